@@ -143,10 +143,12 @@ find_mlir_lib(MLIRCopyOpInterface)
 find_mlir_lib(MLIRDialect)
 find_mlir_lib(MLIREDSC)
 find_mlir_lib(MLIRExecutionEngine)
+find_mlir_lib(MLIRGPU)
 find_mlir_lib(MLIRInferTypeOpInterface)
 find_mlir_lib(MLIRIR)
 find_mlir_lib(MLIRLLVMIR)
 find_mlir_lib(MLIRLoopAnalysis)
+find_mlir_lib(MLIRSCFToGPU)
 find_mlir_lib(MLIRSCFToStandard)
 find_mlir_lib(MLIRLoopLikeInterface)
 find_mlir_lib(MLIRLinalg)
@@ -207,6 +209,8 @@ find_mlir_lib(LLVMDemangle)
 find_mlir_lib(LLVMFrontendOpenMP)
 
 set(MLIRLibs
+        ${MLIRSCFToGPU}
+        ${MLIRGPU}
         ${MLIRAffineToStandard}
         ${MLIRAffine}
         ${MLIRAffineUtils}
@@ -0,0 +1,580 @@
+//===------------- OMBench.cpp - Lowered ONNX operator benchmarks ---------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains micro-benchmarks of the lowerings of commonly used ONNX
+// operators. As in test/numerical, each benchmark builds a module made of a
+// single operator with static shapes, compiles it into a shared library with
+// the options given on the command line (e.g. --vector-bits=256) and runs it.
+//
+// The latency of each invocation is measured, and reported along with its
+// percentiles and with the GFLOP/s and GB/s reached at the median latency:
+//
+//   ./OMBench --benchmark_filter=Conv --enable-matmul-tiling
+//
+// With --tune-model, the matrix multiplications of a model are compiled and
+// timed with candidate tile sizes and loop orders instead, and the fastest
+// ones are written into a tuning database read by onnx-mlir:
+//
+//   ./OMBench --tune-model=model.onnx --tune-output=model.tune
+//   onnx-mlir --tuning-database=model.tune model.onnx
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "mlir/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+
+#include "src/Conversion/ONNXToKrnl/TuningDatabase.hpp"
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/MainUtils.hpp"
+#include "src/Runtime/ExecutionSession.hpp"
+#include "src/Runtime/OMTensorHelper.h"
+
+using namespace std;
+
+namespace {
+
+using OMTensorPtr = unique_ptr<OMTensor, decltype(&omTensorDestroy)>;
+
+/// Input of a benchmarked operator. Integer inputs hold indices in
+/// [0, bound).
+struct BenchInput {
+  vector<int64_t> shape;
+  bool isIndex = false;
+  int64_t bound = 0;
+};
+
+/// A benchmarked operator at a given shape, with the number of floating point
+/// operations and the number of bytes moved by one invocation.
+struct BenchCase {
+  string name;
+  string opName;
+  vector<BenchInput> inputs;
+  // Number of trailing optional operands left unset, e.g. for LSTM.
+  int numNoneOperands = 0;
+  int numResults = 1;
+  function<void(Builder &, OperationState &)> setAttributes;
+  double flops;
+  double bytes;
+
+  unique_ptr<onnx_mlir::ExecutionSession> session;
+  vector<OMTensorPtr> tensors;
+};
+
+/// Inputs are kept by the benchmark across invocations.
+void keepTensor(OMTensor *) {}
+
+int64_t numElements(const vector<int64_t> &shape) {
+  int64_t n = 1;
+  for (int64_t dim : shape)
+    n *= dim;
+  return n;
+}
+
+IntegerAttr getSI64Attr(Builder &builder, int64_t value) {
+  return IntegerAttr::get(builder.getIntegerType(64, /*isSigned=*/true),
+      APInt(64, value, /*isSigned=*/true));
+}
+
+/// Build the module of a benchmarked operator and compile it into a shared
+/// library. Returns false if the compilation failed.
+bool compileBenchCase(BenchCase &bench, const string &sharedLibBase) {
+  MLIRContext ctx;
+  registerDialects(ctx);
+  auto loc = UnknownLoc::get(&ctx);
+
+  auto module = ModuleOp::create(loc);
+  OpBuilder builder(&ctx);
+  SmallVector<Type, 4> inputsType;
+  for (auto &input : bench.inputs)
+    inputsType.emplace_back(RankedTensorType::get(input.shape,
+        input.isIndex ? builder.getI64Type() : builder.getF32Type()));
+  auto yType = UnrankedTensorType::get(builder.getF32Type());
+
+  auto funcType = builder.getFunctionType(inputsType, {yType});
+  auto funcOp = builder.create<FuncOp>(
+      loc, "main_graph", funcType, ArrayRef<NamedAttribute>{});
+  auto entryBlock = funcOp.addEntryBlock();
+  builder.setInsertionPointToStart(entryBlock);
+
+  OperationState state(loc, bench.opName);
+  state.addOperands(entryBlock->getArguments());
+  for (int i = 0; i < bench.numNoneOperands; ++i)
+    state.addOperands(
+        builder.create<ConstantOp>(loc, builder.getUnitAttr()).getResult());
+  state.addTypes(SmallVector<Type, 3>(bench.numResults, yType));
+  if (bench.setAttributes)
+    bench.setAttributes(builder, state);
+  Operation *op = builder.createOperation(state);
+
+  builder.create<ReturnOp>(loc, op->getResult(0));
+  module.push_back(funcOp);
+  module.push_back(ONNXEntryPointOp::create(loc, funcOp,
+      /*numInputs=*/bench.inputs.size(), /*numOutputs=*/1));
+
+  OwningModuleRef moduleRef(module);
+  return compileModule(moduleRef, ctx, sharedLibBase, EmitLib) == 0;
+}
+
+/// Compile a benchmarked operator and create its inputs, unless already done.
+/// Returns false if the compilation failed.
+bool prepareBenchCase(BenchCase &bench) {
+  if (bench.session)
+    return true;
+  string sharedLibBase = "./OMBench_" + bench.name;
+  if (!compileBenchCase(bench, sharedLibBase))
+    return false;
+  bench.session = make_unique<onnx_mlir::ExecutionSession>(
+      sharedLibBase + ".so", "run_main_graph");
+  llvm::sys::fs::remove(sharedLibBase + ".so");
+  for (auto &input : bench.inputs)
+    bench.tensors.emplace_back(
+        input.isIndex ? omTensorCreateWithRandomData<int64_t>(
+                            input.shape, 0, input.bound - 1)
+                      : omTensorCreateWithRandomData<float>(input.shape),
+        omTensorDestroy);
+  return true;
+}
+
+/// Run a prepared benchmarked operator once, returning its latency in
+/// seconds.
+double runBenchCaseOnce(BenchCase &bench) {
+  vector<OMTensorPtr> inputs;
+  for (auto &tensor : bench.tensors)
+    inputs.emplace_back(tensor.get(), keepTensor);
+
+  auto start = chrono::steady_clock::now();
+  auto outputs = bench.session->run(move(inputs));
+  auto end = chrono::steady_clock::now();
+  return chrono::duration<double>(end - start).count();
+}
+
+void runBenchCase(benchmark::State &state, BenchCase *bench) {
+  // Compile and create the inputs once, the benchmark function being called
+  // several times to settle the number of iterations.
+  if (!prepareBenchCase(*bench)) {
+    state.SkipWithError("compilation failed");
+    return;
+  }
+
+  vector<double> latencies;
+  for (auto _ : state) {
+    double seconds = runBenchCaseOnce(*bench);
+    state.SetIterationTime(seconds);
+    latencies.emplace_back(seconds);
+  }
+
+  if (latencies.empty())
+    return;
+  sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    return latencies[min(latencies.size() - 1,
+        static_cast<size_t>(p * latencies.size()))];
+  };
+  double median = percentile(0.5);
+  state.counters["p50_us"] = median * 1e6;
+  state.counters["p90_us"] = percentile(0.9) * 1e6;
+  state.counters["p99_us"] = percentile(0.99) * 1e6;
+  state.counters["GFLOP/s"] = bench->flops / median * 1e-9;
+  state.counters["GB/s"] = bench->bytes / median * 1e-9;
+}
+
+//===----------------------------------------------------------------------===//
+// Benchmarked operators
+//===----------------------------------------------------------------------===//
+
+void addConv(vector<BenchCase> &cases, int64_t C, int64_t H, int64_t M,
+    int64_t k, int64_t stride, int64_t pad) {
+  int64_t OH = (H + 2 * pad - k) / stride + 1;
+  BenchCase bench;
+  bench.name = "Conv_" + to_string(C) + "x" + to_string(H) + "x" +
+               to_string(H) + "_" + to_string(M) + "x" + to_string(k) + "x" +
+               to_string(k) + "_s" + to_string(stride);
+  bench.opName = ONNXConvOp::getOperationName().str();
+  bench.inputs = {{{1, C, H, H}}, {{M, C, k, k}}, {{M}}};
+  bench.setAttributes = [=](Builder &builder, OperationState &state) {
+    state.addAttribute("kernel_shape", builder.getI64ArrayAttr({k, k}));
+    state.addAttribute("pads", builder.getI64ArrayAttr({pad, pad, pad, pad}));
+    state.addAttribute("strides", builder.getI64ArrayAttr({stride, stride}));
+    state.addAttribute("group", getSI64Attr(builder, 1));
+  };
+  bench.flops = 2.0 * M * OH * OH * C * k * k;
+  bench.bytes = 4.0 * (C * H * H + M * C * k * k + M + M * OH * OH);
+  cases.emplace_back(move(bench));
+}
+
+void addMatMul(vector<BenchCase> &cases, int64_t M, int64_t K, int64_t N) {
+  BenchCase bench;
+  bench.name =
+      "MatMul_" + to_string(M) + "x" + to_string(K) + "x" + to_string(N);
+  bench.opName = ONNXMatMulOp::getOperationName().str();
+  bench.inputs = {{{M, K}}, {{K, N}}};
+  bench.flops = 2.0 * M * N * K;
+  bench.bytes = 4.0 * (M * K + K * N + M * N);
+  cases.emplace_back(move(bench));
+}
+
+void addGemm(vector<BenchCase> &cases, int64_t M, int64_t K, int64_t N) {
+  BenchCase bench;
+  bench.name = "Gemm_" + to_string(M) + "x" + to_string(K) + "x" + to_string(N);
+  bench.opName = ONNXGemmOp::getOperationName().str();
+  // Fully connected layers store their weights as NxK.
+  bench.inputs = {{{M, K}}, {{N, K}}, {{N}}};
+  bench.setAttributes = [](Builder &builder, OperationState &state) {
+    state.addAttribute("transB", getSI64Attr(builder, 1));
+  };
+  bench.flops = 2.0 * M * N * K + M * N;
+  bench.bytes = 4.0 * (M * K + K * N + N + M * N);
+  cases.emplace_back(move(bench));
+}
+
+void addSoftmax(vector<BenchCase> &cases, vector<int64_t> shape) {
+  int64_t n = numElements(shape);
+  BenchCase bench;
+  bench.name = "Softmax_" + to_string(shape[0]) + "x" + to_string(n / shape[0]);
+  bench.opName = ONNXSoftmaxOp::getOperationName().str();
+  bench.inputs = {{shape}};
+  bench.setAttributes = [=](Builder &builder, OperationState &state) {
+    state.addAttribute("axis", getSI64Attr(builder, shape.size() - 1));
+  };
+  // Maximum, subtraction, exponential, sum and division.
+  bench.flops = 5.0 * n;
+  bench.bytes = 4.0 * 2 * n;
+  cases.emplace_back(move(bench));
+}
+
+void addReduction(vector<BenchCase> &cases, StringRef opName,
+    vector<int64_t> shape, vector<int64_t> axes) {
+  int64_t n = numElements(shape);
+  int64_t reduced = 1;
+  for (int64_t axis : axes)
+    reduced *= shape[axis];
+  BenchCase bench;
+  bench.name = opName.drop_front(strlen("onnx.")).str();
+  for (int64_t dim : shape)
+    bench.name += "_" + to_string(dim);
+  bench.name += "_axes";
+  for (int64_t axis : axes)
+    bench.name += to_string(axis);
+  bench.opName = opName.str();
+  bench.inputs = {{shape}};
+  bench.setAttributes = [=](Builder &builder, OperationState &state) {
+    state.addAttribute("axes", builder.getI64ArrayAttr(axes));
+    state.addAttribute("keepdims", getSI64Attr(builder, 1));
+  };
+  bench.flops = n;
+  bench.bytes = 4.0 * (n + n / reduced);
+  cases.emplace_back(move(bench));
+}
+
+void addPool(vector<BenchCase> &cases, StringRef opName, int64_t C, int64_t H,
+    int64_t k, int64_t stride, int64_t pad) {
+  int64_t OH = (H + 2 * pad - k) / stride + 1;
+  BenchCase bench;
+  bench.name = opName.drop_front(strlen("onnx.")).str() + "_" + to_string(C) +
+               "x" + to_string(H) + "x" + to_string(H) + "_k" + to_string(k) +
+               "_s" + to_string(stride);
+  bench.opName = opName.str();
+  bench.inputs = {{{1, C, H, H}}};
+  bench.setAttributes = [=](Builder &builder, OperationState &state) {
+    state.addAttribute("kernel_shape", builder.getI64ArrayAttr({k, k}));
+    state.addAttribute("pads", builder.getI64ArrayAttr({pad, pad, pad, pad}));
+    state.addAttribute("strides", builder.getI64ArrayAttr({stride, stride}));
+  };
+  bench.flops = 1.0 * C * OH * OH * k * k;
+  bench.bytes = 4.0 * (C * H * H + C * OH * OH);
+  cases.emplace_back(move(bench));
+}
+
+void addLSTM(vector<BenchCase> &cases, int64_t seqLength, int64_t batchSize,
+    int64_t inputSize, int64_t hiddenSize) {
+  BenchCase bench;
+  bench.name = "LSTM_seq" + to_string(seqLength) + "_b" + to_string(batchSize) +
+               "_i" + to_string(inputSize) + "_h" + to_string(hiddenSize);
+  bench.opName = ONNXLSTMOp::getOperationName().str();
+  bench.inputs = {{{seqLength, batchSize, inputSize}},
+      {{1, 4 * hiddenSize, inputSize}}, {{1, 4 * hiddenSize, hiddenSize}}};
+  // B, sequence_lens, initial_h, initial_c and P.
+  bench.numNoneOperands = 5;
+  bench.numResults = 3;
+  bench.setAttributes = [=](Builder &builder, OperationState &state) {
+    state.addAttribute("hidden_size", getSI64Attr(builder, hiddenSize));
+  };
+  // The gate matrix multiplications dominate.
+  bench.flops =
+      2.0 * seqLength * batchSize * 4 * hiddenSize * (inputSize + hiddenSize);
+  bench.bytes = 4.0 * (seqLength * batchSize * (inputSize + hiddenSize) +
+                          4 * hiddenSize * (inputSize + hiddenSize));
+  cases.emplace_back(move(bench));
+}
+
+void addGather(vector<BenchCase> &cases, int64_t rows, int64_t cols,
+    int64_t numIndices, int64_t axis) {
+  BenchCase bench;
+  bench.name = "Gather_" + to_string(rows) + "x" + to_string(cols) + "_" +
+               to_string(numIndices) + "_axis" + to_string(axis);
+  bench.opName = ONNXGatherOp::getOperationName().str();
+  BenchInput indices;
+  indices.shape = {numIndices};
+  indices.isIndex = true;
+  indices.bound = axis == 0 ? rows : cols;
+  bench.inputs = {{{rows, cols}}, indices};
+  bench.setAttributes = [=](Builder &builder, OperationState &state) {
+    state.addAttribute("axis", getSI64Attr(builder, axis));
+  };
+  int64_t n = numIndices * (axis == 0 ? cols : rows);
+  bench.flops = 0;
+  bench.bytes = 4.0 * 2 * n + 8.0 * numIndices;
+  cases.emplace_back(move(bench));
+}
+
+void addTranspose(
+    vector<BenchCase> &cases, vector<int64_t> shape, vector<int64_t> perm) {
+  int64_t n = numElements(shape);
+  BenchCase bench;
+  bench.name = "Transpose";
+  for (int64_t dim : shape)
+    bench.name += "_" + to_string(dim);
+  bench.name += "_perm";
+  for (int64_t axis : perm)
+    bench.name += to_string(axis);
+  bench.opName = ONNXTransposeOp::getOperationName().str();
+  bench.inputs = {{shape}};
+  bench.setAttributes = [=](Builder &builder, OperationState &state) {
+    state.addAttribute("perm", builder.getI64ArrayAttr(perm));
+  };
+  bench.flops = 0;
+  bench.bytes = 4.0 * 2 * n;
+  cases.emplace_back(move(bench));
+}
+
+/// Shapes representative of image classification, language and recommendation
+/// models.
+vector<BenchCase> getBenchCases() {
+  vector<BenchCase> cases;
+  addConv(cases, 3, 224, 64, 7, 2, 3);
+  addConv(cases, 64, 56, 64, 3, 1, 1);
+  addConv(cases, 256, 56, 64, 1, 1, 0);
+  addConv(cases, 128, 28, 128, 3, 1, 1);
+  addConv(cases, 256, 14, 256, 3, 1, 1);
+
+  addMatMul(cases, 64, 64, 64);
+  addMatMul(cases, 256, 256, 256);
+  addMatMul(cases, 512, 512, 512);
+  addMatMul(cases, 128, 768, 3072);
+
+  addGemm(cases, 1, 2048, 1000);
+  addGemm(cases, 64, 1024, 1024);
+  addGemm(cases, 256, 512, 512);
+
+  addSoftmax(cases, {1, 1000});
+  addSoftmax(cases, {64, 1000});
+  addSoftmax(cases, {8, 128, 128});
+
+  for (StringRef opName : {ONNXReduceSumOp::getOperationName(),
+           ONNXReduceMeanOp::getOperationName(),
+           ONNXReduceMaxOp::getOperationName()}) {
+    addReduction(cases, opName, {64, 1024}, {1});
+    addReduction(cases, opName, {64, 1024}, {0});
+    addReduction(cases, opName, {1, 256, 56, 56}, {2, 3});
+  }
+
+  addPool(cases, ONNXMaxPoolSingleOutOp::getOperationName(), 64, 112, 3, 2, 1);
+  addPool(cases, ONNXMaxPoolSingleOutOp::getOperationName(), 256, 28, 2, 2, 0);
+  addPool(cases, ONNXAveragePoolOp::getOperationName(), 64, 56, 3, 1, 1);
+  addPool(cases, ONNXAveragePoolOp::getOperationName(), 256, 14, 2, 2, 0);
+
+  addLSTM(cases, 16, 1, 256, 256);
+  addLSTM(cases, 32, 16, 512, 512);
+
+  addGather(cases, 30000, 512, 128, 0);
+  addGather(cases, 64, 1024, 512, 1);
+
+  addTranspose(cases, {1, 64, 56, 56}, {0, 2, 3, 1});
+  addTranspose(cases, {1024, 1024}, {1, 0});
+  addTranspose(cases, {16, 128, 12, 64}, {0, 2, 1, 3});
+  return cases;
+}
+
+//===----------------------------------------------------------------------===//
+// Auto-tuning
+//===----------------------------------------------------------------------===//
+
+llvm::cl::opt<string> tuneModel("tune-model",
+    llvm::cl::desc("instead of running the benchmarks, tune the tile sizes "
+                   "and loop orders of the matrix multiplications of the "
+                   "given model for the target CPU, see --tune-output:"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+llvm::cl::opt<string> tuneOutput("tune-output",
+    llvm::cl::desc("tuning database to which the tuned parameters are added, "
+                   "to be given to onnx-mlir with --tuning-database:"),
+    llvm::cl::value_desc("filename"), llvm::cl::init("onnx-mlir.tune"));
+
+/// Parameters of the tiled lowering of MatMul and the values tried for them,
+/// the first value being the default of the lowering. The register tiles are
+/// tuned first as the best cache tiles depend on them.
+const vector<pair<string, vector<string>>> matMulTuningSpace = {
+    {"register-tile-m", {"4", "2", "8"}},
+    {"register-tile-n", {"8", "4", "16"}},
+    {"cache-tile-m", {"64", "32", "128"}},
+    {"cache-tile-n", {"256", "64", "128", "512"}},
+    {"cache-tile-k", {"128", "64", "256"}},
+    {"cache-loop-order", {"nkm", "nmk", "mnk", "kmn"}},
+};
+
+/// Number of timed invocations of each candidate, after one warm-up
+/// invocation.
+const int numTuningRuns = 10;
+
+/// Return the operand shapes of the matrix multiplications of static shapes of
+/// a model, once per distinct shape.
+vector<vector<vector<int64_t>>> getMatMulShapes(const string &modelFile) {
+  MLIRContext ctx;
+  registerDialects(ctx);
+  OwningModuleRef module;
+  processInputFile(modelFile, EmitONNXIR, ctx, module);
+  mlir::PassManager pm(&ctx);
+  addONNXToMLIRPasses(pm);
+  if (!module || failed(pm.run(*module)))
+    return {};
+
+  vector<vector<vector<int64_t>>> shapes;
+  module->walk([&](ONNXMatMulOp op) {
+    vector<vector<int64_t>> operandShapes;
+    for (Type type : op.getOperation()->getOperandTypes()) {
+      auto tensorType = type.dyn_cast<RankedTensorType>();
+      if (!tensorType || !tensorType.hasStaticShape() ||
+          tensorType.getRank() < 2 || !tensorType.getElementType().isF32())
+        return;
+      operandShapes.emplace_back(tensorType.getShape().vec());
+    }
+    if (find(shapes.begin(), shapes.end(), operandShapes) == shapes.end())
+      shapes.emplace_back(move(operandShapes));
+  });
+  return shapes;
+}
+
+/// Median latency in seconds of a matrix multiplication lowered with the given
+/// parameters, or a negative value if it cannot be compiled.
+double measureMatMul(const vector<vector<int64_t>> &shapes,
+    const string &shapesKey, const TuningConfig &config, int candidate) {
+  // The candidate is compiled with a database holding only its parameters.
+  SmallString<64> databaseFile;
+  if (llvm::sys::fs::createTemporaryFile("OMBench", "tune", databaseFile))
+    return -1;
+  TuningDatabase database;
+  database.insert(
+      ONNXMatMulOp::getOperationName(), shapesKey, getTuningTarget(), config);
+  string errorMessage;
+  if (!database.save(databaseFile, errorMessage)) {
+    llvm::errs() << errorMessage << "\n";
+    return -1;
+  }
+  setTuningDatabase(databaseFile.str().str());
+
+  // Libraries are not reloaded from the same path, each candidate has its own.
+  BenchCase bench;
+  bench.name = "tune_" + to_string(candidate);
+  bench.opName = ONNXMatMulOp::getOperationName().str();
+  bench.inputs = {{shapes[0]}, {shapes[1]}};
+  bool prepared = prepareBenchCase(bench);
+  llvm::sys::fs::remove(databaseFile);
+  if (!prepared)
+    return -1;
+
+  runBenchCaseOnce(bench);
+  vector<double> latencies;
+  for (int i = 0; i < numTuningRuns; ++i)
+    latencies.emplace_back(runBenchCaseOnce(bench));
+  sort(latencies.begin(), latencies.end());
+  return latencies[latencies.size() / 2];
+}
+
+/// Tune the matrix multiplications of the model given by --tune-model and add
+/// the fastest parameters found for each shape to the --tune-output database.
+/// The parameters are tuned one at a time, keeping the best value of each.
+int tuneMatMuls() {
+  TuningDatabase database;
+  string errorMessage;
+  if (llvm::sys::fs::exists(tuneOutput) &&
+      !database.load(tuneOutput, errorMessage)) {
+    llvm::errs() << errorMessage << "\n";
+    return 1;
+  }
+
+  MLIRContext ctx;
+  string target = getTuningTarget();
+  int candidate = 0;
+  for (auto &shapes : getMatMulShapes(tuneModel)) {
+    SmallVector<Type, 2> operandTypes;
+    for (auto &shape : shapes)
+      operandTypes.emplace_back(
+          RankedTensorType::get(shape, FloatType::getF32(&ctx)));
+    string shapesKey = TuningDatabase::getShapesKey(operandTypes);
+
+    TuningConfig best;
+    for (auto &parameter : matMulTuningSpace)
+      best[parameter.first] = parameter.second.front();
+    double bestLatency = measureMatMul(shapes, shapesKey, best, candidate++);
+    if (bestLatency < 0) {
+      llvm::errs() << "cannot compile MatMul " << shapesKey << "\n";
+      continue;
+    }
+    for (auto &parameter : matMulTuningSpace) {
+      for (auto &value : llvm::makeArrayRef(parameter.second).drop_front()) {
+        TuningConfig config = best;
+        config[parameter.first] = value;
+        double latency = measureMatMul(shapes, shapesKey, config, candidate++);
+        if (latency >= 0 && latency < bestLatency) {
+          best = config;
+          bestLatency = latency;
+        }
+      }
+    }
+    database.insert(ONNXMatMulOp::getOperationName(), shapesKey, target, best);
+    llvm::outs() << "MatMul " << shapesKey << ": " << bestLatency * 1e6
+                 << " us\n";
+  }
+
+  if (!database.save(tuneOutput, errorMessage)) {
+    llvm::errs() << errorMessage << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  setExecPath(argv[0], (void *)main);
+
+  // The benchmark flags are consumed first, the remaining ones are the
+  // options of onnx-mlir used to compile the operators.
+  benchmark::Initialize(&argc, argv);
+  llvm::cl::ParseCommandLineOptions(
+      argc, argv, "ONNX-MLIR operator micro-benchmarks\n");
+  if (!tuneModel.empty())
+    return tuneMatMuls();
+
+  auto cases = getBenchCases();
+  for (auto &bench : cases)
+    benchmark::RegisterBenchmark(bench.name.c_str(), runBenchCase, &bench)
+        ->UseManualTime()
+        ->Unit(benchmark::kMicrosecond);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -18,6 +18,9 @@
 #include <stdint.h>
 #endif
 
+#include <onnx-mlir/Runtime/OMArena.h>
+#include <onnx-mlir/Runtime/OMInstrument.h>
+#include <onnx-mlir/Runtime/OMMemoryPlan.h>
 #include <onnx-mlir/Runtime/OMTensor.h>
 #include <onnx-mlir/Runtime/OMTensorList.h>
 
@@ -0,0 +1,66 @@
+//===------------- OMArena.h - OMArena Declaration header -----------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declaration of the memory arena API functions used by
+// models compiled with --enable-memory-arena.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ONNX_MLIR_OMARENA_H
+#define ONNX_MLIR_OMARENA_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Memory arena slot getter
+ *
+ * Return the memory of the memory pool identified by `slot` in the arena of
+ * the calling thread. The memory is kept across calls and is only reallocated
+ * when `size` exceeds the size of the memory already held by the slot, in
+ * which case its content is not preserved. The memory is owned by the arena
+ * and must not be freed by the caller.
+ *
+ * @param slot index of the memory pool within the compiled model
+ * @param size size in bytes of the memory pool
+ * @return pointer to at least `size` bytes, NULL if allocation failed.
+ */
+void *omArenaGet(int64_t slot, int64_t size);
+
+/**
+ * \brief Memory arena allocation counter
+ *
+ * Return the number of heap allocations made so far by the arena of the
+ * calling thread, i.e. the number of times its memory pools and its table of
+ * slots were allocated or grown. The difference between two calls around an
+ * invocation of a model is zero once the arena was sized by a previous
+ * invocation on the same inputs.
+ *
+ * @return number of allocations of the arena of the calling thread.
+ */
+int64_t omArenaGetNumAllocs(void);
+
+/**
+ * \brief Memory arena destroyer
+ *
+ * Free all the memory held by the arena of the calling thread. A thread
+ * running a model compiled with --enable-memory-arena should call this
+ * function before exiting.
+ */
+void omArenaRelease(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ONNX_MLIR_OMARENA_H
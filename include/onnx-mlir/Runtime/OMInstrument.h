@@ -0,0 +1,95 @@
+//===--------- OMInstrument.h - OMInstrument Declaration header -----------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declaration of the profiling API functions used by
+// models compiled with --instrument.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ONNX_MLIR_OMINSTRUMENT_H
+#define ONNX_MLIR_OMINSTRUMENT_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Profiling hook
+ *
+ * Called by models compiled with --instrument right before (`tag` 0) and
+ * right after (`tag` 1) the code of each ONNX operation. The time elapsed
+ * between the two calls made by a thread for an operation is recorded into
+ * the profile, along with the hardware performance counters of the thread
+ * when they are collected. The strings are owned by the compiled model and
+ * must outlive the profile.
+ *
+ * @param opName name of the ONNX operation, e.g. "onnx.Conv"
+ * @param nodeName name of the node in the ONNX model, may be empty
+ * @param shapes types of the operands and the results of the operation
+ * @param tag 0 before the operation, 1 after it
+ */
+void omInstrumentPoint(
+    const char *opName, const char *nodeName, const char *shapes, int64_t tag);
+
+/**
+ * \brief Aggregated profile writer
+ *
+ * Write the number of calls and the total and average time spent in each
+ * ONNX node, from the slowest to the fastest, followed by the same numbers
+ * aggregated per kind of operation. With ONNX_MLIR_PERF_COUNTERS=1, the
+ * average cycles, instructions per cycle and memory traffic of the calls
+ * follow the times.
+ *
+ * @param path file to write, NULL writes to the standard output
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int omInstrumentDumpProfile(const char *path);
+
+/**
+ * \brief Chrome trace writer
+ *
+ * Write the recorded operations in the Trace Event Format, which can be
+ * loaded into chrome://tracing or Perfetto. Only the first events are kept
+ * for the trace, 1048576 by default or the number given by the
+ * ONNX_MLIR_INSTRUMENT_MAX_EVENTS environment variable; the aggregated
+ * profile covers all the events.
+ *
+ * @param path file to write
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int omInstrumentDumpChromeTrace(const char *path);
+
+/**
+ * \brief Prometheus profile writer
+ *
+ * Write the number of calls, the time and, with ONNX_MLIR_PERF_COUNTERS=1,
+ * the hardware performance counters of each ONNX node in the Prometheus text
+ * exposition format, see OMPerfCounters.h.
+ *
+ * @param path file to write, NULL writes to the standard output
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int omInstrumentDumpPrometheus(const char *path);
+
+/**
+ * \brief Profile reset
+ *
+ * Discard the profile and the trace recorded so far, e.g. after warm-up
+ * invocations of a model.
+ */
+void omInstrumentReset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ONNX_MLIR_OMINSTRUMENT_H
@@ -0,0 +1,110 @@
+//===------------- OMMemcpy.h - OMMemcpy Declaration header ---------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declaration of the memory copy functions called by the
+// compiled models.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ONNX_MLIR_OMMEMCPY_H
+#define ONNX_MLIR_OMMEMCPY_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Non-temporal memory copy
+ *
+ * Copy `size` bytes from `src` to `dest` with non-temporal stores where the
+ * target supports them, so that the destination does not evict the content
+ * of the caches. The stores are complete when the function returns. The
+ * memory ranges must not overlap.
+ *
+ * @param dest pointer to the destination memory
+ * @param src pointer to the source memory
+ * @param size number of bytes to copy
+ */
+void omMemcpyNonTemporal(void *dest, const void *src, int64_t size);
+
+/**
+ * \brief Parallel memory copy
+ *
+ * Copy `size` bytes from `src` to `dest`, split in contiguous chunks copied
+ * by the calling thread and the memory copy threads of the runtime when
+ * `size` is at least `threshold` bytes, in a single memcpy otherwise. The
+ * chunks are copied with non-temporal stores if `nonTemporal` is not zero,
+ * see omMemcpyNonTemporal. The copy is complete when the function returns.
+ * The memory ranges must not overlap.
+ *
+ * The number of memory copy threads is given by ONNX_MLIR_MEMCPY_THREADS in
+ * the environment, by default one less than the number of online processors
+ * up to 7, and 0 disables them. A single parallel copy runs at a time, the
+ * copies made concurrently by other threads are not split.
+ *
+ * @param dest pointer to the destination memory
+ * @param src pointer to the source memory
+ * @param size number of bytes to copy
+ * @param threshold minimum number of bytes of a split copy
+ * @param nonTemporal whether to copy with non-temporal stores
+ */
+void omMemcpyParallel(void *dest, const void *src, int64_t size,
+    int64_t threshold, int32_t nonTemporal);
+
+/**
+ * \brief Memory copy threads configuration
+ *
+ * Start the memory copy threads of the runtime if they are not started yet,
+ * pin them to the CPUs of `cpus` but the first one, which is left to the
+ * thread running the model, in a round robin fashion (Linux only), and make
+ * them and the callers of omMemcpyParallel spin rather than sleep while they
+ * wait if `spinWait` is not zero. Spinning threads keep their CPU busy
+ * between the copies, so they should run on CPUs isolated for the model.
+ * The threads are not pinned when `numCpus` is less than 2. They are stopped
+ * when the library embedding the runtime is unloaded.
+ *
+ * @param cpus CPUs to pin the threads to
+ * @param numCpus number of CPUs in `cpus`
+ * @param spinWait whether the threads spin while they wait
+ * @return 0 on success, -1 if a thread could not be pinned.
+ */
+int omMemcpyConfigureThreads(
+    const int *cpus, int64_t numCpus, int32_t spinWait);
+
+/**
+ * \brief MemRef padding
+ *
+ * Replace the data of the MemRef described by `memRef` with a copy whose
+ * dimension `axis` is padded with zeros up to `size`, stored contiguously.
+ * The descriptor is updated to point to the copy, with an offset of 0 and
+ * the new sizes and strides. The compiled models call this function to pad
+ * their inputs to the sequence length of a specialized inference function.
+ * Aborts if the copy cannot be allocated.
+ *
+ * @param memRef pointer to the MemRef descriptor, holding the allocated and
+ * aligned pointers, the offset, the sizes and the strides
+ * @param rank rank of the MemRef
+ * @param axis dimension to pad
+ * @param size padded size of the dimension
+ * @param elementSize size in bytes of the elements
+ * @return pointer to the copy, to be freed by the caller once the MemRef is no
+ * longer used, NULL if the dimension is not smaller than `size` and the MemRef
+ * is left unchanged.
+ */
+void *omPadMemRef(void *memRef, int64_t rank, int64_t axis, int64_t size,
+    int64_t elementSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ONNX_MLIR_OMMEMCPY_H
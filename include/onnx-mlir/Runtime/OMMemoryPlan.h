@@ -0,0 +1,42 @@
+//===--------- OMMemoryPlan.h - OMMemoryPlan Declaration header -----------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declaration of the memory plan query functions exported
+// by the compiled models.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ONNX_MLIR_OMMEMORYPLAN_H
+#define ONNX_MLIR_OMMEMORYPLAN_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Peak memory getter
+ *
+ * Return the peak memory in bytes of the buffers allocated by one inference of
+ * the compiled model, including its outputs but not its inputs nor its
+ * constants, as planned at compile time. Concurrent inferences each need this
+ * memory.
+ *
+ * @return peak memory in bytes, -1 if the model has dynamically shaped buffers
+ * whose size is only known at run time.
+ */
+int64_t omModelGetPeakMemory(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ONNX_MLIR_OMMEMORYPLAN_H
@@ -0,0 +1,53 @@
+//===------------ OMParallel.h - OMParallel Declaration header ------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declaration of the parallel loop function called by the
+// compiled models.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ONNX_MLIR_OMPARALLEL_H
+#define ONNX_MLIR_OMPARALLEL_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Parallel loop
+ *
+ * Run the iterations [0, numIterations) of a parallel loop on the calling
+ * thread and the loop threads of the runtime. The iterations are split in
+ * contiguous ranges, at most one per thread, and `body` is called with the
+ * bounds [begin, end) of each range and `context`. The iterations are all
+ * run when the function returns.
+ *
+ * The number of loop threads is given by ONNX_MLIR_NUM_THREADS in the
+ * environment, by default one less than the number of online processors,
+ * and 0 disables them. A single parallel loop runs at a time: the loops
+ * started concurrently by other threads, or by the body of a parallel loop,
+ * run all their iterations on the calling thread.
+ *
+ * @param body function running the iterations [begin, end)
+ * @param numIterations number of iterations of the loop
+ * @param context pointer passed to `body`
+ * @param numThreads maximum number of threads running the loop, the calling
+ * thread included, 0 for all of them
+ */
+void omParallelFor(void (*body)(int64_t, int64_t, void *),
+    int64_t numIterations, void *context, int32_t numThreads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ONNX_MLIR_OMPARALLEL_H
@@ -0,0 +1,59 @@
+//===------- OMPerfCounters.h - OMPerfCounters Declaration header ---------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declaration of the hardware performance counter API
+// functions embedded into the compiled models.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ONNX_MLIR_OMPERFCOUNTERS_H
+#define ONNX_MLIR_OMPERFCOUNTERS_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hardware performance counters read by omPerfCountersRead. There is no
+ * per-thread counter of the memory bandwidth, the traffic from memory is
+ * estimated from the last level cache misses, each of them reading a cache
+ * line of OM_PERF_CACHE_LINE_BYTES bytes.
+ */
+typedef enum {
+  OM_PERF_CYCLES = 0,
+  OM_PERF_INSTRUCTIONS = 1,
+  OM_PERF_LLC_MISSES = 2,
+  OM_PERF_NUM_COUNTERS = 3,
+} OM_PERF_COUNTER;
+
+#define OM_PERF_CACHE_LINE_BYTES 64
+
+/**
+ * \brief Hardware performance counters reader
+ *
+ * Read the hardware performance counters of the calling thread, counting the
+ * events in user space since the first call made by the thread. The counters
+ * are only collected with ONNX_MLIR_PERF_COUNTERS=1 in the environment, on
+ * Linux, when the kernel lets the process open them, see
+ * /proc/sys/kernel/perf_event_paranoid.
+ *
+ * @param counters array of OM_PERF_NUM_COUNTERS counters, indexed by
+ * OM_PERF_COUNTER
+ * @return 0 on success, -1 if the counters are not collected.
+ */
+int omPerfCountersRead(uint64_t *counters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ONNX_MLIR_OMPERFCOUNTERS_H
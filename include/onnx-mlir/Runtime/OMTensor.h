@@ -144,6 +144,31 @@ OMTensor *omTensorCreateEmptyDeprecated(int rank);
  */
 void omTensorDestroy(OMTensor *tensor);
 
+/**
+ * \brief Recycle the OMTensor struct.
+ *
+ * Like omTensorDestroy, except that an OMTensor owning an aligned data buffer
+ * is kept by the calling thread along with its buffer, to be returned by its
+ * next call of omTensorCreateEmpty with the same shape and element type. The
+ * content of the buffer is left as is. Recycling the input and output tensors
+ * of a request saves their allocation in the next requests of the same shape.
+ *
+ * @param tensor pointer to the OMTensor
+ *
+ */
+void omTensorRecycle(OMTensor *tensor);
+
+/**
+ * \brief Free the OMTensor structs and recycled OMTensors kept by the calling
+ * thread.
+ *
+ * Destroyed OMTensor structs are kept by the thread destroying them for its
+ * next OMTensors of the same rank. Threads that no longer create OMTensors
+ * can release them.
+ *
+ */
+void omTensorPoolRelease(void);
+
 /**
  * \brief OMTensor data pointer getter.
  *
@@ -213,6 +238,29 @@ int64_t *omTensorGetStrides(OMTensor *tensor);
  */
 void omTensorSetStrides(OMTensor *tensor, int64_t *strides);
 
+/**
+ * \brief OMTensor data offset getter
+ *
+ * The offset is the number of elements between the aligned data pointer and
+ * the first element of the tensor, so that a tensor may view a part of a
+ * larger buffer.
+ *
+ * @param tensor pointer to the OMTensor
+ * @return offset of the first element, in elements.
+ */
+int64_t omTensorGetOffset(OMTensor *tensor);
+
+/**
+ * \brief OMTensor data offset setter
+ *
+ * @param tensor pointer to the OMTensor
+ * @param offset offset of the first element from the aligned data pointer, in
+ * elements.
+ *
+ * Set the offset of the first element of the OMTensor.
+ */
+void omTensorSetOffset(OMTensor *tensor, int64_t offset);
+
 /**
  * \brief OMTensor data type getter
  *
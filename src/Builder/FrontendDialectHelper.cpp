@@ -7,7 +7,13 @@
 // Helper methods for handling input ONNX models.
 //
 //===----------------------------------------------------------------------===//
+#include <cstring>
+
+#include <llvm/ADT/SmallString.h>
 #include <llvm/Support/Endian.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/SwapByteOrder.h>
 
 #include "src/Builder/FrontendDialectHelper.hpp"
@@ -58,93 +64,138 @@ bool OnnxMlirSymbolMapping::ContainKey(std::string name) {
 
 template <typename T>
 struct TransformValueToONNXData {
-  static const google::protobuf::RepeatedField<T> data(
-      onnx::TensorProto initializer) {
-    return google::protobuf::RepeatedField<T>();
+  static const google::protobuf::RepeatedField<T> &data(
+      const onnx::TensorProto &initializer) {
+    static const google::protobuf::RepeatedField<T> empty;
+    return empty;
   }
 };
 
 template <>
 struct TransformValueToONNXData<double> {
-  static const google::protobuf::RepeatedField<double> data(
-      onnx::TensorProto initializer) {
+  static const google::protobuf::RepeatedField<double> &data(
+      const onnx::TensorProto &initializer) {
     return initializer.double_data();
   }
 };
 
 template <>
 struct TransformValueToONNXData<float> {
-  static const google::protobuf::RepeatedField<float> data(
-      onnx::TensorProto initializer) {
+  static const google::protobuf::RepeatedField<float> &data(
+      const onnx::TensorProto &initializer) {
     return initializer.float_data();
   }
 };
 
 template <>
 struct TransformValueToONNXData<int32_t> {
-  static const google::protobuf::RepeatedField<int32_t> data(
-      onnx::TensorProto initializer) {
+  static const google::protobuf::RepeatedField<int32_t> &data(
+      const onnx::TensorProto &initializer) {
     return initializer.int32_data();
   }
 };
 
 template <>
 struct TransformValueToONNXData<int64_t> {
-  static const google::protobuf::RepeatedField<int64_t> data(
-      onnx::TensorProto initializer) {
+  static const google::protobuf::RepeatedField<int64_t> &data(
+      const onnx::TensorProto &initializer) {
     return initializer.int64_data();
   }
 };
 
 template <>
 struct TransformValueToONNXData<uint8_t> {
-  static const google::protobuf::RepeatedField<int32_t> data(
-      onnx::TensorProto initializer) {
+  static const google::protobuf::RepeatedField<int32_t> &data(
+      const onnx::TensorProto &initializer) {
     return initializer.int32_data();
   }
 };
 
 template <>
 struct TransformValueToONNXData<int8_t> {
-  static const google::protobuf::RepeatedField<int32_t> data(
-      onnx::TensorProto initializer) {
+  static const google::protobuf::RepeatedField<int32_t> &data(
+      const onnx::TensorProto &initializer) {
     return initializer.int32_data();
   }
 };
 
-// Helper method for constructing an array attribute from a model input.
+// Return the raw data of a tensor. The data of tensors stored in an external
+// data file is memory-mapped into `externalData` rather than read.
+static llvm::StringRef getRawData(const onnx::TensorProto &initializer,
+    const std::string &externalDataDir,
+    std::unique_ptr<llvm::MemoryBuffer> &externalData) {
+  if (initializer.data_location() != onnx::TensorProto::EXTERNAL)
+    return initializer.raw_data();
+
+  std::string location;
+  int64_t offset = 0, length = -1;
+  for (const auto &entry : initializer.external_data()) {
+    if (entry.key() == "location")
+      location = entry.value();
+    else if (entry.key() == "offset")
+      offset = std::stoll(entry.value());
+    else if (entry.key() == "length")
+      length = std::stoll(entry.value());
+  }
+  // The location is relative to the directory of the model.
+  llvm::SmallString<128> path(externalDataDir);
+  llvm::sys::path::append(path, location);
+  if (length < 0) {
+    uint64_t fileSize;
+    if (llvm::sys::fs::file_size(path, fileSize))
+      llvm::report_fatal_error(
+          llvm::Twine("cannot open external data file ") + path);
+    length = fileSize - offset;
+  }
+  auto buffer = llvm::MemoryBuffer::getFileSlice(path, length, offset,
+      /*IsVolatile=*/false);
+  if (!buffer)
+    llvm::report_fatal_error(llvm::Twine("cannot read external data of ") +
+                             initializer.name() + " from " + path);
+  externalData = std::move(*buffer);
+  return externalData->getBuffer();
+}
+
+// Helper method for constructing a dense elements attribute from a model
+// input.
 template <typename T>
-static std::vector<T> CreateArrayAttribute(onnx::TensorProto initializer) {
-  size_t size;
-  if (initializer.raw_data().size()) {
-    // copy & take care of endianness
-    std::vector<char> byteInitializer;
-    std::copy(initializer.raw_data().begin(), initializer.raw_data().end(),
-        back_inserter(byteInitializer));
-    size = initializer.raw_data().size() / sizeof(T);
-    T *arrayPtr = reinterpret_cast<T *>(&byteInitializer[0]);
-    auto array = std::vector<T>(arrayPtr, arrayPtr + size);
+static mlir::DenseElementsAttr createDenseElmAttr(
+    mlir::RankedTensorType tensorType, const onnx::TensorProto &initializer,
+    llvm::StringRef rawData) {
+  if (!rawData.empty()) {
+    // ONNX tensor content raw data is always in LE, so that it is the content
+    // of the attribute as is on LE systems.
+    llvm::ArrayRef<char> rawBuffer(rawData.data(), rawData.size());
+    bool detectedSplat;
+    if (llvm::support::endian::system_endianness() ==
+            llvm::support::endianness::little &&
+        mlir::DenseElementsAttr::isValidRawBuffer(
+            tensorType, rawBuffer, detectedSplat))
+      return mlir::DenseElementsAttr::getFromRawBuffer(
+          tensorType, rawBuffer, detectedSplat);
+
+    // Copy & take care of endianness.
+    std::vector<T> array(rawData.size() / sizeof(T));
+    std::memcpy(array.data(), rawData.data(), array.size() * sizeof(T));
     // Perform byte swap if system endianness is BE.
-    // ONNX tensor content raw data is always in LE.
     if (llvm::support::endian::system_endianness() !=
         llvm::support::endianness::little)
-      for (int i = 0; i < array.size(); i++)
+      for (size_t i = 0; i < array.size(); i++)
         llvm::sys::swapByteOrder<T>(array[i]);
-
-    return array;
+    return mlir::DenseElementsAttr::get(tensorType, llvm::makeArrayRef(array));
   }
 
   // copy, no need to take care of endianness
-  auto data = TransformValueToONNXData<T>::data(initializer);
-  size = data.size();
-  return std::vector<T>(&data[0], &data[0] + size);
+  const auto &data = TransformValueToONNXData<T>::data(initializer);
+  std::vector<T> array(data.begin(), data.end());
+  return mlir::DenseElementsAttr::get(tensorType, llvm::makeArrayRef(array));
 }
 
 void InitializedTensorMapping::AddMapping(
-    std::string name, onnx::TensorProto tensor) {
+    std::string name, const onnx::TensorProto &tensor) {
   assert(nameToInitializedTensor.count(name) == 0 &&
          "Tensor initializer already mapped.");
-  nameToInitializedTensor.emplace(name, tensor);
+  nameToInitializedTensor.emplace(name, &tensor);
 }
 
 bool InitializedTensorMapping::ContainKey(std::string name) {
@@ -153,78 +204,67 @@ bool InitializedTensorMapping::ContainKey(std::string name) {
 
 mlir::Value InitializedTensorMapping::EmitInitializerForInputTensor(
     mlir::Location loc, mlir::OpBuilder &builder, const std::string &name) {
-  // Initializer for input.
-  onnx::TensorProto initializer = GetInitializedTensor(name);
-
   // Emit ConstantOp and record the mapping between the input and
   // the constant value.
-  // Create value attribute.
-  mlir::DenseElementsAttr denseElmAttr =
-      onnxTensorProtoToDenseElmAttr(builder, initializer);
+  // Create value attribute, once for all the uses of the initializer.
+  mlir::DenseElementsAttr &denseElmAttr = nameToDenseElmAttr[name];
+  if (!denseElmAttr)
+    denseElmAttr = onnxTensorProtoToDenseElmAttr(
+        builder, GetInitializedTensor(name), externalDataDir);
 
   // Create ConstantOp for dense array.
   return builder.create<mlir::ONNXConstantOp>(
       loc, denseElmAttr.getType(), nullptr, denseElmAttr);
 }
 
-mlir::DenseElementsAttr onnxTensorProtoToDenseElmAttr(
-    mlir::OpBuilder &builder, const onnx::TensorProto &initializer) {
+mlir::DenseElementsAttr onnxTensorProtoToDenseElmAttr(mlir::OpBuilder &builder,
+    const onnx::TensorProto &initializer, const std::string &externalDataDir) {
   // Tensor dimensions.
   llvm::ArrayRef<int64_t> tensorDims(
       initializer.dims().data(), initializer.dims().size());
+  // The mapping of external data is released once the attribute is created.
+  std::unique_ptr<llvm::MemoryBuffer> externalData;
+  llvm::StringRef rawData =
+      getRawData(initializer, externalDataDir, externalData);
   mlir::DenseElementsAttr denseElmAttr;
   switch (initializer.data_type()) {
   case (onnx::TensorProto::FLOAT): {
-    const auto &arrayAttrInitializer = CreateArrayAttribute<float>(initializer);
     auto elmType = builder.getF32Type();
     auto tensorType = mlir::RankedTensorType::get(tensorDims, elmType);
-    denseElmAttr = mlir::DenseElementsAttr::get(
-        tensorType, llvm::makeArrayRef(arrayAttrInitializer));
+    denseElmAttr = createDenseElmAttr<float>(tensorType, initializer, rawData);
     break;
   }
   case (onnx::TensorProto::DOUBLE): {
-    const auto &arrayAttrInitializer =
-        CreateArrayAttribute<double>(initializer);
     auto elmType = builder.getF64Type();
     auto tensorType = mlir::RankedTensorType::get(tensorDims, elmType);
-    denseElmAttr = mlir::DenseElementsAttr::get(
-        tensorType, llvm::makeArrayRef(arrayAttrInitializer));
+    denseElmAttr = createDenseElmAttr<double>(tensorType, initializer, rawData);
     break;
   }
   case (onnx::TensorProto::INT8): {
-    const auto &arrayAttrInitializer =
-        CreateArrayAttribute<int8_t>(initializer);
     auto elmType = builder.getIntegerType(8);
     auto tensorType = mlir::RankedTensorType::get(tensorDims, elmType);
-    denseElmAttr = mlir::DenseElementsAttr::get(
-        tensorType, llvm::makeArrayRef(arrayAttrInitializer));
+    denseElmAttr = createDenseElmAttr<int8_t>(tensorType, initializer, rawData);
     break;
   }
   case (onnx::TensorProto::UINT8): {
-    const auto &arrayAttrInitializer =
-        CreateArrayAttribute<uint8_t>(initializer);
     auto elmType = builder.getIntegerType(8, false);
     auto tensorType = mlir::RankedTensorType::get(tensorDims, elmType);
-    denseElmAttr = mlir::DenseElementsAttr::get(
-        tensorType, llvm::makeArrayRef(arrayAttrInitializer));
+    denseElmAttr =
+        createDenseElmAttr<uint8_t>(tensorType, initializer, rawData);
     break;
   }
   case (onnx::TensorProto::INT32): {
-    const auto &arrayAttrInitializer =
-        CreateArrayAttribute<int32_t>(initializer);
     auto elmType = builder.getIntegerType(32);
     auto tensorType = mlir::RankedTensorType::get(tensorDims, elmType);
-    denseElmAttr = mlir::DenseElementsAttr::get(
-        tensorType, llvm::makeArrayRef(arrayAttrInitializer));
+    denseElmAttr =
+        createDenseElmAttr<int32_t>(tensorType, initializer, rawData);
     break;
   }
   case (onnx::TensorProto::INT64): {
-    const auto &arrayAttrInitializer =
-        CreateArrayAttribute<int64_t>(initializer);
     auto elmType = builder.getIntegerType(64);
     auto tensorType = mlir::RankedTensorType::get(tensorDims, elmType);
-    denseElmAttr = mlir::DenseElementsAttr::get(
-        tensorType, llvm::makeArrayRef(arrayAttrInitializer));
+    denseElmAttr =
+        createDenseElmAttr<int64_t>(tensorType, initializer, rawData);
     break;
   }
   default:
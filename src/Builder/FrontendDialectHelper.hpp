@@ -69,8 +69,15 @@ private:
 };
 
 struct InitializedTensorMapping {
-  // Add new entry.
-  void AddMapping(std::string name, onnx::TensorProto tensor);
+  // Add new entry. The tensor is referenced, not copied, so that the model
+  // must outlive the mapping.
+  void AddMapping(std::string name, const onnx::TensorProto &tensor);
+
+  // Set the directory that the locations of the external data files of the
+  // tensors are relative to, i.e. the directory of the model.
+  void SetExternalDataDir(std::string dir) { externalDataDir = dir; }
+
+  const std::string &GetExternalDataDir() { return externalDataDir; }
 
   // Check if input is initialized. Not all inputs are, some of the inputs
   // require input from the user and are not stored inside the ONNX model
@@ -89,19 +96,29 @@ struct InitializedTensorMapping {
       mlir::Location loc, mlir::OpBuilder &builder, const std::string &name);
 
   // Get initialized tensor.
-  onnx::TensorProto &GetInitializedTensor(std::string name) {
+  const onnx::TensorProto &GetInitializedTensor(std::string name) {
     assert(
         nameToInitializedTensor.find(name) != nameToInitializedTensor.end() &&
         "Tensor initializer not found");
-    return nameToInitializedTensor.at(name);
+    return *nameToInitializedTensor.at(name);
   }
 
 private:
   // Mapping from ONNX tensor name to InitializedTensor.
-  std::map<std::string, onnx::TensorProto> nameToInitializedTensor;
+  std::map<std::string, const onnx::TensorProto *> nameToInitializedTensor;
+
+  // Mapping from ONNX tensor name to the value of its constants, created on
+  // its first use.
+  std::map<std::string, mlir::DenseElementsAttr> nameToDenseElmAttr;
+
+  std::string externalDataDir;
 };
 
-mlir::DenseElementsAttr onnxTensorProtoToDenseElmAttr(
-    mlir::OpBuilder &builder, const onnx::TensorProto &initializer);
+// Create the value of a tensor. Tensors whose raw data is stored in an external
+// data file, in `externalDataDir`, are memory-mapped to create their value
+// without reading the file into memory first.
+mlir::DenseElementsAttr onnxTensorProtoToDenseElmAttr(mlir::OpBuilder &builder,
+    const onnx::TensorProto &initializer,
+    const std::string &externalDataDir = "");
 
 } // namespace onnx_mlir
@@ -14,12 +14,17 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <type_traits>
 // Using backported variant.
 // bstd = backported standard library.
 #include <mpark/variant.hpp>
 namespace bstd = mpark;
 
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
 #include "src/Interface/ResultTypeInferenceOpInterface.hpp"
 
 #include "FrontendDialectTransformer.hpp"
@@ -40,8 +45,9 @@ public:
     InitHandlerMap();
   }
 
-  mlir::ModuleOp ImportONNXModel(onnx::ModelProto model) {
-    ImportGraph(model.graph());
+  mlir::ModuleOp ImportONNXModel(const onnx::ModelProto &model,
+      const std::vector<std::string> &outputNames) {
+    ImportGraph(model.graph(), outputNames);
     return module_;
   }
 
@@ -131,7 +137,8 @@ private:
           llvm::makeArrayRef(attr.ints().begin(), attr.ints().end()));
       break;
     case onnx::AttributeProto::TENSOR:
-      mlirAttr = onnxTensorProtoToDenseElmAttr(builder_, attr.t());
+      mlirAttr = onnxTensorProtoToDenseElmAttr(
+          builder_, attr.t(), initializedTensors.GetExternalDataDir());
       break;
     case onnx::AttributeProto::STRINGS: {
       llvm::SmallVector<mlir::StringRef, 4> vectorStringRef;
@@ -484,6 +491,92 @@ private:
     buildOutputAndOperation<mlir::ONNXSliceOp>(node, in, nIn, nOut);
   }
 
+  /*!
+   * Look up the value of a tensor of the graph or of an enclosing graph, or
+   * emit the constant of its initializer.
+   */
+  mlir::Value GetTensorOrInitializer(const std::string &name) {
+    if (initializedTensors.ContainKey(legalize_name(name)))
+      return initializedTensors.EmitInitializerForInputTensor(
+          UnknownLoc(), builder_, legalize_name(name));
+    return frontend_symbols_.GetTensorByOnnxName(name);
+  }
+
+  /*!
+   * Import the nodes of a subgraph into the single block of a region, which
+   * is terminated by an ONNXIfRegionYieldOp of the outputs of the subgraph.
+   */
+  void ImportSubgraph(const onnx::GraphProto &graph, mlir::Region &region) {
+    mlir::OpBuilder::InsertionGuard guard(builder_);
+    builder_.setInsertionPointToStart(&region.emplaceBlock());
+    for (const auto &initializer : graph.initializer())
+      initializedTensors.AddMapping(
+          legalize_name(initializer.name()), initializer);
+
+    // A constant standing for the missing arguments defined in the region is
+    // not visible after it.
+    mlir::Value outerNone = none_;
+    llvm::SmallVector<const onnx::ValueInfoProto *, 4> outputs;
+    for (const auto &output : graph.output())
+      outputs.emplace_back(&output);
+    std::vector<bool> liveNodes = CollectLiveNodes(graph, outputs);
+    for (int i = 0; i < graph.node_size(); ++i)
+      if (liveNodes[i])
+        ImportNode(graph.node(i));
+    none_ = outerNone;
+
+    std::vector<mlir::Value> values;
+    for (const auto *output : outputs)
+      values.emplace_back(GetTensorOrInitializer(output->name()));
+    builder_.create<mlir::ONNXIfRegionYieldOp>(UnknownLoc(), values);
+  }
+
+  /*!
+   * Special handle for If operations, whose branches are imported into the
+   * regions of an ONNXIfRegionOp so that only the taken branch is computed.
+   */
+  void ImportNodeIf(const onnx::NodeProto &node) {
+    const onnx::GraphProto *thenBranch = nullptr, *elseBranch = nullptr;
+    for (const auto &attr : node.attribute()) {
+      if (attr.name() == "then_branch")
+        thenBranch = &attr.g();
+      else if (attr.name() == "else_branch")
+        elseBranch = &attr.g();
+    }
+    if (!thenBranch || !elseBranch ||
+        thenBranch->output_size() != node.output_size() ||
+        elseBranch->output_size() != node.output_size())
+      llvm::report_fatal_error("If node without a branch per output");
+
+    // The results have the types of the outputs of the branches when they
+    // agree, and are inferred from the branches otherwise.
+    auto importOutputType = [&](const onnx::ValueInfoProto &output) {
+      const auto &tensorType = output.type().tensor_type();
+      if (tensorType.elem_type() == onnx::TensorProto::UNDEFINED)
+        return mlir::Type();
+      if (!tensorType.has_shape())
+        return mlir::Type(mlir::UnrankedTensorType::get(
+            convertONNXTypeToMLIRType(builder_,
+                (onnx::TensorProto_DataType)tensorType.elem_type())));
+      return ImportTensorType(output);
+    };
+    std::vector<mlir::Type> outputTypes;
+    for (int i = 0; i < node.output_size(); ++i) {
+      mlir::Type thenType = importOutputType(thenBranch->output(i));
+      mlir::Type elseType = importOutputType(elseBranch->output(i));
+      if (!thenType || thenType != elseType)
+        thenType = mlir::UnrankedTensorType::get(builder_.getF32Type());
+      outputTypes.emplace_back(thenType);
+    }
+    auto ifOp = builder_.create<mlir::ONNXIfRegionOp>(
+        UnknownLoc(), outputTypes, GetTensorOrInitializer(node.input(0)));
+    ImportSubgraph(*thenBranch, ifOp.then_branch());
+    ImportSubgraph(*elseBranch, ifOp.else_branch());
+    for (int i = 0; i < node.output_size(); ++i)
+      frontend_symbols_.AddMapping(
+          legalize_name(node.output(i)), ifOp.getResult(i));
+  }
+
   void ImportCustomNode(const onnx::NodeProto &node) {
     llvm::StringRef opName = node.op_type();
 
@@ -506,6 +599,9 @@ private:
 
   void InitHandlerMap() {
 #include "src/Builder/OpBuildTable.inc"
+    // The operations of later opsets than the generated ones.
+    import_handler_map_["Einsum"] =
+        &onnx_mlir::detail::FrontendGenImpl::buildOperation<mlir::ONNXEinsumOp>;
   }
 
   /*!
@@ -538,11 +634,77 @@ private:
     ret_vals.push_back(tensor_val);
   }
 
-  void ImportGraph(
-      const onnx::GraphProto &graph, const std::string &name = "main_graph") {
+  /*!
+   * Add the names of the tensors read by the nodes of a subgraph, and of its
+   * own subgraphs, to `names`.
+   */
+  static void CollectSubgraphInputs(
+      const onnx::GraphProto &graph, std::vector<std::string> &names) {
+    for (const auto &node : graph.node()) {
+      for (const auto &input : node.input())
+        if (!input.empty())
+          names.emplace_back(input);
+      for (const auto &attr : node.attribute()) {
+        if (attr.has_g())
+          CollectSubgraphInputs(attr.g(), names);
+        for (const auto &subgraph : attr.graphs())
+          CollectSubgraphInputs(subgraph, names);
+      }
+    }
+  }
+
+  /*!
+   * Find the nodes of the graph that the outputs depend on. The other nodes
+   * are not imported, and neither are the initializers that only they use,
+   * the constants of the initializers being emitted on their first use.
+   * @param graph onnx graph.
+   * @param outputs the outputs of the graph to import.
+   * @return whether each node of the graph is imported.
+   */
+  std::vector<bool> CollectLiveNodes(const onnx::GraphProto &graph,
+      llvm::ArrayRef<const onnx::ValueInfoProto *> outputs) {
+    std::map<std::string, int> producers;
+    for (int i = 0; i < graph.node_size(); ++i)
+      for (const auto &output : graph.node(i).output())
+        if (!output.empty())
+          producers[output] = i;
+
+    std::vector<bool> liveNodes(graph.node_size(), false);
+    std::vector<std::string> worklist;
+    for (const auto *output : outputs)
+      worklist.emplace_back(output->name());
+    while (!worklist.empty()) {
+      auto producer = producers.find(worklist.back());
+      worklist.pop_back();
+      if (producer == producers.end() || liveNodes[producer->second])
+        continue;
+      liveNodes[producer->second] = true;
+      const auto &node = graph.node(producer->second);
+      for (const auto &input : node.input())
+        if (!input.empty())
+          worklist.emplace_back(input);
+      // The subgraphs of control flow operations may read the tensors of
+      // this graph.
+      for (const auto &attr : node.attribute()) {
+        if (attr.has_g())
+          CollectSubgraphInputs(attr.g(), worklist);
+        for (const auto &subgraph : attr.graphs())
+          CollectSubgraphInputs(subgraph, worklist);
+      }
+    }
+    return liveNodes;
+  }
+
+  /*!
+   * Import the graph as the main function, returning the outputs named in
+   * `selectedOutputNames`, or all the outputs of the graph when it is empty.
+   */
+  void ImportGraph(const onnx::GraphProto &graph,
+      const std::vector<std::string> &selectedOutputNames,
+      const std::string &name = "main_graph") {
     // Maintain a mapping between the parameter and its initializer.
-    for (auto initializer : graph.initializer()) {
-      auto name = initializer.name();
+    for (const auto &initializer : graph.initializer()) {
+      const auto &name = initializer.name();
       initializedTensors.AddMapping(legalize_name(name), initializer);
     }
 
@@ -569,8 +731,25 @@ private:
       }
     }
 
-    for (const auto &output : graph.output()) {
-      outputNames.push_back(output.name());
+    // Select the outputs to import.
+    llvm::SmallVector<const onnx::ValueInfoProto *, 4> outputs;
+    if (selectedOutputNames.empty()) {
+      for (const auto &output : graph.output())
+        outputs.emplace_back(&output);
+    } else {
+      for (const auto &selectedName : selectedOutputNames) {
+        auto output = std::find_if(graph.output().begin(),
+            graph.output().end(), [&](const onnx::ValueInfoProto &output) {
+              return output.name() == selectedName;
+            });
+        if (output == graph.output().end())
+          llvm::report_fatal_error(llvm::Twine("output ") + selectedName +
+                                   " not found in the model");
+        outputs.emplace_back(&*output);
+      }
+    }
+    for (const auto *output : outputs) {
+      outputNames.push_back(output->name());
     }
 
     funcAttrs.emplace_back(builder_.getNamedAttr(
@@ -587,7 +766,7 @@ private:
     // inputs and outputs.
     auto entryPoint = mlir::ONNXEntryPointOp::create(UnknownLoc(), mainFunc,
         /*numInputs=*/numInputs,
-        /*numOutputs=*/graph.output().size());
+        /*numOutputs=*/outputs.size());
 
     // Get the entru block inside the main function and set the insertion point
     // to it.
@@ -610,16 +789,18 @@ private:
       }
     }
 
-    // Import nodes in the graph.
-    for (const auto &item : graph.node()) {
-      ImportNode(item);
+    // Import the nodes in the graph that the outputs depend on.
+    std::vector<bool> liveNodes = CollectLiveNodes(graph, outputs);
+    for (int i = 0; i < graph.node_size(); ++i) {
+      if (liveNodes[i])
+        ImportNode(graph.node(i));
     }
 
     llvm::SmallVector<mlir::Type, 4> ret_types;
     llvm::SmallVector<mlir::Value, 4> ret_vals;
     // Import the output tensors
-    for (const auto &output : graph.output()) {
-      ImportOutputTensor(output, ret_types, ret_vals);
+    for (const auto *output : outputs) {
+      ImportOutputTensor(*output, ret_types, ret_vals);
     }
 
     // Create a return operation to return all ONNX output tensors.
@@ -636,14 +817,22 @@ private:
 namespace onnx_mlir {
 
 void ImportFrontendModelFile(std::string model_fname,
-    mlir::MLIRContext &context, mlir::OwningModuleRef &module) {
+    mlir::MLIRContext &context, mlir::OwningModuleRef &module,
+    const std::vector<std::string> &outputNames) {
   onnx::ModelProto model;
-  std::fstream input(model_fname, std::ios::in | std::ios::binary);
-
-  auto parse_success = model.ParseFromIstream(&input);
+  // Parse the model from its memory-mapped file. The weights of large models
+  // are rather stored in external data files, which are memory-mapped later,
+  // each at the creation of the value of its tensor.
+  auto buffer = llvm::MemoryBuffer::getFile(model_fname);
+  assert(buffer && "Onnx Model File Reading Failed.");
+  auto parse_success = model.ParseFromArray(
+      (*buffer)->getBufferStart(), (*buffer)->getBufferSize());
   assert(parse_success && "Onnx Model Parsing Failed.");
+  buffer->reset();
+  detail::initializedTensors.SetExternalDataDir(
+      llvm::sys::path::parent_path(model_fname).str());
 
   detail::FrontendGenImpl myONNXGen(context);
-  module = myONNXGen.ImportONNXModel(model);
+  module = myONNXGen.ImportONNXModel(model, outputNames);
 }
 } // namespace onnx_mlir
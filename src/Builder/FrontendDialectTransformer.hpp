@@ -33,10 +33,13 @@ namespace onnx_mlir {
 /*!
  *  Import an ONNX model file into the ONNX Dialect.
  *  @param model_fname file name pointing to the onnx model protobuf.
+ *  @param outputNames names of the outputs of the model to import, all of
+ *  them when empty. Only the nodes these outputs depend on are imported.
  *  @return MLIR::module generated for the ONNX model.
  */
 void ImportFrontendModelFile(std::string model_fname,
-    mlir::MLIRContext &context, mlir::OwningModuleRef &module);
+    mlir::MLIRContext &context, mlir::OwningModuleRef &module,
+    const std::vector<std::string> &outputNames = {});
 
 /*!
  *  TODO: Import models into other extension dialects that cover the
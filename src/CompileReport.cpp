@@ -0,0 +1,134 @@
+//===------------------------- CompileReport.cpp --------------------------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Pass instrumentation recording the compile time and IR size statistics of
+// each pass, and writing them into a JSON report.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include "mlir/IR/Operation.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/CompileReport.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+// Must be included after windows.h.
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace mlir;
+using namespace onnx_mlir;
+
+namespace {
+
+// Return the peak resident set size of the process in kilobytes.
+int64_t getPeakRSSKb() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize / 1024;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  // Reported in bytes on macOS, and in kilobytes elsewhere.
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+int64_t countOperations(Operation *op) {
+  int64_t count = 0;
+  op->walk([&](Operation *) { ++count; });
+  return count;
+}
+
+} // namespace
+
+void CompileReport::runBeforePass(Pass *pass, Operation *op) {
+  // Count before taking the lock, the operation is not shared with other
+  // threads.
+  PassRun run = {Clock::now(), countOperations(op)};
+  std::lock_guard<std::mutex> lock(mutex);
+  runningPasses[{pass, op}] = run;
+}
+
+void CompileReport::runAfterPass(Pass *pass, Operation *op) {
+  recordRun(pass, op);
+}
+
+void CompileReport::runAfterPassFailed(Pass *pass, Operation *op) {
+  recordRun(pass, op);
+}
+
+void CompileReport::recordRun(Pass *pass, Operation *op) {
+  Clock::time_point end = Clock::now();
+  int64_t opsAfter = countOperations(op);
+  int64_t peakRSSKb = getPeakRSSKb();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto runIt = runningPasses.find({pass, op});
+  if (runIt == runningPasses.end())
+    return;
+  PassRun run = runIt->second;
+  runningPasses.erase(runIt);
+
+  auto indexIt = statisticsIndices.find(pass);
+  if (indexIt == statisticsIndices.end()) {
+    indexIt = statisticsIndices.insert({pass, statistics.size()}).first;
+    statistics.emplace_back();
+    statistics.back().name = pass->getName().str();
+  }
+  PassStatistics &passStatistics = statistics[indexIt->second];
+  passStatistics.runs += 1;
+  passStatistics.wallTimeMs +=
+      std::chrono::duration<double, std::milli>(end - run.start).count();
+  passStatistics.peakRSSKb = std::max(passStatistics.peakRSSKb, peakRSSKb);
+  passStatistics.opsBefore += run.opsBefore;
+  passStatistics.opsAfter += opsAfter;
+}
+
+bool CompileReport::write() const {
+  std::error_code error;
+  llvm::raw_fd_ostream os(filename, error, llvm::sys::fs::OF_Text);
+  if (error) {
+    llvm::errs() << "cannot open compile report " << filename << ": "
+                 << error.message() << "\n";
+    return false;
+  }
+
+  double totalWallTimeMs =
+      std::chrono::duration<double, std::milli>(Clock::now() - creationTime)
+          .count();
+  llvm::json::OStream json(os, /*IndentSize=*/2);
+  json.object([&] {
+    json.attribute("total_wall_time_ms", totalWallTimeMs);
+    json.attribute("peak_rss_kb", getPeakRSSKb());
+    json.attributeArray("passes", [&] {
+      for (const PassStatistics &passStatistics : statistics)
+        json.object([&] {
+          json.attribute("pass", passStatistics.name);
+          json.attribute("runs", passStatistics.runs);
+          json.attribute("wall_time_ms", passStatistics.wallTimeMs);
+          json.attribute("peak_rss_kb", passStatistics.peakRSSKb);
+          json.attribute("ops_before", passStatistics.opsBefore);
+          json.attribute("ops_after", passStatistics.opsAfter);
+        });
+    });
+  });
+  os << "\n";
+  return true;
+}
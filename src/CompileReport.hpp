@@ -0,0 +1,74 @@
+//===------------------------- CompileReport.hpp --------------------------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Pass instrumentation recording the compile time and IR size statistics of
+// each pass, and writing them into a JSON report.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "mlir/Pass/PassInstrumentation.h"
+
+namespace onnx_mlir {
+
+// Records, for each pass run by a pass manager:
+//   - the wall time spent in the pass, summed over all of its runs (a
+//     function pass runs once per function),
+//   - the peak resident set size of the process after the pass,
+//   - the number of operations of the IR the pass runs on, before and after
+//     the pass, summed over all of its runs.
+// Passes are reported in the order of their first run. The pass adaptors
+// running nested pipelines on the functions of a module are reported as well,
+// and account for the whole nested pipeline.
+class CompileReport : public mlir::PassInstrumentation {
+public:
+  explicit CompileReport(std::string filename) : filename(filename) {}
+
+  void runBeforePass(mlir::Pass *pass, mlir::Operation *op) override;
+  void runAfterPass(mlir::Pass *pass, mlir::Operation *op) override;
+  void runAfterPassFailed(mlir::Pass *pass, mlir::Operation *op) override;
+
+  // Write the report into its file. Return false on failure.
+  bool write() const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct PassStatistics {
+    std::string name;
+    int64_t runs = 0;
+    double wallTimeMs = 0;
+    int64_t peakRSSKb = 0;
+    int64_t opsBefore = 0;
+    int64_t opsAfter = 0;
+  };
+
+  struct PassRun {
+    Clock::time_point start;
+    int64_t opsBefore;
+  };
+
+  void recordRun(mlir::Pass *pass, mlir::Operation *op);
+
+  std::string filename;
+  Clock::time_point creationTime = Clock::now();
+
+  // Function passes run on several threads.
+  std::mutex mutex;
+  std::vector<PassStatistics> statistics;
+  llvm::DenseMap<mlir::Pass *, size_t> statisticsIndices;
+  llvm::DenseMap<std::pair<mlir::Pass *, mlir::Operation *>, PassRun>
+      runningPasses;
+};
+
+} // namespace onnx_mlir
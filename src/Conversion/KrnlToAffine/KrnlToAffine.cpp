@@ -8,7 +8,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Analysis/Utils.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Affine/Utils.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
@@ -121,14 +123,15 @@ struct ConvertKrnlToAffinePass
 
 LogicalResult interpretOperation(Operation *op, OpBuilder &builder,
     llvm::SmallDenseMap<Value, AffineForOp, 4> &loopRefToOp,
-    llvm::SmallPtrSetImpl<Operation *> &opsToErase) {
+    llvm::SmallPtrSetImpl<Operation *> &opsToErase,
+    SmallVectorImpl<AffineForOp> &loopsToParallelize) {
   // Recursively interpret nested operations.
   for (auto &region : op->getRegions())
     for (auto &block : region.getBlocks()) {
       auto &blockOps = block.getOperations();
       for (auto itr = blockOps.begin(); itr != blockOps.end();)
-        if (failed(interpretOperation(
-                &(*itr), builder, loopRefToOp, opsToErase))) {
+        if (failed(interpretOperation(&(*itr), builder, loopRefToOp,
+                opsToErase, loopsToParallelize))) {
           return failure();
         } else {
           ++itr;
@@ -204,6 +207,14 @@ LogicalResult interpretOperation(Operation *op, OpBuilder &builder,
     auto loopRef = unrollOp.loop();
     loopUnrollFull(loopRefToOp[loopRef]);
 
+    opsToErase.insert(op);
+    return success();
+  } else if (auto parallelOp = dyn_cast_or_null<KrnlParallelOp>(op)) {
+    // Record the affine for loop, it is parallelized once the krnl terminators
+    // of its body have been lowered, since dependence analysis does not know
+    // about krnl operations.
+    loopsToParallelize.emplace_back(loopRefToOp[parallelOp.loop()]);
+
     opsToErase.insert(op);
     return success();
   }
@@ -222,7 +233,9 @@ void ConvertKrnlToAffinePass::runOnFunction() {
   // after iteration completes.
   llvm::SmallDenseMap<Value, AffineForOp, 4> loopRefToOp;
   llvm::SmallPtrSet<Operation *, 4> opsToErase;
-  if (failed(interpretOperation(funcOp, builder, loopRefToOp, opsToErase))) {
+  SmallVector<AffineForOp, 4> loopsToParallelize;
+  if (failed(interpretOperation(
+          funcOp, builder, loopRefToOp, opsToErase, loopsToParallelize))) {
     signalPassFailure();
     return;
   }
@@ -240,8 +253,16 @@ void ConvertKrnlToAffinePass::runOnFunction() {
   patterns.insert<KrnlTerminatorLowering>(&getContext());
   DenseSet<Operation *> unconverted;
   if (failed(applyPartialConversion(
-          getFunction(), target, patterns, &unconverted)))
+          getFunction(), target, patterns, &unconverted))) {
     signalPassFailure();
+    return;
+  }
+
+  // Convert the loops marked by krnl.parallel into affine.parallel operations.
+  // Loops carrying a dependence are left as sequential loops.
+  for (auto forOp : loopsToParallelize)
+    if (isLoopParallel(forOp))
+      affineParallelize(forOp);
 }
 } // namespace
 
@@ -17,16 +17,23 @@
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/SCF/SCF.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Matchers.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Target/LLVMIR/ModuleTranslation.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "onnx/onnx_pb.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/Sequence.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 #include "src/Conversion/KrnlToLLVM/KrnlToLLVM.hpp"
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 #include "src/Dialect/Krnl/KrnlOps.hpp"
 #include "src/Pass/Passes.hpp"
+#include <limits>
+#include <type_traits>
 
 using namespace mlir;
 
@@ -53,6 +60,8 @@ static onnx::TensorProto::DataType llvmTypeToOnnxType(
     return onnx::TensorProto::BOOL;
   if (elemType.isHalfTy())
     return onnx::TensorProto::FLOAT16;
+  if (elemType.isBFloatTy())
+    return onnx::TensorProto::BFLOAT16;
   if (elemType.isDoubleTy())
     return onnx::TensorProto::DOUBLE;
   if (elemType.isUnsignedInteger(32))
@@ -151,6 +160,30 @@ static FlatSymbolRefAttr getOrInsertMalloc(
   return SymbolRefAttr::get("malloc", ctx);
 }
 
+/// Set the sizes and the strides of a MemRef descriptor to those of a
+/// contiguous row-major MemRef of the given type. The sizes of the dynamic
+/// dimensions are given in order.
+static void setContiguousSizesAndStrides(ConversionPatternRewriter &rewriter,
+    Location loc, LLVM::LLVMType llvmIndexType, MemRefType memRefTy,
+    ValueRange dynamicSizes, MemRefDescriptor &llvmMemRef) {
+  auto memRefShape = memRefTy.getShape();
+  int64_t dynDimIdx = dynamicSizes.size();
+  Value stride = rewriter.create<LLVM::ConstantOp>(
+      loc, llvmIndexType, rewriter.getIndexAttr(1));
+  for (int64_t i = memRefShape.size() - 1; i >= 0; --i) {
+    Value size;
+    if (memRefShape[i] < 0)
+      size = dynamicSizes[--dynDimIdx];
+    else
+      size = rewriter.create<LLVM::ConstantOp>(
+          loc, llvmIndexType, rewriter.getIndexAttr(memRefShape[i]));
+    llvmMemRef.setSize(rewriter, loc, i, size);
+    llvmMemRef.setStride(rewriter, loc, i, stride);
+    if (i > 0)
+      stride = rewriter.create<LLVM::MulOp>(loc, stride, size);
+  }
+}
+
 //===----------------------------------------------------------------------===//
 // KRNL to LLVM: KrnlGetRefOpLowering
 //===----------------------------------------------------------------------===//
@@ -200,8 +233,25 @@ public:
         loc, llvmOutputElementType.getPointerTo(), outputMemPoolTypePtrAlloc);
 
     // Create llvm MemRef from original MemRef and fill the data pointers.
-    auto llvmMemRef = MemRefDescriptor::fromStaticShape(
-        rewriter, loc, typeConverter, memRefTy, outputTypedPtrAlloc);
+    if (memRefTy.hasStaticShape()) {
+      auto llvmMemRef = MemRefDescriptor::fromStaticShape(
+          rewriter, loc, typeConverter, memRefTy, outputTypedPtrAlloc);
+      rewriter.replaceOp(op, {llvmMemRef});
+      return success();
+    }
+
+    // The sizes of the dynamic dimensions are the trailing operands of the
+    // krnl.getref. The strides are those of a contiguous row-major MemRef.
+    auto dynamicSizes = operandAdaptor.value();
+    if (dynamicSizes.size() != memRefTy.getNumDynamicDims())
+      return failure();
+
+    auto llvmMemRef = MemRefDescriptor::undef(rewriter, loc, llvmMemRefType);
+    llvmMemRef.setAllocatedPtr(rewriter, loc, outputTypedPtrAlloc);
+    llvmMemRef.setAlignedPtr(rewriter, loc, outputTypedPtrAlloc);
+    llvmMemRef.setConstantOffset(rewriter, loc, 0);
+    setContiguousSizesAndStrides(rewriter, loc, typeConverter.getIndexType(),
+        memRefTy, dynamicSizes, llvmMemRef);
 
     rewriter.replaceOp(op, {llvmMemRef});
     return success();
@@ -213,16 +263,218 @@ private:
   }
 };
 
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: KrnlReshapeOpLowering
+//===----------------------------------------------------------------------===//
+
+class KrnlReshapeOpLowering : public ConvertToLLVMPattern {
+public:
+  explicit KrnlReshapeOpLowering(
+      MLIRContext *context, LLVMTypeConverter &lowering_)
+      : ConvertToLLVMPattern(
+            KrnlReshapeOp::getOperationName(), context, lowering_) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const override {
+    auto loc = op->getLoc();
+    KrnlReshapeOpAdaptor operandAdaptor(operands);
+
+    auto memRefTy = op->getResult(0).getType().cast<MemRefType>();
+    auto llvmMemRefType =
+        typeConverter.convertType(memRefTy).cast<LLVM::LLVMType>();
+    auto dynamicSizes = operandAdaptor.sizes();
+    if (dynamicSizes.size() != memRefTy.getNumDynamicDims())
+      return failure();
+
+    // The output MemRef uses the buffer of the input MemRef. The offset of
+    // MemRefs with the identity layout is always zero, so the offset of the
+    // krnl.reshape is applied to the aligned pointer.
+    MemRefDescriptor srcMemRef(operandAdaptor.src());
+    Value alignedPtr = srcMemRef.alignedPtr(rewriter, loc);
+    int64_t viewOffset = cast<KrnlReshapeOp>(op).offset();
+    if (viewOffset != 0) {
+      Value offset = rewriter.create<LLVM::ConstantOp>(loc,
+          typeConverter.getIndexType(), rewriter.getIndexAttr(viewOffset));
+      alignedPtr = rewriter.create<LLVM::GEPOp>(
+          loc, alignedPtr.getType(), alignedPtr, ArrayRef<Value>({offset}));
+    }
+    auto llvmMemRef = MemRefDescriptor::undef(rewriter, loc, llvmMemRefType);
+    llvmMemRef.setAllocatedPtr(
+        rewriter, loc, srcMemRef.allocatedPtr(rewriter, loc));
+    llvmMemRef.setAlignedPtr(rewriter, loc, alignedPtr);
+    llvmMemRef.setConstantOffset(rewriter, loc, 0);
+    setContiguousSizesAndStrides(rewriter, loc, typeConverter.getIndexType(),
+        memRefTy, dynamicSizes, llvmMemRef);
+
+    rewriter.replaceOp(op, {llvmMemRef});
+    return success();
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: KrnlArenaAllocOpLowering
+//===----------------------------------------------------------------------===//
+
+class KrnlArenaAllocOpLowering : public ConvertToLLVMPattern {
+public:
+  explicit KrnlArenaAllocOpLowering(
+      MLIRContext *context, LLVMTypeConverter &lowering_)
+      : ConvertToLLVMPattern(
+            KrnlArenaAllocOp::getOperationName(), context, lowering_) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const override {
+    auto *context = op->getContext();
+    auto loc = op->getLoc();
+    ModuleOp module = op->getParentOfType<ModuleOp>();
+    auto arenaAllocOp = llvm::dyn_cast<KrnlArenaAllocOp>(op);
+    KrnlArenaAllocOpAdaptor operandAdaptor(operands);
+
+    auto memRefTy = op->getResult(0).getType().cast<mlir::MemRefType>();
+    auto llvmMemRefType =
+        typeConverter.convertType(memRefTy).cast<LLVM::LLVMType>();
+    auto llvmI8PtrTy = LLVM::LLVMType::getInt8PtrTy(context);
+    auto llvmI64Ty = LLVM::LLVMType::getInt64Ty(context);
+
+    // The memory pool is a rank 1 MemRef of bytes, its size is either static
+    // or given by the only operand.
+    Value size;
+    if (memRefTy.hasStaticShape())
+      size = rewriter.create<LLVM::ConstantOp>(
+          loc, llvmI64Ty, rewriter.getI64IntegerAttr(memRefTy.getShape()[0]));
+    else
+      size = operandAdaptor.size()[0];
+
+    // Call the runtime to get the memory of the slot.
+    auto arenaGetRef =
+        getOrInsertExternFunc(KrnlArenaAllocOp::getArenaGetFuncName(), module,
+            LLVM::LLVMType::getFunctionTy(
+                llvmI8PtrTy, {llvmI64Ty, llvmI64Ty}, /*isVarArg=*/false),
+            rewriter);
+    auto slot = rewriter.create<LLVM::ConstantOp>(
+        loc, llvmI64Ty, arenaAllocOp.slotAttr());
+    Value memPoolPtr = rewriter
+                           .create<LLVM::CallOp>(loc, llvmI8PtrTy, arenaGetRef,
+                               ArrayRef<Value>({slot, size}))
+                           .getResult(0);
+
+    // Create the MemRef of the memory pool.
+    Value llvmMemRef;
+    if (memRefTy.hasStaticShape()) {
+      llvmMemRef = MemRefDescriptor::fromStaticShape(
+          rewriter, loc, typeConverter, memRefTy, memPoolPtr);
+    } else {
+      auto descriptor = MemRefDescriptor::undef(rewriter, loc, llvmMemRefType);
+      descriptor.setAllocatedPtr(rewriter, loc, memPoolPtr);
+      descriptor.setAlignedPtr(rewriter, loc, memPoolPtr);
+      descriptor.setConstantOffset(rewriter, loc, 0);
+      descriptor.setSize(rewriter, loc, 0, size);
+      descriptor.setConstantStride(rewriter, loc, 0, 1);
+      llvmMemRef = descriptor;
+    }
+
+    rewriter.replaceOp(op, {llvmMemRef});
+    return success();
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: KrnlInstrumentOpLowering
+//===----------------------------------------------------------------------===//
+
+class KrnlInstrumentOpLowering : public ConversionPattern {
+public:
+  explicit KrnlInstrumentOpLowering(MLIRContext *context)
+      : ConversionPattern(KrnlInstrumentOp::getOperationName(), 1, context) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const override {
+    auto *context = op->getContext();
+    auto loc = op->getLoc();
+    ModuleOp module = op->getParentOfType<ModuleOp>();
+    auto instrumentOp = llvm::cast<KrnlInstrumentOp>(op);
+
+    auto llvmVoidTy = LLVM::LLVMType::getVoidTy(context);
+    auto llvmI8PtrTy = LLVM::LLVMType::getInt8PtrTy(context);
+    auto llvmI64Ty = LLVM::LLVMType::getInt64Ty(context);
+
+    // The runtime keeps the pointers to the strings describing the operation,
+    // which live as long as the shared library.
+    Value opName =
+        getOrCreateGlobalString(instrumentOp.opName(), loc, module, rewriter);
+    Value nodeName =
+        getOrCreateGlobalString(instrumentOp.nodeName(), loc, module, rewriter);
+    Value shapes =
+        getOrCreateGlobalString(instrumentOp.shapes(), loc, module, rewriter);
+    Value tag = rewriter.create<LLVM::ConstantOp>(
+        loc, llvmI64Ty, instrumentOp.tagAttr());
+
+    auto instrumentRef =
+        getOrInsertExternFunc(KrnlInstrumentOp::getInstrumentFuncName(),
+            module,
+            LLVM::LLVMType::getFunctionTy(llvmVoidTy,
+                {llvmI8PtrTy, llvmI8PtrTy, llvmI8PtrTy, llvmI64Ty},
+                /*isVarArg=*/false),
+            rewriter);
+    rewriter.create<LLVM::CallOp>(loc, ArrayRef<Type>({}), instrumentRef,
+        ArrayRef<Value>({opName, nodeName, shapes, tag}));
+
+    rewriter.eraseOp(op);
+    return success();
+  }
+
+private:
+  /// Return a pointer to a null-terminated global copy of a string, which is
+  /// shared by all the operations referring to the same string.
+  static Value getOrCreateGlobalString(StringRef value, Location loc,
+      ModuleOp module, ConversionPatternRewriter &rewriter) {
+    auto *context = module.getContext();
+    std::string data = (value + llvm::Twine('\0')).str();
+
+    // Globals are named after the hash of their content, colliding strings
+    // get a distinct suffix.
+    std::string baseName =
+        "om_instrument_str_" + llvm::utohexstr(llvm::hash_value(value));
+    std::string name = baseName;
+    LLVM::GlobalOp global;
+    for (int suffix = 0;; ++suffix) {
+      global = module.lookupSymbol<LLVM::GlobalOp>(name);
+      if (!global)
+        break;
+      auto globalValue = global.valueAttr().dyn_cast_or_null<StringAttr>();
+      if (globalValue && globalValue.getValue() == data)
+        break;
+      name = baseName + "_" + std::to_string(suffix);
+    }
+    if (!global) {
+      OpBuilder::InsertionGuard insertGuard(rewriter);
+      rewriter.setInsertionPointToStart(module.getBody());
+      auto type = LLVM::LLVMType::getArrayTy(
+          LLVM::LLVMType::getInt8Ty(context), data.size());
+      global = rewriter.create<LLVM::GlobalOp>(loc, type, /*isConstant=*/true,
+          LLVM::Linkage::Internal, name, rewriter.getStringAttr(data));
+    }
+
+    Value globalPtr = rewriter.create<LLVM::AddressOfOp>(loc, global);
+    Value zero = rewriter.create<LLVM::ConstantOp>(loc,
+        LLVM::LLVMType::getInt64Ty(context), rewriter.getI64IntegerAttr(0));
+    return rewriter.create<LLVM::GEPOp>(loc,
+        LLVM::LLVMType::getInt8PtrTy(context), globalPtr,
+        ArrayRef<Value>({zero, zero}));
+  }
+};
+
 //===----------------------------------------------------------------------===//
 // KRNL to LLVM: KrnlGlobalOpLowering
 //===----------------------------------------------------------------------===//
 
 class KrnlGlobalOpLowering : public ConvertToLLVMPattern {
 public:
-  explicit KrnlGlobalOpLowering(
-      MLIRContext *context, LLVMTypeConverter &lowering_)
+  explicit KrnlGlobalOpLowering(MLIRContext *context,
+      LLVMTypeConverter &lowering_, bool lazyConstants = false)
       : ConvertToLLVMPattern(
-            KrnlGlobalOp::getOperationName(), context, lowering_) {}
+            KrnlGlobalOp::getOperationName(), context, lowering_),
+        lazyConstants(lazyConstants) {}
 
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const override {
@@ -310,6 +562,44 @@ public:
       auto memcpyRef = getOrInsertMemcpy(rewriter, module);
       rewriter.create<CallOp>(loc, memcpyRef, ArrayRef<Type>({}),
           ArrayRef<Value>({int8PtrAlloc, i8PtrGlobal, int64Size, isVolatile}));
+    } else if (lazyConstants) {
+      // Some frequently used types.
+      auto llvmI8PtrTy = LLVM::LLVMType::getInt8PtrTy(context);
+      auto llvmI64Ty = LLVM::LLVMType::getInt64Ty(context);
+
+      // Each packed constant has its own storage, pointed to by a global
+      // initialized to null. The runtime materializes the constant from the
+      // constant pack on its first use, under a thread-safe guard.
+      LLVM::GlobalOp storage;
+      {
+        OpBuilder::InsertionGuard insertGuard(rewriter);
+        rewriter.setInsertionPointToStart(module.getBody());
+
+        storage = rewriter.create<LLVM::GlobalOp>(loc, llvmI8PtrTy,
+            /*isConstant=*/false, LLVM::Linkage::Internal,
+            (Twine(name) + "_storage").str(), nullptr);
+        rewriter.createBlock(&storage.getInitializerRegion());
+        Value null = rewriter.create<LLVM::NullOp>(loc, llvmI8PtrTy);
+        rewriter.create<LLVM::ReturnOp>(loc, null);
+      }
+
+      Value storageAddr = rewriter.create<LLVM::AddressOfOp>(loc, storage);
+      auto offset = rewriter.create<LLVM::ConstantOp>(loc, llvmI64Ty,
+          rewriter.getI64IntegerAttr(
+              krnlGlobalOp.offsetAttr().getValue().getSExtValue()));
+      auto size = rewriter.create<LLVM::ConstantOp>(loc, llvmI64Ty,
+          rewriter.getI64IntegerAttr(
+              getMemRefEltSizeInBytes(memRefTy) * numElements));
+      auto getLazyEmbeddedConstRef = getOrInsertExternFunc(
+          KrnlPackedConstantOp::getLazyEmbeddedDataLoaderMethodName(), module,
+          LLVM::LLVMType::getFunctionTy(llvmI8PtrTy,
+              {llvmI8PtrTy.getPointerTo(), llvmI64Ty, llvmI64Ty},
+              /*isVarArg=*/false),
+          rewriter);
+      alloc = rewriter
+                  .create<CallOp>(loc, getLazyEmbeddedConstRef, llvmI8PtrTy,
+                      ArrayRef<Value>({storageAddr, offset, size}))
+                  .getResult(0);
     } else {
       // Some frequently used types.
       auto llvmI8PtrTy = LLVM::LLVMType::getInt8PtrTy(context);
@@ -347,19 +637,116 @@ public:
   }
 
 private:
+  // Whether packed constants are materialized on their first use.
+  bool lazyConstants;
+
+  // Return the FNV-1a hash of the packed constants, held by the operation or
+  // in its file, or 0 if they cannot be read.
+  static int64_t hashConstPack(KrnlPackedConstantOp packedConstOp) {
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    ArrayRef<char> data;
+    if (auto valueAttr = packedConstOp.valueAttr()) {
+      data = valueAttr.cast<DenseElementsAttr>().getRawData();
+    } else if (auto fileNameAttr = packedConstOp.file_nameAttr()) {
+      auto fileOrError = llvm::MemoryBuffer::getFile(fileNameAttr.getValue());
+      if (!fileOrError)
+        return 0;
+      buffer = std::move(*fileOrError);
+      data = llvm::makeArrayRef(
+          buffer->getBufferStart(), buffer->getBufferSize());
+    }
+    uint64_t hash = 14695981039346656037ULL;
+    for (char byte : data) {
+      hash ^= (uint8_t)byte;
+      hash *= 1099511628211ULL;
+    }
+    return (int64_t)hash;
+  }
+
   static int64_t ArrayAttrIntVal(ArrayAttr a, int i) {
     return (a.getValue()[i]).cast<IntegerAttr>().getInt();
   }
 };
 
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: NarrowIndexAccessLowering
+//===----------------------------------------------------------------------===//
+
+/// Test if the linearized indices of the elements of a MemRef type fit in 32
+/// bits, i.e. if the MemRef is statically shaped, contiguous and has fewer
+/// than 2^31 elements.
+static bool hasNarrowIndices(MemRefType memRefType) {
+  return memRefType.hasStaticShape() && memRefType.getAffineMaps().empty() &&
+         memRefType.getRank() > 0 &&
+         memRefType.getNumElements() <= std::numeric_limits<int32_t>::max();
+}
+
+/// Lower the loads and stores of MemRefs with narrow indices, computing the
+/// linearized index of the element in 32 bits before extending it to the
+/// index type. The index cannot overflow for an access within the bounds of
+/// the MemRef, and the vectorizer then gathers and scatters with vectors of
+/// 32-bit offsets, which hold twice as many lanes.
+template <typename OP>
+class NarrowIndexAccessLowering : public ConvertToLLVMPattern {
+public:
+  explicit NarrowIndexAccessLowering(
+      MLIRContext *context, LLVMTypeConverter &lowering_)
+      : ConvertToLLVMPattern(OP::getOperationName(), context, lowering_,
+            /*benefit=*/2) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const override {
+    auto accessOp = llvm::cast<OP>(op);
+    auto loc = op->getLoc();
+    auto memRefType = accessOp.getMemRefType();
+    if (!hasNarrowIndices(memRefType))
+      return failure();
+
+    // The operands of a load are the MemRef and the indices, those of a
+    // store are the stored value, the MemRef and the indices.
+    unsigned memRefIdx = std::is_same<OP, StoreOp>::value ? 1 : 0;
+    MemRefDescriptor memRef(operands[memRefIdx]);
+    auto indices = operands.drop_front(memRefIdx + 1);
+
+    auto int32Ty = LLVM::LLVMType::getInt32Ty(op->getContext());
+    auto shape = memRefType.getShape();
+    Value linearIndex;
+    int64_t stride = 1;
+    for (int64_t i = shape.size() - 1; i >= 0; --i) {
+      Value index = rewriter.create<LLVM::TruncOp>(loc, int32Ty, indices[i]);
+      if (stride != 1)
+        index = rewriter.create<LLVM::MulOp>(loc, index,
+            rewriter.create<LLVM::ConstantOp>(
+                loc, int32Ty, rewriter.getI32IntegerAttr(stride)));
+      linearIndex = linearIndex
+                        ? rewriter.create<LLVM::AddOp>(loc, linearIndex, index)
+                        : index;
+      stride *= shape[i];
+    }
+    linearIndex = rewriter.create<LLVM::SExtOp>(
+        loc, typeConverter.getIndexType(), linearIndex);
+
+    Value alignedPtr = memRef.alignedPtr(rewriter, loc);
+    Value elementPtr = rewriter.create<LLVM::GEPOp>(
+        loc, alignedPtr.getType(), alignedPtr, ArrayRef<Value>({linearIndex}));
+    if (std::is_same<OP, StoreOp>::value)
+      rewriter.replaceOpWithNewOp<LLVM::StoreOp>(op, operands[0], elementPtr);
+    else
+      rewriter.replaceOpWithNewOp<LLVM::LoadOp>(op, elementPtr);
+    return success();
+  }
+};
+
 //===----------------------------------------------------------------------===//
 // KRNL to LLVM: KrnlMemcpyOpLowering
 //===----------------------------------------------------------------------===//
 
 class KrnlMemcpyOpLowering : public ConversionPattern {
 public:
-  explicit KrnlMemcpyOpLowering(MLIRContext *context)
-      : ConversionPattern(KrnlMemcpyOp::getOperationName(), 1, context) {}
+  explicit KrnlMemcpyOpLowering(
+      MLIRContext *context, int64_t parallelMemcpyThreshold = 0)
+      : ConversionPattern(KrnlMemcpyOp::getOperationName(), 1, context),
+        parallelMemcpyThreshold(parallelMemcpyThreshold) {}
 
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const override {
@@ -378,6 +765,10 @@ public:
                        .getStructElementType(1);
     Value alignedDstMemory = rewriter.create<LLVM::ExtractValueOp>(
         loc, dstType, operandAdaptor.dest(), rewriter.getI64ArrayAttr(1));
+    auto offsets = operandAdaptor.offsets();
+    if (!offsets.empty())
+      alignedDstMemory = rewriter.create<LLVM::GEPOp>(
+          loc, dstType, alignedDstMemory, ArrayRef<Value>({offsets[0]}));
     Value alignedInt8PtrDstMemory = rewriter.create<LLVM::BitcastOp>(
         loc, LLVM::LLVMType::getInt8PtrTy(context), alignedDstMemory);
 
@@ -388,6 +779,9 @@ public:
                        .getStructElementType(1);
     Value alignedSrcMemory = rewriter.create<LLVM::ExtractValueOp>(
         loc, srcType, operandAdaptor.src(), rewriter.getI64ArrayAttr(1));
+    if (!offsets.empty())
+      alignedSrcMemory = rewriter.create<LLVM::GEPOp>(
+          loc, srcType, alignedSrcMemory, ArrayRef<Value>({offsets[1]}));
     Value alignedInt8PtrSrcMemory = rewriter.create<LLVM::BitcastOp>(
         loc, LLVM::LLVMType::getInt8PtrTy(context), alignedSrcMemory);
 
@@ -395,6 +789,56 @@ public:
     Value int64Size = rewriter.create<LLVM::SExtOp>(
         loc, LLVM::LLVMType::getInt64Ty(context), operandAdaptor.size());
 
+    auto memcpyOp = llvm::cast<KrnlMemcpyOp>(op);
+    auto llvmI8PtrTy = LLVM::LLVMType::getInt8PtrTy(context);
+    auto llvmI64Ty = LLVM::LLVMType::getInt64Ty(context);
+    auto llvmI32Ty = LLVM::LLVMType::getInt32Ty(context);
+
+    // Copies which may reach the threshold are split by the runtime across
+    // its threads, as a single thread does not saturate the memory bandwidth.
+    // The runtime compares the sizes unknown at compile time to the
+    // threshold.
+    APInt constSize;
+    bool isParallel =
+        parallelMemcpyThreshold > 0 &&
+        (!matchPattern(memcpyOp.size(), m_ConstantInt(&constSize)) ||
+            constSize.getSExtValue() >= parallelMemcpyThreshold);
+    if (isParallel) {
+      auto memcpyParallelRef = getOrInsertExternFunc(
+          KrnlMemcpyOp::getParallelMemcpyFuncName(), parentModule,
+          LLVM::LLVMType::getFunctionTy(LLVM::LLVMType::getVoidTy(context),
+              {llvmI8PtrTy, llvmI8PtrTy, llvmI64Ty, llvmI64Ty, llvmI32Ty},
+              /*isVarArg=*/false),
+          rewriter);
+      Value threshold = rewriter.create<LLVM::ConstantOp>(loc, llvmI64Ty,
+          rewriter.getI64IntegerAttr(parallelMemcpyThreshold));
+      Value isNonTemporal = rewriter.create<LLVM::ConstantOp>(loc, llvmI32Ty,
+          rewriter.getI32IntegerAttr(memcpyOp.isNonTemporal() ? 1 : 0));
+      rewriter.create<LLVM::CallOp>(loc, ArrayRef<Type>({}),
+          memcpyParallelRef,
+          ArrayRef<Value>({alignedInt8PtrDstMemory, alignedInt8PtrSrcMemory,
+              int64Size, threshold, isNonTemporal}));
+      rewriter.eraseOp(op);
+      return success();
+    }
+
+    // Non-temporal copies are left to the runtime, which can align the
+    // non-temporal stores and order them with the following stores.
+    if (memcpyOp.isNonTemporal()) {
+      auto memcpyNonTemporalRef = getOrInsertExternFunc(
+          KrnlMemcpyOp::getNonTemporalMemcpyFuncName(), parentModule,
+          LLVM::LLVMType::getFunctionTy(LLVM::LLVMType::getVoidTy(context),
+              {llvmI8PtrTy, llvmI8PtrTy, llvmI64Ty},
+              /*isVarArg=*/false),
+          rewriter);
+      rewriter.create<LLVM::CallOp>(loc, ArrayRef<Type>({}),
+          memcpyNonTemporalRef,
+          ArrayRef<Value>(
+              {alignedInt8PtrDstMemory, alignedInt8PtrSrcMemory, int64Size}));
+      rewriter.eraseOp(op);
+      return success();
+    }
+
     // Is volatile (set to false).
     Value isVolatile = rewriter.create<LLVM::ConstantOp>(loc,
         LLVM::LLVMType::getInt1Ty(context),
@@ -408,6 +852,190 @@ public:
     rewriter.eraseOp(op);
     return success();
   }
+
+private:
+  int64_t parallelMemcpyThreshold;
+};
+
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: KrnlBlasGemmOpLowering
+//===----------------------------------------------------------------------===//
+
+class KrnlBlasGemmOpLowering : public ConversionPattern {
+public:
+  explicit KrnlBlasGemmOpLowering(MLIRContext *context)
+      : ConversionPattern(KrnlBlasGemmOp::getOperationName(), 1, context) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const override {
+    auto *context = op->getContext();
+    auto gemmOp = llvm::cast<KrnlBlasGemmOp>(op);
+    KrnlBlasGemmOpAdaptor operandAdaptor(operands);
+    auto loc = op->getLoc();
+    ModuleOp parentModule = op->getParentOfType<ModuleOp>();
+
+    // The aligned pointers of the matrices, moved to their offsets if any.
+    auto offsets = operandAdaptor.offsets();
+    auto getMatrixPtr = [&](Value memRef, unsigned index) -> Value {
+      Type ptrType =
+          memRef.getType().cast<LLVM::LLVMType>().getStructElementType(1);
+      Value ptr = rewriter.create<LLVM::ExtractValueOp>(
+          loc, ptrType, memRef, rewriter.getI64ArrayAttr(1));
+      if (!offsets.empty())
+        ptr = rewriter.create<LLVM::GEPOp>(
+            loc, ptrType, ptr, ArrayRef<Value>({offsets[index]}));
+      return ptr;
+    };
+    Value A = getMatrixPtr(operandAdaptor.A(), 0);
+    Value B = getMatrixPtr(operandAdaptor.B(), 1);
+    Value C = getMatrixPtr(operandAdaptor.C(), 2);
+
+    // CBLAS enumerations.
+    const int64_t cblasRowMajor = 101, cblasNoTrans = 111, cblasTrans = 112;
+    auto llvmI32Ty = LLVM::LLVMType::getInt32Ty(context);
+    auto llvmF32Ty = LLVM::LLVMType::getFloatTy(context);
+    auto i32Constant = [&](int64_t value) -> Value {
+      return rewriter.create<LLVM::ConstantOp>(
+          loc, llvmI32Ty, rewriter.getI32IntegerAttr(value));
+    };
+    bool transA = gemmOp.transA(), transB = gemmOp.transB();
+    int64_t M = gemmOp.M(), N = gemmOp.N(), K = gemmOp.K();
+    Value alpha = rewriter.create<LLVM::ConstantOp>(
+        loc, llvmF32Ty, gemmOp.alphaAttr());
+    Value beta = rewriter.create<LLVM::ConstantOp>(
+        loc, llvmF32Ty, gemmOp.betaAttr());
+
+    // void cblas_sgemm(order, transA, transB, M, N, K, alpha, A, lda, B, ldb,
+    //     beta, C, ldc)
+    auto llvmF32PtrTy = llvmF32Ty.getPointerTo();
+    auto gemmRef = getOrInsertExternFunc(KrnlBlasGemmOp::getGemmFuncName(),
+        parentModule,
+        LLVM::LLVMType::getFunctionTy(LLVM::LLVMType::getVoidTy(context),
+            {llvmI32Ty, llvmI32Ty, llvmI32Ty, llvmI32Ty, llvmI32Ty, llvmI32Ty,
+                llvmF32Ty, llvmF32PtrTy, llvmI32Ty, llvmF32PtrTy, llvmI32Ty,
+                llvmF32Ty, llvmF32PtrTy, llvmI32Ty},
+            /*isVarArg=*/false),
+        rewriter);
+    rewriter.create<LLVM::CallOp>(loc, ArrayRef<Type>({}), gemmRef,
+        ArrayRef<Value>({i32Constant(cblasRowMajor),
+            i32Constant(transA ? cblasTrans : cblasNoTrans),
+            i32Constant(transB ? cblasTrans : cblasNoTrans), i32Constant(M),
+            i32Constant(N), i32Constant(K), alpha, A,
+            i32Constant(transA ? M : K), B, i32Constant(transB ? K : N), beta,
+            C, i32Constant(N)}));
+
+    rewriter.eraseOp(op);
+    return success();
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// KRNL to LLVM: KrnlParallelForOpLowering
+//===----------------------------------------------------------------------===//
+
+class KrnlParallelForOpLowering : public ConversionPattern {
+public:
+  explicit KrnlParallelForOpLowering(MLIRContext *context)
+      : ConversionPattern(KrnlParallelForOp::getOperationName(), 1, context) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const override {
+    auto *context = op->getContext();
+    auto parallelForOp = llvm::cast<KrnlParallelForOp>(op);
+    KrnlParallelForOpAdaptor operandAdaptor(operands);
+    auto loc = op->getLoc();
+    ModuleOp parentModule = op->getParentOfType<ModuleOp>();
+    auto llvmVoidTy = LLVM::LLVMType::getVoidTy(context);
+    auto llvmI8PtrTy = LLVM::LLVMType::getInt8PtrTy(context);
+    auto llvmI32Ty = LLVM::LLVMType::getInt32Ty(context);
+    auto llvmI64Ty = LLVM::LLVMType::getInt64Ty(context);
+
+    // The captured values are passed to the threads in a structure on the
+    // stack of the caller, the MemRefs as their descriptors.
+    auto captures = operandAdaptor.captures();
+    SmallVector<LLVM::LLVMType, 8> fieldTypes;
+    for (Value capture : captures)
+      fieldTypes.emplace_back(capture.getType().cast<LLVM::LLVMType>());
+    auto contextTy = LLVM::LLVMType::getStructTy(context, fieldTypes);
+    auto getFieldPtr = [&](Value contextPtr, unsigned index) -> Value {
+      Value zero = rewriter.create<LLVM::ConstantOp>(
+          loc, llvmI32Ty, rewriter.getI32IntegerAttr(0));
+      Value field = rewriter.create<LLVM::ConstantOp>(
+          loc, llvmI32Ty, rewriter.getI32IntegerAttr(index));
+      return rewriter.create<LLVM::GEPOp>(loc,
+          fieldTypes[index].getPointerTo(), contextPtr,
+          ArrayRef<Value>({zero, field}));
+    };
+
+    // The threads call a worker taking the range of iterations and the
+    // structure, which calls the C wrapper of the outlined function with the
+    // captured values, the MemRefs by pointers to their descriptors.
+    StringRef funcName = parallelForOp.func();
+    std::string workerName = (funcName + "_worker").str();
+    auto workerFunc = parentModule.lookupSymbol<LLVM::LLVMFuncOp>(workerName);
+    if (!workerFunc) {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      rewriter.setInsertionPointToStart(parentModule.getBody());
+      workerFunc = rewriter.create<LLVM::LLVMFuncOp>(loc, workerName,
+          LLVM::LLVMType::getFunctionTy(llvmVoidTy,
+              {llvmI64Ty, llvmI64Ty, llvmI8PtrTy}, /*isVarArg=*/false),
+          LLVM::Linkage::Internal);
+      SmallVector<Type, 3> workerArgTypes = {
+          llvmI64Ty, llvmI64Ty, llvmI8PtrTy};
+      Block *workerBlock = rewriter.createBlock(
+          &workerFunc.getBody(), Region::iterator(), workerArgTypes);
+      Value contextPtr = rewriter.create<LLVM::BitcastOp>(
+          loc, contextTy.getPointerTo(), workerBlock->getArgument(2));
+      SmallVector<Value, 8> args = {
+          workerBlock->getArgument(0), workerBlock->getArgument(1)};
+      for (auto capture : llvm::enumerate(parallelForOp.captures())) {
+        Value fieldPtr = getFieldPtr(contextPtr, capture.index());
+        if (capture.value().getType().isa<MemRefType>())
+          args.emplace_back(fieldPtr);
+        else
+          args.emplace_back(rewriter.create<LLVM::LoadOp>(loc, fieldPtr));
+      }
+      rewriter.create<LLVM::CallOp>(loc, ArrayRef<Type>({}),
+          rewriter.getSymbolRefAttr(("_mlir_ciface_" + funcName).str()),
+          args);
+      rewriter.create<LLVM::ReturnOp>(loc, ArrayRef<Value>({}));
+    }
+
+    // The structure is allocated in the entry block, so that the stack does
+    // not grow with the loops around the operation.
+    Value contextPtr;
+    {
+      PatternRewriter::InsertionGuard insertGuard(rewriter);
+      rewriter.setInsertionPointToStart(&op->getParentRegion()->front());
+      Value one = rewriter.create<LLVM::ConstantOp>(
+          loc, llvmI64Ty, rewriter.getI64IntegerAttr(1));
+      contextPtr = rewriter.create<LLVM::AllocaOp>(
+          loc, contextTy.getPointerTo(), one, /*alignment=*/0);
+    }
+    for (auto capture : llvm::enumerate(captures))
+      rewriter.create<LLVM::StoreOp>(
+          loc, capture.value(), getFieldPtr(contextPtr, capture.index()));
+
+    // void omParallelFor(body, numIterations, context, numThreads)
+    auto parallelForRef = getOrInsertExternFunc(
+        KrnlParallelForOp::getParallelForFuncName(), parentModule,
+        LLVM::LLVMType::getFunctionTy(llvmVoidTy,
+            {llvmI8PtrTy, llvmI64Ty, llvmI8PtrTy, llvmI32Ty},
+            /*isVarArg=*/false),
+        rewriter);
+    Value workerPtr = rewriter.create<LLVM::BitcastOp>(
+        loc, llvmI8PtrTy, rewriter.create<LLVM::AddressOfOp>(loc, workerFunc));
+    Value contextI8Ptr =
+        rewriter.create<LLVM::BitcastOp>(loc, llvmI8PtrTy, contextPtr);
+    Value numThreads = rewriter.create<LLVM::ConstantOp>(loc, llvmI32Ty,
+        rewriter.getI32IntegerAttr(parallelForOp.numThreads()));
+    rewriter.create<LLVM::CallOp>(loc, ArrayRef<Type>({}), parallelForRef,
+        ArrayRef<Value>({workerPtr, operandAdaptor.numIterations(),
+            contextI8Ptr, numThreads}));
+
+    rewriter.eraseOp(op);
+    return success();
+  }
 };
 
 //===----------------------------------------------------------------------===//
@@ -423,6 +1051,8 @@ public:
     CREATE_OMTENSOR,
     GET_DATA,
     SET_DATA,
+    GET_CONTIGUOUS,
+    RELEASE_CONTIGUOUS,
     GET_DATA_SIZES,
     GET_DATA_STRIDES,
     SET_DATA_TYPE,
@@ -458,9 +1088,43 @@ public:
     auto numOutputs =
         op.getAttrOfType<IntegerAttr>(KrnlEntryPointOp::getNumOutputsAttrName())
             .getInt();
+    // Entry points with output buffers take the list of output tensors to
+    // write the results into as a second argument.
+    bool hasOutputBuffers =
+        op.getAttr(KrnlEntryPointOp::getOutputBuffersAttrName()) != nullptr;
+    // Entry points with output buffers may also have a typed entry point,
+    // taking the raw data pointers of their statically shaped MemRefs.
+    auto typedArgTypes = op.getAttrOfType<ArrayAttr>(
+        KrnlEntryPointOp::getTypedEntryPointAttrName());
+    // Entry points with inference functions specialized for batch sizes call
+    // the one matching the leading dimension of the batched inputs. Those
+    // specialized for sequence lengths compare another dimension, and may
+    // call the first one the padded inputs fit in.
+    SmallVector<std::string, 4> specializationNames;
+    SmallVector<int64_t, 4> batchSizes, batchedInputs;
+    int64_t specializedAxis = 0;
+    bool padInputs =
+        op.getAttr(KrnlEntryPointOp::getPadInputsAttrName()) != nullptr;
+    if (auto axis = op.getAttrOfType<IntegerAttr>(
+            KrnlEntryPointOp::getSpecializedAxisAttrName()))
+      specializedAxis = axis.getInt();
+    if (auto specializations = op.getAttrOfType<ArrayAttr>(
+            KrnlEntryPointOp::getSpecializationsAttrName())) {
+      for (auto specialization : specializations)
+        specializationNames.emplace_back(
+            "_mlir_ciface_" +
+            specialization.cast<SymbolRefAttr>().getLeafReference().lower());
+      for (auto batchSize : op.getAttrOfType<ArrayAttr>(
+               KrnlEntryPointOp::getBatchSizesAttrName()))
+        batchSizes.emplace_back(batchSize.cast<IntegerAttr>().getInt());
+      for (auto input : op.getAttrOfType<ArrayAttr>(
+               KrnlEntryPointOp::getBatchedInputsAttrName()))
+        batchedInputs.emplace_back(input.cast<IntegerAttr>().getInt());
+    }
 
     using LLVMType = LLVM::LLVMType;
     auto opaquePtrTy = LLVMType::getInt8PtrTy(context);
+    auto int1Ty = LLVMType::getInt1Ty(context);
     auto int32Ty = LLVMType::getInt32Ty(context);
     auto int64Ty = LLVMType::getInt64Ty(context);
 
@@ -478,9 +1142,22 @@ public:
     auto dynEntryPointName = "run_" + staticEntryPointFuncName;
     assert(module.lookupSymbol(dynEntryPointName.str()) == nullptr &&
            "dynamic entry point name is not unique");
+    // The signature of the model is exported once, with the first entry
+    // point.
+    if (auto signature = op.getAttrOfType<StringAttr>(
+            KrnlEntryPointOp::getInputSignatureAttrName()))
+      emitStringFunc(module, rewriter, loc,
+          KrnlEntryPointOp::getInputSignatureFuncName(), signature.getValue());
+    if (auto signature = op.getAttrOfType<StringAttr>(
+            KrnlEntryPointOp::getOutputSignatureAttrName()))
+      emitStringFunc(module, rewriter, loc,
+          KrnlEntryPointOp::getOutputSignatureFuncName(), signature.getValue());
     rewriter.eraseOp(op);
+    SmallVector<LLVMType, 2> dynEntryPointInputTys = {opaquePtrTy};
+    if (hasOutputBuffers)
+      dynEntryPointInputTys.emplace_back(opaquePtrTy);
     auto dynEntryPointFuncTy =
-        LLVMType::getFunctionTy(opaquePtrTy, {opaquePtrTy}, false);
+        LLVMType::getFunctionTy(opaquePtrTy, dynEntryPointInputTys, false);
     auto dynamicEntryPointFunc = rewriter.create<LLVM::LLVMFuncOp>(
         loc, dynEntryPointName.str(), dynEntryPointFuncTy);
     auto &entryPointEntryBlock =
@@ -505,12 +1182,31 @@ public:
     SmallVector<Value, 4> staticInputs;
     auto wrappedInput = entryPointEntryBlock.getArgument(0);
 
-    auto omTensorPtrArr =
+    auto inputOmTensorPtrArr =
         callApi(rewriter, loc, apiRegistry, API::GET_OMTS, {wrappedInput});
-    for (size_t i = 0; i < staticEntryPointTy.getFunctionNumParams(); i++) {
+
+    // The trailing parameters of an entry point with output buffers are the
+    // MemRefs of the outputs, retrieved from the wrapped output buffers.
+    size_t numParams = staticEntryPointTy.getFunctionNumParams();
+    size_t numInputs = hasOutputBuffers ? numParams - numOutputs : numParams;
+    Value wrappedOutputBuffers;
+    Value outputOmTensorPtrArr;
+    if (hasOutputBuffers) {
+      wrappedOutputBuffers = entryPointEntryBlock.getArgument(1);
+      outputOmTensorPtrArr = callApi(
+          rewriter, loc, apiRegistry, API::GET_OMTS, {wrappedOutputBuffers});
+    }
+
+    // The inputs and their dense row-major versions, released once the
+    // inference function returns.
+    SmallVector<std::pair<Value, Value>, 4> contiguousInputs;
+    for (size_t i = 0; i < numParams; i++) {
       // Call API function to retrieve the i-th dynamic memref.
-      auto idxVal = rewriter.create<LLVM::ConstantOp>(
-          loc, int32Ty, rewriter.getI32IntegerAttr(i));
+      bool isInput = i < numInputs;
+      auto omTensorPtrArr =
+          isInput ? inputOmTensorPtrArr : outputOmTensorPtrArr;
+      auto idxVal = rewriter.create<LLVM::ConstantOp>(loc, int32Ty,
+          rewriter.getI32IntegerAttr(isInput ? i : i - numInputs));
 
       auto omTensorPtrAddrTy = opaquePtrTy.getPointerTo();
       auto omTensorPtrAddr = rewriter
@@ -530,6 +1226,17 @@ public:
       Value ptrToMemRef = rewriter.create<LLVM::AllocaOp>(loc, memRefPtrTy, one,
           /*alignment=*/0);
 
+      // The inference function indexes its inputs as dense row-major MemRefs,
+      // inputs with other strides are repacked into temporary tensors, the
+      // tensors of the caller are left as they are. The output buffers are
+      // written in place, their strides must be dense.
+      if (isInput) {
+        Value contiguousPtr = callApi(
+            rewriter, loc, apiRegistry, API::GET_CONTIGUOUS, {omTensorPtr});
+        contiguousInputs.emplace_back(omTensorPtr, contiguousPtr);
+        omTensorPtr = contiguousPtr;
+      }
+
       // Fill in the memref underlying ptrToMemRef with information extracted
       // from omTensorPtr.
       fillPtrToMemRefWithOMTensor(
@@ -540,14 +1247,147 @@ public:
     }
 
     // Call static entry point with the memref ptrs created, and get output.
-    auto outMemRefs =
-        rewriter
-            .create<LLVM::CallOp>(loc,
-                staticEntryPointTy.getFunctionResultType(),
-                rewriter.getSymbolRefAttr(wrappedStaticEntryPointFuncName),
-                staticInputs)
-            .getResult(0);
-    auto outMemRefsType = outMemRefs.getType().dyn_cast<LLVMType>();
+    auto outMemRefsType = staticEntryPointTy.getFunctionResultType();
+    auto callInferenceFunc = [&](StringRef name) {
+      return rewriter
+          .create<LLVM::CallOp>(loc, outMemRefsType,
+              rewriter.getSymbolRefAttr(name), staticInputs)
+          .getResult(0);
+    };
+    Value outMemRefs;
+    if (specializationNames.empty()) {
+      outMemRefs = callInferenceFunc(wrappedStaticEntryPointFuncName);
+    } else {
+      // The specializations only differ from the generic function by the
+      // static sizes of their MemRefs, so that they have the same signature
+      // once lowered. Branch to the call of the first specialization whose
+      // batch size is the leading dimension of all the batched inputs, and
+      // to the call of the generic function otherwise. With padding, the
+      // first specialization whose size is not below the dimension of any of
+      // the batched inputs is called with the inputs padded to its size, and
+      // the padded copies are freed once it returns.
+      FlatSymbolRefAttr padMemRefRef, freeRef;
+      if (padInputs) {
+        padMemRefRef = getOrInsertExternFunc(
+            KrnlEntryPointOp::getPadMemRefFuncName(), module,
+            LLVMType::getFunctionTy(opaquePtrTy,
+                {opaquePtrTy, int64Ty, int64Ty, int64Ty, int64Ty},
+                /*isVarArg=*/false),
+            rewriter);
+        freeRef = getOrInsertExternFunc("free", module,
+            LLVMType::getFunctionTy(LLVMType::getVoidTy(context),
+                {opaquePtrTy}, /*isVarArg=*/false),
+            rewriter);
+      }
+      Region *body = &dynamicEntryPointFunc.getBody();
+      Type outMemRefsArgTy = outMemRefsType;
+      Block *endBlock = rewriter.createBlock(
+          body, body->end(), ArrayRef<Type>(outMemRefsArgTy));
+      Block *testBlock = &entryPointEntryBlock;
+      for (unsigned k = 0; k < specializationNames.size(); ++k) {
+        rewriter.setInsertionPointToEnd(testBlock);
+        auto batchSize = rewriter.create<LLVM::ConstantOp>(
+            loc, int64Ty, rewriter.getI64IntegerAttr(batchSizes[k]));
+        Value matches;
+        for (int64_t i : batchedInputs) {
+          auto memRefTy =
+              staticEntryPointTy.getFunctionParamType(i).getPointerElementTy();
+          auto memRef =
+              rewriter.create<LLVM::LoadOp>(loc, memRefTy, staticInputs[i]);
+          // The sizes are the fourth field of the MemRef descriptors.
+          auto leadingDim = rewriter.create<LLVM::ExtractValueOp>(loc,
+              int64Ty, memRef,
+              rewriter.getArrayAttr({rewriter.getI64IntegerAttr(3),
+                  rewriter.getI64IntegerAttr(specializedAxis)}));
+          Value isBatchSize = rewriter.create<LLVM::ICmpOp>(loc,
+              padInputs ? LLVM::ICmpPredicate::sle : LLVM::ICmpPredicate::eq,
+              leadingDim, batchSize);
+          if (matches)
+            matches = rewriter.create<LLVM::AndOp>(
+                loc, int1Ty, matches, isBatchSize);
+          else
+            matches = isBatchSize;
+        }
+        Block *callBlock =
+            rewriter.createBlock(body, Region::iterator(endBlock));
+        Block *nextBlock =
+            rewriter.createBlock(body, Region::iterator(endBlock));
+        rewriter.setInsertionPointToEnd(testBlock);
+        rewriter.create<LLVM::CondBrOp>(
+            loc, matches, callBlock, ValueRange(), nextBlock, ValueRange());
+
+        rewriter.setInsertionPointToStart(callBlock);
+        SmallVector<Value, 4> paddedInputs;
+        ArrayRef<int64_t> inputsToPad =
+            padInputs ? ArrayRef<int64_t>(batchedInputs) : ArrayRef<int64_t>();
+        for (int64_t i : inputsToPad) {
+          auto memRefTy =
+              staticEntryPointTy.getFunctionParamType(i).getPointerElementTy();
+          auto rank = rewriter.create<LLVM::ConstantOp>(loc, int64Ty,
+              rewriter.getI64IntegerAttr(getRankFromMemRefType(memRefTy)));
+          auto axis = rewriter.create<LLVM::ConstantOp>(
+              loc, int64Ty, rewriter.getI64IntegerAttr(specializedAxis));
+          // The size of the elements is the address of the second element
+          // from a null pointer.
+          auto elementPtrTy = memRefTy.getStructElementType(1);
+          Value null = rewriter.create<LLVM::NullOp>(loc, elementPtrTy);
+          auto one = rewriter.create<LLVM::ConstantOp>(
+              loc, int64Ty, rewriter.getI64IntegerAttr(1));
+          Value secondElement = rewriter.create<LLVM::GEPOp>(
+              loc, elementPtrTy, null, ArrayRef<Value>({one}));
+          Value elementSize =
+              rewriter.create<LLVM::PtrToIntOp>(loc, int64Ty, secondElement);
+          Value memRefPtr = rewriter.create<LLVM::BitcastOp>(
+              loc, opaquePtrTy, staticInputs[i]);
+          paddedInputs.emplace_back(
+              rewriter
+                  .create<LLVM::CallOp>(loc, opaquePtrTy, padMemRefRef,
+                      ArrayRef<Value>(
+                          {memRefPtr, rank, axis, batchSize, elementSize}))
+                  .getResult(0));
+        }
+        Value specializationOutMemRefs =
+            callInferenceFunc(specializationNames[k]);
+        for (Value paddedInput : paddedInputs)
+          rewriter.create<LLVM::CallOp>(
+              loc, ArrayRef<Type>({}), freeRef, ArrayRef<Value>({paddedInput}));
+        rewriter.create<LLVM::BrOp>(
+            loc, ValueRange(specializationOutMemRefs), endBlock);
+        testBlock = nextBlock;
+      }
+      rewriter.setInsertionPointToStart(testBlock);
+      rewriter.create<LLVM::BrOp>(loc,
+          ValueRange(callInferenceFunc(wrappedStaticEntryPointFuncName)),
+          endBlock);
+      rewriter.setInsertionPointToStart(endBlock);
+      outMemRefs = endBlock->getArgument(0);
+    }
+
+    // The temporary tensors of the repacked inputs are destroyed once the
+    // inference function returns.
+    for (auto &input : contiguousInputs)
+      callApi(rewriter, loc, apiRegistry, API::RELEASE_CONTIGUOUS,
+          {input.second, input.first});
+
+    // The results have been written into the output buffers, which are
+    // returned as is.
+    if (hasOutputBuffers) {
+      rewriter.create<LLVM::ReturnOp>(
+          loc, SmallVector<Value, 1>({wrappedOutputBuffers}));
+      if (typedArgTypes) {
+        rewriter.setInsertionPointAfter(dynamicEntryPointFunc);
+        auto baseName = staticEntryPointFuncName.drop_back(
+            KrnlEntryPointOp::getOutputBuffersFuncSuffix().size());
+        std::string typedEntryPointName =
+            ("run_" + baseName +
+                KrnlEntryPointOp::getTypedEntryPointFuncSuffix())
+                .str();
+        emitTypedEntryPoint(rewriter, loc, typedEntryPointName,
+            wrappedStaticEntryPointFuncName, staticEntryPointTy,
+            typedArgTypes, numOutputs);
+      }
+      return success();
+    }
 
     std::vector<mlir::Value> outMemRefList;
     if (numOutputs == 1) {
@@ -629,6 +1469,34 @@ public:
 private:
   using ApiRegistry = std::map<API, ApiSpec>;
 
+  // Emit a function returning a pointer to a null-terminated global copy of a
+  // string, unless the module already has it.
+  void emitStringFunc(ModuleOp module, PatternRewriter &rewriter, Location loc,
+      StringRef funcName, StringRef value) const {
+    if (module.lookupSymbol(funcName))
+      return;
+    using LLVMType = LLVM::LLVMType;
+    auto *context = module.getContext();
+    auto opaquePtrTy = LLVMType::getInt8PtrTy(context);
+    std::string data = (value + llvm::Twine('\0')).str();
+
+    OpBuilder::InsertionGuard guard(rewriter);
+    rewriter.setInsertionPointToStart(module.getBody());
+    auto global = rewriter.create<LLVM::GlobalOp>(loc,
+        LLVMType::getArrayTy(LLVMType::getInt8Ty(context), data.size()),
+        /*isConstant=*/true, LLVM::Linkage::Internal, (funcName + "_str").str(),
+        rewriter.getStringAttr(data));
+    auto funcTy = LLVMType::getFunctionTy(opaquePtrTy, {}, /*isVarArg=*/false);
+    auto func = rewriter.create<LLVM::LLVMFuncOp>(loc, funcName, funcTy);
+    rewriter.setInsertionPointToStart(&createEntryBlock(funcTy, func));
+    Value globalPtr = rewriter.create<LLVM::AddressOfOp>(loc, global);
+    Value zero = rewriter.create<LLVM::ConstantOp>(loc,
+        LLVMType::getInt64Ty(context), rewriter.getI64IntegerAttr(0));
+    Value str = rewriter.create<LLVM::GEPOp>(
+        loc, opaquePtrTy, globalPtr, ArrayRef<Value>({zero, zero}));
+    rewriter.create<LLVM::ReturnOp>(loc, ArrayRef<Value>({str}));
+  }
+
   ApiRegistry RegisterAllApis(
       ModuleOp &module, PatternRewriter &rewriter) const {
     auto *context = module.getContext();
@@ -648,6 +1516,8 @@ private:
         ApiSpec(API::CREATE_OMTENSOR, "omTensorCreateEmptyDeprecated", opaquePtrTy, {int32Ty}),
         ApiSpec(API::GET_DATA, "omTensorGetDataPtr", opaquePtrTy, {opaquePtrTy}),
         ApiSpec(API::SET_DATA, "omTensorSetPtr", voidTy, {opaquePtrTy, int32Ty, opaquePtrTy, opaquePtrTy}),
+        ApiSpec(API::GET_CONTIGUOUS, "omTensorGetContiguous", opaquePtrTy, {opaquePtrTy}),
+        ApiSpec(API::RELEASE_CONTIGUOUS, "omTensorReleaseContiguous", voidTy, {opaquePtrTy, opaquePtrTy}),
         ApiSpec(API::GET_DATA_SIZES, "omTensorGetDataShape", int64PtrTy, {opaquePtrTy}),
         ApiSpec(API::GET_DATA_STRIDES, "omTensorGetStrides", int64PtrTy, {opaquePtrTy}),
         ApiSpec(API::GET_DATA_TYPE, "omTensorGetDataType", int32Ty, {opaquePtrTy}),
@@ -705,6 +1575,88 @@ private:
     return *entryPointEntryBlock;
   }
 
+  // Emit a typed entry point taking the raw data pointers of the statically
+  // shaped MemRefs of argTypes, and passing their descriptors to the
+  // inference function writing into output buffers:
+  //
+  //   void run_main_graph_typed(float *input0, float *output0);
+  //
+  // The types of the MemRefs and the number of outputs are kept on the typed
+  // entry point, for the generation of its C declaration.
+  void emitTypedEntryPoint(PatternRewriter &rewriter, Location loc,
+      StringRef name, StringRef wrappedStaticEntryPointFuncName,
+      LLVM::LLVMType staticEntryPointTy, ArrayAttr argTypes,
+      int64_t numOutputs) const {
+    using LLVMType = LLVM::LLVMType;
+    auto *context = rewriter.getContext();
+    auto int32Ty = LLVMType::getInt32Ty(context);
+    auto int64Ty = LLVMType::getInt64Ty(context);
+
+    SmallVector<LLVMType, 4> dataPtrTys;
+    for (size_t i = 0; i < staticEntryPointTy.getFunctionNumParams(); ++i)
+      dataPtrTys.emplace_back(staticEntryPointTy.getFunctionParamType(i)
+                                  .getPointerElementTy()
+                                  .getStructElementType(1));
+    auto typedFuncTy = LLVMType::getFunctionTy(
+        LLVMType::getVoidTy(context), dataPtrTys, /*isVarArg=*/false);
+    auto typedFunc =
+        rewriter.create<LLVM::LLVMFuncOp>(loc, name.str(), typedFuncTy);
+    typedFunc.setAttr(KrnlEntryPointOp::getTypedEntryPointAttrName(), argTypes);
+    typedFunc.setAttr(KrnlEntryPointOp::getNumOutputsAttrName(),
+        rewriter.getI32IntegerAttr(numOutputs));
+    auto &entryBlock = createEntryBlock(typedFuncTy, typedFunc);
+    rewriter.setInsertionPointToStart(&entryBlock);
+
+    // Build the descriptor of each MemRef from its data pointer and its static
+    // sizes and strides.
+    SmallVector<Value, 4> memRefPtrs;
+    for (size_t i = 0; i < dataPtrTys.size(); ++i) {
+      auto memRefPtrTy = staticEntryPointTy.getFunctionParamType(i);
+      auto memRefTy = memRefPtrTy.getPointerElementTy();
+      auto shape = argTypes[i].cast<TypeAttr>()
+                       .getValue()
+                       .cast<MemRefType>()
+                       .getShape();
+      auto insert = [&](Value memRef, Value value, ArrayRef<int64_t> pos) {
+        SmallVector<Attribute, 2> position;
+        for (int64_t p : pos)
+          position.emplace_back(rewriter.getI64IntegerAttr(p));
+        return rewriter.create<LLVM::InsertValueOp>(loc, memRefTy, memRef,
+            value, rewriter.getArrayAttr(position));
+      };
+      auto constant = [&](int64_t value) {
+        return rewriter.create<LLVM::ConstantOp>(
+            loc, int64Ty, rewriter.getI64IntegerAttr(value));
+      };
+
+      Value dataPtr = entryBlock.getArgument(i);
+      Value memRef = rewriter.create<LLVM::UndefOp>(loc, memRefTy);
+      memRef = insert(memRef, dataPtr, {0});
+      memRef = insert(memRef, dataPtr, {1});
+      memRef = insert(memRef, constant(0), {2});
+      int64_t stride = 1;
+      for (int64_t d = shape.size() - 1; d >= 0; --d) {
+        memRef = insert(memRef, constant(shape[d]), {3, d});
+        memRef = insert(memRef, constant(stride), {4, d});
+        stride *= shape[d];
+      }
+
+      auto one = rewriter.create<LLVM::ConstantOp>(
+          loc, int32Ty, rewriter.getI32IntegerAttr(1));
+      Value memRefPtr = rewriter.create<LLVM::AllocaOp>(loc, memRefPtrTy, one,
+          /*alignment=*/0);
+      rewriter.create<LLVM::StoreOp>(loc, memRef, memRefPtr);
+      memRefPtrs.emplace_back(memRefPtr);
+    }
+
+    // The results are written into the output buffers.
+    rewriter.create<LLVM::CallOp>(loc,
+        staticEntryPointTy.getFunctionResultType(),
+        rewriter.getSymbolRefAttr(wrappedStaticEntryPointFuncName),
+        memRefPtrs);
+    rewriter.create<LLVM::ReturnOp>(loc, ArrayRef<Value>());
+  }
+
   void fillPtrToMemRefWithOMTensor(Value &rtMemRef, Value &ptrToMemRef,
       PatternRewriter &rewriter, const Location &loc,
       const std::map<API, ApiSpec> &apiRegistry, ModuleOp &module) const {
@@ -754,7 +1706,7 @@ private:
 
       // Insert stride of the dimension.
       auto dimStridePtr = rewriter.create<LLVM::GEPOp>(loc,
-          int64Ty.getPointerTo(), sizesArrayPtr, ArrayRef<Value>({dimIdx}));
+          int64Ty.getPointerTo(), stridesArrayPtr, ArrayRef<Value>({dimIdx}));
       auto dimStride = rewriter.create<LLVM::LoadOp>(
           loc, int64Ty.getPointerTo(), dimStridePtr);
       memRef = rewriter.create<LLVM::InsertValueOp>(loc, memRefTy, memRef,
@@ -840,10 +1792,11 @@ private:
 
 class KrnlPackedConstOpLowering : public ConvertToLLVMPattern {
 public:
-  explicit KrnlPackedConstOpLowering(
-      MLIRContext *context, LLVMTypeConverter &lowering_)
+  explicit KrnlPackedConstOpLowering(MLIRContext *context,
+      LLVMTypeConverter &lowering_, bool lazyConstants = false)
       : ConvertToLLVMPattern(
-            KrnlPackedConstantOp::getOperationName(), context, lowering_) {}
+            KrnlPackedConstantOp::getOperationName(), context, lowering_),
+        lazyConstants(lazyConstants) {}
 
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const override {
@@ -868,23 +1821,52 @@ public:
     auto mainFunc = module.lookupSymbol<FuncOp>("main_graph");
     assert(mainFunc);
 
-    rewriter.setInsertionPoint(
-        &mainFunc.getBody().front(), mainFunc.getBody().front().begin());
+    // The variant of main_graph writing into output buffers is an entry point
+    // of its own, so it initializes the global constant base as well.
+    SmallVector<FuncOp, 2> inferenceFuncs = {mainFunc};
+    if (auto intoFunc = module.lookupSymbol<FuncOp>(
+            (Twine("main_graph") +
+                KrnlEntryPointOp::getOutputBuffersFuncSuffix())
+                .str()))
+      inferenceFuncs.emplace_back(intoFunc);
+    // So are its specializations for batch sizes or sequence lengths, called
+    // instead of it.
+    auto specializationPrefix =
+        (Twine("main_graph") + KrnlEntryPointOp::getSpecializationFuncSuffix())
+            .str();
+    auto sequenceSpecializationPrefix =
+        (Twine("main_graph") +
+            KrnlEntryPointOp::getSequenceSpecializationFuncSuffix())
+            .str();
+    for (auto func : module.getOps<FuncOp>())
+      if (func.getName().startswith(specializationPrefix) ||
+          func.getName().startswith(sequenceSpecializationPrefix))
+        inferenceFuncs.emplace_back(func);
 
-    //  - Initialize the global constant base.
-    Value basePtrAddr = rewriter.create<LLVM::AddressOfOp>(loc, globalBase);
     auto getEmbeddedConstPoolRef = getOrInsertExternFunc(
         KrnlPackedConstantOp::getEmbeddedDataLoaderMethodName(), module,
         LLVM::LLVMType::getFunctionTy(
             llvmI8PtrTy, {llvmI64Ty}, /*isVarArg=*/false),
         rewriter);
-    auto constPackSize = rewriter.create<LLVM::ConstantOp>(loc,
-        LLVM::LLVMType::getInt64Ty(context), packedConstOp.size_in_bytesAttr());
-    Value alloc = rewriter
-                      .create<CallOp>(loc, getEmbeddedConstPoolRef, llvmI8PtrTy,
-                          ArrayRef<Value>({constPackSize}))
-                      .getResult(0);
-    rewriter.create<LLVM::StoreOp>(loc, alloc, basePtrAddr);
+    // Lazily materialized constants do not use the global constant base.
+    if (lazyConstants)
+      inferenceFuncs.clear();
+    for (auto func : inferenceFuncs) {
+      rewriter.setInsertionPoint(
+          &func.getBody().front(), func.getBody().front().begin());
+
+      //  - Initialize the global constant base.
+      Value basePtrAddr = rewriter.create<LLVM::AddressOfOp>(loc, globalBase);
+      auto constPackSize = rewriter.create<LLVM::ConstantOp>(loc,
+          LLVM::LLVMType::getInt64Ty(context),
+          packedConstOp.size_in_bytesAttr());
+      Value alloc =
+          rewriter
+              .create<CallOp>(loc, getEmbeddedConstPoolRef, llvmI8PtrTy,
+                  ArrayRef<Value>({constPackSize}))
+              .getResult(0);
+      rewriter.create<LLVM::StoreOp>(loc, alloc, basePtrAddr);
+    }
     {
       OpBuilder::InsertionGuard insertGuard(rewriter);
       rewriter.setInsertionPointToStart(module.getBody());
@@ -925,6 +1907,23 @@ public:
           LLVM::Linkage::External,
           mlir::KrnlPackedConstantOp::getConstPackIsLESymbolName(),
           rewriter.getI8IntegerAttr(packedConstOp.is_le()));
+
+      rewriter.create<LLVM::GlobalOp>(loc, type, /*isConstant=*/true,
+          LLVM::Linkage::External,
+          mlir::KrnlPackedConstantOp::getConstPackIsCompressedSymbolName(),
+          rewriter.getI8IntegerAttr(packedConstOp.chunk_size().hasValue()));
+
+      rewriter.create<LLVM::GlobalOp>(loc, type, /*isConstant=*/true,
+          LLVM::Linkage::External,
+          mlir::KrnlPackedConstantOp::getConstPackIsLazySymbolName(),
+          rewriter.getI8IntegerAttr(lazyConstants));
+
+      // Record the hash of the constant pack, which names the constant pool
+      // shared by the processes serving the model.
+      rewriter.create<LLVM::GlobalOp>(loc, llvmI64Ty, /*isConstant=*/true,
+          LLVM::Linkage::External,
+          mlir::KrnlPackedConstantOp::getConstPackHashSymbolName(),
+          rewriter.getI64IntegerAttr(hashConstPack(packedConstOp)));
     }
 
     rewriter.eraseOp(op);
@@ -932,6 +1931,32 @@ public:
   }
 
 private:
+  // Whether packed constants are materialized on their first use.
+  bool lazyConstants;
+
+  // Return the FNV-1a hash of the packed constants, held by the operation or
+  // in its file, or 0 if they cannot be read.
+  static int64_t hashConstPack(KrnlPackedConstantOp packedConstOp) {
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    ArrayRef<char> data;
+    if (auto valueAttr = packedConstOp.valueAttr()) {
+      data = valueAttr.cast<DenseElementsAttr>().getRawData();
+    } else if (auto fileNameAttr = packedConstOp.file_nameAttr()) {
+      auto fileOrError = llvm::MemoryBuffer::getFile(fileNameAttr.getValue());
+      if (!fileOrError)
+        return 0;
+      buffer = std::move(*fileOrError);
+      data = llvm::makeArrayRef(
+          buffer->getBufferStart(), buffer->getBufferSize());
+    }
+    uint64_t hash = 14695981039346656037ULL;
+    for (char byte : data) {
+      hash ^= (uint8_t)byte;
+      hash *= 1099511628211ULL;
+    }
+    return (int64_t)hash;
+  }
+
   static int64_t ArrayAttrIntVal(ArrayAttr a, int i) {
     return (a.getValue()[i]).cast<IntegerAttr>().getInt();
   }
@@ -940,7 +1965,8 @@ private:
 
 void mlir::populateAffineAndKrnlToLLVMConversion(
     OwningRewritePatternList &patterns, MLIRContext *ctx,
-    LLVMTypeConverter &typeConverter) {
+    LLVMTypeConverter &typeConverter, bool lazyConstants,
+    int64_t parallelMemcpyThreshold, bool narrowIndices) {
   populateAffineToStdConversionPatterns(patterns, ctx);
   populateLoopToStdConversionPatterns(patterns, ctx);
   populateShapeToStandardConversionPatterns(patterns, ctx);
@@ -949,9 +1975,15 @@ void mlir::populateAffineAndKrnlToLLVMConversion(
   populateStdToLLVMConversionPatterns(typeConverter, patterns);
 
   patterns.insert<KrnlGlobalOpLowering, KrnlPackedConstOpLowering>(
-      ctx, typeConverter);
-  patterns.insert<KrnlGetRefOpLowering>(ctx, typeConverter);
-  patterns.insert<KrnlMemcpyOpLowering, KrnlEntryPointOpLowering>(ctx);
+      ctx, typeConverter, lazyConstants);
+  patterns.insert<KrnlGetRefOpLowering, KrnlReshapeOpLowering,
+      KrnlArenaAllocOpLowering>(ctx, typeConverter);
+  if (narrowIndices)
+    patterns.insert<NarrowIndexAccessLowering<LoadOp>,
+        NarrowIndexAccessLowering<StoreOp>>(ctx, typeConverter);
+  patterns.insert<KrnlMemcpyOpLowering>(ctx, parallelMemcpyThreshold);
+  patterns.insert<KrnlBlasGemmOpLowering, KrnlParallelForOpLowering,
+      KrnlEntryPointOpLowering, KrnlInstrumentOpLowering>(ctx);
 }
 
 //===----------------------------------------------------------------------===//
@@ -959,10 +1991,129 @@ void mlir::populateAffineAndKrnlToLLVMConversion(
 //===----------------------------------------------------------------------===//
 
 namespace {
+// Alignment in bytes of the memory pools, that of the widest vector registers.
+const int64_t kMemoryPoolAlignment = 64;
+
 struct ConvertKrnlToLLVMPass
     : public PassWrapper<ConvertKrnlToLLVMPass, OperationPass<ModuleOp>> {
+  /// Make sure that we have a valid default constructor and copy constructor to
+  /// make sure that the options are initialized properly.
+  ConvertKrnlToLLVMPass() = default;
+  ConvertKrnlToLLVMPass(const ConvertKrnlToLLVMPass &pass) {}
+  ConvertKrnlToLLVMPass(bool lazyConstants, bool foldStaticMemRefs,
+      bool annotateBuffers, int64_t parallelMemcpyThreshold,
+      bool narrowIndices) {
+    this->lazyConstants = lazyConstants;
+    this->foldStaticMemRefs = foldStaticMemRefs;
+    this->annotateBuffers = annotateBuffers;
+    this->parallelMemcpyThreshold = parallelMemcpyThreshold;
+    this->narrowIndices = narrowIndices;
+  }
+
   void runOnOperation() final;
+
+  Option<bool> lazyConstants{*this, "lazy-constants",
+      llvm::cl::desc("Materialize each packed constant from the constant pack "
+                     "on its first use instead of loading the whole constant "
+                     "pack on every invocation."),
+      llvm::cl::init(false)};
+  Option<bool> foldStaticMemRefs{*this, "fold-static-memrefs",
+      llvm::cl::desc("Replace the offsets, sizes and strides of the "
+                     "statically shaped MemRef arguments of the functions "
+                     "by constants."),
+      llvm::cl::init(false)};
+  Option<bool> annotateBuffers{*this, "annotate-buffers",
+      llvm::cl::desc("Mark the data of the MemRef arguments of the functions "
+                     "noalias, assuming that the inputs and outputs of the "
+                     "model do not overlap, and align the memory pools to "
+                     "the alignment of vector registers."),
+      llvm::cl::init(false)};
+  Option<int64_t> parallelMemcpyThreshold{*this, "parallel-memcpy-threshold",
+      llvm::cl::desc("Split the copies of at least this number of bytes "
+                     "across the memory copy threads of the runtime, 0 "
+                     "disables it."),
+      llvm::cl::init(0)};
+  Option<bool> narrowIndices{*this, "narrow-indices",
+      llvm::cl::desc("Compute the element offsets of the loads and stores "
+                     "of statically shaped MemRefs with fewer than 2^31 "
+                     "elements in 32 bits."),
+      llvm::cl::init(false)};
 };
+
+/// Return the number of arguments of a lowered function for an argument of
+/// the given type. Each ranked MemRef is expanded into its two pointers, its
+/// offset, and its sizes and strides; other arguments are not expanded.
+unsigned getNumLoweredArgs(Type type) {
+  if (auto memRefType = type.dyn_cast<MemRefType>())
+    return 3 + 2 * memRefType.getRank();
+  return type.isa<UnrankedMemRefType>() ? 2 : 1;
+}
+
+/// Test if the arguments of a lowered function are the expansion of
+/// arguments of the given types.
+bool hasLoweredArgs(LLVM::LLVMFuncOp func, ArrayRef<Type> argTypes) {
+  if (func.isExternal())
+    return false;
+  unsigned numArgs = 0;
+  for (Type type : argTypes)
+    numArgs += getNumLoweredArgs(type);
+  return numArgs == func.getNumArguments();
+}
+
+/// Replace the offsets, sizes and strides passed with the statically shaped
+/// MemRef arguments of a lowered function by constants. The arguments are
+/// kept, so that the calling convention of the function and of its C wrapper
+/// is unchanged, but the code of the function only depends on the pointers
+/// of their descriptors. argTypes are the types of the arguments before
+/// their expansion into the fields of the descriptors.
+void foldStaticMemRefDescriptors(
+    LLVM::LLVMFuncOp func, ArrayRef<Type> argTypes) {
+  if (!hasLoweredArgs(func, argTypes))
+    return;
+  Block &entryBlock = func.getBody().front();
+  auto int64Ty = LLVM::LLVMType::getInt64Ty(func.getContext());
+
+  OpBuilder builder(&entryBlock, entryBlock.begin());
+  unsigned argIndex = 0;
+  for (Type type : argTypes) {
+    auto memRefType = type.dyn_cast<MemRefType>();
+    int64_t offset;
+    SmallVector<int64_t, 4> strides;
+    if (memRefType && memRefType.hasStaticShape() &&
+        succeeded(getStridesAndOffset(memRefType, strides, offset)) &&
+        !ShapedType::isDynamicStrideOrOffset(offset) &&
+        llvm::none_of(strides, ShapedType::isDynamicStrideOrOffset)) {
+      SmallVector<int64_t, 9> fields = {offset};
+      fields.append(
+          memRefType.getShape().begin(), memRefType.getShape().end());
+      fields.append(strides.begin(), strides.end());
+      for (unsigned k = 0; k < fields.size(); ++k) {
+        Value arg = entryBlock.getArgument(argIndex + 2 + k);
+        if (arg.getType() != int64Ty || arg.use_empty())
+          continue;
+        Value field = builder.create<LLVM::ConstantOp>(
+            func.getLoc(), int64Ty, builder.getI64IntegerAttr(fields[k]));
+        arg.replaceAllUsesWith(field);
+      }
+    }
+    argIndex += getNumLoweredArgs(type);
+  }
+}
+
+/// Mark the aligned pointers of the ranked MemRef arguments of a lowered
+/// function noalias. The allocated pointers are only used to free the data,
+/// and are left as is.
+void markMemRefArgsNoAlias(LLVM::LLVMFuncOp func, ArrayRef<Type> argTypes) {
+  if (!hasLoweredArgs(func, argTypes))
+    return;
+  unsigned argIndex = 0;
+  for (Type type : argTypes) {
+    if (type.isa<MemRefType>())
+      func.setArgAttr(
+          argIndex + 1, "llvm.noalias", BoolAttr::get(true, func.getContext()));
+    argIndex += getNumLoweredArgs(type);
+  }
+}
 } // end anonymous namespace
 
 void ConvertKrnlToLLVMPass::runOnOperation() {
@@ -980,12 +2131,51 @@ void ConvertKrnlToLLVMPass::runOnOperation() {
   // We have a combination of `krnl`, `affine`, and `std` operations. We
   // lower in stages until all the code is in the LLVM dialect.
   OwningRewritePatternList patterns;
-  populateAffineAndKrnlToLLVMConversion(patterns, &getContext(), typeConverter);
+  populateAffineAndKrnlToLLVMConversion(patterns, &getContext(),
+      typeConverter, lazyConstants, parallelMemcpyThreshold, narrowIndices);
+
+  // Record the types of the arguments of the functions, which are lost when
+  // their MemRefs are expanded into the fields of their descriptors. The
+  // MemRefs passed to outlined functions may alias: they are left alone.
+  llvm::StringMap<SmallVector<Type, 4>> funcArgTypes;
+  if (foldStaticMemRefs || annotateBuffers)
+    getOperation().walk([&](FuncOp func) {
+      if (func.getAttr(KrnlOpsDialect::getOutlinedAttrName()))
+        return;
+      auto inputs = func.getType().getInputs();
+      funcArgTypes[func.getName()].assign(inputs.begin(), inputs.end());
+    });
+
+  // The memory pools, only used through krnl.getref, are allocated with the
+  // alignment of vector registers. The offsets of the krnl.getref operations
+  // being constants, LLVM derives the alignment of the MemRefs in the pools.
+  if (annotateBuffers)
+    getOperation().walk([&](AllocOp allocOp) {
+      Value pool = allocOp.getResult();
+      if (allocOp.alignment().hasValue() || pool.use_empty() ||
+          !llvm::all_of(pool.getUsers(), [&](Operation *user) {
+            return isa<KrnlGetRefOp>(user) || isa<DeallocOp>(user);
+          }))
+        return;
+      allocOp.setAttr("alignment",
+          Builder(&getContext()).getI64IntegerAttr(kMemoryPoolAlignment));
+    });
 
   // We want to completely lower to LLVM, so we use a `FullConversion`. This
   // ensures that only legal operations will remain after the conversion.
   if (failed(applyFullConversion(getOperation(), target, patterns))) {
     signalPassFailure();
+    return;
+  }
+
+  for (auto func : getOperation().getOps<LLVM::LLVMFuncOp>()) {
+    auto argTypes = funcArgTypes.find(func.getName());
+    if (argTypes == funcArgTypes.end())
+      continue;
+    if (foldStaticMemRefs)
+      foldStaticMemRefDescriptors(func, argTypes->second);
+    if (annotateBuffers)
+      markMemRefArgsNoAlias(func, argTypes->second);
   }
 }
 
@@ -993,3 +2183,11 @@ void ConvertKrnlToLLVMPass::runOnOperation() {
 std::unique_ptr<mlir::Pass> mlir::createConvertKrnlToLLVMPass() {
   return std::make_unique<ConvertKrnlToLLVMPass>();
 }
+
+std::unique_ptr<mlir::Pass> mlir::createConvertKrnlToLLVMPass(
+    bool lazyConstants, bool foldStaticMemRefs, bool annotateBuffers,
+    int64_t parallelMemcpyThreshold, bool narrowIndices) {
+  return std::make_unique<ConvertKrnlToLLVMPass>(lazyConstants,
+      foldStaticMemRefs, annotateBuffers, parallelMemcpyThreshold,
+      narrowIndices);
+}
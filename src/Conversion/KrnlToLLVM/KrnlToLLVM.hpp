@@ -20,7 +20,9 @@ class LLVMTypeConverter;
 class OwningRewritePatternList;
 
 void populateAffineAndKrnlToLLVMConversion(OwningRewritePatternList &patterns,
-    MLIRContext *ctx, LLVMTypeConverter &typeConverter);
+    MLIRContext *ctx, LLVMTypeConverter &typeConverter,
+    bool lazyConstants = false, int64_t parallelMemcpyThreshold = 0,
+    bool narrowIndices = false);
 
 } // namespace mlir
 
@@ -0,0 +1,119 @@
+//===------------------------ If.cpp - Lowering If Op ---------------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX IfRegion Operator to an scf.if operation, so that
+// only the operations of the taken branch are executed. The buffers of the
+// operations of a branch are allocated and freed in the block of the branch,
+// and the memory pools bundling them are scoped to it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/SCF/SCF.h"
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+namespace {
+
+struct ONNXIfRegionOpLowering : public ConversionPattern {
+  ONNXIfRegionOpLowering(MLIRContext *ctx)
+      : ConversionPattern(mlir::ONNXIfRegionOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto ifOp = llvm::cast<ONNXIfRegionOp>(op);
+    auto loc = op->getLoc();
+    ONNXIfRegionOpAdaptor operandAdaptor(operands);
+
+    // The condition is the single element of a tensor of booleans.
+    Value cond = operandAdaptor.cond();
+    auto condType = cond.getType().cast<MemRefType>();
+    Value zero = emitConstantOp(rewriter, loc, rewriter.getIndexType(), 0);
+    SmallVector<Value, 1> zeros(condType.getRank(), zero);
+    Value condValue = rewriter.create<LoadOp>(loc, cond, zeros);
+
+    SmallVector<Type, 4> resultTypes;
+    for (Type type : op->getResultTypes())
+      resultTypes.emplace_back(convertToMemRefType(type));
+    auto scfIfOp = rewriter.create<scf::IfOp>(
+        loc, resultTypes, condValue, /*withElseRegion=*/true);
+    rewriter.mergeBlocks(&ifOp.then_branch().front(),
+        &scfIfOp.thenRegion().front(), llvm::None);
+    rewriter.mergeBlocks(&ifOp.else_branch().front(),
+        &scfIfOp.elseRegion().front(), llvm::None);
+
+    // The buffers of the results are freed after the last use of the results
+    // in the block, unless they are returned.
+    for (unsigned i = 0; i < op->getNumResults(); ++i) {
+      if (!checkInsertDealloc(op, i))
+        continue;
+      auto dealloc = rewriter.create<DeallocOp>(loc, scfIfOp.getResult(i));
+      dealloc.getOperation()->moveBefore(&op->getBlock()->back());
+    }
+
+    rewriter.replaceOp(op, scfIfOp.getResults());
+    return success();
+  }
+};
+
+struct ONNXIfRegionYieldOpLowering : public ConversionPattern {
+  ONNXIfRegionYieldOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXIfRegionYieldOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    Operation *parentOp = op->getParentOp();
+    if (!isa<scf::IfOp>(parentOp))
+      return failure();
+
+    // Each branch yields buffers of its own, which the results of the If own.
+    // The values defined before the If, e.g. forwarded by an Identity, and the
+    // constants are copied into new buffers.
+    SmallVector<Value, 4> values;
+    for (auto operand : llvm::enumerate(operands)) {
+      Value value = operand.value();
+      auto resultType =
+          parentOp->getResult(operand.index()).getType().cast<MemRefType>();
+      auto allocOp = value.getDefiningOp<AllocOp>();
+      if (!allocOp || !op->getParentRegion()->isAncestor(
+                          allocOp.getOperation()->getParentRegion())) {
+        auto type = value.getType().cast<MemRefType>();
+        Value copy = insertAllocAndDealloc(
+            type, loc, rewriter, /*insertDealloc=*/false, {value});
+        Value size = emitConstantOp(rewriter, loc,
+            rewriter.getIntegerType(64), getMemRefEltSizeInBytes(type));
+        for (unsigned i = 0; i < type.getRank(); ++i) {
+          Value dim;
+          if (type.isDynamicDim(i))
+            dim = rewriter.create<IndexCastOp>(loc,
+                rewriter.create<DimOp>(loc, value, i),
+                rewriter.getIntegerType(64));
+          else
+            dim = emitConstantOp(rewriter, loc, rewriter.getIntegerType(64),
+                type.getShape()[i]);
+          size = rewriter.create<MulIOp>(loc, size, dim);
+        }
+        emitMemcpy(rewriter, loc, copy, value, size);
+        value = copy;
+      }
+      // The dimensions on which the branches disagree are dynamic.
+      if (value.getType() != resultType)
+        value = rewriter.create<MemRefCastOp>(loc, value, resultType);
+      values.emplace_back(value);
+    }
+    rewriter.replaceOpWithNewOp<scf::YieldOp>(op, values);
+    return success();
+  }
+};
+} // namespace
+
+void populateLoweringONNXIfRegionOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXIfRegionOpLowering, ONNXIfRegionYieldOpLowering>(ctx);
+}
@@ -9,6 +9,13 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+
+#include "mlir/Dialect/SCF/SCF.h"
+#include "mlir/Dialect/Vector/VectorOps.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/JSON.h"
+
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 using namespace mlir;
@@ -17,22 +24,132 @@ using namespace mlir;
 // EntryPoint Op lowering to Krnl Entry Point.
 //===----------------------------------------------------------------------===//
 
+/// Describe the names, element types and dimensions of the inputs or outputs
+/// of a model in JSON, e.g. [{"name":"x","type":"f32","dims":[-1,3]}], with
+/// -1 for the dynamic dimensions and null dimensions for unranked tensors.
+static std::string getSignature(ArrayRef<Type> types, ArrayAttr names) {
+  llvm::json::Array signature;
+  for (auto type : llvm::enumerate(types)) {
+    llvm::json::Object entry;
+    if (names && type.index() < names.size())
+      if (auto name = names[type.index()].dyn_cast<StringAttr>())
+        entry["name"] = name.getValue().str();
+    std::string elementType;
+    llvm::raw_string_ostream os(elementType);
+    getElementTypeOrSelf(type.value()).print(os);
+    entry["type"] = os.str();
+    auto shapedType = type.value().dyn_cast<ShapedType>();
+    if (shapedType && shapedType.hasRank()) {
+      llvm::json::Array dims;
+      for (int64_t dim : shapedType.getShape())
+        dims.push_back(dim);
+      entry["dims"] = std::move(dims);
+    } else {
+      entry["dims"] = nullptr;
+    }
+    signature.push_back(std::move(entry));
+  }
+  std::string str;
+  llvm::raw_string_ostream os(str);
+  os << llvm::json::Value(std::move(signature));
+  return os.str();
+}
+
 class ONNXEntryPointLowering : public OpRewritePattern<ONNXEntryPointOp> {
 public:
   using OpRewritePattern<ONNXEntryPointOp>::OpRewritePattern;
 
   LogicalResult matchAndRewrite(
       ONNXEntryPointOp op, PatternRewriter &rewriter) const override {
-    rewriter.replaceOpWithNewOp<KrnlEntryPointOp>(op,
+    auto entryPoint = rewriter.create<KrnlEntryPointOp>(op.getLoc(),
         op.getAttrOfType<SymbolRefAttr>(
             ONNXEntryPointOp::getEntryPointFuncAttrName()),
         op.getAttrOfType<IntegerAttr>(ONNXEntryPointOp::getNumInputsAttrName()),
         op.getAttrOfType<IntegerAttr>(
             ONNXEntryPointOp::getNumOutputsAttrName()));
+    // The signature of the model lets its users validate their inputs
+    // without running it.
+    auto module = op.getParentOfType<ModuleOp>();
+    if (auto function = module.lookupSymbol<FuncOp>(
+            op.getAttrOfType<SymbolRefAttr>(
+                  ONNXEntryPointOp::getEntryPointFuncAttrName())
+                .getLeafReference())) {
+      entryPoint.setAttr(KrnlEntryPointOp::getInputSignatureAttrName(),
+          rewriter.getStringAttr(getSignature(function.getType().getInputs(),
+              function.getAttrOfType<ArrayAttr>("input_names"))));
+      entryPoint.setAttr(KrnlEntryPointOp::getOutputSignatureAttrName(),
+          rewriter.getStringAttr(getSignature(function.getType().getResults(),
+              function.getAttrOfType<ArrayAttr>("output_names"))));
+    }
+    // Keep the functions specialized for batch sizes or sequence lengths.
+    if (auto specializations = op.getAttr(
+            ONNXEntryPointOp::getSpecializationsAttrName())) {
+      entryPoint.setAttr(
+          KrnlEntryPointOp::getSpecializationsAttrName(), specializations);
+      entryPoint.setAttr(KrnlEntryPointOp::getBatchSizesAttrName(),
+          op.getAttr(ONNXEntryPointOp::getBatchSizesAttrName()));
+      entryPoint.setAttr(KrnlEntryPointOp::getBatchedInputsAttrName(),
+          op.getAttr(ONNXEntryPointOp::getBatchedInputsAttrName()));
+      if (auto axis =
+              op.getAttr(ONNXEntryPointOp::getSpecializedAxisAttrName()))
+        entryPoint.setAttr(
+            KrnlEntryPointOp::getSpecializedAxisAttrName(), axis);
+      if (op.getAttr(ONNXEntryPointOp::getPadInputsAttrName()))
+        entryPoint.setAttr(KrnlEntryPointOp::getPadInputsAttrName(),
+            rewriter.getUnitAttr());
+    }
+    rewriter.eraseOp(op);
     return success();
   }
 };
 
+//===----------------------------------------------------------------------===//
+// Runtime profiling of the lowered ONNX operations.
+//===----------------------------------------------------------------------===//
+
+/// Describe the operand and result types of an operation, which the runtime
+/// profile reports along with the name of the operation.
+static std::string getShapesDescription(Operation *op) {
+  std::string shapes;
+  llvm::raw_string_ostream os(shapes);
+  os << "(";
+  llvm::interleaveComma(op->getOperandTypes(), os);
+  os << ") -> (";
+  llvm::interleaveComma(op->getResultTypes(), os);
+  os << ")";
+  return os.str();
+}
+
+/// Surround each ONNX operation of the module with krnl.instrument operations,
+/// so that the loop nest it is lowered to is timed by the runtime.
+static void instrumentONNXOps(ModuleOp module) {
+  auto *onnxDialect = module.getContext()->getLoadedDialect<ONNXOpsDialect>();
+  SmallVector<Operation *, 32> ops;
+  module.walk([&](Operation *op) {
+    if (op->getDialect() != onnxDialect ||
+        isa<ONNXEntryPointOp, ONNXConstantOp>(op) ||
+        !isa<FuncOp>(op->getParentOp()))
+      return;
+    ops.emplace_back(op);
+  });
+
+  OpBuilder builder(module.getContext());
+  for (Operation *op : ops) {
+    auto opName = builder.getStringAttr(op->getName().getStringRef());
+    auto nodeName = op->getAttrOfType<StringAttr>("onnx_node_name");
+    if (!nodeName)
+      nodeName = builder.getStringAttr("");
+    auto shapes = builder.getStringAttr(getShapesDescription(op));
+
+    builder.setInsertionPoint(op);
+    builder.create<KrnlInstrumentOp>(op->getLoc(), opName, nodeName, shapes,
+        builder.getI64IntegerAttr(KrnlInstrumentOp::getBeforeOpTag()));
+    builder.setInsertionPointAfter(op);
+    builder.create<KrnlInstrumentOp>(op->getLoc(), opName, nodeName, shapes,
+        builder.getI64IntegerAttr(KrnlInstrumentOp::getAfterOpTag()));
+  }
+}
+
 //===----------------------------------------------------------------------===//
 // Frontend to Krnl Dialect lowering pass
 //===----------------------------------------------------------------------===//
@@ -41,13 +158,125 @@ public:
 namespace {
 struct FrontendToKrnlLoweringPass
     : public PassWrapper<FrontendToKrnlLoweringPass, OperationPass<ModuleOp>> {
+  /// Make sure that we have a valid default constructor and copy constructor to
+  /// make sure that the options are initialized properly.
+  FrontendToKrnlLoweringPass() = default;
+  FrontendToKrnlLoweringPass(const FrontendToKrnlLoweringPass &pass) {}
+  FrontendToKrnlLoweringPass(bool enableMatMulTiling, int64_t vectorBits,
+      const std::string &convStrategy, bool instrument,
+      const std::string &tuningDatabase, const std::string &tuningTarget,
+      bool inPlaceElementwise, int64_t blasThreshold,
+      int64_t unrollThreshold) {
+    this->enableMatMulTiling = enableMatMulTiling;
+    this->vectorBits = vectorBits;
+    this->convStrategy = convStrategy;
+    this->instrument = instrument;
+    this->tuningDatabase = tuningDatabase;
+    this->tuningTarget = tuningTarget;
+    this->inPlaceElementwise = inPlaceElementwise;
+    this->blasThreshold = blasThreshold;
+    this->unrollThreshold = unrollThreshold;
+  }
+
   void runOnOperation() final;
+
+  Option<bool> enableMatMulTiling{*this, "enable-matmul-tiling",
+      llvm::cl::desc("Tile the loops of matrix multiplications with static "
+                     "shapes for the cache and the registers."),
+      llvm::cl::init(false)};
+  Option<int64_t> matmulCacheTileM{*this, "matmul-cache-tile-m",
+      llvm::cl::desc("Cache tile size along the M dimension of MatMul."),
+      llvm::cl::init(MatMulTilingOptions().cacheTileM)};
+  Option<int64_t> matmulCacheTileN{*this, "matmul-cache-tile-n",
+      llvm::cl::desc("Cache tile size along the N dimension of MatMul."),
+      llvm::cl::init(MatMulTilingOptions().cacheTileN)};
+  Option<int64_t> matmulCacheTileK{*this, "matmul-cache-tile-k",
+      llvm::cl::desc("Cache tile size along the K dimension of MatMul."),
+      llvm::cl::init(MatMulTilingOptions().cacheTileK)};
+  Option<int64_t> matmulRegisterTileM{*this, "matmul-register-tile-m",
+      llvm::cl::desc("Register tile size along the M dimension of MatMul."),
+      llvm::cl::init(MatMulTilingOptions().registerTileM)};
+  Option<int64_t> matmulRegisterTileN{*this, "matmul-register-tile-n",
+      llvm::cl::desc("Register tile size along the N dimension of MatMul."),
+      llvm::cl::init(MatMulTilingOptions().registerTileN)};
+  Option<std::string> matmulCacheLoopOrder{*this, "matmul-cache-loop-order",
+      llvm::cl::desc("Order of the loops over the cache tiles of MatMul, "
+                     "outermost first, as a permutation of m, n and k."),
+      llvm::cl::init(MatMulTilingOptions().cacheLoopOrder)};
+  Option<int64_t> vectorBits{*this, "vector-bits",
+      llvm::cl::desc("Number of bits of the vectors used for the innermost "
+                     "dimension of element-wise operations (0 disables "
+                     "vectorization)."),
+      llvm::cl::init(0)};
+  Option<std::string> convStrategy{*this, "conv-strategy",
+      llvm::cl::desc("Strategy used to lower convolutions: direct, im2col, "
+                     "winograd or auto."),
+      llvm::cl::init("direct")};
+  Option<bool> instrument{*this, "instrument",
+      llvm::cl::desc("Call the runtime profiling hook before and after the "
+                     "code of each lowered ONNX operation."),
+      llvm::cl::init(false)};
+  Option<std::string> tuningDatabase{*this, "tuning-database",
+      llvm::cl::desc("Tuning database holding the parameters of the lowering "
+                     "of operations of given shapes."),
+      llvm::cl::init("")};
+  Option<std::string> tuningTarget{*this, "tuning-target",
+      llvm::cl::desc("Target whose entries of the tuning database are used."),
+      llvm::cl::init("")};
+  Option<bool> inPlaceElementwise{*this, "in-place-elementwise",
+      llvm::cl::desc("Let the result of element-wise operations reuse the "
+                     "buffer of an input which has no other use."),
+      llvm::cl::init(false)};
+  Option<int64_t> blasThreshold{*this, "blas-threshold",
+      llvm::cl::desc("Minimum number of multiply-accumulates of the f32 "
+                     "matrix products of static shapes of MatMul, Gemm and "
+                     "Conv which call the BLAS library (0 disables it)."),
+      llvm::cl::init(0)};
+  Option<int64_t> unrollThreshold{*this, "unroll-threshold",
+      llvm::cl::desc("Maximum number of elements of the element-wise "
+                     "operations, and of multiply-accumulates of MatMul and "
+                     "Gemm, of static shapes whose loops are fully unrolled "
+                     "(0 disables it)."),
+      llvm::cl::init(0)};
 };
 } // end anonymous namespace.
 
 void FrontendToKrnlLoweringPass::runOnOperation() {
   ModuleOp module = getOperation();
 
+  auto convLoweringStrategy =
+      llvm::StringSwitch<llvm::Optional<ConvLoweringStrategy>>(convStrategy)
+          .Case("direct", ConvLoweringStrategy::Direct)
+          .Case("im2col", ConvLoweringStrategy::Im2Col)
+          .Case("winograd", ConvLoweringStrategy::Winograd)
+          .Case("auto", ConvLoweringStrategy::Auto)
+          .Default(llvm::None);
+  if (!convLoweringStrategy) {
+    module.emitError("unknown convolution lowering strategy: ")
+        << StringRef(convStrategy);
+    return signalPassFailure();
+  }
+
+  std::string cacheLoopOrder = matmulCacheLoopOrder;
+  if (cacheLoopOrder.size() != 3 ||
+      !std::is_permutation(
+          cacheLoopOrder.begin(), cacheLoopOrder.end(), "mnk")) {
+    module.emitError("invalid MatMul cache loop order: ") << cacheLoopOrder;
+    return signalPassFailure();
+  }
+
+  TuningDatabase database;
+  if (!tuningDatabase.empty()) {
+    std::string errorMessage;
+    if (!database.load(tuningDatabase, errorMessage)) {
+      module.emitError(errorMessage);
+      return signalPassFailure();
+    }
+  }
+
+  if (instrument)
+    instrumentONNXOps(module);
+
   // The first thing to define is the conversion target. This will define the
   // final target for this lowering.
   ConversionTarget target(getContext());
@@ -55,7 +284,7 @@ void FrontendToKrnlLoweringPass::runOnOperation() {
   // We define the specific operations, or dialects, that are legal targets for
   // this lowering.
   target.addLegalDialect<KrnlOpsDialect, AffineDialect, StandardOpsDialect,
-      shape::ShapeDialect>();
+      scf::SCFDialect, shape::ShapeDialect, vector::VectorDialect>();
 
   // TODO: enable this once more ops are supported.
   // We also define the ONNX dialect as Illegal so that the conversion will fail
@@ -84,19 +313,38 @@ void FrontendToKrnlLoweringPass::runOnOperation() {
       patterns, &getContext(), tensor_to_memref_converter);
 
   // Frontend operation lowering.
+  // Control flow
+  populateLoweringONNXIfRegionOpPattern(patterns, &getContext());
   // Math
-  populateLoweringONNXElementwiseOpPattern(patterns, &getContext());
-  populateLoweringONNXGemmOpPattern(patterns, &getContext());
-  populateLoweringONNXReductionOpPattern(patterns, &getContext());
-  populateLoweringONNXSoftmaxOpPattern(patterns, &getContext());
-  populateLoweringONNXMatMulOpPattern(patterns, &getContext());
+  populateLoweringONNXElementwiseOpPattern(patterns, &getContext(),
+      vectorBits, inPlaceElementwise, unrollThreshold);
+  populateLoweringONNXGemmOpPattern(
+      patterns, &getContext(), blasThreshold, unrollThreshold);
+  populateLoweringONNXReductionOpPattern(patterns, &getContext(), vectorBits);
+  populateLoweringONNXSoftmaxOpPattern(patterns, &getContext(), vectorBits);
+  populateLoweringONNXTopKOpPattern(patterns, &getContext());
+  populateLoweringONNXSparseMatMulOpPattern(patterns, &getContext());
+  MatMulTilingOptions matmulTilingOptions;
+  matmulTilingOptions.enabled = enableMatMulTiling;
+  matmulTilingOptions.cacheTileM = matmulCacheTileM;
+  matmulTilingOptions.cacheTileN = matmulCacheTileN;
+  matmulTilingOptions.cacheTileK = matmulCacheTileK;
+  matmulTilingOptions.registerTileM = matmulRegisterTileM;
+  matmulTilingOptions.registerTileN = matmulRegisterTileN;
+  matmulTilingOptions.cacheLoopOrder = cacheLoopOrder;
+  populateLoweringONNXMatMulOpPattern(patterns, &getContext(),
+      matmulTilingOptions, database.empty() ? nullptr : &database,
+      tuningTarget, blasThreshold, unrollThreshold);
   // Tensor
   populateLoweringONNXReshapeOpPattern(patterns, &getContext());
   populateLoweringONNXPadConstantValuePadOpPattern(patterns, &getContext());
   populateLoweringONNXPadOpPattern(patterns, &getContext());
   populateLoweringONNXUnsqueezeOpPattern(patterns, &getContext());
   populateLoweringONNXTransposeOpPattern(patterns, &getContext());
+  populateLoweringONNXLayoutTransformOpPattern(patterns, &getContext());
   populateLoweringONNXGatherOpPattern(patterns, &getContext());
+  populateLoweringONNXScatterElementsOpPattern(patterns, &getContext());
+  populateLoweringONNXScatterNDOpPattern(patterns, &getContext());
   populateLoweringONNXIdentityOpPattern(patterns, &getContext());
   populateLoweringONNXConstantOfShapeOpPattern(patterns, &getContext());
   populateLoweringONNXConstantOpPattern(patterns, &getContext());
@@ -105,10 +353,22 @@ void FrontendToKrnlLoweringPass::runOnOperation() {
   populateLoweringONNXSplitOpPattern(patterns, &getContext());
   populateLoweringONNXSizeOpPattern(patterns, &getContext());
   populateLoweringONNXTileOpPattern(patterns, &getContext());
+  populateLoweringONNXResizeOpPattern(patterns, &getContext());
+  populateLoweringONNXImagePreprocessOpPattern(patterns, &getContext());
+  populateLoweringONNXEmbeddingBagOpPattern(patterns, &getContext());
   // Neural network
-  populateLoweringONNXConvOpPattern(patterns, &getContext());
-  populateLoweringONNXNormalizationOpPattern(patterns, &getContext());
-  populateLoweringONNXPoolingOpPattern(patterns, &getContext());
+  populateLoweringONNXConvOpPattern(patterns, &getContext(),
+      *convLoweringStrategy, vectorBits, blasThreshold);
+  populateLoweringONNXConvTransposeOpPattern(patterns, &getContext());
+  populateLoweringONNXNormalizationOpPattern(
+      patterns, &getContext(), vectorBits);
+  populateLoweringONNXFusedAttentionOpPattern(patterns, &getContext());
+  populateLoweringONNXPoolingOpPattern(patterns, &getContext(), vectorBits);
+  // Quantization
+  populateLoweringONNXQuantizeLinearOpPattern(patterns, &getContext());
+  populateLoweringONNXDequantizeLinearOpPattern(patterns, &getContext());
+  populateLoweringONNXMatMulIntegerOpPattern(patterns, &getContext());
+  populateLoweringONNXQLinearConvOpPattern(patterns, &getContext());
   // Recurrent neural network
   populateLoweringONNXGRUOpPattern(patterns, &getContext());
   populateLoweringONNXLSTMOpPattern(patterns, &getContext());
@@ -126,3 +386,12 @@ void FrontendToKrnlLoweringPass::runOnOperation() {
 std::unique_ptr<Pass> mlir::createLowerToKrnlPass() {
   return std::make_unique<FrontendToKrnlLoweringPass>();
 }
+
+std::unique_ptr<Pass> mlir::createLowerToKrnlPass(bool enableMatMulTiling,
+    int64_t vectorBits, const std::string &convStrategy, bool instrument,
+    const std::string &tuningDatabase, const std::string &tuningTarget,
+    bool inPlaceElementwise, int64_t blasThreshold, int64_t unrollThreshold) {
+  return std::make_unique<FrontendToKrnlLoweringPass>(enableMatMulTiling,
+      vectorBits, convStrategy, instrument, tuningDatabase, tuningTarget,
+      inPlaceElementwise, blasThreshold, unrollThreshold);
+}
@@ -8,6 +8,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/IR/BlockAndValueMapping.h"
+
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 using namespace mlir;
@@ -120,10 +122,27 @@ Value emitScalarOpFor<ONNXCastOp>(ConversionPatternRewriter &rewriter,
         return rewriter.create<FPTruncOp>(loc, elementType, operand);
     }
   }
-  // int to float
   else if (origtype.isa<IntegerType>()) {
-    if (elementType.isa<FloatType>())
+    // Booleans are 0 or 1, not sign extended.
+    bool isBool = origtype.isInteger(1);
+    // int to float
+    if (elementType.isa<FloatType>()) {
+      if (isBool)
+        return rewriter.create<UIToFPOp>(loc, operand, elementType);
       return rewriter.create<SIToFPOp>(loc, elementType, operand);
+    }
+    // int to int of another width
+    if (elementType.isa<IntegerType>()) {
+      unsigned origWidth = origtype.getIntOrFloatBitWidth();
+      unsigned width = elementType.getIntOrFloatBitWidth();
+      if (origWidth > width)
+        return rewriter.create<TruncateIOp>(loc, elementType, operand);
+      if (origWidth < width && isBool)
+        return rewriter.create<ZeroExtendIOp>(loc, operand, elementType);
+      if (origWidth < width)
+        return rewriter.create<SignExtendIOp>(loc, elementType, operand);
+      return operand;
+    }
   }
   llvm_unreachable("unsupported element type");
 }
@@ -555,12 +574,336 @@ Value emitScalarOpFor<ONNXLessOp>(ConversionPatternRewriter &rewriter,
   }
 }
 
+//===----------------------------------------------------------------------===//
+// Scalar unary ops for lowering ONNXGeluOp
+//===----------------------------------------------------------------------===//
+template <>
+Value emitScalarOpFor<ONNXGeluOp>(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands) {
+  // ONNXGeluOp(%X) = 0.5 * %X * (1 + erf(%X / sqrt(2))), with erf(%Z)
+  // approximated by formula 7.1.26 of Abramowitz and Stegun, whose absolute
+  // error is below 1.5e-7:
+  //   %T = 1 / (1 + p * |%Z|)
+  //   erf(|%Z|) = 1 - (a1 * %T + ... + a5 * %T^5) * exp(-%Z * %Z)
+  // and the sign of %Z restored with a select.
+  Value operand = scalarOperands[0];
+
+  auto zero = emitConstantOp(rewriter, loc, elementType, 0);
+  auto half = emitConstantOp(rewriter, loc, elementType, 0.5);
+  auto one = emitConstantOp(rewriter, loc, elementType, 1);
+  auto z = rewriter.create<MulFOp>(loc, operand,
+      emitConstantOp(rewriter, loc, elementType, 0.70710678118654752));
+  auto absZ = rewriter.create<AbsFOp>(loc, z);
+  auto t = rewriter.create<DivFOp>(loc, one,
+      rewriter.create<AddFOp>(loc, one,
+          rewriter.create<MulFOp>(loc, absZ,
+              emitConstantOp(rewriter, loc, elementType, 0.3275911))));
+  // Horner evaluation of the polynomial in %T.
+  const double coefficients[] = {1.061405429, -1.453152027, 1.421413741,
+      -0.284496736, 0.254829592};
+  Value poly = emitConstantOp(rewriter, loc, elementType, coefficients[0]);
+  for (unsigned i = 1; i < 5; ++i)
+    poly = rewriter.create<AddFOp>(loc, rewriter.create<MulFOp>(loc, poly, t),
+        emitConstantOp(rewriter, loc, elementType, coefficients[i]));
+  poly = rewriter.create<MulFOp>(loc, poly, t);
+  auto negSquare = rewriter.create<SubFOp>(
+      loc, zero, rewriter.create<MulFOp>(loc, z, z));
+  auto absErf = rewriter.create<SubFOp>(
+      loc, one, rewriter.create<MulFOp>(
+                    loc, poly, rewriter.create<ExpOp>(loc, negSquare)));
+  auto lessThanZero =
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, z, zero);
+  auto erf = rewriter.create<SelectOp>(loc, lessThanZero,
+      rewriter.create<SubFOp>(loc, zero, absErf), absErf);
+  auto result = rewriter.create<MulFOp>(loc,
+      rewriter.create<MulFOp>(loc, half, operand),
+      rewriter.create<AddFOp>(loc, one, erf));
+
+  return result;
+}
+
+//===----------------------------------------------------------------------===//
+// Scalar unary ops for lowering ONNXFastGeluOp
+//===----------------------------------------------------------------------===//
+template <>
+Value emitScalarOpFor<ONNXFastGeluOp>(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands) {
+  // 0.5 * (1 + tanh(%U)) is the sigmoid of 2 * %U, so
+  // ONNXFastGeluOp(%X) = DivFOp(%X, AddFOp(ConstantOp 1, ExpOp(-2 * %U)))
+  // with %U = sqrt(2 / pi) * (%X + 0.044715 * %X^3).
+  Value operand = scalarOperands[0];
+
+  auto one = emitConstantOp(rewriter, loc, elementType, 1);
+  auto square = rewriter.create<MulFOp>(loc, operand, operand);
+  auto inner = rewriter.create<MulFOp>(loc, operand,
+      rewriter.create<AddFOp>(loc, one,
+          rewriter.create<MulFOp>(loc, square,
+              emitConstantOp(rewriter, loc, elementType, 0.044715))));
+  // -2 * sqrt(2 / pi)
+  auto negTwoU = rewriter.create<MulFOp>(loc, inner,
+      emitConstantOp(rewriter, loc, elementType, -1.5957691216057308));
+  auto result = rewriter.create<DivFOp>(loc, operand,
+      rewriter.create<AddFOp>(
+          loc, one, rewriter.create<ExpOp>(loc, negTwoU)));
+
+  return result;
+}
+
+//===----------------------------------------------------------------------===//
+// Element-wise ops whose scalar computation is also valid on vectors of
+// floating-point values.
+//===----------------------------------------------------------------------===//
+template <typename Op>
+struct VectorizableOp {
+  static const bool value = false;
+};
+
+#define DECLARE_VECTORIZABLE_OP(ONNX_OP)                                       \
+  template <>                                                                  \
+  struct VectorizableOp<ONNX_OP> {                                             \
+    static const bool value = true;                                            \
+  };
+
+DECLARE_VECTORIZABLE_OP(ONNXAddOp)
+DECLARE_VECTORIZABLE_OP(ONNXCosOp)
+DECLARE_VECTORIZABLE_OP(ONNXDivOp)
+DECLARE_VECTORIZABLE_OP(ONNXExpOp)
+DECLARE_VECTORIZABLE_OP(ONNXFastGeluOp)
+DECLARE_VECTORIZABLE_OP(ONNXGeluOp)
+DECLARE_VECTORIZABLE_OP(ONNXLogOp)
+DECLARE_VECTORIZABLE_OP(ONNXMaxOp)
+DECLARE_VECTORIZABLE_OP(ONNXMinOp)
+DECLARE_VECTORIZABLE_OP(ONNXMulOp)
+DECLARE_VECTORIZABLE_OP(ONNXReluOp)
+DECLARE_VECTORIZABLE_OP(ONNXSigmoidOp)
+DECLARE_VECTORIZABLE_OP(ONNXSqrtOp)
+DECLARE_VECTORIZABLE_OP(ONNXSubOp)
+DECLARE_VECTORIZABLE_OP(ONNXSumOp)
+
+#undef DECLARE_VECTORIZABLE_OP
+
+// Return the number of elements per vector if the element-wise operation can
+// be emitted with vectors of `vectorBits` bits, or 0 otherwise. The operands
+// must have the type of the result (no broadcasting), with static shapes and a
+// floating-point element type, and the innermost dimension must hold at least
+// one vector.
+template <typename ElementwiseOp>
+int64_t getElementwiseVectorWidth(
+    MemRefType memRefType, ArrayRef<Value> operands, int64_t vectorBits) {
+  if (!VectorizableOp<ElementwiseOp>::value || vectorBits <= 0)
+    return 0;
+  auto elementType = memRefType.getElementType();
+  if (!elementType.isa<FloatType>() || memRefType.getRank() == 0 ||
+      !hasAllConstantDimensions(memRefType))
+    return 0;
+  if (!llvm::all_of(
+          operands, [&](Value v) { return v.getType() == memRefType; }))
+    return 0;
+  int64_t vectorWidth = vectorBits / elementType.getIntOrFloatBitWidth();
+  if (vectorWidth < 2 || memRefType.getShape().back() < vectorWidth)
+    return 0;
+  return vectorWidth;
+}
+
+// Test if the loops of an element-wise operation are fully unrolled, i.e. if
+// its result has a static shape of at most `unrollThreshold` elements.
+bool isElementwiseFullyUnrolled(MemRefType memRefType,
+    ArrayRef<Value> operands, int64_t unrollThreshold) {
+  if (!memRefType.hasStaticShape())
+    return false;
+  return isFullyUnrolled(
+      operands, memRefType.getNumElements(), unrollThreshold);
+}
+
+// Emit the loop nests of an element-wise operation whose innermost dimension
+// is processed by vectors of `vectorWidth` elements, followed by a scalar loop
+// for the remaining elements. `emitComputation` emits the computation for a
+// given (vector or scalar) type and loaded operands. With `unroll`, the loops
+// are fully unrolled instead of parallelized.
+void emitVectorizedElementwiseLoops(ConversionPatternRewriter &rewriter,
+    Location loc, ArrayRef<Value> operands, Value alloc, int64_t vectorWidth,
+    llvm::function_ref<Value(Type, ArrayRef<Value>)> emitComputation,
+    bool unroll = false) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  auto shape = memRefType.getShape();
+  int64_t rank = shape.size();
+  int64_t numVectors = shape[rank - 1] / vectorWidth;
+  auto vectorType = VectorType::get({vectorWidth}, elementType);
+
+  // Map the induction variable of the innermost loop to the first element of
+  // a vector.
+  SmallVector<AffineExpr, 4> vectorExprs;
+  for (int i = 0; i < rank - 1; ++i)
+    vectorExprs.emplace_back(rewriter.getAffineDimExpr(i));
+  vectorExprs.emplace_back(rewriter.getAffineDimExpr(rank - 1) * vectorWidth);
+  auto vectorMap = AffineMap::get(rank, 0, vectorExprs, rewriter.getContext());
+
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop vectorLoops(rewriter, loc, rank);
+    vectorLoops.createDefineOp();
+    if (unroll)
+      emitFullUnroll(rewriter, loc, vectorLoops.getOriginalLoops());
+    else
+      vectorLoops.parallelize(0);
+    for (int i = 0; i < rank - 1; ++i)
+      vectorLoops.pushBounds(0, alloc, i);
+    vectorLoops.pushBounds(0, numVectors);
+    vectorLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(vectorLoops.getIterateBlock());
+
+    SmallVector<Value, 4> loopIVs;
+    for (auto arg : vectorLoops.getAllInductionVar())
+      loopIVs.emplace_back(arg);
+    SmallVector<Value, 4> loadedVals;
+    for (auto operand : operands)
+      loadedVals.emplace_back(rewriter.create<AffineVectorLoadOp>(
+          loc, vectorType, operand, vectorMap, loopIVs));
+    Value result = emitComputation(vectorType, loadedVals);
+    rewriter.create<AffineVectorStoreOp>(
+        loc, result, alloc, vectorMap, loopIVs);
+  }
+
+  // Scalar loop for the remaining elements of the innermost dimension.
+  if (shape[rank - 1] % vectorWidth != 0) {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop remainderLoops(rewriter, loc, rank);
+    remainderLoops.createDefineOp();
+    if (unroll)
+      emitFullUnroll(rewriter, loc, remainderLoops.getOriginalLoops());
+    for (int i = 0; i < rank - 1; ++i)
+      remainderLoops.pushBounds(0, alloc, i);
+    remainderLoops.pushBounds(numVectors * vectorWidth, shape[rank - 1]);
+    remainderLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(remainderLoops.getIterateBlock());
+
+    SmallVector<Value, 4> loopIVs;
+    for (auto arg : remainderLoops.getAllInductionVar())
+      loopIVs.emplace_back(arg);
+    SmallVector<Value, 4> loadedVals;
+    for (auto operand : operands)
+      loadedVals.emplace_back(
+          rewriter.create<AffineLoadOp>(loc, operand, loopIVs));
+    Value result = emitComputation(elementType, loadedVals);
+    rewriter.create<AffineStoreOp>(loc, result, alloc, loopIVs);
+  }
+}
+
+// Return the number of outer dimensions of the result after which an operand
+// is broadcast along all the remaining dimensions, i.e. the depth of the loop
+// nest from which its value is invariant. The operand dimensions must be
+// statically known to be 1 to be broadcast.
+int64_t getBroadcastInvariantDepth(MemRefType memRefType, Value operand) {
+  int64_t rank = memRefType.getRank();
+  auto shape = operand.getType().cast<MemRefType>().getShape();
+  int64_t rankOffset = rank - shape.size();
+  int64_t depth = rank;
+  while (depth > 0 &&
+         (depth - 1 < rankOffset || shape[depth - 1 - rankOffset] == 1))
+    --depth;
+  return depth;
+}
+
+// Emit the loop nest of an element-wise operation with broadcasting. The
+// operands broadcast along the innermost dimensions, such as biases or
+// per-channel scales, are loaded once per iteration of the loops outside of
+// these dimensions instead of once per element. `emitComputation` emits the
+// computation of a result element from the loaded operands. With `unroll`, the
+// loops are fully unrolled instead of parallelized.
+void emitBroadcastingElementwiseLoops(ConversionPatternRewriter &rewriter,
+    Location loc, ArrayRef<Value> operands, Value alloc,
+    llvm::function_ref<Value(ArrayRef<Value>)> emitComputation,
+    bool unroll = false) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  int64_t rank = memRefType.getRank();
+  bool isStatic = hasAllConstantDimensions(memRefType);
+  std::map<int, std::map<int, Value>> broadcastedDimInfo;
+  if (!hasAllScalarValues(operands))
+    // Get run-time dimension information for unknown dimensions used for
+    // broadcasting.
+    broadcastedDimInfo =
+        getBroadcastedDimInfo(loc, rewriter, memRefType, operands);
+
+  // Split the loop nest at the deepest level from which an operand is
+  // invariant, when there is one.
+  SmallVector<int64_t, 4> invariantDepths;
+  int64_t outerRank = 0;
+  for (auto operand : operands) {
+    int64_t depth = getBroadcastInvariantDepth(memRefType, operand);
+    invariantDepths.emplace_back(depth);
+    if (depth < rank)
+      outerRank = std::max(outerRank, depth);
+  }
+
+  // The induction variables of the loops, filled as the loops are created.
+  SmallVector<Value, 4> loopIVs(rank);
+  SmallVector<Value, 4> loadedVals(operands.size());
+  auto emitLoad = [&](int i) {
+    std::vector<Value> operandIVs = getLoopIVsForBroadcasting(
+        loc, rewriter, loopIVs, operands[i], broadcastedDimInfo[i]);
+    if (isStatic)
+      loadedVals[i] =
+          rewriter.create<AffineLoadOp>(loc, operands[i], operandIVs);
+    else
+      // In case of unknown dimensions, use std.load since
+      // 'getLoopIVsForBroadcasting' has not supported affine map so far.
+      loadedVals[i] = rewriter.create<LoadOp>(loc, operands[i], operandIVs);
+  };
+  auto emitLoops = [&](int64_t begin, int64_t end) {
+    BuildKrnlLoop loops(rewriter, loc, end - begin);
+    loops.createDefineOp();
+    for (int64_t d = begin; d < end; ++d)
+      loops.pushBounds(0, alloc, d);
+    // Iterations of the outermost loop are independent.
+    if (unroll)
+      emitFullUnroll(rewriter, loc, loops.getOriginalLoops());
+    else if (begin == 0)
+      loops.parallelize(0);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    for (int64_t d = begin; d < end; ++d)
+      loopIVs[d] = loops.getInductionVar(d - begin);
+  };
+
+  if (outerRank > 0)
+    emitLoops(0, outerRank);
+  // The loop-invariant operands only use the outer induction variables.
+  for (unsigned i = 0; i < operands.size(); ++i)
+    if (invariantDepths[i] <= outerRank && invariantDepths[i] < rank)
+      emitLoad(i);
+  if (outerRank < rank)
+    emitLoops(outerRank, rank);
+  for (unsigned i = 0; i < operands.size(); ++i)
+    if (!loadedVals[i])
+      emitLoad(i);
+
+  Value result = emitComputation(loadedVals);
+  rewriter.create<AffineStoreOp>(loc, result, alloc, loopIVs);
+}
+
 // Element-wise unary ops lowering to Krnl dialect.
 //===----------------------------------------------------------------------===//
 template <typename ElementwiseUnaryOp>
 struct ONNXElementwiseUnaryOpLowering : public ConversionPattern {
-  ONNXElementwiseUnaryOpLowering(MLIRContext *ctx)
-      : ConversionPattern(ElementwiseUnaryOp::getOperationName(), 1, ctx) {}
+  ONNXElementwiseUnaryOpLowering(MLIRContext *ctx, int64_t vectorBits = 0,
+      bool inPlace = false, int64_t unrollThreshold = 0)
+      : ConversionPattern(ElementwiseUnaryOp::getOperationName(), 1, ctx),
+        vectorBits(vectorBits), inPlace(inPlace),
+        unrollThreshold(unrollThreshold) {}
+
+  // Number of bits of the vectors used for the innermost dimension, 0 if the
+  // operation is not vectorized.
+  int64_t vectorBits;
+
+  // Whether the result may reuse the buffer of an input with no other use.
+  bool inPlace;
+
+  // Maximum number of elements of the results whose loops are fully unrolled.
+  int64_t unrollThreshold;
+
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const final {
     // TODO: Check that the types are valid.
@@ -581,17 +924,41 @@ struct ONNXElementwiseUnaryOpLowering : public ConversionPattern {
     Value alloc;
     bool insertDealloc = checkInsertDealloc(op);
 
-    if (hasAllConstantDimensions(memRefType))
+    // The result overwrites the input if it has no other use.
+    if (inPlace)
+      alloc = getInPlaceOperand(op, operands, memRefType,
+          /*mayBroadcast=*/false);
+    if (!alloc && hasAllConstantDimensions(memRefType))
       alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
-    else
+    else if (!alloc)
       alloc =
           insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc, {X});
 
+    bool unroll =
+        isElementwiseFullyUnrolled(memRefType, operands, unrollThreshold);
+    if (int64_t vectorWidth = getElementwiseVectorWidth<ElementwiseUnaryOp>(
+            memRefType, operands, vectorBits)) {
+      emitVectorizedElementwiseLoops(
+          rewriter, loc, {X}, alloc, vectorWidth,
+          [&](Type type, ArrayRef<Value> loadedVals) {
+            return emitScalarOpFor<ElementwiseUnaryOp>(
+                rewriter, loc, op, type, loadedVals);
+          },
+          unroll);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+
     SmallVector<Value, 4> loopIVs;
     if (!hasAllScalarValues(operands)) {
       // Create iterateOp & get block within iterate op.
       BuildKrnlLoop loops(rewriter, loc, memRefType.getRank());
       loops.createDefineAndIterateOp(X);
+      // Iterations of the outermost loop are independent.
+      if (unroll)
+        emitFullUnroll(rewriter, loc, loops.getOriginalLoops());
+      else
+        loops.parallelize(0);
       Block *iterationBlock = loops.getIterateBlock();
 
       // Insert instructions inside the KernelIterateOp body.
@@ -619,8 +986,14 @@ struct ONNXElementwiseUnaryOpLowering : public ConversionPattern {
 //===----------------------------------------------------------------------===//
 template <typename ElementwiseBinaryOp>
 struct ONNXElementwiseBinaryOpLowering : public ConversionPattern {
-  ONNXElementwiseBinaryOpLowering(MLIRContext *ctx)
-      : ConversionPattern(ElementwiseBinaryOp::getOperationName(), 1, ctx) {}
+  ONNXElementwiseBinaryOpLowering(
+      MLIRContext *ctx, int64_t unrollThreshold = 0)
+      : ConversionPattern(ElementwiseBinaryOp::getOperationName(), 1, ctx),
+        unrollThreshold(unrollThreshold) {}
+
+  // Maximum number of elements of the results whose loops are fully unrolled.
+  int64_t unrollThreshold;
+
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const final {
     auto loc = op->getLoc();
@@ -642,53 +1015,13 @@ struct ONNXElementwiseBinaryOpLowering : public ConversionPattern {
       alloc = insertAllocAndDealloc(
           memRefType, loc, rewriter, insertDealloc, operands);
 
-    SmallVector<Value, 4> loopIVs;
-    std::map<int, std::map<int, Value>> broadcastedDimInfo;
-    if (!hasAllScalarValues(operands)) {
-      // Get run-time dimension information for unknown dimensions used for
-      // broadcasting.
-      broadcastedDimInfo =
-          getBroadcastedDimInfo(loc, rewriter, memRefType, operands);
-
-      // Create iterateOp & get block within iterate op.
-      BuildKrnlLoop loops(rewriter, loc, memRefType.getRank());
-      loops.createDefineAndIterateOp(alloc);
-      Block *iterationBlock = loops.getIterateBlock();
-
-      // Insert instructions inside the KernelIterateOp body.
-      rewriter.setInsertionPointToStart(iterationBlock);
-
-      // Handle the operation:
-      for (auto arg : iterationBlock->getArguments())
-        loopIVs.push_back(arg);
-    }
-    // Fold over operands for each of their scalar values.
-    Value lhs, rhs;
-    // Obtain the first operand.
-    std::vector<Value> lhsLoopIVs = getLoopIVsForBroadcasting(
-        loc, rewriter, loopIVs, operands[0], broadcastedDimInfo[0]);
-    if (!hasAllConstantDimensions(memRefType))
-      // In case of unknown dimensions, use std.load since
-      // 'getLoopIVsForBroadcasting' has not supported affine map so far.
-      lhs = rewriter.create<LoadOp>(loc, operands[0], lhsLoopIVs);
-    else
-      lhs = rewriter.create<AffineLoadOp>(loc, operands[0], lhsLoopIVs);
-    // Obtain the second operand.
-    std::vector<Value> rhsLoopIVs = getLoopIVsForBroadcasting(
-        loc, rewriter, loopIVs, operands[1], broadcastedDimInfo[1]);
-    if (!hasAllConstantDimensions(memRefType))
-      // In case of unknown dimensions, use std.load since
-      // 'getLoopIVsForBroadcasting' has not supported affine map so far.
-      rhs = rewriter.create<LoadOp>(loc, operands[1], rhsLoopIVs);
-    else
-      rhs = rewriter.create<AffineLoadOp>(loc, operands[1], rhsLoopIVs);
-
-    // Apply the element-wise function.
-    Value result = emitScalarOpFor<ElementwiseBinaryOp>(
-        rewriter, loc, op, memRefType.getElementType(), {lhs, rhs});
-
-    // Store result in the resulting array.
-    rewriter.create<AffineStoreOp>(loc, result, alloc, loopIVs);
+    emitBroadcastingElementwiseLoops(
+        rewriter, loc, operands, alloc,
+        [&](ArrayRef<Value> loadedVals) {
+          return emitScalarOpFor<ElementwiseBinaryOp>(rewriter, loc, op,
+              memRefType.getElementType(), {loadedVals[0], loadedVals[1]});
+        },
+        isElementwiseFullyUnrolled(memRefType, operands, unrollThreshold));
 
     rewriter.replaceOp(op, alloc);
 
@@ -700,8 +1033,22 @@ struct ONNXElementwiseBinaryOpLowering : public ConversionPattern {
 //===----------------------------------------------------------------------===//
 template <typename ElementwiseVariadicOp>
 struct ONNXElementwiseVariadicOpLowering : public ConversionPattern {
-  ONNXElementwiseVariadicOpLowering(MLIRContext *ctx)
-      : ConversionPattern(ElementwiseVariadicOp::getOperationName(), 1, ctx) {}
+  ONNXElementwiseVariadicOpLowering(MLIRContext *ctx, int64_t vectorBits = 0,
+      bool inPlace = false, int64_t unrollThreshold = 0)
+      : ConversionPattern(ElementwiseVariadicOp::getOperationName(), 1, ctx),
+        vectorBits(vectorBits), inPlace(inPlace),
+        unrollThreshold(unrollThreshold) {}
+
+  // Number of bits of the vectors used for the innermost dimension, 0 if the
+  // operation is not vectorized.
+  int64_t vectorBits;
+
+  // Whether the result may reuse the buffer of an input with no other use.
+  bool inPlace;
+
+  // Maximum number of elements of the results whose loops are fully unrolled.
+  int64_t unrollThreshold;
+
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const final {
     // TODO: Check that the types are valid.
@@ -720,70 +1067,210 @@ struct ONNXElementwiseVariadicOpLowering : public ConversionPattern {
     // In particular, we need to know from which operand a result dimension
     // comes from.
     // TODO: can the dimension of the result differ after optimizations?
-    if (hasAllConstantDimensions(memRefType))
+    // The result overwrites an input which has no other use and is not
+    // broadcast.
+    if (inPlace)
+      alloc = getInPlaceOperand(op, operands, memRefType,
+          /*mayBroadcast=*/true);
+    if (!alloc && hasAllConstantDimensions(memRefType))
       alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
-    else
+    else if (!alloc)
       alloc = insertAllocAndDealloc(
           memRefType, loc, rewriter, insertDealloc, operands);
 
-    SmallVector<Value, 4> loopIVs;
-    std::map<int, std::map<int, Value>> broadcastedDimInfo;
-    if (!hasAllScalarValues(operands)) {
-      // Get run-time dimension information for unknown dimensions used for
-      // broadcasting.
-      broadcastedDimInfo =
-          getBroadcastedDimInfo(loc, rewriter, memRefType, operands);
+    bool unroll =
+        isElementwiseFullyUnrolled(memRefType, operands, unrollThreshold);
+    if (int64_t vectorWidth =
+            getElementwiseVectorWidth<ElementwiseVariadicOp>(
+                memRefType, operands, vectorBits)) {
+      emitVectorizedElementwiseLoops(
+          rewriter, loc, operands, alloc, vectorWidth,
+          [&](Type type, ArrayRef<Value> loadedVals) {
+            Value accumulated = loadedVals[0];
+            for (unsigned i = 1; i < numArgs; i++)
+              accumulated = emitScalarOpFor<ElementwiseVariadicOp>(
+                  rewriter, loc, op, type, {accumulated, loadedVals[i]});
+            return accumulated;
+          },
+          unroll);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
 
-      // Create iterateOp & get block within iterate op.
-      BuildKrnlLoop loops(rewriter, loc, memRefType.getRank());
-      loops.createDefineAndIterateOp(alloc);
-      Block *iterationBlock = loops.getIterateBlock();
+    emitBroadcastingElementwiseLoops(
+        rewriter, loc, operands, alloc,
+        [&](ArrayRef<Value> loadedVals) {
+          // Fold over operands for each of their scalar values.
+          Value accumulated = loadedVals[0];
+          for (unsigned i = 1; i < numArgs; i++)
+            accumulated = emitScalarOpFor<ElementwiseVariadicOp>(rewriter,
+                loc, op, memRefType.getElementType(),
+                {accumulated, loadedVals[i]});
+          return accumulated;
+        },
+        unroll);
 
-      // Insert instructions inside the KernelIterateOp body.
-      rewriter.setInsertionPointToStart(iterationBlock);
+    rewriter.replaceOp(op, alloc);
 
-      // Handle the operation:
-      for (auto arg : iterationBlock->getArguments())
-        loopIVs.push_back(arg);
-    }
-    // Fold over operands for each of their scalar values.
-    Value accumulated, next;
-    // Obtain the first operand.
-    std::vector<Value> accumulatedLoopIVs = getLoopIVsForBroadcasting(
-        loc, rewriter, loopIVs, operands[0], broadcastedDimInfo[0]);
-    if (!hasAllConstantDimensions(memRefType))
-      // In case of unknown dimensions, use std.load since
-      // 'getLoopIVsForBroadcasting' has not supported affine map so far.
-      accumulated =
-          rewriter.create<LoadOp>(loc, operands[0], accumulatedLoopIVs);
+    return success();
+  }
+};
+
+// Element-wise fused ops lowering to Krnl dialect.
+//===----------------------------------------------------------------------===//
+
+// Fold the scalar computation of a variadic operation over its operands.
+template <typename ElementwiseVariadicOp>
+Value emitFoldedScalarOpFor(ConversionPatternRewriter &rewriter, Location loc,
+    Operation *op, Type elementType, ArrayRef<Value> scalarOperands) {
+  Value accumulated = scalarOperands[0];
+  for (unsigned i = 1; i < scalarOperands.size(); i++)
+    accumulated = emitScalarOpFor<ElementwiseVariadicOp>(
+        rewriter, loc, op, elementType, {accumulated, scalarOperands[i]});
+  return accumulated;
+}
+
+// Emit the scalar computation of a member of a fused element-wise operation.
+Value emitFusedMemberScalarOp(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands) {
+#define EMIT_UNARY_MEMBER(ONNX_OP)                                             \
+  if (isa<ONNX_OP>(op))                                                        \
+    return emitScalarOpFor<ONNX_OP>(                                           \
+        rewriter, loc, op, elementType, scalarOperands);
+#define EMIT_VARIADIC_MEMBER(ONNX_OP)                                          \
+  if (isa<ONNX_OP>(op))                                                        \
+    return emitFoldedScalarOpFor<ONNX_OP>(                                     \
+        rewriter, loc, op, elementType, scalarOperands);
+
+  EMIT_UNARY_MEMBER(ONNXAbsOp)
+  EMIT_VARIADIC_MEMBER(ONNXAddOp)
+  EMIT_VARIADIC_MEMBER(ONNXAndOp)
+  EMIT_UNARY_MEMBER(ONNXCastOp)
+  EMIT_UNARY_MEMBER(ONNXCosOp)
+  EMIT_UNARY_MEMBER(ONNXCoshOp)
+  EMIT_VARIADIC_MEMBER(ONNXDivOp)
+  EMIT_UNARY_MEMBER(ONNXEluOp)
+  EMIT_UNARY_MEMBER(ONNXExpOp)
+  EMIT_UNARY_MEMBER(ONNXFastGeluOp)
+  EMIT_UNARY_MEMBER(ONNXGeluOp)
+  EMIT_UNARY_MEMBER(ONNXHardSigmoidOp)
+  EMIT_UNARY_MEMBER(ONNXLeakyReluOp)
+  EMIT_UNARY_MEMBER(ONNXLogOp)
+  EMIT_VARIADIC_MEMBER(ONNXMaxOp)
+  EMIT_VARIADIC_MEMBER(ONNXMinOp)
+  EMIT_VARIADIC_MEMBER(ONNXMulOp)
+  EMIT_UNARY_MEMBER(ONNXNegOp)
+  EMIT_VARIADIC_MEMBER(ONNXOrOp)
+  EMIT_UNARY_MEMBER(ONNXReciprocalOp)
+  EMIT_UNARY_MEMBER(ONNXReluOp)
+  EMIT_UNARY_MEMBER(ONNXSeluOp)
+  EMIT_UNARY_MEMBER(ONNXSigmoidOp)
+  EMIT_UNARY_MEMBER(ONNXSignOp)
+  EMIT_UNARY_MEMBER(ONNXSinhOp)
+  EMIT_UNARY_MEMBER(ONNXSoftplusOp)
+  EMIT_UNARY_MEMBER(ONNXSoftsignOp)
+  EMIT_UNARY_MEMBER(ONNXSqrtOp)
+  EMIT_VARIADIC_MEMBER(ONNXSubOp)
+  EMIT_VARIADIC_MEMBER(ONNXSumOp)
+  EMIT_UNARY_MEMBER(ONNXTanhOp)
+  EMIT_VARIADIC_MEMBER(ONNXXorOp)
+
+#undef EMIT_UNARY_MEMBER
+#undef EMIT_VARIADIC_MEMBER
+
+  llvm_unreachable("unsupported member of a fused element-wise operation");
+}
+
+struct ONNXFusedElementwiseOpLowering : public ConversionPattern {
+  ONNXFusedElementwiseOpLowering(
+      MLIRContext *ctx, bool inPlace = false, int64_t unrollThreshold = 0)
+      : ConversionPattern(
+            mlir::ONNXFusedElementwiseOp::getOperationName(), 1, ctx),
+        inPlace(inPlace), unrollThreshold(unrollThreshold) {}
+
+  // Whether the result may reuse the buffer of an input with no other use.
+  bool inPlace;
+
+  // Maximum number of elements of the results whose loops are fully unrolled.
+  int64_t unrollThreshold;
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    // The inputs and all the values computed by the members of the fused
+    // operation have the shape of the result, see the element-wise fusion
+    // pass. Their element types only differ across casts.
+    auto fusedOp = llvm::dyn_cast<ONNXFusedElementwiseOp>(op);
+    auto loc = op->getLoc();
+
+    // Insert an allocation and deallocation for the result of this operation.
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+
+    Value alloc;
+    bool insertDealloc = checkInsertDealloc(op);
+    // The inputs are loaded before the result is stored at each iteration,
+    // the result overwrites an input which has no other use.
+    if (inPlace)
+      alloc = getInPlaceOperand(op, operands, memRefType,
+          /*mayBroadcast=*/false);
+    if (!alloc && hasAllConstantDimensions(memRefType))
+      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+    else if (!alloc)
+      alloc = insertAllocAndDealloc(
+          memRefType, loc, rewriter, insertDealloc, {operands[0]});
+
+    // Create a single loop nest for all the members of the fused operation.
+    BuildKrnlLoop loops(rewriter, loc, memRefType.getRank());
+    loops.createDefineAndIterateOp(alloc);
+    // Iterations of the outermost loop are independent.
+    if (isElementwiseFullyUnrolled(memRefType, operands, unrollThreshold))
+      emitFullUnroll(rewriter, loc, loops.getOriginalLoops());
     else
-      accumulated =
-          rewriter.create<AffineLoadOp>(loc, operands[0], accumulatedLoopIVs);
-    // Iterate over the remaining operands.
-    for (unsigned i = 1; i < numArgs; i++) {
-      std::vector<Value> nextLoopIVs = getLoopIVsForBroadcasting(
-          loc, rewriter, loopIVs, operands[i], broadcastedDimInfo[i]);
-      if (!hasAllConstantDimensions(memRefType))
-        // In case of unknown dimensions, use std.load since
-        // 'getLoopIVsForBroadcasting' has not supported affine map so far.
-        next = rewriter.create<LoadOp>(loc, operands[i], nextLoopIVs);
-      else
-        next = rewriter.create<AffineLoadOp>(loc, operands[i], nextLoopIVs);
-      accumulated = emitScalarOpFor<ElementwiseVariadicOp>(
-          rewriter, loc, op, memRefType.getElementType(), {accumulated, next});
+      loops.parallelize(0);
+    Block *iterationBlock = loops.getIterateBlock();
+    rewriter.setInsertionPointToStart(iterationBlock);
+
+    SmallVector<Value, 4> loopIVs;
+    for (auto arg : iterationBlock->getArguments())
+      loopIVs.push_back(arg);
+
+    // Load the inputs, then compute the members in order on scalars of their
+    // own element types, so that the casts of the inputs apply to the loaded
+    // scalars and the casts of the value of the chain to the stored one.
+    Block &body = fusedOp.body().front();
+    BlockAndValueMapping scalars;
+    for (auto arg : llvm::enumerate(body.getArguments()))
+      scalars.map(arg.value(),
+          rewriter.create<AffineLoadOp>(loc, operands[arg.index()], loopIVs));
+    for (auto &member : body.without_terminator()) {
+      SmallVector<Value, 4> scalarOperands;
+      for (auto memberOperand : member.getOperands())
+        scalarOperands.emplace_back(scalars.lookup(memberOperand));
+      auto memberElementType =
+          member.getResult(0).getType().cast<ShapedType>().getElementType();
+      scalars.map(member.getResult(0),
+          emitFusedMemberScalarOp(
+              rewriter, loc, &member, memberElementType, scalarOperands));
     }
 
     // Store result in the resulting array.
-    rewriter.create<AffineStoreOp>(loc, accumulated, alloc, loopIVs);
+    auto yieldOp =
+        llvm::cast<ONNXFusedElementwiseYieldOp>(body.getTerminator());
+    rewriter.create<AffineStoreOp>(
+        loc, scalars.lookup(yieldOp.value()), alloc, loopIVs);
 
     rewriter.replaceOp(op, alloc);
-
     return success();
   }
 };
 
 void populateLoweringONNXElementwiseOpPattern(
-    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+    OwningRewritePatternList &patterns, MLIRContext *ctx, int64_t vectorBits,
+    bool inPlace, int64_t unrollThreshold) {
+  patterns.insert<ONNXElementwiseBinaryOpLowering<mlir::ONNXLessOp>>(
+      ctx, unrollThreshold);
+  patterns.insert<ONNXFusedElementwiseOpLowering>(
+      ctx, inPlace, unrollThreshold);
   patterns.insert<ONNXElementwiseUnaryOpLowering<mlir::ONNXAbsOp>,
       ONNXElementwiseVariadicOpLowering<mlir::ONNXAddOp>,
       ONNXElementwiseVariadicOpLowering<mlir::ONNXAndOp>,
@@ -792,9 +1279,10 @@ void populateLoweringONNXElementwiseOpPattern(
       ONNXElementwiseVariadicOpLowering<mlir::ONNXDivOp>,
       ONNXElementwiseUnaryOpLowering<mlir::ONNXEluOp>,
       ONNXElementwiseUnaryOpLowering<mlir::ONNXExpOp>,
+      ONNXElementwiseUnaryOpLowering<mlir::ONNXFastGeluOp>,
+      ONNXElementwiseUnaryOpLowering<mlir::ONNXGeluOp>,
       ONNXElementwiseUnaryOpLowering<mlir::ONNXHardSigmoidOp>,
       ONNXElementwiseUnaryOpLowering<mlir::ONNXLeakyReluOp>,
-      ONNXElementwiseBinaryOpLowering<mlir::ONNXLessOp>,
       ONNXElementwiseUnaryOpLowering<mlir::ONNXLogOp>,
       ONNXElementwiseVariadicOpLowering<mlir::ONNXMaxOp>,
       ONNXElementwiseVariadicOpLowering<mlir::ONNXMinOp>,
@@ -814,5 +1302,6 @@ void populateLoweringONNXElementwiseOpPattern(
       ONNXElementwiseVariadicOpLowering<mlir::ONNXSumOp>,
       ONNXElementwiseUnaryOpLowering<mlir::ONNXTanhOp>,
       ONNXElementwiseUnaryOpLowering<mlir::ONNXCastOp>,
-      ONNXElementwiseVariadicOpLowering<mlir::ONNXXorOp>>(ctx);
+      ONNXElementwiseVariadicOpLowering<mlir::ONNXXorOp>>(
+      ctx, vectorBits, inPlace, unrollThreshold);
 }
@@ -13,10 +13,59 @@
 
 using namespace mlir;
 
+static int64_t gemmPackedID = 0;
+
+// Copy the transpose of a 2-D MemRef with static shape into a newly allocated
+// buffer, so that the rows of the buffer are the columns of the source. The
+// buffer is written contiguously. The transpose of a constant, e.g. the
+// weights of a layer, is computed at compile time into a Krnl global.
+static Value emitPackedTranspose(
+    ConversionPatternRewriter &rewriter, Location loc, Value src) {
+  auto srcType = src.getType().cast<MemRefType>();
+  auto srcShape = srcType.getShape();
+  auto packedType =
+      MemRefType::get({srcShape[1], srcShape[0]}, srcType.getElementType());
+
+  Attribute attr;
+  Operation *defOp = src.getDefiningOp();
+  if (auto constantOp = dyn_cast_or_null<ONNXConstantOp>(defOp))
+    attr = constantOp.valueAttr();
+  else if (auto globalOp = dyn_cast_or_null<KrnlGlobalOp>(defOp))
+    attr = globalOp.value().getValueOr(Attribute());
+  if (auto denseAttr = attr.dyn_cast_or_null<DenseElementsAttr>())
+    return rewriter.create<KrnlGlobalOp>(loc, packedType,
+        /*shape=*/rewriter.getI64ArrayAttr(packedType.getShape()),
+        /*name=*/
+        rewriter.getStringAttr("gemm_packed_" + std::to_string(gemmPackedID++)),
+        /*value=*/transposeMatrix(denseAttr),
+        /*offset=*/nullptr);
+
+  Value packed = insertAllocAndDealloc(packedType, loc, rewriter, true);
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  BuildKrnlLoop packLoops(rewriter, loc, 2);
+  packLoops.createDefineOp();
+  packLoops.parallelize(0);
+  packLoops.pushBounds(0, packed, 0);
+  packLoops.pushBounds(0, packed, 1);
+  packLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(packLoops.getIterateBlock());
+  Value i = packLoops.getInductionVar(0);
+  Value j = packLoops.getInductionVar(1);
+  auto loaded = rewriter.create<AffineLoadOp>(loc, src, ArrayRef<Value>{j, i});
+  rewriter.create<AffineStoreOp>(loc, loaded, packed, ArrayRef<Value>{i, j});
+  return packed;
+}
+
 template <typename GemmOp>
 struct ONNXGemmOpLowering : public ConversionPattern {
-  ONNXGemmOpLowering(MLIRContext *ctx)
-      : ConversionPattern(GemmOp::getOperationName(), 1, ctx) {}
+  ONNXGemmOpLowering(
+      MLIRContext *ctx, int64_t blasThreshold, int64_t unrollThreshold)
+      : ConversionPattern(GemmOp::getOperationName(), 1, ctx),
+        blasThreshold(blasThreshold), unrollThreshold(unrollThreshold) {}
+
+  int64_t blasThreshold;
+  int64_t unrollThreshold;
 
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const final {
@@ -31,10 +80,14 @@ struct ONNXGemmOpLowering : public ConversionPattern {
       C = operandAdaptor.C();
 
     auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto elementType = memRefType.getElementType();
+    // Half-precision results are accumulated in f32, and the operands are
+    // extended when loaded, so they may also be narrower than the result.
+    auto accElementType = getAccumulationType(elementType);
 
-    auto alphaAttr = FloatAttr::get(memRefType.getElementType(),
+    auto alphaAttr = FloatAttr::get(accElementType,
         llvm::dyn_cast<GemmOp>(op).alpha().convertToFloat());
-    auto betaAttr = FloatAttr::get(memRefType.getElementType(),
+    auto betaAttr = FloatAttr::get(accElementType,
         llvm::dyn_cast<GemmOp>(op).beta().convertToFloat());
     auto alpha = rewriter.create<ConstantOp>(loc, alphaAttr);
     auto beta = rewriter.create<ConstantOp>(loc, betaAttr);
@@ -66,6 +119,73 @@ struct ONNXGemmOpLowering : public ConversionPattern {
       }
     }
 
+    // Large products of static f32 matrices are left to the BLAS library,
+    // which adds the product to the bias broadcast into the result.
+    if (hasAllConstantDimensions(memRefType)) {
+      int64_t M = memRefType.getShape()[0], N = memRefType.getShape()[1];
+      int64_t K = A.getType().cast<MemRefType>().getShape()[isTransA ? 0 : 1];
+      SmallVector<Value, 4> memRefs = {A, B, alloc};
+      if (hasBias)
+        memRefs.emplace_back(C);
+      if (isBlasGemmProfitable(memRefs, M, N, K, blasThreshold)) {
+        if (hasBias) {
+          OpBuilder::InsertionGuard guard(rewriter);
+          BuildKrnlLoop biasLoops(rewriter, loc, 2);
+          biasLoops.createDefineOp();
+          biasLoops.pushBounds(0, M);
+          biasLoops.pushBounds(0, N);
+          biasLoops.parallelize(0);
+          biasLoops.createIterateOp();
+          rewriter.setInsertionPointToStart(biasLoops.getIterateBlock());
+          SmallVector<Value, 2> loopMNIVs(
+              biasLoops.getAllInductionVar().begin(),
+              biasLoops.getAllInductionVar().end());
+          auto loopCIVs =
+              getLoopIVsForBroadcasting(loc, rewriter, loopMNIVs, C, {});
+          Value loadedC = rewriter.create<AffineLoadOp>(loc, C, loopCIVs);
+          rewriter.create<AffineStoreOp>(loc, loadedC, alloc, loopMNIVs);
+        }
+        auto gemmOp = llvm::dyn_cast<GemmOp>(op);
+        emitBlasGemm(rewriter, loc, A, B, alloc, M, N, K,
+            gemmOp.alpha().convertToFloat(),
+            hasBias ? gemmOp.beta().convertToFloat() : 0, isTransA, isTransB);
+        rewriter.replaceOp(op, alloc);
+        return success();
+      }
+    }
+
+    Value acc = insertAccumulationBuffer(rewriter, loc, alloc);
+
+    // The loops of tiny products are fully unrolled into straight-line code,
+    // which reads the operands in place.
+    bool unroll = false;
+    if (hasAllConstantDimensions(memRefType)) {
+      int64_t M = memRefType.getShape()[0], N = memRefType.getShape()[1];
+      int64_t K = A.getType().cast<MemRefType>().getShape()[isTransA ? 0 : 1];
+      SmallVector<Value, 4> memRefs = {A, B};
+      if (hasBias)
+        memRefs.emplace_back(C);
+      unroll = isFullyUnrolled(memRefs, M * N * K, unrollThreshold);
+    }
+
+    // The reduction loop is the innermost one. When the shapes are known,
+    // A is packed as a M x K buffer and B as a N x K buffer, so that the
+    // reduction streams through contiguous memory whatever transA and transB
+    // are. An operand is only packed when it is reused, i.e. when the other
+    // dimension of the result is larger than 1.
+    if (!unroll && hasAllConstantDimensions(memRefType) &&
+        hasAllConstantDimensions(A.getType().cast<MemRefType>()) &&
+        hasAllConstantDimensions(B.getType().cast<MemRefType>())) {
+      if (isTransA && memRefType.getShape()[1] > 1) {
+        A = emitPackedTranspose(rewriter, loc, A);
+        isTransA = false;
+      }
+      if (!isTransB && memRefType.getShape()[0] > 1) {
+        B = emitPackedTranspose(rewriter, loc, B);
+        isTransB = true;
+      }
+    }
+
     // Number of loops
     auto memRefShape = memRefType.getShape();
     int64_t numLoops = 3;
@@ -73,6 +193,11 @@ struct ONNXGemmOpLowering : public ConversionPattern {
     // Define loops.
     std::vector<Value> originalLoops;
     defineLoops(rewriter, loc, originalLoops, numLoops);
+    // Rows of the output matrix are computed independently.
+    if (unroll)
+      emitFullUnroll(rewriter, loc, originalLoops);
+    else
+      rewriter.create<KrnlParallelOp>(loc, originalLoops[0]);
 
     // We have two Krnl loops:
     // - Outer loop iterates over the output matrix dimensions, and
@@ -144,26 +269,26 @@ struct ONNXGemmOpLowering : public ConversionPattern {
     }
 
     // Initialize the output of A * B
-    auto zero = emitConstantOp(rewriter, loc, memRefType.getElementType(), 0);
-    rewriter.create<AffineStoreOp>(loc, zero, alloc, loopMNIVs);
+    auto zero = emitConstantOp(rewriter, loc, accElementType, 0);
+    rewriter.create<AffineStoreOp>(loc, zero, acc, loopMNIVs);
 
     // Compute A * B
     auto matmulIterateOp = rewriter.create<KrnlIterateOp>(loc, reductionPack);
 
     // Compute beta * C, and add up to alpha * A * B (unidirectional
     // broadcasting)
-    auto loadedAB = rewriter.create<AffineLoadOp>(loc, alloc, loopMNIVs);
-    auto alphaAB = rewriter.create<MulFOp>(loc, alpha, loadedAB);
+    auto loadedAB = rewriter.create<AffineLoadOp>(loc, acc, loopMNIVs);
+    Value Y = rewriter.create<MulFOp>(loc, alpha, loadedAB);
     if (hasBias) {
       auto loopCIVs = getLoopIVsForBroadcasting(
           loc, rewriter, loopMNIVs, C, broadcastedDimInfo);
-      auto loadedC = rewriter.create<AffineLoadOp>(loc, C, loopCIVs);
+      Value loadedC = emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, C, loopCIVs), accElementType);
       auto betaC = rewriter.create<MulFOp>(loc, beta, loadedC);
-      auto Y = rewriter.create<AddFOp>(loc, alphaAB, betaC);
-      rewriter.create<AffineStoreOp>(loc, Y, alloc, loopMNIVs);
-    } else {
-      rewriter.create<AffineStoreOp>(loc, alphaAB, alloc, loopMNIVs);
+      Y = rewriter.create<AddFOp>(loc, Y, betaC);
     }
+    rewriter.create<AffineStoreOp>(loc,
+        emitConvertFloat(rewriter, loc, Y, elementType), alloc, loopMNIVs);
 
     // Insert instructions to do matrix multiplication: A * B
     Block &matmulIterationBlock = matmulIterateOp.bodyRegion().front();
@@ -189,12 +314,14 @@ struct ONNXGemmOpLowering : public ConversionPattern {
     }
 
     // Matmul computation
-    auto loadedA = rewriter.create<AffineLoadOp>(loc, A, loopAIVs);
-    auto loadedB = rewriter.create<AffineLoadOp>(loc, B, loopBIVs);
-    auto loadedY = rewriter.create<AffineLoadOp>(loc, alloc, loopMNIVs);
+    Value loadedA = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, A, loopAIVs), accElementType);
+    Value loadedB = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, B, loopBIVs), accElementType);
+    auto loadedY = rewriter.create<AffineLoadOp>(loc, acc, loopMNIVs);
     auto AB = rewriter.create<MulFOp>(loc, loadedA, loadedB);
     auto accumulated = rewriter.create<AddFOp>(loc, loadedY, AB);
-    rewriter.create<AffineStoreOp>(loc, accumulated, alloc, loopMNIVs);
+    rewriter.create<AffineStoreOp>(loc, accumulated, acc, loopMNIVs);
 
     rewriter.replaceOp(op, alloc);
 
@@ -202,7 +329,8 @@ struct ONNXGemmOpLowering : public ConversionPattern {
   }
 };
 
-void populateLoweringONNXGemmOpPattern(
-    OwningRewritePatternList &patterns, MLIRContext *ctx) {
-  patterns.insert<ONNXGemmOpLowering<ONNXGemmOp>>(ctx);
+void populateLoweringONNXGemmOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx, int64_t blasThreshold, int64_t unrollThreshold) {
+  patterns.insert<ONNXGemmOpLowering<ONNXGemmOp>>(
+      ctx, blasThreshold, unrollThreshold);
 }
@@ -8,18 +8,298 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+
+#include "llvm/ADT/StringSwitch.h"
+
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 using namespace mlir;
 
+// Return the indices of the batch dimensions of an operand of shape `shape`,
+// of which the two innermost dimensions are not batch dimensions, for the
+// batch of the result given by batchIVs. The batch dimensions of the operand
+// are aligned with the innermost batch dimensions of the result of shape
+// `resultShape`, those of size 1 broadcast along the result are indexed by 0.
+static SmallVector<Value, 4> getOperandBatchIVs(
+    ConversionPatternRewriter &rewriter, Location loc,
+    ArrayRef<int64_t> shape, ArrayRef<int64_t> resultShape,
+    ArrayRef<Value> batchIVs) {
+  int64_t numBatchDims = shape.size() - 2;
+  int64_t offset = batchIVs.size() - numBatchDims;
+  SmallVector<Value, 4> operandBatchIVs;
+  for (int64_t i = 0; i < numBatchDims; ++i) {
+    if (shape[i] == 1 && resultShape[offset + i] != 1)
+      operandBatchIVs.emplace_back(rewriter.create<ConstantIndexOp>(loc, 0));
+    else
+      operandBatchIVs.emplace_back(batchIVs[offset + i]);
+  }
+  return operandBatchIVs;
+}
+
+// Emit a tiled matrix multiplication of A (... x M x K) and B (... x K x N)
+// into the accumulators alloc (... x M x N) for the batch given by batchIVs.
+// All dimensions must be known at compile time. resultLoops are the loops over
+// the M and N dimensions of the result, they are used to fill the result with
+// zeros.
+//
+// The loops over M, N and K are blocked into cache tiles, the cache tiles over
+// M and N are blocked again into register tiles, and the loops are permuted
+// into (for the default "nkm" order of the loops over the cache tiles):
+//
+//   for jb = 0 .. N step Nc:           (parallel)
+//     for kb = 0 .. K step Kc:
+//       for ib = 0 .. M step Mc:
+//         for irb = ib .. ib + Mc step Mr:
+//           for jrb = jb .. jb + Nc step Nr:
+//             for k = kb .. kb + Kc:
+//               for i = irb .. irb + Mr:   (unrolled)
+//                 for j = jrb .. jrb + Nr: (unrolled)
+//                   R[i, j] += A[i, k] * B[k, j]
+static void emitTiledMatMul(ConversionPatternRewriter &rewriter, Location loc,
+    Value A, Value B, Value alloc, Value zero, ArrayRef<Value> batchIVs,
+    ArrayRef<Value> resultLoops, const MatMulTilingOptions &options) {
+  auto AShape = A.getType().cast<MemRefType>().getShape();
+  auto BShape = B.getType().cast<MemRefType>().getShape();
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  auto memRefShape = memRefType.getShape();
+  int64_t rank = memRefShape.size();
+
+  // Tile sizes cannot exceed the size of the dimensions they tile.
+  auto clampTileSize = [](int64_t tileSize, int64_t dimSize) {
+    return std::max<int64_t>(1, std::min(tileSize, dimSize));
+  };
+  int64_t cacheTileM = clampTileSize(options.cacheTileM, memRefShape[rank - 2]);
+  int64_t cacheTileN = clampTileSize(options.cacheTileN, memRefShape[rank - 1]);
+  int64_t cacheTileK =
+      clampTileSize(options.cacheTileK, AShape[AShape.size() - 1]);
+  int64_t registerTileM = clampTileSize(options.registerTileM, cacheTileM);
+  int64_t registerTileN = clampTileSize(options.registerTileN, cacheTileN);
+
+  // Fill the output with value 0.
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    KrnlIterateOperandPack initPack(rewriter, resultLoops);
+    addDimensionToPack(rewriter, loc, initPack, alloc, rank - 2);
+    addDimensionToPack(rewriter, loc, initPack, alloc, rank - 1);
+    auto initIterateOp = rewriter.create<KrnlIterateOp>(loc, initPack);
+    Block &initIterationBlock = initIterateOp.bodyRegion().front();
+    rewriter.setInsertionPointToStart(&initIterationBlock);
+    SmallVector<Value, 4> loopBatchMNIVs(batchIVs.begin(), batchIVs.end());
+    for (auto arg : initIterationBlock.getArguments())
+      loopBatchMNIVs.emplace_back(arg);
+    rewriter.create<AffineStoreOp>(loc, zero, alloc, loopBatchMNIVs);
+  }
+
+  // Define the M, N, K loops and tile them.
+  std::vector<Value> loops;
+  defineLoops(rewriter, loc, loops, 3);
+  auto loopType = LoopType::get(rewriter.getContext());
+  auto emitBlock = [&](Value loop, int64_t tileSize) {
+    return rewriter.create<KrnlBlockOp>(
+        loc, loopType, loopType, loop, rewriter.getI64IntegerAttr(tileSize));
+  };
+  auto iBlock = emitBlock(loops[0], cacheTileM);
+  auto jBlock = emitBlock(loops[1], cacheTileN);
+  auto kBlock = emitBlock(loops[2], cacheTileK);
+  auto iRegBlock = emitBlock(iBlock.loop_local(), registerTileM);
+  auto jRegBlock = emitBlock(jBlock.loop_local(), registerTileN);
+
+  // After blocking, the loop nest is (ib, irb, ir, jb, jrb, jr, kb, k). The
+  // loops over the cache tiles are the three outermost ones.
+  int64_t ibPos = options.cacheLoopOrder.find('m');
+  int64_t jbPos = options.cacheLoopOrder.find('n');
+  int64_t kbPos = options.cacheLoopOrder.find('k');
+  rewriter.create<KrnlPermuteOp>(loc,
+      ValueRange{iBlock.loop_block(), iRegBlock.loop_block(),
+          iRegBlock.loop_local(), jBlock.loop_block(), jRegBlock.loop_block(),
+          jRegBlock.loop_local(), kBlock.loop_block(), kBlock.loop_local()},
+      rewriter.getI64ArrayAttr({ibPos, 3, 6, jbPos, 4, 7, kbPos, 5}));
+  // Fully unroll the register tile, innermost loop first.
+  rewriter.create<KrnlUnrollOp>(loc, jRegBlock.loop_local());
+  rewriter.create<KrnlUnrollOp>(loc, iRegBlock.loop_local());
+  // Cache tiles along N write to disjoint columns of the result.
+  rewriter.create<KrnlParallelOp>(loc, jBlock.loop_block());
+
+  std::vector<Value> optimizedLoops = {Value(), Value(), Value(),
+      iRegBlock.loop_block(), jRegBlock.loop_block(), kBlock.loop_local(),
+      iRegBlock.loop_local(), jRegBlock.loop_local()};
+  optimizedLoops[ibPos] = iBlock.loop_block();
+  optimizedLoops[jbPos] = jBlock.loop_block();
+  optimizedLoops[kbPos] = kBlock.loop_block();
+  KrnlIterateOperandPack pack(rewriter, loops, optimizedLoops);
+  addDimensionToPack(rewriter, loc, pack, alloc, rank - 2);
+  addDimensionToPack(rewriter, loc, pack, alloc, rank - 1);
+  addDimensionToPack(rewriter, loc, pack, A, AShape.size() - 1);
+  auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
+
+  // Insert instructions into the tiled KrnlIterateOp.
+  Block &iterationBlock = iterateOp.bodyRegion().front();
+  rewriter.setInsertionPointToStart(&iterationBlock);
+  Value i = iterationBlock.getArgument(0);
+  Value j = iterationBlock.getArgument(1);
+  Value k = iterationBlock.getArgument(2);
+
+  // Induction variables. A and B use the innermost batch dimensions.
+  SmallVector<Value, 4> loopBatchMKIVs =
+      getOperandBatchIVs(rewriter, loc, AShape, memRefShape, batchIVs);
+  loopBatchMKIVs.emplace_back(i);
+  loopBatchMKIVs.emplace_back(k);
+  SmallVector<Value, 4> loopBatchKNIVs =
+      getOperandBatchIVs(rewriter, loc, BShape, memRefShape, batchIVs);
+  loopBatchKNIVs.emplace_back(k);
+  loopBatchKNIVs.emplace_back(j);
+  SmallVector<Value, 4> loopBatchMNIVs(batchIVs.begin(), batchIVs.end());
+  loopBatchMNIVs.emplace_back(i);
+  loopBatchMNIVs.emplace_back(j);
+
+  // Matmul computation
+  Value loadedA = emitConvertFloat(rewriter, loc,
+      rewriter.create<AffineLoadOp>(loc, A, loopBatchMKIVs), elementType);
+  Value loadedB = emitConvertFloat(rewriter, loc,
+      rewriter.create<AffineLoadOp>(loc, B, loopBatchKNIVs), elementType);
+  auto loadedY = rewriter.create<AffineLoadOp>(loc, alloc, loopBatchMNIVs);
+  if (elementType.isa<IntegerType>()) {
+    auto AB = rewriter.create<MulIOp>(loc, loadedA, loadedB);
+    auto accumulated = rewriter.create<AddIOp>(loc, loadedY, AB);
+    rewriter.create<AffineStoreOp>(loc, accumulated, alloc, loopBatchMNIVs);
+  } else if (elementType.isa<FloatType>()) {
+    auto AB = rewriter.create<MulFOp>(loc, loadedA, loadedB);
+    auto accumulated = rewriter.create<AddFOp>(loc, loadedY, AB);
+    rewriter.create<AffineStoreOp>(loc, accumulated, alloc, loopBatchMNIVs);
+  }
+}
+
+// Override the tiling options with the parameters of an entry of the tuning
+// database, and enable the tiling. Returns false, leaving the options
+// unchanged, if a parameter is unknown or invalid.
+static bool applyTuningConfig(
+    const TuningConfig &config, MatMulTilingOptions &options) {
+  MatMulTilingOptions tunedOptions = options;
+  tunedOptions.enabled = true;
+  for (const auto &parameter : config) {
+    StringRef name = parameter.first;
+    StringRef value = parameter.second;
+    if (name == "cache-loop-order") {
+      if (value.size() != 3 ||
+          !std::is_permutation(value.begin(), value.end(), "mnk"))
+        return false;
+      tunedOptions.cacheLoopOrder = value.str();
+      continue;
+    }
+    int64_t *tileSize =
+        llvm::StringSwitch<int64_t *>(name)
+            .Case("cache-tile-m", &tunedOptions.cacheTileM)
+            .Case("cache-tile-n", &tunedOptions.cacheTileN)
+            .Case("cache-tile-k", &tunedOptions.cacheTileK)
+            .Case("register-tile-m", &tunedOptions.registerTileM)
+            .Case("register-tile-n", &tunedOptions.registerTileN)
+            .Default(nullptr);
+    if (!tileSize || value.getAsInteger(10, *tileSize) || *tileSize <= 0)
+      return false;
+  }
+  options = tunedOptions;
+  return true;
+}
+
 struct ONNXMatMulOpLowering : public ConversionPattern {
-  ONNXMatMulOpLowering(MLIRContext *ctx)
-      : ConversionPattern(mlir::ONNXMatMulOp::getOperationName(), 1, ctx) {}
+  ONNXMatMulOpLowering(MLIRContext *ctx,
+      const MatMulTilingOptions &tilingOptions,
+      const TuningDatabase *tuningDatabase, StringRef tuningTarget,
+      int64_t blasThreshold, int64_t unrollThreshold)
+      : ConversionPattern(mlir::ONNXMatMulOp::getOperationName(), 1, ctx),
+        defaultTilingOptions(tilingOptions), tuningDatabase(tuningDatabase),
+        tuningTarget(tuningTarget.str()), blasThreshold(blasThreshold),
+        unrollThreshold(unrollThreshold) {}
+
+  MatMulTilingOptions defaultTilingOptions;
+  const TuningDatabase *tuningDatabase;
+  std::string tuningTarget;
+  int64_t blasThreshold;
+  int64_t unrollThreshold;
+
+  // Leave the matrix multiplications of A (... x M x K) and B (... x K x N)
+  // into alloc (... x M x N) to the BLAS library when they are large enough.
+  // When B is the same matrix for all the batches, the batches and the rows of
+  // A form the rows of a single call, otherwise each batch is a call at the
+  // offsets of its matrices. Return false if the BLAS library is not used.
+  bool emitBlasMatMul(ConversionPatternRewriter &rewriter, Location loc,
+      Value A, Value B, Value alloc) const {
+    auto AShape = A.getType().cast<MemRefType>().getShape();
+    auto BShape = B.getType().cast<MemRefType>().getShape();
+    auto resultShape = alloc.getType().cast<MemRefType>().getShape();
+    int64_t M = AShape[AShape.size() - 2], K = AShape.back();
+    int64_t N = BShape.back();
+    int64_t numBatches = 1;
+    for (int64_t dim : resultShape.drop_back(2))
+      numBatches *= dim;
+    if (!isBlasGemmProfitable(
+            {A, B, alloc}, numBatches * M, N, K, blasThreshold))
+      return false;
+
+    if (llvm::all_of(
+            BShape.drop_back(2), [](int64_t dim) { return dim == 1; })) {
+      emitBlasGemm(rewriter, loc, A, B, alloc, numBatches * M, N, K, 1, 0);
+      return true;
+    }
+
+    // The element offset of the matrix of a batch within a MemRef whose batch
+    // dimensions are batchShape.
+    auto emitMatrixOffset = [&](ArrayRef<Value> ivs,
+                                ArrayRef<int64_t> batchShape,
+                                int64_t matrixSize) -> Value {
+      AffineExpr offset = rewriter.getAffineConstantExpr(0);
+      int64_t stride = matrixSize;
+      for (int64_t i = batchShape.size() - 1; i >= 0; --i) {
+        offset = offset + rewriter.getAffineDimExpr(i) * stride;
+        stride *= batchShape[i];
+      }
+      AffineMap map =
+          AffineMap::get(ivs.size(), 0, offset, rewriter.getContext());
+      return rewriter.create<AffineApplyOp>(loc, map, ivs);
+    };
+
+    OpBuilder::InsertionGuard guard(rewriter);
+    int64_t numBatchDims = resultShape.size() - 2;
+    BuildKrnlLoop batchLoops(rewriter, loc, numBatchDims);
+    batchLoops.createDefineOp();
+    for (int64_t i = 0; i < numBatchDims; ++i) {
+      batchLoops.pushBounds(0, alloc, i);
+      batchLoops.parallelize(i);
+    }
+    batchLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(batchLoops.getIterateBlock());
+    SmallVector<Value, 4> batchIVs(batchLoops.getAllInductionVar().begin(),
+        batchLoops.getAllInductionVar().end());
+    Value offsetA = emitMatrixOffset(
+        getOperandBatchIVs(rewriter, loc, AShape, resultShape, batchIVs),
+        AShape.drop_back(2), M * K);
+    Value offsetB = emitMatrixOffset(
+        getOperandBatchIVs(rewriter, loc, BShape, resultShape, batchIVs),
+        BShape.drop_back(2), K * N);
+    Value offsetC =
+        emitMatrixOffset(batchIVs, resultShape.drop_back(2), M * N);
+    emitBlasGemm(rewriter, loc, A, B, alloc, M, N, K, 1, 0, false, false,
+        {offsetA, offsetB, offsetC});
+    return true;
+  }
 
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const final {
     auto loc = op->getLoc();
 
+    // The tuned parameters of this shape on the target, if any, take
+    // precedence over the options of the lowering.
+    MatMulTilingOptions tilingOptions = defaultTilingOptions;
+    if (tuningDatabase) {
+      const TuningConfig *config = tuningDatabase->lookup(
+          op->getName().getStringRef(),
+          TuningDatabase::getShapesKey(op->getOperandTypes()), tuningTarget);
+      if (config && !applyTuningConfig(*config, tilingOptions))
+        op->emitWarning("ignoring invalid tuning database entry");
+    }
+
     ONNXMatMulOpAdaptor operandAdaptor(operands);
     Value A = operandAdaptor.A();
     Value B = operandAdaptor.B();
@@ -33,12 +313,8 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
 
     // Result type
     auto memRefType = convertToMemRefType(*op->result_type_begin());
-    auto elementType = memRefType.getElementType();
     auto memRefShape = memRefType.getShape();
 
-    // A value zero
-    auto zero = emitConstantOp(rewriter, loc, memRefType.getElementType(), 0);
-
     // Insert an allocation and deallocation for the result of this operation.
     Value alloc;
     bool insertDealloc = checkInsertDealloc(op);
@@ -110,14 +386,86 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
       alloc = rewriter.create<AllocOp>(loc, memRefType, allocOperands);
     }
 
+    if (AShape.size() >= 2 && BShape.size() >= 2 &&
+        emitBlasMatMul(rewriter, loc, A, B, alloc)) {
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+
+    // Half-precision results are accumulated in f32 and truncated once the
+    // products are summed. The operands are extended when loaded, so they may
+    // also be narrower than the result, e.g. bf16 weights.
+    Value acc = insertAccumulationBuffer(rewriter, loc, alloc);
+    auto elementType = acc.getType().cast<MemRefType>().getElementType();
+
+    // A value zero
+    auto zero = emitConstantOp(rewriter, loc, elementType, 0);
+
+    // The loops of tiny products are fully unrolled into straight-line code
+    // rather than tiled or parallelized.
+    bool unroll = false;
+    if (hasAllConstantDimensions(memRefType)) {
+      int64_t numIterations = AShape.back();
+      for (int64_t dim : memRefShape)
+        numIterations *= dim;
+      unroll = isFullyUnrolled({A, B}, numIterations, unrollThreshold);
+    }
+
     if (AShape.size() >= 2 || BShape.size() >= 2) {
       // Cases 1 and 2:
       // - Both arguments are N-D, N >= 2
       // - Either argument is 1-D, the other is N-D, N >= 2
 
+      bool useTiling =
+          !unroll && tilingOptions.enabled && AShape.size() >= 2 &&
+          BShape.size() >= 2 &&
+          hasAllConstantDimensions(A.getType().cast<MemRefType>()) &&
+          hasAllConstantDimensions(B.getType().cast<MemRefType>()) &&
+          hasAllConstantDimensions(memRefType);
+
+      // When B is the same matrix for all the batches, e.g. a weight matrix,
+      // the batches and the rows of A form the rows of a single larger
+      // matrix multiplication, so that each tile of B is loaded once for
+      // all the batches.
+      if (useTiling && memRefShape.size() > 2 &&
+          llvm::all_of(BShape.drop_back(2),
+              [](int64_t dim) { return dim == 1; })) {
+        int64_t numRows = 1;
+        for (int64_t dim : memRefShape.drop_back())
+          numRows *= dim;
+        auto viewType = [&](Value memRef, ArrayRef<int64_t> shape) {
+          auto type = memRef.getType().cast<MemRefType>();
+          return MemRefType::get(shape, type.getElementType());
+        };
+        Value matrixA = rewriter.create<KrnlReshapeOp>(
+            loc, viewType(A, {numRows, AShape.back()}), A);
+        Value matrixB = B;
+        if (BShape.size() > 2)
+          matrixB = rewriter.create<KrnlReshapeOp>(loc,
+              viewType(B, {BShape[BShape.size() - 2], BShape.back()}), B);
+        Value matrixAcc = rewriter.create<KrnlReshapeOp>(
+            loc, viewType(acc, {numRows, memRefShape.back()}), acc);
+
+        std::vector<Value> resultLoops;
+        defineLoops(rewriter, loc, resultLoops, 2);
+        rewriter.create<KrnlParallelOp>(loc, resultLoops[0]);
+        emitTiledMatMul(rewriter, loc, matrixA, matrixB, matrixAcc, zero, {},
+            resultLoops, tilingOptions);
+        rewriter.setInsertionPoint(op);
+        emitStoreAccumulators(rewriter, loc, acc, alloc);
+        rewriter.replaceOp(op, alloc);
+        return success();
+      }
+
       // Define loops for batch dimensions.
       std::vector<Value> originalLoops;
       defineLoops(rewriter, loc, originalLoops, memRefShape.size());
+      // The outermost loop, either a batch loop or the loop over the rows of
+      // the result, carries no dependence, nor do the other batch loops.
+      if (unroll)
+        emitFullUnroll(rewriter, loc, originalLoops);
+      else
+        rewriter.create<KrnlParallelOp>(loc, originalLoops[0]);
 
       // Outer KrnlIterateOp
       SmallVector<Value, 4> loopBatchIVs;
@@ -131,8 +479,11 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
 
         std::vector<Value> outerLoops;
         outerLoops.reserve(batchAxes.size());
-        for (int i = 0; i < batchAxes.size(); ++i)
+        for (int i = 0; i < batchAxes.size(); ++i) {
           outerLoops.push_back(originalLoops[i]);
+          if (i > 0 && !unroll)
+            rewriter.create<KrnlParallelOp>(loc, originalLoops[i]);
+        }
 
         KrnlIterateOperandPack outerPack(rewriter, outerLoops);
         for (int i = 0; i < batchAxes.size(); ++i) {
@@ -152,6 +503,18 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
         hasBatchLoop = true;
       }
 
+      // Use the tiled lowering when requested and all sizes are known.
+      if (useTiling) {
+        emitTiledMatMul(rewriter, loc, A, B, acc, zero, loopBatchIVs,
+            {originalLoops[memRefShape.size() - 2],
+                originalLoops[memRefShape.size() - 1]},
+            tilingOptions);
+        rewriter.setInsertionPoint(op);
+        emitStoreAccumulators(rewriter, loc, acc, alloc);
+        rewriter.replaceOp(op, alloc);
+        return success();
+      }
+
       // Now, we define loops for matrix multiplication.
 
       // Create a KrnlIterateOp for matrix multiplication.
@@ -198,12 +561,14 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
       }
 
       // Fill the output with value 0.
-      rewriter.create<AffineStoreOp>(loc, zero, alloc, loopBatchMNIVs);
+      rewriter.create<AffineStoreOp>(loc, zero, acc, loopBatchMNIVs);
 
       //  Iterate along the reduction dimension.
       //  Use a value from A.
       std::vector<Value> reduceLoops;
       defineLoops(rewriter, loc, reduceLoops, 1);
+      if (unroll)
+        emitFullUnroll(rewriter, loc, reduceLoops);
       KrnlIterateOperandPack reducePack(rewriter, reduceLoops);
       addDimensionToPack(rewriter, loc, reducePack, A, AShape.size() - 1);
       auto reduceIterateOp = rewriter.create<KrnlIterateOp>(loc, reducePack);
@@ -218,15 +583,15 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
       loopKIVs.emplace_back(reduceIterationBlock.getArguments()[0]);
       // MK
       if (AShape.size() > 2)
-        for (auto arg : loopBatchIVs)
-          loopBatchMKIVs.emplace_back(arg);
+        loopBatchMKIVs = getOperandBatchIVs(
+            rewriter, loc, AShape, memRefShape, loopBatchIVs);
       if (AShape.size() >= 2)
         loopBatchMKIVs.emplace_back(loopMNIVs[0]);
       loopBatchMKIVs.emplace_back(loopKIVs[0]);
       // KN
       if (BShape.size() > 2)
-        for (auto arg : loopBatchIVs)
-          loopBatchKNIVs.emplace_back(arg);
+        loopBatchKNIVs = getOperandBatchIVs(
+            rewriter, loc, BShape, memRefShape, loopBatchIVs);
       loopBatchKNIVs.emplace_back(loopKIVs[0]);
       if (BShape.size() >= 2) {
         if (AShape.size() >= 2)
@@ -235,17 +600,19 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
           loopBatchKNIVs.emplace_back(loopMNIVs[0]);
       }
       // Matmul computation
-      auto loadedA = rewriter.create<AffineLoadOp>(loc, A, loopBatchMKIVs);
-      auto loadedB = rewriter.create<AffineLoadOp>(loc, B, loopBatchKNIVs);
-      auto loadedY = rewriter.create<AffineLoadOp>(loc, alloc, loopBatchMNIVs);
+      Value loadedA = emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, A, loopBatchMKIVs), elementType);
+      Value loadedB = emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, B, loopBatchKNIVs), elementType);
+      auto loadedY = rewriter.create<AffineLoadOp>(loc, acc, loopBatchMNIVs);
       if (elementType.isa<IntegerType>()) {
         auto AB = rewriter.create<MulIOp>(loc, loadedA, loadedB);
         auto accumulated = rewriter.create<AddIOp>(loc, loadedY, AB);
-        rewriter.create<AffineStoreOp>(loc, accumulated, alloc, loopBatchMNIVs);
+        rewriter.create<AffineStoreOp>(loc, accumulated, acc, loopBatchMNIVs);
       } else if (elementType.isa<FloatType>()) {
         auto AB = rewriter.create<MulFOp>(loc, loadedA, loadedB);
         auto accumulated = rewriter.create<AddFOp>(loc, loadedY, AB);
-        rewriter.create<AffineStoreOp>(loc, accumulated, alloc, loopBatchMNIVs);
+        rewriter.create<AffineStoreOp>(loc, accumulated, acc, loopBatchMNIVs);
       }
     } else if ((AShape.size() == 1) && (BShape.size() == 1)) {
       // Case 3:
@@ -253,13 +620,15 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
 
       // Fill the output with value 0.
       Value zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
-      rewriter.create<AffineStoreOp>(loc, zero, alloc, zeroIndex);
+      rewriter.create<AffineStoreOp>(loc, zero, acc, zeroIndex);
 
       //  Iterate along the reduction dimension.
       //  Use a value from A.
       std::vector<Value> reduceLoops;
 
       defineLoops(rewriter, loc, reduceLoops, 1);
+      if (unroll)
+        emitFullUnroll(rewriter, loc, reduceLoops);
       KrnlIterateOperandPack reducePack(rewriter, reduceLoops);
       addDimensionToPack(rewriter, loc, reducePack, A, 0);
       auto reduceIterateOp = rewriter.create<KrnlIterateOp>(loc, reducePack);
@@ -274,30 +643,37 @@ struct ONNXMatMulOpLowering : public ConversionPattern {
       loopKIVs.emplace_back(reduceIterationBlock.getArgument(0));
 
       // Matmul computation
-      auto loadedA = rewriter.create<AffineLoadOp>(loc, A, loopKIVs);
-      auto loadedB = rewriter.create<AffineLoadOp>(loc, B, loopKIVs);
-      auto loadedY = rewriter.create<AffineLoadOp>(loc, alloc, zeroIndex);
+      Value loadedA = emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, A, loopKIVs), elementType);
+      Value loadedB = emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, B, loopKIVs), elementType);
+      auto loadedY = rewriter.create<AffineLoadOp>(loc, acc, zeroIndex);
       if (elementType.isa<IntegerType>()) {
         auto AB = rewriter.create<MulIOp>(loc, loadedA, loadedB);
         auto accumulated = rewriter.create<AddIOp>(loc, loadedY, AB);
-        rewriter.create<AffineStoreOp>(loc, accumulated, alloc, zeroIndex);
+        rewriter.create<AffineStoreOp>(loc, accumulated, acc, zeroIndex);
       } else if (elementType.isa<FloatType>()) {
         auto AB = rewriter.create<MulFOp>(loc, loadedA, loadedB);
         auto accumulated = rewriter.create<AddFOp>(loc, loadedY, AB);
-        rewriter.create<AffineStoreOp>(loc, accumulated, alloc, zeroIndex);
+        rewriter.create<AffineStoreOp>(loc, accumulated, acc, zeroIndex);
       }
     } else {
       // No scalar matrix multiplication.
       llvm_unreachable("Unsupported scalar matrix multiplication.");
     }
 
+    rewriter.setInsertionPoint(op);
+    emitStoreAccumulators(rewriter, loc, acc, alloc);
     rewriter.replaceOp(op, alloc);
 
     return success();
   }
 };
 
-void populateLoweringONNXMatMulOpPattern(
-    OwningRewritePatternList &patterns, MLIRContext *ctx) {
-  patterns.insert<ONNXMatMulOpLowering>(ctx);
+void populateLoweringONNXMatMulOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx, const MatMulTilingOptions &tilingOptions,
+    const TuningDatabase *tuningDatabase, StringRef tuningTarget,
+    int64_t blasThreshold, int64_t unrollThreshold) {
+  patterns.insert<ONNXMatMulOpLowering>(ctx, tilingOptions, tuningDatabase,
+      tuningTarget, blasThreshold, unrollThreshold);
 }
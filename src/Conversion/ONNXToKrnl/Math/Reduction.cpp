@@ -8,6 +8,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Dialect/Vector/VectorOps.h"
+
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 using namespace mlir;
@@ -43,6 +45,18 @@ Value getIdentityValue<ONNXReduceMeanOp>(
   return emitConstantOp(rewriter, loc, type, 0);
 }
 
+template <>
+Value getIdentityValue<ONNXArgMaxOp>(
+    ConversionPatternRewriter &rewriter, Location loc, Type type) {
+  return emitNegativeInfinityConstantOp(rewriter, loc, type);
+}
+
+template <>
+Value getIdentityValue<ONNXArgMinOp>(
+    ConversionPatternRewriter &rewriter, Location loc, Type type) {
+  return emitPositiveInfinityConstantOp(rewriter, loc, type);
+}
+
 // Scalar ops
 template <>
 struct ScalarOp<ONNXReduceProdOp> {
@@ -109,7 +123,7 @@ Value emitScalarOpFor<ONNXReduceMaxOp>(ConversionPatternRewriter &rewriter,
     ArrayRef<Value> scalarOperands) {
   Value lhs = scalarOperands[0];
   Value rhs = scalarOperands[1];
-  Type element_type = lhs.getType();
+  Type element_type = getElementTypeOrSelf(lhs.getType());
   if (element_type.isa<IntegerType>()) {
     auto max = rewriter.create<CmpIOp>(loc, CmpIPredicate::sgt, lhs, rhs);
     auto result = rewriter.create<SelectOp>(loc, max, lhs, rhs);
@@ -132,11 +146,11 @@ Value emitScalarOpFor<ONNXReduceMinOp>(ConversionPatternRewriter &rewriter,
     ArrayRef<Value> scalarOperands) {
   Value lhs = scalarOperands[0];
   Value rhs = scalarOperands[1];
-  if (elementType.isa<IntegerType>()) {
+  if (getElementTypeOrSelf(elementType).isa<IntegerType>()) {
     auto min = rewriter.create<CmpIOp>(loc, CmpIPredicate::slt, lhs, rhs);
     auto result = rewriter.create<SelectOp>(loc, min, lhs, rhs);
     return result;
-  } else if (elementType.isa<FloatType>()) {
+  } else if (getElementTypeOrSelf(elementType).isa<FloatType>()) {
     auto min = rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, lhs, rhs);
     auto result = rewriter.create<SelectOp>(loc, min, lhs, rhs);
     return result;
@@ -145,13 +159,208 @@ Value emitScalarOpFor<ONNXReduceMinOp>(ConversionPatternRewriter &rewriter,
   }
 }
 
+//===----------------------------------------------------------------------===//
+// Scalar binary ops for lowering ONNXArgMaxOp and ONNXArgMinOp
+//===----------------------------------------------------------------------===//
+// Given the selected element and the next element, return whether the next
+// element is selected instead. Only strictly greater, or smaller, elements are
+// selected so that the first of equal elements is kept.
+template <>
+Value emitScalarOpFor<ONNXArgMaxOp>(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands) {
+  Value selected = scalarOperands[0];
+  Value next = scalarOperands[1];
+  if (getElementTypeOrSelf(elementType).isa<IntegerType>())
+    return rewriter.create<CmpIOp>(loc, CmpIPredicate::sgt, next, selected);
+  else if (getElementTypeOrSelf(elementType).isa<FloatType>())
+    return rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, next, selected);
+  else
+    llvm_unreachable("unsupported element type");
+}
+
+template <>
+Value emitScalarOpFor<ONNXArgMinOp>(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands) {
+  Value selected = scalarOperands[0];
+  Value next = scalarOperands[1];
+  if (getElementTypeOrSelf(elementType).isa<IntegerType>())
+    return rewriter.create<CmpIOp>(loc, CmpIPredicate::slt, next, selected);
+  else if (getElementTypeOrSelf(elementType).isa<FloatType>())
+    return rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, next, selected);
+  else
+    llvm_unreachable("unsupported element type");
+}
+
+// Return the number of elements per vector if the reduction can be emitted
+// with vectors of `vectorBits` bits, or 0 otherwise. The reduced axes must be
+// the innermost axes of an input of static shape and floating-point element
+// type, the innermost dimension holding at least one vector.
+int64_t getReductionVectorWidth(
+    MemRefType memRefType, ArrayRef<int64_t> axes, int64_t vectorBits) {
+  auto elementType = memRefType.getElementType();
+  int64_t rank = memRefType.getRank();
+  if (vectorBits <= 0 || !elementType.isa<FloatType>() || rank == 0 ||
+      !hasAllConstantDimensions(memRefType))
+    return 0;
+  SmallVector<int64_t, 4> sortedAxes(axes.begin(), axes.end());
+  llvm::sort(sortedAxes);
+  for (int64_t i = 0, e = sortedAxes.size(); i < e; ++i)
+    if (sortedAxes[i] != rank - e + i)
+      return 0;
+  int64_t vectorWidth = vectorBits / elementType.getIntOrFloatBitWidth();
+  if (vectorWidth < 2 || !llvm::isPowerOf2_64(vectorWidth) ||
+      memRefType.getShape().back() < vectorWidth)
+    return 0;
+  return vectorWidth;
+}
+
+// Combine the lanes of a vector of partial results with a tree of reduction
+// operations, each step combining the low and high halves of the vector, and
+// return the resulting scalar.
+template <typename ONNXReductionOp>
+Value emitLaneTreeReduction(ConversionPatternRewriter &rewriter, Location loc,
+    Operation *op, Value partials) {
+  auto vectorType = partials.getType().cast<VectorType>();
+  for (int64_t width = vectorType.getNumElements() / 2; width >= 1;
+       width /= 2) {
+    SmallVector<int64_t, 8> lowMask, highMask;
+    for (int64_t i = 0; i < width; ++i) {
+      lowMask.emplace_back(i);
+      highMask.emplace_back(width + i);
+    }
+    Value low =
+        rewriter.create<vector::ShuffleOp>(loc, partials, partials, lowMask);
+    Value high =
+        rewriter.create<vector::ShuffleOp>(loc, partials, partials, highMask);
+    partials = emitScalarOpFor<ONNXReductionOp>(
+        rewriter, loc, op, low.getType(), {low, high});
+  }
+  return rewriter.create<vector::ExtractOp>(
+      loc, partials, ArrayRef<int64_t>{0});
+}
+
+// Emit the reduction of the innermost axes of `input`, starting at
+// `firstAxis`, into `alloc`. Each output element is accumulated into a vector
+// of partial results, one per lane, which are combined by a tree reduction
+// once all the vectors of the element have been read. The remaining elements
+// of the innermost dimension are then accumulated by a scalar loop. The loops
+// over the output are parallel, each output element having its own partial
+// results.
+template <typename ONNXReductionOp>
+void emitVectorizedReduction(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Value input, Value alloc, int64_t firstAxis,
+    int64_t vectorWidth) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  auto memRefInType = input.getType().cast<MemRefType>();
+  auto inShape = memRefInType.getShape();
+  int64_t inRank = inShape.size();
+  int64_t outRank = alloc.getType().cast<MemRefType>().getRank();
+  auto elementType = memRefInType.getElementType();
+  auto vectorType = VectorType::get({vectorWidth}, elementType);
+  int64_t innerDimSize = inShape[inRank - 1];
+  int64_t numVectors = innerDimSize / vectorWidth;
+
+  // Partial results of each output element.
+  SmallVector<int64_t, 4> partialsShape(
+      inShape.begin(), inShape.begin() + firstAxis);
+  Value partialsOp = insertAllocAndDealloc(
+      MemRefType::get(partialsShape, vectorType), loc, rewriter, true);
+  Value identity =
+      getIdentityValue<ONNXReductionOp>(rewriter, loc, elementType);
+  Value vectorIdentity =
+      rewriter.create<vector::BroadcastOp>(loc, vectorType, identity);
+  Value zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
+
+  // Map the induction variable of the innermost loop to the first element of
+  // a vector.
+  SmallVector<AffineExpr, 4> vectorExprs;
+  for (int64_t i = 0; i < inRank - 1; ++i)
+    vectorExprs.emplace_back(rewriter.getAffineDimExpr(i));
+  vectorExprs.emplace_back(
+      rewriter.getAffineDimExpr(inRank - 1) * vectorWidth);
+  auto vectorMap =
+      AffineMap::get(inRank, 0, vectorExprs, rewriter.getContext());
+
+  // Loops over the output elements.
+  SmallVector<Value, 4> outerLoopIVs;
+  if (firstAxis > 0) {
+    BuildKrnlLoop outerLoops(rewriter, loc, firstAxis);
+    outerLoops.createDefineOp();
+    outerLoops.parallelize(0);
+    for (int64_t i = 0; i < firstAxis; ++i)
+      outerLoops.pushBounds(0, input, i);
+    outerLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+    for (auto arg : outerLoops.getAllInductionVar())
+      outerLoopIVs.emplace_back(arg);
+  }
+  // The reduced dimensions are kept as dimensions of size one, if any.
+  SmallVector<Value, 4> outLoopIVs(outerLoopIVs.begin(), outerLoopIVs.end());
+  outLoopIVs.resize(outRank, zeroIndex);
+
+  // Emit the loops over the reduced dimensions, the innermost one iterating
+  // from `lowerBound` to `upperBound`, and accumulate the loaded values.
+  auto emitReductionLoops = [&](int64_t lowerBound, int64_t upperBound,
+                                llvm::function_ref<void(ArrayRef<Value>)>
+                                    emitAccumulation) {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop reductionLoops(rewriter, loc, inRank - firstAxis);
+    reductionLoops.createDefineOp();
+    for (int64_t i = firstAxis; i < inRank - 1; ++i)
+      reductionLoops.pushBounds(0, input, i);
+    reductionLoops.pushBounds(lowerBound, upperBound);
+    reductionLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(reductionLoops.getIterateBlock());
+    SmallVector<Value, 4> inLoopIVs(outerLoopIVs.begin(), outerLoopIVs.end());
+    for (auto arg : reductionLoops.getAllInductionVar())
+      inLoopIVs.emplace_back(arg);
+    emitAccumulation(inLoopIVs);
+  };
+
+  rewriter.create<AffineStoreOp>(loc, vectorIdentity, partialsOp, outerLoopIVs);
+  emitReductionLoops(0, numVectors, [&](ArrayRef<Value> inLoopIVs) {
+    Value next = rewriter.create<AffineVectorLoadOp>(
+        loc, vectorType, input, vectorMap, inLoopIVs);
+    Value partials =
+        rewriter.create<AffineLoadOp>(loc, partialsOp, outerLoopIVs);
+    partials = emitScalarOpFor<ONNXReductionOp>(
+        rewriter, loc, op, vectorType, {partials, next});
+    rewriter.create<AffineStoreOp>(loc, partials, partialsOp, outerLoopIVs);
+  });
+
+  Value partials = rewriter.create<AffineLoadOp>(loc, partialsOp, outerLoopIVs);
+  Value result =
+      emitLaneTreeReduction<ONNXReductionOp>(rewriter, loc, op, partials);
+  rewriter.create<AffineStoreOp>(loc, result, alloc, outLoopIVs);
+
+  // Scalar loop for the remaining elements of the innermost dimension.
+  if (innerDimSize % vectorWidth != 0)
+    emitReductionLoops(numVectors * vectorWidth, innerDimSize,
+        [&](ArrayRef<Value> inLoopIVs) {
+          Value next = rewriter.create<AffineLoadOp>(loc, input, inLoopIVs);
+          Value accumulated =
+              rewriter.create<AffineLoadOp>(loc, alloc, outLoopIVs);
+          accumulated = emitScalarOpFor<ONNXReductionOp>(
+              rewriter, loc, op, elementType, {accumulated, next});
+          rewriter.create<AffineStoreOp>(loc, accumulated, alloc, outLoopIVs);
+        });
+}
+
 template <typename ONNXReductionOp>
 struct ONNXReductionOpLowering : public ConversionPattern {
   bool computeMean = false;
 
-  ONNXReductionOpLowering(MLIRContext *ctx, bool computeMean = false)
+  // Number of bits of the vectors used for the innermost reduced dimension, 0
+  // if the operation is not vectorized.
+  int64_t vectorBits = 0;
+
+  ONNXReductionOpLowering(
+      MLIRContext *ctx, bool computeMean = false, int64_t vectorBits = 0)
       : ConversionPattern(ONNXReductionOp::getOperationName(), 1, ctx) {
     this->computeMean = computeMean;
+    this->vectorBits = vectorBits;
   }
 
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
@@ -206,7 +415,6 @@ struct ONNXReductionOpLowering : public ConversionPattern {
 
     // Get type information
     auto memRefOutShape = memRefOutType.getShape();
-    auto elementOutType = memRefOutType.getElementType();
     std::map<int64_t, int64_t> outInDimMap =
         getReductionMapping(memRefInType, axes, isKeepdims);
 
@@ -232,90 +440,134 @@ struct ONNXReductionOpLowering : public ConversionPattern {
       }
     }
 
-    // There are two required and one optional Krnl loops:
-    // - One to initialize the result memref,
-    // - One to do reduction, and
-    // - One to compute mean (optional).
+    // Half-precision results are accumulated in f32 and truncated once the
+    // reduction, and the mean, are computed.
+    Value acc = insertAccumulationBuffer(rewriter, loc, alloc);
+    auto accElementType = acc.getType().cast<MemRefType>().getElementType();
+
+    // When the innermost axes are reduced, the reduction is vectorized along
+    // the innermost dimension with vectors of `vectorBits` bits. The
+    // vectorized reduction accumulates in the type of the input, so it is
+    // only used when that type is its own accumulation type.
+    int64_t vectorWidth = 0;
+    if (acc == alloc)
+      vectorWidth = getReductionVectorWidth(memRefInType, axes, vectorBits);
+    if (vectorWidth) {
+      emitVectorizedReduction<ONNXReductionOp>(rewriter, loc, op, input, alloc,
+          inRank - axes.size(), vectorWidth);
+    } else {
+      // There are two required and one optional Krnl loops:
+      // - One to initialize the result memref,
+      // - One to do reduction, and
+      // - One to compute mean (optional).
 
-    // 1. Define loops to initialize the result.
-    std::vector<Value> originalLoopsInit;
-    defineLoops(rewriter, loc, originalLoopsInit, outRank);
+      // 1. Define loops to initialize the result.
+      std::vector<Value> originalLoopsInit;
+      defineLoops(rewriter, loc, originalLoopsInit, outRank);
 
-    // Iteration information
-    KrnlIterateOperandPack packInit(rewriter, originalLoopsInit);
-    for (decltype(outRank) i = 0; i < outRank; ++i) {
-      addDimensionToPack(rewriter, loc, packInit, alloc, i);
-    }
-    auto iterateOpInit = rewriter.create<KrnlIterateOp>(loc, packInit);
-    Block &iterationBlockInit = iterateOpInit.bodyRegion().front();
+      // Iteration information
+      KrnlIterateOperandPack packInit(rewriter, originalLoopsInit);
+      for (decltype(outRank) i = 0; i < outRank; ++i) {
+        addDimensionToPack(rewriter, loc, packInit, acc, i);
+      }
+      auto iterateOpInit = rewriter.create<KrnlIterateOp>(loc, packInit);
+      Block &iterationBlockInit = iterateOpInit.bodyRegion().front();
 
-    // Perform the insertions into the body of the initialization loop.
+      // Perform the insertions into the body of the initialization loop.
 
-    // Insert instructions inside the KernelIterateOp body.
-    rewriter.setInsertionPointToStart(&iterationBlockInit);
+      // Insert instructions inside the KernelIterateOp body.
+      rewriter.setInsertionPointToStart(&iterationBlockInit);
 
-    // Handle the operation:
-    SmallVector<Value, 4> loopIVs;
-    for (auto arg : iterationBlockInit.getArguments()) {
-      loopIVs.push_back(arg);
-    }
+      // Handle the operation:
+      SmallVector<Value, 4> loopIVs;
+      for (auto arg : iterationBlockInit.getArguments()) {
+        loopIVs.push_back(arg);
+      }
 
-    Value identity =
-        getIdentityValue<ONNXReductionOp>(rewriter, loc, elementOutType);
-    rewriter.create<AffineStoreOp>(loc, identity, alloc, loopIVs);
-
-    // 2. Define an Krnl loop to do reduction.
-    rewriter.setInsertionPointAfter(iterateOpInit);
-    auto ipMainRegion = rewriter.saveInsertionPoint();
-    std::vector<Value> originalLoops;
-    defineLoops(rewriter, loc, originalLoops, inRank);
-    // Iteration information
-    KrnlIterateOperandPack pack(rewriter, originalLoops);
-    for (decltype(inRank) i = 0; i < inRank; ++i) {
-      addDimensionToPack(rewriter, loc, pack, input, i);
-    }
-    auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
-    Block &iterationBlock = iterateOp.bodyRegion().front();
-
-    // Perform the insertions into the body of the reduction loop.
-    // Insert instructions inside the KernelIterateOp body.
-    rewriter.setInsertionPointToStart(&iterationBlock);
-
-    // Handle the operation:
-    SmallVector<Value, 4> inLoopIVs, outLoopIVs;
-    auto args = iterationBlock.getArguments();
-    for (int i = 0; i < args.size(); ++i) {
-      inLoopIVs.push_back(args[i]);
-    }
-    Value zeroIndex = nullptr;
-    for (decltype(inRank) i = 0; i < outRank; ++i) {
-      if (outInDimMap.find(i) != outInDimMap.end()) {
-        outLoopIVs.push_back(inLoopIVs[outInDimMap[i]]);
-      } else {
-        if (zeroIndex) {
-          outLoopIVs.push_back(zeroIndex);
+      Value identity =
+          getIdentityValue<ONNXReductionOp>(rewriter, loc, accElementType);
+      rewriter.create<AffineStoreOp>(loc, identity, acc, loopIVs);
+
+      // 2. Define an Krnl loop to do reduction.
+      rewriter.setInsertionPointAfter(iterateOpInit);
+      auto ipMainRegion = rewriter.saveInsertionPoint();
+      std::vector<Value> originalLoops;
+      defineLoops(rewriter, loc, originalLoops, inRank);
+      // The loops over the kept dimensions are moved outside of the loops over
+      // the reduced axes, so that an element of the result is accumulated by
+      // consecutive iterations and can stay in a register. When the innermost
+      // dimension is kept, its loop stays innermost instead, so that both the
+      // input and the result are accessed contiguously.
+      SmallVector<int64_t, 4> loopOrder;
+      bool keepInnermost =
+          inRank > 0 &&
+          std::find(axes.begin(), axes.end(), inRank - 1) == axes.end();
+      for (int64_t i = 0; i < inRank - (keepInnermost ? 1 : 0); ++i)
+        if (std::find(axes.begin(), axes.end(), i) == axes.end())
+          loopOrder.emplace_back(i);
+      for (int64_t i = 0; i < inRank; ++i)
+        if (std::find(axes.begin(), axes.end(), i) != axes.end())
+          loopOrder.emplace_back(i);
+      if (keepInnermost)
+        loopOrder.emplace_back(inRank - 1);
+      SmallVector<int64_t, 4> positions(inRank);
+      bool isPermuted = false;
+      for (int64_t i = 0; i < inRank; ++i) {
+        positions[loopOrder[i]] = i;
+        isPermuted |= loopOrder[i] != i;
+      }
+      if (isPermuted)
+        rewriter.create<KrnlPermuteOp>(
+            loc, originalLoops, rewriter.getI64ArrayAttr(positions));
+      // Iteration information
+      KrnlIterateOperandPack pack(rewriter, originalLoops);
+      for (decltype(inRank) i = 0; i < inRank; ++i) {
+        addDimensionToPack(rewriter, loc, pack, input, i);
+      }
+      auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
+      Block &iterationBlock = iterateOp.bodyRegion().front();
+
+      // Perform the insertions into the body of the reduction loop.
+      // Insert instructions inside the KernelIterateOp body.
+      rewriter.setInsertionPointToStart(&iterationBlock);
+
+      // Handle the operation:
+      SmallVector<Value, 4> inLoopIVs, outLoopIVs;
+      auto args = iterationBlock.getArguments();
+      for (int i = 0; i < args.size(); ++i) {
+        inLoopIVs.push_back(args[i]);
+      }
+      Value zeroIndex = nullptr;
+      for (decltype(inRank) i = 0; i < outRank; ++i) {
+        if (outInDimMap.find(i) != outInDimMap.end()) {
+          outLoopIVs.push_back(inLoopIVs[outInDimMap[i]]);
         } else {
-          zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
-          outLoopIVs.push_back(zeroIndex);
+          if (zeroIndex) {
+            outLoopIVs.push_back(zeroIndex);
+          } else {
+            zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
+            outLoopIVs.push_back(zeroIndex);
+          }
         }
       }
-    }
 
-    Value next, accumulated;
-    next = rewriter.create<AffineLoadOp>(loc, input, inLoopIVs);
-    accumulated = rewriter.create<AffineLoadOp>(loc, alloc, outLoopIVs);
-    accumulated = emitScalarOpFor<ONNXReductionOp>(
-        rewriter, loc, op, memRefOutType.getElementType(), {accumulated, next});
-    rewriter.create<AffineStoreOp>(loc, accumulated, alloc, outLoopIVs);
+      Value next, accumulated;
+      next = emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, input, inLoopIVs), accElementType);
+      accumulated = rewriter.create<AffineLoadOp>(loc, acc, outLoopIVs);
+      accumulated = emitScalarOpFor<ONNXReductionOp>(
+          rewriter, loc, op, accElementType, {accumulated, next});
+      rewriter.create<AffineStoreOp>(loc, accumulated, acc, outLoopIVs);
+      rewriter.restoreInsertionPoint(ipMainRegion);
+    }
 
     // 3. Define an Krnl loop to compute mean (optional).
-    rewriter.restoreInsertionPoint(ipMainRegion);
     if (computeMean) {
-      Type elementType = memRefOutType.getElementType();
+      Type elementType = accElementType;
       // Compute the divisor that is the number of elements participated in
       // reduction, i.e., 'divisor = size of input / size of output'
       Value inputSize = getSizeInType(rewriter, loc, input, elementType);
-      Value outputSize = getSizeInType(rewriter, loc, alloc, elementType);
+      Value outputSize = getSizeInType(rewriter, loc, acc, elementType);
       Value divisor;
       if (elementType.isa<FloatType>())
         divisor = rewriter.create<DivFOp>(loc, inputSize, outputSize);
@@ -326,10 +578,10 @@ struct ONNXReductionOpLowering : public ConversionPattern {
 
       // Compute mean
       BuildKrnlLoop meanLoops(rewriter, loc, outRank);
-      meanLoops.createDefineAndIterateOp(alloc);
+      meanLoops.createDefineAndIterateOp(acc);
       rewriter.setInsertionPointToStart(meanLoops.getIterateBlock());
       auto meanIVs = meanLoops.getAllInductionVar();
-      auto loadData = rewriter.create<AffineLoadOp>(loc, alloc, meanIVs);
+      auto loadData = rewriter.create<AffineLoadOp>(loc, acc, meanIVs);
       Value meanVal;
       if (elementType.isa<FloatType>())
         meanVal = rewriter.create<DivFOp>(loc, loadData, divisor);
@@ -337,20 +589,320 @@ struct ONNXReductionOpLowering : public ConversionPattern {
         meanVal = rewriter.create<SignedDivIOp>(loc, loadData, divisor);
       else
         llvm_unreachable("unsupported element type");
-      rewriter.create<AffineStoreOp>(loc, meanVal, alloc, meanIVs);
+      rewriter.create<AffineStoreOp>(loc, meanVal, acc, meanIVs);
+    }
+
+    rewriter.setInsertionPoint(op);
+    emitStoreAccumulators(rewriter, loc, acc, alloc);
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+// Select the next element and its index if it is selected by the ArgMax or
+// ArgMin operation over the element and index stored in `selectedValues` and
+// `selectedIndices`.
+template <typename ONNXArgOp>
+void emitArgSelection(ConversionPatternRewriter &rewriter, Location loc,
+    Operation *op, Value next, Value nextIndex, Value selectedValues,
+    Value selectedIndices, ArrayRef<Value> outLoopIVs) {
+  Value selected =
+      rewriter.create<AffineLoadOp>(loc, selectedValues, outLoopIVs);
+  Value selectedIndex =
+      rewriter.create<AffineLoadOp>(loc, selectedIndices, outLoopIVs);
+  Value isSelected = emitScalarOpFor<ONNXArgOp>(
+      rewriter, loc, op, next.getType(), {selected, next});
+  rewriter.create<AffineStoreOp>(loc,
+      rewriter.create<SelectOp>(loc, isSelected, next, selected),
+      selectedValues, outLoopIVs);
+  rewriter.create<AffineStoreOp>(loc,
+      rewriter.create<SelectOp>(loc, isSelected, nextIndex, selectedIndex),
+      selectedIndices, outLoopIVs);
+}
+
+// Emit the selection of the innermost axis of `input` into the indices of
+// `alloc`, in a single pass over the input. Each output element is selected
+// from vectors of partial selections, one value and index per lane, which are
+// combined once all the vectors of the element have been read. The remaining
+// elements of the innermost dimension are then selected by a scalar loop. The
+// loops over the output are parallel.
+template <typename ONNXArgOp>
+void emitVectorizedArgReduction(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Value input, Value alloc,
+    int64_t vectorWidth) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  auto memRefInType = input.getType().cast<MemRefType>();
+  auto inShape = memRefInType.getShape();
+  int64_t inRank = inShape.size();
+  auto outType = alloc.getType().cast<MemRefType>();
+  int64_t outRank = outType.getRank();
+  auto elementType = memRefInType.getElementType();
+  auto indexType = outType.getElementType();
+  auto vectorType = VectorType::get({vectorWidth}, elementType);
+  auto indexVectorType = VectorType::get({vectorWidth}, indexType);
+  int64_t innerDimSize = inShape[inRank - 1];
+  int64_t numVectors = innerDimSize / vectorWidth;
+
+  // Partial selections of each output element.
+  SmallVector<int64_t, 4> partialsShape(inShape.begin(), inShape.end() - 1);
+  Value partialValues = insertAllocAndDealloc(
+      MemRefType::get(partialsShape, vectorType), loc, rewriter, true);
+  Value partialIndices = insertAllocAndDealloc(
+      MemRefType::get(partialsShape, indexVectorType), loc, rewriter, true);
+  // The selected values, if the remaining elements are selected from them.
+  Value selectedValues;
+  if (innerDimSize % vectorWidth != 0)
+    selectedValues = insertAllocAndDealloc(
+        MemRefType::get(outType.getShape(), elementType), loc, rewriter, true);
+  Value identity = getIdentityValue<ONNXArgOp>(rewriter, loc, elementType);
+  Value vectorIdentity =
+      rewriter.create<vector::BroadcastOp>(loc, vectorType, identity);
+  Value zeroIndices = rewriter.create<vector::BroadcastOp>(
+      loc, indexVectorType, emitConstantOp(rewriter, loc, indexType, 0));
+  SmallVector<int64_t, 16> lanes;
+  for (int64_t i = 0; i < vectorWidth; ++i)
+    lanes.emplace_back(i);
+  Value laneIndices = rewriter.create<ConstantOp>(
+      loc, DenseElementsAttr::get(indexVectorType, llvm::makeArrayRef(lanes)));
+  Value vectorWidthValue =
+      emitConstantOp(rewriter, loc, indexType, vectorWidth);
+  Value zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
+
+  // Map the induction variable of the innermost loop to the first element of
+  // a vector.
+  SmallVector<AffineExpr, 4> vectorExprs;
+  for (int64_t i = 0; i < inRank - 1; ++i)
+    vectorExprs.emplace_back(rewriter.getAffineDimExpr(i));
+  vectorExprs.emplace_back(
+      rewriter.getAffineDimExpr(inRank - 1) * vectorWidth);
+  auto vectorMap =
+      AffineMap::get(inRank, 0, vectorExprs, rewriter.getContext());
+
+  // Loops over the output elements.
+  SmallVector<Value, 4> outerLoopIVs;
+  if (inRank > 1) {
+    BuildKrnlLoop outerLoops(rewriter, loc, inRank - 1);
+    outerLoops.createDefineOp();
+    outerLoops.parallelize(0);
+    for (int64_t i = 0; i < inRank - 1; ++i)
+      outerLoops.pushBounds(0, input, i);
+    outerLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+    for (auto arg : outerLoops.getAllInductionVar())
+      outerLoopIVs.emplace_back(arg);
+  }
+  // The reduced dimension is kept as a dimension of size one, if any.
+  SmallVector<Value, 4> outLoopIVs(outerLoopIVs.begin(), outerLoopIVs.end());
+  outLoopIVs.resize(outRank, zeroIndex);
+
+  // Emit the loop over the innermost dimension, from `lowerBound` to
+  // `upperBound`.
+  auto emitInnerLoop = [&](int64_t lowerBound, int64_t upperBound,
+                           llvm::function_ref<void(ArrayRef<Value>)>
+                               emitSelection) {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop innerLoop(rewriter, loc, 1);
+    innerLoop.createDefineOp();
+    innerLoop.pushBounds(lowerBound, upperBound);
+    innerLoop.createIterateOp();
+    rewriter.setInsertionPointToStart(innerLoop.getIterateBlock());
+    SmallVector<Value, 4> inLoopIVs(outerLoopIVs.begin(), outerLoopIVs.end());
+    inLoopIVs.emplace_back(innerLoop.getInductionVar(0));
+    emitSelection(inLoopIVs);
+  };
+
+  rewriter.create<AffineStoreOp>(
+      loc, vectorIdentity, partialValues, outerLoopIVs);
+  rewriter.create<AffineStoreOp>(
+      loc, zeroIndices, partialIndices, outerLoopIVs);
+  emitInnerLoop(0, numVectors, [&](ArrayRef<Value> inLoopIVs) {
+    Value next = rewriter.create<AffineVectorLoadOp>(
+        loc, vectorType, input, vectorMap, inLoopIVs);
+    // The indices of the lanes of the vector.
+    Value first = rewriter.create<MulIOp>(loc,
+        rewriter.create<IndexCastOp>(loc, inLoopIVs.back(), indexType),
+        vectorWidthValue);
+    Value nextIndices = rewriter.create<AddIOp>(loc,
+        rewriter.create<vector::BroadcastOp>(loc, indexVectorType, first),
+        laneIndices);
+    emitArgSelection<ONNXArgOp>(rewriter, loc, op, next, nextIndices,
+        partialValues, partialIndices, outerLoopIVs);
+  });
+
+  // Combine the lanes, the first of equal elements being the one of lowest
+  // index.
+  Value values =
+      rewriter.create<AffineLoadOp>(loc, partialValues, outerLoopIVs);
+  Value indices =
+      rewriter.create<AffineLoadOp>(loc, partialIndices, outerLoopIVs);
+  Value selected = rewriter.create<vector::ExtractOp>(
+      loc, values, ArrayRef<int64_t>{0});
+  Value selectedIndex = rewriter.create<vector::ExtractOp>(
+      loc, indices, ArrayRef<int64_t>{0});
+  for (int64_t i = 1; i < vectorWidth; ++i) {
+    Value next = rewriter.create<vector::ExtractOp>(
+        loc, values, ArrayRef<int64_t>{i});
+    Value nextIndex = rewriter.create<vector::ExtractOp>(
+        loc, indices, ArrayRef<int64_t>{i});
+    Value isEqualAndFirst = rewriter.create<AndOp>(loc,
+        rewriter.create<CmpFOp>(loc, CmpFPredicate::OEQ, next, selected),
+        rewriter.create<CmpIOp>(
+            loc, CmpIPredicate::slt, nextIndex, selectedIndex));
+    Value isSelected = rewriter.create<OrOp>(loc,
+        emitScalarOpFor<ONNXArgOp>(
+            rewriter, loc, op, elementType, {selected, next}),
+        isEqualAndFirst);
+    selected = rewriter.create<SelectOp>(loc, isSelected, next, selected);
+    selectedIndex =
+        rewriter.create<SelectOp>(loc, isSelected, nextIndex, selectedIndex);
+  }
+  rewriter.create<AffineStoreOp>(loc, selectedIndex, alloc, outLoopIVs);
+
+  // Scalar loop for the remaining elements of the innermost dimension, whose
+  // indices follow the indices of the vectors.
+  if (selectedValues) {
+    rewriter.create<AffineStoreOp>(loc, selected, selectedValues, outLoopIVs);
+    emitInnerLoop(numVectors * vectorWidth, innerDimSize,
+        [&](ArrayRef<Value> inLoopIVs) {
+          Value next = rewriter.create<AffineLoadOp>(loc, input, inLoopIVs);
+          Value nextIndex =
+              rewriter.create<IndexCastOp>(loc, inLoopIVs.back(), indexType);
+          emitArgSelection<ONNXArgOp>(rewriter, loc, op, next, nextIndex,
+              selectedValues, alloc, outLoopIVs);
+        });
+  }
+}
+
+template <typename ONNXArgOp>
+struct ONNXArgMinMaxOpLowering : public ConversionPattern {
+  // Number of bits of the vectors used for the innermost reduced dimension, 0
+  // if the operation is not vectorized.
+  int64_t vectorBits = 0;
+
+  ONNXArgMinMaxOpLowering(MLIRContext *ctx, int64_t vectorBits = 0)
+      : ConversionPattern(ONNXArgOp::getOperationName(), 1, ctx) {
+    this->vectorBits = vectorBits;
+  }
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    /*
+     * The index of the greatest, or smallest, element along the axis is
+     * selected in a single pass over the input, e.g. for axis = 1:
+     *
+     * krnl.iterate() with (i0, i1, i2) {
+     *   if (X(i0, i1, i2) > V(i0, 0, i2)) {
+     *     V(i0, 0, i2) = X(i0, i1, i2)
+     *     Y(i0, 0, i2) = i1
+     *   }
+     * }
+     *
+     */
+    auto loc = op->getLoc();
+    auto input = operands[0];
+    auto memRefInType = input.getType().cast<MemRefType>();
+    auto memRefOutType = convertToMemRefType(*op->result_type_begin());
+    auto elementType = memRefInType.getElementType();
+    int64_t inRank = memRefInType.getRank();
+    int64_t outRank = memRefOutType.getRank();
+    auto argOp = llvm::cast<ONNXArgOp>(op);
+    int64_t axis = argOp.axis();
+    axis = axis >= 0 ? axis : (inRank + axis);
+    bool isKeepdims = argOp.keepdims() == 1;
+    std::map<int64_t, int64_t> outInDimMap =
+        getReductionMapping(memRefInType, {axis}, isKeepdims);
+
+    // Insert an allocation and deallocation for the result of this operation,
+    // and for the selected values.
+    auto insertReductionAlloc = [&](MemRefType type, bool insertDealloc) {
+      if (hasAllConstantDimensions(type))
+        return insertAllocAndDealloc(type, loc, rewriter, insertDealloc);
+      SmallVector<Value, 2> allocOperands;
+      for (decltype(outRank) i = 0; i < outRank; ++i)
+        if (type.getShape()[i] < 0)
+          allocOperands.push_back(
+              rewriter.create<DimOp>(loc, input, outInDimMap[i]));
+      Value alloc = rewriter.create<AllocOp>(loc, type, allocOperands);
+      if (insertDealloc) {
+        auto *parentBlock = alloc.getDefiningOp()->getBlock();
+        auto dealloc = rewriter.create<DeallocOp>(loc, alloc);
+        dealloc.getOperation()->moveBefore(&parentBlock->back());
+      }
+      return alloc;
+    };
+    Value alloc = insertReductionAlloc(memRefOutType, checkInsertDealloc(op));
+    auto indexType = memRefOutType.getElementType();
+
+    // When the innermost axis is reduced, the selection is vectorized along
+    // the innermost dimension with vectors of `vectorBits` bits.
+    int64_t vectorWidth =
+        getReductionVectorWidth(memRefInType, {axis}, vectorBits);
+    if (vectorWidth) {
+      emitVectorizedArgReduction<ONNXArgOp>(
+          rewriter, loc, op, input, alloc, vectorWidth);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+
+    Value selectedValues = insertReductionAlloc(
+        MemRefType::get(memRefOutType.getShape(), elementType), true);
+
+    // 1. Initialize the selected values and indices.
+    BuildKrnlLoop initLoops(rewriter, loc, outRank);
+    initLoops.createDefineAndIterateOp(alloc);
+    auto ipInit = rewriter.saveInsertionPoint();
+    rewriter.setInsertionPointToStart(initLoops.getIterateBlock());
+    auto initIVs = initLoops.getAllInductionVar();
+    rewriter.create<AffineStoreOp>(loc,
+        getIdentityValue<ONNXArgOp>(rewriter, loc, elementType),
+        selectedValues, initIVs);
+    rewriter.create<AffineStoreOp>(loc,
+        emitConstantOp(rewriter, loc, indexType, 0), alloc, initIVs);
+    rewriter.restoreInsertionPoint(ipInit);
+
+    // 2. Select the elements. The loops over the dimensions before the axis
+    // only write their own output elements, so they run in parallel.
+    BuildKrnlLoop loops(rewriter, loc, inRank);
+    loops.createDefineOp();
+    for (decltype(inRank) i = 0; i < inRank; ++i)
+      loops.pushBounds(0, input, i);
+    if (axis > 0)
+      loops.parallelize(0);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    auto inLoopIVs = loops.getAllInductionVar();
+    SmallVector<Value, 4> outLoopIVs;
+    Value zeroIndex = nullptr;
+    for (decltype(outRank) i = 0; i < outRank; ++i) {
+      if (outInDimMap.find(i) != outInDimMap.end()) {
+        outLoopIVs.push_back(inLoopIVs[outInDimMap[i]]);
+      } else {
+        if (!zeroIndex)
+          zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
+        outLoopIVs.push_back(zeroIndex);
+      }
     }
+    Value next = rewriter.create<AffineLoadOp>(loc, input, inLoopIVs);
+    Value nextIndex =
+        rewriter.create<IndexCastOp>(loc, inLoopIVs[axis], indexType);
+    emitArgSelection<ONNXArgOp>(rewriter, loc, op, next, nextIndex,
+        selectedValues, alloc, outLoopIVs);
 
+    rewriter.setInsertionPoint(op);
     rewriter.replaceOp(op, alloc);
     return success();
   }
 };
 
 void populateLoweringONNXReductionOpPattern(
-    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+    OwningRewritePatternList &patterns, MLIRContext *ctx, int64_t vectorBits) {
   patterns.insert<ONNXReductionOpLowering<mlir::ONNXReduceMaxOp>,
       ONNXReductionOpLowering<mlir::ONNXReduceMinOp>,
       ONNXReductionOpLowering<mlir::ONNXReduceProdOp>,
-      ONNXReductionOpLowering<mlir::ONNXReduceSumOp>>(ctx);
+      ONNXReductionOpLowering<mlir::ONNXReduceSumOp>>(
+      ctx, /*computeMean=*/false, vectorBits);
   patterns.insert<ONNXReductionOpLowering<mlir::ONNXReduceMeanOp>>(
-      ctx, /*computeMean=*/true);
+      ctx, /*computeMean=*/true, vectorBits);
+  patterns.insert<ONNXArgMinMaxOpLowering<mlir::ONNXArgMaxOp>,
+      ONNXArgMinMaxOpLowering<mlir::ONNXArgMinOp>>(ctx, vectorBits);
 }
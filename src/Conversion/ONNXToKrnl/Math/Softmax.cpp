@@ -8,19 +8,106 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Dialect/Vector/VectorOps.h"
+
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 using namespace mlir;
 
+// Emit a loop nest over the dimensions [axis, rank) of `input`, whose
+// innermost loop iterates from `lowerBound` to `upperBound` (over the whole
+// dimension when `upperBound` is negative), and call `emitBody` with the
+// induction variables of the loop nest.
+static void emitSoftmaxRowLoops(ConversionPatternRewriter &rewriter,
+    Location loc, Value input, int64_t axis, int64_t lowerBound,
+    int64_t upperBound, llvm::function_ref<void(ArrayRef<Value>)> emitBody) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  int64_t rank = input.getType().cast<MemRefType>().getRank();
+  BuildKrnlLoop loops(rewriter, loc, rank - axis);
+  loops.createDefineOp();
+  for (int64_t i = axis; i < rank - 1; ++i)
+    loops.pushBounds(0, input, i);
+  if (upperBound < 0)
+    loops.pushBounds(0, input, rank - 1);
+  else
+    loops.pushBounds(lowerBound, upperBound);
+  loops.createIterateOp();
+  rewriter.setInsertionPointToStart(loops.getIterateBlock());
+  SmallVector<Value, 4> loopIVs;
+  for (auto arg : loops.getAllInductionVar())
+    loopIVs.emplace_back(arg);
+  emitBody(loopIVs);
+}
+
+// Merge a value x of weight w into the running max m and sum s of the
+// exponentials of a row, where the sum is relative to the max:
+//
+//   m' = max(m, x),  t = m' == -inf ? 0 : m'
+//   if x > m: s = s * exp(m - t) + w
+//   else:     s = s + w * exp(x - t)
+//   m = m'
+//
+// so that a single exponential is computed per merge. The exponential is
+// taken relative to t rather than m', which is -inf until an element is not
+// -inf, so that the leading elements masked out with -inf add exp(-inf) = 0
+// rather than exp(-inf + inf) = NaN. The weight is 1 when `weight` is null.
+// The values can be scalars or vectors.
+static void emitOnlineSoftmaxUpdate(ConversionPatternRewriter &rewriter,
+    Location loc, Value x, Value weight, Value max, Value sum) {
+  Value m = rewriter.create<AffineLoadOp>(loc, max);
+  Value s = rewriter.create<AffineLoadOp>(loc, sum);
+  Value greater = rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, x, m);
+  Value newMax = rewriter.create<SelectOp>(loc, greater, x, m);
+  Value isNegInfinity = rewriter.create<CmpFOp>(loc, CmpFPredicate::OEQ,
+      newMax,
+      emitConstantOp(rewriter, loc, x.getType(),
+          -std::numeric_limits<float>::infinity()));
+  Value shift = rewriter.create<SelectOp>(loc, isNegInfinity,
+      emitConstantOp(rewriter, loc, x.getType(), 0), newMax);
+  Value exp = rewriter.create<ExpOp>(loc,
+      rewriter.create<SubFOp>(loc,
+          rewriter.create<SelectOp>(loc, greater, m, x), shift));
+  Value rescaledSum = rewriter.create<MulFOp>(loc, s, exp);
+  Value weightedExp = exp;
+  if (weight) {
+    rescaledSum = rewriter.create<AddFOp>(loc, rescaledSum, weight);
+    weightedExp = rewriter.create<MulFOp>(loc, weight, exp);
+  } else {
+    Value one = emitConstantOp(rewriter, loc, x.getType(), 1);
+    rescaledSum = rewriter.create<AddFOp>(loc, rescaledSum, one);
+  }
+  Value accumulatedSum = rewriter.create<AddFOp>(loc, s, weightedExp);
+  rewriter.create<AffineStoreOp>(loc,
+      rewriter.create<SelectOp>(loc, greater, rescaledSum, accumulatedSum), sum,
+      ArrayRef<Value>{});
+  rewriter.create<AffineStoreOp>(loc, newMax, max, ArrayRef<Value>{});
+}
+
 struct ONNXSoftmaxOpLowering : public ConversionPattern {
-  ONNXSoftmaxOpLowering(MLIRContext *ctx)
-      : ConversionPattern(mlir::ONNXSoftmaxOp::getOperationName(), 1, ctx) {}
+  ONNXSoftmaxOpLowering(MLIRContext *ctx, int64_t vectorBits = 0)
+      : ConversionPattern(mlir::ONNXSoftmaxOp::getOperationName(), 1, ctx),
+        vectorBits(vectorBits) {}
+
+  // Number of bits of the vectors used along the innermost dimension, 0 if
+  // the operation is not vectorized.
+  int64_t vectorBits;
+
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const final {
     // softmax(x) = let max_x = max(x) in
     //                let exp_x = exp(x - max_x) in
     //                  let sum = sum(exp_x) in
     //                    exp_x / sum
+    //
+    // The max and the sum are computed in a single pass over the input: when
+    // the running max increases, the sum of the exponentials accumulated so
+    // far is rescaled to the new max (see "Online normalizer calculation for
+    // softmax", Milakov and Gimelshein). A second pass computes the result,
+    // so that each row is read twice and written once.
+    //
+    // When vectorized, the innermost dimension is processed by vectors whose
+    // lanes accumulate their own max and sum. The lanes are merged into the
+    // scalar max and sum, which then take in the remaining elements.
     auto memRefType = convertToMemRefType(*op->result_type_begin());
     int64_t rank = memRefType.getRank();
     int64_t axis = llvm::dyn_cast<ONNXSoftmaxOp>(op).axis();
@@ -41,147 +128,144 @@ struct ONNXSoftmaxOpLowering : public ConversionPattern {
       alloc = insertAllocAndDealloc(
           memRefType, loc, rewriter, insertDealloc, input);
 
-    // Shape of the result
-    auto memRefShape = memRefType.getShape();
+    // The innermost dimension is vectorized when it is static and holds at
+    // least one vector.
+    int64_t innerDimSize = memRefType.getShape().back();
+    int64_t vectorWidth = 0;
+    if (vectorBits > 0 && elementType.isa<FloatType>() && innerDimSize > 0) {
+      vectorWidth = vectorBits / elementType.getIntOrFloatBitWidth();
+      if (vectorWidth < 2 || innerDimSize < vectorWidth)
+        vectorWidth = 0;
+    }
+    int64_t numVectors = vectorWidth ? innerDimSize / vectorWidth : 0;
+    VectorType vectorType;
+    if (vectorWidth)
+      vectorType = VectorType::get({vectorWidth}, elementType);
 
-    // Insert allocations and deallocations for sum and max.
+    // Insert allocations and deallocations for sum and max, and for the sum
+    // and max of each lane of the vectors.
     MemRefType scalarMemRefType = MemRefType::get({}, elementType, {}, 0);
     Value sumOp = insertAllocAndDealloc(scalarMemRefType, loc, rewriter, true);
     Value maxOp = insertAllocAndDealloc(scalarMemRefType, loc, rewriter, true);
     Value zero = emitConstantOp(rewriter, loc, elementType, 0);
     Value negInfinity = rewriter.create<ConstantOp>(loc,
         FloatAttr::get(elementType, -std::numeric_limits<float>::infinity()));
-
-    // Define loops.
-    std::vector<Value> originalLoops;
-    defineLoops(rewriter, loc, originalLoops, rank);
+    Value laneSumOp, laneMaxOp, vectorZero, vectorNegInfinity;
+    if (vectorWidth) {
+      MemRefType laneMemRefType = MemRefType::get({}, vectorType, {}, 0);
+      laneSumOp = insertAllocAndDealloc(laneMemRefType, loc, rewriter, true);
+      laneMaxOp = insertAllocAndDealloc(laneMemRefType, loc, rewriter, true);
+      vectorZero = emitConstantOp(rewriter, loc, vectorType, 0);
+      vectorNegInfinity = emitConstantOp(rewriter, loc, vectorType,
+          -std::numeric_limits<float>::infinity());
+    }
 
     // Coerce the input into a 2-D tensor. `axis` will be the coercing point.
     // This coercing follows the softmax definition in ONNX:
     // https://github.com/onnx/onnx/blob/master/docs/Operators.md#Softmax
-    // Here, we create an outer loop and inner loop for handling the two
-    // dimensions. The outer loop is only created once `axis` is not zero.
-
-    // Define an outer loop with respect to axis.
-    std::vector<Value> outerLoops;
-    outerLoops.reserve(axis);
-    for (int i = 0; i < axis; ++i) {
-      outerLoops.push_back(originalLoops[i]);
-    }
-    KrnlIterateOperandPack outerPack(rewriter, outerLoops);
-    for (int i = 0; i < axis; ++i)
-      addDimensionToPack(rewriter, loc, outerPack, input, i);
-
-    // Define an inner loop with respect to axis.
-    std::vector<Value> innerLoops;
-    innerLoops.reserve(rank - axis);
-    for (int i = axis; i < rank; ++i) {
-      innerLoops.push_back(originalLoops[i]);
-    }
-    KrnlIterateOperandPack innerPack(rewriter, innerLoops);
-    for (int i = axis; i < rank; ++i)
-      addDimensionToPack(rewriter, loc, innerPack, input, i);
-
-    KrnlIterateOp outerIterateOp, maxIterateOp, sumIterateOp, softmaxIterateOp;
+    // Here, we create an outer loop nest over the rows, and inner loop nests
+    // over the elements of a row. The outer loop is only created once `axis`
+    // is not zero.
     SmallVector<Value, 4> outerLoopIVs;
     if (axis != 0) {
-      outerIterateOp = rewriter.create<KrnlIterateOp>(loc, outerPack);
+      BuildKrnlLoop outerLoops(rewriter, loc, axis);
+      outerLoops.createDefineOp();
+      for (int64_t i = 0; i < axis; ++i)
+        outerLoops.pushBounds(0, input, i);
+      outerLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+      for (auto arg : outerLoops.getAllInductionVar())
+        outerLoopIVs.emplace_back(arg);
+    }
+    auto getRowIndices = [&](ArrayRef<Value> innerLoopIVs) {
+      SmallVector<Value, 4> indices(outerLoopIVs.begin(), outerLoopIVs.end());
+      indices.append(innerLoopIVs.begin(), innerLoopIVs.end());
+      return indices;
+    };
+    // Map the induction variable of the innermost loop to the first element
+    // of a vector.
+    AffineMap vectorMap;
+    if (vectorWidth) {
+      SmallVector<AffineExpr, 4> vectorExprs;
+      for (int64_t i = 0; i < rank - 1; ++i)
+        vectorExprs.emplace_back(rewriter.getAffineDimExpr(i));
+      vectorExprs.emplace_back(
+          rewriter.getAffineDimExpr(rank - 1) * vectorWidth);
+      vectorMap = AffineMap::get(rank, 0, vectorExprs, rewriter.getContext());
+    }
 
-      // Insert instructions inside the outer loop.
-      Block &outerIterationBlock = outerIterateOp.bodyRegion().front();
-      rewriter.setInsertionPointToStart(&outerIterationBlock);
-      for (auto arg : outerIterationBlock.getArguments())
-        outerLoopIVs.push_back(arg);
+    // Reset accumulators.
+    rewriter.create<AffineStoreOp>(loc, zero, sumOp, ArrayRef<Value>{});
+    rewriter.create<AffineStoreOp>(loc, negInfinity, maxOp, ArrayRef<Value>{});
 
-      // Reset accumulators.
-      rewriter.create<AffineStoreOp>(loc, zero, sumOp, ArrayRef<Value>{});
+    // 1. Compute the max and the sum in a single pass.
+    if (vectorWidth) {
       rewriter.create<AffineStoreOp>(
-          loc, negInfinity, maxOp, ArrayRef<Value>{});
-
-      // Create an inner loop to compute max.
-      maxIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-      // Create an inner loop to compute sum.
-      sumIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-      // Create an inner loop to compute softmax.
-      softmaxIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-    } else {
-      // Reset accumulators.
-      rewriter.create<AffineStoreOp>(loc, zero, sumOp, ArrayRef<Value>{});
+          loc, vectorZero, laneSumOp, ArrayRef<Value>{});
       rewriter.create<AffineStoreOp>(
-          loc, negInfinity, maxOp, ArrayRef<Value>{});
-
-      // Create an inner loop to compute max.
-      maxIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-      // Create an inner loop to compute sum.
-      sumIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-      // Create an inner loop to compute softmax.
-      softmaxIterateOp = rewriter.create<KrnlIterateOp>(loc, innerPack);
-    }
-
-    // Insert instructions inside the max loop.
-    Block &maxIterationBlock = maxIterateOp.bodyRegion().front();
-    rewriter.setInsertionPointToStart(&maxIterationBlock);
+          loc, vectorNegInfinity, laneMaxOp, ArrayRef<Value>{});
+      emitSoftmaxRowLoops(rewriter, loc, input, axis, 0, numVectors,
+          [&](ArrayRef<Value> innerLoopIVs) {
+            Value next = rewriter.create<AffineVectorLoadOp>(loc, vectorType,
+                input, vectorMap, getRowIndices(innerLoopIVs));
+            emitOnlineSoftmaxUpdate(
+                rewriter, loc, next, nullptr, laneMaxOp, laneSumOp);
+          });
 
-    // Get induction variables.
-    SmallVector<Value, 4> maxLoopIVs;
-    for (auto arg : outerLoopIVs)
-      maxLoopIVs.push_back(arg);
-    for (auto arg : maxIterationBlock.getArguments())
-      maxLoopIVs.push_back(arg);
+      // Merge the lanes, each lane standing for the sum of its exponentials.
+      Value laneMax = rewriter.create<AffineLoadOp>(loc, laneMaxOp);
+      Value laneSum = rewriter.create<AffineLoadOp>(loc, laneSumOp);
+      for (int64_t lane = 0; lane < vectorWidth; ++lane) {
+        Value max = rewriter.create<vector::ExtractOp>(
+            loc, laneMax, ArrayRef<int64_t>{lane});
+        Value sum = rewriter.create<vector::ExtractOp>(
+            loc, laneSum, ArrayRef<int64_t>{lane});
+        emitOnlineSoftmaxUpdate(rewriter, loc, max, sum, maxOp, sumOp);
+      }
+    }
+    if (!vectorWidth || innerDimSize % vectorWidth != 0)
+      emitSoftmaxRowLoops(rewriter, loc, input, axis, numVectors * vectorWidth,
+          vectorWidth ? innerDimSize : -1, [&](ArrayRef<Value> innerLoopIVs) {
+            Value next = rewriter.create<AffineLoadOp>(
+                loc, input, getRowIndices(innerLoopIVs));
+            emitOnlineSoftmaxUpdate(
+                rewriter, loc, next, nullptr, maxOp, sumOp);
+          });
 
-    // Compute the max value.
+    // Get the max and the inverse of the sum.
     Value max = rewriter.create<AffineLoadOp>(loc, maxOp);
-    Value nextMax = rewriter.create<AffineLoadOp>(loc, input, maxLoopIVs);
-    auto maxCond =
-        rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, max, nextMax);
-    max = rewriter.create<SelectOp>(loc, maxCond, max, nextMax);
-    rewriter.create<AffineStoreOp>(loc, max, maxOp, ArrayRef<Value>{});
-
-    // Get the max.
-    rewriter.setInsertionPoint(sumIterateOp);
-    max = rewriter.create<AffineLoadOp>(loc, maxOp);
-
-    // Insert instructions inside the sum loop.
-    Block &sumIterationBlock = sumIterateOp.bodyRegion().front();
-    rewriter.setInsertionPointToStart(&sumIterationBlock);
-
-    // Get induction variables.
-    SmallVector<Value, 4> sumLoopIVs;
-    for (auto arg : outerLoopIVs)
-      sumLoopIVs.push_back(arg);
-    for (auto arg : sumIterationBlock.getArguments())
-      sumLoopIVs.push_back(arg);
-
-    // Sum up values.
     Value sum = rewriter.create<AffineLoadOp>(loc, sumOp);
-    Value next = rewriter.create<AffineLoadOp>(loc, input, sumLoopIVs);
-    Value sub = rewriter.create<SubFOp>(loc, next, max);
-    Value exp = rewriter.create<ExpOp>(loc, sub);
-    sum = rewriter.create<AddFOp>(loc, sum, exp);
-    rewriter.create<AffineStoreOp>(loc, sum, sumOp, ArrayRef<Value>{});
-    // Store intermediate values in the result to avoid recomputation.
-    rewriter.create<AffineStoreOp>(loc, exp, alloc, sumLoopIVs);
-
-    // Get the sum.
-    rewriter.setInsertionPoint(softmaxIterateOp);
-    sum = rewriter.create<AffineLoadOp>(loc, sumOp);
-
-    // Insert instructions inside the softmax loop.
-    Block &softmaxIterationBlock = softmaxIterateOp.bodyRegion().front();
-    rewriter.setInsertionPointToStart(&softmaxIterationBlock);
-
-    // Get induction variables.
-    SmallVector<Value, 4> softmaxLoopIVs;
-    for (auto arg : outerLoopIVs)
-      softmaxLoopIVs.push_back(arg);
-    for (auto arg : softmaxIterationBlock.getArguments())
-      softmaxLoopIVs.push_back(arg);
-
-    // Compute softmax.
-    Value expLoadedVal =
-        rewriter.create<AffineLoadOp>(loc, alloc, softmaxLoopIVs);
-    Value result = rewriter.create<DivFOp>(loc, expLoadedVal, sum);
-    rewriter.create<AffineStoreOp>(loc, result, alloc, softmaxLoopIVs);
+    Value one = emitConstantOp(rewriter, loc, elementType, 1);
+    Value invSum = rewriter.create<DivFOp>(loc, one, sum);
+
+    // 2. Compute softmax.
+    if (vectorWidth) {
+      Value vectorMax =
+          rewriter.create<vector::BroadcastOp>(loc, vectorType, max);
+      Value vectorInvSum =
+          rewriter.create<vector::BroadcastOp>(loc, vectorType, invSum);
+      emitSoftmaxRowLoops(rewriter, loc, input, axis, 0, numVectors,
+          [&](ArrayRef<Value> innerLoopIVs) {
+            auto indices = getRowIndices(innerLoopIVs);
+            Value next = rewriter.create<AffineVectorLoadOp>(
+                loc, vectorType, input, vectorMap, indices);
+            Value exp = rewriter.create<ExpOp>(
+                loc, rewriter.create<SubFOp>(loc, next, vectorMax));
+            Value result = rewriter.create<MulFOp>(loc, exp, vectorInvSum);
+            rewriter.create<AffineVectorStoreOp>(
+                loc, result, alloc, vectorMap, indices);
+          });
+    }
+    if (!vectorWidth || innerDimSize % vectorWidth != 0)
+      emitSoftmaxRowLoops(rewriter, loc, input, axis, numVectors * vectorWidth,
+          vectorWidth ? innerDimSize : -1, [&](ArrayRef<Value> innerLoopIVs) {
+            auto indices = getRowIndices(innerLoopIVs);
+            Value next = rewriter.create<AffineLoadOp>(loc, input, indices);
+            Value exp = rewriter.create<ExpOp>(
+                loc, rewriter.create<SubFOp>(loc, next, max));
+            Value result = rewriter.create<MulFOp>(loc, exp, invSum);
+            rewriter.create<AffineStoreOp>(loc, result, alloc, indices);
+          });
 
     rewriter.replaceOp(op, alloc);
 
@@ -190,6 +274,6 @@ struct ONNXSoftmaxOpLowering : public ConversionPattern {
 };
 
 void populateLoweringONNXSoftmaxOpPattern(
-    OwningRewritePatternList &patterns, MLIRContext *ctx) {
-  patterns.insert<ONNXSoftmaxOpLowering>(ctx);
+    OwningRewritePatternList &patterns, MLIRContext *ctx, int64_t vectorBits) {
+  patterns.insert<ONNXSoftmaxOpLowering>(ctx, vectorBits);
 }
@@ -0,0 +1,104 @@
+//===----------- SparseMatMul.cpp - Lowering SparseMatMul Op --------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX SparseMatMul Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/SCF/SCF.h"
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+// Multiply the rows of A by the sparse columns of W, one output element at a
+// time, accumulated in a register:
+//
+//   for i, n:                               (i parallel)
+//     y = B[n]
+//     for p = row_pointers[n] to row_pointers[n + 1]:
+//       y += A[i][column_indices[p]] * values[p]
+//     Y[i][n] = y
+//
+// so that only the non-zero weights are read and multiplied. The weights of
+// a column are contiguous, and the row of A they gather from stays in cache
+// while the columns are iterated over.
+struct ONNXSparseMatMulOpLowering : public ConversionPattern {
+  ONNXSparseMatMulOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXSparseMatMulOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    ONNXSparseMatMulOpAdaptor operandAdaptor(operands);
+    auto loc = op->getLoc();
+    Value A = operandAdaptor.A();
+    Value rowPointers = operandAdaptor.row_pointers();
+    Value columnIndices = operandAdaptor.column_indices();
+    Value values = operandAdaptor.values();
+    Value B = operandAdaptor.B();
+    bool hasBias = !B.getType().isa<NoneType>();
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto elementType = memRefType.getElementType();
+    int64_t rank = memRefType.getRank();
+    if (!elementType.isa<FloatType>() || memRefType.isDynamicDim(rank - 1))
+      return failure();
+
+    // The leading dimensions of the result are those of A.
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc, {A});
+    Value zero = emitConstantOp(rewriter, loc, elementType, 0);
+    Value one = rewriter.create<ConstantIndexOp>(loc, 1);
+
+    BuildKrnlLoop loops(rewriter, loc, rank);
+    loops.createDefineOp();
+    for (int64_t i = 0; i < rank; ++i)
+      loops.pushBounds(0, alloc, i);
+    loops.parallelize(0);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    SmallVector<Value, 4> ivs(loops.getAllInductionVar().begin(),
+        loops.getAllInductionVar().end());
+    Value n = ivs.back();
+
+    auto loadIndex = [&](Value memRef, Value position) -> Value {
+      return rewriter.create<IndexCastOp>(loc,
+          rewriter.create<LoadOp>(loc, memRef, position),
+          rewriter.getIndexType());
+    };
+    Value begin = loadIndex(rowPointers, n);
+    Value end = loadIndex(rowPointers, rewriter.create<AddIOp>(loc, n, one));
+    Value init =
+        hasBias ? rewriter.create<AffineLoadOp>(loc, B, n).getResult() : zero;
+
+    // The bounds of the loop over the non-zero weights are loaded, which
+    // affine loops do not allow.
+    auto forOp =
+        rewriter.create<scf::ForOp>(loc, begin, end, one, ValueRange{init});
+    rewriter.setInsertionPointToStart(forOp.getBody());
+    Value p = forOp.getInductionVar();
+    Value sum = forOp.getBody()->getArgument(1);
+    SmallVector<Value, 4> aIndices(ivs.begin(), ivs.end() - 1);
+    aIndices.emplace_back(loadIndex(columnIndices, p));
+    Value a = rewriter.create<LoadOp>(loc, A, aIndices);
+    Value w = rewriter.create<LoadOp>(loc, values, p);
+    sum = rewriter.create<AddFOp>(
+        loc, sum, rewriter.create<MulFOp>(loc, a, w));
+    rewriter.create<scf::YieldOp>(loc, sum);
+
+    rewriter.setInsertionPointAfter(forOp);
+    rewriter.create<AffineStoreOp>(loc, forOp.getResult(0), alloc, ivs);
+
+    rewriter.setInsertionPoint(op);
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+void populateLoweringONNXSparseMatMulOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXSparseMatMulOpLowering>(ctx);
+}
@@ -0,0 +1,312 @@
+//===-------------------- TopK.cpp - Lowering TopK Op ---------------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX TopK Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/SCF/SCF.h"
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+namespace {
+// A binary heap of the K elements selected in a row of the input, stored in
+// the row of the values and indices of the outputs. The worst of the selected
+// elements is at the root of the heap: the smallest one if the largest
+// elements are selected, the largest one otherwise, and the one of greatest
+// index among equal elements.
+class TopKHeap {
+public:
+  TopKHeap(ConversionPatternRewriter &rewriter, Location loc, Value values,
+      Value indices, ArrayRef<Value> rowIVs, int64_t axis, bool largest)
+      : rewriter(rewriter), loc(loc), values(values), indices(indices),
+        rowIVs(rowIVs.begin(), rowIVs.end()), axis(axis), largest(largest) {}
+
+  // Load the value and the index of the element at a position of the heap.
+  std::pair<Value, Value> load(Value position) {
+    auto rowIndices = getRowIndices(position);
+    Value value = rewriter.create<LoadOp>(loc, values, rowIndices);
+    Value index = rewriter.create<LoadOp>(loc, indices, rowIndices);
+    return {value, index};
+  }
+
+  void store(Value position, Value value, Value index) {
+    auto rowIndices = getRowIndices(position);
+    rewriter.create<StoreOp>(loc, value, values, rowIndices);
+    rewriter.create<StoreOp>(loc, index, indices, rowIndices);
+  }
+
+  // Return whether the element (lhs, lhsIndex) comes after the element (rhs,
+  // rhsIndex) in the output.
+  Value isWorse(Value lhs, Value lhsIndex, Value rhs, Value rhsIndex) {
+    Value isWorseValue, isEqual;
+    if (lhs.getType().isa<FloatType>()) {
+      isWorseValue = rewriter.create<CmpFOp>(loc,
+          largest ? CmpFPredicate::OLT : CmpFPredicate::OGT, lhs, rhs);
+      isEqual = rewriter.create<CmpFOp>(loc, CmpFPredicate::OEQ, lhs, rhs);
+    } else {
+      isWorseValue = rewriter.create<CmpIOp>(loc,
+          largest ? CmpIPredicate::slt : CmpIPredicate::sgt, lhs, rhs);
+      isEqual = rewriter.create<CmpIOp>(loc, CmpIPredicate::eq, lhs, rhs);
+    }
+    Value isLaterIndex =
+        rewriter.create<CmpIOp>(loc, CmpIPredicate::sgt, lhsIndex, rhsIndex);
+    return rewriter.create<OrOp>(loc, isWorseValue,
+        rewriter.create<AndOp>(loc, isEqual, isLaterIndex));
+  }
+
+  // Move the element at `start` down the heap of the first `size` positions
+  // until it is not worse than its children. The element moves down at most
+  // `maxLevels` levels, the depth of the heap of K elements:
+  //
+  //   scf.for l = 0 .. maxLevels iter_args(p = start, done = false):
+  //     c = worse child of p, if it exists and not done
+  //     if c is worse than p: swap p and c, p = c
+  //     else: done = true
+  void siftDown(Value start, Value size, int64_t maxLevels) {
+    if (maxLevels == 0)
+      return;
+    OpBuilder::InsertionGuard guard(rewriter);
+    auto indexType = rewriter.getIndexType();
+    auto i1Type = rewriter.getI1Type();
+    Value zero = rewriter.create<ConstantIndexOp>(loc, 0);
+    Value one = rewriter.create<ConstantIndexOp>(loc, 1);
+    Value two = rewriter.create<ConstantIndexOp>(loc, 2);
+    Value levels = rewriter.create<ConstantIndexOp>(loc, maxLevels);
+    Value trueValue =
+        rewriter.create<ConstantOp>(loc, rewriter.getBoolAttr(true));
+    Value falseValue =
+        rewriter.create<ConstantOp>(loc, rewriter.getBoolAttr(false));
+
+    auto forOp = rewriter.create<scf::ForOp>(
+        loc, zero, levels, one, ValueRange{start, falseValue});
+    rewriter.setInsertionPointToStart(forOp.getBody());
+    Value position = forOp.getBody()->getArgument(1);
+    Value done = forOp.getBody()->getArgument(2);
+    Value left = rewriter.create<AddIOp>(
+        loc, rewriter.create<MulIOp>(loc, position, two), one);
+    Value hasChild = rewriter.create<AndOp>(loc,
+        rewriter.create<CmpIOp>(loc, CmpIPredicate::slt, left, size),
+        rewriter.create<XOrOp>(loc, done, trueValue));
+    auto ifOp = rewriter.create<scf::IfOp>(loc, TypeRange{indexType, i1Type},
+        hasChild, /*withElseRegion=*/true);
+    rewriter.create<scf::YieldOp>(loc, ifOp.getResults());
+
+    // The right child is compared with itself if it does not exist.
+    rewriter.setInsertionPointToStart(&ifOp.thenRegion().front());
+    Value right = rewriter.create<AddIOp>(loc, left, one);
+    Value hasRight =
+        rewriter.create<CmpIOp>(loc, CmpIPredicate::slt, right, size);
+    right = rewriter.create<SelectOp>(loc, hasRight, right, left);
+    auto leftElement = load(left);
+    auto rightElement = load(right);
+    Value isRightWorse = isWorse(rightElement.first, rightElement.second,
+        leftElement.first, leftElement.second);
+    Value child = rewriter.create<SelectOp>(loc, isRightWorse, right, left);
+    Value childValue = rewriter.create<SelectOp>(
+        loc, isRightWorse, rightElement.first, leftElement.first);
+    Value childIndex = rewriter.create<SelectOp>(
+        loc, isRightWorse, rightElement.second, leftElement.second);
+    auto parentElement = load(position);
+    Value isSwapped = isWorse(
+        childValue, childIndex, parentElement.first, parentElement.second);
+    store(position,
+        rewriter.create<SelectOp>(
+            loc, isSwapped, childValue, parentElement.first),
+        rewriter.create<SelectOp>(
+            loc, isSwapped, childIndex, parentElement.second));
+    store(child,
+        rewriter.create<SelectOp>(
+            loc, isSwapped, parentElement.first, childValue),
+        rewriter.create<SelectOp>(
+            loc, isSwapped, parentElement.second, childIndex));
+    Value nextPosition =
+        rewriter.create<SelectOp>(loc, isSwapped, child, position);
+    Value isDone = rewriter.create<XOrOp>(loc, isSwapped, trueValue);
+    rewriter.create<scf::YieldOp>(loc, ValueRange{nextPosition, isDone});
+
+    rewriter.setInsertionPointToStart(&ifOp.elseRegion().front());
+    rewriter.create<scf::YieldOp>(loc, ValueRange{position, trueValue});
+  }
+
+private:
+  SmallVector<Value, 4> getRowIndices(Value position) {
+    SmallVector<Value, 4> rowIndices(rowIVs.begin(), rowIVs.end());
+    rowIndices.insert(rowIndices.begin() + axis, position);
+    return rowIndices;
+  }
+
+  ConversionPatternRewriter &rewriter;
+  Location loc;
+  Value values, indices;
+  SmallVector<Value, 4> rowIVs;
+  int64_t axis;
+  bool largest;
+};
+} // namespace
+
+// Read the value of a constant K, defined by an ONNX constant or already
+// lowered to a Krnl global.
+static bool getConstantK(Value value, int64_t &k) {
+  Attribute attr;
+  Operation *defOp = value.getDefiningOp();
+  if (auto constantOp = dyn_cast_or_null<ONNXConstantOp>(defOp))
+    attr = constantOp.valueAttr();
+  else if (auto globalOp = dyn_cast_or_null<KrnlGlobalOp>(defOp))
+    attr = globalOp.value().getValueOr(Attribute());
+  auto denseAttr = attr.dyn_cast_or_null<DenseElementsAttr>();
+  if (!denseAttr || denseAttr.getNumElements() != 1)
+    return false;
+  k = (*denseAttr.getValues<IntegerAttr>().begin()).getInt();
+  return true;
+}
+
+struct ONNXTopKOpLowering : public ConversionPattern {
+  ONNXTopKOpLowering(MLIRContext *ctx)
+      : ConversionPattern(mlir::ONNXTopKOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    // The K selected elements of each row are kept in a heap, so that each
+    // element of the row is compared with the worst selected element only,
+    // and inserted into the heap in O(log K) if it is better:
+    //
+    //   for each row:                           (parallel)
+    //     heap = X[row][0 .. K] with their indices
+    //     heapify(heap)
+    //     for j = K .. N:
+    //       if X[row][j] is better than the root of the heap:
+    //         root = X[row][j], j
+    //         sift down the root
+    //     sort the heap, with the best element first
+    //
+    // The selection takes O(N log K) per row instead of sorting the row in
+    // O(N log N). The heap is stored in the row of the outputs.
+    auto loc = op->getLoc();
+    ONNXTopKOpAdaptor operandAdaptor(operands);
+    auto topKOp = llvm::cast<ONNXTopKOp>(op);
+
+    Value input = operandAdaptor.X();
+    auto inputType = input.getType().cast<MemRefType>();
+    int64_t rank = inputType.getRank();
+    int64_t axis = topKOp.axis();
+    axis = axis >= 0 ? axis : rank + axis;
+    bool largest = topKOp.largest() == 1;
+    bool sorted = topKOp.sorted() == 1;
+    int64_t k;
+    if (!getConstantK(topKOp.K(), k) && !getConstantK(operandAdaptor.K(), k))
+      return failure();
+    int64_t inputSize = inputType.getShape()[axis];
+    if (k < 0 || (inputSize >= 0 && k > inputSize))
+      return failure();
+
+    auto valuesType = convertToMemRefType(op->getResult(0).getType());
+    auto indicesType = convertToMemRefType(op->getResult(1).getType());
+    Value values = insertAllocAndDealloc(
+        valuesType, loc, rewriter, checkInsertDealloc(op, 0), {input});
+    Value indices = insertAllocAndDealloc(
+        indicesType, loc, rewriter, checkInsertDealloc(op, 1), {input});
+    if (k == 0) {
+      rewriter.replaceOp(op, {values, indices});
+      return success();
+    }
+    auto indexType = indicesType.getElementType();
+    int64_t maxLevels = llvm::Log2_64(k);
+
+    // Iterate over the rows of the input along the axis.
+    SmallVector<Value, 4> rowIVs;
+    if (rank > 1) {
+      BuildKrnlLoop rowLoops(rewriter, loc, rank - 1);
+      rowLoops.createDefineOp();
+      for (int64_t i = 0; i < rank; ++i)
+        if (i != axis)
+          rowLoops.pushBounds(0, input, i);
+      rowLoops.parallelize(0);
+      rowLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(rowLoops.getIterateBlock());
+      for (auto arg : rowLoops.getAllInductionVar())
+        rowIVs.emplace_back(arg);
+    }
+    TopKHeap heap(rewriter, loc, values, indices, rowIVs, axis, largest);
+    Value kValue = rewriter.create<ConstantIndexOp>(loc, k);
+    Value zero = rewriter.create<ConstantIndexOp>(loc, 0);
+    auto getInputIndices = [&](Value j) {
+      SmallVector<Value, 4> inputIndices(rowIVs.begin(), rowIVs.end());
+      inputIndices.insert(inputIndices.begin() + axis, j);
+      return inputIndices;
+    };
+    auto emitLoop = [&](int64_t lowerBound, int64_t upperBound,
+                        llvm::function_ref<void(Value)> emitBody) {
+      OpBuilder::InsertionGuard guard(rewriter);
+      BuildKrnlLoop loop(rewriter, loc, 1);
+      loop.createDefineOp();
+      if (upperBound >= 0)
+        loop.pushBounds(lowerBound, upperBound);
+      else
+        loop.pushBounds(lowerBound, input, axis);
+      loop.createIterateOp();
+      rewriter.setInsertionPointToStart(loop.getIterateBlock());
+      emitBody(loop.getInductionVar(0));
+    };
+
+    // 1. Fill the heap with the first K elements of the row.
+    emitLoop(0, k, [&](Value j) {
+      Value value =
+          rewriter.create<AffineLoadOp>(loc, input, getInputIndices(j));
+      heap.store(j, value, rewriter.create<IndexCastOp>(loc, j, indexType));
+    });
+
+    // 2. Heapify, sifting down the elements which have children from the last
+    // one.
+    emitLoop(0, k / 2, [&](Value j) {
+      Value start = rewriter.create<AffineApplyOp>(loc,
+          AffineMap::get(1, 0, k / 2 - 1 - rewriter.getAffineDimExpr(0),
+              rewriter.getContext()),
+          j);
+      heap.siftDown(start, kValue, maxLevels);
+    });
+
+    // 3. Insert the better elements of the rest of the row.
+    if (inputSize != k)
+      emitLoop(k, inputSize, [&](Value j) {
+        Value value =
+            rewriter.create<AffineLoadOp>(loc, input, getInputIndices(j));
+        Value index = rewriter.create<IndexCastOp>(loc, j, indexType);
+        auto root = heap.load(zero);
+        Value isBetter = heap.isWorse(root.first, root.second, value, index);
+        auto ifOp = rewriter.create<scf::IfOp>(
+            loc, TypeRange{}, isBetter, /*withElseRegion=*/false);
+        rewriter.setInsertionPointToStart(&ifOp.thenRegion().front());
+        heap.store(zero, value, index);
+        heap.siftDown(zero, kValue, maxLevels);
+      });
+
+    // 4. Sort the heap by moving the worst element to the end of the heap.
+    if (sorted && k > 1)
+      emitLoop(0, k - 1, [&](Value j) {
+        Value end = rewriter.create<AffineApplyOp>(loc,
+            AffineMap::get(1, 0, k - 1 - rewriter.getAffineDimExpr(0),
+                rewriter.getContext()),
+            j);
+        auto root = heap.load(zero);
+        auto last = heap.load(end);
+        heap.store(zero, last.first, last.second);
+        heap.store(end, root.first, root.second);
+        heap.siftDown(zero, end, maxLevels);
+      });
+
+    rewriter.setInsertionPoint(op);
+    rewriter.replaceOp(op, {values, indices});
+    return success();
+  }
+};
+
+void populateLoweringONNXTopKOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXTopKOpLowering>(ctx);
+}
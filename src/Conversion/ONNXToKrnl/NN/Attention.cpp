@@ -0,0 +1,268 @@
+//===-------------- Attention.cpp - Lowering Fused Attention Op -----------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX fused attention operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+// Number of keys whose scores are computed at a time. The scores of a block
+// stay in the L1 cache between their computation and their use.
+static const int64_t kAttentionKeyBlockSize = 64;
+
+// Emit a loop from 0 to `upperBound`, or to the minimum of the results of
+// `upperBoundMap` applied to `mapOperand` when the map is set, and call
+// `emitBody` with its induction variable.
+static void emitAttentionLoop(ConversionPatternRewriter &rewriter,
+    Location loc, int64_t upperBound, llvm::function_ref<void(Value)> emitBody,
+    AffineMap upperBoundMap = AffineMap(), Value mapOperand = nullptr) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  BuildKrnlLoop loop(rewriter, loc, 1);
+  loop.createDefineOp();
+  if (upperBoundMap)
+    loop.pushBounds(0, upperBoundMap, mapOperand);
+  else
+    loop.pushBounds(0, upperBound);
+  loop.createIterateOp();
+  rewriter.setInsertionPointToStart(loop.getIterateBlock());
+  emitBody(loop.getInductionVar(0));
+}
+
+struct ONNXFusedAttentionOpLowering : public ConversionPattern {
+  ONNXFusedAttentionOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXFusedAttentionOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    // Y = softmax(Q * K * scale + mask) * V
+    //
+    // Each row of the result is computed from the scores of its query with
+    // one block of keys at a time, with the online normalizer of the Softmax
+    // lowering extended to the weighted sum of the values: the row
+    // accumulates the values weighted by the exponentials of the scores
+    // relative to the running max of the scores, and is rescaled whenever a
+    // block raises the max:
+    //
+    //   for each block of keys:
+    //     s[j] = q * k[j] * scale + mask[j]
+    //     m' = max(m, max(s)),  t = m' == -inf ? 0 : m',  c = exp(m - t)
+    //     sum = sum * c + sum(exp(s[j] - t))
+    //     y = y * c + sum(exp(s[j] - t) * v[j])
+    //     m = m'
+    //   y = y / sum
+    //
+    // The exponentials are taken relative to t rather than m', which is -inf
+    // until a key is not masked out, so that the blocks fully masked out with
+    // -inf add exp(-inf) = 0 rather than exp(-inf + inf) = NaN.
+    //
+    // Only the scores of one block are kept, instead of the whole [..., S, L]
+    // score tensor.
+    ONNXFusedAttentionOpAdaptor operandAdaptor(operands);
+    auto attentionOp = llvm::cast<ONNXFusedAttentionOp>(op);
+    auto loc = op->getLoc();
+    Value queries = operandAdaptor.Q();
+    Value keys = operandAdaptor.K();
+    Value values = operandAdaptor.V();
+    Value mask = operandAdaptor.mask();
+    bool hasMask = !mask.getType().isa<NoneType>();
+
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto elementType = memRefType.getElementType();
+    int64_t rank = memRefType.getRank();
+    auto keysShape = keys.getType().cast<MemRefType>().getShape();
+    int64_t depth = keysShape[rank - 2];
+    int64_t numKeys = keysShape[rank - 1];
+    int64_t valueDepth = memRefType.getShape()[rank - 1];
+    int64_t blockSize = std::min(kAttentionKeyBlockSize, numKeys);
+    int64_t numBlocks = (numKeys + blockSize - 1) / blockSize;
+
+    Value alloc = insertAllocAndDealloc(
+        memRefType, loc, rewriter, checkInsertDealloc(op));
+
+    // The scores of the block and the statistics of the row are held once
+    // per iteration of the outermost loop, which is parallel.
+    int64_t numRowGroups = memRefType.getShape()[0];
+    auto statType = MemRefType::get({numRowGroups}, elementType);
+    auto blockType = MemRefType::get({numRowGroups, blockSize}, elementType);
+    Value blockScores = insertAllocAndDealloc(blockType, loc, rewriter, true);
+    Value blockMaxOp = insertAllocAndDealloc(statType, loc, rewriter, true);
+    Value maxOp = insertAllocAndDealloc(statType, loc, rewriter, true);
+    Value sumOp = insertAllocAndDealloc(statType, loc, rewriter, true);
+
+    Value zero = emitConstantOp(rewriter, loc, elementType, 0);
+    Value one = emitConstantOp(rewriter, loc, elementType, 1);
+    Value negInfinity = rewriter.create<ConstantOp>(loc,
+        FloatAttr::get(elementType, -std::numeric_limits<float>::infinity()));
+    Value scale = rewriter.create<ConstantOp>(
+        loc, FloatAttr::get(elementType,
+                 attentionOp.scaleAttr().getValueAsDouble()));
+    Value zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
+
+    // Keys of a block: [block * blockSize, min((block + 1) * blockSize, L)).
+    AffineExpr blockExpr = rewriter.getAffineDimExpr(0);
+    AffineMap keyMap = AffineMap::get(2, 0,
+        {blockExpr * blockSize + rewriter.getAffineDimExpr(1)},
+        rewriter.getContext());
+    AffineMap blockSizeMap = AffineMap::get(1, 0,
+        {rewriter.getAffineConstantExpr(blockSize),
+            rewriter.getAffineConstantExpr(numKeys) - blockExpr * blockSize},
+        rewriter.getContext());
+
+    // Iterate over the rows of the result.
+    BuildKrnlLoop rowLoops(rewriter, loc, rank - 1);
+    rowLoops.createDefineOp();
+    for (int64_t i = 0; i < rank - 1; ++i)
+      rowLoops.pushBounds(0, alloc, i);
+    rowLoops.parallelize(0);
+    rowLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(rowLoops.getIterateBlock());
+    SmallVector<Value, 4> rowIVs(rowLoops.getAllInductionVar().begin(),
+        rowLoops.getAllInductionVar().end());
+    Value row = rowIVs.back();
+    SmallVector<Value, 1> statIVs = {rowIVs[0]};
+    auto getIndices = [&](Value first, Value second) {
+      SmallVector<Value, 4> indices(rowIVs.begin(), rowIVs.end() - 1);
+      indices.emplace_back(first);
+      indices.emplace_back(second);
+      return indices;
+    };
+    // The mask is broadcast along its dimensions of size 1.
+    auto getMaskIndices = [&](Value key) {
+      auto scoreIndices = getIndices(row, key);
+      auto maskShape = mask.getType().cast<MemRefType>().getShape();
+      int64_t offset = rank - maskShape.size();
+      SmallVector<Value, 4> indices;
+      for (int64_t i = 0; i < (int64_t)maskShape.size(); ++i)
+        indices.emplace_back(
+            maskShape[i] == 1 ? zeroIndex : scoreIndices[offset + i]);
+      return indices;
+    };
+
+    rewriter.create<AffineStoreOp>(loc, negInfinity, maxOp, statIVs);
+    rewriter.create<AffineStoreOp>(loc, zero, sumOp, statIVs);
+    emitAttentionLoop(rewriter, loc, valueDepth, [&](Value col) {
+      rewriter.create<AffineStoreOp>(loc, zero, alloc, getIndices(row, col));
+    });
+
+    emitAttentionLoop(rewriter, loc, numBlocks, [&](Value block) {
+      // 1. Compute the scores of the block and their max.
+      rewriter.create<AffineStoreOp>(loc, negInfinity, blockMaxOp, statIVs);
+      emitAttentionLoop(
+          rewriter, loc, blockSize,
+          [&](Value offset) {
+            Value key = rewriter.create<AffineApplyOp>(
+                loc, keyMap, ValueRange{block, offset});
+            SmallVector<Value, 2> scoreIVs = {rowIVs[0], offset};
+            rewriter.create<AffineStoreOp>(loc, zero, blockScores, scoreIVs);
+            emitAttentionLoop(rewriter, loc, depth, [&](Value d) {
+              Value q = rewriter.create<AffineLoadOp>(
+                  loc, queries, getIndices(row, d));
+              Value k =
+                  rewriter.create<AffineLoadOp>(loc, keys, getIndices(d, key));
+              Value partial =
+                  rewriter.create<AffineLoadOp>(loc, blockScores, scoreIVs);
+              rewriter.create<AffineStoreOp>(loc,
+                  rewriter.create<AddFOp>(
+                      loc, partial, rewriter.create<MulFOp>(loc, q, k)),
+                  blockScores, scoreIVs);
+            });
+            Value score = rewriter.create<MulFOp>(loc,
+                rewriter.create<AffineLoadOp>(loc, blockScores, scoreIVs),
+                scale);
+            if (hasMask)
+              score = rewriter.create<AddFOp>(loc, score,
+                  rewriter.create<AffineLoadOp>(
+                      loc, mask, getMaskIndices(key)));
+            rewriter.create<AffineStoreOp>(loc, score, blockScores, scoreIVs);
+            Value blockMax =
+                rewriter.create<AffineLoadOp>(loc, blockMaxOp, statIVs);
+            Value greater = rewriter.create<CmpFOp>(
+                loc, CmpFPredicate::OGT, score, blockMax);
+            rewriter.create<AffineStoreOp>(loc,
+                rewriter.create<SelectOp>(loc, greater, score, blockMax),
+                blockMaxOp, statIVs);
+          },
+          blockSizeMap, block);
+
+      // 2. Rescale the sum and the row, accumulated relative to the previous
+      // max, to the new max.
+      Value max = rewriter.create<AffineLoadOp>(loc, maxOp, statIVs);
+      Value blockMax = rewriter.create<AffineLoadOp>(loc, blockMaxOp, statIVs);
+      Value greater =
+          rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, blockMax, max);
+      Value newMax = rewriter.create<SelectOp>(loc, greater, blockMax, max);
+      Value isNegInfinity = rewriter.create<CmpFOp>(
+          loc, CmpFPredicate::OEQ, newMax, negInfinity);
+      Value shift = rewriter.create<SelectOp>(loc, isNegInfinity, zero, newMax);
+      Value correction = rewriter.create<ExpOp>(
+          loc, rewriter.create<SubFOp>(loc, max, shift));
+      Value sum = rewriter.create<AffineLoadOp>(loc, sumOp, statIVs);
+      rewriter.create<AffineStoreOp>(loc,
+          rewriter.create<MulFOp>(loc, sum, correction), sumOp, statIVs);
+      rewriter.create<AffineStoreOp>(loc, newMax, maxOp, statIVs);
+      emitAttentionLoop(rewriter, loc, valueDepth, [&](Value col) {
+        auto indices = getIndices(row, col);
+        Value partial = rewriter.create<AffineLoadOp>(loc, alloc, indices);
+        rewriter.create<AffineStoreOp>(loc,
+            rewriter.create<MulFOp>(loc, partial, correction), alloc, indices);
+      });
+
+      // 3. Accumulate the exponentials of the scores of the block, and the
+      // values weighted by them.
+      emitAttentionLoop(
+          rewriter, loc, blockSize,
+          [&](Value offset) {
+            Value key = rewriter.create<AffineApplyOp>(
+                loc, keyMap, ValueRange{block, offset});
+            SmallVector<Value, 2> scoreIVs = {rowIVs[0], offset};
+            Value score =
+                rewriter.create<AffineLoadOp>(loc, blockScores, scoreIVs);
+            Value exp = rewriter.create<ExpOp>(
+                loc, rewriter.create<SubFOp>(loc, score, shift));
+            Value partialSum =
+                rewriter.create<AffineLoadOp>(loc, sumOp, statIVs);
+            rewriter.create<AffineStoreOp>(loc,
+                rewriter.create<AddFOp>(loc, partialSum, exp), sumOp,
+                statIVs);
+            emitAttentionLoop(rewriter, loc, valueDepth, [&](Value col) {
+              auto indices = getIndices(row, col);
+              Value v = rewriter.create<AffineLoadOp>(
+                  loc, values, getIndices(key, col));
+              Value partial =
+                  rewriter.create<AffineLoadOp>(loc, alloc, indices);
+              rewriter.create<AffineStoreOp>(loc,
+                  rewriter.create<AddFOp>(
+                      loc, partial, rewriter.create<MulFOp>(loc, exp, v)),
+                  alloc, indices);
+            });
+          },
+          blockSizeMap, block);
+    });
+
+    // Normalize the row.
+    Value invSum = rewriter.create<DivFOp>(
+        loc, one, rewriter.create<AffineLoadOp>(loc, sumOp, statIVs));
+    emitAttentionLoop(rewriter, loc, valueDepth, [&](Value col) {
+      auto indices = getIndices(row, col);
+      Value partial = rewriter.create<AffineLoadOp>(loc, alloc, indices);
+      rewriter.create<AffineStoreOp>(loc,
+          rewriter.create<MulFOp>(loc, partial, invSum), alloc, indices);
+    });
+
+    rewriter.replaceOp(op, alloc);
+
+    return success();
+  }
+};
+
+void populateLoweringONNXFusedAttentionOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXFusedAttentionOpLowering>(ctx);
+}
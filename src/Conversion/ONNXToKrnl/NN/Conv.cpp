@@ -9,23 +9,802 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Dialect/Vector/VectorOps.h"
+
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 using namespace mlir;
 
+//===----------------------------------------------------------------------===//
+// Selection of the lowering strategy.
+//===----------------------------------------------------------------------===//
+
+// Read an optional array attribute holding one value per spatial dimension,
+// e.g. strides or dilations.
+static SmallVector<int64_t, 4> getSpatialAttrValues(
+    ArrayAttr attr, int64_t nSpatial, int64_t defaultValue) {
+  SmallVector<int64_t, 4> values;
+  if (attr)
+    for (auto value : attr.getValue())
+      values.emplace_back(value.cast<IntegerAttr>().getInt());
+  values.resize(nSpatial, defaultValue);
+  return values;
+}
+
+// The im2col and Winograd strategies handle 2-D convolutions with static
+// shapes, a single group, no dilation and no padding (padding is made explicit
+// before lowering, see ConvOpPaddingPattern).
+template <typename ConvOp>
+static bool isLoweredAsGemmCompatible(ConvOp convOp, MemRefType inputType,
+    MemRefType kernelType, MemRefType resultType) {
+  if (inputType.getRank() != 4 || !hasAllConstantDimensions(inputType) ||
+      !hasAllConstantDimensions(kernelType) ||
+      !hasAllConstantDimensions(resultType) ||
+      !resultType.getElementType().isa<FloatType>())
+    return false;
+  if (convOp.group() != 1)
+    return false;
+  auto dilations = getSpatialAttrValues(convOp.dilationsAttr(), 2, 1);
+  if (llvm::any_of(dilations, [](int64_t d) { return d != 1; }))
+    return false;
+  auto pads = getSpatialAttrValues(convOp.padsAttr(), 4, 0);
+  return llvm::all_of(pads, [](int64_t p) { return p == 0; });
+}
+
+// Winograd F(2x2, 3x3) handles 3x3 kernels with unit strides whose output
+// spatial dimensions are multiples of the 2x2 output tile.
+template <typename ConvOp>
+static bool isWinogradCompatible(ConvOp convOp, MemRefType inputType,
+    MemRefType kernelType, MemRefType resultType) {
+  if (!isLoweredAsGemmCompatible(convOp, inputType, kernelType, resultType))
+    return false;
+  auto kernelShape = kernelType.getShape();
+  auto resultShape = resultType.getShape();
+  auto strides = getSpatialAttrValues(convOp.stridesAttr(), 2, 1);
+  return kernelShape[2] == 3 && kernelShape[3] == 3 && strides[0] == 1 &&
+         strides[1] == 1 && resultShape[2] % 2 == 0 && resultShape[3] % 2 == 0;
+}
+
+// Pick the strategy of `auto`: Winograd if it is eligible and cheaper than
+// im2col, else im2col, else the direct loop nest. im2col performs the
+// multiply-accumulates of the direct loop nest as a tiled GEMM over packed
+// columns, so it is taken for all the convolutions it handles: the costs of
+// the memory accesses of the direct loop nest are not modeled. Winograd
+// trades multiply-accumulates for the transforms of the kernel, the input
+// and the output, which are only amortized over enough channels; both costs
+// are counted in operations.
+template <typename ConvOp>
+static ConvLoweringStrategy selectConvStrategy(ConvOp convOp,
+    MemRefType inputType, MemRefType kernelType, MemRefType resultType) {
+  if (!isLoweredAsGemmCompatible(convOp, inputType, kernelType, resultType))
+    return ConvLoweringStrategy::Direct;
+  if (!isWinogradCompatible(convOp, inputType, kernelType, resultType))
+    return ConvLoweringStrategy::Im2Col;
+
+  auto kernelShape = kernelType.getShape();
+  auto resultShape = resultType.getShape();
+  int64_t N = resultShape[0], M = resultShape[1];
+  int64_t P = resultShape[2] * resultShape[3];
+  int64_t C = kernelShape[1], K = kernelShape[2] * kernelShape[3];
+  int64_t macs = N * M * P * C * K;
+
+  // GEMM over the packed columns plus the packing itself.
+  int64_t im2colCost = macs + N * C * K * P;
+  // Element-wise products of 4x4 tiles, kernel, input and output transforms
+  // and initialization of the accumulators.
+  int64_t tiles = P / 4;
+  int64_t winogradCost = N * tiles * M * C * 16 + M * C * 28 +
+                         N * C * tiles * 32 + N * M * tiles * (24 + 16);
+  return winogradCost < im2colCost ? ConvLoweringStrategy::Winograd
+                                   : ConvLoweringStrategy::Im2Col;
+}
+
+//===----------------------------------------------------------------------===//
+// Depthwise lowering.
+//===----------------------------------------------------------------------===//
+
+// Depthwise convolutions have one input channel per group, and M = C *
+// multiplier output channels. The depthwise kernel handles 2-D depthwise
+// convolutions with static shapes and no padding.
+template <typename ConvOp>
+static bool isDepthwiseCompatible(ConvOp convOp, MemRefType inputType,
+    MemRefType kernelType, MemRefType resultType) {
+  if (inputType.getRank() != 4 || !hasAllConstantDimensions(inputType) ||
+      !hasAllConstantDimensions(kernelType) ||
+      !hasAllConstantDimensions(resultType) ||
+      !resultType.getElementType().isa<FloatType>())
+    return false;
+  int64_t group = convOp.group();
+  if (group <= 1 || inputType.getShape()[1] != group ||
+      kernelType.getShape()[1] != 1 || resultType.getShape()[1] % group != 0)
+    return false;
+  auto pads = getSpatialAttrValues(convOp.padsAttr(), 4, 0);
+  return llvm::all_of(pads, [](int64_t p) { return p == 0; });
+}
+
+// Return the number of adjacent outputs of a row of a depthwise convolution
+// computed by the lanes of a vector, or 0 if it is not vectorized. The lanes
+// read contiguous inputs for unit strides along the width, and the operands
+// must not need a conversion to the accumulation type.
+static int64_t getDepthwiseVectorWidth(MemRefType inputType,
+    MemRefType kernelType, MemRefType accType, ArrayRef<int64_t> strides,
+    int64_t vectorBits) {
+  auto elementType = accType.getElementType();
+  if (vectorBits <= 0 || strides[1] != 1 ||
+      inputType.getElementType() != elementType ||
+      kernelType.getElementType() != elementType)
+    return 0;
+  int64_t vectorWidth = vectorBits / elementType.getIntOrFloatBitWidth();
+  if (vectorWidth < 2 || accType.getShape()[3] < vectorWidth)
+    return 0;
+  return vectorWidth;
+}
+
+// R = Conv(D, K) with D (NxCxHxW), K (MxC/groupxKHxKW), group = C and
+// R (NxMxRHxRW) is computed one output row at a time:
+//
+//   for n, m (parallel), r1:
+//     for r2:
+//       R[n][m][r1][r2] = B[m] or 0
+//     for k1, k2:
+//       w = K[m][0][k1][k2]
+//       for r2:
+//         R[n][m][r1][r2] +=
+//             D[n][m / multiplier][s1 * r1 + d1 * k1][s2 * r2 + d2 * k2] * w
+//
+// so that the innermost loop walks the width of the row with a single weight
+// instead of a reduction of length 1 over the input channels. The width loop
+// is vectorized with `vectorWidth` lanes, and the outputs left over by the
+// vectors are computed one at a time.
+template <typename ConvOp>
+static void emitDepthwiseConv(ConversionPatternRewriter &rewriter,
+    Location loc, ConvOp convOp, Value inputOperand, Value kernelOperand,
+    Value biasOperand, bool hasBias, Value alloc, int64_t vectorWidth) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  auto resultShape = memRefType.getShape();
+  auto inputShape = inputOperand.getType().cast<MemRefType>().getShape();
+  auto kernelShape = kernelOperand.getType().cast<MemRefType>().getShape();
+  auto strides = getSpatialAttrValues(convOp.stridesAttr(), 2, 1);
+  auto dilations = getSpatialAttrValues(convOp.dilationsAttr(), 2, 1);
+  int64_t multiplier = resultShape[1] / inputShape[1];
+  int64_t RW = resultShape[3];
+
+  // 1. Iterate over the output rows.
+  BuildKrnlLoop rowLoops(rewriter, loc, 3);
+  rowLoops.createDefineOp();
+  for (int i = 0; i < 3; ++i)
+    rowLoops.pushBounds(0, resultShape[i]);
+  // Images of the batch and output channels are computed independently.
+  rowLoops.parallelize(0);
+  rowLoops.parallelize(1);
+  rowLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(rowLoops.getIterateBlock());
+  Value n = rowLoops.getInductionVar(0);
+  Value m = rowLoops.getInductionVar(1);
+  Value r1 = rowLoops.getInductionVar(2);
+
+  Value initValue;
+  if (hasBias)
+    initValue = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, biasOperand, m), elementType);
+  else
+    initValue = emitConstantOp(rewriter, loc, elementType, 0);
+
+  // Emit the outputs of the row in [lowerBound * width, upperBound * width),
+  // `width` at a time.
+  auto emitRowSegment = [&](int64_t lowerBound, int64_t upperBound,
+                            int64_t width) {
+    OpBuilder::InsertionGuard guard(rewriter);
+    Type type = elementType;
+    if (width > 1)
+      type = VectorType::get({width}, elementType);
+    auto d = [&](unsigned pos) { return rewriter.getAffineDimExpr(pos); };
+    // (n, m, r1, r2) -> (n, m, r1, r2 * width)
+    AffineMap resultMap = AffineMap::get(
+        4, 0, {d(0), d(1), d(2), d(3) * width}, rewriter.getContext());
+    // (n, m, r1, r2, k1, k2) ->
+    //     (n, m floordiv multiplier, s1 * r1 + d1 * k1,
+    //      s2 * r2 * width + d2 * k2)
+    AffineMap dataMap = AffineMap::get(6, 0,
+        {d(0), d(1).floorDiv(multiplier),
+            d(2) * strides[0] + d(4) * dilations[0],
+            d(3) * (strides[1] * width) + d(5) * dilations[1]},
+        rewriter.getContext());
+
+    auto emitLoad = [&](Value memRef, AffineMap map, ArrayRef<Value> indices) {
+      if (width > 1)
+        return rewriter
+            .create<AffineVectorLoadOp>(loc, type, memRef, map, indices)
+            .getResult();
+      return emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, memRef, map, indices),
+          elementType);
+    };
+    auto emitStore = [&](Value value, ArrayRef<Value> indices) {
+      if (width > 1)
+        rewriter.create<AffineVectorStoreOp>(
+            loc, value, alloc, resultMap, indices);
+      else
+        rewriter.create<AffineStoreOp>(loc, value, alloc, resultMap, indices);
+    };
+
+    // 2. Initialize the row with the bias.
+    {
+      OpBuilder::InsertionGuard guard(rewriter);
+      BuildKrnlLoop initLoop(rewriter, loc, 1);
+      initLoop.createDefineOp();
+      initLoop.pushBounds(lowerBound, upperBound);
+      initLoop.createIterateOp();
+      rewriter.setInsertionPointToStart(initLoop.getIterateBlock());
+      Value init = initValue;
+      if (width > 1)
+        init = rewriter.create<vector::BroadcastOp>(loc, type, initValue);
+      emitStore(init, {n, m, r1, initLoop.getInductionVar(0)});
+    }
+
+    // 3. Accumulate the products of the rows of the input with each weight.
+    BuildKrnlLoop kernelLoops(rewriter, loc, 2);
+    kernelLoops.createDefineOp();
+    kernelLoops.pushBounds(0, kernelShape[2]);
+    kernelLoops.pushBounds(0, kernelShape[3]);
+    kernelLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(kernelLoops.getIterateBlock());
+    Value k1 = kernelLoops.getInductionVar(0);
+    Value k2 = kernelLoops.getInductionVar(1);
+    // (m, k1, k2) -> (m, 0, k1, k2)
+    AffineMap kernelMap = AffineMap::get(3, 0,
+        {d(0), rewriter.getAffineConstantExpr(0), d(1), d(2)},
+        rewriter.getContext());
+    Value weight = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(
+            loc, kernelOperand, kernelMap, ValueRange{m, k1, k2}),
+        elementType);
+    if (width > 1)
+      weight = rewriter.create<vector::BroadcastOp>(loc, type, weight);
+
+    BuildKrnlLoop widthLoop(rewriter, loc, 1);
+    widthLoop.createDefineOp();
+    widthLoop.pushBounds(lowerBound, upperBound);
+    widthLoop.createIterateOp();
+    rewriter.setInsertionPointToStart(widthLoop.getIterateBlock());
+    Value r2 = widthLoop.getInductionVar(0);
+    SmallVector<Value, 4> resultIndices = {n, m, r1, r2};
+    Value loadData =
+        emitLoad(inputOperand, dataMap, {n, m, r1, r2, k1, k2});
+    Value loadPartialSum = emitLoad(alloc, resultMap, resultIndices);
+    Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
+        rewriter.create<MulFOp>(loc, loadData, weight));
+    emitStore(result, resultIndices);
+  };
+
+  if (vectorWidth > 1) {
+    int64_t numVectors = RW / vectorWidth;
+    emitRowSegment(0, numVectors, vectorWidth);
+    if (RW % vectorWidth != 0)
+      emitRowSegment(numVectors * vectorWidth, RW, 1);
+  } else {
+    emitRowSegment(0, RW, 1);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// im2col + GEMM lowering.
+//===----------------------------------------------------------------------===//
+
+// Tile sizes of the GEMM loops over output channels (M), output pixels (P)
+// and reduction (C * KH * KW).
+static const int64_t im2colTileM = 16;
+static const int64_t im2colTileP = 64;
+static const int64_t im2colTileK = 64;
+
+// R = Conv(D, K) with D (NxCxHxW), K (MxCxKHxKW) and R (NxMxRHxRW) is
+// computed one image at a time:
+//
+//   for n = 0 .. N:
+//     for c, k1, k2, r1, r2:
+//       col[c * KH * KW + k1 * KW + k2][r1 * RW + r2] =
+//           D[n][c][s1 * r1 + k1][s2 * r2 + k2]
+//     for m, p:
+//       R[n][m][p / RW][p % RW] = B[m] or 0
+//     for m, k, p (tiled):
+//       R[n][m][p / RW][p % RW] += K[m][k] * col[k][p]
+//
+// where K is viewed as a (M x C * KH * KW) matrix. With `useBlas`, the tiled
+// product is a call to the BLAS library.
+template <typename ConvOp>
+static void emitIm2ColConv(ConversionPatternRewriter &rewriter, Location loc,
+    ConvOp convOp, Value inputOperand, Value kernelOperand,
+    Value biasOperand, bool hasBias, Value alloc, bool useBlas = false) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  auto resultShape = memRefType.getShape();
+  auto kernelShape = kernelOperand.getType().cast<MemRefType>().getShape();
+  auto strides = getSpatialAttrValues(convOp.stridesAttr(), 2, 1);
+  int64_t N = resultShape[0], M = resultShape[1];
+  int64_t RH = resultShape[2], RW = resultShape[3];
+  int64_t C = kernelShape[1], KH = kernelShape[2], KW = kernelShape[3];
+  int64_t K = KH * KW, P = RH * RW;
+
+  // The column buffer is shared by all the images of the batch.
+  auto colType = MemRefType::get({C * K, P}, elementType);
+  Value col = insertAllocAndDealloc(colType, loc, rewriter, true);
+  Value zero = emitConstantOp(rewriter, loc, elementType, 0);
+
+  BuildKrnlLoop imageLoop(rewriter, loc, 1);
+  imageLoop.createDefineOp();
+  imageLoop.pushBounds(0, N);
+  imageLoop.createIterateOp();
+  rewriter.setInsertionPointToStart(imageLoop.getIterateBlock());
+  Value n = imageLoop.getInductionVar(0);
+
+  // 1. Pack the input patches into the columns.
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop packLoops(rewriter, loc, 5);
+    packLoops.createDefineOp();
+    packLoops.pushBounds(0, C);
+    packLoops.pushBounds(0, KH);
+    packLoops.pushBounds(0, KW);
+    packLoops.pushBounds(0, RH);
+    packLoops.pushBounds(0, RW);
+    packLoops.parallelize(0);
+    packLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(packLoops.getIterateBlock());
+
+    // (n, c, k1, k2, r1, r2) -> (n, c, s1 * r1 + k1, s2 * r2 + k2)
+    AffineMap dataMap = AffineMap::get(6, 0,
+        {rewriter.getAffineDimExpr(0), rewriter.getAffineDimExpr(1),
+            rewriter.getAffineDimExpr(4) * strides[0] +
+                rewriter.getAffineDimExpr(2),
+            rewriter.getAffineDimExpr(5) * strides[1] +
+                rewriter.getAffineDimExpr(3)},
+        rewriter.getContext());
+    // (c, k1, k2, r1, r2) -> (c * KH * KW + k1 * KW + k2, r1 * RW + r2)
+    AffineMap colMap = AffineMap::get(5, 0,
+        {rewriter.getAffineDimExpr(0) * K + rewriter.getAffineDimExpr(1) * KW +
+                rewriter.getAffineDimExpr(2),
+            rewriter.getAffineDimExpr(3) * RW + rewriter.getAffineDimExpr(4)},
+        rewriter.getContext());
+    SmallVector<Value, 6> dataOperands = {n};
+    SmallVector<Value, 5> colOperands;
+    for (auto arg : packLoops.getAllInductionVar()) {
+      dataOperands.emplace_back(arg);
+      colOperands.emplace_back(arg);
+    }
+    Value loadData = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, inputOperand, dataMap, dataOperands),
+        elementType);
+    rewriter.create<AffineStoreOp>(loc, loadData, col, colMap, colOperands);
+  }
+
+  // (n, m, p) -> (n, m, p floordiv RW, p mod RW)
+  AffineMap resultMap = AffineMap::get(3, 0,
+      {rewriter.getAffineDimExpr(0), rewriter.getAffineDimExpr(1),
+          rewriter.getAffineDimExpr(2).floorDiv(RW),
+          rewriter.getAffineDimExpr(2) % RW},
+      rewriter.getContext());
+
+  // 2. Initialize the output with the bias.
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop initLoops(rewriter, loc, 2);
+    initLoops.createDefineOp();
+    initLoops.pushBounds(0, M);
+    initLoops.pushBounds(0, P);
+    initLoops.parallelize(0);
+    initLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(initLoops.getIterateBlock());
+    Value m = initLoops.getInductionVar(0);
+    Value initValue = zero;
+    if (hasBias)
+      initValue = emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, biasOperand, m), elementType);
+    rewriter.create<AffineStoreOp>(loc, initValue, alloc, resultMap,
+        ValueRange{n, m, initLoops.getInductionVar(1)});
+  }
+
+  // 3. Multiply the kernel matrix by the columns.
+  if (useBlas) {
+    // The matrices of the kernel and the columns start at offset 0, and the
+    // output of the image at n * M * P.
+    Value zeroIndex = rewriter.create<ConstantIndexOp>(loc, 0);
+    Value resultOffset = rewriter.create<AffineApplyOp>(loc,
+        AffineMap::get(1, 0, rewriter.getAffineDimExpr(0) * (M * P),
+            rewriter.getContext()),
+        ValueRange{n});
+    emitBlasGemm(rewriter, loc, kernelOperand, col, alloc, M, P, C * K, 1, 1,
+        false, false, {zeroIndex, zeroIndex, resultOffset});
+    return;
+  }
+  std::vector<Value> loops;
+  defineLoops(rewriter, loc, loops, 3);
+  auto loopType = LoopType::get(rewriter.getContext());
+  auto emitBlock = [&](Value loop, int64_t tileSize, int64_t dimSize) {
+    tileSize = std::max<int64_t>(1, std::min(tileSize, dimSize));
+    return rewriter.create<KrnlBlockOp>(
+        loc, loopType, loopType, loop, rewriter.getI64IntegerAttr(tileSize));
+  };
+  auto mBlock = emitBlock(loops[0], im2colTileM, M);
+  auto kBlock = emitBlock(loops[1], im2colTileK, C * K);
+  auto pBlock = emitBlock(loops[2], im2colTileP, P);
+  // After blocking, the loop nest is (mb, m, kb, k, pb, p). Iterate over
+  // (mb, pb, kb, m, k, p) so that the innermost loop walks contiguous columns
+  // and output pixels.
+  rewriter.create<KrnlPermuteOp>(loc,
+      ValueRange{mBlock.loop_block(), mBlock.loop_local(), kBlock.loop_block(),
+          kBlock.loop_local(), pBlock.loop_block(), pBlock.loop_local()},
+      rewriter.getI64ArrayAttr({0, 3, 2, 4, 1, 5}));
+  // Tiles along M write to disjoint output channels.
+  rewriter.create<KrnlParallelOp>(loc, mBlock.loop_block());
+
+  std::vector<Value> optimizedLoops = {mBlock.loop_block(),
+      pBlock.loop_block(), kBlock.loop_block(), mBlock.loop_local(),
+      kBlock.loop_local(), pBlock.loop_local()};
+  KrnlIterateOperandPack pack(rewriter, loops, optimizedLoops);
+  pack.pushConstantBound(0);
+  pack.pushConstantBound(M);
+  pack.pushConstantBound(0);
+  pack.pushConstantBound(C * K);
+  pack.pushConstantBound(0);
+  pack.pushConstantBound(P);
+  auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
+  Block &iterationBlock = iterateOp.bodyRegion().front();
+  rewriter.setInsertionPointToStart(&iterationBlock);
+  Value m = iterationBlock.getArgument(0);
+  Value k = iterationBlock.getArgument(1);
+  Value p = iterationBlock.getArgument(2);
+
+  // (m, k) -> (m, k floordiv (KH * KW), (k mod (KH * KW)) floordiv KW,
+  //            k mod KW)
+  AffineMap kernelMap = AffineMap::get(2, 0,
+      {rewriter.getAffineDimExpr(0), rewriter.getAffineDimExpr(1).floorDiv(K),
+          (rewriter.getAffineDimExpr(1) % K).floorDiv(KW),
+          rewriter.getAffineDimExpr(1) % KW},
+      rewriter.getContext());
+  Value loadKernel = emitConvertFloat(rewriter, loc,
+      rewriter.create<AffineLoadOp>(
+          loc, kernelOperand, kernelMap, ValueRange{m, k}),
+      elementType);
+  Value loadCol = rewriter.create<AffineLoadOp>(loc, col, ValueRange{k, p});
+  Value loadPartialSum = rewriter.create<AffineLoadOp>(
+      loc, alloc, resultMap, ValueRange{n, m, p});
+  Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
+      rewriter.create<MulFOp>(loc, loadKernel, loadCol));
+  rewriter.create<AffineStoreOp>(
+      loc, result, alloc, resultMap, ValueRange{n, m, p});
+}
+
+//===----------------------------------------------------------------------===//
+// Winograd F(2x2, 3x3) lowering.
+//===----------------------------------------------------------------------===//
+
+// Transform matrices of F(2x2, 3x3), see "Fast Algorithms for Convolutional
+// Neural Networks", Lavin and Gray. The kernel g, input tile d and product
+// tile p are transformed as G g G^T, B^T d B and A^T p A.
+static const double winogradG[4 * 3] = {
+    1.0, 0.0, 0.0, 0.5, 0.5, 0.5, 0.5, -0.5, 0.5, 0.0, 0.0, 1.0};
+static const double winogradBT[4 * 4] = {
+    1.0, 0.0, -1.0, 0.0, 0.0, 1.0, 1.0, 0.0, 0.0, -1.0, 1.0, 0.0, 0.0, 1.0,
+    0.0, -1.0};
+static const double winogradAT[2 * 4] = {
+    1.0, 1.0, 1.0, 0.0, 0.0, 1.0, -1.0, -1.0};
+
+// Emit sum(coefficients[i] * values[i]). Null coefficients are skipped and
+// unit coefficients do not need a multiplication.
+static Value emitLinearCombination(ConversionPatternRewriter &rewriter,
+    Location loc, Type elementType, ArrayRef<double> coefficients,
+    ArrayRef<Value> values) {
+  // Start from a positive term, if any, to avoid a negation.
+  SmallVector<unsigned, 4> order;
+  for (unsigned i = 0; i < coefficients.size(); ++i)
+    if (coefficients[i] != 0)
+      order.emplace_back(i);
+  auto firstPositive = llvm::find_if(
+      order, [&](unsigned i) { return coefficients[i] > 0; });
+  if (firstPositive != order.end())
+    std::rotate(order.begin(), firstPositive, firstPositive + 1);
+
+  Value result;
+  for (unsigned i : order) {
+    Value term = values[i];
+    double magnitude = std::abs(coefficients[i]);
+    if (magnitude != 1.0)
+      term = rewriter.create<MulFOp>(
+          loc, term, emitConstantOp(rewriter, loc, elementType, magnitude));
+    if (!result && coefficients[i] > 0)
+      result = term;
+    else if (!result)
+      result = rewriter.create<NegFOp>(loc, term);
+    else if (coefficients[i] > 0)
+      result = rewriter.create<AddFOp>(loc, result, term);
+    else
+      result = rewriter.create<SubFOp>(loc, result, term);
+  }
+  return result;
+}
+
+// Emit T * tile * T^T for a (rows x size) transform matrix T and a
+// (size x size) tile, both in row-major order. Returns the (rows x rows)
+// transformed tile.
+static SmallVector<Value, 16> emitWinogradTransform(
+    ConversionPatternRewriter &rewriter, Location loc, Type elementType,
+    ArrayRef<double> transform, int64_t rows, ArrayRef<Value> tile) {
+  int64_t size = transform.size() / rows;
+  // T * tile
+  SmallVector<Value, 16> left;
+  for (int64_t i = 0; i < rows; ++i)
+    for (int64_t j = 0; j < size; ++j) {
+      SmallVector<Value, 4> column;
+      for (int64_t l = 0; l < size; ++l)
+        column.emplace_back(tile[l * size + j]);
+      left.emplace_back(emitLinearCombination(rewriter, loc, elementType,
+          transform.slice(i * size, size), column));
+    }
+  // (T * tile) * T^T
+  SmallVector<Value, 16> result;
+  for (int64_t i = 0; i < rows; ++i)
+    for (int64_t j = 0; j < rows; ++j)
+      result.emplace_back(emitLinearCombination(rewriter, loc, elementType,
+          transform.slice(j * size, size),
+          ArrayRef<Value>(left).slice(i * size, size)));
+  return result;
+}
+
+// Return the map (d0, ..., dn-1) -> (d0, ..., dn-1, i, j) accessing element
+// (i, j) of the tiles of a transformed buffer.
+static AffineMap getTileElementMap(ConversionPatternRewriter &rewriter,
+    int64_t numDims, int64_t i, int64_t j) {
+  SmallVector<AffineExpr, 6> exprs;
+  for (int64_t d = 0; d < numDims; ++d)
+    exprs.emplace_back(rewriter.getAffineDimExpr(d));
+  exprs.emplace_back(rewriter.getAffineConstantExpr(i));
+  exprs.emplace_back(rewriter.getAffineConstantExpr(j));
+  return AffineMap::get(numDims, 0, exprs, rewriter.getContext());
+}
+
+// Return the map (n, c, th, tw) -> (n, c, 2 * th + i, 2 * tw + j) accessing
+// element (i, j) of a spatial tile of an input or output image.
+static AffineMap getImageTileMap(
+    ConversionPatternRewriter &rewriter, int64_t i, int64_t j) {
+  return AffineMap::get(4, 0,
+      {rewriter.getAffineDimExpr(0), rewriter.getAffineDimExpr(1),
+          rewriter.getAffineDimExpr(2) * 2 + i,
+          rewriter.getAffineDimExpr(3) * 2 + j},
+      rewriter.getContext());
+}
+
+// R = Conv(D, K) with D (NxCxHxW), K (Mxcx3x3) and R (NxMxRHxRW) is computed
+// on 2x2 output tiles (TH = RH / 2, TW = RW / 2):
+//
+//   U[m][c] = G K[m][c] G^T                        (4x4 tiles)
+//   V[n][c][th][tw] = B^T D[n][c][2th:2th+4][2tw:2tw+4] B
+//   S[n][m][th][tw] = sum_c U[m][c] .* V[n][c][th][tw]
+//   R[n][m][2th:2th+2][2tw:2tw+2] = A^T S[n][m][th][tw] A + B[m]
+static void emitWinogradConv(ConversionPatternRewriter &rewriter, Location loc,
+    Value inputOperand, Value kernelOperand, Value biasOperand, bool hasBias,
+    Value alloc) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  auto resultShape = memRefType.getShape();
+  auto kernelShape = kernelOperand.getType().cast<MemRefType>().getShape();
+  int64_t N = resultShape[0], M = resultShape[1];
+  int64_t TH = resultShape[2] / 2, TW = resultShape[3] / 2;
+  int64_t C = kernelShape[1];
+
+  Value transformedKernel = insertAllocAndDealloc(
+      MemRefType::get({M, C, 4, 4}, elementType), loc, rewriter, true);
+  Value transformedInput = insertAllocAndDealloc(
+      MemRefType::get({N, C, TH, TW, 4, 4}, elementType), loc, rewriter, true);
+  Value products = insertAllocAndDealloc(
+      MemRefType::get({N, M, TH, TW, 4, 4}, elementType), loc, rewriter, true);
+
+  // Emit a loop nest with the given bounds whose outermost loop is parallel,
+  // and call `emitBody` with the induction variables inside of it.
+  auto emitLoopNest = [&](ArrayRef<int64_t> upperBounds,
+                          llvm::function_ref<void(ArrayRef<Value>)> emitBody) {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop loops(rewriter, loc, upperBounds.size());
+    loops.createDefineOp();
+    for (auto upperBound : upperBounds)
+      loops.pushBounds(0, upperBound);
+    loops.parallelize(0);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    SmallVector<Value, 8> ivs;
+    for (auto arg : loops.getAllInductionVar())
+      ivs.emplace_back(arg);
+    emitBody(ivs);
+  };
+
+  // 1. Kernel transform.
+  emitLoopNest({M, C}, [&](ArrayRef<Value> ivs) {
+    SmallVector<Value, 9> tile;
+    for (int64_t i = 0; i < 3; ++i)
+      for (int64_t j = 0; j < 3; ++j)
+        tile.emplace_back(emitConvertFloat(rewriter, loc,
+            rewriter.create<AffineLoadOp>(loc, kernelOperand,
+                getTileElementMap(rewriter, 2, i, j), ivs),
+            elementType));
+    auto transformed = emitWinogradTransform(
+        rewriter, loc, elementType, winogradG, 4, tile);
+    for (int64_t i = 0; i < 4; ++i)
+      for (int64_t j = 0; j < 4; ++j)
+        rewriter.create<AffineStoreOp>(loc, transformed[i * 4 + j],
+            transformedKernel, getTileElementMap(rewriter, 2, i, j), ivs);
+  });
+
+  // 2. Input transform.
+  emitLoopNest({N, C, TH, TW}, [&](ArrayRef<Value> ivs) {
+    SmallVector<Value, 16> tile;
+    for (int64_t i = 0; i < 4; ++i)
+      for (int64_t j = 0; j < 4; ++j)
+        tile.emplace_back(emitConvertFloat(rewriter, loc,
+            rewriter.create<AffineLoadOp>(
+                loc, inputOperand, getImageTileMap(rewriter, i, j), ivs),
+            elementType));
+    auto transformed = emitWinogradTransform(
+        rewriter, loc, elementType, winogradBT, 4, tile);
+    for (int64_t i = 0; i < 4; ++i)
+      for (int64_t j = 0; j < 4; ++j)
+        rewriter.create<AffineStoreOp>(loc, transformed[i * 4 + j],
+            transformedInput, getTileElementMap(rewriter, 4, i, j), ivs);
+  });
+
+  // 3. Element-wise products of the transformed tiles, reduced over the input
+  // channels.
+  Value zero = emitConstantOp(rewriter, loc, elementType, 0);
+  emitLoopNest({N, M, TH, TW, 4, 4}, [&](ArrayRef<Value> ivs) {
+    rewriter.create<AffineStoreOp>(loc, zero, products, ivs);
+  });
+  emitLoopNest({N, M, C, TH, TW, 4, 4}, [&](ArrayRef<Value> ivs) {
+    // ivs = (n, m, c, th, tw, i, j)
+    Value loadKernel = rewriter.create<AffineLoadOp>(loc, transformedKernel,
+        ValueRange{ivs[1], ivs[2], ivs[5], ivs[6]});
+    Value loadInput = rewriter.create<AffineLoadOp>(loc, transformedInput,
+        ValueRange{ivs[0], ivs[2], ivs[3], ivs[4], ivs[5], ivs[6]});
+    SmallVector<Value, 6> productIndices = {
+        ivs[0], ivs[1], ivs[3], ivs[4], ivs[5], ivs[6]};
+    Value loadPartialSum =
+        rewriter.create<AffineLoadOp>(loc, products, productIndices);
+    Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
+        rewriter.create<MulFOp>(loc, loadKernel, loadInput));
+    rewriter.create<AffineStoreOp>(loc, result, products, productIndices);
+  });
+
+  // 4. Output transform.
+  emitLoopNest({N, M, TH, TW}, [&](ArrayRef<Value> ivs) {
+    SmallVector<Value, 16> tile;
+    for (int64_t i = 0; i < 4; ++i)
+      for (int64_t j = 0; j < 4; ++j)
+        tile.emplace_back(rewriter.create<AffineLoadOp>(
+            loc, products, getTileElementMap(rewriter, 4, i, j), ivs));
+    auto transformed = emitWinogradTransform(
+        rewriter, loc, elementType, winogradAT, 2, tile);
+    Value bias;
+    if (hasBias)
+      bias = emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, biasOperand, ivs[1]), elementType);
+    for (int64_t i = 0; i < 2; ++i)
+      for (int64_t j = 0; j < 2; ++j) {
+        Value result = transformed[i * 2 + j];
+        if (hasBias)
+          result = rewriter.create<AddFOp>(loc, result, bias);
+        rewriter.create<AffineStoreOp>(
+            loc, result, alloc, getImageTileMap(rewriter, i, j), ivs);
+      }
+  });
+}
+
+//===----------------------------------------------------------------------===//
+// Epilogue of fused convolutions.
+//===----------------------------------------------------------------------===//
+
+static bool hasConvEpilogue(ONNXConvOp convOp) { return false; }
+
+static bool hasConvEpilogue(ONNXFusedConvOp convOp) { return true; }
+
+static Value emitConvEpilogue(ConversionPatternRewriter &rewriter,
+    Location loc, ONNXConvOp convOp, ArrayRef<Value> operands, Value result,
+    ArrayRef<Value> resultIndices) {
+  return result;
+}
+
+// Apply the residual addition and the activation of a fused convolution to
+// the value of an output element.
+static Value emitConvEpilogue(ConversionPatternRewriter &rewriter,
+    Location loc, ONNXFusedConvOp convOp, ArrayRef<Value> operands,
+    Value result, ArrayRef<Value> resultIndices) {
+  ONNXFusedConvOpAdaptor operandAdaptor(operands);
+  auto elementType = result.getType();
+  Value residualOperand = operandAdaptor.residual();
+  if (!residualOperand.getType().isa<NoneType>()) {
+    Value loadResidual = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, residualOperand, resultIndices),
+        elementType);
+    result = rewriter.create<AddFOp>(loc, result, loadResidual);
+  }
+
+  auto activation = convOp.activation();
+  if (!activation)
+    return result;
+  if (*activation == "Relu" || *activation == "LeakyRelu") {
+    auto zero = emitConstantOp(rewriter, loc, elementType, 0);
+    auto lessThanZero =
+        rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, result, zero);
+    Value negativeValue = zero;
+    if (*activation == "LeakyRelu") {
+      auto alpha = emitConstantOp(
+          rewriter, loc, elementType, convOp.alpha().convertToDouble());
+      negativeValue = rewriter.create<MulFOp>(loc, alpha, result);
+    }
+    return rewriter.create<SelectOp>(loc, lessThanZero, negativeValue, result);
+  }
+  if (*activation == "Clip") {
+    if (auto clipMin = convOp.clip_min()) {
+      auto bound = emitConstantOp(
+          rewriter, loc, elementType, clipMin->convertToDouble());
+      auto lessThanMin =
+          rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, result, bound);
+      result = rewriter.create<SelectOp>(loc, lessThanMin, bound, result);
+    }
+    if (auto clipMax = convOp.clip_max()) {
+      auto bound = emitConstantOp(
+          rewriter, loc, elementType, clipMax->convertToDouble());
+      auto greaterThanMax =
+          rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, result, bound);
+      result = rewriter.create<SelectOp>(loc, greaterThanMax, bound, result);
+    }
+    return result;
+  }
+  llvm_unreachable("unsupported activation of a fused convolution");
+}
+
+// Apply the epilogue of a fused convolution to its whole output, for the
+// strategies computing the output elements in tiles.
+template <typename ConvOp>
+static void emitConvEpilogueLoop(ConversionPatternRewriter &rewriter,
+    Location loc, ConvOp convOp, ArrayRef<Value> operands, Value alloc) {
+  if (!hasConvEpilogue(convOp))
+    return;
+  OpBuilder::InsertionGuard guard(rewriter);
+  BuildKrnlLoop loops(
+      rewriter, loc, alloc.getType().cast<MemRefType>().getRank());
+  loops.createDefineAndIterateOp(alloc);
+  loops.parallelize(0);
+  rewriter.setInsertionPointToStart(loops.getIterateBlock());
+  SmallVector<Value, 4> loopIVs(loops.getAllInductionVar().begin(),
+      loops.getAllInductionVar().end());
+  Value result = rewriter.create<AffineLoadOp>(loc, alloc, loopIVs);
+  result = emitConvEpilogue(rewriter, loc, convOp, operands, result, loopIVs);
+  rewriter.create<AffineStoreOp>(loc, result, alloc, loopIVs);
+}
+
+//===----------------------------------------------------------------------===//
+// Conv lowering.
+//===----------------------------------------------------------------------===//
+
+template <typename ConvOp>
 struct ONNXConvOpLowering : public ConversionPattern {
-  ONNXConvOpLowering(MLIRContext *ctx)
-      : ConversionPattern(mlir::ONNXConvOp::getOperationName(), 1, ctx) {}
+  ONNXConvOpLowering(MLIRContext *ctx, ConvLoweringStrategy strategy,
+      int64_t vectorBits, int64_t blasThreshold)
+      : ConversionPattern(ConvOp::getOperationName(), 1, ctx),
+        strategy(strategy), vectorBits(vectorBits),
+        blasThreshold(blasThreshold) {}
+
+  ConvLoweringStrategy strategy;
+  int64_t vectorBits;
+  int64_t blasThreshold;
 
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const final {
     auto loc = op->getLoc();
-    ONNXConvOpAdaptor operandAdaptor(operands);
+    typename ConvOp::Adaptor operandAdaptor(operands);
     // Insert an allocation and deallocation for the result of this operation.
     auto memRefType = convertToMemRefType(*op->result_type_begin());
     Value alloc;
     bool insertDealloc = checkInsertDealloc(op);
-    ONNXConvOp convOp = llvm::dyn_cast<ONNXConvOp>(op);
+    ConvOp convOp = llvm::dyn_cast<ConvOp>(op);
 
     auto resultShape = memRefType.getShape();
     auto inputOperand = operandAdaptor.X();
@@ -40,6 +819,78 @@ struct ONNXConvOpLowering : public ConversionPattern {
     else
       alloc = insertAllocAndDealloc(
           memRefType, loc, rewriter, insertDealloc, {inputOperand});
+    // Half-precision results are accumulated in f32 and truncated once the
+    // convolution is complete. The operands are extended when loaded, so they
+    // may also be narrower than the result, e.g. bf16 weights.
+    Value acc = insertAccumulationBuffer(rewriter, loc, alloc);
+    auto accElementType = acc.getType().cast<MemRefType>().getElementType();
+
+    // Use the requested strategy when it applies to this convolution, and fall
+    // back to the direct loop nest otherwise.
+    auto inputType = inputOperand.getType().cast<MemRefType>();
+    auto kernelType = kernelOperand.getType().cast<MemRefType>();
+    // Depthwise convolutions use their own kernel whatever the strategy, the
+    // other strategies only handle a single group.
+    if (isDepthwiseCompatible(convOp, inputType, kernelType, memRefType)) {
+      {
+        OpBuilder::InsertionGuard guard(rewriter);
+        auto strides = getSpatialAttrValues(convOp.stridesAttr(), 2, 1);
+        int64_t vectorWidth = getDepthwiseVectorWidth(inputType, kernelType,
+            acc.getType().cast<MemRefType>(), strides, vectorBits);
+        emitDepthwiseConv(rewriter, loc, convOp, inputOperand, kernelOperand,
+            biasOperand, hasBias, acc, vectorWidth);
+      }
+      emitConvEpilogueLoop(rewriter, loc, convOp, operands, acc);
+      emitStoreAccumulators(rewriter, loc, acc, alloc);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+    // Large products of the im2col lowering are left to the BLAS library,
+    // whatever the strategy.
+    if (isLoweredAsGemmCompatible(convOp, inputType, kernelType, memRefType)) {
+      int64_t numPixels = memRefType.getShape()[2] * memRefType.getShape()[3];
+      int64_t patchSize = kernelShape[1] * kernelShape[2] * kernelShape[3];
+      if (isBlasGemmProfitable({inputOperand, kernelOperand, acc},
+              kernelShape[0], numPixels, patchSize, blasThreshold)) {
+        {
+          OpBuilder::InsertionGuard guard(rewriter);
+          emitIm2ColConv(rewriter, loc, convOp, inputOperand, kernelOperand,
+              biasOperand, hasBias, acc, /*useBlas=*/true);
+        }
+        emitConvEpilogueLoop(rewriter, loc, convOp, operands, acc);
+        emitStoreAccumulators(rewriter, loc, acc, alloc);
+        rewriter.replaceOp(op, alloc);
+        return success();
+      }
+    }
+    ConvLoweringStrategy convStrategy = strategy;
+    if (convStrategy == ConvLoweringStrategy::Auto)
+      convStrategy =
+          selectConvStrategy(convOp, inputType, kernelType, memRefType);
+    if (convStrategy == ConvLoweringStrategy::Winograd &&
+        isWinogradCompatible(convOp, inputType, kernelType, memRefType)) {
+      {
+        OpBuilder::InsertionGuard guard(rewriter);
+        emitWinogradConv(rewriter, loc, inputOperand, kernelOperand,
+            biasOperand, hasBias, acc);
+      }
+      emitConvEpilogueLoop(rewriter, loc, convOp, operands, acc);
+      emitStoreAccumulators(rewriter, loc, acc, alloc);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+    if (convStrategy == ConvLoweringStrategy::Im2Col &&
+        isLoweredAsGemmCompatible(convOp, inputType, kernelType, memRefType)) {
+      {
+        OpBuilder::InsertionGuard guard(rewriter);
+        emitIm2ColConv(rewriter, loc, convOp, inputOperand, kernelOperand,
+            biasOperand, hasBias, acc);
+      }
+      emitConvEpilogueLoop(rewriter, loc, convOp, operands, acc);
+      emitStoreAccumulators(rewriter, loc, acc, alloc);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
 
     // R = Conv(D, K)
     //
@@ -96,7 +947,7 @@ struct ONNXConvOpLowering : public ConversionPattern {
     int64_t kernelsPerGroup = floor(kernelShape[0] / group);
     auto kernelsPerGroupValue =
         rewriter.create<ConstantIndexOp>(loc, kernelsPerGroup);
-    auto zero = emitConstantOp(rewriter, loc, memRefType.getElementType(), 0);
+    auto zero = emitConstantOp(rewriter, loc, accElementType, 0);
     Value subchannels;
     if (kernelShape[1] < 0) {
       subchannels = rewriter.create<DimOp>(loc, kernelOperand, 1).getResult();
@@ -116,6 +967,9 @@ struct ONNXConvOpLowering : public ConversionPattern {
       gIndex = outerLoops.pushBounds(0, group);
     //   for m = 0 .. kernelsPerGroup:
     int mIndex = outerLoops.pushBounds(0, kernelsPerGroup);
+    // Images of the batch and output channels are computed independently.
+    outerLoops.parallelize(nIndex);
+    outerLoops.parallelize(mIndex);
     // Outer loop iterations.
     outerLoops.createIterateOp();
     rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
@@ -163,7 +1017,7 @@ struct ONNXConvOpLowering : public ConversionPattern {
         for (auto arg : spatialLoops.getIterateBlock()->getArguments())
           resultIndices.emplace_back(arg);
         // Store initializer value into output location.
-        rewriter.create<AffineStoreOp>(loc, zero, alloc, resultIndices);
+        rewriter.create<AffineStoreOp>(loc, zero, acc, resultIndices);
 
         // 3.2 Define inner loops.
         int64_t nInnerLoops = 1 + (kernelShape.size() - 2);
@@ -178,19 +1032,21 @@ struct ONNXConvOpLowering : public ConversionPattern {
         // 3.4 Emit inner loop nest.
         innerLoops.createIterateOp();
 
-        // Emit the bias, if needed.
-        if (hasBias) {
-          auto loadResult =
-              rewriter.create<AffineLoadOp>(loc, alloc, resultIndices);
-          SmallVector<Value, 4> biasIndices;
-          biasIndices.emplace_back(kernel);
-          auto loadBias =
-              rewriter.create<AffineLoadOp>(loc, biasOperand, kernel);
-          auto resultWithBias =
-              rewriter.create<AddFOp>(loc, loadResult, loadBias);
+        // Emit the bias and the epilogue of fused convolutions, if needed,
+        // on the output element that has just been reduced.
+        if (hasBias || hasConvEpilogue(convOp)) {
+          Value result =
+              rewriter.create<AffineLoadOp>(loc, acc, resultIndices);
+          if (hasBias) {
+            Value loadBias = emitConvertFloat(rewriter, loc,
+                rewriter.create<AffineLoadOp>(loc, biasOperand, kernel),
+                accElementType);
+            result = rewriter.create<AddFOp>(loc, result, loadBias);
+          }
+          result = emitConvEpilogue(
+              rewriter, loc, convOp, operands, result, resultIndices);
           // Store initializer value into output location.
-          rewriter.create<AffineStoreOp>(
-              loc, resultWithBias, alloc, resultIndices);
+          rewriter.create<AffineStoreOp>(loc, result, acc, resultIndices);
         }
 
         //
@@ -250,26 +1106,159 @@ struct ONNXConvOpLowering : public ConversionPattern {
             kernelIndices.emplace_back(innerLoops.getInductionVar(i + 1));
 
           // 4.3 Compute convolution.
-          auto loadData =
-              rewriter.create<AffineLoadOp>(loc, inputOperand, dataIndices);
-          auto loadKernel =
-              rewriter.create<AffineLoadOp>(loc, kernelOperand, kernelIndices);
+          Value loadData = emitConvertFloat(rewriter, loc,
+              rewriter.create<AffineLoadOp>(loc, inputOperand, dataIndices),
+              accElementType);
+          Value loadKernel = emitConvertFloat(rewriter, loc,
+              rewriter.create<AffineLoadOp>(loc, kernelOperand, kernelIndices),
+              accElementType);
           auto loadPartialSum =
-              rewriter.create<AffineLoadOp>(loc, alloc, resultIndices);
+              rewriter.create<AffineLoadOp>(loc, acc, resultIndices);
           Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
               rewriter.create<MulFOp>(loc, loadData, loadKernel));
           // 4.4 Store computed value into output location.
-          rewriter.create<AffineStoreOp>(loc, result, alloc, resultIndices);
+          rewriter.create<AffineStoreOp>(loc, result, acc, resultIndices);
         }
       }
     }
+    rewriter.setInsertionPoint(op);
+    emitStoreAccumulators(rewriter, loc, acc, alloc);
+    rewriter.replaceOp(op, alloc);
+
+    return success();
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// NCHW[x]c lowering.
+//===----------------------------------------------------------------------===//
+
+// R = ConvNCHWc(D, K) with D (NxCBxHxWxb), K (MBxCBxKHxKWxbxb) and
+// R (NxMBxRHxRWxb) is computed as:
+//
+//   for n, mb (parallel), r1, r2:
+//     for mi:
+//       R[n][mb][r1][r2][mi] = B[mb * b + mi] or 0
+//     for cb, k1, k2, ci:
+//       x = D[n][cb][s1 * r1 + k1][s2 * r2 + k2][ci]
+//       for mi:
+//         R[n][mb][r1][r2][mi] += x * K[mb][cb][k1][k2][ci][mi]
+//
+// so that the innermost loop updates a block of contiguous output channels
+// with a block of contiguous kernel values.
+struct ONNXConvNCHWcOpLowering : public ConversionPattern {
+  ONNXConvNCHWcOpLowering(MLIRContext *ctx)
+      : ConversionPattern(mlir::ONNXConvNCHWcOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    ONNXConvNCHWcOpAdaptor operandAdaptor(operands);
+    auto convOp = llvm::cast<ONNXConvNCHWcOp>(op);
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    if (!hasAllConstantDimensions(memRefType))
+      return failure();
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    auto inputOperand = operandAdaptor.X();
+    auto kernelOperand = operandAdaptor.W();
+    auto biasOperand = operandAdaptor.B();
+    bool hasBias = !biasOperand.getType().isa<NoneType>();
+    auto elementType = memRefType.getElementType();
+    auto resultShape = memRefType.getShape();
+    auto kernelShape = kernelOperand.getType().cast<MemRefType>().getShape();
+    auto strides = getSpatialAttrValues(convOp.stridesAttr(), 2, 1);
+    int64_t b = resultShape[4];
+
+    // 1. Iterate over the output pixels.
+    BuildKrnlLoop outerLoops(rewriter, loc, 4);
+    outerLoops.createDefineOp();
+    for (int i = 0; i < 4; ++i)
+      outerLoops.pushBounds(0, resultShape[i]);
+    outerLoops.parallelize(1);
+    outerLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+    Value n = outerLoops.getInductionVar(0);
+    Value mb = outerLoops.getInductionVar(1);
+    Value r1 = outerLoops.getInductionVar(2);
+    Value r2 = outerLoops.getInductionVar(3);
+
+    // 2. Initialize the block of output channels with the bias.
+    {
+      OpBuilder::InsertionGuard guard(rewriter);
+      BuildKrnlLoop initLoop(rewriter, loc, 1);
+      initLoop.createDefineOp();
+      initLoop.pushBounds(0, b);
+      initLoop.createIterateOp();
+      rewriter.setInsertionPointToStart(initLoop.getIterateBlock());
+      Value mi = initLoop.getInductionVar(0);
+      Value initValue = emitConstantOp(rewriter, loc, elementType, 0);
+      if (hasBias) {
+        // (mb, mi) -> (mb * b + mi)
+        AffineMap biasMap = AffineMap::get(2, 0,
+            {rewriter.getAffineDimExpr(0) * b + rewriter.getAffineDimExpr(1)},
+            rewriter.getContext());
+        initValue = rewriter.create<AffineLoadOp>(
+            loc, biasOperand, biasMap, ValueRange{mb, mi});
+      }
+      rewriter.create<AffineStoreOp>(
+          loc, initValue, alloc, ValueRange{n, mb, r1, r2, mi});
+    }
+
+    // 3. Accumulate the products over the input channels and the kernel.
+    BuildKrnlLoop reductionLoops(rewriter, loc, 4);
+    reductionLoops.createDefineOp();
+    reductionLoops.pushBounds(0, kernelShape[1]);
+    reductionLoops.pushBounds(0, kernelShape[2]);
+    reductionLoops.pushBounds(0, kernelShape[3]);
+    reductionLoops.pushBounds(0, b);
+    reductionLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(reductionLoops.getIterateBlock());
+    Value cb = reductionLoops.getInductionVar(0);
+    Value k1 = reductionLoops.getInductionVar(1);
+    Value k2 = reductionLoops.getInductionVar(2);
+    Value ci = reductionLoops.getInductionVar(3);
+
+    // (n, cb, r1, k1, r2, k2, ci) -> (n, cb, s1 * r1 + k1, s2 * r2 + k2, ci)
+    AffineMap dataMap = AffineMap::get(7, 0,
+        {rewriter.getAffineDimExpr(0), rewriter.getAffineDimExpr(1),
+            rewriter.getAffineDimExpr(2) * strides[0] +
+                rewriter.getAffineDimExpr(3),
+            rewriter.getAffineDimExpr(4) * strides[1] +
+                rewriter.getAffineDimExpr(5),
+            rewriter.getAffineDimExpr(6)},
+        rewriter.getContext());
+    Value loadData = rewriter.create<AffineLoadOp>(loc, inputOperand, dataMap,
+        ValueRange{n, cb, r1, k1, r2, k2, ci});
+
+    BuildKrnlLoop channelLoop(rewriter, loc, 1);
+    channelLoop.createDefineOp();
+    channelLoop.pushBounds(0, b);
+    channelLoop.createIterateOp();
+    rewriter.setInsertionPointToStart(channelLoop.getIterateBlock());
+    Value mi = channelLoop.getInductionVar(0);
+    Value loadKernel = rewriter.create<AffineLoadOp>(
+        loc, kernelOperand, ValueRange{mb, cb, k1, k2, ci, mi});
+    SmallVector<Value, 5> resultIndices = {n, mb, r1, r2, mi};
+    Value loadPartialSum =
+        rewriter.create<AffineLoadOp>(loc, alloc, resultIndices);
+    Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
+        rewriter.create<MulFOp>(loc, loadData, loadKernel));
+    rewriter.create<AffineStoreOp>(loc, result, alloc, resultIndices);
+
     rewriter.replaceOp(op, alloc);
 
     return success();
   }
 };
 
-void populateLoweringONNXConvOpPattern(
-    OwningRewritePatternList &patterns, MLIRContext *ctx) {
-  patterns.insert<ONNXConvOpLowering>(ctx);
+void populateLoweringONNXConvOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx, ConvLoweringStrategy strategy, int64_t vectorBits,
+    int64_t blasThreshold) {
+  patterns.insert<ONNXConvOpLowering<ONNXConvOp>,
+      ONNXConvOpLowering<ONNXFusedConvOp>>(
+      ctx, strategy, vectorBits, blasThreshold);
+  patterns.insert<ONNXConvNCHWcOpLowering>(ctx);
 }
@@ -0,0 +1,226 @@
+//===------------ ConvTranspose.cpp - Lowering ConvTranspose Op -----------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX ConvTranspose Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/IntegerSet.h"
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+// Read an optional array attribute holding one value per spatial dimension,
+// e.g. strides or dilations.
+static SmallVector<int64_t, 4> getSpatialAttrValues(
+    ArrayAttr attr, int64_t nSpatial, int64_t defaultValue) {
+  SmallVector<int64_t, 4> values;
+  if (attr)
+    for (auto value : attr.getValue())
+      values.emplace_back(value.cast<IntegerAttr>().getInt());
+  values.resize(nSpatial, defaultValue);
+  return values;
+}
+
+// The transposed convolution scatters each input element, multiplied by the
+// kernel, into the outputs
+//
+//   o = s * i - pb + d * k
+//
+// of each spatial dimension, where s, d and pb are the stride, the dilation and
+// the padding at the beginning of the dimension. It is computed as a gather
+// instead: each output element sums the products of the input elements
+//
+//   i = (o + pb - d * k) / s
+//
+// for the kernel offsets k such that o + pb - d * k is a multiple of s within
+// the input, so that the output elements are computed independently, without
+// concurrent accumulations into the same element:
+//
+//   for n = 0 .. N:                         (parallel)
+//     for g = 0 .. group:
+//       for m = 0 .. M / group:             (parallel)
+//         for o1 = 0 .. O1, o2 = 0 .. O2:
+//           R[n][g * M / group + m][o1][o2] = B[g * M / group + m] or 0
+//           for c = 0 .. C / group:
+//             for k1 = 0 .. K1, k2 = 0 .. K2:
+//               if (o1, o2, k1, k2) hit an input element (i1, i2):
+//                 R[n][g * M / group + m][o1][o2] +=
+//                     D[n][g * C / group + c][i1][i2] *
+//                     K[g * C / group + c][m][k1][k2]
+//
+// with D (N x C x I1 x I2), K (C x M / group x K1 x K2) and
+// R (N x M x O1 x O2), for any number of spatial dimensions.
+struct ONNXConvTransposeOpLowering : public ConversionPattern {
+  ONNXConvTransposeOpLowering(MLIRContext *ctx)
+      : ConversionPattern(ONNXConvTransposeOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    ONNXConvTransposeOpAdaptor operandAdaptor(operands);
+    auto convOp = llvm::cast<ONNXConvTransposeOp>(op);
+
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto inputOperand = operandAdaptor.X();
+    auto kernelOperand = operandAdaptor.W();
+    auto biasOperand = operandAdaptor.B();
+    bool hasBias = !biasOperand.getType().isa<NoneType>();
+    auto inputShape = inputOperand.getType().cast<MemRefType>().getShape();
+    auto kernelShape = kernelOperand.getType().cast<MemRefType>().getShape();
+    auto resultShape = memRefType.getShape();
+
+    // All the dimensions but the batch size must be known at compile time.
+    auto isStaticBeyondBatch = [](ArrayRef<int64_t> shape) {
+      return llvm::all_of(
+          shape.drop_front(), [](int64_t dim) { return dim >= 0; });
+    };
+    if (!isStaticBeyondBatch(inputShape) ||
+        !hasAllConstantDimensions(
+            kernelOperand.getType().cast<MemRefType>()) ||
+        !isStaticBeyondBatch(resultShape))
+      return failure();
+
+    int64_t nSpatial = resultShape.size() - 2;
+    int64_t group = convOp.group();
+    int64_t channelsPerGroup = kernelShape[0] / group;
+    int64_t kernelsPerGroup = kernelShape[1];
+    auto strides = getSpatialAttrValues(convOp.stridesAttr(), nSpatial, 1);
+    auto dilations =
+        getSpatialAttrValues(convOp.dilationsAttr(), nSpatial, 1);
+    auto pads = getSpatialAttrValues(convOp.padsAttr(), 2 * nSpatial, 0);
+
+    // Insert an allocation and deallocation for the result of this operation.
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc;
+    if (hasAllConstantDimensions(memRefType))
+      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+    else
+      alloc = insertAllocAndDealloc(
+          memRefType, loc, rewriter, insertDealloc, {inputOperand});
+    // Half-precision results are accumulated in f32 and truncated once the
+    // sums are complete.
+    Value acc = insertAccumulationBuffer(rewriter, loc, alloc);
+    auto accElementType = acc.getType().cast<MemRefType>().getElementType();
+    Value zero = emitConstantOp(rewriter, loc, accElementType, 0);
+
+    // 1. Iterate over the output elements.
+    BuildKrnlLoop outerLoops(rewriter, loc, 3 + nSpatial);
+    outerLoops.createDefineOp();
+    int nIndex = outerLoops.pushBounds(0, inputOperand, 0);
+    int gIndex = outerLoops.pushBounds(0, group);
+    int mIndex = outerLoops.pushBounds(0, kernelsPerGroup);
+    for (int64_t i = 0; i < nSpatial; ++i)
+      outerLoops.pushBounds(0, resultShape[2 + i]);
+    // Images of the batch and output channels are computed independently.
+    outerLoops.parallelize(nIndex);
+    outerLoops.parallelize(mIndex);
+    outerLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+
+    Value n = outerLoops.getInductionVar(nIndex);
+    Value g = outerLoops.getInductionVar(gIndex);
+    Value m = outerLoops.getInductionVar(mIndex);
+    SmallVector<Value, 4> outputIVs;
+    for (int64_t i = 0; i < nSpatial; ++i)
+      outputIVs.emplace_back(outerLoops.getInductionVar(3 + i));
+
+    // (g, m) -> g * M / group + m
+    Value kernel = rewriter.create<AffineApplyOp>(loc,
+        AffineMap::get(2, 0,
+            rewriter.getAffineDimExpr(0) * kernelsPerGroup +
+                rewriter.getAffineDimExpr(1),
+            rewriter.getContext()),
+        ValueRange{g, m});
+    SmallVector<Value, 4> resultIndices = {n, kernel};
+    resultIndices.append(outputIVs.begin(), outputIVs.end());
+
+    // 2. Initialize the output element with the bias.
+    Value initValue = zero;
+    if (hasBias)
+      initValue = emitConvertFloat(rewriter, loc,
+          rewriter.create<AffineLoadOp>(loc, biasOperand, kernel),
+          accElementType);
+    rewriter.create<AffineStoreOp>(loc, initValue, acc, resultIndices);
+
+    // 3. Gather the products of the input elements hit by the kernel.
+    BuildKrnlLoop innerLoops(rewriter, loc, 1 + nSpatial);
+    innerLoops.createDefineOp();
+    int cIndex = innerLoops.pushBounds(0, channelsPerGroup);
+    for (int64_t i = 0; i < nSpatial; ++i)
+      innerLoops.pushBounds(0, kernelShape[2 + i]);
+    innerLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(innerLoops.getIterateBlock());
+    Value c = innerLoops.getInductionVar(cIndex);
+    SmallVector<Value, 4> kernelIVs;
+    for (int64_t i = 0; i < nSpatial; ++i)
+      kernelIVs.emplace_back(innerLoops.getInductionVar(1 + i));
+
+    // (o..., k...) -> 0 <= o + pb - d * k <= s * (I - 1), and
+    //                 (o + pb - d * k) mod s == 0 for strides s > 1
+    SmallVector<AffineExpr, 8> constraints;
+    SmallVector<bool, 8> eqFlags;
+    SmallVector<AffineExpr, 4> inputExprs;
+    for (int64_t i = 0; i < nSpatial; ++i) {
+      AffineExpr o = rewriter.getAffineDimExpr(i);
+      AffineExpr k = rewriter.getAffineDimExpr(nSpatial + i);
+      AffineExpr offset = o + pads[i] - k * dilations[i];
+      constraints.emplace_back(offset);
+      eqFlags.emplace_back(false);
+      constraints.emplace_back(strides[i] * (inputShape[2 + i] - 1) - offset);
+      eqFlags.emplace_back(false);
+      if (strides[i] > 1) {
+        constraints.emplace_back(offset % strides[i]);
+        eqFlags.emplace_back(true);
+      }
+      inputExprs.emplace_back(offset.floorDiv(strides[i]));
+    }
+    SmallVector<Value, 8> spatialIVs(outputIVs.begin(), outputIVs.end());
+    spatialIVs.append(kernelIVs.begin(), kernelIVs.end());
+    auto ifOp = rewriter.create<AffineIfOp>(loc,
+        IntegerSet::get(2 * nSpatial, 0, constraints, eqFlags), spatialIVs,
+        /*withElseRegion=*/false);
+    rewriter.setInsertionPointToStart(ifOp.getThenBlock());
+
+    // (g, c) -> g * C / group + c
+    Value channel = rewriter.create<AffineApplyOp>(loc,
+        AffineMap::get(2, 0,
+            rewriter.getAffineDimExpr(0) * channelsPerGroup +
+                rewriter.getAffineDimExpr(1),
+            rewriter.getContext()),
+        ValueRange{g, c});
+    SmallVector<Value, 4> dataIndices = {n, channel};
+    for (AffineExpr inputExpr : inputExprs)
+      dataIndices.emplace_back(rewriter.create<AffineApplyOp>(loc,
+          AffineMap::get(2 * nSpatial, 0, inputExpr, rewriter.getContext()),
+          spatialIVs));
+    SmallVector<Value, 4> kernelIndices = {channel, m};
+    kernelIndices.append(kernelIVs.begin(), kernelIVs.end());
+
+    Value loadData = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, inputOperand, dataIndices),
+        accElementType);
+    Value loadKernel = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, kernelOperand, kernelIndices),
+        accElementType);
+    Value loadPartialSum =
+        rewriter.create<AffineLoadOp>(loc, acc, resultIndices);
+    Value result = rewriter.create<AddFOp>(loc, loadPartialSum,
+        rewriter.create<MulFOp>(loc, loadData, loadKernel));
+    rewriter.create<AffineStoreOp>(loc, result, acc, resultIndices);
+
+    rewriter.setInsertionPoint(op);
+    emitStoreAccumulators(rewriter, loc, acc, alloc);
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+void populateLoweringONNXConvTransposeOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXConvTransposeOpLowering>(ctx);
+}
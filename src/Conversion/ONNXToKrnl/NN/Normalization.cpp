@@ -8,6 +8,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Dialect/Vector/VectorOps.h"
+
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 using namespace mlir;
@@ -21,6 +23,7 @@ struct ONNXBatchNormalizationTestModeOpLowering : public ConversionPattern {
       ConversionPatternRewriter &rewriter) const final {
     // batchnorm{epsilon}(x, scale, bias, mean, variance) =
     //      scale * (x - mean) / sqrt(variance + epsilon) + bias
+    //      = x * multiplier + offset, computed once per channel
     ONNXBatchNormalizationTestModeOpAdaptor operandAdaptor(operands);
     auto loc = op->getLoc();
 
@@ -81,6 +84,17 @@ struct ONNXBatchNormalizationTestModeOpLowering : public ConversionPattern {
     auto meanVal = rewriter.create<AffineLoadOp>(loc, mean, loopCIVs);
     auto varianceVal = rewriter.create<AffineLoadOp>(loc, variance, loopCIVs);
 
+    // The parameters are per channel, so the normalization reduces to a
+    // multiply-add per element:
+    //   multiplier = scale / sqrt(variance + epsilon)
+    //   offset = bias - mean * multiplier
+    auto adjustedVarianceVal =
+        rewriter.create<AddFOp>(loc, varianceVal, epsilon);
+    auto divisor = rewriter.create<SqrtOp>(loc, adjustedVarianceVal);
+    auto multiplier = rewriter.create<DivFOp>(loc, scaleVal, divisor);
+    auto meanMultiplier = rewriter.create<MulFOp>(loc, meanVal, multiplier);
+    auto offset = rewriter.create<SubFOp>(loc, biasVal, meanMultiplier);
+
     // Create a KrnlIterateOp along the other dimensions.
     SmallVector<int64_t, 4> axes;
     axes.emplace_back(0);
@@ -114,17 +128,429 @@ struct ONNXBatchNormalizationTestModeOpLowering : public ConversionPattern {
     }
 
     auto xVal = rewriter.create<AffineLoadOp>(loc, operand, loopIVs);
-    // normalize
-    auto dividend = rewriter.create<SubFOp>(loc, xVal, meanVal);
+    auto scaleNormVal = rewriter.create<MulFOp>(loc, xVal, multiplier);
+    auto shiftScaleNormVal = rewriter.create<AddFOp>(loc, scaleNormVal, offset);
+    rewriter.create<AffineStoreOp>(loc, shiftScaleNormVal, alloc, loopIVs);
+
+    rewriter.replaceOp(op, alloc);
+
+    return success();
+  }
+};
+
+// Convert an index to a float of the given type.
+static Value emitIndexToFloat(
+    ConversionPatternRewriter &rewriter, Location loc, Value index, Type type) {
+  auto value =
+      rewriter.create<IndexCastOp>(loc, index, rewriter.getIntegerType(64));
+  return rewriter.create<SIToFPOp>(loc, value, type);
+}
+
+struct ONNXInstanceNormalizationOpLowering : public ConversionPattern {
+  ONNXInstanceNormalizationOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXInstanceNormalizationOp::getOperationName(), 1, ctx) {}
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    // instancenorm{epsilon}(x, scale, bias) =
+    //      scale * (x - mean) / sqrt(variance + epsilon) + bias
+    // where the mean and variance of each instance and channel are taken
+    // over the spatial dimensions D1x...xDn of x.
+    //
+    // They are computed in a single pass over x with Welford's algorithm,
+    // which is numerically stable, then x is normalized with a multiply-add
+    // per element.
+    ONNXInstanceNormalizationOpAdaptor operandAdaptor(operands);
+    auto loc = op->getLoc();
+
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    int64_t rank = memRefType.getRank();
+    if (rank < 3)
+      return failure();
+    auto elementType = memRefType.getElementType();
+    auto accType = getAccumulationType(elementType);
+    auto epsilon = emitConstantOp(rewriter, loc, accType,
+        llvm::cast<ONNXInstanceNormalizationOp>(op)
+            .epsilon()
+            .convertToFloat());
+    auto zero = emitConstantOp(rewriter, loc, accType, 0);
+    auto one = emitConstantOp(rewriter, loc, accType, 1);
+
+    auto operand = operandAdaptor.input();
+    auto scale = operandAdaptor.scale();
+    auto bias = operandAdaptor.B();
+
+    // Insert an allocation and deallocation for the result of this operation.
+    Value alloc;
+    bool insertDealloc = checkInsertDealloc(op);
+
+    if (hasAllConstantDimensions(memRefType))
+      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+    else
+      alloc = insertAllocAndDealloc(
+          memRefType, loc, rewriter, insertDealloc, {operand});
+
+    // The running mean and sum of squared differences of each instance and
+    // channel, so that the instances and channels are normalized in
+    // parallel.
+    auto statType = MemRefType::get(
+        memRefType.getShape().take_front(2), accType);
+    SmallVector<Value, 2> statOperands;
+    for (int i = 0; i < 2; ++i)
+      if (statType.isDynamicDim(i))
+        statOperands.emplace_back(rewriter.create<DimOp>(loc, operand, i));
+    SmallVector<Value, 2> stats;
+    for (int i = 0; i < 2; ++i) {
+      auto stat = rewriter.create<AllocOp>(loc, statType, statOperands);
+      auto *parentBlock = stat.getOperation()->getBlock();
+      if (hasAllConstantDimensions(statType))
+        stat.getOperation()->moveBefore(&parentBlock->front());
+      auto dealloc = rewriter.create<DeallocOp>(loc, stat);
+      dealloc.getOperation()->moveBefore(&parentBlock->back());
+      stats.emplace_back(stat);
+    }
+    Value meanStat = stats[0], m2Stat = stats[1];
+
+    // Spatial dimensions, and their number of elements.
+    SmallVector<Value, 4> spatialDims;
+    for (int64_t i = 2; i < rank; ++i)
+      spatialDims.emplace_back(
+          memRefType.isDynamicDim(i)
+              ? rewriter.create<DimOp>(loc, operand, i).getResult()
+              : rewriter.create<ConstantIndexOp>(loc, memRefType.getShape()[i])
+                    .getResult());
+    Value spatialSize = spatialDims[0];
+    for (int64_t i = 1; i < rank - 2; ++i)
+      spatialSize = rewriter.create<MulIOp>(loc, spatialSize, spatialDims[i]);
+    Value count = emitIndexToFloat(rewriter, loc, spatialSize, accType);
+
+    // Iterate over the instances and channels.
+    BuildKrnlLoop outerLoops(rewriter, loc, 2);
+    outerLoops.createDefineOp();
+    outerLoops.pushBounds(0, operand, 0);
+    outerLoops.pushBounds(0, operand, 1);
+    outerLoops.parallelize(0);
+    outerLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+    SmallVector<Value, 2> statIVs(outerLoops.getAllInductionVar().begin(),
+        outerLoops.getAllInductionVar().end());
+    rewriter.create<AffineStoreOp>(loc, zero, meanStat, statIVs);
+    rewriter.create<AffineStoreOp>(loc, zero, m2Stat, statIVs);
+
+    // Iterate over the spatial dimensions, calling `body` with the loaded
+    // element of x and the indices of the element.
+    auto emitSpatialLoops = [&](std::function<void(Value, ArrayRef<Value>)>
+                                    body) {
+      BuildKrnlLoop spatialLoops(rewriter, loc, rank - 2);
+      spatialLoops.createDefineOp();
+      for (int64_t i = 2; i < rank; ++i)
+        spatialLoops.pushBounds(0, operand, i);
+      spatialLoops.createIterateOp();
+      OpBuilder::InsertionGuard guard(rewriter);
+      rewriter.setInsertionPointToStart(spatialLoops.getIterateBlock());
+      SmallVector<Value, 4> loopIVs(statIVs.begin(), statIVs.end());
+      for (auto arg : spatialLoops.getAllInductionVar())
+        loopIVs.emplace_back(arg);
+      Value xVal = rewriter.create<AffineLoadOp>(loc, operand, loopIVs);
+      body(emitConvertFloat(rewriter, loc, xVal, accType), loopIVs);
+    };
+
+    // Welford's update with the k-th element of the instance and channel:
+    //   delta = x - mean
+    //   mean = mean + delta / k
+    //   m2 = m2 + delta * (x - mean)
+    emitSpatialLoops([&](Value xVal, ArrayRef<Value> loopIVs) {
+      Value index = loopIVs[2];
+      for (int64_t i = 3; i < rank; ++i)
+        index = rewriter.create<AddIOp>(loc,
+            rewriter.create<MulIOp>(loc, index, spatialDims[i - 2]),
+            loopIVs[i]);
+      auto k = rewriter.create<AddFOp>(
+          loc, emitIndexToFloat(rewriter, loc, index, accType), one);
+      auto meanVal = rewriter.create<AffineLoadOp>(loc, meanStat, statIVs);
+      auto m2Val = rewriter.create<AffineLoadOp>(loc, m2Stat, statIVs);
+      auto delta = rewriter.create<SubFOp>(loc, xVal, meanVal);
+      auto newMean = rewriter.create<AddFOp>(
+          loc, meanVal, rewriter.create<DivFOp>(loc, delta, k));
+      auto newM2 = rewriter.create<AddFOp>(loc, m2Val,
+          rewriter.create<MulFOp>(
+              loc, delta, rewriter.create<SubFOp>(loc, xVal, newMean)));
+      rewriter.create<AffineStoreOp>(loc, newMean, meanStat, statIVs);
+      rewriter.create<AffineStoreOp>(loc, newM2, m2Stat, statIVs);
+    });
+
+    // Per instance and channel multiplier and offset:
+    //   multiplier = scale / sqrt(m2 / count + epsilon)
+    //   offset = bias - mean * multiplier
+    SmallVector<Value, 1> channelIVs = {statIVs[1]};
+    auto scaleVal = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, scale, channelIVs), accType);
+    auto biasVal = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, bias, channelIVs), accType);
+    auto meanVal = rewriter.create<AffineLoadOp>(loc, meanStat, statIVs);
+    auto m2Val = rewriter.create<AffineLoadOp>(loc, m2Stat, statIVs);
+    auto varianceVal = rewriter.create<DivFOp>(loc, m2Val, count);
     auto adjustedVarianceVal =
         rewriter.create<AddFOp>(loc, varianceVal, epsilon);
     auto divisor = rewriter.create<SqrtOp>(loc, adjustedVarianceVal);
-    auto normVal = rewriter.create<DivFOp>(loc, dividend, divisor);
-    // scale and shift
-    auto scaleNormVal = rewriter.create<MulFOp>(loc, scaleVal, normVal);
-    auto shiftScaleNormVal =
-        rewriter.create<AddFOp>(loc, scaleNormVal, biasVal);
-    rewriter.create<AffineStoreOp>(loc, shiftScaleNormVal, alloc, loopIVs);
+    auto multiplier = rewriter.create<DivFOp>(loc, scaleVal, divisor);
+    auto offset = rewriter.create<SubFOp>(
+        loc, biasVal, rewriter.create<MulFOp>(loc, meanVal, multiplier));
+
+    // Normalize.
+    emitSpatialLoops([&](Value xVal, ArrayRef<Value> loopIVs) {
+      auto scaleNormVal = rewriter.create<MulFOp>(loc, xVal, multiplier);
+      auto shiftScaleNormVal =
+          rewriter.create<AddFOp>(loc, scaleNormVal, offset);
+      rewriter.create<AffineStoreOp>(loc,
+          emitConvertFloat(rewriter, loc, shiftScaleNormVal, elementType),
+          alloc, loopIVs);
+    });
+
+    rewriter.replaceOp(op, alloc);
+
+    return success();
+  }
+};
+
+// Emit a loop over the innermost dimension of `input` from `lowerBound` to
+// `upperBound` (over the whole dimension when `upperBound` is negative), and
+// call `emitBody` with its induction variable.
+static void emitLayerNormRowLoop(ConversionPatternRewriter &rewriter,
+    Location loc, Value input, int64_t lowerBound, int64_t upperBound,
+    llvm::function_ref<void(Value)> emitBody) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  int64_t rank = input.getType().cast<MemRefType>().getRank();
+  BuildKrnlLoop loop(rewriter, loc, 1);
+  loop.createDefineOp();
+  if (upperBound < 0)
+    loop.pushBounds(0, input, rank - 1);
+  else
+    loop.pushBounds(lowerBound, upperBound);
+  loop.createIterateOp();
+  rewriter.setInsertionPointToStart(loop.getIterateBlock());
+  emitBody(loop.getInductionVar(0));
+}
+
+struct ONNXLayerNormalizationOpLowering : public ConversionPattern {
+  ONNXLayerNormalizationOpLowering(MLIRContext *ctx, int64_t vectorBits = 0)
+      : ConversionPattern(
+            mlir::ONNXLayerNormalizationOp::getOperationName(), 1, ctx),
+        vectorBits(vectorBits) {}
+
+  // Number of bits of the vectors used along the innermost dimension, 0 if
+  // the operation is not vectorized.
+  int64_t vectorBits;
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    // layernorm{epsilon}(x, scale, bias) =
+    //      (x - mean) / sqrt(variance + epsilon) * scale + bias
+    //
+    // The mean and the variance are computed over each row of the innermost
+    // dimension, in two passes so that the variance is the mean of the
+    // squared centered values and does not cancel out when the mean is large.
+    // A third pass computes the result, so that the row is read three times
+    // and written once, instead of once per operation of the original
+    // subgraph.
+    //
+    // When vectorized, the innermost dimension is processed by vectors whose
+    // lanes accumulate their own sums. The lanes are added into the scalar
+    // sum, which then takes in the remaining elements.
+    ONNXLayerNormalizationOpAdaptor operandAdaptor(operands);
+    auto loc = op->getLoc();
+
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto elementType = memRefType.getElementType();
+    int64_t rank = memRefType.getRank();
+    if (rank == 0)
+      return emitError(loc, "LayerNormalization of a scalar");
+    Value input = operandAdaptor.X();
+    Value scale = operandAdaptor.scale();
+    Value bias = operandAdaptor.B();
+    Value epsilon = emitConstantOp(rewriter, loc, elementType,
+        llvm::dyn_cast<ONNXLayerNormalizationOp>(op)
+            .epsilon()
+            .convertToFloat());
+
+    // Insert an allocation and deallocation for the result of this operation.
+    Value alloc;
+    bool insertDealloc = checkInsertDealloc(op);
+    if (hasAllConstantDimensions(memRefType))
+      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+    else
+      alloc = insertAllocAndDealloc(
+          memRefType, loc, rewriter, insertDealloc, {input});
+
+    // The innermost dimension is vectorized when it is static and holds at
+    // least one vector.
+    int64_t innerDimSize = memRefType.getShape().back();
+    int64_t vectorWidth = 0;
+    if (vectorBits > 0 && innerDimSize > 0) {
+      vectorWidth = vectorBits / elementType.getIntOrFloatBitWidth();
+      if (vectorWidth < 2 || innerDimSize < vectorWidth)
+        vectorWidth = 0;
+    }
+    int64_t numVectors = vectorWidth ? innerDimSize / vectorWidth : 0;
+    bool hasScalarLoop = !vectorWidth || innerDimSize % vectorWidth != 0;
+    int64_t scalarLowerBound = numVectors * vectorWidth;
+    int64_t scalarUpperBound = vectorWidth ? innerDimSize : -1;
+    VectorType vectorType;
+    if (vectorWidth)
+      vectorType = VectorType::get({vectorWidth}, elementType);
+
+    // Insert allocations and deallocations for the sum of a row, and for the
+    // sums of the lanes of the vectors.
+    MemRefType scalarMemRefType = MemRefType::get({}, elementType, {}, 0);
+    Value sumOp = insertAllocAndDealloc(scalarMemRefType, loc, rewriter, true);
+    Value zero = emitConstantOp(rewriter, loc, elementType, 0);
+    Value one = emitConstantOp(rewriter, loc, elementType, 1);
+    Value laneSumOp, vectorZero;
+    if (vectorWidth) {
+      MemRefType laneMemRefType = MemRefType::get({}, vectorType, {}, 0);
+      laneSumOp = insertAllocAndDealloc(laneMemRefType, loc, rewriter, true);
+      vectorZero = emitConstantOp(rewriter, loc, vectorType, 0);
+    }
+
+    // The number of elements of a row, as a floating-point value.
+    Value rowSize;
+    if (innerDimSize > 0) {
+      rowSize = emitConstantOp(rewriter, loc, elementType, innerDimSize);
+    } else {
+      rowSize = rewriter.create<DimOp>(loc, input, rank - 1);
+      rowSize = rewriter.create<IndexCastOp>(
+          loc, rowSize, rewriter.getIntegerType(64));
+      rowSize = rewriter.create<SIToFPOp>(loc, rowSize, elementType);
+    }
+
+    // Create an outer loop nest over the rows.
+    SmallVector<Value, 4> outerLoopIVs;
+    if (rank > 1) {
+      BuildKrnlLoop outerLoops(rewriter, loc, rank - 1);
+      outerLoops.createDefineOp();
+      for (int64_t i = 0; i < rank - 1; ++i)
+        outerLoops.pushBounds(0, input, i);
+      outerLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+      for (auto arg : outerLoops.getAllInductionVar())
+        outerLoopIVs.emplace_back(arg);
+    }
+    auto getRowIndices = [&](Value innerLoopIV) {
+      SmallVector<Value, 4> indices(outerLoopIVs.begin(), outerLoopIVs.end());
+      indices.emplace_back(innerLoopIV);
+      return indices;
+    };
+    // Map the induction variable of the innermost loop to the first element
+    // of a vector, in the input and in the scale and the bias.
+    AffineMap vectorMap, rowVectorMap;
+    if (vectorWidth) {
+      SmallVector<AffineExpr, 4> vectorExprs;
+      for (int64_t i = 0; i < rank - 1; ++i)
+        vectorExprs.emplace_back(rewriter.getAffineDimExpr(i));
+      vectorExprs.emplace_back(
+          rewriter.getAffineDimExpr(rank - 1) * vectorWidth);
+      vectorMap = AffineMap::get(rank, 0, vectorExprs, rewriter.getContext());
+      rowVectorMap = AffineMap::get(1, 0,
+          {rewriter.getAffineDimExpr(0) * vectorWidth}, rewriter.getContext());
+    }
+
+    // Sum the elements of the row, or the squares of their differences with
+    // `center` when it is not null.
+    auto emitRowSum = [&](Value center) -> Value {
+      auto emitTerm = [&](Value x, Value c) -> Value {
+        if (!c)
+          return x;
+        Value diff = rewriter.create<SubFOp>(loc, x, c);
+        return rewriter.create<MulFOp>(loc, diff, diff);
+      };
+      rewriter.create<AffineStoreOp>(loc, zero, sumOp, ArrayRef<Value>{});
+      if (vectorWidth) {
+        Value vectorCenter;
+        if (center)
+          vectorCenter =
+              rewriter.create<vector::BroadcastOp>(loc, vectorType, center);
+        rewriter.create<AffineStoreOp>(
+            loc, vectorZero, laneSumOp, ArrayRef<Value>{});
+        emitLayerNormRowLoop(
+            rewriter, loc, input, 0, numVectors, [&](Value innerLoopIV) {
+              Value next = rewriter.create<AffineVectorLoadOp>(loc,
+                  vectorType, input, vectorMap, getRowIndices(innerLoopIV));
+              Value laneSum = rewriter.create<AffineLoadOp>(loc, laneSumOp);
+              rewriter.create<AffineStoreOp>(loc,
+                  rewriter.create<AddFOp>(
+                      loc, laneSum, emitTerm(next, vectorCenter)),
+                  laneSumOp, ArrayRef<Value>{});
+            });
+
+        // Add the lanes.
+        Value laneSum = rewriter.create<AffineLoadOp>(loc, laneSumOp);
+        Value sum = zero;
+        for (int64_t lane = 0; lane < vectorWidth; ++lane)
+          sum = rewriter.create<AddFOp>(loc, sum,
+              rewriter.create<vector::ExtractOp>(
+                  loc, laneSum, ArrayRef<int64_t>{lane}));
+        rewriter.create<AffineStoreOp>(loc, sum, sumOp, ArrayRef<Value>{});
+      }
+      if (hasScalarLoop)
+        emitLayerNormRowLoop(rewriter, loc, input, scalarLowerBound,
+            scalarUpperBound, [&](Value innerLoopIV) {
+              Value next = rewriter.create<AffineLoadOp>(
+                  loc, input, getRowIndices(innerLoopIV));
+              Value sum = rewriter.create<AffineLoadOp>(loc, sumOp);
+              rewriter.create<AffineStoreOp>(loc,
+                  rewriter.create<AddFOp>(loc, sum, emitTerm(next, center)),
+                  sumOp, ArrayRef<Value>{});
+            });
+      return rewriter.create<AffineLoadOp>(loc, sumOp);
+    };
+
+    // 1. Compute the mean of the row.
+    Value mean = rewriter.create<DivFOp>(loc, emitRowSum(nullptr), rowSize);
+
+    // 2. Compute the variance of the row, and the inverse of the standard
+    // deviation.
+    Value variance = rewriter.create<DivFOp>(loc, emitRowSum(mean), rowSize);
+    Value invStdDev = rewriter.create<DivFOp>(loc, one,
+        rewriter.create<SqrtOp>(
+            loc, rewriter.create<AddFOp>(loc, variance, epsilon)));
+
+    // 3. Normalize, scale and shift the row.
+    auto emitResult = [&](Value x, Value s, Value b, Value m, Value inv) {
+      Value normalized = rewriter.create<MulFOp>(
+          loc, rewriter.create<SubFOp>(loc, x, m), inv);
+      return rewriter.create<AddFOp>(
+          loc, rewriter.create<MulFOp>(loc, normalized, s), b);
+    };
+    if (vectorWidth) {
+      Value vectorMean =
+          rewriter.create<vector::BroadcastOp>(loc, vectorType, mean);
+      Value vectorInvStdDev =
+          rewriter.create<vector::BroadcastOp>(loc, vectorType, invStdDev);
+      emitLayerNormRowLoop(
+          rewriter, loc, input, 0, numVectors, [&](Value innerLoopIV) {
+            auto indices = getRowIndices(innerLoopIV);
+            Value next = rewriter.create<AffineVectorLoadOp>(
+                loc, vectorType, input, vectorMap, indices);
+            Value s = rewriter.create<AffineVectorLoadOp>(
+                loc, vectorType, scale, rowVectorMap, innerLoopIV);
+            Value b = rewriter.create<AffineVectorLoadOp>(
+                loc, vectorType, bias, rowVectorMap, innerLoopIV);
+            Value result =
+                emitResult(next, s, b, vectorMean, vectorInvStdDev);
+            rewriter.create<AffineVectorStoreOp>(
+                loc, result, alloc, vectorMap, indices);
+          });
+    }
+    if (hasScalarLoop)
+      emitLayerNormRowLoop(rewriter, loc, input, scalarLowerBound,
+          scalarUpperBound, [&](Value innerLoopIV) {
+            auto indices = getRowIndices(innerLoopIV);
+            Value next = rewriter.create<AffineLoadOp>(loc, input, indices);
+            Value s = rewriter.create<AffineLoadOp>(loc, scale, innerLoopIV);
+            Value b = rewriter.create<AffineLoadOp>(loc, bias, innerLoopIV);
+            Value result = emitResult(next, s, b, mean, invStdDev);
+            rewriter.create<AffineStoreOp>(loc, result, alloc, indices);
+          });
 
     rewriter.replaceOp(op, alloc);
 
@@ -133,6 +559,8 @@ struct ONNXBatchNormalizationTestModeOpLowering : public ConversionPattern {
 };
 
 void populateLoweringONNXNormalizationOpPattern(
-    OwningRewritePatternList &patterns, MLIRContext *ctx) {
-  patterns.insert<ONNXBatchNormalizationTestModeOpLowering>(ctx);
+    OwningRewritePatternList &patterns, MLIRContext *ctx, int64_t vectorBits) {
+  patterns.insert<ONNXBatchNormalizationTestModeOpLowering,
+      ONNXInstanceNormalizationOpLowering>(ctx);
+  patterns.insert<ONNXLayerNormalizationOpLowering>(ctx, vectorBits);
 }
@@ -8,6 +8,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Dialect/Vector/VectorOps.h"
+
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 using namespace mlir;
@@ -180,13 +182,340 @@ Value insertAllocAndDeallocForPooling(ConversionPatternRewriter &rewriter,
   return alloc;
 }
 
+//===----------------------------------------------------------------------===//
+// Helper functions for the specialized average and max pooling kernels.
+//
+
+// Get the affine maps giving the first input index of the window of a pooling
+// dimension and the size of the window, clipped to the input, from the output
+// index o:
+//   start = max(0, o * s - p)
+//   size = min(I, o * s - p + k) - start
+// where the size is rewritten as the min of the four differences between the
+// end and start candidates, as for the windows of the general case.
+static void getPoolWindowMaps(Builder &builder, int64_t inputDim,
+    int64_t kernelDim, int64_t pad, int64_t stride, AffineMap &startMap,
+    AffineMap &sizeMap) {
+  AffineExpr outputIndex = builder.getAffineDimExpr(0);
+  AffineExpr start1 = builder.getAffineConstantExpr(0);
+  AffineExpr start2 = outputIndex * stride - pad;
+  AffineExpr end1 = builder.getAffineConstantExpr(inputDim);
+  AffineExpr end2 = start2 + kernelDim;
+  startMap = AffineMap::get(1, 0, {start1, start2}, builder.getContext());
+  sizeMap = AffineMap::get(1, 0,
+      {end1 - start1, end1 - start2, end2 - start1, end2 - start2},
+      builder.getContext());
+}
+
+// Emit dst[indices] = sum(src[indices with indices[axis] = i]) where i scans
+// the window of indices[axis] along `axis`.
+static void emitPoolWindowSum(ConversionPatternRewriter &rewriter,
+    Location loc, Value src, Value dst, ArrayRef<Value> indices, int axis,
+    AffineMap startMap, AffineMap sizeMap) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  auto elementType = dst.getType().cast<MemRefType>().getElementType();
+  rewriter.create<AffineStoreOp>(
+      loc, emitConstantOp(rewriter, loc, elementType, 0), dst, indices);
+  Value start = rewriter.create<AffineMaxOp>(loc, startMap, indices[axis]);
+
+  BuildKrnlLoop windowLoop(rewriter, loc, 1);
+  windowLoop.createDefineOp();
+  windowLoop.pushBounds(0, sizeMap, indices[axis]);
+  windowLoop.createIterateOp();
+  rewriter.setInsertionPointToStart(windowLoop.getIterateBlock());
+
+  SmallVector<Value, 4> srcIndices(indices.begin(), indices.end());
+  srcIndices[axis] =
+      rewriter.create<AddIOp>(loc, windowLoop.getInductionVar(0), start);
+  Value next = rewriter.create<LoadOp>(loc, src, srcIndices);
+  Value partial = rewriter.create<AffineLoadOp>(loc, dst, indices);
+  rewriter.create<AffineStoreOp>(
+      loc, rewriter.create<AddFOp>(loc, partial, next), dst, indices);
+}
+
+// An average pool over two spatial dimensions is separable: the sum of a
+// window is the sum of the sums of its rows. Summing each row of the window
+// once into a buffer takes kH + kW additions per output instead of kH * kW,
+// which pays off as soon as kH * kW > kH + kW.
+static bool isSeparableAveragePool(MemRefType inputType,
+    MemRefType outputType, ArrayRef<int64_t> kernelShape) {
+  return inputType.getRank() == 4 && kernelShape.size() == 2 &&
+         hasAllConstantDimensions(inputType) &&
+         hasAllConstantDimensions(outputType) &&
+         inputType.getElementType().isa<FloatType>() &&
+         kernelShape[0] * kernelShape[1] > kernelShape[0] + kernelShape[1];
+}
+
+// Emit a separable average pool over NxCxHxW inputs:
+//
+//   rowSums[n][c][h][wo] = sum(input[n][c][h][wi] for wi in window(wo))
+//   output[n][c][ho][wo] = sum(rowSums[n][c][hi][wo] for hi in window(ho))
+//   output[n][c][ho][wo] /= count(ho, wo)
+//
+// where count is the kernel size if padding is counted, and the number of
+// input pixels in the window otherwise.
+static void emitSeparableAveragePool(ConversionPatternRewriter &rewriter,
+    Location loc, Value input, Value alloc, ArrayRef<int64_t> kernelShape,
+    ArrayRef<int64_t> pads, ArrayRef<int64_t> strides,
+    bool countIncludePad) {
+  auto inputShape = input.getType().cast<MemRefType>().getShape();
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto outputShape = memRefType.getShape();
+  auto elementType = memRefType.getElementType();
+
+  AffineMap rowStartMap, rowSizeMap, colStartMap, colSizeMap;
+  getPoolWindowMaps(rewriter, inputShape[2], kernelShape[0], pads[0],
+      strides[0], rowStartMap, rowSizeMap);
+  getPoolWindowMaps(rewriter, inputShape[3], kernelShape[1], pads[1],
+      strides[1], colStartMap, colSizeMap);
+
+  // 1. Sum the rows of the windows.
+  auto rowSumsType = MemRefType::get(
+      {inputShape[0], inputShape[1], inputShape[2], outputShape[3]},
+      elementType);
+  Value rowSums = insertAllocAndDealloc(rowSumsType, loc, rewriter, true);
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop rowLoops(rewriter, loc, 4);
+    rowLoops.createDefineOp();
+    for (int i = 0; i < 4; ++i)
+      rowLoops.pushBounds(0, rowSums, i);
+    // Channels are processed in parallel.
+    rowLoops.parallelize(1);
+    rowLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(rowLoops.getIterateBlock());
+    SmallVector<Value, 4> indices(rowLoops.getAllInductionVar().begin(),
+        rowLoops.getAllInductionVar().end());
+    emitPoolWindowSum(
+        rewriter, loc, input, rowSums, indices, 3, colStartMap, colSizeMap);
+  }
+
+  // 2. Sum the row sums of the windows and take the average.
+  OpBuilder::InsertionGuard guard(rewriter);
+  BuildKrnlLoop outputLoops(rewriter, loc, 4);
+  outputLoops.createDefineOp();
+  for (int i = 0; i < 4; ++i)
+    outputLoops.pushBounds(0, alloc, i);
+  outputLoops.parallelize(1);
+  outputLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(outputLoops.getIterateBlock());
+  SmallVector<Value, 4> indices(outputLoops.getAllInductionVar().begin(),
+      outputLoops.getAllInductionVar().end());
+  emitPoolWindowSum(
+      rewriter, loc, rowSums, alloc, indices, 2, rowStartMap, rowSizeMap);
+
+  Value sum = rewriter.create<AffineLoadOp>(loc, alloc, indices);
+  Value count;
+  if (countIncludePad) {
+    count = emitConstantOp(
+        rewriter, loc, elementType, kernelShape[0] * kernelShape[1]);
+  } else {
+    Value rows = rewriter.create<AffineMinOp>(loc, rowSizeMap, indices[2]);
+    Value cols = rewriter.create<AffineMinOp>(loc, colSizeMap, indices[3]);
+    count = rewriter.create<MulIOp>(loc, rows, cols);
+    count = rewriter.create<IndexCastOp>(
+        loc, count, rewriter.getIntegerType(64));
+    count = rewriter.create<SIToFPOp>(loc, count, elementType);
+  }
+  rewriter.create<AffineStoreOp>(
+      loc, rewriter.create<DivFOp>(loc, sum, count), alloc, indices);
+}
+
+// Return the number of adjacent outputs of the innermost spatial dimension of
+// a max pool computed by the lanes of a vector, or 0 if it is not vectorized.
+// The lanes read contiguous inputs for unit strides along that dimension.
+static int64_t getMaxPoolVectorWidth(MemRefType inputType,
+    MemRefType outputType, ArrayRef<int64_t> strides, int64_t vectorBits) {
+  auto elementType = inputType.getElementType();
+  if (vectorBits <= 0 || !elementType.isa<FloatType>() ||
+      !hasAllConstantDimensions(inputType) ||
+      !hasAllConstantDimensions(outputType) || strides.back() != 1)
+    return 0;
+  int64_t vectorWidth = vectorBits / elementType.getIntOrFloatBitWidth();
+  if (vectorWidth < 2 || outputType.getShape().back() < vectorWidth)
+    return 0;
+  return vectorWidth;
+}
+
+// Emit the windows of a max pool over `src`, whose windows are all within
+// bounds, for the outputs of the innermost spatial dimension in
+// [lowerBound * vectorWidth, upperBound * vectorWidth). The outputs are
+// computed by vectors of `vectorWidth` lanes, or one at a time if it is 1.
+static void emitMaxPoolWindows(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Value src, Value alloc,
+    ArrayRef<int64_t> kernelShape, ArrayRef<int64_t> strides,
+    ArrayRef<int64_t> dilations, int64_t lowerBound, int64_t upperBound,
+    int64_t vectorWidth) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  int rank = memRefType.getRank();
+  int kernelRank = kernelShape.size();
+  int kernelOffset = rank - kernelRank;
+  Type type = memRefType.getElementType();
+  if (vectorWidth > 1)
+    type = VectorType::get({vectorWidth}, type);
+
+  // Map the output loops followed by the window loops to the input, and the
+  // output loops to the output.
+  //   hi = ho * sH + kh * dH
+  //   wi = wo * W + kw * dW
+  auto d = [&](unsigned pos) { return rewriter.getAffineDimExpr(pos); };
+  SmallVector<AffineExpr, 4> srcExprs, outputExprs;
+  for (int i = 0; i < kernelOffset; ++i)
+    srcExprs.emplace_back(d(i));
+  for (int j = 0; j < kernelRank; ++j) {
+    int64_t dilation = dilations.empty() ? 1 : dilations[j];
+    int64_t stride = (j == kernelRank - 1) ? vectorWidth : strides[j];
+    srcExprs.emplace_back(
+        d(kernelOffset + j) * stride + d(rank + j) * dilation);
+  }
+  for (int i = 0; i < rank - 1; ++i)
+    outputExprs.emplace_back(d(i));
+  outputExprs.emplace_back(d(rank - 1) * vectorWidth);
+  AffineMap srcMap =
+      AffineMap::get(rank + kernelRank, 0, srcExprs, rewriter.getContext());
+  AffineMap outputMap =
+      AffineMap::get(rank, 0, outputExprs, rewriter.getContext());
+
+  BuildKrnlLoop outputLoops(rewriter, loc, rank);
+  outputLoops.createDefineOp();
+  for (int i = 0; i < rank - 1; ++i)
+    outputLoops.pushBounds(0, alloc, i);
+  outputLoops.pushBounds(lowerBound, upperBound);
+  // Channels are processed in parallel.
+  outputLoops.parallelize(1);
+  outputLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(outputLoops.getIterateBlock());
+  SmallVector<Value, 4> outputIndices(outputLoops.getAllInductionVar().begin(),
+      outputLoops.getAllInductionVar().end());
+
+  auto emitLoad = [&](Value memRef, AffineMap map, ArrayRef<Value> indices) {
+    if (vectorWidth > 1)
+      return rewriter
+          .create<AffineVectorLoadOp>(loc, type, memRef, map, indices)
+          .getResult();
+    return rewriter.create<AffineLoadOp>(loc, memRef, map, indices)
+        .getResult();
+  };
+  auto emitStore = [&](Value value) {
+    if (vectorWidth > 1)
+      rewriter.create<AffineVectorStoreOp>(
+          loc, value, alloc, outputMap, outputIndices);
+    else
+      rewriter.create<AffineStoreOp>(
+          loc, value, alloc, outputMap, outputIndices);
+  };
+
+  emitStore(emitConstantOp(
+      rewriter, loc, type, -std::numeric_limits<double>::infinity()));
+
+  BuildKrnlLoop windowLoops(rewriter, loc, kernelRank);
+  windowLoops.createDefineOp();
+  for (int j = 0; j < kernelRank; ++j)
+    windowLoops.pushBounds(0, kernelShape[j]);
+  windowLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(windowLoops.getIterateBlock());
+  SmallVector<Value, 8> srcIndices(outputIndices.begin(), outputIndices.end());
+  for (auto arg : windowLoops.getAllInductionVar())
+    srcIndices.emplace_back(arg);
+
+  Value next = emitLoad(src, srcMap, srcIndices);
+  Value partial = emitLoad(alloc, outputMap, outputIndices);
+  emitStore(emitScalarOpFor<ONNXMaxPoolSingleOutOp>(
+      rewriter, loc, op, type, {partial, next}));
+}
+
+// Emit a max pool whose innermost spatial dimension is vectorized. Windows
+// overlapping the padding, or extending past the input in ceil mode, would
+// give the lanes of a vector different bounds. The input is then copied into
+// a buffer whose borders hold negative infinity, the identity of max, so that
+// every window is read in full:
+//
+//   padded[n][c][h + pH][w + pW] = input[n][c][h][w]
+//   output[n][c][ho][wo..wo+W] = max(padded[n][c][ho * sH + kh * dH]
+//                                        [wo + kw * dW..wo + kw * dW + W])
+//
+// The outputs left over by the vectors are computed one at a time.
+static void emitVectorizedMaxPool(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Value input, Value alloc,
+    ArrayRef<int64_t> kernelShape, ArrayRef<int64_t> pads,
+    ArrayRef<int64_t> strides, ArrayRef<int64_t> dilations,
+    int64_t vectorWidth) {
+  auto inputType = input.getType().cast<MemRefType>();
+  auto inputShape = inputType.getShape();
+  auto outputShape = alloc.getType().cast<MemRefType>().getShape();
+  int rank = inputShape.size();
+  int kernelRank = kernelShape.size();
+  int kernelOffset = rank - kernelRank;
+
+  SmallVector<int64_t, 4> paddedShape(inputShape.begin(), inputShape.end());
+  bool isPadded = false;
+  for (int j = 0; j < kernelRank; ++j) {
+    int i = kernelOffset + j;
+    int64_t dilation = dilations.empty() ? 1 : dilations[j];
+    int64_t extent =
+        (outputShape[i] - 1) * strides[j] + (kernelShape[j] - 1) * dilation + 1;
+    paddedShape[i] = std::max(extent, inputShape[i] + pads[j]);
+    if (pads[j] != 0 || extent > inputShape[i])
+      isPadded = true;
+  }
+
+  Value src = input;
+  if (isPadded) {
+    auto paddedType =
+        MemRefType::get(paddedShape, inputType.getElementType());
+    src = insertAllocAndDealloc(paddedType, loc, rewriter, true);
+    {
+      OpBuilder::InsertionGuard guard(rewriter);
+      BuildKrnlLoop fillLoops(rewriter, loc, src);
+      fillLoops.createDefineAndIterateOp(src);
+      rewriter.setInsertionPointToStart(fillLoops.getIterateBlock());
+      rewriter.create<AffineStoreOp>(loc,
+          emitNegativeInfinityConstantOp(
+              rewriter, loc, inputType.getElementType()),
+          src, fillLoops.getAllInductionVar());
+    }
+    {
+      OpBuilder::InsertionGuard guard(rewriter);
+      BuildKrnlLoop copyLoops(rewriter, loc, input);
+      copyLoops.createDefineAndIterateOp(input);
+      rewriter.setInsertionPointToStart(copyLoops.getIterateBlock());
+      SmallVector<AffineExpr, 4> paddedExprs;
+      for (int i = 0; i < rank; ++i) {
+        AffineExpr expr = rewriter.getAffineDimExpr(i);
+        paddedExprs.emplace_back(
+            i < kernelOffset ? expr : expr + pads[i - kernelOffset]);
+      }
+      AffineMap paddedMap =
+          AffineMap::get(rank, 0, paddedExprs, rewriter.getContext());
+      Value loadInput = rewriter.create<AffineLoadOp>(
+          loc, input, copyLoops.getAllInductionVar());
+      rewriter.create<AffineStoreOp>(
+          loc, loadInput, src, paddedMap, copyLoops.getAllInductionVar());
+    }
+  }
+
+  int64_t innerDimSize = outputShape.back();
+  int64_t numVectors = innerDimSize / vectorWidth;
+  emitMaxPoolWindows(rewriter, loc, op, src, alloc, kernelShape, strides,
+      dilations, 0, numVectors, vectorWidth);
+  if (innerDimSize % vectorWidth != 0)
+    emitMaxPoolWindows(rewriter, loc, op, src, alloc, kernelShape, strides,
+        dilations, numVectors * vectorWidth, innerDimSize, 1);
+}
+
 //===----------------------------------------------------------------------===//
 // Template function that does pooling.
 //
 template <typename PoolOp>
 struct ONNXPoolOpLowering : public ConversionPattern {
-  ONNXPoolOpLowering(MLIRContext *ctx)
-      : ConversionPattern(PoolOp::getOperationName(), 1, ctx) {}
+  ONNXPoolOpLowering(MLIRContext *ctx, int64_t vectorBits = 0)
+      : ConversionPattern(PoolOp::getOperationName(), 1, ctx),
+        vectorBits(vectorBits) {}
+
+  // Number of bits of the vectors used along the innermost spatial dimension
+  // of max pools, 0 if they are not vectorized.
+  int64_t vectorBits;
 
   LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
       ConversionPatternRewriter &rewriter) const final {
@@ -242,6 +571,28 @@ struct ONNXPoolOpLowering : public ConversionPattern {
           ceilMode);
     }
 
+    // Average pools with large kernels are computed in two separable passes,
+    // and max pools are vectorized along the innermost spatial dimension, when
+    // the shapes are static. Other cases fall back to the loop nest below.
+    auto inputMemRefType = inputOperand.getType().cast<MemRefType>();
+    if (std::is_same<PoolOp, ONNXAveragePoolOp>::value &&
+        isSeparableAveragePool(inputMemRefType, memRefType, kernelShape)) {
+      emitSeparableAveragePool(rewriter, loc, inputOperand, alloc, kernelShape,
+          pads, strides, getCountIncludePad<PoolOp>(poolOp));
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+    if (std::is_same<PoolOp, ONNXMaxPoolSingleOutOp>::value) {
+      int64_t vectorWidth = getMaxPoolVectorWidth(
+          inputMemRefType, memRefType, strides, vectorBits);
+      if (vectorWidth) {
+        emitVectorizedMaxPool(rewriter, loc, op, inputOperand, alloc,
+            kernelShape, pads, strides, dilations, vectorWidth);
+        rewriter.replaceOp(op, alloc);
+        return success();
+      }
+    }
+
     // input = Pool(output)
     //
     // The input/output shapes will look like this:
@@ -533,8 +884,205 @@ struct ONNXPoolOpLowering : public ConversionPattern {
   }
 };
 
-void populateLoweringONNXPoolingOpPattern(
-    OwningRewritePatternList &patterns, MLIRContext *ctx) {
-  patterns.insert<ONNXPoolOpLowering<ONNXMaxPoolSingleOutOp>>(ctx);
+//===----------------------------------------------------------------------===//
+// GlobalAveragePool reduces the spatial dimensions of each channel.
+//
+struct ONNXGlobalAveragePoolOpLowering : public ConversionPattern {
+  ONNXGlobalAveragePoolOpLowering(MLIRContext *ctx, int64_t vectorBits = 0)
+      : ConversionPattern(
+            mlir::ONNXGlobalAveragePoolOp::getOperationName(), 1, ctx),
+        vectorBits(vectorBits) {}
+
+  // Number of bits of the vectors used along the innermost dimension, 0 if
+  // the operation is not vectorized.
+  int64_t vectorBits;
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    // for n in range(N):
+    //   for c in range(C):
+    //     output[n][c][0][0] = sum(input[n][c]) * (1 / (H * W))
+    //
+    // The channels are processed in parallel. When vectorized, the innermost
+    // dimension is summed by vectors whose lanes are added together before
+    // taking in the remaining elements.
+    ONNXGlobalAveragePoolOpAdaptor operandAdaptor(operands);
+    auto loc = op->getLoc();
+    Value input = operandAdaptor.X();
+    auto inputType = input.getType().cast<MemRefType>();
+    auto inputShape = inputType.getShape();
+    int64_t inputRank = inputShape.size();
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto elementType = memRefType.getElementType();
+
+    Value alloc;
+    bool insertDealloc = checkInsertDealloc(op);
+    if (hasAllConstantDimensions(memRefType))
+      alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+    else
+      alloc = insertAllocAndDealloc(
+          memRefType, loc, rewriter, insertDealloc, input);
+
+    // The innermost dimension is vectorized when it is static and holds at
+    // least one vector.
+    int64_t innerDimSize = inputShape.back();
+    int64_t vectorWidth = 0;
+    if (vectorBits > 0 && innerDimSize > 0) {
+      vectorWidth = vectorBits / elementType.getIntOrFloatBitWidth();
+      if (vectorWidth < 2 || innerDimSize < vectorWidth)
+        vectorWidth = 0;
+    }
+    int64_t numVectors = vectorWidth ? innerDimSize / vectorWidth : 0;
+    VectorType vectorType;
+    Value lanes;
+    if (vectorWidth) {
+      vectorType = VectorType::get({vectorWidth}, elementType);
+      // One vector of partial sums per channel.
+      auto lanesType = MemRefType::get(
+          {inputShape[0], inputShape[1]}, vectorType, {}, 0);
+      lanes = insertAllocAndDealloc(lanesType, loc, rewriter, true, input);
+    }
+
+    // Inverse of the number of elements of a channel.
+    int64_t staticNumElements = 1;
+    Value dynamicNumElements = nullptr;
+    for (int64_t i = 2; i < inputRank; ++i) {
+      if (inputShape[i] >= 0) {
+        staticNumElements *= inputShape[i];
+        continue;
+      }
+      Value dim = rewriter.create<DimOp>(loc, input, i);
+      if (dynamicNumElements)
+        dynamicNumElements =
+            rewriter.create<MulIOp>(loc, dynamicNumElements, dim);
+      else
+        dynamicNumElements = dim;
+    }
+    Value numElements =
+        emitConstantOp(rewriter, loc, elementType, staticNumElements);
+    if (dynamicNumElements) {
+      dynamicNumElements = rewriter.create<IndexCastOp>(
+          loc, dynamicNumElements, rewriter.getIntegerType(64));
+      dynamicNumElements =
+          rewriter.create<SIToFPOp>(loc, dynamicNumElements, elementType);
+      numElements =
+          rewriter.create<MulFOp>(loc, numElements, dynamicNumElements);
+    }
+    Value invNumElements = rewriter.create<DivFOp>(
+        loc, emitConstantOp(rewriter, loc, elementType, 1), numElements);
+
+    // Map the channel to its output, and the spatial loops to the input.
+    auto d = [&](unsigned pos) { return rewriter.getAffineDimExpr(pos); };
+    SmallVector<AffineExpr, 4> outputExprs = {d(0), d(1)};
+    for (int64_t i = 2; i < memRefType.getRank(); ++i)
+      outputExprs.emplace_back(rewriter.getAffineConstantExpr(0));
+    AffineMap outputMap =
+        AffineMap::get(2, 0, outputExprs, rewriter.getContext());
+    AffineMap vectorMap;
+    if (vectorWidth) {
+      SmallVector<AffineExpr, 4> vectorExprs;
+      for (int64_t i = 0; i < inputRank - 1; ++i)
+        vectorExprs.emplace_back(d(i));
+      vectorExprs.emplace_back(d(inputRank - 1) * vectorWidth);
+      vectorMap =
+          AffineMap::get(inputRank, 0, vectorExprs, rewriter.getContext());
+    }
+
+    BuildKrnlLoop channelLoops(rewriter, loc, 2);
+    channelLoops.createDefineOp();
+    channelLoops.pushBounds(0, input, 0);
+    channelLoops.pushBounds(0, input, 1);
+    channelLoops.parallelize(1);
+    channelLoops.createIterateOp();
+    auto ipMainRegion = rewriter.saveInsertionPoint();
+    rewriter.setInsertionPointToStart(channelLoops.getIterateBlock());
+    SmallVector<Value, 2> channelIndices(
+        channelLoops.getAllInductionVar().begin(),
+        channelLoops.getAllInductionVar().end());
+
+    // Emit a loop nest over the spatial dimensions, whose innermost loop
+    // iterates from `lowerBound` to `upperBound` (over the whole dimension
+    // when `upperBound` is negative), and call `emitBody` with the indices of
+    // the input.
+    auto emitSpatialLoops =
+        [&](int64_t lowerBound, int64_t upperBound,
+            llvm::function_ref<void(ArrayRef<Value>)> emitBody) {
+          OpBuilder::InsertionGuard guard(rewriter);
+          BuildKrnlLoop spatialLoops(rewriter, loc, inputRank - 2);
+          spatialLoops.createDefineOp();
+          for (int64_t i = 2; i < inputRank - 1; ++i)
+            spatialLoops.pushBounds(0, input, i);
+          if (upperBound < 0)
+            spatialLoops.pushBounds(0, input, inputRank - 1);
+          else
+            spatialLoops.pushBounds(lowerBound, upperBound);
+          spatialLoops.createIterateOp();
+          rewriter.setInsertionPointToStart(spatialLoops.getIterateBlock());
+          SmallVector<Value, 4> indices(
+              channelIndices.begin(), channelIndices.end());
+          for (auto arg : spatialLoops.getAllInductionVar())
+            indices.emplace_back(arg);
+          emitBody(indices);
+        };
+
+    if (vectorWidth) {
+      rewriter.create<AffineStoreOp>(loc,
+          emitConstantOp(rewriter, loc, vectorType, 0), lanes, channelIndices);
+      emitSpatialLoops(0, numVectors, [&](ArrayRef<Value> indices) {
+        Value next = rewriter.create<AffineVectorLoadOp>(
+            loc, vectorType, input, vectorMap, indices);
+        Value partial =
+            rewriter.create<AffineLoadOp>(loc, lanes, channelIndices);
+        rewriter.create<AffineStoreOp>(loc,
+            rewriter.create<AddFOp>(loc, partial, next), lanes,
+            channelIndices);
+      });
+
+      // Add the lanes together.
+      Value partials =
+          rewriter.create<AffineLoadOp>(loc, lanes, channelIndices);
+      Value sum = rewriter.create<vector::ExtractOp>(
+          loc, partials, ArrayRef<int64_t>{0});
+      for (int64_t lane = 1; lane < vectorWidth; ++lane)
+        sum = rewriter.create<AddFOp>(loc, sum,
+            rewriter.create<vector::ExtractOp>(
+                loc, partials, ArrayRef<int64_t>{lane}));
+      rewriter.create<AffineStoreOp>(
+          loc, sum, alloc, outputMap, channelIndices);
+    } else {
+      rewriter.create<AffineStoreOp>(loc,
+          emitConstantOp(rewriter, loc, elementType, 0), alloc, outputMap,
+          channelIndices);
+    }
+    if (!vectorWidth || innerDimSize % vectorWidth != 0)
+      emitSpatialLoops(numVectors * vectorWidth,
+          vectorWidth ? innerDimSize : -1, [&](ArrayRef<Value> indices) {
+            Value next = rewriter.create<AffineLoadOp>(loc, input, indices);
+            Value partial = rewriter.create<AffineLoadOp>(
+                loc, alloc, outputMap, channelIndices);
+            rewriter.create<AffineStoreOp>(loc,
+                rewriter.create<AddFOp>(loc, partial, next), alloc, outputMap,
+                channelIndices);
+          });
+
+    Value sum =
+        rewriter.create<AffineLoadOp>(loc, alloc, outputMap, channelIndices);
+    rewriter.create<AffineStoreOp>(loc,
+        rewriter.create<MulFOp>(loc, sum, invNumElements), alloc, outputMap,
+        channelIndices);
+
+    // Go back to the main region.
+    rewriter.restoreInsertionPoint(ipMainRegion);
+
+    rewriter.replaceOp(op, alloc);
+
+    return success();
+  }
+};
+
+void populateLoweringONNXPoolingOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx, int64_t vectorBits) {
+  patterns.insert<ONNXPoolOpLowering<ONNXMaxPoolSingleOutOp>>(ctx, vectorBits);
   patterns.insert<ONNXPoolOpLowering<ONNXAveragePoolOp>>(ctx);
+  patterns.insert<ONNXGlobalAveragePoolOpLowering>(ctx, vectorBits);
 }
@@ -9,6 +9,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Dialect/SCF/SCF.h"
+
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 /// Check is all dimensions are known at compile time.
@@ -152,9 +154,46 @@ bool checkInsertDealloc(Operation *currentOp, int resultIndex) {
     }
   });
 
+  // The buffers yielded by a branch are owned by the results of the If.
+  Operation *terminator = &parentBlock->back();
+  if (currentOp->getNumResults() > 0 &&
+      isa<ONNXIfRegionYieldOp, scf::YieldOp>(terminator) &&
+      llvm::is_contained(
+          terminator->getOperands(), currentOp->getResult(resultIndex)))
+    insertDealloc = false;
+
   return insertDealloc;
 }
 
+bool canReshapeInPlace(Value input, Operation *currentOp, MemRefType type,
+    int resultIndex) {
+  auto inputType = input.getType().dyn_cast<MemRefType>();
+  return inputType && inputType.getAffineMaps().empty() &&
+         type.getAffineMaps().empty() &&
+         checkInsertDealloc(currentOp, resultIndex);
+}
+
+Value getInPlaceOperand(Operation *currentOp, ArrayRef<Value> operands,
+    MemRefType type, bool mayBroadcast) {
+  if (mayBroadcast && !hasAllConstantDimensions(type))
+    return nullptr;
+  if (!checkInsertDealloc(currentOp))
+    return nullptr;
+  for (unsigned i = 0; i < operands.size(); ++i) {
+    // The input is not read by any other op, nor twice by this op.
+    if (!currentOp->getOperand(i).hasOneUse() ||
+        operands[i].getType() != type)
+      continue;
+    auto alloc = operands[i].getDefiningOp<AllocOp>();
+    if (!alloc || alloc.getOperation()->getBlock() != currentOp->getBlock())
+      continue;
+    if (llvm::any_of(alloc.getResult().getUsers(),
+            [](Operation *user) { return isa<DeallocOp>(user); }))
+      return alloc.getResult();
+  }
+  return nullptr;
+}
+
 // Create a mapping from result type's dimensions to input type's dimensions,
 // given that the result type is the result of a reduction op over the input
 // type.
@@ -224,6 +263,13 @@ unsigned getMemRefEltSizeInBytes(MemRefType memRefType) {
   return llvm::divideCeil(sizeInBits, 8);
 }
 
+SmallVector<int64_t, 4> getStaticStrides(ArrayRef<int64_t> shape) {
+  SmallVector<int64_t, 4> strides(shape.size(), 1);
+  for (int i = shape.size() - 2; i >= 0; --i)
+    strides[i] = strides[i + 1] * shape[i + 1];
+  return strides;
+}
+
 // Get run-time dimension information for unknown dimensions used for
 // broadcasting.
 std::map<int, std::map<int, Value>> getBroadcastedDimInfo(Location loc,
@@ -309,8 +355,9 @@ std::vector<Value> getLoopIVsForBroadcasting(Location loc,
 Value emitConstantOp(
     PatternRewriter &rewriter, Location loc, Type type, double value) {
   Attribute constantAttr;
+  Type elementType = getElementTypeOrSelf(type);
 
-  TypeSwitch<Type>(type)
+  TypeSwitch<Type>(elementType)
       .Case<Float16Type>(
           [&](Type) { constantAttr = rewriter.getF16FloatAttr((float)value); })
       .Case<Float32Type>(
@@ -318,18 +365,20 @@ Value emitConstantOp(
       .Case<Float64Type>(
           [&](Type) { constantAttr = rewriter.getF64FloatAttr((float)value); })
       .Case<IntegerType>([&](Type) {
-        auto width = type.cast<IntegerType>().getWidth();
+        auto width = elementType.cast<IntegerType>().getWidth();
         if (width == 1) {
           constantAttr = rewriter.getBoolAttr(false);
         } else {
-          constantAttr =
-              rewriter.getIntegerAttr(type, APInt(width, (int64_t)value));
+          constantAttr = rewriter.getIntegerAttr(
+              elementType, APInt(width, (int64_t)value));
         }
       })
       .Case<IndexType>([&](Type) {
-        constantAttr = rewriter.getIntegerAttr(type, (int64_t)value);
+        constantAttr = rewriter.getIntegerAttr(elementType, (int64_t)value);
       })
       .Default([](Type) { llvm_unreachable("unsupported element type"); });
+  if (auto vectorType = type.dyn_cast<VectorType>())
+    constantAttr = DenseElementsAttr::get(vectorType, constantAttr);
   return rewriter.create<ConstantOp>(loc, constantAttr);
 }
 
@@ -478,6 +527,348 @@ int64_t ArrayAttrIntVal(ArrayAttr a, int i) {
   return (a.getValue()[i]).cast<IntegerAttr>().getInt();
 }
 
+KrnlMemcpyOp emitMemcpy(PatternRewriter &rewriter, Location loc, Value dest,
+    Value src, Value size, ValueRange offsets) {
+  auto memcpyOp = rewriter.create<KrnlMemcpyOp>(loc, dest, src, size, offsets);
+  auto destType = dest.getType().cast<MemRefType>();
+  if (destType.hasStaticShape() &&
+      getMemRefSizeInBytes(dest) > kLastLevelCacheBytes)
+    memcpyOp.setAttr(
+        KrnlMemcpyOp::getNonTemporalAttrName(), rewriter.getUnitAttr());
+  return memcpyOp;
+}
+
+bool isBlasGemmProfitable(ArrayRef<Value> memRefs, int64_t M, int64_t N,
+    int64_t K, int64_t blasThreshold) {
+  if (blasThreshold <= 0 || M * N * K < blasThreshold)
+    return false;
+  return llvm::all_of(memRefs, [](Value memRef) {
+    auto type = memRef.getType().cast<MemRefType>();
+    return type.getElementType().isF32() && type.hasStaticShape();
+  });
+}
+
+bool isFullyUnrolled(
+    ArrayRef<Value> memRefs, int64_t numIterations, int64_t unrollThreshold) {
+  if (unrollThreshold <= 0 || numIterations > unrollThreshold)
+    return false;
+  return llvm::all_of(memRefs, [](Value memRef) {
+    return memRef.getType().cast<MemRefType>().hasStaticShape();
+  });
+}
+
+void emitFullUnroll(
+    ConversionPatternRewriter &rewriter, Location loc, ArrayRef<Value> loops) {
+  if (loops.empty())
+    return;
+  OpBuilder::InsertionGuard guard(rewriter);
+  // Each operation is inserted before the previous one.
+  for (Value loop : loops) {
+    rewriter.setInsertionPointAfter(loops.front().getDefiningOp());
+    rewriter.create<KrnlUnrollOp>(loc, loop);
+  }
+}
+
+KrnlBlasGemmOp emitBlasGemm(PatternRewriter &rewriter, Location loc, Value A,
+    Value B, Value C, int64_t M, int64_t N, int64_t K, float alpha,
+    float beta, bool transA, bool transB, ValueRange offsets) {
+  return rewriter.create<KrnlBlasGemmOp>(loc, A, B, C, offsets,
+      rewriter.getI64IntegerAttr(M), rewriter.getI64IntegerAttr(N),
+      rewriter.getI64IntegerAttr(K), rewriter.getF32FloatAttr(alpha),
+      rewriter.getF32FloatAttr(beta), rewriter.getBoolAttr(transA),
+      rewriter.getBoolAttr(transB));
+}
+
+Type getAccumulationType(Type elementType) {
+  if (elementType.isF16() || elementType.isBF16())
+    return FloatType::getF32(elementType.getContext());
+  return elementType;
+}
+
+Value emitConvertFloat(ConversionPatternRewriter &rewriter, Location loc,
+    Value value, Type type) {
+  auto fromType = value.getType().dyn_cast<FloatType>();
+  auto toType = type.dyn_cast<FloatType>();
+  if (!fromType || !toType || fromType == toType)
+    return value;
+  if (fromType.getWidth() < toType.getWidth())
+    return rewriter.create<FPExtOp>(loc, value, toType);
+  if (fromType.getWidth() > toType.getWidth())
+    return rewriter.create<FPTruncOp>(loc, value, toType);
+  // F16 and BF16 have the same width, go through F32.
+  Value extended = rewriter.create<FPExtOp>(
+      loc, value, FloatType::getF32(rewriter.getContext()));
+  return rewriter.create<FPTruncOp>(loc, extended, toType);
+}
+
+Value insertAccumulationBuffer(
+    ConversionPatternRewriter &rewriter, Location loc, Value alloc) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto accType = getAccumulationType(memRefType.getElementType());
+  if (accType == memRefType.getElementType())
+    return alloc;
+
+  auto accMemRefType = MemRefType::get(memRefType.getShape(), accType);
+  SmallVector<Value, 4> allocOperands;
+  for (int i = 0; i < memRefType.getRank(); ++i)
+    if (memRefType.isDynamicDim(i))
+      allocOperands.emplace_back(rewriter.create<DimOp>(loc, alloc, i));
+  auto acc = rewriter.create<AllocOp>(loc, accMemRefType, allocOperands);
+
+  // The accumulators never outlive the operation.
+  auto *parentBlock = acc.getOperation()->getBlock();
+  if (hasAllConstantDimensions(accMemRefType))
+    acc.getOperation()->moveBefore(&parentBlock->front());
+  auto dealloc = rewriter.create<DeallocOp>(loc, acc);
+  dealloc.getOperation()->moveBefore(&parentBlock->back());
+  return acc;
+}
+
+void emitStoreAccumulators(ConversionPatternRewriter &rewriter, Location loc,
+    Value acc, Value alloc) {
+  if (acc == alloc)
+    return;
+  OpBuilder::InsertionGuard guard(rewriter);
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  int64_t rank = memRefType.getRank();
+  BuildKrnlLoop loops(rewriter, loc, rank);
+  loops.createDefineOp();
+  for (int i = 0; i < rank; ++i)
+    loops.pushBounds(0, alloc, i);
+  if (rank > 0)
+    loops.parallelize(0);
+  loops.createIterateOp();
+  rewriter.setInsertionPointToStart(loops.getIterateBlock());
+
+  auto ivs = loops.getAllInductionVar();
+  SmallVector<Value, 4> indices(ivs.begin(), ivs.end());
+  Value accumulated = rewriter.create<AffineLoadOp>(loc, acc, indices);
+  rewriter.create<AffineStoreOp>(loc,
+      emitConvertFloat(
+          rewriter, loc, accumulated, memRefType.getElementType()),
+      alloc, indices);
+}
+
+bool isPerTensorQuantizationParam(Value param) {
+  if (param.getType().isa<NoneType>())
+    return true;
+  auto type = param.getType().dyn_cast<ShapedType>();
+  return type && type.hasStaticShape() && type.getNumElements() == 1 &&
+         !type.getElementType().isUnsignedInteger();
+}
+
+// Load the single element of a scale or of a zero point.
+static Value loadQuantizationParam(
+    ConversionPatternRewriter &rewriter, Location loc, Value param) {
+  auto rank = param.getType().cast<MemRefType>().getRank();
+  SmallVector<Value, 1> indices;
+  if (rank > 0)
+    indices.append(rank, rewriter.create<ConstantIndexOp>(loc, 0));
+  return rewriter.create<AffineLoadOp>(loc, param, indices);
+}
+
+Value loadScale(
+    ConversionPatternRewriter &rewriter, Location loc, Value scale) {
+  return loadQuantizationParam(rewriter, loc, scale);
+}
+
+Value loadZeroPoint(
+    ConversionPatternRewriter &rewriter, Location loc, Value zeroPoint) {
+  if (zeroPoint.getType().isa<NoneType>())
+    return emitConstantOp(rewriter, loc, rewriter.getIntegerType(32), 0);
+  return emitExtendToI32(
+      rewriter, loc, loadQuantizationParam(rewriter, loc, zeroPoint));
+}
+
+Value emitExtendToI32(
+    ConversionPatternRewriter &rewriter, Location loc, Value value) {
+  auto i32Type = rewriter.getIntegerType(32);
+  if (value.getType().cast<IntegerType>().getWidth() >= 32)
+    return value;
+  return rewriter.create<SignExtendIOp>(loc, i32Type, value);
+}
+
+Value emitQuantize(ConversionPatternRewriter &rewriter, Location loc,
+    Value real, Value zeroPoint, IntegerType quantizedType) {
+  auto floatType = real.getType();
+  auto half = emitConstantOp(rewriter, loc, floatType, 0.5);
+  auto one = emitConstantOp(rewriter, loc, floatType, 1);
+
+  // floor(x) = -ceil(-x).
+  Value floor = rewriter.create<NegFOp>(loc,
+      rewriter.create<CeilFOp>(loc, rewriter.create<NegFOp>(loc, real)));
+  Value fraction = rewriter.create<SubFOp>(loc, real, floor);
+  // Ties are rounded up when the floor is odd, that is when half of it is not
+  // an integer.
+  Value halfFloor = rewriter.create<MulFOp>(loc, floor, half);
+  Value isOdd = rewriter.create<CmpFOp>(loc, CmpFPredicate::ONE, halfFloor,
+      rewriter.create<CeilFOp>(loc, halfFloor));
+  Value isAboveHalf =
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, fraction, half);
+  Value isHalf =
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::OEQ, fraction, half);
+  Value roundUp = rewriter.create<OrOp>(
+      loc, isAboveHalf, rewriter.create<AndOp>(loc, isHalf, isOdd));
+  Value rounded = rewriter.create<SelectOp>(
+      loc, roundUp, rewriter.create<AddFOp>(loc, floor, one), floor);
+
+  // Add the zero point and saturate.
+  Value result = rewriter.create<AddFOp>(
+      loc, rounded, rewriter.create<SIToFPOp>(loc, floatType, zeroPoint));
+  auto width = quantizedType.getWidth();
+  auto minValue =
+      emitConstantOp(rewriter, loc, floatType, -(int64_t(1) << (width - 1)));
+  auto maxValue = emitConstantOp(
+      rewriter, loc, floatType, (int64_t(1) << (width - 1)) - 1);
+  result = rewriter.create<SelectOp>(loc,
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, result, minValue),
+      minValue, result);
+  result = rewriter.create<SelectOp>(loc,
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, result, maxValue),
+      maxValue, result);
+  return rewriter.create<FPToSIOp>(loc, quantizedType, result);
+}
+
+void emitRequantization(ConversionPatternRewriter &rewriter, Location loc,
+    Value acc, Value multiplier, Value zeroPoint, Value alloc) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto quantizedType = memRefType.getElementType().cast<IntegerType>();
+  int64_t rank = memRefType.getRank();
+  BuildKrnlLoop loops(rewriter, loc, rank);
+  loops.createDefineOp();
+  for (int i = 0; i < rank; ++i)
+    loops.pushBounds(0, alloc, i);
+  if (rank > 0)
+    loops.parallelize(0);
+  loops.createIterateOp();
+  rewriter.setInsertionPointToStart(loops.getIterateBlock());
+
+  auto ivs = loops.getAllInductionVar();
+  SmallVector<Value, 4> indices(ivs.begin(), ivs.end());
+  Value accumulated = rewriter.create<AffineLoadOp>(loc, acc, indices);
+  Value real = rewriter.create<MulFOp>(loc,
+      rewriter.create<SIToFPOp>(loc, multiplier.getType(), accumulated),
+      multiplier);
+  Value quantized = emitQuantize(rewriter, loc, real, zeroPoint, quantizedType);
+  rewriter.create<AffineStoreOp>(loc, quantized, alloc, indices);
+}
+
+// Runs of the padded data shorter than a cache line are copied element by
+// element.
+static const int64_t kMinPadCopyRunBytes = 64;
+
+void emitConstantPadding(ConversionPatternRewriter &rewriter, Location loc,
+    Value data, Value alloc, ArrayRef<int64_t> padsBegin, Value padValue) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto outputShape = memRefType.getShape();
+  auto inputShape = data.getType().cast<MemRefType>().getShape();
+  int64_t rank = outputShape.size();
+
+  // Fill the slab [lb, ub) of dimension dim, within the interior of the outer
+  // dimensions, so that every element of the borders is written once.
+  auto emitFill = [&](int64_t dim, int64_t lb, int64_t ub) {
+    if (lb >= ub)
+      return;
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop fillLoops(rewriter, loc, rank);
+    fillLoops.createDefineOp();
+    for (int64_t i = 0; i < rank; ++i) {
+      if (i < dim)
+        fillLoops.pushBounds(padsBegin[i], padsBegin[i] + inputShape[i]);
+      else if (i == dim)
+        fillLoops.pushBounds(lb, ub);
+      else
+        fillLoops.pushBounds(0, outputShape[i]);
+    }
+    fillLoops.parallelize(0);
+    fillLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(fillLoops.getIterateBlock());
+    rewriter.create<AffineStoreOp>(
+        loc, padValue, alloc, fillLoops.getAllInductionVar());
+  };
+  for (int64_t i = 0; i < rank; ++i) {
+    emitFill(i, 0, padsBegin[i]);
+    emitFill(i, padsBegin[i] + inputShape[i], outputShape[i]);
+  }
+
+  // The data is copied in runs made of its innermost padded dimension and of
+  // the dimensions inside it, which are contiguous in the output too.
+  OpBuilder::InsertionGuard guard(rewriter);
+  int64_t innerDim = rank - 1;
+  while (innerDim > 0 && inputShape[innerDim] == outputShape[innerDim])
+    --innerDim;
+  int64_t runLength = 1;
+  for (int64_t i = innerDim; i < rank; ++i)
+    runLength *= inputShape[i];
+  if (rank > 0 &&
+      runLength * getMemRefEltSizeInBytes(memRefType) >= kMinPadCopyRunBytes) {
+    SmallVector<Value, 4> ivs;
+    if (innerDim > 0) {
+      BuildKrnlLoop copyLoops(rewriter, loc, innerDim);
+      copyLoops.createDefineOp();
+      for (int64_t i = 0; i < innerDim; ++i)
+        copyLoops.pushBounds(0, inputShape[i]);
+      copyLoops.parallelize(0);
+      copyLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(copyLoops.getIterateBlock());
+      auto loopIVs = copyLoops.getAllInductionVar();
+      ivs.append(loopIVs.begin(), loopIVs.end());
+    }
+    auto outputStrides = getStaticStrides(outputShape);
+    auto inputStrides = getStaticStrides(inputShape);
+    AffineExpr outputOffset = rewriter.getAffineConstantExpr(
+        padsBegin[innerDim] * outputStrides[innerDim]);
+    AffineExpr inputOffset = rewriter.getAffineConstantExpr(0);
+    for (int64_t i = 0; i < innerDim; ++i) {
+      auto d = rewriter.getAffineDimExpr(i);
+      outputOffset = outputOffset + (d + padsBegin[i]) * outputStrides[i];
+      inputOffset = inputOffset + d * inputStrides[i];
+    }
+    auto emitOffset = [&](AffineExpr offset) -> Value {
+      if (innerDim == 0)
+        return emitConstantOp(rewriter, loc, rewriter.getIndexType(),
+            offset.cast<AffineConstantExpr>().getValue());
+      return rewriter.create<AffineApplyOp>(
+          loc, AffineMap::get(innerDim, 0, offset), ivs);
+    };
+    Value destOffset = emitOffset(outputOffset);
+    Value srcOffset = emitOffset(inputOffset);
+    Value runBytes = emitConstantOp(rewriter, loc,
+        rewriter.getIntegerType(64),
+        runLength * getMemRefEltSizeInBytes(memRefType));
+    emitMemcpy(rewriter, loc, alloc, data, runBytes,
+        ValueRange{destOffset, srcOffset});
+    return;
+  }
+
+  // Otherwise, iterate over the data.
+  BuildKrnlLoop copyLoops(rewriter, loc, rank);
+  copyLoops.createDefineOp();
+  for (int64_t i = 0; i < rank; ++i)
+    copyLoops.pushBounds(0, inputShape[i]);
+  if (rank > 0)
+    copyLoops.parallelize(0);
+  copyLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(copyLoops.getIterateBlock());
+  SmallVector<Value, 4> inLoopIVs;
+  SmallVector<Value, 4> outLoopIVs;
+  for (int64_t i = 0; i < rank; ++i) {
+    Value iv = copyLoops.getInductionVar(i);
+    inLoopIVs.emplace_back(iv);
+    if (padsBegin[i] == 0) {
+      outLoopIVs.emplace_back(iv);
+    } else {
+      AffineMap indexWithOffsetMap =
+          AffineMap::get(1, 0, rewriter.getAffineDimExpr(0) + padsBegin[i]);
+      outLoopIVs.emplace_back(
+          rewriter.create<AffineApplyOp>(loc, indexWithOffsetMap, iv));
+    }
+  }
+  Value inputVal = rewriter.create<AffineLoadOp>(loc, data, inLoopIVs);
+  rewriter.create<AffineStoreOp>(loc, inputVal, alloc, outLoopIVs);
+}
+
 bool checkOpResultIsUsedByGetRef(AllocOp *allocOp) {
   FuncOp function = getContainingFunction(allocOp->getOperation());
 
@@ -22,6 +22,7 @@
 #include "llvm/ADT/Sequence.h"
 #include "llvm/ADT/TypeSwitch.h"
 
+#include "src/Conversion/ONNXToKrnl/TuningDatabase.hpp"
 #include "src/Dialect/Krnl/KrnlHelper.hpp"
 #include "src/Dialect/Krnl/KrnlOps.hpp"
 #include "src/Dialect/ONNX/ONNXOps.hpp"
@@ -52,10 +53,26 @@ Value insertAllocAndDealloc(MemRefType type, Location loc,
     ArrayRef<Value> operands = {}, int64_t alignment = -1);
 
 // Determine if current function returns the result value of the
-// current op being lowered. If it does then dealloc should not be
-// inserted.
+// current op being lowered, or the branch of an If yields it. If it
+// does then dealloc should not be inserted.
 bool checkInsertDealloc(Operation *currentOp, int resultIndex = 0);
 
+// Determine if a result of the current op, which only reshapes its input or
+// a part of it, can be a view of the buffer of the input instead of a copy.
+// The result must not be returned by the function, and both MemRefs must be
+// contiguous.
+bool canReshapeInPlace(Value input, Operation *currentOp, MemRefType type,
+    int resultIndex = 0);
+
+// Return the buffer of an operand of the current element-wise op which the
+// result of type `type` can reuse, or nullptr. The buffer must be allocated
+// and deallocated in the block of the op, have the type of the result and
+// hold an input which has no other use. The result must not be returned by
+// the function. When the op broadcasts its operands, the types must be
+// static, so that the operand is not broadcast.
+Value getInPlaceOperand(Operation *currentOp, ArrayRef<Value> operands,
+    MemRefType type, bool mayBroadcast);
+
 // Create a mapping from result type's dimensions to input type's dimensions,
 // given that the result type is the result of a reduction op over the input
 // type.
@@ -74,6 +91,9 @@ void defineLoops(ConversionPatternRewriter &rewriter, Location loc,
 
 unsigned getMemRefEltSizeInBytes(MemRefType memRefType);
 
+// Get the strides, in elements, of the dimensions of a static shape.
+SmallVector<int64_t, 4> getStaticStrides(ArrayRef<int64_t> shape);
+
 // Get run-time dimension information for unknown dimensions used for
 // broadcasting.
 std::map<int, std::map<int, Value>> getBroadcastedDimInfo(Location loc,
@@ -86,7 +106,8 @@ std::vector<Value> getLoopIVsForBroadcasting(Location loc,
     ConversionPatternRewriter &rewriter, ArrayRef<Value> loopIVs, Value operand,
     std::map<int, Value> broadcastedDims);
 
-// Emit a constant of a specific type.
+// Emit a constant of a specific type. If the type is a vector type, the
+// constant is splat to all the elements of the vector.
 // Use this function for small values only to avoid unexpected loss in type
 // casting.
 Value emitConstantOp(
@@ -107,6 +128,112 @@ Value emitNegativeInfinityConstantOp(
 
 int64_t ArrayAttrIntVal(ArrayAttr a, int i);
 
+// Size in bytes of the last level cache assumed by the lowerings. Copies into
+// a static destination larger than it are non-temporal: that destination
+// cannot stay in the caches until it is read anyway.
+static const int64_t kLastLevelCacheBytes = 32 * 1024 * 1024;
+
+// Emit a krnl.memcpy of `size` bytes from `src` into `dest`, at the given
+// element offsets if any, marked non-temporal when `dest` exceeds the last
+// level cache.
+KrnlMemcpyOp emitMemcpy(PatternRewriter &rewriter, Location loc, Value dest,
+    Value src, Value size, ValueRange offsets = {});
+
+// Test if the product of an M x K and a K x N matrix stored in the given
+// MemRefs is left to the BLAS library, i.e. if the MemRefs are f32 with static
+// shapes and the product has at least `blasThreshold` multiply-accumulates. A
+// threshold of 0 disables the BLAS library.
+bool isBlasGemmProfitable(ArrayRef<Value> memRefs, int64_t M, int64_t N,
+    int64_t K, int64_t blasThreshold);
+
+// Test if the loop nests of an operation on the given MemRefs are fully
+// unrolled into straight-line code, i.e. if the MemRefs have static shapes
+// and the innermost loop body runs at most `unrollThreshold` times. A
+// threshold of 0 disables the unrolling.
+bool isFullyUnrolled(
+    ArrayRef<Value> memRefs, int64_t numIterations, int64_t unrollThreshold);
+
+// Fully unroll loops of constant bounds defined by the same
+// krnl.define_loops, given outermost first. The krnl.unroll operations are
+// emitted right after the definition of the loops, innermost loop first.
+void emitFullUnroll(
+    ConversionPatternRewriter &rewriter, Location loc, ArrayRef<Value> loops);
+
+// Emit a krnl.blas_gemm computing C = alpha * op(A) * op(B) + beta * C, at the
+// given element offsets of the matrices within A, B and C if any.
+KrnlBlasGemmOp emitBlasGemm(PatternRewriter &rewriter, Location loc, Value A,
+    Value B, Value C, int64_t M, int64_t N, int64_t K, float alpha,
+    float beta, bool transA = false, bool transB = false,
+    ValueRange offsets = {});
+
+//===----------------------------------------------------------------------===//
+// Helpers of the lowering of half-precision floats. F16 and BF16 tensors are
+// stored as is, but matrix multiplications, convolutions and reductions
+// accumulate them in F32.
+//===----------------------------------------------------------------------===//
+
+// Get the type in which values of the given element type are accumulated.
+Type getAccumulationType(Type elementType);
+
+// Extend or truncate a float to the given float type. Other values are
+// returned unchanged.
+Value emitConvertFloat(ConversionPatternRewriter &rewriter, Location loc,
+    Value value, Type type);
+
+// Allocate the buffer accumulating the values of alloc, of the same shape and
+// of the accumulation type of its elements, or return alloc when its elements
+// are their own accumulation type.
+Value insertAccumulationBuffer(
+    ConversionPatternRewriter &rewriter, Location loc, Value alloc);
+
+// Emit the loop nest converting the accumulators of acc into alloc, of the
+// same shape. Nothing is emitted when acc is alloc.
+void emitStoreAccumulators(ConversionPatternRewriter &rewriter, Location loc,
+    Value acc, Value alloc);
+
+//===----------------------------------------------------------------------===//
+// Helpers of the lowering of quantized operations. Quantized tensors hold
+// signless integers, and their scales and zero points hold a single value
+// applying to the whole tensor.
+//===----------------------------------------------------------------------===//
+
+// Check that a scale or a zero point holds a single value, of a signless type
+// for zero points. Absent zero points are accepted.
+bool isPerTensorQuantizationParam(Value param);
+
+// Load the value of a scale, or the value of a zero point extended to i32.
+// Absent zero points are 0.
+Value loadScale(ConversionPatternRewriter &rewriter, Location loc, Value scale);
+Value loadZeroPoint(
+    ConversionPatternRewriter &rewriter, Location loc, Value zeroPoint);
+
+// Extend a quantized integer to i32, the type in which quantized products are
+// accumulated.
+Value emitExtendToI32(
+    ConversionPatternRewriter &rewriter, Location loc, Value value);
+
+// Quantize a real value already divided by its scale: round it to the nearest
+// integer, ties to even, add the i32 zero point and saturate the result to
+// the range of the quantized integer type.
+Value emitQuantize(ConversionPatternRewriter &rewriter, Location loc,
+    Value real, Value zeroPoint, IntegerType quantizedType);
+
+// Emit the loop nest quantizing the i32 accumulators of acc, multiplied by the
+// real multiplier, into the quantized tensor alloc of the same shape.
+void emitRequantization(ConversionPatternRewriter &rewriter, Location loc,
+    Value acc, Value multiplier, Value zeroPoint, Value alloc);
+
+//===----------------------------------------------------------------------===//
+// Helpers of the lowering of constant padding.
+//===----------------------------------------------------------------------===//
+
+// Emit the constant padding of data into alloc, both of static shapes, with
+// data starting at padsBegin in alloc. The borders of alloc are filled with
+// padValue one contiguous slab at a time, and data is only copied into the
+// interior, in contiguous runs when they are long enough.
+void emitConstantPadding(ConversionPatternRewriter &rewriter, Location loc,
+    Value data, Value alloc, ArrayRef<int64_t> padsBegin, Value padValue);
+
 //===----------------------------------------------------------------------===//
 // This is to get a scalar operation of a given type for a specific operation.
 //===----------------------------------------------------------------------===//
@@ -134,14 +261,16 @@ Value getIdentityValue(
 // This is used in the innermost loop of a KrnlIterateOp to insert computation
 // composed of one or many scalar ops.
 // Use template specialization for each of different ONNX operations.
+// The element type can also be a vector type, in which case the operation is
+// applied to all the elements of the vector operands.
 //===----------------------------------------------------------------------===//
 template <typename Op>
 Value emitScalarOpFor(ConversionPatternRewriter &rewriter, Location loc,
     Operation *op, Type elementType, ArrayRef<Value> scalarOperands) {
-  if (elementType.isa<IntegerType>()) {
+  if (getElementTypeOrSelf(elementType).isa<IntegerType>()) {
     return rewriter.create<ScalarIOp<Op>>(
         loc, elementType, scalarOperands, mlir::None);
-  } else if (elementType.isa<FloatType>()) {
+  } else if (getElementTypeOrSelf(elementType).isa<FloatType>()) {
     return rewriter.create<ScalarFOp<Op>>(
         loc, elementType, scalarOperands, mlir::None);
   } else {
@@ -149,6 +278,29 @@ Value emitScalarOpFor(ConversionPatternRewriter &rewriter, Location loc,
   }
 }
 
+// Specializations for the activations without attributes, which do not use
+// the operation and are also emitted by the lowering of the RNN operations.
+template <>
+Value emitScalarOpFor<ONNXReluOp>(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands);
+template <>
+Value emitScalarOpFor<ONNXTanhOp>(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands);
+template <>
+Value emitScalarOpFor<ONNXSigmoidOp>(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands);
+template <>
+Value emitScalarOpFor<ONNXSoftsignOp>(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands);
+template <>
+Value emitScalarOpFor<ONNXSoftplusOp>(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Type elementType,
+    ArrayRef<Value> scalarOperands);
+
 //===----------------------------------------------------------------------===//
 // Conversion from Tensor type to the Standard dialect MemRef type.
 //===----------------------------------------------------------------------===//
@@ -179,36 +331,129 @@ struct TensorTypeConverter : public TypeConverter {
   }
 };
 
+//===----------------------------------------------------------------------===//
+// Options controlling the lowering of some operations.
+//===----------------------------------------------------------------------===//
+
+// Tiling of matrix multiplications. The loops over the result are first
+// blocked into cache tiles, and the cache tiles into register tiles whose
+// loops are fully unrolled.
+struct MatMulTilingOptions {
+  bool enabled = false;
+  // Cache tile sizes along the M, N and K dimensions.
+  int64_t cacheTileM = 64;
+  int64_t cacheTileN = 256;
+  int64_t cacheTileK = 128;
+  // Register tile sizes along the M and N dimensions.
+  int64_t registerTileM = 4;
+  int64_t registerTileN = 8;
+  // Order of the loops over the cache tiles, outermost first, as a
+  // permutation of the letters m, n and k.
+  std::string cacheLoopOrder = "nkm";
+};
+
+// Strategy used to lower convolutions. Convolutions that a strategy does not
+// handle are lowered to the direct loop nest. `Auto` picks Winograd for the
+// convolutions it handles when its transforms cost less than the operations
+// they save, and im2col otherwise.
+enum class ConvLoweringStrategy { Direct, Im2Col, Winograd, Auto };
+
 //===----------------------------------------------------------------------===//
 // Functions to add lowering patterns for frontend operations.
 //===----------------------------------------------------------------------===//
 
 // `Math` directory methods:
 
+// Element-wise operations are vectorized along their innermost dimension with
+// vectors of `vectorBits` bits when it is positive. With `inPlace`, their
+// results reuse the buffer of an input which has no other use. The loops of
+// those of at most `unrollThreshold` elements are fully unrolled, see
+// isFullyUnrolled.
 void populateLoweringONNXElementwiseOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx,
+    int64_t vectorBits = 0, bool inPlace = false, int64_t unrollThreshold = 0);
+
+// Products of at least `blasThreshold` multiply-accumulates are left to the
+// BLAS library when it is positive, see isBlasGemmProfitable. The loops of
+// those of at most `unrollThreshold` multiply-accumulates are fully unrolled.
+void populateLoweringONNXGemmOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx, int64_t blasThreshold = 0, int64_t unrollThreshold = 0);
+
+// Matrix multiplications with an entry for `tuningTarget` in the tuning
+// database, if any, are tiled with the parameters of the entry. Products of
+// at least `blasThreshold` multiply-accumulates are left to the BLAS library
+// when it is positive, the loops of those of at most `unrollThreshold`
+// multiply-accumulates are fully unrolled.
+void populateLoweringONNXMatMulOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx,
+    const MatMulTilingOptions &tilingOptions = MatMulTilingOptions(),
+    const TuningDatabase *tuningDatabase = nullptr,
+    StringRef tuningTarget = "", int64_t blasThreshold = 0,
+    int64_t unrollThreshold = 0);
+
+// Reductions of the innermost axes are vectorized along the innermost
+// dimension with vectors of `vectorBits` bits when it is positive.
+void populateLoweringONNXReductionOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx, int64_t vectorBits = 0);
+
+// Softmax is vectorized along the innermost dimension with vectors of
+// `vectorBits` bits when it is positive.
+void populateLoweringONNXSoftmaxOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx, int64_t vectorBits = 0);
+
+void populateLoweringONNXTopKOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
-void populateLoweringONNXGemmOpPattern(
+void populateLoweringONNXSparseMatMulOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
-void populateLoweringONNXMatMulOpPattern(
+// `ControlFlow` directory methods:
+
+void populateLoweringONNXIfRegionOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
-void populateLoweringONNXReductionOpPattern(
+// `NN` directory methods:
+
+// Depthwise convolutions are vectorized along the width with vectors of
+// `vectorBits` bits when it is positive. The products of the im2col lowering
+// of at least `blasThreshold` multiply-accumulates are left to the BLAS
+// library when it is positive, whatever the strategy.
+void populateLoweringONNXConvOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx,
+    ConvLoweringStrategy strategy = ConvLoweringStrategy::Direct,
+    int64_t vectorBits = 0, int64_t blasThreshold = 0);
+
+// Transposed convolutions are computed as a gather over the input elements
+// of each output element.
+void populateLoweringONNXConvTransposeOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
-void populateLoweringONNXSoftmaxOpPattern(
+// LayerNormalization is vectorized along the innermost dimension with vectors
+// of `vectorBits` bits when it is positive.
+void populateLoweringONNXNormalizationOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx,
+    int64_t vectorBits = 0);
+
+void populateLoweringONNXFusedAttentionOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
-// `NN` directory methods:
+// Max pools and GlobalAveragePool are vectorized along the innermost
+// dimension with vectors of `vectorBits` bits when it is positive.
+void populateLoweringONNXPoolingOpPattern(OwningRewritePatternList &patterns,
+    MLIRContext *ctx, int64_t vectorBits = 0);
+
+// `Quantization` directory methods:
 
-void populateLoweringONNXConvOpPattern(
+void populateLoweringONNXQuantizeLinearOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
-void populateLoweringONNXNormalizationOpPattern(
+void populateLoweringONNXDequantizeLinearOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx);
+
+void populateLoweringONNXMatMulIntegerOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
-void populateLoweringONNXPoolingOpPattern(
+void populateLoweringONNXQLinearConvOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
 // `RNN` directory methods:
@@ -228,9 +473,18 @@ void populateLoweringONNXUnsqueezeOpPattern(
 void populateLoweringONNXTransposeOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
+void populateLoweringONNXLayoutTransformOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx);
+
 void populateLoweringONNXGatherOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
+void populateLoweringONNXScatterElementsOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx);
+
+void populateLoweringONNXScatterNDOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx);
+
 void populateLoweringONNXPadConstantValuePadOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
@@ -264,6 +518,15 @@ void populateLoweringONNXSizeOpPattern(
 void populateLoweringONNXTileOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx);
 
+void populateLoweringONNXResizeOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx);
+
+void populateLoweringONNXImagePreprocessOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx);
+
+void populateLoweringONNXEmbeddingBagOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx);
+
 bool checkOpResultIsUsedByGetRef(AllocOp *allocOp);
 
 int64_t getMemRefSizeInBytes(Value val);
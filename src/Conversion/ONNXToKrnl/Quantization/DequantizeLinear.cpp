@@ -0,0 +1,75 @@
+//===------- DequantizeLinear.cpp - Lowering DequantizeLinear Op ----------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX DequantizeLinear Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+struct ONNXDequantizeLinearOpLowering : public ConversionPattern {
+  ONNXDequantizeLinearOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXDequantizeLinearOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    ONNXDequantizeLinearOpAdaptor operandAdaptor(operands);
+    Value x = operandAdaptor.x();
+    Value scale = operandAdaptor.x_scale();
+    Value zeroPoint = operandAdaptor.x_zero_point();
+
+    // y = (x - x_zero_point) * x_scale
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto elementType = memRefType.getElementType();
+    auto quantizedType = x.getType()
+                             .cast<MemRefType>()
+                             .getElementType()
+                             .dyn_cast<IntegerType>();
+    if (!hasAllConstantDimensions(memRefType) || !quantizedType ||
+        !quantizedType.isSignless() || !isPerTensorQuantizationParam(scale) ||
+        !isPerTensorQuantizationParam(zeroPoint))
+      return failure();
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    Value scaleValue = loadScale(rewriter, loc, scale);
+    Value zeroPointValue = loadZeroPoint(rewriter, loc, zeroPoint);
+
+    int64_t rank = memRefType.getRank();
+    BuildKrnlLoop loops(rewriter, loc, rank);
+    loops.createDefineOp();
+    for (int i = 0; i < rank; ++i)
+      loops.pushBounds(0, alloc, i);
+    if (rank > 0)
+      loops.parallelize(0);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    {
+      auto ivs = loops.getAllInductionVar();
+      SmallVector<Value, 4> indices(ivs.begin(), ivs.end());
+      Value quantized = emitExtendToI32(
+          rewriter, loc, rewriter.create<AffineLoadOp>(loc, x, indices));
+      Value shifted = rewriter.create<SubIOp>(loc, quantized, zeroPointValue);
+      Value real = rewriter.create<MulFOp>(loc,
+          rewriter.create<SIToFPOp>(loc, elementType, shifted), scaleValue);
+      rewriter.create<AffineStoreOp>(loc, real, alloc, indices);
+    }
+
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+void populateLoweringONNXDequantizeLinearOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXDequantizeLinearOpLowering>(ctx);
+}
@@ -0,0 +1,222 @@
+//===------- MatMulInteger.cpp - Lowering Quantized MatMul Ops ------------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX MatMulInteger and QLinearMatMul Operators to Krnl
+// dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+// Check that the quantized matrices A (... x M x K) and B (K x N), or
+// B (... x K x N) with the batch dimensions of A, can be multiplied into a
+// result of the given type. All dimensions must be known at compile time.
+static bool isSupportedQuantizedMatMul(
+    Value A, Value B, MemRefType resultType) {
+  auto AType = A.getType().cast<MemRefType>();
+  auto BType = B.getType().cast<MemRefType>();
+  auto AElementType = AType.getElementType().dyn_cast<IntegerType>();
+  auto BElementType = BType.getElementType().dyn_cast<IntegerType>();
+  if (!AElementType || !AElementType.isSignless() || !BElementType ||
+      !BElementType.isSignless())
+    return false;
+  if (!hasAllConstantDimensions(AType) || !hasAllConstantDimensions(BType) ||
+      !hasAllConstantDimensions(resultType))
+    return false;
+  int64_t rank = AType.getRank();
+  if (rank < 2 || resultType.getRank() != rank)
+    return false;
+  if (BType.getRank() == 2)
+    return true;
+  return BType.getRank() == rank &&
+         AType.getShape().drop_back(2) == BType.getShape().drop_back(2);
+}
+
+// Emit the product of the quantized matrices A (... x M x K) and B (K x N or
+// ... x K x N), from which their zero points are subtracted, into the i32
+// accumulators of acc (... x M x N):
+//
+//   for b..., i = 0 .. M:         (parallel)
+//     for j = 0 .. N:
+//       acc[b..., i, j] = 0
+//     for k = 0 .. K:
+//       a = A[b..., i, k] - aZeroPoint
+//       for j = 0 .. N:
+//         acc[b..., i, j] += a * (B[b..., k, j] - bZeroPoint)
+//
+// The innermost loop runs over contiguous elements of B and acc, so that the
+// products of 8-bit integers accumulated in 32 bits are vectorized by the
+// backend.
+static void emitQuantizedMatMul(ConversionPatternRewriter &rewriter,
+    Location loc, Value A, Value aZeroPoint, Value B, Value bZeroPoint,
+    Value acc) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  auto accType = acc.getType().cast<MemRefType>();
+  int64_t rank = accType.getRank();
+  int64_t BRank = B.getType().cast<MemRefType>().getRank();
+  auto zero = emitConstantOp(rewriter, loc, accType.getElementType(), 0);
+
+  // Loops over the batch dimensions and the rows of the result.
+  BuildKrnlLoop outerLoops(rewriter, loc, rank - 1);
+  outerLoops.createDefineOp();
+  for (int i = 0; i < rank - 1; ++i)
+    outerLoops.pushBounds(0, acc, i);
+  outerLoops.parallelize(0);
+  outerLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+  auto outerIVs = outerLoops.getAllInductionVar();
+  SmallVector<Value, 4> batchIVs(outerIVs.begin(), outerIVs.end() - 1);
+  Value i = outerIVs.back();
+
+  // Fill the row of the result with zeros.
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop initLoops(rewriter, loc, 1);
+    initLoops.createDefineOp();
+    initLoops.pushBounds(0, acc, rank - 1);
+    initLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(initLoops.getIterateBlock());
+    SmallVector<Value, 4> accIndices(outerIVs.begin(), outerIVs.end());
+    accIndices.emplace_back(initLoops.getInductionVar(0));
+    rewriter.create<AffineStoreOp>(loc, zero, acc, accIndices);
+  }
+
+  // Reduction loop.
+  BuildKrnlLoop reductionLoops(rewriter, loc, 1);
+  reductionLoops.createDefineOp();
+  reductionLoops.pushBounds(0, A, rank - 1);
+  reductionLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(reductionLoops.getIterateBlock());
+  Value k = reductionLoops.getInductionVar(0);
+  SmallVector<Value, 4> AIndices(outerIVs.begin(), outerIVs.end());
+  AIndices.emplace_back(k);
+  Value a = rewriter.create<SubIOp>(loc,
+      emitExtendToI32(
+          rewriter, loc, rewriter.create<AffineLoadOp>(loc, A, AIndices)),
+      aZeroPoint);
+
+  // Loop over the columns of the result.
+  BuildKrnlLoop innerLoops(rewriter, loc, 1);
+  innerLoops.createDefineOp();
+  innerLoops.pushBounds(0, acc, rank - 1);
+  innerLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(innerLoops.getIterateBlock());
+  Value j = innerLoops.getInductionVar(0);
+  SmallVector<Value, 4> BIndices;
+  if (BRank > 2)
+    BIndices.append(batchIVs.begin(), batchIVs.end());
+  BIndices.emplace_back(k);
+  BIndices.emplace_back(j);
+  Value b = rewriter.create<SubIOp>(loc,
+      emitExtendToI32(
+          rewriter, loc, rewriter.create<AffineLoadOp>(loc, B, BIndices)),
+      bZeroPoint);
+  SmallVector<Value, 4> accIndices(batchIVs.begin(), batchIVs.end());
+  accIndices.emplace_back(i);
+  accIndices.emplace_back(j);
+  Value accumulated = rewriter.create<AffineLoadOp>(loc, acc, accIndices);
+  Value sum = rewriter.create<AddIOp>(
+      loc, accumulated, rewriter.create<MulIOp>(loc, a, b));
+  rewriter.create<AffineStoreOp>(loc, sum, acc, accIndices);
+}
+
+struct ONNXMatMulIntegerOpLowering : public ConversionPattern {
+  ONNXMatMulIntegerOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXMatMulIntegerOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    ONNXMatMulIntegerOpAdaptor operandAdaptor(operands);
+    Value A = operandAdaptor.A();
+    Value B = operandAdaptor.B();
+    Value aZeroPoint = operandAdaptor.a_zero_point();
+    Value bZeroPoint = operandAdaptor.b_zero_point();
+
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    if (!isSupportedQuantizedMatMul(A, B, memRefType) ||
+        !isPerTensorQuantizationParam(aZeroPoint) ||
+        !isPerTensorQuantizationParam(bZeroPoint))
+      return failure();
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    Value aZeroPointValue = loadZeroPoint(rewriter, loc, aZeroPoint);
+    Value bZeroPointValue = loadZeroPoint(rewriter, loc, bZeroPoint);
+    emitQuantizedMatMul(
+        rewriter, loc, A, aZeroPointValue, B, bZeroPointValue, alloc);
+
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+struct ONNXQLinearMatMulOpLowering : public ConversionPattern {
+  ONNXQLinearMatMulOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXQLinearMatMulOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    ONNXQLinearMatMulOpAdaptor operandAdaptor(operands);
+    Value A = operandAdaptor.a();
+    Value B = operandAdaptor.b();
+
+    // y = saturate(round((a - a_zero_point) * (b - b_zero_point) * a_scale *
+    //     b_scale / y_scale) + y_zero_point)
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto quantizedType = memRefType.getElementType().dyn_cast<IntegerType>();
+    if (!quantizedType || !quantizedType.isSignless() ||
+        !isSupportedQuantizedMatMul(A, B, memRefType) ||
+        !isPerTensorQuantizationParam(operandAdaptor.a_scale()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.a_zero_point()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.b_scale()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.b_zero_point()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.y_scale()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.y_zero_point()))
+      return failure();
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    // The products are accumulated in a temporary i32 buffer, then quantized
+    // into the result.
+    auto accType =
+        MemRefType::get(memRefType.getShape(), rewriter.getIntegerType(32));
+    Value acc = insertAllocAndDealloc(accType, loc, rewriter, true);
+
+    Value aZeroPoint =
+        loadZeroPoint(rewriter, loc, operandAdaptor.a_zero_point());
+    Value bZeroPoint =
+        loadZeroPoint(rewriter, loc, operandAdaptor.b_zero_point());
+    emitQuantizedMatMul(rewriter, loc, A, aZeroPoint, B, bZeroPoint, acc);
+
+    Value multiplier = rewriter.create<DivFOp>(loc,
+        rewriter.create<MulFOp>(loc,
+            loadScale(rewriter, loc, operandAdaptor.a_scale()),
+            loadScale(rewriter, loc, operandAdaptor.b_scale())),
+        loadScale(rewriter, loc, operandAdaptor.y_scale()));
+    Value yZeroPoint =
+        loadZeroPoint(rewriter, loc, operandAdaptor.y_zero_point());
+    emitRequantization(rewriter, loc, acc, multiplier, yZeroPoint, alloc);
+
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+void populateLoweringONNXMatMulIntegerOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXMatMulIntegerOpLowering, ONNXQLinearMatMulOpLowering>(
+      ctx);
+}
@@ -0,0 +1,259 @@
+//===----------- QLinearConv.cpp - Lowering QLinearConv Op ----------------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX QLinearConv Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+// Return the value of the i-th element of an optional array attribute, or the
+// default value when the attribute is absent.
+static int64_t getAttrValueOr(
+    Optional<ArrayAttr> attr, int i, int64_t defaultValue) {
+  return attr.hasValue() ? ArrayAttrIntVal(attr.getValue(), i) : defaultValue;
+}
+
+// Copy the quantized input X (N x C x D1 x ... x Dn) into the interior of
+// a buffer padded with its zero point, which is the quantized value of 0.
+static Value emitPaddedInput(ConversionPatternRewriter &rewriter, Location loc,
+    Value X, Value xZeroPoint, ArrayRef<int64_t> pads) {
+  OpBuilder::InsertionGuard guard(rewriter);
+  auto XType = X.getType().cast<MemRefType>();
+  auto XShape = XType.getShape();
+  int64_t rank = XType.getRank();
+  int64_t spatialRank = rank - 2;
+
+  SmallVector<int64_t, 4> paddedShape(XShape.begin(), XShape.end());
+  for (int i = 0; i < spatialRank; ++i)
+    paddedShape[i + 2] += pads[i] + pads[i + spatialRank];
+  auto paddedType = MemRefType::get(paddedShape, XType.getElementType());
+  Value padded = insertAllocAndDealloc(paddedType, loc, rewriter, true);
+
+  Value padValue = xZeroPoint;
+  if (XType.getElementType().cast<IntegerType>().getWidth() < 32)
+    padValue = rewriter.create<TruncateIOp>(
+        loc, XType.getElementType(), xZeroPoint);
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    BuildKrnlLoop fillLoops(rewriter, loc, padded);
+    fillLoops.createDefineAndIterateOp(padded);
+    rewriter.setInsertionPointToStart(fillLoops.getIterateBlock());
+    auto ivs = fillLoops.getAllInductionVar();
+    rewriter.create<AffineStoreOp>(loc, padValue, padded,
+        SmallVector<Value, 4>(ivs.begin(), ivs.end()));
+  }
+
+  BuildKrnlLoop copyLoops(rewriter, loc, X);
+  copyLoops.createDefineAndIterateOp(X);
+  rewriter.setInsertionPointToStart(copyLoops.getIterateBlock());
+  auto ivs = copyLoops.getAllInductionVar();
+  SmallVector<Value, 4> XIndices(ivs.begin(), ivs.end());
+  SmallVector<Value, 4> paddedIndices(ivs.begin(), ivs.begin() + 2);
+  for (int i = 0; i < spatialRank; ++i) {
+    AffineMap indexMap = AffineMap::get(
+        1, 0, rewriter.getAffineDimExpr(0) + pads[i]);
+    paddedIndices.emplace_back(
+        rewriter.create<AffineApplyOp>(loc, indexMap, ivs[i + 2]));
+  }
+  Value element = rewriter.create<AffineLoadOp>(loc, X, XIndices);
+  rewriter.create<AffineStoreOp>(loc, element, padded, paddedIndices);
+  return padded;
+}
+
+struct ONNXQLinearConvOpLowering : public ConversionPattern {
+  ONNXQLinearConvOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXQLinearConvOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    ONNXQLinearConvOpAdaptor operandAdaptor(operands);
+    auto convOp = llvm::cast<ONNXQLinearConvOp>(op);
+    Value X = operandAdaptor.x();
+    Value W = operandAdaptor.w();
+    Value bias = operandAdaptor.B();
+    bool hasBias = !bias.getType().isa<NoneType>();
+
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto quantizedType = memRefType.getElementType().dyn_cast<IntegerType>();
+    auto XType = X.getType().cast<MemRefType>();
+    auto WType = W.getType().cast<MemRefType>();
+    auto XElementType = XType.getElementType().dyn_cast<IntegerType>();
+    auto WElementType = WType.getElementType().dyn_cast<IntegerType>();
+    if (!quantizedType || !quantizedType.isSignless() || !XElementType ||
+        !XElementType.isSignless() || !WElementType ||
+        !WElementType.isSignless() || !hasAllConstantDimensions(memRefType) ||
+        !hasAllConstantDimensions(XType) || !hasAllConstantDimensions(WType))
+      return failure();
+    // Per output channel scales and zero points are not supported.
+    if (!isPerTensorQuantizationParam(operandAdaptor.x_scale()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.x_zero_point()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.w_scale()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.w_zero_point()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.y_scale()) ||
+        !isPerTensorQuantizationParam(operandAdaptor.y_zero_point()))
+      return failure();
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    // The products are accumulated in a temporary i32 buffer, then quantized
+    // into the result.
+    auto accType =
+        MemRefType::get(memRefType.getShape(), rewriter.getIntegerType(32));
+    Value acc = insertAllocAndDealloc(accType, loc, rewriter, true);
+
+    Value xZeroPoint =
+        loadZeroPoint(rewriter, loc, operandAdaptor.x_zero_point());
+    Value wZeroPoint =
+        loadZeroPoint(rewriter, loc, operandAdaptor.w_zero_point());
+
+    // Padding is applied to a copy of the input.
+    auto kernelShape = WType.getShape();
+    int64_t spatialRank = kernelShape.size() - 2;
+    SmallVector<int64_t, 4> pads, strides, dilations;
+    for (int i = 0; i < 2 * spatialRank; ++i)
+      pads.emplace_back(getAttrValueOr(convOp.pads(), i, 0));
+    for (int i = 0; i < spatialRank; ++i) {
+      strides.emplace_back(getAttrValueOr(convOp.strides(), i, 1));
+      dilations.emplace_back(getAttrValueOr(convOp.dilations(), i, 1));
+    }
+    Value input = X;
+    if (llvm::any_of(pads, [](int64_t pad) { return pad != 0; }))
+      input = emitPaddedInput(rewriter, loc, X, xZeroPoint, pads);
+
+    // acc = Conv(X - x_zero_point, W - w_zero_point) + B
+    //
+    // kernelsPerGroup = M / group;
+    // for n = 0 .. N:                     (parallel)
+    //   for g = 0 .. group:
+    //     for m = 0 .. kernelsPerGroup:   (parallel)
+    //       kernel = g * kernelsPerGroup + m;
+    //       for r1 = 0 .. R1, ..., rn = 0 .. Rn:
+    //         acc[n][kernel][r1]...[rn] = B[kernel];
+    //         for c = 0 .. C/group, k1 = 0 .. K1, ..., kn = 0 .. Kn:
+    //           acc[n][kernel][r1]...[rn] +=
+    //             (X[n][g * C/group + c][s1 * r1 + d1 * k1]... - xZeroPoint) *
+    //             (W[kernel][c][k1]...[kn] - wZeroPoint);
+    {
+      OpBuilder::InsertionGuard guard(rewriter);
+      int64_t group = convOp.group();
+      int64_t kernelsPerGroup = kernelShape[0] / group;
+      int64_t subchannels = kernelShape[1];
+
+      BuildKrnlLoop outerLoops(rewriter, loc, (group > 1) ? 3 : 2);
+      outerLoops.createDefineOp();
+      int nIndex = outerLoops.pushBounds(0, alloc, 0);
+      int gIndex = -1;
+      if (group > 1)
+        gIndex = outerLoops.pushBounds(0, group);
+      int mIndex = outerLoops.pushBounds(0, kernelsPerGroup);
+      outerLoops.parallelize(nIndex);
+      outerLoops.parallelize(mIndex);
+      outerLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+
+      Value kernel = outerLoops.getInductionVar(mIndex);
+      Value channelBase;
+      if (group > 1) {
+        Value g = outerLoops.getInductionVar(gIndex);
+        AffineMap kernelMap = AffineMap::get(2, 0,
+            rewriter.getAffineDimExpr(0) * kernelsPerGroup +
+                rewriter.getAffineDimExpr(1));
+        kernel = rewriter.create<AffineApplyOp>(
+            loc, kernelMap, ArrayRef<Value>{g, kernel});
+        channelBase = g;
+      }
+
+      BuildKrnlLoop spatialLoops(rewriter, loc, spatialRank);
+      spatialLoops.createDefineOp();
+      for (int i = 0; i < spatialRank; ++i)
+        spatialLoops.pushBounds(0, alloc, i + 2);
+      spatialLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(spatialLoops.getIterateBlock());
+
+      SmallVector<Value, 4> accIndices;
+      accIndices.emplace_back(outerLoops.getInductionVar(nIndex));
+      accIndices.emplace_back(kernel);
+      for (auto arg : spatialLoops.getIterateBlock()->getArguments())
+        accIndices.emplace_back(arg);
+      Value init = hasBias ? rewriter.create<AffineLoadOp>(loc, bias, kernel)
+                                 .getResult()
+                           : emitConstantOp(rewriter, loc,
+                                 accType.getElementType(), 0);
+      rewriter.create<AffineStoreOp>(loc, init, acc, accIndices);
+
+      BuildKrnlLoop innerLoops(rewriter, loc, 1 + spatialRank);
+      innerLoops.createDefineOp();
+      int cIndex = innerLoops.pushBounds(0, subchannels);
+      for (int i = 0; i < spatialRank; ++i)
+        innerLoops.pushBounds(0, W, i + 2);
+      innerLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(innerLoops.getIterateBlock());
+
+      Value c = innerLoops.getInductionVar(cIndex);
+      SmallVector<Value, 4> inputIndices;
+      inputIndices.emplace_back(outerLoops.getInductionVar(nIndex));
+      if (group > 1) {
+        AffineMap channelMap = AffineMap::get(2, 0,
+            rewriter.getAffineDimExpr(0) * subchannels +
+                rewriter.getAffineDimExpr(1));
+        inputIndices.emplace_back(rewriter.create<AffineApplyOp>(
+            loc, channelMap, ArrayRef<Value>{channelBase, c}));
+      } else {
+        inputIndices.emplace_back(c);
+      }
+      for (int i = 0; i < spatialRank; ++i) {
+        AffineMap indexMap = AffineMap::get(2, 0,
+            rewriter.getAffineDimExpr(0) * strides[i] +
+                rewriter.getAffineDimExpr(1) * dilations[i]);
+        inputIndices.emplace_back(rewriter.create<AffineApplyOp>(loc, indexMap,
+            ArrayRef<Value>{spatialLoops.getInductionVar(i),
+                innerLoops.getInductionVar(i + 1)}));
+      }
+      SmallVector<Value, 4> kernelIndices;
+      kernelIndices.emplace_back(kernel);
+      kernelIndices.emplace_back(c);
+      for (int i = 0; i < spatialRank; ++i)
+        kernelIndices.emplace_back(innerLoops.getInductionVar(i + 1));
+
+      Value x = rewriter.create<SubIOp>(loc,
+          emitExtendToI32(rewriter, loc,
+              rewriter.create<AffineLoadOp>(loc, input, inputIndices)),
+          xZeroPoint);
+      Value w = rewriter.create<SubIOp>(loc,
+          emitExtendToI32(rewriter, loc,
+              rewriter.create<AffineLoadOp>(loc, W, kernelIndices)),
+          wZeroPoint);
+      Value accumulated = rewriter.create<AffineLoadOp>(loc, acc, accIndices);
+      Value sum = rewriter.create<AddIOp>(
+          loc, accumulated, rewriter.create<MulIOp>(loc, x, w));
+      rewriter.create<AffineStoreOp>(loc, sum, acc, accIndices);
+    }
+
+    Value multiplier = rewriter.create<DivFOp>(loc,
+        rewriter.create<MulFOp>(loc,
+            loadScale(rewriter, loc, operandAdaptor.x_scale()),
+            loadScale(rewriter, loc, operandAdaptor.w_scale())),
+        loadScale(rewriter, loc, operandAdaptor.y_scale()));
+    Value yZeroPoint =
+        loadZeroPoint(rewriter, loc, operandAdaptor.y_zero_point());
+    emitRequantization(rewriter, loc, acc, multiplier, yZeroPoint, alloc);
+
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+void populateLoweringONNXQLinearConvOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXQLinearConvOpLowering>(ctx);
+}
@@ -0,0 +1,73 @@
+//===-------- QuantizeLinear.cpp - Lowering QuantizeLinear Op -------------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX QuantizeLinear Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+struct ONNXQuantizeLinearOpLowering : public ConversionPattern {
+  ONNXQuantizeLinearOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXQuantizeLinearOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    auto loc = op->getLoc();
+    ONNXQuantizeLinearOpAdaptor operandAdaptor(operands);
+    Value x = operandAdaptor.x();
+    Value scale = operandAdaptor.y_scale();
+    Value zeroPoint = operandAdaptor.y_zero_point();
+
+    // y = saturate(round(x / y_scale) + y_zero_point)
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto quantizedType = memRefType.getElementType().dyn_cast<IntegerType>();
+    if (!hasAllConstantDimensions(memRefType) || !quantizedType ||
+        !quantizedType.isSignless() || !isPerTensorQuantizationParam(scale) ||
+        !isPerTensorQuantizationParam(zeroPoint))
+      return failure();
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+    Value scaleValue = loadScale(rewriter, loc, scale);
+    Value zeroPointValue = loadZeroPoint(rewriter, loc, zeroPoint);
+
+    int64_t rank = memRefType.getRank();
+    BuildKrnlLoop loops(rewriter, loc, rank);
+    loops.createDefineOp();
+    for (int i = 0; i < rank; ++i)
+      loops.pushBounds(0, alloc, i);
+    if (rank > 0)
+      loops.parallelize(0);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    {
+      auto ivs = loops.getAllInductionVar();
+      SmallVector<Value, 4> indices(ivs.begin(), ivs.end());
+      Value real = rewriter.create<AffineLoadOp>(loc, x, indices);
+      // Integer inputs are quantized as their real values.
+      if (real.getType().isa<IntegerType>())
+        real = rewriter.create<SIToFPOp>(loc, scaleValue.getType(), real);
+      real = rewriter.create<DivFOp>(loc, real, scaleValue);
+      Value quantized =
+          emitQuantize(rewriter, loc, real, zeroPointValue, quantizedType);
+      rewriter.create<AffineStoreOp>(loc, quantized, alloc, indices);
+    }
+
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+void populateLoweringONNXQuantizeLinearOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXQuantizeLinearOpLowering>(ctx);
+}
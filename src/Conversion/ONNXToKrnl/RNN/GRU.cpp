@@ -16,6 +16,13 @@ struct GruState {
   Value allH;
   Value ht;
   bool linearBeforeReset;
+  // Projection of the input of all the timesteps on the gates, the biases
+  // included unless linearBeforeReset is set.
+  Value xw;
+  // Projection of the hidden state on the gates, for the current timestep.
+  Value hr;
+  // rt (.) Ht-1 for the current timestep, unless linearBeforeReset is set.
+  Value rh;
 };
 
 struct GruActivationPack {
@@ -192,6 +199,30 @@ GruState allocAndInitializeStates<ONNXGRUOp, GruState>(
     state.linearBeforeReset = false;
   else
     state.linearBeforeReset = true;
+
+  // The input projections do not depend on the recurrence, compute them for
+  // all the timesteps at once. Rbh is multiplied by rt when linearBeforeReset
+  // is set, the biases of the recurrence weights are then added to the
+  // projections of the hidden state instead.
+  state.xw = emitInputProjection(rewriter, loc, operandAdaptor.X(),
+      operandAdaptor.W(), operandAdaptor.B(),
+      /*addRecurrenceBias=*/!state.linearBeforeReset);
+  auto elementType =
+      operandAdaptor.X().getType().cast<ShapedType>().getElementType();
+  auto batchDimSize = dimAt(operandAdaptor.X(), 1);
+  // One projection of the hidden state per direction, so that the directions
+  // can run in parallel.
+  auto numDirections = dimAt(operandAdaptor.R(), 0);
+  auto hrMemRefType = MemRefType::get(
+      {numDirections, batchDimSize, dimAt(operandAdaptor.R(), 1)},
+      elementType);
+  state.hr = insertAllocAndDealloc(hrMemRefType, loc, rewriter, true);
+  if (!state.linearBeforeReset) {
+    auto rhMemRefType = MemRefType::get(
+        {numDirections, batchDimSize, dimAt(operandAdaptor.R(), 2)},
+        elementType);
+    state.rh = insertAllocAndDealloc(rhMemRefType, loc, rewriter, true);
+  }
   return state;
 }
 
@@ -204,13 +235,8 @@ void calculateState<ONNXGRUOp, GruState, GruActivationPack>(
   // GRU has 3 gates: Update, Reset, and Hidden.
   const int GATES = 3;
 
-  bool hasBiasForInput = false;
-  if (!isNoneType(operandAdaptor.B()))
-    hasBiasForInput = true;
-
   // Prepare dimensions.
   auto batchDimSize = dimAt(operandAdaptor.X(), 1);
-  auto inputDimSize = dimAt(operandAdaptor.X(), 2);
   auto hiddenDimSize = dimAt(operandAdaptor.R(), 2);
   Value hiddenDimVal =
       emitConstantOp(rewriter, loc, rewriter.getIndexType(), hiddenDimSize);
@@ -218,7 +244,7 @@ void calculateState<ONNXGRUOp, GruState, GruActivationPack>(
   auto elementType =
       operandAdaptor.X().getType().cast<ShapedType>().getElementType();
 
-  // Prepare AffineMap to access the bias tensor.
+  // Prepare AffineMap to access the gates.
   AffineMap accessByOffsetMap;
   {
     AffineExpr iv = rewriter.getAffineDimExpr(0);
@@ -230,10 +256,34 @@ void calculateState<ONNXGRUOp, GruState, GruActivationPack>(
 
   // Prepare constant indices.
   SmallVector<Value, GATES> constantIndices;
-  for (int i = 0; i < 2 * GATES; i++)
+  for (int i = 0; i < GATES; i++)
     constantIndices.emplace_back(
         emitConstantOp(rewriter, loc, rewriter.getIndexType(), i));
 
+  // Compute the IVs of the gates in the projections.
+  // XW[zrh] :: [num_directions, seq_length, batch_size, GATES*hidden_size]
+  // HR[zrh] :: [num_directions, batch_size, GATES*hidden_size]
+  auto getGateIVs = [&](Value batchIV, Value hiddenIV,
+                        SmallVectorImpl<SmallVector<Value, 4>> &xwIVs,
+                        SmallVectorImpl<SmallVector<Value, 4>> &hrIVs) {
+    for (unsigned i = 0; i < GATES; ++i) {
+      Value gateHiddenIV =
+          rewriter.create<AffineApplyOp>(loc, accessByOffsetMap,
+              std::vector<Value>{/*iv=*/hiddenIV,
+                  /*index=*/constantIndices[i], /*size=*/hiddenDimVal});
+      xwIVs.emplace_back(SmallVector<Value, 4>{
+          directionIV, sequenceIV, batchIV, gateHiddenIV});
+      hrIVs.emplace_back(
+          SmallVector<Value, 4>{directionIV, batchIV, gateHiddenIV});
+    }
+  };
+  // Sum the projections of the input and of the hidden state on a gate.
+  auto emitGate = [&](ArrayRef<Value> xwIVs, ArrayRef<Value> hrIVs) -> Value {
+    Value loadXW = rewriter.create<AffineLoadOp>(loc, state.xw, xwIVs);
+    Value loadHR = rewriter.create<AffineLoadOp>(loc, state.hr, hrIVs);
+    return rewriter.create<AddFOp>(loc, loadXW, loadHR);
+  };
+
   // Equations (Default: f=Sigmoid, g=Tanh):"
   // zt = f(Xt*(Wz^T) + Ht-1*(Rz^T) + Wbz + Rbz)"
   // rt = f(Xt*(Wr^T) + Ht-1*(Rr^T) + Wbr + Rbr)"
@@ -243,27 +293,79 @@ void calculateState<ONNXGRUOp, GruState, GruActivationPack>(
   //   ht = g(Xt*(Wh^T) + (rt (.) Ht-1)*(Rh^T) + Rbh + Wbh)
   // Ht = (1 - zt) (.) ht + zt (.) Ht-1"
   //
-
-  // The following code will emit loops as follows:
-  // for b in 0 .. BatchDimSize
-  //   for h in 0 .. HiddenDimSize {
-  //     for i in 0 .. InputDimSize {
-  //       compute Xt*(Wz^T), Ht-1*(Rz^T),
-  //               Xt*(Wr^T), Ht-1*(Rr^T),
-  //               Xt*(Wh^T),
-  //       if (linearBeforeReset)
-  //         Ht-1*(Rh^T)
-  //     }
-  //     compute zt, rt
-  //     if (!linearBeforeReset)
-  //       compute RHt = (rt (.) Ht-1)
-  //       for i in 0 .. InputDimSize {
+  // Xt*(W[zrh]^T) + Wb[zrh] have been computed for all the timesteps before
+  // the recurrence, together with Rb[zrh] if not linearBeforeReset. The
+  // following code will emit loops as follows:
+  // if (linearBeforeReset)
+  //   for b in 0 .. BatchDimSize
+  //     for g in 0 .. 3*HiddenDimSize
+  //       for k in 0 .. HiddenDimSize
+  //         compute Ht-1*(R[zrh]^T) + Rb[zrh]
+  // else
+  //   for b in 0 .. BatchDimSize
+  //     for g in 0 .. 2*HiddenDimSize
+  //       for k in 0 .. HiddenDimSize
+  //         compute Ht-1*(R[zr]^T)
+  //   for b in 0 .. BatchDimSize
+  //     for h in 0 .. HiddenDimSize
+  //       compute rt, RHt = (rt (.) Ht-1)
+  //   for b in 0 .. BatchDimSize
+  //     for g in 2*HiddenDimSize .. 3*HiddenDimSize
+  //       for k in 0 .. HiddenDimSize
   //         compute (RHt)*(Rh^T)
-  //     compute ht
-  //   }
+  // for b in 0 .. BatchDimSize
+  //   for h in 0 .. HiddenDimSize
+  //     compute zt, ht, Ht
+
+  if (state.linearBeforeReset) {
+    // Ht-1*(R[zrh]^T) + Rb[zrh], the three gates in a single matrix
+    // multiplication.
+    emitRecurrentProjection(rewriter, loc, state.ht, operandAdaptor.R(),
+        operandAdaptor.B(), directionIV, 0, GATES * hiddenDimSize, state.hr);
+  } else {
+    // Ht-1*(R[zr]^T), the update and reset gates in a single matrix
+    // multiplication.
+    emitRecurrentProjection(rewriter, loc, state.ht, operandAdaptor.R(),
+        /*B=*/nullptr, directionIV, 0, 2 * hiddenDimSize, state.hr);
+
+    { // RHt = rt (.) Ht-1
+      OpBuilder::InsertionGuard guard(rewriter);
+      BuildKrnlLoop resetLoops(rewriter, loc, 2);
+      resetLoops.createDefineOp();
+      resetLoops.parallelize(0);
+      resetLoops.parallelize(1);
+      resetLoops.pushBounds(0, batchDimSize);
+      resetLoops.pushBounds(0, hiddenDimSize);
+      resetLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(resetLoops.getIterateBlock());
+
+      auto batchIV = resetLoops.getInductionVar(0);
+      auto hiddenIV = resetLoops.getInductionVar(1);
+      SmallVector<SmallVector<Value, 4>, GATES> xwZRHIVs, hrZRHIVs;
+      getGateIVs(batchIV, hiddenIV, xwZRHIVs, hrZRHIVs);
+
+      // rt = f(Xt*(Wr^T) + Ht-1*(Rr^T) + Wbr + Rbr)
+      Value rt = emitGate(xwZRHIVs[1], hrZRHIVs[1]);
+      rt = applyActivation(rewriter, loc, activationPack.f, rt);
+      Value loadH = rewriter.create<AffineLoadOp>(
+          loc, state.ht, ArrayRef<Value>{directionIV, batchIV, hiddenIV});
+      Value rtHt = rewriter.create<MulFOp>(loc, rt, loadH);
+      rewriter.create<AffineStoreOp>(
+          loc, rtHt, state.rh,
+          ArrayRef<Value>{directionIV, batchIV, hiddenIV});
+    }
+
+    // (rt (.) Ht-1)*(Rh^T)
+    emitRecurrentProjection(rewriter, loc, state.rh, operandAdaptor.R(),
+        /*B=*/nullptr, directionIV, 2 * hiddenDimSize, GATES * hiddenDimSize,
+        state.hr);
+  }
 
+  // The batch and hidden elements of the state are independent.
   BuildKrnlLoop stateLoops(rewriter, loc, 2);
   stateLoops.createDefineOp();
+  stateLoops.parallelize(0);
+  stateLoops.parallelize(1);
   stateLoops.pushBounds(0, batchDimSize);
   stateLoops.pushBounds(0, hiddenDimSize);
   stateLoops.createIterateOp();
@@ -275,208 +377,35 @@ void calculateState<ONNXGRUOp, GruState, GruActivationPack>(
 
     // IVs to access tensors.
     // IVs for the hidden state tensor.
-    SmallVector<Value, 3> hIVs, cIVs;
-    // IVs for the bias tensors for W and R.
-    SmallVector<SmallVector<Value, 2>, GATES> wbZRHIVs, rbZRHIVs;
-
-    { // Compute IVs.
-      // H :: [num_directions, batch_size, hidden_size]
-      hIVs = {directionIV, batchIV, hiddenIV};
-
-      // Bias [Wb[zrh], Rb[zrh]] :: [num_directions, 2*GATES*hidden_size]
-      if (hasBiasForInput) {
-        // Wb[zrh]
-        for (unsigned i = 0; i < GATES; ++i) {
-          Value wHiddenIV =
-              rewriter.create<AffineApplyOp>(loc, accessByOffsetMap,
-                  std::vector<Value>{/*iv=*/hiddenIV,
-                      /*index=*/constantIndices[i], /*size=*/hiddenDimVal});
-          wbZRHIVs.emplace_back(SmallVector<Value, 2>{directionIV, wHiddenIV});
-        }
-        // Rb[zrh]
-        for (unsigned i = GATES; i < 2 * GATES; ++i) {
-          Value rHiddenIV =
-              rewriter.create<AffineApplyOp>(loc, accessByOffsetMap,
-                  std::vector<Value>{/*iv=*/hiddenIV,
-                      /*index=*/constantIndices[i], /*size=*/hiddenDimVal});
-          rbZRHIVs.emplace_back(SmallVector<Value, 2>{directionIV, rHiddenIV});
-        }
-      }
-    }
+    SmallVector<Value, 3> hIVs;
+    // IVs for the projections on the gates.
+    SmallVector<SmallVector<Value, 4>, GATES> xwZRHIVs, hrZRHIVs;
 
-    Value loadH = rewriter.create<AffineLoadOp>(loc, state.ht, hIVs);
+    // H :: [num_directions, batch_size, hidden_size]
+    hIVs = {directionIV, batchIV, hiddenIV};
+    getGateIVs(batchIV, hiddenIV, xwZRHIVs, hrZRHIVs);
 
-    // Emit instructions for matrix multiplications:
-    //   Xt*(Wz^T), Ht-1*(Rz^T),
-    //   Xt*(Wr^T), Ht-1*(Rr^T),
-    //   Xt*(Wh^T),
-    //   if (linearBeforeReset)
-    //     Ht-1*(Rh^T)
-
-    // Allocate memory for storing matrix multiplication results.
-    SmallVector<Value, GATES> xwZRH, hrZRH;
-    Value zero = emitConstantOp(rewriter, loc, elementType, 0);
-    MemRefType scalarMemRefType = MemRefType::get({}, elementType, {}, 0);
-    for (unsigned i = 0; i < GATES; ++i) {
-      Value xwAlloc = rewriter.create<AllocOp>(loc, scalarMemRefType);
-      rewriter.create<AffineStoreOp>(loc, zero, xwAlloc, ArrayRef<Value>{});
-      Value hrAlloc = rewriter.create<AllocOp>(loc, scalarMemRefType);
-      rewriter.create<AffineStoreOp>(loc, zero, hrAlloc, ArrayRef<Value>{});
-      xwZRH.emplace_back(xwAlloc);
-      hrZRH.emplace_back(hrAlloc);
-    }
-
-    { // Emit instructions for matrix multiplications.
-      // input_size is the reduction dimension.
-      BuildKrnlLoop reductionLoops(rewriter, loc, 1);
-      reductionLoops.createDefineOp();
-      reductionLoops.pushBounds(0, inputDimSize);
-      reductionLoops.createIterateOp();
-
-      auto ipReductionLoops = rewriter.saveInsertionPoint();
-      rewriter.setInsertionPointToStart(reductionLoops.getIterateBlock());
-      {
-        auto reductionIV = reductionLoops.getInductionVar(0);
-        // Prepare IVs for accessing the input tensor and parameters.
-        SmallVector<Value, 3> xIVs;
-        SmallVector<SmallVector<Value, 3>, GATES> wZRHIVs, rZRHIVs;
-
-        // X :: [seq_length, batch_size, input_size]
-        xIVs = {sequenceIV, batchIV, reductionIV};
-
-        // W[zrh] :: [num_directions, GATES*hidden_size, input_size]
-        // R[zrh] :: [num_directions, GATES*hidden_size, input_size]
-        for (unsigned i = 0; i < GATES; ++i) {
-          SmallVector<Value, 3> wIVs, rIVs;
-          Value wHiddenIV = rewriter.create<AffineApplyOp>(loc,
-              accessByOffsetMap,
-              std::vector<Value>{hiddenIV, constantIndices[i], hiddenDimVal});
-
-          wIVs = {directionIV, wHiddenIV, reductionIV};
-          wZRHIVs.emplace_back(wIVs);
-
-          rIVs = {directionIV, wHiddenIV, reductionIV};
-          rZRHIVs.emplace_back(rIVs);
-        }
-
-        Value loadX =
-            rewriter.create<AffineLoadOp>(loc, operandAdaptor.X(), xIVs);
-        for (unsigned i = 0; i < GATES; ++i) {
-          // Xt * W[zrh]
-          Value loadW = rewriter.create<AffineLoadOp>(
-              loc, operandAdaptor.W(), wZRHIVs[i]);
-          Value xwVal = rewriter.create<MulFOp>(loc, loadX, loadW);
-          Value loadXW = rewriter.create<AffineLoadOp>(loc, xwZRH[i]);
-          Value nextXW = rewriter.create<AddFOp>(loc, loadXW, xwVal);
-          rewriter.create<AffineStoreOp>(
-              loc, nextXW, xwZRH[i], ArrayRef<Value>{});
-
-          // Ht-1 * R[zrh]
-          // Only compute Ht-1*(Rh^T) if not linearBeforeReset
-          if (!state.linearBeforeReset && (i == GATES - 1))
-            continue;
-          Value loadR = rewriter.create<AffineLoadOp>(
-              loc, operandAdaptor.R(), rZRHIVs[i]);
-          Value hrVal = rewriter.create<MulFOp>(loc, loadH, loadR);
-          Value loadHR = rewriter.create<AffineLoadOp>(loc, hrZRH[i]);
-          Value nextHR = rewriter.create<AddFOp>(loc, loadHR, hrVal);
-          rewriter.create<AffineStoreOp>(
-              loc, nextHR, hrZRH[i], ArrayRef<Value>{});
-        }
-      }
-      rewriter.restoreInsertionPoint(ipReductionLoops);
-    }
+    Value loadH = rewriter.create<AffineLoadOp>(loc, state.ht, hIVs);
 
     // zt = f(Xt*(Wz^T) + Ht-1*(Rz^T) + Wbz + Rbz)
-    Value loadXWZ = rewriter.create<AffineLoadOp>(loc, xwZRH[0]);
-    Value loadHRZ = rewriter.create<AffineLoadOp>(loc, hrZRH[0]);
-    Value zt = rewriter.create<AddFOp>(loc, loadXWZ, loadHRZ);
-    if (hasBiasForInput) {
-      Value loadWB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), wbZRHIVs[0]);
-      zt = rewriter.create<AddFOp>(loc, zt, loadWB);
-      Value loadRB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), rbZRHIVs[0]);
-      zt = rewriter.create<AddFOp>(loc, zt, loadRB);
-    }
+    Value zt = emitGate(xwZRHIVs[0], hrZRHIVs[0]);
     zt = applyActivation(rewriter, loc, activationPack.f, zt);
 
-    // rt = f(Xt*(Wr^T) + Ht-1*(Rr^T) + Wbr + Rbr)
-    Value loadXWR = rewriter.create<AffineLoadOp>(loc, xwZRH[1]);
-    Value loadHRR = rewriter.create<AffineLoadOp>(loc, hrZRH[1]);
-    Value rt = rewriter.create<AddFOp>(loc, loadXWR, loadHRR);
-    if (hasBiasForInput) {
-      Value loadWB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), wbZRHIVs[1]);
-      rt = rewriter.create<AddFOp>(loc, rt, loadWB);
-      Value loadRB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), rbZRHIVs[1]);
-      rt = rewriter.create<AddFOp>(loc, rt, loadRB);
-    }
-    rt = applyActivation(rewriter, loc, activationPack.f, rt);
-
     // if (linearBeforeReset)
     //   ht = g(Xt*(Wh^T) + (rt (.) (Ht-1*(Rh^T) + Rbh)) + Wbh)
     // else
     //   ht = g(Xt*(Wh^T) + (rt (.) Ht-1)*(Rh^T) + Rbh + Wbh)
-    Value ht = rewriter.create<AffineLoadOp>(loc, xwZRH[2]);
+    Value ht;
     if (state.linearBeforeReset) {
-      Value linear = rewriter.create<AffineLoadOp>(loc, hrZRH[2]);
-      if (hasBiasForInput) {
-        Value loadRB =
-            rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), rbZRHIVs[2]);
-        linear = rewriter.create<AddFOp>(loc, linear, loadRB);
-      }
+      // rt = f(Xt*(Wr^T) + Ht-1*(Rr^T) + Wbr + Rbr)
+      Value rt = emitGate(xwZRHIVs[1], hrZRHIVs[1]);
+      rt = applyActivation(rewriter, loc, activationPack.f, rt);
+      Value loadXW = rewriter.create<AffineLoadOp>(loc, state.xw, xwZRHIVs[2]);
+      Value linear = rewriter.create<AffineLoadOp>(loc, state.hr, hrZRHIVs[2]);
       Value reset = rewriter.create<MulFOp>(loc, rt, linear);
-      ht = rewriter.create<AddFOp>(loc, ht, reset);
-      if (hasBiasForInput) {
-        Value loadWB =
-            rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), wbZRHIVs[2]);
-        ht = rewriter.create<AddFOp>(loc, ht, loadWB);
-      }
+      ht = rewriter.create<AddFOp>(loc, loadXW, reset);
     } else {
-      // rtHt = rt (.) Ht-1)
-      Value rtHt = rewriter.create<MulFOp>(loc, rt, loadH);
-      {
-        // Emit instructions for 'rtHt*(Rh^T)'.
-        // input_size is the reduction dimension.
-        BuildKrnlLoop reductionLoops(rewriter, loc, 1);
-        reductionLoops.createDefineOp();
-        reductionLoops.pushBounds(0, inputDimSize);
-        reductionLoops.createIterateOp();
-
-        auto ipReductionLoops = rewriter.saveInsertionPoint();
-        rewriter.setInsertionPointToStart(reductionLoops.getIterateBlock());
-        {
-          auto reductionIV = reductionLoops.getInductionVar(0);
-          // Rh :: [num_directions, hidden_size, input_size]
-          Value wHiddenIV = rewriter.create<AffineApplyOp>(loc,
-              accessByOffsetMap,
-              std::vector<Value>{hiddenIV, constantIndices[2], hiddenDimVal});
-          SmallVector<Value, 3> rhIVs = {directionIV, wHiddenIV, reductionIV};
-
-          // 'rtHt*(Rh^T)'
-          Value loadR =
-              rewriter.create<AffineLoadOp>(loc, operandAdaptor.R(), rhIVs);
-          Value hrVal = rewriter.create<MulFOp>(loc, rtHt, loadR);
-          Value loadHR = rewriter.create<AffineLoadOp>(loc, hrZRH[2]);
-          Value nextHR = rewriter.create<AddFOp>(loc, loadHR, hrVal);
-          rewriter.create<AffineStoreOp>(
-              loc, nextHR, hrZRH[2], ArrayRef<Value>{});
-        }
-        rewriter.restoreInsertionPoint(ipReductionLoops);
-      }
-      //   ht = g(Xt*(Wh^T) + (rt (.) Ht-1)*(Rh^T) + Rbh + Wbh)
-      Value linear = rewriter.create<AffineLoadOp>(loc, hrZRH[2]);
-      ht = rewriter.create<AddFOp>(loc, ht, linear);
-      if (hasBiasForInput) {
-        Value loadWB =
-            rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), wbZRHIVs[2]);
-        ht = rewriter.create<AddFOp>(loc, ht, loadWB);
-        Value loadRB =
-            rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), rbZRHIVs[2]);
-        ht = rewriter.create<AddFOp>(loc, ht, loadRB);
-      }
+      ht = emitGate(xwZRHIVs[2], hrZRHIVs[2]);
     }
     ht = applyActivation(rewriter, loc, activationPack.g, ht);
 
@@ -493,12 +422,6 @@ void calculateState<ONNXGRUOp, GruState, GruActivationPack>(
       SmallVector<Value, 4> allHIVs{sequenceIV, directionIV, batchIV, hiddenIV};
       rewriter.create<AffineStoreOp>(loc, Ht, state.allH, allHIVs);
     }
-
-    // Deallocate the temporary results of matrix multiplications.
-    for (Value v : xwZRH)
-      rewriter.create<DeallocOp>(loc, v);
-    for (Value v : hrZRH)
-      rewriter.create<DeallocOp>(loc, v);
   }
 }
 
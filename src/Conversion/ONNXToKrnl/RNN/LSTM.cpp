@@ -16,6 +16,11 @@ struct LstmState {
   Value allH;
   Value ht;
   Value ct;
+  // Projection of the input of all the timesteps on the gates, the biases
+  // included.
+  Value xw;
+  // Projection of the hidden state on the gates, for the current timestep.
+  Value hr;
 };
 
 struct LstmActivationPack {
@@ -233,6 +238,18 @@ LstmState allocAndInitializeStates<ONNXLSTMOp, LstmState>(
     rewriter.create<AffineStoreOp>(loc, cellVal, state.ct, IVs);
   }
   rewriter.restoreInsertionPoint(ipInitializationLoops);
+
+  // The input projections do not depend on the recurrence, compute them for
+  // all the timesteps at once.
+  state.xw = emitInputProjection(rewriter, loc, operandAdaptor.X(),
+      operandAdaptor.W(), operandAdaptor.B(), /*addRecurrenceBias=*/true);
+  // One projection of the hidden state per direction, so that the directions
+  // can run in parallel.
+  auto hrMemRefType = MemRefType::get(
+      {dimAt(operandAdaptor.R(), 0), dimAt(operandAdaptor.X(), 1),
+          dimAt(operandAdaptor.R(), 1)},
+      operandAdaptor.X().getType().cast<ShapedType>().getElementType());
+  state.hr = insertAllocAndDealloc(hrMemRefType, loc, rewriter, true);
   return state;
 }
 
@@ -242,23 +259,17 @@ void calculateState<ONNXLSTMOp, LstmState, LstmActivationPack>(
     typename ONNXLSTMOp::Adaptor operandAdaptor, LstmState state,
     LstmActivationPack activationPack, Value directionIV, Value sequenceIV) {
 
-  bool hasBiasForInput = false, hasPeepholes = false;
-  if (!isNoneType(operandAdaptor.B()))
-    hasBiasForInput = true;
+  bool hasPeepholes = false;
   if (!isNoneType(operandAdaptor.P()))
     hasPeepholes = true;
 
   // Prepare dimensions.
   auto batchDimSize = dimAt(operandAdaptor.X(), 1);
-  auto inputDimSize = dimAt(operandAdaptor.X(), 2);
   auto hiddenDimSize = dimAt(operandAdaptor.R(), 2);
   Value hiddenDimVal =
       emitConstantOp(rewriter, loc, rewriter.getIndexType(), hiddenDimSize);
 
-  auto elementType =
-      operandAdaptor.X().getType().cast<ShapedType>().getElementType();
-
-  // Prepare AffineMap to access bias, peepholes tensors.
+  // Prepare AffineMap to access the gates, peepholes tensors.
   AffineMap accessByOffsetMap;
   {
     AffineExpr iv = rewriter.getAffineDimExpr(0);
@@ -270,7 +281,7 @@ void calculateState<ONNXLSTMOp, LstmState, LstmActivationPack>(
 
   // Prepare constant indices.
   SmallVector<Value, 4> constantIndices;
-  for (int i = 0; i < 8; i++)
+  for (int i = 0; i < 4; i++)
     constantIndices.emplace_back(
         emitConstantOp(rewriter, loc, rewriter.getIndexType(), i));
 
@@ -282,17 +293,27 @@ void calculateState<ONNXLSTMOp, LstmState, LstmActivationPack>(
   // ot = f(Xt*(Wo^T) + Ht-1*(Ro^T) + Po (.) Ct + Wbo + Rbo)
   // Ht = ot (.) h(Ct)
   //
-  // The following code will emit loops as follows:
+  // Xt*(W[iofc]^T) + Wb[iofc] + Rb[iofc] have been computed for all the
+  // timesteps before the recurrence. The following code will emit loops as
+  // follows:
+  // for b in 0 .. BatchDimSize
+  //   for g in 0 .. 4*HiddenDimSize
+  //     for k in 0 .. HiddenDimSize
+  //       compute Ht-1*(R[iofc]^T)
   // for b in 0 .. BatchDimSize
   //   for h in 0 .. HiddenDimSize
-  //     for i in 0 .. InputDimSize {
-  //       compute Xt*(Wi^T), Xt*(Wo^T), Xt*(Wf^t), Xt*(Wc^T),
-  //               Ht-1*(Ri^T), Ht-1*(Ro^T), Ht-1*(Rf^t), Ht-1*(Rc^T)
-  //     }
   //     compute it, ft, ct, Ct, ot, Ht
 
+  // Ht-1*(R[iofc]^T), the four gates in a single matrix multiplication.
+  emitRecurrentProjection(rewriter, loc, state.ht, operandAdaptor.R(),
+      /*B=*/nullptr,
+      directionIV, 0, dimAt(operandAdaptor.R(), 1), state.hr);
+
+  // The batch and hidden elements of the state are independent.
   BuildKrnlLoop stateLoops(rewriter, loc, 2);
   stateLoops.createDefineOp();
+  stateLoops.parallelize(0);
+  stateLoops.parallelize(1);
   stateLoops.pushBounds(0, batchDimSize);
   stateLoops.pushBounds(0, hiddenDimSize);
   stateLoops.createIterateOp();
@@ -305,8 +326,8 @@ void calculateState<ONNXLSTMOp, LstmState, LstmActivationPack>(
     // IVs to access tensors.
     // IVs for the hidden and cell state tensors.
     SmallVector<Value, 4> hIVs, cIVs;
-    // IVs for the bias tensors for W and R.
-    SmallVector<SmallVector<Value, 4>, 4> wbIOFCIVs, rbIOFCIVs;
+    // IVs for the projections on the gates.
+    SmallVector<SmallVector<Value, 4>, 4> xwIOFCIVs, hrIOFCIVs;
     // IVs for the peepholes.
     SmallVector<SmallVector<Value, 4>, 4> pIOFIVs;
 
@@ -316,25 +337,17 @@ void calculateState<ONNXLSTMOp, LstmState, LstmActivationPack>(
       // C :: [num_directions, batch_size, hidden_size]
       cIVs = {directionIV, batchIV, hiddenIV};
 
-      // Bias [Wb[iofc], Rb[iofc]] :: [num_directions, 8*hidden_size]
-      if (hasBiasForInput) {
-        // Wb[iofc]
-        for (unsigned i = 0; i < 4; ++i) {
-          Value wHiddenIV =
-              rewriter.create<AffineApplyOp>(loc, accessByOffsetMap,
-                  std::vector<Value>{/*iv=*/hiddenIV,
-                      /*index=*/constantIndices[i], /*size=*/hiddenDimVal});
-          wbIOFCIVs.emplace_back(SmallVector<Value, 2>{directionIV, wHiddenIV});
-        }
-        // Rb[iofc]
-        for (unsigned i = 4; i < 8; ++i) {
-          SmallVector<Value, 4> rbIVs;
-          Value rHiddenIV =
-              rewriter.create<AffineApplyOp>(loc, accessByOffsetMap,
-                  std::vector<Value>{/*iv=*/hiddenIV,
-                      /*index=*/constantIndices[i], /*size=*/hiddenDimVal});
-          rbIOFCIVs.emplace_back(SmallVector<Value, 2>{directionIV, rHiddenIV});
-        }
+      // XW[iofc] :: [num_directions, seq_length, batch_size, 4*hidden_size]
+      // HR[iofc] :: [num_directions, batch_size, 4*hidden_size]
+      for (unsigned i = 0; i < 4; ++i) {
+        Value gateHiddenIV =
+            rewriter.create<AffineApplyOp>(loc, accessByOffsetMap,
+                std::vector<Value>{/*iv=*/hiddenIV,
+                    /*index=*/constantIndices[i], /*size=*/hiddenDimVal});
+        xwIOFCIVs.emplace_back(SmallVector<Value, 4>{
+            directionIV, sequenceIV, batchIV, gateHiddenIV});
+        hrIOFCIVs.emplace_back(
+            SmallVector<Value, 4>{directionIV, batchIV, gateHiddenIV});
       }
 
       // Peepholes P[iof] :: [num_directions, 3*hidden_size]
@@ -349,135 +362,37 @@ void calculateState<ONNXLSTMOp, LstmState, LstmActivationPack>(
       }
     }
 
-    Value loadH = rewriter.create<AffineLoadOp>(loc, state.ht, hIVs);
     Value loadC = rewriter.create<AffineLoadOp>(loc, state.ct, cIVs);
 
-    // Emit instructions for matrix multiplications:
-    //   Xt*(Wi^T), Xt*(Wo^T), Xt*(Wf^t), Xt*(Wc^T)
-    //   Ht-1*(Ri^T), Ht-1*(Ro^T), Ht-1*(Rf^t), Ht-1*(Rc^T)
-
-    // Allocate memory for storing matrix multiplication results.
-    SmallVector<Value, 4> xwIOFC, hrIOFC;
-    Value zero = emitConstantOp(rewriter, loc, elementType, 0);
-    MemRefType scalarMemRefType = MemRefType::get({}, elementType, {}, 0);
-    for (unsigned i = 0; i < 4; ++i) {
-      Value xwAlloc = rewriter.create<AllocOp>(loc, scalarMemRefType);
-      rewriter.create<AffineStoreOp>(loc, zero, xwAlloc, ArrayRef<Value>{});
-      Value hrAlloc = rewriter.create<AllocOp>(loc, scalarMemRefType);
-      rewriter.create<AffineStoreOp>(loc, zero, hrAlloc, ArrayRef<Value>{});
-      xwIOFC.emplace_back(xwAlloc);
-      hrIOFC.emplace_back(hrAlloc);
-    }
-
-    { // Emit instructions for matrix multiplications.
-      // input_size is the reduction dimension.
-      BuildKrnlLoop reductionLoops(rewriter, loc, 1);
-      reductionLoops.createDefineOp();
-      reductionLoops.pushBounds(0, inputDimSize);
-      reductionLoops.createIterateOp();
-
-      auto ipReductionLoops = rewriter.saveInsertionPoint();
-      rewriter.setInsertionPointToStart(reductionLoops.getIterateBlock());
-      {
-        auto reductionIV = reductionLoops.getInductionVar(0);
-        // Prepare IVs for accessing the input tensor and parameters.
-        SmallVector<Value, 4> xIVs;
-        SmallVector<SmallVector<Value, 4>, 4> wIOFCIVs, rIOFCIVs;
-
-        // X :: [seq_length, batch_size, input_size]
-        xIVs = {sequenceIV, batchIV, reductionIV};
-
-        // W[iofc] :: [num_directions, 4*hidden_size, input_size]
-        // R[iofc] :: [num_directions, 4*hidden_size, input_size]
-        for (unsigned i = 0; i < 4; ++i) {
-          SmallVector<Value, 4> wIVs, rIVs;
-          Value wHiddenIV = rewriter.create<AffineApplyOp>(loc,
-              accessByOffsetMap,
-              std::vector<Value>{hiddenIV, constantIndices[i], hiddenDimVal});
-
-          wIVs = {directionIV, wHiddenIV, reductionIV};
-          wIOFCIVs.emplace_back(wIVs);
-
-          rIVs = {directionIV, wHiddenIV, reductionIV};
-          rIOFCIVs.emplace_back(rIVs);
-        }
-
-        Value loadX =
-            rewriter.create<AffineLoadOp>(loc, operandAdaptor.X(), xIVs);
-        for (unsigned i = 0; i < 4; ++i) {
-          // Xt * Wiofc
-          Value loadW = rewriter.create<AffineLoadOp>(
-              loc, operandAdaptor.W(), wIOFCIVs[i]);
-          Value xwVal = rewriter.create<MulFOp>(loc, loadX, loadW);
-          Value loadXW = rewriter.create<AffineLoadOp>(loc, xwIOFC[i]);
-          Value nextXW = rewriter.create<AddFOp>(loc, loadXW, xwVal);
-          rewriter.create<AffineStoreOp>(
-              loc, nextXW, xwIOFC[i], ArrayRef<Value>{});
-          // Ht-1 * Riofc
-          Value loadR = rewriter.create<AffineLoadOp>(
-              loc, operandAdaptor.R(), rIOFCIVs[i]);
-          Value hrVal = rewriter.create<MulFOp>(loc, loadH, loadR);
-          Value loadHR = rewriter.create<AffineLoadOp>(loc, hrIOFC[i]);
-          Value nextHR = rewriter.create<AddFOp>(loc, loadHR, hrVal);
-          rewriter.create<AffineStoreOp>(
-              loc, nextHR, hrIOFC[i], ArrayRef<Value>{});
-        }
-      }
-      rewriter.restoreInsertionPoint(ipReductionLoops);
-    }
+    // Sum the projections of the input and of the hidden state on a gate.
+    auto emitGate = [&](unsigned i) -> Value {
+      Value loadXW = rewriter.create<AffineLoadOp>(loc, state.xw, xwIOFCIVs[i]);
+      Value loadHR = rewriter.create<AffineLoadOp>(loc, state.hr, hrIOFCIVs[i]);
+      return rewriter.create<AddFOp>(loc, loadXW, loadHR);
+    };
 
     // it = f(Xt*(Wi^T) + Ht-1*(Ri^T) + Pi (.) Ct-1 + Wbi + Rbi)
-    Value loadXWI = rewriter.create<AffineLoadOp>(loc, xwIOFC[0]);
-    Value loadHRI = rewriter.create<AffineLoadOp>(loc, hrIOFC[0]);
-    Value it = rewriter.create<AddFOp>(loc, loadXWI, loadHRI);
+    Value it = emitGate(0);
     if (hasPeepholes) {
       Value loadP =
           rewriter.create<AffineLoadOp>(loc, operandAdaptor.P(), pIOFIVs[0]);
       Value PC = rewriter.create<MulFOp>(loc, loadP, loadC);
       it = rewriter.create<AddFOp>(loc, it, PC);
     }
-    if (hasBiasForInput) {
-      Value loadWB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), wbIOFCIVs[0]);
-      it = rewriter.create<AddFOp>(loc, it, loadWB);
-      Value loadRB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), rbIOFCIVs[0]);
-      it = rewriter.create<AddFOp>(loc, it, loadRB);
-    }
     it = applyActivation(rewriter, loc, activationPack.f, it);
 
     // ft = f(Xt*(Wf^T) + Ht-1*(Rf^T) + Pf (.) Ct-1 + Wbf + Rbf)
-    Value loadXWF = rewriter.create<AffineLoadOp>(loc, xwIOFC[2]);
-    Value loadHRF = rewriter.create<AffineLoadOp>(loc, hrIOFC[2]);
-    Value ft = rewriter.create<AddFOp>(loc, loadXWF, loadHRF);
+    Value ft = emitGate(2);
     if (hasPeepholes) {
       Value loadP =
           rewriter.create<AffineLoadOp>(loc, operandAdaptor.P(), pIOFIVs[2]);
       Value PC = rewriter.create<MulFOp>(loc, loadP, loadC);
       ft = rewriter.create<AddFOp>(loc, ft, PC);
     }
-    if (hasBiasForInput) {
-      Value loadWB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), wbIOFCIVs[2]);
-      ft = rewriter.create<AddFOp>(loc, ft, loadWB);
-      Value loadRB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), rbIOFCIVs[2]);
-      ft = rewriter.create<AddFOp>(loc, ft, loadRB);
-    }
     ft = applyActivation(rewriter, loc, activationPack.f, ft);
 
     // ct = g(Xt*(Wc^T) + Ht-1*(Rc^T) + Wbc + Rbc)
-    Value loadXWC = rewriter.create<AffineLoadOp>(loc, xwIOFC[3]);
-    Value loadHRC = rewriter.create<AffineLoadOp>(loc, hrIOFC[3]);
-    Value ct = rewriter.create<AddFOp>(loc, loadXWC, loadHRC);
-    if (hasBiasForInput) {
-      Value loadWB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), wbIOFCIVs[3]);
-      ct = rewriter.create<AddFOp>(loc, ct, loadWB);
-      Value loadRB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), rbIOFCIVs[3]);
-      ct = rewriter.create<AddFOp>(loc, ct, loadRB);
-    }
+    Value ct = emitGate(3);
     ct = applyActivation(rewriter, loc, activationPack.g, ct);
 
     // Ct = ft (.) Ct-1 + it (.) ct
@@ -487,23 +402,13 @@ void calculateState<ONNXLSTMOp, LstmState, LstmActivationPack>(
     rewriter.create<AffineStoreOp>(loc, Ct, state.ct, cIVs);
 
     // ot = f(Xt*(Wo^T) + Ht-1*(Ro^T) + Po (.) Ct + Wbo + Rbo)
-    Value loadXWO = rewriter.create<AffineLoadOp>(loc, xwIOFC[1]);
-    Value loadHRO = rewriter.create<AffineLoadOp>(loc, hrIOFC[1]);
-    Value ot = rewriter.create<AddFOp>(loc, loadXWO, loadHRO);
+    Value ot = emitGate(1);
     if (hasPeepholes) {
       Value loadP =
           rewriter.create<AffineLoadOp>(loc, operandAdaptor.P(), pIOFIVs[1]);
       Value PC = rewriter.create<MulFOp>(loc, loadP, Ct);
       ot = rewriter.create<AddFOp>(loc, ot, PC);
     }
-    if (hasBiasForInput) {
-      Value loadWB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), wbIOFCIVs[1]);
-      ot = rewriter.create<AddFOp>(loc, ot, loadWB);
-      Value loadRB =
-          rewriter.create<AffineLoadOp>(loc, operandAdaptor.B(), rbIOFCIVs[1]);
-      ot = rewriter.create<AddFOp>(loc, ot, loadRB);
-    }
     ot = applyActivation(rewriter, loc, activationPack.f, ot);
 
     // Ht = ot (.) h(Ct)
@@ -516,12 +421,6 @@ void calculateState<ONNXLSTMOp, LstmState, LstmActivationPack>(
       SmallVector<Value, 4> allHIVs{sequenceIV, directionIV, batchIV, hiddenIV};
       rewriter.create<AffineStoreOp>(loc, Ht, state.allH, allHIVs);
     }
-
-    // Deallocate the temporary results of matrix multiplications.
-    for (Value v : xwIOFC)
-      rewriter.create<DeallocOp>(loc, v);
-    for (Value v : hrIOFC)
-      rewriter.create<DeallocOp>(loc, v);
   }
 }
 
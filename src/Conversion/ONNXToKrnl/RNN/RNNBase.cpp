@@ -23,6 +23,26 @@ int64_t dimAt(Value val, int index) {
 // Apply an activation function on a given scalar operand.
 Value applyActivation(ConversionPatternRewriter &rewriter, Location loc,
     RNNActivation activation, Value scalarOperand) {
+  // The activations without attributes are emitted on the scalar directly,
+  // leaving the loops of the recurrence free of allocations so that they can
+  // be parallelized.
+  Type elementType = scalarOperand.getType();
+  if (activation.name.equals_lower("relu"))
+    return emitScalarOpFor<ONNXReluOp>(
+        rewriter, loc, nullptr, elementType, {scalarOperand});
+  if (activation.name.equals_lower("tanh"))
+    return emitScalarOpFor<ONNXTanhOp>(
+        rewriter, loc, nullptr, elementType, {scalarOperand});
+  if (activation.name.equals_lower("sigmoid"))
+    return emitScalarOpFor<ONNXSigmoidOp>(
+        rewriter, loc, nullptr, elementType, {scalarOperand});
+  if (activation.name.equals_lower("softsign"))
+    return emitScalarOpFor<ONNXSoftsignOp>(
+        rewriter, loc, nullptr, elementType, {scalarOperand});
+  if (activation.name.equals_lower("softplus"))
+    return emitScalarOpFor<ONNXSoftplusOp>(
+        rewriter, loc, nullptr, elementType, {scalarOperand});
+
   Value res;
 
   MemRefType scalarMemRefType =
@@ -40,13 +60,7 @@ Value applyActivation(ConversionPatternRewriter &rewriter, Location loc,
         rewriter.getNamedAttr("beta", activation.beta.getValue()));
   }
 
-  if (activation.name.equals_lower("relu"))
-    res = rewriter.create<ONNXReluOp>(loc, scalarMemRefType, alloc);
-  else if (activation.name.equals_lower("tanh"))
-    res = rewriter.create<ONNXTanhOp>(loc, scalarMemRefType, alloc);
-  else if (activation.name.equals_lower("sigmoid"))
-    res = rewriter.create<ONNXSigmoidOp>(loc, scalarMemRefType, alloc);
-  else if (activation.name.equals_lower("affine"))
+  if (activation.name.equals_lower("affine"))
     llvm_unreachable("Unsupported activation");
   else if (activation.name.equals_lower("leakyrelu"))
     res = rewriter.create<ONNXLeakyReluOp>(
@@ -61,13 +75,129 @@ Value applyActivation(ConversionPatternRewriter &rewriter, Location loc,
         loc, scalarMemRefType, alloc, attributes);
   else if (activation.name.equals_lower("elu"))
     res = rewriter.create<ONNXEluOp>(loc, scalarMemRefType, alloc, attributes);
-  else if (activation.name.equals_lower("softsign"))
-    res = rewriter.create<ONNXSoftsignOp>(loc, scalarMemRefType, alloc);
-  else if (activation.name.equals_lower("softplus"))
-    res = rewriter.create<ONNXSoftplusOp>(loc, scalarMemRefType, alloc);
   else
     llvm_unreachable("Unsupported activation");
 
   Value result = rewriter.create<AffineLoadOp>(loc, res);
   return result;
 }
+
+// Emit the projection of the input of all the timesteps on the input weights
+// of all the gates.
+Value emitInputProjection(ConversionPatternRewriter &rewriter, Location loc,
+    Value X, Value W, Value B, bool addRecurrenceBias) {
+  auto elementType = X.getType().cast<ShapedType>().getElementType();
+  int64_t numDirections = dimAt(W, 0);
+  int64_t gateRows = dimAt(W, 1);
+  int64_t inputDimSize = dimAt(X, 2);
+  auto xwMemRefType = MemRefType::get(
+      {numDirections, dimAt(X, 0), dimAt(X, 1), gateRows}, elementType);
+  Value xw = insertAllocAndDealloc(xwMemRefType, loc, rewriter, true);
+
+  // The iterations over the output are independent, those over the timesteps
+  // are run in parallel.
+  OpBuilder::InsertionGuard guard(rewriter);
+  BuildKrnlLoop projectionLoops(rewriter, loc, 4);
+  projectionLoops.createDefineOp();
+  projectionLoops.parallelize(1);
+  for (int i = 0; i < 4; ++i)
+    projectionLoops.pushBounds(0, xwMemRefType.getShape()[i]);
+  projectionLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(projectionLoops.getIterateBlock());
+
+  Value directionIV = projectionLoops.getInductionVar(0);
+  Value sequenceIV = projectionLoops.getInductionVar(1);
+  Value batchIV = projectionLoops.getInductionVar(2);
+  Value gateIV = projectionLoops.getInductionVar(3);
+  SmallVector<Value, 4> xwIVs = {directionIV, sequenceIV, batchIV, gateIV};
+
+  // Initialize with the biases, Rb following Wb in B.
+  Value init = emitConstantOp(rewriter, loc, elementType, 0);
+  if (!isNoneType(B)) {
+    init = rewriter.create<AffineLoadOp>(
+        loc, B, ArrayRef<Value>{directionIV, gateIV});
+    if (addRecurrenceBias) {
+      AffineMap rbMap = AffineMap::get(2, 0,
+          {rewriter.getAffineDimExpr(0),
+              rewriter.getAffineDimExpr(1) + gateRows},
+          rewriter.getContext());
+      Value rb = rewriter.create<AffineLoadOp>(
+          loc, B, rbMap, ArrayRef<Value>{directionIV, gateIV});
+      init = rewriter.create<AddFOp>(loc, init, rb);
+    }
+  }
+  rewriter.create<AffineStoreOp>(loc, init, xw, xwIVs);
+
+  // input_size is the reduction dimension.
+  BuildKrnlLoop reductionLoops(rewriter, loc, 1);
+  reductionLoops.createDefineOp();
+  reductionLoops.pushBounds(0, inputDimSize);
+  reductionLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(reductionLoops.getIterateBlock());
+  {
+    Value reductionIV = reductionLoops.getInductionVar(0);
+    Value loadX = rewriter.create<AffineLoadOp>(
+        loc, X, ArrayRef<Value>{sequenceIV, batchIV, reductionIV});
+    Value loadW = rewriter.create<AffineLoadOp>(
+        loc, W, ArrayRef<Value>{directionIV, gateIV, reductionIV});
+    Value xwVal = rewriter.create<MulFOp>(loc, loadX, loadW);
+    Value loadXW = rewriter.create<AffineLoadOp>(loc, xw, xwIVs);
+    Value nextXW = rewriter.create<AddFOp>(loc, loadXW, xwVal);
+    rewriter.create<AffineStoreOp>(loc, nextXW, xw, xwIVs);
+  }
+  return xw;
+}
+
+// Emit the product of a hidden state with the recurrence weights of some
+// rows of R.
+void emitRecurrentProjection(ConversionPatternRewriter &rewriter,
+    Location loc, Value H, Value R, Value B, Value directionIV,
+    int64_t rowBegin, int64_t rowEnd, Value HR) {
+  auto elementType = HR.getType().cast<MemRefType>().getElementType();
+  int64_t gateRows = dimAt(R, 1);
+  int64_t hiddenDimSize = dimAt(R, 2);
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  BuildKrnlLoop projectionLoops(rewriter, loc, 2);
+  projectionLoops.createDefineOp();
+  projectionLoops.parallelize(0);
+  projectionLoops.parallelize(1);
+  projectionLoops.pushBounds(0, dimAt(HR, 1));
+  projectionLoops.pushBounds(rowBegin, rowEnd);
+  projectionLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(projectionLoops.getIterateBlock());
+
+  Value batchIV = projectionLoops.getInductionVar(0);
+  Value gateIV = projectionLoops.getInductionVar(1);
+  SmallVector<Value, 3> hrIVs = {directionIV, batchIV, gateIV};
+
+  // Initialize with the bias of the recurrence weights, following Wb in B.
+  Value init = emitConstantOp(rewriter, loc, elementType, 0);
+  if (B && !isNoneType(B)) {
+    AffineMap rbMap = AffineMap::get(2, 0,
+        {rewriter.getAffineDimExpr(0),
+            rewriter.getAffineDimExpr(1) + gateRows},
+        rewriter.getContext());
+    init = rewriter.create<AffineLoadOp>(
+        loc, B, rbMap, ArrayRef<Value>{directionIV, gateIV});
+  }
+  rewriter.create<AffineStoreOp>(loc, init, HR, hrIVs);
+
+  // hidden_size is the reduction dimension.
+  BuildKrnlLoop reductionLoops(rewriter, loc, 1);
+  reductionLoops.createDefineOp();
+  reductionLoops.pushBounds(0, hiddenDimSize);
+  reductionLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(reductionLoops.getIterateBlock());
+  {
+    Value reductionIV = reductionLoops.getInductionVar(0);
+    Value loadH = rewriter.create<AffineLoadOp>(
+        loc, H, ArrayRef<Value>{directionIV, batchIV, reductionIV});
+    Value loadR = rewriter.create<AffineLoadOp>(
+        loc, R, ArrayRef<Value>{directionIV, gateIV, reductionIV});
+    Value hrVal = rewriter.create<MulFOp>(loc, loadH, loadR);
+    Value loadHR = rewriter.create<AffineLoadOp>(loc, HR, hrIVs);
+    Value nextHR = rewriter.create<AddFOp>(loc, loadHR, hrVal);
+    rewriter.create<AffineStoreOp>(loc, nextHR, HR, hrIVs);
+  }
+}
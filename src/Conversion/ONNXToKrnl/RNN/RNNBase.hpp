@@ -9,6 +9,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "mlir/IR/AffineExpr.h"
+#include "mlir/IR/IntegerSet.h"
 #include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
 
 using namespace mlir;
@@ -33,6 +34,26 @@ int64_t dimAt(Value val, int index);
 Value applyActivation(ConversionPatternRewriter &rewriter, Location loc,
     RNNActivation activation, Value scalarOperand);
 
+// Emit the projection of the input of all the timesteps on the input weights
+// of all the gates, ahead of the recurrence:
+//   XW[d][t][b][g] = sum_i X[t][b][i] * W[d][g][i] + Wb[d][g] (+ Rb[d][g])
+// The bias of the recurrence weights is also added if
+// `addRecurrenceBias` is set. Returns a buffer of type
+// [num_directions, seq_length, batch_size, num_gates*hidden_size].
+Value emitInputProjection(ConversionPatternRewriter &rewriter, Location loc,
+    Value X, Value W, Value B, bool addRecurrenceBias);
+
+// Emit the product of a hidden state with the recurrence weights of the rows
+// [rowBegin, rowEnd) of R, for the direction `directionIV`, into `HR`:
+//   HR[d][b][g] = sum_k H[d][b][k] * R[d][g][k] (+ Rb[d][g])
+// The bias of the recurrence weights is added unless B is null or none. HR
+// has type [num_directions, batch_size, num_gates*hidden_size], each
+// direction having its own buffers so that the directions of a bidirectional
+// operation can be computed concurrently.
+void emitRecurrentProjection(ConversionPatternRewriter &rewriter,
+    Location loc, Value H, Value R, Value B, Value directionIV,
+    int64_t rowBegin, int64_t rowEnd, Value HR);
+
 // Override the following methods when lowering an RNN operation:
 // - hasAllNoneOutput
 // - getActivationPack
@@ -91,7 +112,10 @@ struct ONNXRNNOpLowering : public ConversionPattern {
     int64_t sequenceDimSize = dimAt(rnnOp.X(), 0);
     auto direction = rnnOp.direction();
 
-    if (direction == FORWARD || direction == BIDIRECTIONAL) {
+    // Emit the recurrence of one direction. The direction index is a
+    // constant emitted in the sequence loop unless `directionIV` is given.
+    auto emitRecurrence = [&](bool reverse, A activation, Value directionIV,
+                              int64_t directionIndex) {
       BuildKrnlLoop sequenceLoops(rewriter, loc, 1);
       sequenceLoops.createDefineOp();
       sequenceLoops.pushBounds(0, sequenceDimSize);
@@ -100,40 +124,60 @@ struct ONNXRNNOpLowering : public ConversionPattern {
       auto ipSequenceLoops = rewriter.saveInsertionPoint();
       rewriter.setInsertionPointToStart(sequenceLoops.getIterateBlock());
       {
-        Value directionIV =
-            emitConstantOp(rewriter, loc, rewriter.getIndexType(), 0);
+        if (!directionIV)
+          directionIV = emitConstantOp(
+              rewriter, loc, rewriter.getIndexType(), directionIndex);
         Value sequenceIV = sequenceLoops.getInductionVar(0);
+        if (reverse) {
+          AffineMap reverseIVMap = AffineMap::get(1, 1,
+              rewriter.getAffineSymbolExpr(0) - rewriter.getAffineDimExpr(0) -
+                  1);
+          sequenceIV = rewriter.create<AffineApplyOp>(loc, reverseIVMap,
+              std::vector<Value>{sequenceIV,
+                  emitConstantOp(rewriter, loc, rewriter.getIndexType(),
+                      sequenceDimSize)});
+        }
         // Emit calculation for one RNN step.
         calculateState<RNNOp, S, A>(rewriter, loc, operandAdaptor, state,
-            activationForward, directionIV, sequenceIV);
+            activation, directionIV, sequenceIV);
       }
       rewriter.restoreInsertionPoint(ipSequenceLoops);
-    }
-
-    if (direction == REVERSE || direction == BIDIRECTIONAL) {
-      BuildKrnlLoop sequenceLoops(rewriter, loc, 1);
-      sequenceLoops.createDefineOp();
-      sequenceLoops.pushBounds(0, sequenceDimSize);
-      sequenceLoops.createIterateOp();
-
-      auto ipSequenceLoops = rewriter.saveInsertionPoint();
-      rewriter.setInsertionPointToStart(sequenceLoops.getIterateBlock());
+    };
+
+    if (direction == FORWARD) {
+      emitRecurrence(/*reverse=*/false, activationForward, nullptr, 0);
+    } else if (direction == REVERSE) {
+      emitRecurrence(/*reverse=*/true, activationReverse, nullptr, 0);
+    } else if (direction == BIDIRECTIONAL) {
+      // The two directions are independent: iterate over them with a parallel
+      // loop, whose first iteration computes the forward recurrence and
+      // second iteration the reverse one. The states are indexed by the
+      // induction variable of the loop rather than by constants, so that the
+      // dependence analysis sees that the iterations access disjoint
+      // elements. Each direction has its own projections of the hidden state
+      // (HR, and RH for GRU), which costs batch_size x GATES*hidden_size
+      // elements per projection. The directions run concurrently when the
+      // parallel loops run on the threads of the runtime, see --num-threads.
+      BuildKrnlLoop directionLoops(rewriter, loc, 1);
+      directionLoops.createDefineOp();
+      directionLoops.parallelize(0);
+      directionLoops.pushBounds(0, 2);
+      directionLoops.createIterateOp();
+
+      auto ipDirectionLoops = rewriter.saveInsertionPoint();
+      rewriter.setInsertionPointToStart(directionLoops.getIterateBlock());
       {
-        AffineMap reverseIVMap = AffineMap::get(1, 1,
-            rewriter.getAffineSymbolExpr(0) - rewriter.getAffineDimExpr(0) - 1);
-
-        Value directionIV = emitConstantOp(rewriter, loc,
-            rewriter.getIndexType(), (direction == REVERSE) ? 0 : 1);
-        Value reverseSequenceIV =
-            rewriter.create<AffineApplyOp>(loc, reverseIVMap,
-                std::vector<Value>{sequenceLoops.getInductionVar(0),
-                    emitConstantOp(rewriter, loc, rewriter.getIndexType(),
-                        sequenceDimSize)});
-        // Emit calculation for one RNN step.
-        calculateState<RNNOp, S, A>(rewriter, loc, operandAdaptor, state,
-            activationReverse, directionIV, reverseSequenceIV);
+        Value directionIV = directionLoops.getInductionVar(0);
+        IntegerSet isForward = IntegerSet::get(1, 0,
+            {rewriter.getAffineDimExpr(0)}, /*eqFlags=*/{true});
+        auto ifOp = rewriter.create<AffineIfOp>(loc, isForward,
+            ValueRange{directionIV}, /*withElseRegion=*/true);
+        rewriter.setInsertionPointToStart(ifOp.getThenBlock());
+        emitRecurrence(/*reverse=*/false, activationForward, directionIV, 0);
+        rewriter.setInsertionPointToStart(ifOp.getElseBlock());
+        emitRecurrence(/*reverse=*/true, activationReverse, directionIV, 1);
       }
-      rewriter.restoreInsertionPoint(ipSequenceLoops);
+      rewriter.restoreInsertionPoint(ipDirectionLoops);
     }
 
     std::vector<Value> outputs;
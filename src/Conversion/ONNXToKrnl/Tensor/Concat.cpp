@@ -12,6 +12,42 @@
 
 using namespace mlir;
 
+/// Replace the buffer of an input of a concatenation with a view of the
+/// result at the given offset, in elements, so that the operation producing
+/// the input writes it directly into the result. This requires the input to
+/// be a statically shaped buffer of the same block, deallocated at the end of
+/// the block, i.e. not returned by the function. Returns false, leaving the
+/// input unchanged, when it has to be copied.
+static bool placeInputInResult(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Value input, Value result, int64_t offset,
+    llvm::SmallPtrSetImpl<Operation *> &placedInputs) {
+  auto allocOp = input.getDefiningOp<AllocOp>();
+  if (!allocOp || allocOp.getOperation()->getBlock() != op->getBlock() ||
+      placedInputs.count(allocOp) || allocOp.alignment().hasValue())
+    return false;
+  auto inputType = allocOp.getType();
+  if (!inputType.hasStaticShape() || !inputType.getAffineMaps().empty())
+    return false;
+
+  DeallocOp deallocOp;
+  for (Operation *user : allocOp.getResult().getUsers())
+    if (auto dealloc = dyn_cast<DeallocOp>(user))
+      deallocOp = dealloc;
+  if (!deallocOp)
+    return false;
+
+  // The result is allocated at the beginning of the block, before any use of
+  // the input.
+  OpBuilder::InsertionGuard insertGuard(rewriter);
+  rewriter.setInsertionPointAfter(result.getDefiningOp());
+  Value view = rewriter.create<KrnlReshapeOp>(loc, inputType, result,
+      rewriter.getI64IntegerAttr(offset), ValueRange());
+  rewriter.eraseOp(deallocOp);
+  rewriter.replaceOp(allocOp, view);
+  placedInputs.insert(allocOp);
+  return true;
+}
+
 struct ONNXConcatOpLowering : public ConversionPattern {
   ONNXConcatOpLowering(MLIRContext *ctx)
       : ConversionPattern(mlir::ONNXConcatOp::getOperationName(), 1, ctx) {}
@@ -38,12 +74,31 @@ struct ONNXConcatOpLowering : public ConversionPattern {
       alloc = insertAllocAndDealloc(
           memRefType, loc, rewriter, insertDealloc, {resultOperand});
 
+    // When the dimensions before the axis are all 1, each input is a
+    // contiguous part of the result. The inputs computed in a buffer of their
+    // own are then computed directly into the result instead (see
+    // placeInputInResult).
+    bool concatInPlace = hasAllConstantDimensions(memRefType) &&
+                         memRefType.getAffineMaps().empty() &&
+                         llvm::all_of(resultShape.take_front(axis),
+                             [](int64_t dim) { return dim == 1; });
+    int64_t innerSize = 1;
+    for (int r = axis + 1; r < rank; ++r)
+      innerSize *= resultShape[r];
+    llvm::SmallPtrSet<Operation *, 4> placedInputs;
+
     // Creates loops, one for each input.
     int writeOffset = 0;
     for (int i = 0; i < inputNum; ++i) {
       OpBuilder::InsertionGuard insertGuard(rewriter);
       // Operand info.
       auto currShape = operands[i].getType().cast<MemRefType>().getShape();
+      if (concatInPlace &&
+          placeInputInResult(rewriter, loc, op, operands[i], alloc,
+              writeOffset * innerSize, placedInputs)) {
+        writeOffset += currShape[axis];
+        continue;
+      }
       // Create loop.
       BuildKrnlLoop inputLoops(rewriter, loc, rank);
       inputLoops.createDefineOp();
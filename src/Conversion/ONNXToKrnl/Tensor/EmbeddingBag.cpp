@@ -0,0 +1,142 @@
+//===----------- EmbeddingBag.cpp - Lowering EmbeddingBag Op --------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX EmbeddingBag Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+// Iterate from 0 to each of the bounds, with the outermost loop run in
+// parallel if requested. The insertion point is moved into the body of the
+// loops, and left unchanged if there is no bound.
+static SmallVector<Value, 4> emitBagLoops(ConversionPatternRewriter &rewriter,
+    Location loc, ArrayRef<int64_t> bounds, bool isParallel) {
+  if (bounds.empty())
+    return {};
+  BuildKrnlLoop loops(rewriter, loc, bounds.size());
+  loops.createDefineOp();
+  for (int64_t bound : bounds)
+    loops.pushBounds(0, bound);
+  if (isParallel)
+    loops.parallelize(0);
+  loops.createIterateOp();
+  rewriter.setInsertionPointToStart(loops.getIterateBlock());
+  auto ivs = loops.getAllInductionVar();
+  return SmallVector<Value, 4>(ivs.begin(), ivs.end());
+}
+
+// Accumulate the rows of each bag into its output row:
+//
+//   for j:                                  (parallel)
+//     for k: Y[j][k] = 0
+//     for b:
+//       i = indices[j][b]
+//       for k: Y[j][k] += data[i][k]
+//     for k: Y[j][k] /= bag                 (mean mode)
+//
+// so that the rows are read once from the table and the bags are never
+// materialized. The output rows stay in cache while they are accumulated.
+struct ONNXEmbeddingBagOpLowering : public ConversionPattern {
+  ONNXEmbeddingBagOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXEmbeddingBagOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    ONNXEmbeddingBagOpAdaptor operandAdaptor(operands);
+    auto embeddingBagOp = llvm::cast<ONNXEmbeddingBagOp>(op);
+    auto loc = op->getLoc();
+    Value data = operandAdaptor.data();
+    Value indices = operandAdaptor.indices();
+    auto dataType = data.getType().cast<MemRefType>();
+    auto indicesType = indices.getType().cast<MemRefType>();
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto elementType = memRefType.getElementType();
+    if (!hasAllConstantDimensions(dataType) ||
+        !hasAllConstantDimensions(indicesType) ||
+        !hasAllConstantDimensions(memRefType) ||
+        !elementType.isa<FloatType>())
+      return failure();
+
+    auto indicesShape = indicesType.getShape();
+    auto bagShape = indicesShape.drop_back();
+    auto rowShape = dataType.getShape().drop_front();
+    int64_t bagSize = indicesShape.back();
+    bool keepDims = embeddingBagOp.keepdims() == 1;
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+    Value zero = emitConstantOp(rewriter, loc, elementType, 0);
+    Value zeroIndex = emitConstantOp(rewriter, loc, rewriter.getIndexType(), 0);
+    Value tableSize = emitConstantOp(
+        rewriter, loc, rewriter.getIndexType(), dataType.getShape()[0]);
+
+    // The output indices of a row: the bag, the kept bag axis and the row.
+    auto getOutputIndices = [&](ArrayRef<Value> bagIVs,
+                                ArrayRef<Value> rowIVs) {
+      SmallVector<Value, 4> outputIndices(bagIVs.begin(), bagIVs.end());
+      if (keepDims)
+        outputIndices.emplace_back(zeroIndex);
+      outputIndices.append(rowIVs.begin(), rowIVs.end());
+      return outputIndices;
+    };
+
+    auto bagIVs = emitBagLoops(rewriter, loc, bagShape, /*isParallel=*/true);
+    {
+      OpBuilder::InsertionGuard guard(rewriter);
+      auto rowIVs =
+          emitBagLoops(rewriter, loc, rowShape, /*isParallel=*/false);
+      rewriter.create<AffineStoreOp>(
+          loc, zero, alloc, getOutputIndices(bagIVs, rowIVs));
+    }
+    {
+      OpBuilder::InsertionGuard guard(rewriter);
+      Value b = emitBagLoops(rewriter, loc, {bagSize}, /*isParallel=*/false)[0];
+      SmallVector<Value, 4> indexIndices(bagIVs.begin(), bagIVs.end());
+      indexIndices.emplace_back(b);
+      Value rawIndex = rewriter.create<IndexCastOp>(loc,
+          rewriter.create<AffineLoadOp>(loc, indices, indexIndices),
+          rewriter.getIndexType());
+      Value isNegative =
+          rewriter.create<CmpIOp>(loc, CmpIPredicate::slt, rawIndex, zeroIndex);
+      Value index = rewriter.create<SelectOp>(loc, isNegative,
+          rewriter.create<AddIOp>(loc, rawIndex, tableSize), rawIndex);
+
+      auto rowIVs =
+          emitBagLoops(rewriter, loc, rowShape, /*isParallel=*/false);
+      SmallVector<Value, 4> dataIndices = {index};
+      dataIndices.append(rowIVs.begin(), rowIVs.end());
+      auto outputIndices = getOutputIndices(bagIVs, rowIVs);
+      Value row = rewriter.create<LoadOp>(loc, data, dataIndices);
+      Value sum = rewriter.create<AffineLoadOp>(loc, alloc, outputIndices);
+      rewriter.create<AffineStoreOp>(loc,
+          rewriter.create<AddFOp>(loc, sum, row), alloc, outputIndices);
+    }
+    if (embeddingBagOp.mode() == "mean") {
+      OpBuilder::InsertionGuard guard(rewriter);
+      Value divisor = emitConstantOp(rewriter, loc, elementType, bagSize);
+      auto rowIVs =
+          emitBagLoops(rewriter, loc, rowShape, /*isParallel=*/false);
+      auto outputIndices = getOutputIndices(bagIVs, rowIVs);
+      Value sum = rewriter.create<AffineLoadOp>(loc, alloc, outputIndices);
+      rewriter.create<AffineStoreOp>(loc,
+          rewriter.create<DivFOp>(loc, sum, divisor), alloc, outputIndices);
+    }
+
+    rewriter.setInsertionPoint(op);
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+void populateLoweringONNXEmbeddingBagOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXEmbeddingBagOpLowering>(ctx);
+}
@@ -12,6 +12,97 @@
 
 using namespace mlir;
 
+// Rows shorter than a cache line are gathered element by element.
+static const int64_t kMinGatherRowBytes = 64;
+// Number of iterations ahead of the current one whose row is prefetched.
+static const int64_t kGatherPrefetchDistance = 4;
+
+/// Return true if the gather selects contiguous rows of the data, i.e. the
+/// dimensions before the axis are all 1, as in embedding lookups where the
+/// axis is 0, and the rows are long enough to be copied with a memcpy.
+static bool isRowGather(Value data, Value indices, int64_t axis) {
+  auto dataType = data.getType().cast<MemRefType>();
+  auto indicesType = indices.getType().cast<MemRefType>();
+  if (!dataType.hasStaticShape() || !indicesType.hasStaticShape() ||
+      !dataType.getAffineMaps().empty() ||
+      !indicesType.getAffineMaps().empty())
+    return false;
+  auto dataShape = dataType.getShape();
+  if (llvm::any_of(
+          dataShape.take_front(axis), [](int64_t dim) { return dim != 1; }))
+    return false;
+  int64_t rowSize = 1;
+  for (int64_t i = axis + 1; i < dataShape.size(); ++i)
+    rowSize *= dataShape[i];
+  return rowSize * getMemRefEltSizeInBytes(dataType) >= kMinGatherRowBytes;
+}
+
+/// Gather the rows of the data selected by the indices with one krnl.memcpy
+/// per index, prefetching the row used a few iterations later.
+static void emitRowGather(ConversionPatternRewriter &rewriter, Location loc,
+    Value data, Value indices, Value alloc, int64_t axis) {
+  auto dataType = data.getType().cast<MemRefType>();
+  auto dataShape = dataType.getShape();
+  auto indicesType = indices.getType().cast<MemRefType>();
+  int64_t rowSize = 1;
+  for (int64_t i = axis + 1; i < dataShape.size(); ++i)
+    rowSize *= dataShape[i];
+  int64_t numIndices = indicesType.getNumElements();
+
+  // Iterate over the indices as a one-dimensional MemRef.
+  auto flatIndicesType =
+      MemRefType::get({numIndices}, indicesType.getElementType());
+  Value flatIndices =
+      rewriter.create<KrnlReshapeOp>(loc, flatIndicesType, indices);
+  Value rowBytes = emitConstantOp(rewriter, loc, rewriter.getIntegerType(64),
+      rowSize * getMemRefEltSizeInBytes(dataType));
+  Value rowSizeVal = emitConstantOp(rewriter, loc, rewriter.getIndexType(),
+      rowSize);
+  Value zero = emitConstantOp(rewriter, loc, rewriter.getIndexType(), 0);
+  Value axisSize =
+      emitConstantOp(rewriter, loc, rewriter.getIndexType(), dataShape[axis]);
+
+  BuildKrnlLoop loop(rewriter, loc, 1);
+  loop.createDefineOp();
+  loop.pushBounds(0, numIndices);
+  loop.parallelize(0);
+  loop.createIterateOp();
+  rewriter.setInsertionPointToStart(loop.getIterateBlock());
+  Value iv = loop.getInductionVar(0);
+
+  // Load an index, adding the size of the axis when it is negative.
+  auto loadIndex = [&](Value position) {
+    Value rawIndex = rewriter.create<IndexCastOp>(loc,
+        rewriter.create<AffineLoadOp>(loc, flatIndices, position),
+        rewriter.getIndexType());
+    Value isNegative =
+        rewriter.create<CmpIOp>(loc, CmpIPredicate::slt, rawIndex, zero);
+    Value negativeIndex = rewriter.create<AddIOp>(loc, rawIndex, axisSize);
+    return rewriter.create<SelectOp>(loc, isNegative, negativeIndex, rawIndex)
+        .getResult();
+  };
+
+  // Prefetch the first line of an upcoming row, while the current one is
+  // copied. The last iterations prefetch the last row again.
+  auto d0 = rewriter.getAffineDimExpr(0);
+  Value nextPosition = rewriter.create<AffineMinOp>(loc,
+      AffineMap::get(1, 0,
+          {d0 + kGatherPrefetchDistance,
+              rewriter.getAffineConstantExpr(numIndices - 1)},
+          rewriter.getContext()),
+      ValueRange{iv});
+  SmallVector<Value, 4> prefetchIndices(dataShape.size(), zero);
+  prefetchIndices[axis] = loadIndex(nextPosition);
+  rewriter.create<PrefetchOp>(loc, data, prefetchIndices, /*isWrite=*/false,
+      /*localityHint=*/3, /*isDataCache=*/true);
+
+  Value srcOffset = rewriter.create<MulIOp>(loc, loadIndex(iv), rowSizeVal);
+  Value destOffset = rewriter.create<AffineApplyOp>(
+      loc, AffineMap::get(1, 0, d0 * rowSize), ValueRange{iv});
+  emitMemcpy(
+      rewriter, loc, alloc, data, rowBytes, ValueRange{destOffset, srcOffset});
+}
+
 struct ONNXGatherOpLowering : public ConversionPattern {
   ONNXGatherOpLowering(MLIRContext *ctx)
       : ConversionPattern(mlir::ONNXGatherOp::getOperationName(), 1, ctx) {}
@@ -43,6 +134,14 @@ struct ONNXGatherOpLowering : public ConversionPattern {
           for kk in ndindex(Nk):
             out[ii + jj + kk] = data[ii + (indices[jj],) + kk]
     */
+    if (isRowGather(data, indices, axisIndex)) {
+      Value alloc = insertAllocAndDealloc(
+          outputMemRefType, loc, rewriter, checkInsertDealloc(op));
+      emitRowGather(rewriter, loc, data, indices, alloc, axisIndex);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+
     // Define loops and iteration trip counts (equivalent to size of output)
     std::vector<Value> originalLoops;
     defineLoops(rewriter, loc, originalLoops, outputRank);
@@ -0,0 +1,142 @@
+//===------- ImagePreprocess.cpp - Lowering ImagePreprocess Op ------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX ImagePreprocess Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+// Suffix of the names of the Krnl globals holding the channel tables.
+static int64_t preprocessTableID = 0;
+
+static Value emitChannelTable(ConversionPatternRewriter &rewriter,
+    Location loc, ArrayRef<float> values) {
+  int64_t size = values.size();
+  auto elementType = rewriter.getF32Type();
+  auto tensorType = RankedTensorType::get({size}, elementType);
+  return rewriter.create<KrnlGlobalOp>(loc,
+      MemRefType::get({size}, elementType),
+      /*shape=*/rewriter.getI64ArrayAttr(size),
+      /*name=*/
+      rewriter.getStringAttr(
+          "preprocess_" + std::to_string(preprocessTableID++)),
+      /*value=*/DenseElementsAttr::get(tensorType, values),
+      /*offset=*/nullptr);
+}
+
+// Return the value of channel c of a per-channel scale or shift: a constant
+// if all the channels have the same value, a load from a table otherwise.
+static Value emitChannelValue(ConversionPatternRewriter &rewriter,
+    Location loc, Value table, ArrayRef<float> values, Value c) {
+  if (!table)
+    return emitConstantOp(rewriter, loc, rewriter.getF32Type(), values[0]);
+  return rewriter.create<AffineLoadOp>(loc, table, c);
+}
+
+// Convert the image in a single loop nest over the elements of the output:
+//
+//   for n, c, h, w:                         (n parallel)
+//     Y[n][c][h][w] = float(X[n][h][w][c]) * scale[c] + shift[c]
+//
+// with scale = 1 / std and shift = -mean / std, computed at compile time. The
+// multiplication and the addition are omitted when they are the identity,
+// e.g. when the normalization is folded into the next convolution.
+struct ONNXImagePreprocessOpLowering : public ConversionPattern {
+  ONNXImagePreprocessOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXImagePreprocessOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    ONNXImagePreprocessOpAdaptor operandAdaptor(operands);
+    auto preprocessOp = llvm::cast<ONNXImagePreprocessOp>(op);
+    auto loc = op->getLoc();
+    Value input = operandAdaptor.X();
+    auto inputType = input.getType().cast<MemRefType>();
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    auto inputElementType = inputType.getElementType();
+    auto elementType = memRefType.getElementType();
+    bool isNHWC = preprocessOp.layout() == "NHWC";
+
+    // Only the batch dimension, shared by the input and the output, may be
+    // dynamic.
+    if (inputType.getRank() != 4 || memRefType.getRank() != 4)
+      return failure();
+    for (int64_t i = 1; i < 4; ++i)
+      if (inputType.isDynamicDim(i) || memRefType.isDynamicDim(i))
+        return failure();
+    int64_t numChannels = memRefType.getDimSize(1);
+
+    SmallVector<float, 4> scales, shifts;
+    bool isIdentity = true;
+    for (int64_t c = 0; c < numChannels; ++c) {
+      auto channelValue = [&](ArrayAttr values) -> float {
+        auto value = values[values.size() == 1 ? 0 : c];
+        return value.cast<FloatAttr>().getValueAsDouble();
+      };
+      float scale = 1 / channelValue(preprocessOp.std());
+      float shift = -channelValue(preprocessOp.mean()) * scale;
+      scales.emplace_back(scale);
+      shifts.emplace_back(shift);
+      isIdentity &= scale == 1 && shift == 0;
+    }
+    bool isUniform =
+        llvm::all_of(scales, [&](float s) { return s == scales[0]; }) &&
+        llvm::all_of(shifts, [&](float s) { return s == shifts[0]; });
+    Value scaleTable, shiftTable;
+    if (!isIdentity && !isUniform) {
+      scaleTable = emitChannelTable(rewriter, loc, scales);
+      shiftTable = emitChannelTable(rewriter, loc, shifts);
+    }
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc = insertAllocAndDealloc(
+        memRefType, loc, rewriter, insertDealloc, {input});
+
+    BuildKrnlLoop loops(rewriter, loc, 4);
+    loops.createDefineOp();
+    for (int64_t i = 0; i < 4; ++i)
+      loops.pushBounds(0, alloc, i);
+    loops.parallelize(0);
+    loops.createIterateOp();
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    Value n = loops.getInductionVar(0), c = loops.getInductionVar(1),
+          h = loops.getInductionVar(2), w = loops.getInductionVar(3);
+
+    SmallVector<Value, 4> inputIndices = {n, c, h, w};
+    if (isNHWC)
+      inputIndices = {n, h, w, c};
+    Value value = rewriter.create<AffineLoadOp>(loc, input, inputIndices);
+    if (inputElementType.isa<IntegerType>()) {
+      if (preprocessOp.is_unsigned())
+        value = rewriter.create<UIToFPOp>(loc, value, elementType);
+      else
+        value = rewriter.create<SIToFPOp>(loc, value, elementType);
+    } else {
+      value = emitConvertFloat(rewriter, loc, value, elementType);
+    }
+    if (!isIdentity) {
+      Value scale = emitChannelValue(rewriter, loc, scaleTable, scales, c);
+      Value shift = emitChannelValue(rewriter, loc, shiftTable, shifts, c);
+      value = rewriter.create<AddFOp>(
+          loc, rewriter.create<MulFOp>(loc, value, scale), shift);
+    }
+    rewriter.create<AffineStoreOp>(
+        loc, value, alloc, loops.getAllInductionVar());
+
+    rewriter.setInsertionPoint(op);
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+void populateLoweringONNXImagePreprocessOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXImagePreprocessOpLowering>(ctx);
+}
@@ -0,0 +1,79 @@
+//===----------- LayoutTransform.cpp - Lowering LayoutTransform Op --------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX LayoutTransform Operator to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+struct ONNXLayoutTransformOpLowering : public ConversionPattern {
+  ONNXLayoutTransformOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXLayoutTransformOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    ONNXLayoutTransformOpAdaptor operandAdaptor(operands);
+    auto transformOp = llvm::cast<ONNXLayoutTransformOp>(op);
+    auto loc = op->getLoc();
+    auto memRefType = convertToMemRefType(*op->result_type_begin());
+    if (!hasAllConstantDimensions(memRefType))
+      return failure();
+    int64_t b = transformOp.block_size();
+    auto layout = transformOp.target_layout();
+
+    // Map the output indices to the input indices.
+    auto d = [&](unsigned pos) { return rewriter.getAffineDimExpr(pos); };
+    SmallVector<AffineExpr, 4> dataExprs;
+    if (layout == ONNXLayoutTransformOp::getNCHWcLayoutName()) {
+      // out[n][cb][h][w][ci] = in[n][cb * b + ci][h][w]
+      dataExprs = {d(0), d(1) * b + d(4), d(2), d(3)};
+    } else if (layout == ONNXLayoutTransformOp::getNCHWLayoutName()) {
+      // out[n][c][h][w] = in[n][c floordiv b][h][w][c mod b]
+      dataExprs = {d(0), d(1).floorDiv(b), d(2), d(3), d(1) % b};
+    } else if (layout == ONNXLayoutTransformOp::getOIHWioLayoutName()) {
+      // out[mb][cb][kh][kw][ci][mi] = in[mb * b + mi][cb * b + ci][kh][kw]
+      dataExprs = {d(0) * b + d(5), d(1) * b + d(4), d(2), d(3)};
+    } else {
+      return op->emitError("unknown layout: ") << layout;
+    }
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+    Value data = operandAdaptor.data();
+
+    // Iterate over the output, the outermost loop writing disjoint blocks.
+    auto outputShape = memRefType.getShape();
+    int64_t rank = outputShape.size();
+    BuildKrnlLoop outputLoops(rewriter, loc, rank);
+    outputLoops.createDefineOp();
+    for (int64_t i = 0; i < rank; ++i)
+      outputLoops.pushBounds(0, outputShape[i]);
+    outputLoops.parallelize(0);
+    outputLoops.createIterateOp();
+    rewriter.setInsertionPointToStart(outputLoops.getIterateBlock());
+
+    AffineMap dataMap =
+        AffineMap::get(rank, 0, dataExprs, rewriter.getContext());
+    Value loadData = rewriter.create<AffineLoadOp>(
+        loc, data, dataMap, outputLoops.getAllInductionVar());
+    rewriter.create<AffineStoreOp>(
+        loc, loadData, alloc, outputLoops.getAllInductionVar());
+
+    rewriter.replaceOp(op, alloc);
+
+    return success();
+  }
+};
+
+void populateLoweringONNXLayoutTransformOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXLayoutTransformOpLowering>(ctx);
+}
@@ -58,55 +58,17 @@ struct ONNXPadOpLowering : public ConversionPattern {
     for (int i = 0; i < rank * 2; ++i)
       pads[i] = (*padsIt++).cast<IntegerAttr>().getInt();
 
+    if (llvm::any_of(pads, [](int64_t pad) { return pad < 0; }))
+      return emitError(loc, "Pad: unsupported negative pads");
+
     // get the padding value
     auto valueAttr = (*constantValAttr.getValues<FloatAttr>().begin());
 
-    // Iterate over the loop nest using the output shape.
-    BuildKrnlLoop padLoops(rewriter, loc, rank);
-    padLoops.createDefineOp();
-    for (int i = 0; i < rank; ++i)
-      padLoops.pushBounds(0, alloc, i);
-    padLoops.createIterateOp();
-
-    // Iterate over the loop nest using the input shape.
-    BuildKrnlLoop valueLoops(rewriter, loc, rank);
-    valueLoops.createDefineOp();
-    for (int i = 0; i < rank; ++i)
-      valueLoops.pushBounds(0, operandAdaptor.data(), i);
-    valueLoops.createIterateOp();
-
-    // Copy the input data into the output.
-    rewriter.setInsertionPointToStart(valueLoops.getIterateBlock());
-
-    SmallVector<Value, 4> inLoopIVs;
-    for (int i = 0; i < rank; ++i)
-      inLoopIVs.emplace_back(valueLoops.getInductionVar(i));
-
-    SmallVector<Value, 4> outLoopIVs;
-    for (int i = 0; i < rank; ++i) {
-      // Calculate the index for the load and store.
-      if (pads[i] == 0) {
-        outLoopIVs.emplace_back(valueLoops.getInductionVar(i));
-      } else {
-        AffineMap indexWithOffsetMap =
-            AffineMap::get(1, 0, rewriter.getAffineDimExpr(0) + pads[i]);
-        Value outIV = rewriter.create<AffineApplyOp>(loc, indexWithOffsetMap,
-            ArrayRef<Value>{valueLoops.getInductionVar(i)});
-        outLoopIVs.emplace_back(outIV);
-      }
-    }
-
-    auto originValue =
-        rewriter.create<AffineLoadOp>(loc, operandAdaptor.data(), inLoopIVs);
-    rewriter.create<AffineStoreOp>(loc, originValue, alloc, outLoopIVs);
-    rewriter.setInsertionPointToStart(padLoops.getIterateBlock());
-
-    SmallVector<Value, 4> outLoopIVs1;
-    for (int i = 0; i < rank; ++i)
-      outLoopIVs1.emplace_back(padLoops.getInductionVar(i));
-
-    auto paddingValue = rewriter.create<ConstantOp>(loc, valueAttr);
-    rewriter.create<AffineStoreOp>(loc, paddingValue, alloc, outLoopIVs1);
+    // Fill the borders and copy the data into the interior.
+    SmallVector<int64_t, 4> padsBegin(pads.begin(), pads.begin() + rank);
+    Value paddingValue = rewriter.create<ConstantOp>(loc, valueAttr);
+    emitConstantPadding(rewriter, loc, operandAdaptor.data(), alloc,
+        padsBegin, paddingValue);
 
     // Replace the original op with the generated code.
     rewriter.replaceOp(op, alloc);
@@ -28,6 +28,14 @@ struct ONNXReshapeOpLowering : public ConversionPattern {
     auto memRefShape = memRefType.getShape();
     Value alloc;
 
+    // A reshape of a contiguous MemRef is a view of its buffer.
+    bool reshapeInPlace = canReshapeInPlace(data, op, memRefType);
+    if (reshapeInPlace && hasAllConstantDimensions(memRefType)) {
+      Value view = rewriter.create<KrnlReshapeOp>(loc, memRefType, data);
+      rewriter.replaceOp(op, view);
+      return success();
+    }
+
     // Compute size in bytes using the input tensor.
     Value tensorSize = emitConstantOp(rewriter, loc,
         rewriter.getIntegerType(64), getMemRefEltSizeInBytes(memRefType));
@@ -123,6 +131,12 @@ struct ONNXReshapeOpLowering : public ConversionPattern {
         allocOperands.push_back(rewriter.create<IndexCastOp>(
             loc, loadedVal, rewriter.getIndexType()));
       }
+      if (reshapeInPlace) {
+        Value view = rewriter.create<KrnlReshapeOp>(
+            loc, memRefType, data, allocOperands);
+        rewriter.replaceOp(op, view);
+        return success();
+      }
       AllocOp allocateMemref =
           rewriter.create<AllocOp>(loc, memRefType, allocOperands);
 
@@ -137,7 +151,7 @@ struct ONNXReshapeOpLowering : public ConversionPattern {
       alloc = allocateMemref;
     }
 
-    rewriter.create<KrnlMemcpyOp>(loc, alloc, data, tensorSize);
+    emitMemcpy(rewriter, loc, alloc, data, tensorSize);
     rewriter.replaceOp(op, alloc);
 
     return success();
@@ -0,0 +1,321 @@
+//===------------- Resize.cpp - Lowering Resize and Upsample Ops ----------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX Resize and Upsample Operators to Krnl dialect.
+//
+//===----------------------------------------------------------------------===//
+
+#include <cmath>
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+// Suffix of the names of the Krnl globals holding the sampling tables.
+static int64_t resizeTableID = 0;
+
+namespace {
+// The sampling of an axis of the input by the output: output index o reads
+// the input indices lo[o] and hi[o] with the weights 1 - weights[o] and
+// weights[o], or lo[o] only in nearest mode.
+struct ResizeAxis {
+  SmallVector<int64_t, 16> lo, hi;
+  SmallVector<float, 16> weights;
+  bool isIdentity = true;
+};
+} // namespace
+
+// Read the float values of a constant, either an ONNX constant or a constant
+// already lowered to a Krnl global.
+static bool getConstantFloats(Value value, SmallVectorImpl<float> &values) {
+  Attribute attr;
+  Operation *defOp = value.getDefiningOp();
+  if (auto constantOp = dyn_cast_or_null<ONNXConstantOp>(defOp))
+    attr = constantOp.valueAttr();
+  else if (auto globalOp = dyn_cast_or_null<KrnlGlobalOp>(defOp))
+    attr = globalOp.value().getValueOr(Attribute());
+  auto denseAttr = attr.dyn_cast_or_null<DenseElementsAttr>();
+  if (!denseAttr)
+    return false;
+  for (auto value : denseAttr.getValues<APFloat>())
+    values.emplace_back(value.convertToFloat());
+  return true;
+}
+
+// Map an output index to the input coordinate it samples, with the float
+// arithmetic of the ONNX reference implementation.
+static float getInputCoordinate(StringRef mode, int64_t o, int64_t inputSize,
+    int64_t outputSize, float scale) {
+  if (mode == "asymmetric")
+    return o / scale;
+  if (mode == "align_corners")
+    return outputSize == 1 ? 0
+                           : o * (inputSize - 1) / float(outputSize - 1);
+  if (mode == "pytorch_half_pixel")
+    return outputSize > 1 ? (o + 0.5f) / scale - 0.5f : 0;
+  if (mode == "tf_half_pixel_for_nn")
+    return (o + 0.5f) / scale;
+  // half_pixel
+  return (o + 0.5f) / scale - 0.5f;
+}
+
+static int64_t roundToNearest(StringRef mode, float x) {
+  if (mode == "floor")
+    return std::floor(x);
+  if (mode == "ceil")
+    return std::ceil(x);
+  float x0 = std::floor(x);
+  if (x - x0 == 0.5f)
+    return mode == "round_prefer_ceil" ? x0 + 1 : x0;
+  return std::round(x);
+}
+
+// Compute the sampling table of an axis once at compile time, so that the
+// kernels do not divide floats for each element.
+static ResizeAxis getResizeAxis(bool isLinear, StringRef coordinateMode,
+    StringRef nearestMode, int64_t inputSize, int64_t outputSize,
+    float scale) {
+  ResizeAxis axis;
+  axis.isIdentity = inputSize == outputSize;
+  for (int64_t o = 0; o < outputSize; ++o) {
+    float x =
+        getInputCoordinate(coordinateMode, o, inputSize, outputSize, scale);
+    int64_t lo, hi;
+    float weight = 0;
+    if (isLinear) {
+      x = std::min(std::max(x, 0.0f), float(inputSize - 1));
+      lo = int64_t(x);
+      hi = std::min(lo + 1, inputSize - 1);
+      weight = x - lo;
+    } else {
+      lo = hi = std::min(std::max(roundToNearest(nearestMode, x), int64_t(0)),
+          inputSize - 1);
+    }
+    axis.lo.emplace_back(lo);
+    axis.hi.emplace_back(hi);
+    axis.weights.emplace_back(weight);
+    axis.isIdentity &= lo == o && weight == 0;
+  }
+  return axis;
+}
+
+template <typename T>
+static Value emitTable(ConversionPatternRewriter &rewriter, Location loc,
+    Type elementType, ArrayRef<T> values) {
+  int64_t size = values.size();
+  auto tensorType = RankedTensorType::get({size}, elementType);
+  return rewriter.create<KrnlGlobalOp>(loc,
+      MemRefType::get({size}, elementType),
+      /*shape=*/rewriter.getI64ArrayAttr(size),
+      /*name=*/
+      rewriter.getStringAttr("resize_" + std::to_string(resizeTableID++)),
+      /*value=*/DenseElementsAttr::get(tensorType, values),
+      /*offset=*/nullptr);
+}
+
+static Value emitIndexTable(ConversionPatternRewriter &rewriter, Location loc,
+    ArrayRef<int64_t> values) {
+  return emitTable(rewriter, loc, rewriter.getIntegerType(64), values);
+}
+
+static Value loadIndex(ConversionPatternRewriter &rewriter, Location loc,
+    Value table, Value iv) {
+  return rewriter.create<IndexCastOp>(loc,
+      rewriter.create<AffineLoadOp>(loc, table, iv), rewriter.getIndexType());
+}
+
+// Iterate over the elements of a MemRef of static shape, with the loops of
+// the two outermost dimensions, e.g. the batch and the channels, run in
+// parallel. The insertion point is moved into the body of the loops.
+static SmallVector<Value, 4> emitResizeLoops(
+    ConversionPatternRewriter &rewriter, Location loc, Value memRef) {
+  int64_t rank = memRef.getType().cast<MemRefType>().getRank();
+  BuildKrnlLoop loops(rewriter, loc, rank);
+  loops.createDefineOp();
+  for (int64_t i = 0; i < rank; ++i)
+    loops.pushBounds(0, memRef, i);
+  for (int64_t i = 0; i < std::min<int64_t>(rank - 1, 2); ++i)
+    loops.parallelize(i);
+  loops.createIterateOp();
+  rewriter.setInsertionPointToStart(loops.getIterateBlock());
+  auto ivs = loops.getAllInductionVar();
+  return SmallVector<Value, 4>(ivs.begin(), ivs.end());
+}
+
+// Resize the input, of static shape, to the static shape of the result of op.
+//
+// In nearest mode, each output element is gathered through the index tables
+// of the resized axes:
+//
+//   for n, c, o1, o2:                       (n and c parallel)
+//     Y[n][c][o1][o2] = X[n][c][lo1[o1]][lo2[o2]]
+//
+// In linear mode, the interpolation is separable: the resized axes are
+// interpolated one at a time into intermediate buffers, e.g.
+//
+//   for n, c, o1, i2:
+//     T[n][c][o1][i2] = X[n][c][lo1[o1]][i2] + w1[o1] *
+//                       (X[n][c][hi1[o1]][i2] - X[n][c][lo1[o1]][i2])
+//   for n, c, o1, o2:
+//     Y[n][c][o1][o2] = T[n][c][o1][lo2[o2]] + w2[o2] *
+//                       (T[n][c][o1][hi2[o2]] - T[n][c][o1][lo2[o2]])
+//
+// which takes two loads per element and axis instead of 2^axes loads per
+// element. The weights of the inner loop of all but the innermost axis are
+// invariant, so that these loops are vectorized. The axes are processed from
+// the most shrunk to the most enlarged to keep the intermediate buffers small.
+static LogicalResult emitResize(ConversionPatternRewriter &rewriter,
+    Operation *op, Value input, ArrayRef<float> scales, bool isLinear,
+    StringRef coordinateMode, StringRef nearestMode) {
+  auto loc = op->getLoc();
+  auto memRefType = convertToMemRefType(*op->result_type_begin());
+  auto inputType = input.getType().cast<MemRefType>();
+  auto elementType = memRefType.getElementType();
+  int64_t rank = memRefType.getRank();
+  if (rank == 0 || !hasAllConstantDimensions(memRefType) ||
+      !hasAllConstantDimensions(inputType))
+    return failure();
+  if (isLinear && !elementType.isa<FloatType>())
+    return failure();
+  if (!scales.empty() && int64_t(scales.size()) != rank)
+    return failure();
+
+  SmallVector<ResizeAxis, 4> axes;
+  SmallVector<int64_t, 4> resizedAxes;
+  for (int64_t i = 0; i < rank; ++i) {
+    int64_t inputSize = inputType.getShape()[i];
+    int64_t outputSize = memRefType.getShape()[i];
+    float scale = scales.empty() ? float(outputSize) / inputSize : scales[i];
+    axes.emplace_back(getResizeAxis(isLinear, coordinateMode, nearestMode,
+        inputSize, outputSize, scale));
+    if (!axes.back().isIdentity)
+      resizedAxes.emplace_back(i);
+  }
+
+  bool insertDealloc = checkInsertDealloc(op);
+  Value alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
+
+  if (!isLinear || resizedAxes.empty()) {
+    SmallVector<Value, 4> tables(rank);
+    for (int64_t i : resizedAxes)
+      tables[i] = emitIndexTable(rewriter, loc, axes[i].lo);
+    auto ivs = emitResizeLoops(rewriter, loc, alloc);
+    SmallVector<Value, 4> inputIndices(ivs.begin(), ivs.end());
+    for (int64_t i : resizedAxes)
+      inputIndices[i] = loadIndex(rewriter, loc, tables[i], ivs[i]);
+    Value value = rewriter.create<LoadOp>(loc, input, inputIndices);
+    rewriter.create<AffineStoreOp>(loc, value, alloc, ivs);
+    rewriter.setInsertionPoint(op);
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+
+  std::stable_sort(resizedAxes.begin(), resizedAxes.end(),
+      [&](int64_t lhs, int64_t rhs) {
+        return memRefType.getShape()[lhs] * inputType.getShape()[rhs] <
+               memRefType.getShape()[rhs] * inputType.getShape()[lhs];
+      });
+
+  // The intermediate buffers hold the accumulation type of the elements.
+  auto accType = getAccumulationType(elementType);
+  SmallVector<int64_t, 4> shape(inputType.getShape().begin(),
+      inputType.getShape().end());
+  Value src = input;
+  for (unsigned pass = 0; pass < resizedAxes.size(); ++pass) {
+    int64_t axis = resizedAxes[pass];
+    bool isLastPass = pass + 1 == resizedAxes.size();
+    shape[axis] = memRefType.getShape()[axis];
+    Value dst = isLastPass ? alloc
+                           : insertAllocAndDealloc(
+                                 MemRefType::get(shape, accType), loc,
+                                 rewriter, /*insertDealloc=*/true);
+
+    Value loTable = emitIndexTable(rewriter, loc, axes[axis].lo);
+    Value hiTable = emitIndexTable(rewriter, loc, axes[axis].hi);
+    Value weightTable = emitTable(rewriter, loc, rewriter.getF32Type(),
+        ArrayRef<float>(axes[axis].weights));
+    auto ivs = emitResizeLoops(rewriter, loc, dst);
+    SmallVector<Value, 4> loIndices(ivs.begin(), ivs.end());
+    SmallVector<Value, 4> hiIndices(ivs.begin(), ivs.end());
+    loIndices[axis] = loadIndex(rewriter, loc, loTable, ivs[axis]);
+    hiIndices[axis] = loadIndex(rewriter, loc, hiTable, ivs[axis]);
+    Value weight = emitConvertFloat(rewriter, loc,
+        rewriter.create<AffineLoadOp>(loc, weightTable, ivs[axis]), accType);
+    Value lo = emitConvertFloat(rewriter, loc,
+        rewriter.create<LoadOp>(loc, src, loIndices), accType);
+    Value hi = emitConvertFloat(rewriter, loc,
+        rewriter.create<LoadOp>(loc, src, hiIndices), accType);
+    Value result = rewriter.create<AddFOp>(loc, lo,
+        rewriter.create<MulFOp>(
+            loc, weight, rewriter.create<SubFOp>(loc, hi, lo)));
+    if (isLastPass)
+      result = emitConvertFloat(rewriter, loc, result, elementType);
+    rewriter.create<AffineStoreOp>(loc, result, dst, ivs);
+    rewriter.setInsertionPoint(op);
+    src = dst;
+  }
+
+  rewriter.replaceOp(op, alloc);
+  return success();
+}
+
+struct ONNXResizeOpLowering : public ConversionPattern {
+  ONNXResizeOpLowering(MLIRContext *ctx)
+      : ConversionPattern(mlir::ONNXResizeOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    ONNXResizeOpAdaptor operandAdaptor(operands);
+    auto resizeOp = llvm::cast<ONNXResizeOp>(op);
+
+    // The region of interest of tf_crop_and_resize and the cubic mode are not
+    // supported.
+    StringRef mode = resizeOp.mode();
+    StringRef coordinateMode = resizeOp.coordinate_transformation_mode();
+    if ((mode != "nearest" && mode != "linear") ||
+        coordinateMode == "tf_crop_and_resize")
+      return failure();
+
+    // The scales are only read with no sizes, otherwise the scale of each
+    // axis is the ratio of its output and input sizes.
+    SmallVector<float, 4> scales;
+    if (resizeOp.sizes().getType().isa<NoneType>() &&
+        !getConstantFloats(resizeOp.scales(), scales) &&
+        !getConstantFloats(operandAdaptor.scales(), scales))
+      return failure();
+
+    return emitResize(rewriter, op, operandAdaptor.X(), scales,
+        mode == "linear", coordinateMode, resizeOp.nearest_mode());
+  }
+};
+
+struct ONNXUpsampleOpLowering : public ConversionPattern {
+  ONNXUpsampleOpLowering(MLIRContext *ctx)
+      : ConversionPattern(mlir::ONNXUpsampleOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    ONNXUpsampleOpAdaptor operandAdaptor(operands);
+    auto upsampleOp = llvm::cast<ONNXUpsampleOp>(op);
+
+    StringRef mode = upsampleOp.mode();
+    if (mode != "nearest" && mode != "linear")
+      return failure();
+    SmallVector<float, 4> scales;
+    if (!getConstantFloats(upsampleOp.scales(), scales) &&
+        !getConstantFloats(operandAdaptor.scales(), scales))
+      return failure();
+
+    // Upsample samples the input at o / scale, rounded down in nearest mode.
+    return emitResize(rewriter, op, operandAdaptor.X(), scales,
+        mode == "linear", "asymmetric", "floor");
+  }
+};
+
+void populateLoweringONNXResizeOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXResizeOpLowering, ONNXUpsampleOpLowering>(ctx);
+}
@@ -0,0 +1,237 @@
+//===---------------- Scatter.cpp - Lowering Scatter Ops ------------------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file lowers the ONNX ScatterElements and ScatterND Operators to Krnl
+// dialect. The output is the buffer of the data when the data has no other
+// use, and a copy of the data made with a single krnl.memcpy otherwise. The
+// updates are then stored at their indices, in parallel when they cannot
+// store to the same element.
+//
+//===----------------------------------------------------------------------===//
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+
+using namespace mlir;
+
+// Slices of ScatterND shorter than a cache line are stored element by
+// element.
+static const int64_t kMinScatterRowBytes = 64;
+
+/// Return a dimension of a MemRef as an index.
+static Value emitDim(
+    ConversionPatternRewriter &rewriter, Location loc, Value memRef, int dim) {
+  auto shape = memRef.getType().cast<MemRefType>().getShape();
+  if (shape[dim] != -1)
+    return emitConstantOp(rewriter, loc, rewriter.getIndexType(), shape[dim]);
+  return rewriter.create<DimOp>(loc, memRef, dim);
+}
+
+/// Load an index, adding the size of its dimension when it is negative.
+static Value emitLoadIndex(ConversionPatternRewriter &rewriter, Location loc,
+    Value indices, ArrayRef<Value> position, Value dimSize) {
+  Value zero = emitConstantOp(rewriter, loc, rewriter.getIndexType(), 0);
+  Value rawIndex = rewriter.create<IndexCastOp>(loc,
+      rewriter.create<LoadOp>(loc, indices, position),
+      rewriter.getIndexType());
+  Value isNegative =
+      rewriter.create<CmpIOp>(loc, CmpIPredicate::slt, rawIndex, zero);
+  Value negativeIndex = rewriter.create<AddIOp>(loc, rawIndex, dimSize);
+  return rewriter.create<SelectOp>(loc, isNegative, negativeIndex, rawIndex);
+}
+
+/// Return the buffer of the output of a scatter: the buffer of the data if
+/// the data has no other use, a copy of the data otherwise.
+static Value emitScatterOutput(ConversionPatternRewriter &rewriter,
+    Location loc, Operation *op, Value data) {
+  auto memRefType = convertToMemRefType(*op->result_type_begin());
+  if (Value alloc = getInPlaceOperand(
+          op, ArrayRef<Value>(data), memRefType, /*mayBroadcast=*/false))
+    return alloc;
+
+  Value alloc = insertAllocAndDealloc(
+      memRefType, loc, rewriter, checkInsertDealloc(op), {data});
+  auto int64Ty = rewriter.getIntegerType(64);
+  int64_t staticSize = getMemRefEltSizeInBytes(memRefType);
+  SmallVector<Value, 4> dynamicDims;
+  for (int i = 0; i < memRefType.getRank(); ++i) {
+    if (memRefType.isDynamicDim(i))
+      dynamicDims.emplace_back(rewriter.create<IndexCastOp>(
+          loc, rewriter.create<DimOp>(loc, data, i), int64Ty));
+    else
+      staticSize *= memRefType.getShape()[i];
+  }
+  Value size = emitConstantOp(rewriter, loc, int64Ty, staticSize);
+  for (Value dim : dynamicDims)
+    size = rewriter.create<MulIOp>(loc, size, dim);
+  emitMemcpy(rewriter, loc, alloc, data, size);
+  return alloc;
+}
+
+struct ONNXScatterElementsOpLowering : public ConversionPattern {
+  ONNXScatterElementsOpLowering(MLIRContext *ctx)
+      : ConversionPattern(
+            mlir::ONNXScatterElementsOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    ONNXScatterElementsOpAdaptor operandAdaptor(operands);
+    auto scatterOp = llvm::cast<ONNXScatterElementsOp>(op);
+    auto loc = op->getLoc();
+    Value data = operandAdaptor.data();
+    Value indices = operandAdaptor.indices();
+    Value updates = operandAdaptor.updates();
+    int64_t rank = data.getType().cast<MemRefType>().getRank();
+    // The axis is made positive by the shape inference.
+    int64_t axis = scatterOp.axis();
+
+    Value alloc = emitScatterOutput(rewriter, loc, op, data);
+    Value axisSize = emitDim(rewriter, loc, data, axis);
+
+    //  for ii in ndindex(updates.shape):
+    //    jj = ii with jj[axis] = indices[ii]
+    //    out[jj] = updates[ii]
+    //
+    // The updates at different positions along another dimension than the
+    // axis never store to the same element, so the loop over one of these
+    // dimensions is parallel. The updates at the same position along them
+    // are stored in order.
+    BuildKrnlLoop loops(rewriter, loc, rank);
+    loops.createDefineAndIterateOp(updates);
+    if (rank > 1)
+      loops.parallelize(axis == 0 ? 1 : 0);
+    rewriter.setInsertionPointToStart(loops.getIterateBlock());
+    SmallVector<Value, 4> ivs;
+    for (int64_t i = 0; i < rank; ++i)
+      ivs.emplace_back(loops.getInductionVar(i));
+
+    Value update = rewriter.create<AffineLoadOp>(loc, updates, ivs);
+    SmallVector<Value, 4> outputIndices(ivs.begin(), ivs.end());
+    outputIndices[axis] = emitLoadIndex(rewriter, loc, indices, ivs, axisSize);
+    rewriter.create<StoreOp>(loc, update, alloc, outputIndices);
+
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+struct ONNXScatterNDOpLowering : public ConversionPattern {
+  ONNXScatterNDOpLowering(MLIRContext *ctx)
+      : ConversionPattern(mlir::ONNXScatterNDOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    ONNXScatterNDOpAdaptor operandAdaptor(operands);
+    auto loc = op->getLoc();
+    Value data = operandAdaptor.data();
+    Value indices = operandAdaptor.indices();
+    Value updates = operandAdaptor.updates();
+    auto dataType = data.getType().cast<MemRefType>();
+    auto updatesType = updates.getType().cast<MemRefType>();
+    auto dataShape = dataType.getShape();
+    auto indicesShape = indices.getType().cast<MemRefType>().getShape();
+    int64_t dataRank = dataShape.size();
+    // The length of the index tuples must be known.
+    int64_t tupleSize = indicesShape.back();
+    if (tupleSize == -1)
+      return failure();
+    int64_t numOuterDims = indicesShape.size() - 1;
+
+    Value alloc = emitScatterOutput(rewriter, loc, op, data);
+    SmallVector<Value, 4> dimSizes;
+    for (int64_t j = 0; j < tupleSize; ++j)
+      dimSizes.emplace_back(emitDim(rewriter, loc, data, j));
+
+    //  for ii in ndindex(indices.shape[:-1]):
+    //    for kk in ndindex(data.shape[k:]):
+    //      out[indices[ii] + kk] = updates[ii + kk]
+    //
+    // The indices must not have duplicate tuples, so the updates of
+    // different tuples are stored in parallel.
+    int64_t sliceSize = 1;
+    for (int64_t i = tupleSize; i < dataRank; ++i)
+      sliceSize *= dataShape[i];
+    bool isRowScatter = dataType.hasStaticShape() &&
+                        updatesType.hasStaticShape() &&
+                        dataType.getAffineMaps().empty() &&
+                        updatesType.getAffineMaps().empty() &&
+                        sliceSize * getMemRefEltSizeInBytes(dataType) >=
+                            kMinScatterRowBytes;
+    int64_t numLoops =
+        isRowScatter ? numOuterDims : numOuterDims + dataRank - tupleSize;
+    SmallVector<Value, 4> ivs;
+    if (numLoops > 0) {
+      BuildKrnlLoop loops(rewriter, loc, numLoops);
+      loops.createDefineOp();
+      for (int64_t i = 0; i < numLoops; ++i)
+        loops.pushBounds(0, updates, i);
+      if (numOuterDims > 0)
+        loops.parallelize(0);
+      loops.createIterateOp();
+      rewriter.setInsertionPointToStart(loops.getIterateBlock());
+      for (int64_t i = 0; i < numLoops; ++i)
+        ivs.emplace_back(loops.getInductionVar(i));
+    }
+
+    // The index tuple of the update.
+    SmallVector<Value, 4> indexPosition(
+        ivs.begin(), ivs.begin() + numOuterDims);
+    indexPosition.emplace_back(nullptr);
+    SmallVector<Value, 4> outputIndices;
+    for (int64_t j = 0; j < tupleSize; ++j) {
+      indexPosition.back() =
+          emitConstantOp(rewriter, loc, rewriter.getIndexType(), j);
+      outputIndices.emplace_back(
+          emitLoadIndex(rewriter, loc, indices, indexPosition, dimSizes[j]));
+    }
+
+    if (!isRowScatter) {
+      outputIndices.append(ivs.begin() + numOuterDims, ivs.end());
+      Value update = rewriter.create<AffineLoadOp>(loc, updates, ivs);
+      rewriter.create<StoreOp>(loc, update, alloc, outputIndices);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+
+    // The slices are contiguous in the output and in the updates, each one
+    // is copied with a krnl.memcpy.
+    Value destOffset =
+        emitConstantOp(rewriter, loc, rewriter.getIndexType(), 0);
+    int64_t stride = sliceSize;
+    for (int64_t j = tupleSize - 1; j >= 0; --j) {
+      Value strideVal =
+          emitConstantOp(rewriter, loc, rewriter.getIndexType(), stride);
+      destOffset = rewriter.create<AddIOp>(loc, destOffset,
+          rewriter.create<MulIOp>(loc, outputIndices[j], strideVal));
+      stride *= dataShape[j];
+    }
+    AffineExpr srcOffsetExpr = rewriter.getAffineConstantExpr(0);
+    stride = sliceSize;
+    for (int64_t i = numOuterDims - 1; i >= 0; --i) {
+      srcOffsetExpr = srcOffsetExpr + rewriter.getAffineDimExpr(i) * stride;
+      stride *= updatesType.getShape()[i];
+    }
+    Value srcOffset = rewriter.create<AffineApplyOp>(loc,
+        AffineMap::get(numOuterDims, 0, srcOffsetExpr), ValueRange(ivs));
+    Value sliceBytes = emitConstantOp(rewriter, loc,
+        rewriter.getIntegerType(64),
+        sliceSize * getMemRefEltSizeInBytes(dataType));
+    emitMemcpy(rewriter, loc, alloc, updates, sliceBytes,
+        ValueRange{destOffset, srcOffset});
+
+    rewriter.replaceOp(op, alloc);
+    return success();
+  }
+};
+
+void populateLoweringONNXScatterElementsOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXScatterElementsOpLowering>(ctx);
+}
+
+void populateLoweringONNXScatterNDOpPattern(
+    OwningRewritePatternList &patterns, MLIRContext *ctx) {
+  patterns.insert<ONNXScatterNDOpLowering>(ctx);
+}
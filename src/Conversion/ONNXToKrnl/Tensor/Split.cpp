@@ -32,13 +32,35 @@ struct ONNXSplitOpLowering : public ConversionPattern {
     auto rank = splitOp.input().getType().cast<ShapedType>().getRank();
     auto outputNum = splitOp.getNumResults();
 
+    // When the dimensions before the split axis are all 1, each output is a
+    // contiguous part of the input, starting at its split offset times the
+    // size of the dimensions after the axis.
+    auto inputType = operands[0].getType().cast<MemRefType>();
+    auto inputShape = inputType.getShape();
+    bool splitInPlace = hasAllConstantDimensions(inputType) &&
+                        llvm::all_of(inputShape.take_front(axis),
+                            [](int64_t dim) { return dim == 1; });
+    int64_t innerSize = 1;
+    for (decltype(rank) r = axis + 1; r < rank; ++r)
+      innerSize *= inputShape[r];
+
     // Alloc and dealloc.
     SmallVector<Value, 4> allocs;
+    SmallVector<bool, 4> isView;
     for (int i = 0; i < outputNum; ++i) {
       Value alloc;
       bool insertDealloc = checkInsertDealloc(op, i);
       auto memRefType = convertToMemRefType(splitOp.outputs()[i].getType());
 
+      if (splitInPlace && canReshapeInPlace(operands[0], op, memRefType, i)) {
+        alloc = rewriter.create<KrnlReshapeOp>(loc, memRefType, operands[0],
+            rewriter.getI64IntegerAttr(splitOffset[i] * innerSize),
+            ValueRange());
+        allocs.emplace_back(alloc);
+        isView.emplace_back(true);
+        continue;
+      }
+
       if (hasAllConstantDimensions(memRefType))
         alloc = insertAllocAndDealloc(memRefType, loc, rewriter, insertDealloc);
       else {
@@ -63,10 +85,13 @@ struct ONNXSplitOpLowering : public ConversionPattern {
         }
       }
       allocs.emplace_back(alloc);
+      isView.emplace_back(false);
     }
 
-    // Creates loops, one for each output.
+    // Creates loops, one for each output that is not a view of the input.
     for (int i = 0; i < outputNum; ++i) {
+      if (isView[i])
+        continue;
       OpBuilder::InsertionGuard insertGuard(rewriter);
       // Create loop.
       BuildKrnlLoop outputLoops(rewriter, loc, rank);
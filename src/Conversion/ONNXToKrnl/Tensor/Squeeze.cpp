@@ -34,6 +34,14 @@ struct ONNXSqueezeOpLowering : public ConversionPattern {
       axes.emplace_back(axis);
     }
 
+    // A squeeze of a contiguous MemRef is a view of its buffer.
+    bool squeezeInPlace = canReshapeInPlace(data, op, memRefType);
+    if (squeezeInPlace && hasAllConstantDimensions(memRefType)) {
+      Value view = rewriter.create<KrnlReshapeOp>(loc, memRefType, data);
+      rewriter.replaceOp(op, view);
+      return success();
+    }
+
     // Insert an allocation and deallocation for the result of this operation,
     // and compute the output tensor's size in bytes.
     Value alloc, tensorSize;
@@ -68,6 +76,12 @@ struct ONNXSqueezeOpLowering : public ConversionPattern {
         // Move to the next output dimension.
         outIdx++;
       }
+      if (squeezeInPlace) {
+        Value view = rewriter.create<KrnlReshapeOp>(
+            loc, memRefType, data, allocOperands);
+        rewriter.replaceOp(op, view);
+        return success();
+      }
       // Allocate memory.
       alloc = rewriter.create<AllocOp>(loc, memRefType, allocOperands);
       auto *parentBlock = alloc.getDefiningOp()->getBlock();
@@ -85,7 +99,7 @@ struct ONNXSqueezeOpLowering : public ConversionPattern {
         tensorSize = rewriter.create<MulIOp>(loc, tensorSize, dimVal);
       }
     }
-    rewriter.create<KrnlMemcpyOp>(loc, alloc, data, tensorSize);
+    emitMemcpy(rewriter, loc, alloc, data, tensorSize);
     rewriter.replaceOp(op, alloc);
     return success();
   }
@@ -1,10 +1,10 @@
-//===----------------Tile.cpp - Lowering Tile Op----------------------=== //
+//===------------- Tile.cpp - Lowering Tile and Expand Ops ------------=== //
 //
 // Copyright 2020 The IBM Research Authors.
 //
 // =============================================================================
 //
-// This file lowers the ONNX Tile Operator to Krnl dialect.
+// This file lowers the ONNX Tile and Expand Operators to Krnl dialect.
 //
 //===----------------------------------------------------------------------===//
 
@@ -12,6 +12,9 @@
 
 using namespace mlir;
 
+// Blocks of the input shorter than a cache line are tiled element by element.
+static const int64_t kMinTileBlockBytes = 64;
+
 //===----------------------------------------------------------------------===//
 // Helper function to insert alloc and dealloc ops for memref of dynamic shape.
 //
@@ -44,6 +47,99 @@ Value insertAllocAndDeallocForTile(MemRefType memRefType, Location loc,
   return alloc;
 }
 
+/// Return the innermost dimension repeated when tiling `inputShape` into
+/// `outputShape`, or 0 if no dimension is repeated.
+static int64_t getInnermostRepeatedDim(
+    ArrayRef<int64_t> inputShape, ArrayRef<int64_t> outputShape) {
+  for (int64_t i = inputShape.size() - 1; i > 0; --i)
+    if (inputShape[i] != outputShape[i])
+      return i;
+  return 0;
+}
+
+/// Return true if tiling `inputShape` into `outputShape`, two static shapes of
+/// the same rank, copies blocks of the input large enough to be copied whole.
+static bool isTileBlockCopyProfitable(ArrayRef<int64_t> inputShape,
+    ArrayRef<int64_t> outputShape, int64_t eltSizeInBytes) {
+  if (llvm::is_contained(inputShape, 0))
+    return false;
+  int64_t innerDim = getInnermostRepeatedDim(inputShape, outputShape);
+  int64_t blockSize = 1;
+  for (int64_t i = innerDim; i < inputShape.size(); ++i)
+    blockSize *= inputShape[i];
+  return blockSize * eltSizeInBytes >= kMinTileBlockBytes;
+}
+
+/// Tile the input, of static shape `inputShape`, into the output with
+/// krnl.memcpy. Going from the innermost repeated dimension outwards, the
+/// slice of the output holding the input along a dimension is contiguous and
+/// it is repeated along that dimension by copying the part already filled
+/// right after itself, doubling it each time:
+///
+///   [x] -> [x x] -> [x x x x] -> [x x x x x x]
+///
+/// The dimensions inside the innermost repeated one are copied from the
+/// input as part of its first slices.
+static void emitTileBlockCopies(ConversionPatternRewriter &rewriter,
+    Location loc, Value input, ArrayRef<int64_t> inputShape, Value alloc) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto outputShape = memRefType.getShape();
+  int64_t eltSizeInBytes = getMemRefEltSizeInBytes(memRefType);
+  auto inputStrides = getStaticStrides(inputShape);
+  auto outputStrides = getStaticStrides(outputShape);
+  int64_t innerDim = getInnermostRepeatedDim(inputShape, outputShape);
+
+  for (int64_t k = innerDim; k >= 0; --k) {
+    if (k != innerDim && inputShape[k] == outputShape[k])
+      continue;
+    OpBuilder::InsertionGuard guard(rewriter);
+
+    // Iterate over the slices along dimension k, the outer dimensions of
+    // which are not repeated yet.
+    SmallVector<Value, 4> ivs;
+    if (k > 0) {
+      BuildKrnlLoop outerLoops(rewriter, loc, k);
+      outerLoops.createDefineOp();
+      for (int64_t i = 0; i < k; ++i)
+        outerLoops.pushBounds(0, inputShape[i]);
+      outerLoops.parallelize(0);
+      outerLoops.createIterateOp();
+      rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+      auto loopIVs = outerLoops.getAllInductionVar();
+      ivs.append(loopIVs.begin(), loopIVs.end());
+    }
+    auto emitOffset = [&](ArrayRef<int64_t> strides, int64_t shift) -> Value {
+      if (k == 0)
+        return emitConstantOp(rewriter, loc, rewriter.getIndexType(), shift);
+      AffineExpr offset = rewriter.getAffineConstantExpr(shift);
+      for (int64_t i = 0; i < k; ++i)
+        offset = offset + rewriter.getAffineDimExpr(i) * strides[i];
+      return rewriter.create<AffineApplyOp>(
+          loc, AffineMap::get(k, 0, offset), ivs);
+    };
+    auto emitCopy = [&](Value src, int64_t numElements, Value destOffset,
+                        Value srcOffset) {
+      Value size = emitConstantOp(rewriter, loc, rewriter.getIntegerType(64),
+          numElements * eltSizeInBytes);
+      rewriter.create<KrnlMemcpyOp>(
+          loc, alloc, src, size, ValueRange{destOffset, srcOffset});
+    };
+
+    int64_t sliceSize = inputShape[k] * outputStrides[k];
+    int64_t lineSize = outputShape[k] * outputStrides[k];
+    Value lineOffset = emitOffset(outputStrides, 0);
+    if (k == innerDim) {
+      Value inputOffset = emitOffset(inputStrides, 0);
+      emitCopy(input, sliceSize, lineOffset, inputOffset);
+    }
+    for (int64_t filled = sliceSize; filled < lineSize; filled *= 2) {
+      Value destOffset = emitOffset(outputStrides, filled);
+      emitCopy(alloc, std::min(filled, lineSize - filled), destOffset,
+          lineOffset);
+    }
+  }
+}
+
 struct ONNXTileOpLowering : public ConversionPattern {
   ONNXTileOpLowering(MLIRContext *ctx)
       : ConversionPattern(mlir::ONNXTileOp::getOperationName(), 1, ctx) {}
@@ -76,6 +172,17 @@ struct ONNXTileOpLowering : public ConversionPattern {
       alloc = insertAllocAndDeallocForTile(
           outputMemRefType, loc, rewriter, insertDealloc, input, repeats);
 
+    // With static shapes, the repeats follow from the shapes and the input
+    // can be replicated in blocks.
+    if (hasAllConstantDimensions(inputMemRefType) &&
+        hasAllConstantDimensions(outputMemRefType) &&
+        isTileBlockCopyProfitable(inputShape, outputMemRefShape,
+            getMemRefEltSizeInBytes(outputMemRefType))) {
+      emitTileBlockCopies(rewriter, loc, input, inputShape, alloc);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+
     // Define loops and iteration trip counts (equivalent to size of output)
     std::vector<Value> originalLoops;
     defineLoops(rewriter, loc, originalLoops, outputRank);
@@ -131,6 +238,63 @@ struct ONNXTileOpLowering : public ConversionPattern {
   }
 };
 
+struct ONNXExpandOpLowering : public ConversionPattern {
+  ONNXExpandOpLowering(MLIRContext *ctx)
+      : ConversionPattern(mlir::ONNXExpandOp::getOperationName(), 1, ctx) {}
+
+  LogicalResult matchAndRewrite(Operation *op, ArrayRef<Value> operands,
+      ConversionPatternRewriter &rewriter) const final {
+    ONNXExpandOpAdaptor operandAdaptor(operands);
+    auto loc = op->getLoc();
+
+    // Expand broadcasts the dimensions of size 1 of the input, aligned to the
+    // right of the output shape. It is lowered for static shapes, where it is
+    // a Tile of the input with leading dimensions of size 1 added.
+    Value input = operandAdaptor.input();
+    auto inputMemRefType = input.getType().cast<MemRefType>();
+    auto outputMemRefType = convertToMemRefType(*op->result_type_begin());
+    if (!hasAllConstantDimensions(inputMemRefType) ||
+        !hasAllConstantDimensions(outputMemRefType))
+      return failure();
+    auto outputShape = outputMemRefType.getShape();
+    int64_t outputRank = outputShape.size();
+    int64_t rankOffset = outputRank - inputMemRefType.getRank();
+    SmallVector<int64_t, 4> inputShape(rankOffset, 1);
+    inputShape.append(inputMemRefType.getShape().begin(),
+        inputMemRefType.getShape().end());
+
+    bool insertDealloc = checkInsertDealloc(op);
+    Value alloc =
+        insertAllocAndDealloc(outputMemRefType, loc, rewriter, insertDealloc);
+
+    if (isTileBlockCopyProfitable(inputShape, outputShape,
+            getMemRefEltSizeInBytes(outputMemRefType))) {
+      emitTileBlockCopies(rewriter, loc, input, inputShape, alloc);
+      rewriter.replaceOp(op, alloc);
+      return success();
+    }
+
+    // Otherwise, iterate over the output, reading the first element of the
+    // broadcast dimensions of the input.
+    BuildKrnlLoop outputLoops(rewriter, loc, outputRank);
+    outputLoops.createDefineAndIterateOp(alloc);
+    rewriter.setInsertionPointToStart(outputLoops.getIterateBlock());
+    Value zero = emitConstantOp(rewriter, loc, rewriter.getIndexType(), 0);
+    SmallVector<Value, 4> inputIndices;
+    for (int64_t i = rankOffset; i < outputRank; ++i)
+      inputIndices.emplace_back(inputShape[i] == 1
+                                    ? zero
+                                    : outputLoops.getInductionVar(i));
+    Value inputVal = rewriter.create<AffineLoadOp>(loc, input, inputIndices);
+    rewriter.create<AffineStoreOp>(
+        loc, inputVal, alloc, outputLoops.getAllInductionVar());
+
+    rewriter.replaceOp(op, alloc);
+
+    return success();
+  }
+};
+
 // This is the alternative way of lowering.
 // It is kept here for record in case this implementation is needed
 struct ONNXTileOpLoweringAlternative : public ConversionPattern {
@@ -224,5 +388,5 @@ struct ONNXTileOpLoweringAlternative : public ConversionPattern {
 
 void populateLoweringONNXTileOpPattern(
     OwningRewritePatternList &patterns, MLIRContext *ctx) {
-  patterns.insert<ONNXTileOpLowering>(ctx);
+  patterns.insert<ONNXTileOpLowering, ONNXExpandOpLowering>(ctx);
 }
@@ -12,6 +12,154 @@
 
 using namespace mlir;
 
+// Contiguous runs shorter than a cache line are copied element by element.
+static const int64_t kMinCopyRunBytes = 64;
+// Size in bytes of the side of the tiles of blocked transposes, so that the
+// source and destination lines of a tile stay in the L1 cache.
+static const int64_t kTransposeTileBytes = 128;
+
+/// Return true if the transpose does not reorder the dimensions of size other
+/// than 1, in which case it is a plain copy of the data.
+static bool isPureCopy(ArrayRef<int64_t> outputShape, ArrayRef<int64_t> perm) {
+  int64_t lastDim = -1;
+  for (unsigned i = 0; i < perm.size(); ++i) {
+    if (outputShape[i] == 1)
+      continue;
+    if (perm[i] < lastDim)
+      return false;
+    lastDim = perm[i];
+  }
+  return true;
+}
+
+/// Return the number of innermost dimensions kept in place by the transpose.
+static unsigned getNumFixedInnerDims(ArrayRef<int64_t> perm) {
+  int64_t rank = perm.size();
+  unsigned numFixed = 0;
+  while (numFixed < rank && perm[rank - 1 - numFixed] == rank - 1 - numFixed)
+    ++numFixed;
+  return numFixed;
+}
+
+/// Copy the runs of contiguous elements made of the `numFixedDims` innermost
+/// dimensions, kept in place by the transpose, with one krnl.memcpy each.
+static void emitTransposeCopyRuns(ConversionPatternRewriter &rewriter,
+    Location loc, Value data, Value alloc, ArrayRef<int64_t> perm,
+    unsigned numFixedDims) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto outputShape = memRefType.getShape();
+  auto inputShape = data.getType().cast<MemRefType>().getShape();
+  int64_t rank = outputShape.size();
+  int64_t numOuterDims = rank - numFixedDims;
+
+  int64_t runLength = 1;
+  for (int64_t i = numOuterDims; i < rank; ++i)
+    runLength *= outputShape[i];
+  Value runBytes = emitConstantOp(rewriter, loc, rewriter.getIntegerType(64),
+      runLength * getMemRefEltSizeInBytes(memRefType));
+
+  // Iterate over the runs in the order of the output, so that it is written
+  // sequentially.
+  BuildKrnlLoop outerLoops(rewriter, loc, numOuterDims);
+  outerLoops.createDefineOp();
+  for (int64_t i = 0; i < numOuterDims; ++i)
+    outerLoops.pushBounds(0, outputShape[i]);
+  outerLoops.parallelize(0);
+  outerLoops.createIterateOp();
+  rewriter.setInsertionPointToStart(outerLoops.getIterateBlock());
+
+  // Offsets of the run in the output and in the input.
+  auto outputStrides = getStaticStrides(outputShape);
+  auto inputStrides = getStaticStrides(inputShape);
+  AffineExpr outputOffset = rewriter.getAffineConstantExpr(0);
+  AffineExpr inputOffset = rewriter.getAffineConstantExpr(0);
+  for (int64_t i = 0; i < numOuterDims; ++i) {
+    auto d = rewriter.getAffineDimExpr(i);
+    outputOffset = outputOffset + d * outputStrides[i];
+    inputOffset = inputOffset + d * inputStrides[perm[i]];
+  }
+  auto ivs = outerLoops.getAllInductionVar();
+  Value destOffset = rewriter.create<AffineApplyOp>(loc,
+      AffineMap::get(numOuterDims, 0, outputOffset), ivs);
+  Value srcOffset = rewriter.create<AffineApplyOp>(loc,
+      AffineMap::get(numOuterDims, 0, inputOffset), ivs);
+  emitMemcpy(rewriter, loc, alloc, data, runBytes,
+      ValueRange{destOffset, srcOffset});
+}
+
+/// Transpose in square tiles spanning the innermost dimension of the output
+/// and the dimension of the output read from the innermost dimension of the
+/// input. The lines of a tile are read and written whole while they are in
+/// the cache, instead of reading or writing the whole tensor with a stride.
+static void emitBlockedTranspose(ConversionPatternRewriter &rewriter,
+    Location loc, Value data, Value alloc, ArrayRef<int64_t> perm) {
+  auto memRefType = alloc.getType().cast<MemRefType>();
+  auto outputShape = memRefType.getShape();
+  int64_t rank = outputShape.size();
+  int64_t innerDim = rank - 1;
+  int64_t readDim =
+      std::find(perm.begin(), perm.end(), rank - 1) - perm.begin();
+
+  int64_t tileSize = std::max<int64_t>(
+      1, kTransposeTileBytes / getMemRefEltSizeInBytes(memRefType));
+  auto clampTileSize = [&](int64_t dimSize) {
+    return std::max<int64_t>(1, std::min(tileSize, dimSize));
+  };
+
+  std::vector<Value> loops;
+  defineLoops(rewriter, loc, loops, rank);
+  auto loopType = LoopType::get(rewriter.getContext());
+  auto readBlock = rewriter.create<KrnlBlockOp>(loc, loopType, loopType,
+      loops[readDim],
+      rewriter.getI64IntegerAttr(clampTileSize(outputShape[readDim])));
+  auto innerBlock = rewriter.create<KrnlBlockOp>(loc, loopType, loopType,
+      loops[innerDim],
+      rewriter.getI64IntegerAttr(clampTileSize(outputShape[innerDim])));
+
+  // Move the intra-tile loops innermost: (..., readBlock, ..., innerBlock,
+  // readLocal, innerLocal), the other loops keeping their order.
+  SmallVector<Value, 8> nestedLoops;
+  SmallVector<int64_t, 8> positions;
+  std::vector<Value> optimizedLoops;
+  for (int64_t i = 0; i < rank; ++i) {
+    if (i == readDim) {
+      nestedLoops.append({readBlock.loop_block(), readBlock.loop_local()});
+      positions.append({(int64_t)optimizedLoops.size(), rank});
+      optimizedLoops.emplace_back(readBlock.loop_block());
+    } else if (i == innerDim) {
+      nestedLoops.append({innerBlock.loop_block(), innerBlock.loop_local()});
+      positions.append({(int64_t)optimizedLoops.size(), rank + 1});
+      optimizedLoops.emplace_back(innerBlock.loop_block());
+    } else {
+      nestedLoops.emplace_back(loops[i]);
+      positions.emplace_back(optimizedLoops.size());
+      optimizedLoops.emplace_back(loops[i]);
+    }
+  }
+  optimizedLoops.emplace_back(readBlock.loop_local());
+  optimizedLoops.emplace_back(innerBlock.loop_local());
+  rewriter.create<KrnlPermuteOp>(
+      loc, nestedLoops, rewriter.getI64ArrayAttr(positions));
+  // The outermost loop writes disjoint parts of the output.
+  rewriter.create<KrnlParallelOp>(loc, optimizedLoops[0]);
+
+  KrnlIterateOperandPack pack(rewriter, loops, optimizedLoops);
+  for (int64_t i = 0; i < rank; ++i)
+    addDimensionToPack(rewriter, loc, pack, alloc, i);
+  auto iterateOp = rewriter.create<KrnlIterateOp>(loc, pack);
+  Block &iterationBlock = iterateOp.bodyRegion().front();
+  rewriter.setInsertionPointToStart(&iterationBlock);
+
+  SmallVector<Value, 4> outLoopIVs;
+  for (auto arg : iterationBlock.getArguments())
+    outLoopIVs.emplace_back(arg);
+  SmallVector<Value, 4> inLoopIVs(rank);
+  for (int64_t i = 0; i < rank; ++i)
+    inLoopIVs[perm[i]] = outLoopIVs[i];
+  auto inVal = rewriter.create<AffineLoadOp>(loc, data, inLoopIVs);
+  rewriter.create<AffineStoreOp>(loc, inVal, alloc, outLoopIVs);
+}
+
 struct ONNXTransposeOpLowering : public ConversionPattern {
   ONNXTransposeOpLowering(MLIRContext *ctx)
       : ConversionPattern(mlir::ONNXTransposeOp::getOperationName(), 1, ctx) {}
@@ -44,6 +192,42 @@ struct ONNXTransposeOpLowering : public ConversionPattern {
     auto memRefShape = memRefType.getShape();
     int64_t rank = memRefShape.size();
 
+    // Read perm attribute.
+    SmallVector<int64_t, 4> perm;
+    auto permAttribute = llvm::dyn_cast<ONNXTransposeOp>(op).permAttr();
+    assert(permAttribute && "permute attribute expected to be defined here");
+    for (auto permVal : permAttribute.getValue())
+      perm.emplace_back(permVal.cast<IntegerAttr>().getInt());
+
+    // With static shapes, copy whole runs of contiguous elements when there
+    // are any, and tile the loops otherwise.
+    if (hasAllConstantDimensions(memRefType) &&
+        hasAllConstantDimensions(data.getType().cast<MemRefType>())) {
+      int64_t eltBytes = getMemRefEltSizeInBytes(memRefType);
+      unsigned numFixedDims = getNumFixedInnerDims(perm);
+      int64_t runLength = 1;
+      for (int64_t i = rank - numFixedDims; i < rank; ++i)
+        runLength *= memRefShape[i];
+
+      bool copyRuns =
+          numFixedDims > 0 && runLength * eltBytes >= kMinCopyRunBytes;
+      if (isPureCopy(memRefShape, perm)) {
+        Value size = emitConstantOp(rewriter, loc, rewriter.getIntegerType(64),
+            getMemRefSizeInBytes(alloc));
+        emitMemcpy(rewriter, loc, alloc, data, size);
+        rewriter.replaceOp(op, alloc);
+        return success();
+      }
+      if (copyRuns || numFixedDims == 0) {
+        if (copyRuns)
+          emitTransposeCopyRuns(rewriter, loc, data, alloc, perm, numFixedDims);
+        else
+          emitBlockedTranspose(rewriter, loc, data, alloc, perm);
+        rewriter.replaceOp(op, alloc);
+        return success();
+      }
+    }
+
     // Define loops.
     std::vector<Value> originalLoops;
     defineLoops(rewriter, loc, originalLoops, rank);
@@ -64,13 +248,6 @@ struct ONNXTransposeOpLowering : public ConversionPattern {
 
     // Handle the operation.
 
-    // Read perm attribute.
-    SmallVector<int, 4> perm;
-    auto permAttribute = llvm::dyn_cast<ONNXTransposeOp>(op).permAttr();
-    assert(permAttribute && "permute attribute expected to be defined here");
-    for (auto permVal : permAttribute.getValue())
-      perm.emplace_back(permVal.cast<IntegerAttr>().getInt());
-
     SmallVector<Value, 4> inLoopIVs;
     for (auto arg : iterationBlock.getArguments())
       inLoopIVs.emplace_back(arg);
@@ -34,6 +34,14 @@ struct ONNXUnsqueezeOpLowering : public ConversionPattern {
       axes.emplace_back(axis);
     }
 
+    // An unsqueeze of a contiguous MemRef is a view of its buffer.
+    bool unsqueezeInPlace = canReshapeInPlace(data, op, memRefType);
+    if (unsqueezeInPlace && hasAllConstantDimensions(memRefType)) {
+      Value view = rewriter.create<KrnlReshapeOp>(loc, memRefType, data);
+      rewriter.replaceOp(op, view);
+      return success();
+    }
+
     // Insert an allocation and deallocation for the result of this operation.
     Value alloc;
 
@@ -68,6 +76,12 @@ struct ONNXUnsqueezeOpLowering : public ConversionPattern {
         if (std::find(axes.begin(), axes.end(), outIdx) == axes.end())
           inIdx++;
       }
+      if (unsqueezeInPlace) {
+        Value view = rewriter.create<KrnlReshapeOp>(
+            loc, memRefType, data, allocOperands);
+        rewriter.replaceOp(op, view);
+        return success();
+      }
       alloc = rewriter.create<AllocOp>(loc, memRefType, allocOperands);
       auto *parentBlock = alloc.getDefiningOp()->getBlock();
       if (insertDealloc) {
@@ -75,7 +89,7 @@ struct ONNXUnsqueezeOpLowering : public ConversionPattern {
         dealloc.getOperation()->moveBefore(&parentBlock->back());
       }
     }
-    rewriter.create<KrnlMemcpyOp>(loc, alloc, data, tensorSize);
+    emitMemcpy(rewriter, loc, alloc, data, tensorSize);
     rewriter.replaceOp(op, alloc);
     return success();
   }
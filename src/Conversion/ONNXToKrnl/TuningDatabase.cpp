@@ -0,0 +1,116 @@
+//===------------- TuningDatabase.cpp - Tuned Lowering Parameters ---------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file implements the reading and writing of the tuning database.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/StandardTypes.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "src/Conversion/ONNXToKrnl/TuningDatabase.hpp"
+
+using namespace mlir;
+
+std::string TuningDatabase::getShapesKey(TypeRange operandTypes) {
+  std::string key;
+  llvm::raw_string_ostream os(key);
+  bool first = true;
+  for (Type type : operandTypes) {
+    if (!first)
+      os << ",";
+    first = false;
+    auto shapedType = type.dyn_cast<ShapedType>();
+    if (!shapedType || !shapedType.hasRank()) {
+      os << "*";
+      continue;
+    }
+    // Scalars have an empty shape, which would not be parsable.
+    if (shapedType.getRank() == 0)
+      os << "scalar";
+    bool firstDim = true;
+    for (int64_t dim : shapedType.getShape()) {
+      if (!firstDim)
+        os << "x";
+      firstDim = false;
+      if (dim < 0)
+        os << "?";
+      else
+        os << dim;
+    }
+  }
+  return os.str();
+}
+
+bool TuningDatabase::load(StringRef fileName, std::string &errorMessage) {
+  auto fileOrErr = llvm::MemoryBuffer::getFile(fileName);
+  if (std::error_code error = fileOrErr.getError()) {
+    errorMessage = "cannot open tuning database " + fileName.str() + ": " +
+                   error.message();
+    return false;
+  }
+
+  SmallVector<StringRef, 64> lines;
+  (*fileOrErr)->getBuffer().split(lines, '\n');
+  for (unsigned i = 0; i < lines.size(); ++i) {
+    StringRef line = lines[i].trim();
+    if (line.empty() || line.startswith("#"))
+      continue;
+    SmallVector<StringRef, 8> fields;
+    line.split(fields, ' ', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+    auto reportError = [&](const Twine &message) {
+      errorMessage =
+          (fileName + ":" + Twine(i + 1) + ": " + message).str();
+      return false;
+    };
+    if (fields.size() < 3)
+      return reportError("expected an operation, shapes and a target");
+
+    TuningConfig config;
+    for (StringRef field : llvm::makeArrayRef(fields).drop_front(3)) {
+      StringRef name, value;
+      std::tie(name, value) = field.split('=');
+      if (name.empty() || value.empty())
+        return reportError("expected a parameter of the form name=value");
+      config[name.str()] = value.str();
+    }
+    insert(fields[0], fields[1], fields[2], config);
+  }
+  return true;
+}
+
+bool TuningDatabase::save(StringRef fileName, std::string &errorMessage) const {
+  std::error_code error;
+  llvm::raw_fd_ostream os(fileName, error, llvm::sys::fs::OF_Text);
+  if (error) {
+    errorMessage = "cannot write tuning database " + fileName.str() + ": " +
+                   error.message();
+    return false;
+  }
+  for (const auto &entry : entries) {
+    os << std::get<0>(entry.first) << " " << std::get<1>(entry.first) << " "
+       << std::get<2>(entry.first);
+    for (const auto &parameter : entry.second)
+      os << " " << parameter.first << "=" << parameter.second;
+    os << "\n";
+  }
+  return true;
+}
+
+const TuningConfig *TuningDatabase::lookup(
+    StringRef opName, StringRef shapes, StringRef target) const {
+  auto it = entries.find(EntryKey(opName.str(), shapes.str(), target.str()));
+  return it == entries.end() ? nullptr : &it->second;
+}
+
+void TuningDatabase::insert(StringRef opName, StringRef shapes,
+    StringRef target, const TuningConfig &config) {
+  entries[EntryKey(opName.str(), shapes.str(), target.str())] = config;
+}
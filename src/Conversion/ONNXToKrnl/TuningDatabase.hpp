@@ -0,0 +1,60 @@
+//===------------- TuningDatabase.hpp - Tuned Lowering Parameters ---------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file declares the tuning database, which holds the parameters of the
+// lowering of operations (tile sizes, loop orders) measured to be the fastest
+// for given operand shapes on a given target. It is a text file with one
+// entry per line:
+//
+//   onnx.MatMul 128x768,768x3072 x86_64:skylake-avx512 cache-tile-m=64 ...
+//
+// made of the name of the operation, the shapes of its operands, the target
+// and the parameters. Empty lines and lines starting with '#' are ignored.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "mlir/IR/Types.h"
+#include "llvm/ADT/StringRef.h"
+
+/// Parameters of the lowering of an operation, by name.
+using TuningConfig = std::map<std::string, std::string>;
+
+class TuningDatabase {
+public:
+  /// Return the key of the shapes of the given operand types, e.g.
+  /// "128x768,768x3072". Unranked operands, scalars and dynamic dimensions
+  /// are written as '*', "scalar" and '?'.
+  static std::string getShapesKey(mlir::TypeRange operandTypes);
+
+  /// Read the entries of a database file, adding them to this database.
+  /// Returns false and sets errorMessage if the file cannot be read or is
+  /// malformed.
+  bool load(llvm::StringRef fileName, std::string &errorMessage);
+
+  /// Write all the entries of this database into a file. Returns false and
+  /// sets errorMessage if the file cannot be written.
+  bool save(llvm::StringRef fileName, std::string &errorMessage) const;
+
+  /// Return the parameters of an operation on a target, or null.
+  const TuningConfig *lookup(llvm::StringRef opName, llvm::StringRef shapes,
+      llvm::StringRef target) const;
+
+  /// Add or replace the parameters of an operation on a target.
+  void insert(llvm::StringRef opName, llvm::StringRef shapes,
+      llvm::StringRef target, const TuningConfig &config);
+
+  bool empty() const { return entries.empty(); }
+
+private:
+  using EntryKey = std::tuple<std::string, std::string, std::string>;
+  std::map<EntryKey, TuningConfig> entries;
+};
@@ -264,6 +264,16 @@ void BuildKrnlLoop::createDefineAndIterateOp(Value memRefOperand) {
   createIterateOp();
 }
 
+void BuildKrnlLoop::parallelize(int originalLoopIndex) {
+  assert(createdDefineOp && "Must create define op before parallelizing.");
+  assert(originalLoopIndex >= 0 && originalLoopIndex < originalLoopNum &&
+         "Original loop index is out of bounds.");
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPointAfter(originalLoops[0].getDefiningOp());
+  rewriter.create<KrnlParallelOp>(loc, originalLoops[originalLoopIndex]);
+}
+
 BlockArgument &BuildKrnlLoop::getInductionVar(int originalLoopIndex) {
   // Check if loop iteration variable is within bounds.
   assert(originalLoopIndex >= 0 && originalLoopIndex < originalLoopNum &&
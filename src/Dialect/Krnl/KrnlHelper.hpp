@@ -182,6 +182,11 @@ public:
   // MemRef operand.
   void createDefineAndIterateOp(Value memRefOperand);
 
+  // Mark the original loop with the given index as parallel. The krnl.parallel
+  // operation is emitted right after the loop definition, the define op must
+  // have been emitted already.
+  void parallelize(int originalLoopIndex);
+
   // Get the (original loop) induction variable associated with the given
   // index. Use the index returned when pushing the bounds.
   BlockArgument &getInductionVar(int originalLoopIndex);
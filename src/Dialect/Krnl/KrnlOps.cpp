@@ -309,6 +309,47 @@ void KrnlEntryPointOp::build(mlir::OpBuilder &builder, OperationState &state,
   state.addAttribute(KrnlEntryPointOp::getNumOutputsAttrName(), numOutputs);
 }
 
+//===----------------------------------------------------------------------===//
+// KrnlGetRefOp
+//===----------------------------------------------------------------------===//
+
+void KrnlGetRefOp::build(OpBuilder &builder, OperationState &result,
+    Type resultType, Value mempool, Value offset) {
+  build(builder, result, resultType, mempool, offset, ValueRange());
+}
+
+static LogicalResult verify(KrnlGetRefOp op) {
+  // The sizes of the dynamic dimensions are either all given or all omitted.
+  auto memRefType = op.getResult().getType().dyn_cast<MemRefType>();
+  int64_t numDynamicSizes = op.value().size();
+  if (memRefType && numDynamicSizes != 0 &&
+      numDynamicSizes != memRefType.getNumDynamicDims())
+    return op.emitOpError("expects one size operand per dynamic dimension");
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// KrnlReshapeOp
+//===----------------------------------------------------------------------===//
+
+static LogicalResult verify(KrnlReshapeOp op) {
+  auto srcType = op.src().getType().cast<MemRefType>();
+  auto memRefType = op.getResult().getType().cast<MemRefType>();
+  if (!srcType.getAffineMaps().empty() || !memRefType.getAffineMaps().empty())
+    return op.emitOpError("expects MemRefs with the identity layout");
+  if (srcType.getElementType() != memRefType.getElementType())
+    return op.emitOpError("expects MemRefs of the same element type");
+  if (op.sizes().size() != memRefType.getNumDynamicDims())
+    return op.emitOpError("expects one size operand per dynamic dimension");
+  int64_t offset = op.offset();
+  if (offset < 0)
+    return op.emitOpError("expects a non-negative offset");
+  if (srcType.hasStaticShape() && memRefType.hasStaticShape() &&
+      offset + memRefType.getNumElements() > srcType.getNumElements())
+    return op.emitOpError("expects the output MemRef to fit in the input one");
+  return success();
+}
+
 #define GET_OP_CLASSES
 #include "src/Dialect/Krnl/KrnlOps.cpp.inc"
 } // namespace mlir
@@ -28,6 +28,10 @@ public:
   KrnlOpsDialect(MLIRContext *context);
   static StringRef getDialectNamespace() { return "krnl"; }
 
+  /// The unit attribute of the functions outlined from the loop nests of
+  /// another function, whose MemRef arguments may alias.
+  static StringRef getOutlinedAttrName() { return "krnl.outlined"; }
+
   /// Parse a type registered to this dialect.
   Type parseType(DialectAsmParser &parser) const override {
     if (succeeded(parser.parseOptionalKeyword("loop")))
@@ -20,6 +20,7 @@
 #include "mlir/IR/PatternMatch.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallBitVector.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/FormatVariadic.h"
 
 #include "ONNXOps.hpp"
@@ -1251,6 +1252,139 @@ LogicalResult ONNXQLinearMatMulOp::inferShapes() {
   return success();
 }
 
+//===----------------------------------------------------------------------===//
+// MatMulInteger
+//===----------------------------------------------------------------------===//
+
+LogicalResult ONNXMatMulIntegerOp::inferShapes() {
+  // Cannot infer shape if no shape exists.
+  if (!A().getType().isa<RankedTensorType>() ||
+      !B().getType().isa<RankedTensorType>())
+    return emitError("Input tensor(s) not ranked");
+
+  auto lhsTy = A().getType().cast<RankedTensorType>();
+  auto rhsTy = B().getType().cast<RankedTensorType>();
+
+  SmallVector<int64_t, 2> dims;
+  auto lhsShape = lhsTy.getShape();
+  auto rhsShape = rhsTy.getShape();
+
+  if (lhsShape.size() < 1 && rhsShape.size() < 1) {
+    // Multiplication by scalars is not allowed.
+    return emitError("Multiplication by scalar arguments not allowed");
+  } else if (lhsShape.size() == 1 && rhsShape.size() == 1) {
+    // Special case when both arrays are 1-dimensional and according to
+    // numpy rules the types need to be extended to 1xN and Nx1. Helper sizes
+    // need to be removed after the multiplication but cannot be removed if all
+    // sizes are 1.
+    if (lhsShape[0] != -1 && rhsShape[0] != -1 && lhsShape[0] != rhsShape[0])
+      return emitError("Attempt to multiply incompatible matrices");
+    dims.emplace_back(1);
+  } else if (lhsShape.size() == 1 && rhsShape.size() >= 2) {
+    // If the first argument is 1-D, it is promoted to a matrix by prepending a
+    // 1 to its dimensions. After matrix multiplication the prepended 1 is
+    // removed.
+    //
+    // N MATMUL (s1 x s2 x... x sK x N x P)
+    // =>
+    // (s1 x s2 x... x sK x P)
+
+    // Check legality of matrix multiplication.
+    unsigned rhsRank = rhsShape.size();
+    if (lhsShape[0] != -1 && rhsShape[rhsRank - 2] != -1 &&
+        lhsShape[0] != rhsShape[rhsRank - 2])
+      return emitError("Attempt to multiply incompatible matrices");
+    for (decltype(rhsRank) i = 0; i < rhsRank - 2; ++i)
+      dims.emplace_back(rhsShape[i]);
+    dims.emplace_back(rhsShape[rhsRank - 1]);
+  } else if (lhsShape.size() >= 2 && rhsShape.size() == 1) {
+    // If the second argument is 1-D, it is promoted to a matrix by appending a
+    // 1 to its dimensions. After matrix multiplication the appended 1 is
+    // removed.
+    //
+    // (s1 x s2 x... x sK x M x N) MATMUL N
+    // =>
+    // (s1 x s2 x... x sK x M)
+
+    // Check legality of matrix multiplication.
+    unsigned lhsRank = lhsShape.size();
+    if (lhsShape[lhsRank - 1] != -1 && rhsShape[0] != -1 &&
+        lhsShape[lhsRank - 1] != rhsShape[0])
+      return emitError("Attempt to multiply incompatible matrices");
+    for (decltype(lhsRank) i = 0; i < lhsRank - 2; ++i)
+      dims.emplace_back(lhsShape[i]);
+    dims.emplace_back(lhsShape[lhsRank - 2]);
+  } else if (lhsShape.size() > 2 && rhsShape.size() == 2) {
+    // (s1 x s2 x... x sK x M x N) MATMUL (N x P)
+    // =>
+    // (s1 x s2 x... x sK x M x P)
+
+    // Check legality of matrix multiplication.
+    unsigned lhsRank = lhsShape.size();
+    if (lhsShape[lhsRank - 1] != -1 && rhsShape[0] != -1 &&
+        lhsShape[lhsRank - 1] != rhsShape[0])
+      return emitError("Attempt to multiply incompatible matrices");
+    for (decltype(lhsRank) i = 0; i < lhsRank - 1; ++i)
+      dims.emplace_back(lhsShape[i]);
+    dims.emplace_back(rhsShape[1]);
+  } else if (lhsShape.size() == 2 && rhsShape.size() > 2) {
+    // (M x N) MATMUL (s1 x s2 x... x sK x N x P)
+    // =>
+    // (s1 x s2 x... x sK x M x P)
+
+    // Check legality of matrix multiplication.
+    unsigned rhsRank = rhsShape.size();
+    if (lhsShape[1] != -1 && rhsShape[rhsRank - 2] != -1 &&
+        lhsShape[1] != rhsShape[rhsRank - 2])
+      return emitError("Attempt to multiply incompatible matrices");
+    for (decltype(rhsRank) i = 0; i < rhsRank - 2; ++i)
+      dims.emplace_back(rhsShape[i]);
+    dims.emplace_back(lhsShape[0]);
+    dims.emplace_back(rhsShape[rhsRank - 1]);
+  } else if (lhsShape.size() > 2 && rhsShape.size() > 2) {
+    // (s1 x s2 x... x sK x M x N) MATMUL (t1 x t2 x... x tK x N x P)
+    // =>
+    // (u1 x u2 x... x uK x M x P)
+
+    // Check legality of matrix multiplication.
+    unsigned lhsRank = lhsShape.size();
+    unsigned rhsRank = rhsShape.size();
+    if (lhsShape[lhsRank - 1] != -1 && rhsShape[rhsRank - 2] != -1 &&
+        lhsShape[lhsRank - 1] != rhsShape[rhsRank - 2])
+      return emitError("Attempt to multiply incompatible matrices");
+    // Check and perform broadcasting for the shapes.
+    SmallVector<int64_t, 2> lhsBcastShape;
+    for (decltype(lhsRank) i = 0; i < lhsRank - 2; ++i)
+      lhsBcastShape.emplace_back(lhsShape[i]);
+    SmallVector<int64_t, 2> rhsBcastShape;
+    for (decltype(rhsRank) i = 0; i < rhsRank - 2; ++i)
+      rhsBcastShape.emplace_back(rhsShape[i]);
+    if (!getBroadcastedShape(lhsBcastShape, rhsBcastShape, dims))
+      return emitError("Broadcasted dimensions are incompatible");
+    dims.emplace_back(lhsShape[lhsRank - 2]);
+    dims.emplace_back(rhsShape[rhsRank - 1]);
+  } else {
+    // This case covers all remaining combinations of 1 and 2-D matrices.
+    int64_t lhsDim = lhsShape[0];
+    int64_t rhsDim = rhsShape[0];
+    if (lhsShape.size() > 1) {
+      lhsDim = lhsShape[1];
+      dims.emplace_back(lhsShape[0]);
+    }
+
+    // Check legality of matrix multiplication.
+    if (lhsDim != -1 && rhsDim != -1 && lhsDim != rhsDim)
+      return emitError("Attempt to multiply incompatible matrices");
+    if (rhsShape.size() > 1)
+      dims.emplace_back(rhsShape[1]);
+  }
+
+  // The products are accumulated in 32-bit integers.
+  getResult().setType(
+      RankedTensorType::get(dims, IntegerType::get(32, getContext())));
+  return success();
+}
+
 // Gemm
 LogicalResult ONNXGemmOp::inferShapes() {
   bool hasBias = !C().getType().isa<NoneType>();
@@ -1340,6 +1474,32 @@ LogicalResult ONNXBatchNormalizationTestModeOp::inferShapes() {
   return success();
 }
 
+/// InstanceNormalization
+LogicalResult ONNXInstanceNormalizationOp::inferShapes() {
+  // Cannot infer shape if no shape exists.
+  if (!input().getType().isa<RankedTensorType>())
+    return emitError("Input tensor not ranked");
+
+  // Operand's dimensions must be in the form of NxCxD1xD2x...xDn.
+  // Shapes of scale and bias must be C.
+  auto inputTensorTy = input().getType().cast<RankedTensorType>();
+  if (inputTensorTy.getRank() < 3)
+    return emitError("Input tensor must have at least 3 dimensions");
+  int64_t c = inputTensorTy.getShape()[1];
+  for (auto param : {scale(), B()}) {
+    auto paramTensorTy = param.getType().dyn_cast<RankedTensorType>();
+    if (!paramTensorTy)
+      continue;
+    auto shape = paramTensorTy.getShape();
+    if (shape.size() != 1 || (c != -1 && shape[0] != -1 && shape[0] != c))
+      return emitError("Wrong shape for the scale or the bias");
+  }
+
+  // The output tensor of the same shape as the input.
+  getResult().setType(input().getType());
+  return success();
+}
+
 // TODO:
 //   Verify that matrix sizes are valid for multiplication and addition.
 //   Take into account the dimensionality of the matrix.
@@ -1514,6 +1674,37 @@ LogicalResult ONNXReduceSumOp::inferShapes() {
   return success();
 }
 
+//===----------------------------------------------------------------------===//
+// ArgMax and ArgMin
+//===----------------------------------------------------------------------===//
+
+// The indices of the selected elements have the shape of the reduction of the
+// data along the axis.
+static LogicalResult inferArgReductionShape(
+    Operation *op, Value data, int64_t axis, int64_t keepdims) {
+  if (!data.getType().isa<RankedTensorType>())
+    return op->emitError("Input tensor not ranked");
+
+  auto dataTy = data.getType().cast<RankedTensorType>();
+  int64_t rank = dataTy.getRank();
+  if (axis < -rank || axis >= rank)
+    return op->emitError("Axis out of the rank of the data");
+  auto builder = mlir::Builder(op->getContext());
+  auto reducedTy = getReductionOutputType(
+      dataTy, builder.getI64ArrayAttr(axis), keepdims);
+  op->getResult(0).setType(
+      RankedTensorType::get(reducedTy.getShape(), builder.getIntegerType(64)));
+  return success();
+}
+
+LogicalResult ONNXArgMaxOp::inferShapes() {
+  return inferArgReductionShape(getOperation(), data(), axis(), keepdims());
+}
+
+LogicalResult ONNXArgMinOp::inferShapes() {
+  return inferArgReductionShape(getOperation(), data(), axis(), keepdims());
+}
+
 //===----------------------------------------------------------------------===//
 // Conv
 //===----------------------------------------------------------------------===//
@@ -2806,6 +2997,89 @@ LogicalResult ONNXGatherOp::inferShapes() {
   return success();
 }
 
+//===----------------------------------------------------------------------===//
+// ScatterElements
+//===----------------------------------------------------------------------===//
+
+/// Infer the output shape of the ONNXScatterElementsOp. This method is
+/// required by the shape inference interface.
+LogicalResult ONNXScatterElementsOp::inferShapes() {
+  // Cannot infer shape if no shape exists.
+  if (!data().getType().isa<RankedTensorType>())
+    return emitError("Input tensor not ranked");
+  if (!indices().getType().isa<RankedTensorType>())
+    return emitError("Indices tensor not ranked");
+  if (!updates().getType().isa<RankedTensorType>())
+    return emitError("Updates tensor not ranked");
+
+  auto dataType = data().getType().cast<RankedTensorType>();
+  auto indicesShape = indices().getType().cast<RankedTensorType>().getShape();
+  auto updatesShape = updates().getType().cast<RankedTensorType>().getShape();
+  int64_t dataRank = dataType.getRank();
+  if (dataRank < 1)
+    return emitError("Input tensor must have rank >= 1");
+  if ((int64_t)indicesShape.size() != dataRank ||
+      (int64_t)updatesShape.size() != dataRank)
+    return emitError("Indices and updates must have the rank of the input");
+  for (int64_t i = 0; i < dataRank; ++i)
+    if (indicesShape[i] != -1 && updatesShape[i] != -1 &&
+        indicesShape[i] != updatesShape[i])
+      return emitError("Indices and updates must have the same shape");
+
+  // 'axis' must be in [-rank, rank-1]
+  int64_t axisIndex = axis();
+  if (axisIndex < -dataRank || axisIndex >= dataRank)
+    return emitError("ScatterElements axis value out of bound");
+  // Convert a negative axis to a positive axis.
+  if (axisIndex < 0) {
+    axisIndex += dataRank;
+    auto builder = mlir::Builder(getContext());
+    axisAttr(IntegerAttr::get(builder.getIntegerType(64, /*isSigned=*/true),
+        APInt(64, /*value=*/axisIndex, /*isSigned=*/true)));
+  }
+
+  // The output is an updated copy of the input.
+  getResult().setType(dataType);
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// ScatterND
+//===----------------------------------------------------------------------===//
+
+/// Infer the output shape of the ONNXScatterNDOp. This method is required by
+/// the shape inference interface.
+LogicalResult ONNXScatterNDOp::inferShapes() {
+  // Cannot infer shape if no shape exists.
+  if (!data().getType().isa<RankedTensorType>())
+    return emitError("Input tensor not ranked");
+  if (!indices().getType().isa<RankedTensorType>())
+    return emitError("Indices tensor not ranked");
+  if (!updates().getType().isa<RankedTensorType>())
+    return emitError("Updates tensor not ranked");
+
+  auto dataType = data().getType().cast<RankedTensorType>();
+  auto indicesShape = indices().getType().cast<RankedTensorType>().getShape();
+  int64_t dataRank = dataType.getRank();
+  int64_t indicesRank = indicesShape.size();
+  int64_t updatesRank = updates().getType().cast<RankedTensorType>().getRank();
+  if (dataRank < 1 || indicesRank < 1)
+    return emitError("Input and indices tensors must have rank >= 1");
+
+  // The last dimension of the indices is the length of the index tuples.
+  int64_t tupleSize = indicesShape.back();
+  if (tupleSize != -1) {
+    if (tupleSize > dataRank)
+      return emitError("Index tuples longer than the rank of the input");
+    if (updatesRank != indicesRank - 1 + dataRank - tupleSize)
+      return emitError("Updates tensor has an unexpected rank");
+  }
+
+  // The output is an updated copy of the input.
+  getResult().setType(dataType);
+  return success();
+}
+
 //===----------------------------------------------------------------------===//
 // ConstantOfShape
 //===----------------------------------------------------------------------===//
@@ -3169,6 +3443,360 @@ LogicalResult ONNXLessOp::inferShapes() {
   return success();
 }
 
+//===----------------------------------------------------------------------===//
+// LayoutTransform
+//===----------------------------------------------------------------------===//
+/// Transforming a tensor into a layout and back is the identity.
+OpFoldResult ONNXLayoutTransformOp::fold(ArrayRef<Attribute> operands) {
+  auto inputTransform = data().getDefiningOp<ONNXLayoutTransformOp>();
+  if (inputTransform && inputTransform.block_size() == block_size() &&
+      inputTransform.data().getType() == getResult().getType())
+    return inputTransform.data();
+  return nullptr;
+}
+
+//===----------------------------------------------------------------------===//
+// Gelu
+//===----------------------------------------------------------------------===//
+/// Infer the output shape of the ONNXGeluOp. This method is required by the
+/// shape inference interface.
+LogicalResult ONNXGeluOp::inferShapes() {
+  getResult().setType(getOperand().getType());
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// FastGelu
+//===----------------------------------------------------------------------===//
+/// Infer the output shape of the ONNXFastGeluOp. This method is required by
+/// the shape inference interface.
+LogicalResult ONNXFastGeluOp::inferShapes() {
+  getResult().setType(getOperand().getType());
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// LayerNormalization
+//===----------------------------------------------------------------------===//
+/// Infer the output shape of the ONNXLayerNormalizationOp. This method is
+/// required by the shape inference interface.
+LogicalResult ONNXLayerNormalizationOp::inferShapes() {
+  getResult().setType(X().getType());
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// SparseMatMul
+//===----------------------------------------------------------------------===//
+/// Infer the output shape of the ONNXSparseMatMulOp. This method is required
+/// by the shape inference interface.
+LogicalResult ONNXSparseMatMulOp::inferShapes() {
+  auto rowPointersType = row_pointers().getType().dyn_cast<RankedTensorType>();
+  if (!A().getType().isa<RankedTensorType>() || !rowPointersType)
+    return emitError("Input tensor(s) not ranked");
+  auto aType = A().getType().cast<RankedTensorType>();
+  if (aType.getRank() < 1 || rowPointersType.getRank() != 1 ||
+      rowPointersType.isDynamicDim(0))
+    return emitError("Unsupported sparse matrix multiplication operands");
+
+  // The rows of A times the columns of W.
+  SmallVector<int64_t, 4> outputShape(
+      aType.getShape().begin(), aType.getShape().end() - 1);
+  outputShape.emplace_back(rowPointersType.getDimSize(0) - 1);
+  getResult().setType(
+      RankedTensorType::get(outputShape, aType.getElementType()));
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// EmbeddingBag
+//===----------------------------------------------------------------------===//
+/// Infer the output shape of the ONNXEmbeddingBagOp. This method is required
+/// by the shape inference interface.
+LogicalResult ONNXEmbeddingBagOp::inferShapes() {
+  if (!data().getType().isa<RankedTensorType>() ||
+      !indices().getType().isa<RankedTensorType>())
+    return emitError("Input tensor(s) not ranked");
+  auto dataType = data().getType().cast<RankedTensorType>();
+  auto indicesShape = indices().getType().cast<RankedTensorType>().getShape();
+  if (dataType.getRank() < 1 || indicesShape.empty())
+    return emitError("Data and indices must have at least one dimension");
+  if (mode() != "sum" && mode() != "mean")
+    return emitError("Unsupported reduction mode");
+
+  // The bags of the indices followed by the rows of the data.
+  SmallVector<int64_t, 4> outputShape(
+      indicesShape.begin(), indicesShape.end() - 1);
+  if (keepdims() == 1)
+    outputShape.emplace_back(1);
+  outputShape.append(
+      dataType.getShape().begin() + 1, dataType.getShape().end());
+  getResult().setType(
+      RankedTensorType::get(outputShape, dataType.getElementType()));
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// ImagePreprocess
+//===----------------------------------------------------------------------===//
+/// Infer the output shape of the ONNXImagePreprocessOp. This method is
+/// required by the shape inference interface.
+LogicalResult ONNXImagePreprocessOp::inferShapes() {
+  if (!X().getType().isa<RankedTensorType>())
+    return emitError("Input tensor not ranked");
+  auto inputShape = X().getType().cast<RankedTensorType>().getShape();
+  if (inputShape.size() != 4)
+    return emitError("Input tensor must be a 4D image");
+  if (layout() != "NHWC" && layout() != "NCHW")
+    return emitError("Unsupported image layout");
+
+  SmallVector<int64_t, 4> outputShape(inputShape.begin(), inputShape.end());
+  if (layout() == "NHWC")
+    outputShape = {inputShape[0], inputShape[3], inputShape[1], inputShape[2]};
+  int64_t numChannels = outputShape[1];
+  for (auto attr : {mean(), std()})
+    if (attr.size() != 1 && numChannels >= 0 &&
+        (int64_t)attr.size() != numChannels)
+      return emitError("Mean and std must have one value or one value per "
+                       "channel");
+
+  getResult().setType(RankedTensorType::get(
+      outputShape, FloatType::getF32(getContext())));
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Resize and Upsample
+//===----------------------------------------------------------------------===//
+
+// Compute the shape of a resized tensor, of which each dimension is
+// floor(input_dimension * scale) for the constant scales, or unknown.
+static LogicalResult inferScaledShape(Operation *op, Value input, Value scales,
+    SmallVectorImpl<int64_t> &dims) {
+  auto inputTy = input.getType().cast<RankedTensorType>();
+  int64_t rank = inputTy.getRank();
+  dims.assign(rank, -1);
+  auto constantOp = getONNXConstantOp(scales);
+  if (!constantOp)
+    return success();
+  DenseElementsAttr valueAttribute =
+      constantOp.valueAttr().dyn_cast<DenseElementsAttr>();
+  if (!valueAttribute)
+    return op->emitError("DenseElementsAttr expected");
+  // Empty scales are found along constant sizes.
+  if (valueAttribute.getNumElements() == 0)
+    return success();
+  if (valueAttribute.getNumElements() != rank)
+    return op->emitError("Scales must have one value per dimension");
+  auto valueIt = valueAttribute.getValues<APFloat>().begin();
+  for (int64_t i = 0; i < rank; ++i) {
+    float scale = (*valueIt++).convertToFloat();
+    if (scale <= 0)
+      return op->emitError("Scales must be positive");
+    int64_t inputDim = inputTy.getShape()[i];
+    if (inputDim >= 0)
+      dims[i] = static_cast<int64_t>(floor(inputDim * scale));
+  }
+  return success();
+}
+
+LogicalResult ONNXResizeOp::inferShapes() {
+  if (!X().getType().isa<RankedTensorType>())
+    return emitError("Input tensor not ranked");
+  auto inputTy = X().getType().cast<RankedTensorType>();
+
+  // Constant sizes give the output shape, and the scales are ignored.
+  SmallVector<int64_t, 4> dims;
+  if (auto constantOp = getONNXConstantOp(sizes())) {
+    DenseElementsAttr valueAttribute =
+        constantOp.valueAttr().dyn_cast<DenseElementsAttr>();
+    if (!valueAttribute)
+      return emitError("DenseElementsAttr expected");
+    if (valueAttribute.getNumElements() != inputTy.getRank())
+      return emitError("Sizes must have one value per dimension");
+    for (auto size : valueAttribute.getValues<IntegerAttr>())
+      dims.emplace_back(size.getInt());
+  } else if (sizes().getType().isa<NoneType>()) {
+    if (failed(inferScaledShape(getOperation(), X(), scales(), dims)))
+      return failure();
+  } else {
+    dims.assign(inputTy.getRank(), -1);
+  }
+
+  getResult().setType(RankedTensorType::get(dims, inputTy.getElementType()));
+  return success();
+}
+
+LogicalResult ONNXUpsampleOp::inferShapes() {
+  if (!X().getType().isa<RankedTensorType>())
+    return emitError("Input tensor not ranked");
+  auto inputTy = X().getType().cast<RankedTensorType>();
+
+  SmallVector<int64_t, 4> dims;
+  if (failed(inferScaledShape(getOperation(), X(), scales(), dims)))
+    return failure();
+  getResult().setType(RankedTensorType::get(dims, inputTy.getElementType()));
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// TopK
+//===----------------------------------------------------------------------===//
+
+LogicalResult ONNXTopKOp::inferShapes() {
+  if (!X().getType().isa<RankedTensorType>())
+    return emitError("Input tensor not ranked");
+
+  auto inputTy = X().getType().cast<RankedTensorType>();
+  int64_t rank = inputTy.getRank();
+  int64_t axisValue = axis();
+  if (axisValue < -rank || axisValue >= rank)
+    return emitError("Axis out of the rank of the input");
+  if (axisValue < 0)
+    axisValue += rank;
+
+  // The dimension of the axis is K when it is a constant.
+  SmallVector<int64_t, 4> dims(
+      inputTy.getShape().begin(), inputTy.getShape().end());
+  dims[axisValue] = -1;
+  if (auto constantOp = getONNXConstantOp(K())) {
+    DenseElementsAttr valueAttribute =
+        constantOp.valueAttr().dyn_cast<DenseElementsAttr>();
+    if (!valueAttribute || valueAttribute.getNumElements() != 1)
+      return emitError("K must be a tensor of one element");
+    dims[axisValue] =
+        (*valueAttribute.getValues<IntegerAttr>().begin()).getInt();
+    if (dims[axisValue] < 0)
+      return emitError("K must not be negative");
+  }
+
+  auto builder = mlir::Builder(getContext());
+  Values().setType(RankedTensorType::get(dims, inputTy.getElementType()));
+  Indices().setType(RankedTensorType::get(dims, builder.getIntegerType(64)));
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Einsum
+//===----------------------------------------------------------------------===//
+
+LogicalResult ONNXEinsumOp::parseEquation(
+    SmallVectorImpl<std::string> &inputLabels, std::string &outputLabels) {
+  std::string spec;
+  for (char c : equation())
+    if (!llvm::isSpace(c))
+      spec.push_back(c);
+  StringRef specRef(spec);
+  if (specRef.contains('.'))
+    return failure();
+
+  // The terms of the inputs are separated by commas, the output term follows
+  // the arrow.
+  StringRef inputsRef, outputRef;
+  bool isExplicit = specRef.contains("->");
+  std::tie(inputsRef, outputRef) = specRef.split("->");
+  SmallVector<StringRef, 2> terms;
+  inputsRef.split(terms, ',');
+  if (terms.size() != getNumOperands())
+    return failure();
+  std::map<char, int> numUses;
+  inputLabels.clear();
+  for (StringRef term : terms) {
+    if (!llvm::all_of(term, [](char c) { return llvm::isAlpha(c); }))
+      return failure();
+    for (char label : term)
+      ++numUses[label];
+    inputLabels.emplace_back(term.str());
+  }
+
+  // The output of an implicit equation has the labels used once, in the
+  // alphabetical order in which the map holds them.
+  outputLabels.clear();
+  if (!isExplicit) {
+    for (auto &numUse : numUses)
+      if (numUse.second == 1)
+        outputLabels.push_back(numUse.first);
+    return success();
+  }
+  for (char label : outputRef) {
+    if (!numUses.count(label) || StringRef(outputLabels).contains(label))
+      return failure();
+    outputLabels.push_back(label);
+  }
+  return success();
+}
+
+/// Infer the output shape of the ONNXEinsumOp. This method is required by the
+/// shape inference interface.
+LogicalResult ONNXEinsumOp::inferShapes() {
+  for (Value input : Inputs())
+    if (!input.getType().isa<RankedTensorType>())
+      return emitError("Input tensor(s) not ranked");
+  SmallVector<std::string, 2> inputLabels;
+  std::string outputLabels;
+  if (failed(parseEquation(inputLabels, outputLabels)))
+    return emitError("Unsupported Einsum equation");
+
+  // The dimensions with the same label have the same size.
+  std::map<char, int64_t> dims;
+  for (auto input : llvm::enumerate(Inputs())) {
+    auto shape = input.value().getType().cast<RankedTensorType>().getShape();
+    const std::string &labels = inputLabels[input.index()];
+    if (labels.size() != shape.size())
+      return emitError("Einsum term does not match the rank of its input");
+    for (unsigned i = 0; i < labels.size(); ++i) {
+      auto it = dims.find(labels[i]);
+      if (it == dims.end() || it->second == -1)
+        dims[labels[i]] = shape[i];
+      else if (shape[i] != -1 && shape[i] != it->second)
+        return emitError("Einsum dimensions of the same label differ");
+    }
+  }
+
+  SmallVector<int64_t, 4> outputDims;
+  for (char label : outputLabels)
+    outputDims.emplace_back(dims[label]);
+  auto elementType =
+      getOperand(0).getType().cast<RankedTensorType>().getElementType();
+  getResult().setType(RankedTensorType::get(outputDims, elementType));
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// IfRegion
+//===----------------------------------------------------------------------===//
+
+/// Infer the output shapes of the ONNXIfRegionOp. This method is required by
+/// the shape inference interface. The operations of the branches are inferred
+/// before it, and the dimensions of a result on which the branches disagree
+/// are dynamic.
+LogicalResult ONNXIfRegionOp::inferShapes() {
+  Operation *thenYield = then_branch().front().getTerminator();
+  Operation *elseYield = else_branch().front().getTerminator();
+  if (thenYield->getNumOperands() != getNumResults() ||
+      elseYield->getNumOperands() != getNumResults())
+    return emitError("Branches do not yield a value per result");
+  for (unsigned i = 0; i < getNumResults(); ++i) {
+    auto thenType =
+        thenYield->getOperand(i).getType().dyn_cast<RankedTensorType>();
+    auto elseType =
+        elseYield->getOperand(i).getType().dyn_cast<RankedTensorType>();
+    if (!thenType || !elseType)
+      return emitError("Branch output tensor(s) not ranked");
+    if (thenType.getRank() != elseType.getRank() ||
+        thenType.getElementType() != elseType.getElementType())
+      return emitError("Branches yield tensors of different types");
+    SmallVector<int64_t, 4> dims;
+    for (unsigned d = 0; d < thenType.getRank(); ++d)
+      dims.emplace_back(thenType.getShape()[d] == elseType.getShape()[d]
+                            ? thenType.getShape()[d]
+                            : -1);
+    getResult(i).setType(
+        RankedTensorType::get(dims, thenType.getElementType()));
+  }
+  return success();
+}
+
 //===----------------------------------------------------------------------===//
 // ONNX type related code
 //===----------------------------------------------------------------------===//
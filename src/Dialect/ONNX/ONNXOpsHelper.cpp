@@ -86,3 +86,35 @@ mlir::Type convertONNXTypeToMLIRType(
     return nullptr;
   }
 }
+
+// Transpose the value of a 2-D constant. Elements stored on a whole number of
+// bytes are moved as raw data, so that large weights are never expanded into
+// attributes.
+DenseElementsAttr transposeMatrix(DenseElementsAttr value) {
+  auto type = value.getType();
+  int64_t rows = type.getDimSize(0), cols = type.getDimSize(1);
+  auto transposedType =
+      RankedTensorType::get({cols, rows}, type.getElementType());
+  if (value.isSplat())
+    return value.reshape(transposedType);
+
+  auto bitWidth = type.getElementTypeBitWidth();
+  if (bitWidth % 8 == 0) {
+    auto eltSize = bitWidth / 8;
+    ArrayRef<char> rawData = value.getRawData();
+    std::vector<char> transposedData(rawData.size());
+    for (int64_t i = 0; i < rows; ++i)
+      for (int64_t j = 0; j < cols; ++j)
+        std::copy_n(rawData.begin() + (i * cols + j) * eltSize, eltSize,
+            transposedData.begin() + (j * rows + i) * eltSize);
+    return DenseElementsAttr::getFromRawBuffer(
+        transposedType, transposedData, /*isSplatBuffer=*/false);
+  }
+
+  SmallVector<Attribute, 16> values(value.getValues<Attribute>());
+  SmallVector<Attribute, 16> transposedValues(values.size());
+  for (int64_t i = 0; i < rows; ++i)
+    for (int64_t j = 0; j < cols; ++j)
+      transposedValues[j * rows + i] = values[i * cols + j];
+  return DenseElementsAttr::get(transposedType, transposedValues);
+}
@@ -37,3 +37,7 @@ AffineMap getConvDimMap(Builder &builder, bool ceilMode);
 
 mlir::Type convertONNXTypeToMLIRType(
     mlir::OpBuilder &builder_, onnx::TensorProto_DataType onnxType);
+
+// Transpose the value of a 2-D constant, e.g. to pack the weights of a Gemm
+// at compile time.
+mlir::DenseElementsAttr transposeMatrix(mlir::DenseElementsAttr value);
@@ -1,3 +1,5 @@
+#include "mlir/Conversion/SCFToGPU/SCFToGPUPass.h"
+#include "mlir/Dialect/GPU/Passes.h"
 #include "mlir/Pass/Pass.h"
 
 namespace onnx_mlir {
@@ -21,5 +23,15 @@ void initMLIRPasses() {
       []() -> std::unique_ptr<mlir::Pass> {
         return mlir::createConvertVectorToLLVMPass();
       });
+  mlir::registerPass("convert-parallel-loops-to-gpu",
+      "Convert the mapped SCF parallel loops to GPU launches.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createParallelLoopToGpuPass();
+      });
+  mlir::registerPass("gpu-kernel-outlining",
+      "Outline the bodies of GPU launches into GPU kernels.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createGpuKernelOutliningPass();
+      });
 }
 } // namespace onnx_mlir
\ No newline at end of file
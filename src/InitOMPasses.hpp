@@ -25,12 +25,103 @@ void initOMPasses() {
         return mlir::createConstPropONNXToONNXPass();
       });
 
+  mlir::registerPass("simplify-shape-computations",
+      "Fold the shape computations of ONNX operations on static shapes, "
+      "iterated with shape inference.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createSimplifyShapeComputationsPass();
+      });
+
   mlir::registerPass("attribute-promotion",
       "Promote constant operands to attributes.",
       []() -> std::unique_ptr<mlir::Pass> {
         return mlir::createAttributePromotionPass();
       });
 
+  mlir::registerPass("fuse-onnx-elementwise",
+      "Fuse chains of element-wise ONNX operations.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createElementwiseFusionPass();
+      });
+
+  mlir::registerPass("fuse-conv-epilogue",
+      "Fuse residual additions and activations into convolutions.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createConvEpilogueFusionPass();
+      });
+
+  mlir::registerPass("fuse-onnx-attention",
+      "Fuse scaled dot-product attentions into single operations.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createAttentionFusionPass();
+      });
+
+  mlir::registerPass("prepack-weights",
+      "Transpose the constant weights of Gemm operations at compile time.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createPrepackWeightsPass();
+      });
+
+  mlir::registerPass("convert-weights-precision",
+      "Convert the f32 constant weights of matrix multiplications and "
+      "convolutions to half-precision floats.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createConvertWeightsPrecisionPass();
+      });
+
+  mlir::registerPass("sparsify-weights",
+      "Store the sparse constant weights of matrix multiplications in the "
+      "compressed sparse row format.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createSparsifyWeightsPass();
+      });
+
+  mlir::registerPass("report-op-costs",
+      "Report the FLOPs, bytes read and written and roofline times of the "
+      "ONNX operations.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createReportOpCostsPass();
+      });
+
+  mlir::registerPass("assign-nchwc-layout",
+      "Compute CNN regions in the NCHW[x]c layout.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createLayoutAssignmentPass();
+      });
+
+  mlir::registerPass("pin-input-shapes",
+      "Pin the dimensions of the inputs of the entry point functions.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createPinInputShapesPass();
+      });
+
+  mlir::registerPass("preprocess-inputs",
+      "Declare raw images as the inputs of the entry point functions and "
+      "convert them to normalized f32 NCHW images in the functions.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createPreprocessInputsPass();
+      });
+
+  mlir::registerPass("specialize-batch-sizes",
+      "Specialize the entry point functions for batch sizes.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createSpecializeBatchSizesPass();
+      });
+
+  mlir::registerPass("specialize-sequence-lengths",
+      "Specialize the entry point functions for sequence lengths, optionally "
+      "padding the inputs to the smallest one they fit in.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createSpecializeSequenceLengthsPass();
+      });
+
+  mlir::registerPass("kv-cache-append",
+      "Return the entries appended to the key and value caches of the entry "
+      "point functions rather than the whole caches.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createKVCacheAppendPass();
+      });
+
   mlir::registerPass("elide-constants", "Elide values of constant operations.",
       []() -> std::unique_ptr<mlir::Pass> {
         return mlir::createElideConstantValuePass();
@@ -48,6 +139,87 @@ void initOMPasses() {
         return mlir::createKrnlBundleMemoryPoolsPass();
       });
 
+  mlir::registerPass("optimize-memory-pools",
+      "Reuse the memory of static memory pools across internal MemRefs with "
+      "disjoint live ranges.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createKrnlOptimizeMemoryPoolsPass();
+      });
+
+  mlir::registerPass("early-dealloc",
+      "Deallocate MemRefs right after their last use instead of the end of "
+      "their block.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createKrnlEarlyDeallocPass();
+      });
+
+  mlir::registerPass("report-memory-plan",
+      "Report the sizes and live ranges of the buffers of the functions and "
+      "embed the peak memory of the model.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createReportMemoryPlanPass();
+      });
+
+  mlir::registerPass("approximate-math",
+      "Expand f32 exp, log and tanh operations into vectorizable polynomial "
+      "approximations.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createApproximateMathPass();
+      });
+
+  mlir::registerPass("fuse-krnl-loops",
+      "Fuse producer and consumer Krnl loop nests iterating over the same "
+      "space.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createKrnlFuseLoopsPass();
+      });
+
+  mlir::registerPass("hoist-krnl-loop-invariants",
+      "Hoist the loop-invariant code out of the Krnl loop nests.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createKrnlHoistLoopInvariantsPass();
+      });
+
+  mlir::registerPass("outline-krnl-partitions",
+      "Outline the partitions of the functions into functions compiled in "
+      "parallel.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createKrnlOutlinePartitionsPass();
+      });
+
+  mlir::registerPass("parallel-branches",
+      "Run the independent Krnl loop nests of a function in the branches of a "
+      "parallel loop.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createKrnlParallelBranchesPass();
+      });
+
+  mlir::registerPass("outline-parallel-loops",
+      "Outline the parallel loops into functions run on the threads of the "
+      "runtime.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createKrnlOutlineParallelLoopsPass();
+      });
+
+  mlir::registerPass("map-parallel-loops-to-gpu",
+      "Map the parallel loops onto the blocks and the threads of a GPU.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createMapParallelLoopsToGPUPass();
+      });
+
+  mlir::registerPass("use-memory-arena",
+      "Allocate memory pools from a runtime arena kept across invocations.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createKrnlUseMemoryArenaPass();
+      });
+
+  mlir::registerPass("emit-output-buffer-entry-point",
+      "Emit an entry point writing the results into caller-provided output "
+      "tensors.",
+      []() -> std::unique_ptr<mlir::Pass> {
+        return mlir::createEmitOutputBufferEntryPointPass();
+      });
+
   mlir::registerPass("convert-krnl-to-affine", "Lower Krnl dialect.",
       []() -> std::unique_ptr<mlir::Pass> {
         return mlir::createConvertKrnlToAffinePass();
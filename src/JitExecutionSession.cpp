@@ -0,0 +1,109 @@
+//===---- JitExecutionSession.cpp - JitExecutionSession Implementation ----===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementations of JitExecutionSession class, which
+// compiles a model in the running process with the MLIR execution engine
+// instead of producing and loading a shared library.
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdexcept>
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/TargetSelect.h"
+#include "mlir/ExecutionEngine/OptUtils.h"
+#include "mlir/Pass/PassManager.h"
+
+#include "src/JitExecutionSession.hpp"
+#include "src/MainUtils.hpp"
+
+namespace onnx_mlir {
+
+JitExecutionSession::JitExecutionSession(
+    std::string modelPath, std::string entryPointName) {
+  mlir::MLIRContext context;
+  registerDialects(context);
+  mlir::OwningModuleRef module;
+  processInputFile(modelPath, EmitLib, context, module);
+  if (!module)
+    throw std::runtime_error("Cannot load model: " + modelPath);
+  // The compiled code does not refer to the module nor to its context.
+  compile(*module, entryPointName);
+}
+
+JitExecutionSession::JitExecutionSession(
+    mlir::ModuleOp module, std::string entryPointName) {
+  compile(module, entryPointName);
+}
+
+void JitExecutionSession::compile(
+    mlir::ModuleOp module, std::string entryPointName) {
+  mlir::PassManager pm(module.getContext());
+  addONNXToMLIRPasses(pm);
+  addONNXToKrnlPasses(pm, /*packConstants=*/false);
+  addKrnlToAffinePasses(pm);
+  addKrnlToLLVMPasses(pm);
+  if (mlir::failed(pm.run(module)))
+    throw std::runtime_error("Cannot lower the model to the LLVM dialect");
+
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  // Optimize as the bitcode of the shared libraries is.
+  auto transformer = mlir::makeOptimizingTransformer(
+      /*optLevel=*/3, /*sizeLevel=*/0, /*targetMachine=*/nullptr);
+  std::string runtimeLibPath = getRuntimeDir() + "/libomruntime.so";
+  llvm::StringRef sharedLibPaths[] = {runtimeLibPath};
+  auto maybeEngine = mlir::ExecutionEngine::create(module,
+      /*llvmModuleBuilder=*/nullptr, transformer,
+      /*jitCodeGenOptLevel=*/llvm::CodeGenOpt::Aggressive, sharedLibPaths);
+  if (!maybeEngine)
+    throw std::runtime_error(
+        "Cannot compile model: " + llvm::toString(maybeEngine.takeError()));
+  _engine = std::move(maybeEngine.get());
+
+  auto entryPointFunc = _engine->lookup(entryPointName);
+  if (!entryPointFunc)
+    throw std::runtime_error("Cannot load symbol '" + entryPointName + "': " +
+                             llvm::toString(entryPointFunc.takeError()));
+  _packedEntryPointFunc = entryPointFunc.get();
+
+  // The entry point writing into output buffers is optional.
+  auto intoEntryPointFunc = _engine->lookup(entryPointName + "_into");
+  if (intoEntryPointFunc)
+    _packedIntoEntryPointFunc = intoEntryPointFunc.get();
+  else
+    llvm::consumeError(intoEntryPointFunc.takeError());
+}
+
+OMTensorList *JitExecutionSession::invokeEntryPoint(OMTensorList *input) {
+  OMTensorList *output = nullptr;
+  void *args[] = {&input, &output};
+  _packedEntryPointFunc(args);
+  return output;
+}
+
+bool JitExecutionSession::hasIntoEntryPoint() const {
+  return _packedIntoEntryPointFunc != nullptr;
+}
+
+void JitExecutionSession::invokeIntoEntryPoint(
+    OMTensorList *input, OMTensorList *output) {
+  OMTensorList *result = nullptr;
+  void *args[] = {&input, &output, &result};
+  _packedIntoEntryPointFunc(args);
+}
+
+JitExecutionSession::~JitExecutionSession() {
+  // Models compiled with a memory arena keep their memory pools in the arena
+  // of the running thread, release it before the code is freed.
+  dlerror();
+  auto arenaReleaseFunc =
+      (arenaReleaseFuncType)dlsym(RTLD_DEFAULT, "omArenaRelease");
+  if (!dlerror() && arenaReleaseFunc)
+    arenaReleaseFunc();
+}
+} // namespace onnx_mlir
@@ -0,0 +1,60 @@
+//===------ JitExecutionSession.hpp - JitExecutionSession Declaration -----===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declarations of JitExecutionSession class, which compiles
+// a model in the running process with the MLIR execution engine instead of
+// producing and loading a shared library.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "mlir/ExecutionEngine/ExecutionEngine.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Module.h"
+
+#include "src/Runtime/ExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+// An ExecutionSession running a model JIT-compiled in process. The runtime
+// functions called by the model are resolved from libomruntime.so in the
+// runtime directory, and the constants of the model are kept in the code
+// rather than packed into a file.
+class JitExecutionSession : public ExecutionSession {
+public:
+  // Compile an ONNX model or a model specified in MLIR, the extension of the
+  // file being the decider.
+  JitExecutionSession(std::string modelPath, std::string entryPointName);
+
+  // Compile a module of the ONNX dialect, which is lowered in place.
+  JitExecutionSession(mlir::ModuleOp module, std::string entryPointName);
+
+  ~JitExecutionSession();
+
+protected:
+  OMTensorList *invokeEntryPoint(OMTensorList *input) override;
+
+  bool hasIntoEntryPoint() const override;
+
+  void invokeIntoEntryPoint(
+      OMTensorList *input, OMTensorList *output) override;
+
+private:
+  void compile(mlir::ModuleOp module, std::string entryPointName);
+
+  // The execution engine owns the compiled code of the model.
+  std::unique_ptr<mlir::ExecutionEngine> _engine;
+
+  // Entry points taking a pointer to each of their arguments and to their
+  // result.
+  void (*_packedEntryPointFunc)(void **) = nullptr;
+  void (*_packedIntoEntryPointFunc)(void **) = nullptr;
+};
+} // namespace onnx_mlir
@@ -11,15 +11,30 @@
 #include <cstdio>
 #include <cstdlib>
 #include <fcntl.h>
-#include <regex>
+#include <set>
 #include <string>
 #include <vector>
 
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/MC/MCSubtargetInfo.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Parallel.h>
+#include <llvm/Support/Process.h>
 #include <llvm/Support/Program.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
 #include <mlir/Dialect/LLVMIR/LLVMDialect.h>
 #include <mlir/IR/SymbolTable.h>
 
+#include "src/CompileReport.hpp"
 #include "src/ExternalUtil.hpp"
 #include "src/MainUtils.hpp"
 
@@ -32,6 +47,323 @@
 using namespace std;
 using namespace onnx_mlir;
 
+// This definition is here rather than in main.cpp because otherwise it's not
+// found probably should be pulled out to a more common location
+// TODO: Find a respectable home for the wain
+llvm::cl::OptionCategory OnnxMlirOptions(
+    "ONNX MLIR Options", "These are frontend options.");
+// the option is used in this file, so defined here
+llvm::cl::opt<bool> preserveLocations("preserveLocations",
+    llvm::cl::desc("emit location data:"), llvm::cl::init(false),
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> printIR("printIR",
+    llvm::cl::desc("print the IR to stdout:"), llvm::cl::init(false),
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableMatMulTiling("enable-matmul-tiling",
+    llvm::cl::desc("tile the loops of matrix multiplications for the cache "
+                   "and the registers:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableElementwiseFusion("enable-elementwise-fusion",
+    llvm::cl::desc("fuse chains of element-wise operations into a single "
+                   "loop nest:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableInPlaceElementwise("enable-in-place-elementwise",
+    llvm::cl::desc("let the results of element-wise operations overwrite an "
+                   "input which has no other use instead of allocating a new "
+                   "buffer:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableParallelBranches("enable-parallel-branches",
+    llvm::cl::desc("run the loop nests of independent branches of the graph "
+                   "in the iterations of parallel loops, ignored with "
+                   "--num-threads=1; the buffers of the branches are all "
+                   "live at once, which increases the memory of the memory "
+                   "pools:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<int64_t> numThreads("num-threads",
+    llvm::cl::desc("maximum number of threads running each parallel loop, "
+                   "the calling thread included: 0 runs them on all the "
+                   "threads of the runtime, set by ONNX_MLIR_NUM_THREADS, "
+                   "1 runs them sequentially:"),
+    llvm::cl::init(1), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<int64_t> blasThreshold("blas-threshold",
+    llvm::cl::desc("call the BLAS library for the f32 matrix products of "
+                   "static shapes of MatMul, Gemm and Conv with at least this "
+                   "number of multiply-accumulates (0 disables it):"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<int64_t> unrollThreshold("unroll-threshold",
+    llvm::cl::desc("fully unroll the loops of the element-wise operations of "
+                   "static shapes with at most this number of elements, and "
+                   "of MatMul and Gemm with at most this number of "
+                   "multiply-accumulates (0 disables it):"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> blasLibrary("blas-library",
+    llvm::cl::desc("BLAS library providing cblas_sgemm, linked as "
+                   "-l<library> into models calling it, e.g. openblas, "
+                   "mkl_rt or blis:"),
+    llvm::cl::init("openblas"), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableKrnlLoopFusion("enable-krnl-loop-fusion",
+    llvm::cl::desc("fuse the loop nests of consecutive operations iterating "
+                   "over the same space, removing their intermediate "
+                   "buffers:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableFastMath("enable-fast-math",
+    llvm::cl::desc("expand exp, log and tanh into polynomial approximations "
+                   "of at most 2 ulp of error instead of math library "
+                   "calls:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableConvEpilogueFusion("enable-conv-epilogue-fusion",
+    llvm::cl::desc("apply the residual additions and activations following "
+                   "convolutions to each output element of the convolutions:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableAttentionFusion("enable-attention-fusion",
+    llvm::cl::desc("compute the scaled dot-product attentions of transformer "
+                   "models one block of keys at a time, without their score "
+                   "matrices:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableKVCacheAppend("enable-kv-cache-append",
+    llvm::cl::desc("return the new entries of the key and value caches that "
+                   "decoder models concatenate with their past entries, "
+                   "instead of the concatenations:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<int> vectorBits("vector-bits",
+    llvm::cl::desc("number of bits of the vectors used by element-wise "
+                   "operations, 0 disables vectorization and -1 uses the "
+                   "widest vectors of the target CPU:"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> mcpu("mcpu",
+    llvm::cl::desc("target CPU of the generated code, e.g. skylake-avx512 or "
+                   "native, the default being a generic CPU of the target "
+                   "architecture:"),
+    llvm::cl::value_desc("cpu-name"), llvm::cl::init(""),
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> mattr("mattr",
+    llvm::cl::desc("comma-separated target features to enable (+feature) or "
+                   "disable (-feature) in the generated code, e.g. +avx2:"),
+    llvm::cl::value_desc("a1,+a2,-a3,..."), llvm::cl::init(""),
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> march("march",
+    llvm::cl::desc("target architecture of the generated code, the default "
+                   "being the architecture of the host:"),
+    llvm::cl::init(""), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> convStrategy("conv-strategy",
+    llvm::cl::desc("strategy used to lower convolutions: direct, im2col, "
+                   "winograd or auto, which picks Winograd where it is "
+                   "eligible and cheaper than im2col, else im2col:"),
+    llvm::cl::init("direct"), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> tuningDatabase("tuning-database",
+    llvm::cl::desc("lower the operations of the shapes tuned for the target "
+                   "CPU with the tile sizes and loop orders of the given "
+                   "tuning database, see OMBench --tune-model for its "
+                   "generation:"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""),
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> weightsPrecision("weights-precision",
+    llvm::cl::desc("float type in which the constant weights of matrix "
+                   "multiplications and convolutions are stored: f32, bf16 "
+                   "or f16, the products being accumulated in f32:"),
+    llvm::cl::init("f32"), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<double> sparseWeightsThreshold("sparse-weights-threshold",
+    llvm::cl::desc("minimum fraction of zeros of the constant weights of "
+                   "matrix multiplications which are stored in the "
+                   "compressed sparse row format and multiplied by their "
+                   "non-zero elements only, e.g. 0.8 (0 disables it):"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> opCostReport("op-cost-report",
+    llvm::cl::desc("write the FLOPs, bytes read and written, arithmetic "
+                   "intensity and roofline time of the ONNX operations of "
+                   "the model, sorted by decreasing cost, into a JSON file, "
+                   "or - for the standard error:"),
+    llvm::cl::init(""), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<double> rooflinePeakGFlops("roofline-peak-gflops",
+    llvm::cl::desc("peak GFLOP/s of the target of the roofline times of the "
+                   "op cost report:"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<double> rooflineBandwidthGBps("roofline-bandwidth-gbps",
+    llvm::cl::desc("memory bandwidth in GB/s of the target of the roofline "
+                   "times of the op cost report:"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> enableMemoryArena("enable-memory-arena",
+    llvm::cl::desc("keep the memory pools in a thread-local runtime arena "
+                   "across invocations of the model:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> memoryPlanReport("memory-plan-report",
+    llvm::cl::desc("write the sizes, live ranges and memory pool offsets of "
+                   "the buffers of the model into a JSON file, or - for the "
+                   "standard error:"),
+    llvm::cl::init(""), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<int64_t> maxActivationMemory("max-activation-memory",
+    llvm::cl::desc("fail the compilation when the peak memory of the buffers "
+                   "of the model exceeds this number of bytes, 0 for no "
+                   "limit:"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> emitOutputBufferEntryPoint(
+    "emit-output-buffer-entry-point",
+    llvm::cl::desc("also emit an entry point writing the results into "
+                   "caller-provided output tensors:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> emitTypedEntryPoint("emit-typed-entry-point",
+    llvm::cl::desc("also emit an entry point taking the raw data pointers of "
+                   "the statically shaped inputs and outputs, declared in a "
+                   "generated header next to the shared library:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::list<std::string> shapeInputs("shape-inputs",
+    llvm::cl::desc("pin the dynamic dimensions of the inputs of the model, "
+                   "given as comma-separated <input index>:<dims> with the "
+                   "dimensions separated by x and ? leaving a dimension "
+                   "dynamic, e.g. 0:1x3x224x224:"),
+    llvm::cl::ZeroOrMore, llvm::cl::CommaSeparated,
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::list<std::string> preprocessInputs("preprocess-inputs",
+    llvm::cl::desc("declare raw images as the inputs of the model instead of "
+                   "its f32 NCHW images, given as comma-separated <input "
+                   "index> followed by :layout=nhwc|nchw, :dtype=ui8|i8|f32, "
+                   ":mean=<values> and :std=<values> with the values of the "
+                   "channels separated by /, e.g. "
+                   "0:layout=nhwc:dtype=ui8:mean=127.5:std=127.5:"),
+    llvm::cl::ZeroOrMore, llvm::cl::CommaSeparated,
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::list<int64_t> specializeBatchSizes("specialize-batch-sizes",
+    llvm::cl::desc("also emit versions of the inference function specialized "
+                   "for the given comma-separated batch sizes, called when "
+                   "the leading dimension of the inputs matches:"),
+    llvm::cl::ZeroOrMore, llvm::cl::CommaSeparated,
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::list<int64_t> specializeSequenceLengths(
+    "specialize-sequence-lengths",
+    llvm::cl::desc("also emit versions of the inference function specialized "
+                   "for the given comma-separated sequence lengths of the "
+                   "second dimension of the inputs, called when the inputs "
+                   "match:"),
+    llvm::cl::ZeroOrMore, llvm::cl::CommaSeparated,
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> padSequenceLengths("pad-sequence-lengths",
+    llvm::cl::desc("pad the inputs with zeros to the smallest sequence length "
+                   "of --specialize-sequence-lengths they fit in, the outputs "
+                   "having the padded length:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::list<std::string> importOutputNames("outputs",
+    llvm::cl::desc("import only the given comma-separated outputs of the "
+                   "model, and the nodes they depend on:"),
+    llvm::cl::ZeroOrMore, llvm::cl::CommaSeparated,
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> mmapConstants("mmap-constants",
+    llvm::cl::desc("keep the packed constants in a file next to the shared "
+                   "library and memory-map it at run time:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> lazyConstants("lazy-constants",
+    llvm::cl::desc("materialize each packed constant on its first use instead "
+                   "of loading all the constants on every invocation:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<int64_t> compressConstants("compress-constants",
+    llvm::cl::desc("compress the packed constants with zlib in chunks of the "
+                   "given number of bytes, decompressed by the runtime when "
+                   "the model is loaded, 0 keeps them uncompressed:"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> foldStaticMemRefs("fold-static-memrefs",
+    llvm::cl::desc("use constants for the offsets, sizes and strides of the "
+                   "statically shaped MemRef arguments of the lowered "
+                   "functions instead of their descriptor fields:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> annotateBuffers("annotate-buffers",
+    llvm::cl::desc("mark the inputs and outputs of the model noalias, which "
+                   "requires them not to overlap, and align the memory pools "
+                   "so that LLVM vectorizes without runtime checks:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<int64_t> parallelMemcpyThreshold("parallel-memcpy-threshold",
+    llvm::cl::desc("split the copies of at least the given number of bytes "
+                   "across the memory copy threads of the runtime, 0 copies "
+                   "on the calling thread only:"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> narrowIndices("narrow-indices",
+    llvm::cl::desc("compute the element offsets of the accesses to the "
+                   "statically shaped tensors of fewer than 2^31 elements "
+                   "in 32 bits, which vectorizes gathers and scatters with "
+                   "twice as many lanes:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<int> nchwcBlockSize("nchwc-block-size",
+    llvm::cl::desc("compute the convolutions and the operations consuming them "
+                   "in the NCHW[x]c layout with blocks of the given number of "
+                   "channels, 0 keeps the NCHW layout:"),
+    llvm::cl::init(0), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<bool> instrumentONNXOps("instrument",
+    llvm::cl::desc("time the code of each ONNX operation at run time, see "
+                   "OMInstrument.h for the functions writing the profile:"),
+    llvm::cl::init(false), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<unsigned> codegenPartitions("codegen-partitions",
+    llvm::cl::desc("split the optimized LLVM module into the given number of "
+                   "modules compiled to object files in parallel, 0 uses one "
+                   "module per hardware thread:"),
+    llvm::cl::init(1), llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<unsigned> compileJobs("j",
+    llvm::cl::desc("run the passes on the given number of threads, the loop "
+                   "nests of the model being outlined into as many functions "
+                   "compiled in parallel, 1 runs them on one thread, 0 keeps "
+                   "the model in one function:"),
+    llvm::cl::value_desc("threads"), llvm::cl::init(0),
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> compileCacheDir("compile-cache",
+    llvm::cl::desc("restore the outputs of compilations of the same model "
+                   "with the same compiler and options from the given cache "
+                   "directory, where the outputs of other compilations are "
+                   "stored:"),
+    llvm::cl::value_desc("directory"), llvm::cl::init(""),
+    llvm::cl::cat(OnnxMlirOptions));
+
+llvm::cl::opt<std::string> compileReport("compile-report",
+    llvm::cl::desc("write the wall time, peak resident set size and number of "
+                   "operations before and after each compiler pass into the "
+                   "given JSON file:"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""),
+    llvm::cl::cat(OnnxMlirOptions));
+
 namespace {
 
 llvm::Optional<std::string> getEnvVar(std::string name) {
@@ -40,40 +372,43 @@ llvm::Optional<std::string> getEnvVar(std::string name) {
   return llvm::None;
 }
 
-// Runtime directory contains all the libraries, jars, etc. that are
-// necessary for running onnx-mlir. It's resolved in the following order:
-//
-//   - if ONNX_MLIR_RUNTIME_DIR is set, use it, otherwise
-//   - get path from where onnx-mlir is run, if it's of the form
-//   /foo/bar/bin/onnx-mlir,
-//     the runtime directory is /foo/bar/lib (note that when onnx-mlir is
-//     installed system wide, which is typically /usr/local/bin, this will
-//     correctly resolve to /usr/local/lib), but some systems still have
-//     lib64 so we check that first. If neither exists, then
-//   - use CMAKE_INSTALL_PREFIX/lib, which is typically /usr/local/lib
-string getRuntimeDir() {
-  const auto &envDir = getEnvVar("ONNX_MLIR_RUNTIME_DIR");
-  if (envDir && llvm::sys::fs::exists(envDir.getValue()))
-    return envDir.getValue();
-
-  string execDir = llvm::sys::path::parent_path(kExecPath).str();
-  if (llvm::sys::path::stem(execDir).str().compare("bin") == 0) {
-    string p = execDir.substr(0, execDir.size() - 3);
-    if (llvm::sys::fs::exists(p + "lib64"))
-      return p + "lib64";
-    if (llvm::sys::fs::exists(p + "lib"))
-      return p + "lib";
+// Size in bits of the widest vector registers of the host CPU.
+int getHostVectorBits() {
+  llvm::StringMap<bool> features;
+  if (llvm::sys::getHostCPUFeatures(features)) {
+    if (features.lookup("avx512f"))
+      return 512;
+    if (features.lookup("avx"))
+      return 256;
   }
+  return 128;
+}
 
-  llvm::SmallString<8> instDir64(kInstPath);
-  llvm::sys::path::append(instDir64, "lib64");
-  string p = llvm::StringRef(instDir64).str();
-  if (llvm::sys::fs::exists(p))
-    return p;
-
-  llvm::SmallString<8> instDir(kInstPath);
-  llvm::sys::path::append(instDir, "lib");
-  return llvm::StringRef(instDir).str();
+// Size in bits of the widest vector registers of the CPU targeted by the
+// --mcpu, --mattr and --march options, the host CPU by default.
+int getTargetVectorBits() {
+  if (march.empty() && (mcpu.empty() || mcpu == "native") && mattr.empty())
+    return getHostVectorBits();
+
+  // Only the native target is registered, the vectors of other architectures
+  // are assumed to be 128 bits wide.
+  llvm::InitializeNativeTarget();
+  llvm::Triple triple(llvm::sys::getDefaultTargetTriple());
+  string error;
+  const llvm::Target *target =
+      llvm::TargetRegistry::lookupTarget(march, triple, error);
+  if (!target || !triple.isX86())
+    return 128;
+  string cpu = mcpu == "native" ? llvm::sys::getHostCPUName().str() : mcpu;
+  std::unique_ptr<llvm::MCSubtargetInfo> subtargetInfo(
+      target->createMCSubtargetInfo(triple.getTriple(), cpu, mattr));
+  if (!subtargetInfo)
+    return 128;
+  if (subtargetInfo->checkFeatures("+avx512f"))
+    return 512;
+  if (subtargetInfo->checkFeatures("+avx"))
+    return 256;
+  return 128;
 }
 
 // Helper struct to make command construction and execution easy & readable.
@@ -132,6 +467,57 @@ struct Command {
 };
 } // namespace
 
+string getTuningTarget() {
+  llvm::Triple triple(llvm::sys::getDefaultTargetTriple());
+  string arch = march.empty() ? triple.getArchName().str() : string(march);
+  // Without --mcpu, the code runs on the host CPU, or on a generic CPU of
+  // another architecture.
+  string cpu = mcpu;
+  if (cpu == "native" || (cpu.empty() && march.empty()))
+    cpu = llvm::sys::getHostCPUName().str();
+  else if (cpu.empty())
+    cpu = "generic";
+  return arch + ":" + cpu;
+}
+
+void setTuningDatabase(string fileName) { tuningDatabase = fileName; }
+
+// Runtime directory contains all the libraries, jars, etc. that are
+// necessary for running onnx-mlir. It's resolved in the following order:
+//
+//   - if ONNX_MLIR_RUNTIME_DIR is set, use it, otherwise
+//   - get path from where onnx-mlir is run, if it's of the form
+//   /foo/bar/bin/onnx-mlir,
+//     the runtime directory is /foo/bar/lib (note that when onnx-mlir is
+//     installed system wide, which is typically /usr/local/bin, this will
+//     correctly resolve to /usr/local/lib), but some systems still have
+//     lib64 so we check that first. If neither exists, then
+//   - use CMAKE_INSTALL_PREFIX/lib, which is typically /usr/local/lib
+string getRuntimeDir() {
+  const auto &envDir = getEnvVar("ONNX_MLIR_RUNTIME_DIR");
+  if (envDir && llvm::sys::fs::exists(envDir.getValue()))
+    return envDir.getValue();
+
+  string execDir = llvm::sys::path::parent_path(kExecPath).str();
+  if (llvm::sys::path::stem(execDir).str().compare("bin") == 0) {
+    string p = execDir.substr(0, execDir.size() - 3);
+    if (llvm::sys::fs::exists(p + "lib64"))
+      return p + "lib64";
+    if (llvm::sys::fs::exists(p + "lib"))
+      return p + "lib";
+  }
+
+  llvm::SmallString<8> instDir64(kInstPath);
+  llvm::sys::path::append(instDir64, "lib64");
+  string p = llvm::StringRef(instDir64).str();
+  if (llvm::sys::fs::exists(p))
+    return p;
+
+  llvm::SmallString<8> instDir(kInstPath);
+  llvm::sys::path::append(instDir, "lib");
+  return llvm::StringRef(instDir).str();
+}
+
 void setExecPath(const char *argv0, void *fmain) {
   string p;
   if (!(p = llvm::sys::fs::getMainExecutable(argv0, fmain)).empty())
@@ -160,8 +546,23 @@ void LoadMLIR(string inputFilename, mlir::MLIRContext &context,
   }
 }
 
+// Record the name of the constant pack file in the module being compiled.
+void setConstPackFileName(
+    const mlir::OwningModuleRef &module, const string &constPackFileName) {
+  mlir::Builder builder(*module);
+  (*module)
+      .lookupSymbol<mlir::LLVM::GlobalOp>(
+          mlir::KrnlPackedConstantOp::getConstPackFileNameSymbolName())
+      .valueAttr(builder.getStringAttr(constPackFileName));
+  (*module)
+      .lookupSymbol<mlir::LLVM::GlobalOp>(
+          mlir::KrnlPackedConstantOp::getConstPackFileNameStrLenSymbolName())
+      .valueAttr(builder.getI64IntegerAttr(constPackFileName.size()));
+}
+
 void genConstPackObj(const mlir::OwningModuleRef &module,
-    llvm::Optional<string> &constPackObjPath, string outputBaseName) {
+    llvm::Optional<string> &constPackObjPath, string outputBaseName,
+    bool keepInFile = false) {
   // Extract constant pack file name, which is embedded as a symbol in the
   // module being compiled.
   auto constPackFilePathSym = (*module).lookupSymbol<mlir::LLVM::GlobalOp>(
@@ -172,6 +573,18 @@ void genConstPackObj(const mlir::OwningModuleRef &module,
                                .str();
   llvm::FileRemover constPackRemover(constPackFilePath);
 
+  if (keepInFile) {
+    /* The constant pack is kept in a file next to the shared library, which
+     * the runtime maps in memory. No object file is generated, and the file
+     * name is recorded relative to the directory of the shared library.
+     */
+    string permConstPackFilePath = outputBaseName + ".constants.bin";
+    llvm::sys::fs::copy_file(constPackFilePath, permConstPackFilePath);
+    setConstPackFileName(
+        module, llvm::sys::path::filename(permConstPackFilePath).str());
+    return;
+  }
+
 #if __APPLE__
   // Create a empty stub file, compile it to an empty obj file.
   llvm::SmallVector<char, 20> stubSrcPath;
@@ -195,31 +608,31 @@ void genConstPackObj(const mlir::OwningModuleRef &module,
       .exec();
 
 #elif __linux__
-  // Create param.o holding packed parameter values.
+  /* Create param.o holding packed parameter values, in a read-only section
+   * aligned on pages so that the runtime uses the constants where the shared
+   * library is mapped instead of copying them: the pages are only read from
+   * the file when the constants are first used, and are shared by the
+   * processes loading the model.
+   */
   constPackObjPath = constPackFilePath + ".o";
-  Command genParamObj(/*exePath=*/kLinkerPath);
-  genParamObj.appendStr("-r")
-      .appendList({"-b", "binary"})
+  string constPackAsmPath = constPackFilePath + ".s";
+  llvm::FileRemover constPackAsmRemover(constPackAsmPath);
+  {
+    error_code error;
+    llvm::raw_fd_ostream constPackAsm(
+        constPackAsmPath, error, llvm::sys::fs::F_None);
+    constPackAsm << "  .section .rodata.param,\"a\",@progbits\n"
+                 << "  .balign 4096\n"
+                 << "  .globl _binary_param_bin_start\n"
+                 << "_binary_param_bin_start:\n"
+                 << "  .incbin \"" << constPackFilePath << "\"\n"
+                 << "  .globl _binary_param_bin_end\n"
+                 << "_binary_param_bin_end:\n"
+                 << "  .section .note.GNU-stack,\"\",@progbits\n";
+  }
+  Command genParamObj(/*exePath=*/kCxxPath);
+  genParamObj.appendList({"-c", constPackAsmPath})
       .appendList({"-o", constPackObjPath.getValue()})
-      .appendStr(constPackFilePath)
-      .exec();
-
-  // Figure out what is the default symbol name describing the start/end
-  // address of the embedded data.
-  std::regex e("[^0-9A-Za-z]");
-  auto sanitizedName =
-      "_binary_" + std::regex_replace(constPackFilePath, e, "_");
-
-  // Rename the symbols to saner ones expected by the runtime function.
-  Command redefineSym(/*exePath=*/kObjCopyPath);
-  redefineSym.appendStr("--redefine-sym")
-      .appendStr(sanitizedName + "_start=_binary_param_bin_start")
-      .appendStr(constPackObjPath.getValue())
-      .exec();
-  redefineSym.resetArgs()
-      .appendStr("--redefine-sym")
-      .appendStr(sanitizedName + "_end=_binary_param_bin_end")
-      .appendStr(constPackObjPath.getValue())
       .exec();
 
 #else
@@ -237,19 +650,22 @@ void genConstPackObj(const mlir::OwningModuleRef &module,
   auto constPackFileName = llvm::sys::path::filename(outputBaseName) + "." +
                            llvm::sys::path::filename(permConstPackFileNameStr);
   llvm::sys::fs::rename(constPackFilePath, constPackFileName);
-
-  mlir::Builder builder(*module);
-  (*module)
-      .lookupSymbol<mlir::LLVM::GlobalOp>(
-          mlir::KrnlPackedConstantOp::getConstPackFileNameSymbolName())
-      .valueAttr(builder.getStringAttr(constPackFileName.str()));
-  (*module)
-      .lookupSymbol<mlir::LLVM::GlobalOp>(
-          mlir::KrnlPackedConstantOp::getConstPackFileNameStrLenSymbolName())
-      .valueAttr(builder.getI64IntegerAttr(constPackFileName.str().size()));
+  setConstPackFileName(module, constPackFileName.str());
 #endif
 }
 
+// Flags of opt and llc selecting the target of the generated code.
+std::vector<string> getTargetFlags() {
+  std::vector<string> flags;
+  if (!march.empty())
+    flags.emplace_back("-march=" + march);
+  if (!mcpu.empty())
+    flags.emplace_back("-mcpu=" + mcpu);
+  if (!mattr.empty())
+    flags.emplace_back("-mattr=" + mattr);
+  return flags;
+}
+
 // Write LLVM optimized bitcode.
 void genLLVMBitcode(const mlir::OwningModuleRef &module,
     string optimizedBitcodePath, string outputBaseName) {
@@ -270,6 +686,7 @@ void genLLVMBitcode(const mlir::OwningModuleRef &module,
   // Use the LLVM's 'opt' command to optimize the bitcode.
   Command optBitcode(/*exePath=*/kOptPath);
   optBitcode.appendStr("-O3")
+      .appendList(getTargetFlags())
       .appendList({"-o", optimizedBitcodePath})
       .appendStr(unoptimizedBitcodePath)
       .exec();
@@ -281,11 +698,64 @@ void genModelObject(const mlir::OwningModuleRef &module, string bitcodePath,
   Command llvmToObj(/*exePath=*/kLlcPath);
   llvmToObj.appendStr("-filetype=obj")
       .appendStr("-relocation-model=pic")
+      .appendList(getTargetFlags())
       .appendList({"-o", modelObjPath})
       .appendStr(bitcodePath)
       .exec();
 }
 
+// Compile LLVM bitcode to object files, splitting the module into
+// `codegenPartitions` modules compiled in parallel. The symbols shared by the
+// partitions are made external, so that the object files are linked together.
+std::vector<string> genModelObjects(const mlir::OwningModuleRef &module,
+    string bitcodePath, string outputBaseName) {
+  unsigned numPartitions = codegenPartitions;
+  if (numPartitions == 0)
+    numPartitions = llvm::hardware_concurrency().compute_thread_count();
+  if (numPartitions <= 1) {
+    string modelObjPath = outputBaseName + ".o";
+    genModelObject(module, bitcodePath, modelObjPath);
+    return {modelObjPath};
+  }
+
+  llvm::LLVMContext llvmContext;
+  llvm::SMDiagnostic diagnostic;
+  auto llvmModule = llvm::parseIRFile(bitcodePath, diagnostic, llvmContext);
+  if (!llvmModule) {
+    diagnostic.print(bitcodePath.c_str(), llvm::errs());
+    llvm_unreachable("Failed to read the optimized bitcode.");
+  }
+
+  std::vector<string> partitionBitcodePaths;
+  llvm::SplitModule(*llvmModule, numPartitions,
+      [&](std::unique_ptr<llvm::Module> partition) {
+        string partitionBitcodePath = outputBaseName + ".part" +
+                                      to_string(partitionBitcodePaths.size()) +
+                                      ".bc";
+        error_code error;
+        llvm::raw_fd_ostream partitionBitcodeStream(
+            partitionBitcodePath, error, llvm::sys::fs::F_None);
+        llvm::WriteBitcodeToFile(*partition, partitionBitcodeStream);
+        partitionBitcodePaths.emplace_back(partitionBitcodePath);
+      });
+
+  // Run one llc per partition.
+  std::vector<string> modelObjPaths;
+  for (unsigned i = 0; i < partitionBitcodePaths.size(); ++i)
+    modelObjPaths.emplace_back(outputBaseName + ".part" + to_string(i) + ".o");
+  {
+    llvm::ThreadPool pool(llvm::hardware_concurrency(numPartitions));
+    for (unsigned i = 0; i < partitionBitcodePaths.size(); ++i)
+      pool.async([&, i]() {
+        genModelObject(module, partitionBitcodePaths[i], modelObjPaths[i]);
+      });
+    pool.wait();
+  }
+  for (const auto &partitionBitcodePath : partitionBitcodePaths)
+    llvm::sys::fs::remove(partitionBitcodePath);
+  return modelObjPaths;
+}
+
 void genJniObject(const mlir::OwningModuleRef &module, string jniSharedLibPath,
     string jniObjPath) {
   Command ar(/*exePath=*/kArPath);
@@ -324,25 +794,128 @@ void genJniJar(const mlir::OwningModuleRef &module, string modelSharedLibPath,
   jar.appendList({"uf", modelJniJarPath}).appendStr(modelSharedLibPath).exec();
 }
 
+// Return the C type of the elements of a MemRef.
+static string getCElementType(mlir::Type elementType) {
+  if (elementType.isF32())
+    return "float";
+  if (elementType.isF64())
+    return "double";
+  if (elementType.isInteger(1))
+    return "bool";
+  if (auto intType = elementType.dyn_cast<mlir::IntegerType>())
+    return (intType.isUnsigned() ? "uint" : "int") +
+           std::to_string(intType.getWidth()) + "_t";
+  // Half precision floats are passed as their bits.
+  return "uint" + std::to_string(elementType.getIntOrFloatBitWidth()) + "_t";
+}
+
+// Write the declarations of the typed entry points of the module in a header
+// next to the shared library. The static shapes of the inputs and outputs are
+// spelled as array parameters:
+//
+//   void run_main_graph_typed(const float input0[1][3][224][224],
+//       float output0[1][1000]);
+void genTypedEntryPointHeader(
+    const mlir::OwningModuleRef &module, std::string outputBaseName) {
+  std::string declarations;
+  llvm::raw_string_ostream os(declarations);
+  for (auto func : (*module).getOps<mlir::LLVM::LLVMFuncOp>()) {
+    auto argTypes = func.getAttrOfType<mlir::ArrayAttr>(
+        mlir::KrnlEntryPointOp::getTypedEntryPointAttrName());
+    if (!argTypes)
+      continue;
+    // The outputs are the trailing arguments.
+    size_t numInputs = argTypes.size() -
+                       func.getAttrOfType<mlir::IntegerAttr>(
+                               mlir::KrnlEntryPointOp::getNumOutputsAttrName())
+                           .getInt();
+
+    os << "void " << func.getName() << "(";
+    for (size_t i = 0; i < argTypes.size(); ++i) {
+      auto memRefType = argTypes[i]
+                            .cast<mlir::TypeAttr>()
+                            .getValue()
+                            .cast<mlir::MemRefType>();
+      bool isInput = i < numInputs;
+      if (i > 0)
+        os << ", ";
+      os << (isInput ? "const " : "")
+         << getCElementType(memRefType.getElementType()) << " ";
+      if (memRefType.getRank() == 0)
+        os << "*";
+      os << (isInput ? "input" : "output") << (isInput ? i : i - numInputs);
+      for (int64_t dim : memRefType.getShape())
+        os << "[" << dim << "]";
+    }
+    os << ");\n";
+  }
+  if (os.str().empty())
+    return;
+
+  error_code error;
+  llvm::raw_fd_ostream header(
+      outputBaseName + ".h", error, llvm::sys::fs::F_None);
+  header << "// Typed entry points of "
+         << llvm::sys::path::filename(outputBaseName) << ".so.\n"
+         << "#pragma once\n\n"
+         << "#include <stdbool.h>\n"
+         << "#include <stdint.h>\n\n"
+         << "#ifdef __cplusplus\n"
+         << "extern \"C\" {\n"
+         << "#endif\n\n"
+         << os.str() << "\n"
+         << "#ifdef __cplusplus\n"
+         << "}\n"
+         << "#endif\n";
+}
+
+// Link the BLAS library into models whose matrix products call it.
+static void addBlasLibrary(
+    const mlir::OwningModuleRef &module, std::vector<string> &libs) {
+  if ((*module).lookupSymbol<mlir::LLVM::LLVMFuncOp>(
+          mlir::KrnlBlasGemmOp::getGemmFuncName()))
+    libs.emplace_back("-l" + blasLibrary.getValue());
+}
+
 void compileModuleToSharedLibrary(
     const mlir::OwningModuleRef &module, std::string outputBaseName) {
+  if (emitTypedEntryPoint)
+    genTypedEntryPointHeader(module, outputBaseName);
 
   llvm::Optional<string> constPackObjPath;
-  genConstPackObj(module, constPackObjPath, outputBaseName);
-  llvm::FileRemover constPackObjRemover(constPackObjPath.getValue());
+  genConstPackObj(module, constPackObjPath, outputBaseName, mmapConstants);
+  llvm::FileRemover constPackObjRemover(constPackObjPath.getValueOr(""));
 
   string bitcodePath = outputBaseName + ".bc";
   genLLVMBitcode(module, bitcodePath, outputBaseName);
   llvm::FileRemover bitcodeRemover(bitcodePath);
 
-  string modelObjPath = outputBaseName + ".o";
-  genModelObject(module, bitcodePath, modelObjPath);
-  llvm::FileRemover modelObjRemover(modelObjPath);
+  std::vector<string> modelObjPaths =
+      genModelObjects(module, bitcodePath, outputBaseName);
+
+  // Constants kept in a file are mapped by the external data loader.
+  std::vector<string> objs = modelObjPaths;
+  if (constPackObjPath.hasValue())
+    objs.insert(objs.begin(), constPackObjPath.getValue());
+  std::vector<string> libs = {"-lEmbeddedDataLoader", "-lcruntime"};
+  if (mmapConstants)
+    libs = {"-lExternalDataLoader", "-lcruntime", "-ldl"};
+  // Compressed constants are decompressed by the data loaders with zlib, on
+  // several threads.
+  if (compressConstants > 0)
+    libs.emplace_back("-lz");
+  // The runtime splits the large copies across its threads.
+  libs.emplace_back("-lpthread");
+  addBlasLibrary(module, libs);
+#ifdef __linux__
+  // The data loaders may share the constant pool in POSIX shared memory.
+  libs.emplace_back("-lrt");
+#endif
 
   string modelSharedLibPath = outputBaseName + ".so";
-  genSharedLib(module, modelSharedLibPath, {"-shared", "-fPIC"},
-      {constPackObjPath.getValueOr(""), modelObjPath},
-      {"-lEmbeddedDataLoader", "-lcruntime"});
+  genSharedLib(module, modelSharedLibPath, {"-shared", "-fPIC"}, objs, libs);
+  for (const auto &modelObjPath : modelObjPaths)
+    llvm::sys::fs::remove(modelObjPath);
 }
 
 void compileModuleToJniJar(
@@ -356,21 +929,32 @@ void compileModuleToJniJar(
   genLLVMBitcode(module, bitcodePath, outputBaseName);
   llvm::FileRemover bitcodeRemover(bitcodePath);
 
-  string modelObjPath = outputBaseName + ".o";
-  genModelObject(module, bitcodePath, modelObjPath);
-  llvm::FileRemover modelObjRemover(modelObjPath);
+  std::vector<string> modelObjPaths =
+      genModelObjects(module, bitcodePath, outputBaseName);
 
   string jniSharedLibPath = getRuntimeDir() + "/libjniruntime.a";
   string jniObjPath = "jnidummy.c.o";
   genJniObject(module, jniSharedLibPath, jniObjPath);
   llvm::FileRemover jniObjRemover(jniObjPath);
 
+  std::vector<string> objs = {constPackObjPath.getValueOr("")};
+  objs.insert(objs.end(), modelObjPaths.begin(), modelObjPaths.end());
+  objs.emplace_back(jniObjPath);
+  std::vector<string> libs = {
+      "-lEmbeddedDataLoader", "-lcruntime", "-ljniruntime"};
+  if (compressConstants > 0)
+    libs.emplace_back("-lz");
+  libs.emplace_back("-lpthread");
+  addBlasLibrary(module, libs);
+#ifdef __linux__
+  libs.emplace_back("-lrt");
+#endif
   string modelSharedLibPath = "libmodel.so";
   genSharedLib(module, modelSharedLibPath,
-      {"-shared", "-fPIC", "-z", "noexecstack"},
-      {constPackObjPath.getValueOr(""), modelObjPath, jniObjPath},
-      {"-lEmbeddedDataLoader", "-lcruntime", "-ljniruntime"});
+      {"-shared", "-fPIC", "-z", "noexecstack"}, objs, libs);
   llvm::FileRemover modelSharedLibRemover(modelSharedLibPath);
+  for (const auto &modelObjPath : modelObjPaths)
+    llvm::sys::fs::remove(modelObjPath);
 
   string modelJniJarPath = outputBaseName + ".jar";
   genJniJar(module, modelSharedLibPath, modelJniJarPath);
@@ -379,15 +963,32 @@ void compileModuleToJniJar(
 void registerDialects(mlir::MLIRContext &context) {
   // Load our Dialect in this MLIR Context.
   context.getOrLoadDialect<mlir::AffineDialect>();
+  context.getOrLoadDialect<mlir::gpu::GPUDialect>();
   context.getOrLoadDialect<mlir::LLVM::LLVMDialect>();
   context.getOrLoadDialect<mlir::scf::SCFDialect>();
   context.getOrLoadDialect<mlir::StandardOpsDialect>();
+  context.getOrLoadDialect<mlir::vector::VectorDialect>();
   context.getOrLoadDialect<mlir::shape::ShapeDialect>();
   context.getOrLoadDialect<mlir::ONNXOpsDialect>();
   context.getOrLoadDialect<mlir::KrnlOpsDialect>();
 }
 
 void addONNXToMLIRPasses(mlir::PassManager &pm) {
+  if (!shapeInputs.empty())
+    pm.addPass(mlir::createPinInputShapesPass(shapeInputs));
+  // The normalization of the images is folded into the weights of the first
+  // convolution before the weights are rewritten by the other passes.
+  if (!preprocessInputs.empty())
+    pm.addPass(mlir::createPreprocessInputsPass(preprocessInputs));
+  if (enableKVCacheAppend)
+    pm.addPass(mlir::createKVCacheAppendPass());
+  // The specializations are cloned before shape inference, which then infers
+  // their static shapes.
+  if (!specializeBatchSizes.empty())
+    pm.addPass(mlir::createSpecializeBatchSizesPass(specializeBatchSizes));
+  else if (!specializeSequenceLengths.empty())
+    pm.addPass(mlir::createSpecializeSequenceLengthsPass(
+        specializeSequenceLengths, /*axis=*/1, padSequenceLengths));
   pm.addPass(mlir::createDecomposeONNXToONNXPass());
   pm.addPass(mlir::createConstPropONNXToONNXPass());
   pm.addPass(mlir::createShapeInferencePass());
@@ -398,35 +999,107 @@ void addONNXToMLIRPasses(mlir::PassManager &pm) {
   // There are more opportunities for const propagation once all tensors have
   // inferred shapes.
   pm.addPass(mlir::createConstPropONNXToONNXPass());
+  // Shape computations on the now static shapes fold into constants, from
+  // which more static shapes are inferred.
+  pm.addPass(mlir::createSimplifyShapeComputationsPass());
+  pm.addPass(mlir::createPrepackWeightsPass());
+  // The sparse weights are kept in f32.
+  if (sparseWeightsThreshold > 0)
+    pm.addPass(mlir::createSparsifyWeightsPass(sparseWeightsThreshold));
+  if (weightsPrecision != "f32")
+    pm.addPass(mlir::createConvertWeightsPrecisionPass(weightsPrecision));
   // Clean dead code.
   pm.addPass(mlir::createSymbolDCEPass());
+  // The costs are those of the operations which are lowered.
+  if (!opCostReport.empty())
+    pm.addPass(mlir::createReportOpCostsPass(
+        opCostReport, rooflinePeakGFlops, rooflineBandwidthGBps));
 }
 
-void addONNXToKrnlPasses(mlir::PassManager &pm) {
-  pm.addPass(mlir::createLowerToKrnlPass());
-  pm.addPass(mlir::createPackKrnlGlobalConstantsPass());
+void addONNXToKrnlPasses(mlir::PassManager &pm, bool packConstants) {
+  if (nchwcBlockSize > 0)
+    pm.addPass(mlir::createLayoutAssignmentPass(nchwcBlockSize));
+  if (enableConvEpilogueFusion)
+    pm.addPass(mlir::createConvEpilogueFusionPass());
+  if (enableAttentionFusion)
+    pm.addPass(mlir::createAttentionFusionPass());
+  if (enableElementwiseFusion)
+    pm.addPass(mlir::createElementwiseFusionPass());
+  pm.addPass(mlir::createLowerToKrnlPass(enableMatMulTiling,
+      vectorBits < 0 ? getTargetVectorBits() : vectorBits, convStrategy,
+      instrumentONNXOps, tuningDatabase,
+      tuningDatabase.empty() ? "" : getTuningTarget(),
+      enableInPlaceElementwise, blasThreshold, unrollThreshold));
+  if (packConstants)
+    pm.addPass(mlir::createPackKrnlGlobalConstantsPass(compressConstants));
+  if (enableFastMath)
+    pm.addPass(mlir::createApproximateMathPass());
   // An additional pass of canonicalization is helpful because lowering
   // from ONNX dialect to Standard dialect exposes additional canonicalization
   // oppertunities.
   pm.addPass(mlir::createCanonicalizerPass());
   pm.addPass(createDisconnectKrnlDimFromAllocPass());
+  // Loop nests are fused before their intermediate buffers are placed in
+  // memory pools.
+  if (enableKrnlLoopFusion)
+    pm.addPass(mlir::createKrnlFuseLoopsPass());
+  // Independent loop nests are scheduled before the memory pools are formed,
+  // so that the buffers of concurrent loop nests do not share memory. They
+  // only cost memory if the parallel loops run sequentially.
+  if (enableParallelBranches && numThreads != 1)
+    pm.addPass(mlir::createKrnlParallelBranchesPass());
 
   // TODO: make this pass optional:
   pm.addPass(mlir::createKrnlEnableMemoryPoolPass());
   pm.addPass(mlir::createKrnlBundleMemoryPoolsPass());
+  pm.addPass(mlir::createKrnlOptimizeMemoryPoolsPass());
+  // The memory plan accounts for the MemRefs deallocated at their last use.
+  pm.addPass(mlir::createKrnlEarlyDeallocPass());
+  pm.addPass(
+      mlir::createReportMemoryPlanPass(memoryPlanReport, maxActivationMemory));
+  if (enableMemoryArena)
+    pm.addPass(mlir::createKrnlUseMemoryArenaPass());
+  // The typed entry point calls the inference function writing into output
+  // buffers.
+  if (emitOutputBufferEntryPoint || emitTypedEntryPoint)
+    pm.addPass(mlir::createEmitOutputBufferEntryPointPass(emitTypedEntryPoint));
   pm.addPass(mlir::createCanonicalizerPass());
 }
 
 void addKrnlToAffinePasses(mlir::PassManager &pm) {
+  // The function passes that follow run on the outlined partitions in
+  // parallel, down to the conversion to LLVM.
+  if (compileJobs > 1)
+    pm.addPass(mlir::createKrnlOutlinePartitionsPass(compileJobs));
+  pm.addPass(mlir::createKrnlHoistLoopInvariantsPass());
   pm.addPass(mlir::createConvertKrnlToAffinePass());
-  // Fuse loops in Affine dialect.
-  //  pm.addPass(mlir::createLoopFusionPass());
+  // The code depending on the outer loops of a krnl.iterate is hoisted once
+  // its loops are separate.
+  pm.nest<mlir::FuncOp>().addPass(mlir::createLoopInvariantCodeMotionPass());
+  // Loops are not fused in the Affine dialect: the intermediate buffers are
+  // in memory pools by then and may share memory. See createKrnlFuseLoopsPass.
 }
 
 void addKrnlToLLVMPasses(mlir::PassManager &pm) {
   pm.addPass(mlir::createLowerAffinePass());
+  // The parallel loops are outlined before the conversion to the CFG turns
+  // them into sequential loops.
+  if (numThreads != 1)
+    pm.addPass(mlir::createKrnlOutlineParallelLoopsPass(numThreads));
   pm.addPass(mlir::createLowerToCFGPass());
-  pm.addPass(mlir::createConvertKrnlToLLVMPass());
+  pm.addPass(mlir::createConvertKrnlToLLVMPass(lazyConstants,
+      foldStaticMemRefs, annotateBuffers, parallelMemcpyThreshold,
+      narrowIndices));
+  pm.addPass(mlir::createCanonicalizerPass());
+}
+
+void addKrnlToGPUPasses(mlir::PassManager &pm) {
+  // The parallel loops become the kernels, the rest of the code stays on the
+  // host.
+  pm.addPass(mlir::createLowerAffinePass());
+  pm.addPass(mlir::createMapParallelLoopsToGPUPass());
+  pm.addPass(mlir::createParallelLoopToGpuPass());
+  pm.addPass(mlir::createGpuKernelOutliningPass());
   pm.addPass(mlir::createCanonicalizerPass());
 }
 
@@ -441,26 +1114,14 @@ void processInputFile(string inputFilename, EmissionTargetType emissionTarget,
          "Either ONNX model or MLIR file needs to be provided.");
 
   if (inputIsONNX) {
-    ImportFrontendModelFile(inputFilename, context, module);
+    ImportFrontendModelFile(inputFilename, context, module,
+        std::vector<std::string>(
+            importOutputNames.begin(), importOutputNames.end()));
   } else {
     LoadMLIR(inputFilename, context, module);
   }
 }
 
-// This definition is here rather than in main.cpp because otherwise it's not
-// found probably should be pulled out to a more common location
-// TODO: Find a respectable home for the wain
-llvm::cl::OptionCategory OnnxMlirOptions(
-    "ONNX MLIR Options", "These are frontend options.");
-// the option is used in this file, so defined here
-llvm::cl::opt<bool> preserveLocations("preserveLocations",
-    llvm::cl::desc("emit location data:"), llvm::cl::init(false),
-    llvm::cl::cat(OnnxMlirOptions));
-
-llvm::cl::opt<bool> printIR("printIR",
-    llvm::cl::desc("print the IR to stdout:"), llvm::cl::init(false),
-    llvm::cl::cat(OnnxMlirOptions));
-
 void outputCode(
     mlir::OwningModuleRef &module, string filename, string extension) {
   string tempFilename = filename + extension;
@@ -523,11 +1184,15 @@ void emitOutputFiles(string outputBaseName, EmissionTargetType emissionTarget,
     mlir::PassManager cleanSourcePM(&context);
     if (emissionTarget == EmitONNXIR || emissionTarget == EmitONNXBasic)
       cleanSourcePM.addPass(mlir::createElideConstantValuePass());
-    if (emissionTarget == EmitMLIR)
+    if (emissionTarget == EmitMLIR || emissionTarget == EmitGPUIR)
       cleanSourcePM.addPass(mlir::createElideConstGlobalValuePass());
 
+    if (emissionTarget == EmitGPUIR)
+      printf("The GPU dialect output is a preview, it cannot be compiled or "
+             "run on a GPU yet.\n\n");
+
     if (emissionTarget == EmitONNXBasic || emissionTarget == EmitONNXIR ||
-        emissionTarget == EmitMLIR) {
+        emissionTarget == EmitMLIR || emissionTarget == EmitGPUIR) {
       if (mlir::failed(cleanSourcePM.run(*module)))
         llvm::errs() << "Could not apply simplification passes.\n";
       outputCode(module, outputBaseName, ".tmp");
@@ -540,8 +1205,196 @@ void emitOutputFiles(string outputBaseName, EmissionTargetType emissionTarget,
   }
 }
 
+namespace {
+
+// Return the extensions of the output files of a compilation that are kept in
+// the compilation cache.
+std::vector<string> getCachedOutputExtensions(
+    EmissionTargetType emissionTarget) {
+  if (emissionTarget == EmitLib) {
+    if (mmapConstants)
+      return {".so", ".constants.bin"};
+    return {".so"};
+  }
+  if (emissionTarget == EmitJNI)
+    return {".jar"};
+  return {};
+}
+
+// Add the content of a file to a hash, returning false if the file cannot be
+// read.
+bool hashFile(llvm::SHA1 &hasher, const string &path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return false;
+  hasher.update((*buffer)->getBuffer());
+  return true;
+}
+
+// Add the identity of an executable to a hash, its size and modification
+// time, which change with every build. Returns false if it does not exist.
+bool hashExecutable(llvm::SHA1 &hasher, const string &path) {
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(path, status))
+    return false;
+  hasher.update(path);
+  hasher.update(to_string(status.getSize()));
+  hasher.update(
+      to_string(llvm::sys::toTimeT(status.getLastModificationTime())));
+  return true;
+}
+
+// Whether an argument sets --mcpu, and the number of arguments it takes.
+int getMcpuArgCount(llvm::StringRef arg) {
+  if (arg == "-mcpu" || arg == "--mcpu")
+    return 2;
+  return arg.startswith("-mcpu=") || arg.startswith("--mcpu=") ? 1 : 0;
+}
+} // namespace
+
+string getCompileCacheKey(string inputFilename, string outputBaseName,
+    EmissionTargetType emissionTarget, int argc, char *argv[]) {
+  if (compileCacheDir.empty() ||
+      getCachedOutputExtensions(emissionTarget).empty())
+    return "";
+
+  llvm::SHA1 hasher;
+  if (!hashFile(hasher, inputFilename))
+    return "";
+
+  // The weights stored in external data files are not part of the model.
+  if (llvm::StringRef(inputFilename).endswith(".onnx")) {
+    onnx::ModelProto model;
+    fstream input(inputFilename, ios::in | ios::binary);
+    if (!model.ParseFromIstream(&input))
+      return "";
+    std::set<string> locations;
+    for (const auto &initializer : model.graph().initializer())
+      for (const auto &entry : initializer.external_data())
+        if (entry.key() == "location")
+          locations.insert(entry.value());
+    for (const auto &location : locations) {
+      llvm::SmallString<128> path(llvm::sys::path::parent_path(inputFilename));
+      llvm::sys::path::append(path, location);
+      hasher.update(location);
+      if (!hashFile(hasher, path.str().str()))
+        return "";
+    }
+  }
+
+  // The compiler is identified by its executable and by the tools it runs.
+  if (!hashExecutable(hasher, kExecPath))
+    return "";
+  for (const string &tool :
+      {kOptPath, kLlcPath, kCxxPath, kLinkerPath, kObjCopyPath, kArPath})
+    if (!tool.empty() && !hashExecutable(hasher, tool))
+      hasher.update(tool);
+
+  // The runtime libraries are linked into the cached libraries, and may be
+  // rebuilt without the compiler.
+  string runtimeDir = getRuntimeDir();
+  for (const char *library :
+      {"libcruntime.a", "libEmbeddedDataLoader.a", "libExternalDataLoader.a",
+          "libjniruntime.a"}) {
+    hasher.update(llvm::StringRef(library));
+    hashFile(hasher, runtimeDir + "/" + library);
+  }
+
+  // The code compiled for the host CPU depends on the host the compiler runs
+  // on, rather than on the option.
+  string cpu = mcpu;
+  if (cpu == "native") {
+    cpu = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> features;
+    if (llvm::sys::getHostCPUFeatures(features)) {
+      std::set<string> enabled;
+      for (const auto &feature : features)
+        if (feature.getValue())
+          enabled.insert(feature.getKey().str());
+      for (const auto &feature : enabled)
+        cpu += "," + feature;
+    }
+  }
+  hasher.update("mcpu=" + cpu);
+
+  // Options, except for the input and output files, the cache itself and
+  // --mcpu hashed above. The name of the output files is kept, as it is
+  // recorded in the shared library when the constants are kept in a file next
+  // to it.
+  hasher.update(llvm::sys::path::filename(outputBaseName));
+  for (int i = 1; i < argc; ++i) {
+    llvm::StringRef arg(argv[i]);
+    if (arg == "-o" || arg == "--o" || arg == "-compile-cache" ||
+        arg == "--compile-cache") {
+      ++i;
+      continue;
+    }
+    if (int mcpuArgCount = getMcpuArgCount(arg)) {
+      i += mcpuArgCount - 1;
+      continue;
+    }
+    if (arg == inputFilename || arg.startswith("-o=") ||
+        arg.startswith("--o=") || arg.startswith("-compile-cache=") ||
+        arg.startswith("--compile-cache="))
+      continue;
+    hasher.update(arg);
+    hasher.update(llvm::StringRef("\0", 1));
+  }
+  return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+bool restoreFromCompileCache(string cacheKey, string outputBaseName,
+    EmissionTargetType emissionTarget) {
+  if (cacheKey.empty())
+    return false;
+
+  auto extensions = getCachedOutputExtensions(emissionTarget);
+  for (const auto &extension : extensions) {
+    llvm::SmallString<128> cachedPath(compileCacheDir);
+    llvm::sys::path::append(cachedPath, cacheKey + extension);
+    if (!llvm::sys::fs::exists(cachedPath))
+      return false;
+  }
+  for (const auto &extension : extensions) {
+    llvm::SmallString<128> cachedPath(compileCacheDir);
+    llvm::sys::path::append(cachedPath, cacheKey + extension);
+    if (llvm::sys::fs::copy_file(cachedPath, outputBaseName + extension))
+      return false;
+  }
+  printf("%s%s has been restored from the compilation cache.\n",
+      outputBaseName.c_str(), extensions.front().c_str());
+  return true;
+}
+
+void storeInCompileCache(string cacheKey, string outputBaseName,
+    EmissionTargetType emissionTarget) {
+  if (cacheKey.empty() || llvm::sys::fs::create_directories(compileCacheDir))
+    return;
+
+  // Each file is copied under a temporary name and renamed, so that concurrent
+  // compilations sharing the cache never see partially written files.
+  for (const auto &extension : getCachedOutputExtensions(emissionTarget)) {
+    llvm::SmallString<128> cachedPath(compileCacheDir);
+    llvm::sys::path::append(cachedPath, cacheKey + extension);
+    string tempPath = (llvm::Twine(cachedPath) + ".tmp" +
+                       to_string(llvm::sys::Process::getProcessId()))
+                          .str();
+    if (llvm::sys::fs::copy_file(outputBaseName + extension, tempPath) ||
+        llvm::sys::fs::rename(tempPath, cachedPath)) {
+      llvm::sys::fs::remove(tempPath);
+      return;
+    }
+  }
+}
+
 int compileModule(mlir::OwningModuleRef &module, mlir::MLIRContext &context,
     std::string outputBaseName, EmissionTargetType emissionTarget) {
+  // The pass manager runs the function passes on the functions of the module
+  // with the threads of llvm::parallelForEach.
+  if (compileJobs == 1)
+    context.disableMultithreading();
+  else if (compileJobs > 1)
+    llvm::parallel::strategy = llvm::hardware_concurrency(compileJobs);
   mlir::PassManager pm(&context);
   if (emissionTarget >= EmitONNXIR) {
     addONNXToMLIRPasses(pm);
@@ -552,10 +1405,22 @@ int compileModule(mlir::OwningModuleRef &module, mlir::MLIRContext &context,
     addKrnlToAffinePasses(pm);
   }
 
-  if (emissionTarget >= EmitLLVMIR)
+  if (emissionTarget == EmitGPUIR)
+    addKrnlToGPUPasses(pm);
+  else if (emissionTarget >= EmitLLVMIR)
     addKrnlToLLVMPasses(pm);
 
-  if (mlir::failed(pm.run(*module)))
+  CompileReport *report = nullptr;
+  if (!compileReport.empty()) {
+    auto instrumentation = std::make_unique<CompileReport>(compileReport);
+    report = instrumentation.get();
+    pm.addInstrumentation(std::move(instrumentation));
+  }
+
+  bool passesFailed = mlir::failed(pm.run(*module));
+  if (report)
+    report->write();
+  if (passesFailed)
     return 4;
 
   emitOutputFiles(outputBaseName, emissionTarget, context, module);
@@ -25,7 +25,9 @@
 #include "src/Dialect/ONNX/ONNXOps.hpp"
 #include "src/Pass/Passes.hpp"
 
+#include "mlir/Conversion/SCFToGPU/SCFToGPUPass.h"
 #include "mlir/Conversion/SCFToStandard/SCFToStandard.h"
+#include "mlir/Dialect/GPU/Passes.h"
 #include "mlir/Dialect/Shape/IR/Shape.h"
 #include "mlir/ExecutionEngine/ExecutionEngine.h"
 #include "mlir/ExecutionEngine/OptUtils.h"
@@ -46,10 +48,22 @@ enum EmissionTargetType {
   EmitLLVMIR,
   EmitLib,
   EmitJNI,
+  EmitGPUIR,
 };
 
 void setExecPath(const char *argv0, void *fmain);
 
+// Return the directory of the runtime libraries.
+std::string getRuntimeDir();
+
+// Return the target of the generated code in the tuning databases, made of
+// its architecture and CPU, e.g. x86_64:skylake-avx512.
+std::string getTuningTarget();
+
+// Read the tuning database from the given file in the following
+// compilations, as with --tuning-database.
+void setTuningDatabase(std::string fileName);
+
 void LoadMLIR(std::string inputFilename, mlir::MLIRContext &context,
     mlir::OwningModuleRef &module);
 
@@ -63,12 +77,20 @@ void registerDialects(mlir::MLIRContext &context);
 
 void addONNXToMLIRPasses(mlir::PassManager &pm);
 
-void addONNXToKrnlPasses(mlir::PassManager &pm);
+// Constants are packed into a file loaded at run time unless packConstants is
+// false, in which case they are kept in the code.
+void addONNXToKrnlPasses(mlir::PassManager &pm, bool packConstants = true);
 
 void addKrnlToAffinePasses(mlir::PassManager &pm);
 
 void addKrnlToLLVMPasses(mlir::PassManager &pm);
 
+// Lower the Affine dialect to host code launching the parallel loops as GPU
+// kernels, which are outlined into GPU modules. This is an IR-only preview:
+// the kernels take the host MemRefs, and no device memory, host-device copies
+// or kernel binaries are generated.
+void addKrnlToGPUPasses(mlir::PassManager &pm);
+
 void processInputFile(std::string inputFilename,
     EmissionTargetType emissionTarget, mlir::MLIRContext &context,
     mlir::OwningModuleRef &module);
@@ -80,5 +102,21 @@ void emitOutputFiles(std::string outputBaseName,
     EmissionTargetType emissionTarget, mlir::MLIRContext &context,
     mlir::OwningModuleRef &module);
 
+// Return the key of the outputs of a compilation in the compilation cache,
+// hashing the model, the compiler and the options, or an empty string when
+// there is no cache.
+std::string getCompileCacheKey(std::string inputFilename,
+    std::string outputBaseName, EmissionTargetType emissionTarget, int argc,
+    char *argv[]);
+
+// Copy the outputs of a compilation from the compilation cache, returning
+// false if they are not in the cache.
+bool restoreFromCompileCache(std::string cacheKey, std::string outputBaseName,
+    EmissionTargetType emissionTarget);
+
+// Store the outputs of a compilation in the compilation cache.
+void storeInCompileCache(std::string cacheKey, std::string outputBaseName,
+    EmissionTargetType emissionTarget);
+
 int compileModule(mlir::OwningModuleRef &module, mlir::MLIRContext &context,
     std::string outputBaseName, EmissionTargetType targetType);
@@ -10,7 +10,11 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
+
+#include "mlir/Support/LLVM.h"
 
 namespace mlir {
 class Pass;
@@ -22,21 +26,183 @@ std::unique_ptr<Pass> createShapeInferencePass();
 
 std::unique_ptr<Pass> createConstPropONNXToONNXPass();
 
+/// Pass for folding the shape computations of the ONNX operations whose input
+/// shapes are static, iterated with shape inference until the inferred shapes
+/// no longer change.
+std::unique_ptr<Pass> createSimplifyShapeComputationsPass();
+
 /// Pass for promoting constant operands to attributes.
 std::unique_ptr<Pass> createAttributePromotionPass();
 
+/// Pass for fusing chains of element-wise operations.
+std::unique_ptr<Pass> createElementwiseFusionPass();
+
+/// Pass for fusing residual additions and activations into convolutions.
+std::unique_ptr<Pass> createConvEpilogueFusionPass();
+
+/// Pass for fusing scaled dot-product attentions.
+std::unique_ptr<Pass> createAttentionFusionPass();
+
+/// Pass for prepacking the constant weights of Gemm operations.
+std::unique_ptr<Pass> createPrepackWeightsPass();
+
+/// Pass for converting the f32 constant weights of matrix multiplications and
+/// convolutions to bf16.
+std::unique_ptr<Pass> createConvertWeightsPrecisionPass();
+
+/// Pass for converting the f32 constant weights of matrix multiplications and
+/// convolutions to the given `precision`, bf16 or f16.
+std::unique_ptr<Pass> createConvertWeightsPrecisionPass(StringRef precision);
+
+/// Pass for storing the sparse constant weights of matrix multiplications in
+/// the compressed sparse row format.
+std::unique_ptr<Pass> createSparsifyWeightsPass();
+
+/// Pass for storing the constant weights of matrix multiplications with at
+/// least a `threshold` fraction of zeros in the compressed sparse row format.
+std::unique_ptr<Pass> createSparsifyWeightsPass(double threshold);
+
+/// Pass for reporting the FLOPs, bytes and roofline times of the ONNX
+/// operations.
+std::unique_ptr<Pass> createReportOpCostsPass();
+
+/// Pass for reporting the FLOPs, bytes and roofline times of the ONNX
+/// operations into `reportFile`, for a target of `peakGFlops` GFLOP/s and
+/// `bandwidthGBps` GB/s.
+std::unique_ptr<Pass> createReportOpCostsPass(
+    const std::string &reportFile, double peakGFlops, double bandwidthGBps);
+
+/// Pass for computing CNN regions in the NCHW[x]c layout.
+std::unique_ptr<Pass> createLayoutAssignmentPass();
+
+/// Pass for computing CNN regions in the NCHW[x]c layout with `blockSize`
+/// channels per block.
+std::unique_ptr<Pass> createLayoutAssignmentPass(int64_t blockSize);
+
+/// Pass for pinning the dimensions of the inputs of the entry point functions.
+std::unique_ptr<Pass> createPinInputShapesPass();
+
+/// Pass for pinning the dimensions of the inputs of the entry point functions
+/// to the given `shapes`, as `<input index>:<dims>` with the dimensions
+/// separated by `x` and `?` for a dynamic dimension.
+std::unique_ptr<Pass> createPinInputShapesPass(ArrayRef<std::string> shapes);
+
+/// Pass for preprocessing the image inputs of the entry point functions.
+std::unique_ptr<Pass> createPreprocessInputsPass();
+
+/// Pass for declaring the raw images of the given `specs` as the inputs of the
+/// entry point functions, converted to normalized f32 NCHW images in the
+/// functions.
+std::unique_ptr<Pass> createPreprocessInputsPass(ArrayRef<std::string> specs);
+
+/// Pass for specializing the entry point functions for batch sizes.
+std::unique_ptr<Pass> createSpecializeBatchSizesPass();
+
+/// Pass for specializing the entry point functions for the given batch sizes,
+/// dispatched to from the entry points at run time.
+std::unique_ptr<Pass> createSpecializeBatchSizesPass(
+    ArrayRef<int64_t> batchSizes);
+
+/// Pass for specializing the entry point functions for sequence lengths.
+std::unique_ptr<Pass> createSpecializeSequenceLengthsPass();
+
+/// Pass for specializing the entry point functions for the given sequence
+/// lengths along dimension `axis` of the inputs, dispatched to from the entry
+/// points at run time. With `padInputs`, the inputs are padded to the smallest
+/// sequence length they fit in.
+std::unique_ptr<Pass> createSpecializeSequenceLengthsPass(
+    ArrayRef<int64_t> sequenceLengths, int64_t axis, bool padInputs);
+
+/// Pass for returning the entries appended to the key and value caches of the
+/// entry point functions rather than the whole caches.
+std::unique_ptr<Pass> createKVCacheAppendPass();
+
 /// Pass for eliding the values of constant operations.
 std::unique_ptr<Pass> createElideConstantValuePass();
 
+/// Pass for fusing producer and consumer Krnl loop nests.
+std::unique_ptr<Pass> createKrnlFuseLoopsPass();
+
+/// Pass for hoisting the loop-invariant code out of the Krnl loop nests.
+std::unique_ptr<Pass> createKrnlHoistLoopInvariantsPass();
+
+/// Pass for outlining the partitions of the functions into functions compiled
+/// in parallel.
+std::unique_ptr<Pass> createKrnlOutlinePartitionsPass();
+std::unique_ptr<Pass> createKrnlOutlinePartitionsPass(int64_t numPartitions);
+
+/// Pass for running the independent Krnl loop nests of a function in the
+/// branches of a parallel loop.
+std::unique_ptr<Pass> createKrnlParallelBranchesPass();
+
+/// Pass for outlining the parallel loops into functions run on the threads of
+/// the runtime.
+std::unique_ptr<Pass> createKrnlOutlineParallelLoopsPass();
+std::unique_ptr<Pass> createKrnlOutlineParallelLoopsPass(int64_t numThreads);
+
+/// Pass for mapping the parallel loops onto the blocks and the threads of a
+/// GPU.
+std::unique_ptr<Pass> createMapParallelLoopsToGPUPass();
+
+/// Pass for expanding f32 exp, log and tanh operations into polynomial
+/// approximations.
+std::unique_ptr<Pass> createApproximateMathPass();
+
 /// Pass for enabling a memory pool for MemRefs.
 std::unique_ptr<Pass> createKrnlEnableMemoryPoolPass();
 
 /// Pass for enabling a memory pool for MemRefs.
 std::unique_ptr<Pass> createKrnlBundleMemoryPoolsPass();
 
+/// Pass for reusing memory pool space across MemRefs with disjoint lifetimes.
+std::unique_ptr<Pass> createKrnlOptimizeMemoryPoolsPass();
+
+/// Pass for deallocating MemRefs right after their last use.
+std::unique_ptr<Pass> createKrnlEarlyDeallocPass();
+
+/// Pass for reporting the memory plan of the functions and embedding the peak
+/// memory of the model.
+std::unique_ptr<Pass> createReportMemoryPlanPass();
+
+/// Pass for reporting the memory plan of the functions into `reportFile` and
+/// embedding the peak memory of the model. Fails if the peak memory of a
+/// function exceeds `maxActivationMemory` bytes, unless it is 0.
+std::unique_ptr<Pass> createReportMemoryPlanPass(
+    const std::string &reportFile, int64_t maxActivationMemory);
+
+/// Pass for allocating memory pools from the runtime memory arena.
+std::unique_ptr<Pass> createKrnlUseMemoryArenaPass();
+
+/// Pass for emitting an entry point writing into caller-provided outputs.
+std::unique_ptr<Pass> createEmitOutputBufferEntryPointPass();
+
+/// Pass for emitting an entry point writing into caller-provided outputs,
+/// optionally with a typed entry point taking raw data pointers.
+std::unique_ptr<Pass> createEmitOutputBufferEntryPointPass(
+    bool typedEntryPoint);
+
 /// Add pass for lowering to Krnl IR.
 std::unique_ptr<Pass> createLowerToKrnlPass();
 
+/// Add pass for lowering to Krnl IR, optionally tiling matrix multiplications,
+/// vectorizing element-wise operations with vectors of `vectorBits` bits and
+/// lowering convolutions with `convStrategy` (direct, im2col, winograd or
+/// auto). When `instrument` is set, the code of each ONNX operation is
+/// surrounded by calls to the runtime profiling hook. The entries of
+/// `tuningTarget` in the `tuningDatabase` file override the parameters of the
+/// lowering of the operations of matching shapes. With `inPlaceElementwise`,
+/// the results of element-wise operations reuse the buffer of an input which
+/// has no other use. The f32 matrix products of MatMul, Gemm and Conv of at
+/// least `blasThreshold` multiply-accumulates call the BLAS library when it is
+/// positive. The loops of the element-wise operations of static shapes of at
+/// most `unrollThreshold` elements, and of MatMul and Gemm of at most as many
+/// multiply-accumulates, are fully unrolled when it is positive.
+std::unique_ptr<Pass> createLowerToKrnlPass(bool enableMatMulTiling,
+    int64_t vectorBits = 0, const std::string &convStrategy = "direct",
+    bool instrument = false, const std::string &tuningDatabase = "",
+    const std::string &tuningTarget = "", bool inPlaceElementwise = false,
+    int64_t blasThreshold = 0, int64_t unrollThreshold = 0);
+
 /// Pass for lowering frontend dialects to Krnl IR dialect.
 std::unique_ptr<Pass> createConvertKrnlToAffinePass();
 
@@ -52,7 +218,23 @@ std::unique_ptr<Pass> createElideConstGlobalValuePass();
 /// Pass for lowering Krnl dialect to LLVM dialect.
 std::unique_ptr<Pass> createConvertKrnlToLLVMPass();
 
+/// Pass for lowering Krnl dialect to LLVM dialect, optionally materializing
+/// each packed constant on its first use, replacing the offsets, sizes and
+/// strides of the statically shaped MemRef arguments by constants,
+/// annotating the buffers with aliasing and alignment information,
+/// splitting the copies of at least parallelMemcpyThreshold bytes across
+/// threads, and computing the element offsets of small static MemRefs in 32
+/// bits.
+std::unique_ptr<Pass> createConvertKrnlToLLVMPass(bool lazyConstants,
+    bool foldStaticMemRefs = false, bool annotateBuffers = false,
+    int64_t parallelMemcpyThreshold = 0, bool narrowIndices = false);
+
 /// Pass for packing Krnl global constants.
 std::unique_ptr<Pass> createPackKrnlGlobalConstantsPass();
 
+/// Pass for packing Krnl global constants, compressed in chunks of
+/// `compressionChunkSize` bytes.
+std::unique_ptr<Pass> createPackKrnlGlobalConstantsPass(
+    int64_t compressionChunkSize);
+
 } // end namespace mlir
@@ -0,0 +1,189 @@
+//===--- BatchingExecutionSession.cpp - BatchingExecutionSession Impl -----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementations of BatchingExecutionSession class, which
+// batches the inference requests submitted to a model along their first
+// dimension.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "BatchingExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+BatchingExecutionSession::BatchingExecutionSession(std::string sharedLibPath,
+    std::string entryPointName, size_t maxBatchSize,
+    std::chrono::microseconds latencyWindow)
+    : ExecutionSession(sharedLibPath, entryPointName),
+      _maxBatchSize(std::max(maxBatchSize, (size_t)1)),
+      _latencyWindow(latencyWindow) {
+  if (!hasDynamicBatchDim())
+    _maxBatchSize = 1;
+  _batcher = std::thread(&BatchingExecutionSession::batcherLoop, this);
+}
+
+std::future<std::vector<BatchingExecutionSession::OMTensorPtr>>
+BatchingExecutionSession::submit(std::vector<OMTensorPtr> ins) {
+  for (const auto &input : ins)
+    if (omTensorGetRank(input.get()) < 1)
+      throw std::runtime_error("Cannot batch inputs of rank 0");
+
+  Request request;
+  request.inputs = std::move(ins);
+  request.arrival = std::chrono::steady_clock::now();
+  auto results = request.results.get_future();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stopping)
+      throw std::runtime_error("Cannot submit to a stopping session");
+    _requests.emplace_back(std::move(request));
+  }
+  _requestAvailable.notify_one();
+  return results;
+}
+
+bool BatchingExecutionSession::hasDynamicBatchDim() {
+  for (const auto &signature : {inputSignature(), outputSignature()})
+    for (const auto &tensor : parseSignature(signature))
+      if (tensor.ranked && (tensor.dims.empty() || tensor.dims[0] != -1))
+        return false;
+  return true;
+}
+
+bool BatchingExecutionSession::areBatchable(
+    const Request &lhs, const Request &rhs) {
+  if (lhs.inputs.size() != rhs.inputs.size())
+    return false;
+  // The inputs are concatenated by copying their data buffers.
+  for (size_t i = 0; i < lhs.inputs.size(); i++) {
+    OMTensor *lhsInput = lhs.inputs[i].get();
+    OMTensor *rhsInput = rhs.inputs[i].get();
+    int rank = omTensorGetRank(lhsInput);
+    if (!isDense(lhsInput) || !isDense(rhsInput) ||
+        omTensorGetRank(rhsInput) != rank ||
+        omTensorGetDataType(lhsInput) != omTensorGetDataType(rhsInput) ||
+        !std::equal(omTensorGetDataShape(lhsInput),
+            omTensorGetDataShape(lhsInput) + rank,
+            omTensorGetDataShape(rhsInput)))
+      return false;
+  }
+  return true;
+}
+
+void BatchingExecutionSession::batcherLoop() {
+  while (true) {
+    std::vector<Request> batch;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _requestAvailable.wait(
+          lock, [this] { return _stopping || !_requests.empty(); });
+      if (_requests.empty())
+        break;
+
+      // Wait for the batch to fill up until the oldest request expires.
+      auto deadline = _requests.front().arrival + _latencyWindow;
+      _requestAvailable.wait_until(lock, deadline, [this] {
+        return _stopping || _requests.size() >= _maxBatchSize;
+      });
+
+      // Take the requests batchable with the oldest one, the others are left
+      // for the next batches.
+      batch.emplace_back(std::move(_requests.front()));
+      _requests.pop_front();
+      for (auto it = _requests.begin();
+           it != _requests.end() && batch.size() < _maxBatchSize;) {
+        if (areBatchable(batch.front(), *it)) {
+          batch.emplace_back(std::move(*it));
+          it = _requests.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+    runBatch(batch);
+  }
+}
+
+void BatchingExecutionSession::runBatch(std::vector<Request> &batch) {
+  try {
+    auto results = runBatchOrThrow(batch);
+    for (size_t r = 0; r < batch.size(); r++)
+      batch[r].results.set_value(std::move(results[r]));
+  } catch (...) {
+    for (auto &request : batch)
+      request.results.set_exception(std::current_exception());
+  }
+}
+
+std::vector<std::vector<BatchingExecutionSession::OMTensorPtr>>
+BatchingExecutionSession::runBatchOrThrow(std::vector<Request> &batch) {
+  std::vector<std::vector<OMTensorPtr>> results;
+  if (batch.size() == 1) {
+    results.emplace_back(run(std::move(batch.front().inputs)));
+    return results;
+  }
+
+  // Concatenate the inputs of the requests along the first dimension.
+  int64_t batchSize = batch.size();
+  std::vector<OMTensorPtr> batchInputs;
+  for (size_t i = 0; i < batch.front().inputs.size(); i++) {
+    OMTensor *input = batch.front().inputs[i].get();
+    int rank = omTensorGetRank(input);
+    std::vector<int64_t> shape(
+        omTensorGetDataShape(input), omTensorGetDataShape(input) + rank);
+    shape[0] *= batchSize;
+    OMTensor *batchInput =
+        omTensorCreateEmpty(shape.data(), rank, omTensorGetDataType(input));
+    if (!batchInput)
+      throw std::runtime_error("Cannot allocate batched input");
+    batchInputs.emplace_back(batchInput, omTensorDestroy);
+
+    auto size = omTensorGetDataBufferSize(input);
+    auto *data = (char *)omTensorGetDataPtr(batchInput);
+    for (int64_t r = 0; r < batchSize; r++)
+      memcpy(data + r * size, omTensorGetDataPtr(batch[r].inputs[i].get()),
+          size);
+  }
+
+  auto batchOutputs = run(std::move(batchInputs));
+
+  // Split the outputs back along the first dimension.
+  results.resize(batchSize);
+  for (auto &batchOutput : batchOutputs) {
+    int rank = omTensorGetRank(batchOutput.get());
+    std::vector<int64_t> shape(omTensorGetDataShape(batchOutput.get()),
+        omTensorGetDataShape(batchOutput.get()) + rank);
+    if (rank < 1 || shape[0] % batchSize != 0)
+      throw std::runtime_error("Cannot split model output along the batch");
+    shape[0] /= batchSize;
+
+    auto size = omTensorGetDataBufferSize(batchOutput.get()) / batchSize;
+    auto *data = (char *)omTensorGetDataPtr(batchOutput.get());
+    for (int64_t r = 0; r < batchSize; r++) {
+      OMTensor *output = omTensorCreateEmpty(
+          shape.data(), rank, omTensorGetDataType(batchOutput.get()));
+      if (!output)
+        throw std::runtime_error("Cannot allocate split output");
+      results[r].emplace_back(output, omTensorDestroy);
+      memcpy(omTensorGetDataPtr(output), data + r * size, size);
+    }
+  }
+  return results;
+}
+
+BatchingExecutionSession::~BatchingExecutionSession() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _requestAvailable.notify_all();
+  _batcher.join();
+}
+} // namespace onnx_mlir
@@ -0,0 +1,85 @@
+//===---- BatchingExecutionSession.hpp - BatchingExecutionSession Decl ----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declarations of BatchingExecutionSession class, which
+// batches the inference requests submitted to a model along their first
+// dimension.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+// An ExecutionSession gathering the requests submitted to it over a latency
+// window. Requests whose inputs have the same shapes and types are
+// concatenated along the first dimension and run as a single batch, whose
+// outputs are then split back along the first dimension to each request.
+//
+// The model must be compiled with a dynamic first dimension for all its inputs
+// and outputs, and the first dimension of each output must be proportional to
+// the batch size. The requests to models whose signature has an input or an
+// output without a dynamic first dimension are run one at a time, and so are
+// the requests with inputs which are not dense, see isDense.
+class BatchingExecutionSession : public ExecutionSession {
+public:
+  typedef std::unique_ptr<OMTensor, decltype(&omTensorDestroy)> OMTensorPtr;
+
+  // Load the model. A batch is run once maxBatchSize compatible requests are
+  // queued, or once the oldest queued request has waited for latencyWindow.
+  BatchingExecutionSession(std::string sharedLibPath,
+      std::string entryPointName, size_t maxBatchSize,
+      std::chrono::microseconds latencyWindow);
+
+  // Queue a request and return a future to its results. Exceptions raised
+  // while running the batch of the request are rethrown by the future.
+  std::future<std::vector<OMTensorPtr>> submit(std::vector<OMTensorPtr> ins);
+
+  // Run the queued requests and stop batching.
+  ~BatchingExecutionSession();
+
+protected:
+  struct Request {
+    std::vector<OMTensorPtr> inputs;
+    std::promise<std::vector<OMTensorPtr>> results;
+    std::chrono::steady_clock::time_point arrival;
+  };
+
+  // Whether two requests can be part of the same batch.
+  static bool areBatchable(const Request &lhs, const Request &rhs);
+
+  // Whether the signature of the model, if it has one, gives all its inputs
+  // and outputs a dynamic first dimension.
+  bool hasDynamicBatchDim();
+
+  // Form batches from the queued requests until the session is destroyed.
+  void batcherLoop();
+
+  // Run a batch of requests and deliver the results to each of them.
+  void runBatch(std::vector<Request> &batch);
+  std::vector<std::vector<OMTensorPtr>> runBatchOrThrow(
+      std::vector<Request> &batch);
+
+  size_t _maxBatchSize;
+  std::chrono::microseconds _latencyWindow;
+
+  std::thread _batcher;
+  std::deque<Request> _requests;
+  std::mutex _mutex;
+  std::condition_variable _requestAvailable;
+  bool _stopping = false;
+};
+} // namespace onnx_mlir
@@ -0,0 +1,232 @@
+//===---- CachingExecutionSession.cpp - CachingExecutionSession Impl ------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementations of CachingExecutionSession class, which
+// caches the outputs of a model for recently seen inputs, so that repeated
+// requests do not run the model again.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "CachingExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+// Constants of the xxHash32 rounds.
+static const uint32_t kPrime1 = 2654435761u;
+static const uint32_t kPrime2 = 2246822519u;
+static const uint32_t kPrime3 = 3266489917u;
+
+// The number of independent lanes of the hash of a buffer.
+static const int kNumLanes = 8;
+
+static inline uint32_t rotl32(uint32_t x, int r) {
+  return (x << r) | (x >> (32 - r));
+}
+
+// Mix a 64-bit value, the finalizer of splitmix64.
+static inline uint64_t mix64(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// Hash a buffer with xxHash32 rounds on eight independent 32-bit lanes, which
+// the compiler keeps in vector registers: a round of all the lanes is a vector
+// multiply-add, rotate and multiply on 32 bytes of the buffer.
+static uint64_t hashBuffer(const char *data, size_t size, uint64_t seed) {
+  uint32_t lanes[kNumLanes];
+  for (int l = 0; l < kNumLanes; l++)
+    lanes[l] = (uint32_t)seed + kPrime1 * (l + 1);
+
+  size_t blockSize = kNumLanes * sizeof(uint32_t);
+  size_t numBlocks = size / blockSize;
+  for (size_t b = 0; b < numBlocks; b++) {
+    uint32_t words[kNumLanes];
+    std::memcpy(words, data + b * blockSize, blockSize);
+    for (int l = 0; l < kNumLanes; l++)
+      lanes[l] = rotl32(lanes[l] + words[l] * kPrime2, 13) * kPrime1;
+  }
+
+  uint64_t hash = mix64(seed ^ size);
+  for (int l = 0; l < kNumLanes; l++)
+    hash = mix64(hash ^ lanes[l]);
+  for (size_t i = numBlocks * blockSize; i < size; i++)
+    hash = mix64(hash ^ ((uint8_t)data[i] * (uint64_t)kPrime3));
+  return hash;
+}
+
+CachingExecutionSession::CachingExecutionSession(std::string sharedLibPath,
+    std::string entryPointName, size_t memoryBudget)
+    : ExecutionSession(sharedLibPath, entryPointName),
+      _memoryBudget(memoryBudget) {}
+
+uint64_t CachingExecutionSession::hashInputs(
+    const std::vector<OMTensor *> &ins) {
+  uint64_t hash = mix64(ins.size());
+  for (OMTensor *in : ins) {
+    int rank = omTensorGetRank(in);
+    int64_t *shape = omTensorGetDataShape(in);
+    hash = mix64(hash ^ omTensorGetDataType(in));
+    for (int i = 0; i < rank; i++)
+      hash = mix64(hash ^ shape[i]);
+    hash = hashBuffer((const char *)omTensorGetDataPtr(in),
+        omTensorGetDataBufferSize(in), hash);
+  }
+  return hash;
+}
+
+bool CachingExecutionSession::matchInputs(
+    const std::vector<OMTensor *> &ins, const std::vector<Input> &inputs) {
+  if (ins.size() != inputs.size())
+    return false;
+  for (size_t i = 0; i < ins.size(); i++) {
+    OMTensor *in = ins[i];
+    const Input &input = inputs[i];
+    int rank = omTensorGetRank(in);
+    int64_t *shape = omTensorGetDataShape(in);
+    if (omTensorGetDataType(in) != input.dataType ||
+        (size_t)rank != input.shape.size() ||
+        !std::equal(shape, shape + rank, input.shape.begin()) ||
+        (size_t)omTensorGetDataBufferSize(in) != input.data.size() ||
+        std::memcmp(omTensorGetDataPtr(in), input.data.data(),
+            input.data.size()))
+      return false;
+  }
+  return true;
+}
+
+CachingExecutionSession::Results CachingExecutionSession::runCached(
+    const std::vector<OMTensor *> &ins) {
+  // The inputs are hashed, compared and copied as the data buffers at their
+  // data pointers, which only hold inputs that isDense accepts.
+  bool cacheable = true;
+  for (OMTensor *in : ins)
+    cacheable &= isDense(in);
+
+  uint64_t hash = cacheable ? hashInputs(ins) : 0;
+  if (cacheable) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _index.find(hash);
+    if (found != _index.end() && matchInputs(ins, found->second->inputs)) {
+      _entries.splice(_entries.begin(), _entries, found->second);
+      _cacheStats.hits++;
+      return found->second->outputs;
+    }
+    _cacheStats.misses++;
+  } else {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cacheStats.misses++;
+  }
+
+  // The model runs outside of the lock, the same inputs requested by two
+  // threads at once may run twice.
+  std::vector<OMTensorPtr> borrowed;
+  for (OMTensor *in : ins)
+    borrowed.emplace_back(in, [](OMTensor *) {});
+  Results outputs = std::make_shared<std::vector<OMTensorPtr>>(
+      run(std::move(borrowed)));
+  if (!cacheable)
+    return outputs;
+
+  Entry entry;
+  entry.hash = hash;
+  entry.outputs = outputs;
+  entry.bytes = 0;
+  for (const auto &output : *outputs)
+    entry.bytes += omTensorGetDataBufferSize(output.get());
+  for (OMTensor *in : ins)
+    entry.bytes += omTensorGetDataBufferSize(in);
+  if (entry.bytes > _memoryBudget)
+    return outputs;
+  for (OMTensor *in : ins) {
+    auto *data = (const char *)omTensorGetDataPtr(in);
+    int64_t *shape = omTensorGetDataShape(in);
+    entry.inputs.push_back({omTensorGetDataType(in),
+        std::vector<int64_t>(shape, shape + omTensorGetRank(in)),
+        std::vector<char>(data, data + omTensorGetDataBufferSize(in))});
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto found = _index.find(hash);
+  if (found != _index.end()) {
+    // Replace the entry of the same inputs cached by another thread, or of
+    // other inputs with the same hash.
+    _cacheStats.entries--;
+    _cacheStats.bytes -= found->second->bytes;
+    _entries.erase(found->second);
+  }
+  _cacheStats.entries++;
+  _cacheStats.bytes += entry.bytes;
+  _entries.emplace_front(std::move(entry));
+  _index[hash] = _entries.begin();
+  evict();
+  return outputs;
+}
+
+void CachingExecutionSession::evict() {
+  while (_cacheStats.bytes > _memoryBudget) {
+    Entry &entry = _entries.back();
+    _index.erase(entry.hash);
+    _cacheStats.entries--;
+    _cacheStats.bytes -= entry.bytes;
+    _cacheStats.evictions++;
+    _entries.pop_back();
+  }
+}
+
+void CachingExecutionSession::clearCache() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _entries.clear();
+  _index.clear();
+  _cacheStats.entries = 0;
+  _cacheStats.bytes = 0;
+}
+
+CachingExecutionSession::CacheStats CachingExecutionSession::getCacheStats() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _cacheStats;
+}
+
+void CachingExecutionSession::resetCacheStats() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _cacheStats.hits = 0;
+  _cacheStats.misses = 0;
+  _cacheStats.evictions = 0;
+}
+
+std::string CachingExecutionSession::getCacheStatsPrometheus(
+    const std::string &model) {
+  CacheStats stats = getCacheStats();
+  std::string label = prometheusLabel(model);
+  std::stringstream out;
+  auto writeMetric = [&](const char *name, const char *help,
+                         const char *type, double value) {
+    out << "# HELP " << name << " " << help << "\n# TYPE " << name << " "
+        << type << "\n"
+        << name << label << " " << value << "\n";
+  };
+  out.precision(17);
+  writeMetric("onnx_mlir_cache_hits_total",
+      "Requests answered from the result cache.", "counter", stats.hits);
+  writeMetric("onnx_mlir_cache_misses_total",
+      "Requests that ran the model.", "counter", stats.misses);
+  writeMetric("onnx_mlir_cache_evictions_total",
+      "Results evicted from the result cache.", "counter", stats.evictions);
+  writeMetric("onnx_mlir_cache_hit_ratio",
+      "Fraction of the requests answered from the result cache.", "gauge",
+      stats.getHitRate());
+  writeMetric("onnx_mlir_cache_entries", "Results in the result cache.",
+      "gauge", stats.entries);
+  writeMetric("onnx_mlir_cache_bytes",
+      "Bytes of the inputs and outputs in the result cache.", "gauge",
+      stats.bytes);
+  return out.str();
+}
+} // namespace onnx_mlir
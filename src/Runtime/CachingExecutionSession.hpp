@@ -0,0 +1,123 @@
+//===---- CachingExecutionSession.hpp - CachingExecutionSession Decl ------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declarations of CachingExecutionSession class, which
+// caches the outputs of a model for recently seen inputs, so that repeated
+// requests do not run the model again.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+// An ExecutionSession keeping the outputs of the most recent requests in a
+// least recently used cache bounded by a memory budget. The inputs of a
+// request are hashed, types, shapes and data included, and a request whose
+// inputs are equal to the inputs of a cached request gets the outputs of that
+// request without running the model. A hash match is confirmed by comparing
+// the inputs with a copy kept by the cache, so that a hash collision never
+// returns the outputs of other inputs.
+//
+// The outputs are shared by all the requests with the same inputs, and must
+// only be read. They live until the last request holding them releases them,
+// even after they are evicted from the cache. The model must compute its
+// outputs from its inputs only, without random operations or state. Requests
+// with inputs that are not dense and row-major, or that start at an offset
+// from their data pointer, always run the model, and their outputs are not
+// cached.
+class CachingExecutionSession : public ExecutionSession {
+public:
+  typedef std::unique_ptr<OMTensor, decltype(&omTensorDestroy)> OMTensorPtr;
+
+  // The outputs of a request, shared with the cache.
+  typedef std::shared_ptr<const std::vector<OMTensorPtr>> Results;
+
+  // Statistics of the cache since the session was created or last reset.
+  struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    // Current number of cached requests and the bytes of their inputs and
+    // outputs.
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+
+    double getHitRate() const {
+      return hits + misses ? (double)hits / (hits + misses) : 0;
+    }
+  };
+
+  // Load the model. The inputs and outputs of the cached requests take at
+  // most memoryBudget bytes, the requests whose inputs and outputs take more
+  // are not cached.
+  CachingExecutionSession(std::string sharedLibPath,
+      std::string entryPointName, size_t memoryBudget);
+
+  // Return the outputs of the model for inputs which remain owned by the
+  // caller, from the cache if the same inputs were run recently. Requests may
+  // be run from several threads at once.
+  Results runCached(const std::vector<OMTensor *> &ins);
+
+  // Drop the cached outputs.
+  void clearCache();
+
+  CacheStats getCacheStats();
+
+  void resetCacheStats();
+
+  // Write the statistics of the cache in the Prometheus text exposition
+  // format, with the given model label.
+  std::string getCacheStatsPrometheus(const std::string &model);
+
+  using ExecutionSession::run;
+  using ExecutionSession::runInto;
+
+private:
+  // A copy of an input of a cached request.
+  struct Input {
+    OM_DATA_TYPE dataType;
+    std::vector<int64_t> shape;
+    std::vector<char> data;
+  };
+
+  struct Entry {
+    uint64_t hash;
+    std::vector<Input> inputs;
+    Results outputs;
+    uint64_t bytes;
+  };
+
+  // Hash the types, shapes and data of the inputs of a request.
+  static uint64_t hashInputs(const std::vector<OMTensor *> &ins);
+
+  // Whether the inputs of a request are equal to the inputs of an entry.
+  static bool matchInputs(
+      const std::vector<OMTensor *> &ins, const std::vector<Input> &inputs);
+
+  // Remove the least recently used entries until the cache takes at most
+  // the memory budget.
+  void evict();
+
+  size_t _memoryBudget;
+
+  // The entries from the most to the least recently used, and their index by
+  // hash of their inputs.
+  std::mutex _mutex;
+  std::list<Entry> _entries;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> _index;
+  CacheStats _cacheStats;
+};
+} // namespace onnx_mlir
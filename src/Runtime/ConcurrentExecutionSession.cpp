@@ -0,0 +1,141 @@
+//===- ConcurrentExecutionSession.cpp - ConcurrentExecutionSession Impl ---===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementations of ConcurrentExecutionSession class, which
+// serves many in-flight inference requests with a single loaded model.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include "ConcurrentExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+#ifdef __linux__
+static const char *kNumaNodesPath = "/sys/devices/system/node";
+
+// Read the CPUs of a NUMA node from its list of ranges, such as "0-15,32-47".
+static bool getNumaNodeCpus(int numaNode, cpu_set_t &cpus) {
+  std::ifstream cpuList(std::string(kNumaNodesPath) + "/node" +
+                        std::to_string(numaNode) + "/cpulist");
+  std::string range;
+  CPU_ZERO(&cpus);
+  while (std::getline(cpuList, range, ',')) {
+    int first, last;
+    char dash;
+    std::istringstream rangeStream(range);
+    if (!(rangeStream >> first))
+      continue;
+    if (!(rangeStream >> dash >> last))
+      last = first;
+    for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+      CPU_SET(cpu, &cpus);
+  }
+  return CPU_COUNT(&cpus) > 0;
+}
+#endif
+
+int ConcurrentExecutionSession::getNumNumaNodes() {
+  int numNodes = 0;
+#ifdef __linux__
+  cpu_set_t cpus;
+  while (getNumaNodeCpus(numNodes, cpus))
+    numNodes++;
+#endif
+  return std::max(numNodes, 1);
+}
+
+ConcurrentExecutionSession::ConcurrentExecutionSession(
+    std::string sharedLibPath, std::string entryPointName, unsigned numWorkers,
+    int numaNode)
+    : ExecutionSession(sharedLibPath, entryPointName,
+          /*privateCopy=*/numaNode >= 0) {
+  dlerror();
+  _arenaReleaseFunc =
+      (arenaReleaseFuncType)dlsym(_sharedLibraryHandle, "omArenaRelease");
+  if (dlerror())
+    _arenaReleaseFunc = nullptr;
+
+#ifdef __linux__
+  if (numaNode >= 0) {
+    if (!getNumaNodeCpus(numaNode, _cpus))
+      throw std::runtime_error(
+          "Cannot find the CPUs of NUMA node " + std::to_string(numaNode));
+    _isBound = true;
+    if (numWorkers == 0)
+      numWorkers = CPU_COUNT(&_cpus);
+  }
+#endif
+  if (numWorkers == 0)
+    numWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+  for (unsigned i = 0; i < numWorkers; i++)
+    _workers.emplace_back(&ConcurrentExecutionSession::workerLoop, this);
+}
+
+std::future<std::vector<ConcurrentExecutionSession::OMTensorPtr>>
+ConcurrentExecutionSession::submit(std::vector<OMTensorPtr> ins) {
+  Request request;
+  request.inputs = std::move(ins);
+  auto results = request.results.get_future();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stopping)
+      throw std::runtime_error("Cannot submit to a stopping session");
+    _requests.emplace(std::move(request));
+  }
+  _requestAvailable.notify_one();
+  return results;
+}
+
+void ConcurrentExecutionSession::workerLoop() {
+  // The worker is bound before running any request, so that the memory it
+  // first touches is allocated on its node.
+#ifdef __linux__
+  if (_isBound)
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &_cpus);
+#endif
+  while (true) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _requestAvailable.wait(
+          lock, [this] { return _stopping || !_requests.empty(); });
+      if (_requests.empty())
+        break;
+      request = std::move(_requests.front());
+      _requests.pop();
+    }
+
+    try {
+      request.results.set_value(run(std::move(request.inputs)));
+    } catch (...) {
+      request.results.set_exception(std::current_exception());
+    }
+  }
+
+  // The memory arena of the model belongs to the worker thread.
+  if (_arenaReleaseFunc)
+    _arenaReleaseFunc();
+}
+
+ConcurrentExecutionSession::~ConcurrentExecutionSession() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _requestAvailable.notify_all();
+  for (auto &worker : _workers)
+    worker.join();
+}
+} // namespace onnx_mlir
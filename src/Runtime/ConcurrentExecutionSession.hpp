@@ -0,0 +1,88 @@
+//===--- ConcurrentExecutionSession.hpp - ConcurrentExecutionSession Decl -===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declarations of ConcurrentExecutionSession class, which
+// serves many in-flight inference requests with a single loaded model.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "ExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+// An ExecutionSession running the requests submitted to it on a pool of worker
+// threads. The compiled model keeps no state across invocations other than its
+// memory arena, which is thread-local, so each worker runs with its own arena
+// and the requests never share intermediate buffers.
+//
+// A session can be placed on a NUMA node: its workers are bound to the CPUs of
+// the node, and a private copy of the model library is loaded so that the
+// session has its own copy of the constants. The constants materialized by
+// the workers, such as lazy or compressed constants, are then first touched
+// in the memory of the node. A process serves all the sockets of a host at
+// full memory bandwidth with one session per node.
+class ConcurrentExecutionSession : public ExecutionSession {
+public:
+  typedef std::unique_ptr<OMTensor, decltype(&omTensorDestroy)> OMTensorPtr;
+
+  // Load the model and start numWorkers worker threads, one per hardware
+  // thread if numWorkers is 0. With a non-negative numaNode, the workers are
+  // bound to the CPUs of the node, one per CPU of the node if numWorkers is
+  // 0 (Linux only).
+  ConcurrentExecutionSession(std::string sharedLibPath,
+      std::string entryPointName, unsigned numWorkers = 0, int numaNode = -1);
+
+  // Queue a request and return a future to its results. Exceptions raised
+  // while running the request are rethrown by the future.
+  std::future<std::vector<OMTensorPtr>> submit(std::vector<OMTensorPtr> ins);
+
+  // Number of worker threads.
+  unsigned getNumWorkers() const { return _workers.size(); }
+
+  // Number of NUMA nodes of the host, 1 if it is not known.
+  static int getNumNumaNodes();
+
+  // Wait for the queued requests to complete and stop the workers.
+  ~ConcurrentExecutionSession();
+
+protected:
+  struct Request {
+    std::vector<OMTensorPtr> inputs;
+    std::promise<std::vector<OMTensorPtr>> results;
+  };
+
+  // Run the queued requests until the session is destroyed.
+  void workerLoop();
+
+  // Release function of the memory arena, if the model has one.
+  arenaReleaseFuncType _arenaReleaseFunc = nullptr;
+
+#ifdef __linux__
+  // CPUs the workers are bound to, if the session is placed on a NUMA node.
+  bool _isBound = false;
+  cpu_set_t _cpus;
+#endif
+
+  std::vector<std::thread> _workers;
+  std::queue<Request> _requests;
+  std::mutex _mutex;
+  std::condition_variable _requestAvailable;
+  bool _stopping = false;
+};
+} // namespace onnx_mlir
@@ -0,0 +1,118 @@
+//===--- DecompressConstPool.cpp - Decompress Const Pool Func Impl --------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains the implementation of the runtime functions
+// decompressing the constant packs compressed in chunks with zlib, shared by
+// the embedded and the external data loaders.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GetEmbeddedConstPool.h"
+#include "OMHugePages.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+// The header and the chunks of a compressed constant pack.
+struct CompressedPack {
+  uint64_t size;
+  uint64_t chunkSize;
+  uint64_t numChunks;
+  const uint64_t *compressedSizes;
+  std::vector<const char *> chunks;
+
+  explicit CompressedPack(const char *pack) {
+    const uint64_t *header = reinterpret_cast<const uint64_t *>(pack);
+    size = header[0];
+    chunkSize = header[1];
+    numChunks = header[2];
+    compressedSizes = header + 3;
+    const char *chunk = reinterpret_cast<const char *>(header + 3 + numChunks);
+    for (uint64_t i = 0; i < numChunks; ++i) {
+      chunks.emplace_back(chunk);
+      chunk += compressedSizes[i];
+    }
+  }
+
+  // Decompress the chunk at its place in the constant pool.
+  void decompressChunk(uint64_t i, char *pool) const {
+    uLongf chunkBytes = std::min(chunkSize, size - i * chunkSize);
+    if (uncompress(reinterpret_cast<Bytef *>(pool + i * chunkSize),
+            &chunkBytes, reinterpret_cast<const Bytef *>(chunks[i]),
+            compressedSizes[i]) != Z_OK) {
+      fprintf(stderr, "Cannot decompress the constant pack.\n");
+      exit(1);
+    }
+  }
+};
+
+} // namespace
+
+void *decompressConstPool(const char *compressedPack) {
+  static std::once_flag decompressed;
+  static char *pool = nullptr;
+  std::call_once(decompressed, [&] {
+    CompressedPack pack(compressedPack);
+    auto decompress = [&](char *pool) {
+      // The threads take the next chunk to decompress until none is left.
+      std::atomic<uint64_t> nextChunk(0);
+      auto decompressChunks = [&]() {
+        for (uint64_t i = nextChunk++; i < pack.numChunks; i = nextChunk++)
+          pack.decompressChunk(i, pool);
+      };
+      uint64_t numThreads = std::min<uint64_t>(
+          std::max(std::thread::hardware_concurrency(), 1u), pack.numChunks);
+      std::vector<std::thread> threads;
+      for (uint64_t t = 1; t < numThreads; ++t)
+        threads.emplace_back(decompressChunks);
+      decompressChunks();
+      for (auto &thread : threads)
+        thread.join();
+    };
+
+    // Only the first process serving the model decompresses a shared
+    // constant pool.
+    pool = const_cast<char *>(getSharedConstPool(pack.size, decompress));
+    if (!pool) {
+      pool = (char *)omAllocPermanentBuffer(pack.size);
+      decompress(pool);
+    }
+  });
+  return pool;
+}
+
+void *getCompressedConst(
+    const char *compressedPack, int64_t offset, int64_t size_in_byte) {
+  // The constant pool is allocated once, and each chunk is decompressed in it
+  // by the first constant spanning it.
+  static std::once_flag allocated;
+  static CompressedPack *pack = nullptr;
+  static char *pool = nullptr;
+  static std::unique_ptr<std::once_flag[]> decompressed;
+  std::call_once(allocated, [&] {
+    pack = new CompressedPack(compressedPack);
+    pool = (char *)omAllocPermanentBuffer(pack->size);
+    decompressed.reset(new std::once_flag[pack->numChunks]);
+  });
+
+  if (size_in_byte > 0) {
+    uint64_t first = offset / pack->chunkSize;
+    uint64_t last = (offset + size_in_byte - 1) / pack->chunkSize;
+    for (uint64_t i = first; i <= last; ++i)
+      std::call_once(
+          decompressed[i], [&] { pack->decompressChunk(i, pool); });
+  }
+  return pool + offset;
+}
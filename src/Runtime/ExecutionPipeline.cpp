@@ -0,0 +1,117 @@
+//===------ ExecutionPipeline.cpp - ExecutionPipeline Implementation ------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementations of ExecutionPipeline class, which chains
+// several compiled models, each running on its own worker threads.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "ExecutionPipeline.hpp"
+
+namespace onnx_mlir {
+
+ExecutionPipeline::ExecutionPipeline(const std::vector<StageDesc> &stages) {
+  if (stages.empty())
+    throw std::runtime_error("A pipeline needs at least one stage");
+  // Stages are created from the last one, each knowing the next.
+  _stages.resize(stages.size());
+  Stage *next = nullptr;
+  for (size_t i = stages.size(); i-- > 0;) {
+    _stages[i] = std::make_unique<Stage>(stages[i], next);
+    next = _stages[i].get();
+  }
+}
+
+std::future<std::vector<ExecutionPipeline::OMTensorPtr>>
+ExecutionPipeline::submit(std::vector<OMTensorPtr> ins) {
+  Request request;
+  request.tensors = std::move(ins);
+  auto results = request.results.get_future();
+  if (!_stages.front()->push(request))
+    throw std::runtime_error("Cannot submit to a stopping pipeline");
+  return results;
+}
+
+ExecutionPipeline::~ExecutionPipeline() {
+  // A stage only stops once its requests are handed to the next stage, which
+  // is still running.
+  for (auto &stage : _stages)
+    stage->stop();
+}
+
+ExecutionPipeline::Stage::Stage(const StageDesc &desc, Stage *next)
+    : ExecutionSession(desc.sharedLibPath, desc.entryPointName),
+      _connector(desc.connector), _next(next) {
+  dlerror();
+  _arenaReleaseFunc =
+      (arenaReleaseFuncType)dlsym(_sharedLibraryHandle, "omArenaRelease");
+  if (dlerror())
+    _arenaReleaseFunc = nullptr;
+
+  for (unsigned i = 0; i < std::max(desc.numWorkers, 1u); i++)
+    _workers.emplace_back(&ExecutionPipeline::Stage::workerLoop, this);
+}
+
+bool ExecutionPipeline::Stage::push(Request &request) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stopping)
+      return false;
+    _requests.emplace(std::move(request));
+  }
+  _requestAvailable.notify_one();
+  return true;
+}
+
+void ExecutionPipeline::Stage::stop() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _requestAvailable.notify_all();
+  for (auto &worker : _workers)
+    worker.join();
+  _workers.clear();
+}
+
+ExecutionPipeline::Stage::~Stage() { stop(); }
+
+void ExecutionPipeline::Stage::workerLoop() {
+  while (true) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _requestAvailable.wait(
+          lock, [this] { return _stopping || !_requests.empty(); });
+      if (_requests.empty())
+        break;
+      request = std::move(_requests.front());
+      _requests.pop();
+    }
+
+    // The outputs are moved to the next stage, which owns them from then on.
+    try {
+      auto inputs = _connector ? _connector(std::move(request.tensors))
+                               : std::move(request.tensors);
+      request.tensors = run(std::move(inputs));
+      if (!_next) {
+        request.results.set_value(std::move(request.tensors));
+      } else if (!_next->push(request)) {
+        throw std::runtime_error("Next stage of the pipeline is stopping");
+      }
+    } catch (...) {
+      request.results.set_exception(std::current_exception());
+    }
+  }
+
+  // The memory arena of the model belongs to the worker thread.
+  if (_arenaReleaseFunc)
+    _arenaReleaseFunc();
+}
+} // namespace onnx_mlir
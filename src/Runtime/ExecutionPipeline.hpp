@@ -0,0 +1,103 @@
+//===-------- ExecutionPipeline.hpp - ExecutionPipeline Declaration -------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declarations of ExecutionPipeline class, which chains
+// several compiled models, each running on its own worker threads.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "ExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+// A chain of models, the outputs of each model being the inputs of the next.
+// Each stage has its own model and worker threads, so that the stage N of a
+// request runs while the stage N-1 of the next request is running: the
+// throughput of the pipeline is the throughput of its slowest stage. The
+// tensors are handed from one stage to the next without copies.
+class ExecutionPipeline {
+public:
+  typedef std::unique_ptr<OMTensor, decltype(&omTensorDestroy)> OMTensorPtr;
+
+  // Turn the outputs of the previous stage into the inputs of a model, e.g. to
+  // crop the regions found by a detector. It runs on the worker thread of the
+  // stage.
+  typedef std::function<std::vector<OMTensorPtr>(std::vector<OMTensorPtr>)>
+      Connector;
+
+  struct StageDesc {
+    std::string sharedLibPath;
+    std::string entryPointName = "run_main_graph";
+    // Outputs of the previous stage are passed as is if not set.
+    Connector connector = nullptr;
+    // More workers let a slower stage keep up with the others.
+    unsigned numWorkers = 1;
+  };
+
+  // Load the models of the stages and start their workers.
+  ExecutionPipeline(const std::vector<StageDesc> &stages);
+
+  // Queue a request and return a future to the outputs of the last stage.
+  // Exceptions raised by any stage are rethrown by the future.
+  std::future<std::vector<OMTensorPtr>> submit(std::vector<OMTensorPtr> ins);
+
+  // Number of stages.
+  size_t getNumStages() const { return _stages.size(); }
+
+  // Wait for the queued requests to complete and stop the workers.
+  ~ExecutionPipeline();
+
+protected:
+  struct Request {
+    std::vector<OMTensorPtr> tensors;
+    std::promise<std::vector<OMTensorPtr>> results;
+  };
+
+  // A model with the queue of the requests waiting for it.
+  class Stage : public ExecutionSession {
+  public:
+    Stage(const StageDesc &desc, Stage *next);
+
+    // Queue a request, returning false if the stage is stopping.
+    bool push(Request &request);
+
+    // Wait for the queued requests to go through the stage and stop the
+    // workers.
+    void stop();
+
+    // Stop the workers if they are running, e.g. when a later stage of the
+    // pipeline fails to load.
+    ~Stage();
+
+  protected:
+    // Run the queued requests until the stage is stopped.
+    void workerLoop();
+
+    Connector _connector;
+    Stage *_next;
+    arenaReleaseFuncType _arenaReleaseFunc = nullptr;
+
+    std::vector<std::thread> _workers;
+    std::queue<Request> _requests;
+    std::mutex _mutex;
+    std::condition_variable _requestAvailable;
+    bool _stopping = false;
+  };
+
+  std::vector<std::unique_ptr<Stage>> _stages;
+};
+} // namespace onnx_mlir
@@ -9,19 +9,70 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <pthread.h>
 #include <sstream>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <vector>
 
 #include "ExecutionSession.hpp"
 
 namespace onnx_mlir {
 
-ExecutionSession::ExecutionSession(
-    std::string sharedLibPath, std::string entryPointName) {
-  // Adapted from https://www.tldp.org/HOWTO/html_single/C++-dlopen/.
-  _sharedLibraryHandle = dlopen(sharedLibPath.c_str(), RTLD_LAZY);
+// Copy a library to a temporary file, dlopen the copy and remove the file.
+// The loader identifies libraries by file, so the copy is a new instance of
+// the library with its own data, while it shares the C and C++ runtimes, and
+// their heap, with the process. A private link map namespace (dlmopen) would
+// also load new instances of the runtimes, and the tensors allocated by the
+// model could then not be freed by the process.
+static void *dlopenPrivateCopy(const std::string &sharedLibPath) {
+  const char *tmpDir = std::getenv("TMPDIR");
+  std::string copyPath =
+      std::string(tmpDir ? tmpDir : "/tmp") + "/onnx-mlir-model-XXXXXX";
+  int copyFd = mkstemp(&copyPath[0]);
+  if (copyFd < 0)
+    throw std::runtime_error("Cannot create a copy of library " +
+                             sharedLibPath + ": " + std::strerror(errno));
+  bool copied = false;
+  int libFd = open(sharedLibPath.c_str(), O_RDONLY);
+  if (libFd >= 0) {
+    char buffer[1 << 16];
+    ssize_t size;
+    copied = true;
+    while (copied && (size = read(libFd, buffer, sizeof(buffer))) != 0)
+      copied = size > 0 && write(copyFd, buffer, size) == size;
+    close(libFd);
+  }
+  int error = errno;
+  close(copyFd);
+  if (!copied) {
+    unlink(copyPath.c_str());
+    throw std::runtime_error("Cannot copy library " + sharedLibPath + ": " +
+                             std::strerror(error));
+  }
+  void *handle = dlopen(copyPath.c_str(), RTLD_NOW);
+  unlink(copyPath.c_str());
+  return handle;
+}
+
+ExecutionSession::ExecutionSession(std::string sharedLibPath,
+    std::string entryPointName, bool privateCopy) {
+  // Adapted from https://www.tldp.org/HOWTO/html_single/C++-dlopen/. The
+  // symbols are bound when the library is loaded rather than by the first
+  // requests.
+  if (privateCopy)
+    _sharedLibraryHandle = dlopenPrivateCopy(sharedLibPath);
+  else
+    _sharedLibraryHandle = dlopen(sharedLibPath.c_str(), RTLD_NOW);
   if (!_sharedLibraryHandle) {
     std::stringstream errStr;
     errStr << "Cannot open library: " << dlerror() << std::endl;
@@ -40,6 +91,13 @@ ExecutionSession::ExecutionSession(
     dlclose(_sharedLibraryHandle);
     throw std::runtime_error(errStr.str());
   }
+
+  // The entry point writing into output buffers is optional.
+  dlerror();
+  _intoEntryPointFunc = (intoEntryPointFuncType)dlsym(
+      _sharedLibraryHandle, (entryPointName + "_into").c_str());
+  if (dlerror())
+    _intoEntryPointFunc = nullptr;
 }
 
 std::vector<std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>>
@@ -51,7 +109,10 @@ ExecutionSession::run(
     omts.emplace_back(inOmt.get());
   auto *wrappedInput = omTensorListCreate(&omts[0], omts.size());
 
-  auto *wrappedOutput = _entryPointFunc(wrappedInput);
+  RunSample sample;
+  beginRun(sample);
+  auto *wrappedOutput = invokeEntryPoint(wrappedInput);
+  endRun(sample);
 
   std::vector<std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>> outs;
 
@@ -62,5 +123,524 @@ ExecutionSession::run(
   return std::move(outs);
 }
 
-ExecutionSession::~ExecutionSession() { dlclose(_sharedLibraryHandle); }
+void ExecutionSession::runInto(
+    std::vector<std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>> ins,
+    const std::vector<OMTensor *> &outs) {
+  if (_lowLatency) {
+    if (ins.size() != _lowLatencyIns.size())
+      throw std::runtime_error("Number of input tensors does not match the "
+                               "sample request of the low-latency mode");
+    for (size_t i = 0; i < ins.size(); i++)
+      _lowLatencyIns[i] = ins[i].get();
+    runLowLatency(outs);
+    return;
+  }
+
+  checkOutputs(outs);
+  if (!hasIntoEntryPoint()) {
+    auto results = run(std::move(ins));
+    if (results.size() != outs.size())
+      throw std::runtime_error("Number of output tensors does not match the "
+                               "number of outputs of the model");
+    for (size_t i = 0; i < results.size(); i++) {
+      auto size = omTensorGetDataBufferSize(results[i].get());
+      if (omTensorGetDataBufferSize(outs[i]) != size)
+        throw std::runtime_error("Output tensor size does not match the size "
+                                 "of the output of the model");
+      memcpy(omTensorGetDataPtr(outs[i]), omTensorGetDataPtr(results[i].get()),
+          size);
+    }
+    return;
+  }
+
+  std::vector<OMTensor *> omts;
+  for (const auto &inOmt : ins)
+    omts.emplace_back(inOmt.get());
+  auto *wrappedInput = omTensorListCreate(&omts[0], omts.size());
+
+  std::vector<OMTensor *> outOmts(outs.begin(), outs.end());
+  auto *wrappedOutput = omTensorListCreate(&outOmts[0], outOmts.size());
+
+  RunSample sample;
+  beginRun(sample);
+  invokeIntoEntryPoint(wrappedInput, wrappedOutput);
+  endRun(sample);
+  std::free(wrappedInput);
+  std::free(wrappedOutput);
+}
+
+void ExecutionSession::runInto(
+    const std::vector<OMTensor *> &ins, const std::vector<OMTensor *> &outs) {
+  if (_lowLatency) {
+    if (ins.size() != _lowLatencyIns.size())
+      throw std::runtime_error("Number of input tensors does not match the "
+                               "sample request of the low-latency mode");
+    std::copy(ins.begin(), ins.end(), _lowLatencyIns.begin());
+    runLowLatency(outs);
+    return;
+  }
+
+  // The inputs are not destroyed with their wrappers.
+  std::vector<std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>> borrowed;
+  for (OMTensor *in : ins)
+    borrowed.emplace_back(in, [](OMTensor *) {});
+  runInto(std::move(borrowed), outs);
+}
+
+// Return a function of the runtime embedded in the model, or of the runtime
+// loaded into the process for models run by the JIT execution session, or
+// nullptr if it has none.
+static void *lookupRuntimeFunc(void *handle, const char *funcName) {
+  dlerror();
+  void *func = dlsym(handle ? handle : RTLD_DEFAULT, funcName);
+  return dlerror() ? nullptr : func;
+}
+
+bool ExecutionSession::isDense(OMTensor *tensor) {
+  if (omTensorGetOffset(tensor) != 0)
+    return false;
+  int64_t rank = omTensorGetRank(tensor);
+  int64_t *shape = omTensorGetDataShape(tensor);
+  int64_t *strides = omTensorGetStrides(tensor);
+  int64_t numElems = 1;
+  for (int64_t i = rank - 1; i >= 0; i--) {
+    if (shape[i] != 1 && strides[i] != numElems)
+      return false;
+    numElems *= shape[i];
+  }
+  return true;
+}
+
+namespace {
+// A parser of the signatures of the models, JSON arrays of objects whose
+// "type" is a string and whose "dims" are an array of integers or null. The
+// other members of the objects are skipped.
+class SignatureParser {
+public:
+  SignatureParser(const std::string &text) : _text(text) {}
+
+  std::vector<ExecutionSession::TensorSignature> parse() {
+    std::vector<ExecutionSession::TensorSignature> tensors;
+    expect('[');
+    if (!consume(']')) {
+      do
+        tensors.emplace_back(parseTensor());
+      while (consume(','));
+      expect(']');
+    }
+    skipSpaces();
+    if (_pos != _text.size())
+      fail();
+    return tensors;
+  }
+
+private:
+  ExecutionSession::TensorSignature parseTensor() {
+    ExecutionSession::TensorSignature tensor;
+    expect('{');
+    if (consume('}'))
+      return tensor;
+    do {
+      std::string key = parseString();
+      expect(':');
+      if (key == "type") {
+        tensor.type = parseString();
+      } else if (key == "dims") {
+        tensor.ranked = !consumeNull();
+        tensor.dims.clear();
+        if (tensor.ranked) {
+          expect('[');
+          if (!consume(']')) {
+            do
+              tensor.dims.emplace_back(parseInteger());
+            while (consume(','));
+            expect(']');
+          }
+        }
+      } else {
+        skipValue();
+      }
+    } while (consume(','));
+    expect('}');
+    return tensor;
+  }
+
+  void skipSpaces() {
+    while (_pos < _text.size() && isspace((unsigned char)_text[_pos]))
+      _pos++;
+  }
+
+  bool consume(char c) {
+    skipSpaces();
+    if (_pos >= _text.size() || _text[_pos] != c)
+      return false;
+    _pos++;
+    return true;
+  }
+
+  void expect(char c) {
+    if (!consume(c))
+      fail();
+  }
+
+  bool consumeNull() {
+    skipSpaces();
+    if (_text.compare(_pos, 4, "null") != 0)
+      return false;
+    _pos += 4;
+    return true;
+  }
+
+  // The escaped characters of the strings are kept as they are, the names of
+  // the element types have none.
+  std::string parseString() {
+    expect('"');
+    std::string str;
+    while (_pos < _text.size() && _text[_pos] != '"') {
+      if (_text[_pos] == '\\' && ++_pos == _text.size())
+        break;
+      str += _text[_pos++];
+    }
+    expect('"');
+    return str;
+  }
+
+  int64_t parseInteger() {
+    skipSpaces();
+    size_t end = _pos;
+    if (end < _text.size() && _text[end] == '-')
+      end++;
+    while (end < _text.size() && isdigit((unsigned char)_text[end]))
+      end++;
+    if (end == _pos)
+      fail();
+    int64_t value = std::strtoll(_text.c_str() + _pos, nullptr, 10);
+    _pos = end;
+    return value;
+  }
+
+  // Skip a string, a number, null or an array of them.
+  void skipValue() {
+    skipSpaces();
+    if (_pos < _text.size() && _text[_pos] == '"') {
+      parseString();
+    } else if (consume('[')) {
+      if (!consume(']')) {
+        do
+          skipValue();
+        while (consume(','));
+        expect(']');
+      }
+    } else if (!consumeNull()) {
+      parseInteger();
+    }
+  }
+
+  [[noreturn]] void fail() {
+    throw std::runtime_error("Invalid signature of the model: " + _text);
+  }
+
+  const std::string &_text;
+  size_t _pos = 0;
+};
+
+// Test if an element type of the signature of a model, an MLIR type, is the
+// data type of a tensor. Signless integers may be signed or unsigned, the
+// other types are not checked.
+bool isSignatureType(const std::string &type, OM_DATA_TYPE dataType) {
+  struct IntegerType {
+    int width;
+    OM_DATA_TYPE signedType;
+    OM_DATA_TYPE unsignedType;
+  };
+  static const std::map<std::string, OM_DATA_TYPE> kTypes = {
+      {"f16", ONNX_TYPE_FLOAT16}, {"bf16", ONNX_TYPE_BFLOAT16},
+      {"f32", ONNX_TYPE_FLOAT}, {"f64", ONNX_TYPE_DOUBLE},
+      {"i1", ONNX_TYPE_BOOL}};
+  static const IntegerType kIntegerTypes[] = {
+      {8, ONNX_TYPE_INT8, ONNX_TYPE_UINT8},
+      {16, ONNX_TYPE_INT16, ONNX_TYPE_UINT16},
+      {32, ONNX_TYPE_INT32, ONNX_TYPE_UINT32},
+      {64, ONNX_TYPE_INT64, ONNX_TYPE_UINT64}};
+  auto it = kTypes.find(type);
+  if (it != kTypes.end())
+    return dataType == it->second;
+  for (const auto &integerType : kIntegerTypes) {
+    std::string width = std::to_string(integerType.width);
+    if (type == "si" + width)
+      return dataType == integerType.signedType;
+    if (type == "ui" + width)
+      return dataType == integerType.unsignedType;
+    if (type == "i" + width)
+      return dataType == integerType.signedType ||
+             dataType == integerType.unsignedType;
+  }
+  return true;
+}
+} // namespace
+
+std::vector<ExecutionSession::TensorSignature> ExecutionSession::parseSignature(
+    const std::string &signature) {
+  if (signature.empty())
+    return {};
+  return SignatureParser(signature).parse();
+}
+
+void ExecutionSession::checkOutputs(const std::vector<OMTensor *> &outs) {
+  std::call_once(_outputSignatureOnce,
+      [this]() { _outputSignature = parseSignature(outputSignature()); });
+  if (!_outputSignature.empty() && outs.size() != _outputSignature.size())
+    throw std::runtime_error("Number of output tensors does not match the "
+                             "number of outputs of the model");
+  for (size_t i = 0; i < outs.size(); i++) {
+    std::string output = "Output tensor " + std::to_string(i);
+    if (!isDense(outs[i]))
+      throw std::runtime_error(output + " is not dense");
+    if (i >= _outputSignature.size())
+      continue;
+    const TensorSignature &expected = _outputSignature[i];
+    if (!isSignatureType(expected.type, omTensorGetDataType(outs[i])))
+      throw std::runtime_error(output + " does not have the element type " +
+                               expected.type + " of the output of the model");
+    if (!expected.ranked)
+      continue;
+    // The dynamic dimensions of the outputs are only known once the model has
+    // run, the element count is checked by the copy of the results.
+    int64_t rank = omTensorGetRank(outs[i]);
+    const int64_t *shape = omTensorGetDataShape(outs[i]);
+    bool matches = rank == (int64_t)expected.dims.size();
+    for (int64_t d = 0; matches && d < rank; d++)
+      matches = expected.dims[d] < 0 || shape[d] == expected.dims[d];
+    if (!matches)
+      throw std::runtime_error(
+          output + " does not have the shape of the output of the model");
+  }
+}
+
+void ExecutionSession::runLowLatency(const std::vector<OMTensor *> &outs) {
+  if (outs.size() != _lowLatencyOuts.size())
+    throw std::runtime_error("Number of output tensors does not match the "
+                             "sample request of the low-latency mode");
+  checkOutputs(outs);
+  std::copy(outs.begin(), outs.end(), _lowLatencyOuts.begin());
+  for (OMTensor *in : _lowLatencyIns)
+    if (!isDense(in))
+      throw std::runtime_error(
+          "Input tensors of the low-latency mode must be dense");
+
+  RunSample sample;
+  beginRun(sample);
+  invokeIntoEntryPoint(_lowLatencyInList, _lowLatencyOutList);
+  endRun(sample);
+}
+
+void ExecutionSession::enableLowLatency(const std::vector<OMTensor *> &ins,
+    const std::vector<OMTensor *> &outs, const LowLatencyOptions &options) {
+  if (!hasIntoEntryPoint())
+    throw std::runtime_error("The low-latency mode needs a model compiled "
+                             "with --emit-output-buffer-entry-point");
+  auto arenaNumAllocsFunc = (arenaNumAllocsFuncType)lookupRuntimeFunc(
+      _sharedLibraryHandle, "omArenaGetNumAllocs");
+  auto memcpyConfigureThreadsFunc =
+      (memcpyConfigureThreadsFuncType)lookupRuntimeFunc(
+          _sharedLibraryHandle, "omMemcpyConfigureThreads");
+  if (!arenaNumAllocsFunc || !memcpyConfigureThreadsFunc)
+    throw std::runtime_error(
+        "The runtime of the model does not support the low-latency mode");
+  _arenaNumAllocsFunc = arenaNumAllocsFunc;
+
+  // The threads are pinned before the memory arena is sized, so that its
+  // memory is local to the CPUs running the inferences.
+  if (!options.cpus.empty()) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(options.cpus[0], &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus) != 0)
+      throw std::runtime_error("Cannot pin the calling thread to CPU " +
+                               std::to_string(options.cpus[0]));
+#else
+    throw std::runtime_error("Threads can only be pinned on Linux");
+#endif
+  }
+  if (memcpyConfigureThreadsFunc(options.cpus.data(), options.cpus.size(),
+          options.spinWait) != 0)
+    throw std::runtime_error("Cannot pin the memory copy threads");
+
+  std::free(_lowLatencyInList);
+  std::free(_lowLatencyOutList);
+  _lowLatencyIns.assign(ins.begin(), ins.end());
+  _lowLatencyOuts.assign(outs.begin(), outs.end());
+  _lowLatencyInList =
+      omTensorListCreate(_lowLatencyIns.data(), _lowLatencyIns.size());
+  _lowLatencyOutList =
+      omTensorListCreate(_lowLatencyOuts.data(), _lowLatencyOuts.size());
+
+  warmup();
+  runLowLatency(outs);
+  int64_t numAllocs = _arenaNumAllocsFunc();
+  runLowLatency(outs);
+  if (_arenaNumAllocsFunc() != numAllocs)
+    throw std::runtime_error("The model allocates memory at each inference, "
+                             "compile it with --enable-memory-arena");
+
+  if (options.lockMemory && mlockall(MCL_CURRENT) != 0)
+    throw std::runtime_error(
+        std::string("Cannot lock the memory of the process: ") +
+        strerror(errno));
+  _lowLatency = true;
+}
+
+void ExecutionSession::warmup(
+    std::vector<std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>> ins) {
+  // Models without packed constants do not export the prefetch function.
+  if (_sharedLibraryHandle) {
+    dlerror();
+    auto prefetchFunc = (constPoolPrefetchFuncType)dlsym(
+        _sharedLibraryHandle, "omPrefetchConstPool");
+    if (!dlerror() && prefetchFunc)
+      prefetchFunc();
+  }
+  if (!ins.empty())
+    run(std::move(ins));
+}
+
+// Return the string returned by a function of the model, or an empty string if
+// the model does not export it.
+static std::string callSignatureFunc(void *handle, const char *funcName) {
+  if (!handle)
+    return "";
+  dlerror();
+  auto signatureFunc = (signatureFuncType)dlsym(handle, funcName);
+  if (dlerror() || !signatureFunc)
+    return "";
+  return signatureFunc();
+}
+
+std::string ExecutionSession::inputSignature() {
+  return callSignatureFunc(_sharedLibraryHandle, "omInputSignature");
+}
+
+std::string ExecutionSession::outputSignature() {
+  return callSignatureFunc(_sharedLibraryHandle, "omOutputSignature");
+}
+
+void ExecutionSession::enableRunStats(bool enable) {
+  // The counters are read by the runtime embedded into the model, models run
+  // by the JIT execution session use the runtime loaded into the process.
+  if (enable && !_perfCountersReadFunc)
+    _perfCountersReadFunc = (perfCountersReadFuncType)lookupRuntimeFunc(
+        _sharedLibraryHandle, "omPerfCountersRead");
+  if (enable && !_arenaNumAllocsFunc)
+    _arenaNumAllocsFunc = (arenaNumAllocsFuncType)lookupRuntimeFunc(
+        _sharedLibraryHandle, "omArenaGetNumAllocs");
+  _collectRunStats = enable;
+}
+
+void ExecutionSession::beginRun(RunSample &sample) {
+  if (!_collectRunStats)
+    return;
+  sample.start = std::chrono::steady_clock::now();
+  sample.counted =
+      _perfCountersReadFunc && _perfCountersReadFunc(sample.counters) == 0;
+  if (_arenaNumAllocsFunc)
+    sample.allocations = _arenaNumAllocsFunc();
+}
+
+void ExecutionSession::endRun(const RunSample &sample) {
+  if (!_collectRunStats)
+    return;
+  uint64_t counters[OM_PERF_NUM_COUNTERS];
+  bool counted = sample.counted && _perfCountersReadFunc(counters) == 0;
+  auto durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - sample.start)
+                        .count();
+  int64_t allocations =
+      _arenaNumAllocsFunc ? _arenaNumAllocsFunc() - sample.allocations : 0;
+
+  std::lock_guard<std::mutex> lock(_runStatsMutex);
+  _runStats.runs++;
+  _runStats.totalNs += durationNs;
+  _runStats.allocations += allocations;
+  if (counted) {
+    _runStats.countedRuns++;
+    for (int i = 0; i < OM_PERF_NUM_COUNTERS; i++)
+      _runStats.counters[i] += counters[i] - sample.counters[i];
+  }
+}
+
+ExecutionSession::RunStats ExecutionSession::getRunStats() {
+  std::lock_guard<std::mutex> lock(_runStatsMutex);
+  return _runStats;
+}
+
+void ExecutionSession::resetRunStats() {
+  std::lock_guard<std::mutex> lock(_runStatsMutex);
+  _runStats = RunStats();
+}
+
+std::string ExecutionSession::prometheusLabel(const std::string &model) {
+  std::string label = "{model=\"";
+  for (char c : model) {
+    if (c == '"' || c == '\\')
+      label += '\\';
+    if (c == '\n') {
+      label += "\\n";
+      continue;
+    }
+    label += c;
+  }
+  label += "\"}";
+  return label;
+}
+
+std::string ExecutionSession::getRunStatsPrometheus(const std::string &model) {
+  RunStats stats = getRunStats();
+  std::string label = prometheusLabel(model);
+  std::stringstream out;
+  auto writeMetric = [&](const char *name, const char *help, double value) {
+    out << "# HELP " << name << " " << help << "\n# TYPE " << name
+        << " counter\n"
+        << name << label << " " << value << "\n";
+  };
+  out.precision(17);
+  writeMetric("onnx_mlir_runs_total", "Number of inferences.", stats.runs);
+  writeMetric("onnx_mlir_run_seconds_total", "Time spent in the inferences.",
+      stats.totalNs / 1e9);
+  writeMetric("onnx_mlir_counted_runs_total",
+      "Number of inferences with hardware counters.", stats.countedRuns);
+  writeMetric("onnx_mlir_run_cycles_total", "CPU cycles of the inferences.",
+      stats.counters[OM_PERF_CYCLES]);
+  writeMetric("onnx_mlir_run_instructions_total",
+      "Instructions retired by the inferences.",
+      stats.counters[OM_PERF_INSTRUCTIONS]);
+  writeMetric("onnx_mlir_run_llc_misses_total",
+      "Last level cache misses of the inferences.",
+      stats.counters[OM_PERF_LLC_MISSES]);
+  writeMetric("onnx_mlir_run_memory_bytes_total",
+      "Memory traffic of the inferences, estimated from the last level cache "
+      "misses.",
+      (double)stats.counters[OM_PERF_LLC_MISSES] * OM_PERF_CACHE_LINE_BYTES);
+  writeMetric("onnx_mlir_run_allocations_total",
+      "Memory arena allocations made by the inferences.", stats.allocations);
+  return out.str();
+}
+
+ExecutionSession::~ExecutionSession() {
+  // Only the lists of the low-latency mode are freed, their tensors are owned
+  // by the caller.
+  std::free(_lowLatencyInList);
+  std::free(_lowLatencyOutList);
+  if (!_sharedLibraryHandle)
+    return;
+
+  // Models compiled with a memory arena keep their memory pools in the arena
+  // of the running thread, release it before unloading the library.
+  dlerror();
+  auto arenaReleaseFunc =
+      (arenaReleaseFuncType)dlsym(_sharedLibraryHandle, "omArenaRelease");
+  if (!dlerror() && arenaReleaseFunc)
+    arenaReleaseFunc();
+  dlclose(_sharedLibraryHandle);
+}
 } // namespace onnx_mlir
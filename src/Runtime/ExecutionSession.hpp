@@ -11,31 +11,218 @@
 
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <dlfcn.h>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "OnnxMlirRuntime.h"
+#include "onnx-mlir/Runtime/OMPerfCounters.h"
 
 namespace onnx_mlir {
 
 typedef OMTensorList *(*entryPointFuncType)(OMTensorList *);
+typedef OMTensorList *(*intoEntryPointFuncType)(OMTensorList *, OMTensorList *);
+typedef void (*arenaReleaseFuncType)();
+typedef void (*constPoolPrefetchFuncType)();
+typedef int (*perfCountersReadFuncType)(uint64_t *);
+typedef int64_t (*arenaNumAllocsFuncType)();
+typedef int (*memcpyConfigureThreadsFuncType)(const int *, int64_t, int32_t);
+typedef const char *(*signatureFuncType)();
 
 class ExecutionSession {
 public:
-  ExecutionSession(std::string sharedLibPath, std::string entryPointName);
+  // Statistics of the inferences run by the session. The hardware performance
+  // counters of the threads running the inferences are summed over the runs
+  // whose counters were read, see OMPerfCounters.h.
+  struct RunStats {
+    uint64_t runs = 0;
+    uint64_t totalNs = 0;
+    uint64_t countedRuns = 0;
+    uint64_t counters[OM_PERF_NUM_COUNTERS] = {};
+    // Heap allocations made by the memory arena of the model during the runs.
+    uint64_t allocations = 0;
+  };
+
+  // Options of the low-latency mode, see enableLowLatency.
+  struct LowLatencyOptions {
+    // Isolated CPUs to run the inferences on: the calling thread is pinned to
+    // the first one, the memory copy threads of the runtime to the others.
+    // The threads are not pinned when empty.
+    std::vector<int> cpus;
+    // Lock the memory of the process, the memory arena and the constant pool
+    // included, so that the inferences never fault on its pages.
+    bool lockMemory = true;
+    // Keep the memory copy threads spinning between the copies rather than
+    // sleeping, so that they need not be woken up by the inferences.
+    bool spinWait = true;
+  };
+
+  // The element type and dimensions of an input or output in the signature
+  // of the model, see inputSignature. The dimensions of unranked tensors are
+  // unknown.
+  struct TensorSignature {
+    std::string type;
+    bool ranked = false;
+    std::vector<int64_t> dims;
+  };
+
+  // Load the model. With a private copy, a copy of the library is loaded
+  // even if the library is already loaded in the process, so that the session
+  // has its own copy of the constants and memory arena of the model.
+  ExecutionSession(std::string sharedLibPath, std::string entryPointName,
+      bool privateCopy = false);
 
   // Use custom deleter since forward declared OMTensor hides destructor
   std::vector<std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>> run(
       std::vector<std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>>);
 
-  ~ExecutionSession();
+  // Run the model and write its results into the pre-allocated output tensors,
+  // which remain owned by the caller. Models compiled with
+  // --emit-output-buffer-entry-point write directly into the outputs, other
+  // models have their results copied into them. The outputs must be dense and
+  // match the element types and shapes of the output signature of the model,
+  // or an exception is thrown.
+  void runInto(
+      std::vector<std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>> ins,
+      const std::vector<OMTensor *> &outs);
+
+  // Run the model on input tensors which remain owned by the caller.
+  void runInto(
+      const std::vector<OMTensor *> &ins, const std::vector<OMTensor *> &outs);
+
+  // Switch the session to a low-latency mode for latency-critical
+  // deployments, in which the inferences run by runInto make no allocation.
+  // The model must be compiled with --enable-memory-arena and
+  // --emit-output-buffer-entry-point. The calling thread is pinned first, and
+  // the sample request of dense inputs and outputs is run twice on it: the
+  // first run materializes the constants and sizes the memory arena of the
+  // thread, the second one must not allocate or an exception is thrown. The
+  // memory of the process is then locked.
+  //
+  // The requests must then be run by the calling thread, one at a time, with
+  // as many dense inputs and outputs as the sample request, whose shapes need
+  // no larger memory pools.
+  void enableLowLatency(const std::vector<OMTensor *> &ins,
+      const std::vector<OMTensor *> &outs, const LowLatencyOptions &options);
+
+  // Warm up the model before it serves requests, so that the first requests
+  // run as fast as the next ones: the constant pool of the model is
+  // materialized and its pages are loaded in memory. The inputs, if any, are
+  // also run once on the calling thread, which loads the code of the model
+  // and sizes the memory arena of the thread. The arenas of the other threads
+  // are sized by their first request.
+  void warmup(
+      std::vector<std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>> ins =
+          {});
+
+  // Collect the statistics of the inferences from now on, or stop collecting
+  // them.
+  void enableRunStats(bool enable = true);
+
+  // Statistics collected since the session was created or last reset.
+  RunStats getRunStats();
+
+  void resetRunStats();
+
+  // Write the statistics in the Prometheus text exposition format, with the
+  // given model label.
+  std::string getRunStatsPrometheus(const std::string &model);
+
+  // The names, element types and shapes of the inputs and outputs of the
+  // model, as JSON arrays of {"name", "type", "dims"} objects whose unknown
+  // dimensions are -1. Empty for models compiled without their signature.
+  std::string inputSignature();
+  std::string outputSignature();
+
+  virtual ~ExecutionSession();
 
 protected:
+  // Sessions not backed by a shared library, such as the JIT execution
+  // session, set up the entry points themselves.
+  ExecutionSession() = default;
+
+  // Call the entry point of the model.
+  virtual OMTensorList *invokeEntryPoint(OMTensorList *input) {
+    return _entryPointFunc(input);
+  }
+
+  // Whether the model has an entry point writing into output buffers.
+  virtual bool hasIntoEntryPoint() const {
+    return _intoEntryPointFunc != nullptr;
+  }
+
+  // Call the entry point of the model writing into output buffers.
+  virtual void invokeIntoEntryPoint(
+      OMTensorList *input, OMTensorList *output) {
+    _intoEntryPointFunc(input, output);
+  }
+
   // Handler to the shared library file being loaded.
   void *_sharedLibraryHandle = nullptr;
 
   // Entry point function.
   entryPointFuncType _entryPointFunc = nullptr;
+
+  // Entry point function writing into output buffers, if the model has one.
+  intoEntryPointFuncType _intoEntryPointFunc = nullptr;
+
+  // Time and hardware performance counters at the start of an inference.
+  struct RunSample {
+    std::chrono::steady_clock::time_point start;
+    bool counted = false;
+    uint64_t counters[OM_PERF_NUM_COUNTERS];
+    int64_t allocations = 0;
+  };
+
+  // Sample the start and the end of an inference, for the statistics of the
+  // session.
+  void beginRun(RunSample &sample);
+  void endRun(const RunSample &sample);
+
+  // Test if a tensor is dense and row-major and starts at its data pointer,
+  // so that the entry point of the model does not copy it and its data is
+  // the buffer of omTensorGetDataBufferSize bytes at omTensorGetDataPtr, see
+  // omTensorGetContiguous.
+  static bool isDense(OMTensor *tensor);
+
+  // Parse the signature of a model, see inputSignature. The signature of
+  // models compiled without it is empty.
+  static std::vector<TensorSignature> parseSignature(
+      const std::string &signature);
+
+  // Check that the tensors to write the outputs into are dense and match the
+  // output signature of the model, if it has one.
+  void checkOutputs(const std::vector<OMTensor *> &outs);
+
+  // The Prometheus label set of the metrics of a model.
+  static std::string prometheusLabel(const std::string &model);
+
+private:
+  // Run the model in the low-latency mode on its inputs, already set in the
+  // list of inputs, and on the given outputs.
+  void runLowLatency(const std::vector<OMTensor *> &outs);
+
+  // The output signature of the model, parsed by the first request.
+  std::once_flag _outputSignatureOnce;
+  std::vector<TensorSignature> _outputSignature;
+
+  std::atomic<bool> _collectRunStats{false};
+  perfCountersReadFuncType _perfCountersReadFunc = nullptr;
+  arenaNumAllocsFuncType _arenaNumAllocsFunc = nullptr;
+  std::mutex _runStatsMutex;
+  RunStats _runStats;
+
+  // The tensors of the requests of the low-latency mode are put in lists
+  // created once, so that the requests make no allocation.
+  bool _lowLatency = false;
+  std::vector<OMTensor *> _lowLatencyIns;
+  std::vector<OMTensor *> _lowLatencyOuts;
+  OMTensorList *_lowLatencyInList = nullptr;
+  OMTensorList *_lowLatencyOutList = nullptr;
 };
 } // namespace onnx_mlir
@@ -10,7 +10,10 @@
 //===----------------------------------------------------------------------===//
 
 #include "GetEmbeddedConstPool.h"
+#include "OMHugePages.h"
 
+#include <atomic>
+#include <mutex>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,6 +26,8 @@ const int i = 1;
 #define XOR(a, b) (!(a) != !(b))
 
 extern const char constPackIsLE;
+extern const char constPackIsCompressed;
+extern const char constPackIsLazy;
 
 void checkEndianness() {
   if (XOR(IS_SYSTEM_LE(), constPackIsLE)) {
@@ -41,22 +46,76 @@ void *getEmbeddedConstPool(int64_t size_in_byte) {
   size_t size = size_in_byte;
   unsigned char *data =
       getsectiondata(&_mh_dylib_header, "binary", "param", &size);
+  if (constPackIsCompressed)
+    return decompressConstPool((const char *)data);
   float *data_ptr = (float *)data;
   void *buffer = malloc(size);
   memcpy(buffer, data, size);
   return data;
 }
 
+static const char *getConstPackData() {
+  size_t size;
+  return (const char *)getsectiondata(
+      &_mh_dylib_header, "binary", "param", &size);
+}
+
 #elif __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+
 extern char _binary_param_bin_start;
 extern char _binary_param_bin_end;
 
 void *getEmbeddedConstPool(int64_t _) {
   checkEndianness();
+  if (constPackIsCompressed)
+    return decompressConstPool(&_binary_param_bin_start);
   auto size = (unsigned int)(&_binary_param_bin_end - &_binary_param_bin_start);
-  void *buffer = malloc(size);
-  memcpy(buffer, &_binary_param_bin_start, size);
-  return buffer;
+  // The processes serving the model share a single copy of the constants.
+  static const char *sharedPool = getSharedConstPool(size, [](char *pool) {
+    memcpy(pool, &_binary_param_bin_start,
+        &_binary_param_bin_end - &_binary_param_bin_start);
+  });
+  if (sharedPool)
+    return (void *)sharedPool;
+  // The constants are read-only, every inference uses the same copy. Unless
+  // they are copied into huge pages, they are used where the shared library
+  // maps them, which the compiler aligns on pages.
+  if (omGetHugePagesMode() == OM_HUGE_PAGES_NONE &&
+      (uintptr_t)&_binary_param_bin_start % 16 == 0)
+    return (void *)&_binary_param_bin_start;
+  static void *privatePool = [size] {
+    void *buffer = omAllocPermanentBuffer(size);
+    memcpy(buffer, &_binary_param_bin_start, size);
+    return buffer;
+  }();
+  return privatePool;
+}
+
+static const char *getConstPackData() { return &_binary_param_bin_start; }
+
+// Load the pages of size bytes of memory at data and map them in the process.
+static void prefaultPages(const char *data, size_t size) {
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  auto begin = (uintptr_t)data & ~(uintptr_t)(pageSize - 1);
+  madvise((void *)begin, (uintptr_t)data + size - begin, MADV_WILLNEED);
+  volatile char sink = 0;
+  for (size_t offset = 0; offset < size; offset += pageSize)
+    sink += data[offset];
+}
+
+void omPrefetchConstPool(void) {
+  checkEndianness();
+  size_t size = &_binary_param_bin_end - &_binary_param_bin_start;
+  if (constPackIsLazy) {
+    prefaultPages(&_binary_param_bin_start, size);
+    return;
+  }
+  auto *pool = (const char *)getEmbeddedConstPool(size);
+  // A decompressed constant pool is loaded in memory as it is written.
+  if (!constPackIsCompressed)
+    prefaultPages(pool, size);
 }
 
 #else
@@ -64,8 +123,7 @@ void *getEmbeddedConstPool(int64_t _) {
 extern char constPackFileName[];
 extern int64_t constPackFileNameStrLen;
 
-void *getEmbeddedConstPool(int64_t _) {
-  checkEndianness();
+static char *readConstPackFile() {
   char *fname = (char *)calloc(1, constPackFileNameStrLen + 1);
   memcpy(fname, constPackFileName, constPackFileNameStrLen);
 
@@ -83,6 +141,54 @@ void *getEmbeddedConstPool(int64_t _) {
   fread(buffer, filelen, 1, fileptr);              // Read in the entire file
   fclose(fileptr);                                 // Close the file
 
-  return (void *)buffer;
+  return buffer;
 }
-#endif
\ No newline at end of file
+
+// The constant pack file is read once, on the first lazy constant or the
+// first decompression of the constant pack.
+static const char *getConstPackData() {
+  static const char *data = readConstPackFile();
+  return data;
+}
+
+void *getEmbeddedConstPool(int64_t _) {
+  checkEndianness();
+  if (constPackIsCompressed)
+    return decompressConstPool(getConstPackData());
+  return (void *)readConstPackFile();
+}
+#endif
+
+#ifndef __linux__
+// Only a compressed constant pool is materialized once per process.
+void omPrefetchConstPool(void) {
+  if (constPackIsCompressed && !constPackIsLazy)
+    getEmbeddedConstPool(0);
+}
+#endif
+
+void *getLazyEmbeddedConst(
+    void **storage, int64_t offset, int64_t size_in_byte) {
+  // The storage of the constant is only written once, under the lock, so that
+  // the fast path is a single acquire load.
+  auto *atomicStorage = reinterpret_cast<std::atomic<void *> *>(storage);
+  void *data = atomicStorage->load(std::memory_order_acquire);
+  if (data)
+    return data;
+
+  static std::mutex materializeMutex;
+  std::lock_guard<std::mutex> lock(materializeMutex);
+  data = atomicStorage->load(std::memory_order_relaxed);
+  if (!data) {
+    checkEndianness();
+    if (constPackIsCompressed) {
+      // The constant points into the decompressed constant pool.
+      data = getCompressedConst(getConstPackData(), offset, size_in_byte);
+    } else {
+      data = malloc(size_in_byte);
+      memcpy(data, getConstPackData() + offset, size_in_byte);
+    }
+    atomicStorage->store(data, std::memory_order_release);
+  }
+  return data;
+}
\ No newline at end of file
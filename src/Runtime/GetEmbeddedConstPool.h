@@ -11,8 +11,36 @@
 
 #pragma once
 
+#include <functional>
 #include <stdint.h>
 
 extern "C" {
 void *getEmbeddedConstPool(int64_t size_in_byte);
-}
\ No newline at end of file
+
+// Return the packed constant of size_in_byte bytes at the given offset of the
+// constant pool, materializing it in *storage on its first use. Thread-safe.
+void *getLazyEmbeddedConst(
+    void **storage, int64_t offset, int64_t size_in_byte);
+
+// Materialize the constant pool and load its pages in memory, so that the
+// first inferences do not fault on the constants. With lazy constants, the
+// pages of the constant pack they are materialized from are loaded instead.
+// Called by ExecutionSession::warmup.
+void omPrefetchConstPool(void);
+}
+// Return the constant pool decompressed from a constant pack compressed in
+// chunks, see KrnlPackedConstantOp. The constant pool is decompressed once per
+// process, on the first call, and its chunks are decompressed in parallel.
+void *decompressConstPool(const char *compressedPack);
+
+// Return the constant of size_in_byte bytes at the given offset of the
+// constant pool compressed in chunks, decompressing only the chunks it spans
+// on their first use. Thread-safe.
+void *getCompressedConst(
+    const char *compressedPack, int64_t offset, int64_t size_in_byte);
+
+// Return the constant pool of size_in_byte bytes shared read-only by the
+// processes serving the same model, filled with `fill` by the first of them,
+// or nullptr when the constant pools are not shared, see SharedConstPool.cpp.
+const char *getSharedConstPool(
+    int64_t size_in_byte, const std::function<void(char *)> &fill);
@@ -0,0 +1,150 @@
+//===--- GetExternalConstPool.cpp - Get External Const Pool API Func Impl -===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains runtime API implementation to map constant pool values
+// kept in a file next to the shared library binary files.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GetEmbeddedConstPool.h"
+#include "OMHugePages.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Adapted from:
+// https://developer.ibm.com/technologies/systems/articles/au-endianc/
+static const int i = 1;
+#define IS_SYSTEM_LE() (!((*(char *)&i) == 0))
+
+#define XOR(a, b) (!(a) != !(b))
+
+extern const char constPackIsLE;
+extern const char constPackIsCompressed;
+extern const char constPackIsLazy;
+extern char constPackFileName[];
+extern int64_t constPackFileNameStrLen;
+
+static void checkEndianness() {
+  if (XOR(IS_SYSTEM_LE(), constPackIsLE)) {
+    fprintf(stderr, "Constant pack is stored in a byte order that is not "
+                    "native to this current system.");
+    exit(1);
+  }
+}
+
+// Size of the mapped constant pack file.
+static size_t constPackSize = 0;
+
+// Read the size bytes of the constant pack file fd in huge pages, or return
+// nullptr if huge pages are not enabled or the file cannot be read.
+static void *readConstPoolInHugePages(int fd, size_t size) {
+  char *data = (char *)omHugePagesAlloc(size);
+  if (!data)
+    return nullptr;
+  size_t offset = 0;
+  while (offset < size) {
+    ssize_t count = pread(fd, data + offset, size - offset, offset);
+    if (count <= 0) {
+      omHugePagesFree(data, size);
+      return nullptr;
+    }
+    offset += count;
+  }
+  return data;
+}
+
+// Map the constant pack file, which is located in the directory of the shared
+// library. The mapping is private, so that processes serving the same model
+// share the physical pages of the file, which are only read when first used.
+// A compressed constant pack is decompressed in a constant pool of its own,
+// which may be shared as well, see SharedConstPool.cpp.
+//
+// With huge pages, which do not back the mappings of files, the file is read
+// instead in a private copy mapped in huge pages, see OMHugePages.h.
+static void *mapConstPool() {
+  std::string path(constPackFileName, constPackFileNameStrLen);
+  Dl_info info;
+  if (dladdr((void *)&getEmbeddedConstPool, &info) && info.dli_fname) {
+    std::string libPath(info.dli_fname);
+    auto pos = libPath.rfind('/');
+    if (pos != std::string::npos)
+      path = libPath.substr(0, pos + 1) + path;
+  }
+
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat fileStat;
+  if (fd < 0 || fstat(fd, &fileStat) != 0) {
+    fprintf(stderr, "Cannot open constant pack file %s.\n", path.c_str());
+    exit(1);
+  }
+  if (fileStat.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  void *data = readConstPoolInHugePages(fd, fileStat.st_size);
+  if (!data)
+    data = mmap(nullptr, fileStat.st_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Cannot map constant pack file %s.\n", path.c_str());
+    exit(1);
+  }
+  constPackSize = fileStat.st_size;
+  return data;
+}
+
+// The file is mapped once per process, on the first call.
+static const char *getConstPackData() {
+  static std::once_flag mapped;
+  static void *constPack = nullptr;
+  std::call_once(mapped, [] {
+    checkEndianness();
+    constPack = mapConstPool();
+  });
+  return (const char *)constPack;
+}
+
+// The mapping already loads the pages of the constants on their first use,
+// while a compressed constant pack is decompressed on the first call.
+void *getEmbeddedConstPool(int64_t _) {
+  if (constPackIsCompressed)
+    return decompressConstPool(getConstPackData());
+  return (void *)getConstPackData();
+}
+
+void *getLazyEmbeddedConst(
+    void **storage, int64_t offset, int64_t size_in_byte) {
+  if (constPackIsCompressed)
+    return getCompressedConst(getConstPackData(), offset, size_in_byte);
+  return (char *)getConstPackData() + offset;
+}
+
+void omPrefetchConstPool(void) {
+  const char *data = getConstPackData();
+  // A decompressed constant pool is loaded in memory as it is written.
+  if (constPackIsCompressed && !constPackIsLazy) {
+    decompressConstPool(data);
+    return;
+  }
+  if (!data)
+    return;
+  // Load the pages of the file and map them in the process.
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  madvise((void *)data, constPackSize, MADV_WILLNEED);
+  volatile char sink = 0;
+  for (size_t offset = 0; offset < constPackSize; offset += pageSize)
+    sink += data[offset];
+}
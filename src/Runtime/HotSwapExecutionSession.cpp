@@ -0,0 +1,164 @@
+//===--- HotSwapExecutionSession.cpp - HotSwapExecutionSession Impl -------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementations of HotSwapExecutionSession class, which
+// switches the requests it serves to a new version of a model without
+// stalling them.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "HotSwapExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+HotSwapExecutionSession::Version::Version(const std::string &sharedLibPath,
+    const std::string &entryPointName, uint64_t number,
+    std::shared_ptr<std::atomic<unsigned>> numLoadedVersions)
+    : ExecutionSession(sharedLibPath, entryPointName),
+      sharedLibPath(sharedLibPath), number(number),
+      _numLoadedVersions(std::move(numLoadedVersions)) {
+  dlerror();
+  _arenaReleaseFunc =
+      (arenaReleaseFuncType)dlsym(_sharedLibraryHandle, "omArenaRelease");
+  if (dlerror())
+    _arenaReleaseFunc = nullptr;
+  (*_numLoadedVersions)++;
+}
+
+HotSwapExecutionSession::Version::~Version() { (*_numLoadedVersions)--; }
+
+// A thread keeps a reference to the versions it ran with, so that their
+// libraries are not closed before it releases its arena in them.
+struct HotSwapExecutionSession::ThreadArenas {
+  std::vector<std::shared_ptr<Version>> versions;
+
+  void hold(const std::shared_ptr<Version> &version) {
+    if (std::find(versions.begin(), versions.end(), version) == versions.end())
+      versions.push_back(version);
+  }
+
+  // Release the arenas of the retired versions, and the versions with them.
+  void releaseRetired() {
+    auto retired = std::stable_partition(versions.begin(), versions.end(),
+        [](const std::shared_ptr<Version> &version) {
+          return !version->retired;
+        });
+    for (auto it = retired; it != versions.end(); ++it)
+      (*it)->releaseArena();
+    versions.erase(retired, versions.end());
+  }
+
+  // The libraries are still open when the thread exits, since the versions
+  // are released after their arenas.
+  ~ThreadArenas() {
+    for (auto &version : versions)
+      version->releaseArena();
+  }
+};
+
+HotSwapExecutionSession::ThreadArenas &
+HotSwapExecutionSession::getThreadArenas() {
+  static thread_local ThreadArenas threadArenas;
+  return threadArenas;
+}
+
+HotSwapExecutionSession::HotSwapExecutionSession(std::string sharedLibPath,
+    std::string entryPointName, WarmupFunc warmup)
+    : _entryPointName(std::move(entryPointName)), _warmup(std::move(warmup)) {
+  _current = load(sharedLibPath, 0);
+  _loader = std::thread(&HotSwapExecutionSession::loaderLoop, this);
+}
+
+std::shared_ptr<HotSwapExecutionSession::Version>
+HotSwapExecutionSession::load(
+    const std::string &sharedLibPath, uint64_t number) {
+  auto version = std::make_shared<Version>(
+      sharedLibPath, _entryPointName, number, _numLoadedVersions);
+  version->warmup();
+  if (_warmup) {
+    _warmup(*version);
+    // The loader thread does not serve requests, its arena is not reused.
+    version->releaseArena();
+  }
+  return version;
+}
+
+std::vector<HotSwapExecutionSession::OMTensorPtr> HotSwapExecutionSession::run(
+    std::vector<OMTensorPtr> ins) {
+  auto version = std::atomic_load(&_current);
+  auto outs = version->run(std::move(ins));
+  // The memory arena of a thread belongs to the library of the version it
+  // ran with. Versions retired since the last request of the thread, or
+  // during this one, are released with their arena.
+  ThreadArenas &threadArenas = getThreadArenas();
+  if (version->hasArena())
+    threadArenas.hold(version);
+  threadArenas.releaseRetired();
+  return outs;
+}
+
+std::future<void> HotSwapExecutionSession::reload(std::string sharedLibPath) {
+  ReloadRequest request;
+  request.sharedLibPath = std::move(sharedLibPath);
+  auto done = request.done.get_future();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stopping)
+      throw std::runtime_error("Cannot reload a stopping session");
+    _reloads.emplace(std::move(request));
+  }
+  _reloadAvailable.notify_one();
+  return done;
+}
+
+uint64_t HotSwapExecutionSession::getVersion() const {
+  return std::atomic_load(&_current)->number;
+}
+
+std::string HotSwapExecutionSession::getSharedLibPath() const {
+  return std::atomic_load(&_current)->sharedLibPath;
+}
+
+void HotSwapExecutionSession::loaderLoop() {
+  while (true) {
+    ReloadRequest request;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _reloadAvailable.wait(
+          lock, [this] { return _stopping || !_reloads.empty(); });
+      if (_reloads.empty())
+        break;
+      request = std::move(_reloads.front());
+      _reloads.pop();
+    }
+
+    try {
+      // Only the loader thread replaces the current version.
+      auto number = std::atomic_load(&_current)->number + 1;
+      auto version = load(request.sharedLibPath, number);
+      // The previous version is closed when the last request running with
+      // it, and the last thread holding an arena in it, release it.
+      std::atomic_exchange(&_current, std::move(version))->retired = true;
+      request.done.set_value();
+    } catch (...) {
+      request.done.set_exception(std::current_exception());
+    }
+  }
+}
+
+HotSwapExecutionSession::~HotSwapExecutionSession() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _reloadAvailable.notify_all();
+  _loader.join();
+  std::atomic_load(&_current)->retired = true;
+}
+} // namespace onnx_mlir
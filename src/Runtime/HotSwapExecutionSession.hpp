@@ -0,0 +1,149 @@
+//===--- HotSwapExecutionSession.hpp - HotSwapExecutionSession Declaration ===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declarations of HotSwapExecutionSession class, which
+// switches the requests it serves to a new version of a model without
+// stalling them.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "ExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+// A session serving the requests with the current version of a model, and
+// loading the new versions of the model in the background:
+//
+//   - reload() queues the loading of a new version on the loader thread of
+//     the session, which opens its library and warms it up, e.g. by running
+//     it once so that its constants are materialized,
+//   - once warmed up, the new version atomically becomes the current one, the
+//     requests started afterwards run with it,
+//   - the previous version is retired: its library is closed once the
+//     requests still running with it complete, and the threads which ran
+//     requests with it released their memory arena in the library.
+//
+// A thread releases the arenas of the retired versions it ran with at the end
+// of its next request, or when it exits, so the library of a retired version
+// stays open while a thread which ran with it is idle.
+//
+// The requests never wait for a version to be loaded. Each version must be
+// a distinct file, e.g. model-v2.so, since opening a library with the path of
+// a library already open in the process returns the open library.
+class HotSwapExecutionSession {
+public:
+  typedef std::unique_ptr<OMTensor, decltype(&omTensorDestroy)> OMTensorPtr;
+
+  // Warm up a version of the model before it serves requests, e.g. by running
+  // representative inputs, once its constant pool is loaded by
+  // ExecutionSession::warmup. It runs on the loader thread, exceptions it
+  // raises abort the reload.
+  typedef std::function<void(ExecutionSession &)> WarmupFunc;
+
+  // Load and warm up the first version of the model.
+  HotSwapExecutionSession(std::string sharedLibPath,
+      std::string entryPointName, WarmupFunc warmup = nullptr);
+
+  // Run a request with the current version of the model. It is safe to call
+  // from several threads.
+  std::vector<OMTensorPtr> run(std::vector<OMTensorPtr> ins);
+
+  // Queue the loading of a new version of the model and return a future set
+  // once the new version serves the requests. Exceptions raised while loading
+  // or warming up the new version are rethrown by the future, the current
+  // version then keeps serving the requests.
+  std::future<void> reload(std::string sharedLibPath);
+
+  // Number of the version serving the requests, starting at 0 and incremented
+  // by each successful reload.
+  uint64_t getVersion() const;
+
+  // Path of the library of the version serving the requests.
+  std::string getSharedLibPath() const;
+
+  // Number of versions whose library is open, i.e. the current version and
+  // the retired versions still running requests or holding the arena of a
+  // thread.
+  unsigned getNumLoadedVersions() const { return *_numLoadedVersions; }
+
+  // Wait for the queued reloads to complete and stop the loader thread. The
+  // current version is retired, its library is closed like the libraries of
+  // the other retired versions.
+  ~HotSwapExecutionSession();
+
+protected:
+  // A version of the model.
+  class Version : public ExecutionSession {
+  public:
+    Version(const std::string &sharedLibPath,
+        const std::string &entryPointName, uint64_t number,
+        std::shared_ptr<std::atomic<unsigned>> numLoadedVersions);
+    ~Version();
+
+    // Whether the model keeps its memory pools in a memory arena.
+    bool hasArena() const { return _arenaReleaseFunc; }
+
+    // Release the memory arena of the calling thread, if the model has one.
+    void releaseArena() const {
+      if (_arenaReleaseFunc)
+        _arenaReleaseFunc();
+    }
+
+    const std::string sharedLibPath;
+    const uint64_t number;
+    // Set once the version no longer serves the requests.
+    std::atomic<bool> retired{false};
+
+  private:
+    arenaReleaseFuncType _arenaReleaseFunc = nullptr;
+    // Shared with the session, which may be destroyed first.
+    std::shared_ptr<std::atomic<unsigned>> _numLoadedVersions;
+  };
+
+  // The versions in which the calling thread owns a memory arena.
+  struct ThreadArenas;
+  static ThreadArenas &getThreadArenas();
+
+  struct ReloadRequest {
+    std::string sharedLibPath;
+    std::promise<void> done;
+  };
+
+  // Open and warm up a version of the model.
+  std::shared_ptr<Version> load(
+      const std::string &sharedLibPath, uint64_t number);
+
+  // Load the queued versions until the session is destroyed.
+  void loaderLoop();
+
+  const std::string _entryPointName;
+  const WarmupFunc _warmup;
+  std::shared_ptr<std::atomic<unsigned>> _numLoadedVersions =
+      std::make_shared<std::atomic<unsigned>>(0);
+
+  // The current version, read and replaced with the atomic shared_ptr
+  // functions. The requests keep a reference to the version they run with.
+  std::shared_ptr<Version> _current;
+
+  std::thread _loader;
+  std::queue<ReloadRequest> _reloads;
+  std::mutex _mutex;
+  std::condition_variable _reloadAvailable;
+  bool _stopping = false;
+};
+} // namespace onnx_mlir
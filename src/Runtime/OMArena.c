@@ -0,0 +1,91 @@
+//===------------------ OMArena.c - OMArena C Implementation --------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementation of the memory arena holding the memory
+// pools of compiled models across invocations. Each thread owns its arena, so
+// concurrent invocations never contend for the memory of a slot.
+//
+// The slots are backed by 2MB huge pages when enabled with
+// ONNX_MLIR_HUGE_PAGES, see OMHugePages.h.
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdlib.h>
+
+#include "OMHugePages.h"
+#include "onnx-mlir/Runtime/OMArena.h"
+
+typedef struct {
+  void *ptr;
+  int64_t size;
+  // Whether ptr is mapped in huge pages rather than allocated with malloc.
+  int isHugePages;
+} OMArenaSlot;
+
+static _Thread_local OMArenaSlot *_slots = NULL;
+static _Thread_local int64_t _numSlots = 0;
+// Number of heap allocations made by the arena of the thread.
+static _Thread_local int64_t _numAllocs = 0;
+
+static void freeSlot(OMArenaSlot *entry) {
+  if (entry->isHugePages)
+    omHugePagesFree(entry->ptr, entry->size);
+  else
+    free(entry->ptr);
+  entry->ptr = NULL;
+  entry->size = 0;
+  entry->isHugePages = 0;
+}
+
+static void allocSlot(OMArenaSlot *entry, int64_t size) {
+  _numAllocs++;
+  entry->ptr = omHugePagesAlloc(size);
+  entry->isHugePages = entry->ptr != NULL;
+  if (!entry->ptr)
+    entry->ptr = malloc(size > 0 ? size : 1);
+  entry->size = entry->ptr ? size : 0;
+}
+
+void *omArenaGet(int64_t slot, int64_t size) {
+  if (slot < 0)
+    return NULL;
+
+  // Grow the table of slots to hold the requested slot.
+  if (slot >= _numSlots) {
+    int64_t numSlots = slot + 1;
+    OMArenaSlot *slots = realloc(_slots, numSlots * sizeof(OMArenaSlot));
+    _numAllocs++;
+    if (!slots)
+      return NULL;
+    for (int64_t i = _numSlots; i < numSlots; i++) {
+      slots[i].ptr = NULL;
+      slots[i].size = 0;
+      slots[i].isHugePages = 0;
+    }
+    _slots = slots;
+    _numSlots = numSlots;
+  }
+
+  // Reuse the memory of the slot unless the requested size is larger. The
+  // content of a memory pool does not outlive an invocation so there is no
+  // need to copy it.
+  OMArenaSlot *entry = &_slots[slot];
+  if (size > entry->size || !entry->ptr) {
+    freeSlot(entry);
+    allocSlot(entry, size);
+  }
+  return entry->ptr;
+}
+
+int64_t omArenaGetNumAllocs(void) { return _numAllocs; }
+
+void omArenaRelease(void) {
+  for (int64_t i = 0; i < _numSlots; i++)
+    freeSlot(&_slots[i]);
+  free(_slots);
+  _slots = NULL;
+  _numSlots = 0;
+}
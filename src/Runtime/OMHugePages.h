@@ -0,0 +1,116 @@
+//===------------- OMHugePages.h - Huge Page Allocation Helpers -----------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains the helper functions allocating the large, randomly
+// accessed buffers of the runtime, i.e. the memory pools of the arena and the
+// constant pools, in 2MB huge pages, so that they take fewer TLB entries.
+//
+// Huge pages are enabled at run time with ONNX_MLIR_HUGE_PAGES in the
+// environment:
+//
+//   - madvise: anonymous mappings aligned to 2MB, advised to be backed by
+//     transparent huge pages,
+//   - hugetlb: mappings of explicit huge pages reserved by the system, e.g.
+//     with /proc/sys/vm/nr_hugepages, falling back to madvise when none is
+//     left.
+//
+// The buffers are allocated with malloc otherwise, or when the mappings fail.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef ONNX_MLIR_OMHUGEPAGES_H
+#define ONNX_MLIR_OMHUGEPAGES_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#define OM_HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+typedef enum {
+  OM_HUGE_PAGES_NONE = 0,
+  OM_HUGE_PAGES_MADVISE = 1,
+  OM_HUGE_PAGES_HUGETLB = 2,
+} OMHugePagesMode;
+
+/* Return the huge pages mode requested by ONNX_MLIR_HUGE_PAGES. */
+static inline OMHugePagesMode omGetHugePagesMode(void) {
+#ifdef __linux__
+  const char *env = getenv("ONNX_MLIR_HUGE_PAGES");
+  if (env && strcmp(env, "madvise") == 0)
+    return OM_HUGE_PAGES_MADVISE;
+  if (env && strcmp(env, "hugetlb") == 0)
+    return OM_HUGE_PAGES_HUGETLB;
+#endif
+  return OM_HUGE_PAGES_NONE;
+}
+
+/* Return the size of the huge page mapping holding size bytes. */
+static inline size_t omHugePagesMappedSize(size_t size) {
+  size_t numPages = (size + OM_HUGE_PAGE_SIZE - 1) / OM_HUGE_PAGE_SIZE;
+  return (numPages > 0 ? numPages : 1) * OM_HUGE_PAGE_SIZE;
+}
+
+/*
+ * Map size bytes of memory aligned to 2MB in huge pages, or return NULL if
+ * huge pages are not enabled or cannot be mapped. The memory is zeroed and
+ * must be released with omHugePagesFree.
+ */
+static inline void *omHugePagesAlloc(size_t size) {
+#ifdef __linux__
+  OMHugePagesMode mode = omGetHugePagesMode();
+  if (mode == OM_HUGE_PAGES_NONE)
+    return NULL;
+  size_t mappedSize = omHugePagesMappedSize(size);
+
+  if (mode == OM_HUGE_PAGES_HUGETLB) {
+    void *data = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED)
+      return data;
+  }
+
+  /* Over-allocate by a huge page and trim the mapping to a 2MB boundary, so
+   * that the kernel can back all of it with transparent huge pages. */
+  char *data = (char *)mmap(NULL, mappedSize + OM_HUGE_PAGE_SIZE,
+      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if ((void *)data == MAP_FAILED)
+    return NULL;
+  uintptr_t begin = ((uintptr_t)data + OM_HUGE_PAGE_SIZE - 1) &
+                    ~(uintptr_t)(OM_HUGE_PAGE_SIZE - 1);
+  size_t head = begin - (uintptr_t)data;
+  if (head > 0)
+    munmap(data, head);
+  munmap((char *)begin + mappedSize, OM_HUGE_PAGE_SIZE - head);
+  madvise((void *)begin, mappedSize, MADV_HUGEPAGE);
+  return (void *)begin;
+#else
+  return NULL;
+#endif
+}
+
+/* Release the memory of size bytes returned by omHugePagesAlloc. */
+static inline void omHugePagesFree(void *ptr, size_t size) {
+#ifdef __linux__
+  if (ptr)
+    munmap(ptr, omHugePagesMappedSize(size));
+#endif
+}
+
+/*
+ * Allocate a buffer of size bytes which is never released, in huge pages if
+ * they are enabled, with malloc otherwise.
+ */
+static inline void *omAllocPermanentBuffer(size_t size) {
+  void *data = omHugePagesAlloc(size);
+  return data ? data : malloc(size > 0 ? size : 1);
+}
+
+#endif // ONNX_MLIR_OMHUGEPAGES_H
@@ -0,0 +1,364 @@
+//===-------------- OMInstrument.cpp - OMInstrument Implementation --------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementation of the profiling hook called by models
+// compiled with --instrument, and of the functions writing the recorded
+// profile.
+//
+// Each thread pairs the calls made before and after an operation on its own
+// stack. The completed operations are then added to a profile shared by all
+// the threads, which aggregates them per node and keeps the first of them for
+// the trace. With ONNX_MLIR_PERF_COUNTERS=1, the hardware performance
+// counters of the thread are read along with the time, see OMPerfCounters.h.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "onnx-mlir/Runtime/OMInstrument.h"
+#include "onnx-mlir/Runtime/OMPerfCounters.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct OMInstrumentNode {
+  const char *opName;
+  const char *nodeName;
+  const char *shapes;
+
+  bool operator<(const OMInstrumentNode &other) const {
+    return std::tie(opName, nodeName, shapes) <
+           std::tie(other.opName, other.nodeName, other.shapes);
+  }
+};
+
+struct OMInstrumentStats {
+  int64_t calls = 0;
+  int64_t totalNs = 0;
+  // Calls whose hardware performance counters were read, and their sums.
+  int64_t countedCalls = 0;
+  uint64_t counters[OM_PERF_NUM_COUNTERS] = {};
+
+  void add(const OMInstrumentStats &other) {
+    calls += other.calls;
+    totalNs += other.totalNs;
+    countedCalls += other.countedCalls;
+    for (int i = 0; i < OM_PERF_NUM_COUNTERS; i++)
+      counters[i] += other.counters[i];
+  }
+};
+
+struct OMInstrumentEvent {
+  OMInstrumentNode node;
+  int64_t startNs;
+  int64_t durationNs;
+  int64_t threadId;
+};
+
+struct OMInstrumentOpenEvent {
+  const char *opName;
+  Clock::time_point start;
+  bool counted;
+  uint64_t counters[OM_PERF_NUM_COUNTERS];
+};
+
+struct OMInstrumentProfile {
+  std::mutex mutex;
+  Clock::time_point origin = Clock::now();
+  std::map<OMInstrumentNode, OMInstrumentStats> stats;
+  std::vector<OMInstrumentEvent> events;
+  size_t maxEvents;
+
+  OMInstrumentProfile() {
+    const char *maxEventsEnv = std::getenv("ONNX_MLIR_INSTRUMENT_MAX_EVENTS");
+    maxEvents = maxEventsEnv ? std::strtoull(maxEventsEnv, nullptr, 10)
+                             : (size_t)1 << 20;
+  }
+};
+
+OMInstrumentProfile &getProfile() {
+  static OMInstrumentProfile profile;
+  return profile;
+}
+
+int64_t getThreadId() {
+  static std::atomic<int64_t> numThreads(0);
+  static thread_local int64_t threadId = numThreads++;
+  return threadId;
+}
+
+thread_local std::vector<OMInstrumentOpenEvent> openEvents;
+
+double toMs(int64_t ns) { return ns / 1e6; }
+
+/// Write a string as a Prometheus label value.
+void writePrometheusLabel(FILE *file, const char *str) {
+  fputc('"', file);
+  for (const char *c = str; *c; ++c) {
+    if (*c == '"' || *c == '\\')
+      fprintf(file, "\\%c", *c);
+    else if (*c == '\n')
+      fprintf(file, "\\n");
+    else
+      fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+/// Write a string as a JSON string literal.
+void writeJSONString(FILE *file, const char *str) {
+  fputc('"', file);
+  for (const char *c = str; *c; ++c) {
+    if (*c == '"' || *c == '\\')
+      fprintf(file, "\\%c", *c);
+    else if ((unsigned char)*c < 0x20)
+      fprintf(file, "\\u%04x", (unsigned char)*c);
+    else
+      fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+} // namespace
+
+void omInstrumentPoint(
+    const char *opName, const char *nodeName, const char *shapes, int64_t tag) {
+  if (tag == 0) {
+    openEvents.push_back({opName, Clock::now()});
+    OMInstrumentOpenEvent &event = openEvents.back();
+    // The counters are read last, so that they do not count the hook.
+    event.counted = omPerfCountersRead(event.counters) == 0;
+    return;
+  }
+  uint64_t counters[OM_PERF_NUM_COUNTERS];
+  bool counted = omPerfCountersRead(counters) == 0;
+  Clock::time_point now = Clock::now();
+
+  // Ignore a call not matching the innermost open operation instead of
+  // attributing its time to another operation.
+  if (openEvents.empty() || openEvents.back().opName != opName)
+    return;
+  const OMInstrumentOpenEvent &open = openEvents.back();
+  Clock::time_point start = open.start;
+  counted &= open.counted;
+  for (int i = 0; counted && i < OM_PERF_NUM_COUNTERS; i++)
+    counters[i] -= open.counters[i];
+  openEvents.pop_back();
+
+  OMInstrumentProfile &profile = getProfile();
+  OMInstrumentNode node = {opName, nodeName, shapes};
+  int64_t durationNs =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - start)
+          .count();
+  int64_t threadId = getThreadId();
+
+  std::lock_guard<std::mutex> lock(profile.mutex);
+  OMInstrumentStats &stats = profile.stats[node];
+  stats.calls++;
+  stats.totalNs += durationNs;
+  if (counted) {
+    stats.countedCalls++;
+    for (int i = 0; i < OM_PERF_NUM_COUNTERS; i++)
+      stats.counters[i] += counters[i];
+  }
+  if (profile.events.size() < profile.maxEvents) {
+    int64_t startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        start - profile.origin)
+                          .count();
+    profile.events.push_back({node, startNs, durationNs, threadId});
+  }
+}
+
+int omInstrumentDumpProfile(const char *path) {
+  FILE *file = path ? fopen(path, "w") : stdout;
+  if (!file)
+    return -1;
+
+  OMInstrumentProfile &profile = getProfile();
+  std::vector<std::pair<OMInstrumentNode, OMInstrumentStats>> nodes;
+  std::map<std::string, OMInstrumentStats> ops;
+  int64_t totalNs = 0;
+  {
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    nodes.assign(profile.stats.begin(), profile.stats.end());
+  }
+  bool counted = false;
+  for (auto &entry : nodes) {
+    ops[entry.first.opName].add(entry.second);
+    totalNs += entry.second.totalNs;
+    counted |= entry.second.countedCalls > 0;
+  }
+  std::sort(nodes.begin(), nodes.end(), [](const auto &a, const auto &b) {
+    return a.second.totalNs > b.second.totalNs;
+  });
+  std::vector<std::pair<std::string, OMInstrumentStats>> sortedOps(
+      ops.begin(), ops.end());
+  std::sort(sortedOps.begin(), sortedOps.end(),
+      [](const auto &a, const auto &b) {
+        return a.second.totalNs > b.second.totalNs;
+      });
+
+  // With hardware performance counters, the average cycles, instructions
+  // per cycle and memory traffic estimated from the last level cache misses
+  // of each call follow the times.
+  auto printCounters = [&](const OMInstrumentStats &stats) {
+    if (!counted)
+      return;
+    double calls = stats.countedCalls > 0 ? stats.countedCalls : 1;
+    double cycles = stats.counters[OM_PERF_CYCLES];
+    fprintf(file, " %12.3f %6.2f %12.3f", cycles / calls / 1e6,
+        cycles > 0 ? stats.counters[OM_PERF_INSTRUCTIONS] / cycles : 0.0,
+        stats.counters[OM_PERF_LLC_MISSES] * OM_PERF_CACHE_LINE_BYTES /
+            calls / 1e6);
+  };
+  auto printCounterHeaders = [&]() {
+    if (counted)
+      fprintf(file, " %12s %6s %12s", "avg Mcycles", "IPC", "avg mem MB");
+  };
+
+  double total = totalNs > 0 ? totalNs : 1;
+  fprintf(file, "%-24s %-32s %10s %12s %12s %7s", "op", "node", "calls",
+      "total ms", "avg ms", "%");
+  printCounterHeaders();
+  fprintf(file, "  %s\n", "shapes");
+  for (auto &entry : nodes) {
+    const OMInstrumentStats &stats = entry.second;
+    fprintf(file, "%-24s %-32s %10lld %12.3f %12.3f %7.2f", entry.first.opName,
+        entry.first.nodeName, (long long)stats.calls, toMs(stats.totalNs),
+        toMs(stats.totalNs) / stats.calls, 100.0 * stats.totalNs / total);
+    printCounters(stats);
+    fprintf(file, "  %s\n", entry.first.shapes);
+  }
+  fprintf(file, "\n%-24s %10s %12s %12s %7s", "op", "calls", "total ms",
+      "avg ms", "%");
+  printCounterHeaders();
+  fprintf(file, "\n");
+  for (auto &entry : sortedOps) {
+    const OMInstrumentStats &stats = entry.second;
+    fprintf(file, "%-24s %10lld %12.3f %12.3f %7.2f", entry.first.c_str(),
+        (long long)stats.calls, toMs(stats.totalNs),
+        toMs(stats.totalNs) / stats.calls, 100.0 * stats.totalNs / total);
+    printCounters(stats);
+    fprintf(file, "\n");
+  }
+
+  if (file == stdout)
+    return fflush(file) == 0 ? 0 : -1;
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+int omInstrumentDumpChromeTrace(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file)
+    return -1;
+
+  OMInstrumentProfile &profile = getProfile();
+  std::vector<OMInstrumentEvent> events;
+  {
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    events = profile.events;
+  }
+
+  // Complete events ("X") carry their start and duration in microseconds.
+  fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  for (size_t i = 0; i < events.size(); ++i) {
+    const OMInstrumentEvent &event = events[i];
+    fprintf(file, "%s\n  {\"name\": ", i ? "," : "");
+    writeJSONString(file, event.node.opName);
+    fprintf(file,
+        ", \"cat\": \"onnx\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+        "\"pid\": 0, \"tid\": %lld, \"args\": {\"node\": ",
+        event.startNs / 1e3, event.durationNs / 1e3,
+        (long long)event.threadId);
+    writeJSONString(file, event.node.nodeName);
+    fprintf(file, ", \"shapes\": ");
+    writeJSONString(file, event.node.shapes);
+    fprintf(file, "}}");
+  }
+  fprintf(file, "\n]}\n");
+
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+int omInstrumentDumpPrometheus(const char *path) {
+  FILE *file = path ? fopen(path, "w") : stdout;
+  if (!file)
+    return -1;
+
+  OMInstrumentProfile &profile = getProfile();
+  std::vector<std::pair<OMInstrumentNode, OMInstrumentStats>> nodes;
+  {
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    nodes.assign(profile.stats.begin(), profile.stats.end());
+  }
+
+  // One sample per node for each metric, the counters only counting the
+  // calls whose hardware performance counters were read.
+  struct Metric {
+    const char *name;
+    const char *help;
+    std::function<double(const OMInstrumentStats &)> value;
+  };
+  const Metric metrics[] = {
+      {"onnx_mlir_op_calls_total", "Number of calls of the ONNX node.",
+          [](const OMInstrumentStats &s) { return (double)s.calls; }},
+      {"onnx_mlir_op_seconds_total", "Time spent in the ONNX node.",
+          [](const OMInstrumentStats &s) { return s.totalNs / 1e9; }},
+      {"onnx_mlir_op_counted_calls_total",
+          "Number of calls of the ONNX node with hardware counters.",
+          [](const OMInstrumentStats &s) { return (double)s.countedCalls; }},
+      {"onnx_mlir_op_cycles_total", "CPU cycles spent in the ONNX node.",
+          [](const OMInstrumentStats &s) {
+            return (double)s.counters[OM_PERF_CYCLES];
+          }},
+      {"onnx_mlir_op_instructions_total",
+          "Instructions retired in the ONNX node.",
+          [](const OMInstrumentStats &s) {
+            return (double)s.counters[OM_PERF_INSTRUCTIONS];
+          }},
+      {"onnx_mlir_op_llc_misses_total",
+          "Last level cache misses in the ONNX node.",
+          [](const OMInstrumentStats &s) {
+            return (double)s.counters[OM_PERF_LLC_MISSES];
+          }},
+  };
+  for (const Metric &metric : metrics) {
+    fprintf(file, "# HELP %s %s\n# TYPE %s counter\n", metric.name,
+        metric.help, metric.name);
+    for (auto &entry : nodes) {
+      fprintf(file, "%s{op=", metric.name);
+      writePrometheusLabel(file, entry.first.opName);
+      fprintf(file, ",node=");
+      writePrometheusLabel(file, entry.first.nodeName);
+      fprintf(file, ",shapes=");
+      writePrometheusLabel(file, entry.first.shapes);
+      fprintf(file, "} %.17g\n", metric.value(entry.second));
+    }
+  }
+
+  if (file == stdout)
+    return fflush(file) == 0 ? 0 : -1;
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+void omInstrumentReset(void) {
+  OMInstrumentProfile &profile = getProfile();
+  std::lock_guard<std::mutex> lock(profile.mutex);
+  profile.stats.clear();
+  profile.events.clear();
+  profile.origin = Clock::now();
+}
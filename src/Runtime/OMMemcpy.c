@@ -0,0 +1,341 @@
+//===----------------- OMMemcpy.c - OMMemcpy C Implementation -------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementation of the memory copy functions called by
+// the compiled models.
+//
+//===----------------------------------------------------------------------===//
+
+// For pthread_setaffinity_np.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "onnx-mlir/Runtime/OMMemcpy.h"
+
+void omMemcpyNonTemporal(void *dest, const void *src, int64_t size) {
+#if defined(__SSE2__) || defined(_M_X64)
+  char *d = (char *)dest;
+  const char *s = (const char *)src;
+
+  // The 16-byte non-temporal stores must be aligned, the bytes before the
+  // first aligned address and after the last one are copied by memcpy.
+  int64_t head = (16 - ((uintptr_t)d & 15)) & 15;
+  if (head > size)
+    head = size;
+  memcpy(d, s, head);
+  d += head;
+  s += head;
+  size -= head;
+  for (; size >= 16; size -= 16, d += 16, s += 16)
+    _mm_stream_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+  memcpy(d, s, size);
+
+  // Non-temporal stores are weakly ordered, make them visible before the
+  // stores that follow, e.g. those signaling the completion of a thread.
+  _mm_sfence();
+#elif defined(__aarch64__)
+  char *d = (char *)dest;
+  const char *s = (const char *)src;
+  for (; size >= 16; size -= 16, d += 16, s += 16) {
+    uint64_t low, high;
+    memcpy(&low, s, 8);
+    memcpy(&high, s + 8, 8);
+    __asm__ volatile("stnp %0, %1, [%2]" : : "r"(low), "r"(high), "r"(d)
+                     : "memory");
+  }
+  memcpy(d, s, size);
+#else
+  memcpy(dest, src, size);
+#endif
+}
+
+static void copyChunk(
+    char *dest, const char *src, int64_t size, int32_t nonTemporal) {
+  if (nonTemporal)
+    omMemcpyNonTemporal(dest, src, size);
+  else
+    memcpy(dest, src, size);
+}
+
+#ifndef _WIN32
+// Maximum number of memory copy threads. A few threads saturate the memory
+// bandwidth of a socket, more only contend for it.
+#define OM_MEMCPY_MAX_THREADS 7
+
+// Minimum size in bytes of the chunks of a parallel copy.
+#define OM_MEMCPY_MIN_CHUNK_SIZE ((int64_t)256 * 1024)
+
+// The parallel copy being run. The threads take the next chunk to copy until
+// none is left, the last one to finish a chunk wakes up the caller.
+typedef struct {
+  char *dest;
+  const char *src;
+  int64_t size;
+  int64_t chunkSize;
+  int64_t numChunks;
+  int64_t nextChunk;
+  int64_t numDoneChunks;
+  int32_t nonTemporal;
+} OMMemcpyJob;
+
+static pthread_once_t _poolOnce = PTHREAD_ONCE_INIT;
+static int64_t _numThreads = 0;
+static pthread_t *_threads = NULL;
+// Whether the threads and the caller spin while they wait rather than sleep,
+// see omMemcpyConfigureThreads.
+static int32_t _spinWait = 0;
+// Set when the library is unloaded, the threads then exit.
+static int32_t _stopping = 0;
+// Held by the caller of the parallel copy being run.
+static pthread_mutex_t _callerMutex = PTHREAD_MUTEX_INITIALIZER;
+// Guards the job and the generation.
+static pthread_mutex_t _jobMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _jobCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t _doneCond = PTHREAD_COND_INITIALIZER;
+static OMMemcpyJob _job;
+// Incremented for each parallel copy, so that the threads wake up once each.
+static uint64_t _generation = 0;
+
+// Hint the processor that the calling thread is spinning.
+static inline void cpuRelax(void) {
+#if defined(__SSE2__) || defined(_M_X64)
+  _mm_pause();
+#elif defined(__aarch64__)
+  __asm__ volatile("yield");
+#endif
+}
+
+// Copy the chunks of the current job until none is left. Called with the job
+// mutex held, which is released while copying.
+static void copyChunks(void) {
+  while (_job.nextChunk < _job.numChunks) {
+    int64_t chunk = _job.nextChunk++;
+    int64_t begin = chunk * _job.chunkSize;
+    int64_t size = _job.size - begin;
+    if (size > _job.chunkSize)
+      size = _job.chunkSize;
+    char *dest = _job.dest + begin;
+    const char *src = _job.src + begin;
+    int32_t nonTemporal = _job.nonTemporal;
+    pthread_mutex_unlock(&_jobMutex);
+    copyChunk(dest, src, size, nonTemporal);
+    pthread_mutex_lock(&_jobMutex);
+    // The caller may spin on the number of chunks done without the mutex.
+    if (__atomic_add_fetch(&_job.numDoneChunks, 1, __ATOMIC_RELEASE) ==
+        _job.numChunks)
+      pthread_cond_signal(&_doneCond);
+  }
+}
+
+static void *memcpyThread(void *arg) {
+  uint64_t seenGeneration = 0;
+  pthread_mutex_lock(&_jobMutex);
+  while (1) {
+    while (_generation == seenGeneration) {
+      if (_stopping) {
+        pthread_mutex_unlock(&_jobMutex);
+        return NULL;
+      }
+      if (!__atomic_load_n(&_spinWait, __ATOMIC_RELAXED)) {
+        pthread_cond_wait(&_jobCond, &_jobMutex);
+        continue;
+      }
+      pthread_mutex_unlock(&_jobMutex);
+      while (__atomic_load_n(&_generation, __ATOMIC_ACQUIRE) ==
+                 seenGeneration &&
+             __atomic_load_n(&_spinWait, __ATOMIC_RELAXED) &&
+             !__atomic_load_n(&_stopping, __ATOMIC_RELAXED))
+        cpuRelax();
+      pthread_mutex_lock(&_jobMutex);
+    }
+    seenGeneration = _generation;
+    copyChunks();
+  }
+}
+
+static void startMemcpyThreads(void) {
+  int64_t numThreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  if (numThreads > OM_MEMCPY_MAX_THREADS)
+    numThreads = OM_MEMCPY_MAX_THREADS;
+  const char *env = getenv("ONNX_MLIR_MEMCPY_THREADS");
+  if (env)
+    numThreads = atoll(env);
+  if (numThreads <= 0 ||
+      !(_threads = (pthread_t *)malloc(numThreads * sizeof(pthread_t))))
+    return;
+  for (int64_t i = 0; i < numThreads; ++i) {
+    if (pthread_create(&_threads[i], NULL, memcpyThread, NULL) != 0)
+      break;
+    _numThreads++;
+  }
+}
+
+// Stop and join the threads when the library is unloaded or the process
+// exits, so that no thread is left running, or spinning, in the code of an
+// unloaded library.
+__attribute__((destructor)) static void stopMemcpyThreads(void) {
+  if (!_threads)
+    return;
+  pthread_mutex_lock(&_jobMutex);
+  __atomic_store_n(&_stopping, 1, __ATOMIC_RELAXED);
+  pthread_cond_broadcast(&_jobCond);
+  pthread_mutex_unlock(&_jobMutex);
+  for (int64_t i = 0; i < _numThreads; ++i)
+    pthread_join(_threads[i], NULL);
+  free(_threads);
+  _threads = NULL;
+  _numThreads = 0;
+}
+#endif
+
+int omMemcpyConfigureThreads(
+    const int *cpus, int64_t numCpus, int32_t spinWait) {
+  int result = 0;
+#ifndef _WIN32
+  pthread_once(&_poolOnce, startMemcpyThreads);
+#ifdef __linux__
+  // The first CPU is left to the caller.
+  for (int64_t i = 0; numCpus > 1 && i < _numThreads; ++i) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpus[1 + i % (numCpus - 1)], &cpuSet);
+    if (pthread_setaffinity_np(_threads[i], sizeof(cpu_set_t), &cpuSet) != 0)
+      result = -1;
+  }
+#else
+  if (numCpus > 1)
+    result = -1;
+#endif
+  // The sleeping threads are woken up to spin.
+  pthread_mutex_lock(&_jobMutex);
+  __atomic_store_n(&_spinWait, spinWait, __ATOMIC_RELAXED);
+  pthread_cond_broadcast(&_jobCond);
+  pthread_mutex_unlock(&_jobMutex);
+#endif
+  return result;
+}
+
+void omMemcpyParallel(void *dest, const void *src, int64_t size,
+    int64_t threshold, int32_t nonTemporal) {
+#ifndef _WIN32
+  if (size >= threshold && size >= 2 * OM_MEMCPY_MIN_CHUNK_SIZE) {
+    pthread_once(&_poolOnce, startMemcpyThreads);
+    // Copies made while another one is split are not split.
+    if (_numThreads > 0 && pthread_mutex_trylock(&_callerMutex) == 0) {
+      int64_t numChunks = size / OM_MEMCPY_MIN_CHUNK_SIZE;
+      if (numChunks > _numThreads + 1)
+        numChunks = _numThreads + 1;
+      // The chunks are whole cache lines, but for the last one.
+      int64_t chunkSize = ((size + numChunks - 1) / numChunks + 63) & ~63;
+      pthread_mutex_lock(&_jobMutex);
+      _job.dest = (char *)dest;
+      _job.src = (const char *)src;
+      _job.size = size;
+      _job.chunkSize = chunkSize;
+      _job.numChunks = (size + chunkSize - 1) / chunkSize;
+      _job.nextChunk = 0;
+      _job.numDoneChunks = 0;
+      _job.nonTemporal = nonTemporal;
+      __atomic_store_n(&_generation, _generation + 1, __ATOMIC_RELEASE);
+      pthread_cond_broadcast(&_jobCond);
+      copyChunks();
+      while (_job.numDoneChunks < _job.numChunks) {
+        if (!_spinWait) {
+          pthread_cond_wait(&_doneCond, &_jobMutex);
+          continue;
+        }
+        // No other copy is split until this one is done.
+        int64_t numChunks = _job.numChunks;
+        pthread_mutex_unlock(&_jobMutex);
+        while (__atomic_load_n(&_job.numDoneChunks, __ATOMIC_ACQUIRE) <
+               numChunks)
+          cpuRelax();
+        pthread_mutex_lock(&_jobMutex);
+      }
+      pthread_mutex_unlock(&_jobMutex);
+      pthread_mutex_unlock(&_callerMutex);
+      return;
+    }
+  }
+#endif
+  copyChunk((char *)dest, (const char *)src, size, nonTemporal);
+}
+
+// Copy the elements of a strided array of `rank` dimensions into another one.
+static void copyStrided(char *dest, const char *src, int64_t rank,
+    const int64_t *sizes, const int64_t *destStrides,
+    const int64_t *srcStrides, int64_t elementSize) {
+  if (rank == 1 && destStrides[0] == 1 && srcStrides[0] == 1) {
+    memcpy(dest, src, sizes[0] * elementSize);
+    return;
+  }
+  for (int64_t i = 0; i < sizes[0]; ++i) {
+    char *d = dest + i * destStrides[0] * elementSize;
+    const char *s = src + i * srcStrides[0] * elementSize;
+    if (rank == 1)
+      memcpy(d, s, elementSize);
+    else
+      copyStrided(d, s, rank - 1, sizes + 1, destStrides + 1, srcStrides + 1,
+          elementSize);
+  }
+}
+
+void *omPadMemRef(void *memRef, int64_t rank, int64_t axis, int64_t size,
+    int64_t elementSize) {
+  // The descriptor holds the allocated and aligned pointers, followed by the
+  // offset, the sizes and the strides.
+  void **ptrs = (void **)memRef;
+  int64_t *offset = (int64_t *)(ptrs + 2);
+  int64_t *sizes = offset + 1;
+  int64_t *strides = sizes + rank;
+  if (axis < 0 || axis >= rank || sizes[axis] >= size)
+    return NULL;
+
+  int64_t numElements = 1;
+  for (int64_t i = 0; i < rank; ++i)
+    numElements *= i == axis ? size : sizes[i];
+  int64_t *paddedStrides = (int64_t *)malloc(rank * sizeof(int64_t));
+  char *padded = (char *)calloc(numElements, elementSize);
+  if (!paddedStrides || !padded) {
+    // The specialized inference function cannot read the unpadded MemRef.
+    fprintf(stderr, "omPadMemRef: cannot allocate %lld bytes\n",
+        (long long)(numElements * elementSize));
+    abort();
+  }
+
+  int64_t stride = 1;
+  for (int64_t i = rank - 1; i >= 0; --i) {
+    paddedStrides[i] = stride;
+    stride *= i == axis ? size : sizes[i];
+  }
+  const char *src = (const char *)ptrs[1] + *offset * elementSize;
+  copyStrided(padded, src, rank, sizes, paddedStrides, strides, elementSize);
+
+  ptrs[0] = ptrs[1] = padded;
+  *offset = 0;
+  sizes[axis] = size;
+  memcpy(strides, paddedStrides, rank * sizeof(int64_t));
+  free(paddedStrides);
+  return padded;
+}
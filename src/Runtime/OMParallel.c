@@ -0,0 +1,151 @@
+//===--------------- OMParallel.c - OMParallel C Implementation -----------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementation of the parallel loop function called by
+// the compiled models.
+//
+//===----------------------------------------------------------------------===//
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "onnx-mlir/Runtime/OMParallel.h"
+
+#ifndef _WIN32
+// The parallel loop being run. The threads take the next range of iterations
+// until none is left, the last one to finish a range wakes up the caller.
+typedef struct {
+  void (*body)(int64_t, int64_t, void *);
+  void *context;
+  int64_t numIterations;
+  int64_t numChunks;
+  int64_t nextChunk;
+  int64_t numDoneChunks;
+} OMParallelJob;
+
+static pthread_once_t _poolOnce = PTHREAD_ONCE_INIT;
+static int64_t _numThreads = 0;
+static pthread_t *_threads = NULL;
+// Set when the library is unloaded, the threads then exit.
+static int32_t _stopping = 0;
+// Held by the caller of the parallel loop being run.
+static pthread_mutex_t _callerMutex = PTHREAD_MUTEX_INITIALIZER;
+// Guards the job and the generation.
+static pthread_mutex_t _jobMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _jobCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t _doneCond = PTHREAD_COND_INITIALIZER;
+static OMParallelJob _job;
+// Incremented for each parallel loop, so that the threads wake up once each.
+static uint64_t _generation = 0;
+
+// Run the ranges of iterations of the current job until none is left. Called
+// with the job mutex held, which is released while running them. The ranges
+// differ in size by at most one iteration.
+static void runChunks(void) {
+  while (_job.nextChunk < _job.numChunks) {
+    int64_t chunk = _job.nextChunk++;
+    int64_t size = _job.numIterations / _job.numChunks;
+    int64_t remainder = _job.numIterations % _job.numChunks;
+    int64_t begin = chunk * size + (chunk < remainder ? chunk : remainder);
+    int64_t end = begin + size + (chunk < remainder ? 1 : 0);
+    void (*body)(int64_t, int64_t, void *) = _job.body;
+    void *context = _job.context;
+    pthread_mutex_unlock(&_jobMutex);
+    body(begin, end, context);
+    pthread_mutex_lock(&_jobMutex);
+    if (++_job.numDoneChunks == _job.numChunks)
+      pthread_cond_signal(&_doneCond);
+  }
+}
+
+static void *loopThread(void *arg) {
+  uint64_t seenGeneration = 0;
+  pthread_mutex_lock(&_jobMutex);
+  while (1) {
+    while (_generation == seenGeneration) {
+      if (_stopping) {
+        pthread_mutex_unlock(&_jobMutex);
+        return NULL;
+      }
+      pthread_cond_wait(&_jobCond, &_jobMutex);
+    }
+    seenGeneration = _generation;
+    runChunks();
+  }
+}
+
+static void startLoopThreads(void) {
+  int64_t numThreads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  const char *env = getenv("ONNX_MLIR_NUM_THREADS");
+  if (env)
+    numThreads = atoll(env);
+  if (numThreads <= 0 ||
+      !(_threads = (pthread_t *)malloc(numThreads * sizeof(pthread_t))))
+    return;
+  for (int64_t i = 0; i < numThreads; ++i) {
+    if (pthread_create(&_threads[i], NULL, loopThread, NULL) != 0)
+      break;
+    _numThreads++;
+  }
+}
+
+// Stop and join the threads when the library is unloaded or the process
+// exits, so that no thread is left running in the code of an unloaded
+// library.
+__attribute__((destructor)) static void stopLoopThreads(void) {
+  if (!_threads)
+    return;
+  pthread_mutex_lock(&_jobMutex);
+  _stopping = 1;
+  pthread_cond_broadcast(&_jobCond);
+  pthread_mutex_unlock(&_jobMutex);
+  for (int64_t i = 0; i < _numThreads; ++i)
+    pthread_join(_threads[i], NULL);
+  free(_threads);
+  _threads = NULL;
+  _numThreads = 0;
+}
+#endif
+
+void omParallelFor(void (*body)(int64_t, int64_t, void *),
+    int64_t numIterations, void *context, int32_t numThreads) {
+  if (numIterations <= 0)
+    return;
+#ifndef _WIN32
+  if (numIterations >= 2 && numThreads != 1) {
+    pthread_once(&_poolOnce, startLoopThreads);
+    // Loops started while another one runs, e.g. nested in its body, run on
+    // the calling thread.
+    if (_numThreads > 0 && pthread_mutex_trylock(&_callerMutex) == 0) {
+      int64_t numChunks = _numThreads + 1;
+      if (numThreads > 0 && numChunks > numThreads)
+        numChunks = numThreads;
+      if (numChunks > numIterations)
+        numChunks = numIterations;
+      pthread_mutex_lock(&_jobMutex);
+      _job.body = body;
+      _job.context = context;
+      _job.numIterations = numIterations;
+      _job.numChunks = numChunks;
+      _job.nextChunk = 0;
+      _job.numDoneChunks = 0;
+      _generation++;
+      pthread_cond_broadcast(&_jobCond);
+      runChunks();
+      while (_job.numDoneChunks < _job.numChunks)
+        pthread_cond_wait(&_doneCond, &_jobMutex);
+      pthread_mutex_unlock(&_jobMutex);
+      pthread_mutex_unlock(&_callerMutex);
+      return;
+    }
+  }
+#endif
+  body(0, numIterations, context);
+}
@@ -0,0 +1,108 @@
+//===----------- OMPerfCounters.cpp - OMPerfCounters Implementation -------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementation of the hardware performance counters read
+// around the inferences and the instrumented operations of compiled models.
+//
+// Each thread opens its own group of perf events on its first read, so that
+// all the counters of the thread are read at once, with a single system call.
+//
+//===----------------------------------------------------------------------===//
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "onnx-mlir/Runtime/OMPerfCounters.h"
+
+#ifdef __linux__
+namespace {
+
+bool isCollectionEnabled() {
+  static bool enabled = [] {
+    const char *env = std::getenv("ONNX_MLIR_PERF_COUNTERS");
+    return env && std::strcmp(env, "1") == 0;
+  }();
+  return enabled;
+}
+
+int openCounter(uint32_t type, uint64_t config, int groupFd) {
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return syscall(__NR_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1, groupFd,
+      /*flags=*/0);
+}
+
+// The perf events of a thread, the first of them leading the group.
+struct OMPerfGroup {
+  int fds[OM_PERF_NUM_COUNTERS];
+  bool opened = false;
+  bool available = false;
+
+  void open() {
+    static const uint64_t configs[OM_PERF_NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES};
+    opened = true;
+    available = true;
+    for (int i = 0; i < OM_PERF_NUM_COUNTERS; i++) {
+      fds[i] = openCounter(
+          PERF_TYPE_HARDWARE, configs[i], i == 0 ? -1 : fds[0]);
+      available &= fds[i] >= 0;
+    }
+    if (!available)
+      close();
+  }
+
+  void close() {
+    for (int i = 0; i < OM_PERF_NUM_COUNTERS; i++)
+      if (fds[i] >= 0)
+        ::close(fds[i]);
+    available = false;
+  }
+
+  ~OMPerfGroup() {
+    if (available)
+      close();
+  }
+};
+
+thread_local OMPerfGroup perfGroup;
+
+} // namespace
+#endif
+
+int omPerfCountersRead(uint64_t *counters) {
+#ifdef __linux__
+  if (!isCollectionEnabled())
+    return -1;
+  if (!perfGroup.opened)
+    perfGroup.open();
+  if (!perfGroup.available)
+    return -1;
+
+  // With PERF_FORMAT_GROUP, the number of events precedes their values.
+  uint64_t values[1 + OM_PERF_NUM_COUNTERS];
+  ssize_t size = sizeof(values);
+  if (read(perfGroup.fds[0], values, size) != size)
+    return -1;
+  std::memcpy(counters, values + 1, OM_PERF_NUM_COUNTERS * sizeof(uint64_t));
+  return 0;
+#else
+  return -1;
+#endif
+}
@@ -9,6 +9,12 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <thread>
+
 #include "onnx/onnx_pb.h"
 #include <third_party/onnx/onnx/onnx_pb.h>
 
@@ -16,14 +22,103 @@
 
 namespace onnx_mlir {
 
-std::vector<py::array> PyExecutionSession::pyRun(
-    const std::vector<py::array> &inputsPyArray) {
-  assert(_entryPointFunc && "Entry point not loaded.");
+namespace {
 
-  std::vector<OMTensor *> omts;
-  for (auto inputPyArray : inputsPyArray) {
-    assert(inputPyArray.flags() && py::array::c_style &&
-           "Expect contiguous python array.");
+using OMTensorPtr = std::unique_ptr<OMTensor, decltype(&omTensorDestroy)>;
+
+// Borrowed from:
+// https://github.com/pybind/pybind11/issues/563#issuecomment-267835542
+OM_DATA_TYPE getOMDataType(const py::array &pyArray) {
+  if (py::isinstance<py::array_t<float>>(pyArray))
+    return ONNX_TYPE_FLOAT;
+  else if (py::isinstance<py::array_t<std::uint8_t>>(pyArray))
+    return ONNX_TYPE_UINT8;
+  else if (py::isinstance<py::array_t<std::int8_t>>(pyArray))
+    return ONNX_TYPE_INT8;
+  else if (py::isinstance<py::array_t<std::uint16_t>>(pyArray))
+    return ONNX_TYPE_UINT16;
+  else if (py::isinstance<py::array_t<std::int16_t>>(pyArray))
+    return ONNX_TYPE_INT16;
+  else if (py::isinstance<py::array_t<std::int32_t>>(pyArray))
+    return ONNX_TYPE_INT32;
+  else if (py::isinstance<py::array_t<std::int64_t>>(pyArray))
+    return ONNX_TYPE_INT64;
+  else if (py::isinstance<py::array_t<bool>>(pyArray))
+    return ONNX_TYPE_BOOL;
+  // There is no C++ type for numpy.float16, which is matched on its kind
+  // and size instead.
+  else if (pyArray.dtype().kind() == 'f' && pyArray.itemsize() == 2)
+    return ONNX_TYPE_FLOAT16;
+  else if (py::isinstance<py::array_t<double>>(pyArray))
+    return ONNX_TYPE_DOUBLE;
+  else if (py::isinstance<py::array_t<std::uint32_t>>(pyArray))
+    return ONNX_TYPE_UINT32;
+  else if (py::isinstance<py::array_t<std::uint64_t>>(pyArray))
+    return ONNX_TYPE_UINT64;
+  std::cerr << "Numpy type not supported: " << pyArray.dtype() << ".\n";
+  exit(1);
+}
+
+// https://numpy.org/devdocs/user/basics.types.html
+py::dtype getPyDtype(OM_DATA_TYPE dataType) {
+  if (dataType == onnx::TensorProto::FLOAT)
+    return py::dtype("float32");
+  else if (dataType == onnx::TensorProto::UINT8)
+    return py::dtype("uint8");
+  else if (dataType == onnx::TensorProto::INT8)
+    return py::dtype("int8");
+  else if (dataType == onnx::TensorProto::UINT16)
+    return py::dtype("uint16");
+  else if (dataType == onnx::TensorProto::INT16)
+    return py::dtype("int16");
+  else if (dataType == onnx::TensorProto::INT32)
+    return py::dtype("int32");
+  else if (dataType == onnx::TensorProto::INT64)
+    return py::dtype("int64");
+  // TODO(tjingrant) wait for Tong's input for how to represent string.
+  else if (dataType == onnx::TensorProto::BOOL)
+    return py::dtype("bool_");
+  else if (dataType == onnx::TensorProto::FLOAT16)
+    return py::dtype("float16");
+  // Numpy has no bfloat16 type, bf16 results are returned as their bit
+  // patterns, the upper halves of the bits of float32 values.
+  else if (dataType == onnx::TensorProto::BFLOAT16)
+    return py::dtype("uint16");
+  else if (dataType == onnx::TensorProto::DOUBLE)
+    return py::dtype("float64");
+  else if (dataType == onnx::TensorProto::UINT32)
+    return py::dtype("uint32");
+  else if (dataType == onnx::TensorProto::UINT64)
+    return py::dtype("uint64");
+  fprintf(stderr, "Unsupported ONNX type in OMTensor.");
+  exit(1);
+}
+
+// Test if the strides of an array, counted in bytes, are whole numbers of
+// elements.
+bool hasElementStrides(const py::array &pyArray) {
+  for (py::ssize_t d = 0; d < pyArray.ndim(); d++)
+    if (pyArray.strides(d) % pyArray.itemsize())
+      return false;
+  return true;
+}
+
+// Wrap the inputs into OMTensors without copying them. Writable inputs keep
+// their strides, counted in elements rather than bytes, and the model repacks
+// those that are not dense into temporary buffers at each call. The other
+// inputs are made C-contiguous first. The arrays are kept in
+// contiguousPyArrays for the duration of the call.
+std::vector<OMTensorPtr> createInputOMTensors(
+    const std::vector<py::array> &inputsPyArray,
+    std::vector<py::array> &contiguousPyArrays) {
+  std::vector<OMTensorPtr> omts;
+  for (const auto &pyArray : inputsPyArray) {
+    bool keepStrides = pyArray.writeable() && hasElementStrides(pyArray);
+    auto inputPyArray =
+        keepStrides ? pyArray : py::array::ensure(pyArray, py::array::c_style);
+    if (!inputPyArray)
+      throw py::error_already_set();
+    contiguousPyArrays.emplace_back(inputPyArray);
 
     void *dataPtr;
     int ownData = 0;
@@ -38,90 +133,175 @@ std::vector<py::array> PyExecutionSession::pyRun(
       ownData = 1;
     }
 
-    // Borrowed from:
-    // https://github.com/pybind/pybind11/issues/563#issuecomment-267835542
-    OM_DATA_TYPE dtype;
-    if (py::isinstance<py::array_t<float>>(inputPyArray))
-      dtype = ONNX_TYPE_FLOAT;
-    else if (py::isinstance<py::array_t<std::uint8_t>>(inputPyArray))
-      dtype = ONNX_TYPE_UINT8;
-    else if (py::isinstance<py::array_t<std::int8_t>>(inputPyArray))
-      dtype = ONNX_TYPE_INT8;
-    else if (py::isinstance<py::array_t<std::uint16_t>>(inputPyArray))
-      dtype = ONNX_TYPE_UINT16;
-    else if (py::isinstance<py::array_t<std::int16_t>>(inputPyArray))
-      dtype = ONNX_TYPE_INT16;
-    else if (py::isinstance<py::array_t<std::int32_t>>(inputPyArray))
-      dtype = ONNX_TYPE_INT32;
-    else if (py::isinstance<py::array_t<std::int64_t>>(inputPyArray))
-      dtype = ONNX_TYPE_INT64;
-    else if (py::isinstance<py::array_t<bool>>(inputPyArray))
-      dtype = ONNX_TYPE_BOOL;
-    // Missing fp16 support.
-    else if (py::isinstance<py::array_t<double>>(inputPyArray))
-      dtype = ONNX_TYPE_DOUBLE;
-    else if (py::isinstance<py::array_t<std::uint32_t>>(inputPyArray))
-      dtype = ONNX_TYPE_UINT32;
-    else if (py::isinstance<py::array_t<std::uint64_t>>(inputPyArray))
-      dtype = ONNX_TYPE_UINT64;
-    else {
-      std::cerr << "Numpy type not supported: " << inputPyArray.dtype()
-                << ".\n";
-      exit(1);
+    omts.emplace_back(omTensorCreateWithOwnership(dataPtr,
+                          (int64_t *)inputPyArray.shape(), inputPyArray.ndim(),
+                          getOMDataType(inputPyArray), ownData),
+        omTensorDestroy);
+    if (keepStrides) {
+      std::vector<int64_t> strides;
+      for (py::ssize_t d = 0; d < inputPyArray.ndim(); d++)
+        strides.emplace_back(inputPyArray.strides(d) / inputPyArray.itemsize());
+      omTensorSetStrides(omts.back().get(), strides.data());
     }
-
-    auto *inputOMTensor = omTensorCreateWithOwnership(dataPtr,
-        (int64_t *)inputPyArray.shape(), inputPyArray.ndim(), dtype, ownData);
-    omTensorSetStrides(inputOMTensor, (int64_t *)inputPyArray.strides());
-
-    omts.emplace_back(inputOMTensor);
   }
+  return omts;
+}
 
-  auto *wrappedInput = omTensorListCreate(&omts[0], omts.size());
-  auto *wrappedOutput = _entryPointFunc(wrappedInput);
-
+// Wrap the outputs of the model into numpy arrays.
+std::vector<py::array> createOutputPyArrays(OMTensorList *wrappedOutput) {
   std::vector<py::array> outputPyArrays;
   for (int i = 0; i < omTensorListGetSize(wrappedOutput); i++) {
     auto *omt = omTensorListGetOmtByIndex(wrappedOutput, i);
-    auto shape = std::vector<int64_t>(omTensorGetDataShape(omt),
-        omTensorGetDataShape(omt) + omTensorGetRank(omt));
-
-    // https://numpy.org/devdocs/user/basics.types.html
-    py::dtype dtype;
-    if (omTensorGetDataType(omt) == onnx::TensorProto::FLOAT)
-      dtype = py::dtype("float32");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::UINT8)
-      dtype = py::dtype("uint8");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::INT8)
-      dtype = py::dtype("int8");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::UINT16)
-      dtype = py::dtype("uint16");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::INT16)
-      dtype = py::dtype("int16");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::INT32)
-      dtype = py::dtype("int32");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::INT64)
-      dtype = py::dtype("int64");
-    // TODO(tjingrant) wait for Tong's input for how to represent string.
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::BOOL)
-      dtype = py::dtype("bool_");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::FLOAT16)
-      dtype = py::dtype("float32");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::DOUBLE)
-      dtype = py::dtype("float64");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::UINT32)
-      dtype = py::dtype("uint32");
-    else if (omTensorGetDataType(omt) == onnx::TensorProto::UINT64)
-      dtype = py::dtype("uint64");
-    else {
-      fprintf(stderr, "Unsupported ONNX type in OMTensor.");
-      exit(1);
+    auto dtype = getPyDtype(omTensorGetDataType(omt));
+    std::vector<int64_t> shape, strides;
+    for (int d = 0; d < omTensorGetRank(omt); d++) {
+      shape.emplace_back(omTensorGetDataShape(omt)[d]);
+      strides.emplace_back(omTensorGetStrides(omt)[d] * dtype.itemsize());
     }
 
+    // The numpy array uses the buffer of the OMTensor as is, the OMTensor
+    // and its buffer are freed along with the array.
+    py::capsule owner(omt,
+        [](void *ptr) { omTensorDestroy(static_cast<OMTensor *>(ptr)); });
     outputPyArrays.emplace_back(
-        py::array(dtype, shape, omTensorGetDataPtr(omt)));
+        py::array(dtype, shape, strides, omTensorGetDataPtr(omt), owner));
+  }
+  return outputPyArrays;
+}
+} // namespace
+
+std::vector<py::array> PyExecutionSession::pyRun(
+    const std::vector<py::array> &inputsPyArray) {
+  assert(_entryPointFunc && "Entry point not loaded.");
+
+  std::vector<py::array> contiguousPyArrays;
+  auto inputs = createInputOMTensors(inputsPyArray, contiguousPyArrays);
+  std::vector<OMTensor *> omts;
+  for (const auto &input : inputs)
+    omts.emplace_back(input.get());
+
+  // The model does not touch Python objects, other Python threads keep
+  // running during the inference.
+  OMTensorList *wrappedOutput;
+  {
+    py::gil_scoped_release release;
+    auto *wrappedInput = omTensorListCreate(&omts[0], omts.size());
+    wrappedOutput = invokeEntryPoint(wrappedInput);
+    // Only the list is freed, its tensors are owned by the inputs.
+    free(wrappedInput);
+  }
+
+  return createOutputPyArrays(wrappedOutput);
+}
+
+std::vector<std::vector<py::array>> PyExecutionSession::pyRunMany(
+    const std::vector<std::vector<py::array>> &requestsPyArrays,
+    unsigned numThreads) {
+  assert(_entryPointFunc && "Entry point not loaded.");
+
+  // All the requests are wrapped before any of them runs, so that invalid
+  // inputs are reported without leaving requests half done.
+  std::vector<py::array> contiguousPyArrays;
+  std::vector<std::vector<OMTensorPtr>> inputs;
+  for (const auto &requestPyArrays : requestsPyArrays) {
+    if (requestPyArrays.size() != requestsPyArrays.front().size())
+      throw std::runtime_error(
+          "All the requests must have the same number of inputs");
+    inputs.emplace_back(
+        createInputOMTensors(requestPyArrays, contiguousPyArrays));
   }
 
+  // The lists do not copy the arrays of tensors they are created from, the
+  // arrays live until the lists are freed after the runs. Only the lists are
+  // freed, their tensors are owned by the inputs.
+  size_t numRequests = inputs.size();
+  std::vector<std::vector<OMTensor *>> omts(numRequests);
+  std::vector<std::unique_ptr<OMTensorList, decltype(&free)>> wrappedInputs;
+  for (size_t r = 0; r < numRequests; r++) {
+    for (const auto &input : inputs[r])
+      omts[r].emplace_back(input.get());
+    wrappedInputs.emplace_back(
+        omTensorListCreate(omts[r].data(), omts[r].size()), free);
+  }
+
+  // Each thread runs the next request not yet taken, with its own memory
+  // arena, which it releases once there are no more requests.
+  dlerror();
+  auto arenaReleaseFunc = (arenaReleaseFuncType)dlsym(
+      _sharedLibraryHandle ? _sharedLibraryHandle : RTLD_DEFAULT,
+      "omArenaRelease");
+  if (dlerror())
+    arenaReleaseFunc = nullptr;
+  std::vector<OMTensorList *> wrappedOutputs(numRequests, nullptr);
+  std::vector<std::exception_ptr> errors(numRequests);
+  {
+    py::gil_scoped_release release;
+    std::atomic<size_t> nextRequest(0);
+    auto runRequests = [&] {
+      for (size_t r = nextRequest++; r < numRequests; r = nextRequest++) {
+        try {
+          wrappedOutputs[r] = invokeEntryPoint(wrappedInputs[r].get());
+        } catch (...) {
+          errors[r] = std::current_exception();
+        }
+      }
+      if (arenaReleaseFunc)
+        arenaReleaseFunc();
+    };
+    if (numThreads == 0)
+      numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < std::min<size_t>(numThreads, numRequests); t++)
+      threads.emplace_back(runRequests);
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  // The outputs of the requests that ran are owned by their arrays before the
+  // first error, if any, is rethrown.
+  std::vector<std::vector<py::array>> outputPyArrays;
+  for (size_t r = 0; r < numRequests; r++)
+    outputPyArrays.emplace_back(wrappedOutputs[r]
+                                    ? createOutputPyArrays(wrappedOutputs[r])
+                                    : std::vector<py::array>());
+  for (const auto &error : errors)
+    if (error)
+      std::rethrow_exception(error);
   return outputPyArrays;
 }
+
+void PyExecutionSession::pyRunInto(const std::vector<py::array> &inputsPyArray,
+    const std::vector<py::array> &outputsPyArray) {
+  assert(_entryPointFunc && "Entry point not loaded.");
+
+  std::vector<py::array> contiguousPyArrays;
+  auto inputs = createInputOMTensors(inputsPyArray, contiguousPyArrays);
+
+  // The outputs are written in place, they must be contiguous and writable.
+  std::vector<OMTensorPtr> outputs;
+  std::vector<OMTensor *> outs;
+  for (auto outputPyArray : outputsPyArray) {
+    if (!(outputPyArray.flags() & py::array::c_style) ||
+        !outputPyArray.writeable())
+      throw std::runtime_error(
+          "Output arrays must be C-contiguous and writable");
+    outputs.emplace_back(
+        omTensorCreate(outputPyArray.mutable_data(),
+            (int64_t *)outputPyArray.shape(), outputPyArray.ndim(),
+            getOMDataType(outputPyArray)),
+        omTensorDestroy);
+    outs.emplace_back(outputs.back().get());
+  }
+
+  py::gil_scoped_release release;
+  runInto(std::move(inputs), outs);
+}
+
+void PyExecutionSession::pyWarmup(const std::vector<py::array> &inputsPyArray) {
+  std::vector<py::array> contiguousPyArrays;
+  auto inputs = createInputOMTensors(inputsPyArray, contiguousPyArrays);
+
+  py::gil_scoped_release release;
+  warmup(std::move(inputs));
+}
 } // namespace onnx_mlir
@@ -24,12 +24,38 @@ public:
   PyExecutionSession(std::string sharedLibPath, std::string entryPointName)
       : onnx_mlir::ExecutionSession(sharedLibPath, entryPointName){};
 
+  // Run the model. The returned arrays own the output buffers of the model,
+  // which are not copied.
   std::vector<py::array> pyRun(const std::vector<py::array> &inputsPyArray);
+
+  // Run the model and write its results into the pre-allocated, C-contiguous
+  // output arrays.
+  void pyRunInto(const std::vector<py::array> &inputsPyArray,
+      const std::vector<py::array> &outputsPyArray);
+
+  // Warm up the model, running the inputs once if any are given.
+  void pyWarmup(const std::vector<py::array> &inputsPyArray);
+
+  // Run the model on each list of inputs, on numThreads native threads or one
+  // per hardware thread if numThreads is 0, and return the outputs of the
+  // requests in order. The inputs are all checked before any request runs.
+  std::vector<std::vector<py::array>> pyRunMany(
+      const std::vector<std::vector<py::array>> &requestsPyArrays,
+      unsigned numThreads);
 };
 } // namespace onnx_mlir
 
 PYBIND11_MODULE(PyRuntime, m) {
   py::class_<onnx_mlir::PyExecutionSession>(m, "ExecutionSession")
       .def(py::init<const std::string &, const std::string &>())
-      .def("run", &onnx_mlir::PyExecutionSession::pyRun);
+      .def("run", &onnx_mlir::PyExecutionSession::pyRun)
+      .def("run_into", &onnx_mlir::PyExecutionSession::pyRunInto)
+      .def("warmup", &onnx_mlir::PyExecutionSession::pyWarmup,
+          py::arg("inputs") = std::vector<py::array>())
+      .def("run_many", &onnx_mlir::PyExecutionSession::pyRunMany,
+          py::arg("inputs"), py::arg("num_threads") = 0)
+      .def("input_signature",
+          &onnx_mlir::PyExecutionSession::inputSignature)
+      .def("output_signature",
+          &onnx_mlir::PyExecutionSession::outputSignature);
 }
@@ -0,0 +1,145 @@
+//===--- SharedConstPool.cpp - Shared Const Pool Func Impl ----------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains the implementation of the runtime function sharing the
+// materialized constant pool of a model between the processes serving it.
+//
+// Worker processes loading the same model each materialize their own copy of
+// the constant pool when it is embedded in the shared library or compressed.
+// With ONNX_MLIR_SHARED_CONST_POOL=1 in the environment, the constant pool is
+// instead placed in a POSIX shared memory object named after the hash of the
+// constant pack, e.g. /dev/shm/onnx-mlir-const-<hash>-<size>:
+//
+//   - the first process creates the object, fills the constant pool and
+//     marks it as ready in the header page of the object,
+//   - the other processes map the object read-only once it is ready.
+//
+// The activations remain private to each process. The shared memory objects
+// outlive the processes and can be removed once no process serves the model,
+// e.g. with rm /dev/shm/onnx-mlir-const-*. Processes falling back to a private
+// constant pool, e.g. when the first process died while filling it, report it
+// on the standard error.
+//
+//===----------------------------------------------------------------------===//
+
+#include "GetEmbeddedConstPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+extern const int64_t constPackHash;
+
+namespace {
+
+// The constant pool starts after a header page, so that it is page aligned.
+const size_t kHeaderSize = 4096;
+
+// Time left to the first process to fill the constant pool, e.g. to
+// decompress it, before the other processes use a private constant pool.
+const std::chrono::seconds kFillTimeout(300);
+
+struct SharedPoolHeader {
+  std::atomic<uint32_t> ready;
+};
+
+bool isSharingEnabled() {
+  const char *env = getenv("ONNX_MLIR_SHARED_CONST_POOL");
+  return env && strcmp(env, "1") == 0;
+}
+
+// Size the shared memory object just created and fill the constant pool in
+// it. The header is zeroed by the sizing of the object, i.e. not ready.
+const char *createPool(const char *name, int fd, size_t size,
+    const std::function<void(char *)> &fill) {
+  void *data = MAP_FAILED;
+  if (ftruncate(fd, kHeaderSize + size) == 0)
+    data = mmap(nullptr, kHeaderSize + size, PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    // Let the next process try again.
+    shm_unlink(name);
+    return nullptr;
+  }
+  char *pool = (char *)data + kHeaderSize;
+  fill(pool);
+  // The constant pool is read-only once filled, in this process as well.
+  mprotect(pool, size, PROT_READ);
+  auto *header = (SharedPoolHeader *)data;
+  header->ready.store(1, std::memory_order_release);
+  return pool;
+}
+
+// Map the shared memory object created by another process once its constant
+// pool is ready.
+const char *attachPool(const char *name, size_t size) {
+  int fd = -1;
+  auto deadline = std::chrono::steady_clock::now() + kFillTimeout;
+  // The object may be created but not sized yet.
+  struct stat fileStat;
+  while (true) {
+    if (fd < 0)
+      fd = shm_open(name, O_RDONLY, 0);
+    if (fd >= 0 && fstat(fd, &fileStat) == 0 &&
+        (size_t)fileStat.st_size == kHeaderSize + size)
+      break;
+    if (std::chrono::steady_clock::now() > deadline) {
+      if (fd >= 0)
+        close(fd);
+      return nullptr;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  void *data = mmap(nullptr, kHeaderSize + size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return nullptr;
+
+  auto *header = (SharedPoolHeader *)data;
+  while (!header->ready.load(std::memory_order_acquire)) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      munmap(data, kHeaderSize + size);
+      return nullptr;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return (const char *)data + kHeaderSize;
+}
+
+} // namespace
+
+const char *getSharedConstPool(
+    int64_t size_in_byte, const std::function<void(char *)> &fill) {
+  if (!isSharingEnabled() || constPackHash == 0 || size_in_byte <= 0)
+    return nullptr;
+
+  char name[64];
+  snprintf(name, sizeof(name), "/onnx-mlir-const-%016llx-%lld",
+      (unsigned long long)constPackHash, (long long)size_in_byte);
+  size_t size = size_in_byte;
+
+  const char *pool = nullptr;
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd >= 0) {
+    pool = createPool(name, fd, size, fill);
+    close(fd);
+  } else if (errno == EEXIST) {
+    pool = attachPool(name, size);
+  }
+  if (!pool)
+    fprintf(stderr, "Cannot share the constant pool in %s, using a private "
+                    "constant pool.\n",
+        name);
+  return pool;
+}
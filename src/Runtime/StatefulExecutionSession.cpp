@@ -0,0 +1,300 @@
+//===--- StatefulExecutionSession.cpp - StatefulExecutionSession Impl -----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains implementations of StatefulExecutionSession class, which
+// feeds outputs of a model back as its inputs in the next call, such as the
+// hidden and cell states of a streaming recurrent model, or appends them to
+// the key and value caches of an autoregressive decoder.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "StatefulExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+StatefulExecutionSession::StatefulExecutionSession(std::string sharedLibPath,
+    std::string entryPointName, std::vector<StateBinding> bindings,
+    std::vector<CacheBinding> caches)
+    : ExecutionSession(sharedLibPath, entryPointName),
+      _bindings(std::move(bindings)), _caches(std::move(caches)) {
+  std::vector<int64_t> inputs, outputs;
+  for (auto &binding : _bindings) {
+    inputs.emplace_back(binding.input);
+    outputs.emplace_back(binding.output);
+  }
+  for (auto &cache : _caches) {
+    if (cache.axis < 0 || cache.capacity < 0)
+      throw std::runtime_error("Cache binding axes and capacities must be "
+                               "non-negative");
+    inputs.emplace_back(cache.input);
+    outputs.emplace_back(cache.output);
+  }
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if (inputs[i] < 0 || outputs[i] < 0)
+      throw std::runtime_error("Binding indices must be non-negative");
+    for (size_t j = 0; j < i; j++)
+      if (inputs[i] == inputs[j] || outputs[i] == outputs[j])
+        throw std::runtime_error("Bindings must not share inputs or outputs");
+  }
+}
+
+std::unique_ptr<StatefulExecutionSession::Stream>
+StatefulExecutionSession::createStream(
+    std::vector<OMTensorPtr> states, std::vector<OMTensorPtr> caches) {
+  if (states.size() != _bindings.size())
+    throw std::runtime_error("Number of states does not match the number of "
+                             "state bindings");
+  if (caches.size() != _caches.size())
+    throw std::runtime_error("Number of caches does not match the number of "
+                             "cache bindings");
+  std::unique_ptr<Stream> stream(new Stream());
+  for (auto &state : states) {
+    if (!state)
+      throw std::runtime_error("Missing initial state");
+    if (usesIntoEntryPoint()) {
+      OMTensor *next = omTensorCreateEmpty(omTensorGetDataShape(state.get()),
+          omTensorGetRank(state.get()), omTensorGetDataType(state.get()));
+      if (!next)
+        throw std::runtime_error("Cannot allocate state buffer");
+      stream->_nextStates.emplace_back(next, omTensorDestroy);
+    }
+    stream->_states.emplace_back(std::move(state));
+  }
+
+  // The initial entries are moved into a buffer of the capacity of the
+  // binding.
+  for (size_t i = 0; i < caches.size(); i++) {
+    if (!caches[i] || omTensorGetRank(caches[i].get()) <= _caches[i].axis)
+      throw std::runtime_error("Missing initial cache or cache axis");
+    int64_t length = omTensorGetDataShape(caches[i].get())[_caches[i].axis];
+    stream->_caches.emplace_back(
+        std::move(caches[i]), OMTensorPtr(nullptr, omTensorDestroy));
+    auto &cache = stream->_caches.back();
+    cache.length = cache.capacity = length;
+    reserveCache(
+        i, cache, std::max({_caches[i].capacity, length, (int64_t)1}));
+  }
+  return stream;
+}
+
+void StatefulExecutionSession::reserveCache(
+    size_t i, Stream::Cache &cache, int64_t capacity) const {
+  int64_t axis = _caches[i].axis;
+  OMTensor *buffer = cache.buffer.get();
+  int64_t rank = omTensorGetRank(buffer);
+  OM_DATA_TYPE dataType = omTensorGetDataType(buffer);
+  std::vector<int64_t> shape(
+      omTensorGetDataShape(buffer), omTensorGetDataShape(buffer) + rank);
+
+  // The entries are copied one slice of the dimensions before the axis at a
+  // time.
+  int64_t numSlices = 1, entrySize = getDataTypeSize(dataType);
+  for (int64_t d = 0; d < rank; d++)
+    if (d < axis)
+      numSlices *= shape[d];
+    else if (d > axis)
+      entrySize *= shape[d];
+
+  shape[axis] = capacity;
+  OMTensorPtr newBuffer(
+      omTensorCreateEmpty(shape.data(), rank, dataType), omTensorDestroy);
+  if (!newBuffer)
+    throw std::runtime_error("Cannot allocate cache buffer");
+  auto *src = (char *)omTensorGetDataPtr(buffer);
+  auto *dst = (char *)omTensorGetDataPtr(newBuffer.get());
+  for (int64_t s = 0; s < numSlices; s++)
+    memcpy(dst + s * capacity * entrySize, src + s * cache.capacity * entrySize,
+        cache.length * entrySize);
+
+  cache.buffer = std::move(newBuffer);
+  cache.capacity = capacity;
+  createCacheView(i, cache);
+}
+
+void StatefulExecutionSession::createCacheView(
+    size_t i, Stream::Cache &cache) const {
+  // The view of the entries has the strides of the buffer. It is created
+  // again after each append rather than resized, so that it views the buffer
+  // even if a model changed it.
+  OMTensor *buffer = cache.buffer.get();
+  int64_t rank = omTensorGetRank(buffer);
+  std::vector<int64_t> shape(
+      omTensorGetDataShape(buffer), omTensorGetDataShape(buffer) + rank);
+  shape[_caches[i].axis] = cache.length;
+  OMTensorPtr view(omTensorCreate(omTensorGetDataPtr(buffer), shape.data(),
+                       rank, omTensorGetDataType(buffer)),
+      omTensorDestroy);
+  if (!view)
+    throw std::runtime_error("Cannot allocate cache view");
+  omTensorSetStrides(view.get(), omTensorGetStrides(buffer));
+  cache.view = std::move(view);
+}
+
+void StatefulExecutionSession::appendToCache(
+    size_t i, Stream::Cache &cache, OMTensor *entries) const {
+  int64_t axis = _caches[i].axis;
+  OMTensor *view = cache.view.get();
+  int64_t rank = omTensorGetRank(view);
+  std::vector<int64_t> shape(
+      omTensorGetDataShape(view), omTensorGetDataShape(view) + rank);
+  int64_t *entriesShape = omTensorGetDataShape(entries);
+  bool isCompatible = omTensorGetRank(entries) == rank &&
+                      omTensorGetDataType(entries) == omTensorGetDataType(view);
+  for (int64_t d = 0; isCompatible && d < rank; d++)
+    isCompatible = d == axis || entriesShape[d] == shape[d];
+  if (!isCompatible)
+    throw std::runtime_error("Cache output does not match the shape of the "
+                             "cache");
+
+  int64_t numSlices = 1, entrySize = getDataTypeSize(omTensorGetDataType(view));
+  for (int64_t d = 0; d < rank; d++)
+    if (d < axis)
+      numSlices *= shape[d];
+    else if (d > axis)
+      entrySize *= shape[d];
+
+  // The capacity is doubled, so that appending one entry at a time costs a
+  // constant time per entry on average.
+  int64_t numEntries = entriesShape[axis];
+  if (cache.length + numEntries > cache.capacity)
+    reserveCache(i, cache,
+        std::max(2 * cache.capacity, cache.length + numEntries));
+  auto *src = (char *)omTensorGetDataPtr(entries);
+  auto *dst = (char *)omTensorGetDataPtr(cache.buffer.get());
+  for (int64_t s = 0; s < numSlices; s++)
+    memcpy(dst + (s * cache.capacity + cache.length) * entrySize,
+        src + s * numEntries * entrySize, numEntries * entrySize);
+
+  cache.length += numEntries;
+  createCacheView(i, cache);
+}
+
+std::vector<OMTensor *> StatefulExecutionSession::gatherInputs(
+    Stream &stream, const std::vector<OMTensorPtr> &ins) const {
+  std::vector<OMTensor *> inputs(
+      ins.size() + _bindings.size() + _caches.size(), nullptr);
+  for (size_t i = 0; i < _bindings.size(); i++) {
+    if (_bindings[i].input >= (int64_t)inputs.size())
+      throw std::runtime_error("State input index exceeds the number of "
+                               "inputs of the model");
+    inputs[_bindings[i].input] = stream._states[i].get();
+  }
+  for (size_t i = 0; i < _caches.size(); i++) {
+    if (_caches[i].input >= (int64_t)inputs.size())
+      throw std::runtime_error("Cache input index exceeds the number of "
+                               "inputs of the model");
+    inputs[_caches[i].input] = stream._caches[i].view.get();
+  }
+  // The inputs of the call fill the inputs of the model left by the states
+  // and the caches, in order.
+  if ((size_t)std::count(inputs.begin(), inputs.end(), nullptr) != ins.size())
+    throw std::runtime_error("Number of inputs does not match the inputs of "
+                             "the model left by the bindings");
+  auto in = ins.begin();
+  for (auto &input : inputs)
+    if (!input)
+      input = (in++)->get();
+  return inputs;
+}
+
+int64_t StatefulExecutionSession::findOutputBinding(int64_t output) const {
+  for (size_t i = 0; i < _bindings.size(); i++)
+    if (_bindings[i].output == output)
+      return i;
+  return -1;
+}
+
+int64_t StatefulExecutionSession::findOutputCache(int64_t output) const {
+  for (size_t i = 0; i < _caches.size(); i++)
+    if (_caches[i].output == output)
+      return i;
+  return -1;
+}
+
+std::vector<StatefulExecutionSession::OMTensorPtr>
+StatefulExecutionSession::run(Stream &stream, std::vector<OMTensorPtr> ins) {
+  auto inputs = gatherInputs(stream, ins);
+  auto *wrappedInput = omTensorListCreate(&inputs[0], inputs.size());
+
+  RunSample sample;
+  beginRun(sample);
+  auto *wrappedOutput = invokeEntryPoint(wrappedInput);
+  endRun(sample);
+  free(wrappedInput);
+
+  // The state outputs replace the states of the stream, whose previous
+  // states are no longer needed, and the cache outputs are appended to the
+  // caches.
+  std::vector<OMTensorPtr> outs;
+  size_t numOutputs = omTensorListGetSize(wrappedOutput);
+  for (size_t i = 0; i < numOutputs; i++) {
+    OMTensorPtr output(
+        omTensorListGetOmtByIndex(wrappedOutput, i), omTensorDestroy);
+    int64_t binding = findOutputBinding(i);
+    int64_t cache = findOutputCache(i);
+    if (binding >= 0)
+      stream._states[binding] = std::move(output);
+    else if (cache >= 0)
+      appendToCache(cache, stream._caches[cache], output.get());
+    else
+      outs.emplace_back(std::move(output));
+  }
+  if (numOutputs < outs.size() + _bindings.size() + _caches.size())
+    throw std::runtime_error("Binding output index exceeds the number of "
+                             "outputs of the model");
+  return outs;
+}
+
+void StatefulExecutionSession::runInto(Stream &stream,
+    std::vector<OMTensorPtr> ins, const std::vector<OMTensor *> &outs) {
+  if (!usesIntoEntryPoint()) {
+    auto results = run(stream, std::move(ins));
+    if (results.size() != outs.size())
+      throw std::runtime_error("Number of output tensors does not match the "
+                               "number of outputs of the model");
+    for (size_t i = 0; i < results.size(); i++) {
+      auto size = omTensorGetDataBufferSize(results[i].get());
+      if (omTensorGetDataBufferSize(outs[i]) != size)
+        throw std::runtime_error("Output tensor size does not match the size "
+                                 "of the output of the model");
+      memcpy(omTensorGetDataPtr(outs[i]), omTensorGetDataPtr(results[i].get()),
+          size);
+    }
+    return;
+  }
+
+  auto inputs = gatherInputs(stream, ins);
+  auto *wrappedInput = omTensorListCreate(&inputs[0], inputs.size());
+
+  // The model writes the next states into the buffers not read by this call.
+  std::vector<OMTensor *> outputs(outs.size() + _bindings.size(), nullptr);
+  for (size_t i = 0; i < _bindings.size(); i++) {
+    if (_bindings[i].output >= (int64_t)outputs.size())
+      throw std::runtime_error("State output index exceeds the number of "
+                               "outputs of the model");
+    outputs[_bindings[i].output] = stream._nextStates[i].get();
+  }
+  auto out = outs.begin();
+  for (auto &output : outputs)
+    if (!output)
+      output = *out++;
+  auto *wrappedOutput = omTensorListCreate(&outputs[0], outputs.size());
+
+  RunSample sample;
+  beginRun(sample);
+  invokeIntoEntryPoint(wrappedInput, wrappedOutput);
+  endRun(sample);
+  free(wrappedInput);
+  free(wrappedOutput);
+
+  stream._states.swap(stream._nextStates);
+}
+} // namespace onnx_mlir
@@ -0,0 +1,165 @@
+//===--- StatefulExecutionSession.hpp - StatefulExecutionSession Decl -----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains declarations of StatefulExecutionSession class, which
+// feeds outputs of a model back as its inputs in the next call, such as the
+// hidden and cell states of a streaming recurrent model, or appends them to
+// the key and value caches of an autoregressive decoder.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "ExecutionSession.hpp"
+
+namespace onnx_mlir {
+
+// An ExecutionSession running a model that is called once per chunk of a
+// stream and carries state tensors from one call to the next. Each binding
+// of the session names an input of the model and the output whose value is
+// given to that input in the next call.
+//
+// The states of a stream are held by a Stream created by the session, the
+// caller only passes the other inputs and gets the other outputs of each
+// call: the states are given to the model as they are, no tensor is copied
+// or handed over to the caller. With an entry point writing into output
+// buffers, the stream holds two buffers per state, the model reads one and
+// writes the other, and they are swapped after each call. Otherwise, the
+// state outputs allocated by the model become the states of the stream.
+//
+// A cache binding names an input of the model reading the past entries of a
+// cache, e.g. the keys of the previous tokens of a decoder, and the output
+// returning the entries of the current call, which are appended to the cache.
+// Decoder models returning the concatenation of the past and the new entries
+// are compiled with --enable-kv-cache-append to return the new entries only.
+// The cache of a stream is a buffer preallocated with a capacity along the
+// axis of the entries, and grown when it is full. Each call reads the past
+// entries through a view of the buffer, with the strides of the buffer, and
+// only the new entries are copied into it: the cost of a call does not grow
+// with the length of the cache. The cache inputs must only be read element by
+// element, e.g. by the concatenation with the new entries, and are not
+// handled by the entry points writing into output buffers.
+//
+// Streams are independent: the session runs any number of streams, from
+// several threads, but a stream must not be run by two calls at once. The
+// state outputs must be computed by the model rather than be forwarded
+// inputs, which is the case of the states of recurrent operations.
+class StatefulExecutionSession : public ExecutionSession {
+public:
+  typedef std::unique_ptr<OMTensor, decltype(&omTensorDestroy)> OMTensorPtr;
+
+  // The value of output `output` of a call is input `input` of the next one.
+  struct StateBinding {
+    int64_t input;
+    int64_t output;
+  };
+
+  // The entries of output `output` of a call are appended along dimension
+  // `axis` of the cache read by input `input` of the next one. The caches
+  // are preallocated for `capacity` entries.
+  struct CacheBinding {
+    int64_t input;
+    int64_t output;
+    int64_t axis;
+    int64_t capacity;
+  };
+
+  // The states and caches of a stream, in the order of the bindings of the
+  // session.
+  class Stream {
+  public:
+    const std::vector<OMTensorPtr> &getStates() const { return _states; }
+
+    // View of the entries of a cache.
+    OMTensor *getCache(size_t i) const { return _caches[i].view.get(); }
+
+    // Number of entries of a cache.
+    int64_t getCacheLength(size_t i) const { return _caches[i].length; }
+
+  private:
+    friend class StatefulExecutionSession;
+
+    // The buffer of a cache holds `capacity` entries along the axis of the
+    // binding, of which the first `length` are viewed by the model.
+    struct Cache {
+      Cache(OMTensorPtr buffer, OMTensorPtr view)
+          : buffer(std::move(buffer)), view(std::move(view)) {}
+      OMTensorPtr buffer;
+      OMTensorPtr view;
+      int64_t length = 0;
+      int64_t capacity = 0;
+    };
+
+    std::vector<OMTensorPtr> _states;
+    std::vector<Cache> _caches;
+    // Buffers the entry point writing into output buffers writes the next
+    // states to, if the model has one.
+    std::vector<OMTensorPtr> _nextStates;
+  };
+
+  // Load the model. The inputs and outputs of a binding must not be part of
+  // another binding.
+  StatefulExecutionSession(std::string sharedLibPath,
+      std::string entryPointName, std::vector<StateBinding> bindings,
+      std::vector<CacheBinding> caches = {});
+
+  // Create a stream starting from the given states, one per binding, e.g.
+  // zeroed hidden and cell states. The stream owns the states. The caches
+  // start with the given entries, one tensor per cache binding, which may
+  // have no entry along the axis of the binding.
+  std::unique_ptr<Stream> createStream(
+      std::vector<OMTensorPtr> states, std::vector<OMTensorPtr> caches = {});
+
+  // Run the model on the inputs that are not states or caches, in the order
+  // of the inputs of the model, and return its other outputs. The states of
+  // the stream are updated with the state outputs, and the cache outputs are
+  // appended to the caches.
+  std::vector<OMTensorPtr> run(Stream &stream, std::vector<OMTensorPtr> ins);
+
+  // Run the model and write its outputs that are not states or caches into
+  // the pre-allocated output tensors, which remain owned by the caller.
+  void runInto(Stream &stream, std::vector<OMTensorPtr> ins,
+      const std::vector<OMTensor *> &outs);
+
+  using ExecutionSession::run;
+  using ExecutionSession::runInto;
+
+private:
+  // Return the inputs of the model, the states and caches of the stream
+  // placed at the inputs of the bindings.
+  std::vector<OMTensor *> gatherInputs(
+      Stream &stream, const std::vector<OMTensorPtr> &ins) const;
+
+  // Index of the binding of an output, -1 if it is not a state output.
+  int64_t findOutputBinding(int64_t output) const;
+
+  // Index of the cache binding of an output, -1 if it is not a cache output.
+  int64_t findOutputCache(int64_t output) const;
+
+  // Copy the entries of a cache output at the end of the cache, growing its
+  // buffer if they do not fit.
+  void appendToCache(size_t i, Stream::Cache &cache, OMTensor *entries) const;
+
+  // Reallocate the buffer of a cache for `capacity` entries, keeping the
+  // entries it holds.
+  void reserveCache(size_t i, Stream::Cache &cache, int64_t capacity) const;
+
+  // Create the view of the entries of a cache from its buffer.
+  void createCacheView(size_t i, Stream::Cache &cache) const;
+
+  // Whether the calls writing into output buffers use the entry point of the
+  // model writing into output buffers.
+  bool usesIntoEntryPoint() const {
+    return hasIntoEntryPoint() && _caches.empty();
+  }
+
+  std::vector<StateBinding> _bindings;
+  std::vector<CacheBinding> _caches;
+};
+} // namespace onnx_mlir
@@ -16,6 +16,16 @@ extern "C" {
 JNIEXPORT jobject JNICALL Java_com_ibm_onnxmlir_DynEntryPoint_main_1graph_1jni(
     JNIEnv *, jclass, jobject);
 
+/*
+ * Class:     com_ibm_onnxmlir_DynEntryPoint
+ * Method:    main_graph_into_jni
+ * Signature:
+ * (Lcom/ibm/onnxmlir/OMTensorList;Lcom/ibm/onnxmlir/OMTensorList;)Lcom/ibm/onnxmlir/OMTensorList;
+ */
+JNIEXPORT jobject JNICALL
+Java_com_ibm_onnxmlir_DynEntryPoint_main_1graph_1into_1jni(
+    JNIEnv *, jclass, jobject, jobject);
+
 #ifdef __cplusplus
 }
 #endif
@@ -68,7 +68,7 @@
 
 /* Debug output of OMTensor fields */
 #define OMT_DEBUG(                                                             \
-    i, n, data, dataSizes, dataStrides, dataType, dataBufferSize, rank, name)  \
+    i, n, data, dataSizes, dataStrides, dataType, dataBufferSize, rank)        \
   do {                                                                         \
     char tmp[1024];                                                            \
     LOG_TYPE_BUF(dataType, tmp, data, n);                                      \
@@ -80,208 +80,250 @@
     LOG_PRINTF(LOG_DEBUG, "omt[%d]:dataType=%d", i, dataType);                 \
     LOG_PRINTF(LOG_DEBUG, "omt[%d]:dataBufferSize=%ld", i, dataBufferSize);    \
     LOG_PRINTF(LOG_DEBUG, "omt[%d]:rank=%d", i, rank);                         \
-    LOG_PRINTF(LOG_DEBUG, "omt[%d]:name=%s", i, name);                         \
     LOG_PRINTF(LOG_DEBUG, "omt[%d]:numOfElems=%ld", i, n);                     \
   } while (0)
 
-/* Model shared library entry point */
-extern OMTensorList *_dyn_entry_point_main_graph(OMTensorList *);
+/* Model shared library entry points. The entry point writing into output
+ * buffers is only generated for models compiled with them.
+ */
+extern OMTensorList *run_main_graph(OMTensorList *);
+extern OMTensorList *run_main_graph_into(OMTensorList *, OMTensorList *)
+    __attribute__((weak));
+
+/* Not part of the public OMTensor API, the buffers of the Java tensors are
+ * never owned by the native tensors wrapping them.
+ */
+extern void omTensorSetPtr(
+    OMTensor *tensor, int owning, void *allocatedPtr, void *alignedPtr);
 
-/* Java classes and methods needed for making various JNI API calls */
+/* Java classes, methods and fields needed for making various JNI API calls.
+ * They are looked up once when the library is loaded, the classes are kept
+ * as global references.
+ */
 typedef struct {
-  jclass ecpt_cls;     /* java/lang/Exception class                  */
-  jclass long_cls;     /* java/lang/Long class                       */
-  jclass string_cls;   /* java/lang/String class                     */
-  jclass omt_cls;      /* com/ibm/onnxmlir/OMTensor class            */
+  jclass ecpt_cls;     /* java/lang/Exception class           */
+  jclass omt_cls;      /* com/ibm/onnxmlir/OMTensor class     */
   jclass omt_list_cls; /* com/ibm/onnxmlir/OMTensorList class */
 
-  jmethodID omt_constructor;       /* OMTensor constructor              */
-  jmethodID omt_getData;           /* OMTensor getData method           */
-  jmethodID omt_setData;           /* OMTensor setData method           */
-  jmethodID omt_getDataSizes;      /* OMTensor getDataSizes method      */
-  jmethodID omt_setDataSizes;      /* OMTensor setDataSizes method      */
-  jmethodID omt_getDataStrides;    /* OMTensor getDataStrides method    */
-  jmethodID omt_setDataStrides;    /* OMTensor setDataStrides method    */
-  jmethodID omt_getDataType;       /* OMTensor getDataType method       */
-  jmethodID omt_setDataType;       /* OMTensor setDataType method       */
-  jmethodID omt_getDataBufferSize; /* OMTensor getDataBufferSize method */
-  jmethodID omt_getRank;           /* OMTensor getRank method           */
-  jmethodID omt_getName;           /* OMTensor getName method           */
-  jmethodID omt_setName;           /* OMTensor setName method           */
-  jmethodID omt_getNumOfElems;     /* OMTensor getNumOfElems method     */
-
-  jmethodID omt_list_constructor; /* OMTensorList constructor    */
-  jmethodID omt_list_getOmts;     /* OMTensorList getOmts method */
+  jmethodID omt_constructor; /* OMTensor constructor    */
+  jmethodID omt_setData;     /* OMTensor setData method */
+
+  jfieldID omt_data;     /* OMTensor _allocatedPtr field */
+  jfieldID omt_shape;    /* OMTensor _shape field        */
+  jfieldID omt_stride;   /* OMTensor _stride field       */
+  jfieldID omt_dataType; /* OMTensor _dataType field     */
+  jfieldID omt_rank;     /* OMTensor _rank field         */
+
+  jmethodID omt_list_constructor; /* OMTensorList constructor  */
+  jfieldID omt_list_omts;         /* OMTensorList _omts field  */
 } jniapi_t;
 
 jniapi_t jniapi;
 
+/* Native OMTensors wrapping the Java tensors of the calls made by a thread.
+ * They are reused by the next call of the thread as long as the number of
+ * tensors and their ranks do not change, so that the exchange does not
+ * allocate memory in the steady state.
+ */
+typedef struct {
+  OMTensor **omts;    /* OMTensor array of list */
+  int nomt;           /* Number of OMTensors    */
+  OMTensorList *list; /* OMTensorList wrapper   */
+} omt_list_cache_t;
+
+static __thread omt_list_cache_t input_cache;
+static __thread omt_list_cache_t output_cache;
+
+/* Get a global reference to a Java class */
+jclass find_global_class(JNIEnv *env, const char *name) {
+  JNI_TYPE_VAR_CALL(env, jclass, cls, (*env)->FindClass(env, name));
+  JNI_TYPE_VAR_CALL(env, jclass, global_cls, (*env)->NewGlobalRef(env, cls));
+  (*env)->DeleteLocalRef(env, cls);
+  return global_cls;
+}
+
 /* Fill in struct jniapi */
 jniapi_t *fill_jniapi(JNIEnv *env, jniapi_t *japi) {
-  /* Get Java Exception, Long, String, OMTensor, and OMTensorList classes
-   */
+  /* Get Java Exception, OMTensor, and OMTensorList classes */
   JNI_VAR_CALL(
-      env, japi->ecpt_cls, (*env)->FindClass(env, "java/lang/Exception"));
-  JNI_VAR_CALL(env, japi->long_cls, (*env)->FindClass(env, "java/lang/Long"));
-  JNI_VAR_CALL(
-      env, japi->string_cls, (*env)->FindClass(env, "java/lang/String"));
-  JNI_VAR_CALL(
-      env, japi->omt_cls, (*env)->FindClass(env, "com/ibm/onnxmlir/OMTensor"));
+      env, japi->ecpt_cls, find_global_class(env, "java/lang/Exception"));
+  JNI_VAR_CALL(env, japi->omt_cls,
+      find_global_class(env, "com/ibm/onnxmlir/OMTensor"));
   JNI_VAR_CALL(env, japi->omt_list_cls,
-      (*env)->FindClass(env, "com/ibm/onnxmlir/OMTensorList"));
+      find_global_class(env, "com/ibm/onnxmlir/OMTensorList"));
 
-  /* Get method ID of constructor and various methods in OMTensor */
+  /* Get method ID of constructor and setData, and field ID of the fields
+   * read and written directly in OMTensor
+   */
   JNI_VAR_CALL(env, japi->omt_constructor,
       (*env)->GetMethodID(env, japi->omt_cls, "<init>", "(I)V"));
-  JNI_VAR_CALL(env, japi->omt_getData,
-      (*env)->GetMethodID(
-          env, japi->omt_cls, "getData", "()Ljava/nio/ByteBuffer;"));
   JNI_VAR_CALL(env, japi->omt_setData,
       (*env)->GetMethodID(
           env, japi->omt_cls, "setData", "(Ljava/nio/ByteBuffer;)V"));
-  JNI_VAR_CALL(env, japi->omt_getDataSizes,
-      (*env)->GetMethodID(env, japi->omt_cls, "getDataSizes", "()[J"));
-  JNI_VAR_CALL(env, japi->omt_setDataSizes,
-      (*env)->GetMethodID(env, japi->omt_cls, "setDataSizes", "([J)V"));
-  JNI_VAR_CALL(env, japi->omt_getDataStrides,
-      (*env)->GetMethodID(env, japi->omt_cls, "getDataStrides", "()[J"));
-  JNI_VAR_CALL(env, japi->omt_setDataStrides,
-      (*env)->GetMethodID(env, japi->omt_cls, "setDataStrides", "([J)V"));
-  JNI_VAR_CALL(env, japi->omt_getDataType,
-      (*env)->GetMethodID(env, japi->omt_cls, "getDataType", "()I"));
-  JNI_VAR_CALL(env, japi->omt_setDataType,
-      (*env)->GetMethodID(env, japi->omt_cls, "setDataType", "(I)V"));
-  JNI_VAR_CALL(env, japi->omt_getDataBufferSize,
-      (*env)->GetMethodID(env, japi->omt_cls, "getDataBufferSize", "()J"));
-  JNI_VAR_CALL(env, japi->omt_getRank,
-      (*env)->GetMethodID(env, japi->omt_cls, "getRank", "()I"));
-  JNI_VAR_CALL(env, japi->omt_getName,
-      (*env)->GetMethodID(
-          env, japi->omt_cls, "getName", "()Ljava/lang/String;"));
-  JNI_VAR_CALL(env, japi->omt_setName,
-      (*env)->GetMethodID(
-          env, japi->omt_cls, "setName", "(Ljava/lang/String;)V"));
-  JNI_VAR_CALL(env, japi->omt_getNumOfElems,
-      (*env)->GetMethodID(env, japi->omt_cls, "getNumOfElems", "()J"));
-
-  /* Get method ID of constructor and various methods in OMTensorList */
+  JNI_VAR_CALL(env, japi->omt_data,
+      (*env)->GetFieldID(
+          env, japi->omt_cls, "_allocatedPtr", "Ljava/nio/ByteBuffer;"));
+  JNI_VAR_CALL(env, japi->omt_shape,
+      (*env)->GetFieldID(env, japi->omt_cls, "_shape", "[J"));
+  JNI_VAR_CALL(env, japi->omt_stride,
+      (*env)->GetFieldID(env, japi->omt_cls, "_stride", "[J"));
+  JNI_VAR_CALL(env, japi->omt_dataType,
+      (*env)->GetFieldID(env, japi->omt_cls, "_dataType", "I"));
+  JNI_VAR_CALL(env, japi->omt_rank,
+      (*env)->GetFieldID(env, japi->omt_cls, "_rank", "I"));
+
+  /* Get method ID of constructor and field ID of _omts in OMTensorList */
   JNI_VAR_CALL(env, japi->omt_list_constructor,
       (*env)->GetMethodID(env, japi->omt_list_cls, "<init>",
           "([Lcom/ibm/onnxmlir/OMTensor;)V"));
-  JNI_VAR_CALL(env, japi->omt_list_getOmts,
-      (*env)->GetMethodID(env, japi->omt_list_cls, "getOmts",
-          "()[Lcom/ibm/onnxmlir/OMTensor;"));
+  JNI_VAR_CALL(env, japi->omt_list_omts,
+      (*env)->GetFieldID(
+          env, japi->omt_list_cls, "_omts", "[Lcom/ibm/onnxmlir/OMTensor;"));
 
   return japi;
 }
 
-/* Convert Java object to native data structure */
+/* Look up the Java classes, methods and fields once, when the model shared
+ * library is loaded by System.load
+ */
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
+  JNIEnv *env;
+  if ((*vm)->GetEnv(vm, (void **)&env, JNI_VERSION_1_6) != JNI_OK)
+    return JNI_ERR;
+  if (!fill_jniapi(env, &jniapi))
+    return JNI_ERR;
+  return JNI_VERSION_1_6;
+}
+
+/* Free the OMTensors and the OMTensorList of a cache */
+void omt_list_cache_release(omt_list_cache_t *cache) {
+  if (!cache->list)
+    return;
+  for (int i = 0; i < cache->nomt; i++) {
+    if (cache->omts[i])
+      omTensorDestroy(cache->omts[i]);
+    cache->omts[i] = NULL;
+  }
+  /* Only frees the list since its OMTensors are now NULL */
+  omTensorListDestroy(cache->list);
+  free(cache->omts);
+  cache->omts = NULL;
+  cache->nomt = 0;
+  cache->list = NULL;
+}
+
+/* Get the OMTensorList of a cache holding nomt OMTensors */
+OMTensorList *omt_list_cache_get_list(omt_list_cache_t *cache, int nomt) {
+  if (cache->list && cache->nomt == nomt)
+    return cache->list;
+
+  omt_list_cache_release(cache);
+  /* OMTensorList does not copy the OMTensor array, the slots are filled in
+   * by omt_list_cache_get_omt
+   */
+  if (!(cache->omts = calloc(nomt ? nomt : 1, sizeof(OMTensor *))))
+    return NULL;
+  if (!(cache->list = omTensorListCreate(cache->omts, nomt))) {
+    free(cache->omts);
+    cache->omts = NULL;
+    return NULL;
+  }
+  cache->nomt = nomt;
+  return cache->list;
+}
+
+/* Get the i-th OMTensor of a cache, recreated if its rank changed */
+OMTensor *omt_list_cache_get_omt(omt_list_cache_t *cache, int i, int rank) {
+  OMTensor *omt = cache->omts[i];
+  if (omt && omTensorGetRank(omt) == rank)
+    return omt;
+  if (omt)
+    omTensorDestroy(omt);
+  return cache->omts[i] = omTensorCreateEmptyDeprecated(rank);
+}
+
+/* Convert Java object to native data structure. The native OMTensors point
+ * to the direct buffers of the Java OMTensors, no data is copied.
+ */
 OMTensorList *omt_list_java_to_native(
-    JNIEnv *env, jclass cls, jobject obj, jniapi_t *japi) {
+    JNIEnv *env, jobject obj, omt_list_cache_t *cache, jniapi_t *japi) {
 
   /* Get OMTensor array Java object in OMTensorList */
   JNI_TYPE_VAR_CALL(env, jobjectArray, omt_list_omts,
-      (*env)->CallObjectMethod(env, obj, japi->omt_list_getOmts));
+      (*env)->GetObjectField(env, obj, japi->omt_list_omts));
 
   /* Get the number of OMTensors in the array */
   JNI_TYPE_VAR_CALL(
       env, jsize, omt_list_nomt, (*env)->GetArrayLength(env, omt_list_omts));
 
-  /* Allocate memory for holding each Java omt object and OMTensor pointers
-   * for constructing native OMTensor array
-   */
-  LIB_TYPE_VAR_CALL(jobject *, obj_omts,
-      malloc(omt_list_nomt * sizeof(jobject)), NULL, env, japi->ecpt_cls,
-      "obj_omts=null");
-  LIB_TYPE_VAR_CALL(OMTensor **, jni_omts,
-      malloc(omt_list_nomt * sizeof(OMTensor *)), NULL, env, japi->ecpt_cls,
-      "jni_omts=null");
+  /* Get the OMTensorList reused from the previous call */
+  LIB_TYPE_VAR_CALL(OMTensorList *, list,
+      omt_list_cache_get_list(cache, omt_list_nomt), NULL, env, japi->ecpt_cls,
+      "list=null");
 
   /* Loop through all the omt_list_omts  */
   for (int i = 0; i < omt_list_nomt; i++) {
-    JNI_VAR_CALL(
-        env, obj_omts[i], (*env)->GetObjectArrayElement(env, omt_list_omts, i));
+    JNI_TYPE_VAR_CALL(env, jobject, obj_omt,
+        (*env)->GetObjectArrayElement(env, omt_list_omts, i));
 
-    /* Get data, dataSizes, dataStrides, dataType, rank, name and
-     * dataBufferSize by calling corresponding methods
-     */
+    /* Get data, shape, strides, dataType and rank from the fields */
     JNI_TYPE_VAR_CALL(env, jobject, omt_data,
-        (*env)->CallObjectMethod(env, obj_omts[i], japi->omt_getData));
-    JNI_TYPE_VAR_CALL(env, jobject, omt_dataSizes,
-        (*env)->CallObjectMethod(env, obj_omts[i], japi->omt_getDataSizes));
-    JNI_TYPE_VAR_CALL(env, jobject, omt_dataStrides,
-        (*env)->CallObjectMethod(env, obj_omts[i], japi->omt_getDataStrides));
+        (*env)->GetObjectField(env, obj_omt, japi->omt_data));
+    JNI_TYPE_VAR_CALL(env, jlongArray, omt_shape,
+        (*env)->GetObjectField(env, obj_omt, japi->omt_shape));
+    JNI_TYPE_VAR_CALL(env, jlongArray, omt_stride,
+        (*env)->GetObjectField(env, obj_omt, japi->omt_stride));
     JNI_TYPE_VAR_CALL(env, jint, omt_dataType,
-        (*env)->CallIntMethod(env, obj_omts[i], japi->omt_getDataType));
-    JNI_TYPE_VAR_CALL(env, jlong, omt_dataBufferSize,
-        (*env)->CallLongMethod(env, obj_omts[i], japi->omt_getDataBufferSize));
+        (*env)->GetIntField(env, obj_omt, japi->omt_dataType));
     JNI_TYPE_VAR_CALL(env, jint, omt_rank,
-        (*env)->CallIntMethod(env, obj_omts[i], japi->omt_getRank));
-    JNI_TYPE_VAR_CALL(env, jstring, omt_name,
-        (*env)->CallObjectMethod(env, obj_omts[i], japi->omt_getName));
-    JNI_TYPE_VAR_CALL(env, jlong, omt_numOfElems,
-        (*env)->CallLongMethod(env, obj_omts[i], japi->omt_getNumOfElems));
+        (*env)->GetIntField(env, obj_omt, japi->omt_rank));
 
     /* Get direct buffer associated with data */
-    JNI_TYPE_VAR_CALL(
-        env, void *, jni_data, (*env)->GetDirectBufferAddress(env, omt_data));
-
-    /* Get long array associated with data sizes and strides */
-    JNI_TYPE_VAR_CALL(env, long *, jni_dataSizes,
-        (*env)->GetLongArrayElements(env, omt_dataSizes, NULL));
-    JNI_TYPE_VAR_CALL(env, long *, jni_dataStrides,
-        (*env)->GetLongArrayElements(env, omt_dataStrides, NULL));
-
-    /* Primitive type int and long can be directly used */
-    int jni_dataType = omt_dataType;
-    long jni_dataBufferSize = omt_dataBufferSize;
-    int jni_rank = omt_rank;
-    long jni_numOfElems = omt_numOfElems;
-
-    /* Get name string */
-    JNI_TYPE_VAR_CALL(env, char *, jni_name,
-        (char *)(*env)->GetStringUTFChars(env, omt_name, NULL));
-
-    /* Print debug info on what we got from the Java side */
-    OMT_DEBUG(i, jni_numOfElems, jni_data, jni_dataSizes, jni_dataStrides,
-        jni_dataType, jni_dataBufferSize, jni_rank, jni_name);
+    LIB_TYPE_VAR_CALL(void *, jni_data,
+        (*env)->GetDirectBufferAddress(env, omt_data), NULL, env,
+        japi->ecpt_cls, "omt[%d]:data=null", i);
 
-    /* Create native OMTensor struct and fill in its fields */
-    LIB_VAR_CALL(jni_omts[i], omt_create(jni_rank), NULL, env, japi->ecpt_cls,
+    /* Fill in the native OMTensor reused from the previous call. The shape
+     * and strides are copied straight into its arrays.
+     */
+    LIB_TYPE_VAR_CALL(OMTensor *, jni_omt,
+        omt_list_cache_get_omt(cache, i, omt_rank), NULL, env, japi->ecpt_cls,
         "jni_omts[%d]=null", i);
-    omt_setData(jni_omts[i], jni_data);
-    omt_setDataSizes(jni_omts[i], jni_dataSizes);
-    omt_setDataStrides(jni_omts[i], jni_dataStrides);
-    omt_setDataType(jni_omts[i], jni_dataType);
-    omt_setName(jni_omts[i], jni_name);
+    omTensorSetPtr(jni_omt, 0, jni_data, jni_data);
+    omTensorSetDataType(jni_omt, omt_dataType);
+    JNI_CALL(env, (*env)->GetLongArrayRegion(env, omt_shape, 0, omt_rank,
+                      (jlong *)omTensorGetDataShape(jni_omt)));
+    JNI_CALL(env, (*env)->GetLongArrayRegion(env, omt_stride, 0, omt_rank,
+                      (jlong *)omTensorGetStrides(jni_omt)));
 
-    /* Release reference to the java objects */
-    JNI_CALL(env,
-        (*env)->ReleaseLongArrayElements(env, omt_dataSizes, jni_dataSizes, 0));
-    JNI_CALL(env, (*env)->ReleaseLongArrayElements(
-                      env, omt_dataStrides, jni_dataStrides, 0));
-    JNI_CALL(env, (*env)->ReleaseStringUTFChars(env, omt_name, jni_name));
+    /* Print debug info on what we got from the Java side */
+    OMT_DEBUG(i, omTensorGetNumElems(jni_omt), jni_data,
+        omTensorGetDataShape(jni_omt), omTensorGetStrides(jni_omt),
+        omt_dataType, omTensorGetDataBufferSize(jni_omt), omt_rank);
+
+    /* Release local references, the list may hold many tensors */
+    (*env)->DeleteLocalRef(env, omt_stride);
+    (*env)->DeleteLocalRef(env, omt_shape);
+    (*env)->DeleteLocalRef(env, omt_data);
+    (*env)->DeleteLocalRef(env, obj_omt);
   }
-
-  /* Create OMTensorList to be constructed and passed to the
-   * model shared library
-   */
-  LIB_TYPE_VAR_CALL(OMTensorList *, list,
-      omt_list_create(jni_omts, omt_list_nomt), NULL, env, japi->ecpt_cls,
-      "list=null");
+  (*env)->DeleteLocalRef(env, omt_list_omts);
 
   return list;
 }
 
-/* Convert native data structure to Java object */
+/* Convert native data structure to Java object. The Java OMTensors get
+ * direct buffers over the native data, which is not copied. The data is
+ * handed over to the Java side and is never freed.
+ */
 jobject omt_list_native_to_java(
-    JNIEnv *env, jclass cls, OMTensorList *dict, jniapi_t *japi) {
+    JNIEnv *env, OMTensorList *dict, jniapi_t *japi) {
 
   /* Get the OMTensor array in the OMTensorList */
-  LIB_TYPE_VAR_CALL(OMTensor **, jni_omts, omTensorListGetOmts(dict), NULL, env,
-      japi->ecpt_cls, "jni_omts=null");
+  LIB_TYPE_VAR_CALL(OMTensor **, jni_omts, omTensorListGetPtrToOmts(dict),
+      NULL, env, japi->ecpt_cls, "jni_omts=null");
   /* Get the number of OMTensors in the OMTensorList */
-  LIB_TYPE_VAR_CALL(int, jni_nomt, omTensorListGetNumOfOmts(dict), 0, env,
+  LIB_TYPE_VAR_CALL(int, jni_nomt, omTensorListGetSize(dict), 0, env,
       japi->ecpt_cls, "jni_nomt=0");
 
   /* Create OMTensor java object array */
@@ -291,73 +333,59 @@ jobject omt_list_native_to_java(
   /* Loop through the native OMTensor structs */
   for (int i = 0; i < jni_nomt; i++) {
 
-    LIB_TYPE_VAR_CALL(void *, jni_data, omTensorGetData(jni_omts[i]), NULL, env,
-        japi->ecpt_cls, "omt[%d]:data=null", i);
-    LIB_TYPE_VAR_CALL(long *, jni_dataSizes, omTensorGetDataSizes(jni_omts[i]),
-        NULL, env, japi->ecpt_cls, "omt[%d]:dataSizes=null", i);
-    LIB_TYPE_VAR_CALL(long *, jni_dataStrides,
-        omTensorGetDataStrides(jni_omts[i]), NULL, env, japi->ecpt_cls,
+    LIB_TYPE_VAR_CALL(void *, jni_data, omTensorGetDataPtr(jni_omts[i]), NULL,
+        env, japi->ecpt_cls, "omt[%d]:data=null", i);
+    LIB_TYPE_VAR_CALL(int64_t *, jni_dataSizes,
+        omTensorGetDataShape(jni_omts[i]), NULL, env, japi->ecpt_cls,
+        "omt[%d]:dataSizes=null", i);
+    LIB_TYPE_VAR_CALL(int64_t *, jni_dataStrides,
+        omTensorGetStrides(jni_omts[i]), NULL, env, japi->ecpt_cls,
         "omt[%d]:dataStrides=null", i);
     LIB_TYPE_VAR_CALL(int, jni_dataType, omTensorGetDataType(jni_omts[i]), 0,
         env, japi->ecpt_cls, "omt[%d]:dataType=0", i);
-    LIB_TYPE_VAR_CALL(long, jni_dataBufferSize,
-        omt_getDataBufferSize(jni_omts[i]), 0, env, japi->ecpt_cls,
-        "omt[%ld]:dataBufferSize=0", i);
+    LIB_TYPE_VAR_CALL(int64_t, jni_dataBufferSize,
+        omTensorGetDataBufferSize(jni_omts[i]), 0, env, japi->ecpt_cls,
+        "omt[%d]:dataBufferSize=0", i);
     LIB_TYPE_VAR_CALL(int, jni_rank, omTensorGetRank(jni_omts[i]), 0, env,
         japi->ecpt_cls, "omt[%d]:rank=0", i);
-    LIB_TYPE_VAR_CALL(char *, jni_name, omTensorGetName(jni_omts[i]), NULL, env,
-        japi->ecpt_cls, "omt[%d]:name=null", i);
-    LIB_TYPE_VAR_CALL(long, jni_numOfElems, omTensorGetNumOfElems(jni_omts[i]),
-        0, env, japi->ecpt_cls, "omt[%d]:numOfElems=0", i);
 
     /* Print debug info on what we got from the native side */
-    OMT_DEBUG(i, jni_numOfElems, jni_data, jni_dataSizes, jni_dataStrides,
-        jni_dataType, jni_dataBufferSize, jni_rank, jni_name);
+    OMT_DEBUG(i, omTensorGetNumElems(jni_omts[i]), jni_data, jni_dataSizes,
+        jni_dataStrides, jni_dataType, jni_dataBufferSize, jni_rank);
 
     /* Create the OMTensor Java object */
     JNI_TYPE_VAR_CALL(env, jobject, obj_omt,
         (*env)->NewObject(env, japi->omt_cls, japi->omt_constructor, jni_rank));
 
     /* Create direct byte buffer Java object from native data buffer, and
-     * call setData method
+     * call setData method to set its byte order
      */
     JNI_TYPE_VAR_CALL(env, jobject, omt_data,
         (*env)->NewDirectByteBuffer(env, jni_data, jni_dataBufferSize));
     JNI_CALL(env,
-        (*env)->CallObjectMethod(env, obj_omt, japi->omt_setData, omt_data));
+        (*env)->CallVoidMethod(env, obj_omt, japi->omt_setData, omt_data));
 
-    /* Create data sizes array Java object, fill in from native array, and
-     * call setDataSizes method
+    /* Fill in the shape and strides arrays allocated by the constructor, and
+     * the data type
      */
-    JNI_TYPE_VAR_CALL(
-        env, jlongArray, omt_dataSizes, (*env)->NewLongArray(env, jni_rank));
+    JNI_TYPE_VAR_CALL(env, jlongArray, omt_shape,
+        (*env)->GetObjectField(env, obj_omt, japi->omt_shape));
     JNI_CALL(env, (*env)->SetLongArrayRegion(
-                      env, omt_dataSizes, 0, jni_rank, jni_dataSizes));
-    JNI_CALL(env, (*env)->CallObjectMethod(
-                      env, obj_omt, japi->omt_setDataSizes, omt_dataSizes));
-
-    /* Create data strides array Java object, fill in from native array, and
-     * call setStrides method
-     */
-    JNI_TYPE_VAR_CALL(
-        env, jlongArray, omt_dataStrides, (*env)->NewLongArray(env, jni_rank));
+                      env, omt_shape, 0, jni_rank, (jlong *)jni_dataSizes));
+    JNI_TYPE_VAR_CALL(env, jlongArray, omt_stride,
+        (*env)->GetObjectField(env, obj_omt, japi->omt_stride));
     JNI_CALL(env, (*env)->SetLongArrayRegion(
-                      env, omt_dataStrides, 0, jni_rank, jni_dataStrides));
-    JNI_CALL(env, (*env)->CallObjectMethod(
-                      env, obj_omt, japi->omt_setDataStrides, omt_dataStrides));
-
-    /* Primitive type int can be directly used. Call setDataType method */
-    JNI_CALL(env, (*env)->CallIntMethod(
-                      env, obj_omt, japi->omt_setDataType, (jint)jni_dataType));
-
-    /* Create string Java object from native char * and call setName method */
-    JNI_TYPE_VAR_CALL(
-        env, jstring, omt_name, (*env)->NewStringUTF(env, jni_name));
-    JNI_CALL(env,
-        (*env)->CallObjectMethod(env, obj_omt, japi->omt_setName, omt_name));
+                      env, omt_stride, 0, jni_rank, (jlong *)jni_dataStrides));
+    JNI_CALL(env, (*env)->SetIntField(
+                      env, obj_omt, japi->omt_dataType, (jint)jni_dataType));
 
     /* Set OMTensor object in the object array */
     JNI_CALL(env, (*env)->SetObjectArrayElement(env, obj_omts, i, obj_omt));
+
+    (*env)->DeleteLocalRef(env, omt_stride);
+    (*env)->DeleteLocalRef(env, omt_shape);
+    (*env)->DeleteLocalRef(env, omt_data);
+    (*env)->DeleteLocalRef(env, obj_omt);
   }
 
   /* Create the OMTensorList java object */
@@ -368,18 +396,106 @@ jobject omt_list_native_to_java(
   return list;
 }
 
+/* Copy the native outputs of a model without output buffers into the direct
+ * buffers of the Java OMTensors, whose shape and strides are updated.
+ */
+jobject omt_list_copy_native_to_java(JNIEnv *env, OMTensorList *dict,
+    jobject obj, OMTensorList *list, jniapi_t *japi) {
+
+  OMTensor **jni_omts = omTensorListGetPtrToOmts(dict);
+  OMTensor **out_omts = omTensorListGetPtrToOmts(list);
+  int jni_nomt = omTensorListGetSize(dict);
+  LIB_CALL(, jni_nomt != omTensorListGetSize(list), env, japi->ecpt_cls,
+      "jni_nomt=%d, expected %d", jni_nomt, omTensorListGetSize(list));
+
+  /* Get OMTensor array Java object in OMTensorList */
+  JNI_TYPE_VAR_CALL(env, jobjectArray, omt_list_omts,
+      (*env)->GetObjectField(env, obj, japi->omt_list_omts));
+
+  for (int i = 0; i < jni_nomt; i++) {
+    int jni_rank = omTensorGetRank(jni_omts[i]);
+    int64_t jni_dataBufferSize = omTensorGetDataBufferSize(jni_omts[i]);
+    LIB_CALL(, jni_rank != omTensorGetRank(out_omts[i]) ||
+                   jni_dataBufferSize >
+                       omTensorGetDataBufferSize(out_omts[i]),
+        env, japi->ecpt_cls, "omt[%d]:output buffer mismatch", i);
+    memcpy(omTensorGetDataPtr(out_omts[i]), omTensorGetDataPtr(jni_omts[i]),
+        jni_dataBufferSize);
+
+    /* Update the shape and strides of the Java OMTensor */
+    JNI_TYPE_VAR_CALL(env, jobject, obj_omt,
+        (*env)->GetObjectArrayElement(env, omt_list_omts, i));
+    JNI_TYPE_VAR_CALL(env, jlongArray, omt_shape,
+        (*env)->GetObjectField(env, obj_omt, japi->omt_shape));
+    JNI_CALL(env, (*env)->SetLongArrayRegion(env, omt_shape, 0, jni_rank,
+                      (jlong *)omTensorGetDataShape(jni_omts[i])));
+    JNI_TYPE_VAR_CALL(env, jlongArray, omt_stride,
+        (*env)->GetObjectField(env, obj_omt, japi->omt_stride));
+    JNI_CALL(env, (*env)->SetLongArrayRegion(env, omt_stride, 0, jni_rank,
+                      (jlong *)omTensorGetStrides(jni_omts[i])));
+
+    (*env)->DeleteLocalRef(env, omt_stride);
+    (*env)->DeleteLocalRef(env, omt_shape);
+    (*env)->DeleteLocalRef(env, obj_omt);
+  }
+  (*env)->DeleteLocalRef(env, omt_list_omts);
+
+  return obj;
+}
+
+/* Free the outputs of the model, including their data */
+void omt_list_destroy(OMTensorList *dict) {
+  OMTensor **omts = omTensorListGetPtrToOmts(dict);
+  for (int i = 0; i < omTensorListGetSize(dict); i++) {
+    omTensorDestroy(omts[i]);
+    omts[i] = NULL;
+  }
+  omTensorListDestroy(dict);
+}
+
 JNIEXPORT jobject JNICALL Java_com_ibm_onnxmlir_DynEntryPoint_main_1graph_1jni(
     JNIEnv *env, jclass cls, jobject obj) {
-  CHECK_CALL(jniapi_t *, japi, fill_jniapi(env, &jniapi), NULL);
+  jniapi_t *japi = &jniapi;
 
   CHECK_CALL(OMTensorList *, input_list,
-      omt_list_java_to_native(env, cls, obj, japi), NULL);
+      omt_list_java_to_native(env, obj, &input_cache, japi), NULL);
+
+  LIB_TYPE_VAR_CALL(OMTensorList *, dict, run_main_graph(input_list), NULL,
+      env, japi->ecpt_cls, "dict=null");
 
   CHECK_CALL(
-      OMTensorList *, dict, _dyn_entry_point_main_graph(input_list), NULL);
+      jobject, output_list, omt_list_native_to_java(env, dict, japi), NULL);
 
-  CHECK_CALL(jobject, output_list,
-      omt_list_native_to_java(env, cls, dict, japi), NULL);
+  /* Only frees the native OMTensors, their data is used by output_list */
+  omTensorListDestroy(dict);
 
   return output_list;
 }
+
+JNIEXPORT jobject JNICALL
+Java_com_ibm_onnxmlir_DynEntryPoint_main_1graph_1into_1jni(
+    JNIEnv *env, jclass cls, jobject in, jobject out) {
+  jniapi_t *japi = &jniapi;
+
+  CHECK_CALL(OMTensorList *, input_list,
+      omt_list_java_to_native(env, in, &input_cache, japi), NULL);
+  CHECK_CALL(OMTensorList *, output_list,
+      omt_list_java_to_native(env, out, &output_cache, japi), NULL);
+
+  /* The model writes its outputs straight into the Java buffers */
+  if (run_main_graph_into) {
+    LIB_TYPE_VAR_CALL(OMTensorList *, dict,
+        run_main_graph_into(input_list, output_list), NULL, env,
+        japi->ecpt_cls, "dict=null");
+    return out;
+  }
+
+  /* Otherwise the outputs allocated by the model are copied */
+  LIB_TYPE_VAR_CALL(OMTensorList *, dict, run_main_graph(input_list), NULL,
+      env, japi->ecpt_cls, "dict=null");
+  jobject result =
+      omt_list_copy_native_to_java(env, dict, out, output_list, japi);
+  omt_list_destroy(dict);
+
+  return result;
+}
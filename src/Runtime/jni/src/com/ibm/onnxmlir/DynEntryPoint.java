@@ -57,8 +57,24 @@ public class DynEntryPoint {
     }
 
     private static native OMTensorList main_graph_jni(OMTensorList list);
+    private static native OMTensorList main_graph_into_jni(
+            OMTensorList input, OMTensorList output);
     
     public static OMTensorList main_graph(OMTensorList list) {
         return main_graph_jni(list);
     }
+
+    /**
+     * Run the model with its outputs written into the direct buffers of
+     * the given OMTensors, without allocating new buffers. The inputs and
+     * outputs can be reused across calls.
+     *
+     * @param input input OMTensorList
+     * @param output OMTensorList holding the output buffers
+     * @return output, with the shapes of the outputs updated
+     */
+    public static OMTensorList main_graph(OMTensorList input,
+            OMTensorList output) {
+        return main_graph_into_jni(input, output);
+    }
 }
@@ -75,6 +75,32 @@ public class OMTensor {
         _name = "";
     }
 
+    /**
+     * Constructor wrapping a direct byte buffer, which is passed to the
+     * model as is. The buffer can be refilled and reused across calls, or
+     * receive the outputs of the model.
+     *
+     * @param data direct byte buffer holding the data
+     * @param dataSizes data sizes array
+     * @param dataType data type
+     */
+    public OMTensor(ByteBuffer data, long[] dataSizes, int dataType) {
+        this(dataSizes.length);
+        if (!data.isDirect())
+            throw new IllegalArgumentException(
+                    "data buffer is not direct");
+        setData(data);
+        setDataSizes(dataSizes);
+        setDataType(dataType);
+
+        /* Strides of the dense row-major layout */
+        long stride = 1;
+        for (int i = _rank - 1; i >= 0; i--) {
+            _stride[i] = stride;
+            stride *= _shape[i];
+        }
+    }
+
     /* ---------- Raw data getter and setter ---------- */
     /* For JNI wrapper only. Not intended for end user. */
 
@@ -8,14 +8,28 @@
 // decodes a sequence of binary data within a binary file specified by an
 // offset and a length into a typed array and print to stdout.
 //
+// The range is memory-mapped rather than read, and decoded in chunks on
+// several threads, so that multi-gigabyte constant packs and output dumps can
+// be inspected. With --ref, the range is instead compared element by element
+// with a range of a reference file, and a summary of the differences is
+// printed.
+//
 //===----------------------------------------------------------------------===//
 
-#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "onnx/onnx_pb.h"
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
 
 #if defined(_WIN32)
 
@@ -39,6 +53,27 @@ llvm::cl::opt<int64_t> Size("n",
 llvm::cl::opt<bool> Remove(
     "rm", llvm::cl::desc(
               "Whether to remove the file being decoded after inspection."));
+llvm::cl::opt<unsigned> Threads("j",
+    llvm::cl::desc("Specify the number of threads decoding the data "
+                   "(default: the number of hardware threads)"),
+    llvm::cl::value_desc("threads"), llvm::cl::init(0));
+
+llvm::cl::opt<std::string> RefFilename("ref",
+    llvm::cl::desc("Compare the data with the data of a reference file"),
+    llvm::cl::value_desc("reference file"));
+llvm::cl::opt<int64_t> RefStart("ref-s",
+    llvm::cl::desc("Specify the index of the starting byte in the reference "
+                   "file (default: the starting byte of the input file)"),
+    llvm::cl::value_desc("start"), llvm::cl::init(-1));
+llvm::cl::opt<double> AbsTolerance("atol",
+    llvm::cl::desc("Absolute tolerance of the comparison"),
+    llvm::cl::value_desc("tolerance"), llvm::cl::init(1e-5));
+llvm::cl::opt<double> RelTolerance("rtol",
+    llvm::cl::desc("Relative tolerance of the comparison"),
+    llvm::cl::value_desc("tolerance"), llvm::cl::init(1e-5));
+llvm::cl::opt<unsigned> MaxMismatches("max-mismatches",
+    llvm::cl::desc("Specify the number of mismatches to print"),
+    llvm::cl::value_desc("count"), llvm::cl::init(10));
 
 llvm::cl::opt<onnx::TensorProto::DataType> DataType(
     llvm::cl::desc("Choose data type to decode:"),
@@ -56,31 +91,187 @@ llvm::cl::opt<onnx::TensorProto::DataType> DataType(
         clEnumVal(onnx::TensorProto::UINT32, "UINT32"),
         clEnumVal(onnx::TensorProto::UINT64, "UINT64")));
 
+// The number of elements decoded by a thread at a time.
+static const int64_t kChunkSize = 1 << 20;
+
+// Load an element of a buffer, which may not be aligned on the element type
+// when the starting byte is not.
 template <typename T>
-int printBuffer(std::vector<char> buffer) {
-  auto *ptr = (T *)&buffer[0];
-  auto data = std::vector<T>(ptr, ptr + buffer.size() / sizeof(T));
-  for (const auto &elem : data)
-    std::cout << elem << " ";
+static T loadElem(const char *data, int64_t i) {
+  T elem;
+  std::memcpy(&elem, data + i * sizeof(T), sizeof(T));
+  return elem;
+}
+
+// Map a range of a file in memory. Return nullptr after reporting an error if
+// the range is not within the file.
+static std::unique_ptr<llvm::MemoryBuffer> mapRange(
+    const std::string &filename, int64_t start, int64_t size) {
+  uint64_t fileSize;
+  if (llvm::sys::fs::file_size(filename, fileSize)) {
+    std::cerr << "cannot open " << filename << "\n";
+    return nullptr;
+  }
+  if (start < 0 || size < 0 || (uint64_t)(start + size) > fileSize) {
+    std::cerr << "bytes [" << start << ", " << start + size
+              << ") are not within " << filename << " of " << fileSize
+              << " bytes\n";
+    return nullptr;
+  }
+  auto buffer = llvm::MemoryBuffer::getFileSlice(filename, size, start);
+  if (!buffer) {
+    std::cerr << "cannot map " << filename << ": "
+              << buffer.getError().message() << "\n";
+    return nullptr;
+  }
+  return std::move(*buffer);
+}
+
+// Print the elements of a buffer. The chunks of a round, one per thread, are
+// formatted in parallel and printed in order, so that the memory used for
+// the text is bounded.
+template <typename T>
+int printBuffer(const llvm::MemoryBuffer &buffer) {
+  const char *data = buffer.getBufferStart();
+  int64_t numElems = buffer.getBufferSize() / sizeof(T);
+  int64_t numChunks = (numElems + kChunkSize - 1) / kChunkSize;
+  auto strategy = llvm::hardware_concurrency(Threads);
+  int64_t chunksPerRound = std::min<int64_t>(
+      std::max<int64_t>(strategy.compute_thread_count(), 1), numChunks);
+  std::vector<std::string> texts(chunksPerRound);
+  llvm::ThreadPool pool(strategy);
+  for (int64_t first = 0; first < numChunks; first += chunksPerRound) {
+    int64_t last = std::min(first + chunksPerRound, numChunks);
+    for (int64_t c = first; c < last; ++c)
+      pool.async([&, c]() {
+        std::ostringstream text;
+        int64_t end = std::min((c + 1) * kChunkSize, numElems);
+        for (int64_t i = c * kChunkSize; i < end; ++i)
+          text << loadElem<T>(data, i) << " ";
+        texts[c - first] = text.str();
+      });
+    pool.wait();
+    for (int64_t c = first; c < last; ++c)
+      std::cout << texts[c - first];
+  }
   return 0;
 }
 
+// The differences between a range of elements and the reference.
+struct CompareStats {
+  int64_t numMismatches = 0;
+  // The first mismatches, up to --max-mismatches.
+  std::vector<int64_t> mismatches;
+  double maxAbsDiff = 0;
+  int64_t maxAbsDiffIndex = -1;
+  double maxRelDiff = 0;
+  int64_t maxRelDiffIndex = -1;
+  double sumSquaredDiff = 0;
+
+  // Merge the differences of the next range.
+  void merge(const CompareStats &next) {
+    numMismatches += next.numMismatches;
+    for (int64_t i : next.mismatches)
+      if (mismatches.size() < MaxMismatches)
+        mismatches.emplace_back(i);
+    if (next.maxAbsDiff > maxAbsDiff || maxAbsDiffIndex < 0) {
+      maxAbsDiff = next.maxAbsDiff;
+      maxAbsDiffIndex = next.maxAbsDiffIndex;
+    }
+    if (next.maxRelDiff > maxRelDiff || maxRelDiffIndex < 0) {
+      maxRelDiff = next.maxRelDiff;
+      maxRelDiffIndex = next.maxRelDiffIndex;
+    }
+    sumSquaredDiff += next.sumSquaredDiff;
+  }
+};
+
+// Compare the elements of a buffer with the elements of a reference buffer.
+// An element matches if |elem - ref| <= atol + rtol * |ref|, and NaNs match
+// NaNs only. The chunks are compared in parallel, then the statistics are
+// merged in order. Return 1 if an element does not match.
+template <typename T>
+int compareBuffer(
+    const llvm::MemoryBuffer &buffer, const llvm::MemoryBuffer &refBuffer) {
+  const char *data = buffer.getBufferStart();
+  const char *refData = refBuffer.getBufferStart();
+  int64_t numElems = buffer.getBufferSize() / sizeof(T);
+  int64_t numChunks = (numElems + kChunkSize - 1) / kChunkSize;
+  std::vector<CompareStats> chunkStats(numChunks);
+  {
+    llvm::ThreadPool pool(llvm::hardware_concurrency(Threads));
+    for (int64_t c = 0; c < numChunks; ++c)
+      pool.async([&, c]() {
+        CompareStats &stats = chunkStats[c];
+        int64_t end = std::min((c + 1) * kChunkSize, numElems);
+        for (int64_t i = c * kChunkSize; i < end; ++i) {
+          double elem = loadElem<T>(data, i);
+          double ref = loadElem<T>(refData, i);
+          if (std::isnan(elem) || std::isnan(ref)) {
+            if (std::isnan(elem) != std::isnan(ref)) {
+              ++stats.numMismatches;
+              if (stats.mismatches.size() < MaxMismatches)
+                stats.mismatches.emplace_back(i);
+            }
+            continue;
+          }
+          double absDiff = std::fabs(elem - ref);
+          double relDiff = ref != 0 ? absDiff / std::fabs(ref) : 0;
+          if (absDiff > AbsTolerance + RelTolerance * std::fabs(ref)) {
+            ++stats.numMismatches;
+            if (stats.mismatches.size() < MaxMismatches)
+              stats.mismatches.emplace_back(i);
+          }
+          if (absDiff > stats.maxAbsDiff || stats.maxAbsDiffIndex < 0) {
+            stats.maxAbsDiff = absDiff;
+            stats.maxAbsDiffIndex = i;
+          }
+          if (relDiff > stats.maxRelDiff || stats.maxRelDiffIndex < 0) {
+            stats.maxRelDiff = relDiff;
+            stats.maxRelDiffIndex = i;
+          }
+          stats.sumSquaredDiff += absDiff * absDiff;
+        }
+      });
+    pool.wait();
+  }
+
+  CompareStats stats;
+  for (const auto &next : chunkStats)
+    stats.merge(next);
+  for (int64_t i : stats.mismatches)
+    std::cout << "mismatch at " << i << ": " << loadElem<T>(data, i)
+              << " vs " << loadElem<T>(refData, i) << "\n";
+  std::cout << "compared " << numElems << " elements, "
+            << stats.numMismatches << " mismatches\n";
+  if (stats.maxAbsDiffIndex >= 0)
+    std::cout << "max abs diff " << stats.maxAbsDiff << " at "
+              << stats.maxAbsDiffIndex << "\n"
+              << "max rel diff " << stats.maxRelDiff << " at "
+              << stats.maxRelDiffIndex << "\n"
+              << "rmse " << std::sqrt(stats.sumSquaredDiff / numElems)
+              << "\n";
+  return stats.numMismatches ? 1 : 0;
+}
+
 int main(int argc, char **argv) {
   llvm::cl::ParseCommandLineOptions(argc, argv);
-  std::vector<char> buffer(Size);
-  std::ifstream file(Filename, std::ios::in | std::ios::binary);
-  if (!file)
+  auto buffer = mapRange(Filename, Start, Size);
+  if (!buffer)
     return -1;
-  file.seekg(Start, file.beg);
-  file.read(&buffer[0], Size);
-  file.close();
-
-  if (Remove)
-    llvm::sys::fs::remove(Filename);
+  std::unique_ptr<llvm::MemoryBuffer> refBuffer;
+  if (!RefFilename.empty()) {
+    refBuffer =
+        mapRange(RefFilename, RefStart >= 0 ? RefStart : Start, Size);
+    if (!refBuffer)
+      return -1;
+  }
 
+  int result = 0;
 #define PRINT_BUFFER_FOR_TYPE(ONNX_TYPE, CPP_TYPE)                             \
   if (DataType == ONNX_TYPE)                                                   \
-    return printBuffer<CPP_TYPE>(buffer);
+    result = refBuffer ? compareBuffer<CPP_TYPE>(*buffer, *refBuffer)          \
+                       : printBuffer<CPP_TYPE>(*buffer);
 
   PRINT_BUFFER_FOR_TYPE(onnx::TensorProto::UINT8, u_int8_t);
   PRINT_BUFFER_FOR_TYPE(onnx::TensorProto::UINT16, u_int16_t);
@@ -92,4 +283,11 @@ int main(int argc, char **argv) {
   PRINT_BUFFER_FOR_TYPE(onnx::TensorProto::DOUBLE, double);
   PRINT_BUFFER_FOR_TYPE(onnx::TensorProto::UINT32, u_int32_t);
   PRINT_BUFFER_FOR_TYPE(onnx::TensorProto::UINT64, u_int64_t);
-}
\ No newline at end of file
+
+  // The mappings are released before the files are removed.
+  buffer.reset();
+  refBuffer.reset();
+  if (Remove)
+    llvm::sys::fs::remove(Filename);
+  return result;
+}
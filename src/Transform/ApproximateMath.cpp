@@ -0,0 +1,293 @@
+//===------- ApproximateMath.cpp - Polynomial Approximations of Math ------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The exponentials and logarithms emitted by the lowering of Softmax, Tanh,
+// Sigmoid, Gelu and the recurrent cells become calls to the math library, one
+// per element, which are not vectorized and cost about 20ns each.
+//
+// This file creates a pass which expands the f32 exp, log and tanh operations
+// of the standard dialect, on scalars and on vectors, into range reductions
+// and polynomial evaluations made only of element-wise arithmetic,
+// comparisons and selects, so that the loops computing them stay
+// vectorizable. The polynomials are those of the Cephes library:
+//
+//   exp(x) = 2^n * exp(r),  r = x - n * ln(2), |r| <= ln(2) / 2
+//   log(x) = e * ln(2) + log(m),  x = m * 2^e, sqrt(1/2) <= m < sqrt(2)
+//   tanh(x) = sign(x) * (1 - 2 / (exp(2 * |x|) + 1))
+//
+// with a maximum error of 2 ulp for normal results. The standard dialect has
+// no bit cast between integers and floats, so 2^n and e are obtained from the
+// binary digits of n and of the magnitude of x with selects instead of the
+// exponent field of the float.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Pass/Pass.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+
+#include "src/Pass/Passes.hpp"
+
+#include <cmath>
+#include <limits>
+
+using namespace mlir;
+
+namespace {
+
+/// Test if a type is f32 or a vector of f32, whose operations are expanded.
+bool isF32OrVectorOfF32(Type type) {
+  if (auto vectorType = type.dyn_cast<VectorType>())
+    type = vectorType.getElementType();
+  return type.isF32();
+}
+
+/// Emit a float constant of a scalar type or a splat constant of a vector
+/// type.
+Value emitSplatConstant(
+    PatternRewriter &rewriter, Location loc, Type type, double value) {
+  Type elementType = type;
+  if (auto vectorType = type.dyn_cast<VectorType>())
+    elementType = vectorType.getElementType();
+  Attribute attr = rewriter.getFloatAttr(elementType, value);
+  if (auto vectorType = type.dyn_cast<VectorType>())
+    attr = DenseElementsAttr::get(vectorType, attr);
+  return rewriter.create<ConstantOp>(loc, attr);
+}
+
+/// Evaluate the polynomial whose coefficients are given from the highest
+/// degree down, with the Horner scheme.
+Value emitPolynomial(PatternRewriter &rewriter, Location loc, Value x,
+    ArrayRef<double> coefficients) {
+  Type type = x.getType();
+  Value result = emitSplatConstant(rewriter, loc, type, coefficients[0]);
+  for (double coefficient : coefficients.drop_front())
+    result = rewriter.create<AddFOp>(loc,
+        rewriter.create<MulFOp>(loc, result, x),
+        emitSplatConstant(rewriter, loc, type, coefficient));
+  return result;
+}
+
+/// Range and coefficients of the exponential.
+const double kExpMaxInput = 88.72283905206835;
+const double kExpMinInput = -87.33654475055310;
+const double kLog2E = 1.44269504088896341;
+const double kLn2High = 0.693359375;
+const double kLn2Low = -2.12194440e-4;
+const double kExpCoefficients[] = {1.9875691500E-4, 1.3981999507E-3,
+    8.3334519073E-3, 4.1665795894E-2, 1.6666665459E-1, 5.0000001201E-1};
+
+/// Emit exp(x) for f32 scalars or vectors.
+Value emitExp(PatternRewriter &rewriter, Location loc, Value x) {
+  Type type = x.getType();
+  Value one = emitSplatConstant(rewriter, loc, type, 1);
+  Value maxInput = emitSplatConstant(rewriter, loc, type, kExpMaxInput);
+  Value minInput = emitSplatConstant(rewriter, loc, type, kExpMinInput);
+
+  // Clamp the input so that 2^n is a normal float. NaN inputs are kept, the
+  // comparisons with them being false.
+  Value tooLarge =
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::OGT, x, maxInput);
+  Value tooSmall =
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, x, minInput);
+  Value clamped = rewriter.create<SelectOp>(loc, tooLarge, maxInput, x);
+  clamped = rewriter.create<SelectOp>(loc, tooSmall, minInput, clamped);
+
+  // n = round(x / ln(2)) and r = x - n * ln(2), with ln(2) split in two parts
+  // so that n * ln2High is exact.
+  Value n = rewriter.create<CeilFOp>(loc,
+      rewriter.create<SubFOp>(loc,
+          rewriter.create<MulFOp>(loc, clamped,
+              emitSplatConstant(rewriter, loc, type, kLog2E)),
+          emitSplatConstant(rewriter, loc, type, 0.5)));
+  Value r = rewriter.create<SubFOp>(loc, clamped,
+      rewriter.create<MulFOp>(
+          loc, n, emitSplatConstant(rewriter, loc, type, kLn2High)));
+  r = rewriter.create<SubFOp>(loc, r,
+      rewriter.create<MulFOp>(
+          loc, n, emitSplatConstant(rewriter, loc, type, kLn2Low)));
+
+  // exp(r) = 1 + r + r^2 * P(r).
+  Value r2 = rewriter.create<MulFOp>(loc, r, r);
+  Value result = rewriter.create<AddFOp>(loc,
+      rewriter.create<AddFOp>(loc, one, r),
+      rewriter.create<MulFOp>(
+          loc, r2, emitPolynomial(rewriter, loc, r, kExpCoefficients)));
+
+  // Multiply by 2^n, one binary digit of |n| at a time from the highest.
+  // |n| <= 128, and 2^128 is applied as two factors 2^64 since it is not a
+  // float.
+  Value zero = emitSplatConstant(rewriter, loc, type, 0);
+  Value negative = rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, n, zero);
+  Value magnitude = rewriter.create<SelectOp>(
+      loc, negative, rewriter.create<SubFOp>(loc, zero, n), n);
+  for (int64_t digit = 7; digit >= 0; --digit) {
+    double bit = std::ldexp(1.0, digit);
+    double factor = std::ldexp(1.0, digit < 7 ? 1LL << digit : 64);
+    Value bitValue = emitSplatConstant(rewriter, loc, type, bit);
+    Value isSet =
+        rewriter.create<CmpFOp>(loc, CmpFPredicate::OGE, magnitude, bitValue);
+    magnitude = rewriter.create<SelectOp>(loc, isSet,
+        rewriter.create<SubFOp>(loc, magnitude, bitValue), magnitude);
+    Value scale = rewriter.create<SelectOp>(loc, negative,
+        emitSplatConstant(rewriter, loc, type, 1.0 / factor),
+        emitSplatConstant(rewriter, loc, type, factor));
+    scale = rewriter.create<SelectOp>(loc, isSet, scale, one);
+    result = rewriter.create<MulFOp>(loc, result, scale);
+    if (digit == 7)
+      result = rewriter.create<MulFOp>(loc, result, scale);
+  }
+
+  // Overflow to infinity and underflow to zero out of the range.
+  result = rewriter.create<SelectOp>(loc, tooLarge,
+      emitSplatConstant(
+          rewriter, loc, type, std::numeric_limits<double>::infinity()),
+      result);
+  return rewriter.create<SelectOp>(loc, tooSmall, zero, result);
+}
+
+/// Coefficients of the logarithm.
+const double kLogCoefficients[] = {7.0376836292E-2, -1.1514610310E-1,
+    1.1676998740E-1, -1.2420140846E-1, 1.4249322787E-1, -1.6668057665E-1,
+    2.0000714765E-1, -2.4999993993E-1, 3.3333331174E-1};
+
+/// Emit log(x) for f32 scalars or vectors.
+Value emitLog(PatternRewriter &rewriter, Location loc, Value x) {
+  Type type = x.getType();
+  Value zero = emitSplatConstant(rewriter, loc, type, 0);
+  Value one = emitSplatConstant(rewriter, loc, type, 1);
+
+  // Compute x = m * 2^e with m in [1/2, 2) by scaling x by powers 2^(2^k)
+  // from the largest down, first for x >= 1 and then for x < 1. The smallest
+  // subnormal is 2^-149, so 2^64 is applied twice to small inputs.
+  Value m = x;
+  Value e = zero;
+  auto emitScaleStep = [&](CmpFPredicate predicate, double threshold,
+                           double factor, double exponent) {
+    Value inRange = rewriter.create<CmpFOp>(loc, predicate, m,
+        emitSplatConstant(rewriter, loc, type, threshold));
+    m = rewriter.create<SelectOp>(loc, inRange,
+        rewriter.create<MulFOp>(
+            loc, m, emitSplatConstant(rewriter, loc, type, factor)),
+        m);
+    e = rewriter.create<SelectOp>(loc, inRange,
+        rewriter.create<AddFOp>(
+            loc, e, emitSplatConstant(rewriter, loc, type, exponent)),
+        e);
+  };
+  for (int64_t digit = 6; digit >= 0; --digit) {
+    double power = std::ldexp(1.0, 1LL << digit);
+    emitScaleStep(
+        CmpFPredicate::OGE, power, 1.0 / power, std::ldexp(1.0, digit));
+  }
+  const int64_t smallDigits[] = {6, 6, 5, 4, 3, 2, 1, 0};
+  for (int64_t digit : smallDigits) {
+    double power = std::ldexp(1.0, 1LL << digit);
+    emitScaleStep(
+        CmpFPredicate::OLT, 1.0 / power, power, -std::ldexp(1.0, digit));
+  }
+  // Bring m into [sqrt(1/2), sqrt(2)).
+  const double sqrtHalf = 0.70710678118654752;
+  emitScaleStep(CmpFPredicate::OGE, 2 * sqrtHalf, 0.5, 1);
+  emitScaleStep(CmpFPredicate::OLT, sqrtHalf, 2, -1);
+
+  // log(m) = z - z^2 / 2 + z^3 * P(z) with z = m - 1, and ln(2) split in two
+  // parts so that e * ln2High is exact.
+  Value z = rewriter.create<SubFOp>(loc, m, one);
+  Value z2 = rewriter.create<MulFOp>(loc, z, z);
+  Value y = rewriter.create<MulFOp>(loc,
+      rewriter.create<MulFOp>(loc, z, z2),
+      emitPolynomial(rewriter, loc, z, kLogCoefficients));
+  y = rewriter.create<AddFOp>(loc, y,
+      rewriter.create<MulFOp>(
+          loc, e, emitSplatConstant(rewriter, loc, type, kLn2Low)));
+  y = rewriter.create<SubFOp>(loc, y,
+      rewriter.create<MulFOp>(
+          loc, z2, emitSplatConstant(rewriter, loc, type, 0.5)));
+  Value result = rewriter.create<AddFOp>(loc, z, y);
+  result = rewriter.create<AddFOp>(loc, result,
+      rewriter.create<MulFOp>(
+          loc, e, emitSplatConstant(rewriter, loc, type, kLn2High)));
+
+  // log(0) = -inf, log(inf) = inf, and log(x) = NaN for x < 0 or NaN.
+  double infinity = std::numeric_limits<double>::infinity();
+  Value posInfinity = emitSplatConstant(rewriter, loc, type, infinity);
+  result = rewriter.create<SelectOp>(loc,
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::OEQ, x, zero),
+      emitSplatConstant(rewriter, loc, type, -infinity), result);
+  result = rewriter.create<SelectOp>(loc,
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::OEQ, x, posInfinity),
+      posInfinity, result);
+  return rewriter.create<SelectOp>(loc,
+      rewriter.create<CmpFOp>(loc, CmpFPredicate::ULT, x, zero),
+      emitSplatConstant(
+          rewriter, loc, type, std::numeric_limits<double>::quiet_NaN()),
+      result);
+}
+
+/// Emit tanh(x) for f32 scalars or vectors. exp(2 * |x|) overflows to
+/// infinity for large inputs, for which the result is then +-1.
+Value emitTanh(PatternRewriter &rewriter, Location loc, Value x) {
+  Type type = x.getType();
+  Value zero = emitSplatConstant(rewriter, loc, type, 0);
+  Value one = emitSplatConstant(rewriter, loc, type, 1);
+  Value two = emitSplatConstant(rewriter, loc, type, 2);
+  Value absX = rewriter.create<AbsFOp>(loc, x);
+  Value exp = emitExp(rewriter, loc, rewriter.create<MulFOp>(loc, absX, two));
+  Value absResult = rewriter.create<SubFOp>(loc, one,
+      rewriter.create<DivFOp>(
+          loc, two, rewriter.create<AddFOp>(loc, exp, one)));
+  Value negative = rewriter.create<CmpFOp>(loc, CmpFPredicate::OLT, x, zero);
+  return rewriter.create<SelectOp>(loc, negative,
+      rewriter.create<SubFOp>(loc, zero, absResult), absResult);
+}
+
+/*!
+ *  RewritePattern that replaces an f32 math operation of the standard
+ *  dialect with the sequence emitted by `emit`.
+ */
+template <typename MathOp, Value (*emit)(PatternRewriter &, Location, Value)>
+class ApproximateMathOp : public OpRewritePattern<MathOp> {
+public:
+  using OpRewritePattern<MathOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(
+      MathOp op, PatternRewriter &rewriter) const override {
+    Value operand = op.getOperand();
+    if (!isF32OrVectorOfF32(operand.getType()))
+      return failure();
+    rewriter.replaceOp(op, emit(rewriter, op.getLoc(), operand));
+    return success();
+  }
+};
+
+/*!
+ *  Function pass that expands math operations into polynomial
+ *  approximations.
+ */
+class ApproximateMathPass
+    : public PassWrapper<ApproximateMathPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    auto function = getFunction();
+
+    OwningRewritePatternList patterns;
+    patterns.insert<ApproximateMathOp<ExpOp, emitExp>,
+        ApproximateMathOp<LogOp, emitLog>,
+        ApproximateMathOp<TanhOp, emitTanh>>(&getContext());
+
+    applyPatternsAndFoldGreedily(function, patterns);
+  }
+};
+} // end anonymous namespace
+
+/*!
+ * Create a math approximation pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createApproximateMathPass() {
+  return std::make_unique<ApproximateMathPass>();
+}
@@ -217,7 +217,7 @@ public:
     // The newly bundled MemRef expressed as a KrnlGetRefOp.
     auto bundledMemRef = rewriter.create<KrnlGetRefOp>(loc,
         currentAllocGetRef.getResult().getType(), newStaticMemPoolAlloc,
-        offset);
+        offset, currentAllocGetRef.value());
     rewriter.replaceOp(currentAllocGetRef, bundledMemRef.getResult());
 
     // Replace old memory pool with new one.
@@ -422,7 +422,7 @@ public:
 
     KrnlGetRefOp bundledMemRef = rewriter.create<KrnlGetRefOp>(loc,
         currentAllocGetRef.getResult().getType(), bundledAlloc,
-        integerDynamicMemoryPoolSize);
+        integerDynamicMemoryPoolSize, currentAllocGetRef.value());
 
     // Replace old memory pool with new one.
     rewriter.replaceOp(oldDynamicMemoryPool, bundledAlloc.getResult());
@@ -0,0 +1,85 @@
+//===----------- EarlyDealloc.cpp - Deallocate MemRefs at Last Use --------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The lowering to Krnl places the deallocation of each internal MemRef at the
+// end of its block, so that all the MemRefs which are not bundled into static
+// memory pools, such as the dynamically shaped ones, are live until the
+// function returns. This pass moves each dealloc right after the last use of
+// its MemRef in the block of the dealloc, so that the memory is released for
+// the next allocations during the inference.
+//
+// Uses through an operation that may alias the MemRef, i.e. an operation
+// returning a MemRef such as krnl.getref or memref_cast, are uses of the
+// MemRef as well. MemRefs escaping their block, e.g. returned or yielded by an
+// alias, are not moved.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Find the last operation of the block using a MemRef or one of its aliases,
+/// other than the dealloc. Returns nullptr if the MemRef escapes the block or
+/// is used outside of it.
+Operation *findLastUse(Value memRef, DeallocOp dealloc) {
+  Block *block = dealloc.getOperation()->getBlock();
+  Operation *lastUse = memRef.getDefiningOp();
+  if (!lastUse || lastUse->getBlock() != block)
+    return nullptr;
+
+  SmallVector<Value, 4> worklist = {memRef};
+  llvm::SmallPtrSet<Operation *, 8> visited;
+  while (!worklist.empty()) {
+    Value value = worklist.pop_back_val();
+    for (Operation *user : value.getUsers()) {
+      if (user == dealloc.getOperation() || !visited.insert(user).second)
+        continue;
+      if (user->isKnownTerminator())
+        return nullptr;
+      Operation *ancestor = block->findAncestorOpInBlock(*user);
+      if (!ancestor)
+        return nullptr;
+      if (lastUse->isBeforeInBlock(ancestor))
+        lastUse = ancestor;
+      for (Value result : user->getResults())
+        if (result.getType().isa<BaseMemRefType>())
+          worklist.emplace_back(result);
+    }
+  }
+  return lastUse;
+}
+
+/*!
+ *  Function pass that deallocates the MemRefs right after their last use.
+ */
+class KrnlEarlyDeallocPass
+    : public PassWrapper<KrnlEarlyDeallocPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    auto function = getFunction();
+
+    SmallVector<DeallocOp, 16> deallocs;
+    function.walk([&](DeallocOp dealloc) { deallocs.emplace_back(dealloc); });
+    for (auto dealloc : deallocs) {
+      Operation *lastUse = findLastUse(dealloc.memref(), dealloc);
+      if (lastUse && lastUse->isBeforeInBlock(dealloc.getOperation()))
+        dealloc.getOperation()->moveAfter(lastUse);
+    }
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createKrnlEarlyDeallocPass() {
+  return std::make_unique<KrnlEarlyDeallocPass>();
+}
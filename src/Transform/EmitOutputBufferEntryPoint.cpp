@@ -0,0 +1,175 @@
+//===--- EmitOutputBufferEntryPoint.cpp - Entry Point with Output Buffers -===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The inference function of a model allocates its outputs, which the caller
+// then usually copies into its own buffers. This pass emits a variant of the
+// inference function taking the output MemRefs as trailing arguments, as well
+// as an entry point for it, so that the results are directly written into the
+// output tensors provided by the caller:
+//
+//   func @main_graph(%arg0: memref<10xf32>) -> memref<10xf32> {
+//     %0 = alloc() : memref<10xf32>
+//     ...
+//     return %0 : memref<10xf32>
+//   }
+//
+// is complemented with:
+//
+//   func @main_graph_into(%arg0: memref<10xf32>, %arg1: memref<10xf32>)
+//       -> memref<10xf32> {
+//     ...
+//     return %arg1 : memref<10xf32>
+//   }
+//
+// Only inference functions whose outputs are all statically shaped MemRefs
+// allocated in the function are handled.
+//
+// When the inputs are statically shaped as well, the new entry point can also
+// be marked for the emission of a typed entry point during the lowering to
+// LLVM, taking the raw data pointers of the inputs and outputs:
+//
+//   void run_main_graph_typed(float *input0, float *output0);
+//
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Collect the allocs of the outputs of the function. Returns failure if an
+/// output is not a distinct, statically shaped MemRef allocated in the body of
+/// the function.
+LogicalResult getOutputAllocs(
+    FuncOp function, SmallVectorImpl<AllocOp> &allocs) {
+  if (!llvm::hasSingleElement(function.getBody()))
+    return failure();
+
+  Block &entryBlock = function.getBody().front();
+  auto returnOp = dyn_cast<ReturnOp>(entryBlock.getTerminator());
+  if (!returnOp)
+    return failure();
+
+  for (Value output : returnOp.getOperands()) {
+    auto allocOp = output.getDefiningOp<AllocOp>();
+    if (!allocOp || allocOp.getOperation()->getBlock() != &entryBlock ||
+        !hasAllConstantDimensions(convertToMemRefType(output.getType())) ||
+        llvm::is_contained(allocs, allocOp))
+      return failure();
+    allocs.emplace_back(allocOp);
+  }
+  return success();
+}
+
+/*!
+ *  Module pass that emits an entry point writing into output buffers.
+ */
+class EmitOutputBufferEntryPointPass
+    : public PassWrapper<EmitOutputBufferEntryPointPass,
+          OperationPass<ModuleOp>> {
+public:
+  EmitOutputBufferEntryPointPass() = default;
+  EmitOutputBufferEntryPointPass(const EmitOutputBufferEntryPointPass &pass) {}
+  EmitOutputBufferEntryPointPass(bool typedEntryPoint) {
+    this->typedEntryPoint = typedEntryPoint;
+  }
+
+  void runOnOperation() override {
+    auto module = getOperation();
+
+    SmallVector<KrnlEntryPointOp, 1> entryPoints;
+    module.walk([&](KrnlEntryPointOp op) {
+      if (!op.getAttr(KrnlEntryPointOp::getOutputBuffersAttrName()))
+        entryPoints.emplace_back(op);
+    });
+
+    for (auto entryPoint : entryPoints) {
+      auto funcName = entryPoint
+                          .getAttrOfType<SymbolRefAttr>(
+                              KrnlEntryPointOp::getEntryPointFuncAttrName())
+                          .getLeafReference();
+      auto function = module.lookupSymbol<FuncOp>(funcName);
+      auto intoFuncName =
+          (Twine(funcName) + KrnlEntryPointOp::getOutputBuffersFuncSuffix())
+              .str();
+      if (!function || module.lookupSymbol(intoFuncName))
+        continue;
+
+      SmallVector<AllocOp, 4> outputAllocs;
+      if (failed(getOutputAllocs(function, outputAllocs)))
+        continue;
+
+      // Clone the inference function and replace the allocs of its outputs
+      // with new trailing arguments.
+      FuncOp intoFunc = function.clone();
+      intoFunc.setName(intoFuncName);
+      module.push_back(intoFunc);
+
+      Block &entryBlock = intoFunc.getBody().front();
+      auto returnOp = cast<ReturnOp>(entryBlock.getTerminator());
+      SmallVector<Type, 4> argTypes(intoFunc.getType().getInputs().begin(),
+          intoFunc.getType().getInputs().end());
+      for (Value output : returnOp.getOperands()) {
+        auto outputAlloc = output.getDefiningOp<AllocOp>();
+        Value outputBuffer = entryBlock.addArgument(output.getType());
+        argTypes.emplace_back(output.getType());
+        outputAlloc.getResult().replaceAllUsesWith(outputBuffer);
+        outputAlloc.erase();
+      }
+      intoFunc.setType(FunctionType::get(
+          argTypes, intoFunc.getType().getResults(), &getContext()));
+
+      // Emit the entry point of the new inference function.
+      OpBuilder builder(entryPoint);
+      builder.setInsertionPointAfter(entryPoint);
+      auto intoEntryPoint = builder.create<KrnlEntryPointOp>(
+          entryPoint.getLoc(), builder.getSymbolRefAttr(intoFuncName),
+          entryPoint.getAttrOfType<IntegerAttr>(
+              KrnlEntryPointOp::getNumInputsAttrName()),
+          entryPoint.getAttrOfType<IntegerAttr>(
+              KrnlEntryPointOp::getNumOutputsAttrName()));
+      intoEntryPoint.setAttr(KrnlEntryPointOp::getOutputBuffersAttrName(),
+          builder.getUnitAttr());
+
+      // The typed entry point passes the static shapes of the MemRefs.
+      if (!typedEntryPoint || !llvm::all_of(argTypes, [](Type type) {
+            auto memRefType = type.dyn_cast<MemRefType>();
+            return memRefType && memRefType.hasStaticShape() &&
+                   memRefType.getAffineMaps().empty();
+          }))
+        continue;
+      SmallVector<Attribute, 4> argTypeAttrs;
+      for (Type type : argTypes)
+        argTypeAttrs.emplace_back(TypeAttr::get(type));
+      intoEntryPoint.setAttr(KrnlEntryPointOp::getTypedEntryPointAttrName(),
+          builder.getArrayAttr(argTypeAttrs));
+    }
+  }
+
+private:
+  Option<bool> typedEntryPoint{*this, "typed-entry-point",
+      llvm::cl::desc("Also emit a typed entry point taking the raw data "
+                     "pointers of statically shaped inputs and outputs."),
+      llvm::cl::init(false)};
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createEmitOutputBufferEntryPointPass() {
+  return std::make_unique<EmitOutputBufferEntryPointPass>();
+}
+
+std::unique_ptr<Pass> mlir::createEmitOutputBufferEntryPointPass(
+    bool typedEntryPoint) {
+  return std::make_unique<EmitOutputBufferEntryPointPass>(typedEntryPoint);
+}
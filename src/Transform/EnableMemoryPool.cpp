@@ -11,6 +11,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/SCF/SCF.h"
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
@@ -34,6 +35,11 @@ bool checkOpResultIsReturned(AllocOp *allocOp) {
         opIsReturned = true;
   });
 
+  // The buffers yielded by the branches of an scf.if outlive the branches.
+  for (Operation *user : allocOp->getResult().getUsers())
+    if (isa<scf::YieldOp>(user))
+      opIsReturned = true;
+
   return opIsReturned;
 }
 
@@ -44,7 +50,8 @@ bool checkOpResultIsReturned(AllocOp *allocOp) {
  *    %mem = alloc() : memref<<dims>x<type>>
  *    %0 = krnl.getref %mem <offset> : memref<<dims>x<type>>
  *
- *  For now, to enable testing, offset will always be 0.
+ *  For now, to enable testing, offset will always be 0. The sizes of the
+ *  dynamic dimensions of the MemRef are forwarded to the krnl.getref.
  */
 
 class KrnlEnableMemoryPool : public OpRewritePattern<AllocOp> {
@@ -57,8 +64,6 @@ public:
 
     auto memRefType = convertToMemRefType(allocOp.getResult().getType());
 
-    // For now we only support constant tensors.
-    // TODO: Enable this pass for MemRef with dyanmic shapes.
     // If alloc operation is not returned then it is a candidate for
     // being included in the memory pool.
     if (checkOpResultIsReturned(&allocOp))
@@ -98,8 +103,8 @@ public:
     // Get reference to local MemRef.
     auto zero = rewriter.create<ConstantOp>(
         loc, rewriter.getIntegerAttr(rewriter.getIntegerType(64), 0));
-    auto poolMemRef =
-        rewriter.create<KrnlGetRefOp>(loc, memRefType, newAlloc, zero);
+    auto poolMemRef = rewriter.create<KrnlGetRefOp>(
+        loc, memRefType, newAlloc, zero, allocOp.getOperands());
 
     rewriter.replaceOp(allocOp, poolMemRef.getResult());
 
@@ -123,6 +128,44 @@ public:
   }
 };
 
+/*!
+ *  RewritePattern that replaces the dimensions of a MemRef of the memory pool
+ *  with the sizes recorded by its krnl.getref:
+ *    %0 = krnl.getref %mem <offset> %d : memref<?x<dims>x<type>>
+ *    %1 = dim %0, 0 : memref<?x<dims>x<type>>
+ *  with:
+ *    %1 = %d
+ *
+ *  The dynamic sizes of subsequent allocs then no longer depend on a
+ *  krnl.getref and these allocs can be bundled as well.
+ */
+
+class KrnlResolveGetRefDim : public OpRewritePattern<DimOp> {
+public:
+  using OpRewritePattern<DimOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(
+      DimOp dimOp, PatternRewriter &rewriter) const override {
+    auto getRefOp = dimOp.memrefOrTensor().getDefiningOp<KrnlGetRefOp>();
+    if (!getRefOp || getRefOp.value().empty())
+      return failure();
+
+    auto indexOp = dimOp.index().getDefiningOp<ConstantIndexOp>();
+    if (!indexOp)
+      return failure();
+    int64_t index = indexOp.getValue();
+
+    auto memRefType = convertToMemRefType(getRefOp.getResult().getType());
+    if (index < 0 || index >= memRefType.getRank() ||
+        !memRefType.isDynamicDim(index))
+      return failure();
+
+    rewriter.replaceOp(
+        dimOp, getRefOp.value()[memRefType.getDynamicDimIndex(index)]);
+    return success();
+  }
+};
+
 // TODO: Replace old dealloc with krnl.unsetref.
 
 /*!
@@ -138,6 +181,7 @@ public:
     OwningRewritePatternList patterns;
     patterns.insert<KrnlEnableMemoryPool>(&getContext());
     patterns.insert<KrnlEliminateOldDealloc>(&getContext());
+    patterns.insert<KrnlResolveGetRefDim>(&getContext());
 
     applyPatternsAndFoldGreedily(function, patterns);
   }
@@ -0,0 +1,254 @@
+//===-------- FuseKrnlLoops.cpp - Fuse Producer and Consumer Loop Nests ---===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Each ONNX operation is lowered to its own loop nests, which write the result
+// of the operation to a buffer read back by the loop nests of the next
+// operation. This pass fuses a loop nest writing buffers element-wise into the
+// next loop nest of the function, when both iterate over the same space and
+// the second one reads the buffers at the indices it iterates over. The loads
+// of a buffer that is then only used by the fused loop nest are replaced by
+// the stored value, and the buffer is removed before any memory pool is
+// formed.
+//
+// The affine loop fusion pass is not used for this purpose: it runs after the
+// memory pools are formed, when the intermediate buffers are views of the
+// memory pools which may share memory.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Return the definition of the loops of a krnl.iterate iterating over all of
+/// them without optimization and with bounds that are not operands, or null.
+KrnlDefineLoopsOp getDefineLoops(KrnlIterateOp iterateOp) {
+  int64_t numLoops = iterateOp.bodyRegion().front().getNumArguments();
+  if (numLoops == 0 || iterateOp.getNumOptimizedLoops() != numLoops ||
+      iterateOp.getNumOperands() != 2 * numLoops)
+    return nullptr;
+  auto defineOp = iterateOp.getOperand(0).getDefiningOp<KrnlDefineLoopsOp>();
+  if (!defineOp || defineOp.getNumResults() != numLoops)
+    return nullptr;
+  for (int64_t i = 0; i < numLoops; ++i)
+    if (iterateOp.getOperand(i) != defineOp.getResult(i) ||
+        iterateOp.getOperand(numLoops + i) != defineOp.getResult(i))
+      return nullptr;
+  for (Operation *user : defineOp.getOperation()->getUsers())
+    if (user != iterateOp.getOperation() && !isa<KrnlParallelOp>(user))
+      return nullptr;
+  return defineOp;
+}
+
+/// Collect the loads and stores of the body of a loop nest. Return false if
+/// the body holds operations other than affine loads and stores and
+/// operations without memory effects.
+bool collectAccesses(KrnlIterateOp iterateOp,
+    SmallVectorImpl<AffineLoadOp> &loads,
+    SmallVectorImpl<AffineStoreOp> &stores) {
+  for (Operation &op : iterateOp.bodyRegion().front().without_terminator()) {
+    if (auto load = dyn_cast<AffineLoadOp>(op))
+      loads.emplace_back(load);
+    else if (auto store = dyn_cast<AffineStoreOp>(op))
+      stores.emplace_back(store);
+    else if (op.getNumRegions() != 0 ||
+             !MemoryEffectOpInterface::hasNoEffect(&op))
+      return false;
+  }
+  return true;
+}
+
+/// Test if an access indexes its MemRef with the induction variables of the
+/// loop nest, in order.
+template <typename AccessOp>
+bool isElementwiseAccess(AccessOp accessOp, Block &body) {
+  return accessOp.getAffineMap().isIdentity() &&
+         llvm::equal(accessOp.getMapOperands(), body.getArguments());
+}
+
+/// Return the MemRef of which a MemRef is a view, or the MemRef itself.
+Value getBaseMemRef(Value memRef) {
+  while (Operation *defOp = memRef.getDefiningOp()) {
+    if (!isa<KrnlReshapeOp, KrnlGetRefOp>(defOp))
+      break;
+    memRef = defOp->getOperand(0);
+  }
+  return memRef;
+}
+
+/// Test if the consumer loop nest can be fused into the producer loop nest,
+/// the first krnl.iterate before it in the same block.
+bool canFuse(KrnlIterateOp producer, KrnlIterateOp consumer) {
+  if (!getDefineLoops(producer) || !getDefineLoops(consumer))
+    return false;
+  auto boundsAttrName = KrnlIterateOp::getBoundsAttrName();
+  if (producer.getAttr(boundsAttrName) != consumer.getAttr(boundsAttrName))
+    return false;
+
+  // The producer is computed after the operations in between, which must not
+  // access memory.
+  for (Operation *op = producer.getOperation()->getNextNode();
+       op != consumer.getOperation(); op = op->getNextNode())
+    if (!isa<AllocOp, KrnlDefineLoopsOp, KrnlParallelOp>(op) &&
+        (op->getNumRegions() != 0 || !MemoryEffectOpInterface::hasNoEffect(op)))
+      return false;
+
+  SmallVector<AffineLoadOp, 8> producerLoads, consumerLoads;
+  SmallVector<AffineStoreOp, 4> producerStores, consumerStores;
+  if (!collectAccesses(producer, producerLoads, producerStores) ||
+      !collectAccesses(consumer, consumerLoads, consumerStores))
+    return false;
+  Block &producerBody = producer.bodyRegion().front();
+  Block &consumerBody = consumer.bodyRegion().front();
+
+  // Each iteration of the producer writes its own elements, and reads no other
+  // elements of the buffers it writes.
+  llvm::DenseSet<Value> producedMemRefs, producedBases, producerReadBases;
+  for (auto store : producerStores) {
+    if (!isElementwiseAccess(store, producerBody))
+      return false;
+    producedMemRefs.insert(store.getMemRef());
+    producedBases.insert(getBaseMemRef(store.getMemRef()));
+  }
+  for (auto load : producerLoads) {
+    Value base = getBaseMemRef(load.getMemRef());
+    if (!producedBases.count(base)) {
+      producerReadBases.insert(base);
+      continue;
+    }
+    if (!producedMemRefs.count(load.getMemRef()) ||
+        !isElementwiseAccess(load, producerBody))
+      return false;
+  }
+
+  // Each iteration of the consumer reads the elements written by the same
+  // iteration of the producer, and does not write what the producer reads. It
+  // may only overwrite the elements written by the same iteration of the
+  // producer, e.g. when the result of an element-wise operation reuses the
+  // buffer of its input.
+  bool readsProducedMemRef = false;
+  for (auto load : consumerLoads) {
+    if (!producedBases.count(getBaseMemRef(load.getMemRef())))
+      continue;
+    if (!producedMemRefs.count(load.getMemRef()) ||
+        !isElementwiseAccess(load, consumerBody))
+      return false;
+    readsProducedMemRef = true;
+  }
+  for (auto store : consumerStores) {
+    Value base = getBaseMemRef(store.getMemRef());
+    if (producerReadBases.count(base))
+      return false;
+    if (producedBases.count(base) &&
+        (!producedMemRefs.count(store.getMemRef()) ||
+            !isElementwiseAccess(store, consumerBody)))
+      return false;
+  }
+  return readsProducedMemRef;
+}
+
+/// Move the body of the producer loop nest at the beginning of the body of
+/// the consumer loop nest, and remove the producer loops. The fused loop nest
+/// keeps the loops of the consumer and their krnl.parallel operations.
+void fuse(KrnlIterateOp producer, KrnlIterateOp consumer) {
+  KrnlDefineLoopsOp defineOp = getDefineLoops(producer);
+  Block &producerBody = producer.bodyRegion().front();
+  Block &consumerBody = consumer.bodyRegion().front();
+  for (auto args :
+      llvm::zip(producerBody.getArguments(), consumerBody.getArguments()))
+    std::get<0>(args).replaceAllUsesWith(std::get<1>(args));
+  consumerBody.getOperations().splice(consumerBody.begin(),
+      producerBody.getOperations(), producerBody.begin(),
+      std::prev(producerBody.end()));
+  producer.erase();
+
+  SmallVector<Operation *, 2> loopUsers(
+      defineOp.getOperation()->getUsers().begin(),
+      defineOp.getOperation()->getUsers().end());
+  for (Operation *user : loopUsers)
+    user->erase();
+  defineOp.erase();
+}
+
+/// Replace the loads of the buffers written and read only by the body of a
+/// loop nest by the values stored to them, then remove the buffers.
+void forwardLocalBuffers(KrnlIterateOp iterateOp) {
+  Block &body = iterateOp.bodyRegion().front();
+  SmallVector<AffineStoreOp, 4> stores;
+  for (Operation &op : body.without_terminator())
+    if (auto store = dyn_cast<AffineStoreOp>(op))
+      stores.emplace_back(store);
+
+  for (auto store : stores) {
+    auto allocOp = store.getMemRef().getDefiningOp<AllocOp>();
+    if (!allocOp)
+      continue;
+    SmallVector<Operation *, 4> loads, deallocs;
+    bool isLocal = true;
+    for (Operation *user : allocOp.getResult().getUsers()) {
+      if (user == store.getOperation())
+        continue;
+      auto load = dyn_cast<AffineLoadOp>(user);
+      if (load && load.getOperation()->getBlock() == &body &&
+          store.getOperation()->isBeforeInBlock(load) &&
+          isElementwiseAccess(load, body))
+        loads.emplace_back(user);
+      else if (isa<DeallocOp>(user))
+        deallocs.emplace_back(user);
+      else
+        isLocal = false;
+    }
+    if (!isLocal)
+      continue;
+
+    for (Operation *load : loads) {
+      load->getResult(0).replaceAllUsesWith(store.getValueToStore());
+      load->erase();
+    }
+    store.erase();
+    for (Operation *dealloc : deallocs)
+      dealloc->erase();
+    allocOp.erase();
+  }
+}
+
+/*!
+ *  Function pass that fuses producer and consumer Krnl loop nests.
+ */
+class KrnlFuseLoopsPass
+    : public PassWrapper<KrnlFuseLoopsPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    auto function = getFunction();
+
+    SmallVector<KrnlIterateOp, 16> loopNests;
+    for (Operation &op : function.getBody().front())
+      if (auto iterateOp = dyn_cast<KrnlIterateOp>(op))
+        loopNests.emplace_back(iterateOp);
+
+    // A loop nest fused into the next one makes it the producer of the one
+    // after, so that chains of operations end up in a single loop nest.
+    for (unsigned i = 1; i < loopNests.size(); ++i) {
+      if (!canFuse(loopNests[i - 1], loopNests[i]))
+        continue;
+      fuse(loopNests[i - 1], loopNests[i]);
+      forwardLocalBuffers(loopNests[i]);
+    }
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createKrnlFuseLoopsPass() {
+  return std::make_unique<KrnlFuseLoopsPass>();
+}
@@ -0,0 +1,83 @@
+//===------ HoistKrnlLoopInvariants.cpp - Hoist Loop-Invariant Code -------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The lowerings compute the index expressions, the broadcasting selects and
+// the dimensions of their MemRefs in the body of their loop nests, even when
+// they only depend on values defined before the loop nest, e.g. on the loop
+// nest computing the outer dimensions of a Gather or a Tile. This pass moves
+// these computations out of the krnl.iterate operations.
+//
+// The pass runs before the lowering to affine loops, so that the hoisted code
+// is not duplicated by krnl.unroll, nor left between the loops permuted by
+// krnl.permute or tiled by krnl.block, which require perfectly nested loops.
+// The computations depending on the outer loops of a krnl.iterate share the
+// body of its innermost loop until the lowering; they are hoisted by the loop
+// invariant code motion of the affine loops.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Test if an operation of the body of a loop nest can be executed once
+/// before it. Operations with memory effects or regions are left in the
+/// body, as are the integer divisions which may trap in loop nests executed
+/// zero times.
+bool isHoistable(Operation *op) {
+  if (isa<KrnlDimOp>(op))
+    return true;
+  // The other Krnl operations define or schedule the loops.
+  if (op->getNumRegions() != 0 || op->isKnownTerminator() ||
+      op->getName().getDialect() == KrnlOpsDialect::getDialectNamespace())
+    return false;
+  if (isa<SignedDivIOp, UnsignedDivIOp, SignedRemIOp, UnsignedRemIOp,
+          SignedFloorDivIOp, SignedCeilDivIOp>(op))
+    return false;
+  return MemoryEffectOpInterface::hasNoEffect(op);
+}
+
+/// Move the operations of the body of a loop nest which only depend on values
+/// defined before it in front of it.
+void hoistLoopInvariants(KrnlIterateOp iterateOp) {
+  Region &body = iterateOp.bodyRegion();
+  SmallVector<Operation *, 16> ops;
+  for (Operation &op : body.front())
+    ops.emplace_back(&op);
+  // The operations are visited in order, so that a chain of invariant
+  // operations is hoisted as a whole.
+  for (Operation *op : ops)
+    if (isHoistable(op) && llvm::all_of(op->getOperands(), [&](Value v) {
+          return !body.isAncestor(v.getParentRegion());
+        }))
+      op->moveBefore(iterateOp);
+}
+
+/*!
+ *  Function pass that hoists the loop-invariant code of the Krnl loop nests.
+ */
+class KrnlHoistLoopInvariantsPass
+    : public PassWrapper<KrnlHoistLoopInvariantsPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    // The nested loop nests are visited first, so that their invariant code
+    // can be hoisted again out of the enclosing loop nests.
+    getFunction().walk(
+        [&](KrnlIterateOp iterateOp) { hoistLoopInvariants(iterateOp); });
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createKrnlHoistLoopInvariantsPass() {
+  return std::make_unique<KrnlHoistLoopInvariantsPass>();
+}
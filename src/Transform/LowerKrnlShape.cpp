@@ -30,9 +30,8 @@ namespace {
  *    %0 = alloc(%d) : memref<?x10x<type>, #map>
  *    %c0 = constant 0 : index
  *    %1 = krnl.dim(%0, %c0) : memref<?x10x<type>, #map>, index
- *    %c1 = constant 1 : index
- *    %2 = krnl.dim(%0, %c1) : memref<?x10x<type>, #map>, index
- *    %shape = shape.from_extents %1, %2
+ *    %c10 = constant 10 : index
+ *    %shape = shape.from_extents %1, %c10
  */
 
 class LowerKrnlShape : public OpRewritePattern<KrnlShapeOp> {
@@ -42,11 +41,18 @@ public:
   LogicalResult matchAndRewrite(
       KrnlShapeOp krnlShapeOp, PatternRewriter &rewriter) const override {
     auto loc = krnlShapeOp.getLoc();
-    auto rank =
-        convertToMemRefType(krnlShapeOp.alloc().getType()).getShape().size();
+    auto shape =
+        convertToMemRefType(krnlShapeOp.alloc().getType()).getShape();
+    auto rank = shape.size();
 
     SmallVector<mlir::Value, 4> fromExtentsOpOperands;
     for (int idx = 0; idx < rank; idx++) {
+      // Static dimensions are emitted as constants.
+      if (shape[idx] >= 0) {
+        fromExtentsOpOperands.emplace_back(rewriter.create<ConstantOp>(
+            loc, rewriter.getIntegerAttr(rewriter.getIndexType(), shape[idx])));
+        continue;
+      }
       auto index = rewriter.create<ConstantOp>(
           loc, rewriter.getIntegerAttr(rewriter.getIndexType(), idx));
       auto operand = rewriter.create<KrnlDimOp>(
@@ -0,0 +1,45 @@
+//===------- MapParallelLoopsToGPU.cpp - Map Parallel Loops onto a GPU ----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The loops marked krnl.parallel are lowered to scf.parallel loops through the
+// Affine dialect. This pass maps each nest of scf.parallel loops of a function
+// onto the hardware of a GPU, the outermost loops onto the grid of blocks and
+// the loops nested in them onto the threads of a block, so that the nests are
+// turned into gpu.launch operations by the conversion of parallel loops to
+// the GPU dialect.
+//
+// The operations outside the parallel loops, and the loops which carry a
+// dependence, are left to the host. The GPU path is an IR-only preview: the
+// kernels take the host MemRefs, and no device memory, host-device copies or
+// kernel binaries are generated.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/GPU/ParallelLoopMapper.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/*!
+ *  Function pass that maps the parallel loops onto the blocks and the threads
+ *  of a GPU.
+ */
+class MapParallelLoopsToGPUPass
+    : public PassWrapper<MapParallelLoopsToGPUPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    greedilyMapParallelSCFToGPU(getFunction().getBody());
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createMapParallelLoopsToGPUPass() {
+  return std::make_unique<MapParallelLoopsToGPUPass>();
+}
@@ -0,0 +1,215 @@
+//===--------- AttentionFusion.cpp - Fuse Scaled Dot-Product Attention ----===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The self-attention layers of transformer models (BERT, GPT) are exported as
+// a MatMul of the queries and the transposed keys, a Div or Mul by a constant
+// scale, an optional Add of a mask, a Softmax and a MatMul with the values.
+// Each operation is lowered to its own loop nests, and the [..., S, L] score
+// tensor between them is written to memory and read back three times, which
+// dominates the memory traffic of long sequences.
+//
+// This file creates a pass which replaces these operations with a single
+// ONNXFusedAttentionOp, whose lowering computes the scores of one block of
+// keys at a time with an online softmax:
+//
+//   %0 = "onnx.MatMul"(%q, %k) : (...) -> tensor<1x12x128x128xf32>
+//   %1 = "onnx.Div"(%0, %c) : (...) -> tensor<1x12x128x128xf32>
+//   %2 = "onnx.Add"(%1, %mask) : (...) -> tensor<1x12x128x128xf32>
+//   %3 = "onnx.Softmax"(%2) {axis = 3 : si64} : (...) -> ...
+//   %4 = "onnx.MatMul"(%3, %v) : (...) -> tensor<1x12x128x64xf32>
+//
+// becomes:
+//
+//   %0 = "onnx.FusedAttention"(%q, %k, %v, %mask) {scale = 1/c}
+//
+// The Reshape and Transpose operations splitting and merging the heads are
+// left around the fused operation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Read the value of a scalar floating-point constant. Returns false if the
+/// value is not such a constant.
+bool getScalarConstant(Value value, double &scalar) {
+  auto constOp = value.getDefiningOp<ONNXConstantOp>();
+  if (!constOp || !constOp.value().hasValue())
+    return false;
+  auto dense = constOp.valueAttr().dyn_cast<DenseElementsAttr>();
+  if (!dense || !dense.isSplat() || dense.getType().getNumElements() != 1)
+    return false;
+  auto splat = dense.getSplatValue().dyn_cast<FloatAttr>();
+  if (!splat)
+    return false;
+  scalar = splat.getValueAsDouble();
+  return true;
+}
+
+/// Test if a value is a static f32 tensor of at least two dimensions.
+bool isStaticMatrixBatch(Value value) {
+  auto type = value.getType().dyn_cast<RankedTensorType>();
+  return type && type.hasStaticShape() && type.getRank() >= 2 &&
+         type.getElementType().isF32();
+}
+
+/// Test if the mask can be broadcast to the scores without changing their
+/// shape.
+bool isBroadcastableMask(Value mask, RankedTensorType scoresType) {
+  auto maskType = mask.getType().dyn_cast<RankedTensorType>();
+  if (!maskType || !maskType.hasStaticShape() ||
+      maskType.getElementType() != scoresType.getElementType() ||
+      maskType.getRank() > scoresType.getRank())
+    return false;
+  int64_t offset = scoresType.getRank() - maskType.getRank();
+  for (int64_t i = 0; i < maskType.getRank(); ++i) {
+    int64_t dim = maskType.getShape()[i];
+    if (dim != 1 && dim != scoresType.getShape()[offset + i])
+      return false;
+  }
+  return true;
+}
+
+/// Test if a value of the type of the scores is the MatMul of the queries and
+/// the keys, or its Div or Mul by a scale.
+bool isScaledScores(Value value, RankedTensorType scoresType) {
+  if (value.getType() != scoresType)
+    return false;
+  Operation *op = value.getDefiningOp();
+  if (isa_and_nonnull<ONNXDivOp, ONNXMulOp>(op))
+    return llvm::any_of(op->getOperands(), [](Value operand) {
+      return operand.getDefiningOp<ONNXMatMulOp>();
+    });
+  return isa_and_nonnull<ONNXMatMulOp>(op);
+}
+
+/// Replace the attention computation ending with a MatMul of the attention
+/// probabilities and the values with a single ONNXFusedAttentionOp.
+void fuseAttention(ONNXMatMulOp outputMatMul) {
+  auto softmaxOp = outputMatMul.A().getDefiningOp<ONNXSoftmaxOp>();
+  if (!softmaxOp || !softmaxOp.getResult().hasOneUse())
+    return;
+  Value scores = softmaxOp.input();
+  auto scoresType = scores.getType().dyn_cast<RankedTensorType>();
+  if (!scoresType || !isStaticMatrixBatch(scores))
+    return;
+  int64_t rank = scoresType.getRank();
+  int64_t axis = softmaxOp.axis();
+  if (axis != -1 && axis != rank - 1)
+    return;
+
+  // Walk up the operations producing the scores from the MatMul of the
+  // queries and the keys, each used only by the next one.
+  SmallVector<Operation *, 4> fusedOps = {outputMatMul, softmaxOp};
+  Value mask;
+  if (auto addOp = scores.getDefiningOp<ONNXAddOp>()) {
+    // The mask is the operand of the Add which is not the scaled scores.
+    Value lhs = addOp.A(), rhs = addOp.B();
+    bool lhsIsScores = isScaledScores(lhs, scoresType);
+    Value other = lhsIsScores ? rhs : lhs;
+    if (!isBroadcastableMask(other, scoresType) ||
+        !addOp.getResult().hasOneUse())
+      return;
+    mask = other;
+    scores = lhsIsScores ? lhs : rhs;
+    fusedOps.emplace_back(addOp);
+  }
+
+  double scale = 1.0;
+  Operation *scaleOp = scores.getDefiningOp();
+  if (auto divOp = dyn_cast_or_null<ONNXDivOp>(scaleOp)) {
+    double divisor;
+    if (!getScalarConstant(divOp.B(), divisor) || divisor == 0.0)
+      return;
+    scale = 1.0 / divisor;
+    scores = divOp.A();
+  } else if (auto mulOp = dyn_cast_or_null<ONNXMulOp>(scaleOp)) {
+    if (getScalarConstant(mulOp.B(), scale))
+      scores = mulOp.A();
+    else if (getScalarConstant(mulOp.A(), scale))
+      scores = mulOp.B();
+    else
+      return;
+  } else {
+    scaleOp = nullptr;
+  }
+  if (scaleOp) {
+    if (!scaleOp->getResult(0).hasOneUse())
+      return;
+    fusedOps.emplace_back(scaleOp);
+  }
+
+  auto scoresMatMul = scores.getDefiningOp<ONNXMatMulOp>();
+  if (!scoresMatMul || scores.getType() != scoresType ||
+      !scores.hasOneUse())
+    return;
+  fusedOps.emplace_back(scoresMatMul);
+
+  // The queries, keys and values are batches of matrices with the same outer
+  // dimensions, the MatMuls do not broadcast.
+  Value queries = scoresMatMul.A(), keys = scoresMatMul.B();
+  Value values = outputMatMul.B();
+  Value result = outputMatMul.getResult();
+  if (!isStaticMatrixBatch(queries) || !isStaticMatrixBatch(keys) ||
+      !isStaticMatrixBatch(values) || !isStaticMatrixBatch(result))
+    return;
+  auto outerShape = [&](Value value) {
+    return value.getType().cast<ShapedType>().getShape().drop_back(2);
+  };
+  for (Value value : {queries, keys, values, result})
+    if (value.getType().cast<ShapedType>().getRank() != rank ||
+        outerShape(value) != outerShape(scores))
+      return;
+
+  OpBuilder builder(outputMatMul);
+  if (!mask)
+    mask = builder.create<ConstantOp>(
+        outputMatMul.getLoc(), builder.getUnitAttr());
+  auto fusedOp = builder.create<ONNXFusedAttentionOp>(outputMatMul.getLoc(),
+      ArrayRef<Type>{result.getType()},
+      ValueRange{queries, keys, values, mask},
+      ArrayRef<NamedAttribute>{});
+  fusedOp.setAttr("scale", builder.getF32FloatAttr(scale));
+
+  result.replaceAllUsesWith(fusedOp.getResult());
+  for (Operation *op : fusedOps)
+    op->erase();
+}
+
+/*!
+ *  Function pass that fuses scaled dot-product attentions.
+ */
+class AttentionFusionPass
+    : public PassWrapper<AttentionFusionPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    auto function = getFunction();
+
+    SmallVector<ONNXMatMulOp, 8> matMulOps;
+    function.walk(
+        [&](ONNXMatMulOp matMulOp) { matMulOps.emplace_back(matMulOp); });
+    // The operations erased by a fusion come before the MatMul ending the
+    // attention, and have already been visited.
+    for (auto matMulOp : matMulOps)
+      fuseAttention(matMulOp);
+  }
+};
+} // end anonymous namespace
+
+/*!
+ * Create an attention fusion pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createAttentionFusionPass() {
+  return std::make_unique<AttentionFusionPass>();
+}
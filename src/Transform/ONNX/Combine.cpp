@@ -13,7 +13,11 @@
 #include "mlir/IR/PatternMatch.h"
 
 #include "src/Dialect/ONNX/ONNXOps.hpp"
+#include <cmath>
+#include <map>
 #include <numeric>
+#include <set>
+#include <type_traits>
 
 using namespace mlir;
 
@@ -58,6 +62,530 @@ bool IsIdentityPermuteVector(ArrayAttr permAttr) {
 
 /// Include the patterns defined in the Declarative Rewrite framework.
 #include "src/Transform/ONNX/ONNXCombine.inc"
+
+//===----------------------------------------------------------------------===//
+// Support for transformer subgraph patterns.
+//===----------------------------------------------------------------------===//
+
+/// Test if a value is a scalar floating-point constant close to the expected
+/// value. Exported models round the constants of Gelu and friends
+/// differently, so the comparison uses a relative tolerance.
+bool isConstantNear(Value value, double expected) {
+  auto constOp = value.getDefiningOp<ONNXConstantOp>();
+  if (!constOp || !constOp.value().hasValue())
+    return false;
+  auto dense = constOp.valueAttr().dyn_cast<DenseElementsAttr>();
+  if (!dense || !dense.isSplat() || dense.getType().getNumElements() != 1)
+    return false;
+  auto splat = dense.getSplatValue().dyn_cast<FloatAttr>();
+  if (!splat)
+    return false;
+  return std::abs(splat.getValueAsDouble() - expected) <=
+         1e-4 * std::abs(expected);
+}
+
+/// Return the operation defining a value if it has the given type and the
+/// value is used only once.
+template <typename OP>
+OP getSingleUseDefiningOp(Value value) {
+  if (!value.hasOneUse())
+    return OP();
+  return value.getDefiningOp<OP>();
+}
+
+/// Match a binary operation one of whose operands is a constant close to the
+/// expected value, and return the other operand.
+template <typename OP>
+bool matchConstantOperand(OP op, double expected, Value &other) {
+  if (isConstantNear(op.B(), expected)) {
+    other = op.A();
+    return true;
+  }
+  if (isConstantNear(op.A(), expected)) {
+    other = op.B();
+    return true;
+  }
+  return false;
+}
+
+/// Collect the factors of a Mul and of its single-use Mul operands.
+void collectMulFactors(ONNXMulOp mulOp, SmallVectorImpl<Value> &factors) {
+  for (Value operand : mulOp.getOperands()) {
+    if (auto innerMulOp = getSingleUseDefiningOp<ONNXMulOp>(operand))
+      factors.append(
+          innerMulOp.getOperands().begin(), innerMulOp.getOperands().end());
+    else
+      factors.emplace_back(operand);
+  }
+}
+
+/// Match the Gelu product 'x * 0.5 * term', in any order and association,
+/// with a term matched by the given function. Returns the input x.
+template <typename TermMatcher>
+Value matchGeluProduct(ONNXMulOp mulOp, TermMatcher matchTerm) {
+  SmallVector<Value, 4> factors;
+  collectMulFactors(mulOp, factors);
+  if (factors.size() != 3)
+    return Value();
+  for (unsigned half = 0; half < 3; ++half) {
+    if (!isConstantNear(factors[half], 0.5))
+      continue;
+    for (unsigned term = 0; term < 3; ++term) {
+      if (term == half)
+        continue;
+      Value input = factors[3 - half - term];
+      Value termInput = matchTerm(factors[term]);
+      if (termInput && termInput == input &&
+          input.getType() == mulOp.getType() &&
+          mulOp.getType().cast<ShapedType>().getElementType().isa<FloatType>())
+        return input;
+    }
+  }
+  return Value();
+}
+
+/// Match '1 + erf(x / sqrt(2))', with the division possibly written as a
+/// multiplication by 1 / sqrt(2). Returns x.
+Value matchErfTerm(Value value) {
+  auto addOp = getSingleUseDefiningOp<ONNXAddOp>(value);
+  Value erfValue, scaled, input;
+  if (!addOp || !matchConstantOperand(addOp, 1.0, erfValue))
+    return Value();
+  auto erfOp = getSingleUseDefiningOp<ONNXErfOp>(erfValue);
+  if (!erfOp)
+    return Value();
+  scaled = erfOp.input();
+  if (auto divOp = getSingleUseDefiningOp<ONNXDivOp>(scaled)) {
+    if (isConstantNear(divOp.B(), 1.41421356))
+      return divOp.A();
+  } else if (auto mulOp = getSingleUseDefiningOp<ONNXMulOp>(scaled)) {
+    if (matchConstantOperand(mulOp, 0.70710678, input))
+      return input;
+  }
+  return Value();
+}
+
+/// Match 'x^3', written as a Pow or as two Muls.
+bool matchCube(Value value, Value input) {
+  if (auto powOp = getSingleUseDefiningOp<ONNXPowOp>(value))
+    return powOp.X() == input && isConstantNear(powOp.Y(), 3.0);
+  auto mulOp = getSingleUseDefiningOp<ONNXMulOp>(value);
+  if (!mulOp)
+    return false;
+  auto isSquare = [&](Value square) {
+    auto squareOp = getSingleUseDefiningOp<ONNXMulOp>(square);
+    return squareOp && squareOp.A() == input && squareOp.B() == input;
+  };
+  return (mulOp.A() == input && isSquare(mulOp.B())) ||
+         (mulOp.B() == input && isSquare(mulOp.A()));
+}
+
+/// Match '1 + tanh(sqrt(2 / pi) * (x + 0.044715 * x^3))'. Returns x.
+Value matchTanhTerm(Value value) {
+  auto addOp = getSingleUseDefiningOp<ONNXAddOp>(value);
+  Value tanhValue, scaled, inner, cube;
+  if (!addOp || !matchConstantOperand(addOp, 1.0, tanhValue))
+    return Value();
+  auto tanhOp = getSingleUseDefiningOp<ONNXTanhOp>(tanhValue);
+  if (!tanhOp)
+    return Value();
+  auto scaleOp = getSingleUseDefiningOp<ONNXMulOp>(tanhOp.input());
+  if (!scaleOp || !matchConstantOperand(scaleOp, 0.7978845608, inner))
+    return Value();
+  auto innerOp = getSingleUseDefiningOp<ONNXAddOp>(inner);
+  if (!innerOp)
+    return Value();
+  for (unsigned i = 0; i < 2; ++i) {
+    Value input = innerOp.getOperand(i);
+    auto cubeOp = getSingleUseDefiningOp<ONNXMulOp>(innerOp.getOperand(1 - i));
+    if (cubeOp && matchConstantOperand(cubeOp, 0.044715, cube) &&
+        matchCube(cube, input))
+      return input;
+  }
+  return Value();
+}
+
+/// Test if a ReduceMean reduces only the innermost dimension of its input of
+/// the given rank and keeps it.
+bool reducesInnermost(ONNXReduceMeanOp reduceOp, int64_t rank) {
+  if (reduceOp.keepdims() != 1 || !reduceOp.axes().hasValue())
+    return false;
+  ArrayAttr axes = reduceOp.axesAttr();
+  if (axes.size() != 1)
+    return false;
+  int64_t axis = axes[0].cast<IntegerAttr>().getInt();
+  return axis == -1 || axis == rank - 1;
+}
+
+//===----------------------------------------------------------------------===//
+// Transformer subgraph patterns.
+//===----------------------------------------------------------------------===//
+
+/// Replace 'x * 0.5 * (1 + erf(x / sqrt(2)))' with onnx.Gelu.
+class GeluPattern : public OpRewritePattern<ONNXMulOp> {
+public:
+  using OpRewritePattern<ONNXMulOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(
+      ONNXMulOp mulOp, PatternRewriter &rewriter) const override {
+    Value input = matchGeluProduct(mulOp, matchErfTerm);
+    if (!input)
+      return failure();
+    rewriter.replaceOpWithNewOp<ONNXGeluOp>(mulOp, mulOp.getType(), input);
+    return success();
+  }
+};
+
+/// Replace 'x * 0.5 * (1 + tanh(sqrt(2 / pi) * (x + 0.044715 * x^3)))' with
+/// onnx.FastGelu.
+class FastGeluPattern : public OpRewritePattern<ONNXMulOp> {
+public:
+  using OpRewritePattern<ONNXMulOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(
+      ONNXMulOp mulOp, PatternRewriter &rewriter) const override {
+    Value input = matchGeluProduct(mulOp, matchTanhTerm);
+    if (!input)
+      return failure();
+    rewriter.replaceOpWithNewOp<ONNXFastGeluOp>(
+        mulOp, mulOp.getType(), input);
+    return success();
+  }
+};
+
+/// Replace the layer normalization over the innermost dimension
+///
+///   d = x - ReduceMean(x), var = ReduceMean(d * d)
+///   y = d / sqrt(var + epsilon) * scale + bias
+///
+/// with onnx.LayerNormalization. The square may also be written as Pow(d, 2).
+class LayerNormPattern : public OpRewritePattern<ONNXAddOp> {
+public:
+  using OpRewritePattern<ONNXAddOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(
+      ONNXAddOp addOp, PatternRewriter &rewriter) const override {
+    for (unsigned i = 0; i < 2; ++i) {
+      auto scaleOp = getSingleUseDefiningOp<ONNXMulOp>(addOp.getOperand(i));
+      if (!scaleOp)
+        continue;
+      for (unsigned j = 0; j < 2; ++j) {
+        auto divOp = getSingleUseDefiningOp<ONNXDivOp>(scaleOp.getOperand(j));
+        if (!divOp)
+          continue;
+        float epsilon;
+        Value input = matchNormalization(divOp, epsilon);
+        Value scale = scaleOp.getOperand(1 - j);
+        Value bias = addOp.getOperand(1 - i);
+        if (!input || input.getType() != addOp.getType() ||
+            !isInnermostVector(scale, input) || !isInnermostVector(bias, input))
+          continue;
+        auto layerNormOp = rewriter.create<ONNXLayerNormalizationOp>(
+            addOp.getLoc(), addOp.getType(), input, scale, bias,
+            rewriter.getF32FloatAttr(epsilon));
+        rewriter.replaceOp(addOp, layerNormOp.getResult());
+        return success();
+      }
+    }
+    return failure();
+  }
+
+private:
+  /// Match 'd / sqrt(var + epsilon)' and return the normalized input x.
+  static Value matchNormalization(ONNXDivOp divOp, float &epsilon) {
+    auto subOp = divOp.A().getDefiningOp<ONNXSubOp>();
+    auto sqrtOp = getSingleUseDefiningOp<ONNXSqrtOp>(divOp.B());
+    if (!subOp || !sqrtOp)
+      return Value();
+    Value input = subOp.A();
+    auto inputType = input.getType().dyn_cast<RankedTensorType>();
+    if (!inputType || inputType.getRank() == 0 ||
+        !inputType.getElementType().isa<FloatType>())
+      return Value();
+    int64_t rank = inputType.getRank();
+
+    // The mean of the input along the innermost dimension.
+    auto meanOp = subOp.B().getDefiningOp<ONNXReduceMeanOp>();
+    if (!meanOp || meanOp.data() != input || !reducesInnermost(meanOp, rank))
+      return Value();
+
+    // The variance of the centered input, plus epsilon.
+    auto epsOp = getSingleUseDefiningOp<ONNXAddOp>(sqrtOp.X());
+    if (!epsOp)
+      return Value();
+    for (unsigned i = 0; i < 2; ++i) {
+      auto varOp = getSingleUseDefiningOp<ONNXReduceMeanOp>(
+          epsOp.getOperand(i));
+      auto epsConstOp = epsOp.getOperand(1 - i).getDefiningOp<ONNXConstantOp>();
+      if (!varOp || !epsConstOp || !reducesInnermost(varOp, rank) ||
+          !isSquare(varOp.data(), subOp.getResult()))
+        continue;
+      auto dense = epsConstOp.valueAttr().dyn_cast_or_null<DenseElementsAttr>();
+      if (!dense || !dense.isSplat() || dense.getType().getNumElements() != 1)
+        continue;
+      auto splat = dense.getSplatValue().dyn_cast<FloatAttr>();
+      if (!splat)
+        continue;
+      epsilon = splat.getValueAsDouble();
+      return input;
+    }
+    return Value();
+  }
+
+  /// Test if a value is 'd * d' or 'Pow(d, 2)'.
+  static bool isSquare(Value value, Value centered) {
+    if (auto powOp = getSingleUseDefiningOp<ONNXPowOp>(value))
+      return powOp.X() == centered && isConstantNear(powOp.Y(), 2.0);
+    auto mulOp = getSingleUseDefiningOp<ONNXMulOp>(value);
+    return mulOp && mulOp.A() == centered && mulOp.B() == centered;
+  }
+
+  /// Test if a value is a 1-D tensor of the static size of the innermost
+  /// dimension of the input.
+  static bool isInnermostVector(Value value, Value input) {
+    auto type = value.getType().dyn_cast<RankedTensorType>();
+    auto inputType = input.getType().cast<RankedTensorType>();
+    int64_t innermost = inputType.getShape().back();
+    return type && type.getRank() == 1 && innermost > 0 &&
+           type.getShape()[0] == innermost &&
+           type.getElementType() == inputType.getElementType();
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// Embedding lookup patterns.
+//===----------------------------------------------------------------------===//
+
+/// Replace the reduction over the bag axis of a Gather of table rows
+///
+///   y = ReduceSum(Gather(table, indices, axis=0), axes=[rank(indices) - 1])
+///
+/// with onnx.EmbeddingBag, and likewise for ReduceMean, so that the rows are
+/// accumulated without materializing the gathered [..., bag, dim] tensor.
+template <typename REDUCE_OP>
+class EmbeddingBagPattern : public OpRewritePattern<REDUCE_OP> {
+public:
+  using OpRewritePattern<REDUCE_OP>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(
+      REDUCE_OP reduceOp, PatternRewriter &rewriter) const override {
+    auto gatherOp = getSingleUseDefiningOp<ONNXGatherOp>(reduceOp.data());
+    if (!gatherOp || gatherOp.axis() != 0 || !reduceOp.axes().hasValue())
+      return failure();
+    auto dataType = gatherOp.data().getType().dyn_cast<RankedTensorType>();
+    auto indicesType =
+        gatherOp.indices().getType().dyn_cast<RankedTensorType>();
+    if (!dataType || !indicesType || !dataType.hasStaticShape() ||
+        !indicesType.hasStaticShape() || dataType.getRank() == 0 ||
+        indicesType.getRank() == 0)
+      return failure();
+    // The rows are accumulated in the element type.
+    Type elementType = dataType.getElementType();
+    if (!elementType.isF32() && !elementType.isF64())
+      return failure();
+
+    // The only reduced axis is the innermost dimension of the indices.
+    ArrayAttr axes = reduceOp.axesAttr();
+    int64_t bagAxis = indicesType.getRank() - 1;
+    int64_t gatheredRank = bagAxis + dataType.getRank();
+    if (axes.size() != 1)
+      return failure();
+    int64_t axis = axes[0].cast<IntegerAttr>().getInt();
+    if (axis < 0)
+      axis += gatheredRank;
+    if (axis != bagAxis)
+      return failure();
+
+    StringRef mode =
+        std::is_same<REDUCE_OP, ONNXReduceMeanOp>::value ? "mean" : "sum";
+    rewriter.replaceOpWithNewOp<ONNXEmbeddingBagOp>(reduceOp,
+        reduceOp.getType(), gatherOp.data(), gatherOp.indices(),
+        rewriter.getStringAttr(mode), reduceOp.keepdimsAttr());
+    return success();
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// Einsum patterns.
+//===----------------------------------------------------------------------===//
+
+/// Replace an Einsum of one or two inputs of static shapes with ReduceSum,
+/// Transpose, Reshape and MatMul operations. The labels of an input missing
+/// from the output and from the other input are summed over first. The labels
+/// of two inputs are then ordered as batch, free and contracted labels, so
+/// that their product is a batched MatMul of
+///
+///   [batch..., M, K] x [batch..., K, N] -> [batch..., M, N]
+///
+/// where M, N and K are the products of the dimensions of the free labels of
+/// the first and second input and of the contracted labels. The result is
+/// reshaped and transposed to the output labels. Diagonals, i.e. labels
+/// repeated in a term, are not supported.
+class EinsumPattern : public OpRewritePattern<ONNXEinsumOp> {
+public:
+  using OpRewritePattern<ONNXEinsumOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(
+      ONNXEinsumOp einsumOp, PatternRewriter &rewriter) const override {
+    SmallVector<std::string, 2> labels;
+    std::string outputLabels;
+    if (einsumOp.getNumOperands() < 1 || einsumOp.getNumOperands() > 2 ||
+        failed(einsumOp.parseEquation(labels, outputLabels)))
+      return failure();
+    auto outputType = einsumOp.getType().dyn_cast<RankedTensorType>();
+    if (!outputType || !outputType.hasStaticShape())
+      return failure();
+    Type elementType = outputType.getElementType();
+    std::map<char, int64_t> dims;
+    for (auto input : llvm::enumerate(einsumOp.Inputs())) {
+      auto type = input.value().getType().dyn_cast<RankedTensorType>();
+      const std::string &term = labels[input.index()];
+      if (!type || !type.hasStaticShape() ||
+          type.getElementType() != elementType ||
+          (size_t)type.getRank() != term.size() ||
+          std::set<char>(term.begin(), term.end()).size() != term.size())
+        return failure();
+      for (unsigned i = 0; i < term.size(); ++i) {
+        auto it = dims.find(term[i]);
+        if (it != dims.end() && it->second != type.getShape()[i])
+          return failure();
+        dims[term[i]] = type.getShape()[i];
+      }
+    }
+    if (ArrayRef<int64_t>(getDims(outputLabels, dims)) !=
+        outputType.getShape())
+      return failure();
+
+    Location loc = einsumOp.getLoc();
+    auto has = [](StringRef term, char label) { return term.contains(label); };
+    Value result;
+    if (einsumOp.getNumOperands() == 1) {
+      std::string &term = labels[0];
+      result = reduce(rewriter, loc, einsumOp.getOperand(0), term, dims,
+          [&](char label) { return has(outputLabels, label); });
+      result = transpose(rewriter, loc, result, term, outputLabels, dims);
+    } else {
+      std::string &lhsTerm = labels[0], &rhsTerm = labels[1];
+      std::string lhsLabels = lhsTerm, rhsLabels = rhsTerm;
+      Value lhs = reduce(rewriter, loc, einsumOp.getOperand(0), lhsTerm, dims,
+          [&](char label) {
+            return has(outputLabels, label) || has(rhsLabels, label);
+          });
+      Value rhs = reduce(rewriter, loc, einsumOp.getOperand(1), rhsTerm, dims,
+          [&](char label) {
+            return has(outputLabels, label) || has(lhsLabels, label);
+          });
+
+      std::string batch, lhsFree, rhsFree, contracted;
+      for (char label : outputLabels) {
+        if (has(lhsTerm, label) && has(rhsTerm, label))
+          batch.push_back(label);
+        else if (has(lhsTerm, label))
+          lhsFree.push_back(label);
+        else
+          rhsFree.push_back(label);
+      }
+      for (char label : lhsTerm)
+        if (has(rhsTerm, label) && !has(outputLabels, label))
+          contracted.push_back(label);
+      lhs = transpose(rewriter, loc, lhs, lhsTerm, batch + lhsFree + contracted,
+          dims);
+      rhs = transpose(rewriter, loc, rhs, rhsTerm, batch + contracted + rhsFree,
+          dims);
+
+      SmallVector<int64_t, 4> batchDims = getDims(batch, dims);
+      int64_t m = getSize(lhsFree, dims);
+      int64_t n = getSize(rhsFree, dims);
+      int64_t k = getSize(contracted, dims);
+      auto matrixDims = [&](int64_t rows, int64_t cols) {
+        SmallVector<int64_t, 4> shape(batchDims);
+        shape.emplace_back(rows);
+        shape.emplace_back(cols);
+        return shape;
+      };
+      lhs = reshape(rewriter, loc, lhs, matrixDims(m, k));
+      rhs = reshape(rewriter, loc, rhs, matrixDims(k, n));
+      result = rewriter.create<ONNXMatMulOp>(loc,
+          RankedTensorType::get(matrixDims(m, n), elementType), lhs, rhs);
+
+      std::string resultTerm = batch + lhsFree + rhsFree;
+      result = reshape(rewriter, loc, result, getDims(resultTerm, dims));
+      result = transpose(rewriter, loc, result, resultTerm, outputLabels, dims);
+    }
+    rewriter.replaceOp(einsumOp, result);
+    return success();
+  }
+
+private:
+  static SmallVector<int64_t, 4> getDims(
+      StringRef term, const std::map<char, int64_t> &dims) {
+    SmallVector<int64_t, 4> shape;
+    for (char label : term)
+      shape.emplace_back(dims.at(label));
+    return shape;
+  }
+
+  static int64_t getSize(StringRef term, const std::map<char, int64_t> &dims) {
+    int64_t size = 1;
+    for (char label : term)
+      size *= dims.at(label);
+    return size;
+  }
+
+  static RankedTensorType getType(Value value, ArrayRef<int64_t> shape) {
+    return RankedTensorType::get(
+        shape, value.getType().cast<ShapedType>().getElementType());
+  }
+
+  /// Sum a value over the dimensions whose label is not kept, and remove
+  /// their labels from the term.
+  template <typename KEEP>
+  static Value reduce(PatternRewriter &rewriter, Location loc, Value value,
+      std::string &term, const std::map<char, int64_t> &dims, KEEP keep) {
+    SmallVector<int64_t, 4> axes;
+    std::string keptTerm;
+    for (unsigned i = 0; i < term.size(); ++i) {
+      if (keep(term[i]))
+        keptTerm.push_back(term[i]);
+      else
+        axes.emplace_back(i);
+    }
+    if (axes.empty())
+      return value;
+    term = keptTerm;
+    return rewriter.create<ONNXReduceSumOp>(loc,
+        getType(value, getDims(term, dims)), value,
+        rewriter.getI64ArrayAttr(axes),
+        IntegerAttr::get(rewriter.getIntegerType(64, /*isSigned=*/true),
+            APInt(64, 0, /*isSigned=*/true)));
+  }
+
+  /// Transpose a value from the labels of its dimensions to the target ones.
+  static Value transpose(PatternRewriter &rewriter, Location loc, Value value,
+      StringRef term, StringRef target, const std::map<char, int64_t> &dims) {
+    if (term == target)
+      return value;
+    SmallVector<int64_t, 4> perm;
+    for (char label : target)
+      perm.emplace_back(term.find(label));
+    return rewriter.create<ONNXTransposeOp>(loc,
+        getType(value, getDims(target, dims)), value,
+        rewriter.getI64ArrayAttr(perm));
+  }
+
+  /// Reshape a value of static shape to another shape.
+  static Value reshape(PatternRewriter &rewriter, Location loc, Value value,
+      ArrayRef<int64_t> shape) {
+    if (value.getType().cast<ShapedType>().getShape() == shape)
+      return value;
+    auto shapeType =
+        RankedTensorType::get({(int64_t)shape.size()}, rewriter.getI64Type());
+    Value shapeConst = rewriter.create<ONNXConstantOp>(loc, shapeType,
+        /*sparse_value=*/nullptr, DenseElementsAttr::get(shapeType, shape));
+    return rewriter.create<ONNXReshapeOp>(
+        loc, getType(value, shape), value, shapeConst);
+  }
+};
 } // end anonymous namespace
 
 /// Register optimization patterns as "canonicalization" patterns
@@ -65,6 +593,14 @@ bool IsIdentityPermuteVector(ArrayAttr permAttr) {
 void ONNXAddOp::getCanonicalizationPatterns(
     OwningRewritePatternList &results, MLIRContext *context) {
   results.insert<MulAddToGemmOptPattern>(context);
+  results.insert<LayerNormPattern>(context);
+}
+
+/// on the ONNXMulOp.
+void ONNXMulOp::getCanonicalizationPatterns(
+    OwningRewritePatternList &results, MLIRContext *context) {
+  results.insert<GeluPattern>(context);
+  results.insert<FastGeluPattern>(context);
 }
 
 void ONNXGemmOp::getCanonicalizationPatterns(
@@ -101,3 +637,21 @@ void ONNXDropoutOp::getCanonicalizationPatterns(
     OwningRewritePatternList &result, MLIRContext *context) {
   result.insert<DropoutEliminationPattern>(context);
 }
+
+/// on the ONNXReduceSumOp.
+void ONNXReduceSumOp::getCanonicalizationPatterns(
+    OwningRewritePatternList &result, MLIRContext *context) {
+  result.insert<EmbeddingBagPattern<ONNXReduceSumOp>>(context);
+}
+
+/// on the ONNXReduceMeanOp.
+void ONNXReduceMeanOp::getCanonicalizationPatterns(
+    OwningRewritePatternList &result, MLIRContext *context) {
+  result.insert<EmbeddingBagPattern<ONNXReduceMeanOp>>(context);
+}
+
+/// on the ONNXEinsumOp.
+void ONNXEinsumOp::getCanonicalizationPatterns(
+    OwningRewritePatternList &result, MLIRContext *context) {
+  result.insert<EinsumPattern>(context);
+}
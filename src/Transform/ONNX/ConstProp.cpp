@@ -11,16 +11,28 @@
 // implement shape inference for the constpropd operation. Hence, it is expected
 // that there is no knowledge about tensor shape at this point
 //
+// A second pass applies the same rewriters, together with the folding of the
+// Shape and Size of static tensors, after shape inference. Since ops whose
+// inferred result types have dynamic dimensions are not inferred again by the
+// shape inference pass, it also infers the shapes of these ops again once
+// their operands are folded, e.g. the Reshape of
+//
+//   Shape -> Gather -> Concat -> Reshape
+//
+// until the inferred shapes no longer change.
+//
 //===----------------------------------------------------------------------===//
 
 #include "mlir/IR/Matchers.h"
 #include "mlir/IR/PatternMatch.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
+#include "llvm/Support/Parallel.h"
 
 #include "src/Dialect/ONNX/ONNXOps.hpp"
 #include "src/Pass/Passes.hpp"
 
+#include <cstring>
 #include <math.h>
 
 using namespace mlir;
@@ -44,10 +56,283 @@ namespace {
 // ComputeConstPropElementwiseBinary and ComputeConstPropElementwiseUnary
 // and they need to be tempalted wtih an ONNX Operation (presuably).
 //
+// Most element types are computed on raw data instead, for which you also have
+// to specialize ConstPropElementwiseBinaryValue or
+// ConstPropElementwiseUnaryValue with a method computing the result on C++
+// values.
+//
 // Then you need to add rules on how to transform the patterns; look into
 // ConstProp.td for example.
 //
 
+//===----------------------------------------------------------------------===//
+// Code to perform constant propagation on raw data.
+//===----------------------------------------------------------------------===//
+// Elements of a type that has a C++ equivalent are computed directly on the
+// raw data of the dense attributes, without building an attribute per
+// element, by chunks of rows of the result processed in parallel. The other
+// element types (f16, bf16, i1) go through the attribute-based code below.
+
+// Number of elements of the result computed by a parallel task.
+const int64_t kConstPropChunkSize = 1 << 16;
+
+// Call `fn` with a value of the C++ type of the given element type. Return
+// false if the element type has no C++ equivalent.
+template <typename FnTy>
+bool dispatchOnElementType(Type elementType, FnTy fn) {
+  if (elementType.isF32()) {
+    fn(float());
+    return true;
+  }
+  if (elementType.isF64()) {
+    fn(double());
+    return true;
+  }
+  if (auto intType = elementType.dyn_cast<IntegerType>()) {
+    bool isUnsigned = intType.isUnsigned();
+    switch (intType.getWidth()) {
+    case 8:
+      isUnsigned ? fn(uint8_t()) : fn(int8_t());
+      return true;
+    case 16:
+      isUnsigned ? fn(uint16_t()) : fn(int16_t());
+      return true;
+    case 32:
+      isUnsigned ? fn(uint32_t()) : fn(int32_t());
+      return true;
+    case 64:
+      isUnsigned ? fn(uint64_t()) : fn(int64_t());
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T>
+T loadRawElement(ArrayRef<char> rawData, int64_t index) {
+  T value;
+  std::memcpy(&value, rawData.data() + index * sizeof(T), sizeof(T));
+  return value;
+}
+
+template <typename T>
+void storeRawElement(std::vector<char> &rawData, int64_t index, T value) {
+  std::memcpy(rawData.data() + index * sizeof(T), &value, sizeof(T));
+}
+
+// Call `fn(rowBegin, rowEnd)` on chunks of the `numRows` rows of `rowSize`
+// elements of a result, in parallel when there is more than one chunk.
+void parallelForRows(int64_t numRows, int64_t rowSize,
+    llvm::function_ref<void(int64_t, int64_t)> fn) {
+  int64_t rowsPerChunk =
+      std::max<int64_t>(1, kConstPropChunkSize / std::max<int64_t>(1, rowSize));
+  int64_t numChunks = (numRows + rowsPerChunk - 1) / rowsPerChunk;
+  if (numChunks <= 1) {
+    fn(0, numRows);
+    return;
+  }
+  llvm::parallelForEachN(0, numChunks, [&](size_t chunk) {
+    int64_t rowBegin = chunk * rowsPerChunk;
+    fn(rowBegin, std::min(numRows, rowBegin + rowsPerChunk));
+  });
+}
+
+// Get the strides of an operand along the dimensions of the result it is
+// broadcast to. Broadcast dimensions, and all the dimensions of a splat, have
+// a zero stride.
+SmallVector<int64_t, 4> getBroadcastStrides(
+    DenseElementsAttr attr, ArrayRef<int64_t> resShape) {
+  int64_t resRank = resShape.size();
+  SmallVector<int64_t, 4> strides(resRank, 0);
+  if (attr.isSplat())
+    return strides;
+  auto shape = attr.getType().getShape();
+  int64_t rank = shape.size();
+  int64_t stride = 1;
+  for (int64_t i = rank - 1; i >= 0; --i) {
+    strides[resRank - rank + i] = (shape[i] == 1) ? 0 : stride;
+    stride *= shape[i];
+  }
+  return strides;
+}
+
+// Get the offset in an operand of the first element of a row of the result,
+// given the strides of the operand along the dimensions of the result.
+int64_t getRowOffset(
+    int64_t row, ArrayRef<int64_t> resShape, ArrayRef<int64_t> strides) {
+  int64_t offset = 0;
+  for (int64_t i = (int64_t)resShape.size() - 2; i >= 0; --i) {
+    offset += (row % resShape[i]) * strides[i];
+    row /= resShape[i];
+  }
+  return offset;
+}
+
+// Computation of the binary operations on the C++ types of their elements.
+template <typename OP>
+struct ConstPropElementwiseBinaryValue {
+  template <typename T>
+  static T compute(T lhs, T rhs) {
+    llvm_unreachable("unkonwn operation");
+  }
+};
+
+template <>
+struct ConstPropElementwiseBinaryValue<ONNXAddOp> {
+  template <typename T>
+  static T compute(T lhs, T rhs) {
+    return lhs + rhs;
+  }
+};
+
+template <>
+struct ConstPropElementwiseBinaryValue<ONNXSubOp> {
+  template <typename T>
+  static T compute(T lhs, T rhs) {
+    return lhs - rhs;
+  }
+};
+
+template <>
+struct ConstPropElementwiseBinaryValue<ONNXMulOp> {
+  template <typename T>
+  static T compute(T lhs, T rhs) {
+    return lhs * rhs;
+  }
+};
+
+template <>
+struct ConstPropElementwiseBinaryValue<ONNXDivOp> {
+  template <typename T>
+  static T compute(T lhs, T rhs) {
+    assert(rhs != 0 && "division by a zero");
+    return lhs / rhs;
+  }
+};
+
+// Computation of the unary operations on the C++ types of their elements.
+template <typename OP>
+struct ConstPropElementwiseUnaryValue {
+  template <typename T>
+  static T compute(T val) {
+    llvm_unreachable("unkonwn operation");
+  }
+};
+
+template <>
+struct ConstPropElementwiseUnaryValue<ONNXNegOp> {
+  template <typename T>
+  static T compute(T val) {
+    return -val;
+  }
+};
+
+template <>
+struct ConstPropElementwiseUnaryValue<ONNXSqrtOp> {
+  template <typename T>
+  static T compute(T val) {
+    return sqrt(val);
+  }
+};
+
+template <typename ElementwiseBinaryOp, typename T>
+DenseElementsAttr ConstPropElementwiseBinaryOnRawData(ShapedType resType,
+    DenseElementsAttr lhsAttr, DenseElementsAttr rhsAttr) {
+  using Impl = ConstPropElementwiseBinaryValue<ElementwiseBinaryOp>;
+  ArrayRef<char> lhsData = lhsAttr.getRawData();
+  ArrayRef<char> rhsData = rhsAttr.getRawData();
+  if (lhsAttr.isSplat() && rhsAttr.isSplat()) {
+    std::vector<char> resData(sizeof(T));
+    storeRawElement<T>(resData, 0,
+        Impl::compute(loadRawElement<T>(lhsData, 0),
+            loadRawElement<T>(rhsData, 0)));
+    return DenseElementsAttr::getFromRawBuffer(
+        resType, resData, /*isSplatBuffer=*/true);
+  }
+
+  auto resShape = resType.getShape();
+  int64_t rank = resShape.size();
+  auto lhsStrides = getBroadcastStrides(lhsAttr, resShape);
+  auto rhsStrides = getBroadcastStrides(rhsAttr, resShape);
+  int64_t lhsInnerStride = rank ? lhsStrides.back() : 0;
+  int64_t rhsInnerStride = rank ? rhsStrides.back() : 0;
+  int64_t rowSize = rank ? resShape.back() : 1;
+  int64_t numElements = resType.getNumElements();
+  int64_t numRows = rowSize ? numElements / rowSize : 0;
+
+  std::vector<char> resData(numElements * sizeof(T));
+  parallelForRows(numRows, rowSize, [&](int64_t rowBegin, int64_t rowEnd) {
+    for (int64_t row = rowBegin; row < rowEnd; ++row) {
+      int64_t lhsOffset = getRowOffset(row, resShape, lhsStrides);
+      int64_t rhsOffset = getRowOffset(row, resShape, rhsStrides);
+      for (int64_t i = 0; i < rowSize; ++i) {
+        T lhs = loadRawElement<T>(lhsData, lhsOffset + i * lhsInnerStride);
+        T rhs = loadRawElement<T>(rhsData, rhsOffset + i * rhsInnerStride);
+        storeRawElement<T>(
+            resData, row * rowSize + i, Impl::compute(lhs, rhs));
+      }
+    }
+  });
+  return DenseElementsAttr::getFromRawBuffer(
+      resType, resData, /*isSplatBuffer=*/false);
+}
+
+template <typename ElementwiseUnaryOp, typename T>
+DenseElementsAttr ConstPropElementwiseUnaryOnRawData(
+    ShapedType resType, DenseElementsAttr attr) {
+  using Impl = ConstPropElementwiseUnaryValue<ElementwiseUnaryOp>;
+  ArrayRef<char> data = attr.getRawData();
+  int64_t numElements = attr.isSplat() ? 1 : resType.getNumElements();
+  std::vector<char> resData(numElements * sizeof(T));
+  parallelForRows(numElements, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i)
+      storeRawElement<T>(
+          resData, i, Impl::compute(loadRawElement<T>(data, i)));
+  });
+  return DenseElementsAttr::getFromRawBuffer(
+      resType, resData, /*isSplatBuffer=*/attr.isSplat());
+}
+
+// Transpose the raw data of a dense attribute whose elements are stored on a
+// whole number of bytes. Return a null attribute otherwise.
+DenseElementsAttr ConstPropTransposeOnRawData(ShapedType resType,
+    DenseElementsAttr attr, ArrayRef<uint64_t> perm) {
+  if (attr.isSplat())
+    return attr.reshape(resType);
+  auto bitWidth = attr.getType().getElementTypeBitWidth();
+  if (bitWidth % 8 != 0)
+    return nullptr;
+  int64_t eltSize = bitWidth / 8;
+
+  // Strides of the input along the dimensions of the result.
+  auto shape = attr.getType().getShape();
+  int64_t rank = shape.size();
+  SmallVector<int64_t, 4> inputStrides(rank, 1), strides(rank, 0);
+  for (int64_t i = rank - 2; i >= 0; --i)
+    inputStrides[i] = inputStrides[i + 1] * shape[i + 1];
+  for (int64_t i = 0; i < rank; ++i)
+    strides[i] = inputStrides[perm[i]];
+
+  auto resShape = resType.getShape();
+  int64_t innerStride = rank ? strides.back() : 0;
+  int64_t rowSize = rank ? resShape.back() : 1;
+  int64_t numElements = resType.getNumElements();
+  int64_t numRows = rowSize ? numElements / rowSize : 0;
+
+  ArrayRef<char> data = attr.getRawData();
+  std::vector<char> resData(numElements * eltSize);
+  parallelForRows(numRows, rowSize, [&](int64_t rowBegin, int64_t rowEnd) {
+    for (int64_t row = rowBegin; row < rowEnd; ++row) {
+      int64_t offset = getRowOffset(row, resShape, strides);
+      for (int64_t i = 0; i < rowSize; ++i)
+        std::memcpy(resData.data() + (row * rowSize + i) * eltSize,
+            data.data() + (offset + i * innerStride) * eltSize, eltSize);
+    }
+  });
+  return DenseElementsAttr::getFromRawBuffer(
+      resType, resData, /*isSplatBuffer=*/false);
+}
+
 //===----------------------------------------------------------------------===//
 // Code to perform constant propagation for binary in presence of broadcast.
 //===----------------------------------------------------------------------===//
@@ -231,6 +516,12 @@ DenseElementsAttr ConstPropElementwiseBinary(PatternRewriter &rewriter,
   assert(
       resOperand.getType().isa<RankedTensorType>() && "expected ranked tensor");
   ShapedType resType = resOperand.getType().cast<RankedTensorType>();
+  DenseElementsAttr result;
+  if (dispatchOnElementType(resType.getElementType(), [&](auto zero) {
+        result = ConstPropElementwiseBinaryOnRawData<ElementwiseBinaryOp,
+            decltype(zero)>(resType, lhsDenseAttr, rhsDenseAttr);
+      }))
+    return result;
   auto lhsRank = lhsDenseAttr.getType().getShape().size();
   auto rhsRank = rhsDenseAttr.getType().getShape().size();
   SmallVector<uint64_t, 4> lhsIndices(lhsRank, 0);
@@ -315,6 +606,12 @@ DenseElementsAttr ConstPropElementwiseUnary(
   assert(
       resOperand.getType().isa<RankedTensorType>() && "expected ranked tensor");
   ShapedType resType = resOperand.getType().cast<RankedTensorType>();
+  DenseElementsAttr result;
+  if (dispatchOnElementType(resType.getElementType(), [&](auto zero) {
+        result = ConstPropElementwiseUnaryOnRawData<ElementwiseUnaryOp,
+            decltype(zero)>(resType, denseAttr);
+      }))
+    return result;
   auto rank = denseAttr.getType().getShape().size();
   SmallVector<uint64_t, 4> indices(rank, 0);
   std::vector<Attribute> resVector;
@@ -363,6 +660,8 @@ DenseElementsAttr ConstPropTranspose(PatternRewriter &rewriter,
   assert(permAttr && "permute attribute expected to be defined here");
   for (auto permVal : permAttr.getValue())
     perm.emplace_back(permVal.cast<IntegerAttr>().getInt());
+  if (auto result = ConstPropTransposeOnRawData(resType, denseAttr, perm))
+    return result;
   // Init indice vector.
   SmallVector<uint64_t, 4> indices(rank, 0);
   std::vector<Attribute> resVector;
@@ -374,10 +673,10 @@ DenseElementsAttr ConstPropTranspose(PatternRewriter &rewriter,
 }
 
 //===----------------------------------------------------------------------===//
-// Code to perform constant propagation for unsqueeze.
+// Code to perform constant propagation for unsqueeze and reshape.
 //===----------------------------------------------------------------------===//
 
-DenseElementsAttr ConstPropUnsqueeze(
+DenseElementsAttr ConstPropReshape(
     PatternRewriter &rewriter, Value resOperand, Attribute attr) {
   // Read dense attribute, the constant tensor we are transforming.
   DenseElementsAttr denseAttr =
@@ -385,14 +684,328 @@ DenseElementsAttr ConstPropUnsqueeze(
   assert(denseAttr && "expected dense attribute");
   ShapedType resType = resOperand.getType().cast<RankedTensorType>();
 
-  // Unqueeze does not change the order of access, so just copy the whole data.
+  // Reshape does not change the order of access, so just reshape the data.
+  return denseAttr.reshape(resType);
+}
+
+DenseElementsAttr ConstPropUnsqueeze(
+    PatternRewriter &rewriter, Value resOperand, Attribute attr) {
+  return ConstPropReshape(rewriter, resOperand, attr);
+}
+
+//===----------------------------------------------------------------------===//
+// Code to perform constant propagation for gather, slice and concat.
+//===----------------------------------------------------------------------===//
+// These operations only move elements around: the result is computed from the
+// list of the indices, in their inputs, of the elements of the result.
+
+// Get the dense value of a constant operation, or a null attribute if the
+// value is not defined by a constant or is sparse.
+DenseElementsAttr getDenseConstantValue(Value value) {
+  auto constOp = dyn_cast_or_null<ONNXConstantOp>(value.getDefiningOp());
+  if (!constOp || constOp.sparse_valueAttr())
+    return nullptr;
+  return constOp.valueAttr().dyn_cast_or_null<DenseElementsAttr>();
+}
+
+// Get the values of a constant tensor of integers.
+SmallVector<int64_t, 4> getIntegerValues(DenseElementsAttr attr) {
+  SmallVector<int64_t, 4> values;
+  for (auto value : attr.getValues<IntegerAttr>())
+    values.emplace_back(value.getInt());
+  return values;
+}
+
+// Get the strides of the elements of a dense attribute along its dimensions.
+SmallVector<int64_t, 4> getStrides(ArrayRef<int64_t> shape) {
+  int64_t rank = shape.size();
+  SmallVector<int64_t, 4> strides(rank, 1);
+  for (int64_t i = rank - 2; i >= 0; --i)
+    strides[i] = strides[i + 1] * shape[i + 1];
+  return strides;
+}
+
+// Create the dense attribute whose element i is the element `indices[i]` of
+// the concatenation of the elements of `attrs`, in row-major order.
+DenseElementsAttr ConstPropSelectElements(ShapedType resType,
+    ArrayRef<DenseElementsAttr> attrs, ArrayRef<int64_t> indices) {
+  // Offsets of the first element of each attribute in the concatenation.
+  SmallVector<int64_t, 4> offsets;
+  int64_t numElements = 0;
+  for (auto attr : attrs) {
+    offsets.emplace_back(numElements);
+    numElements += attr.getType().getNumElements();
+  }
+  auto locate = [&](int64_t index, int64_t &attrIndex, int64_t &eltIndex) {
+    attrIndex =
+        std::upper_bound(offsets.begin(), offsets.end(), index) -
+        offsets.begin() - 1;
+    eltIndex = attrs[attrIndex].isSplat() ? 0 : index - offsets[attrIndex];
+  };
+
+  // Elements stored on a whole number of bytes are copied as raw data.
+  unsigned bitWidth = resType.getElementTypeBitWidth();
+  if (bitWidth % 8 == 0) {
+    int64_t eltSize = bitWidth / 8;
+    std::vector<char> resData(indices.size() * eltSize);
+    parallelForRows(indices.size(), 1, [&](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        int64_t attrIndex, eltIndex;
+        locate(indices[i], attrIndex, eltIndex);
+        std::memcpy(resData.data() + i * eltSize,
+            attrs[attrIndex].getRawData().data() + eltIndex * eltSize,
+            eltSize);
+      }
+    });
+    return DenseElementsAttr::getFromRawBuffer(
+        resType, resData, /*isSplatBuffer=*/false);
+  }
+
+  std::vector<std::vector<Attribute>> values;
+  for (auto attr : attrs)
+    values.emplace_back(attr.getValues<Attribute>().begin(),
+        attr.getValues<Attribute>().end());
+  std::vector<Attribute> resVector;
+  for (int64_t index : indices) {
+    int64_t attrIndex, eltIndex;
+    locate(index, attrIndex, eltIndex);
+    resVector.emplace_back(values[attrIndex][eltIndex]);
+  }
+  return DenseElementsAttr::get(resType, llvm::makeArrayRef(resVector));
+}
+
+DenseElementsAttr ConstPropGather(PatternRewriter &rewriter,
+    Value resOperand, Attribute dataAttr, Attribute indicesAttr) {
+  DenseElementsAttr data = dataAttr.dyn_cast_or_null<DenseElementsAttr>();
+  DenseElementsAttr indices =
+      indicesAttr.dyn_cast_or_null<DenseElementsAttr>();
+  assert((data && indices) && "expected dense attributes");
+  ShapedType resType = resOperand.getType().cast<RankedTensorType>();
+  if (data.isSplat())
+    return DenseElementsAttr::get(resType, data.getSplatValue());
+
+  auto shape = data.getType().getShape();
+  int64_t rank = shape.size();
+  int64_t axis = resOperand.getDefiningOp<ONNXGatherOp>().axis();
+  if (axis < 0)
+    axis += rank;
+  int64_t axisSize = shape[axis];
+  int64_t outerSize = 1, innerSize = 1;
+  for (int64_t i = 0; i < axis; ++i)
+    outerSize *= shape[i];
+  for (int64_t i = axis + 1; i < rank; ++i)
+    innerSize *= shape[i];
+
+  SmallVector<int64_t, 4> gathered = getIntegerValues(indices);
+  if (indices.isSplat())
+    gathered.resize(indices.getType().getNumElements(), gathered[0]);
+  // result[o][g][i] = data[o][indices[g]][i]
+  std::vector<int64_t> resIndices;
+  resIndices.reserve(resType.getNumElements());
+  for (int64_t o = 0; o < outerSize; ++o)
+    for (int64_t index : gathered) {
+      if (index < 0)
+        index += axisSize;
+      assert(index >= 0 && index < axisSize && "out-of-bound gather index");
+      for (int64_t i = 0; i < innerSize; ++i)
+        resIndices.emplace_back((o * axisSize + index) * innerSize + i);
+    }
+  return ConstPropSelectElements(resType, data, resIndices);
+}
+
+// Fold a slice of a constant with constant starts, ends, axes and steps.
+struct ConstPropSlicePattern : public OpRewritePattern<ONNXSliceOp> {
+  using OpRewritePattern<ONNXSliceOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(
+      ONNXSliceOp sliceOp, PatternRewriter &rewriter) const override {
+    auto resType = sliceOp.getType().dyn_cast<RankedTensorType>();
+    DenseElementsAttr data = getDenseConstantValue(sliceOp.data());
+    DenseElementsAttr startsAttr = getDenseConstantValue(sliceOp.starts());
+    DenseElementsAttr endsAttr = getDenseConstantValue(sliceOp.ends());
+    if (!resType || !resType.hasStaticShape() || !data || !startsAttr ||
+        !endsAttr || !data.getType().getElementType().isIntOrFloat())
+      return failure();
+
+    auto shape = data.getType().getShape();
+    int64_t rank = shape.size();
+    SmallVector<int64_t, 4> starts = getIntegerValues(startsAttr);
+    SmallVector<int64_t, 4> ends = getIntegerValues(endsAttr);
+    SmallVector<int64_t, 4> axes, steps;
+    if (sliceOp.axes().getType().isa<NoneType>()) {
+      for (int64_t i = 0; i < (int64_t)starts.size(); ++i)
+        axes.emplace_back(i);
+    } else if (auto axesAttr = getDenseConstantValue(sliceOp.axes())) {
+      axes = getIntegerValues(axesAttr);
+    } else {
+      return failure();
+    }
+    if (sliceOp.steps().getType().isa<NoneType>()) {
+      steps.resize(starts.size(), 1);
+    } else if (auto stepsAttr = getDenseConstantValue(sliceOp.steps())) {
+      steps = getIntegerValues(stepsAttr);
+    } else {
+      return failure();
+    }
+    if (ends.size() != starts.size() || axes.size() != starts.size() ||
+        steps.size() != starts.size())
+      return failure();
+
+    // Start and step of the slice along each dimension, with the clamping of
+    // the ONNX specification.
+    SmallVector<int64_t, 4> dimStarts(rank, 0), dimSteps(rank, 1);
+    SmallVector<int64_t, 4> resShape(shape.begin(), shape.end());
+    for (unsigned i = 0; i < axes.size(); ++i) {
+      int64_t axis = axes[i] < 0 ? axes[i] + rank : axes[i];
+      int64_t step = steps[i];
+      if (axis < 0 || axis >= rank || step == 0)
+        return failure();
+      int64_t dim = shape[axis];
+      int64_t start = starts[i] < 0 ? starts[i] + dim : starts[i];
+      int64_t end = ends[i] < 0 ? ends[i] + dim : ends[i];
+      if (step > 0) {
+        start = std::min(std::max<int64_t>(start, 0), dim);
+        end = std::min(std::max<int64_t>(end, 0), dim);
+        resShape[axis] = std::max<int64_t>(0, (end - start + step - 1) / step);
+      } else {
+        start = std::min(std::max<int64_t>(start, 0), dim - 1);
+        end = std::min(std::max<int64_t>(end, -1), dim - 1);
+        resShape[axis] = std::max<int64_t>(0, (start - end - step - 1) / -step);
+      }
+      dimStarts[axis] = start;
+      dimSteps[axis] = step;
+    }
+    if (resType.getShape() != llvm::makeArrayRef(resShape))
+      return failure();
+
+    SmallVector<int64_t, 4> strides = getStrides(shape);
+    std::vector<int64_t> resIndices(resType.getNumElements());
+    for (int64_t i = 0; i < (int64_t)resIndices.size(); ++i) {
+      int64_t index = 0;
+      for (int64_t d = rank - 1, rem = i; d >= 0; --d) {
+        index += (dimStarts[d] + (rem % resShape[d]) * dimSteps[d]) *
+                 strides[d];
+        rem /= resShape[d];
+      }
+      resIndices[i] = index;
+    }
+    rewriter.replaceOpWithNewOp<ONNXConstantOp>(sliceOp, Attribute(),
+        ConstPropSelectElements(resType, data, resIndices));
+    return success();
+  }
+};
+
+// Fold a concatenation of constants. The patterns of the DRR cannot match the
+// variadic operands of the concatenation.
+struct ConstPropConcatPattern : public OpRewritePattern<ONNXConcatOp> {
+  using OpRewritePattern<ONNXConcatOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(
+      ONNXConcatOp concatOp, PatternRewriter &rewriter) const override {
+    auto resType = concatOp.getType().dyn_cast<RankedTensorType>();
+    if (!resType || !resType.hasStaticShape() ||
+        !resType.getElementType().isIntOrFloat())
+      return failure();
+    SmallVector<DenseElementsAttr, 4> inputs;
+    for (Value input : concatOp.inputs()) {
+      DenseElementsAttr attr = getDenseConstantValue(input);
+      if (!attr)
+        return failure();
+      inputs.emplace_back(attr);
+    }
+
+    auto resShape = resType.getShape();
+    int64_t rank = resShape.size();
+    int64_t axis = concatOp.axis();
+    if (axis < 0)
+      axis += rank;
+    int64_t outerSize = 1, innerSize = 1;
+    for (int64_t i = 0; i < axis; ++i)
+      outerSize *= resShape[i];
+    for (int64_t i = axis + 1; i < rank; ++i)
+      innerSize *= resShape[i];
+
+    // result[o][offset_k + j][i] = inputs[k][o][j][i]
+    std::vector<int64_t> resIndices;
+    resIndices.reserve(resType.getNumElements());
+    for (int64_t o = 0; o < outerSize; ++o) {
+      int64_t offset = 0;
+      for (auto input : inputs) {
+        int64_t chunkSize = input.getType().getShape()[axis] * innerSize;
+        for (int64_t i = 0; i < chunkSize; ++i)
+          resIndices.emplace_back(offset + o * chunkSize + i);
+        offset += input.getType().getNumElements();
+      }
+    }
+    rewriter.replaceOpWithNewOp<ONNXConstantOp>(concatOp, Attribute(),
+        ConstPropSelectElements(resType, inputs, resIndices));
+    return success();
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// Code to perform constant propagation for cast.
+//===----------------------------------------------------------------------===//
+
+DenseElementsAttr ConstPropCast(
+    PatternRewriter &rewriter, Value resOperand, Attribute attr) {
+  DenseElementsAttr denseAttr =
+      attr.dyn_cast_or_null<mlir::DenseElementsAttr>();
+  assert(denseAttr && "expected dense attribute");
+  ShapedType resType = resOperand.getType().cast<RankedTensorType>();
+  Type fromType = denseAttr.getType().getElementType();
+  Type toType = resType.getElementType();
+
+  DenseElementsAttr result;
+  ArrayRef<char> data = denseAttr.getRawData();
+  int64_t numElements = denseAttr.isSplat() ? 1 : resType.getNumElements();
+  if (dispatchOnElementType(fromType, [&](auto fromZero) {
+        dispatchOnElementType(toType, [&](auto toZero) {
+          using FromT = decltype(fromZero);
+          using ToT = decltype(toZero);
+          std::vector<char> resData(numElements * sizeof(ToT));
+          parallelForRows(numElements, 1, [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i)
+              storeRawElement<ToT>(resData, i,
+                  static_cast<ToT>(loadRawElement<FromT>(data, i)));
+          });
+          result = DenseElementsAttr::getFromRawBuffer(
+              resType, resData, /*isSplatBuffer=*/denseAttr.isSplat());
+        });
+      }) &&
+      result)
+    return result;
+
+  // Other element types (f16, bf16, i1) go through a double or an integer.
   std::vector<Attribute> resVector;
   for (auto value : denseAttr.getValues<Attribute>()) {
-    resVector.emplace_back(value);
+    if (auto floatAttr = value.dyn_cast<FloatAttr>()) {
+      double val = floatAttr.getValueAsDouble();
+      if (toType.isa<FloatType>())
+        resVector.emplace_back(rewriter.getFloatAttr(toType, val));
+      else if (toType.isInteger(1))
+        resVector.emplace_back(rewriter.getIntegerAttr(toType, val != 0));
+      else
+        resVector.emplace_back(
+            rewriter.getIntegerAttr(toType, static_cast<int64_t>(val)));
+    } else {
+      auto intAttr = value.cast<IntegerAttr>();
+      auto intType = intAttr.getType().cast<IntegerType>();
+      int64_t val = (intType.isUnsigned() || intType.getWidth() == 1)
+                        ? (int64_t)intAttr.getValue().getZExtValue()
+                        : intAttr.getValue().getSExtValue();
+      if (toType.isa<FloatType>())
+        resVector.emplace_back(
+            rewriter.getFloatAttr(toType, static_cast<double>(val)));
+      else if (toType.isInteger(1))
+        resVector.emplace_back(rewriter.getIntegerAttr(toType, val != 0));
+      else
+        resVector.emplace_back(rewriter.getIntegerAttr(toType, val));
+    }
   }
-
-  ArrayRef<Attribute> resRef(resVector);
-  return DenseElementsAttr::get(resType, resRef);
+  if (denseAttr.isSplat())
+    return DenseElementsAttr::get(resType, resVector[0]);
+  return DenseElementsAttr::get(resType, llvm::makeArrayRef(resVector));
 }
 
 //===----------------------------------------------------------------------===//
@@ -401,6 +1014,13 @@ DenseElementsAttr ConstPropUnsqueeze(
 
 #include "src/Transform/ONNX/ONNXConstProp.inc"
 
+/// Populate the constant propagation patterns.
+void populateConstPropPatterns(
+    OwningRewritePatternList &patterns, MLIRContext *context) {
+  populateWithGenerated(context, patterns);
+  patterns.insert<ConstPropSlicePattern, ConstPropConcatPattern>(context);
+}
+
 //===----------------------------------------------------------------------===//
 // Code to manage the pass.
 //===----------------------------------------------------------------------===//
@@ -409,6 +1029,44 @@ struct ConstPropONNXToONNXPass
     : public PassWrapper<ConstPropONNXToONNXPass, FunctionPass> {
   void runOnFunction() final;
 };
+
+/// Check whether the ranked tensor results of an operation have dynamic
+/// dimensions.
+bool hasDynamicDims(Operation *op) {
+  return llvm::any_of(op->getResultTypes(), [](Type type) {
+    auto rankedType = type.dyn_cast<RankedTensorType>();
+    return rankedType && !rankedType.hasStaticShape();
+  });
+}
+
+/// Check whether `newType` keeps the rank and the static dimensions of
+/// `oldType`.
+bool refinesType(Type newType, Type oldType) {
+  auto oldRankedType = oldType.dyn_cast<RankedTensorType>();
+  if (!oldRankedType)
+    return true;
+  auto newRankedType = newType.dyn_cast<RankedTensorType>();
+  if (!newRankedType || newRankedType.getRank() != oldRankedType.getRank())
+    return false;
+  for (unsigned i = 0; i < oldRankedType.getRank(); ++i)
+    if (!oldRankedType.isDynamicDim(i) &&
+        newRankedType.getDimSize(i) != oldRankedType.getDimSize(i))
+      return false;
+  return true;
+}
+
+struct SimplifyShapeComputationsPass
+    : public PassWrapper<SimplifyShapeComputationsPass, FunctionPass> {
+  SimplifyShapeComputationsPass() = default;
+  SimplifyShapeComputationsPass(const SimplifyShapeComputationsPass &pass) {}
+
+  void runOnFunction() final;
+
+  Option<int> maxIterations{*this, "max-iterations",
+      llvm::cl::desc("Maximum number of rounds of folding and shape "
+                     "inference."),
+      llvm::cl::init(8)};
+};
 } // end anonymous namespace.
 
 void ConstPropONNXToONNXPass::runOnFunction() {
@@ -419,14 +1077,68 @@ void ConstPropONNXToONNXPass::runOnFunction() {
   target.addLegalDialect<ONNXOpsDialect>();
 
   OwningRewritePatternList patterns;
-  populateWithGenerated(context, patterns);
+  populateConstPropPatterns(patterns, context);
 
   applyPatternsAndFoldGreedily(function, patterns);
 } // end anonymous namespace
 
+void SimplifyShapeComputationsPass::runOnFunction() {
+  auto function = getFunction();
+  MLIRContext *context = &getContext();
+
+  OwningRewritePatternList patterns;
+  populateConstPropPatterns(patterns, context);
+  ONNXShapeOp::getCanonicalizationPatterns(patterns, context);
+  ONNXSizeOp::getCanonicalizationPatterns(patterns, context);
+
+  for (int iteration = 0; iteration < maxIterations; ++iteration) {
+    applyPatternsAndFoldGreedily(function, patterns);
+
+    // Infer the shapes of the ops with dynamic dimensions again, in program
+    // order so that the operands of an op are inferred before it. The new
+    // result types are only kept when they refine the former ones.
+    bool changed = false;
+    auto walkResult = function.walk([&](Operation *op) -> WalkResult {
+      auto shapeOp = dyn_cast<ShapeInference>(op);
+      if (!shapeOp || !hasDynamicDims(op))
+        return WalkResult::advance();
+      SmallVector<Type, 2> oldTypes(
+          op->getResultTypes().begin(), op->getResultTypes().end());
+      if (failed(shapeOp.inferShapes())) {
+        op->emitError("shape inference failed");
+        return WalkResult::interrupt();
+      }
+      for (unsigned i = 0; i < op->getNumResults(); ++i) {
+        Value result = op->getResult(i);
+        if (!refinesType(result.getType(), oldTypes[i]))
+          result.setType(oldTypes[i]);
+        changed |= result.getType() != oldTypes[i];
+      }
+      return WalkResult::advance();
+    });
+    if (walkResult.wasInterrupted())
+      return signalPassFailure();
+    if (!changed)
+      break;
+  }
+
+  if (auto terminator = function.getBody().back().getTerminator()) {
+    auto results = terminator->getOperandTypes();
+    function.setType(FunctionType::get(function.getType().getInputs(),
+        std::vector<Type>(results.begin(), results.end()), context));
+  }
+}
+
 /*!
  * Create a ConstPropONNX pass.
  */
 std::unique_ptr<mlir::Pass> mlir::createConstPropONNXToONNXPass() {
   return std::make_unique<ConstPropONNXToONNXPass>();
 }
+
+/*!
+ * Create a shape computation simplification pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createSimplifyShapeComputationsPass() {
+  return std::make_unique<SimplifyShapeComputationsPass>();
+}
@@ -0,0 +1,165 @@
+//===------- ConvEpilogueFusion.cpp - Fuse Epilogues into Convolutions ----===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Batch normalizations are folded into the weights of the convolutions they
+// follow (see FuseBatchNormTestModeConvPattern), but the residual additions
+// and activations consuming a convolution are still lowered to their own loop
+// nests, each traversing the whole output of the convolution.
+//
+// This file creates a pass which replaces a convolution followed by an
+// optional residual Add and an optional Relu, LeakyRelu or Clip with a single
+// ONNXFusedConvOp, whose lowering applies the epilogue to each output element
+// right after its reduction:
+//
+//   %0 = "onnx.Conv"(%x, %w, %b) : (...) -> tensor<1x16x30x30xf32>
+//   %1 = "onnx.Add"(%0, %y) : (...) -> tensor<1x16x30x30xf32>
+//   %2 = "onnx.Relu"(%1) : (...) -> tensor<1x16x30x30xf32>
+//
+// becomes:
+//
+//   %0 = "onnx.FusedConv"(%x, %w, %b, %y) {activation = "Relu", ...}
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Return the single user of a value, or null.
+Operation *getSingleUser(Value value) {
+  if (!value.hasOneUse())
+    return nullptr;
+  return *value.getUsers().begin();
+}
+
+/// Read the value of an optional scalar constant bound of a Clip operation.
+/// Returns false if the bound is not a constant.
+bool getClipBound(Value bound, FloatAttr &value) {
+  if (bound.getType().isa<NoneType>())
+    return true;
+  auto constOp = bound.getDefiningOp<ONNXConstantOp>();
+  if (!constOp || !constOp.value().hasValue())
+    return false;
+  auto dense = constOp.valueAttr().dyn_cast<DenseElementsAttr>();
+  if (!dense || !dense.isSplat())
+    return false;
+  auto splat = dense.getSplatValue().dyn_cast<FloatAttr>();
+  if (!splat)
+    return false;
+  value = FloatAttr::get(
+      Builder(bound.getContext()).getF32Type(), splat.getValueAsDouble());
+  return true;
+}
+
+/// Replace a convolution and the epilogue operations consuming it with a
+/// single ONNXFusedConvOp.
+void fuseConvEpilogue(ONNXConvOp convOp) {
+  Value result = convOp.getResult();
+  auto resultType = result.getType().dyn_cast<RankedTensorType>();
+  if (!resultType || !resultType.getElementType().isa<FloatType>())
+    return;
+  // Padding is made explicit before lowering (see ConvOpPaddingPattern), which
+  // fused convolutions do not go through.
+  if (auto pads = convOp.padsAttr())
+    if (llvm::any_of(pads.getValue(), [](Attribute pad) {
+          return pad.cast<IntegerAttr>().getInt() != 0;
+        }))
+      return;
+
+  OpBuilder builder(convOp);
+  SmallVector<Operation *, 2> epilogueOps;
+  Value residual;
+  NamedAttrList activationAttrs;
+
+  // The residual is added before the activation, as in residual networks.
+  Operation *user = getSingleUser(result);
+  if (auto addOp = dyn_cast_or_null<ONNXAddOp>(user)) {
+    Value other = addOp.A() == result ? addOp.B() : addOp.A();
+    if (other != result && other.getType() == resultType &&
+        addOp.getResult().getType() == resultType) {
+      residual = other;
+      epilogueOps.emplace_back(addOp);
+      result = addOp.getResult();
+      user = getSingleUser(result);
+    }
+  }
+
+  if (user && user->getNumResults() == 1 &&
+      user->getResult(0).getType() == resultType) {
+    if (isa<ONNXReluOp>(user)) {
+      activationAttrs.set("activation", builder.getStringAttr("Relu"));
+      epilogueOps.emplace_back(user);
+    } else if (auto leakyReluOp = dyn_cast<ONNXLeakyReluOp>(user)) {
+      activationAttrs.set("activation", builder.getStringAttr("LeakyRelu"));
+      activationAttrs.set("alpha", leakyReluOp.alphaAttr());
+      epilogueOps.emplace_back(user);
+    } else if (auto clipOp = dyn_cast<ONNXClipOp>(user)) {
+      FloatAttr clipMin, clipMax;
+      if (getClipBound(clipOp.min(), clipMin) &&
+          getClipBound(clipOp.max(), clipMax)) {
+        activationAttrs.set("activation", builder.getStringAttr("Clip"));
+        if (clipMin)
+          activationAttrs.set("clip_min", clipMin);
+        if (clipMax)
+          activationAttrs.set("clip_max", clipMax);
+        epilogueOps.emplace_back(user);
+      }
+    }
+  }
+
+  if (epilogueOps.empty())
+    return;
+
+  // The fused operation replaces the last operation of the epilogue, where
+  // the residual is available.
+  Operation *lastOp = epilogueOps.back();
+  builder.setInsertionPoint(lastOp);
+  if (!residual)
+    residual =
+        builder.create<ConstantOp>(lastOp->getLoc(), builder.getUnitAttr());
+  auto fusedOp = builder.create<ONNXFusedConvOp>(convOp.getLoc(),
+      ArrayRef<Type>{resultType},
+      ValueRange{convOp.X(), convOp.W(), convOp.B(), residual},
+      convOp.getAttrs());
+  for (auto attr : activationAttrs)
+    fusedOp.setAttr(attr.first, attr.second);
+
+  lastOp->getResult(0).replaceAllUsesWith(fusedOp.getResult());
+  for (Operation *op : llvm::reverse(epilogueOps))
+    op->erase();
+  convOp.erase();
+}
+
+/*!
+ *  Function pass that fuses epilogues into convolutions.
+ */
+class ConvEpilogueFusionPass
+    : public PassWrapper<ConvEpilogueFusionPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    auto function = getFunction();
+
+    SmallVector<ONNXConvOp, 8> convOps;
+    function.walk([&](ONNXConvOp convOp) { convOps.emplace_back(convOp); });
+    for (auto convOp : convOps)
+      fuseConvEpilogue(convOp);
+  }
+};
+} // end anonymous namespace
+
+/*!
+ * Create a convolution epilogue fusion pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createConvEpilogueFusionPass() {
+  return std::make_unique<ConvEpilogueFusionPass>();
+}
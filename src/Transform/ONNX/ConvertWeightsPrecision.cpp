@@ -0,0 +1,150 @@
+//===--- ConvertWeightsPrecision.cpp - Store Float Weights in Half Floats -===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Matrix multiplications and convolutions stream their weights from memory
+// for every invocation of the model, and large models are bound by the
+// bandwidth this takes.
+//
+// This file creates a pass which converts the f32 constant weights of MatMul,
+// Gemm and Conv operations to bf16 or f16, halving their size:
+//
+//   %w = "onnx.Constant"() {value = dense<...> : tensor<64x64xf32>}
+//   %y = "onnx.MatMul"(%x, %w) : (tensor<?x64xf32>, tensor<64x64xf32>) -> ...
+//
+// becomes
+//
+//   %w = "onnx.Constant"() {value = dense<...> : tensor<64x64xbf16>}
+//   %y = "onnx.MatMul"(%x, %w) : (tensor<?x64xf32>, tensor<64x64xbf16>) -> ...
+//
+// The lowerings of these operations extend the weights to the type of the
+// accumulators when they are loaded, so the results keep their f32 type.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Return the value of a constant f32 operand, or a null attribute.
+DenseElementsAttr getConstantF32Weights(Value operand) {
+  auto constOp = operand.getDefiningOp<ONNXConstantOp>();
+  if (!constOp || !constOp.value().hasValue())
+    return nullptr;
+  auto type = operand.getType().dyn_cast<RankedTensorType>();
+  if (!type || !type.getElementType().isF32())
+    return nullptr;
+  return constOp.valueAttr().dyn_cast<DenseElementsAttr>();
+}
+
+/// Round the values of an f32 constant to the given float type, ties to even.
+/// The rounded values are written as raw data, so that large weights are never
+/// expanded into attributes.
+DenseElementsAttr convertWeights(DenseElementsAttr value, FloatType type) {
+  auto convertedType = RankedTensorType::get(value.getType().getShape(), type);
+  auto convert = [&](APFloat element) {
+    bool losesInfo;
+    element.convert(
+        type.getFloatSemantics(), APFloat::rmNearestTiesToEven, &losesInfo);
+    return element;
+  };
+  if (value.isSplat())
+    return DenseElementsAttr::get(
+        convertedType, convert(value.getSplatValue<APFloat>()));
+
+  std::vector<uint16_t> convertedData;
+  convertedData.reserve(value.getNumElements());
+  for (APFloat element : value.getValues<APFloat>())
+    convertedData.emplace_back(
+        convert(element).bitcastToAPInt().getZExtValue());
+  return DenseElementsAttr::getFromRawBuffer(convertedType,
+      ArrayRef<char>(reinterpret_cast<const char *>(convertedData.data()),
+          convertedData.size() * sizeof(uint16_t)),
+      /*isSplatBuffer=*/false);
+}
+
+/*!
+ *  Function pass that converts the f32 constant weights of matrix
+ *  multiplications and convolutions to a half-precision float type.
+ */
+class ConvertWeightsPrecisionPass
+    : public PassWrapper<ConvertWeightsPrecisionPass, FunctionPass> {
+public:
+  /// Make sure that we have a valid default constructor and copy constructor to
+  /// make sure that the options are initialized properly.
+  ConvertWeightsPrecisionPass() = default;
+  ConvertWeightsPrecisionPass(const ConvertWeightsPrecisionPass &pass) {}
+  ConvertWeightsPrecisionPass(StringRef precision) {
+    this->precision = precision.str();
+  }
+
+  void runOnFunction() override {
+    auto function = getFunction();
+    OpBuilder builder(&getContext());
+    FloatType type;
+    if (precision == "bf16")
+      type = builder.getBF16Type();
+    else if (precision == "f16")
+      type = builder.getF16Type();
+    else {
+      function.emitError("unsupported weight precision: ") << precision;
+      return signalPassFailure();
+    }
+
+    // The weights are the B operand of matrix multiplications and the W
+    // operand of convolutions.
+    SmallVector<std::pair<Operation *, unsigned>, 16> weights;
+    function.walk([&](Operation *op) {
+      if (isa<ONNXMatMulOp, ONNXGemmOp, ONNXConvOp, ONNXFusedConvOp>(op))
+        weights.emplace_back(op, 1);
+    });
+
+    // Each constant is converted once, right after its definition. The f32
+    // constant is kept as long as other operations use it.
+    llvm::DenseMap<Value, Value> convertedWeights;
+    for (auto weight : weights) {
+      Operation *op = weight.first;
+      Value operand = op->getOperand(weight.second);
+      Value &convertedOperand = convertedWeights[operand];
+      if (!convertedOperand) {
+        auto value = getConstantF32Weights(operand);
+        if (!value)
+          continue;
+        auto converted = convertWeights(value, type);
+        builder.setInsertionPointAfter(operand.getDefiningOp());
+        convertedOperand = builder.create<ONNXConstantOp>(operand.getLoc(),
+            converted.getType(), /*sparse_value=*/nullptr, converted)
+                               .getResult();
+      }
+      op->setOperand(weight.second, convertedOperand);
+      if (operand.use_empty())
+        operand.getDefiningOp()->erase();
+    }
+  }
+
+private:
+  Option<std::string> precision{*this, "precision",
+      llvm::cl::desc("Float type of the converted weights, bf16 or f16."),
+      llvm::cl::init("bf16")};
+};
+} // end anonymous namespace
+
+/*!
+ * Create a weight precision conversion pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createConvertWeightsPrecisionPass() {
+  return std::make_unique<ConvertWeightsPrecisionPass>();
+}
+
+std::unique_ptr<mlir::Pass> mlir::createConvertWeightsPrecisionPass(
+    StringRef precision) {
+  return std::make_unique<ConvertWeightsPrecisionPass>(precision);
+}
@@ -0,0 +1,164 @@
+//===------- ElementwiseFusion.cpp - Fuse ONNX Element-wise Operations ----===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Every element-wise ONNX operation is lowered to its own loop nest writing
+// its own intermediate buffer, so that a chain such as Add -> Mul -> Relu
+// traverses memory once per operation.
+//
+// This file creates a pass which groups producer/consumer chains of
+// element-wise operations into a single ONNXFusedElementwiseOp. The fused
+// operation is lowered to a single loop nest computing all the members of the
+// chain on scalars, removing the intermediate buffers.
+//
+// Casts are members of the chains too: a cast of an input of the chain is
+// applied to the scalars loaded from the input, and a cast of the value of the
+// chain to the scalars stored into the result, so that a conversion between
+// element types does not cost a pass over memory of its own.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/BlockAndValueMapping.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Test if the operation is an element-wise operation that can be part of a
+/// fused operation. The operation must have a single result, and all its
+/// operands must have the type of the result, i.e. no broadcasting and no
+/// change of element type except by a cast. Only static shapes are considered
+/// so that all the members of a chain are known to iterate over the same
+/// space.
+bool isFusableElementwiseOp(Operation *op) {
+  if (!isa<ONNXAbsOp, ONNXAddOp, ONNXAndOp, ONNXCastOp, ONNXCosOp, ONNXCoshOp,
+          ONNXDivOp, ONNXEluOp, ONNXExpOp, ONNXFastGeluOp, ONNXGeluOp,
+          ONNXHardSigmoidOp, ONNXLeakyReluOp, ONNXLogOp, ONNXMaxOp, ONNXMinOp,
+          ONNXMulOp, ONNXNegOp, ONNXOrOp, ONNXReciprocalOp, ONNXReluOp,
+          ONNXSeluOp, ONNXSigmoidOp, ONNXSignOp, ONNXSinhOp, ONNXSoftplusOp,
+          ONNXSoftsignOp, ONNXSqrtOp, ONNXSubOp, ONNXSumOp, ONNXTanhOp,
+          ONNXXorOp>(op))
+    return false;
+  if (op->getNumResults() != 1 || op->getNumOperands() == 0)
+    return false;
+  auto resultType = op->getResult(0).getType().dyn_cast<RankedTensorType>();
+  if (!resultType || !resultType.hasStaticShape() || resultType.getRank() == 0)
+    return false;
+  if (isa<ONNXCastOp>(op)) {
+    auto operandType = op->getOperand(0).getType().dyn_cast<RankedTensorType>();
+    return operandType && operandType.getShape() == resultType.getShape();
+  }
+  return llvm::all_of(op->getOperandTypes(),
+      [&](Type operandType) { return operandType == resultType; });
+}
+
+/// Collect into `members` the chain of fusable operations computing the value
+/// of `root`. A producer joins the chain when its only use is by a member of
+/// the chain in the same block.
+void collectFusedMembers(
+    Operation *root, SmallPtrSetImpl<Operation *> &members) {
+  SmallVector<Operation *, 8> worklist = {root};
+  members.insert(root);
+  while (!worklist.empty()) {
+    Operation *op = worklist.pop_back_val();
+    for (Value operand : op->getOperands()) {
+      Operation *producer = operand.getDefiningOp();
+      if (!producer || members.count(producer) ||
+          producer->getBlock() != root->getBlock() ||
+          !isFusableElementwiseOp(producer) || !producer->hasOneUse())
+        continue;
+      members.insert(producer);
+      worklist.emplace_back(producer);
+    }
+  }
+}
+
+/// Replace the chain of operations computing the value of `root` by a single
+/// ONNXFusedElementwiseOp.
+void fuseElementwiseChain(Operation *root, ArrayRef<Operation *> members) {
+  // The values used by the chain but not computed by it become the inputs of
+  // the fused operation, in order of first use.
+  SmallPtrSet<Operation *, 8> memberSet(members.begin(), members.end());
+  SmallVector<Value, 4> inputs;
+  for (Operation *member : members)
+    for (Value operand : member->getOperands())
+      if (!memberSet.count(operand.getDefiningOp()) &&
+          !llvm::is_contained(inputs, operand))
+        inputs.emplace_back(operand);
+
+  OpBuilder builder(root);
+  Value result = root->getResult(0);
+  auto fusedOp = builder.create<ONNXFusedElementwiseOp>(
+      root->getLoc(), result.getType(), inputs);
+
+  // Clone the members of the chain into the body of the fused operation.
+  Block *body = new Block();
+  fusedOp.body().push_back(body);
+  BlockAndValueMapping mapper;
+  for (Value input : inputs)
+    mapper.map(input, body->addArgument(input.getType()));
+  builder.setInsertionPointToStart(body);
+  for (Operation *member : members)
+    builder.clone(*member, mapper);
+  builder.create<ONNXFusedElementwiseYieldOp>(
+      root->getLoc(), mapper.lookup(result));
+
+  result.replaceAllUsesWith(fusedOp.getResult());
+  for (Operation *member : llvm::reverse(members))
+    member->erase();
+}
+
+/*!
+ *  Function pass that fuses chains of element-wise operations.
+ */
+class ElementwiseFusionPass
+    : public PassWrapper<ElementwiseFusionPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    auto function = getFunction();
+
+    // Visit the operations from the last to the first one so that a chain is
+    // always collected from its root, i.e. the member whose value is used
+    // outside of the chain.
+    for (Block &block : function.getBody()) {
+      SmallVector<Operation *, 32> candidates;
+      for (Operation &op : llvm::reverse(block))
+        if (isFusableElementwiseOp(&op))
+          candidates.emplace_back(&op);
+
+      SmallPtrSet<Operation *, 32> fused;
+      for (Operation *root : candidates) {
+        if (fused.count(root))
+          continue;
+        SmallPtrSet<Operation *, 8> memberSet;
+        collectFusedMembers(root, memberSet);
+        if (memberSet.size() < 2)
+          continue;
+        fused.insert(memberSet.begin(), memberSet.end());
+
+        // Members are cloned in their original order so that every value is
+        // defined before being used.
+        SmallVector<Operation *, 8> members(memberSet.begin(), memberSet.end());
+        llvm::sort(members, [](Operation *lhs, Operation *rhs) {
+          return lhs->isBeforeInBlock(rhs);
+        });
+        fuseElementwiseChain(root, members);
+      }
+    }
+  }
+};
+} // end anonymous namespace
+
+/*!
+ * Create an element-wise operation fusion pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createElementwiseFusionPass() {
+  return std::make_unique<ElementwiseFusionPass>();
+}
@@ -0,0 +1,106 @@
+//===----------- KVCacheAppend.cpp - Return New Cache Entries Only --------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Autoregressive decoder models take the keys and values of the previous
+// tokens as inputs, concatenate them with those of the new tokens, and return
+// the concatenations as the inputs of the next call:
+//
+//   func @main_graph(%past: tensor<1x12x?x64xf32>, ...) -> ... {
+//     %present = "onnx.Concat"(%past, %new) {axis = 2 : si64} : (...) -> ...
+//     ...
+//     return %present, ...
+//   }
+//
+// so that the whole cache is written out, and copied back in by the caller,
+// for each generated token.
+//
+// This file creates a pass which returns the new entries instead of the
+// concatenations, when the past entries are only read by the concatenation:
+//
+//     return %new, ...
+//
+// The concatenation is left to the other operations using it, such as the
+// attention. The caller appends the new entries to its cache, which is what
+// StatefulExecutionSession does with its cache bindings.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Return the new entries of a concatenation of the past entries read from an
+/// argument of the function with new entries, or nullptr if the value is not
+/// such a concatenation.
+Value getAppendedEntries(Value value, Block &entryBlock) {
+  auto concatOp = value.getDefiningOp<ONNXConcatOp>();
+  if (!concatOp || concatOp.inputs().size() != 2)
+    return nullptr;
+  Value past = concatOp.inputs()[0];
+  auto pastArg = past.dyn_cast<BlockArgument>();
+  if (!pastArg || pastArg.getOwner() != &entryBlock || !past.hasOneUse())
+    return nullptr;
+  return concatOp.inputs()[1];
+}
+
+/*!
+ *  Module pass that returns the entries appended to the caches of the entry
+ *  point functions.
+ */
+class KVCacheAppendPass
+    : public PassWrapper<KVCacheAppendPass, OperationPass<ModuleOp>> {
+public:
+  void runOnOperation() override {
+    auto module = getOperation();
+    SymbolTable symbolTable(module);
+
+    SmallVector<ONNXEntryPointOp, 1> entryPoints;
+    module.walk([&](ONNXEntryPointOp op) { entryPoints.emplace_back(op); });
+
+    for (auto entryPoint : entryPoints) {
+      auto funcName = entryPoint
+                          .getAttrOfType<SymbolRefAttr>(
+                              ONNXEntryPointOp::getEntryPointFuncAttrName())
+                          .getLeafReference();
+      auto function = symbolTable.lookup<FuncOp>(funcName);
+      if (!function || !llvm::hasSingleElement(function.getBody()))
+        continue;
+
+      Block &entryBlock = function.getBody().front();
+      Operation *returnOp = entryBlock.getTerminator();
+      SmallVector<Type, 4> resultTypes(function.getType().getResults().begin(),
+          function.getType().getResults().end());
+      bool changed = false;
+      for (unsigned i = 0; i < returnOp->getNumOperands(); ++i) {
+        Value concat = returnOp->getOperand(i);
+        Value entries = getAppendedEntries(concat, entryBlock);
+        if (!entries)
+          continue;
+        returnOp->setOperand(i, entries);
+        resultTypes[i] = entries.getType();
+        if (concat.use_empty())
+          concat.getDefiningOp()->erase();
+        changed = true;
+      }
+      if (changed)
+        function.setType(FunctionType::get(function.getType().getInputs(),
+            resultTypes, &getContext()));
+    }
+  }
+};
+} // namespace
+
+std::unique_ptr<mlir::Pass> mlir::createKVCacheAppendPass() {
+  return std::make_unique<KVCacheAppendPass>();
+}
@@ -0,0 +1,290 @@
+//===------- LayoutAssignment.cpp - Assign Blocked Layouts to CNN Regions -===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// In the NCHW layout, the innermost loop of a convolution walks the pixels of
+// a single channel while the reduction walks the channels, so that every
+// multiply-add of the output channels loads its operands from distant
+// locations.
+//
+// This file creates a pass which computes the convolutions in the NCHW[x]c
+// layout instead, where the innermost dimension of the tensors holds x
+// consecutive channels, and propagates that layout through the element-wise
+// and pooling operations consuming the convolutions. Layout transformations
+// are only left at the boundaries of the resulting regions:
+//
+//   %0 = "onnx.Conv"(%x, %w, %b) : (...) -> tensor<1x16x30x30xf32>
+//   %1 = "onnx.Relu"(%0) : (tensor<1x16x30x30xf32>) -> tensor<1x16x30x30xf32>
+//
+// becomes, with a block size of 8:
+//
+//   %0 = "onnx.LayoutTransform"(%x) {target_layout = "NCHWc", ...}
+//   %1 = "onnx.LayoutTransform"(%w) {target_layout = "OIHWio", ...}
+//   %2 = "onnx.ConvNCHWc"(%0, %1, %b) : (...) -> tensor<1x2x30x30x8xf32>
+//   %3 = "onnx.Relu"(%2) : (tensor<1x2x30x30x8xf32>) -> tensor<1x2x30x30x8xf32>
+//   %4 = "onnx.LayoutTransform"(%3) {target_layout = "NCHW", ...}
+//
+// Batch normalizations are expected to be folded into the convolutions
+// beforehand, and end the regions otherwise.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Return the static 4-D f32 type of a value whose channels are a multiple of
+/// the block size, or a null type.
+RankedTensorType getBlockableType(Value value, int64_t blockSize) {
+  auto type = value.getType().dyn_cast<RankedTensorType>();
+  if (!type || type.getRank() != 4 || !type.hasStaticShape() ||
+      !type.getElementType().isF32() || type.getDimSize(1) % blockSize != 0)
+    return nullptr;
+  return type;
+}
+
+/// Return the NCHWc type of a NCHW type.
+RankedTensorType getNCHWcType(RankedTensorType type, int64_t blockSize) {
+  auto shape = type.getShape();
+  return RankedTensorType::get(
+      {shape[0], shape[1] / blockSize, shape[2], shape[3], blockSize},
+      type.getElementType());
+}
+
+/// Return the OIHWio type of a OIHW kernel type.
+RankedTensorType getOIHWioType(RankedTensorType type, int64_t blockSize) {
+  auto shape = type.getShape();
+  return RankedTensorType::get({shape[0] / blockSize, shape[1] / blockSize,
+                                   shape[2], shape[3], blockSize, blockSize},
+      type.getElementType());
+}
+
+bool hasAllValues(ArrayAttr attr, int64_t value) {
+  return !attr || llvm::all_of(attr.getValue(), [&](Attribute element) {
+    return element.cast<IntegerAttr>().getInt() == value;
+  });
+}
+
+bool hasExplicitPadding(Operation *op) {
+  auto autoPad = op->getAttrOfType<StringAttr>("auto_pad");
+  return !autoPad || autoPad.getValue() == "NOTSET" ||
+         autoPad.getValue() == "VALID";
+}
+
+/// Return the NCHWc value of an operand computed in a blocked region, i.e. the
+/// input of the transformation back to NCHW producing it, or a null value.
+Value getBlockedValue(Value operand, int64_t blockSize) {
+  auto transformOp = operand.getDefiningOp<ONNXLayoutTransformOp>();
+  if (!transformOp || transformOp.block_size() != blockSize ||
+      transformOp.target_layout() != ONNXLayoutTransformOp::getNCHWLayoutName())
+    return nullptr;
+  return transformOp.data();
+}
+
+/*!
+ *  Function pass that assigns the NCHW[x]c layout to CNN regions.
+ */
+class LayoutAssignmentPass
+    : public PassWrapper<LayoutAssignmentPass, FunctionPass> {
+public:
+  /// Make sure that we have a valid default constructor and copy constructor to
+  /// make sure that the options are initialized properly.
+  LayoutAssignmentPass() = default;
+  LayoutAssignmentPass(const LayoutAssignmentPass &pass) {}
+  LayoutAssignmentPass(int64_t blockSize) { this->blockSize = blockSize; }
+
+  void runOnFunction() override {
+    auto function = getFunction();
+    if (blockSize <= 0)
+      return;
+
+    SmallVector<Operation *, 32> ops;
+    function.walk([&](Operation *op) {
+      if (op->getParentOp() == function)
+        ops.emplace_back(op);
+    });
+    for (Operation *op : ops) {
+      OpBuilder builder(op);
+      if (auto convOp = dyn_cast<ONNXConvOp>(op))
+        assignConvLayout(builder, convOp);
+      else if (isa<ONNXMaxPoolSingleOutOp, ONNXAveragePoolOp>(op))
+        assignPoolLayout(builder, op);
+      else if (auto padOp = dyn_cast<ONNXPadConstantValuePadOp>(op))
+        assignPadLayout(builder, padOp);
+      else if (isElementwiseOp(op))
+        assignElementwiseLayout(builder, op);
+    }
+
+    // Fold the pairs of transformations between adjacent blocked operations
+    // and remove the transformations left unused.
+    OwningRewritePatternList patterns;
+    applyPatternsAndFoldGreedily(function, patterns);
+  }
+
+private:
+  Option<int64_t> blockSize{*this, "block-size",
+      llvm::cl::desc("Number of channels of the blocked dimension of the "
+                     "NCHW[x]c layout (0 disables the pass)."),
+      llvm::cl::init(8)};
+
+  Value createTransform(
+      OpBuilder &builder, Location loc, Value data, Type type, StringRef layout) {
+    return builder.create<ONNXLayoutTransformOp>(loc, type, data,
+        builder.getStringAttr(layout), builder.getI64IntegerAttr(blockSize));
+  }
+
+  /// Replace the result of an operation by the transformation back to NCHW of
+  /// its blocked counterpart.
+  void replaceByBlockedResult(
+      OpBuilder &builder, Operation *op, Value blockedResult) {
+    Value result = op->getResult(0);
+    Value nchwResult = createTransform(builder, op->getLoc(), blockedResult,
+        result.getType(), ONNXLayoutTransformOp::getNCHWLayoutName());
+    result.replaceAllUsesWith(nchwResult);
+    op->erase();
+  }
+
+  /// Create a copy of an operation computing on blocked operands.
+  Operation *cloneWithBlockedTypes(OpBuilder &builder, Operation *op,
+      ValueRange blockedOperands, Type blockedType) {
+    OperationState state(op->getLoc(), op->getName());
+    state.addOperands(blockedOperands);
+    state.addTypes(blockedType);
+    state.addAttributes(op->getAttrs());
+    return builder.createOperation(state);
+  }
+
+  void assignConvLayout(OpBuilder &builder, ONNXConvOp convOp) {
+    auto inputType = getBlockableType(convOp.X(), blockSize);
+    auto kernelType = getBlockableType(convOp.W(), blockSize);
+    auto resultType = getBlockableType(convOp.getResult(), blockSize);
+    if (!inputType || !kernelType || !resultType ||
+        kernelType.getDimSize(0) % blockSize != 0 || convOp.group() != 1 ||
+        !hasExplicitPadding(convOp) || !hasAllValues(convOp.padsAttr(), 0) ||
+        !hasAllValues(convOp.dilationsAttr(), 1))
+      return;
+
+    auto loc = convOp.getLoc();
+    Value input = getBlockedValue(convOp.X(), blockSize);
+    if (!input)
+      input = createTransform(builder, loc, convOp.X(),
+          getNCHWcType(inputType, blockSize),
+          ONNXLayoutTransformOp::getNCHWcLayoutName());
+    Value kernel = createTransform(builder, loc, convOp.W(),
+        getOIHWioType(kernelType, blockSize),
+        ONNXLayoutTransformOp::getOIHWioLayoutName());
+    auto blockedConvOp =
+        builder.create<ONNXConvNCHWcOp>(loc, getNCHWcType(resultType, blockSize),
+            input, kernel, convOp.B(), convOp.stridesAttr());
+    replaceByBlockedResult(builder, convOp, blockedConvOp.getResult());
+  }
+
+  void assignPoolLayout(OpBuilder &builder, Operation *poolOp) {
+    Value input = getBlockedValue(poolOp->getOperand(0), blockSize);
+    auto resultType = getBlockableType(poolOp->getResult(0), blockSize);
+    auto pads = poolOp->getAttrOfType<ArrayAttr>("pads");
+    if (!input || !resultType || !hasExplicitPadding(poolOp) || !pads ||
+        pads.size() != 4)
+      return;
+
+    // The blocked dimension is pooled with a unit kernel.
+    auto appendUnit = [&](StringRef name, int64_t defaultValue) {
+      SmallVector<int64_t, 3> values;
+      if (auto attr = poolOp->getAttrOfType<ArrayAttr>(name))
+        for (Attribute value : attr.getValue())
+          values.emplace_back(value.cast<IntegerAttr>().getInt());
+      values.resize(2, defaultValue);
+      values.emplace_back(1);
+      return builder.getI64ArrayAttr(values);
+    };
+    auto padValues = llvm::to_vector<4>(
+        llvm::map_range(pads.getValue(), [](Attribute pad) {
+          return pad.cast<IntegerAttr>().getInt();
+        }));
+
+    Operation *blockedPoolOp = cloneWithBlockedTypes(
+        builder, poolOp, input, getNCHWcType(resultType, blockSize));
+    blockedPoolOp->setAttr("kernel_shape", appendUnit("kernel_shape", 1));
+    blockedPoolOp->setAttr("strides", appendUnit("strides", 1));
+    if (poolOp->getAttr("dilations"))
+      blockedPoolOp->setAttr("dilations", appendUnit("dilations", 1));
+    blockedPoolOp->setAttr(
+        "pads", builder.getI64ArrayAttr({padValues[0], padValues[1], 0,
+                    padValues[2], padValues[3], 0}));
+    replaceByBlockedResult(builder, poolOp, blockedPoolOp->getResult(0));
+  }
+
+  void assignPadLayout(OpBuilder &builder, ONNXPadConstantValuePadOp padOp) {
+    Value input = getBlockedValue(padOp.data(), blockSize);
+    auto resultType = getBlockableType(padOp.getResult(), blockSize);
+    if (!input || !resultType)
+      return;
+
+    // Only the spatial dimensions can be padded.
+    SmallVector<int64_t, 8> pads;
+    for (Attribute pad : padOp.pads().getValue())
+      pads.emplace_back(pad.cast<IntegerAttr>().getInt());
+    if (pads.size() != 8 || pads[0] != 0 || pads[1] != 0 || pads[4] != 0 ||
+        pads[5] != 0)
+      return;
+
+    Operation *blockedPadOp = cloneWithBlockedTypes(
+        builder, padOp, input, getNCHWcType(resultType, blockSize));
+    blockedPadOp->setAttr("pads", builder.getI64ArrayAttr({0, 0, pads[2],
+                                      pads[3], 0, 0, 0, pads[6], pads[7], 0}));
+    replaceByBlockedResult(builder, padOp, blockedPadOp->getResult(0));
+  }
+
+  /// Element-wise operations without broadcasting are computed in any layout.
+  bool isElementwiseOp(Operation *op) {
+    if (!isa<ONNXAbsOp, ONNXAddOp, ONNXDivOp, ONNXEluOp, ONNXExpOp,
+            ONNXHardSigmoidOp, ONNXLeakyReluOp, ONNXMaxOp, ONNXMinOp,
+            ONNXMulOp, ONNXNegOp, ONNXReluOp, ONNXSeluOp, ONNXSigmoidOp,
+            ONNXSoftplusOp, ONNXSqrtOp, ONNXSubOp, ONNXSumOp, ONNXTanhOp>(op))
+      return false;
+    if (op->getNumResults() != 1 || op->getNumOperands() == 0)
+      return false;
+    Type resultType = op->getResult(0).getType();
+    return llvm::all_of(op->getOperandTypes(),
+        [&](Type operandType) { return operandType == resultType; });
+  }
+
+  void assignElementwiseLayout(OpBuilder &builder, Operation *op) {
+    auto resultType = getBlockableType(op->getResult(0), blockSize);
+    if (!resultType)
+      return;
+    SmallVector<Value, 2> blockedOperands;
+    for (Value operand : op->getOperands()) {
+      Value blockedOperand = getBlockedValue(operand, blockSize);
+      if (!blockedOperand)
+        return;
+      blockedOperands.emplace_back(blockedOperand);
+    }
+
+    Operation *blockedOp = cloneWithBlockedTypes(
+        builder, op, blockedOperands, getNCHWcType(resultType, blockSize));
+    replaceByBlockedResult(builder, op, blockedOp->getResult(0));
+  }
+};
+} // end anonymous namespace
+
+/*!
+ * Create a layout assignment pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createLayoutAssignmentPass() {
+  return std::make_unique<LayoutAssignmentPass>();
+}
+
+std::unique_ptr<mlir::Pass> mlir::createLayoutAssignmentPass(
+    int64_t blockSize) {
+  return std::make_unique<LayoutAssignmentPass>(blockSize);
+}
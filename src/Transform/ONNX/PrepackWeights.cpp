@@ -0,0 +1,92 @@
+//===-------- PrepackWeights.cpp - Prepack Constant Weight Operands -------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The Gemm lowering reads both of its operands along the reduction dimension,
+// and packs the operands stored the other way around into transposed buffers
+// on every invocation of the model.
+//
+// This file creates a pass which transposes the constant operands of Gemm
+// operations at compile time instead, and records their new layout in the
+// transA and transB attributes of the operation, so that no packing is left
+// for the lowering. MatMul operations followed by an Add are combined into
+// Gemm operations beforehand and benefit from this pass as well.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Return the value of a constant 2-D operand with static shape, or a null
+/// attribute.
+DenseElementsAttr getConstantMatrix(Value operand) {
+  auto constOp = operand.getDefiningOp<ONNXConstantOp>();
+  if (!constOp || !constOp.value().hasValue())
+    return nullptr;
+  auto type = operand.getType().dyn_cast<RankedTensorType>();
+  if (!type || type.getRank() != 2 || !type.hasStaticShape())
+    return nullptr;
+  return constOp.valueAttr().dyn_cast<DenseElementsAttr>();
+}
+
+/// Replace the operand of an operation by the transpose of its constant value.
+void replaceByTransposedConstant(
+    OpBuilder &builder, Operation *op, unsigned index) {
+  Value operand = op->getOperand(index);
+  auto transposed = transposeMatrix(getConstantMatrix(operand));
+
+  builder.setInsertionPoint(op);
+  auto transposedConstOp = builder.create<ONNXConstantOp>(operand.getLoc(),
+      transposed.getType(), /*sparse_value=*/nullptr, transposed);
+  op->setOperand(index, transposedConstOp.getResult());
+  if (operand.use_empty())
+    operand.getDefiningOp()->erase();
+}
+
+IntegerAttr getTransAttr(OpBuilder &builder, int64_t trans) {
+  return IntegerAttr::get(builder.getIntegerType(64, /*isSigned=*/true),
+      APInt(64, trans, /*isSigned=*/true));
+}
+
+/*!
+ *  Function pass that prepacks the constant weights of Gemm operations.
+ */
+class PrepackWeightsPass : public PassWrapper<PrepackWeightsPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    auto function = getFunction();
+    OpBuilder builder(&getContext());
+
+    // The reduction reads A along its rows when transA is not set, and B along
+    // its rows when transB is set.
+    SmallVector<ONNXGemmOp, 8> gemmOps;
+    function.walk([&](ONNXGemmOp gemmOp) { gemmOps.emplace_back(gemmOp); });
+    for (auto gemmOp : gemmOps) {
+      if (gemmOp.transA() != 0 && getConstantMatrix(gemmOp.A())) {
+        replaceByTransposedConstant(builder, gemmOp, 0);
+        gemmOp.transAAttr(getTransAttr(builder, 0));
+      }
+      if (gemmOp.transB() == 0 && getConstantMatrix(gemmOp.B())) {
+        replaceByTransposedConstant(builder, gemmOp, 1);
+        gemmOp.transBAttr(getTransAttr(builder, 1));
+      }
+    }
+  }
+};
+} // end anonymous namespace
+
+/*!
+ * Create a weight prepacking pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createPrepackWeightsPass() {
+  return std::make_unique<PrepackWeightsPass>();
+}
@@ -0,0 +1,294 @@
+//===-------- PreprocessInputs.cpp - Preprocess Image Inputs in Model -----===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Vision models take normalized f32 NCHW images, which their clients compute
+// from the bytes of NHWC images, one pass over the image for the conversion,
+// the normalization and the transposition, before the model reads the image
+// again.
+//
+// This file creates a pass which declares the raw images as the inputs of the
+// entry point functions and converts them in the model:
+//
+//   --preprocess-inputs="specs=0:layout=nhwc:dtype=ui8:mean=127.5:std=127.5"
+//   func @main_graph(%arg0: tensor<1x224x224x3xi8>) -> tensor<*xf32> {
+//     %0 = "onnx.ImagePreprocess"(%arg0) {is_unsigned = 1 : si64,
+//         layout = "NHWC", mean = [...], std = [...]} : (...) -> ...
+//
+// Unsigned bytes are read from signless i8 tensors. When the image is only
+// read by a convolution without padding, the normalization is folded into its
+// constant weights and bias, and the conversion only converts and transposes
+// the image:
+//
+//   W'[m][c] = W[m][c] / std[c]
+//   B'[m] = B[m] - sum(W[m][c] * mean[c] / std[c])
+//
+// Padded convolutions pad the normalized image with zeros, which the folding
+// would turn into the means, so their inputs are normalized by the conversion.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Preprocessing of an input of the entry point functions.
+struct InputPreprocessing {
+  int64_t index;
+  bool isNHWC = true;
+  bool isUnsigned = true;
+  Type elementType;
+  SmallVector<float, 4> mean = {0};
+  SmallVector<float, 4> stdDev = {1};
+};
+
+/// Parse a list of values separated by `/`.
+bool parseValues(StringRef str, SmallVectorImpl<float> &values) {
+  SmallVector<StringRef, 4> valueStrs;
+  str.split(valueStrs, '/');
+  values.clear();
+  for (StringRef valueStr : valueStrs) {
+    double value;
+    if (valueStr.trim().getAsDouble(value))
+      return false;
+    values.emplace_back(value);
+  }
+  return true;
+}
+
+/// Parse an input preprocessing given as `<input index>` followed by
+/// `:<key>=<value>` settings, e.g. `0:layout=nhwc:dtype=ui8:mean=127.5`.
+bool parsePreprocessing(
+    MLIRContext *context, StringRef spec, InputPreprocessing &preprocessing) {
+  SmallVector<StringRef, 4> fields;
+  spec.split(fields, ':');
+  if (fields[0].trim().getAsInteger(10, preprocessing.index) ||
+      preprocessing.index < 0)
+    return false;
+  preprocessing.elementType = IntegerType::get(8, context);
+  for (StringRef field : llvm::drop_begin(fields, 1)) {
+    StringRef key, value;
+    std::tie(key, value) = field.split('=');
+    key = key.trim();
+    value = value.trim();
+    if (key == "layout" && value.equals_lower("nhwc"))
+      preprocessing.isNHWC = true;
+    else if (key == "layout" && value.equals_lower("nchw"))
+      preprocessing.isNHWC = false;
+    else if (key == "dtype" && (value == "ui8" || value == "i8")) {
+      preprocessing.elementType = IntegerType::get(8, context);
+      preprocessing.isUnsigned = value == "ui8";
+    } else if (key == "dtype" && value == "f32") {
+      preprocessing.elementType = FloatType::getF32(context);
+      preprocessing.isUnsigned = false;
+    } else if (key == "mean" && parseValues(value, preprocessing.mean))
+      continue;
+    else if (key == "std" && parseValues(value, preprocessing.stdDev))
+      continue;
+    else
+      return false;
+  }
+  return !llvm::is_contained(preprocessing.stdDev, 0.0f);
+}
+
+/// Return the dense value of a constant, or nullptr if it is not a f32
+/// constant of static shape.
+DenseElementsAttr getConstantValue(Value value) {
+  auto constOp = value.getDefiningOp<ONNXConstantOp>();
+  if (!constOp || !constOp.value().hasValue())
+    return nullptr;
+  auto type = value.getType().dyn_cast<RankedTensorType>();
+  if (!type || !type.hasStaticShape() || !type.getElementType().isF32())
+    return nullptr;
+  return constOp.valueAttr().dyn_cast<DenseElementsAttr>();
+}
+
+/// Value of a per-channel attribute for channel `c`, a single value applying
+/// to all the channels.
+float getChannelValue(ArrayAttr values, int64_t c) {
+  auto value = values[values.size() == 1 ? 0 : c];
+  return value.cast<FloatAttr>().getValueAsDouble();
+}
+
+/// Fold the normalization of an image into the weights and bias of the
+/// convolution reading it, if it is its only user and it does not pad it.
+void foldIntoConvolution(OpBuilder &builder, ONNXImagePreprocessOp op) {
+  Value image = op.getResult();
+  if (!image.hasOneUse())
+    return;
+  auto convOp = dyn_cast<ONNXConvOp>(*image.getUsers().begin());
+  if (!convOp || convOp.X() != image || convOp.group() != 1)
+    return;
+  if (convOp.auto_pad() != "NOTSET" && convOp.auto_pad() != "VALID")
+    return;
+  if (auto pads = convOp.pads())
+    if (llvm::any_of(pads.getValue(), [](Attribute pad) {
+          return pad.cast<IntegerAttr>().getInt() != 0;
+        }))
+      return;
+
+  DenseElementsAttr weights = getConstantValue(convOp.W());
+  if (!weights || weights.getType().getRank() < 2)
+    return;
+  bool hasBias = !convOp.B().getType().isa<NoneType>();
+  DenseElementsAttr bias = hasBias ? getConstantValue(convOp.B()) : nullptr;
+  if (hasBias && !bias)
+    return;
+
+  auto weightsType = weights.getType();
+  int64_t numFilters = weightsType.getDimSize(0);
+  int64_t numChannels = weightsType.getDimSize(1);
+  int64_t kernelSize = weightsType.getNumElements() / numFilters / numChannels;
+  ArrayAttr mean = op.mean(), stdDev = op.std();
+  if ((mean.size() != 1 && (int64_t)mean.size() != numChannels) ||
+      (stdDev.size() != 1 && (int64_t)stdDev.size() != numChannels))
+    return;
+
+  SmallVector<float, 64> foldedWeights(weights.getValues<float>());
+  SmallVector<float, 8> foldedBias(numFilters, 0);
+  if (hasBias)
+    foldedBias.assign(bias.getValues<float>().begin(),
+        bias.getValues<float>().end());
+  for (int64_t m = 0; m < numFilters; ++m)
+    for (int64_t c = 0; c < numChannels; ++c) {
+      float scale = 1 / getChannelValue(stdDev, c);
+      float shift = -getChannelValue(mean, c) * scale;
+      for (int64_t k = 0; k < kernelSize; ++k) {
+        float &w = foldedWeights[(m * numChannels + c) * kernelSize + k];
+        foldedBias[m] += w * shift;
+        w *= scale;
+      }
+    }
+
+  builder.setInsertionPoint(convOp);
+  auto biasType =
+      RankedTensorType::get({numFilters}, weightsType.getElementType());
+  Value foldedW = builder.create<ONNXConstantOp>(convOp.getLoc(), weightsType,
+      /*sparse_value=*/nullptr,
+      DenseElementsAttr::get(weightsType, llvm::makeArrayRef(foldedWeights)));
+  Value foldedB = builder.create<ONNXConstantOp>(convOp.getLoc(), biasType,
+      /*sparse_value=*/nullptr,
+      DenseElementsAttr::get(biasType, llvm::makeArrayRef(foldedBias)));
+  Value oldW = convOp.W(), oldB = convOp.B();
+  convOp.setOperand(1, foldedW);
+  convOp.setOperand(2, foldedB);
+  for (Value old : {oldW, oldB})
+    if (old.getDefiningOp<ONNXConstantOp>() && old.use_empty())
+      old.getDefiningOp()->erase();
+
+  op.setAttr("mean", builder.getF32ArrayAttr({0}));
+  op.setAttr("std", builder.getF32ArrayAttr({1}));
+}
+
+/// Declare the raw images as the inputs of the entry point functions and
+/// convert them to the f32 NCHW images the functions read.
+LogicalResult preprocessInputs(ModuleOp module, ArrayRef<std::string> specs) {
+  MLIRContext *context = module.getContext();
+  SmallVector<InputPreprocessing, 4> preprocessings;
+  for (const std::string &spec : specs) {
+    InputPreprocessing preprocessing;
+    if (!parsePreprocessing(context, spec, preprocessing))
+      return module.emitError("invalid input preprocessing '") << spec << "'";
+    preprocessings.emplace_back(preprocessing);
+  }
+
+  SymbolTable symbolTable(module);
+  SmallVector<ONNXEntryPointOp, 1> entryPoints;
+  module.walk([&](ONNXEntryPointOp op) { entryPoints.emplace_back(op); });
+  OpBuilder builder(context);
+  for (auto entryPoint : entryPoints) {
+    auto funcName = entryPoint
+                        .getAttrOfType<SymbolRefAttr>(
+                            ONNXEntryPointOp::getEntryPointFuncAttrName())
+                        .getLeafReference();
+    auto function = symbolTable.lookup<FuncOp>(funcName);
+    if (!function)
+      continue;
+
+    Block &entryBlock = function.getBody().front();
+    auto inputTypes = function.getType().getInputs();
+    SmallVector<Type, 4> argTypes(inputTypes.begin(), inputTypes.end());
+    for (auto &preprocessing : preprocessings) {
+      int64_t index = preprocessing.index;
+      if (index >= (int64_t)argTypes.size())
+        return function.emitError("no input ") << index << " to preprocess";
+      auto type = argTypes[index].dyn_cast<RankedTensorType>();
+      if (!type || type.getRank() != 4 || !type.getElementType().isF32())
+        return function.emitError("input ")
+               << index << " is not a 4D f32 image";
+
+      // The raw image has the layout of the preprocessing.
+      auto shape = type.getShape();
+      SmallVector<int64_t, 4> rawShape(shape.begin(), shape.end());
+      if (preprocessing.isNHWC)
+        rawShape = {shape[0], shape[2], shape[3], shape[1]};
+      argTypes[index] =
+          RankedTensorType::get(rawShape, preprocessing.elementType);
+      BlockArgument arg = entryBlock.getArgument(index);
+      arg.setType(argTypes[index]);
+
+      builder.setInsertionPointToStart(&entryBlock);
+      auto preprocessOp = builder.create<ONNXImagePreprocessOp>(
+          function.getLoc(), type, arg,
+          builder.getF32ArrayAttr(preprocessing.mean),
+          builder.getF32ArrayAttr(preprocessing.stdDev),
+          builder.getStringAttr(preprocessing.isNHWC ? "NHWC" : "NCHW"),
+          IntegerAttr::get(builder.getIntegerType(64, /*isSigned=*/true),
+              APInt(64, preprocessing.isUnsigned, /*isSigned=*/true)));
+      arg.replaceAllUsesExcept(preprocessOp.getResult(),
+          SmallPtrSet<Operation *, 1>{preprocessOp});
+      foldIntoConvolution(builder, preprocessOp);
+    }
+    function.setType(FunctionType::get(
+        argTypes, function.getType().getResults(), context));
+  }
+  return success();
+}
+
+/*!
+ *  Module pass that preprocesses the image inputs of the entry point
+ *  functions.
+ */
+class PreprocessInputsPass
+    : public PassWrapper<PreprocessInputsPass, OperationPass<ModuleOp>> {
+public:
+  PreprocessInputsPass() = default;
+  PreprocessInputsPass(const PreprocessInputsPass &pass) {}
+  PreprocessInputsPass(ArrayRef<std::string> specs) { this->specs = specs; }
+
+  void runOnOperation() override {
+    SmallVector<std::string, 4> preprocessings(specs.begin(), specs.end());
+    if (failed(preprocessInputs(getOperation(), preprocessings)))
+      signalPassFailure();
+  }
+
+private:
+  ListOption<std::string> specs{*this, "specs",
+      llvm::cl::desc("Preprocessings of the inputs, as <input index> "
+                     "followed by :layout=nhwc|nchw, :dtype=ui8|i8|f32, "
+                     ":mean=<values> and :std=<values> with the values of "
+                     "the channels separated by /."),
+      llvm::cl::ZeroOrMore, llvm::cl::MiscFlags::CommaSeparated};
+};
+} // end anonymous namespace
+
+/*!
+ * Create an input preprocessing pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createPreprocessInputsPass() {
+  return std::make_unique<PreprocessInputsPass>();
+}
+
+std::unique_ptr<mlir::Pass> mlir::createPreprocessInputsPass(
+    ArrayRef<std::string> specs) {
+  return std::make_unique<PreprocessInputsPass>(specs);
+}
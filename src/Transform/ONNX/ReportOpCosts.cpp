@@ -0,0 +1,309 @@
+//===--------- ReportOpCosts.cpp - Report the Roofline Costs of Ops -------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file creates a pass which estimates, from the shapes inferred for the
+// ONNX operations, the number of floating-point operations of each operation
+// and the number of bytes it reads and writes, and writes a JSON report of the
+// operations sorted by decreasing cost:
+//
+//   {
+//     "peak_gflops": 100,
+//     "bandwidth_gbps": 10,
+//     "total_flops": 4194304,
+//     "total_bytes": 1572864,
+//     "estimated_time_us": 199.2,
+//     "dynamic_ops": 0,
+//     "ops": [
+//       {
+//         "name": "onnx.MatMul",
+//         "loc": "loc(\"matmul_0\")",
+//         "flops": 4194304,
+//         "bytes_read": 1048576,
+//         "bytes_written": 524288,
+//         "intensity": 2.67,
+//         "bound": "memory",
+//         "estimated_time_us": 157.3
+//       },
+//       ...
+//
+// The estimated time of an operation is its roofline time on a target with the
+// given peak FLOP/s and memory bandwidth: the larger of its FLOPs over the
+// peak FLOP/s and of its bytes over the bandwidth. Comparing it with the
+// profile of the compiled model, see --instrument, shows the operations whose
+// lowering is far from the roofline.
+//
+// The FLOPs of the matrix multiplications and convolutions count a multiply
+// and an add per multiply-accumulate, those of the pooling operations one
+// operation per element of their windows, and the other operations one
+// operation per element of their largest operand or result. The operations of
+// which a type is not statically shaped are only counted in dynamic_ops.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+struct OpCost {
+  std::string name;
+  std::string loc;
+  int64_t flops = 0;
+  int64_t bytesRead = 0;
+  int64_t bytesWritten = 0;
+  double time = 0;
+};
+
+/// Return the number of elements of a statically shaped tensor, 0 for none,
+/// or -1.
+int64_t getNumElements(Type type) {
+  if (type.isa<NoneType>())
+    return 0;
+  auto shapedType = type.dyn_cast<ShapedType>();
+  if (!shapedType || !shapedType.hasStaticShape() ||
+      !shapedType.getElementType().isIntOrFloat())
+    return -1;
+  return shapedType.getNumElements();
+}
+
+/// Return the number of elements of the statically shaped tensors of a range
+/// of values in `sizes`, their sum in bytes, or -1 if a tensor is not
+/// statically shaped.
+int64_t getSizesInBytes(ValueRange values, SmallVectorImpl<int64_t> &sizes) {
+  int64_t bytes = 0;
+  for (Value value : values) {
+    int64_t numElements = getNumElements(value.getType());
+    if (numElements < 0)
+      return -1;
+    sizes.emplace_back(numElements);
+    if (numElements == 0)
+      continue;
+    Type elementType = getElementTypeOrSelf(value.getType());
+    bytes += numElements * ((elementType.getIntOrFloatBitWidth() + 7) / 8);
+  }
+  return bytes;
+}
+
+/// Return the product of the dimensions of a statically shaped value in
+/// [begin, end).
+int64_t getShapeProduct(Value value, int64_t begin, int64_t end) {
+  auto shape = value.getType().cast<ShapedType>().getShape();
+  int64_t product = 1;
+  for (int64_t i = begin; i < end; ++i)
+    product *= shape[i];
+  return product;
+}
+
+/// Estimate the number of floating-point operations of an operation, given
+/// the numbers of elements of its operands and results.
+int64_t estimateFlops(Operation *op, ArrayRef<int64_t> inputSizes,
+    ArrayRef<int64_t> outputSizes) {
+  int64_t outputSize = outputSizes.empty() ? 0 : outputSizes[0];
+  if (auto matMulOp = dyn_cast<ONNXMatMulOp>(op)) {
+    auto aType = matMulOp.A().getType().cast<ShapedType>();
+    int64_t k = aType.getShape().back();
+    return 2 * outputSize * k;
+  }
+  if (auto gemmOp = dyn_cast<ONNXGemmOp>(op)) {
+    auto aShape = gemmOp.A().getType().cast<ShapedType>().getShape();
+    int64_t k = aShape[gemmOp.transA() != 0 ? 0 : 1];
+    bool hasBias = !gemmOp.C().getType().isa<NoneType>();
+    return 2 * outputSize * k + (hasBias ? outputSize : 0);
+  }
+  if (auto convOp = dyn_cast<ONNXConvOp>(op)) {
+    // The weights are [M, C / group, k1, ..., kn].
+    Value W = convOp.W();
+    int64_t rank = W.getType().cast<ShapedType>().getRank();
+    bool hasBias = !convOp.B().getType().isa<NoneType>();
+    return 2 * outputSize * getShapeProduct(W, 1, rank) +
+           (hasBias ? outputSize : 0);
+  }
+  if (auto convTransposeOp = dyn_cast<ONNXConvTransposeOp>(op)) {
+    // Each input element is scattered to C / group times the kernel outputs,
+    // with weights [C, M / group, k1, ..., kn].
+    Value W = convTransposeOp.W();
+    int64_t rank = W.getType().cast<ShapedType>().getRank();
+    return 2 * inputSizes[0] * getShapeProduct(W, 1, rank);
+  }
+  if (auto sparseOp = dyn_cast<ONNXSparseMatMulOp>(op)) {
+    // The non-zero weights of each column are multiplied with each row of A.
+    int64_t numColumns =
+        sparseOp.row_pointers().getType().cast<ShapedType>().getShape()[0] - 1;
+    int64_t numRows = numColumns > 0 ? outputSize / numColumns : 0;
+    return 2 * numRows * inputSizes[3] + (inputSizes[4] > 0 ? outputSize : 0);
+  }
+  // The data movement operations only read and write.
+  if (isa<ONNXReshapeOp, ONNXTransposeOp, ONNXConcatOp, ONNXGatherOp,
+          ONNXSliceOp, ONNXSqueezeOp, ONNXUnsqueezeOp, ONNXIdentityOp,
+          ONNXFlattenOp, ONNXPadOp, ONNXShapeOp, ONNXSplitOp, ONNXTileOp,
+          ONNXExpandOp, ONNXConstantOfShapeOp>(op))
+    return 0;
+  if (auto kernelShape = op->getAttrOfType<ArrayAttr>("kernel_shape")) {
+    int64_t windowSize = 1;
+    for (Attribute dim : kernelShape)
+      windowSize *= dim.cast<IntegerAttr>().getInt();
+    return outputSize * windowSize;
+  }
+  int64_t size = 0;
+  for (int64_t s : inputSizes)
+    size = std::max(size, s);
+  for (int64_t s : outputSizes)
+    size = std::max(size, s);
+  return size;
+}
+
+/// Write the costs of the operations into a JSON report, sorted by decreasing
+/// cost. Writes to the standard error when the filename is "-".
+bool writeReport(const std::string &filename, ArrayRef<OpCost> costs,
+    double peakGFlops, double bandwidthGBps, int64_t numDynamicOps) {
+  std::error_code error;
+  std::unique_ptr<llvm::raw_fd_ostream> file;
+  if (filename != "-") {
+    file = std::make_unique<llvm::raw_fd_ostream>(
+        filename, error, llvm::sys::fs::OF_Text);
+    if (error) {
+      llvm::errs() << "cannot open op cost report " << filename << ": "
+                   << error.message() << "\n";
+      return false;
+    }
+  }
+  llvm::raw_ostream &os = file ? *file : llvm::errs();
+
+  int64_t totalFlops = 0, totalBytes = 0;
+  double totalTime = 0;
+  for (const OpCost &cost : costs) {
+    totalFlops += cost.flops;
+    totalBytes += cost.bytesRead + cost.bytesWritten;
+    totalTime += cost.time;
+  }
+  bool hasRoofline = peakGFlops > 0 && bandwidthGBps > 0;
+
+  llvm::json::OStream json(os, /*IndentSize=*/2);
+  json.object([&] {
+    if (hasRoofline) {
+      json.attribute("peak_gflops", peakGFlops);
+      json.attribute("bandwidth_gbps", bandwidthGBps);
+    }
+    json.attribute("total_flops", totalFlops);
+    json.attribute("total_bytes", totalBytes);
+    if (hasRoofline)
+      json.attribute("estimated_time_us", totalTime * 1e6);
+    json.attribute("dynamic_ops", numDynamicOps);
+    json.attributeArray("ops", [&] {
+      for (const OpCost &cost : costs)
+        json.object([&] {
+          int64_t bytes = cost.bytesRead + cost.bytesWritten;
+          json.attribute("name", cost.name);
+          json.attribute("loc", cost.loc);
+          json.attribute("flops", cost.flops);
+          json.attribute("bytes_read", cost.bytesRead);
+          json.attribute("bytes_written", cost.bytesWritten);
+          if (bytes > 0)
+            json.attribute("intensity", (double)cost.flops / bytes);
+          else
+            json.attribute("intensity", nullptr);
+          if (!hasRoofline)
+            return;
+          // The ridge point of the roofline is the intensity at which the
+          // operation takes as long to compute as to move its bytes.
+          bool isComputeBound =
+              (double)cost.flops * bandwidthGBps >= bytes * peakGFlops;
+          json.attribute("bound", isComputeBound ? "compute" : "memory");
+          json.attribute("estimated_time_us", cost.time * 1e6);
+        });
+    });
+  });
+  os << "\n";
+  return true;
+}
+
+/*!
+ *  Module pass that reports the FLOPs, bytes and roofline times of the ONNX
+ *  operations.
+ */
+class ReportOpCostsPass
+    : public PassWrapper<ReportOpCostsPass, OperationPass<ModuleOp>> {
+public:
+  Option<std::string> reportFile{*this, "report-file",
+      llvm::cl::desc("File the JSON op cost report is written to, or - for "
+                     "the standard error"),
+      llvm::cl::init("-")};
+  Option<double> peakGFlops{*this, "peak-gflops",
+      llvm::cl::desc("Peak GFLOP/s of the target, 0 for no roofline estimate"),
+      llvm::cl::init(0)};
+  Option<double> bandwidthGBps{*this, "bandwidth-gbps",
+      llvm::cl::desc("Memory bandwidth of the target in GB/s, 0 for no "
+                     "roofline estimate"),
+      llvm::cl::init(0)};
+
+  ReportOpCostsPass() = default;
+  ReportOpCostsPass(const ReportOpCostsPass &) {}
+  ReportOpCostsPass(
+      const std::string &reportFile, double peakGFlops, double bandwidthGBps) {
+    this->reportFile = reportFile;
+    this->peakGFlops = peakGFlops;
+    this->bandwidthGBps = bandwidthGBps;
+  }
+
+  void runOnOperation() override {
+    std::vector<OpCost> costs;
+    int64_t numDynamicOps = 0;
+    getOperation().walk([&](Operation *op) {
+      if (op->getName().getDialect() != ONNXOpsDialect::getDialectNamespace() ||
+          isa<ONNXConstantOp, ONNXEntryPointOp>(op))
+        return;
+      SmallVector<int64_t, 4> inputSizes, outputSizes;
+      int64_t bytesRead = getSizesInBytes(op->getOperands(), inputSizes);
+      int64_t bytesWritten = getSizesInBytes(op->getResults(), outputSizes);
+      if (bytesRead < 0 || bytesWritten < 0) {
+        numDynamicOps++;
+        return;
+      }
+      OpCost cost;
+      cost.name = op->getName().getStringRef().str();
+      llvm::raw_string_ostream locStream(cost.loc);
+      op->getLoc().print(locStream);
+      locStream.flush();
+      cost.flops = estimateFlops(op, inputSizes, outputSizes);
+      cost.bytesRead = bytesRead;
+      cost.bytesWritten = bytesWritten;
+      if (peakGFlops > 0 && bandwidthGBps > 0)
+        cost.time = std::max(cost.flops / (peakGFlops * 1e9),
+            (bytesRead + bytesWritten) / (bandwidthGBps * 1e9));
+      costs.emplace_back(std::move(cost));
+    });
+
+    // Without a roofline, the operations are sorted by FLOPs.
+    std::stable_sort(
+        costs.begin(), costs.end(), [](const OpCost &lhs, const OpCost &rhs) {
+          if (lhs.time != rhs.time)
+            return lhs.time > rhs.time;
+          return lhs.flops > rhs.flops;
+        });
+    if (!writeReport(
+            reportFile, costs, peakGFlops, bandwidthGBps, numDynamicOps))
+      signalPassFailure();
+    markAllAnalysesPreserved();
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createReportOpCostsPass() {
+  return std::make_unique<ReportOpCostsPass>();
+}
+
+std::unique_ptr<Pass> mlir::createReportOpCostsPass(
+    const std::string &reportFile, double peakGFlops, double bandwidthGBps) {
+  return std::make_unique<ReportOpCostsPass>(
+      reportFile, peakGFlops, bandwidthGBps);
+}
@@ -12,7 +12,8 @@
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/IR/StandardTypes.h"
 #include "mlir/Pass/Pass.h"
-#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "src/Interface/ShapeInferenceInterface.hpp"
@@ -32,35 +33,55 @@ public:
   void runOnFunction() override {
     auto f = getFunction();
 
-    // Iterate on the operations that need shape inference i.e the operations
-    // that return a dynamic shape or followed by a return op.
+    // Seed the worklist with the operations that need shape inference. These
+    // are the operations returning a dynamic shape, i.e. only the operations
+    // created or left unresolved since a previous run of the pass, and the
+    // operations followed by a return op. The users of an operation whose
+    // result types change are added to the worklist, even if their results
+    // are already ranked. The operations are inferred in program order, so
+    // that the operands of an operation are inferred before it.
+    SmallVector<Operation *, 64> ops;
+    llvm::SetVector<Operation *> worklist;
     f.walk([&](mlir::Operation *op) {
-      // The shape of graph output has been imported from onnx protobuf model,
-      // so the ops followed by a return op may not have dynamic shape output.
-      // However, shape inference is still need on these ops
-      // to infer optional attributes.
-      if (isUsedByReturnOp(op) || returnsDynamicShape(op)) {
-        if (auto shape_op = dyn_cast<ShapeInference>(op)) {
-          if (failed(shape_op.inferShapes())) {
-            op->emitError("shape inference failed");
-            return signalPassFailure();
-          }
-        } else {
-          op->emitError("unable to infer shape of operation without shape "
-                        "inference interface");
-          return signalPassFailure();
-        }
+      ops.emplace_back(op);
+      if (returnsDynamicShape(op)) {
+        worklist.insert(op);
+      } else if (isa<ReturnOp>(op)) {
+        // The shape of graph output has been imported from onnx protobuf
+        // model, so the ops followed by a return op may not have dynamic shape
+        // output. However, shape inference is still need on these ops to infer
+        // optional attributes.
+        for (Value operand : op->getOperands())
+          if (auto *definingOp = operand.getDefiningOp())
+            worklist.insert(definingOp);
       }
     });
 
-    int64_t dynamicOperations = 0;
-    f.walk([&](mlir::Operation *op) {
-      if (returnsDynamicShape(op)) {
-        dynamicOperations++;
+    for (Operation *op : ops) {
+      if (!worklist.count(op))
+        continue;
+      auto shape_op = dyn_cast<ShapeInference>(op);
+      if (!shape_op) {
+        op->emitError("unable to infer shape of operation without shape "
+                      "inference interface");
+        return signalPassFailure();
       }
-    });
+      SmallVector<Type, 4> resultTypes(op->getResultTypes());
+      if (failed(shape_op.inferShapes())) {
+        op->emitError("shape inference failed");
+        return signalPassFailure();
+      }
+      if (std::equal(
+              resultTypes.begin(), resultTypes.end(), op->result_type_begin()))
+        continue;
+      for (Operation *user : op->getUsers())
+        if (isa<ShapeInference>(user))
+          worklist.insert(user);
+    }
 
-    // If any dynamic operations remain, this indicates a failure.
+    // If any dynamic operations remain, this indicates a failure. Operations
+    // outside of the worklist already returned static shapes.
+    int64_t dynamicOperations = llvm::count_if(worklist, returnsDynamicShape);
     if (dynamicOperations != 0) {
       f.emitError("Shape inference failed, ")
           << dynamicOperations << " operations couldn't be inferred\n";
@@ -74,15 +95,6 @@ public:
     }
   }
 
-  static bool isUsedByReturnOp(Operation *op) {
-    for (auto *user : op->getUsers()) {
-      if (dyn_cast<ReturnOp>(user)) {
-        return true;
-      }
-    }
-    return false;
-  }
-
   /*!
    *  Check if the given operation has a dynamically shaped result.
    */
@@ -0,0 +1,170 @@
+//===------ SparsifyWeights.cpp - Store Pruned Weights as Sparse Rows -----===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Pruned models multiply by constant weights of which 80 to 90% are zeros,
+// stored as dense constants: the matrix multiplications read and multiply
+// every zero.
+//
+// This file creates a pass which stores the constant f32 weights of MatMul
+// and Gemm operations with at least a given fraction of zeros in the
+// compressed sparse row (CSR) format, one row per column of the result, and
+// replaces the operations with onnx.SparseMatMul:
+//
+//   %w = "onnx.Constant"() {value = dense<...> : tensor<256x64xf32>}
+//   %y = "onnx.MatMul"(%x, %w) : (tensor<?x256xf32>, tensor<256x64xf32>) -> ...
+//
+// becomes
+//
+//   %rows = "onnx.Constant"() {value = dense<...> : tensor<65xi64>}
+//   %cols = "onnx.Constant"() {value = dense<...> : tensor<nnzxi64>}
+//   %vals = "onnx.Constant"() {value = dense<...> : tensor<nnzxf32>}
+//   %y = "onnx.SparseMatMul"(%x, %rows, %cols, %vals, %none) : ...
+//
+// The alpha of Gemm operations is folded into the values, and their bias is
+// kept when it is a vector added as is.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Return the value of a constant 2-D f32 operand with static shape, or a null
+/// attribute.
+DenseElementsAttr getConstantF32Matrix(Value operand) {
+  auto constOp = operand.getDefiningOp<ONNXConstantOp>();
+  if (!constOp || !constOp.value().hasValue())
+    return nullptr;
+  auto type = operand.getType().dyn_cast<RankedTensorType>();
+  if (!type || type.getRank() != 2 || !type.hasStaticShape() ||
+      !type.getElementType().isF32())
+    return nullptr;
+  return constOp.valueAttr().dyn_cast<DenseElementsAttr>();
+}
+
+/// Test if a value is a ranked f32 tensor with an innermost dimension of the
+/// given size.
+bool isF32Operand(Value operand, int64_t innermostSize) {
+  auto type = operand.getType().dyn_cast<RankedTensorType>();
+  return type && type.getRank() >= 1 && type.getElementType().isF32() &&
+         type.getShape().back() == innermostSize;
+}
+
+/*!
+ *  Function pass that stores the sparse constant weights of matrix
+ *  multiplications in the compressed sparse row format.
+ */
+class SparsifyWeightsPass
+    : public PassWrapper<SparsifyWeightsPass, FunctionPass> {
+public:
+  SparsifyWeightsPass() = default;
+  SparsifyWeightsPass(const SparsifyWeightsPass &pass) {}
+  SparsifyWeightsPass(double threshold) { this->threshold = threshold; }
+
+  void runOnFunction() override {
+    auto function = getFunction();
+    OpBuilder builder(&getContext());
+
+    SmallVector<Operation *, 8> ops;
+    function.walk([&](Operation *op) {
+      if (isa<ONNXMatMulOp, ONNXGemmOp>(op))
+        ops.emplace_back(op);
+    });
+    for (Operation *op : ops) {
+      Value A = op->getOperand(0), W = op->getOperand(1);
+      Value bias;
+      bool isTransposed = false;
+      float alpha = 1;
+      if (auto gemmOp = dyn_cast<ONNXGemmOp>(op)) {
+        // The bias is only kept when it is a vector added as is.
+        bias = gemmOp.C();
+        auto biasType = bias.getType().dyn_cast<RankedTensorType>();
+        bool hasBias = !bias.getType().isa<NoneType>();
+        if (gemmOp.transA() != 0 ||
+            (hasBias && (!biasType || biasType.getRank() != 1 ||
+                            gemmOp.beta().convertToFloat() != 1)))
+          continue;
+        isTransposed = gemmOp.transB() != 0;
+        alpha = gemmOp.alpha().convertToFloat();
+      }
+      DenseElementsAttr weights = getConstantF32Matrix(W);
+      if (!weights)
+        continue;
+      auto shape = weights.getType().getShape();
+      int64_t K = shape[isTransposed ? 1 : 0], N = shape[isTransposed ? 0 : 1];
+      if (!isF32Operand(A, K) ||
+          (isa<ONNXGemmOp>(op) &&
+              A.getType().cast<RankedTensorType>().getRank() != 2) ||
+          (bias && !bias.getType().isa<NoneType>() && !isF32Operand(bias, N)))
+        continue;
+
+      // The non-zero weights of each column of W, in the order of the rows.
+      SmallVector<float, 64> values(weights.getValues<float>());
+      int64_t numZeros = llvm::count(values, 0.0f);
+      if (numZeros == (int64_t)values.size() ||
+          numZeros < threshold * values.size())
+        continue;
+      SmallVector<int64_t, 64> rowPointers = {0}, columnIndices;
+      SmallVector<float, 64> nonZeros;
+      for (int64_t n = 0; n < N; ++n) {
+        for (int64_t k = 0; k < K; ++k) {
+          float w = values[isTransposed ? n * K + k : k * N + n];
+          if (w == 0)
+            continue;
+          columnIndices.emplace_back(k);
+          nonZeros.emplace_back(alpha * w);
+        }
+        rowPointers.emplace_back(columnIndices.size());
+      }
+
+      builder.setInsertionPoint(op);
+      auto createConstant = [&](Type elementType, const auto &values) {
+        auto type = RankedTensorType::get(
+            {(int64_t)values.size()}, elementType);
+        return builder
+            .create<ONNXConstantOp>(op->getLoc(), type,
+                /*sparse_value=*/nullptr,
+                DenseElementsAttr::get(type, llvm::makeArrayRef(values)))
+            .getResult();
+      };
+      if (!bias)
+        bias = builder.create<ConstantOp>(op->getLoc(), builder.getUnitAttr());
+      auto sparseOp = builder.create<ONNXSparseMatMulOp>(op->getLoc(),
+          op->getResult(0).getType(), A,
+          createConstant(builder.getIntegerType(64), rowPointers),
+          createConstant(builder.getIntegerType(64), columnIndices),
+          createConstant(builder.getF32Type(), nonZeros), bias);
+      op->getResult(0).replaceAllUsesWith(sparseOp.getResult());
+      op->erase();
+      if (W.use_empty())
+        W.getDefiningOp()->erase();
+    }
+  }
+
+private:
+  Option<double> threshold{*this, "threshold",
+      llvm::cl::desc("Minimum fraction of zeros of the sparsified weights."),
+      llvm::cl::init(0.8)};
+};
+} // end anonymous namespace
+
+/*!
+ * Create a weight sparsification pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createSparsifyWeightsPass() {
+  return std::make_unique<SparsifyWeightsPass>();
+}
+
+std::unique_ptr<mlir::Pass> mlir::createSparsifyWeightsPass(double threshold) {
+  return std::make_unique<SparsifyWeightsPass>(threshold);
+}
@@ -0,0 +1,366 @@
+//===--- SpecializeBatchSizes.cpp - Specialize Graphs for Batch Sizes -----===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// When the leading dimension of the inputs of a model is dynamic, every loop
+// bound derived from it is only known at run time, which prevents the static
+// shape optimizations of the lowering.
+//
+// This file creates a pass which clones the entry point function for each of a
+// list of batch sizes, with the leading dynamic dimension of its inputs set to
+// the batch size, before shape inference:
+//
+//   func @main_graph(%arg0: tensor<?x10xf32>) -> tensor<*xf32>
+//   func @main_graph_batch8(%arg0: tensor<8x10xf32>) -> tensor<*xf32>
+//   "onnx.EntryPoint"() {func = @main_graph, numInputs = 1 : i32,
+//       numOutputs = 1 : i32, specializations = [@main_graph_batch8],
+//       batchSizes = [8], batchedInputs = [0]} : () -> ()
+//
+// The entry point then calls the specialization matching the leading
+// dimension of the batched inputs at run time, and the generic function
+// otherwise.
+//
+// A second pass specializes the entry point functions for a list of sequence
+// lengths in the same way, along the second dimension of the inputs by
+// default, e.g. [batch, sequence] token inputs of transformer models:
+//
+//   func @main_graph_seq128(%arg0: tensor<?x128xi64>) -> tensor<*xf32>
+//   "onnx.EntryPoint"() {..., specializations = [@main_graph_seq128],
+//       batchSizes = [128], batchedInputs = [0], specializedAxis = 1,
+//       padInputs} : () -> ()
+//
+// With padding, the sequence lengths are sorted and the entry point calls the
+// specialization of the smallest sequence length not below that of the
+// inputs, padded with zeros, so that one specialization serves a bucket of
+// sequence lengths. The outputs then have the padded sequence length.
+//
+// A third pass pins the dimensions of the inputs of the entry point functions
+// once and for all, e.g. for models exported with dynamic dimensions and
+// always run on the same shape:
+//
+//   --pin-input-shapes="shapes=0:1x?x224"
+//   func @main_graph(%arg0: tensor<1x?x224xf32>) -> tensor<*xf32>
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/ONNX/ONNXOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Clone the entry point functions of the module for each of the sizes, with
+/// the dynamic dimension `axis` of their inputs set to the size. The names of
+/// the clones are the name of the function followed by `suffix` and the size.
+void specializeEntryPoints(ModuleOp module, ArrayRef<int64_t> sizes,
+    int64_t axis, StringRef suffix, bool padInputs) {
+  MLIRContext *context = module.getContext();
+  SymbolTable symbolTable(module);
+
+  SmallVector<ONNXEntryPointOp, 1> entryPoints;
+  module.walk([&](ONNXEntryPointOp op) { entryPoints.emplace_back(op); });
+
+  for (auto entryPoint : entryPoints) {
+    if (entryPoint.getAttr(ONNXEntryPointOp::getSpecializationsAttrName()))
+      continue;
+    auto funcName = entryPoint
+                        .getAttrOfType<SymbolRefAttr>(
+                            ONNXEntryPointOp::getEntryPointFuncAttrName())
+                        .getLeafReference();
+    auto function = symbolTable.lookup<FuncOp>(funcName);
+    if (!function)
+      continue;
+
+    // The batched inputs are the ranked inputs with a dynamic dimension at
+    // the specialized axis.
+    SmallVector<int64_t, 4> batchedInputs;
+    auto inputTypes = function.getType().getInputs();
+    for (unsigned i = 0; i < inputTypes.size(); ++i) {
+      auto type = inputTypes[i].dyn_cast<RankedTensorType>();
+      if (type && type.getRank() > axis && type.isDynamicDim(axis))
+        batchedInputs.emplace_back(i);
+    }
+    if (batchedInputs.empty())
+      continue;
+
+    // Padded inputs are freed once the specialization returns, which must not
+    // return them.
+    if (padInputs) {
+      Operation *returnOp = function.getBody().front().getTerminator();
+      if (llvm::any_of(returnOp->getOperands(),
+              [](Value value) { return value.isa<BlockArgument>(); }))
+        continue;
+    }
+
+    OpBuilder builder(context);
+    SmallVector<Attribute, 4> specializations;
+    SmallVector<int64_t, 4> specializedSizes;
+    for (int64_t size : sizes) {
+      if (size <= 0 || llvm::is_contained(specializedSizes, size))
+        continue;
+      FuncOp specialization = function.clone();
+      specialization.setName((Twine(funcName) + suffix + Twine(size)).str());
+      symbolTable.insert(specialization);
+
+      // Only the inputs are specialized, shape inference derives the types of
+      // the operations and of the results from them.
+      Block &entryBlock = specialization.getBody().front();
+      SmallVector<Type, 4> argTypes(inputTypes.begin(), inputTypes.end());
+      for (int64_t i : batchedInputs) {
+        auto type = argTypes[i].cast<RankedTensorType>();
+        SmallVector<int64_t, 4> shape(
+            type.getShape().begin(), type.getShape().end());
+        shape[axis] = size;
+        argTypes[i] = RankedTensorType::get(shape, type.getElementType());
+        entryBlock.getArgument(i).setType(argTypes[i]);
+      }
+      specialization.setType(FunctionType::get(
+          argTypes, specialization.getType().getResults(), context));
+
+      specializations.emplace_back(
+          builder.getSymbolRefAttr(specialization.getName()));
+      specializedSizes.emplace_back(size);
+    }
+    if (specializations.empty())
+      continue;
+
+    entryPoint.setAttr(ONNXEntryPointOp::getSpecializationsAttrName(),
+        builder.getArrayAttr(specializations));
+    entryPoint.setAttr(ONNXEntryPointOp::getBatchSizesAttrName(),
+        builder.getI64ArrayAttr(specializedSizes));
+    entryPoint.setAttr(ONNXEntryPointOp::getBatchedInputsAttrName(),
+        builder.getI64ArrayAttr(batchedInputs));
+    if (axis != 0)
+      entryPoint.setAttr(ONNXEntryPointOp::getSpecializedAxisAttrName(),
+          builder.getI64IntegerAttr(axis));
+    if (padInputs)
+      entryPoint.setAttr(
+          ONNXEntryPointOp::getPadInputsAttrName(), builder.getUnitAttr());
+  }
+}
+
+/// Parse an input shape given as `<input index>:<dims>`, with the dimensions
+/// separated by `x` and `?` for a dynamic dimension, e.g. `0:1x?x224`.
+bool parseInputShape(
+    StringRef spec, int64_t &index, SmallVectorImpl<int64_t> &dims) {
+  StringRef indexStr, dimsStr;
+  std::tie(indexStr, dimsStr) = spec.split(':');
+  if (indexStr.trim().getAsInteger(10, index) || index < 0)
+    return false;
+  dims.clear();
+  // A scalar input has no dimensions.
+  if (dimsStr.trim().empty())
+    return true;
+  SmallVector<StringRef, 4> dimStrs;
+  dimsStr.split(dimStrs, 'x');
+  for (StringRef dimStr : dimStrs) {
+    dimStr = dimStr.trim();
+    int64_t dim;
+    if (dimStr == "?")
+      dim = -1;
+    else if (dimStr.getAsInteger(10, dim) || dim < -1)
+      return false;
+    dims.emplace_back(dim);
+  }
+  return true;
+}
+
+/// Set the dimensions of the inputs of the entry point functions of the
+/// module. Only the dynamic dimensions of the inputs can be pinned.
+LogicalResult pinInputShapes(ModuleOp module, ArrayRef<std::string> specs) {
+  SmallVector<std::pair<int64_t, SmallVector<int64_t, 4>>, 4> shapes;
+  for (const std::string &spec : specs) {
+    int64_t index;
+    SmallVector<int64_t, 4> dims;
+    if (!parseInputShape(spec, index, dims))
+      return module.emitError("invalid input shape '") << spec << "'";
+    shapes.emplace_back(index, dims);
+  }
+
+  SymbolTable symbolTable(module);
+  SmallVector<ONNXEntryPointOp, 1> entryPoints;
+  module.walk([&](ONNXEntryPointOp op) { entryPoints.emplace_back(op); });
+  for (auto entryPoint : entryPoints) {
+    auto funcName = entryPoint
+                        .getAttrOfType<SymbolRefAttr>(
+                            ONNXEntryPointOp::getEntryPointFuncAttrName())
+                        .getLeafReference();
+    auto function = symbolTable.lookup<FuncOp>(funcName);
+    if (!function)
+      continue;
+
+    Block &entryBlock = function.getBody().front();
+    auto inputTypes = function.getType().getInputs();
+    SmallVector<Type, 4> argTypes(inputTypes.begin(), inputTypes.end());
+    for (auto &shape : shapes) {
+      int64_t index = shape.first;
+      ArrayRef<int64_t> dims = shape.second;
+      if (index >= (int64_t)argTypes.size())
+        return function.emitError("no input ") << index << " to pin";
+      auto type = argTypes[index].dyn_cast<TensorType>();
+      if (!type)
+        return function.emitError("input ") << index << " is not a tensor";
+      SmallVector<int64_t, 4> pinned(dims.begin(), dims.end());
+      if (type.hasRank()) {
+        if (type.getRank() != (int64_t)dims.size())
+          return function.emitError("input ")
+                 << index << " has rank " << type.getRank() << ", not "
+                 << dims.size();
+        for (unsigned i = 0; i < pinned.size(); ++i) {
+          if (type.isDynamicDim(i))
+            continue;
+          if (pinned[i] >= 0 && pinned[i] != type.getDimSize(i))
+            return function.emitError("dimension ")
+                   << i << " of input " << index << " is "
+                   << type.getDimSize(i) << ", not " << pinned[i];
+          pinned[i] = type.getDimSize(i);
+        }
+      }
+      argTypes[index] = RankedTensorType::get(pinned, type.getElementType());
+      entryBlock.getArgument(index).setType(argTypes[index]);
+    }
+    function.setType(FunctionType::get(
+        argTypes, function.getType().getResults(), module.getContext()));
+  }
+  return success();
+}
+
+/*!
+ *  Module pass that pins the dimensions of the inputs of the entry point
+ *  functions.
+ */
+class PinInputShapesPass
+    : public PassWrapper<PinInputShapesPass, OperationPass<ModuleOp>> {
+public:
+  PinInputShapesPass() = default;
+  PinInputShapesPass(const PinInputShapesPass &pass) {}
+  PinInputShapesPass(ArrayRef<std::string> shapes) { this->shapes = shapes; }
+
+  void runOnOperation() override {
+    SmallVector<std::string, 4> specs(shapes.begin(), shapes.end());
+    if (failed(pinInputShapes(getOperation(), specs)))
+      signalPassFailure();
+  }
+
+private:
+  ListOption<std::string> shapes{*this, "shapes",
+      llvm::cl::desc("Shapes of the inputs, as <input index>:<dims> with the "
+                     "dimensions separated by x and ? for a dynamic "
+                     "dimension."),
+      llvm::cl::ZeroOrMore, llvm::cl::MiscFlags::CommaSeparated};
+};
+
+/*!
+ *  Module pass that specializes the entry point functions for batch sizes.
+ */
+class SpecializeBatchSizesPass
+    : public PassWrapper<SpecializeBatchSizesPass, OperationPass<ModuleOp>> {
+public:
+  /// Make sure that we have a valid default constructor and copy constructor to
+  /// make sure that the options are initialized properly.
+  SpecializeBatchSizesPass() = default;
+  SpecializeBatchSizesPass(const SpecializeBatchSizesPass &pass) {}
+  SpecializeBatchSizesPass(ArrayRef<int64_t> batchSizes) {
+    this->batchSizes = batchSizes;
+  }
+
+  void runOnOperation() override {
+    SmallVector<int64_t, 8> sizes(batchSizes.begin(), batchSizes.end());
+    specializeEntryPoints(getOperation(), sizes, /*axis=*/0,
+        ONNXEntryPointOp::getSpecializationFuncSuffix(),
+        /*padInputs=*/false);
+  }
+
+private:
+  ListOption<int64_t> batchSizes{*this, "batch-sizes",
+      llvm::cl::desc("Batch sizes to specialize the entry point functions "
+                     "for."),
+      llvm::cl::ZeroOrMore, llvm::cl::MiscFlags::CommaSeparated};
+};
+
+/*!
+ *  Module pass that specializes the entry point functions for sequence
+ *  lengths.
+ */
+class SpecializeSequenceLengthsPass
+    : public PassWrapper<SpecializeSequenceLengthsPass,
+          OperationPass<ModuleOp>> {
+public:
+  SpecializeSequenceLengthsPass() = default;
+  SpecializeSequenceLengthsPass(const SpecializeSequenceLengthsPass &pass) {}
+  SpecializeSequenceLengthsPass(
+      ArrayRef<int64_t> sequenceLengths, int64_t axis, bool padInputs) {
+    this->sequenceLengths = sequenceLengths;
+    this->axis = axis;
+    this->padInputs = padInputs;
+  }
+
+  void runOnOperation() override {
+    if (axis < 0)
+      return;
+    // The entry point calls the first specialization the inputs fit in.
+    SmallVector<int64_t, 8> sizes(
+        sequenceLengths.begin(), sequenceLengths.end());
+    llvm::sort(sizes);
+    specializeEntryPoints(getOperation(), sizes, axis,
+        ONNXEntryPointOp::getSequenceSpecializationFuncSuffix(), padInputs);
+  }
+
+private:
+  ListOption<int64_t> sequenceLengths{*this, "sequence-lengths",
+      llvm::cl::desc("Sequence lengths to specialize the entry point "
+                     "functions for."),
+      llvm::cl::ZeroOrMore, llvm::cl::MiscFlags::CommaSeparated};
+  Option<int64_t> axis{*this, "axis",
+      llvm::cl::desc("Dimension of the inputs holding the sequence length."),
+      llvm::cl::init(1)};
+  Option<bool> padInputs{*this, "pad",
+      llvm::cl::desc("Pad the inputs to the smallest sequence length they fit "
+                     "in."),
+      llvm::cl::init(false)};
+};
+} // end anonymous namespace
+
+/*!
+ * Create a batch size specialization pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createSpecializeBatchSizesPass() {
+  return std::make_unique<SpecializeBatchSizesPass>();
+}
+
+std::unique_ptr<mlir::Pass> mlir::createSpecializeBatchSizesPass(
+    ArrayRef<int64_t> batchSizes) {
+  return std::make_unique<SpecializeBatchSizesPass>(batchSizes);
+}
+
+/*!
+ * Create an input shape pinning pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createPinInputShapesPass() {
+  return std::make_unique<PinInputShapesPass>();
+}
+
+std::unique_ptr<mlir::Pass> mlir::createPinInputShapesPass(
+    ArrayRef<std::string> shapes) {
+  return std::make_unique<PinInputShapesPass>(shapes);
+}
+
+/*!
+ * Create a sequence length specialization pass.
+ */
+std::unique_ptr<mlir::Pass> mlir::createSpecializeSequenceLengthsPass() {
+  return std::make_unique<SpecializeSequenceLengthsPass>();
+}
+
+std::unique_ptr<mlir::Pass> mlir::createSpecializeSequenceLengthsPass(
+    ArrayRef<int64_t> sequenceLengths, int64_t axis, bool padInputs) {
+  return std::make_unique<SpecializeSequenceLengthsPass>(
+      sequenceLengths, axis, padInputs);
+}
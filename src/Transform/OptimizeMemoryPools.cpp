@@ -0,0 +1,202 @@
+//===-- OptimizeMemoryPools.cpp - Reuse memory in static memory pools -----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The BundleMemoryPools pass places all the internal MemRefs of a block end to
+// end in a single static memory pool, so the size of the pool is the sum of
+// the sizes of all the internal MemRefs. This pass computes the live range of
+// each MemRef of a static memory pool and assigns overlapping offsets to the
+// MemRefs whose live ranges do not intersect, so the size of the pool becomes
+// close to the maximum size of the MemRefs live at the same time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+//===----------------------------------------------------------------------===//
+// Data structures for managing memory pools.
+//===----------------------------------------------------------------------===//
+
+// A MemRef of a static memory pool. Its live range is the interval [start,
+// end] of the positions, in the block of the memory pool, of the operations
+// using it.
+struct PoolSlot {
+  KrnlGetRefOp getRef;
+  int64_t size;
+  int64_t alignment;
+  int64_t start;
+  int64_t end;
+  int64_t offset = 0;
+
+  bool interferesWith(const PoolSlot &other) const {
+    return start <= other.end && other.start <= end;
+  }
+};
+
+//===----------------------------------------------------------------------===//
+// Helper functions.
+//===----------------------------------------------------------------------===//
+
+/// Compute the live range of the MemRef returned by a krnl.getref. Uses nested
+/// in other operations of the block extend the range to these operations.
+/// Uses through an operation that may alias the MemRef, i.e. an operation
+/// returning a MemRef, keep it live until the end of the block.
+bool computeLiveRange(KrnlGetRefOp getRef, Block *block,
+    const llvm::DenseMap<Operation *, int64_t> &positions, PoolSlot &slot) {
+  int64_t blockEnd = positions.size();
+  slot.start = blockEnd;
+  slot.end = -1;
+  for (Operation *user : getRef.getResult().getUsers()) {
+    Operation *ancestor = block->findAncestorOpInBlock(*user);
+    if (!ancestor)
+      return false;
+    int64_t position = positions.lookup(ancestor);
+    slot.start = std::min(slot.start, position);
+    slot.end = std::max(slot.end, position);
+    if (llvm::any_of(user->getResultTypes(),
+            [](Type type) { return type.isa<BaseMemRefType>(); }))
+      slot.end = blockEnd;
+  }
+  // An unused MemRef does not need any memory, keep it at offset 0.
+  if (slot.end < 0)
+    slot.start = slot.end = blockEnd + 1;
+  return true;
+}
+
+/// Assign offsets to the slots by decreasing size, then by increasing start of
+/// their live range. Each slot is placed at the lowest aligned offset that does
+/// not overlap the memory of the already placed slots whose live ranges
+/// intersect its own. Returns the size of the memory pool.
+int64_t assignOffsets(SmallVectorImpl<PoolSlot> &slots) {
+  SmallVector<PoolSlot *, 16> order;
+  for (auto &slot : slots)
+    order.emplace_back(&slot);
+  llvm::sort(order, [](PoolSlot *lhs, PoolSlot *rhs) {
+    if (lhs->size != rhs->size)
+      return lhs->size > rhs->size;
+    return lhs->start < rhs->start;
+  });
+
+  int64_t poolSize = 0;
+  SmallVector<PoolSlot *, 16> placed;
+  for (PoolSlot *slot : order) {
+    SmallVector<PoolSlot *, 16> interfering;
+    for (PoolSlot *other : placed)
+      if (slot->interferesWith(*other))
+        interfering.emplace_back(other);
+    llvm::sort(interfering, [](PoolSlot *lhs, PoolSlot *rhs) {
+      return lhs->offset < rhs->offset;
+    });
+
+    // Find the first gap large enough between the interfering slots.
+    int64_t offset = 0;
+    for (PoolSlot *other : interfering) {
+      if (offset + slot->size <= other->offset)
+        break;
+      offset = std::max(offset, other->offset + other->size);
+      offset = llvm::alignTo(offset, slot->alignment);
+    }
+    slot->offset = offset;
+    poolSize = std::max(poolSize, offset + slot->size);
+    placed.emplace_back(slot);
+  }
+  return poolSize;
+}
+
+/// Reassign the offsets of the MemRefs of a static memory pool. Pools whose
+/// MemRefs are not all obtained with constant offsets in the block of the
+/// pool are left unchanged.
+void optimizeStaticMemoryPool(AllocOp memPool) {
+  auto memPoolType = convertToMemRefType(memPool.getResult().getType());
+  if (!hasAllConstantDimensions(memPoolType) ||
+      memPoolType.getShape().size() != 1 ||
+      getMemRefEltSizeInBytes(memPoolType) != 1)
+    return;
+
+  // Live ranges are only computed in the body of the function, where each
+  // operation is executed once.
+  Block *block = memPool.getOperation()->getBlock();
+  if (!isa<FuncOp>(block->getParentOp()))
+    return;
+
+  llvm::DenseMap<Operation *, int64_t> positions;
+  for (Operation &op : *block)
+    positions.try_emplace(&op, positions.size());
+
+  SmallVector<PoolSlot, 16> slots;
+  for (Operation *user : memPool.getResult().getUsers()) {
+    if (isa<DeallocOp>(user))
+      continue;
+    auto getRef = dyn_cast<KrnlGetRefOp>(user);
+    if (!getRef || getRef.getOperation()->getBlock() != block ||
+        !getRef.offset().getDefiningOp<ConstantOp>())
+      return;
+    auto memRefType = convertToMemRefType(getRef.getResult().getType());
+    if (!hasAllConstantDimensions(memRefType))
+      return;
+
+    PoolSlot slot;
+    slot.getRef = getRef;
+    slot.size = getMemRefSizeInBytes(getRef.getResult());
+    slot.alignment = getMemRefEltSizeInBytes(memRefType);
+    if (!computeLiveRange(getRef, block, positions, slot))
+      return;
+    slots.emplace_back(slot);
+  }
+  if (slots.size() < 2)
+    return;
+
+  int64_t poolSize = assignOffsets(slots);
+  if (poolSize >= memPoolType.getShape()[0])
+    return;
+
+  // Emit the new memory pool and the new offsets.
+  OpBuilder builder(memPool);
+  auto newMemPool = builder.create<AllocOp>(memPool.getLoc(),
+      MemRefType::get({poolSize}, builder.getIntegerType(8)));
+  for (auto &slot : slots) {
+    builder.setInsertionPoint(slot.getRef);
+    auto offset = builder.create<ConstantOp>(slot.getRef.getLoc(),
+        builder.getIntegerAttr(builder.getIntegerType(64), slot.offset));
+    slot.getRef.getOperation()->setOperand(1, offset);
+  }
+  memPool.getResult().replaceAllUsesWith(newMemPool.getResult());
+  memPool.erase();
+}
+
+/*!
+ *  Function pass that reuses the memory of static memory pools across MemRefs
+ *  with disjoint live ranges.
+ */
+class KrnlOptimizeMemoryPoolsPass
+    : public PassWrapper<KrnlOptimizeMemoryPoolsPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    auto function = getFunction();
+
+    SmallVector<AllocOp, 4> memPools;
+    function.walk([&](AllocOp allocOp) {
+      if (checkOpResultIsUsedByGetRef(&allocOp))
+        memPools.emplace_back(allocOp);
+    });
+    for (auto memPool : memPools)
+      optimizeStaticMemoryPool(memPool);
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createKrnlOptimizeMemoryPoolsPass() {
+  return std::make_unique<KrnlOptimizeMemoryPoolsPass>();
+}
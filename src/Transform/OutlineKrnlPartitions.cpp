@@ -0,0 +1,252 @@
+//===------ OutlineKrnlPartitions.cpp - Outline Partitions of Functions ---===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The function passes are run in parallel on the functions of a module, but a
+// model is lowered to a single function: the lowering of its loop nests to
+// affine loops, to the standard dialect and the canonicalizations all run on
+// one thread. This pass splits the top-level operations of the functions into
+// contiguous partitions of about as many nested operations, which are outlined
+// into private functions called in order, so that the function passes run on
+// the partitions in parallel.
+//
+// The partitions only exchange MemRefs and scalars: the constants they use are
+// cloned into them, so that they remain foldable and usable in affine maps,
+// and a partition never ends between the definition of Krnl loops and their
+// krnl.iterate. The buffers are allocated and freed where they were, and the
+// outlined functions only pass pointers to them around.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Pass/Pass.h"
+#include "llvm/ADT/SetVector.h"
+
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Test if the values of a type can be passed to and returned from functions.
+bool isPassable(Type type) {
+  return type.isa<MemRefType>() || type.isa<IndexType>() ||
+         type.isa<IntegerType>() || type.isa<FloatType>();
+}
+
+/// Redirect the uses of a value inside or outside an operation to another.
+void replaceUses(Value value, Value replacement, Operation *op, bool inside) {
+  for (OpOperand &use : llvm::make_early_inc_range(value.getUses()))
+    if (op->isAncestor(use.getOwner()) == inside)
+      use.set(replacement);
+}
+
+/// Outline consecutive top-level operations of a function into a private
+/// function called in their place and inserted after another. The constants
+/// are left in the function. Return a null function and leave the function
+/// unchanged if a value crossing the partition cannot be passed.
+FuncOp outlinePartition(FuncOp function, ArrayRef<Operation *> partitionOps,
+    SymbolTable &symbolTable, Operation *insertAfter, unsigned index) {
+  Block &body = function.getBody().front();
+  SmallVector<Operation *, 16> ops;
+  for (Operation *op : partitionOps)
+    if (!isa<ConstantOp>(op))
+      ops.emplace_back(op);
+  if (ops.empty())
+    return nullptr;
+  llvm::SmallPtrSet<Operation *, 16> partition(ops.begin(), ops.end());
+  auto isInPartition = [&](Operation *op) {
+    Operation *ancestor = body.findAncestorOpInBlock(*op);
+    return ancestor && partition.count(ancestor);
+  };
+  auto isDefinedInPartition = [&](Value value) {
+    Operation *owner = value.getDefiningOp();
+    return isInPartition(
+        owner ? owner : value.getParentBlock()->getParentOp());
+  };
+
+  // The values used in the partition and defined before it, and those defined
+  // in the partition and used after it.
+  llvm::SetVector<Value> inputs, outputs;
+  llvm::SetVector<Operation *> constants;
+  for (Operation *op : ops) {
+    op->walk([&](Operation *nestedOp) {
+      for (Value operand : nestedOp->getOperands()) {
+        if (isDefinedInPartition(operand))
+          continue;
+        if (auto constOp = operand.getDefiningOp<ConstantOp>())
+          constants.insert(constOp);
+        else
+          inputs.insert(operand);
+      }
+    });
+    for (Value result : op->getResults())
+      if (llvm::any_of(result.getUsers(),
+              [&](Operation *user) { return !isInPartition(user); }))
+        outputs.insert(result);
+  }
+  auto isValuePassable = [](Value value) {
+    return isPassable(value.getType());
+  };
+  if (!llvm::all_of(inputs, isValuePassable) ||
+      !llvm::all_of(outputs, isValuePassable))
+    return nullptr;
+
+  MLIRContext *context = function.getContext();
+  Location loc = ops.front()->getLoc();
+  SmallVector<Type, 8> inputTypes, outputTypes;
+  for (Value input : inputs)
+    inputTypes.emplace_back(input.getType());
+  for (Value output : outputs)
+    outputTypes.emplace_back(output.getType());
+  auto outlined = FuncOp::create(loc,
+      (function.getName() + "_part" + Twine(index)).str(),
+      FunctionType::get(inputTypes, outputTypes, context));
+  outlined.setAttr(
+      KrnlOpsDialect::getOutlinedAttrName(), UnitAttr::get(context));
+  symbolTable.insert(outlined, std::next(Block::iterator(insertAfter)));
+  SymbolTable::setSymbolVisibility(outlined, SymbolTable::Visibility::Private);
+
+  // The operations are moved into the outlined function, where their uses of
+  // the inputs and constants are redirected to its arguments and to copies of
+  // the constants.
+  Block *entryBlock = outlined.addEntryBlock();
+  Operation *next = partitionOps.back()->getNextNode();
+  for (Operation *op : ops)
+    op->moveBefore(entryBlock, entryBlock->end());
+  OpBuilder builder = OpBuilder::atBlockBegin(entryBlock);
+  for (Operation *constOp : constants)
+    replaceUses(constOp->getResult(0), builder.clone(*constOp)->getResult(0),
+        outlined, /*inside=*/true);
+  for (auto input : llvm::enumerate(inputs))
+    replaceUses(input.value(), entryBlock->getArgument(input.index()),
+        outlined, /*inside=*/true);
+  builder.setInsertionPointToEnd(entryBlock);
+  builder.create<ReturnOp>(loc, outputs.getArrayRef());
+
+  builder.setInsertionPoint(next);
+  auto callOp = builder.create<CallOp>(loc, outlined, inputs.getArrayRef());
+  for (auto output : llvm::enumerate(outputs))
+    replaceUses(output.value(), callOp.getResult(output.index()), outlined,
+        /*inside=*/false);
+  return outlined;
+}
+
+/// Return the number of operations nested in an operation, itself included.
+int64_t getNumNestedOps(Operation *op) {
+  int64_t numOps = 0;
+  op->walk([&](Operation *) { ++numOps; });
+  return numOps;
+}
+
+/*!
+ *  Module pass that outlines the partitions of the functions into functions
+ *  compiled in parallel.
+ */
+class KrnlOutlinePartitionsPass
+    : public PassWrapper<KrnlOutlinePartitionsPass, OperationPass<ModuleOp>> {
+public:
+  KrnlOutlinePartitionsPass() = default;
+  KrnlOutlinePartitionsPass(const KrnlOutlinePartitionsPass &pass) {}
+  KrnlOutlinePartitionsPass(int64_t numPartitions) {
+    this->numPartitions = numPartitions;
+  }
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    SymbolTable symbolTable(module);
+    SmallVector<FuncOp, 4> functions;
+    for (FuncOp function : module.getOps<FuncOp>())
+      if (!function.isExternal() &&
+          !function.getAttr(KrnlOpsDialect::getOutlinedAttrName()))
+        functions.emplace_back(function);
+    for (FuncOp function : functions)
+      partitionFunction(function, symbolTable);
+  }
+
+private:
+  void partitionFunction(FuncOp function, SymbolTable &symbolTable) {
+    if (!llvm::hasSingleElement(function.getBody()))
+      return;
+    Block &body = function.getBody().front();
+    SmallVector<Operation *, 64> ops;
+    for (Operation &op : body.without_terminator())
+      ops.emplace_back(&op);
+    if (numPartitions < 2 || (int64_t)ops.size() < numPartitions)
+      return;
+
+    // A partition may end before an operation if no value defined before it
+    // and used after it, e.g. Krnl loops, cannot be passed.
+    llvm::DenseMap<Operation *, size_t> positions;
+    for (auto op : llvm::enumerate(ops))
+      positions[op.value()] = op.index();
+    SmallVector<bool, 64> canEndBefore(ops.size(), true);
+    size_t lastUse = 0;
+    for (size_t i = 0; i < ops.size(); ++i) {
+      canEndBefore[i] = lastUse < i;
+      for (Value result : ops[i]->getResults()) {
+        if (isPassable(result.getType()))
+          continue;
+        for (Operation *user : result.getUsers())
+          if (Operation *ancestor = body.findAncestorOpInBlock(*user))
+            if (positions.count(ancestor))
+              lastUse = std::max(lastUse, positions[ancestor]);
+      }
+    }
+
+    // Partitions of about the same number of operations, ending as soon as
+    // possible after their share of the operations.
+    SmallVector<int64_t, 64> numNestedOps;
+    int64_t totalNumOps = 0;
+    for (Operation *op : ops) {
+      numNestedOps.emplace_back(getNumNestedOps(op));
+      totalNumOps += numNestedOps.back();
+    }
+    SmallVector<size_t, 8> begins = {0};
+    int64_t numOps = 0;
+    for (size_t i = 0; i < ops.size(); ++i) {
+      if (numOps >= totalNumOps * (int64_t)begins.size() / numPartitions &&
+          canEndBefore[i] && i > begins.back())
+        begins.emplace_back(i);
+      numOps += numNestedOps[i];
+    }
+    begins.emplace_back(ops.size());
+    if (begins.size() < 3)
+      return;
+
+    // Only the partitions with loop nests are worth outlining.
+    auto opsRef = llvm::makeArrayRef(ops);
+    Operation *insertAfter = function;
+    for (size_t p = 0; p + 1 < begins.size(); ++p) {
+      auto partition = opsRef.slice(begins[p], begins[p + 1] - begins[p]);
+      bool hasLoops = llvm::any_of(partition, [](Operation *op) {
+        return op->walk([](KrnlIterateOp) { return WalkResult::interrupt(); })
+            .wasInterrupted();
+      });
+      if (!hasLoops)
+        continue;
+      if (FuncOp outlined = outlinePartition(
+              function, partition, symbolTable, insertAfter, p))
+        insertAfter = outlined;
+    }
+  }
+
+  Option<int64_t> numPartitions{*this, "num-partitions",
+      llvm::cl::desc("Number of partitions of the functions."),
+      llvm::cl::init(2)};
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createKrnlOutlinePartitionsPass() {
+  return std::make_unique<KrnlOutlinePartitionsPass>();
+}
+
+std::unique_ptr<Pass> mlir::createKrnlOutlinePartitionsPass(
+    int64_t numPartitions) {
+  return std::make_unique<KrnlOutlinePartitionsPass>(numPartitions);
+}
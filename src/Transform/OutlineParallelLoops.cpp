@@ -0,0 +1,189 @@
+//===------- OutlineParallelLoops.cpp - Outline Parallel Loops to Threads -===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The loops marked krnl.parallel are lowered to scf.parallel loops through the
+// Affine dialect, which the conversion to the CFG turns into sequential loops.
+// This pass outlines the outermost scf.parallel loops of the functions into
+// private functions running a range [begin, end) of the iterations of their
+// first dimension, and replaces the loops by krnl.parallel_for operations,
+// lowered to calls to the runtime, which splits the iterations across its
+// loop threads.
+//
+// The outlined functions take the values used by the loops as arguments,
+// but for the constants, which are cloned into them, so that they remain
+// foldable. Loops using values which cannot be passed, loops with reductions
+// and loops with fewer than two iterations are left sequential.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/SCF/SCF.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/BlockAndValueMapping.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Pass/Pass.h"
+#include "mlir/Transforms/RegionUtils.h"
+#include "llvm/ADT/SetVector.h"
+
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// Test if the values of a type can be passed to functions.
+bool isPassable(Type type) {
+  return type.isa<MemRefType>() || type.isa<IndexType>() ||
+         type.isa<IntegerType>() || type.isa<FloatType>();
+}
+
+/// Return the number of iterations of the first dimension of a parallel loop
+/// if it is known at compile time, -1 otherwise.
+int64_t getConstantNumIterations(scf::ParallelOp parallelOp) {
+  auto lb = parallelOp.lowerBound()[0].getDefiningOp<ConstantIndexOp>();
+  auto ub = parallelOp.upperBound()[0].getDefiningOp<ConstantIndexOp>();
+  auto step = parallelOp.step()[0].getDefiningOp<ConstantIndexOp>();
+  if (!lb || !ub || !step || step.getValue() <= 0)
+    return -1;
+  int64_t size = ub.getValue() - lb.getValue();
+  return size <= 0 ? 0 : (size + step.getValue() - 1) / step.getValue();
+}
+
+/// Outline a parallel loop into a private function running the iterations
+/// [begin, end) of its first dimension, inserted before the function, and
+/// replace the loop by a krnl.parallel_for calling it. Return failure and
+/// leave the loop unchanged if a value used by the loop cannot be passed.
+LogicalResult outlineParallelLoop(scf::ParallelOp parallelOp, FuncOp function,
+    SymbolTable &symbolTable, unsigned index, int64_t numThreads) {
+  Operation *op = parallelOp.getOperation();
+  llvm::SetVector<Value> values;
+  values.insert(op->getOperands().begin(), op->getOperands().end());
+  getUsedValuesDefinedAbove(op->getRegions(), values);
+  SmallVector<Value, 8> captures;
+  SmallVector<Operation *, 8> constants;
+  for (Value value : values) {
+    if (auto constOp = value.getDefiningOp<ConstantOp>())
+      constants.emplace_back(constOp);
+    else if (isPassable(value.getType()))
+      captures.emplace_back(value);
+    else
+      return failure();
+  }
+
+  MLIRContext *context = function.getContext();
+  Location loc = parallelOp.getLoc();
+  Type indexType = IndexType::get(context);
+  SmallVector<Type, 8> inputTypes = {indexType, indexType};
+  for (Value capture : captures)
+    inputTypes.emplace_back(capture.getType());
+  auto outlined = FuncOp::create(loc,
+      (function.getName() + "_parallel" + Twine(index)).str(),
+      FunctionType::get(inputTypes, {}, context));
+  outlined.setAttr(
+      KrnlOpsDialect::getOutlinedAttrName(), UnitAttr::get(context));
+  symbolTable.insert(outlined, Block::iterator(function));
+  SymbolTable::setSymbolVisibility(outlined, SymbolTable::Visibility::Private);
+
+  // The loop is cloned into the outlined function, with the bounds of its
+  // first dimension restricted to the iterations [begin, end).
+  Block *entryBlock = outlined.addEntryBlock();
+  OpBuilder builder = OpBuilder::atBlockBegin(entryBlock);
+  BlockAndValueMapping mapping;
+  for (Operation *constOp : constants)
+    mapping.map(constOp->getResult(0), builder.clone(*constOp)->getResult(0));
+  for (auto capture : llvm::enumerate(captures))
+    mapping.map(capture.value(), entryBlock->getArgument(2 + capture.index()));
+  Value lb = mapping.lookup(parallelOp.lowerBound()[0]);
+  Value ub = mapping.lookup(parallelOp.upperBound()[0]);
+  Value step = mapping.lookup(parallelOp.step()[0]);
+  Value begin = builder.create<AddIOp>(loc, lb,
+      builder.create<MulIOp>(loc, entryBlock->getArgument(0), step));
+  Value end = builder.create<AddIOp>(loc, lb,
+      builder.create<MulIOp>(loc, entryBlock->getArgument(1), step));
+  Value isBeforeUb = builder.create<CmpIOp>(loc, CmpIPredicate::slt, end, ub);
+  end = builder.create<SelectOp>(loc, isBeforeUb, end, ub);
+  Operation *clone = builder.clone(*op, mapping);
+  clone->setOperand(0, begin);
+  clone->setOperand(parallelOp.getNumLoops(), end);
+  builder.create<ReturnOp>(loc);
+
+  // The number of iterations ceildiv(ub - lb, step), the steps of parallel
+  // loops being positive.
+  builder.setInsertionPoint(op);
+  lb = parallelOp.lowerBound()[0];
+  ub = parallelOp.upperBound()[0];
+  step = parallelOp.step()[0];
+  Value one = builder.create<ConstantIndexOp>(loc, 1);
+  Value numIterations = builder.create<SignedDivIOp>(loc,
+      builder.create<SubIOp>(loc,
+          builder.create<AddIOp>(loc, builder.create<SubIOp>(loc, ub, lb),
+              step),
+          one),
+      step);
+  builder.create<KrnlParallelForOp>(loc, numIterations, captures,
+      builder.getSymbolRefAttr(outlined.getName()),
+      builder.getI64IntegerAttr(numThreads));
+  op->erase();
+  return success();
+}
+
+/*!
+ *  Module pass that outlines the outermost parallel loops of the functions
+ *  and runs them on the threads of the runtime.
+ */
+class KrnlOutlineParallelLoopsPass
+    : public PassWrapper<KrnlOutlineParallelLoopsPass,
+          OperationPass<ModuleOp>> {
+public:
+  KrnlOutlineParallelLoopsPass() = default;
+  KrnlOutlineParallelLoopsPass(const KrnlOutlineParallelLoopsPass &pass) {}
+  KrnlOutlineParallelLoopsPass(int64_t numThreads) {
+    this->numThreads = numThreads;
+  }
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    SymbolTable symbolTable(module);
+    SmallVector<FuncOp, 4> functions;
+    for (FuncOp function : module.getOps<FuncOp>())
+      if (!function.isExternal())
+        functions.emplace_back(function);
+    for (FuncOp function : functions) {
+      SmallVector<scf::ParallelOp, 4> parallelOps;
+      function.walk([&](scf::ParallelOp parallelOp) {
+        Operation *op = parallelOp.getOperation();
+        int64_t numIterations = getConstantNumIterations(parallelOp);
+        if (!op->getParentOfType<scf::ParallelOp>() &&
+            op->getNumResults() == 0 &&
+            (numIterations < 0 || numIterations >= 2))
+          parallelOps.emplace_back(parallelOp);
+      });
+      unsigned index = 0;
+      for (scf::ParallelOp parallelOp : parallelOps)
+        if (succeeded(outlineParallelLoop(
+                parallelOp, function, symbolTable, index, numThreads)))
+          ++index;
+    }
+  }
+
+private:
+  Option<int64_t> numThreads{*this, "num-threads",
+      llvm::cl::desc("Maximum number of threads running each parallel loop, "
+                     "the calling thread included, 0 for all the threads of "
+                     "the runtime."),
+      llvm::cl::init(0)};
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createKrnlOutlineParallelLoopsPass() {
+  return std::make_unique<KrnlOutlineParallelLoopsPass>();
+}
+
+std::unique_ptr<Pass> mlir::createKrnlOutlineParallelLoopsPass(
+    int64_t numThreads) {
+  return std::make_unique<KrnlOutlineParallelLoopsPass>(numThreads);
+}
@@ -13,10 +13,15 @@
 // dialect code. This pass should never be invoked on code meant to be run.
 //
 //===----------------------------------------------------------------------===//
+#include <algorithm>
 #include <fstream>
+#include <unordered_map>
 
 #include "mlir/Dialect/StandardOps/IR/Ops.h"
 #include "mlir/Pass/Pass.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Compression.h"
 #include "llvm/Support/FileSystem.h"
 
 #include "src/Dialect/Krnl/KrnlOps.hpp"
@@ -37,16 +42,28 @@ public:
   /// make sure that the options are initialized properly.
   PackKrnlGlobalConstantsPass() = default;
   PackKrnlGlobalConstantsPass(const PackKrnlGlobalConstantsPass &pass) {}
+  PackKrnlGlobalConstantsPass(int64_t compressionChunkSize) {
+    this->compressionChunkSize = compressionChunkSize;
+  }
 
   void runOnOperation() override {
     auto module = getOperation();
     OpBuilder builder(&getContext());
 
-    // Packing constant arrays to packedConst.
-    std::vector<char> packedConst;
+    // Packing constant arrays to packedConst. Identical payloads, e.g. tied
+    // weights or repeated initializers, are stored once and the globals
+    // holding them share the same offset. The payloads are looked up by their
+    // hash, and the bytes are compared to rule out collisions.
+    //
+    // The attributes live as long as the context: the packed constant is the
+    // sequence of their raw data rather than a copy of it, and the bytes are
+    // only concatenated into a buffer when an attribute holds the pack or
+    // when it is compressed, one chunk at a time.
+    PackedConstant packedConst;
+    std::unordered_map<size_t, llvm::SmallVector<size_t, 1>> indicesByHash;
     module.walk([&](KrnlGlobalOp op) {
       assert(op.value());
-      op.offsetAttr(builder.getI64IntegerAttr(packedConst.size()));
+      op.offsetAttr(builder.getI64IntegerAttr(packedConst.size));
       assert(op.value()->isa<DenseElementsAttr>());
       const auto &denseAttr = op.valueAttr().cast<DenseElementsAttr>();
       auto numElements = denseAttr.getNumElements();
@@ -54,8 +71,17 @@ public:
         return;
 
       // TODO(tjingrant) verify we can actually use the raw data.
-      std::vector<char> rawData = denseAttr.getRawData();
-      packedConst.insert(packedConst.end(), rawData.begin(), rawData.end());
+      ArrayRef<char> rawData = denseAttr.getRawData();
+      size_t hash = llvm::hash_combine_range(rawData.begin(), rawData.end());
+      auto &indices = indicesByHash[hash];
+      for (size_t index : indices) {
+        if (packedConst.segments[index] != rawData)
+          continue;
+        op.offsetAttr(builder.getI64IntegerAttr(packedConst.offsets[index]));
+        return;
+      }
+      indices.emplace_back(packedConst.segments.size());
+      packedConst.append(rawData);
     });
 
     // Remove value attributes from krnl constant op.
@@ -67,17 +93,27 @@ public:
     module.walk(
         [&](FuncOp func) { applyPatternsAndFoldGreedily(func, patterns); });
 
+    if (compressionChunkSize > 0 && packedConst.size > 0 &&
+        failed(compressChunks(packedConst))) {
+      module.emitError("cannot compress the packed constants");
+      return signalPassFailure();
+    }
+
     bool isLE = llvm::support::endian::system_endianness() ==
                 llvm::support::endianness::little;
     mlir::OperationState state(module.getLoc(), "krnl.packed_const");
     KrnlPackedConstantOp::build(builder, state,
         builder.getIntegerType(/*width=*/64),
-        /*size_in_bytes=*/builder.getI64IntegerAttr(packedConst.size()),
+        /*size_in_bytes=*/builder.getI64IntegerAttr(packedConst.size),
         /*is_le=*/builder.getBoolAttr(isLE),
         /*value=*/nullptr,
-        /*file_name=*/nullptr);
+        /*file_name=*/nullptr,
+        /*chunk_size=*/nullptr);
     auto packedConstOp =
         llvm::cast<mlir::KrnlPackedConstantOp>(mlir::Operation::create(state));
+    if (compressionChunkSize > 0 && packedConst.size > 0)
+      packedConstOp.chunk_sizeAttr(
+          builder.getI64IntegerAttr(compressionChunkSize));
     module.insert(module.begin(), packedConstOp);
     if (moveToFile) {
       std::string pathStr;
@@ -90,17 +126,88 @@ public:
       }
       packedConstOp.file_nameAttr(builder.getStringAttr(pathStr));
       std::ofstream outfile(pathStr, std::ofstream::binary);
-      outfile.write(packedConst.data(), packedConst.size());
+      for (ArrayRef<char> segment : packedConst.segments)
+        outfile.write(segment.data(), segment.size());
     } else {
-      auto shapeTy =
-          RankedTensorType::get({static_cast<int64_t>(packedConst.size())},
-              builder.getIntegerType(8));
+      std::vector<char> bytes;
+      bytes.reserve(packedConst.size);
+      for (ArrayRef<char> segment : packedConst.segments)
+        bytes.insert(bytes.end(), segment.begin(), segment.end());
+      auto shapeTy = RankedTensorType::get(
+          {packedConst.size}, builder.getIntegerType(8));
       auto denseAttr =
-          DenseIntElementsAttr::get(shapeTy, llvm::makeArrayRef(packedConst));
+          DenseIntElementsAttr::get(shapeTy, llvm::makeArrayRef(bytes));
       packedConstOp.valueAttr(denseAttr);
     }
   }
 
+  /// The packed constant, made of the raw data of the attributes at the given
+  /// offsets, or of the bytes it owns once compressed.
+  struct PackedConstant {
+    std::vector<ArrayRef<char>> segments;
+    std::vector<int64_t> offsets;
+    int64_t size = 0;
+    std::vector<char> storage;
+
+    void append(ArrayRef<char> segment) {
+      segments.emplace_back(segment);
+      offsets.emplace_back(size);
+      size += segment.size();
+    }
+  };
+
+  /// Replace the packed constants by their zlib compression, in chunks of
+  /// compressionChunkSize bytes which the runtime decompresses independently.
+  /// The compressed pack starts with a header of 64-bit words in the native
+  /// byte order: the size of the packed constants, the chunk size, the number
+  /// of chunks and the compressed size of each chunk. The compressed chunks
+  /// follow the header.
+  LogicalResult compressChunks(PackedConstant &packedConst) {
+    if (!llvm::zlib::isAvailable())
+      return failure();
+    uint64_t size = packedConst.size;
+    uint64_t chunkSize = compressionChunkSize;
+    uint64_t numChunks = (size + chunkSize - 1) / chunkSize;
+    std::vector<uint64_t> header = {size, chunkSize, numChunks};
+    std::vector<char> chunks, chunk;
+    auto compressChunk = [&]() {
+      llvm::SmallVector<char, 0> compressed;
+      if (auto error = llvm::zlib::compress(
+              llvm::StringRef(chunk.data(), chunk.size()), compressed)) {
+        llvm::consumeError(std::move(error));
+        return failure();
+      }
+      header.emplace_back(compressed.size());
+      chunks.insert(chunks.end(), compressed.begin(), compressed.end());
+      chunk.clear();
+      return success();
+    };
+    // The chunks are gathered from the segments one at a time.
+    chunk.reserve(std::min(chunkSize, size));
+    for (ArrayRef<char> segment : packedConst.segments) {
+      while (!segment.empty()) {
+        size_t numBytes = std::min<uint64_t>(
+            segment.size(), chunkSize - chunk.size());
+        chunk.insert(chunk.end(), segment.begin(), segment.begin() + numBytes);
+        segment = segment.drop_front(numBytes);
+        if (chunk.size() == chunkSize && failed(compressChunk()))
+          return failure();
+      }
+    }
+    if (!chunk.empty() && failed(compressChunk()))
+      return failure();
+
+    const char *headerBytes = reinterpret_cast<const char *>(header.data());
+    packedConst.storage.assign(
+        headerBytes, headerBytes + header.size() * sizeof(uint64_t));
+    packedConst.storage.insert(
+        packedConst.storage.end(), chunks.begin(), chunks.end());
+    packedConst.segments = {packedConst.storage};
+    packedConst.offsets = {0};
+    packedConst.size = packedConst.storage.size();
+    return success();
+  }
+
   Option<bool> moveToFile{*this, "move-to-file",
       llvm::cl::desc("Whether to move the packed constant to a file."),
       llvm::cl::init(true)};
@@ -116,6 +223,13 @@ public:
   Option<std::string> filename{*this, "filename",
       llvm::cl::desc(
           "Specify a file in which the packed constant is to be stored.")};
+  Option<int64_t> compressionChunkSize{*this, "compression-chunk-size",
+      llvm::cl::desc("Compress the packed constant with zlib in chunks of the "
+                     "given number of bytes, which the runtime decompresses "
+                     "in parallel when the model is loaded, or when each "
+                     "constant is first used with lazy constants (0 keeps "
+                     "the packed constant uncompressed)."),
+      llvm::cl::init(0)};
 };
 } // namespace
 
@@ -123,5 +237,10 @@ std::unique_ptr<Pass> mlir::createPackKrnlGlobalConstantsPass() {
   return std::make_unique<PackKrnlGlobalConstantsPass>();
 }
 
+std::unique_ptr<Pass> mlir::createPackKrnlGlobalConstantsPass(
+    int64_t compressionChunkSize) {
+  return std::make_unique<PackKrnlGlobalConstantsPass>(compressionChunkSize);
+}
+
 static PassRegistration<PackKrnlGlobalConstantsPass> pass("pack-krnl-constants",
     "Elide the constant values of the Global Krnl operations.");
\ No newline at end of file
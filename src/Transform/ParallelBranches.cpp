@@ -0,0 +1,247 @@
+//===------- ParallelBranches.cpp - Run Independent Loop Nests Together ---===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// The operations of the independent branches of a graph, such as the towers
+// of an inception block or the heads of a multi-head subgraph, are lowered to
+// loop nests that the function runs one after another. This pass schedules
+// the top-level Krnl loop nests of a function by levels: the loop nests of a
+// level access no buffer written by another loop nest of the same level, and
+// each loop nest comes after the loop nests it depends on. The loop nests of
+// a level are placed in the branches of a loop marked krnl.parallel, whose
+// iteration selects a loop nest with an affine.if on its induction variable,
+// so that they run concurrently on the threads of the runtime, see
+// createKrnlOutlineParallelLoopsPass.
+//
+// Loop nests are only moved across operations without memory effects and
+// allocations. The pass runs before the memory pools are formed: the buffers
+// used by the loop nests of a level are all live during the parallel loop, so
+// they are never given the same memory. This increases the memory of the
+// pools, by up to the buffers of all the loop nests of the largest level,
+// which is only worth it when the parallel loops run on several threads:
+// with sequential parallel loops, the pass costs memory and gains nothing.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/IntegerSet.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/// A top-level loop nest, with the operations defining and optimizing its
+/// loops in block order, and the buffers it reads and writes.
+struct LoopNest {
+  KrnlIterateOp iterateOp;
+  SmallVector<Operation *, 4> ops;
+  llvm::SmallDenseSet<Value, 4> reads, writes;
+
+  bool dependsOn(const LoopNest &other) const {
+    auto intersects = [](const llvm::SmallDenseSet<Value, 4> &lhs,
+                          const llvm::SmallDenseSet<Value, 4> &rhs) {
+      return llvm::any_of(lhs, [&](Value value) { return rhs.count(value); });
+    };
+    return intersects(writes, other.reads) ||
+           intersects(writes, other.writes) ||
+           intersects(reads, other.writes);
+  }
+};
+
+/// Return the MemRef of which a MemRef is a view, or the MemRef itself.
+Value getBaseMemRef(Value memRef) {
+  while (Operation *defOp = memRef.getDefiningOp()) {
+    if (!isa<KrnlReshapeOp, KrnlGetRefOp, MemRefCastOp>(defOp))
+      break;
+    memRef = defOp->getOperand(0);
+  }
+  return memRef;
+}
+
+/// Test if an operation only refers to loops, of which the Krnl to Affine
+/// lowering builds the loop nests.
+bool isLoopOp(Operation *op) {
+  return isa<KrnlDefineLoopsOp, KrnlParallelOp, KrnlBlockOp, KrnlPermuteOp,
+      KrnlUnrollOp>(op);
+}
+
+/// Test if a loop nest can be moved across an operation of the block.
+bool canMoveAcross(Operation *op) {
+  if (op->getNumRegions() != 0 || op->isKnownTerminator())
+    return false;
+  return isLoopOp(op) || isa<AllocOp, KrnlDimOp, KrnlGlobalOp>(op) ||
+         MemoryEffectOpInterface::hasNoEffect(op);
+}
+
+/// Collect the operations defining and optimizing the loops of a loop nest,
+/// which must not be used by another loop nest.
+bool collectLoopOps(
+    KrnlIterateOp iterateOp, SmallVectorImpl<Operation *> &ops) {
+  Block *block = iterateOp.getOperation()->getBlock();
+  llvm::SmallPtrSet<Operation *, 8> visited = {iterateOp.getOperation()};
+  SmallVector<Operation *, 8> worklist = {iterateOp.getOperation()};
+  while (!worklist.empty()) {
+    Operation *op = worklist.pop_back_val();
+    auto visit = [&](Operation *other) {
+      if (!other || other->getBlock() != block ||
+          (!isLoopOp(other) && other != iterateOp.getOperation()))
+        return false;
+      if (visited.insert(other).second)
+        worklist.emplace_back(other);
+      return true;
+    };
+    for (Value operand : op->getOperands())
+      if (operand.getType().isa<LoopType>() && !visit(operand.getDefiningOp()))
+        return false;
+    for (Value result : op->getResults())
+      for (Operation *user : result.getUsers())
+        if (!visit(user))
+          return false;
+  }
+  for (Operation *op : visited)
+    ops.emplace_back(op);
+  llvm::sort(ops, [](Operation *lhs, Operation *rhs) {
+    return lhs->isBeforeInBlock(rhs);
+  });
+  return true;
+}
+
+/// Collect the buffers read and written by a loop nest. Return false if it
+/// holds operations with unknown memory effects.
+bool collectAccesses(LoopNest &loopNest) {
+  auto result = loopNest.iterateOp.walk([&](Operation *op) {
+    if (auto memcpyOp = dyn_cast<KrnlMemcpyOp>(op)) {
+      loopNest.writes.insert(getBaseMemRef(memcpyOp.dest()));
+      loopNest.reads.insert(getBaseMemRef(memcpyOp.src()));
+      return WalkResult::advance();
+    }
+    if (auto gemmOp = dyn_cast<KrnlBlasGemmOp>(op)) {
+      loopNest.writes.insert(getBaseMemRef(gemmOp.C()));
+      loopNest.reads.insert(getBaseMemRef(gemmOp.A()));
+      loopNest.reads.insert(getBaseMemRef(gemmOp.B()));
+      return WalkResult::advance();
+    }
+    if (auto effectInterface = dyn_cast<MemoryEffectOpInterface>(op)) {
+      SmallVector<MemoryEffects::EffectInstance, 2> effects;
+      effectInterface.getEffects(effects);
+      for (auto &effect : effects) {
+        if (!effect.getValue())
+          return WalkResult::interrupt();
+        Value base = getBaseMemRef(effect.getValue());
+        if (isa<MemoryEffects::Read>(effect.getEffect()))
+          loopNest.reads.insert(base);
+        else
+          loopNest.writes.insert(base);
+      }
+      return WalkResult::advance();
+    }
+    if (op->hasTrait<OpTrait::HasRecursiveSideEffects>() || isLoopOp(op) ||
+        isa<KrnlIterateOp, KrnlTerminatorOp, KrnlGetRefOp, KrnlReshapeOp,
+            KrnlDimOp>(op))
+      return WalkResult::advance();
+    return WalkResult::interrupt();
+  });
+  return !result.wasInterrupted();
+}
+
+/// Place the loop nests of each level in the branches of a parallel loop
+/// built before `insertionPoint`, and the loop nests alone in their level
+/// right before it.
+void emitLevels(ArrayRef<SmallVector<LoopNest *, 4>> levels,
+    Operation *insertionPoint) {
+  OpBuilder builder(insertionPoint);
+  for (auto &level : levels) {
+    if (level.size() == 1) {
+      for (Operation *op : level.front()->ops)
+        op->moveBefore(insertionPoint);
+      continue;
+    }
+
+    Location loc = level.front()->iterateOp.getLoc();
+    auto defineOp = builder.create<KrnlDefineLoopsOp>(loc, 1);
+    Value branchLoop = defineOp.getResult(0);
+    builder.create<KrnlParallelOp>(loc, branchLoop);
+    KrnlIterateOperandPack pack(builder, branchLoop);
+    pack.pushConstantBound(0);
+    pack.pushConstantBound(level.size());
+    auto iterateOp = builder.create<KrnlIterateOp>(loc, pack);
+    Block &body = iterateOp.bodyRegion().front();
+
+    OpBuilder::InsertionGuard guard(builder);
+    builder.setInsertionPoint(body.getTerminator());
+    for (unsigned i = 0; i < level.size(); ++i) {
+      IntegerSet isBranch = IntegerSet::get(1, 0,
+          {builder.getAffineDimExpr(0) - i}, /*eqFlags=*/{true});
+      auto ifOp = builder.create<AffineIfOp>(loc, isBranch,
+          ValueRange{body.getArgument(0)}, /*withElseRegion=*/false);
+      for (Operation *op : level[i]->ops)
+        op->moveBefore(ifOp.getThenBlock()->getTerminator());
+    }
+  }
+}
+
+/// Schedule the loop nests found before a barrier by levels. The block is
+/// left unchanged if no two loop nests can run concurrently.
+void scheduleLoopNests(
+    SmallVectorImpl<LoopNest> &loopNests, Operation *barrier) {
+  SmallVector<SmallVector<LoopNest *, 4>, 4> levels;
+  SmallVector<unsigned, 8> levelOf;
+  for (unsigned i = 0; i < loopNests.size(); ++i) {
+    unsigned level = 0;
+    for (unsigned j = 0; j < i; ++j)
+      if (loopNests[i].dependsOn(loopNests[j]))
+        level = std::max(level, levelOf[j] + 1);
+    levelOf.emplace_back(level);
+    if (level == levels.size())
+      levels.emplace_back();
+    levels[level].emplace_back(&loopNests[i]);
+  }
+  if (levels.size() < loopNests.size())
+    emitLevels(levels, barrier);
+}
+
+/*!
+ *  Function pass that runs the independent Krnl loop nests concurrently.
+ */
+class KrnlParallelBranchesPass
+    : public PassWrapper<KrnlParallelBranchesPass, FunctionPass> {
+public:
+  void runOnFunction() override {
+    auto function = getFunction();
+
+    // The loop nests between two operations that they cannot be moved across
+    // are scheduled together, right before the second operation.
+    SmallVector<LoopNest, 8> loopNests;
+    SmallVector<Operation *, 32> ops;
+    for (Operation &op : function.getBody().front())
+      ops.emplace_back(&op);
+    for (Operation *op : ops) {
+      if (auto iterateOp = dyn_cast<KrnlIterateOp>(op)) {
+        LoopNest loopNest;
+        loopNest.iterateOp = iterateOp;
+        if (collectLoopOps(iterateOp, loopNest.ops) &&
+            collectAccesses(loopNest)) {
+          loopNests.emplace_back(std::move(loopNest));
+          continue;
+        }
+      } else if (canMoveAcross(op)) {
+        continue;
+      }
+      scheduleLoopNests(loopNests, op);
+      loopNests.clear();
+    }
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createKrnlParallelBranchesPass() {
+  return std::make_unique<KrnlParallelBranchesPass>();
+}
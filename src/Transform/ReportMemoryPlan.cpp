@@ -0,0 +1,311 @@
+//===-------- ReportMemoryPlan.cpp - Report the Memory Plan of a Model ----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Once the internal MemRefs are bundled into static memory pools and the pools
+// are optimized, the sizes and live ranges of all the buffers of a function
+// are known at compile time, except for the dynamically shaped ones. This pass
+// computes the peak memory of each function, i.e. the maximum, over the
+// operations of the function, of the sum of the sizes of the buffers live at
+// the same time, and:
+//
+//   - writes a JSON report of the buffers of each function, with their sizes,
+//     live ranges and, for memory pools, the offsets of their MemRefs,
+//   - emits a function returning the peak memory of the model, exported from
+//     the compiled model:
+//
+//       func @omModelGetPeakMemory() -> i64 {
+//         %0 = constant 4096 : i64
+//         return %0 : i64
+//       }
+//
+//   - optionally fails the compilation when the peak memory exceeds a limit.
+//
+// The live range of a buffer is the interval between the operations of the
+// body of the function containing its alloc and its dealloc. A buffer which
+// is not deallocated, e.g. an output, is live until the end of the function.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+const char *kPeakMemoryFuncName = "omModelGetPeakMemory";
+
+//===----------------------------------------------------------------------===//
+// Data structures for the memory plan.
+//===----------------------------------------------------------------------===//
+
+// A MemRef obtained from a memory pool with a krnl.getref. Its live range is
+// the interval [start, end] of the positions, in the body of the function, of
+// the operations using it. The offset is -1 when it is not a constant.
+struct PlannedSlot {
+  int64_t size;
+  int64_t offset;
+  int64_t start;
+  int64_t end;
+};
+
+// A buffer allocated in a function. The size is 0 for dynamically shaped
+// buffers.
+struct PlannedBuffer {
+  std::string type;
+  std::string loc;
+  int64_t size = 0;
+  bool dynamic = false;
+  int64_t start;
+  int64_t end;
+  SmallVector<PlannedSlot, 8> slots;
+};
+
+struct FunctionPlan {
+  std::string name;
+  int64_t peak = 0;
+  int64_t numDynamicBuffers = 0;
+  std::vector<PlannedBuffer> buffers;
+};
+
+//===----------------------------------------------------------------------===//
+// Helper functions.
+//===----------------------------------------------------------------------===//
+
+template <typename T>
+std::string printToString(T value) {
+  std::string str;
+  llvm::raw_string_ostream os(str);
+  value.print(os);
+  return os.str();
+}
+
+/// Compute the first and last positions, in the body of the function, of the
+/// operations using a value.
+void computeUseRange(Value value, Block *block,
+    const llvm::DenseMap<Operation *, int64_t> &positions, int64_t &start,
+    int64_t &end) {
+  start = positions.size();
+  end = -1;
+  for (Operation *user : value.getUsers()) {
+    Operation *ancestor = block->findAncestorOpInBlock(*user);
+    if (!ancestor)
+      continue;
+    start = std::min(start, positions.lookup(ancestor));
+    end = std::max(end, positions.lookup(ancestor));
+  }
+  if (end < 0)
+    start = end = positions.size();
+}
+
+/// Compute the buffers of a function and its peak memory.
+FunctionPlan planFunction(FuncOp function) {
+  FunctionPlan plan;
+  plan.name = function.getName().str();
+
+  Block *block = &function.getBody().front();
+  llvm::DenseMap<Operation *, int64_t> positions;
+  for (Operation &op : *block)
+    positions.try_emplace(&op, positions.size());
+  int64_t blockEnd = positions.size();
+
+  function.walk([&](AllocOp allocOp) {
+    Operation *ancestor = block->findAncestorOpInBlock(*allocOp.getOperation());
+    if (!ancestor)
+      return;
+
+    PlannedBuffer buffer;
+    buffer.type = printToString(allocOp.getType());
+    buffer.loc = printToString(allocOp.getLoc());
+    buffer.dynamic = !hasAllConstantDimensions(allocOp.getType());
+    if (!buffer.dynamic)
+      buffer.size = getMemRefSizeInBytes(allocOp.getResult());
+    buffer.start = positions.lookup(ancestor);
+    buffer.end = blockEnd;
+    for (Operation *user : allocOp.getResult().getUsers()) {
+      if (isa<DeallocOp>(user)) {
+        if (Operation *deallocAncestor = block->findAncestorOpInBlock(*user))
+          buffer.end = positions.lookup(deallocAncestor);
+        continue;
+      }
+      auto getRef = dyn_cast<KrnlGetRefOp>(user);
+      if (!getRef)
+        continue;
+      PlannedSlot slot;
+      auto memRefType = convertToMemRefType(getRef.getResult().getType());
+      slot.size = hasAllConstantDimensions(memRefType)
+                      ? getMemRefSizeInBytes(getRef.getResult())
+                      : 0;
+      slot.offset = -1;
+      if (auto constOp = getRef.offset().getDefiningOp<ConstantOp>())
+        if (auto offsetAttr = constOp.value().dyn_cast<IntegerAttr>())
+          slot.offset = offsetAttr.getInt();
+      computeUseRange(getRef.getResult(), block, positions, slot.start,
+          slot.end);
+      buffer.slots.emplace_back(slot);
+    }
+    if (buffer.dynamic)
+      plan.numDynamicBuffers++;
+    plan.buffers.emplace_back(std::move(buffer));
+  });
+
+  // Sum the sizes of the buffers live at each position.
+  std::vector<int64_t> delta(blockEnd + 2, 0);
+  for (const PlannedBuffer &buffer : plan.buffers) {
+    delta[buffer.start] += buffer.size;
+    delta[buffer.end + 1] -= buffer.size;
+  }
+  int64_t live = 0;
+  for (int64_t d : delta) {
+    live += d;
+    plan.peak = std::max(plan.peak, live);
+  }
+  return plan;
+}
+
+/// Write the memory plan of the functions into a JSON report. Writes to the
+/// standard error when the filename is "-".
+bool writeReport(const std::string &filename, ArrayRef<FunctionPlan> plans,
+    int64_t peak) {
+  std::error_code error;
+  std::unique_ptr<llvm::raw_fd_ostream> file;
+  if (filename != "-") {
+    file = std::make_unique<llvm::raw_fd_ostream>(
+        filename, error, llvm::sys::fs::OF_Text);
+    if (error) {
+      llvm::errs() << "cannot open memory plan report " << filename << ": "
+                   << error.message() << "\n";
+      return false;
+    }
+  }
+  llvm::raw_ostream &os = file ? *file : llvm::errs();
+
+  llvm::json::OStream json(os, /*IndentSize=*/2);
+  json.object([&] {
+    json.attribute("peak_bytes", peak);
+    json.attributeArray("functions", [&] {
+      for (const FunctionPlan &plan : plans)
+        json.object([&] {
+          json.attribute("name", plan.name);
+          json.attribute("peak_bytes", plan.peak);
+          json.attribute("dynamic_buffers", plan.numDynamicBuffers);
+          json.attributeArray("buffers", [&] {
+            for (const PlannedBuffer &buffer : plan.buffers)
+              json.object([&] {
+                json.attribute("type", buffer.type);
+                json.attribute("loc", buffer.loc);
+                if (buffer.dynamic)
+                  json.attribute("size_bytes", nullptr);
+                else
+                  json.attribute("size_bytes", buffer.size);
+                json.attribute("start", buffer.start);
+                json.attribute("end", buffer.end);
+                if (buffer.slots.empty())
+                  return;
+                json.attributeArray("slots", [&] {
+                  for (const PlannedSlot &slot : buffer.slots)
+                    json.object([&] {
+                      json.attribute("size_bytes", slot.size);
+                      json.attribute("offset", slot.offset);
+                      json.attribute("start", slot.start);
+                      json.attribute("end", slot.end);
+                    });
+                });
+              });
+          });
+        });
+    });
+  });
+  os << "\n";
+  return true;
+}
+
+/*!
+ *  Module pass that reports the memory plan of the functions and embeds the
+ *  peak memory of the model.
+ */
+class ReportMemoryPlanPass
+    : public PassWrapper<ReportMemoryPlanPass, OperationPass<ModuleOp>> {
+public:
+  Option<std::string> reportFile{*this, "report-file",
+      llvm::cl::desc("File the JSON memory plan report is written to, or - "
+                     "for the standard error"),
+      llvm::cl::init("")};
+  Option<int64_t> maxActivationMemory{*this, "max-activation-memory",
+      llvm::cl::desc("Maximum peak memory in bytes of a function, 0 for no "
+                     "limit"),
+      llvm::cl::init(0)};
+
+  ReportMemoryPlanPass() = default;
+  ReportMemoryPlanPass(const ReportMemoryPlanPass &) {}
+  ReportMemoryPlanPass(
+      const std::string &reportFile, int64_t maxActivationMemory) {
+    this->reportFile = reportFile;
+    this->maxActivationMemory = maxActivationMemory;
+  }
+
+  void runOnOperation() override {
+    auto module = getOperation();
+
+    SmallVector<FunctionPlan, 4> plans;
+    int64_t peak = 0;
+    bool hasDynamicBuffers = false;
+    bool exceeded = false;
+    for (auto function : module.getOps<FuncOp>()) {
+      if (function.isExternal() || function.getName() == kPeakMemoryFuncName)
+        continue;
+      plans.emplace_back(planFunction(function));
+      const FunctionPlan &plan = plans.back();
+      peak = std::max(peak, plan.peak);
+      hasDynamicBuffers |= plan.numDynamicBuffers > 0;
+      if (maxActivationMemory > 0 && plan.peak > maxActivationMemory) {
+        function.emitError("peak memory of ")
+            << plan.peak << " bytes exceeds the maximum activation memory of "
+            << maxActivationMemory << " bytes";
+        exceeded = true;
+      }
+    }
+
+    if (!reportFile.empty() && !writeReport(reportFile, plans, peak))
+      return signalPassFailure();
+    if (exceeded)
+      return signalPassFailure();
+
+    if (module.lookupSymbol(kPeakMemoryFuncName))
+      return;
+    OpBuilder builder(&getContext());
+    auto loc = module.getLoc();
+    Type i64Type = builder.getIntegerType(64);
+    auto peakFunc = FuncOp::create(loc, kPeakMemoryFuncName,
+        FunctionType::get({}, {i64Type}, &getContext()));
+    module.push_back(peakFunc);
+    builder.setInsertionPointToStart(peakFunc.addEntryBlock());
+    // The peak memory of a model with dynamically shaped buffers is not known
+    // at compile time.
+    auto peakValue = builder.create<ConstantOp>(
+        loc, builder.getIntegerAttr(i64Type, hasDynamicBuffers ? -1 : peak));
+    builder.create<ReturnOp>(loc, peakValue.getResult());
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createReportMemoryPlanPass() {
+  return std::make_unique<ReportMemoryPlanPass>();
+}
+
+std::unique_ptr<Pass> mlir::createReportMemoryPlanPass(
+    const std::string &reportFile, int64_t maxActivationMemory) {
+  return std::make_unique<ReportMemoryPlanPass>(
+      reportFile, maxActivationMemory);
+}
@@ -0,0 +1,67 @@
+//===-------- UseMemoryArena.cpp - Allocate Memory Pools from an Arena ----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// Memory pools are allocated and deallocated on every invocation of the model.
+// This pass replaces the allocation of each memory pool with a krnl.arena_alloc
+// retrieving the memory of the pool from a thread-local arena owned by the
+// runtime. The arena keeps the memory across invocations, so that steady-state
+// inference does not allocate any memory for the internal MemRefs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/StandardOps/IR/Ops.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/Pass/Pass.h"
+
+#include "src/Conversion/ONNXToKrnl/ONNXToKrnlCommon.hpp"
+#include "src/Dialect/Krnl/KrnlOps.hpp"
+#include "src/Pass/Passes.hpp"
+
+using namespace mlir;
+
+namespace {
+
+/*!
+ *  Module pass that allocates the memory pools from the runtime arena. Each
+ *  memory pool of the module is given its own slot of the arena, so that the
+ *  memory pools live at the same time never share memory.
+ */
+class KrnlUseMemoryArenaPass
+    : public PassWrapper<KrnlUseMemoryArenaPass, OperationPass<ModuleOp>> {
+public:
+  void runOnOperation() override {
+    auto module = getOperation();
+
+    SmallVector<AllocOp, 8> memPools;
+    module.walk([&](AllocOp allocOp) {
+      if (checkOpResultIsUsedByGetRef(&allocOp))
+        memPools.emplace_back(allocOp);
+    });
+
+    int64_t slot = 0;
+    for (auto memPool : memPools) {
+      // The memory of the arena is owned by the runtime.
+      SmallVector<Operation *, 2> deallocs;
+      for (Operation *user : memPool.getResult().getUsers())
+        if (isa<DeallocOp>(user))
+          deallocs.emplace_back(user);
+      for (Operation *dealloc : deallocs)
+        dealloc->erase();
+
+      OpBuilder builder(memPool);
+      auto arenaAlloc = builder.create<KrnlArenaAllocOp>(memPool.getLoc(),
+          memPool.getResult().getType(), builder.getI64IntegerAttr(slot++),
+          memPool.getOperands());
+      memPool.getResult().replaceAllUsesWith(arenaAlloc.getResult());
+      memPool.erase();
+    }
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> mlir::createKrnlUseMemoryArenaPass() {
+  return std::make_unique<KrnlUseMemoryArenaPass>();
+}
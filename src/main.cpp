@@ -40,19 +40,33 @@ int main(int argc, char *argv[]) {
                              "LLVM bitcode for model, compile and link it to a "
                              "shared library."),
           clEnumVal(EmitJNI, "Lower model to LLMV IR -> LLVM bitcode "
-                             "-> JNI shared library -> jar")),
+                             "-> JNI shared library -> jar"),
+          clEnumVal(EmitGPUIR,
+              "Preview: lower model to the GPU dialect, with the parallel "
+              "loops as GPU kernels, and emit (to file) the MLIR only. No "
+              "device memory, host-device copies or kernel binaries are "
+              "generated, the output cannot run on a GPU.")),
       llvm::cl::init(EmitLib), llvm::cl::cat(OnnxMlirOptions));
 
   llvm::cl::HideUnrelatedOptions(OnnxMlirOptions);
   llvm::cl::ParseCommandLineOptions(
       argc, argv, "ONNX MLIR modular optimizer driver\n");
 
-  mlir::OwningModuleRef module;
-  processInputFile(inputFilename, emissionTarget, context, module);
-
   // Input file base name, replace path if required.
   if (outputBaseName == "")
     outputBaseName = inputFilename.substr(0, inputFilename.find_last_of("."));
 
-  return compileModule(module, context, outputBaseName, emissionTarget);
+  // Identical compilations are restored from the compilation cache, if any.
+  string cacheKey = getCompileCacheKey(
+      inputFilename, outputBaseName, emissionTarget, argc, argv);
+  if (restoreFromCompileCache(cacheKey, outputBaseName, emissionTarget))
+    return 0;
+
+  mlir::OwningModuleRef module;
+  processInputFile(inputFilename, emissionTarget, context, module);
+
+  int rc = compileModule(module, context, outputBaseName, emissionTarget);
+  if (rc == 0)
+    storeInCompileCache(cacheKey, outputBaseName, emissionTarget);
+  return rc;
 }
@@ -0,0 +1,134 @@
+# Compile a fixed set of models with onnx-mlir and record the compile time,
+# the peak memory and the IR size of each compiler pass, as reported by the
+# --compile-report option.
+#
+# The per-model totals and the slowest passes are printed and written into
+# the output report. When a baseline report of a previous run is given, models
+# whose compile time or peak memory grew by more than the tolerance are
+# reported and make the script fail.
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+VERBOSE = bool(os.environ.get("VERBOSE"))
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument("--onnx-mlir", required=True, help="onnx-mlir binary")
+parser.add_argument("--models", required=True,
+                    help="file listing the models to compile, one per line")
+parser.add_argument("--model-dir", default="",
+                    help="directory holding the models")
+parser.add_argument("--output", required=True, help="report to write")
+parser.add_argument("--baseline", default="",
+                    help="report of a previous run to compare against")
+parser.add_argument("--tolerance", type=float, default=0.1,
+                    help="relative growth reported as a regression")
+parser.add_argument("--slowest-passes", type=int, default=5,
+                    help="number of slowest passes kept per model")
+
+
+def read_model_list(filename):
+    with open(filename) as f:
+        lines = [line.strip() for line in f]
+    return [line for line in lines if line and not line.startswith("#")]
+
+
+def compile_model(onnx_mlir, model_path, work_dir):
+    name = os.path.splitext(os.path.basename(model_path))[0]
+    report_path = os.path.join(work_dir, name + ".json")
+    # Lowering to the LLVM dialect runs every compiler pass without invoking
+    # the external tools building the shared library.
+    cmd = [
+        onnx_mlir, "--EmitLLVMIR", "--compile-report=" + report_path,
+        "-o", os.path.join(work_dir, name), model_path
+    ]
+    if VERBOSE:
+        print(" ".join(cmd))
+    result = subprocess.run(cmd,
+                            stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr.decode(errors="replace"))
+        return None
+    with open(report_path) as f:
+        return json.load(f)
+
+
+def summarize(report, slowest_passes):
+    passes = report["passes"]
+    slowest = sorted(passes, key=lambda p: p["wall_time_ms"], reverse=True)
+    return {
+        "total_wall_time_ms": report["total_wall_time_ms"],
+        "peak_rss_kb": report["peak_rss_kb"],
+        "ops_before": passes[0]["ops_before"] if passes else 0,
+        "ops_after": passes[-1]["ops_after"] if passes else 0,
+        "slowest_passes": slowest[:slowest_passes],
+        "passes": passes,
+    }
+
+
+def find_regressions(summary, baseline, tolerance):
+    regressions = []
+    for model, numbers in summary.items():
+        if model not in baseline:
+            continue
+        for key in ("total_wall_time_ms", "peak_rss_kb"):
+            old, new = baseline[model][key], numbers[key]
+            if old > 0 and new > old * (1 + tolerance):
+                regressions.append("{}: {} grew from {:.1f} to {:.1f}".format(
+                    model, key, old, new))
+    return regressions
+
+
+def main():
+    args = parser.parse_args()
+    if not args.model_dir or not os.path.isdir(args.model_dir):
+        print("Set ONNX_MLIR_MODEL_ZOO_DIR to a directory holding the models "
+              "listed in " + args.models)
+        return 1
+
+    summary = {}
+    failures = []
+    work_dir = tempfile.mkdtemp(prefix="onnx-mlir-compile-time-")
+    for model in read_model_list(args.models):
+        model_path = os.path.join(args.model_dir, model)
+        if not os.path.exists(model_path):
+            print("{}: not found, skipped".format(model))
+            continue
+        report = compile_model(args.onnx_mlir, model_path, work_dir)
+        if report is None:
+            failures.append(model)
+            print("{}: compilation failed".format(model))
+            continue
+        summary[model] = summarize(report, args.slowest_passes)
+        print("{}: {:.1f} ms, peak RSS {} KB, {} -> {} ops".format(
+            model, summary[model]["total_wall_time_ms"],
+            summary[model]["peak_rss_kb"], summary[model]["ops_before"],
+            summary[model]["ops_after"]))
+        for p in summary[model]["slowest_passes"]:
+            print("  {:10.1f} ms  {}".format(p["wall_time_ms"], p["pass"]))
+
+    with open(args.output, "w") as f:
+        json.dump(summary, f, indent=2)
+
+    regressions = []
+    if args.baseline:
+        with open(args.baseline) as f:
+            regressions = find_regressions(summary, json.load(f),
+                                           args.tolerance)
+        for regression in regressions:
+            print("regression: " + regression)
+    return 1 if failures or regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,17 @@
+// RUN: onnx-mlir-opt --pack-krnl-constants='elision-threshold=3 move-to-file=true filename=test-binary-decoder-compare.bin' %s && not binary-decoder test-binary-decoder-compare.bin -s 0 -n 16 --onnx::TensorProto::FLOAT --ref test-binary-decoder-compare.bin --ref-s 16 | FileCheck %s
+// RUN: onnx-mlir-opt --pack-krnl-constants='elision-threshold=3 move-to-file=true filename=test-binary-decoder-compare.bin' %s && binary-decoder test-binary-decoder-compare.bin -s 0 -n 16 --onnx::TensorProto::FLOAT --ref test-binary-decoder-compare.bin --ref-s 16 --atol 0.2 -rm | FileCheck %s -check-prefix=TOLERANCE
+
+/// The two constants are packed one after the other, and differ in their last
+/// element.
+func @test_binary_decoder_compare() -> memref<1x4xf32> {
+  %0 = "krnl.global"() {name = "constant_0", shape = [1, 4], value = dense<[[0.1, 0.2, 0.3, 0.4]]> : tensor<1x4xf32>} : () -> memref<1x4xf32>
+  %1 = "krnl.global"() {name = "constant_1", shape = [1, 4], value = dense<[[0.1, 0.2, 0.3, 0.5]]> : tensor<1x4xf32>} : () -> memref<1x4xf32>
+  return %0 : memref<1x4xf32>
+
+  // CHECK: mismatch at 3: 0.4 vs 0.5
+  // CHECK-NEXT: compared 4 elements, 1 mismatches
+  // CHECK-NEXT: max abs diff 0.1 at 3
+
+  // TOLERANCE-NOT: mismatch at
+  // TOLERANCE: compared 4 elements, 0 mismatches
+}
@@ -0,0 +1,20 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-affine --convert-krnl-to-llvm='annotate-buffers=true' %s -split-input-file | FileCheck %s
+
+/// The aligned pointers of the MemRef arguments are noalias, and the memory
+/// pool is aligned to 64 bytes.
+func @test_annotate_buffers(%arg0: memref<8xf32>, %arg1: memref<8xf32>) -> memref<8xf32> {
+  %c0 = constant 0 : i64
+  %0 = alloc() : memref<32xi8>
+  %1 = "krnl.getref"(%0, %c0) : (memref<32xi8>, i64) -> memref<8xf32>
+  %2 = affine.load %arg0[0] : memref<8xf32>
+  affine.store %2, %1[0] : memref<8xf32>
+  %3 = affine.load %1[0] : memref<8xf32>
+  affine.store %3, %arg1[0] : memref<8xf32>
+  dealloc %0 : memref<32xi8>
+  return %arg1 : memref<8xf32>
+
+  // CHECK-LABEL: llvm.func @test_annotate_buffers
+  // CHECK-SAME: ({{%.+}}: !llvm.ptr<float>, {{%.+}}: !llvm.ptr<float> {llvm.noalias = true}, {{%.+}}: !llvm.i64, {{%.+}}: !llvm.i64, {{%.+}}: !llvm.i64, {{%.+}}: !llvm.ptr<float>, {{%.+}}: !llvm.ptr<float> {llvm.noalias = true}, {{%.+}}: !llvm.i64, {{%.+}}: !llvm.i64, {{%.+}}: !llvm.i64)
+  // CHECK: [[ALIGNMENT:%.+]] = llvm.mlir.constant(64 : index) : !llvm.i64
+  // CHECK: llvm.call @malloc
+}
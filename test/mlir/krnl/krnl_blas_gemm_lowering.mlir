@@ -0,0 +1,30 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-affine --convert-krnl-to-llvm %s -split-input-file | FileCheck %s
+
+/// The matrices are passed to cblas_sgemm in row-major order.
+func @test_blas_gemm(%arg0: memref<16x32xf32>, %arg1: memref<64x32xf32>) -> memref<16x64xf32> {
+  %0 = alloc() : memref<16x64xf32>
+  "krnl.blas_gemm"(%arg0, %arg1, %0) {K = 32 : i64, M = 16 : i64, N = 64 : i64, alpha = 1.000000e+00 : f32, beta = 0.000000e+00 : f32, transB = true} : (memref<16x32xf32>, memref<64x32xf32>, memref<16x64xf32>) -> ()
+  return %0 : memref<16x64xf32>
+
+  // CHECK: llvm.func @cblas_sgemm(!llvm.i32, !llvm.i32, !llvm.i32, !llvm.i32, !llvm.i32, !llvm.i32, !llvm.float, !llvm.ptr<float>, !llvm.i32, !llvm.ptr<float>, !llvm.i32, !llvm.float, !llvm.ptr<float>, !llvm.i32)
+  // CHECK-LABEL: llvm.func @test_blas_gemm
+  // CHECK-DAG: [[ROW_MAJOR:%.+]] = llvm.mlir.constant(101 : i32) : !llvm.i32
+  // CHECK-DAG: [[NO_TRANS:%.+]] = llvm.mlir.constant(111 : i32) : !llvm.i32
+  // CHECK-DAG: [[TRANS:%.+]] = llvm.mlir.constant(112 : i32) : !llvm.i32
+  // CHECK: llvm.call @cblas_sgemm([[ROW_MAJOR]], [[NO_TRANS]], [[TRANS]], {{.*}}) : (!llvm.i32, !llvm.i32, !llvm.i32, !llvm.i32, !llvm.i32, !llvm.i32, !llvm.float, !llvm.ptr<float>, !llvm.i32, !llvm.ptr<float>, !llvm.i32, !llvm.float, !llvm.ptr<float>, !llvm.i32) -> ()
+  // CHECK: llvm.return
+}
+
+// -----
+
+/// The offsets move the pointers to the matrices of a batch.
+func @test_blas_gemm_offsets(%arg0: memref<2x16x32xf32>, %arg1: memref<2x32x64xf32>, %arg2: memref<2x16x64xf32>, %arg3: index, %arg4: index, %arg5: index) {
+  "krnl.blas_gemm"(%arg0, %arg1, %arg2, %arg3, %arg4, %arg5) {K = 32 : i64, M = 16 : i64, N = 64 : i64, alpha = 1.000000e+00 : f32, beta = 0.000000e+00 : f32} : (memref<2x16x32xf32>, memref<2x32x64xf32>, memref<2x16x64xf32>, index, index, index) -> ()
+  return
+
+  // CHECK-LABEL: llvm.func @test_blas_gemm_offsets
+  // CHECK: [[A:%.+]] = llvm.getelementptr {{.*}}[{{.*}}] : (!llvm.ptr<float>, !llvm.i64) -> !llvm.ptr<float>
+  // CHECK: [[B:%.+]] = llvm.getelementptr {{.*}}[{{.*}}] : (!llvm.ptr<float>, !llvm.i64) -> !llvm.ptr<float>
+  // CHECK: [[C:%.+]] = llvm.getelementptr {{.*}}[{{.*}}] : (!llvm.ptr<float>, !llvm.i64) -> !llvm.ptr<float>
+  // CHECK: llvm.call @cblas_sgemm({{.*}}, [[A]], {{.*}}, [[B]], {{.*}}, [[C]], {{.*}})
+}
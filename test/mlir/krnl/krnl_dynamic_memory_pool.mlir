@@ -0,0 +1,38 @@
+// RUN: onnx-mlir-opt --enable-memory-pool --bundle-memory-pools --canonicalize %s -split-input-file | FileCheck %s
+// RUN: onnx-mlir-opt --enable-memory-pool --bundle-memory-pools --convert-krnl-to-affine --convert-krnl-to-llvm %s -split-input-file | FileCheck %s --check-prefix=LLVM
+
+/// Internal MemRefs whose sizes are taken from other internal MemRefs are
+/// bundled in a single dynamic memory pool.
+func @test_dynamic_pool_chain(%arg0: memref<?x10xf32>) -> memref<?x10xf32> {
+  %c0 = constant 0 : index
+  %cst = constant 0.000000e+00 : f32
+  %0 = dim %arg0, %c0 : memref<?x10xf32>
+  %1 = alloc(%0) : memref<?x10xf32>
+  affine.store %cst, %1[0, 0] : memref<?x10xf32>
+  %2 = dim %1, %c0 : memref<?x10xf32>
+  %3 = alloc(%2) : memref<?x10xf32>
+  %4 = affine.load %1[0, 0] : memref<?x10xf32>
+  affine.store %4, %3[0, 0] : memref<?x10xf32>
+  %5 = dim %3, %c0 : memref<?x10xf32>
+  %6 = alloc(%5) : memref<?x10xf32>
+  %7 = affine.load %3[0, 0] : memref<?x10xf32>
+  affine.store %7, %6[0, 0] : memref<?x10xf32>
+  dealloc %3 : memref<?x10xf32>
+  dealloc %1 : memref<?x10xf32>
+  return %6 : memref<?x10xf32>
+
+  // CHECK-LABEL: test_dynamic_pool_chain
+  // CHECK: [[DIM:%.+]] = dim %arg0, {{.*}} : memref<?x10xf32>
+  // CHECK: [[MEMPOOL:%.+]] = alloc({{.*}}) : memref<?xi8>
+  // CHECK: "krnl.getref"([[MEMPOOL]], {{.*}}, [[DIM]]) : (memref<?xi8>, i64, index) -> memref<?x10xf32>
+  // CHECK: "krnl.getref"([[MEMPOOL]], {{.*}}, [[DIM]]) : (memref<?xi8>, i64, index) -> memref<?x10xf32>
+  // CHECK: [[RES:%.+]] = alloc([[DIM]]) : memref<?x10xf32>
+  // CHECK: dealloc [[MEMPOOL]] : memref<?xi8>
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RES]] : memref<?x10xf32>
+
+  /// The MemRefs of the memory pool are lowered with their dynamic sizes.
+  // LLVM-LABEL: llvm.func @test_dynamic_pool_chain
+  // LLVM-NOT: krnl.getref
+  // LLVM: llvm.return
+}
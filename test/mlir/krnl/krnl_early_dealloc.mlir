@@ -0,0 +1,89 @@
+// RUN: onnx-mlir-opt --early-dealloc %s -split-input-file | FileCheck %s
+
+func @test_dealloc_at_last_use(%arg0: memref<?xf32>) -> memref<?xf32> {
+  %c0 = constant 0 : index
+  %d0 = dim %arg0, %c0 : memref<?xf32>
+  %0 = alloc(%d0) : memref<?xf32>
+  %1 = alloc(%d0) : memref<?xf32>
+  %2 = alloc(%d0) : memref<?xf32>
+  affine.for %i = 0 to %d0 {
+    %3 = affine.load %arg0[%i] : memref<?xf32>
+    affine.store %3, %0[%i] : memref<?xf32>
+  }
+  affine.for %i = 0 to %d0 {
+    %3 = affine.load %0[%i] : memref<?xf32>
+    affine.store %3, %1[%i] : memref<?xf32>
+  }
+  affine.for %i = 0 to %d0 {
+    %3 = affine.load %1[%i] : memref<?xf32>
+    affine.store %3, %2[%i] : memref<?xf32>
+  }
+  dealloc %0 : memref<?xf32>
+  dealloc %1 : memref<?xf32>
+  return %2 : memref<?xf32>
+
+  // CHECK-LABEL: test_dealloc_at_last_use
+  // CHECK: [[ALLOC0:%.+]] = alloc
+  // CHECK: [[ALLOC1:%.+]] = alloc
+  // CHECK: [[ALLOC2:%.+]] = alloc
+  // CHECK: affine.for
+  // CHECK: affine.store {{.*}}, [[ALLOC0]]
+  // CHECK: affine.for
+  // CHECK: affine.load [[ALLOC0]]
+  // CHECK: affine.store {{.*}}, [[ALLOC1]]
+  // CHECK: }
+  // CHECK-NEXT: dealloc [[ALLOC0]]
+  // CHECK-NEXT: affine.for
+  // CHECK: affine.load [[ALLOC1]]
+  // CHECK: affine.store {{.*}}, [[ALLOC2]]
+  // CHECK: }
+  // CHECK-NEXT: dealloc [[ALLOC1]]
+  // CHECK-NEXT: return [[ALLOC2]]
+}
+
+// -----
+
+// The MemRefs obtained from a memory pool keep it live.
+func @test_dealloc_memory_pool_after_getref_uses(%arg0: memref<10xf32>) -> memref<10xf32> {
+  %c0_i64 = constant 0 : i64
+  %c0 = constant 0 : index
+  %0 = alloc() : memref<40xi8>
+  %1 = "krnl.getref"(%0, %c0_i64) : (memref<40xi8>, i64) -> memref<10xf32>
+  %2 = alloc() : memref<10xf32>
+  %3 = affine.load %arg0[%c0] : memref<10xf32>
+  affine.store %3, %1[%c0] : memref<10xf32>
+  %4 = affine.load %1[%c0] : memref<10xf32>
+  affine.store %4, %2[%c0] : memref<10xf32>
+  affine.store %4, %2[%c0] : memref<10xf32>
+  dealloc %0 : memref<40xi8>
+  return %2 : memref<10xf32>
+
+  // CHECK-LABEL: test_dealloc_memory_pool_after_getref_uses
+  // CHECK: [[POOL:%.+]] = alloc() : memref<40xi8>
+  // CHECK: [[REF:%.+]] = "krnl.getref"([[POOL]]
+  // CHECK: [[LOAD:%.+]] = affine.load [[REF]]
+  // CHECK-NEXT: dealloc [[POOL]]
+  // CHECK-NEXT: affine.store [[LOAD]]
+  // CHECK-NEXT: affine.store [[LOAD]]
+  // CHECK-NEXT: return
+}
+
+// -----
+
+// A MemRef returned through an alias is not deallocated earlier.
+func @test_no_early_dealloc_of_escaping_memref(%arg0: memref<10xf32>) -> memref<?xf32> {
+  %c0 = constant 0 : index
+  %0 = alloc() : memref<10xf32>
+  %1 = memref_cast %0 : memref<10xf32> to memref<?xf32>
+  %2 = affine.load %arg0[%c0] : memref<10xf32>
+  affine.store %2, %0[%c0] : memref<10xf32>
+  affine.store %2, %arg0[%c0] : memref<10xf32>
+  dealloc %0 : memref<10xf32>
+  return %1 : memref<?xf32>
+
+  // CHECK-LABEL: test_no_early_dealloc_of_escaping_memref
+  // CHECK: affine.store
+  // CHECK-NEXT: affine.store
+  // CHECK-NEXT: dealloc
+  // CHECK-NEXT: return
+}
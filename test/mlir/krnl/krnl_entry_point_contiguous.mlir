@@ -0,0 +1,27 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-llvm %s | FileCheck %s
+
+/// The inputs are repacked into temporary dense tensors, which are released
+/// after the call of the inference function. The tensors of the caller are
+/// not modified.
+module {
+  func @main_graph(%arg0: memref<10xf32>, %arg1: memref<10xf32>) -> memref<10xf32> {
+    %0 = alloc() : memref<10xf32>
+    %1 = affine.load %arg0[0] : memref<10xf32>
+    %2 = affine.load %arg1[0] : memref<10xf32>
+    %3 = addf %1, %2 : f32
+    affine.store %3, %0[0] : memref<10xf32>
+    return %0 : memref<10xf32>
+  }
+  "krnl.entry_point"() {func = @main_graph, numInputs = 2 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: llvm.func @run_main_graph
+  // CHECK: [[IN0:%.+]] = llvm.load {{.*}} : !llvm.ptr<ptr<i8>>
+  // CHECK: [[DENSE0:%.+]] = llvm.call @omTensorGetContiguous([[IN0]])
+  // CHECK: llvm.call @omTensorGetDataPtr([[DENSE0]])
+  // CHECK: [[IN1:%.+]] = llvm.load {{.*}} : !llvm.ptr<ptr<i8>>
+  // CHECK: [[DENSE1:%.+]] = llvm.call @omTensorGetContiguous([[IN1]])
+  // CHECK: llvm.call @_mlir_ciface_main_graph
+  // CHECK: llvm.call @omTensorReleaseContiguous([[DENSE0]], [[IN0]])
+  // CHECK: llvm.call @omTensorReleaseContiguous([[DENSE1]], [[IN1]])
+  // CHECK: llvm.call @omTensorListCreate
+}
@@ -0,0 +1,20 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-llvm %s | FileCheck %s
+
+/// The signature of the model is returned by omInputSignature and
+/// omOutputSignature.
+module {
+  func @main_graph(%arg0: memref<?x3xf32>) -> memref<?x3xf32> {
+    return %arg0 : memref<?x3xf32>
+  }
+  "krnl.entry_point"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 1 : i32, inputSignature = "[{\"dims\":[-1,3],\"name\":\"x\",\"type\":\"f32\"}]", outputSignature = "[{\"dims\":[-1,3],\"name\":\"y\",\"type\":\"f32\"}]"} : () -> ()
+
+  // CHECK-DAG: llvm.mlir.global internal constant @omInputSignature_str("[{{.*}}x{{.*}}f32{{.*}}]\00")
+  // CHECK-DAG: llvm.mlir.global internal constant @omOutputSignature_str("[{{.*}}y{{.*}}f32{{.*}}]\00")
+  // CHECK-LABEL: llvm.func @omInputSignature() -> !llvm.ptr<i8>
+  // CHECK: [[ADDR:%.+]] = llvm.mlir.addressof @omInputSignature_str
+  // CHECK: [[ZERO:%.+]] = llvm.mlir.constant(0 : i64) : !llvm.i64
+  // CHECK: [[STR:%.+]] = llvm.getelementptr [[ADDR]]{{\[}}[[ZERO]], [[ZERO]]{{\]}}
+  // CHECK: llvm.return [[STR]] : !llvm.ptr<i8>
+  // CHECK-LABEL: llvm.func @omOutputSignature() -> !llvm.ptr<i8>
+  // CHECK: llvm.mlir.addressof @omOutputSignature_str
+}
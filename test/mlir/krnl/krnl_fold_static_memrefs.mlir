@@ -0,0 +1,34 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-affine --convert-krnl-to-llvm='fold-static-memrefs=true' %s -split-input-file | FileCheck %s
+
+/// The offset, sizes and strides of a static MemRef argument are constants,
+/// the function keeps the arguments of its descriptor.
+func @test_fold_static_memrefs(%arg0: memref<2x8xf32>) -> memref<2x8xf32> {
+  return %arg0 : memref<2x8xf32>
+
+  // CHECK-LABEL: llvm.func @test_fold_static_memrefs
+  // CHECK-SAME: ([[ALLOCATED:%.+]]: !llvm.ptr<float>, [[ALIGNED:%.+]]: !llvm.ptr<float>, {{%.+}}: !llvm.i64, {{%.+}}: !llvm.i64, {{%.+}}: !llvm.i64, {{%.+}}: !llvm.i64, {{%.+}}: !llvm.i64)
+  // CHECK-DAG: [[OFFSET:%.+]] = llvm.mlir.constant(0 : i64) : !llvm.i64
+  // CHECK-DAG: [[SIZE0:%.+]] = llvm.mlir.constant(2 : i64) : !llvm.i64
+  // CHECK-DAG: [[SIZE1:%.+]] = llvm.mlir.constant(8 : i64) : !llvm.i64
+  // CHECK-DAG: [[STRIDE1:%.+]] = llvm.mlir.constant(1 : i64) : !llvm.i64
+  // CHECK: llvm.insertvalue [[ALLOCATED]], {{.*}}[0]
+  // CHECK: llvm.insertvalue [[ALIGNED]], {{.*}}[1]
+  // CHECK: llvm.insertvalue [[OFFSET]], {{.*}}[2]
+  // CHECK: llvm.insertvalue [[SIZE0]], {{.*}}[3, 0]
+  // CHECK: llvm.insertvalue [[SIZE1]], {{.*}}[3, 1]
+  // CHECK: llvm.insertvalue {{.*}}[4, 0]
+  // CHECK: llvm.insertvalue [[STRIDE1]], {{.*}}[4, 1]
+}
+
+// -----
+
+/// The fields of a dynamic MemRef argument are left as is.
+func @test_no_fold_dynamic_memrefs(%arg0: memref<?x8xf32>) -> memref<?x8xf32> {
+  return %arg0 : memref<?x8xf32>
+
+  // CHECK-LABEL: llvm.func @test_no_fold_dynamic_memrefs
+  // CHECK-SAME: ({{%.+}}: !llvm.ptr<float>, {{%.+}}: !llvm.ptr<float>, [[OFFSET:%.+]]: !llvm.i64, [[SIZE0:%.+]]: !llvm.i64, [[SIZE1:%.+]]: !llvm.i64, [[STRIDE0:%.+]]: !llvm.i64, [[STRIDE1:%.+]]: !llvm.i64)
+  // CHECK-NOT: llvm.mlir.constant
+  // CHECK: llvm.insertvalue [[OFFSET]], {{.*}}[2]
+  // CHECK: llvm.insertvalue [[SIZE0]], {{.*}}[3, 0]
+}
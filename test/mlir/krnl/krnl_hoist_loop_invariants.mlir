@@ -0,0 +1,60 @@
+// RUN: onnx-mlir-opt --hoist-krnl-loop-invariants %s -split-input-file | FileCheck %s
+
+/// The broadcasting index of the inner loop nest only depends on the outer
+/// induction variable, and is computed once per iteration of the outer loop.
+func @test_hoist_broadcast_index(%arg0: memref<?x20xf32>, %arg1: memref<1x20xf32>) -> memref<?x20xf32> {
+  %c0 = constant 0 : index
+  %c1 = constant 1 : index
+  %d0 = dim %arg0, %c0 : memref<?x20xf32>
+  %0 = alloc(%d0) : memref<?x20xf32>
+  %1 = krnl.define_loops 1
+  krnl.iterate(%1) with (%1 -> %arg2 = 0 to %d0) {
+    %2 = krnl.define_loops 1
+    krnl.iterate(%2) with (%2 -> %arg3 = 0 to 20) {
+      %3 = "krnl.dim"(%arg1, %c0) : (memref<1x20xf32>, index) -> index
+      %4 = cmpi "eq", %3, %c1 : index
+      %5 = select %4, %c0, %arg2 : index
+      %6 = load %arg1[%5, %arg3] : memref<1x20xf32>
+      %7 = affine.load %arg0[%arg2, %arg3] : memref<?x20xf32>
+      %8 = addf %6, %7 : f32
+      affine.store %8, %0[%arg2, %arg3] : memref<?x20xf32>
+    }
+  }
+  return %0 : memref<?x20xf32>
+
+  // CHECK-LABEL: test_hoist_broadcast_index
+  // CHECK: [[DIM:%.+]] = "krnl.dim"(%arg1, %c0) : (memref<1x20xf32>, index) -> index
+  // CHECK: [[IS_ONE:%.+]] = cmpi "eq", [[DIM]], %c1 : index
+  // CHECK: [[OUTER:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.iterate([[OUTER]]) with ([[OUTER]] -> [[I:%.+]] = 0 to %{{.+}}) {
+  // CHECK:   [[ROW:%.+]] = select [[IS_ONE]], %c0, [[I]] : index
+  // CHECK:   [[INNER:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[INNER]]) with ([[INNER]] -> [[J:%.+]] = 0 to 20) {
+  // CHECK:     [[B:%.+]] = load %arg1{{\[}}[[ROW]], [[J]]{{\]}} : memref<1x20xf32>
+  // CHECK:     [[A:%.+]] = affine.load %arg0{{\[}}[[I]], [[J]]{{\]}} : memref<?x20xf32>
+  // CHECK:     [[SUM:%.+]] = addf [[B]], [[A]] : f32
+  // CHECK:     affine.store [[SUM]], {{.*}}{{\[}}[[I]], [[J]]{{\]}} : memref<?x20xf32>
+}
+
+// -----
+
+/// Loads, stores and integer divisions stay in the loop nest.
+func @test_no_hoist(%arg0: memref<10xindex>, %arg1: index) -> memref<10xindex> {
+  %c2 = constant 2 : index
+  %0 = alloc() : memref<10xindex>
+  %1 = krnl.define_loops 1
+  krnl.iterate(%1) with (%1 -> %arg2 = 0 to 10) {
+    %2 = load %arg0[%c2] : memref<10xindex>
+    %3 = divi_signed %arg1, %c2 : index
+    %4 = addi %2, %3 : index
+    affine.store %4, %0[%arg2] : memref<10xindex>
+  }
+  return %0 : memref<10xindex>
+
+  // CHECK-LABEL: test_no_hoist
+  // CHECK: krnl.iterate
+  // CHECK-NEXT: load %arg0
+  // CHECK-NEXT: divi_signed %arg1
+  // CHECK-NEXT: addi
+  // CHECK-NEXT: affine.store
+}
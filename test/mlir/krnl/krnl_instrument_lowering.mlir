@@ -0,0 +1,19 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-llvm %s -split-input-file | FileCheck %s
+
+func @test_instrument_lowering() {
+  "krnl.instrument"() {nodeName = "relu0", opName = "onnx.Relu", shapes = "(tensor<10xf32>) -> (tensor<10xf32>)", tag = 0 : i64} : () -> ()
+  "krnl.instrument"() {nodeName = "relu0", opName = "onnx.Relu", shapes = "(tensor<10xf32>) -> (tensor<10xf32>)", tag = 1 : i64} : () -> ()
+  return
+
+  /// The strings describing the operation are shared by both calls.
+  // CHECK-DAG: llvm.mlir.global internal constant @om_instrument_str_{{.*}}("onnx.Relu\00")
+  // CHECK-DAG: llvm.mlir.global internal constant @om_instrument_str_{{.*}}("relu0\00")
+  // CHECK-DAG: llvm.func @omInstrumentPoint(!llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.i64)
+  // CHECK-LABEL: llvm.func @test_instrument_lowering
+  // CHECK: [[BEFORE:%.+]] = llvm.mlir.constant(0 : i64) : !llvm.i64
+  // CHECK: llvm.call @omInstrumentPoint({{.*}}, {{.*}}, {{.*}}, [[BEFORE]]) : (!llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.i64) -> ()
+  // CHECK: [[AFTER:%.+]] = llvm.mlir.constant(1 : i64) : !llvm.i64
+  // CHECK: llvm.call @omInstrumentPoint({{.*}}, {{.*}}, {{.*}}, [[AFTER]]) : (!llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.i64) -> ()
+  // CHECK-NOT: llvm.mlir.global
+  // CHECK: llvm.return
+}
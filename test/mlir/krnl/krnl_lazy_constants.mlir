@@ -0,0 +1,23 @@
+// RUN: onnx-mlir-opt --pack-krnl-constants='elision-threshold=3 move-to-file=true filename=test-lazy-constants.bin' --convert-krnl-to-llvm='lazy-constants=true' %s -split-input-file | FileCheck %s && rm -f test-lazy-constants.bin
+
+func @main_graph() -> memref<1x4xf32> {
+  %0 = "krnl.global"() {name = "constant_0", shape = [1, 4], value = dense<[[0., 1., 2., 3.]]> : tensor<1x4xf32>} : () -> memref<1x4xf32>
+  %1 = "krnl.global"() {name = "constant_1", shape = [1, 4], value = dense<[[0., 1., 2., 3.]]> : tensor<1x4xf32>} : () -> memref<1x4xf32>
+  return %1 : memref<1x4xf32>
+}
+
+// CHECK-DAG: llvm.func @getLazyEmbeddedConst(!llvm.ptr<ptr<i8>>, !llvm.i64, !llvm.i64) -> !llvm.ptr<i8>
+// CHECK-DAG: llvm.mlir.global internal @constant_0_storage() : !llvm.ptr<i8> {
+// CHECK-DAG: llvm.mlir.global internal @constant_1_storage() : !llvm.ptr<i8> {
+
+// CHECK-LABEL: llvm.func @main_graph
+// CHECK-NOT: llvm.call @getEmbeddedConstPool
+// CHECK: [[STORAGE0:%.+]] = llvm.mlir.addressof @constant_0_storage : !llvm.ptr<ptr<i8>>
+// CHECK: [[OFFSET0:%.+]] = llvm.mlir.constant(0 : i64) : !llvm.i64
+// CHECK: [[SIZE0:%.+]] = llvm.mlir.constant(16 : i64) : !llvm.i64
+// CHECK: llvm.call @getLazyEmbeddedConst([[STORAGE0]], [[OFFSET0]], [[SIZE0]]) : (!llvm.ptr<ptr<i8>>, !llvm.i64, !llvm.i64) -> !llvm.ptr<i8>
+// CHECK: [[STORAGE1:%.+]] = llvm.mlir.addressof @constant_1_storage : !llvm.ptr<ptr<i8>>
+// CHECK: [[OFFSET1:%.+]] = llvm.mlir.constant(16 : i64) : !llvm.i64
+// CHECK: [[SIZE1:%.+]] = llvm.mlir.constant(16 : i64) : !llvm.i64
+// CHECK: [[CONST1:%.+]] = llvm.call @getLazyEmbeddedConst([[STORAGE1]], [[OFFSET1]], [[SIZE1]]) : (!llvm.ptr<ptr<i8>>, !llvm.i64, !llvm.i64) -> !llvm.ptr<i8>
+// CHECK: llvm.bitcast [[CONST1]] : !llvm.ptr<i8> to !llvm.ptr<float>
@@ -0,0 +1,177 @@
+// RUN: onnx-mlir-opt --fuse-krnl-loops %s -split-input-file | FileCheck %s
+
+/// The loop nest of the Add is fused into the loop nest of the Relu, and the
+/// intermediate buffer is replaced by the added value.
+func @test_fuse_elementwise(%arg0: memref<10x20xf32>, %arg1: memref<10x20xf32>) -> memref<10x20xf32> {
+  %cst = constant 0.000000e+00 : f32
+  %0 = alloc() : memref<10x20xf32>
+  %1 = alloc() : memref<10x20xf32>
+  %2:2 = krnl.define_loops 2
+  krnl.parallel %2#0 : !krnl.loop
+  krnl.iterate(%2#0, %2#1) with (%2#0 -> %arg2 = 0 to 10, %2#1 -> %arg3 = 0 to 20) {
+    %4 = affine.load %arg0[%arg2, %arg3] : memref<10x20xf32>
+    %5 = affine.load %arg1[%arg2, %arg3] : memref<10x20xf32>
+    %6 = addf %4, %5 : f32
+    affine.store %6, %1[%arg2, %arg3] : memref<10x20xf32>
+  }
+  %3:2 = krnl.define_loops 2
+  krnl.parallel %3#0 : !krnl.loop
+  krnl.iterate(%3#0, %3#1) with (%3#0 -> %arg2 = 0 to 10, %3#1 -> %arg3 = 0 to 20) {
+    %4 = affine.load %1[%arg2, %arg3] : memref<10x20xf32>
+    %5 = cmpf "olt", %4, %cst : f32
+    %6 = select %5, %cst, %4 : f32
+    affine.store %6, %0[%arg2, %arg3] : memref<10x20xf32>
+  }
+  dealloc %1 : memref<10x20xf32>
+  return %0 : memref<10x20xf32>
+
+  // CHECK-LABEL: test_fuse_elementwise
+  // CHECK: [[CST:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x20xf32>
+  // CHECK-NOT: alloc
+  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg2 = 0 to 10, [[DEF_LOOPS]]#1 -> %arg3 = 0 to 20) {
+  // CHECK:   [[LOAD0:%.+]] = affine.load %arg0[%arg2, %arg3] : memref<10x20xf32>
+  // CHECK:   [[LOAD1:%.+]] = affine.load %arg1[%arg2, %arg3] : memref<10x20xf32>
+  // CHECK:   [[ADD:%.+]] = addf [[LOAD0]], [[LOAD1]] : f32
+  // CHECK:   [[CMP:%.+]] = cmpf "olt", [[ADD]], [[CST]] : f32
+  // CHECK:   [[RELU:%.+]] = select [[CMP]], [[CST]], [[ADD]] : f32
+  // CHECK:   affine.store [[RELU]], [[RES]][%arg2, %arg3] : memref<10x20xf32>
+  // CHECK: }
+  // CHECK-NOT: krnl.iterate
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RES]] : memref<10x20xf32>
+}
+
+// -----
+
+/// The loop nests are fused, but the intermediate buffer is kept as it is
+/// returned.
+func @test_fuse_keep_returned_buffer(%arg0: memref<10xf32>) -> (memref<10xf32>, memref<10xf32>) {
+  %0 = alloc() : memref<10xf32>
+  %1 = alloc() : memref<10xf32>
+  %2 = krnl.define_loops 1
+  krnl.iterate(%2) with (%2 -> %arg1 = 0 to 10) {
+    %4 = affine.load %arg0[%arg1] : memref<10xf32>
+    %5 = exp %4 : f32
+    affine.store %5, %1[%arg1] : memref<10xf32>
+  }
+  %3 = krnl.define_loops 1
+  krnl.iterate(%3) with (%3 -> %arg1 = 0 to 10) {
+    %4 = affine.load %1[%arg1] : memref<10xf32>
+    %5 = addf %4, %4 : f32
+    affine.store %5, %0[%arg1] : memref<10xf32>
+  }
+  return %0, %1 : memref<10xf32>, memref<10xf32>
+
+  // CHECK-LABEL: test_fuse_keep_returned_buffer
+  // CHECK: [[RES0:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[RES1:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[DEF_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.iterate([[DEF_LOOPS]]) with ([[DEF_LOOPS]] -> %arg1 = 0 to 10) {
+  // CHECK:   [[LOAD:%.+]] = affine.load %arg0[%arg1] : memref<10xf32>
+  // CHECK:   [[EXP:%.+]] = exp [[LOAD]] : f32
+  // CHECK:   affine.store [[EXP]], [[RES1]][%arg1] : memref<10xf32>
+  // CHECK:   [[LOAD_EXP:%.+]] = affine.load [[RES1]][%arg1] : memref<10xf32>
+  // CHECK:   [[ADD:%.+]] = addf [[LOAD_EXP]], [[LOAD_EXP]] : f32
+  // CHECK:   affine.store [[ADD]], [[RES0]][%arg1] : memref<10xf32>
+  // CHECK: }
+  // CHECK-NOT: krnl.iterate
+  // CHECK: return [[RES0]], [[RES1]] : memref<10xf32>, memref<10xf32>
+}
+
+// -----
+
+/// The consumer reads the elements written by other iterations of the
+/// producer, the loop nests are not fused.
+func @test_no_fuse_transposed_read(%arg0: memref<10x10xf32>) -> memref<10x10xf32> {
+  %0 = alloc() : memref<10x10xf32>
+  %1 = alloc() : memref<10x10xf32>
+  %2:2 = krnl.define_loops 2
+  krnl.iterate(%2#0, %2#1) with (%2#0 -> %arg1 = 0 to 10, %2#1 -> %arg2 = 0 to 10) {
+    %4 = affine.load %arg0[%arg1, %arg2] : memref<10x10xf32>
+    affine.store %4, %1[%arg1, %arg2] : memref<10x10xf32>
+  }
+  %3:2 = krnl.define_loops 2
+  krnl.iterate(%3#0, %3#1) with (%3#0 -> %arg1 = 0 to 10, %3#1 -> %arg2 = 0 to 10) {
+    %4 = affine.load %1[%arg2, %arg1] : memref<10x10xf32>
+    affine.store %4, %0[%arg1, %arg2] : memref<10x10xf32>
+  }
+  dealloc %1 : memref<10x10xf32>
+  return %0 : memref<10x10xf32>
+
+  // CHECK-LABEL: test_no_fuse_transposed_read
+  // CHECK: krnl.iterate
+  // CHECK: krnl.iterate
+  // CHECK: dealloc
+}
+
+// -----
+
+/// Loop nests over different spaces are not fused.
+func @test_no_fuse_different_bounds(%arg0: memref<10xf32>) -> memref<5xf32> {
+  %0 = alloc() : memref<5xf32>
+  %1 = alloc() : memref<10xf32>
+  %2 = krnl.define_loops 1
+  krnl.iterate(%2) with (%2 -> %arg1 = 0 to 10) {
+    %4 = affine.load %arg0[%arg1] : memref<10xf32>
+    affine.store %4, %1[%arg1] : memref<10xf32>
+  }
+  %3 = krnl.define_loops 1
+  krnl.iterate(%3) with (%3 -> %arg1 = 0 to 5) {
+    %4 = affine.load %1[%arg1] : memref<10xf32>
+    affine.store %4, %0[%arg1] : memref<5xf32>
+  }
+  dealloc %1 : memref<10xf32>
+  return %0 : memref<5xf32>
+
+  // CHECK-LABEL: test_no_fuse_different_bounds
+  // CHECK: krnl.iterate
+  // CHECK: krnl.iterate
+  // CHECK: dealloc
+}
+
+// -----
+
+/// The consumer overwrites in place the elements written by the producer, as
+/// the in-place lowering of element-wise operations does.
+func @test_fuse_in_place(%arg0: memref<10xf32>) -> memref<10xf32> {
+  %0 = alloc() : memref<10xf32>
+  %1 = alloc() : memref<10xf32>
+  %2 = krnl.define_loops 1
+  krnl.iterate(%2) with (%2 -> %arg1 = 0 to 10) {
+    %4 = affine.load %arg0[%arg1] : memref<10xf32>
+    %5 = exp %4 : f32
+    affine.store %5, %1[%arg1] : memref<10xf32>
+  }
+  %3 = krnl.define_loops 1
+  krnl.iterate(%3) with (%3 -> %arg1 = 0 to 10) {
+    %4 = affine.load %1[%arg1] : memref<10xf32>
+    %5 = exp %4 : f32
+    affine.store %5, %1[%arg1] : memref<10xf32>
+  }
+  %6 = krnl.define_loops 1
+  krnl.iterate(%6) with (%6 -> %arg1 = 0 to 10) {
+    %4 = affine.load %1[%arg1] : memref<10xf32>
+    affine.store %4, %0[%arg1] : memref<10xf32>
+  }
+  dealloc %1 : memref<10xf32>
+  return %0 : memref<10xf32>
+
+  // CHECK-LABEL: test_fuse_in_place
+  // CHECK: [[RES:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[BUF:%.+]] = alloc() : memref<10xf32>
+  // CHECK: krnl.iterate
+  // CHECK:   [[LOAD0:%.+]] = affine.load %arg0[%arg1] : memref<10xf32>
+  // CHECK:   [[EXP0:%.+]] = exp [[LOAD0]] : f32
+  // CHECK:   affine.store [[EXP0]], [[BUF]][%arg1] : memref<10xf32>
+  // CHECK:   [[LOAD1:%.+]] = affine.load [[BUF]][%arg1] : memref<10xf32>
+  // CHECK:   [[EXP1:%.+]] = exp [[LOAD1]] : f32
+  // CHECK:   affine.store [[EXP1]], [[BUF]][%arg1] : memref<10xf32>
+  // CHECK:   [[LOAD2:%.+]] = affine.load [[BUF]][%arg1] : memref<10xf32>
+  // CHECK:   affine.store [[LOAD2]], [[RES]][%arg1] : memref<10xf32>
+  // CHECK: }
+  // CHECK-NOT: krnl.iterate
+  // CHECK: dealloc [[BUF]] : memref<10xf32>
+}
@@ -0,0 +1,27 @@
+// RUN: onnx-mlir-opt --lower-affine --map-parallel-loops-to-gpu --convert-parallel-loops-to-gpu --gpu-kernel-outlining %s | FileCheck %s
+
+/// The parallel loops are launched as a kernel, the allocation stays on the
+/// host.
+func @test_parallel_loops_to_gpu(%arg0: memref<16x32xf32>) -> memref<16x32xf32> {
+  %0 = alloc() : memref<16x32xf32>
+  affine.parallel (%i, %j) = (0, 0) to (16, 32) {
+    %1 = affine.load %arg0[%i, %j] : memref<16x32xf32>
+    %2 = addf %1, %1 : f32
+    affine.store %2, %0[%i, %j] : memref<16x32xf32>
+  }
+  return %0 : memref<16x32xf32>
+
+  // CHECK: module attributes {gpu.container_module}
+  // CHECK-LABEL: func @test_parallel_loops_to_gpu
+  // CHECK: [[RES:%.+]] = alloc() : memref<16x32xf32>
+  // CHECK-NOT: scf.parallel
+  // CHECK: gpu.launch_func
+  // CHECK: return [[RES]] : memref<16x32xf32>
+  // CHECK: gpu.module @{{.*}} {
+  // CHECK: gpu.func @{{.*}}({{.*}}) kernel
+  // CHECK: gpu.block_id
+  // CHECK: [[LOAD:%.+]] = load
+  // CHECK: [[ADD:%.+]] = addf [[LOAD]], [[LOAD]] : f32
+  // CHECK: store [[ADD]]
+  // CHECK: gpu.return
+}
@@ -0,0 +1,38 @@
+// RUN: onnx-mlir-opt --use-memory-arena %s -split-input-file | FileCheck %s
+// RUN: onnx-mlir-opt --use-memory-arena --convert-krnl-to-affine --convert-krnl-to-llvm %s -split-input-file | FileCheck %s --check-prefix=LLVM
+
+func @test_memory_arena(%arg0: memref<?x10xf32>) -> memref<?x10xf32> {
+  %c0 = constant 0 : index
+  %c0_i64 = constant 0 : i64
+  %cst = constant 0.000000e+00 : f32
+  %0 = alloc() : memref<400xi8>
+  %1 = "krnl.getref"(%0, %c0_i64) : (memref<400xi8>, i64) -> memref<10x10xf32>
+  %2 = dim %arg0, %c0 : memref<?x10xf32>
+  %3 = alloc(%2) : memref<?xi8>
+  %4 = "krnl.getref"(%3, %c0_i64, %2) : (memref<?xi8>, i64, index) -> memref<?x10xf32>
+  %5 = alloc(%2) : memref<?x10xf32>
+  affine.store %cst, %1[0, 0] : memref<10x10xf32>
+  affine.store %cst, %4[0, 0] : memref<?x10xf32>
+  affine.store %cst, %5[0, 0] : memref<?x10xf32>
+  dealloc %3 : memref<?xi8>
+  dealloc %0 : memref<400xi8>
+  return %5 : memref<?x10xf32>
+
+  // CHECK-LABEL: test_memory_arena
+  // CHECK: [[STATIC_POOL:%.+]] = "krnl.arena_alloc"() {slot = 0 : i64} : () -> memref<400xi8>
+  // CHECK: "krnl.getref"([[STATIC_POOL]], {{.*}}) : (memref<400xi8>, i64) -> memref<10x10xf32>
+  // CHECK: [[DIM:%.+]] = dim %arg0, {{.*}} : memref<?x10xf32>
+  // CHECK: [[DYNAMIC_POOL:%.+]] = "krnl.arena_alloc"([[DIM]]) {slot = 1 : i64} : (index) -> memref<?xi8>
+  // CHECK: "krnl.getref"([[DYNAMIC_POOL]], {{.*}}, [[DIM]]) : (memref<?xi8>, i64, index) -> memref<?x10xf32>
+  // CHECK: [[RES:%.+]] = alloc([[DIM]]) : memref<?x10xf32>
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RES]] : memref<?x10xf32>
+
+  /// The memory pools are retrieved from the runtime arena.
+  // LLVM: llvm.func @omArenaGet(!llvm.i64, !llvm.i64) -> !llvm.ptr<i8>
+  // LLVM-LABEL: llvm.func @test_memory_arena
+  // LLVM: llvm.call @omArenaGet({{.*}}) : (!llvm.i64, !llvm.i64) -> !llvm.ptr<i8>
+  // LLVM: llvm.call @omArenaGet({{.*}}) : (!llvm.i64, !llvm.i64) -> !llvm.ptr<i8>
+  // LLVM-NOT: @free
+  // LLVM: llvm.return
+}
@@ -0,0 +1,81 @@
+// RUN: onnx-mlir-opt --report-memory-plan %s -split-input-file | FileCheck %s
+// RUN: onnx-mlir-opt --report-memory-plan='report-file=%t' %s && FileCheck --check-prefix=REPORT %s < %t
+// RUN: not onnx-mlir-opt --report-memory-plan='max-activation-memory=1000' %s -split-input-file 2>&1 | FileCheck --check-prefix=LIMIT %s
+
+/// The temporary buffer is deallocated before the memory pool and the output
+/// are allocated, the peak memory is the sum of the sizes of the memory pool
+/// and of the output.
+func @test_memory_plan(%arg0: memref<10x10xf32>) -> memref<10x10xf32> {
+  %c0_i64 = constant 0 : i64
+  %c400_i64 = constant 400 : i64
+  %ind = constant 0 : index
+  %cst = constant 0.000000e+00 : f32
+  %0 = alloc() : memref<200xf32>
+  affine.store %cst, %0[%ind] : memref<200xf32>
+  dealloc %0 : memref<200xf32>
+  %1 = alloc() : memref<800xi8>
+  %2 = "krnl.getref"(%1, %c0_i64) : (memref<800xi8>, i64) -> memref<10x10xf32>
+  %3 = "krnl.getref"(%1, %c400_i64) : (memref<800xi8>, i64) -> memref<10x10xf32>
+  %4 = alloc() : memref<10x10xf32>
+  affine.store %cst, %2[%ind, %ind] : memref<10x10xf32>
+  %5 = affine.load %2[%ind, %ind] : memref<10x10xf32>
+  affine.store %5, %3[%ind, %ind] : memref<10x10xf32>
+  %6 = affine.load %3[%ind, %ind] : memref<10x10xf32>
+  affine.store %6, %4[%ind, %ind] : memref<10x10xf32>
+  dealloc %1 : memref<800xi8>
+  return %4 : memref<10x10xf32>
+
+  // CHECK-LABEL: test_memory_plan
+  // CHECK-LABEL: func @omModelGetPeakMemory() -> i64
+  // CHECK: [[PEAK:%.+]] = constant 1200 : i64
+  // CHECK: return [[PEAK]] : i64
+
+  // REPORT: "peak_bytes": 1200,
+  // REPORT: "name": "test_memory_plan",
+  // REPORT-NEXT: "peak_bytes": 1200,
+  // REPORT-NEXT: "dynamic_buffers": 0,
+  // REPORT: "type": "memref<200xf32>",
+  // REPORT: "size_bytes": 800,
+  // REPORT-NEXT: "start": 4,
+  // REPORT-NEXT: "end": 6
+  // REPORT: "type": "memref<800xi8>",
+  // REPORT: "size_bytes": 800,
+  // REPORT-NEXT: "start": 7,
+  // REPORT-NEXT: "end": 16,
+  // REPORT-NEXT: "slots": [
+  // REPORT: "size_bytes": 400,
+  // REPORT-NEXT: "offset": 0,
+  // REPORT-NEXT: "start": 11,
+  // REPORT-NEXT: "end": 12
+  // REPORT: "size_bytes": 400,
+  // REPORT-NEXT: "offset": 400,
+  // REPORT-NEXT: "start": 13,
+  // REPORT-NEXT: "end": 14
+  // REPORT: "type": "memref<10x10xf32>",
+  // REPORT: "size_bytes": 400,
+  // REPORT-NEXT: "start": 10,
+  // REPORT-NEXT: "end": 18
+
+  // LIMIT: error: peak memory of 1200 bytes exceeds the maximum activation memory of 1000 bytes
+}
+
+// -----
+
+/// The size of a dynamically shaped buffer is unknown, so is the peak memory.
+func @test_memory_plan_dynamic(%arg0: memref<?xf32>) -> memref<?xf32> {
+  %c0 = constant 0 : index
+  %0 = dim %arg0, %c0 : memref<?xf32>
+  %1 = alloc(%0) : memref<?xf32>
+  return %1 : memref<?xf32>
+
+  // CHECK-LABEL: test_memory_plan_dynamic
+  // CHECK-LABEL: func @omModelGetPeakMemory() -> i64
+  // CHECK: [[PEAK:%.+]] = constant -1 : i64
+  // CHECK: return [[PEAK]] : i64
+
+  // REPORT: "name": "test_memory_plan_dynamic",
+  // REPORT-NEXT: "peak_bytes": 0,
+  // REPORT-NEXT: "dynamic_buffers": 1,
+  // REPORT: "type": "memref<?xf32>",
+  // REPORT: "size_bytes": null,
+}
@@ -0,0 +1,33 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-llvm="narrow-indices=true" %s -split-input-file | FileCheck %s
+
+/// The element offsets of small static MemRefs are computed in 32 bits.
+func @test_narrow_indices(%arg0: memref<10x20xf32>, %arg1: index, %arg2: index) -> memref<10x20xf32> {
+  %0 = alloc() : memref<10x20xf32>
+  %1 = load %arg0[%arg1, %arg2] : memref<10x20xf32>
+  store %1, %0[%arg1, %arg2] : memref<10x20xf32>
+  return %0 : memref<10x20xf32>
+
+  // CHECK-LABEL: llvm.func @test_narrow_indices
+  // CHECK: [[J:%.+]] = llvm.trunc %arg{{[0-9]+}} : !llvm.i64 to !llvm.i32
+  // CHECK: [[I:%.+]] = llvm.trunc %arg{{[0-9]+}} : !llvm.i64 to !llvm.i32
+  // CHECK: [[C20:%.+]] = llvm.mlir.constant(20 : i32) : !llvm.i32
+  // CHECK: [[ROW:%.+]] = llvm.mul [[I]], [[C20]] : !llvm.i32
+  // CHECK: [[LINEAR:%.+]] = llvm.add [[J]], [[ROW]] : !llvm.i32
+  // CHECK: [[OFFSET:%.+]] = llvm.sext [[LINEAR]] : !llvm.i32 to !llvm.i64
+  // CHECK: [[PTR:%.+]] = llvm.getelementptr {{.*}}{{\[}}[[OFFSET]]{{\]}} : (!llvm.ptr<float>, !llvm.i64) -> !llvm.ptr<float>
+  // CHECK: [[VALUE:%.+]] = llvm.load [[PTR]] : !llvm.ptr<float>
+  // CHECK: llvm.sext {{.*}} : !llvm.i32 to !llvm.i64
+  // CHECK: llvm.store [[VALUE]], {{.*}} : !llvm.ptr<float>
+}
+
+// -----
+
+/// The accesses to dynamically shaped MemRefs keep 64-bit offsets.
+func @test_dynamic_indices(%arg0: memref<?x20xf32>, %arg1: index, %arg2: index) -> f32 {
+  %0 = load %arg0[%arg1, %arg2] : memref<?x20xf32>
+  return %0 : f32
+
+  // CHECK-LABEL: llvm.func @test_dynamic_indices
+  // CHECK-NOT: llvm.trunc
+  // CHECK: llvm.load
+}
@@ -0,0 +1,71 @@
+// RUN: onnx-mlir-opt --optimize-memory-pools --canonicalize %s -split-input-file | FileCheck %s
+
+func @test_pool_reuse(%arg0: memref<10x10xf32>) -> memref<10x10xf32> {
+  %c0_i64 = constant 0 : i64
+  %c400_i64 = constant 400 : i64
+  %c800_i64 = constant 800 : i64
+  %c1600_i64 = constant 1600 : i64
+  %ind = constant 0 : index
+  %cst = constant 0.000000e+00 : f32
+  %0 = alloc() : memref<2000xi8>
+  %1 = "krnl.getref"(%0, %c1600_i64) : (memref<2000xi8>, i64) -> memref<10x10xf32>
+  %2 = "krnl.getref"(%0, %c800_i64) : (memref<2000xi8>, i64) -> memref<10x20xf32>
+  %3 = "krnl.getref"(%0, %c400_i64) : (memref<2000xi8>, i64) -> memref<10x10xf32>
+  %4 = "krnl.getref"(%0, %c0_i64) : (memref<2000xi8>, i64) -> memref<10x10xf32>
+  %5 = alloc() : memref<10x10xf32>
+  affine.store %cst, %1[%ind, %ind] : memref<10x10xf32>
+  %6 = affine.load %1[%ind, %ind] : memref<10x10xf32>
+  affine.store %6, %5[%ind, %ind] : memref<10x10xf32>
+  affine.store %cst, %2[%ind, %ind] : memref<10x20xf32>
+  affine.store %cst, %3[%ind, %ind] : memref<10x10xf32>
+  %7 = affine.load %2[%ind, %ind] : memref<10x20xf32>
+  affine.store %7, %5[%ind, %ind] : memref<10x10xf32>
+  %8 = affine.load %3[%ind, %ind] : memref<10x10xf32>
+  affine.store %8, %5[%ind, %ind] : memref<10x10xf32>
+  affine.store %cst, %4[%ind, %ind] : memref<10x10xf32>
+  %9 = affine.load %4[%ind, %ind] : memref<10x10xf32>
+  affine.store %9, %5[%ind, %ind] : memref<10x10xf32>
+  dealloc %0 : memref<2000xi8>
+  return %5 : memref<10x10xf32>
+
+  /// The second and third MemRefs are live at the same time, all the other
+  /// MemRefs reuse the memory of the second one.
+  // CHECK-LABEL: test_pool_reuse
+  // CHECK-DAG: [[CONST_0:%.+]] = constant 0 : i64
+  // CHECK-DAG: [[CONST_800:%.+]] = constant 800 : i64
+  // CHECK: [[MEMPOOL:%.+]] = alloc() : memref<1200xi8>
+  // CHECK: [[MEMREF1:%.+]] = "krnl.getref"([[MEMPOOL]], [[CONST_0]]) : (memref<1200xi8>, i64) -> memref<10x10xf32>
+  // CHECK: [[MEMREF2:%.+]] = "krnl.getref"([[MEMPOOL]], [[CONST_0]]) : (memref<1200xi8>, i64) -> memref<10x20xf32>
+  // CHECK: [[MEMREF3:%.+]] = "krnl.getref"([[MEMPOOL]], [[CONST_800]]) : (memref<1200xi8>, i64) -> memref<10x10xf32>
+  // CHECK: [[MEMREF4:%.+]] = "krnl.getref"([[MEMPOOL]], [[CONST_0]]) : (memref<1200xi8>, i64) -> memref<10x10xf32>
+  // CHECK: dealloc [[MEMPOOL]] : memref<1200xi8>
+}
+
+// -----
+
+func @test_pool_alias(%arg0: memref<10x10xf32>) -> memref<10x10xf32> {
+  %c0_i64 = constant 0 : i64
+  %c400_i64 = constant 400 : i64
+  %ind = constant 0 : index
+  %cst = constant 0.000000e+00 : f32
+  %0 = alloc() : memref<800xi8>
+  %1 = "krnl.getref"(%0, %c400_i64) : (memref<800xi8>, i64) -> memref<10x10xf32>
+  %2 = "krnl.getref"(%0, %c0_i64) : (memref<800xi8>, i64) -> memref<10x10xf32>
+  %3 = alloc() : memref<10x10xf32>
+  %4 = memref_cast %1 : memref<10x10xf32> to memref<?x10xf32>
+  affine.store %cst, %4[%ind, %ind] : memref<?x10xf32>
+  affine.store %cst, %2[%ind, %ind] : memref<10x10xf32>
+  %5 = affine.load %2[%ind, %ind] : memref<10x10xf32>
+  affine.store %5, %3[%ind, %ind] : memref<10x10xf32>
+  dealloc %0 : memref<800xi8>
+  return %3 : memref<10x10xf32>
+
+  /// A MemRef used through an alias stays live until the end of the block.
+  // CHECK-LABEL: test_pool_alias
+  // CHECK-DAG: [[CONST_0:%.+]] = constant 0 : i64
+  // CHECK-DAG: [[CONST_400:%.+]] = constant 400 : i64
+  // CHECK: [[MEMPOOL:%.+]] = alloc() : memref<800xi8>
+  // CHECK: [[MEMREF1:%.+]] = "krnl.getref"([[MEMPOOL]], [[CONST_400]]) : (memref<800xi8>, i64) -> memref<10x10xf32>
+  // CHECK: [[MEMREF2:%.+]] = "krnl.getref"([[MEMPOOL]], [[CONST_0]]) : (memref<800xi8>, i64) -> memref<10x10xf32>
+  // CHECK: dealloc [[MEMPOOL]] : memref<800xi8>
+}
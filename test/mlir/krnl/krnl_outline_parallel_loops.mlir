@@ -0,0 +1,88 @@
+// RUN: onnx-mlir-opt --outline-parallel-loops="num-threads=4" %s -split-input-file | FileCheck %s
+
+/// The outlined function runs the iterations [begin, end) of the first
+/// dimension of the loop. The constants are copied into it.
+func @test_outline_parallel_loop(%arg0: memref<16x32xf32>, %arg1: memref<16x32xf32>) {
+  %c0 = constant 0 : index
+  %c1 = constant 1 : index
+  %c16 = constant 16 : index
+  %c32 = constant 32 : index
+  scf.parallel (%i, %j) = (%c0, %c0) to (%c16, %c32) step (%c1, %c1) {
+    %0 = load %arg0[%i, %j] : memref<16x32xf32>
+    store %0, %arg1[%i, %j] : memref<16x32xf32>
+  }
+  return
+
+  // CHECK: func {{.*}}@test_outline_parallel_loop_parallel0(%arg0: index, %arg1: index, %arg2: memref<16x32xf32>, %arg3: memref<16x32xf32>) attributes {{.*}}krnl.outlined
+  // CHECK: [[C0:%.+]] = constant 0 : index
+  // CHECK: [[C16:%.+]] = constant 16 : index
+  // CHECK: [[C32:%.+]] = constant 32 : index
+  // CHECK: [[C1:%.+]] = constant 1 : index
+  // CHECK: [[BEGIN_OFFSET:%.+]] = muli %arg0, [[C1]] : index
+  // CHECK: [[BEGIN:%.+]] = addi [[C0]], [[BEGIN_OFFSET]] : index
+  // CHECK: [[END_OFFSET:%.+]] = muli %arg1, [[C1]] : index
+  // CHECK: [[END:%.+]] = addi [[C0]], [[END_OFFSET]] : index
+  // CHECK: [[IS_BEFORE_UB:%.+]] = cmpi "slt", [[END]], [[C16]] : index
+  // CHECK: [[UB:%.+]] = select [[IS_BEFORE_UB]], [[END]], [[C16]] : index
+  // CHECK: scf.parallel ([[I:%.+]], [[J:%.+]]) = ([[BEGIN]], [[C0]]) to ([[UB]], [[C32]]) step ([[C1]], [[C1]]) {
+  // CHECK: [[LOAD:%.+]] = load %arg2{{\[}}[[I]], [[J]]{{\]}} : memref<16x32xf32>
+  // CHECK: store [[LOAD]], %arg3{{\[}}[[I]], [[J]]{{\]}} : memref<16x32xf32>
+  // CHECK: return
+
+  // CHECK-LABEL: func @test_outline_parallel_loop(
+  // CHECK: [[ONE:%.+]] = constant 1 : index
+  // CHECK: [[SIZE:%.+]] = subi %c16, %c0 : index
+  // CHECK: [[SIZE_STEP:%.+]] = addi [[SIZE]], %c1 : index
+  // CHECK: [[SIZE_UP:%.+]] = subi [[SIZE_STEP]], [[ONE]] : index
+  // CHECK: [[NUM_ITERATIONS:%.+]] = divi_signed [[SIZE_UP]], %c1 : index
+  // CHECK: "krnl.parallel_for"([[NUM_ITERATIONS]], %arg0, %arg1) {func = @test_outline_parallel_loop_parallel0, numThreads = 4 : i64} : (index, memref<16x32xf32>, memref<16x32xf32>) -> ()
+  // CHECK-NOT: scf.parallel
+  // CHECK: return
+}
+
+// -----
+
+/// The bounds and the values used by the loop are passed to the outlined
+/// function.
+func @test_outline_dynamic_parallel_loop(%arg0: memref<?xf32>, %arg1: index) {
+  %c0 = constant 0 : index
+  %c2 = constant 2 : index
+  scf.parallel (%i) = (%c0) to (%arg1) step (%c2) {
+    %0 = load %arg0[%i] : memref<?xf32>
+    %1 = addf %0, %0 : f32
+    store %1, %arg0[%i] : memref<?xf32>
+  }
+  return
+
+  // CHECK: func {{.*}}@test_outline_dynamic_parallel_loop_parallel0(%arg0: index, %arg1: index, %arg2: index, %arg3: memref<?xf32>)
+  // CHECK: cmpi "slt", {{.*}}, %arg2 : index
+  // CHECK: scf.parallel
+  // CHECK: load %arg3
+
+  // CHECK-LABEL: func @test_outline_dynamic_parallel_loop(
+  // CHECK: [[SIZE:%.+]] = subi %arg1, %c0 : index
+  // CHECK: "krnl.parallel_for"({{.*}}, %arg1, %arg0) {func = @test_outline_dynamic_parallel_loop_parallel0, numThreads = 4 : i64} : (index, index, memref<?xf32>) -> ()
+}
+
+// -----
+
+/// Loops of a single iteration are left sequential, and so are the loops
+/// nested in a parallel loop.
+func @test_single_iteration(%arg0: memref<1x8xf32>) {
+  %c0 = constant 0 : index
+  %c1 = constant 1 : index
+  %c8 = constant 8 : index
+  scf.parallel (%i) = (%c0) to (%c1) step (%c1) {
+    scf.parallel (%j) = (%c0) to (%c8) step (%c1) {
+      %0 = load %arg0[%i, %j] : memref<1x8xf32>
+      %1 = addf %0, %0 : f32
+      store %1, %arg0[%i, %j] : memref<1x8xf32>
+    }
+  }
+  return
+
+  // CHECK-LABEL: func @test_single_iteration
+  // CHECK-NOT: krnl.parallel_for
+  // CHECK: scf.parallel
+  // CHECK: scf.parallel
+}
@@ -0,0 +1,63 @@
+// RUN: onnx-mlir-opt --outline-krnl-partitions="num-partitions=2" %s -split-input-file | FileCheck %s
+
+/// The loop nests are outlined in two functions, the second one using the
+/// buffers allocated by the first one. The constants are copied into them.
+func @test_outline_loop_nests(%arg0: memref<10xf32>) -> memref<10xf32> {
+  %c0 = constant 0 : index
+  %0 = alloc() : memref<10xf32>
+  %1 = alloc() : memref<10xf32>
+  %2 = krnl.define_loops 1
+  krnl.iterate(%2) with (%2 -> %arg1 = 0 to 10) {
+    %3 = affine.load %arg0[%arg1] : memref<10xf32>
+    %4 = exp %3 : f32
+    affine.store %4, %0[%arg1] : memref<10xf32>
+  }
+  %5 = krnl.define_loops 1
+  krnl.iterate(%5) with (%5 -> %arg1 = 0 to 10) {
+    %6 = load %0[%c0] : memref<10xf32>
+    %7 = affine.load %0[%arg1] : memref<10xf32>
+    %8 = addf %6, %7 : f32
+    affine.store %8, %1[%arg1] : memref<10xf32>
+  }
+  dealloc %0 : memref<10xf32>
+  return %1 : memref<10xf32>
+
+  // CHECK-LABEL: func @test_outline_loop_nests
+  // CHECK: [[PART0:%.+]]:2 = call @test_outline_loop_nests_part0(%arg0) : (memref<10xf32>) -> (memref<10xf32>, memref<10xf32>)
+  // CHECK: call @test_outline_loop_nests_part1([[PART0]]#0, [[PART0]]#1) : (memref<10xf32>, memref<10xf32>) -> ()
+  // CHECK: return [[PART0]]#1 : memref<10xf32>
+
+  // CHECK: func {{.*}}@test_outline_loop_nests_part0(%arg0: memref<10xf32>) -> (memref<10xf32>, memref<10xf32>) attributes {{.*}}krnl.outlined
+  // CHECK: [[RES0:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[RES1:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[LOOP0:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.iterate([[LOOP0]])
+  // CHECK: return [[RES0]], [[RES1]] : memref<10xf32>, memref<10xf32>
+
+  // CHECK: func {{.*}}@test_outline_loop_nests_part1(%arg0: memref<10xf32>, %arg1: memref<10xf32>) attributes {{.*}}krnl.outlined
+  // CHECK: [[C0:%.+]] = constant 0 : index
+  // CHECK: [[LOOP1:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.iterate([[LOOP1]]) with ([[LOOP1]] -> [[I:%.+]] = 0 to 10) {
+  // CHECK:   load %arg0{{\[}}[[C0]]{{\]}} : memref<10xf32>
+  // CHECK:   affine.store {{.*}}, %arg1{{\[}}[[I]]{{\]}} : memref<10xf32>
+  // CHECK: dealloc %arg0 : memref<10xf32>
+  // CHECK: return
+}
+
+// -----
+
+/// A function with a single loop nest is left whole.
+func @test_single_loop_nest(%arg0: memref<10xf32>) -> memref<10xf32> {
+  %0 = alloc() : memref<10xf32>
+  %1 = krnl.define_loops 1
+  krnl.iterate(%1) with (%1 -> %arg1 = 0 to 10) {
+    %2 = affine.load %arg0[%arg1] : memref<10xf32>
+    affine.store %2, %0[%arg1] : memref<10xf32>
+  }
+  return %0 : memref<10xf32>
+
+  // CHECK-LABEL: func @test_single_loop_nest
+  // CHECK-NOT: call
+  // CHECK: krnl.iterate
+  // CHECK-NOT: krnl.outlined
+}
@@ -0,0 +1,61 @@
+// RUN: onnx-mlir-opt --emit-output-buffer-entry-point %s -split-input-file | FileCheck %s
+// RUN: onnx-mlir-opt --emit-output-buffer-entry-point='typed-entry-point=true' %s -split-input-file | FileCheck --check-prefix=TYPED %s
+
+module {
+  func @main_graph(%arg0: memref<10xf32>) -> memref<10xf32> {
+    %c0 = constant 0 : index
+    %0 = alloc() : memref<10xf32>
+    %1 = affine.load %arg0[0] : memref<10xf32>
+    affine.store %1, %0[0] : memref<10xf32>
+    return %0 : memref<10xf32>
+  }
+  "krnl.entry_point"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph(%arg0: memref<10xf32>) -> memref<10xf32>
+  // CHECK: [[RES:%.+]] = alloc() : memref<10xf32>
+  // CHECK: return [[RES]] : memref<10xf32>
+  // CHECK: "krnl.entry_point"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 1 : i32} : () -> ()
+  // CHECK: "krnl.entry_point"() {func = @main_graph_into, numInputs = 1 : i32, numOutputs = 1 : i32, outputBuffers} : () -> ()
+
+  // CHECK-LABEL: func @main_graph_into(%arg0: memref<10xf32>, %arg1: memref<10xf32>) -> memref<10xf32>
+  // CHECK-NOT: alloc
+  // CHECK: [[LOAD:%.+]] = affine.load %arg0[0] : memref<10xf32>
+  // CHECK: affine.store [[LOAD]], %arg1[0] : memref<10xf32>
+  // CHECK: return %arg1 : memref<10xf32>
+
+  // TYPED: "krnl.entry_point"() {func = @main_graph_into, numInputs = 1 : i32, numOutputs = 1 : i32, outputBuffers, typedEntryPoint = [memref<10xf32>, memref<10xf32>]} : () -> ()
+}
+
+// -----
+
+// Outputs with a dynamic shape are not supported.
+module {
+  func @main_graph(%arg0: memref<?xf32>) -> memref<?xf32> {
+    %c0 = constant 0 : index
+    %d0 = dim %arg0, %c0 : memref<?xf32>
+    %0 = alloc(%d0) : memref<?xf32>
+    return %0 : memref<?xf32>
+  }
+  "krnl.entry_point"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph(%arg0: memref<?xf32>) -> memref<?xf32>
+  // CHECK-NOT: main_graph_into
+}
+
+// -----
+
+// Inputs with a dynamic shape have no typed entry point.
+module {
+  func @main_graph(%arg0: memref<?xf32>) -> memref<10xf32> {
+    %0 = alloc() : memref<10xf32>
+    %c0 = constant 0 : index
+    %1 = load %arg0[%c0] : memref<?xf32>
+    affine.store %1, %0[0] : memref<10xf32>
+    return %0 : memref<10xf32>
+  }
+  "krnl.entry_point"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // TYPED-LABEL: func @main_graph(%arg0: memref<?xf32>) -> memref<10xf32>
+  // TYPED: "krnl.entry_point"() {func = @main_graph_into, numInputs = 1 : i32, numOutputs = 1 : i32, outputBuffers} : () -> ()
+  // TYPED-LABEL: func @main_graph_into(%arg0: memref<?xf32>, %arg1: memref<10xf32>) -> memref<10xf32>
+}
@@ -0,0 +1,134 @@
+// RUN: onnx-mlir-opt --parallel-branches %s -split-input-file | FileCheck %s
+
+/// The loop nests of the two Exps are independent, they are run in the
+/// branches of a parallel loop before the loop nest of the Add.
+func @test_parallel_branches(%arg0: memref<10xf32>, %arg1: memref<10xf32>) -> memref<10xf32> {
+  %0 = alloc() : memref<10xf32>
+  %1 = alloc() : memref<10xf32>
+  %2 = alloc() : memref<10xf32>
+  %3 = krnl.define_loops 1
+  krnl.iterate(%3) with (%3 -> %arg2 = 0 to 10) {
+    %6 = affine.load %arg0[%arg2] : memref<10xf32>
+    %7 = exp %6 : f32
+    affine.store %7, %1[%arg2] : memref<10xf32>
+  }
+  %4 = krnl.define_loops 1
+  krnl.iterate(%4) with (%4 -> %arg2 = 0 to 10) {
+    %6 = affine.load %arg1[%arg2] : memref<10xf32>
+    %7 = exp %6 : f32
+    affine.store %7, %2[%arg2] : memref<10xf32>
+  }
+  %5 = krnl.define_loops 1
+  krnl.iterate(%5) with (%5 -> %arg2 = 0 to 10) {
+    %6 = affine.load %1[%arg2] : memref<10xf32>
+    %7 = affine.load %2[%arg2] : memref<10xf32>
+    %8 = addf %6, %7 : f32
+    affine.store %8, %0[%arg2] : memref<10xf32>
+  }
+  dealloc %1 : memref<10xf32>
+  dealloc %2 : memref<10xf32>
+  return %0 : memref<10xf32>
+
+  // CHECK-LABEL: test_parallel_branches
+  // CHECK: [[RES:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[EXP0:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[EXP1:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[BRANCHES:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[BRANCHES]] : !krnl.loop
+  // CHECK: krnl.iterate([[BRANCHES]]) with ([[BRANCHES]] -> [[BRANCH:%.+]] = 0 to 2) {
+  // CHECK:   affine.if {{.*}}([[BRANCH]]) {
+  // CHECK:     krnl.define_loops 1
+  // CHECK:     krnl.iterate
+  // CHECK:       affine.load %arg0
+  // CHECK:       affine.store {{.*}}, [[EXP0]]
+  // CHECK:   affine.if {{.*}}([[BRANCH]]) {
+  // CHECK:     krnl.define_loops 1
+  // CHECK:     krnl.iterate
+  // CHECK:       affine.load %arg1
+  // CHECK:       affine.store {{.*}}, [[EXP1]]
+  // CHECK: krnl.define_loops 1
+  // CHECK: krnl.iterate
+  // CHECK:   affine.load [[EXP0]]
+  // CHECK:   affine.load [[EXP1]]
+  // CHECK:   affine.store {{.*}}, [[RES]]
+  // CHECK: dealloc [[EXP0]]
+  // CHECK: dealloc [[EXP1]]
+}
+
+// -----
+
+/// Each branch has two dependent loop nests, the first loop nests of the
+/// branches are run together, then the second ones.
+func @test_parallel_branch_levels(%arg0: memref<10xf32>, %arg1: memref<10xf32>) -> memref<10xf32> {
+  %0 = alloc() : memref<10xf32>
+  %1 = alloc() : memref<10xf32>
+  %2 = alloc() : memref<10xf32>
+  %3 = alloc() : memref<10xf32>
+  %4 = krnl.define_loops 1
+  krnl.iterate(%4) with (%4 -> %arg2 = 0 to 10) {
+    %8 = affine.load %arg0[%arg2] : memref<10xf32>
+    affine.store %8, %0[%arg2] : memref<10xf32>
+  }
+  %5 = krnl.define_loops 1
+  krnl.iterate(%5) with (%5 -> %arg2 = 0 to 10) {
+    %8 = affine.load %0[%arg2] : memref<10xf32>
+    affine.store %8, %1[%arg2] : memref<10xf32>
+  }
+  %6 = krnl.define_loops 1
+  krnl.iterate(%6) with (%6 -> %arg2 = 0 to 10) {
+    %8 = affine.load %arg1[%arg2] : memref<10xf32>
+    affine.store %8, %2[%arg2] : memref<10xf32>
+  }
+  %7 = krnl.define_loops 1
+  krnl.iterate(%7) with (%7 -> %arg2 = 0 to 10) {
+    %8 = affine.load %2[%arg2] : memref<10xf32>
+    affine.store %8, %3[%arg2] : memref<10xf32>
+  }
+  dealloc %0 : memref<10xf32>
+  dealloc %2 : memref<10xf32>
+  dealloc %3 : memref<10xf32>
+  return %1 : memref<10xf32>
+
+  // CHECK-LABEL: test_parallel_branch_levels
+  // CHECK: [[BUF0:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[BUF1:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[BUF2:%.+]] = alloc() : memref<10xf32>
+  // CHECK: [[BUF3:%.+]] = alloc() : memref<10xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} = 0 to 2) {
+  // CHECK:   affine.if
+  // CHECK:     affine.store {{.*}}, [[BUF0]]
+  // CHECK:   affine.if
+  // CHECK:     affine.store {{.*}}, [[BUF2]]
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} = 0 to 2) {
+  // CHECK:   affine.if
+  // CHECK:     affine.load [[BUF0]]
+  // CHECK:     affine.store {{.*}}, [[BUF1]]
+  // CHECK:   affine.if
+  // CHECK:     affine.load [[BUF2]]
+  // CHECK:     affine.store {{.*}}, [[BUF3]]
+  // CHECK: dealloc [[BUF0]]
+}
+
+// -----
+
+/// The second loop nest overwrites the input of the first one, the loop nests
+/// are left unchanged.
+func @test_no_parallel_branches(%arg0: memref<10xf32>) -> memref<10xf32> {
+  %0 = alloc() : memref<10xf32>
+  %1 = krnl.define_loops 1
+  krnl.iterate(%1) with (%1 -> %arg1 = 0 to 10) {
+    %3 = affine.load %arg0[%arg1] : memref<10xf32>
+    affine.store %3, %0[%arg1] : memref<10xf32>
+  }
+  %2 = krnl.define_loops 1
+  krnl.iterate(%2) with (%2 -> %arg1 = 0 to 10) {
+    %cst = constant 0.000000e+00 : f32
+    affine.store %cst, %arg0[%arg1] : memref<10xf32>
+  }
+  return %0 : memref<10xf32>
+
+  // CHECK-LABEL: test_no_parallel_branches
+  // CHECK-NOT: krnl.parallel
+  // CHECK-NOT: affine.if
+  // CHECK: return
+}
@@ -0,0 +1,33 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-llvm %s | FileCheck %s
+
+/// The captured values are stored in a structure read by the worker, which
+/// calls the C wrapper of the outlined function.
+func @test_parallel_for_parallel0(%arg0: index, %arg1: index, %arg2: memref<16xf32>, %arg3: f32) attributes {krnl.outlined} {
+  return
+}
+
+func @test_parallel_for(%arg0: memref<16xf32>, %arg1: f32) {
+  %c16 = constant 16 : index
+  "krnl.parallel_for"(%c16, %arg0, %arg1) {func = @test_parallel_for_parallel0, numThreads = 2 : i64} : (index, memref<16xf32>, f32) -> ()
+  return
+
+  // CHECK: llvm.func @omParallelFor(!llvm.ptr<i8>, !llvm.i64, !llvm.ptr<i8>, !llvm.i32)
+  // CHECK: llvm.func internal @test_parallel_for_parallel0_worker(%arg0: !llvm.i64, %arg1: !llvm.i64, %arg2: !llvm.ptr<i8>) {
+  // CHECK: [[CONTEXT:%.+]] = llvm.bitcast %arg2 : !llvm.ptr<i8> to !llvm.ptr<struct<
+  // CHECK: [[MEMREF_PTR:%.+]] = llvm.getelementptr [[CONTEXT]]
+  // CHECK: [[SCALAR_PTR:%.+]] = llvm.getelementptr [[CONTEXT]]
+  // CHECK: [[SCALAR:%.+]] = llvm.load [[SCALAR_PTR]] : !llvm.ptr<float>
+  // CHECK: llvm.call @_mlir_ciface_test_parallel_for_parallel0(%arg0, %arg1, [[MEMREF_PTR]], [[SCALAR]])
+  // CHECK: llvm.return
+
+  // CHECK-LABEL: llvm.func @test_parallel_for(
+  // CHECK: llvm.alloca
+  // CHECK: [[NUM_ITERATIONS:%.+]] = llvm.mlir.constant(16 : index) : !llvm.i64
+  // CHECK: llvm.store {{.*}}, {{.*}} : !llvm.ptr<struct<(ptr<float>
+  // CHECK: llvm.store %arg5, {{.*}} : !llvm.ptr<float>
+  // CHECK: [[WORKER:%.+]] = llvm.mlir.addressof @test_parallel_for_parallel0_worker
+  // CHECK: [[WORKER_PTR:%.+]] = llvm.bitcast [[WORKER]]
+  // CHECK: [[CONTEXT_PTR:%.+]] = llvm.bitcast
+  // CHECK: [[NUM_THREADS:%.+]] = llvm.mlir.constant(2 : i32) : !llvm.i32
+  // CHECK: llvm.call @omParallelFor([[WORKER_PTR]], [[NUM_ITERATIONS]], [[CONTEXT_PTR]], [[NUM_THREADS]]) : (!llvm.ptr<i8>, !llvm.i64, !llvm.ptr<i8>, !llvm.i32) -> ()
+}
@@ -0,0 +1,42 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-affine --convert-krnl-to-llvm %s -split-input-file | FileCheck %s
+
+func @test_reshape_lowering(%arg0: memref<2x8xf32>) -> memref<4x4xf32> {
+  %0 = "krnl.reshape"(%arg0) : (memref<2x8xf32>) -> memref<4x4xf32>
+  return %0 : memref<4x4xf32>
+
+  // CHECK-LABEL: test_reshape_lowering
+  // CHECK: [[SRC:%.+]] = llvm.insertvalue {{.*}}[4, 1] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[ALIGNED:%.+]] = llvm.extractvalue [[SRC]][1] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[VIEW:%.+]] = llvm.mlir.undef : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[ALLOCATED:%.+]] = llvm.extractvalue [[SRC]][0] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[VIEW0:%.+]] = llvm.insertvalue [[ALLOCATED]], [[VIEW]][0] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[VIEW1:%.+]] = llvm.insertvalue [[ALIGNED]], [[VIEW0]][1] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[OFFSET:%.+]] = llvm.mlir.constant(0 : index) : !llvm.i64
+  // CHECK: [[VIEW2:%.+]] = llvm.insertvalue [[OFFSET]], [[VIEW1]][2] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[STRIDE1:%.+]] = llvm.mlir.constant(1 : index) : !llvm.i64
+  // CHECK: [[SIZE1:%.+]] = llvm.mlir.constant(4 : index) : !llvm.i64
+  // CHECK: [[VIEW3:%.+]] = llvm.insertvalue [[SIZE1]], [[VIEW2]][3, 1] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[VIEW4:%.+]] = llvm.insertvalue [[STRIDE1]], [[VIEW3]][4, 1] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[STRIDE0:%.+]] = llvm.mul [[STRIDE1]], [[SIZE1]] : !llvm.i64
+  // CHECK: [[SIZE0:%.+]] = llvm.mlir.constant(4 : index) : !llvm.i64
+  // CHECK: [[VIEW5:%.+]] = llvm.insertvalue [[SIZE0]], [[VIEW4]][3, 0] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[VIEW6:%.+]] = llvm.insertvalue [[STRIDE0]], [[VIEW5]][4, 0] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: llvm.return [[VIEW6]] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+}
+
+// -----
+
+func @test_reshape_offset_lowering(%arg0: memref<2x8xf32>) -> memref<8xf32> {
+  %0 = "krnl.reshape"(%arg0) {offset = 8 : i64} : (memref<2x8xf32>) -> memref<8xf32>
+  return %0 : memref<8xf32>
+
+  // CHECK-LABEL: test_reshape_offset_lowering
+  // CHECK: [[SRC:%.+]] = llvm.insertvalue {{.*}}[4, 1] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[ALIGNED:%.+]] = llvm.extractvalue [[SRC]][1] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: %[[VIEW_OFFSET:.+]] = llvm.mlir.constant(8 : index) : !llvm.i64
+  // CHECK: [[VIEW_ALIGNED:%.+]] = llvm.getelementptr [[ALIGNED]][%[[VIEW_OFFSET]]] : (!llvm.ptr<float>, !llvm.i64) -> !llvm.ptr<float>
+  // CHECK: [[VIEW:%.+]] = llvm.mlir.undef : !llvm.struct<(ptr<float>, ptr<float>, i64, array<1 x i64>, array<1 x i64>)>
+  // CHECK: [[ALLOCATED:%.+]] = llvm.extractvalue [[SRC]][0] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<2 x i64>, array<2 x i64>)>
+  // CHECK: [[VIEW0:%.+]] = llvm.insertvalue [[ALLOCATED]], [[VIEW]][0] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<1 x i64>, array<1 x i64>)>
+  // CHECK: [[VIEW1:%.+]] = llvm.insertvalue [[VIEW_ALIGNED]], [[VIEW0]][1] : !llvm.struct<(ptr<float>, ptr<float>, i64, array<1 x i64>, array<1 x i64>)>
+}
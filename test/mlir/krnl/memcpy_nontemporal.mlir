@@ -0,0 +1,15 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-affine --convert-krnl-to-llvm %s -split-input-file | FileCheck %s
+
+/// Non-temporal copies are done by the runtime instead of llvm.memcpy.
+func @test_memcpy_nontemporal(%arg0: memref<16xf32>) -> memref<16xf32> {
+  %0 = alloc() : memref<16xf32>
+  %c64_i64 = constant 64 : i64
+  "krnl.memcpy"(%0, %arg0, %c64_i64) {nontemporal} : (memref<16xf32>, memref<16xf32>, i64) -> ()
+  return %0 : memref<16xf32>
+
+  // CHECK: llvm.func @omMemcpyNonTemporal(!llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.i64)
+  // CHECK-LABEL: llvm.func @test_memcpy_nontemporal
+  // CHECK-NOT: llvm.memcpy
+  // CHECK: llvm.call @omMemcpyNonTemporal({{.*}}, {{.*}}, {{.*}}) : (!llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.i64) -> ()
+  // CHECK: llvm.return
+}
@@ -0,0 +1,47 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-affine --convert-krnl-to-llvm="parallel-memcpy-threshold=1024" %s -split-input-file | FileCheck %s
+
+/// Copies reaching the threshold are split by the runtime.
+func @test_memcpy_parallel(%arg0: memref<1024xf32>) -> memref<1024xf32> {
+  %0 = alloc() : memref<1024xf32>
+  %c4096_i64 = constant 4096 : i64
+  "krnl.memcpy"(%0, %arg0, %c4096_i64) {nontemporal} : (memref<1024xf32>, memref<1024xf32>, i64) -> ()
+  return %0 : memref<1024xf32>
+
+  // CHECK: llvm.func @omMemcpyParallel(!llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.i64, !llvm.i64, !llvm.i32)
+  // CHECK-LABEL: llvm.func @test_memcpy_parallel
+  // CHECK-NOT: llvm.memcpy
+  // CHECK-DAG: [[THRESHOLD:%.+]] = llvm.mlir.constant(1024 : i64) : !llvm.i64
+  // CHECK-DAG: [[NONTEMPORAL:%.+]] = llvm.mlir.constant(1 : i32) : !llvm.i32
+  // CHECK: llvm.call @omMemcpyParallel({{.*}}, {{.*}}, {{.*}}, [[THRESHOLD]], [[NONTEMPORAL]]) : (!llvm.ptr<i8>, !llvm.ptr<i8>, !llvm.i64, !llvm.i64, !llvm.i32) -> ()
+  // CHECK: llvm.return
+}
+
+// -----
+
+/// The sizes unknown at compile time are compared to the threshold by the
+/// runtime.
+func @test_memcpy_parallel_dynamic(%arg0: memref<?xf32>, %arg1: i64) -> memref<?xf32> {
+  %c0 = constant 0 : index
+  %d0 = dim %arg0, %c0 : memref<?xf32>
+  %0 = alloc(%d0) : memref<?xf32>
+  "krnl.memcpy"(%0, %arg0, %arg1) : (memref<?xf32>, memref<?xf32>, i64) -> ()
+  return %0 : memref<?xf32>
+
+  // CHECK-LABEL: llvm.func @test_memcpy_parallel_dynamic
+  // CHECK: [[NONTEMPORAL:%.+]] = llvm.mlir.constant(0 : i32) : !llvm.i32
+  // CHECK: llvm.call @omMemcpyParallel({{.*}}, {{.*}}, {{.*}}, {{.*}}, [[NONTEMPORAL]])
+}
+
+// -----
+
+/// Small copies are left to llvm.memcpy.
+func @test_memcpy_small(%arg0: memref<16xf32>) -> memref<16xf32> {
+  %0 = alloc() : memref<16xf32>
+  %c64_i64 = constant 64 : i64
+  "krnl.memcpy"(%0, %arg0, %c64_i64) : (memref<16xf32>, memref<16xf32>, i64) -> ()
+  return %0 : memref<16xf32>
+
+  // CHECK-LABEL: llvm.func @test_memcpy_small
+  // CHECK-NOT: omMemcpyParallel
+  // CHECK: llvm.call @llvm.memcpy.p0i8.p0i8.i64
+}
@@ -0,0 +1,13 @@
+// RUN: onnx-mlir-opt --pack-krnl-constants='elision-threshold=3 move-to-file=false compression-chunk-size=8' %s -split-input-file | FileCheck %s
+
+/// The packed constants are compressed in chunks, the globals keep their
+/// offsets in the uncompressed constants.
+// CHECK: [[CONST_PACK:%.+]] = "krnl.packed_const"() {chunk_size = 8 : i64, is_le = {{.*}}, size_in_bytes = {{[0-9]+}} : i64, value = dense<{{.*}}> : tensor<{{[0-9]+}}xi8>} : () -> i64
+// CHECK-LABEL: func @test_krnl_const_packing_compressed() -> memref<1x4xf32> {
+// CHECK-NEXT: [[CONST0:%.+]] = "krnl.global"() {name = "constant_0", offset = 0 : i64, shape = [1, 4]} : () -> memref<1x4xf32>
+// CHECK-NEXT: [[CONST1:%.+]] = "krnl.global"() {name = "constant_1", offset = 16 : i64, shape = [1, 4]} : () -> memref<1x4xf32>
+func @test_krnl_const_packing_compressed() -> memref<1x4xf32> {
+  %0 = "krnl.global"() {name = "constant_0", shape = [1, 4], value = dense<[[0., 1., 2., 3.]]> : tensor<1x4xf32>} : () -> memref<1x4xf32>
+  %1 = "krnl.global"() {name = "constant_1", shape = [1, 4], value = dense<[[4., 5., 6., 7.]]> : tensor<1x4xf32>} : () -> memref<1x4xf32>
+  return %0 : memref<1x4xf32>
+}
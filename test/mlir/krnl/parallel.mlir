@@ -0,0 +1,71 @@
+// RUN: onnx-mlir-opt --convert-krnl-to-affine %s -split-input-file | FileCheck %s
+
+func @simple_parallel(%arg0: memref<10x20xf32>, %arg1: memref<10x20xf32>) {
+  %ii, %jj = krnl.define_loops 2
+  krnl.parallel %ii : !krnl.loop
+  krnl.iterate(%ii, %jj) with (%ii -> %i = 0 to 10, %jj -> %j = 0 to 20) {
+    %0 = affine.load %arg0[%i, %j] : memref<10x20xf32>
+    affine.store %0, %arg1[%i, %j] : memref<10x20xf32>
+  }
+
+  // CHECK-LABEL: simple_parallel
+  // CHECK-NEXT: affine.parallel ([[OUTER_LOOP_IV:%.+]]) = (0) to (10) {
+  // CHECK-NEXT:   affine.for [[INNER_LOOP_IV:%.+]] = 0 to 20 {
+  // CHECK-NEXT:     [[LOAD:%.+]] = affine.load %arg0{{\[}}[[OUTER_LOOP_IV]], [[INNER_LOOP_IV]]{{\]}} : memref<10x20xf32>
+  // CHECK-NEXT:     affine.store [[LOAD]], %arg1{{\[}}[[OUTER_LOOP_IV]], [[INNER_LOOP_IV]]{{\]}} : memref<10x20xf32>
+  // CHECK-NEXT:   }
+  // CHECK-NEXT: }
+  return
+}
+
+// -----
+
+func @parallel_with_dependence(%arg0: memref<10xf32>, %arg1: memref<1xf32>) {
+  %ii = krnl.define_loops 1
+  krnl.parallel %ii : !krnl.loop
+  krnl.iterate(%ii) with (%ii -> %i = 0 to 10) {
+    %0 = affine.load %arg0[%i] : memref<10xf32>
+    %1 = affine.load %arg1[0] : memref<1xf32>
+    %2 = addf %0, %1 : f32
+    affine.store %2, %arg1[0] : memref<1xf32>
+  }
+
+  /// The loop carries a dependence, it is kept sequential.
+  // CHECK-LABEL: parallel_with_dependence
+  // CHECK-NEXT: affine.for [[LOOP_IV:%.+]] = 0 to 10 {
+  // CHECK-NOT: affine.parallel
+  return
+}
+
+// -----
+
+#set = affine_set<(d0) : (d0 == 0)>
+func @parallel_directions(%arg0: memref<2x4xf32>, %arg1: memref<2x4xf32>) {
+  %dd = krnl.define_loops 1
+  krnl.parallel %dd : !krnl.loop
+  krnl.iterate(%dd) with (%dd -> %d = 0 to 2) {
+    affine.if #set(%d) {
+      %ii = krnl.define_loops 1
+      krnl.iterate(%ii) with (%ii -> %i = 0 to 4) {
+        %0 = affine.load %arg0[%d, %i] : memref<2x4xf32>
+        affine.store %0, %arg1[%d, %i] : memref<2x4xf32>
+      }
+    } else {
+      %ii = krnl.define_loops 1
+      krnl.iterate(%ii) with (%ii -> %i = 0 to 4) {
+        %0 = affine.load %arg0[%d, -%i + 3] : memref<2x4xf32>
+        affine.store %0, %arg1[%d, %i] : memref<2x4xf32>
+      }
+    }
+  }
+
+  /// The branches of the iterations access the elements of their own
+  /// direction, the direction loop is parallelized.
+  // CHECK-LABEL: parallel_directions
+  // CHECK-NEXT: affine.parallel ([[DIRECTION_IV:%.+]]) = (0) to (2) {
+  // CHECK-NEXT:   affine.if {{.*}}([[DIRECTION_IV]]) {
+  // CHECK-NEXT:     affine.for
+  // CHECK:        } else {
+  // CHECK-NEXT:     affine.for
+  return
+}
@@ -0,0 +1,117 @@
+// RUN: onnx-mlir-opt --fuse-onnx-attention %s -split-input-file | FileCheck %s
+// RUN: onnx-mlir-opt --fuse-onnx-attention --convert-onnx-to-krnl %s -split-input-file | FileCheck --check-prefix=KRNL %s
+
+/// The scores are divided by a constant and masked before the Softmax, the
+/// attention is fused and lowered without the score tensor.
+func @test_fuse_attention(%arg0: tensor<1x2x4x8xf32>, %arg1: tensor<1x2x8x4xf32>, %arg2: tensor<1x2x4x8xf32>, %arg3: tensor<1x1x1x4xf32>) -> tensor<1x2x4x8xf32> {
+  %0 = "onnx.Constant"() {value = dense<8.0> : tensor<1xf32>} : () -> tensor<1xf32>
+  %1 = "onnx.MatMul"(%arg0, %arg1) : (tensor<1x2x4x8xf32>, tensor<1x2x8x4xf32>) -> tensor<1x2x4x4xf32>
+  %2 = "onnx.Div"(%1, %0) : (tensor<1x2x4x4xf32>, tensor<1xf32>) -> tensor<1x2x4x4xf32>
+  %3 = "onnx.Add"(%2, %arg3) : (tensor<1x2x4x4xf32>, tensor<1x1x1x4xf32>) -> tensor<1x2x4x4xf32>
+  %4 = "onnx.Softmax"(%3) {axis = 3 : si64} : (tensor<1x2x4x4xf32>) -> tensor<1x2x4x4xf32>
+  %5 = "onnx.MatMul"(%4, %arg2) : (tensor<1x2x4x4xf32>, tensor<1x2x4x8xf32>) -> tensor<1x2x4x8xf32>
+  "std.return"(%5) : (tensor<1x2x4x8xf32>) -> ()
+
+  // CHECK-LABEL: test_fuse_attention
+  // CHECK-NOT: "onnx.MatMul"
+  // CHECK-NOT: "onnx.Softmax"
+  // CHECK: [[RES:%.+]] = "onnx.FusedAttention"(%arg0, %arg1, %arg2, %arg3) {scale = 1.250000e-01 : f32} : (tensor<1x2x4x8xf32>, tensor<1x2x8x4xf32>, tensor<1x2x4x8xf32>, tensor<1x1x1x4xf32>) -> tensor<1x2x4x8xf32>
+  // CHECK: return [[RES]] : tensor<1x2x4x8xf32>
+
+  // KRNL-LABEL: test_fuse_attention
+  // KRNL-NOT: memref<1x2x4x4xf32>
+  // KRNL-DAG: [[RES:%.+]] = alloc() : memref<1x2x4x8xf32>
+  // KRNL-DAG: [[SCORES:%.+]] = alloc() : memref<1x4xf32>
+  // KRNL-DAG: [[SCALE:%.+]] = constant 1.250000e-01 : f32
+  // KRNL: [[ROW_LOOPS:%.+]]:3 = krnl.define_loops 3
+  // KRNL: krnl.parallel [[ROW_LOOPS]]#0 : !krnl.loop
+  // KRNL: krnl.iterate([[ROW_LOOPS]]#0, [[ROW_LOOPS]]#1, [[ROW_LOOPS]]#2) with ([[ROW_LOOPS]]#0 -> [[B:%.+]] = 0 to 1, [[ROW_LOOPS]]#1 -> [[H:%.+]] = 0 to 2, [[ROW_LOOPS]]#2 -> [[I:%.+]] = 0 to 4) {
+  // KRNL: [[Q:%.+]] = affine.load %arg0{{\[}}[[B]], [[H]], [[I]], {{.*}}] : memref<1x2x4x8xf32>
+  // KRNL: [[K:%.+]] = affine.load %arg1{{\[}}[[B]], [[H]], {{.*}}] : memref<1x2x8x4xf32>
+  // KRNL: mulf [[Q]], [[K]] : f32
+  // KRNL: [[SCORE:%.+]] = affine.load [[SCORES]]{{\[}}[[B]], {{.*}}] : memref<1x4xf32>
+  // KRNL: [[SCALED:%.+]] = mulf [[SCORE]], [[SCALE]] : f32
+  // KRNL: [[MASK:%.+]] = affine.load %arg3[{{.*}}] : memref<1x1x1x4xf32>
+  // KRNL: addf [[SCALED]], [[MASK]] : f32
+  // KRNL: exp
+  // KRNL: exp
+  // KRNL: [[V:%.+]] = affine.load %arg2{{\[}}[[B]], [[H]], {{.*}}] : memref<1x2x4x8xf32>
+  // KRNL: divf
+  // KRNL: return [[RES]] : memref<1x2x4x8xf32>
+}
+
+// -----
+
+/// The mask may mask out the whole first block of 64 keys with -inf. The
+/// exponentials are taken relative to 0 while the max of the scores is -inf,
+/// so that they are 0 rather than NaN.
+func @test_fuse_attention_masked_block(%arg0: tensor<1x4x8xf32>, %arg1: tensor<1x8x128xf32>, %arg2: tensor<1x128x8xf32>, %arg3: tensor<1x1x128xf32>) -> tensor<1x4x8xf32> {
+  %0 = "onnx.MatMul"(%arg0, %arg1) : (tensor<1x4x8xf32>, tensor<1x8x128xf32>) -> tensor<1x4x128xf32>
+  %1 = "onnx.Add"(%0, %arg3) : (tensor<1x4x128xf32>, tensor<1x1x128xf32>) -> tensor<1x4x128xf32>
+  %2 = "onnx.Softmax"(%1) {axis = 2 : si64} : (tensor<1x4x128xf32>) -> tensor<1x4x128xf32>
+  %3 = "onnx.MatMul"(%2, %arg2) : (tensor<1x4x128xf32>, tensor<1x128x8xf32>) -> tensor<1x4x8xf32>
+  "std.return"(%3) : (tensor<1x4x8xf32>) -> ()
+
+  // CHECK-LABEL: test_fuse_attention_masked_block
+  // CHECK: "onnx.FusedAttention"(%arg0, %arg1, %arg2, %arg3) {scale = 1.000000e+00 : f32}
+
+  // KRNL-LABEL: test_fuse_attention_masked_block
+  // KRNL-DAG: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // KRNL-DAG: [[NEG_INF:%.+]] = constant 0xFF800000 : f32
+  // KRNL: [[IS_NEG_INF:%.+]] = cmpf "oeq", [[NEW_MAX:%.+]], [[NEG_INF]] : f32
+  // KRNL-NEXT: [[SHIFT:%.+]] = select [[IS_NEG_INF]], [[ZERO]], [[NEW_MAX]] : f32
+  // KRNL-NEXT: [[MAX_DIFF:%.+]] = subf {{%.+}}, [[SHIFT]] : f32
+  // KRNL-NEXT: exp [[MAX_DIFF]] : f32
+  // KRNL: affine.store [[NEW_MAX]], {{%.+}}{{\[}}{{.*}}] : memref<1xf32>
+  // KRNL: [[SCORE_DIFF:%.+]] = subf {{%.+}}, [[SHIFT]] : f32
+  // KRNL-NEXT: exp [[SCORE_DIFF]] : f32
+  // KRNL-NOT: subf {{%.+}}, [[NEW_MAX]] : f32
+  // KRNL: divf
+}
+
+// -----
+
+/// The scores are multiplied by a constant without mask.
+func @test_fuse_attention_no_mask(%arg0: tensor<2x4x8xf32>, %arg1: tensor<2x8x4xf32>, %arg2: tensor<2x4x8xf32>) -> tensor<2x4x8xf32> {
+  %0 = "onnx.Constant"() {value = dense<0.5> : tensor<f32>} : () -> tensor<f32>
+  %1 = "onnx.MatMul"(%arg0, %arg1) : (tensor<2x4x8xf32>, tensor<2x8x4xf32>) -> tensor<2x4x4xf32>
+  %2 = "onnx.Mul"(%0, %1) : (tensor<f32>, tensor<2x4x4xf32>) -> tensor<2x4x4xf32>
+  %3 = "onnx.Softmax"(%2) {axis = -1 : si64} : (tensor<2x4x4xf32>) -> tensor<2x4x4xf32>
+  %4 = "onnx.MatMul"(%3, %arg2) : (tensor<2x4x4xf32>, tensor<2x4x8xf32>) -> tensor<2x4x8xf32>
+  "std.return"(%4) : (tensor<2x4x8xf32>) -> ()
+
+  // CHECK-LABEL: test_fuse_attention_no_mask
+  // CHECK: [[NONE:%.+]] = constant unit
+  // CHECK: [[RES:%.+]] = "onnx.FusedAttention"(%arg0, %arg1, %arg2, [[NONE]]) {scale = 5.000000e-01 : f32} : (tensor<2x4x8xf32>, tensor<2x8x4xf32>, tensor<2x4x8xf32>, none) -> tensor<2x4x8xf32>
+  // CHECK-NOT: "onnx.Softmax"
+  // CHECK: return [[RES]] : tensor<2x4x8xf32>
+}
+
+// -----
+
+/// The Softmax is not computed along the keys, the attention is not fused.
+func @test_no_fuse_attention_softmax_axis(%arg0: tensor<2x4x8xf32>, %arg1: tensor<2x8x4xf32>, %arg2: tensor<2x4x8xf32>) -> tensor<2x4x8xf32> {
+  %0 = "onnx.MatMul"(%arg0, %arg1) : (tensor<2x4x8xf32>, tensor<2x8x4xf32>) -> tensor<2x4x4xf32>
+  %1 = "onnx.Softmax"(%0) {axis = 1 : si64} : (tensor<2x4x4xf32>) -> tensor<2x4x4xf32>
+  %2 = "onnx.MatMul"(%1, %arg2) : (tensor<2x4x4xf32>, tensor<2x4x8xf32>) -> tensor<2x4x8xf32>
+  "std.return"(%2) : (tensor<2x4x8xf32>) -> ()
+
+  // CHECK-LABEL: test_no_fuse_attention_softmax_axis
+  // CHECK-NOT: "onnx.FusedAttention"
+  // CHECK: "onnx.Softmax"
+}
+
+// -----
+
+/// The attention probabilities are also returned, the attention is not
+/// fused.
+func @test_no_fuse_attention_returned_probs(%arg0: tensor<2x4x8xf32>, %arg1: tensor<2x8x4xf32>, %arg2: tensor<2x4x8xf32>) -> (tensor<2x4x8xf32>, tensor<2x4x4xf32>) {
+  %0 = "onnx.MatMul"(%arg0, %arg1) : (tensor<2x4x8xf32>, tensor<2x8x4xf32>) -> tensor<2x4x4xf32>
+  %1 = "onnx.Softmax"(%0) {axis = 2 : si64} : (tensor<2x4x4xf32>) -> tensor<2x4x4xf32>
+  %2 = "onnx.MatMul"(%1, %arg2) : (tensor<2x4x4xf32>, tensor<2x4x8xf32>) -> tensor<2x4x8xf32>
+  "std.return"(%2, %1) : (tensor<2x4x8xf32>, tensor<2x4x4xf32>) -> ()
+
+  // CHECK-LABEL: test_no_fuse_attention_returned_probs
+  // CHECK-NOT: "onnx.FusedAttention"
+  // CHECK: "onnx.Softmax"
+}
@@ -268,3 +268,236 @@ func @test_size2(%arg0 : tensor<*xf32>) -> tensor<*xi64> {
   // CHECK-NEXT: return %0 : tensor<*xi64>
 }
 
+
+// -----
+
+/// The erf form of Gelu exported by PyTorch is replaced with onnx.Gelu.
+func @test_gelu(%arg0 : tensor<2x8xf32>) -> tensor<2x8xf32> {
+  %0 = "onnx.Constant"() {value = dense<1.41421354> : tensor<f32>} : () -> tensor<f32>
+  %1 = "onnx.Constant"() {value = dense<1.0> : tensor<f32>} : () -> tensor<f32>
+  %2 = "onnx.Constant"() {value = dense<0.5> : tensor<f32>} : () -> tensor<f32>
+  %3 = "onnx.Div"(%arg0, %0) : (tensor<2x8xf32>, tensor<f32>) -> tensor<2x8xf32>
+  %4 = "onnx.Erf"(%3) : (tensor<2x8xf32>) -> tensor<2x8xf32>
+  %5 = "onnx.Add"(%4, %1) : (tensor<2x8xf32>, tensor<f32>) -> tensor<2x8xf32>
+  %6 = "onnx.Mul"(%arg0, %5) : (tensor<2x8xf32>, tensor<2x8xf32>) -> tensor<2x8xf32>
+  %7 = "onnx.Mul"(%6, %2) : (tensor<2x8xf32>, tensor<f32>) -> tensor<2x8xf32>
+  return %7 : tensor<2x8xf32>
+
+  // CHECK-LABEL: @test_gelu
+  // CHECK-NOT: "onnx.Erf"
+  // CHECK: [[RES:%.+]] = "onnx.Gelu"(%arg0) : (tensor<2x8xf32>) -> tensor<2x8xf32>
+  // CHECK-NEXT: return [[RES]] : tensor<2x8xf32>
+}
+
+// -----
+
+/// The erf argument is not x / sqrt(2), the subgraph is left unchanged.
+func @test_no_gelu(%arg0 : tensor<2x8xf32>) -> tensor<2x8xf32> {
+  %0 = "onnx.Constant"() {value = dense<2.0> : tensor<f32>} : () -> tensor<f32>
+  %1 = "onnx.Constant"() {value = dense<1.0> : tensor<f32>} : () -> tensor<f32>
+  %2 = "onnx.Constant"() {value = dense<0.5> : tensor<f32>} : () -> tensor<f32>
+  %3 = "onnx.Div"(%arg0, %0) : (tensor<2x8xf32>, tensor<f32>) -> tensor<2x8xf32>
+  %4 = "onnx.Erf"(%3) : (tensor<2x8xf32>) -> tensor<2x8xf32>
+  %5 = "onnx.Add"(%4, %1) : (tensor<2x8xf32>, tensor<f32>) -> tensor<2x8xf32>
+  %6 = "onnx.Mul"(%arg0, %5) : (tensor<2x8xf32>, tensor<2x8xf32>) -> tensor<2x8xf32>
+  %7 = "onnx.Mul"(%6, %2) : (tensor<2x8xf32>, tensor<f32>) -> tensor<2x8xf32>
+  return %7 : tensor<2x8xf32>
+
+  // CHECK-LABEL: @test_no_gelu
+  // CHECK-NOT: "onnx.Gelu"
+  // CHECK: "onnx.Erf"
+}
+
+// -----
+
+/// The tanh approximation of Gelu exported by TensorFlow is replaced with
+/// onnx.FastGelu.
+func @test_fast_gelu(%arg0 : tensor<2x8xf32>) -> tensor<2x8xf32> {
+  %0 = "onnx.Constant"() {value = dense<3.0> : tensor<f32>} : () -> tensor<f32>
+  %1 = "onnx.Constant"() {value = dense<0.044715> : tensor<f32>} : () -> tensor<f32>
+  %2 = "onnx.Constant"() {value = dense<0.797884583> : tensor<f32>} : () -> tensor<f32>
+  %3 = "onnx.Constant"() {value = dense<1.0> : tensor<f32>} : () -> tensor<f32>
+  %4 = "onnx.Constant"() {value = dense<0.5> : tensor<f32>} : () -> tensor<f32>
+  %5 = "onnx.Pow"(%arg0, %0) : (tensor<2x8xf32>, tensor<f32>) -> tensor<2x8xf32>
+  %6 = "onnx.Mul"(%1, %5) : (tensor<f32>, tensor<2x8xf32>) -> tensor<2x8xf32>
+  %7 = "onnx.Add"(%arg0, %6) : (tensor<2x8xf32>, tensor<2x8xf32>) -> tensor<2x8xf32>
+  %8 = "onnx.Mul"(%7, %2) : (tensor<2x8xf32>, tensor<f32>) -> tensor<2x8xf32>
+  %9 = "onnx.Tanh"(%8) : (tensor<2x8xf32>) -> tensor<2x8xf32>
+  %10 = "onnx.Add"(%3, %9) : (tensor<f32>, tensor<2x8xf32>) -> tensor<2x8xf32>
+  %11 = "onnx.Mul"(%arg0, %4) : (tensor<2x8xf32>, tensor<f32>) -> tensor<2x8xf32>
+  %12 = "onnx.Mul"(%11, %10) : (tensor<2x8xf32>, tensor<2x8xf32>) -> tensor<2x8xf32>
+  return %12 : tensor<2x8xf32>
+
+  // CHECK-LABEL: @test_fast_gelu
+  // CHECK-NOT: "onnx.Tanh"
+  // CHECK: [[RES:%.+]] = "onnx.FastGelu"(%arg0) : (tensor<2x8xf32>) -> tensor<2x8xf32>
+  // CHECK-NEXT: return [[RES]] : tensor<2x8xf32>
+}
+
+// -----
+
+/// The layer normalization over the innermost dimension is replaced with
+/// onnx.LayerNormalization.
+func @test_layer_norm(%arg0 : tensor<2x4x16xf32>, %arg1 : tensor<16xf32>, %arg2 : tensor<16xf32>) -> tensor<2x4x16xf32> {
+  %0 = "onnx.Constant"() {value = dense<9.99999996E-13> : tensor<f32>} : () -> tensor<f32>
+  %1 = "onnx.Constant"() {value = dense<2.0> : tensor<f32>} : () -> tensor<f32>
+  %2 = "onnx.ReduceMean"(%arg0) {axes = [-1], keepdims = 1 : si64} : (tensor<2x4x16xf32>) -> tensor<2x4x1xf32>
+  %3 = "onnx.Sub"(%arg0, %2) : (tensor<2x4x16xf32>, tensor<2x4x1xf32>) -> tensor<2x4x16xf32>
+  %4 = "onnx.Pow"(%3, %1) : (tensor<2x4x16xf32>, tensor<f32>) -> tensor<2x4x16xf32>
+  %5 = "onnx.ReduceMean"(%4) {axes = [2], keepdims = 1 : si64} : (tensor<2x4x16xf32>) -> tensor<2x4x1xf32>
+  %6 = "onnx.Add"(%5, %0) : (tensor<2x4x1xf32>, tensor<f32>) -> tensor<2x4x1xf32>
+  %7 = "onnx.Sqrt"(%6) : (tensor<2x4x1xf32>) -> tensor<2x4x1xf32>
+  %8 = "onnx.Div"(%3, %7) : (tensor<2x4x16xf32>, tensor<2x4x1xf32>) -> tensor<2x4x16xf32>
+  %9 = "onnx.Mul"(%8, %arg1) : (tensor<2x4x16xf32>, tensor<16xf32>) -> tensor<2x4x16xf32>
+  %10 = "onnx.Add"(%9, %arg2) : (tensor<2x4x16xf32>, tensor<16xf32>) -> tensor<2x4x16xf32>
+  return %10 : tensor<2x4x16xf32>
+
+  // CHECK-LABEL: @test_layer_norm
+  // CHECK-NOT: "onnx.ReduceMean"
+  // CHECK: [[RES:%.+]] = "onnx.LayerNormalization"(%arg0, %arg1, %arg2) {epsilon = 9.99999996E-13 : f32} : (tensor<2x4x16xf32>, tensor<16xf32>, tensor<16xf32>) -> tensor<2x4x16xf32>
+  // CHECK-NEXT: return [[RES]] : tensor<2x4x16xf32>
+}
+
+// -----
+
+/// The mean is computed over another dimension, the subgraph is left
+/// unchanged.
+func @test_no_layer_norm_axis(%arg0 : tensor<2x4x16xf32>, %arg1 : tensor<16xf32>, %arg2 : tensor<16xf32>) -> tensor<2x4x16xf32> {
+  %0 = "onnx.Constant"() {value = dense<9.99999996E-13> : tensor<f32>} : () -> tensor<f32>
+  %1 = "onnx.ReduceMean"(%arg0) {axes = [1], keepdims = 1 : si64} : (tensor<2x4x16xf32>) -> tensor<2x1x16xf32>
+  %2 = "onnx.Sub"(%arg0, %1) : (tensor<2x4x16xf32>, tensor<2x1x16xf32>) -> tensor<2x4x16xf32>
+  %3 = "onnx.Mul"(%2, %2) : (tensor<2x4x16xf32>, tensor<2x4x16xf32>) -> tensor<2x4x16xf32>
+  %4 = "onnx.ReduceMean"(%3) {axes = [-1], keepdims = 1 : si64} : (tensor<2x4x16xf32>) -> tensor<2x4x1xf32>
+  %5 = "onnx.Add"(%4, %0) : (tensor<2x4x1xf32>, tensor<f32>) -> tensor<2x4x1xf32>
+  %6 = "onnx.Sqrt"(%5) : (tensor<2x4x1xf32>) -> tensor<2x4x1xf32>
+  %7 = "onnx.Div"(%2, %6) : (tensor<2x4x16xf32>, tensor<2x4x1xf32>) -> tensor<2x4x16xf32>
+  %8 = "onnx.Mul"(%7, %arg1) : (tensor<2x4x16xf32>, tensor<16xf32>) -> tensor<2x4x16xf32>
+  %9 = "onnx.Add"(%8, %arg2) : (tensor<2x4x16xf32>, tensor<16xf32>) -> tensor<2x4x16xf32>
+  return %9 : tensor<2x4x16xf32>
+
+  // CHECK-LABEL: @test_no_layer_norm_axis
+  // CHECK-NOT: "onnx.LayerNormalization"
+  // CHECK: "onnx.ReduceMean"
+}
+
+// -----
+
+/// The sum of the gathered rows over the bag axis is an embedding bag.
+func @test_embedding_bag_sum(%arg0 : tensor<100x16xf32>, %arg1 : tensor<4x8xi64>) -> tensor<4x16xf32> {
+  %0 = "onnx.Gather"(%arg0, %arg1) {axis = 0 : si64} : (tensor<100x16xf32>, tensor<4x8xi64>) -> tensor<4x8x16xf32>
+  %1 = "onnx.ReduceSum"(%0) {axes = [1], keepdims = 0 : si64} : (tensor<4x8x16xf32>) -> tensor<4x16xf32>
+  return %1 : tensor<4x16xf32>
+
+  // CHECK-LABEL: @test_embedding_bag_sum
+  // CHECK-NOT: "onnx.Gather"
+  // CHECK: [[RES:%.+]] = "onnx.EmbeddingBag"(%arg0, %arg1) {keepdims = 0 : si64, mode = "sum"} : (tensor<100x16xf32>, tensor<4x8xi64>) -> tensor<4x16xf32>
+  // CHECK: return [[RES]] : tensor<4x16xf32>
+}
+
+// -----
+
+/// The mean over the bag axis, given as a negative axis, keeping it.
+func @test_embedding_bag_mean(%arg0 : tensor<100x16xf32>, %arg1 : tensor<4x8xi64>) -> tensor<4x1x16xf32> {
+  %0 = "onnx.Gather"(%arg0, %arg1) {axis = 0 : si64} : (tensor<100x16xf32>, tensor<4x8xi64>) -> tensor<4x8x16xf32>
+  %1 = "onnx.ReduceMean"(%0) {axes = [-2], keepdims = 1 : si64} : (tensor<4x8x16xf32>) -> tensor<4x1x16xf32>
+  return %1 : tensor<4x1x16xf32>
+
+  // CHECK-LABEL: @test_embedding_bag_mean
+  // CHECK: [[RES:%.+]] = "onnx.EmbeddingBag"(%arg0, %arg1) {keepdims = 1 : si64, mode = "mean"} : (tensor<100x16xf32>, tensor<4x8xi64>) -> tensor<4x1x16xf32>
+  // CHECK: return [[RES]] : tensor<4x1x16xf32>
+}
+
+// -----
+
+/// The reduction over the rows of the table is left unchanged.
+func @test_no_embedding_bag_axis(%arg0 : tensor<100x16xf32>, %arg1 : tensor<4x8xi64>) -> tensor<4x8xf32> {
+  %0 = "onnx.Gather"(%arg0, %arg1) {axis = 0 : si64} : (tensor<100x16xf32>, tensor<4x8xi64>) -> tensor<4x8x16xf32>
+  %1 = "onnx.ReduceSum"(%0) {axes = [2], keepdims = 0 : si64} : (tensor<4x8x16xf32>) -> tensor<4x8xf32>
+  return %1 : tensor<4x8xf32>
+
+  // CHECK-LABEL: @test_no_embedding_bag_axis
+  // CHECK-NOT: "onnx.EmbeddingBag"
+  // CHECK: "onnx.ReduceSum"
+}
+
+// -----
+
+/// A batched matrix product is a MatMul.
+func @test_einsum_batched_matmul(%arg0 : tensor<2x3x4xf32>, %arg1 : tensor<2x4x5xf32>) -> tensor<2x3x5xf32> {
+  %0 = "onnx.Einsum"(%arg0, %arg1) {equation = "bij,bjk->bik"} : (tensor<2x3x4xf32>, tensor<2x4x5xf32>) -> tensor<2x3x5xf32>
+  return %0 : tensor<2x3x5xf32>
+
+  // CHECK-LABEL: @test_einsum_batched_matmul
+  // CHECK-NOT: "onnx.Einsum"
+  // CHECK-NOT: "onnx.Transpose"
+  // CHECK: [[RES:%.+]] = "onnx.MatMul"(%arg0, %arg1) : (tensor<2x3x4xf32>, tensor<2x4x5xf32>) -> tensor<2x3x5xf32>
+  // CHECK: return [[RES]] : tensor<2x3x5xf32>
+}
+
+// -----
+
+/// The keys are transposed so that the contracted label is the rows of the
+/// second input.
+func @test_einsum_attention_scores(%arg0 : tensor<1x2x4x8xf32>, %arg1 : tensor<1x2x6x8xf32>) -> tensor<1x2x4x6xf32> {
+  %0 = "onnx.Einsum"(%arg0, %arg1) {equation = "bhid, bhjd -> bhij"} : (tensor<1x2x4x8xf32>, tensor<1x2x6x8xf32>) -> tensor<1x2x4x6xf32>
+  return %0 : tensor<1x2x4x6xf32>
+
+  // CHECK-LABEL: @test_einsum_attention_scores
+  // CHECK: [[KT:%.+]] = "onnx.Transpose"(%arg1) {perm = [0, 1, 3, 2]} : (tensor<1x2x6x8xf32>) -> tensor<1x2x8x6xf32>
+  // CHECK: [[RES:%.+]] = "onnx.MatMul"(%arg0, [[KT]]) : (tensor<1x2x4x8xf32>, tensor<1x2x8x6xf32>) -> tensor<1x2x4x6xf32>
+  // CHECK: return [[RES]] : tensor<1x2x4x6xf32>
+}
+
+// -----
+
+/// Several contracted labels are reshaped into one dimension.
+func @test_einsum_contract_two_labels(%arg0 : tensor<2x3x4xf32>, %arg1 : tensor<3x4x5xf32>) -> tensor<2x5xf32> {
+  %0 = "onnx.Einsum"(%arg0, %arg1) {equation = "ijk,jkl->il"} : (tensor<2x3x4xf32>, tensor<3x4x5xf32>) -> tensor<2x5xf32>
+  return %0 : tensor<2x5xf32>
+
+  // CHECK-LABEL: @test_einsum_contract_two_labels
+  // CHECK-DAG: [[LHS_SHAPE:%.+]] = "onnx.Constant"() {value = dense<[2, 12]> : tensor<2xi64>} : () -> tensor<2xi64>
+  // CHECK-DAG: [[RHS_SHAPE:%.+]] = "onnx.Constant"() {value = dense<[12, 5]> : tensor<2xi64>} : () -> tensor<2xi64>
+  // CHECK-DAG: [[LHS:%.+]] = "onnx.Reshape"(%arg0, [[LHS_SHAPE]]) : (tensor<2x3x4xf32>, tensor<2xi64>) -> tensor<2x12xf32>
+  // CHECK-DAG: [[RHS:%.+]] = "onnx.Reshape"(%arg1, [[RHS_SHAPE]]) : (tensor<3x4x5xf32>, tensor<2xi64>) -> tensor<12x5xf32>
+  // CHECK: [[RES:%.+]] = "onnx.MatMul"([[LHS]], [[RHS]]) : (tensor<2x12xf32>, tensor<12x5xf32>) -> tensor<2x5xf32>
+  // CHECK: return [[RES]] : tensor<2x5xf32>
+}
+
+// -----
+
+/// The label of a single input missing from the output is summed over.
+func @test_einsum_reduce_transpose(%arg0 : tensor<2x3x4xf32>) -> tensor<4x2xf32> {
+  %0 = "onnx.Einsum"(%arg0) {equation = "ijk->ki"} : (tensor<2x3x4xf32>) -> tensor<4x2xf32>
+  return %0 : tensor<4x2xf32>
+
+  // CHECK-LABEL: @test_einsum_reduce_transpose
+  // CHECK: [[SUM:%.+]] = "onnx.ReduceSum"(%arg0) {axes = [1], keepdims = 0 : si64} : (tensor<2x3x4xf32>) -> tensor<2x4xf32>
+  // CHECK: [[RES:%.+]] = "onnx.Transpose"([[SUM]]) {perm = [1, 0]} : (tensor<2x4xf32>) -> tensor<4x2xf32>
+  // CHECK: return [[RES]] : tensor<4x2xf32>
+}
+
+// -----
+
+/// The output of an implicit equation has the labels used once.
+func @test_einsum_implicit(%arg0 : tensor<3x4xf32>, %arg1 : tensor<4x5xf32>) -> tensor<3x5xf32> {
+  %0 = "onnx.Einsum"(%arg0, %arg1) {equation = "ij,jk"} : (tensor<3x4xf32>, tensor<4x5xf32>) -> tensor<3x5xf32>
+  return %0 : tensor<3x5xf32>
+
+  // CHECK-LABEL: @test_einsum_implicit
+  // CHECK: [[RES:%.+]] = "onnx.MatMul"(%arg0, %arg1) : (tensor<3x4xf32>, tensor<4x5xf32>) -> tensor<3x5xf32>
+  // CHECK: return [[RES]] : tensor<3x5xf32>
+}
+
+// -----
+
+/// Dynamic shapes and diagonals are left unchanged.
+func @test_einsum_unsupported(%arg0 : tensor<?x4xf32>, %arg1 : tensor<4x4xf32>) -> (tensor<?x4xf32>, tensor<4xf32>) {
+  %0 = "onnx.Einsum"(%arg0, %arg1) {equation = "ij,jk->ik"} : (tensor<?x4xf32>, tensor<4x4xf32>) -> tensor<?x4xf32>
+  %1 = "onnx.Einsum"(%arg1) {equation = "ii->i"} : (tensor<4x4xf32>) -> tensor<4xf32>
+  return %0, %1 : tensor<?x4xf32>, tensor<4xf32>
+
+  // CHECK-LABEL: @test_einsum_unsupported
+  // CHECK: "onnx.Einsum"(%arg0, %arg1)
+  // CHECK: "onnx.Einsum"(%arg1)
+}
@@ -111,6 +111,18 @@ func @test_broadcast_3(%arg0 : tensor<3x2xi32>) -> tensor<3x2xi32> {
   // CHECK-NEXT: [[ADD1:%.+]] = "onnx.Add"(%arg0, [[CONST1]]) : (tensor<3x2xi32>, tensor<3x2xi32>) -> tensor<3x2xi32>
 }
 
+/// check 3d with broadcast of inner dimensions on both sides
+// -----
+// CHECK-LABEL: @test_broadcast_4() -> tensor<2x3x2xf32>
+func @test_broadcast_4() -> tensor<2x3x2xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[[1.0, 2.0]], [[3.0, 4.0]]]> : tensor<2x1x2xf32>} : () -> tensor<2x1x2xf32>
+  %1 = "onnx.Constant"() {value = dense<[[10.0], [20.0], [30.0]]> : tensor<3x1xf32>} : () -> tensor<3x1xf32>
+  %2 = "onnx.Add"(%0, %1) : (tensor<2x1x2xf32> , tensor<3x1xf32>) -> tensor<2x3x2xf32>
+  "std.return"(%2) : (tensor<2x3x2xf32>) -> ()
+  // CHECK-NEXT: [[CONST1:%.+]] = "onnx.Constant"() {value = dense<{{.}}{{.}}[1.100000e+01, 1.200000e+01], [2.100000e+01, 2.200000e+01], [3.100000e+01, 3.200000e+01]], {{.}}[1.300000e+01, 1.400000e+01], [2.300000e+01, 2.400000e+01], [3.300000e+01, 3.400000e+01]]]> : tensor<2x3x2xf32>} : () -> tensor<2x3x2xf32>
+  // CHECK-NEXT: "std.return"([[CONST1]]) : (tensor<2x3x2xf32>) -> ()
+}
+
 
 //===----------------------------------------------------------------------===//  
 /// MUL tests (same as add, so have only two).
@@ -271,3 +283,103 @@ func @test_unsqueeze() -> tensor<*xf32> {
   // CHECK-NOT: {{.*}} = "onnx.Unsqueeze"{{.*}}
 }
 
+
+//===----------------------------------------------------------------------===//
+/// Reshape tests
+
+// -----
+
+// CHECK-LABEL: @test_reshape() -> tensor<3x2xf32>
+func @test_reshape() -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]]> : tensor<2x3xf32>} : () -> tensor<2x3xf32>
+  %1 = "onnx.Constant"() {value = dense<[3, -1]> : tensor<2xi64>} : () -> tensor<2xi64>
+  %2 = "onnx.Reshape"(%0, %1) : (tensor<2x3xf32>, tensor<2xi64>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+  // CHECK: [[RES:%.+]] = "onnx.Constant"() {value = dense<{{\[}}[1.000000e+00, 2.000000e+00], [3.000000e+00, 4.000000e+00], [5.000000e+00, 6.000000e+00]{{\]}}> : tensor<3x2xf32>} : () -> tensor<3x2xf32>
+  // CHECK-NOT: "onnx.Reshape"
+  // CHECK: return [[RES]] : tensor<3x2xf32>
+}
+
+//===----------------------------------------------------------------------===//
+/// Gather tests
+
+// -----
+
+// CHECK-LABEL: @test_gather() -> tensor<2x2xi64>
+func @test_gather() -> tensor<*xi64> {
+  %0 = "onnx.Constant"() {value = dense<[[1, 2, 3], [4, 5, 6]]> : tensor<2x3xi64>} : () -> tensor<2x3xi64>
+  %1 = "onnx.Constant"() {value = dense<[2, -3]> : tensor<2xi64>} : () -> tensor<2xi64>
+  %2 = "onnx.Gather"(%0, %1) {axis = 1 : si64} : (tensor<2x3xi64>, tensor<2xi64>) -> tensor<*xi64>
+  "std.return"(%2) : (tensor<*xi64>) -> ()
+  // CHECK: [[RES:%.+]] = "onnx.Constant"() {value = dense<{{\[}}[3, 1], [6, 4]{{\]}}> : tensor<2x2xi64>} : () -> tensor<2x2xi64>
+  // CHECK-NOT: "onnx.Gather"
+  // CHECK: return [[RES]] : tensor<2x2xi64>
+}
+
+//===----------------------------------------------------------------------===//
+/// Slice tests
+
+// -----
+
+// CHECK-LABEL: @test_slice() -> tensor<2x2xf32>
+func @test_slice() -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[1.0, 2.0, 3.0, 4.0], [5.0, 6.0, 7.0, 8.0]]> : tensor<2x4xf32>} : () -> tensor<2x4xf32>
+  %1 = "onnx.Constant"() {value = dense<[-1]> : tensor<1xi64>} : () -> tensor<1xi64>
+  %2 = "onnx.Constant"() {value = dense<[0]> : tensor<1xi64>} : () -> tensor<1xi64>
+  %3 = "onnx.Constant"() {value = dense<[1]> : tensor<1xi64>} : () -> tensor<1xi64>
+  %4 = "onnx.Constant"() {value = dense<[-2]> : tensor<1xi64>} : () -> tensor<1xi64>
+  %5 = "onnx.Slice"(%0, %1, %2, %3, %4) : (tensor<2x4xf32>, tensor<1xi64>, tensor<1xi64>, tensor<1xi64>, tensor<1xi64>) -> tensor<*xf32>
+  "std.return"(%5) : (tensor<*xf32>) -> ()
+  // CHECK: [[RES:%.+]] = "onnx.Constant"() {value = dense<{{\[}}[4.000000e+00, 2.000000e+00], [8.000000e+00, 6.000000e+00]{{\]}}> : tensor<2x2xf32>} : () -> tensor<2x2xf32>
+  // CHECK-NOT: "onnx.Slice"
+  // CHECK: return [[RES]] : tensor<2x2xf32>
+}
+
+//===----------------------------------------------------------------------===//
+/// Concat tests
+
+// -----
+
+// CHECK-LABEL: @test_concat() -> tensor<2x3xi32>
+func @test_concat() -> tensor<*xi32> {
+  %0 = "onnx.Constant"() {value = dense<[[1], [4]]> : tensor<2x1xi32>} : () -> tensor<2x1xi32>
+  %1 = "onnx.Constant"() {value = dense<[[2, 3], [5, 6]]> : tensor<2x2xi32>} : () -> tensor<2x2xi32>
+  %2 = "onnx.Concat"(%0, %1) {axis = -1 : si64} : (tensor<2x1xi32>, tensor<2x2xi32>) -> tensor<*xi32>
+  "std.return"(%2) : (tensor<*xi32>) -> ()
+  // CHECK: [[RES:%.+]] = "onnx.Constant"() {value = dense<{{\[}}[1, 2, 3], [4, 5, 6]{{\]}}> : tensor<2x3xi32>} : () -> tensor<2x3xi32>
+  // CHECK-NOT: "onnx.Concat"
+  // CHECK: return [[RES]] : tensor<2x3xi32>
+}
+
+//===----------------------------------------------------------------------===//
+/// Cast tests
+
+// -----
+
+// CHECK-LABEL: @test_cast() -> tensor<3xi64>
+func @test_cast() -> tensor<*xi64> {
+  %0 = "onnx.Constant"() {value = dense<[1.5, -2.5, 3.0]> : tensor<3xf32>} : () -> tensor<3xf32>
+  %1 = "onnx.Cast"(%0) {to = 7 : si64} : (tensor<3xf32>) -> tensor<*xi64>
+  "std.return"(%1) : (tensor<*xi64>) -> ()
+  // CHECK: [[RES:%.+]] = "onnx.Constant"() {value = dense<[1, -2, 3]> : tensor<3xi64>} : () -> tensor<3xi64>
+  // CHECK-NOT: "onnx.Cast"
+  // CHECK: return [[RES]] : tensor<3xi64>
+}
+
+// -----
+
+/// A shape computation on initializers folds completely.
+// CHECK-LABEL: @test_shape_subgraph
+func @test_shape_subgraph(%arg0: tensor<6xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<[1, 2, 3]> : tensor<3xi32>} : () -> tensor<3xi32>
+  %1 = "onnx.Constant"() {value = dense<[1, 2]> : tensor<2xi64>} : () -> tensor<2xi64>
+  %2 = "onnx.Gather"(%0, %1) {axis = 0 : si64} : (tensor<3xi32>, tensor<2xi64>) -> tensor<*xi32>
+  %3 = "onnx.Cast"(%2) {to = 7 : si64} : (tensor<*xi32>) -> tensor<*xi64>
+  %4 = "onnx.Reshape"(%arg0, %3) : (tensor<6xf32>, tensor<*xi64>) -> tensor<*xf32>
+  "std.return"(%4) : (tensor<*xf32>) -> ()
+  // CHECK: [[SHAPE:%.+]] = "onnx.Constant"() {value = dense<[2, 3]> : tensor<2xi64>} : () -> tensor<2xi64>
+  // CHECK-NOT: "onnx.Gather"
+  // CHECK-NOT: "onnx.Cast"
+  // CHECK: [[RES:%.+]] = "onnx.Reshape"(%arg0, [[SHAPE]]) : (tensor<6xf32>, tensor<2xi64>) -> tensor<{{.*}}xf32>
+  // CHECK: return [[RES]]
+}
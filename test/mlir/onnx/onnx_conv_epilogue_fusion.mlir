@@ -0,0 +1,76 @@
+// RUN: onnx-mlir-opt --fuse-conv-epilogue %s -split-input-file | FileCheck %s
+// RUN: onnx-mlir-opt --fuse-conv-epilogue --convert-onnx-to-krnl %s -split-input-file | FileCheck --check-prefix=KRNL %s
+
+/// A residual addition followed by a Relu is fused into the convolution, and
+/// applied to each output element right after its reduction.
+func @test_fuse_conv_add_relu(%arg0: tensor<1x2x4x4xf32>, %arg1: tensor<3x2x2x2xf32>, %arg2: tensor<3xf32>, %arg3: tensor<1x3x3x3xf32>) -> tensor<1x3x3x3xf32> {
+  %0 = "onnx.Conv"(%arg0, %arg1, %arg2) {auto_pad = "NOTSET", group = 1 : si64, kernel_shape = [2, 2], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x2x4x4xf32>, tensor<3x2x2x2xf32>, tensor<3xf32>) -> tensor<1x3x3x3xf32>
+  %1 = "onnx.Add"(%0, %arg3) : (tensor<1x3x3x3xf32>, tensor<1x3x3x3xf32>) -> tensor<1x3x3x3xf32>
+  %2 = "onnx.Relu"(%1) : (tensor<1x3x3x3xf32>) -> tensor<1x3x3x3xf32>
+  "std.return"(%2) : (tensor<1x3x3x3xf32>) -> ()
+
+  // CHECK-LABEL: test_fuse_conv_add_relu
+  // CHECK-NOT: "onnx.Conv"
+  // CHECK: [[RES:%.+]] = "onnx.FusedConv"(%arg0, %arg1, %arg2, %arg3) {activation = "Relu", auto_pad = "NOTSET", group = 1 : si64, kernel_shape = [2, 2], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x2x4x4xf32>, tensor<3x2x2x2xf32>, tensor<3xf32>, tensor<1x3x3x3xf32>) -> tensor<1x3x3x3xf32>
+  // CHECK-NOT: "onnx.Add"
+  // CHECK-NOT: "onnx.Relu"
+  // CHECK: return [[RES]] : tensor<1x3x3x3xf32>
+
+  // KRNL-LABEL: test_fuse_conv_add_relu
+  // KRNL: [[RES:%.+]] = alloc() : memref<1x3x3x3xf32>
+  // KRNL: krnl.iterate
+  // KRNL: krnl.iterate
+  // KRNL: [[SUM:%.+]] = affine.load [[RES]][{{.*}}] : memref<1x3x3x3xf32>
+  // KRNL: [[BIAS:%.+]] = affine.load %arg2[{{.*}}] : memref<3xf32>
+  // KRNL: [[WITH_BIAS:%.+]] = addf [[SUM]], [[BIAS]] : f32
+  // KRNL: [[RESIDUAL:%.+]] = affine.load %arg3[{{.*}}] : memref<1x3x3x3xf32>
+  // KRNL: [[WITH_RESIDUAL:%.+]] = addf [[WITH_BIAS]], [[RESIDUAL]] : f32
+  // KRNL: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // KRNL: [[LTZERO:%.+]] = cmpf "olt", [[WITH_RESIDUAL]], [[ZERO]] : f32
+  // KRNL: [[RELU:%.+]] = select [[LTZERO]], [[ZERO]], [[WITH_RESIDUAL]] : f32
+  // KRNL: affine.store [[RELU]], [[RES]][{{.*}}] : memref<1x3x3x3xf32>
+  // KRNL-NOT: krnl.define_loops
+  // KRNL: return [[RES]] : memref<1x3x3x3xf32>
+}
+
+// -----
+
+/// A Clip with constant bounds is fused into a convolution without residual.
+func @test_fuse_conv_clip(%arg0: tensor<1x2x4x4xf32>, %arg1: tensor<3x2x2x2xf32>) -> tensor<1x3x3x3xf32> {
+  %cst = constant unit
+  %min = "onnx.Constant"() {value = dense<0.0> : tensor<f32>} : () -> tensor<f32>
+  %max = "onnx.Constant"() {value = dense<6.0> : tensor<f32>} : () -> tensor<f32>
+  %0 = "onnx.Conv"(%arg0, %arg1, %cst) {auto_pad = "NOTSET", group = 1 : si64, kernel_shape = [2, 2], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x2x4x4xf32>, tensor<3x2x2x2xf32>, none) -> tensor<1x3x3x3xf32>
+  %1 = "onnx.Clip"(%0, %min, %max) : (tensor<1x3x3x3xf32>, tensor<f32>, tensor<f32>) -> tensor<1x3x3x3xf32>
+  "std.return"(%1) : (tensor<1x3x3x3xf32>) -> ()
+
+  // CHECK-LABEL: test_fuse_conv_clip
+  // CHECK: [[RES:%.+]] = "onnx.FusedConv"(%arg0, %arg1, %cst, {{%.+}}) {activation = "Clip", auto_pad = "NOTSET", clip_max = 6.000000e+00 : f32, clip_min = 0.000000e+00 : f32, group = 1 : si64, kernel_shape = [2, 2], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x2x4x4xf32>, tensor<3x2x2x2xf32>, none, none) -> tensor<1x3x3x3xf32>
+  // CHECK-NOT: "onnx.Clip"
+  // CHECK: return [[RES]] : tensor<1x3x3x3xf32>
+
+  // KRNL-LABEL: test_fuse_conv_clip
+  // KRNL: [[SUM:%.+]] = affine.load [[RES:%.+]][{{.*}}] : memref<1x3x3x3xf32>
+  // KRNL: [[MIN:%.+]] = constant 0.000000e+00 : f32
+  // KRNL: [[LTMIN:%.+]] = cmpf "olt", [[SUM]], [[MIN]] : f32
+  // KRNL: [[CLIP_MIN:%.+]] = select [[LTMIN]], [[MIN]], [[SUM]] : f32
+  // KRNL: [[MAX:%.+]] = constant 6.000000e+00 : f32
+  // KRNL: [[GTMAX:%.+]] = cmpf "ogt", [[CLIP_MIN]], [[MAX]] : f32
+  // KRNL: [[CLIP_MAX:%.+]] = select [[GTMAX]], [[MAX]], [[CLIP_MIN]] : f32
+  // KRNL: affine.store [[CLIP_MAX]], [[RES]][{{.*}}] : memref<1x3x3x3xf32>
+}
+
+// -----
+
+/// A convolution whose output has several uses is left unchanged.
+func @test_no_fuse_multiple_uses(%arg0: tensor<1x2x4x4xf32>, %arg1: tensor<3x2x2x2xf32>) -> (tensor<1x3x3x3xf32>, tensor<1x3x3x3xf32>) {
+  %cst = constant unit
+  %0 = "onnx.Conv"(%arg0, %arg1, %cst) {auto_pad = "NOTSET", group = 1 : si64, kernel_shape = [2, 2], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x2x4x4xf32>, tensor<3x2x2x2xf32>, none) -> tensor<1x3x3x3xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<1x3x3x3xf32>) -> tensor<1x3x3x3xf32>
+  "std.return"(%0, %1) : (tensor<1x3x3x3xf32>, tensor<1x3x3x3xf32>) -> ()
+
+  // CHECK-LABEL: test_no_fuse_multiple_uses
+  // CHECK-NOT: "onnx.FusedConv"
+  // CHECK: "onnx.Conv"
+  // CHECK: "onnx.Relu"
+}
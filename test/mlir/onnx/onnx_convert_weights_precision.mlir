@@ -0,0 +1,31 @@
+// RUN: onnx-mlir-opt --convert-weights-precision %s -split-input-file | FileCheck %s
+
+/// The constant weights are converted, the results keep their type.
+func @test_matmul_weights(%arg0: tensor<3x2xf32>) -> tensor<3x2xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[1.0, 2.5], [-3.0, 4.0]]> : tensor<2x2xf32>} : () -> tensor<2x2xf32>
+  %1 = "onnx.MatMul"(%arg0, %0) : (tensor<3x2xf32>, tensor<2x2xf32>) -> tensor<3x2xf32>
+  "std.return"(%1) : (tensor<3x2xf32>) -> ()
+
+  // CHECK-LABEL: func @test_matmul_weights
+  // CHECK-NOT: tensor<2x2xf32>
+  // CHECK: [[WEIGHTS:%.+]] = "onnx.Constant"() {value = dense<{{\[}}[1.000000e+00, 2.500000e+00], [-3.000000e+00, 4.000000e+00]{{\]}}> : tensor<2x2xbf16>} : () -> tensor<2x2xbf16>
+  // CHECK: [[RES:%.+]] = "onnx.MatMul"(%arg0, [[WEIGHTS]]) : (tensor<3x2xf32>, tensor<2x2xbf16>) -> tensor<3x2xf32>
+  // CHECK: return [[RES]] : tensor<3x2xf32>
+}
+
+// -----
+
+/// Constants also used by other operations are kept for them.
+func @test_conv_shared_weights(%arg0: tensor<1x1x3x3xf32>) -> (tensor<1x1x3x3xf32>, tensor<1x1x1x1xf32>) {
+  %0 = "onnx.Constant"() {value = dense<0.5> : tensor<1x1x1x1xf32>} : () -> tensor<1x1x1x1xf32>
+  %cst = constant unit
+  %1 = "onnx.Conv"(%arg0, %0, %cst) {auto_pad = "NOTSET", group = 1 : si64} : (tensor<1x1x3x3xf32>, tensor<1x1x1x1xf32>, none) -> tensor<1x1x3x3xf32>
+  %2 = "onnx.Relu"(%0) : (tensor<1x1x1x1xf32>) -> tensor<1x1x1x1xf32>
+  "std.return"(%1, %2) : (tensor<1x1x3x3xf32>, tensor<1x1x1x1xf32>) -> ()
+
+  // CHECK-LABEL: func @test_conv_shared_weights
+  // CHECK: [[CONST:%.+]] = "onnx.Constant"() {value = dense<5.000000e-01> : tensor<1x1x1x1xf32>} : () -> tensor<1x1x1x1xf32>
+  // CHECK: [[WEIGHTS:%.+]] = "onnx.Constant"() {value = dense<5.000000e-01> : tensor<1x1x1x1xbf16>} : () -> tensor<1x1x1x1xbf16>
+  // CHECK: [[CONV:%.+]] = "onnx.Conv"(%arg0, [[WEIGHTS]], %cst) {auto_pad = "NOTSET", group = 1 : si64} : (tensor<1x1x3x3xf32>, tensor<1x1x1x1xbf16>, none) -> tensor<1x1x3x3xf32>
+  // CHECK: [[RELU:%.+]] = "onnx.Relu"([[CONST]]) : (tensor<1x1x1x1xf32>) -> tensor<1x1x1x1xf32>
+}
@@ -0,0 +1,114 @@
+// RUN: onnx-mlir-opt --shape-inference --fuse-onnx-elementwise %s -split-input-file | FileCheck %s
+// RUN: onnx-mlir-opt --shape-inference --fuse-onnx-elementwise --convert-onnx-to-krnl %s -split-input-file | FileCheck --check-prefix=KRNL %s
+
+func @test_fuse_add_mul_relu(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>, %arg2 : tensor<10x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Mul"(%0, %arg2) : (tensor<*xf32>, tensor<10x10xf32>) -> tensor<*xf32>
+  %2 = "onnx.Relu"(%1) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_fuse_add_mul_relu
+  // CHECK: [[FUSED:%.+]] = "onnx.FusedElementwise"(%arg0, %arg1, %arg2) ( {
+  // CHECK: ^bb0([[A:%.+]]: tensor<10x10xf32>, [[B:%.+]]: tensor<10x10xf32>, [[C:%.+]]: tensor<10x10xf32>):
+  // CHECK:   [[ADD:%.+]] = "onnx.Add"([[A]], [[B]]) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK:   [[MUL:%.+]] = "onnx.Mul"([[ADD]], [[C]]) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK:   [[RELU:%.+]] = "onnx.Relu"([[MUL]]) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK:   "onnx.FusedElementwiseYield"([[RELU]]) : (tensor<10x10xf32>) -> ()
+  // CHECK: }) : (tensor<10x10xf32>, tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK: return [[FUSED]] : tensor<10x10xf32>
+
+  // KRNL-LABEL: test_fuse_add_mul_relu
+  // KRNL: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // KRNL-NOT: alloc()
+  // KRNL: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // KRNL: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg3 = 0 to 10, [[DEF_LOOPS]]#1 -> %arg4 = 0 to 10) {
+  // KRNL: [[LOAD_A:%.+]] = affine.load %arg0[%arg3, %arg4] : memref<10x10xf32>
+  // KRNL: [[LOAD_B:%.+]] = affine.load %arg1[%arg3, %arg4] : memref<10x10xf32>
+  // KRNL: [[LOAD_C:%.+]] = affine.load %arg2[%arg3, %arg4] : memref<10x10xf32>
+  // KRNL: [[ADD:%.+]] = addf [[LOAD_A]], [[LOAD_B]] : f32
+  // KRNL: [[MUL:%.+]] = mulf [[ADD]], [[LOAD_C]] : f32
+  // KRNL: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // KRNL: [[LTZERO:%.+]] = cmpf "olt", [[MUL]], [[ZERO]] : f32
+  // KRNL: [[RELU:%.+]] = select [[LTZERO]], [[ZERO]], [[MUL]] : f32
+  // KRNL: affine.store [[RELU]], [[RES]][%arg3, %arg4] : memref<10x10xf32>
+  // KRNL-NOT: krnl.define_loops
+  // KRNL: return [[RES]] : memref<10x10xf32>
+}
+
+// -----
+
+/// A value used twice ends the chain, it is computed by its own operation.
+func @test_fuse_multiple_uses(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Exp"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  %2 = "onnx.Sub"(%1, %0) : (tensor<*xf32>, tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_fuse_multiple_uses
+  // CHECK: [[ADD:%.+]] = "onnx.Add"(%arg0, %arg1) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK: [[FUSED:%.+]] = "onnx.FusedElementwise"([[ADD]]) ( {
+  // CHECK: ^bb0([[X:%.+]]: tensor<10x10xf32>):
+  // CHECK:   [[EXP:%.+]] = "onnx.Exp"([[X]]) : (tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK:   [[SUB:%.+]] = "onnx.Sub"([[EXP]], [[X]]) : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<10x10xf32>
+  // CHECK:   "onnx.FusedElementwiseYield"([[SUB]]) : (tensor<10x10xf32>) -> ()
+  // CHECK: return [[FUSED]] : tensor<10x10xf32>
+
+  // KRNL-LABEL: test_fuse_multiple_uses
+  // KRNL: krnl.define_loops 2
+  // KRNL: addf
+  // KRNL: krnl.define_loops 2
+  // KRNL: exp
+  // KRNL: subf
+  // KRNL: return
+}
+
+// -----
+
+/// Broadcasting operations are not fused.
+func @test_no_fuse_broadcast(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<10x10xf32>, tensor<10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_no_fuse_broadcast
+  // CHECK-NOT: onnx.FusedElementwise
+  // CHECK: "onnx.Add"
+  // CHECK: "onnx.Relu"
+
+  // KRNL-LABEL: test_no_fuse_broadcast
+  // KRNL: return
+}
+
+// -----
+
+/// The casts of the inputs and of the value of the chain are fused, the mask
+/// is converted when it is loaded and the product when it is stored.
+func @test_fuse_casts(%arg0 : tensor<10xi1>, %arg1 : tensor<10xf32>) -> tensor<*xf16> {
+  %0 = "onnx.Cast"(%arg0) {to = 1 : si64} : (tensor<10xi1>) -> tensor<*xf32>
+  %1 = "onnx.Mul"(%0, %arg1) : (tensor<*xf32>, tensor<10xf32>) -> tensor<*xf32>
+  %2 = "onnx.Cast"(%1) {to = 10 : si64} : (tensor<*xf32>) -> tensor<*xf16>
+  "std.return"(%2) : (tensor<*xf16>) -> ()
+
+  // CHECK-LABEL: test_fuse_casts
+  // CHECK: [[FUSED:%.+]] = "onnx.FusedElementwise"(%arg0, %arg1) ( {
+  // CHECK: ^bb0([[A:%.+]]: tensor<10xi1>, [[B:%.+]]: tensor<10xf32>):
+  // CHECK:   [[CAST_A:%.+]] = "onnx.Cast"([[A]]) {to = 1 : si64} : (tensor<10xi1>) -> tensor<10xf32>
+  // CHECK:   [[MUL:%.+]] = "onnx.Mul"([[CAST_A]], [[B]]) : (tensor<10xf32>, tensor<10xf32>) -> tensor<10xf32>
+  // CHECK:   [[CAST_MUL:%.+]] = "onnx.Cast"([[MUL]]) {to = 10 : si64} : (tensor<10xf32>) -> tensor<10xf16>
+  // CHECK:   "onnx.FusedElementwiseYield"([[CAST_MUL]]) : (tensor<10xf16>) -> ()
+  // CHECK: }) : (tensor<10xi1>, tensor<10xf32>) -> tensor<10xf16>
+  // CHECK: return [[FUSED]] : tensor<10xf16>
+
+  // KRNL-LABEL: test_fuse_casts
+  // KRNL: [[RES:%.+]] = alloc() : memref<10xf16>
+  // KRNL-NOT: alloc()
+  // KRNL: krnl.iterate
+  // KRNL: [[LOAD_A:%.+]] = affine.load %arg0[%arg2] : memref<10xi1>
+  // KRNL: [[LOAD_B:%.+]] = affine.load %arg1[%arg2] : memref<10xf32>
+  // KRNL: [[CAST_A:%.+]] = uitofp [[LOAD_A]] : i1 to f32
+  // KRNL: [[MUL:%.+]] = mulf [[CAST_A]], [[LOAD_B]] : f32
+  // KRNL: [[CAST_MUL:%.+]] = fptrunc [[MUL]] : f32 to f16
+  // KRNL: affine.store [[CAST_MUL]], [[RES]][%arg2] : memref<10xf16>
+  // KRNL-NOT: krnl.define_loops
+  // KRNL: return [[RES]] : memref<10xf16>
+}
@@ -0,0 +1,52 @@
+// RUN: onnx-mlir-opt --kv-cache-append %s -split-input-file | FileCheck %s
+
+/// The new entries are returned instead of the concatenations with the past
+/// entries, which are left to the other operations using them.
+module {
+  func @main_graph(%arg0: tensor<1x2x?x4xf32>, %arg1: tensor<1x2x?x4xf32>, %arg2: tensor<1x2x1x4xf32>, %arg3: tensor<1x2x1x4xf32>) -> (tensor<*xf32>, tensor<*xf32>, tensor<*xf32>) {
+    %0 = "onnx.Concat"(%arg0, %arg2) {axis = 2 : si64} : (tensor<1x2x?x4xf32>, tensor<1x2x1x4xf32>) -> tensor<*xf32>
+    %1 = "onnx.Concat"(%arg1, %arg3) {axis = 2 : si64} : (tensor<1x2x?x4xf32>, tensor<1x2x1x4xf32>) -> tensor<*xf32>
+    %2 = "onnx.MatMul"(%0, %1) : (tensor<*xf32>, tensor<*xf32>) -> tensor<*xf32>
+    "std.return"(%2, %0, %1) : (tensor<*xf32>, tensor<*xf32>, tensor<*xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 4 : i32, numOutputs = 3 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph
+  // CHECK-SAME: -> (tensor<*xf32>, tensor<1x2x1x4xf32>, tensor<1x2x1x4xf32>)
+  // CHECK: [[KEYS:%.+]] = "onnx.Concat"(%arg0, %arg2)
+  // CHECK: [[VALUES:%.+]] = "onnx.Concat"(%arg1, %arg3)
+  // CHECK: [[RES:%.+]] = "onnx.MatMul"([[KEYS]], [[VALUES]])
+  // CHECK: return [[RES]], %arg2, %arg3
+}
+
+// -----
+
+/// Concatenations not used otherwise are removed.
+module {
+  func @main_graph(%arg0: tensor<1x?x4xf32>, %arg1: tensor<1x1x4xf32>) -> tensor<*xf32> {
+    %0 = "onnx.Concat"(%arg0, %arg1) {axis = 1 : si64} : (tensor<1x?x4xf32>, tensor<1x1x4xf32>) -> tensor<*xf32>
+    "std.return"(%0) : (tensor<*xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 2 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph
+  // CHECK-SAME: -> tensor<1x1x4xf32>
+  // CHECK-NOT: onnx.Concat
+  // CHECK: return %arg1 : tensor<1x1x4xf32>
+}
+
+// -----
+
+/// The concatenation is kept when the past entries have other uses.
+module {
+  func @main_graph(%arg0: tensor<1x?x4xf32>, %arg1: tensor<1x1x4xf32>) -> (tensor<*xf32>, tensor<*xf32>) {
+    %0 = "onnx.Concat"(%arg0, %arg1) {axis = 1 : si64} : (tensor<1x?x4xf32>, tensor<1x1x4xf32>) -> tensor<*xf32>
+    %1 = "onnx.Relu"(%arg0) : (tensor<1x?x4xf32>) -> tensor<*xf32>
+    "std.return"(%0, %1) : (tensor<*xf32>, tensor<*xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 2 : i32, numOutputs = 2 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph
+  // CHECK: [[CONCAT:%.+]] = "onnx.Concat"(%arg0, %arg1)
+  // CHECK: return [[CONCAT]], {{.*}} : tensor<*xf32>, tensor<*xf32>
+}
@@ -0,0 +1,42 @@
+// RUN: onnx-mlir-opt --assign-nchwc-layout="block-size=8" %s -split-input-file | FileCheck %s
+
+/// A chain of convolutions and the operations consuming them is computed in
+/// the NCHWc layout, with transformations left at the boundaries only.
+func @test_nchwc_region(%arg0: tensor<1x8x10x10xf32>, %arg1: tensor<16x8x3x3xf32>, %arg2: tensor<16xf32>, %arg3: tensor<16x16x1x1xf32>) -> tensor<1x16x4x4xf32> {
+  %cst = constant unit
+  %0 = "onnx.Conv"(%arg0, %arg1, %arg2) {auto_pad = "NOTSET", group = 1 : si64, kernel_shape = [3, 3], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x8x10x10xf32>, tensor<16x8x3x3xf32>, tensor<16xf32>) -> tensor<1x16x8x8xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<1x16x8x8xf32>) -> tensor<1x16x8x8xf32>
+  %2 = "onnx.MaxPoolSingleOut"(%1) {auto_pad = "NOTSET", ceil_mode = 0 : si64, kernel_shape = [2, 2], pads = [0, 0, 0, 0], storage_order = 0 : si64, strides = [2, 2]} : (tensor<1x16x8x8xf32>) -> tensor<1x16x4x4xf32>
+  %3 = "onnx.Conv"(%2, %arg3, %cst) {auto_pad = "NOTSET", group = 1 : si64, kernel_shape = [1, 1], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x16x4x4xf32>, tensor<16x16x1x1xf32>, none) -> tensor<1x16x4x4xf32>
+  %4 = "onnx.Add"(%3, %2) : (tensor<1x16x4x4xf32>, tensor<1x16x4x4xf32>) -> tensor<1x16x4x4xf32>
+  "std.return"(%4) : (tensor<1x16x4x4xf32>) -> ()
+
+  // CHECK-LABEL: test_nchwc_region
+  // CHECK: [[X:%.+]] = "onnx.LayoutTransform"(%arg0) {block_size = 8 : i64, target_layout = "NCHWc"} : (tensor<1x8x10x10xf32>) -> tensor<1x1x10x10x8xf32>
+  // CHECK: [[W1:%.+]] = "onnx.LayoutTransform"(%arg1) {block_size = 8 : i64, target_layout = "OIHWio"} : (tensor<16x8x3x3xf32>) -> tensor<2x1x3x3x8x8xf32>
+  // CHECK: [[CONV1:%.+]] = "onnx.ConvNCHWc"([[X]], [[W1]], %arg2) {strides = [1, 1]} : (tensor<1x1x10x10x8xf32>, tensor<2x1x3x3x8x8xf32>, tensor<16xf32>) -> tensor<1x2x8x8x8xf32>
+  // CHECK: [[RELU:%.+]] = "onnx.Relu"([[CONV1]]) : (tensor<1x2x8x8x8xf32>) -> tensor<1x2x8x8x8xf32>
+  // CHECK: [[POOL:%.+]] = "onnx.MaxPoolSingleOut"([[RELU]]) {auto_pad = "NOTSET", ceil_mode = 0 : si64, kernel_shape = [2, 2, 1], pads = [0, 0, 0, 0, 0, 0], storage_order = 0 : si64, strides = [2, 2, 1]} : (tensor<1x2x8x8x8xf32>) -> tensor<1x2x4x4x8xf32>
+  // CHECK: [[W2:%.+]] = "onnx.LayoutTransform"(%arg3) {block_size = 8 : i64, target_layout = "OIHWio"} : (tensor<16x16x1x1xf32>) -> tensor<2x2x1x1x8x8xf32>
+  // CHECK: [[CONV2:%.+]] = "onnx.ConvNCHWc"([[POOL]], [[W2]], %cst) {strides = [1, 1]} : (tensor<1x2x4x4x8xf32>, tensor<2x2x1x1x8x8xf32>, none) -> tensor<1x2x4x4x8xf32>
+  // CHECK: [[ADD:%.+]] = "onnx.Add"([[CONV2]], [[POOL]]) : (tensor<1x2x4x4x8xf32>, tensor<1x2x4x4x8xf32>) -> tensor<1x2x4x4x8xf32>
+  // CHECK: [[RES:%.+]] = "onnx.LayoutTransform"([[ADD]]) {block_size = 8 : i64, target_layout = "NCHW"} : (tensor<1x2x4x4x8xf32>) -> tensor<1x16x4x4xf32>
+  // CHECK-NOT: "onnx.LayoutTransform"
+  // CHECK: return [[RES]] : tensor<1x16x4x4xf32>
+}
+
+// -----
+
+/// Convolutions whose channels are not a multiple of the block size keep the
+/// NCHW layout.
+func @test_nchwc_unblockable(%arg0: tensor<1x3x10x10xf32>, %arg1: tensor<16x3x3x3xf32>) -> tensor<1x16x8x8xf32> {
+  %cst = constant unit
+  %0 = "onnx.Conv"(%arg0, %arg1, %cst) {auto_pad = "NOTSET", group = 1 : si64, kernel_shape = [3, 3], pads = [0, 0, 0, 0], strides = [1, 1]} : (tensor<1x3x10x10xf32>, tensor<16x3x3x3xf32>, none) -> tensor<1x16x8x8xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<1x16x8x8xf32>) -> tensor<1x16x8x8xf32>
+  "std.return"(%1) : (tensor<1x16x8x8xf32>) -> ()
+
+  // CHECK-LABEL: test_nchwc_unblockable
+  // CHECK-NOT: "onnx.LayoutTransform"
+  // CHECK: "onnx.Conv"
+  // CHECK: "onnx.Relu"
+}
@@ -695,6 +695,33 @@ func @test_add_with_broadcasting(%arg0 : tensor<?xf32>, %arg1 : tensor<?x10xf32>
 
 // -----
 
+/// The per-channel bias is loaded once per channel, outside of the loops over
+/// the spatial dimensions.
+func @test_add_hoist_broadcast(%arg0 : tensor<2x3x4x5xf32>, %arg1 : tensor<3x1x1xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<2x3x4x5xf32>, tensor<3x1x1xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_add_hoist_broadcast
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x3x4x5xf32>
+  // CHECK: [[OUTER_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[OUTER_LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[OUTER_LOOPS]]#0, [[OUTER_LOOPS]]#1) with ([[OUTER_LOOPS]]#0 -> %arg2 = 0 to 2, [[OUTER_LOOPS]]#1 -> %arg3 = 0 to 3) {
+  // CHECK: [[ZERO:%.+]] = constant 0 : index
+  // CHECK: [[ZERO_0:%.+]] = constant 0 : index
+  // CHECK: [[BIAS:%.+]] = affine.load %arg1[%arg3, [[ZERO]], [[ZERO_0]]] : memref<3x1x1xf32>
+  // CHECK: [[INNER_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK-NOT: krnl.parallel
+  // CHECK: krnl.iterate([[INNER_LOOPS]]#0, [[INNER_LOOPS]]#1) with ([[INNER_LOOPS]]#0 -> %arg4 = 0 to 4, [[INNER_LOOPS]]#1 -> %arg5 = 0 to 5) {
+  // CHECK: [[LOAD:%.+]] = affine.load %arg0[%arg2, %arg3, %arg4, %arg5] : memref<2x3x4x5xf32>
+  // CHECK: [[ADD:%.+]] = addf [[LOAD]], [[BIAS]] : f32
+  // CHECK: affine.store [[ADD]], [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<2x3x4x5xf32>
+  // CHECK: }
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<2x3x4x5xf32>
+}
+
+// -----
+
 func @test_reducemax(%arg0 : tensor<3x2x2xf32>) -> tensor<*xf32> {
   %0 ="onnx.ReduceMax"(%arg0) {axes=[1], keepdims = 0 : si64} : (tensor<3x2x2xf32>)-> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -743,6 +770,38 @@ func @test_reducemin(%arg0 : tensor<3x2x2xf32>) -> tensor<*xf32> {
 
 // -----
 
+func @test_argmin(%arg0 : tensor<3x2x2xf32>) -> tensor<*xi64> {
+  %0 ="onnx.ArgMin"(%arg0) {axis = 1 : si64, keepdims = 0 : si64} : (tensor<3x2x2xf32>)-> tensor<*xi64>
+  "std.return"(%0) : (tensor<*xi64>) -> ()
+
+  // CHECK-LABEL: test_argmin
+  // CHECK: [[RES:%.+]] = alloc() : memref<3x2xi64>
+  // CHECK: [[SELECTED:%.+]] = alloc() : memref<3x2xf32>
+  // CHECK: [[DEF_LOOPS1:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[DEF_LOOPS1]]#0, [[DEF_LOOPS1]]#1) with ([[DEF_LOOPS1]]#0 -> %arg1 = 0 to 3, [[DEF_LOOPS1]]#1 -> %arg2 = 0 to 2) {
+  // CHECK: [[IDENTITY:%.+]] = constant 0x7F800000 : f32
+  // CHECK: affine.store [[IDENTITY]], [[SELECTED]][%arg1, %arg2] : memref<3x2xf32>
+  // CHECK: [[ZERO:%.+]] = constant 0 : i64
+  // CHECK: affine.store [[ZERO]], [[RES]][%arg1, %arg2] : memref<3x2xi64>
+
+  // CHECK: [[DEF_LOOPS2:%.+]]:3 = krnl.define_loops 3
+  // CHECK: krnl.parallel [[DEF_LOOPS2]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1, [[DEF_LOOPS2]]#2) with ([[DEF_LOOPS2]]#0 -> %arg1 = 0 to 3, [[DEF_LOOPS2]]#1 -> %arg2 = 0 to 2, [[DEF_LOOPS2]]#2 -> %arg3 = 0 to 2) {
+  // CHECK: [[NEXT:%.+]] = affine.load %arg0[%arg1, %arg2, %arg3] : memref<3x2x2xf32>
+  // CHECK: [[INDEX:%.+]] = index_cast %arg2 : index to i64
+  // CHECK: [[VALUE:%.+]] = affine.load [[SELECTED]][%arg1, %arg3] : memref<3x2xf32>
+  // CHECK: [[VALUE_INDEX:%.+]] = affine.load [[RES]][%arg1, %arg3] : memref<3x2xi64>
+  // CHECK: [[CMP:%.+]] = cmpf "olt", [[NEXT]], [[VALUE]] : f32
+  // CHECK: [[SELECT:%.+]] = select [[CMP]], [[NEXT]], [[VALUE]] : f32
+  // CHECK: affine.store [[SELECT]], [[SELECTED]][%arg1, %arg3] : memref<3x2xf32>
+  // CHECK: [[SELECT_INDEX:%.+]] = select [[CMP]], [[INDEX]], [[VALUE_INDEX]] : i64
+  // CHECK: affine.store [[SELECT_INDEX]], [[RES]][%arg1, %arg3] : memref<3x2xi64>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<3x2xi64>
+}
+
+// -----
+
 func @test_reduceprod(%arg0 : tensor<3x2x2xf32>) -> tensor<*xf32> {
   %0 ="onnx.ReduceProd"(%arg0) {axes=[1], keepdims = 0 : si64} : (tensor<3x2x2xf32>)-> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -789,6 +848,44 @@ func @test_reducesum(%arg0 : tensor<3x2x2xf32>) -> tensor<*xf32> {
 
 // -----
 
+// Loops over the kept dimensions are outside of the loops over the reduced
+// axes, the innermost kept dimension staying innermost.
+func @test_reducesum_loop_order(%arg0 : tensor<2x3x4x5xf32>) -> tensor<*xf32> {
+  %0 ="onnx.ReduceSum"(%arg0) {axes=[1], keepdims = 0 : si64} : (tensor<2x3x4x5xf32>)-> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_reducesum_loop_order
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x4x5xf32>
+  // CHECK: [[DEF_LOOPS2:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.permute([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1, [[DEF_LOOPS2]]#2, [[DEF_LOOPS2]]#3) [0, 2, 1, 3] : !krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1, [[DEF_LOOPS2]]#2, [[DEF_LOOPS2]]#3) with ([[DEF_LOOPS2]]#0 -> %arg1 = 0 to 2, [[DEF_LOOPS2]]#1 -> %arg2 = 0 to 3, [[DEF_LOOPS2]]#2 -> %arg3 = 0 to 4, [[DEF_LOOPS2]]#3 -> %arg4 = 0 to 5) {
+  // CHECK: [[LOAD1:%.+]] = affine.load %arg0[%arg1, %arg2, %arg3, %arg4] : memref<2x3x4x5xf32>
+  // CHECK: [[LOAD2:%.+]] = affine.load [[RES]][%arg1, %arg3, %arg4] : memref<2x4x5xf32>
+  // CHECK: [[REDUCE:%.+]] = addf [[LOAD2]], [[LOAD1]] : f32
+  // CHECK: affine.store [[REDUCE]], [[RES]][%arg1, %arg3, %arg4] : memref<2x4x5xf32>
+}
+
+// -----
+
+// Loops over the reduced axes are innermost when the innermost dimension is
+// reduced, the result element being the same in all their iterations.
+func @test_reducesum_reduced_innermost(%arg0 : tensor<3x4x5xf32>) -> tensor<*xf32> {
+  %0 ="onnx.ReduceSum"(%arg0) {axes=[0, 2], keepdims = 0 : si64} : (tensor<3x4x5xf32>)-> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_reducesum_reduced_innermost
+  // CHECK: [[RES:%.+]] = alloc() : memref<4xf32>
+  // CHECK: [[DEF_LOOPS2:%.+]]:3 = krnl.define_loops 3
+  // CHECK: krnl.permute([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1, [[DEF_LOOPS2]]#2) [1, 0, 2] : !krnl.loop, !krnl.loop, !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1, [[DEF_LOOPS2]]#2) with ([[DEF_LOOPS2]]#0 -> %arg1 = 0 to 3, [[DEF_LOOPS2]]#1 -> %arg2 = 0 to 4, [[DEF_LOOPS2]]#2 -> %arg3 = 0 to 5) {
+  // CHECK: [[LOAD1:%.+]] = affine.load %arg0[%arg1, %arg2, %arg3] : memref<3x4x5xf32>
+  // CHECK: [[LOAD2:%.+]] = affine.load [[RES]][%arg2] : memref<4xf32>
+  // CHECK: [[REDUCE:%.+]] = addf [[LOAD2]], [[LOAD1]] : f32
+  // CHECK: affine.store [[REDUCE]], [[RES]][%arg2] : memref<4xf32>
+}
+
+// -----
+
 /// Check ReduceMean with f32.
 func @test_reducemean_f32(%arg0 : tensor<3x2x2xf32>) -> tensor<*xf32> {
   %0 ="onnx.ReduceMean"(%arg0) {axes=[1], keepdims = 0 : si64} : (tensor<3x2x2xf32>)-> tensor<*xf32>
@@ -897,37 +994,48 @@ func @test_softmax(%arg0 : tensor<10x10xf32>) -> tensor<*xf32> {
   "std.return"(%0) : (tensor<*xf32>) -> ()
 
   // CHECK-LABEL: test_softmax
-  // CHECK: [[MAX:%.+]] = alloc() : memref<f32>
-  // CHECK: [[SUM:%.+]] = alloc() : memref<f32>
-  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK-DAG: [[MAX:%.+]] = alloc() : memref<f32>
+  // CHECK-DAG: [[SUM:%.+]] = alloc() : memref<f32>
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<10x10xf32>
   // CHECK: [[CST:%.+]] = constant 0.000000e+00 : f32
   // CHECK: [[CST_0:%.+]] = constant 0xFF800000 : f32
-  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK: krnl.iterate([[DEF_LOOPS]]#0) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 10) {
+  // CHECK: [[OUTER_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.iterate([[OUTER_LOOPS]]) with ([[OUTER_LOOPS]] -> %arg1 = 0 to 10) {
   // CHECK: affine.store [[CST]], [[SUM]][] : memref<f32>
   // CHECK: affine.store [[CST_0]], [[MAX]][] : memref<f32>
-  // CHECK: krnl.iterate([[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#1 -> %arg2 = 0 to 10) {
-  // CHECK:   [[LOAD1:%.+]] = affine.load [[MAX]][] : memref<f32>
-  // CHECK:   [[LOAD2:%.+]] = affine.load %arg0[%arg1, %arg2] : memref<10x10xf32>
-  // CHECK:   [[COND:%.+]] = cmpf "ogt", [[LOAD1]], [[LOAD2]] : f32
-  // CHECK:   [[SELECT:%.+]] = select [[COND]], [[LOAD1]], [[LOAD2]] : f32
-  // CHECK:   affine.store [[SELECT]], [[MAX]][] : memref<f32>
+  // CHECK: [[MAX_SUM_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.iterate([[MAX_SUM_LOOPS]]) with ([[MAX_SUM_LOOPS]] -> %arg2 = 0 to 10) {
+  // CHECK:   [[X:%.+]] = affine.load %arg0[%arg1, %arg2] : memref<10x10xf32>
+  // CHECK:   [[M:%.+]] = affine.load [[MAX]][] : memref<f32>
+  // CHECK:   [[S:%.+]] = affine.load [[SUM]][] : memref<f32>
+  // CHECK:   [[GT:%.+]] = cmpf "ogt", [[X]], [[M]] : f32
+  // CHECK:   [[NEW_MAX:%.+]] = select [[GT]], [[X]], [[M]] : f32
+  // CHECK:   [[NEG_INF:%.+]] = constant 0xFF800000 : f32
+  // CHECK:   [[IS_NEG_INF:%.+]] = cmpf "oeq", [[NEW_MAX]], [[NEG_INF]] : f32
+  // CHECK:   [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK:   [[SHIFT:%.+]] = select [[IS_NEG_INF]], [[ZERO]], [[NEW_MAX]] : f32
+  // CHECK:   [[OTHER:%.+]] = select [[GT]], [[M]], [[X]] : f32
+  // CHECK:   [[DIFF:%.+]] = subf [[OTHER]], [[SHIFT]] : f32
+  // CHECK:   [[EXP:%.+]] = exp [[DIFF]] : f32
+  // CHECK:   [[RESCALED:%.+]] = mulf [[S]], [[EXP]] : f32
+  // CHECK:   [[ONE:%.+]] = constant 1.000000e+00 : f32
+  // CHECK:   [[RESCALED_SUM:%.+]] = addf [[RESCALED]], [[ONE]] : f32
+  // CHECK:   [[ACC_SUM:%.+]] = addf [[S]], [[EXP]] : f32
+  // CHECK:   [[NEW_SUM:%.+]] = select [[GT]], [[RESCALED_SUM]], [[ACC_SUM]] : f32
+  // CHECK:   affine.store [[NEW_SUM]], [[SUM]][] : memref<f32>
+  // CHECK:   affine.store [[NEW_MAX]], [[MAX]][] : memref<f32>
   // CHECK: }
   // CHECK: [[LOAD_MAX:%.+]] = affine.load [[MAX]][] : memref<f32>
-  // CHECK: krnl.iterate([[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#1 -> %arg2 = 0 to 10) {
-  // CHECK:   [[LOAD1]] = affine.load [[SUM]][] : memref<f32>
-  // CHECK:   [[LOAD2]] = affine.load %arg0[%arg1, %arg2] : memref<10x10xf32>
-  // CHECK:   [[SUB:%.+]] = subf [[LOAD2]], [[LOAD_MAX]] : f32
-  // CHECK:   [[EXP:%.+]] = exp [[SUB]] : f32
-  // CHECK:   [[ADD:%.+]] = addf [[LOAD1]], [[EXP]] : f32
-  // CHECK:   affine.store [[ADD]], [[SUM]][] : memref<f32>
-  // CHECK:   affine.store [[EXP]], [[RES]][%arg1, %arg2] : memref<10x10xf32>
-  // CHECK: }
   // CHECK: [[LOAD_SUM:%.+]] = affine.load [[SUM]][] : memref<f32>
-  // CHECK: krnl.iterate([[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#1 -> %arg2 = 0 to 10) {
-  // CHECK:   [[LOAD1]] = affine.load [[RES]][%arg1, %arg2] : memref<10x10xf32>
-  // CHECK:   [[DIV:%.+]] = divf [[LOAD1]], [[LOAD_SUM]] : f32
-  // CHECK:   affine.store [[DIV]], [[RES]][%arg1, %arg2] : memref<10x10xf32>
+  // CHECK: [[ONE_0:%.+]] = constant 1.000000e+00 : f32
+  // CHECK: [[INV_SUM:%.+]] = divf [[ONE_0]], [[LOAD_SUM]] : f32
+  // CHECK: [[RES_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.iterate([[RES_LOOPS]]) with ([[RES_LOOPS]] -> %arg2 = 0 to 10) {
+  // CHECK:   [[LOAD:%.+]] = affine.load %arg0[%arg1, %arg2] : memref<10x10xf32>
+  // CHECK:   [[SUB:%.+]] = subf [[LOAD]], [[LOAD_MAX]] : f32
+  // CHECK:   [[EXP_0:%.+]] = exp [[SUB]] : f32
+  // CHECK:   [[MUL:%.+]] = mulf [[EXP_0]], [[INV_SUM]] : f32
+  // CHECK:   affine.store [[MUL]], [[RES]][%arg1, %arg2] : memref<10x10xf32>
   // CHECK: }
   // CHECK: }
   // CHECK: dealloc [[SUM]] : memref<f32>
@@ -937,19 +1045,54 @@ func @test_softmax(%arg0 : tensor<10x10xf32>) -> tensor<*xf32> {
 
 // -----
 
+/// The leading elements of a row masked out with -inf leave the running max at
+/// -inf, the exponentials are then taken relative to 0 rather than to the max
+/// so that they add 0 to the sum rather than NaN.
+func @test_softmax_leading_neg_infinity(%arg0 : tensor<1x4xf32>) -> tensor<*xf32> {
+  %mask = "onnx.Constant"() {value = dense<[[0xFF800000, 0xFF800000, 0.0, 0.0]]> : tensor<1x4xf32>} : () -> tensor<1x4xf32>
+  %0 = "onnx.Add"(%arg0, %mask) : (tensor<1x4xf32>, tensor<1x4xf32>) -> tensor<*xf32>
+  %1 = "onnx.Softmax"(%0) {axis=1: si64} : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_softmax_leading_neg_infinity
+  // CHECK:   [[GT:%.+]] = cmpf "ogt", [[X:%.+]], [[M:%.+]] : f32
+  // CHECK:   [[NEW_MAX:%.+]] = select [[GT]], [[X]], [[M]] : f32
+  // CHECK:   [[IS_NEG_INF:%.+]] = cmpf "oeq", [[NEW_MAX]], {{.*}} : f32
+  // CHECK:   [[SHIFT:%.+]] = select [[IS_NEG_INF]], {{.*}}, [[NEW_MAX]] : f32
+  // CHECK:   [[OTHER:%.+]] = select [[GT]], [[M]], [[X]] : f32
+  // CHECK:   [[DIFF:%.+]] = subf [[OTHER]], [[SHIFT]] : f32
+  // CHECK:   exp [[DIFF]] : f32
+  // CHECK: return
+}
+
+// -----
+
 func @test_gemm(%arg0 : tensor<5x10xf32>, %arg1 : tensor<5x10xf32>, %arg2: tensor<10xf32>) -> tensor<*xf32> {
   %0 ="onnx.Gemm"(%arg0, %arg1, %arg2) {alpha = 1.0 : f32, beta = 5.0 : f32, transA = 1 : si64, transB = 0 : si64} : (tensor<5x10xf32>, tensor<5x10xf32>, tensor<10xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
 
   // CHECK-LABEL: test_gemm
+  // CHECK: [[PACKED_B:%.+]] = alloc() : memref<10x5xf32>
+  // CHECK: [[PACKED_A:%.+]] = alloc() : memref<10x5xf32>
   // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
   // CHECK: [[ALPHA:%.+]] = constant 1.000000e+00 : f32
   // CHECK: [[BETA:%.+]] = constant 5.000000e+00 : f32
+
+  /// Pack the transposed A and the non-transposed B.
+  // CHECK: [[PACK_A_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[PACK_A_LOOPS]]#0, [[PACK_A_LOOPS]]#1) with ([[PACK_A_LOOPS]]#0 -> [[PACK_A_I:%.+]] = 0 to 10, [[PACK_A_LOOPS]]#1 -> [[PACK_A_J:%.+]] = 0 to 5) {
+  // CHECK: [[LOAD_A:%.+]] = affine.load %arg0{{\[}}[[PACK_A_J]], [[PACK_A_I]]{{\]}} : memref<5x10xf32>
+  // CHECK: affine.store [[LOAD_A]], [[PACKED_A]]{{\[}}[[PACK_A_I]], [[PACK_A_J]]{{\]}} : memref<10x5xf32>
+  // CHECK: [[PACK_B_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[PACK_B_LOOPS]]#0, [[PACK_B_LOOPS]]#1) with ([[PACK_B_LOOPS]]#0 -> [[PACK_B_I:%.+]] = 0 to 10, [[PACK_B_LOOPS]]#1 -> [[PACK_B_J:%.+]] = 0 to 5) {
+  // CHECK: [[LOAD_B:%.+]] = affine.load %arg1{{\[}}[[PACK_B_J]], [[PACK_B_I]]{{\]}} : memref<5x10xf32>
+  // CHECK: affine.store [[LOAD_B]], [[PACKED_B]]{{\[}}[[PACK_B_I]], [[PACK_B_J]]{{\]}} : memref<10x5xf32>
+
   // CHECK: [[DEF_LOOPS:%.+]]:3 = krnl.define_loops 3
   // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg3 = 0 to 10, [[DEF_LOOPS]]#1 -> %arg4 = 0 to 10) {
   // CHECK: krnl.iterate([[DEF_LOOPS]]#2) with ([[DEF_LOOPS]]#2 -> %arg5 = 0 to 5) {
-  // CHECK: [[A:%.+]] = affine.load %arg0[%arg5, %arg3] : memref<5x10xf32>
-  // CHECK: [[B:%.+]] = affine.load %arg1[%arg5, %arg4] : memref<5x10xf32>
+  // CHECK: [[A:%.+]] = affine.load [[PACKED_A]][%arg3, %arg5] : memref<10x5xf32>
+  // CHECK: [[B:%.+]] = affine.load [[PACKED_B]][%arg4, %arg5] : memref<10x5xf32>
   // CHECK: [[Y:%.+]] = affine.load [[RES]][%arg3, %arg4] : memref<10x10xf32>
   // CHECK: [[AB:%.+]] = mulf [[A]], [[B]] : f32
   // CHECK: [[SUM:%.+]] = addf [[Y]], [[AB]] : f32
@@ -968,6 +1111,45 @@ func @test_gemm(%arg0 : tensor<5x10xf32>, %arg1 : tensor<5x10xf32>, %arg2: tenso
 
 // -----
 
+/// With transA = 0 and transB = 1, the reduction already reads contiguous
+/// memory and no operand is packed.
+func @test_gemm_transB(%arg0 : tensor<10x5xf32>, %arg1 : tensor<10x5xf32>, %arg2: tensor<10xf32>) -> tensor<*xf32> {
+  %0 ="onnx.Gemm"(%arg0, %arg1, %arg2) {alpha = 1.0 : f32, beta = 1.0 : f32, transA = 0 : si64, transB = 1 : si64} : (tensor<10x5xf32>, tensor<10x5xf32>, tensor<10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_gemm_transB
+  // CHECK-NOT: alloc() : memref<10x5xf32>
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[DEF_LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg3 = 0 to 10, [[DEF_LOOPS]]#1 -> %arg4 = 0 to 10) {
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#2) with ([[DEF_LOOPS]]#2 -> %arg5 = 0 to 5) {
+  // CHECK: [[A:%.+]] = affine.load %arg0[%arg3, %arg5] : memref<10x5xf32>
+  // CHECK: [[B:%.+]] = affine.load %arg1[%arg4, %arg5] : memref<10x5xf32>
+  // CHECK: return [[RES]] : memref<10x10xf32>
+}
+
+// -----
+
+/// The constant B is transposed at compile time instead of being packed by
+/// loops run on every inference.
+func @test_gemm_constant_B(%arg0 : tensor<3x2xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]]> : tensor<2x3xf32>} : () -> tensor<2x3xf32>
+  %cst = constant unit
+  %1 ="onnx.Gemm"(%arg0, %0, %cst) {alpha = 1.0 : f32, beta = 1.0 : f32, transA = 0 : si64, transB = 0 : si64} : (tensor<3x2xf32>, tensor<2x3xf32>, none) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_gemm_constant_B
+  // CHECK-NOT: alloc() : memref<3x2xf32>
+  // CHECK: [[PACKED:%.+]] = "krnl.global"() {name = "gemm_packed_{{[0-9]+}}", shape = [3, 2], value = dense<{{\[+}}1.000000e+00, 4.000000e+00], [2.000000e+00, 5.000000e+00], [3.000000e+00, 6.000000e+00{{\]+}}> : tensor<3x2xf32>} : () -> memref<3x2xf32>
+  // CHECK: [[RES:%.+]] = alloc() : memref<3x3xf32>
+  // CHECK: [[DEF_LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#2) with ([[DEF_LOOPS]]#2 -> %arg3 = 0 to 2) {
+  // CHECK: [[B:%.+]] = affine.load [[PACKED]][%arg2, %arg3] : memref<3x2xf32>
+  // CHECK: return [[RES]] : memref<3x3xf32>
+}
+
+// -----
+
 func @test_sqrt(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
   %0 = "onnx.Sqrt"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -1019,14 +1201,22 @@ func @test_transpose(%arg0 : tensor<10x20x30x40xf32>) -> tensor<*xf32> {
   // CHECK: [[RES1:%.+]] = alloc() : memref<40x30x20x10xf32>
 
   // CHECK: [[DEF_LOOPS:%.+]]:4 = krnl.define_loops 4
-  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1, [[DEF_LOOPS]]#2, [[DEF_LOOPS]]#3) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 10, [[DEF_LOOPS]]#1 -> %arg2 = 0 to 20, [[DEF_LOOPS]]#2 -> %arg3 = 0 to 30, [[DEF_LOOPS]]#3 -> %arg4 = 0 to 40) {
-  // CHECK: [[LOAD:%.+]] = affine.load %arg0[%arg1, %arg2, %arg3, %arg4] : memref<10x20x30x40xf32>
-  // CHECK: affine.store [[LOAD]], [[RES1]][%arg4, %arg3, %arg2, %arg1] : memref<40x30x20x10xf32>
+  // CHECK: [[BLOCK0:%.+]]:2 = krnl.block [[DEF_LOOPS]]#0 32 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[BLOCK3:%.+]]:2 = krnl.block [[DEF_LOOPS]]#3 10 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: krnl.permute([[BLOCK0]]#0, [[BLOCK0]]#1, [[DEF_LOOPS]]#1, [[DEF_LOOPS]]#2, [[BLOCK3]]#0, [[BLOCK3]]#1) [0, 4, 1, 2, 3, 5] : !krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop
+  // CHECK: krnl.parallel [[BLOCK0]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[BLOCK0]]#0, [[DEF_LOOPS]]#1, [[DEF_LOOPS]]#2, [[BLOCK3]]#0, [[BLOCK0]]#1, [[BLOCK3]]#1) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 40, [[DEF_LOOPS]]#1 -> %arg2 = 0 to 30, [[DEF_LOOPS]]#2 -> %arg3 = 0 to 20, [[DEF_LOOPS]]#3 -> %arg4 = 0 to 10) {
+  // CHECK: [[LOAD:%.+]] = affine.load %arg0[%arg4, %arg3, %arg2, %arg1] : memref<10x20x30x40xf32>
+  // CHECK: affine.store [[LOAD]], [[RES1]][%arg1, %arg2, %arg3, %arg4] : memref<40x30x20x10xf32>
 
   // CHECK: [[DEF_LOOPS:%.+]]:4 = krnl.define_loops 4
-  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1, [[DEF_LOOPS]]#2, [[DEF_LOOPS]]#3) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 40, [[DEF_LOOPS]]#1 -> %arg2 = 0 to 30, [[DEF_LOOPS]]#2 -> %arg3 = 0 to 20, [[DEF_LOOPS]]#3 -> %arg4 = 0 to 10) {
-  // CHECK: [[LOAD:%.+]] = affine.load [[RES1]][%arg1, %arg2, %arg3, %arg4] : memref<40x30x20x10xf32>
-  // CHECK: affine.store [[LOAD]], [[RES0]][%arg1, %arg4, %arg2, %arg3] : memref<40x10x30x20xf32>
+  // CHECK: [[BLOCK1:%.+]]:2 = krnl.block [[DEF_LOOPS]]#1 10 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[BLOCK3:%.+]]:2 = krnl.block [[DEF_LOOPS]]#3 20 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: krnl.permute([[DEF_LOOPS]]#0, [[BLOCK1]]#0, [[BLOCK1]]#1, [[DEF_LOOPS]]#2, [[BLOCK3]]#0, [[BLOCK3]]#1) [0, 1, 4, 2, 3, 5] : !krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop, !krnl.loop
+  // CHECK: krnl.parallel [[DEF_LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[BLOCK1]]#0, [[DEF_LOOPS]]#2, [[BLOCK3]]#0, [[BLOCK1]]#1, [[BLOCK3]]#1) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 40, [[DEF_LOOPS]]#1 -> %arg2 = 0 to 10, [[DEF_LOOPS]]#2 -> %arg3 = 0 to 30, [[DEF_LOOPS]]#3 -> %arg4 = 0 to 20) {
+  // CHECK: [[LOAD:%.+]] = affine.load [[RES1]][%arg1, %arg3, %arg4, %arg2] : memref<40x30x20x10xf32>
+  // CHECK: affine.store [[LOAD]], [[RES0]][%arg1, %arg2, %arg3, %arg4] : memref<40x10x30x20xf32>
 
   // CHECK: dealloc [[RES1]] : memref<40x30x20x10xf32>
   // CHECK: return [[RES0]] : memref<40x10x30x20xf32>
@@ -1034,6 +1224,40 @@ func @test_transpose(%arg0 : tensor<10x20x30x40xf32>) -> tensor<*xf32> {
 
 // -----
 
+func @test_transpose_copy(%arg0 : tensor<1x64x8x8xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Transpose"(%arg0) {perm = [1, 0, 2, 3]} : (tensor<1x64x8x8xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_transpose_copy
+  // CHECK: [[RES:%.+]] = alloc() : memref<64x1x8x8xf32>
+  // CHECK: [[SIZE:%.+]] = constant 16384 : i64
+  // CHECK: "krnl.memcpy"([[RES]], %arg0, [[SIZE]]) : (memref<64x1x8x8xf32>, memref<1x64x8x8xf32>, i64) -> ()
+  // CHECK-NOT: krnl.iterate
+  // CHECK: return [[RES]] : memref<64x1x8x8xf32>
+}
+
+// -----
+
+func @test_transpose_copy_runs(%arg0 : tensor<2x16x4x64xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Transpose"(%arg0) {perm = [0, 2, 1, 3]} : (tensor<2x16x4x64xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-DAG: [[DEST_MAP:#.+]] = affine_map<(d0, d1, d2) -> (d0 * 4096 + d1 * 1024 + d2 * 64)>
+  // CHECK-DAG: [[SRC_MAP:#.+]] = affine_map<(d0, d1, d2) -> (d0 * 4096 + d1 * 64 + d2 * 256)>
+  // CHECK-LABEL: test_transpose_copy_runs
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x4x16x64xf32>
+  // CHECK: [[SIZE:%.+]] = constant 256 : i64
+  // CHECK: [[DEF_LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK: krnl.parallel [[DEF_LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1, [[DEF_LOOPS]]#2) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 2, [[DEF_LOOPS]]#1 -> %arg2 = 0 to 4, [[DEF_LOOPS]]#2 -> %arg3 = 0 to 16) {
+  // CHECK: [[DEST:%.+]] = affine.apply [[DEST_MAP]](%arg1, %arg2, %arg3)
+  // CHECK: [[SRC:%.+]] = affine.apply [[SRC_MAP]](%arg1, %arg2, %arg3)
+  // CHECK: "krnl.memcpy"([[RES]], %arg0, [[SIZE]], [[DEST]], [[SRC]]) : (memref<2x4x16x64xf32>, memref<2x16x4x64xf32>, i64, index, index) -> ()
+  // CHECK: return [[RES]] : memref<2x4x16x64xf32>
+}
+
+// -----
+
 func @test_identity(%arg0 : tensor<10x20x30x40xf32>) -> tensor<*xf32> {
   %0 = "onnx.Identity"(%arg0) : (tensor<10x20x30x40xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -1407,6 +1631,34 @@ func @test_conv_no_bias_no_pad_w_group(%arg0 : tensor<1x9x32x64xf32>, %arg1 : te
 
 // -----
 
+/// Depthwise convolutions walk the output rows with one weight at a time.
+func @test_conv_depthwise(%arg0 : tensor<1x4x6x6xf32>, %arg1 : tensor<8x1x3x3xf32>, %arg2 : tensor<8xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Conv"(%arg0, %arg1, %arg2) {auto_pad = "NOTSET", group = 4 : si64} : (tensor<1x4x6x6xf32>, tensor<8x1x3x3xf32>, tensor<8xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_depthwise
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x8x4x4xf32>
+  // CHECK: [[ROW_LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK: krnl.parallel [[ROW_LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.parallel [[ROW_LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[N:%.+]] = 0 to 1, {{.*}} -> [[M:%.+]] = 0 to 8, {{.*}} -> [[R1:%.+]] = 0 to 4) {
+  // CHECK:   [[BIAS:%.+]] = affine.load %arg2{{\[}}[[M]]{{\]}} : memref<8xf32>
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> [[R2:%.+]] = 0 to 4) {
+  // CHECK:     affine.store [[BIAS]], [[RES]]{{\[}}[[N]], [[M]], [[R1]], [[R2]]{{\]}} : memref<1x8x4x4xf32>
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> [[K1:%.+]] = 0 to 3, {{.*}} -> [[K2:%.+]] = 0 to 3) {
+  // CHECK:     [[WEIGHT:%.+]] = affine.load %arg1{{\[}}[[M]], 0, [[K1]], [[K2]]{{\]}} : memref<8x1x3x3xf32>
+  // CHECK:     krnl.iterate({{.*}}) with ({{.*}} -> [[R2:%.+]] = 0 to 4) {
+  // CHECK:       [[DATA:%.+]] = affine.load %arg0{{\[}}[[N]], [[M]] floordiv 2, [[R1]] + [[K1]], [[R2]] + [[K2]]{{\]}} : memref<1x4x6x6xf32>
+  // CHECK:       [[PARTIAL:%.+]] = affine.load [[RES]]{{\[}}[[N]], [[M]], [[R1]], [[R2]]{{\]}} : memref<1x8x4x4xf32>
+  // CHECK:       [[MUL:%.+]] = mulf [[DATA]], [[WEIGHT]] : f32
+  // CHECK:       [[ADD:%.+]] = addf [[PARTIAL]], [[MUL]] : f32
+  // CHECK:       affine.store [[ADD]], [[RES]]{{\[}}[[N]], [[M]], [[R1]], [[R2]]{{\]}} : memref<1x8x4x4xf32>
+  // CHECK-NOT: krnl.iterate
+  // CHECK: return [[RES]] : memref<1x8x4x4xf32>
+}
+
+// -----
+
 func @test_conv_no_bias_no_pad_w_strides(%arg0 : tensor<1x9x32x64xf32>, %arg1 : tensor<5x9x6x7xf32>) -> tensor<*xf32> {
   %cst = constant unit
   %0 = "onnx.Conv"(%arg0, %arg1, %cst) {auto_pad = "NOTSET", group = 1 : si64, strides = [2, 2]} : (tensor<1x9x32x64xf32>, tensor<5x9x6x7xf32>, none) -> tensor<*xf32>
@@ -1457,14 +1709,15 @@ func @test_batchnorm_testmode_Nd(%arg0: tensor<1x2x1x3xf32>, %arg1: tensor<2xf32
   // CHECK:   [[BIAS:%.+]] = affine.load %arg2[%arg5] : memref<2xf32>
   // CHECK:   [[MEAN:%.+]] = affine.load %arg3[%arg5] : memref<2xf32>
   // CHECK:   [[VARIANCE:%.+]] = affine.load %arg4[%arg5] : memref<2xf32>
+  // CHECK:   [[ADJUSTED_VARIANCE:%.+]] = addf [[VARIANCE]], [[EPSILON]] : f32
+  // CHECK:   [[DIVISOR:%.+]] = sqrt [[ADJUSTED_VARIANCE]] : f32
+  // CHECK:   [[MULTIPLIER:%.+]] = divf [[SCALE]], [[DIVISOR]] : f32
+  // CHECK:   [[MEAN_MULTIPLIER:%.+]] = mulf [[MEAN]], [[MULTIPLIER]] : f32
+  // CHECK:   [[OFFSET:%.+]] = subf [[BIAS]], [[MEAN_MULTIPLIER]] : f32
   // CHECK:   krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#2, [[DEF_LOOPS]]#3) with ([[DEF_LOOPS]]#0 -> %arg6 = 0 to 1, [[DEF_LOOPS]]#2 -> %arg7 = 0 to 1, [[DEF_LOOPS]]#3 -> %arg8 = 0 to 3) {
   // CHECK:     [[LOADED_VAL:%.+]] = affine.load %arg0[%arg6, %arg5, %arg7, %arg8] : memref<1x2x1x3xf32>
-  // CHECK:     [[DIVIDEND:%.+]] = subf [[LOADED_VAL]], [[MEAN]] : f32
-  // CHECK:     [[ADJUSTED_VARIANCE:%.+]] = addf [[VARIANCE]], [[EPSILON]] : f32
-  // CHECK:     [[DIVISOR:%.+]] = sqrt [[ADJUSTED_VARIANCE]] : f32
-  // CHECK:     [[NORM:%.+]] = divf [[DIVIDEND]], [[DIVISOR]] : f32
-  // CHECK:     [[SCALE_NORM:%.+]] = mulf [[SCALE]], [[NORM]] : f32
-  // CHECK:     [[SHIFT_SCALE_NORM:%.+]] = addf [[SCALE_NORM]], [[BIAS]] : f32
+  // CHECK:     [[SCALE_NORM:%.+]] = mulf [[LOADED_VAL]], [[MULTIPLIER]] : f32
+  // CHECK:     [[SHIFT_SCALE_NORM:%.+]] = addf [[SCALE_NORM]], [[OFFSET]] : f32
   // CHECK:     affine.store [[SHIFT_SCALE_NORM]], [[RES]][%arg6, %arg5, %arg7, %arg8] : memref<1x2x1x3xf32>
   // CHECK:   }
   // CHECK: }
@@ -1486,14 +1739,15 @@ func @test_batchnorm_testmode_1d(%arg0: tensor<10xf32>, %arg1: tensor<1xf32>, %a
   // CHECK: [[BIAS:%.+]] = affine.load %arg2[%[[ZERO_INDEX]]] : memref<1xf32>
   // CHECK: [[MEAN:%.+]] = affine.load %arg3[%[[ZERO_INDEX]]] : memref<1xf32>
   // CHECK: [[VARIANCE:%.+]] = affine.load %arg4[%[[ZERO_INDEX]]] : memref<1xf32>
+  // CHECK: [[ADJUSTED_VARIANCE:%.+]] = addf [[VARIANCE]], [[EPSILON]] : f32
+  // CHECK: [[DIVISOR:%.+]] = sqrt [[ADJUSTED_VARIANCE]] : f32
+  // CHECK: [[MULTIPLIER:%.+]] = divf [[SCALE]], [[DIVISOR]] : f32
+  // CHECK: [[MEAN_MULTIPLIER:%.+]] = mulf [[MEAN]], [[MULTIPLIER]] : f32
+  // CHECK: [[OFFSET:%.+]] = subf [[BIAS]], [[MEAN_MULTIPLIER]] : f32
   // CHECK: krnl.iterate([[DEF_LOOPS]]) with ([[DEF_LOOPS]] -> %arg5 = 0 to 10) {
   // CHECK:   [[LOADED_VAL:%.+]] = affine.load %arg0[%arg5] : memref<10xf32>
-  // CHECK:   [[DIVIDEND:%.+]] = subf [[LOADED_VAL]], [[MEAN]] : f32
-  // CHECK:   [[ADJUSTED_VARIANCE:%.+]] = addf [[VARIANCE]], [[EPSILON]] : f32
-  // CHECK:   [[DIVISOR:%.+]] = sqrt [[ADJUSTED_VARIANCE]] : f32
-  // CHECK:   [[NORM:%.+]] = divf [[DIVIDEND]], [[DIVISOR]] : f32
-  // CHECK:   [[SCALE_NORM:%.+]] = mulf [[SCALE]], [[NORM]] : f32
-  // CHECK:   [[SHIFT_SCALE_NORM:%.+]] = addf [[SCALE_NORM]], [[BIAS]] : f32
+  // CHECK:   [[SCALE_NORM:%.+]] = mulf [[LOADED_VAL]], [[MULTIPLIER]] : f32
+  // CHECK:   [[SHIFT_SCALE_NORM:%.+]] = addf [[SCALE_NORM]], [[OFFSET]] : f32
   // CHECK:   affine.store [[SHIFT_SCALE_NORM]], [[RES]][%arg5] : memref<10xf32>
   // CHECK: }
   // CHECK: return [[RES]] : memref<10xf32>
@@ -1514,14 +1768,15 @@ func @test_batchnorm_testmode_2d(%arg0: tensor<10x3xf32>, %arg1: tensor<3xf32>,
   // CHECK:   [[BIAS:%.+]] = affine.load %arg2[%arg5] : memref<3xf32>
   // CHECK:   [[MEAN:%.+]] = affine.load %arg3[%arg5] : memref<3xf32>
   // CHECK:   [[VARIANCE:%.+]] = affine.load %arg4[%arg5] : memref<3xf32>
+  // CHECK:   [[ADJUSTED_VARIANCE:%.+]] = addf [[VARIANCE]], [[EPSILON]] : f32
+  // CHECK:   [[DIVISOR:%.+]] = sqrt [[ADJUSTED_VARIANCE]] : f32
+  // CHECK:   [[MULTIPLIER:%.+]] = divf [[SCALE]], [[DIVISOR]] : f32
+  // CHECK:   [[MEAN_MULTIPLIER:%.+]] = mulf [[MEAN]], [[MULTIPLIER]] : f32
+  // CHECK:   [[OFFSET:%.+]] = subf [[BIAS]], [[MEAN_MULTIPLIER]] : f32
   // CHECK:   krnl.iterate([[DEF_LOOPS]]#0) with ([[DEF_LOOPS]]#0 -> %arg6 = 0 to 10) {
   // CHECK:     [[LOADED_VAL:%.+]] = affine.load %arg0[%arg6, %arg5] : memref<10x3xf32>
-  // CHECK:     [[DIVIDEND:%.+]] = subf [[LOADED_VAL]], [[MEAN]] : f32
-  // CHECK:     [[ADJUSTED_VARIANCE:%.+]] = addf [[VARIANCE]], [[EPSILON]] : f32
-  // CHECK:     [[DIVISOR:%.+]] = sqrt [[ADJUSTED_VARIANCE]] : f32
-  // CHECK:     [[NORM:%.+]] = divf [[DIVIDEND]], [[DIVISOR]] : f32
-  // CHECK:     [[SCALE_NORM:%.+]] = mulf [[SCALE]], [[NORM]] : f32
-  // CHECK:     [[SHIFT_SCALE_NORM:%.+]] = addf [[SCALE_NORM]], [[BIAS]] : f32
+  // CHECK:     [[SCALE_NORM:%.+]] = mulf [[LOADED_VAL]], [[MULTIPLIER]] : f32
+  // CHECK:     [[SHIFT_SCALE_NORM:%.+]] = addf [[SCALE_NORM]], [[OFFSET]] : f32
   // CHECK:     affine.store [[SHIFT_SCALE_NORM]], [[RES]][%arg6, %arg5] : memref<10x3xf32>
   // CHECK:   }
   // CHECK: }
@@ -1530,6 +1785,71 @@ func @test_batchnorm_testmode_2d(%arg0: tensor<10x3xf32>, %arg1: tensor<3xf32>,
 
 // -----
 
+func @test_instancenorm(%arg0: tensor<2x3x4x5xf32>, %arg1: tensor<3xf32>, %arg2: tensor<3xf32>) -> tensor<*xf32> {
+  %0 = "onnx.InstanceNormalization"(%arg0, %arg1, %arg2) : (tensor<2x3x4x5xf32>, tensor<3xf32>, tensor<3xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_instancenorm
+  // CHECK: [[M2:%.+]] = alloc() : memref<2x3xf32>
+  // CHECK: [[MEAN:%.+]] = alloc() : memref<2x3xf32>
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x3x4x5xf32>
+  // CHECK: [[EPSILON:%.+]] = constant 9.99999974E-6 : f32
+  // CHECK: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[ONE:%.+]] = constant 1.000000e+00 : f32
+  // CHECK: [[DIM2:%.+]] = constant 4 : index
+  // CHECK: [[DIM3:%.+]] = constant 5 : index
+  // CHECK: [[SIZE:%.+]] = muli [[DIM2]], [[DIM3]] : index
+  // CHECK: [[SIZE_I64:%.+]] = index_cast [[SIZE]] : index to i64
+  // CHECK: [[COUNT:%.+]] = sitofp [[SIZE_I64]] : i64 to f32
+  // CHECK: [[OUTER_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[OUTER_LOOPS]]#0
+  // CHECK: krnl.iterate([[OUTER_LOOPS]]#0, [[OUTER_LOOPS]]#1) with ([[OUTER_LOOPS]]#0 -> %arg3 = 0 to 2, [[OUTER_LOOPS]]#1 -> %arg4 = 0 to 3) {
+  // CHECK:   affine.store [[ZERO]], [[MEAN]][%arg3, %arg4] : memref<2x3xf32>
+  // CHECK:   affine.store [[ZERO]], [[M2]][%arg3, %arg4] : memref<2x3xf32>
+  // CHECK:   [[STAT_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:   krnl.iterate([[STAT_LOOPS]]#0, [[STAT_LOOPS]]#1) with ([[STAT_LOOPS]]#0 -> %arg5 = 0 to 4, [[STAT_LOOPS]]#1 -> %arg6 = 0 to 5) {
+  // CHECK:     [[X:%.+]] = affine.load %arg0[%arg3, %arg4, %arg5, %arg6] : memref<2x3x4x5xf32>
+  // CHECK:     [[ROW:%.+]] = muli %arg5, [[DIM3]] : index
+  // CHECK:     [[INDEX:%.+]] = addi [[ROW]], %arg6 : index
+  // CHECK:     [[INDEX_I64:%.+]] = index_cast [[INDEX]] : index to i64
+  // CHECK:     [[INDEX_F32:%.+]] = sitofp [[INDEX_I64]] : i64 to f32
+  // CHECK:     [[K:%.+]] = addf [[INDEX_F32]], [[ONE]] : f32
+  // CHECK:     [[MEAN_VAL:%.+]] = affine.load [[MEAN]][%arg3, %arg4] : memref<2x3xf32>
+  // CHECK:     [[M2_VAL:%.+]] = affine.load [[M2]][%arg3, %arg4] : memref<2x3xf32>
+  // CHECK:     [[DELTA:%.+]] = subf [[X]], [[MEAN_VAL]] : f32
+  // CHECK:     [[DELTA_K:%.+]] = divf [[DELTA]], [[K]] : f32
+  // CHECK:     [[NEW_MEAN:%.+]] = addf [[MEAN_VAL]], [[DELTA_K]] : f32
+  // CHECK:     [[NEW_DELTA:%.+]] = subf [[X]], [[NEW_MEAN]] : f32
+  // CHECK:     [[DELTA_PROD:%.+]] = mulf [[DELTA]], [[NEW_DELTA]] : f32
+  // CHECK:     [[NEW_M2:%.+]] = addf [[M2_VAL]], [[DELTA_PROD]] : f32
+  // CHECK:     affine.store [[NEW_MEAN]], [[MEAN]][%arg3, %arg4] : memref<2x3xf32>
+  // CHECK:     affine.store [[NEW_M2]], [[M2]][%arg3, %arg4] : memref<2x3xf32>
+  // CHECK:   }
+  // CHECK:   [[SCALE:%.+]] = affine.load %arg1[%arg4] : memref<3xf32>
+  // CHECK:   [[BIAS:%.+]] = affine.load %arg2[%arg4] : memref<3xf32>
+  // CHECK:   [[MEAN_VAL:%.+]] = affine.load [[MEAN]][%arg3, %arg4] : memref<2x3xf32>
+  // CHECK:   [[M2_VAL:%.+]] = affine.load [[M2]][%arg3, %arg4] : memref<2x3xf32>
+  // CHECK:   [[VARIANCE:%.+]] = divf [[M2_VAL]], [[COUNT]] : f32
+  // CHECK:   [[ADJUSTED_VARIANCE:%.+]] = addf [[VARIANCE]], [[EPSILON]] : f32
+  // CHECK:   [[DIVISOR:%.+]] = sqrt [[ADJUSTED_VARIANCE]] : f32
+  // CHECK:   [[MULTIPLIER:%.+]] = divf [[SCALE]], [[DIVISOR]] : f32
+  // CHECK:   [[MEAN_MULTIPLIER:%.+]] = mulf [[MEAN_VAL]], [[MULTIPLIER]] : f32
+  // CHECK:   [[OFFSET:%.+]] = subf [[BIAS]], [[MEAN_MULTIPLIER]] : f32
+  // CHECK:   [[NORM_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:   krnl.iterate([[NORM_LOOPS]]#0, [[NORM_LOOPS]]#1) with ([[NORM_LOOPS]]#0 -> %arg5 = 0 to 4, [[NORM_LOOPS]]#1 -> %arg6 = 0 to 5) {
+  // CHECK:     [[LOADED_VAL:%.+]] = affine.load %arg0[%arg3, %arg4, %arg5, %arg6] : memref<2x3x4x5xf32>
+  // CHECK:     [[SCALE_NORM:%.+]] = mulf [[LOADED_VAL]], [[MULTIPLIER]] : f32
+  // CHECK:     [[SHIFT_SCALE_NORM:%.+]] = addf [[SCALE_NORM]], [[OFFSET]] : f32
+  // CHECK:     affine.store [[SHIFT_SCALE_NORM]], [[RES]][%arg3, %arg4, %arg5, %arg6] : memref<2x3x4x5xf32>
+  // CHECK:   }
+  // CHECK: }
+  // CHECK: dealloc [[MEAN]] : memref<2x3xf32>
+  // CHECK: dealloc [[M2]] : memref<2x3xf32>
+  // CHECK: return [[RES]] : memref<2x3x4x5xf32>
+}
+
+// -----
+
 func @test_abs_float(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
   %0 = "onnx.Abs"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -1576,13 +1896,35 @@ func @test_abs_int(%arg0 : tensor<?x10xi32>) -> tensor<*xi32> {
 func @test_constant_pad1(%arg0: tensor<16x16xf32>) -> tensor<18x20xf32> {
   %0 = "onnx.PadConstantValuePad"(%arg0) {constant_value = 0.000000e+00 : f32, mode = "constant", pads = [0, 3, 2, 1]} : (tensor<16x16xf32>) -> tensor<18x20xf32>
   return %0 : tensor<18x20xf32>
+  // CHECK-DAG: [[DEST_MAP:#.+]] = affine_map<(d0) -> (d0 * 20 + 3)>
+  // CHECK-DAG: [[SRC_MAP:#.+]] = affine_map<(d0) -> (d0 * 16)>
   // CHECK-LABEL: test_constant_pad1
   // CHECK: [[RES:%.+]] = alloc() : memref<18x20xf32>
-  // CHECK: [[DEF_LOOPS1:%.+]]:2 = krnl.define_loops 2
-  // CHECK: krnl.iterate([[DEF_LOOPS1]]#0, [[DEF_LOOPS1]]#1) with ([[DEF_LOOPS1]]#0 -> %arg1 = 0 to 18, [[DEF_LOOPS1]]#1 -> %arg2 = 0 to 20) {
   // CHECK: [[CST:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[DEF_LOOPS1:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS1]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS1]]#0, [[DEF_LOOPS1]]#1) with ([[DEF_LOOPS1]]#0 -> %arg1 = 16 to 18, [[DEF_LOOPS1]]#1 -> %arg2 = 0 to 20) {
   // CHECK: affine.store [[CST]], [[RES]][%arg1, %arg2] : memref<18x20xf32>
   // CHECK: }
+  // CHECK: [[DEF_LOOPS2:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS2]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1) with ([[DEF_LOOPS2]]#0 -> %arg1 = 0 to 16, [[DEF_LOOPS2]]#1 -> %arg2 = 0 to 3) {
+  // CHECK: affine.store [[CST]], [[RES]][%arg1, %arg2] : memref<18x20xf32>
+  // CHECK: }
+  // CHECK: [[DEF_LOOPS3:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS3]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS3]]#0, [[DEF_LOOPS3]]#1) with ([[DEF_LOOPS3]]#0 -> %arg1 = 0 to 16, [[DEF_LOOPS3]]#1 -> %arg2 = 19 to 20) {
+  // CHECK: affine.store [[CST]], [[RES]][%arg1, %arg2] : memref<18x20xf32>
+  // CHECK: }
+  // CHECK: [[DEF_LOOPS4:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[DEF_LOOPS4]] : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS4]]) with ([[DEF_LOOPS4]] -> %arg1 = 0 to 16) {
+  // CHECK: [[DEST:%.+]] = affine.apply [[DEST_MAP]](%arg1)
+  // CHECK: [[SRC:%.+]] = affine.apply [[SRC_MAP]](%arg1)
+  // CHECK: [[SIZE:%.+]] = constant 64 : i64
+  // CHECK: "krnl.memcpy"([[RES]], %arg0, [[SIZE]], [[DEST]], [[SRC]]) : (memref<18x20xf32>, memref<16x16xf32>, i64, index, index) -> ()
+  // CHECK: }
+}
   // CHECK: [[DEF_LOOPS2:%.+]]:2 = krnl.define_loops 2
   // CHECK: krnl.iterate([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1) with ([[DEF_LOOPS2]]#0 -> %arg1 = 0 to 16, [[DEF_LOOPS2]]#1 -> %arg2 = 0 to 16) {
   // CHECK: [[ADD:%.+]] = affine.apply #{{.*}}(%arg2)
@@ -1591,17 +1933,41 @@ func @test_constant_pad1(%arg0: tensor<16x16xf32>) -> tensor<18x20xf32> {
   // CHECK: }
 }
 
+// -----
+
 func @test_pad1(%arg0: tensor<16x16xf32>) -> tensor<18x20xf32> {
   %cst = constant unit
   %0 = "onnx.Pad"(%arg0, %cst, %cst) {constant_value = dense<0.000000e+00> : tensor<1xf32>, mode = "constant", pads = dense<[0, 3, 2, 1]> : tensor<4xi32>} : (tensor<16x16xf32>, none, none) -> tensor<18x20xf32>
   return %0 : tensor<18x20xf32>
+  // CHECK-DAG: [[DEST_MAP:#.+]] = affine_map<(d0) -> (d0 * 20 + 3)>
+  // CHECK-DAG: [[SRC_MAP:#.+]] = affine_map<(d0) -> (d0 * 16)>
   // CHECK-LABEL: test_pad1
   // CHECK: [[RES:%.+]] = alloc() : memref<18x20xf32>
-  // CHECK: [[DEF_LOOPS1:%.+]]:2 = krnl.define_loops 2
-  // CHECK: krnl.iterate([[DEF_LOOPS1]]#0, [[DEF_LOOPS1]]#1) with ([[DEF_LOOPS1]]#0 -> %arg1 = 0 to 18, [[DEF_LOOPS1]]#1 -> %arg2 = 0 to 20) {
   // CHECK: [[CST:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[DEF_LOOPS1:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS1]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS1]]#0, [[DEF_LOOPS1]]#1) with ([[DEF_LOOPS1]]#0 -> %arg1 = 16 to 18, [[DEF_LOOPS1]]#1 -> %arg2 = 0 to 20) {
+  // CHECK: affine.store [[CST]], [[RES]][%arg1, %arg2] : memref<18x20xf32>
+  // CHECK: }
+  // CHECK: [[DEF_LOOPS2:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS2]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1) with ([[DEF_LOOPS2]]#0 -> %arg1 = 0 to 16, [[DEF_LOOPS2]]#1 -> %arg2 = 0 to 3) {
+  // CHECK: affine.store [[CST]], [[RES]][%arg1, %arg2] : memref<18x20xf32>
+  // CHECK: }
+  // CHECK: [[DEF_LOOPS3:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS3]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS3]]#0, [[DEF_LOOPS3]]#1) with ([[DEF_LOOPS3]]#0 -> %arg1 = 0 to 16, [[DEF_LOOPS3]]#1 -> %arg2 = 19 to 20) {
   // CHECK: affine.store [[CST]], [[RES]][%arg1, %arg2] : memref<18x20xf32>
   // CHECK: }
+  // CHECK: [[DEF_LOOPS4:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[DEF_LOOPS4]] : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS4]]) with ([[DEF_LOOPS4]] -> %arg1 = 0 to 16) {
+  // CHECK: [[DEST:%.+]] = affine.apply [[DEST_MAP]](%arg1)
+  // CHECK: [[SRC:%.+]] = affine.apply [[SRC_MAP]](%arg1)
+  // CHECK: [[SIZE:%.+]] = constant 64 : i64
+  // CHECK: "krnl.memcpy"([[RES]], %arg0, [[SIZE]], [[DEST]], [[SRC]]) : (memref<18x20xf32>, memref<16x16xf32>, i64, index, index) -> ()
+  // CHECK: }
+}
   // CHECK: [[DEF_LOOPS2:%.+]]:2 = krnl.define_loops 2
   // CHECK: krnl.iterate([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1) with ([[DEF_LOOPS2]]#0 -> %arg1 = 0 to 16, [[DEF_LOOPS2]]#1 -> %arg2 = 0 to 16) {
   // CHECK: [[ADD:%.+]] = affine.apply #{{.*}}(%arg2)
@@ -1612,6 +1978,31 @@ func @test_pad1(%arg0: tensor<16x16xf32>) -> tensor<18x20xf32> {
 
 // -----
 
+func @test_constant_pad_elementwise(%arg0: tensor<4x4xf32>) -> tensor<4x6xf32> {
+  %0 = "onnx.PadConstantValuePad"(%arg0) {constant_value = 1.000000e+00 : f32, mode = "constant", pads = [0, 1, 0, 1]} : (tensor<4x4xf32>) -> tensor<4x6xf32>
+  return %0 : tensor<4x6xf32>
+  // CHECK-LABEL: test_constant_pad_elementwise
+  // CHECK: [[RES:%.+]] = alloc() : memref<4x6xf32>
+  // CHECK: [[CST:%.+]] = constant 1.000000e+00 : f32
+  // CHECK: [[DEF_LOOPS1:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[DEF_LOOPS1]]#0, [[DEF_LOOPS1]]#1) with ([[DEF_LOOPS1]]#0 -> %arg1 = 0 to 4, [[DEF_LOOPS1]]#1 -> %arg2 = 0 to 1) {
+  // CHECK: affine.store [[CST]], [[RES]][%arg1, %arg2] : memref<4x6xf32>
+  // CHECK: }
+  // CHECK: [[DEF_LOOPS2:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[DEF_LOOPS2]]#0, [[DEF_LOOPS2]]#1) with ([[DEF_LOOPS2]]#0 -> %arg1 = 0 to 4, [[DEF_LOOPS2]]#1 -> %arg2 = 5 to 6) {
+  // CHECK: affine.store [[CST]], [[RES]][%arg1, %arg2] : memref<4x6xf32>
+  // CHECK: }
+  // CHECK: [[DEF_LOOPS3:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS3]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS3]]#0, [[DEF_LOOPS3]]#1) with ([[DEF_LOOPS3]]#0 -> %arg1 = 0 to 4, [[DEF_LOOPS3]]#1 -> %arg2 = 0 to 4) {
+  // CHECK: [[ADD:%.+]] = affine.apply #{{.*}}(%arg2)
+  // CHECK: [[LOAD:%.+]] = affine.load %arg0[%arg1, %arg2] : memref<4x4xf32>
+  // CHECK: affine.store [[LOAD]], [[RES]][%arg1, [[ADD]]] : memref<4x6xf32>
+  // CHECK: }
+}
+
+// -----
+
 func @test_constant_dense_2d_value(%arg0: tensor<1xf32>) -> tensor<*xf32> {
   %0 = "onnx.Constant"() {value = dense<[[0.0, 0.0], [1.0, 1.1], [2.0, 2.1]]> : tensor<3x2xf32>} : () -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -1650,6 +2041,26 @@ func @test_concat_1(%arg0 : tensor<5x5x1x32xf32>, %arg1 : tensor<5x5x3x32xf32>,
 
 // -----
 
+func @test_concat_in_place(%arg0 : tensor<1x2x4xf32>, %arg1 : tensor<1x3x4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Relu"(%arg0) : (tensor<1x2x4xf32>) -> tensor<1x2x4xf32>
+  %1 = "onnx.Relu"(%arg1) : (tensor<1x3x4xf32>) -> tensor<1x3x4xf32>
+  %2 = "onnx.Concat"(%0, %1) { axis = 1 : si64} : (tensor<1x2x4xf32>, tensor<1x3x4xf32>)  -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_concat_in_place
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x5x4xf32>
+  // CHECK-DAG: [[VIEW1:%.+]] = "krnl.reshape"([[RES]]) {offset = 8 : i64} : (memref<1x5x4xf32>) -> memref<1x3x4xf32>
+  // CHECK-DAG: [[VIEW0:%.+]] = "krnl.reshape"([[RES]]) {offset = 0 : i64} : (memref<1x5x4xf32>) -> memref<1x2x4xf32>
+  // CHECK-NOT: alloc
+  // CHECK: affine.store {{.*}}, [[VIEW0]][{{.*}}] : memref<1x2x4xf32>
+  // CHECK: affine.store {{.*}}, [[VIEW1]][{{.*}}] : memref<1x3x4xf32>
+  // CHECK-NOT: krnl.iterate
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RES]] : memref<1x5x4xf32>
+}
+
+// -----
+
 func @test_pool_general_computation(%arg0 : tensor<1x3x32x32xf32>) -> tensor<*xf32> {
   %0 = "onnx.AveragePool"(%arg0) {auto_pad = "NOTSET", kernel_shape = [2, 2]} : (tensor<1x3x32x32xf32>) -> tensor<*xf32>
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -1779,6 +2190,84 @@ func @test_maxpool_pooling_operation(%arg0 : tensor<1x3x32x32xf32>) -> tensor<*x
 
 // -----
 
+/// Average pools whose kernel has more elements than rows and columns are
+/// computed as sums over the rows of the windows, then over their columns.
+func @test_averagepool_separable(%arg0 : tensor<1x3x32x32xf32>) -> tensor<*xf32> {
+  %0 = "onnx.AveragePool"(%arg0) {auto_pad = "NOTSET", kernel_shape = [3, 3]} : (tensor<1x3x32x32xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_averagepool_separable
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<1x3x30x30xf32>
+  // CHECK-DAG: [[ROW_SUMS:%.+]] = alloc() : memref<1x3x32x30xf32>
+
+  // CHECK: [[ROW_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.parallel [[ROW_LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate([[ROW_LOOPS]]#0, [[ROW_LOOPS]]#1, [[ROW_LOOPS]]#2, [[ROW_LOOPS]]#3) with ([[ROW_LOOPS]]#0 -> [[N:%.+]] = 0 to 1, [[ROW_LOOPS]]#1 -> [[C:%.+]] = 0 to 3, [[ROW_LOOPS]]#2 -> [[H:%.+]] = 0 to 32, [[ROW_LOOPS]]#3 -> [[WO:%.+]] = 0 to 30) {
+  // CHECK:   affine.store {{.*}}, [[ROW_SUMS]]{{\[}}[[N]], [[C]], [[H]], [[WO]]{{\]}} : memref<1x3x32x30xf32>
+  // CHECK:   [[COL_START:%.+]] = affine.max #{{.*}}([[WO]])
+  // CHECK:   [[COL_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[COL_LOOP]]) with ([[COL_LOOP]] -> [[KW:%.+]] = 0 to min #{{.*}}([[WO]])) {
+  // CHECK:     [[WI:%.+]] = addi [[KW]], [[COL_START]] : index
+  // CHECK:     [[INPUT:%.+]] = load %arg0{{\[}}[[N]], [[C]], [[H]], [[WI]]{{\]}} : memref<1x3x32x32xf32>
+  // CHECK:     [[PARTIAL:%.+]] = affine.load [[ROW_SUMS]]{{\[}}[[N]], [[C]], [[H]], [[WO]]{{\]}} : memref<1x3x32x30xf32>
+  // CHECK:     [[SUM:%.+]] = addf [[PARTIAL]], [[INPUT]] : f32
+  // CHECK:     affine.store [[SUM]], [[ROW_SUMS]]{{\[}}[[N]], [[C]], [[H]], [[WO]]{{\]}} : memref<1x3x32x30xf32>
+  // CHECK:   }
+  // CHECK: }
+
+  // CHECK: [[OUTPUT_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.parallel [[OUTPUT_LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate([[OUTPUT_LOOPS]]#0, [[OUTPUT_LOOPS]]#1, [[OUTPUT_LOOPS]]#2, [[OUTPUT_LOOPS]]#3) with ([[OUTPUT_LOOPS]]#0 -> [[N:%.+]] = 0 to 1, [[OUTPUT_LOOPS]]#1 -> [[C:%.+]] = 0 to 3, [[OUTPUT_LOOPS]]#2 -> [[HO:%.+]] = 0 to 30, [[OUTPUT_LOOPS]]#3 -> [[WO:%.+]] = 0 to 30) {
+  // CHECK:   [[ROW_START:%.+]] = affine.max #{{.*}}([[HO]])
+  // CHECK:   [[ROW_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[ROW_LOOP]]) with ([[ROW_LOOP]] -> [[KH:%.+]] = 0 to min #{{.*}}([[HO]])) {
+  // CHECK:     [[HI:%.+]] = addi [[KH]], [[ROW_START]] : index
+  // CHECK:     [[ROW_SUM:%.+]] = load [[ROW_SUMS]]{{\[}}[[N]], [[C]], [[HI]], [[WO]]{{\]}} : memref<1x3x32x30xf32>
+  // CHECK:     [[PARTIAL:%.+]] = affine.load [[RES]]{{\[}}[[N]], [[C]], [[HO]], [[WO]]{{\]}} : memref<1x3x30x30xf32>
+  // CHECK:     [[SUM:%.+]] = addf [[PARTIAL]], [[ROW_SUM]] : f32
+  // CHECK:     affine.store [[SUM]], [[RES]]{{\[}}[[N]], [[C]], [[HO]], [[WO]]{{\]}} : memref<1x3x30x30xf32>
+  // CHECK:   }
+  // CHECK:   [[NUMERATOR:%.+]] = affine.load [[RES]]{{\[}}[[N]], [[C]], [[HO]], [[WO]]{{\]}} : memref<1x3x30x30xf32>
+  // CHECK:   [[ROWS:%.+]] = affine.min #{{.*}}([[HO]])
+  // CHECK:   [[COLS:%.+]] = affine.min #{{.*}}([[WO]])
+  // CHECK:   [[COUNT:%.+]] = muli [[ROWS]], [[COLS]] : index
+  // CHECK:   [[AVERAGE:%.+]] = divf [[NUMERATOR]], {{.*}} : f32
+  // CHECK:   affine.store [[AVERAGE]], [[RES]]{{\[}}[[N]], [[C]], [[HO]], [[WO]]{{\]}} : memref<1x3x30x30xf32>
+  // CHECK: }
+  // CHECK: dealloc [[ROW_SUMS]] : memref<1x3x32x30xf32>
+  // CHECK: return [[RES]] : memref<1x3x30x30xf32>
+}
+
+// -----
+
+func @test_global_averagepool(%arg0 : tensor<1x3x5x4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.GlobalAveragePool"(%arg0) : (tensor<1x3x5x4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_global_averagepool
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x3x1x1xf32>
+  // CHECK: [[NUM_ELEMENTS:%.+]] = constant 2.000000e+01 : f32
+  // CHECK: [[INV_NUM_ELEMENTS:%.+]] = divf {{.*}}, [[NUM_ELEMENTS]] : f32
+  // CHECK: [[CHANNEL_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[CHANNEL_LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate([[CHANNEL_LOOPS]]#0, [[CHANNEL_LOOPS]]#1) with ([[CHANNEL_LOOPS]]#0 -> [[N:%.+]] = 0 to 1, [[CHANNEL_LOOPS]]#1 -> [[C:%.+]] = 0 to 3) {
+  // CHECK:   affine.store {{.*}}, [[RES]]{{\[}}[[N]], [[C]], 0, 0{{\]}} : memref<1x3x1x1xf32>
+  // CHECK:   [[SPATIAL_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:   krnl.iterate([[SPATIAL_LOOPS]]#0, [[SPATIAL_LOOPS]]#1) with ([[SPATIAL_LOOPS]]#0 -> [[H:%.+]] = 0 to 5, [[SPATIAL_LOOPS]]#1 -> [[W:%.+]] = 0 to 4) {
+  // CHECK:     [[INPUT:%.+]] = affine.load %arg0{{\[}}[[N]], [[C]], [[H]], [[W]]{{\]}} : memref<1x3x5x4xf32>
+  // CHECK:     [[PARTIAL:%.+]] = affine.load [[RES]]{{\[}}[[N]], [[C]], 0, 0{{\]}} : memref<1x3x1x1xf32>
+  // CHECK:     [[SUM:%.+]] = addf [[PARTIAL]], [[INPUT]] : f32
+  // CHECK:     affine.store [[SUM]], [[RES]]{{\[}}[[N]], [[C]], 0, 0{{\]}} : memref<1x3x1x1xf32>
+  // CHECK:   }
+  // CHECK:   [[TOTAL:%.+]] = affine.load [[RES]]{{\[}}[[N]], [[C]], 0, 0{{\]}} : memref<1x3x1x1xf32>
+  // CHECK:   [[AVERAGE:%.+]] = mulf [[TOTAL]], [[INV_NUM_ELEMENTS]] : f32
+  // CHECK:   affine.store [[AVERAGE]], [[RES]]{{\[}}[[N]], [[C]], 0, 0{{\]}} : memref<1x3x1x1xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<1x3x1x1xf32>
+}
+
+// -----
+
 /// Check GRU with three required inputs (X, W, R). The optional inputs are default.
 /// Also check the equation for 'ht' when linear_before_reset = 0 (default)
 func @test_gru_general_computation(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x9x2xf32>, %arg2: tensor<1x9x3xf32>) -> tensor<*xf32> {
@@ -1787,7 +2276,10 @@ func @test_gru_general_computation(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x9x2
   return %Y_h : tensor<*xf32>
 
   // CHECK-LABEL: test_gru_general_computation
-  // CHECK: [[RES:%.+]] = alloc() : memref<1x3x3xf32>
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<1x3x3xf32>
+  // CHECK-DAG: [[XW:%.+]] = alloc() : memref<1x4x3x9xf32>
+  // CHECK-DAG: [[HR:%.+]] = alloc() : memref<1x3x9xf32>
+  // CHECK-DAG: [[RH:%.+]] = alloc() : memref<1x3x3xf32>
 
   /// Check initialize loop.
   // CHECK: [[INITIAL_VAL:%.+]] = constant 0.000000e+00 : f32
@@ -1796,160 +2288,66 @@ func @test_gru_general_computation(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x9x2
   // CHECK:   affine.store [[INITIAL_VAL]], [[RES]][%arg3, %arg4, %arg5] : memref<1x3x3xf32>
   // CHECK: }
 
+  /// Check the projection of the input of all the timesteps.
+  // CHECK: [[XW_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.parallel [[XW_LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate([[XW_LOOPS]]#0, [[XW_LOOPS]]#1, [[XW_LOOPS]]#2, [[XW_LOOPS]]#3) with ([[XW_LOOPS]]#0 -> %arg3 = 0 to 1, [[XW_LOOPS]]#1 -> %arg4 = 0 to 4, [[XW_LOOPS]]#2 -> %arg5 = 0 to 3, [[XW_LOOPS]]#3 -> %arg6 = 0 to 9) {
+  // CHECK:   affine.store {{.*}}, [[XW]][%arg3, %arg4, %arg5, %arg6] : memref<1x4x3x9xf32>
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg7 = 0 to 2) {
+  // CHECK:     [[Xt_LOAD:%.+]] = affine.load %arg0[%arg4, %arg5, %arg7] : memref<4x3x2xf32>
+  // CHECK:     [[W_LOAD:%.+]] = affine.load %arg1[%arg3, %arg6, %arg7] : memref<1x9x2xf32>
+  // CHECK:     [[XW_MUL:%.+]] = mulf [[Xt_LOAD]], [[W_LOAD]] : f32
+  // CHECK:     [[XW_LOAD:%.+]] = affine.load [[XW]][%arg3, %arg4, %arg5, %arg6] : memref<1x4x3x9xf32>
+  // CHECK:     [[XW_ADD:%.+]] = addf [[XW_LOAD]], [[XW_MUL]] : f32
+  // CHECK:     affine.store [[XW_ADD]], [[XW]][%arg3, %arg4, %arg5, %arg6] : memref<1x4x3x9xf32>
+  // CHECK:   }
+  // CHECK: }
+
   /// Check main loop.
   // CHECK: [[SEQUENCE_LOOPS:%.+]] = krnl.define_loops 1
   // CHECK: krnl.iterate([[SEQUENCE_LOOPS]]) with ([[SEQUENCE_LOOPS]] -> %arg3 = 0 to 4) {
   // CHECK:   [[ZERO_INDEX:%.+]] = constant 0 : index
-  // CHECK:   [[INDEX_3:%.+]] = constant 3 : index
-  // CHECK:   [[INDEX_0:%.+]] = constant 0 : index
-  // CHECK:   [[INDEX_1:%.+]] = constant 1 : index
-  // CHECK:   [[INDEX_2:%.+]] = constant 2 : index
-  // CHECK:   [[DATA_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK:   krnl.iterate([[DATA_LOOPS]]#0, [[DATA_LOOPS]]#1) with ([[DATA_LOOPS]]#0 -> %arg4 = 0 to 3, [[DATA_LOOPS]]#1 -> %arg5 = 0 to 3) {
-  // CHECK:     [[ht:%.+]] = alloc() : memref<f32>
-  // CHECK:     [[rt:%.+]] = alloc() : memref<f32>
-  // CHECK:     [[zt:%.+]] = alloc() : memref<f32>
 
-  // CHECK:     [[PREVIOUS_Ht:%.+]] = affine.load [[RES]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x3xf32>
+  /// Ht-1*(R[zr]^T) for the update and reset gates.
+  // CHECK:   [[HR_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:   krnl.parallel [[HR_LOOPS]]#0 : !krnl.loop
+  // CHECK:   krnl.parallel [[HR_LOOPS]]#1 : !krnl.loop
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 3, {{.*}} -> %arg5 = 0 to 6) {
+  // CHECK:     krnl.iterate({{.*}}) with ({{.*}} -> %arg6 = 0 to 3) {
+  // CHECK:       [[Ht1_LOAD:%.+]] = affine.load [[RES]]{{\[}}[[ZERO_INDEX]], %arg4, %arg6] : memref<1x3x3xf32>
+  // CHECK:       [[R_LOAD:%.+]] = affine.load %arg2{{\[}}[[ZERO_INDEX]], %arg5, %arg6] : memref<1x9x3xf32>
+  // CHECK:       [[HR_MUL:%.+]] = mulf [[Ht1_LOAD]], [[R_LOAD]] : f32
+  // CHECK:       affine.store {{.*}}, [[HR]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x9xf32>
+  // CHECK:     }
+  // CHECK:   }
 
-  // CHECK:     [[INITIAL_VAL_0:%.+]] = constant 0.000000e+00 : f32
-  // CHECK:     [[XWZt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[XWZt]][] : memref<f32>
-  // CHECK:     [[HRZt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[HRZt]][] : memref<f32>
-  // CHECK:     [[XWRt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[XWRt]][] : memref<f32>
-  // CHECK:     [[HRRt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[HRRt]][] : memref<f32>
-  // CHECK:     [[XWHt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[XWHt]][] : memref<f32>
-  // CHECK:     [[HRHt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[HRHt]][] : memref<f32>
+  /// rt (.) Ht-1
+  // CHECK:   [[RESET_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:   krnl.parallel [[RESET_LOOPS]]#0 : !krnl.loop
+  // CHECK:   krnl.parallel [[RESET_LOOPS]]#1 : !krnl.loop
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 3, {{.*}} -> %arg5 = 0 to 3) {
+  // CHECK:     affine.load [[XW]]{{\[}}[[ZERO_INDEX]], %arg3, %arg4, {{.*}}] : memref<1x4x3x9xf32>
+  // CHECK:     affine.load [[HR]]{{\[}}[[ZERO_INDEX]], %arg4, {{.*}}] : memref<1x3x9xf32>
+  // CHECK-NOT: alloc
+  // CHECK:     exp {{.*}} : f32
+  // CHECK:     affine.store {{.*}}, [[RH]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x3xf32>
+  // CHECK:   }
 
-  // CHECK:     [[REDUCTION_LOOPS:%.+]] = krnl.define_loops 1
-  // CHECK:     krnl.iterate([[REDUCTION_LOOPS]]) with ([[REDUCTION_LOOPS]] -> %arg6 = 0 to 2) {
-  // CHECK:       [[BIAS_MAP_FOR_Z:%.+]] = affine.apply {{.*}}(%arg5){{\[}}[[INDEX_0]], [[INDEX_3]]]
-  // CHECK:       [[BIAS_MAP_FOR_R:%.+]] = affine.apply {{.*}}(%arg5){{\[}}[[INDEX_1]], [[INDEX_3]]]
-  // CHECK:       [[BIAS_MAP_FOR_H:%.+]] = affine.apply {{.*}}(%arg5){{\[}}[[INDEX_2]], [[INDEX_3]]]
-  // CHECK:       [[Xt:%.+]] = affine.load %arg0[%arg3, %arg4, %arg6] : memref<4x3x2xf32>
-
-  /// compute Xt*(Wz^T)
-  // CHECK:       [[WZt:%.+]] = affine.load %arg1{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_Z]], %arg6] : memref<1x9x2xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[Xt]], [[WZt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[XWZt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[XWZt]][] : memref<f32>
-
-  /// compute Ht-1*(Rz^T)
-  // CHECK:       [[RZt:%.+]] = affine.load %arg2{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_Z]], %arg6] : memref<1x9x3xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[PREVIOUS_Ht]], [[RZt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[HRZt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[HRZt]][] : memref<f32>
-
-  /// compute Xt*(Wr^T)
-  // CHECK:       [[WRt:%.+]] = affine.load %arg1{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_R]], %arg6] : memref<1x9x2xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[Xt]], [[WRt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[XWRt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[XWRt]][] : memref<f32>
-
-  /// compute Ht-1*(Rr^T)
-  // CHECK:       [[RRt:%.+]] = affine.load %arg2{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_R]], %arg6] : memref<1x9x3xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[PREVIOUS_Ht]], [[RRt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[HRRt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[HRRt]][] : memref<f32>
-
-  /// compute Xt*(Wh^T)
-  // CHECK:       [[WHt:%.+]] = affine.load %arg1{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_H]], %arg6] : memref<1x9x2xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[Xt]], [[WHt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[XWHt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[XWHt]][] : memref<f32>
+  /// (rt (.) Ht-1)*(Rh^T)
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 3, {{.*}} -> %arg5 = 6 to 9) {
+  // CHECK:     krnl.iterate({{.*}}) with ({{.*}} -> %arg6 = 0 to 3) {
+  // CHECK:       affine.load [[RH]]{{\[}}[[ZERO_INDEX]], %arg4, %arg6] : memref<1x3x3xf32>
   // CHECK:     }
+  // CHECK:   }
 
-  /// compute zt = f(Xt*(Wz^T) + Ht-1*(Rz^T) + Wbz + Rbz)
-  // CHECK:     [[LOAD_XWZt:%.+]] = affine.load [[XWZt]][] : memref<f32>
-  // CHECK:     [[LOAD_HRZt:%.+]] = affine.load [[HRZt]][] : memref<f32>
-  // CHECK:     [[ADD:%.+]] = addf [[LOAD_XWZt]], [[LOAD_HRZt]] : f32
-  /// apply activation f = sigmoid
-  // CHECK:     {{.*}} = alloc() : memref<f32>
-  // CHECK:     affine.store [[ADD]], {{.*}}[] : memref<f32>
-  // CHECK:     {{.*}} = affine.load {{.*}}[] : memref<f32>
-  // CHECK:     {{.*}} = constant 0.000000e+00 : f32
-  // CHECK:     {{.*}} = constant 1.000000e+00 : f32
-  // CHECK:     {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = exp {{.*}} : f32
-  // CHECK:     {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:     affine.store {{.*}}, [[zt]][] : memref<f32>
-
-  /// compute rt = f(Xt*(Wr^T) + Ht-1*(Rr^T) + Wbr + Rbr)
-  // CHECK:     [[LOAD_zt:%.+]] = affine.load [[zt]][] : memref<f32>
-  // CHECK:     [[LOAD_XWRt:%.+]] = affine.load [[XWRt]][] : memref<f32>
-  // CHECK:     [[LOAD_HRRt:%.+]] = affine.load [[HRRt]][] : memref<f32>
-  // CHECK:     [[ADD:%.+]] = addf [[LOAD_XWRt]], [[LOAD_HRRt]] : f32
-  /// apply activation f = sigmoid
-  // CHECK:     {{.*}} = alloc() : memref<f32>
-  // CHECK:     affine.store [[ADD]], {{.*}}[] : memref<f32>
-  // CHECK:     {{.*}} = affine.load %28[] : memref<f32>
-  // CHECK:     {{.*}} = constant 0.000000e+00 : f32
-  // CHECK:     {{.*}} = constant 1.000000e+00 : f32
-  // CHECK:     {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = exp {{.*}} : f32
-  // CHECK:     {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:     affine.store {{.*}}, [[rt]][] : memref<f32>
-  // CHECK:     [[LOAD_rt:%.+]] = affine.load [[rt]][] : memref<f32>
-
-  /// compute  ht = g(Xt*(Wh^T) + (rt (.) Ht-1)*(Rh^T) + Rbh + Wbh) since linear_before_reset = 0 (default)
-  /// 'rt (.) Ht-1'
-  // CHECK:     [[LOAD_XWHt:%.+]] = affine.load [[XWHt]][] : memref<f32>
-  // CHECK:     [[MUL_rt_PREVIOUS_Ht:%.+]] = mulf [[LOAD_rt]], [[PREVIOUS_Ht]] : f32
-  /// '(rt (.) Ht-1)*(Rh^T)'
-  // CHECK:     [[REDUCTION_LOOPS_1:%.+]] = krnl.define_loops 1
-  // CHECK:     krnl.iterate([[REDUCTION_LOOPS_1]]) with ([[REDUCTION_LOOPS_1]] -> %arg6 = 0 to 2) {
-  // CHECK:       [[BIAS_MAP_FOR_H:%.+]] = affine.apply {{.*}}(%arg5){{\[}}[[INDEX_2]], [[INDEX_3]]]
-  // CHECK:       [[LOAD_RHt:%.+]] = affine.load %arg2{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_H]], %arg6] : memref<1x9x3xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[MUL_rt_PREVIOUS_Ht]], [[LOAD_RHt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[HRHt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[HRHt]][] : memref<f32>
-  // CHECK:     }
-  // CHECK:     [[LOAD_HRHt:%.+]] = affine.load [[HRHt]][] : memref<f32>
-  // CHECK:     [[ADD:%.+]] = addf [[LOAD_XWHt]], [[LOAD_HRHt]] : f32
-  /// apply activation g = tanh
-  // CHECK:     {{.*}} = alloc() : memref<f32>
-  // CHECK:     affine.store [[ADD]], {{.*}}[] : memref<f32>
-  // CHECK:     {{.*}} = affine.load {{.*}}[] : memref<f32>
-  // CHECK:     %cst_8 = constant 0.000000e+00 : f32
-  // CHECK:     {{.*}} = subf %cst_8, {{.*}} : f32
-  // CHECK:     {{.*}} = exp {{.*}} : f32
-  // CHECK:     {{.*}} = exp {{.*}} : f32
-  // CHECK:     {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:     affine.store {{.*}}, [[ht]][] : memref<f32>
-  // CHECK:     [[LOAD_ht:%.+]] = affine.load [[ht]][] : memref<f32>
-
-  /// compute  Ht = (1 - zt) (.) ht + zt (.) Ht-1
-  // CHECK:     [[ONE:%.+]] = constant 1.000000e+00 : f32
-  // CHECK:     [[SUB:%.+]] = subf [[ONE]], [[LOAD_zt]] : f32
-  // CHECK:     [[MUL:%.+]] = mulf [[SUB]], [[LOAD_ht]] : f32
-  // CHECK:     [[MUL_1:%.+]] = mulf [[LOAD_zt]], [[PREVIOUS_Ht]] : f32
-  // CHECK:     [[ADD:%.+]] = addf [[MUL]], [[MUL_1]] : f32
-  // CHECK:     affine.store [[ADD]], [[RES]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x3xf32>
-
-  // CHECK:     dealloc [[XWZt]] : memref<f32>
-  // CHECK:     dealloc [[XWRt]] : memref<f32>
-  // CHECK:     dealloc [[XWHt]] : memref<f32>
-  // CHECK:     dealloc [[HRZt]] : memref<f32>
-  // CHECK:     dealloc [[HRRt]] : memref<f32>
-  // CHECK:     dealloc [[HRHt]] : memref<f32>
-  // CHECK:     dealloc [[zt]] : memref<f32>
-  // CHECK:     dealloc [[rt]] : memref<f32>
-  // CHECK:     dealloc [[ht]] : memref<f32>
+  /// Ht
+  // CHECK:   [[STATE_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:   krnl.parallel [[STATE_LOOPS]]#0 : !krnl.loop
+  // CHECK:   krnl.parallel [[STATE_LOOPS]]#1 : !krnl.loop
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 3, {{.*}} -> %arg5 = 0 to 3) {
+  // CHECK:     exp {{.*}} : f32
+  // CHECK:     exp {{.*}} : f32
+  // CHECK:     affine.store {{.*}}, [[RES]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x3xf32>
   // CHECK:   }
   // CHECK: }
   // CHECK: return [[RES]] : memref<1x3x3xf32>
@@ -1965,167 +2363,31 @@ func @test_gru_linear_before_reset(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x9x2
   return %Y_h : tensor<*xf32>
 
   // CHECK-LABEL: test_gru_linear_before_reset
-  // CHECK: [[RES:%.+]] = alloc() : memref<1x3x3xf32>
-
-  /// Check initialize loop.
-  // CHECK: [[INITIAL_VAL:%.+]] = constant 0.000000e+00 : f32
-  // CHECK: [[DEF_LOOPS_INIT:%.+]]:3 = krnl.define_loops 3
-  // CHECK: krnl.iterate([[DEF_LOOPS_INIT]]#0, [[DEF_LOOPS_INIT]]#1, [[DEF_LOOPS_INIT]]#2) with ([[DEF_LOOPS_INIT]]#0 -> %arg3 = 0 to 1, [[DEF_LOOPS_INIT]]#1 -> %arg4 = 0 to 3, [[DEF_LOOPS_INIT]]#2 -> %arg5 = 0 to 3) {
-  // CHECK:   affine.store [[INITIAL_VAL]], [[RES]][%arg3, %arg4, %arg5] : memref<1x3x3xf32>
-  // CHECK: }
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<1x3x3xf32>
+  // CHECK-DAG: [[XW:%.+]] = alloc() : memref<1x4x3x9xf32>
+  // CHECK-DAG: [[HR:%.+]] = alloc() : memref<1x3x9xf32>
 
   /// Check main loop.
   // CHECK: [[SEQUENCE_LOOPS:%.+]] = krnl.define_loops 1
   // CHECK: krnl.iterate([[SEQUENCE_LOOPS]]) with ([[SEQUENCE_LOOPS]] -> %arg3 = 0 to 4) {
-  // CHECK:   [[ZERO_INDEX:%.+]] = constant 0 : index
-  // CHECK:   [[INDEX_3:%.+]] = constant 3 : index
-  // CHECK:   [[INDEX_0:%.+]] = constant 0 : index
-  // CHECK:   [[INDEX_1:%.+]] = constant 1 : index
-  // CHECK:   [[INDEX_2:%.+]] = constant 2 : index
-  // CHECK:   [[DATA_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK:   krnl.iterate([[DATA_LOOPS]]#0, [[DATA_LOOPS]]#1) with ([[DATA_LOOPS]]#0 -> %arg4 = 0 to 3, [[DATA_LOOPS]]#1 -> %arg5 = 0 to 3) {
-  // CHECK:     [[ht:%.+]] = alloc() : memref<f32>
-  // CHECK:     [[rt:%.+]] = alloc() : memref<f32>
-  // CHECK:     [[zt:%.+]] = alloc() : memref<f32>
 
-  // CHECK:     [[PREVIOUS_Ht:%.+]] = affine.load [[RES]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x3xf32>
-
-  // CHECK:     [[INITIAL_VAL_0:%.+]] = constant 0.000000e+00 : f32
-  // CHECK:     [[XWZt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[XWZt]][] : memref<f32>
-  // CHECK:     [[HRZt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[HRZt]][] : memref<f32>
-  // CHECK:     [[XWRt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[XWRt]][] : memref<f32>
-  // CHECK:     [[HRRt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[HRRt]][] : memref<f32>
-  // CHECK:     [[XWHt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[XWHt]][] : memref<f32>
-  // CHECK:     [[HRHt:%.+]] = alloc() : memref<f32>
-  // CHECK:     affine.store [[INITIAL_VAL_0]], [[HRHt]][] : memref<f32>
-
-  // CHECK:     [[REDUCTION_LOOPS:%.+]] = krnl.define_loops 1
-  // CHECK:     krnl.iterate([[REDUCTION_LOOPS]]) with ([[REDUCTION_LOOPS]] -> %arg6 = 0 to 2) {
-  // CHECK:       [[BIAS_MAP_FOR_Z:%.+]] = affine.apply {{.*}}(%arg5){{\[}}[[INDEX_0]], [[INDEX_3]]]
-  // CHECK:       [[BIAS_MAP_FOR_R:%.+]] = affine.apply {{.*}}(%arg5){{\[}}[[INDEX_1]], [[INDEX_3]]]
-  // CHECK:       [[BIAS_MAP_FOR_H:%.+]] = affine.apply {{.*}}(%arg5){{\[}}[[INDEX_2]], [[INDEX_3]]]
-  // CHECK:       [[Xt:%.+]] = affine.load %arg0[%arg3, %arg4, %arg6] : memref<4x3x2xf32>
-
-  /// compute Xt*(Wz^T)
-  // CHECK:       [[WZt:%.+]] = affine.load %arg1{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_Z]], %arg6] : memref<1x9x2xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[Xt]], [[WZt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[XWZt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[XWZt]][] : memref<f32>
-
-  /// compute Ht-1*(Rz^T)
-  // CHECK:       [[RZt:%.+]] = affine.load %arg2{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_Z]], %arg6] : memref<1x9x3xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[PREVIOUS_Ht]], [[RZt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[HRZt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[HRZt]][] : memref<f32>
-
-  /// compute Xt*(Wr^T)
-  // CHECK:       [[WRt:%.+]] = affine.load %arg1{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_R]], %arg6] : memref<1x9x2xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[Xt]], [[WRt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[XWRt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[XWRt]][] : memref<f32>
-
-  /// compute Ht-1*(Rr^T)
-  // CHECK:       [[RRt:%.+]] = affine.load %arg2{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_R]], %arg6] : memref<1x9x3xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[PREVIOUS_Ht]], [[RRt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[HRRt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[HRRt]][] : memref<f32>
-
-  /// compute Xt*(Wh^T)
-  // CHECK:       [[WHt:%.+]] = affine.load %arg1{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_H]], %arg6] : memref<1x9x2xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[Xt]], [[WHt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[XWHt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[XWHt]][] : memref<f32>
-
-  /// compute Ht-1*(Rh^T)
-  // CHECK:       [[RHt:%.+]] = affine.load %arg2{{\[}}[[ZERO_INDEX]], [[BIAS_MAP_FOR_H]], %arg6] : memref<1x9x3xf32>
-  // CHECK:       [[MUL:%.+]] = mulf [[PREVIOUS_Ht]], [[RHt]] : f32
-  // CHECK:       [[LOAD:%.+]] = affine.load [[HRHt]][] : memref<f32>
-  // CHECK:       [[ADD:%.+]] = addf [[LOAD]], [[MUL]] : f32
-  // CHECK:       affine.store [[ADD]], [[HRHt]][] : memref<f32>
-  // CHECK:     }
+  /// Ht-1*(R[zrh]^T) for the three gates at once.
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 3, {{.*}} -> %arg5 = 0 to 9) {
+  // CHECK:     affine.store {{.*}}, [[HR]][{{.*}}, %arg4, %arg5] : memref<1x3x9xf32>
+  // CHECK:   }
 
-  /// compute zt = f(Xt*(Wz^T) + Ht-1*(Rz^T) + Wbz + Rbz)
-  // CHECK:     [[LOAD_XWZt:%.+]] = affine.load [[XWZt]][] : memref<f32>
-  // CHECK:     [[LOAD_HRZt:%.+]] = affine.load [[HRZt]][] : memref<f32>
-  // CHECK:     [[ADD:%.+]] = addf [[LOAD_XWZt]], [[LOAD_HRZt]] : f32
-  /// apply activation f = sigmoid
-  // CHECK:     {{.*}} = alloc() : memref<f32>
-  // CHECK:     affine.store [[ADD]], {{.*}}[] : memref<f32>
-  // CHECK:     {{.*}} = affine.load {{.*}}[] : memref<f32>
-  // CHECK:     {{.*}} = constant 0.000000e+00 : f32
-  // CHECK:     {{.*}} = constant 1.000000e+00 : f32
-  // CHECK:     {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = exp {{.*}} : f32
-  // CHECK:     {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:     affine.store {{.*}}, [[zt]][] : memref<f32>
-
-  /// compute rt = f(Xt*(Wr^T) + Ht-1*(Rr^T) + Wbr + Rbr)
-  // CHECK:     [[LOAD_zt:%.+]] = affine.load [[zt]][] : memref<f32>
-  // CHECK:     [[LOAD_XWRt:%.+]] = affine.load [[XWRt]][] : memref<f32>
-  // CHECK:     [[LOAD_HRRt:%.+]] = affine.load [[HRRt]][] : memref<f32>
-  // CHECK:     [[ADD:%.+]] = addf [[LOAD_XWRt]], [[LOAD_HRRt]] : f32
-  /// apply activation f = sigmoid
-  // CHECK:     {{.*}} = alloc() : memref<f32>
-  // CHECK:     affine.store [[ADD]], {{.*}}[] : memref<f32>
-  // CHECK:     {{.*}} = affine.load %28[] : memref<f32>
-  // CHECK:     {{.*}} = constant 0.000000e+00 : f32
-  // CHECK:     {{.*}} = constant 1.000000e+00 : f32
-  // CHECK:     {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = exp {{.*}} : f32
-  // CHECK:     {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:     affine.store {{.*}}, [[rt]][] : memref<f32>
-  // CHECK:     [[LOAD_rt:%.+]] = affine.load [[rt]][] : memref<f32>
-
-  /// compute ht = g(Xt*(Wh^T) + (rt (.) (Ht-1*(Rh^T) + Rbh)) + Wbh) since linear_before_reset != 0
-  // CHECK:     [[LOAD_XWHt:%.+]] = affine.load [[XWHt]][] : memref<f32>
-  // CHECK:     [[LOAD_HRHt:%.+]] = affine.load [[HRHt]][] : memref<f32>
-  // CHECK:     [[MUL_rt_HRHt:%.+]] = mulf [[LOAD_rt]], [[LOAD_HRHt]] : f32
-  // CHECK:     [[ADD:%.+]] = addf [[LOAD_XWHt]], [[MUL_rt_HRHt]] : f32
-  /// apply activation g = tanh
-  // CHECK:     {{.*}} = alloc() : memref<f32>
-  // CHECK:     affine.store [[ADD]], {{.*}}[] : memref<f32>
-  // CHECK:     {{.*}} = affine.load {{.*}}[] : memref<f32>
-  // CHECK:     %cst_8 = constant 0.000000e+00 : f32
-  // CHECK:     {{.*}} = subf %cst_8, {{.*}} : f32
-  // CHECK:     {{.*}} = exp {{.*}} : f32
-  // CHECK:     {{.*}} = exp {{.*}} : f32
-  // CHECK:     {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:     {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:     affine.store {{.*}}, [[ht]][] : memref<f32>
-  // CHECK:     [[LOAD_ht:%.+]] = affine.load [[ht]][] : memref<f32>
-
-  /// compute  Ht = (1 - zt) (.) ht + zt (.) Ht-1
-  // CHECK:     [[ONE:%.+]] = constant 1.000000e+00 : f32
-  // CHECK:     [[SUB:%.+]] = subf [[ONE]], [[LOAD_zt]] : f32
-  // CHECK:     [[MUL:%.+]] = mulf [[SUB]], [[LOAD_ht]] : f32
-  // CHECK:     [[MUL_1:%.+]] = mulf [[LOAD_zt]], [[PREVIOUS_Ht]] : f32
-  // CHECK:     [[ADD:%.+]] = addf [[MUL]], [[MUL_1]] : f32
-  // CHECK:     affine.store [[ADD]], [[RES]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x3xf32>
-
-  // CHECK:     dealloc [[XWZt]] : memref<f32>
-  // CHECK:     dealloc [[XWRt]] : memref<f32>
-  // CHECK:     dealloc [[XWHt]] : memref<f32>
-  // CHECK:     dealloc [[HRZt]] : memref<f32>
-  // CHECK:     dealloc [[HRRt]] : memref<f32>
-  // CHECK:     dealloc [[HRHt]] : memref<f32>
-  // CHECK:     dealloc [[zt]] : memref<f32>
-  // CHECK:     dealloc [[rt]] : memref<f32>
-  // CHECK:     dealloc [[ht]] : memref<f32>
+  /// ht = g(Xt*(Wh^T) + (rt (.) (Ht-1*(Rh^T) + Rbh)) + Wbh)
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 3, {{.*}} -> %arg5 = 0 to 3) {
+  // CHECK:     affine.load [[XW]]{{.*}} : memref<1x4x3x9xf32>
+  // CHECK:     affine.load [[XW]]{{.*}} : memref<1x4x3x9xf32>
+  // CHECK:     [[XWh_LOAD:%.+]] = affine.load [[XW]]{{.*}} : memref<1x4x3x9xf32>
+  // CHECK-NEXT:     [[HRh_LOAD:%.+]] = affine.load [[HR]]{{.*}} : memref<1x3x9xf32>
+  // CHECK-NEXT:     [[RESET:%.+]] = mulf {{.*}}, [[HRh_LOAD]] : f32
+  // CHECK-NEXT:     {{.*}} = addf [[XWh_LOAD]], [[RESET]] : f32
+  // CHECK:     exp {{.*}} : f32
   // CHECK:   }
   // CHECK: }
+  // CHECK-NOT: dealloc {{.*}} : memref<1x3x3xf32>
   // CHECK: return [[RES]] : memref<1x3x3xf32>
 }
 
@@ -2139,20 +2401,17 @@ func @test_gru_with_bias(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x9x2xf32>, %ar
 
   // CHECK-LABEL: test_gru_with_bias
 
-  // CHECK: [[LOAD_WZ_BIAS:%.+]] = affine.load %arg3[{{.*}}, {{.*}}] : memref<1x18xf32>
-  // CHECK: {{.*}} = addf {{.*}}, [[LOAD_WZ_BIAS]] : f32
-  // CHECK: [[LOAD_RZ_BIAS:%.+]] = affine.load %arg3[{{.*}}, {{.*}}] : memref<1x18xf32>
-  // CHECK: {{.*}} = addf {{.*}}, [[LOAD_RZ_BIAS]] : f32
-
-  // CHECK: [[LOAD_WR_BIAS:%.+]] = affine.load %arg3[{{.*}}, {{.*}}] : memref<1x18xf32>
-  // CHECK: {{.*}} = addf {{.*}}, [[LOAD_WR_BIAS]] : f32
-  // CHECK: [[LOAD_RR_BIAS:%.+]] = affine.load %arg3[{{.*}}, {{.*}}] : memref<1x18xf32>
-  // CHECK: {{.*}} = addf {{.*}}, [[LOAD_RR_BIAS]] : f32
+  /// The biases are added to the projection of the input.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 1, {{.*}} -> %arg5 = 0 to 4, {{.*}} -> %arg6 = 0 to 3, {{.*}} -> %arg7 = 0 to 9) {
+  // CHECK:   [[LOAD_W_BIAS:%.+]] = affine.load %arg3[%arg4, %arg7] : memref<1x18xf32>
+  // CHECK:   [[LOAD_R_BIAS:%.+]] = affine.load %arg3{{\[}}%arg4, %arg7 + 9] : memref<1x18xf32>
+  // CHECK:   [[BIAS:%.+]] = addf [[LOAD_W_BIAS]], [[LOAD_R_BIAS]] : f32
+  // CHECK:   affine.store [[BIAS]], {{.*}}[%arg4, %arg5, %arg6, %arg7] : memref<1x4x3x9xf32>
 
-  // CHECK: [[LOAD_WH_BIAS:%.+]] = affine.load %arg3[{{.*}}, {{.*}}] : memref<1x18xf32>
-  // CHECK: {{.*}} = addf {{.*}}, [[LOAD_WH_BIAS]] : f32
-  // CHECK: [[LOAD_RH_BIAS:%.+]] = affine.load %arg3[{{.*}}, {{.*}}] : memref<1x18xf32>
-  // CHECK: {{.*}} = addf {{.*}}, [[LOAD_RH_BIAS]] : f32
+  /// No bias is loaded within the recurrence.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 4) {
+  // CHECK-NOT: memref<1x18xf32>
+  // CHECK: return
 }
 
 // -----
@@ -2165,9 +2424,10 @@ func @test_lstm_general_computation(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x12
   // CHECK-DAG: [[ACCESS_BY_OFFSET_MAP:#.+]] = affine_map<(d0)[s0, s1] -> (d0 + s0 * s1)>
   // CHECK-LABEL: @test_lstm_general_computation
 
-  // CHECK:  [[CELL_STATE:%.+]] = alloc() : memref<1x3x3xf32>
-  // CHECK:  [[HIDDEN_STATE:%.+]] = alloc() : memref<1x3x3xf32>
-  // CHECK:  {{.*}} = constant unit
+  // CHECK-DAG:  [[CELL_STATE:%.+]] = alloc() : memref<1x3x3xf32>
+  // CHECK-DAG:  [[HIDDEN_STATE:%.+]] = alloc() : memref<1x3x3xf32>
+  // CHECK-DAG:  [[XW:%.+]] = alloc() : memref<1x4x3x12xf32>
+  // CHECK-DAG:  [[HR:%.+]] = alloc() : memref<1x3x12xf32>
 
   // CHECK:  [[INITIAL_VALUE:%.+]] = constant 0.000000e+00 : f32
   // CHECK:  [[INITIALIZE_LOOPS:%.+]]:3 = krnl.define_loops 3
@@ -2176,205 +2436,87 @@ func @test_lstm_general_computation(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x12
   // CHECK:    affine.store [[INITIAL_VALUE]], [[CELL_STATE]][%arg3, %arg4, %arg5] : memref<1x3x3xf32>
   // CHECK:  }
 
+  /// Xt*(W[iofc]^T) for all the timesteps, ahead of the recurrence.
+  // CHECK:  [[XW_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK:  krnl.parallel [[XW_LOOPS]]#1 : !krnl.loop
+  // CHECK:  krnl.iterate([[XW_LOOPS]]#0, [[XW_LOOPS]]#1, [[XW_LOOPS]]#2, [[XW_LOOPS]]#3) with ([[XW_LOOPS]]#0 -> %arg3 = 0 to 1, [[XW_LOOPS]]#1 -> %arg4 = 0 to 4, [[XW_LOOPS]]#2 -> %arg5 = 0 to 3, [[XW_LOOPS]]#3 -> %arg6 = 0 to 12) {
+  // CHECK:    [[ZERO_FLOAT:%.+]] = constant 0.000000e+00 : f32
+  // CHECK:    affine.store [[ZERO_FLOAT]], [[XW]][%arg3, %arg4, %arg5, %arg6] : memref<1x4x3x12xf32>
+  // CHECK:    [[REDUCTION_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:    krnl.iterate([[REDUCTION_LOOPS]]) with ([[REDUCTION_LOOPS]] -> %arg7 = 0 to 2) {
+  // CHECK:      [[Xt_LOAD:%.+]] = affine.load %arg0[%arg4, %arg5, %arg7] : memref<4x3x2xf32>
+  // CHECK:      [[W_LOAD:%.+]] = affine.load %arg1[%arg3, %arg6, %arg7] : memref<1x12x2xf32>
+  // CHECK:      [[XW_MUL:%.+]] = mulf [[Xt_LOAD]], [[W_LOAD]] : f32
+  // CHECK:      [[XW_LOAD:%.+]] = affine.load [[XW]][%arg3, %arg4, %arg5, %arg6] : memref<1x4x3x12xf32>
+  // CHECK:      [[XW_ADD:%.+]] = addf [[XW_LOAD]], [[XW_MUL]] : f32
+  // CHECK:      affine.store [[XW_ADD]], [[XW]][%arg3, %arg4, %arg5, %arg6] : memref<1x4x3x12xf32>
+  // CHECK:    }
+  // CHECK:  }
+
   // CHECK:  [[SEQUENCE_LOOPS:%.+]] = krnl.define_loops 1
   // CHECK:  krnl.iterate([[SEQUENCE_LOOPS]]) with ([[SEQUENCE_LOOPS]] -> %arg3 = 0 to 4) {
-  // CHECK:    {{.*}} = constant 0 : index
-  // CHECK:    {{.*}} = constant 3 : index
-  // CHECK:    {{.*}} = constant 0 : index
-  // CHECK:    {{.*}} = constant 1 : index
-  // CHECK:    {{.*}} = constant 2 : index
-  // CHECK:    {{.*}} = constant 3 : index
-  // CHECK:    {{.*}} = constant 4 : index
-  // CHECK:    {{.*}} = constant 5 : index
-  // CHECK:    {{.*}} = constant 6 : index
-  // CHECK:    {{.*}} = constant 7 : index
-  // CHECK:    [[DATA_LOOPS:%.+]]:2 = krnl.define_loops 2
-  // CHECK:    krnl.iterate([[DATA_LOOPS]]#0, [[DATA_LOOPS]]#1) with ([[DATA_LOOPS]]#0 -> %arg4 = 0 to 3, [[DATA_LOOPS]]#1 -> %arg5 = 0 to 3) {
-  // CHECK:      [[hCt:%.+]] = alloc() : memref<f32>
-  // CHECK:      [[Ot:%.+]] = alloc() : memref<f32>
-  // CHECK:      [[ct:%.+]] = alloc() : memref<f32>
-  // CHECK:      [[Ft:%.+]] = alloc() : memref<f32>
-  // CHECK:      [[It:%.+]] = alloc() : memref<f32>
-  // CHECK:      [[Ht1_LOAD:%.+]] = affine.load [[HIDDEN_STATE]][%c0, %arg4, %arg5] : memref<1x3x3xf32>
-  // CHECK:      [[Ct1_LOAD:%.+]] = affine.load [[CELL_STATE]][%c0, %arg4, %arg5] : memref<1x3x3xf32>
-
+  // CHECK:    [[DIRECTION_IV:%.+]] = constant 0 : index
+  // CHECK:    [[HIDDEN_SIZE:%.+]] = constant 3 : index
+  // CHECK:    [[INDEX_0:%.+]] = constant 0 : index
+  // CHECK:    [[INDEX_1:%.+]] = constant 1 : index
+  // CHECK:    [[INDEX_2:%.+]] = constant 2 : index
+  // CHECK:    [[INDEX_3:%.+]] = constant 3 : index
+
+  /// Ht-1*(R[iofc]^T), the four gates in a single matrix multiplication.
+  // CHECK:    [[HR_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:    krnl.parallel [[HR_LOOPS]]#0 : !krnl.loop
+  // CHECK:    krnl.parallel [[HR_LOOPS]]#1 : !krnl.loop
+  // CHECK:    krnl.iterate([[HR_LOOPS]]#0, [[HR_LOOPS]]#1) with ([[HR_LOOPS]]#0 -> %arg4 = 0 to 3, [[HR_LOOPS]]#1 -> %arg5 = 0 to 12) {
   // CHECK:      [[ZERO_FLOAT:%.+]] = constant 0.000000e+00 : f32
-  // CHECK:      [[XtWi_GEMM:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[ZERO_FLOAT]], [[XtWi_GEMM]][] : memref<f32>
-  // CHECK:      [[Ht1Ri_GEMM:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[ZERO_FLOAT]], [[Ht1Ri_GEMM]][] : memref<f32>
-  // CHECK:      [[XtWo_GEMM:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[ZERO_FLOAT]], [[XtWo_GEMM]][] : memref<f32>
-  // CHECK:      [[Ht1Ro_GEMM:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[ZERO_FLOAT]], [[Ht1Ro_GEMM]][] : memref<f32>
-  // CHECK:      [[XtWf_GEMM:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[ZERO_FLOAT]], [[XtWf_GEMM]][] : memref<f32>
-  // CHECK:      [[Ht1Rf_GEMM:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[ZERO_FLOAT]], [[Ht1Rf_GEMM]][] : memref<f32>
-  // CHECK:      [[XtWc_GEMM:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[ZERO_FLOAT]], [[XtWc_GEMM]][] : memref<f32>
-  // CHECK:      [[Ht1Rc_GEMM:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[ZERO_FLOAT]], [[Ht1Rc_GEMM]][] : memref<f32>
-
+  // CHECK:      affine.store [[ZERO_FLOAT]], [[HR]]{{\[}}[[DIRECTION_IV]], %arg4, %arg5] : memref<1x3x12xf32>
   // CHECK:      [[REDUCTION_LOOPS:%.+]] = krnl.define_loops 1
-  // CHECK:      krnl.iterate([[REDUCTION_LOOPS]]) with ([[REDUCTION_LOOPS]] -> %arg6 = 0 to 2) {
-  // CHECK:        [[INPUT_HIDDEN_INDEX:%.+]] = affine.apply #{{.*}}(%arg5)[{{.*}}, %c3]
-  // CHECK:        [[OUTPUT_HIDDEN_INDEX:%.+]] = affine.apply #{{.*}}(%arg5)[{{.*}}, %c3]
-  // CHECK:        [[FORGET_HIDDEN_INDEX:%.+]] = affine.apply #{{.*}}(%arg5)[{{.*}}, %c3]
-  // CHECK:        [[CELL_HIDDEN_INDEX:%.+]] = affine.apply #{{.*}}(%arg5)[{{.*}}, %c3]
-  // CHECK:        [[Xt_LOAD:%.+]] = affine.load %arg0[%arg3, %arg4, %arg6] : memref<4x3x2xf32>
-
-  // CHECK:        [[Wi_LOAD:%.+]] = affine.load %arg1[%c0, [[INPUT_HIDDEN_INDEX]], %arg6] : memref<1x12x2xf32>
-  // CHECK:        {{.*}} = mulf [[Xt_LOAD]], [[Wi_LOAD]] : f32
-  // CHECK:        {{.*}} = affine.load [[XtWi_GEMM]][] : memref<f32>
-  // CHECK:        {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:        affine.store {{.*}}, [[XtWi_GEMM]][] : memref<f32>
-
-  // CHECK:        [[Ri_LOAD:%.+]] = affine.load %arg2[%c0, [[INPUT_HIDDEN_INDEX]], %arg6] : memref<1x12x3xf32>
-  // CHECK:        {{.*}} = mulf [[Ht1_LOAD]], [[Ri_LOAD]] : f32
-  // CHECK:        {{.*}} = affine.load [[Ht1Ri_GEMM]][] : memref<f32>
-  // CHECK:        {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:        affine.store {{.*}}, [[Ht1Ri_GEMM]][] : memref<f32>
-
-  // CHECK:        [[Wo_LOAD:%.+]] = affine.load %arg1[%c0, [[OUTPUT_HIDDEN_INDEX]], %arg6] : memref<1x12x2xf32>
-  // CHECK:        {{.*}} = mulf [[Xt_LOAD]], [[Wo_LOAD]] : f32
-  // CHECK:        {{.*}} = affine.load [[XtWo_GEMM]][] : memref<f32>
-  // CHECK:        {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:        affine.store {{.*}}, [[XtWo_GEMM]][] : memref<f32>
-
-  // CHECK:        [[Ro_LOAD:%.+]] = affine.load %arg2[%c0, [[OUTPUT_HIDDEN_INDEX]], %arg6] : memref<1x12x3xf32>
-  // CHECK:        {{.*}} = mulf [[Ht1_LOAD]], [[Ro_LOAD]] : f32
-  // CHECK:        {{.*}} = affine.load [[Ht1Ro_GEMM]][] : memref<f32>
-  // CHECK:        {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:        affine.store {{.*}}, [[Ht1Ro_GEMM]][] : memref<f32>
-
-  // CHECK:        [[Wf_LOAD:%.+]] = affine.load %arg1[%c0, [[FORGET_HIDDEN_INDEX]], %arg6] : memref<1x12x2xf32>
-  // CHECK:        {{.*}} = mulf [[Xt_LOAD]], [[Wf_LOAD]] : f32
-  // CHECK:        {{.*}} = affine.load [[XtWf_GEMM]][] : memref<f32>
-  // CHECK:        {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:        affine.store {{.*}}, [[XtWf_GEMM]][] : memref<f32>
-
-  // CHECK:        [[Rf_LOAD:%.+]] = affine.load %arg2[%c0, [[FORGET_HIDDEN_INDEX]], %arg6] : memref<1x12x3xf32>
-  // CHECK:        {{.*}} = mulf [[Ht1_LOAD]], [[Rf_LOAD]] : f32
-  // CHECK:        {{.*}} = affine.load [[Ht1Rf_GEMM]][] : memref<f32>
-  // CHECK:        {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:        affine.store {{.*}}, [[Ht1Rf_GEMM]][] : memref<f32>
-
-  // CHECK:        [[Wc_LOAD:%.+]] = affine.load %arg1[%c0, [[CELL_HIDDEN_INDEX]], %arg6] : memref<1x12x2xf32>
-  // CHECK:        {{.*}} = mulf [[Xt_LOAD]], [[Wc_LOAD]] : f32
-  // CHECK:        {{.*}} = affine.load [[XtWc_GEMM]][] : memref<f32>
-  // CHECK:        {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:        affine.store {{.*}}, [[XtWc_GEMM]][] : memref<f32>
-
-  // CHECK:        [[Rc_LOAD:%.+]] = affine.load %arg2[%c0, [[CELL_HIDDEN_INDEX]], %arg6] : memref<1x12x3xf32>
-  // CHECK:        {{.*}} = mulf [[Ht1_LOAD]], [[Rc_LOAD]] : f32
-  // CHECK:        {{.*}} = affine.load [[Ht1Rc_GEMM]][] : memref<f32>
-  // CHECK:        {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:        affine.store {{.*}}, [[Ht1Rc_GEMM]][] : memref<f32>
+  // CHECK:      krnl.iterate([[REDUCTION_LOOPS]]) with ([[REDUCTION_LOOPS]] -> %arg6 = 0 to 3) {
+  // CHECK:        [[Ht1_LOAD:%.+]] = affine.load [[HIDDEN_STATE]]{{\[}}[[DIRECTION_IV]], %arg4, %arg6] : memref<1x3x3xf32>
+  // CHECK:        [[R_LOAD:%.+]] = affine.load %arg2{{\[}}[[DIRECTION_IV]], %arg5, %arg6] : memref<1x12x3xf32>
+  // CHECK:        [[HR_MUL:%.+]] = mulf [[Ht1_LOAD]], [[R_LOAD]] : f32
+  // CHECK:        [[HR_LOAD:%.+]] = affine.load [[HR]]{{\[}}[[DIRECTION_IV]], %arg4, %arg5] : memref<1x3x12xf32>
+  // CHECK:        [[HR_ADD:%.+]] = addf [[HR_LOAD]], [[HR_MUL]] : f32
+  // CHECK:        affine.store [[HR_ADD]], [[HR]]{{\[}}[[DIRECTION_IV]], %arg4, %arg5] : memref<1x3x12xf32>
   // CHECK:      }
+  // CHECK:    }
 
-  // CHECK:      [[XtWi_LOAD:%.+]] = affine.load [[XtWi_GEMM]][] : memref<f32>
-  // CHECK:      [[Ht1Ri_LOAD:%.+]] = affine.load [[Ht1Ri_GEMM]][] : memref<f32>
-  // CHECK:      [[It_OUTPUT:%.+]] = addf [[XtWi_LOAD]], [[Ht1Ri_LOAD]] : f32
-
-  // CHECK:      [[SIGMOID_INPUT:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[It_OUTPUT]], [[SIGMOID_INPUT]][] : memref<f32>
-  // CHECK:      {{.*}} = affine.load [[SIGMOID_INPUT]][] : memref<f32>
-  // CHECK:      {{.*}} = constant 0.000000e+00 : f32
-  // CHECK:      {{.*}} = constant 1.000000e+00 : f32
-  // CHECK:      {{.*}} = subf {{.*}}, {{.*}}: f32
-  // CHECK:      {{.*}} = exp {{.*}} : f32
-  // CHECK:      {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:      {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:      affine.store {{.*}}, [[It]][] : memref<f32>
-  // CHECK:      [[It_LOAD:%.+]] = affine.load [[It]][] : memref<f32>
-
-  // CHECK:      [[XtWf_LOAD:%.+]] = affine.load [[XtWf_GEMM]][] : memref<f32>
-  // CHECK:      [[Ht1Rf_LOAD:%.+]] = affine.load [[Ht1Rf_GEMM]][] : memref<f32>
-  // CHECK:      [[Ft_OUTPUT:%.+]] = addf [[XtWf_LOAD]], [[Ht1Rf_LOAD]] : f32
-
-  // CHECK:      [[SIGMOID_FORGET:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[Ft_OUTPUT]], [[SIGMOID_FORGET]][] : memref<f32>
-  // CHECK:      {{.*}} = affine.load [[SIGMOID_FORGET]][] : memref<f32>
-  // CHECK:      {{.*}} = constant 0.000000e+00 : f32
-  // CHECK:      {{.*}} = constant 1.000000e+00 : f32
-  // CHECK:      {{.*}} = subf {{.*}}, {{.*}}: f32
-  // CHECK:      {{.*}} = exp {{.*}} : f32
-  // CHECK:      {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:      {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:      affine.store {{.*}}, [[Ft]][] : memref<f32>
-  // CHECK:      [[Ft_LOAD:%.+]] = affine.load [[Ft]][] : memref<f32>
-
-  // CHECK:      [[XtWc_LOAD:%.+]] = affine.load [[XtWc_GEMM]][] : memref<f32>
-  // CHECK:      [[Ht1Rc_LOAD:%.+]] = affine.load [[Ht1Rc_GEMM]][] : memref<f32>
-  // CHECK:      [[ct_OUTPUT:%.+]] = addf [[XtWc_LOAD]], [[Ht1Rc_LOAD]] : f32
-
-  // CHECK:      [[TANH_CELL:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[ct_OUTPUT]], [[TANH_CELL]][] : memref<f32>
-  // CHECK:      {{.*}} = affine.load [[TANH_CELL]][] : memref<f32>
-  // CHECK:      {{.*}} = constant 0.000000e+00 : f32
-  // CHECK:      {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:      {{.*}} = exp {{.*}} : f32
-  // CHECK:      {{.*}} = exp {{.*}} : f32
-  // CHECK:      {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:      {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:      {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:      affine.store {{.*}}, [[ct]][] : memref<f32>
-  // CHECK:      [[ct_LOAD:%.+]] = affine.load [[ct]][] : memref<f32>
-
-  // CHECK:      [[FtCt1:%.+]] = mulf [[Ft_LOAD]], [[Ct1_LOAD]] : f32
-  // CHECK:      [[Itct:%.+]] = mulf [[It_LOAD]], [[ct_LOAD]] : f32
-  // CHECK:      [[Ct:%.+]] = addf [[FtCt1]], [[Itct]] : f32
-  // CHECK:      affine.store [[Ct]], [[CELL_STATE]][%c0, %arg4, %arg5] : memref<1x3x3xf32>
-
-  // CHECK:      [[XtWo_LOAD:%.+]] = affine.load [[XtWo_GEMM]][] : memref<f32>
-  // CHECK:      [[Ht1Ro_LOAD:%.+]] = affine.load [[Ht1Ro_GEMM]][] : memref<f32>
-  // CHECK:      [[Ot_OUTPUT:%.+]] = addf [[XtWo_LOAD]], [[Ht1Ro_LOAD]] : f32
-
-  // CHECK:      [[SIGMOID_OUTPUT:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[Ot_OUTPUT]], [[SIGMOID_OUTPUT]][] : memref<f32>
-  // CHECK:      {{.*}} = affine.load [[SIGMOID_OUTPUT]][] : memref<f32>
-  // CHECK:      {{.*}} = constant 0.000000e+00 : f32
-  // CHECK:      {{.*}} = constant 1.000000e+00 : f32
-  // CHECK:      {{.*}} = subf {{.*}}, {{.*}}: f32
-  // CHECK:      {{.*}} = exp {{.*}} : f32
-  // CHECK:      {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:      {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:      affine.store {{.*}}, [[Ot]][] : memref<f32>
-  // CHECK:      [[Ot_LOAD:%.+]] = affine.load [[Ot]][] : memref<f32>
-
-  // CHECK:      [[TANH_HIDDEN:%.+]] = alloc() : memref<f32>
-  // CHECK:      affine.store [[Ct]], [[TANH_HIDDEN]][] : memref<f32>
-  // CHECK:      {{.*}} = affine.load [[TANH_HIDDEN]][] : memref<f32>
-  // CHECK:      {{.*}} = constant 0.000000e+00 : f32
-  // CHECK:      {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:      {{.*}} = exp {{.*}} : f32
-  // CHECK:      {{.*}} = exp {{.*}} : f32
-  // CHECK:      {{.*}} = subf {{.*}}, {{.*}} : f32
-  // CHECK:      {{.*}} = addf {{.*}}, {{.*}} : f32
-  // CHECK:      {{.*}} = divf {{.*}}, {{.*}} : f32
-  // CHECK:      affine.store {{.*}}, [[hCt]][] : memref<f32>
-  // CHECK:      [[hCt_LOAD:%.+]] = affine.load [[hCt]][] : memref<f32>
-
-  // CHECK:      [[Ht:%.+]] = mulf [[Ot_LOAD]], [[hCt_LOAD]] : f32
-  // CHECK:      affine.store [[Ht]], [[HIDDEN_STATE]][%c0, %arg4, %arg5] : memref<1x3x3xf32>
-
-  // CHECK:      dealloc [[XtWi_GEMM]] : memref<f32>
-  // CHECK:      dealloc [[XtWo_GEMM]] : memref<f32>
-  // CHECK:      dealloc [[XtWf_GEMM]] : memref<f32>
-  // CHECK:      dealloc [[XtWc_GEMM]] : memref<f32>
-  // CHECK:      dealloc [[Ht1Ri_GEMM]] : memref<f32>
-  // CHECK:      dealloc [[Ht1Ro_GEMM]] : memref<f32>
-  // CHECK:      dealloc [[Ht1Rf_GEMM]] : memref<f32>
-  // CHECK:      dealloc [[Ht1Rc_GEMM]] : memref<f32>
-  // CHECK:      dealloc [[It]] : memref<f32>
-  // CHECK:      dealloc [[Ft]] : memref<f32>
-  // CHECK:      dealloc [[ct]] : memref<f32>
-  // CHECK:      dealloc [[Ot]] : memref<f32>
-  // CHECK:      dealloc [[hCt]] : memref<f32>
+  // CHECK:    [[DATA_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK:    krnl.parallel [[DATA_LOOPS]]#0 : !krnl.loop
+  // CHECK:    krnl.parallel [[DATA_LOOPS]]#1 : !krnl.loop
+  // CHECK:    krnl.iterate([[DATA_LOOPS]]#0, [[DATA_LOOPS]]#1) with ([[DATA_LOOPS]]#0 -> %arg4 = 0 to 3, [[DATA_LOOPS]]#1 -> %arg5 = 0 to 3) {
+  // CHECK:      [[I_IV:%.+]] = affine.apply [[ACCESS_BY_OFFSET_MAP]](%arg5){{\[}}[[INDEX_0]], [[HIDDEN_SIZE]]{{\]}}
+  // CHECK:      [[O_IV:%.+]] = affine.apply [[ACCESS_BY_OFFSET_MAP]](%arg5){{\[}}[[INDEX_1]], [[HIDDEN_SIZE]]{{\]}}
+  // CHECK:      [[F_IV:%.+]] = affine.apply [[ACCESS_BY_OFFSET_MAP]](%arg5){{\[}}[[INDEX_2]], [[HIDDEN_SIZE]]{{\]}}
+  // CHECK:      [[C_IV:%.+]] = affine.apply [[ACCESS_BY_OFFSET_MAP]](%arg5){{\[}}[[INDEX_3]], [[HIDDEN_SIZE]]{{\]}}
+  // CHECK:      [[Ct1_LOAD:%.+]] = affine.load [[CELL_STATE]]{{\[}}[[DIRECTION_IV]], %arg4, %arg5] : memref<1x3x3xf32>
+
+  // CHECK:      [[XWi_LOAD:%.+]] = affine.load [[XW]]{{\[}}[[DIRECTION_IV]], %arg3, %arg4, [[I_IV]]{{\]}} : memref<1x4x3x12xf32>
+  // CHECK:      [[HRi_LOAD:%.+]] = affine.load [[HR]]{{\[}}[[DIRECTION_IV]], %arg4, [[I_IV]]{{\]}} : memref<1x3x12xf32>
+  // CHECK:      {{.*}} = addf [[XWi_LOAD]], [[HRi_LOAD]] : f32
+
+  // CHECK:      [[XWf_LOAD:%.+]] = affine.load [[XW]]{{\[}}[[DIRECTION_IV]], %arg3, %arg4, [[F_IV]]{{\]}} : memref<1x4x3x12xf32>
+  // CHECK:      [[HRf_LOAD:%.+]] = affine.load [[HR]]{{\[}}[[DIRECTION_IV]], %arg4, [[F_IV]]{{\]}} : memref<1x3x12xf32>
+  // CHECK:      {{.*}} = addf [[XWf_LOAD]], [[HRf_LOAD]] : f32
+
+  // CHECK:      [[XWc_LOAD:%.+]] = affine.load [[XW]]{{\[}}[[DIRECTION_IV]], %arg3, %arg4, [[C_IV]]{{\]}} : memref<1x4x3x12xf32>
+  // CHECK:      [[HRc_LOAD:%.+]] = affine.load [[HR]]{{\[}}[[DIRECTION_IV]], %arg4, [[C_IV]]{{\]}} : memref<1x3x12xf32>
+  // CHECK:      {{.*}} = addf [[XWc_LOAD]], [[HRc_LOAD]] : f32
+
+  /// The activations are computed without allocation.
+  // CHECK-NOT:  alloc
+  // CHECK:      [[FtCt1:%.+]] = mulf {{.*}}, [[Ct1_LOAD]] : f32
+  // CHECK-NEXT: [[Itct:%.+]] = mulf {{.*}}, {{.*}} : f32
+  // CHECK-NEXT: [[Ct:%.+]] = addf [[FtCt1]], [[Itct]] : f32
+  // CHECK-NEXT: affine.store [[Ct]], [[CELL_STATE]]{{\[}}[[DIRECTION_IV]], %arg4, %arg5] : memref<1x3x3xf32>
+
+  // CHECK:      [[XWo_LOAD:%.+]] = affine.load [[XW]]{{\[}}[[DIRECTION_IV]], %arg3, %arg4, [[O_IV]]{{\]}} : memref<1x4x3x12xf32>
+  // CHECK:      [[HRo_LOAD:%.+]] = affine.load [[HR]]{{\[}}[[DIRECTION_IV]], %arg4, [[O_IV]]{{\]}} : memref<1x3x12xf32>
+  // CHECK:      {{.*}} = addf [[XWo_LOAD]], [[HRo_LOAD]] : f32
+
+  // CHECK:      [[Ht:%.+]] = mulf {{.*}}, {{.*}} : f32
+  // CHECK-NEXT: affine.store [[Ht]], [[HIDDEN_STATE]]{{\[}}[[DIRECTION_IV]], %arg4, %arg5] : memref<1x3x3xf32>
   // CHECK:    }
   // CHECK:  }
-  // CHECK:  dealloc [[CELL_STATE]] : memref<1x3x3xf32>
   // CHECK:  return [[HIDDEN_STATE]] : memref<1x3x3xf32>
 }
 
@@ -2387,12 +2529,13 @@ func @test_lstm_reverse_mode(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x12x2xf32>
 
   // CHECK: [[REVERSE_IV_MAP:#.+]] = affine_map<(d0)[s0] -> (-d0 + s0 - 1)>
   // CHECK-LABEL: @test_lstm_reverse_mode
+  // CHECK-DAG: [[XW:%.+]] = alloc() : memref<1x4x3x12xf32>
 
   // CHECK:  [[REVERSE_SEQUENCE_LOOPS:%.+]] = krnl.define_loops 1
   // CHECK:  krnl.iterate([[REVERSE_SEQUENCE_LOOPS]]) with ([[REVERSE_SEQUENCE_LOOPS]] -> %arg3 = 0 to 4) {
   // CHECK:  %[[SEQUENCE_LEN:.+]] = constant 4 : index
   // CHECK:  %[[REVERSE_SEQUENCE_IV:.+]] = affine.apply [[REVERSE_IV_MAP]](%arg3)[%[[SEQUENCE_LEN]]{{]}}
-  // CHECK:  [[Xt_LOAD:%.+]] = affine.load %arg0[%[[REVERSE_SEQUENCE_IV]], {{.*}}, {{.*}}] : memref<4x3x2xf32>
+  // CHECK:  [[XWt_LOAD:%.+]] = affine.load [[XW]][{{.*}}, %[[REVERSE_SEQUENCE_IV]], {{.*}}, {{.*}}] : memref<1x4x3x12xf32>
 }
 
 // -----
@@ -2402,18 +2545,27 @@ func @test_lstm_bidirectional_mode(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x12x
   %Y, %Y_h, %Y_c = "onnx.LSTM"(%arg0, %arg1, %arg2, %cst, %cst, %cst, %cst, %cst) {hidden_size = 3 : si64, direction = "bidirectional"} : (tensor<4x3x2xf32>, tensor<1x12x2xf32>, tensor<1x12x3xf32>, none, none, none, none, none) -> (none, tensor<*xf32>, none)
   return %Y_h : tensor<*xf32>
 
-  // CHECK: [[REVERSE_IV_MAP:#.+]] = affine_map<(d0)[s0] -> (-d0 + s0 - 1)>
+  // CHECK-DAG: [[REVERSE_IV_MAP:#.+]] = affine_map<(d0)[s0] -> (-d0 + s0 - 1)>
+  // CHECK-DAG: [[FORWARD_SET:#.+]] = affine_set<(d0) : (d0 == 0)>
   // CHECK-LABEL: @test_lstm_bidirectional_mode
+  // CHECK-DAG: [[XW:%.+]] = alloc() : memref<1x4x3x12xf32>
+
+  /// The two directions are computed by the iterations of a parallel loop.
+  // CHECK:  [[DIRECTION_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK:  krnl.parallel [[DIRECTION_LOOPS]] : !krnl.loop
+  // CHECK:  krnl.iterate([[DIRECTION_LOOPS]]) with ([[DIRECTION_LOOPS]] -> %arg3 = 0 to 2) {
+  // CHECK:  affine.if [[FORWARD_SET]](%arg3) {
 
   // CHECK:  [[SEQUENCE_LOOPS:%.+]] = krnl.define_loops 1
-  // CHECK:  krnl.iterate([[SEQUENCE_LOOPS]]) with ([[SEQUENCE_LOOPS]] -> %arg3 = 0 to 4) {
-  // CHECK:  [[Xt_LOAD:%.+]] = affine.load %arg0[%arg3, {{.*}}, {{.*}}] : memref<4x3x2xf32>
+  // CHECK:  krnl.iterate([[SEQUENCE_LOOPS]]) with ([[SEQUENCE_LOOPS]] -> %arg4 = 0 to 4) {
+  // CHECK:  [[XWt_LOAD:%.+]] = affine.load [[XW]][%arg3, %arg4, {{.*}}, {{.*}}] : memref<1x4x3x12xf32>
 
+  // CHECK:  } else {
   // CHECK:  [[REVERSE_SEQUENCE_LOOPS:%.+]] = krnl.define_loops 1
-  // CHECK:  krnl.iterate([[REVERSE_SEQUENCE_LOOPS]]) with ([[REVERSE_SEQUENCE_LOOPS]] -> %arg3 = 0 to 4) {
+  // CHECK:  krnl.iterate([[REVERSE_SEQUENCE_LOOPS]]) with ([[REVERSE_SEQUENCE_LOOPS]] -> %arg4 = 0 to 4) {
   // CHECK:  %[[SEQUENCE_LEN:.+]] = constant 4 : index
-  // CHECK:  %[[REVERSE_SEQUENCE_IV:.+]] = affine.apply [[REVERSE_IV_MAP]](%arg3)[%[[SEQUENCE_LEN]]{{]}}
-  // CHECK:  [[Xt_LOAD:%.+]] = affine.load %arg0[%[[REVERSE_SEQUENCE_IV]], {{.*}}, {{.*}}] : memref<4x3x2xf32>
+  // CHECK:  %[[REVERSE_SEQUENCE_IV:.+]] = affine.apply [[REVERSE_IV_MAP]](%arg4)[%[[SEQUENCE_LEN]]{{]}}
+  // CHECK:  [[XWt_LOAD:%.+]] = affine.load [[XW]][%arg3, %[[REVERSE_SEQUENCE_IV]], {{.*}}, {{.*}}] : memref<1x4x3x12xf32>
 }
 
 // -----
@@ -2440,7 +2592,6 @@ func @test_rnn_general_computation(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x3x2
   // CHECK:   [[ZERO_INDEX:%.+]] = constant 0 : index
   // CHECK:   [[DATA_LOOPS:%.+]]:2 = krnl.define_loops 2
   // CHECK:   krnl.iterate([[DATA_LOOPS]]#0, [[DATA_LOOPS]]#1) with ([[DATA_LOOPS]]#0 -> %arg4 = 0 to 3, [[DATA_LOOPS]]#1 -> %arg5 = 0 to 3) {
-  // CHECK:     [[Ht:%.+]] = alloc() : memref<f32>
   // CHECK:     [[PREVIOUS_Ht:%.+]] = affine.load [[RES]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x3xf32>
 
   /// Check reduction loop to compute matrix multiplication for 'Xt*(Wi^T)' and 'Ht-1*(Ri^T)'
@@ -2469,25 +2620,19 @@ func @test_rnn_general_computation(%arg0: tensor<4x3x2xf32>, %arg1: tensor<1x3x2
   // CHECK: [[LOAD_HRi:%.+]] = affine.load [[HRi]][] : memref<f32>
   // CHECK: [[XWi_PLUS_HRi:%.+]] = addf [[LOAD_XWi]], [[LOAD_HRi]] : f32
 
-  /// Check calling 'Tanh'
-  // CHECK: {{.*}} = alloc() : memref<f32>
-  // CHECK: affine.store [[XWi_PLUS_HRi]], {{.*}} : memref<f32>
-  // CHECK: {{.*}} = affine.load {{.*}}[] : memref<f32>
-  // CHECK: {{.*}} = constant 0.000000e+00 : f32
-  // CHECK: {{.*}} = subf %cst_3, %13 : f32
-  // CHECK: {{.*}} = exp %13 : f32
-  // CHECK: {{.*.}} = exp {{.*.}} : f32
-  // CHECK: {{.*.}} = subf {{.*.}}, {{.*.}} : f32
-  // CHECK: {{.*.}} = addf {{.*.}}, {{.*.}} : f32
-  // CHECK: {{.*}} = divf {{.*.}}, {{.*.}} : f32
-  // CHECK: affine.store {{.*}}, [[Ht]][] : memref<f32>
+  /// Check computing 'Tanh' on the scalar.
+  // CHECK-NEXT: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK-NEXT: [[NEG:%.+]] = subf [[ZERO]], [[XWi_PLUS_HRi]] : f32
+  // CHECK-NEXT: [[EXP:%.+]] = exp [[XWi_PLUS_HRi]] : f32
+  // CHECK-NEXT: [[NEG_EXP:%.+]] = exp [[NEG]] : f32
+  // CHECK-NEXT: [[DIVIDEND:%.+]] = subf [[EXP]], [[NEG_EXP]] : f32
+  // CHECK-NEXT: [[DIVISOR:%.+]] = addf [[EXP]], [[NEG_EXP]] : f32
+  // CHECK-NEXT: [[NEW_Ht:%.+]] = divf [[DIVIDEND]], [[DIVISOR]] : f32
 
   /// Check storing the result.
-  // CHECK:     [[NEW_Ht_LOAD:%.+]] = affine.load [[Ht]][] : memref<f32>
-  // CHECK:     affine.store [[NEW_Ht_LOAD]], [[RES]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x3xf32>
+  // CHECK-NEXT: affine.store [[NEW_Ht]], [[RES]]{{\[}}[[ZERO_INDEX]], %arg4, %arg5] : memref<1x3x3xf32>
   // CHECK:     dealloc [[XWi]] : memref<f32>
   // CHECK:     dealloc [[HRi]] : memref<f32>
-  // CHECK:     dealloc [[Ht]] : memref<f32>
   // CHECK:   }
   // CHECK: }
   // CHECK: return [[RES]] : memref<1x3x3xf32>
@@ -2523,6 +2668,20 @@ func @test_squeeze(%arg0 : tensor<16x1x32x1x64xf32>) -> tensor<*xf32> {
 
 // -----
 
+/// Copies into results larger than the last level cache are non-temporal.
+func @test_squeeze_nontemporal(%arg0 : tensor<1x4096x4096xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Squeeze"(%arg0) { axes = [0]} : (tensor<1x4096x4096xf32>) -> (tensor<*xf32>)
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: @test_squeeze_nontemporal
+  // CHECK: [[RES:%.+]] = alloc() : memref<4096x4096xf32>
+  // CHECK: [[TENSOR_SIZE:%.+]] = constant 67108864 : i64
+  // CHECK: "krnl.memcpy"([[RES]], %arg0, [[TENSOR_SIZE]]) {nontemporal} : (memref<4096x4096xf32>, memref<1x4096x4096xf32>, i64) -> ()
+  // CHECK: return [[RES]] : memref<4096x4096xf32>
+}
+
+// -----
+
 func @test_squeeze_unknown_dimensions(%arg0 : tensor<?x1x32x?x64xf32>) -> tensor<*xf32> {
   %0 = "onnx.Squeeze"(%arg0) { axes = [1,-2]} : (tensor<?x1x32x?x64xf32>) -> (tensor<*xf32>)
   "std.return"(%0) : (tensor<*xf32>) -> ()
@@ -2540,6 +2699,36 @@ func @test_squeeze_unknown_dimensions(%arg0 : tensor<?x1x32x?x64xf32>) -> tensor
 
 // -----
 
+func @test_squeeze_in_place(%arg0 : tensor<?x1x32x?x64xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Squeeze"(%arg0) { axes = [1,-2]} : (tensor<?x1x32x?x64xf32>) -> (tensor<*xf32>)
+  %1 = "onnx.Relu"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: @test_squeeze_in_place
+  // CHECK: [[C0:%.+]] = constant 0 : index
+  // CHECK: [[DIM_0:%.+]] = dim %arg0, [[C0]] : memref<?x1x32x?x64xf32>
+  // CHECK: [[VIEW:%.+]] = "krnl.reshape"(%arg0, [[DIM_0]]) : (memref<?x1x32x?x64xf32>, index) -> memref<?x32x64xf32>
+  // CHECK-NOT: krnl.memcpy
+  // CHECK: affine.load [[VIEW]][%arg1, %arg2, %arg3] : memref<?x32x64xf32>
+}
+
+// -----
+
+func @test_unsqueeze_in_place(%arg0 : tensor<10x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Unsqueeze"(%arg0) {axes=[0,3]} : (tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: @test_unsqueeze_in_place
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x10x10x1xf32>
+  // CHECK: [[VIEW:%.+]] = "krnl.reshape"(%arg0) : (memref<10x10xf32>) -> memref<1x10x10x1xf32>
+  // CHECK-NOT: krnl.memcpy
+  // CHECK: affine.load [[VIEW]][%arg1, %arg2, %arg3, %arg4] : memref<1x10x10x1xf32>
+  // CHECK: return [[RES]] : memref<1x10x10x1xf32>
+}
+
+// -----
+
 func @test_split_equal(%arg0 : tensor<16x32x64xf32>) -> (tensor<*xf32>, tensor<*xf32>) {
   %0, %1 = "onnx.Split"(%arg0) { axis = 0 : si64} : (tensor<16x32x64xf32>) -> (tensor<*xf32>, tensor<*xf32>)
   "std.return"(%0, %1) : (tensor<*xf32>, tensor<*xf32>) -> ()
@@ -2590,6 +2779,22 @@ func @test_split_variable(%arg0 : tensor<16x32x64xf32>) -> (tensor<*xf32>, tenso
 
 // -----
 
+func @test_split_in_place(%arg0 : tensor<1x6x4xf32>) -> (tensor<*xf32>, tensor<*xf32>) {
+  %0, %1 = "onnx.Split"(%arg0) { axis = 1 : si64, split = [2, 4]} : (tensor<1x6x4xf32>) -> (tensor<*xf32>, tensor<*xf32>)
+  %2 = "onnx.Relu"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  %3 = "onnx.Relu"(%1) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%2, %3) : (tensor<*xf32>, tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: @test_split_in_place
+  // CHECK: [[VIEW_0:%.+]] = "krnl.reshape"(%arg0) {offset = 0 : i64} : (memref<1x6x4xf32>) -> memref<1x2x4xf32>
+  // CHECK: [[VIEW_1:%.+]] = "krnl.reshape"(%arg0) {offset = 8 : i64} : (memref<1x6x4xf32>) -> memref<1x4x4xf32>
+  // CHECK-NOT: affine.load %arg0
+  // CHECK: affine.load [[VIEW_0]][{{.*}}] : memref<1x2x4xf32>
+  // CHECK: affine.load [[VIEW_1]][{{.*}}] : memref<1x4x4xf32>
+}
+
+// -----
+
 func @test_split_unknown_dimension(%arg0 : tensor<?x?x64xf32>) -> (tensor<*xf32>, tensor<*xf32>) {
   %0, %1 = "onnx.Split"(%arg0) { axis = 1 : si64, split = [2, 30]} : (tensor<?x?x64xf32>) -> (tensor<*xf32>, tensor<*xf32>)
   "std.return"(%0, %1) : (tensor<*xf32>, tensor<*xf32>) -> ()
@@ -2794,6 +2999,38 @@ func @test_gather_axis1(%arg0 : tensor<3x3xf32>) -> tensor<3x1x2xf32> {
 
 // -----
 
+// Test gather of whole rows, as in embedding lookups.
+func @test_gather_rows(%arg0 : tensor<1000x64xf32>, %arg1 : tensor<2x3xi64>) -> tensor<*xf32> {
+  %0 = "onnx.Gather"(%arg0, %arg1) {axis = 0 : si64} : (tensor<1000x64xf32>, tensor<2x3xi64>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-DAG: [[NEXT_MAP:#.+]] = affine_map<(d0) -> (d0 + 4, 5)>
+  // CHECK-DAG: [[DEST_MAP:#.+]] = affine_map<(d0) -> (d0 * 64)>
+  // CHECK-LABEL: test_gather_rows
+  // CHECK: [[ALLOC:%.+]] = alloc() : memref<2x3x64xf32>
+  // CHECK: [[INDICES:%.+]] = "krnl.reshape"(%arg1) : (memref<2x3xi64>) -> memref<6xi64>
+  // CHECK: [[ROW_BYTES:%.+]] = constant 256 : i64
+  // CHECK: [[ROW_SIZE:%.+]] = constant 64 : index
+  // CHECK: [[ZERO:%.+]] = constant 0 : index
+  // CHECK: [[AXIS_SIZE:%.+]] = constant 1000 : index
+  // CHECK: [[LOOP:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[LOOP]] : !krnl.loop
+  // CHECK: krnl.iterate([[LOOP]]) with ([[LOOP]] -> [[ARG2:%.+]] = 0 to 6) {
+  // CHECK: [[NEXT:%.+]] = affine.min [[NEXT_MAP]]([[ARG2]])
+  // CHECK: [[NEXT_INDEX_I64:%.+]] = affine.load [[INDICES]]{{.}}[[NEXT]]{{.}} : memref<6xi64>
+  // CHECK: [[NEXT_INDEX:%.+]] = index_cast [[NEXT_INDEX_I64]] : i64 to index
+  // CHECK: [[NEXT_ROW:%.+]] = select {{.*}} : index
+  // CHECK: prefetch %arg0{{.}}[[NEXT_ROW]], [[ZERO]]{{.}}, read, locality<3>, data : memref<1000x64xf32>
+  // CHECK: [[INDEX_I64:%.+]] = affine.load [[INDICES]]{{.}}[[ARG2]]{{.}} : memref<6xi64>
+  // CHECK: [[INDEX:%.+]] = index_cast [[INDEX_I64]] : i64 to index
+  // CHECK: [[ROW:%.+]] = select {{.*}} : index
+  // CHECK: [[SRC:%.+]] = muli [[ROW]], [[ROW_SIZE]] : index
+  // CHECK: [[DEST:%.+]] = affine.apply [[DEST_MAP]]([[ARG2]])
+  // CHECK: "krnl.memcpy"([[ALLOC]], %arg0, [[ROW_BYTES]], [[DEST]], [[SRC]]) : (memref<2x3x64xf32>, memref<1000x64xf32>, i64, index, index) -> ()
+}
+
+// -----
+
 // Check the lowering of ConstantOfShape when:
 //   - No value attribute.
 //   - The input is an empty tensor.
@@ -2948,6 +3185,94 @@ func @test_tile3(%arg0 : tensor<?xf32>, %arg1 : tensor<1xi64>) -> tensor<*xf32>
 
 // -----
 
+// Test Tile with static shapes, copying blocks of the input
+func @test_tile_block_copies(%arg0 : tensor<2x16xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() { value = dense<[3, 2]> : tensor<2xi64>} : () -> tensor<2xi64>
+  %1 = "onnx.Tile"(%arg0, %0) : (tensor<2x16xf32>, tensor<2xi64>) -> tensor<*xf32>
+  return %1 : tensor<*xf32>
+  // CHECK-DAG: [[LINE_MAP:#.+]] = affine_map<(d0) -> (d0 * 32)>
+  // CHECK-DAG: [[INPUT_MAP:#.+]] = affine_map<(d0) -> (d0 * 16)>
+  // CHECK-DAG: [[FILLED_MAP:#.+]] = affine_map<(d0) -> (d0 * 32 + 16)>
+  // CHECK-LABEL: test_tile_block_copies
+  // CHECK: [[RES:%.+]] = alloc() : memref<6x32xf32>
+  // CHECK: [[DEF_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[DEF_LOOPS]] : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS]]) with ([[DEF_LOOPS]] -> %arg1 = 0 to 2) {
+  // CHECK:   [[LINE:%.+]] = affine.apply [[LINE_MAP]](%arg1)
+  // CHECK:   [[INPUT:%.+]] = affine.apply [[INPUT_MAP]](%arg1)
+  // CHECK:   [[SIZE:%.+]] = constant 64 : i64
+  // CHECK:   "krnl.memcpy"([[RES]], %arg0, [[SIZE]], [[LINE]], [[INPUT]]) : (memref<6x32xf32>, memref<2x16xf32>, i64, index, index) -> ()
+  // CHECK:   [[FILLED:%.+]] = affine.apply [[FILLED_MAP]](%arg1)
+  // CHECK:   [[SIZE:%.+]] = constant 64 : i64
+  // CHECK:   "krnl.memcpy"([[RES]], [[RES]], [[SIZE]], [[FILLED]], [[LINE]]) : (memref<6x32xf32>, memref<6x32xf32>, i64, index, index) -> ()
+  // CHECK: }
+  // CHECK: [[LINE:%.+]] = constant 0 : index
+  // CHECK: [[FILLED:%.+]] = constant 64 : index
+  // CHECK: [[SIZE:%.+]] = constant 256 : i64
+  // CHECK: "krnl.memcpy"([[RES]], [[RES]], [[SIZE]], [[FILLED]], [[LINE]]) : (memref<6x32xf32>, memref<6x32xf32>, i64, index, index) -> ()
+  // CHECK: [[FILLED:%.+]] = constant 128 : index
+  // CHECK: [[SIZE:%.+]] = constant 256 : i64
+  // CHECK: "krnl.memcpy"([[RES]], [[RES]], [[SIZE]], [[FILLED]], [[LINE]]) : (memref<6x32xf32>, memref<6x32xf32>, i64, index, index) -> ()
+  // CHECK: return [[RES]] : memref<6x32xf32>
+}
+
+// -----
+
+// Test Expand adding and broadcasting dimensions, copying blocks of the input
+func @test_expand_block_copies(%arg0 : tensor<1x16xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() { value = dense<[4, 3, 16]> : tensor<3xi64>} : () -> tensor<3xi64>
+  %1 = "onnx.Expand"(%arg0, %0) : (tensor<1x16xf32>, tensor<3xi64>) -> tensor<*xf32>
+  return %1 : tensor<*xf32>
+  // CHECK-DAG: [[LINE_MAP:#.+]] = affine_map<(d0) -> (d0 * 48)>
+  // CHECK-DAG: [[INPUT_MAP:#.+]] = affine_map<(d0) -> (d0 * 16)>
+  // CHECK-DAG: [[FILLED_MAP_0:#.+]] = affine_map<(d0) -> (d0 * 48 + 16)>
+  // CHECK-DAG: [[FILLED_MAP_1:#.+]] = affine_map<(d0) -> (d0 * 48 + 32)>
+  // CHECK-LABEL: test_expand_block_copies
+  // CHECK: [[RES:%.+]] = alloc() : memref<4x3x16xf32>
+  // CHECK: [[DEF_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[DEF_LOOPS]] : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS]]) with ([[DEF_LOOPS]] -> %arg1 = 0 to 1) {
+  // CHECK:   [[LINE:%.+]] = affine.apply [[LINE_MAP]](%arg1)
+  // CHECK:   [[INPUT:%.+]] = affine.apply [[INPUT_MAP]](%arg1)
+  // CHECK:   [[SIZE:%.+]] = constant 64 : i64
+  // CHECK:   "krnl.memcpy"([[RES]], %arg0, [[SIZE]], [[LINE]], [[INPUT]]) : (memref<4x3x16xf32>, memref<1x16xf32>, i64, index, index) -> ()
+  // CHECK:   [[FILLED:%.+]] = affine.apply [[FILLED_MAP_0]](%arg1)
+  // CHECK:   [[SIZE:%.+]] = constant 64 : i64
+  // CHECK:   "krnl.memcpy"([[RES]], [[RES]], [[SIZE]], [[FILLED]], [[LINE]])
+  // CHECK:   [[FILLED:%.+]] = affine.apply [[FILLED_MAP_1]](%arg1)
+  // CHECK:   [[SIZE:%.+]] = constant 64 : i64
+  // CHECK:   "krnl.memcpy"([[RES]], [[RES]], [[SIZE]], [[FILLED]], [[LINE]])
+  // CHECK: }
+  // CHECK: [[LINE:%.+]] = constant 0 : index
+  // CHECK: [[FILLED:%.+]] = constant 48 : index
+  // CHECK: [[SIZE:%.+]] = constant 192 : i64
+  // CHECK: "krnl.memcpy"([[RES]], [[RES]], [[SIZE]], [[FILLED]], [[LINE]])
+  // CHECK: [[FILLED:%.+]] = constant 96 : index
+  // CHECK: [[SIZE:%.+]] = constant 384 : i64
+  // CHECK: "krnl.memcpy"([[RES]], [[RES]], [[SIZE]], [[FILLED]], [[LINE]])
+  // CHECK: return [[RES]] : memref<4x3x16xf32>
+}
+
+// -----
+
+// Test Expand broadcasting a small inner dimension, element by element
+func @test_expand_elementwise(%arg0 : tensor<3x1xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() { value = dense<[3, 4]> : tensor<2xi64>} : () -> tensor<2xi64>
+  %1 = "onnx.Expand"(%arg0, %0) : (tensor<3x1xf32>, tensor<2xi64>) -> tensor<*xf32>
+  return %1 : tensor<*xf32>
+  // CHECK-LABEL: test_expand_elementwise
+  // CHECK: [[RES:%.+]] = alloc() : memref<3x4xf32>
+  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg1 = 0 to 3, [[DEF_LOOPS]]#1 -> %arg2 = 0 to 4) {
+  // CHECK:   [[ZERO:%.+]] = constant 0 : index
+  // CHECK:   [[LOAD:%.+]] = affine.load %arg0[%arg1, [[ZERO]]] : memref<3x1xf32>
+  // CHECK:   affine.store [[LOAD]], [[RES]][%arg1, %arg2] : memref<3x4xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<3x4xf32>
+}
+
+// -----
+
 func @test_less(%arg0: tensor<3x4x5xf32>, %arg1: tensor<3x4x5xf32>) -> tensor<3x4x5xi1> {
   %0 = "onnx.Less"(%arg0, %arg1) : (tensor<3x4x5xf32>, tensor<3x4x5xf32>) -> tensor<3x4x5xi1>
   return %0 : tensor<3x4x5xi1>
@@ -3006,3 +3331,215 @@ func @test_less_unknown_dims(%arg0: tensor<3x4x5xf32>, %arg1: tensor<?x4x5xf32>)
   // CHECK: return [[RES]] : memref<3x4x5xi1>
 }
 
+// -----
+
+func @test_dequantize_linear(%arg0 : tensor<4x3xi8>, %arg1 : tensor<f32>, %arg2 : tensor<i8>) -> tensor<*xf32> {
+  %0 = "onnx.DequantizeLinear"(%arg0, %arg1, %arg2) : (tensor<4x3xi8>, tensor<f32>, tensor<i8>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_dequantize_linear
+  // CHECK: [[RES:%.+]] = alloc() : memref<4x3xf32>
+  // CHECK: [[SCALE:%.+]] = affine.load %arg1[] : memref<f32>
+  // CHECK: [[LOAD_ZERO_POINT:%.+]] = affine.load %arg2[] : memref<i8>
+  // CHECK: [[ZERO_POINT:%.+]] = sexti [[LOAD_ZERO_POINT]] : i8 to i32
+  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg3 = 0 to 4, [[DEF_LOOPS]]#1 -> %arg4 = 0 to 3) {
+  // CHECK:   [[LOAD:%.+]] = affine.load %arg0[%arg3, %arg4] : memref<4x3xi8>
+  // CHECK:   [[EXT:%.+]] = sexti [[LOAD]] : i8 to i32
+  // CHECK:   [[SUB:%.+]] = subi [[EXT]], [[ZERO_POINT]] : i32
+  // CHECK:   [[REAL:%.+]] = sitofp [[SUB]] : i32 to f32
+  // CHECK:   [[MUL:%.+]] = mulf [[REAL]], [[SCALE]] : f32
+  // CHECK:   affine.store [[MUL]], [[RES]][%arg3, %arg4] : memref<4x3xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<4x3xf32>
+}
+
+// -----
+
+/// The products of int8 matrices are accumulated in int32.
+func @test_matmul_integer(%arg0 : tensor<4x3xi8>, %arg1 : tensor<3x2xi8>, %arg2 : tensor<i8>, %arg3 : tensor<i8>) -> tensor<*xi32> {
+  %0 = "onnx.MatMulInteger"(%arg0, %arg1, %arg2, %arg3) : (tensor<4x3xi8>, tensor<3x2xi8>, tensor<i8>, tensor<i8>) -> tensor<*xi32>
+  "std.return"(%0) : (tensor<*xi32>) -> ()
+
+  // CHECK-LABEL: test_matmul_integer
+  // CHECK: [[RES:%.+]] = alloc() : memref<4x2xi32>
+  // CHECK: [[LOAD_A_ZERO_POINT:%.+]] = affine.load %arg2[] : memref<i8>
+  // CHECK: [[A_ZERO_POINT:%.+]] = sexti [[LOAD_A_ZERO_POINT]] : i8 to i32
+  // CHECK: [[LOAD_B_ZERO_POINT:%.+]] = affine.load %arg3[] : memref<i8>
+  // CHECK: [[B_ZERO_POINT:%.+]] = sexti [[LOAD_B_ZERO_POINT]] : i8 to i32
+  // CHECK: [[ZERO:%.+]] = constant 0 : i32
+  // CHECK: [[ROW_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[ROW_LOOP]] : !krnl.loop
+  // CHECK: krnl.iterate([[ROW_LOOP]]) with ([[ROW_LOOP]] -> %arg4 = 0 to 4) {
+  // CHECK:   [[INIT_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[INIT_LOOP]]) with ([[INIT_LOOP]] -> %arg5 = 0 to 2) {
+  // CHECK:     affine.store [[ZERO]], [[RES]][%arg4, %arg5] : memref<4x2xi32>
+  // CHECK:   }
+  // CHECK:   [[REDUCTION_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[REDUCTION_LOOP]]) with ([[REDUCTION_LOOP]] -> %arg5 = 0 to 3) {
+  // CHECK:     [[LOAD_A:%.+]] = affine.load %arg0[%arg4, %arg5] : memref<4x3xi8>
+  // CHECK:     [[EXT_A:%.+]] = sexti [[LOAD_A]] : i8 to i32
+  // CHECK:     [[A:%.+]] = subi [[EXT_A]], [[A_ZERO_POINT]] : i32
+  // CHECK:     [[COLUMN_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:     krnl.iterate([[COLUMN_LOOP]]) with ([[COLUMN_LOOP]] -> %arg6 = 0 to 2) {
+  // CHECK:       [[LOAD_B:%.+]] = affine.load %arg1[%arg5, %arg6] : memref<3x2xi8>
+  // CHECK:       [[EXT_B:%.+]] = sexti [[LOAD_B]] : i8 to i32
+  // CHECK:       [[B:%.+]] = subi [[EXT_B]], [[B_ZERO_POINT]] : i32
+  // CHECK:       [[LOAD_RES:%.+]] = affine.load [[RES]][%arg4, %arg6] : memref<4x2xi32>
+  // CHECK:       [[MUL:%.+]] = muli [[A]], [[B]] : i32
+  // CHECK:       [[ADD:%.+]] = addi [[LOAD_RES]], [[MUL]] : i32
+  // CHECK:       affine.store [[ADD]], [[RES]][%arg4, %arg6] : memref<4x2xi32>
+  // CHECK:     }
+  // CHECK:   }
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<4x2xi32>
+}
+
+// -----
+
+/// Half-precision products are accumulated in f32, and operands of different
+/// float types are extended to f32.
+func @test_matmul_f16(%arg0 : tensor<2x3xf16>, %arg1 : tensor<3x4xbf16>) -> tensor<*xf16> {
+  %0 = "onnx.MatMul"(%arg0, %arg1) : (tensor<2x3xf16>, tensor<3x4xbf16>) -> tensor<*xf16>
+  "std.return"(%0) : (tensor<*xf16>) -> ()
+
+  // CHECK-LABEL: test_matmul_f16
+  // CHECK: [[ACC:%.+]] = alloc() : memref<2x4xf32>
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x4xf16>
+  // CHECK: [[ZERO:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg2 = 0 to 2, [[DEF_LOOPS]]#1 -> %arg3 = 0 to 4) {
+  // CHECK:   affine.store [[ZERO]], [[ACC]][%arg2, %arg3] : memref<2x4xf32>
+  // CHECK:   [[DEF_LOOPS_REDUCE:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[DEF_LOOPS_REDUCE]]) with ([[DEF_LOOPS_REDUCE]] -> %arg4 = 0 to 3) {
+  // CHECK:     [[LOAD_0:%.+]] = affine.load %arg0[%arg2, %arg4] : memref<2x3xf16>
+  // CHECK:     [[EXT_0:%.+]] = fpext [[LOAD_0]] : f16 to f32
+  // CHECK:     [[LOAD_1:%.+]] = affine.load %arg1[%arg4, %arg3] : memref<3x4xbf16>
+  // CHECK:     [[EXT_1:%.+]] = fpext [[LOAD_1]] : bf16 to f32
+  // CHECK:     [[LOAD_ACC:%.+]] = affine.load [[ACC]][%arg2, %arg3] : memref<2x4xf32>
+  // CHECK:     [[MUL:%.+]] = mulf [[EXT_0]], [[EXT_1]] : f32
+  // CHECK:     [[ADD:%.+]] = addf [[LOAD_ACC]], [[MUL]] : f32
+  // CHECK:     affine.store [[ADD]], [[ACC]][%arg2, %arg3] : memref<2x4xf32>
+  // CHECK:   }
+  // CHECK: }
+  // CHECK: [[STORE_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[STORE_LOOPS]]#0, [[STORE_LOOPS]]#1) with ([[STORE_LOOPS]]#0 -> %arg2 = 0 to 2, [[STORE_LOOPS]]#1 -> %arg3 = 0 to 4) {
+  // CHECK:   [[LOAD_SUM:%.+]] = affine.load [[ACC]][%arg2, %arg3] : memref<2x4xf32>
+  // CHECK:   [[SUM:%.+]] = fptrunc [[LOAD_SUM]] : f32 to f16
+  // CHECK:   affine.store [[SUM]], [[RES]][%arg2, %arg3] : memref<2x4xf16>
+  // CHECK: }
+  // CHECK: dealloc [[ACC]] : memref<2x4xf32>
+  // CHECK: return [[RES]] : memref<2x4xf16>
+}
+
+// -----
+
+/// Unsigned bytes of an NHWC image are converted and normalized with the
+/// per-channel tables in a single loop nest.
+func @test_image_preprocess(%arg0 : tensor<1x2x2x3xi8>) -> tensor<*xf32> {
+  %0 = "onnx.ImagePreprocess"(%arg0) {is_unsigned = 1 : si64, layout = "NHWC", mean = [1.0 : f32], std = [1.0 : f32, 2.0 : f32, 4.0 : f32]} : (tensor<1x2x2x3xi8>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_image_preprocess
+  // CHECK: [[SCALES:%.+]] = "krnl.global"() {name = "preprocess_{{[0-9]+}}", shape = [3], value = dense<[1.000000e+00, 5.000000e-01, 2.500000e-01]> : tensor<3xf32>} : () -> memref<3xf32>
+  // CHECK: [[SHIFTS:%.+]] = "krnl.global"() {name = "preprocess_{{[0-9]+}}", shape = [3], value = dense<[-1.000000e+00, -5.000000e-01, -2.500000e-01]> : tensor<3xf32>} : () -> memref<3xf32>
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x3x2x2xf32>
+  // CHECK: [[LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.parallel [[LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[LOOPS]]#0, [[LOOPS]]#1, [[LOOPS]]#2, [[LOOPS]]#3) with ([[LOOPS]]#0 -> [[N:%.+]] = 0 to 1, [[LOOPS]]#1 -> [[C:%.+]] = 0 to 3, [[LOOPS]]#2 -> [[H:%.+]] = 0 to 2, [[LOOPS]]#3 -> [[W:%.+]] = 0 to 2) {
+  // CHECK:   [[LOAD:%.+]] = affine.load %arg0{{\[}}[[N]], [[H]], [[W]], [[C]]{{\]}} : memref<1x2x2x3xi8>
+  // CHECK:   [[FLOAT:%.+]] = uitofp [[LOAD]] : i8 to f32
+  // CHECK:   [[SCALE:%.+]] = affine.load [[SCALES]]{{\[}}[[C]]{{\]}} : memref<3xf32>
+  // CHECK:   [[SHIFT:%.+]] = affine.load [[SHIFTS]]{{\[}}[[C]]{{\]}} : memref<3xf32>
+  // CHECK:   [[MUL:%.+]] = mulf [[FLOAT]], [[SCALE]] : f32
+  // CHECK:   [[ADD:%.+]] = addf [[MUL]], [[SHIFT]] : f32
+  // CHECK:   affine.store [[ADD]], [[RES]]{{\[}}[[N]], [[C]], [[H]], [[W]]{{\]}} : memref<1x3x2x2xf32>
+  // CHECK: return [[RES]] : memref<1x3x2x2xf32>
+}
+
+// -----
+
+/// The arithmetic is omitted when the normalization is folded into the
+/// convolution reading the image.
+func @test_image_preprocess_identity(%arg0 : tensor<1x2x2x3xi8>) -> tensor<*xf32> {
+  %0 = "onnx.ImagePreprocess"(%arg0) {is_unsigned = 0 : si64, layout = "NHWC", mean = [0.0 : f32], std = [1.0 : f32]} : (tensor<1x2x2x3xi8>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_image_preprocess_identity
+  // CHECK: [[LOAD:%.+]] = affine.load %arg0
+  // CHECK: [[FLOAT:%.+]] = sitofp [[LOAD]] : i8 to f32
+  // CHECK-NOT: mulf
+  // CHECK: affine.store [[FLOAT]]
+}
+
+// -----
+
+/// The rows of each bag are accumulated into its output row, and divided by
+/// the size of the bag in mean mode.
+func @test_embedding_bag(%arg0 : tensor<100x16xf32>, %arg1 : tensor<4x8xi64>) -> tensor<*xf32> {
+  %0 = "onnx.EmbeddingBag"(%arg0, %arg1) {keepdims = 0 : si64, mode = "mean"} : (tensor<100x16xf32>, tensor<4x8xi64>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_embedding_bag
+  // CHECK: [[RES:%.+]] = alloc() : memref<4x16xf32>
+  // CHECK: [[BAGS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[BAGS]] : !krnl.loop
+  // CHECK: krnl.iterate([[BAGS]]) with ([[BAGS]] -> [[J:%.+]] = 0 to 4) {
+  // CHECK:   [[ZERO_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[ZERO_LOOP]]) with ([[ZERO_LOOP]] -> [[K0:%.+]] = 0 to 16) {
+  // CHECK:     affine.store {{.*}}, [[RES]]{{\[}}[[J]], [[K0]]{{\]}} : memref<4x16xf32>
+  // CHECK:   [[BAG_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[BAG_LOOP]]) with ([[BAG_LOOP]] -> [[B:%.+]] = 0 to 8) {
+  // CHECK:     [[RAW:%.+]] = affine.load %arg1{{\[}}[[J]], [[B]]{{\]}} : memref<4x8xi64>
+  // CHECK:     [[INDEX:%.+]] = select
+  // CHECK:     [[ROW_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:     krnl.iterate([[ROW_LOOP]]) with ([[ROW_LOOP]] -> [[K1:%.+]] = 0 to 16) {
+  // CHECK:       [[ROW:%.+]] = load %arg0{{\[}}[[INDEX]], [[K1]]{{\]}} : memref<100x16xf32>
+  // CHECK:       [[SUM:%.+]] = affine.load [[RES]]{{\[}}[[J]], [[K1]]{{\]}} : memref<4x16xf32>
+  // CHECK:       [[ADD:%.+]] = addf [[SUM]], [[ROW]] : f32
+  // CHECK:       affine.store [[ADD]], [[RES]]{{\[}}[[J]], [[K1]]{{\]}} : memref<4x16xf32>
+  // CHECK:   [[MEAN_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[MEAN_LOOP]]) with ([[MEAN_LOOP]] -> [[K2:%.+]] = 0 to 16) {
+  // CHECK:     [[TOTAL:%.+]] = affine.load [[RES]]{{\[}}[[J]], [[K2]]{{\]}} : memref<4x16xf32>
+  // CHECK:     [[DIV:%.+]] = divf [[TOTAL]], {{.*}} : f32
+  // CHECK:     affine.store [[DIV]], [[RES]]{{\[}}[[J]], [[K2]]{{\]}} : memref<4x16xf32>
+  // CHECK: return [[RES]] : memref<4x16xf32>
+}
+
+// -----
+
+/// Each output element accumulates the products of the non-zero weights of
+/// its column, from the bias.
+func @test_sparse_matmul(%arg0 : tensor<3x4xf32>, %arg1 : tensor<2xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<[0, 1, 2]> : tensor<3xi64>} : () -> tensor<3xi64>
+  %1 = "onnx.Constant"() {value = dense<[3, 1]> : tensor<2xi64>} : () -> tensor<2xi64>
+  %2 = "onnx.Constant"() {value = dense<[2.0, 6.0]> : tensor<2xf32>} : () -> tensor<2xf32>
+  %3 = "onnx.SparseMatMul"(%arg0, %0, %1, %2, %arg1) : (tensor<3x4xf32>, tensor<3xi64>, tensor<2xi64>, tensor<2xf32>, tensor<2xf32>) -> tensor<*xf32>
+  "std.return"(%3) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_sparse_matmul
+  // CHECK-DAG: [[ROWS:%.+]] = "krnl.global"() {name = "constant_{{[0-9]+}}", shape = [3], value = dense<[0, 1, 2]> : tensor<3xi64>} : () -> memref<3xi64>
+  // CHECK-DAG: [[COLS:%.+]] = "krnl.global"() {name = "constant_{{[0-9]+}}", shape = [2], value = dense<[3, 1]> : tensor<2xi64>} : () -> memref<2xi64>
+  // CHECK-DAG: [[VALS:%.+]] = "krnl.global"() {name = "constant_{{[0-9]+}}", shape = [2], value = dense<[2.000000e+00, 6.000000e+00]> : tensor<2xf32>} : () -> memref<2xf32>
+  // CHECK: [[RES:%.+]] = alloc() : memref<3x2xf32>
+  // CHECK: [[LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[LOOPS]]#0, [[LOOPS]]#1) with ([[LOOPS]]#0 -> [[I:%.+]] = 0 to 3, [[LOOPS]]#1 -> [[N:%.+]] = 0 to 2) {
+  // CHECK:   [[BEGIN_I64:%.+]] = load [[ROWS]]{{\[}}[[N]]{{\]}} : memref<3xi64>
+  // CHECK:   [[BEGIN:%.+]] = index_cast [[BEGIN_I64]] : i64 to index
+  // CHECK:   [[NEXT:%.+]] = addi [[N]], %c1 : index
+  // CHECK:   [[END_I64:%.+]] = load [[ROWS]]{{\[}}[[NEXT]]{{\]}} : memref<3xi64>
+  // CHECK:   [[END:%.+]] = index_cast [[END_I64]] : i64 to index
+  // CHECK:   [[BIAS:%.+]] = affine.load %arg1{{\[}}[[N]]{{\]}} : memref<2xf32>
+  // CHECK:   [[SUM:%.+]] = scf.for [[P:%.+]] = [[BEGIN]] to [[END]] step %c1 iter_args([[ACC:%.+]] = [[BIAS]]) -> (f32) {
+  // CHECK:     [[K_I64:%.+]] = load [[COLS]]{{\[}}[[P]]{{\]}} : memref<2xi64>
+  // CHECK:     [[K:%.+]] = index_cast [[K_I64]] : i64 to index
+  // CHECK:     [[A:%.+]] = load %arg0{{\[}}[[I]], [[K]]{{\]}} : memref<3x4xf32>
+  // CHECK:     [[W:%.+]] = load [[VALS]]{{\[}}[[P]]{{\]}} : memref<2xf32>
+  // CHECK:     [[MUL:%.+]] = mulf [[A]], [[W]] : f32
+  // CHECK:     [[ADD:%.+]] = addf [[ACC]], [[MUL]] : f32
+  // CHECK:     scf.yield [[ADD]] : f32
+  // CHECK:   affine.store [[SUM]], [[RES]]{{\[}}[[I]], [[N]]{{\]}} : memref<3x2xf32>
+  // CHECK: return [[RES]] : memref<3x2xf32>
+}
@@ -0,0 +1,100 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='blas-threshold=1024' %s -split-input-file | FileCheck %s
+
+func @test_blas_matmul(%arg0 : tensor<16x32xf32>, %arg1 : tensor<32x64xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<16x32xf32>, tensor<32x64xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_blas_matmul
+  // CHECK: [[RES:%.+]] = alloc() : memref<16x64xf32>
+  // CHECK-NOT: krnl.iterate
+  // CHECK: "krnl.blas_gemm"(%arg0, %arg1, [[RES]]) {K = 32 : i64, M = 16 : i64, N = 64 : i64, alpha = 1.000000e+00 : f32, beta = 0.000000e+00 : f32, transA = false, transB = false} : (memref<16x32xf32>, memref<32x64xf32>, memref<16x64xf32>) -> ()
+  // CHECK: return [[RES]] : memref<16x64xf32>
+}
+
+// -----
+
+/// The batches of A form the rows of a single call when B is shared.
+func @test_blas_matmul_shared_weights(%arg0 : tensor<4x16x32xf32>, %arg1 : tensor<32x64xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<4x16x32xf32>, tensor<32x64xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_blas_matmul_shared_weights
+  // CHECK: [[RES:%.+]] = alloc() : memref<4x16x64xf32>
+  // CHECK-NOT: krnl.iterate
+  // CHECK: "krnl.blas_gemm"(%arg0, %arg1, [[RES]]) {K = 32 : i64, M = 64 : i64, N = 64 : i64, {{.*}}} : (memref<4x16x32xf32>, memref<32x64xf32>, memref<4x16x64xf32>) -> ()
+  // CHECK: return [[RES]] : memref<4x16x64xf32>
+}
+
+// -----
+
+/// Each batch is a call at the offsets of its matrices.
+func @test_blas_matmul_batched(%arg0 : tensor<2x16x32xf32>, %arg1 : tensor<2x32x64xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<2x16x32xf32>, tensor<2x32x64xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-DAG: [[MAP_A:#.+]] = affine_map<(d0) -> (d0 * 512)>
+  // CHECK-DAG: [[MAP_B:#.+]] = affine_map<(d0) -> (d0 * 2048)>
+  // CHECK-DAG: [[MAP_C:#.+]] = affine_map<(d0) -> (d0 * 1024)>
+  // CHECK-LABEL: test_blas_matmul_batched
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x16x64xf32>
+  // CHECK: [[LOOP:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[LOOP]] : !krnl.loop
+  // CHECK: krnl.iterate([[LOOP]]) with ([[LOOP]] -> [[I:%.+]] = 0 to 2) {
+  // CHECK:   [[OFFSET_A:%.+]] = affine.apply [[MAP_A]]([[I]])
+  // CHECK:   [[OFFSET_B:%.+]] = affine.apply [[MAP_B]]([[I]])
+  // CHECK:   [[OFFSET_C:%.+]] = affine.apply [[MAP_C]]([[I]])
+  // CHECK:   "krnl.blas_gemm"(%arg0, %arg1, [[RES]], [[OFFSET_A]], [[OFFSET_B]], [[OFFSET_C]]) {K = 32 : i64, M = 16 : i64, N = 64 : i64, {{.*}}} : (memref<2x16x32xf32>, memref<2x32x64xf32>, memref<2x16x64xf32>, index, index, index) -> ()
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<2x16x64xf32>
+}
+
+// -----
+
+/// Products below the threshold keep their loop nest.
+func @test_blas_matmul_small(%arg0 : tensor<4x4xf32>, %arg1 : tensor<4x4xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<4x4xf32>, tensor<4x4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_blas_matmul_small
+  // CHECK-NOT: krnl.blas_gemm
+  // CHECK: krnl.iterate
+}
+
+// -----
+
+/// The bias is broadcast into the result, to which the call adds the product.
+func @test_blas_gemm(%arg0 : tensor<32x64xf32>, %arg1 : tensor<128x64xf32>, %arg2 : tensor<128xf32>) -> tensor<*xf32> {
+  %0 ="onnx.Gemm"(%arg0, %arg1, %arg2) {alpha = 5.000000e-01 : f32, beta = 2.000000e+00 : f32, transA = 0 : si64, transB = 1 : si64} : (tensor<32x64xf32>, tensor<128x64xf32>, tensor<128xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_blas_gemm
+  // CHECK: [[RES:%.+]] = alloc() : memref<32x128xf32>
+  // CHECK: [[BIAS_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[BIAS_LOOPS]]#0, [[BIAS_LOOPS]]#1) with ([[BIAS_LOOPS]]#0 -> [[I:%.+]] = 0 to 32, [[BIAS_LOOPS]]#1 -> [[J:%.+]] = 0 to 128) {
+  // CHECK:   [[BIAS:%.+]] = affine.load %arg2{{\[}}[[J]]{{\]}} : memref<128xf32>
+  // CHECK:   affine.store [[BIAS]], [[RES]]{{\[}}[[I]], [[J]]{{\]}} : memref<32x128xf32>
+  // CHECK: }
+  // CHECK: "krnl.blas_gemm"(%arg0, %arg1, [[RES]]) {K = 64 : i64, M = 32 : i64, N = 128 : i64, alpha = 5.000000e-01 : f32, beta = 2.000000e+00 : f32, transA = false, transB = true} : (memref<32x64xf32>, memref<128x64xf32>, memref<32x128xf32>) -> ()
+  // CHECK: return [[RES]] : memref<32x128xf32>
+}
+
+// -----
+
+/// The product of the im2col lowering is a call for each image.
+func @test_blas_conv(%arg0 : tensor<1x2x6x6xf32>, %arg1 : tensor<4x2x3x3xf32>, %arg2 : tensor<4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Conv"(%arg0, %arg1, %arg2) {auto_pad = "NOTSET", group = 1 : si64} : (tensor<1x2x6x6xf32>, tensor<4x2x3x3xf32>, tensor<4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-DAG: [[MAP_RES:#.+]] = affine_map<(d0) -> (d0 * 64)>
+  // CHECK-LABEL: test_blas_conv
+  // CHECK-DAG: [[COL:%.+]] = alloc() : memref<18x16xf32>
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<1x4x4x4xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[N:%.+]] = 0 to 1) {
+  // CHECK:   affine.store {{.*}}, [[COL]]
+  // CHECK:   affine.store {{.*}}, [[RES]]
+  // CHECK:   [[ZERO:%.+]] = constant 0 : index
+  // CHECK:   [[OFFSET:%.+]] = affine.apply [[MAP_RES]]([[N]])
+  // CHECK:   "krnl.blas_gemm"(%arg1, [[COL]], [[RES]], [[ZERO]], [[ZERO]], [[OFFSET]]) {K = 18 : i64, M = 4 : i64, N = 16 : i64, alpha = 1.000000e+00 : f32, beta = 1.000000e+00 : f32, transA = false, transB = false} : (memref<4x2x3x3xf32>, memref<18x16xf32>, memref<1x4x4x4xf32>, index, index, index) -> ()
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<1x4x4x4xf32>
+}
@@ -0,0 +1,125 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='conv-strategy=im2col' %s -split-input-file | FileCheck --check-prefix=IM2COL %s
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='conv-strategy=winograd' %s -split-input-file | FileCheck --check-prefix=WINOGRAD %s
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='conv-strategy=auto' %s -split-input-file | FileCheck --check-prefix=AUTO %s
+
+func @test_conv_3x3(%arg0 : tensor<1x2x6x6xf32>, %arg1 : tensor<4x2x3x3xf32>, %arg2 : tensor<4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Conv"(%arg0, %arg1, %arg2) {auto_pad = "NOTSET", group = 1 : si64} : (tensor<1x2x6x6xf32>, tensor<4x2x3x3xf32>, tensor<4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // IM2COL-LABEL: test_conv_3x3
+  // IM2COL-DAG: [[COL:%.+]] = alloc() : memref<18x16xf32>
+  // IM2COL-DAG: [[RES:%.+]] = alloc() : memref<1x4x4x4xf32>
+  // IM2COL: [[IMAGE_LOOP:%.+]] = krnl.define_loops 1
+  // IM2COL: krnl.iterate([[IMAGE_LOOP]]) with ([[IMAGE_LOOP]] -> [[N:%.+]] = 0 to 1) {
+
+  /// Pack the input patches.
+  // IM2COL: [[PACK_LOOPS:%.+]]:5 = krnl.define_loops 5
+  // IM2COL: krnl.parallel [[PACK_LOOPS]]#0 : !krnl.loop
+  // IM2COL: krnl.iterate([[PACK_LOOPS]]#0, [[PACK_LOOPS]]#1, [[PACK_LOOPS]]#2, [[PACK_LOOPS]]#3, [[PACK_LOOPS]]#4) with ({{.*}} = 0 to 2, {{.*}} = 0 to 3, {{.*}} = 0 to 3, {{.*}} = 0 to 4, {{.*}} = 0 to 4) {
+  // IM2COL:   [[DATA:%.+]] = affine.load %arg0[{{.*}}] : memref<1x2x6x6xf32>
+  // IM2COL:   affine.store [[DATA]], [[COL]][{{.*}}] : memref<18x16xf32>
+
+  /// Initialize the output with the bias.
+  // IM2COL: [[INIT_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // IM2COL: krnl.iterate([[INIT_LOOPS]]#0, [[INIT_LOOPS]]#1) with ([[INIT_LOOPS]]#0 -> [[M:%.+]] = 0 to 4, [[INIT_LOOPS]]#1 -> {{.*}} = 0 to 16) {
+  // IM2COL:   [[BIAS:%.+]] = affine.load %arg2{{\[}}[[M]]{{\]}} : memref<4xf32>
+  // IM2COL:   affine.store [[BIAS]], [[RES]][{{.*}}] : memref<1x4x4x4xf32>
+
+  /// Tiled GEMM between the kernel and the columns.
+  // IM2COL: [[GEMM_LOOPS:%.+]]:3 = krnl.define_loops 3
+  // IM2COL: [[MB:%.+]], [[ML:%.+]] = krnl.block [[GEMM_LOOPS]]#0 4 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // IM2COL: [[KB:%.+]], [[KL:%.+]] = krnl.block [[GEMM_LOOPS]]#1 18 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // IM2COL: [[PB:%.+]], [[PL:%.+]] = krnl.block [[GEMM_LOOPS]]#2 16 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // IM2COL: krnl.permute([[MB]], [[ML]], [[KB]], [[KL]], [[PB]], [[PL]]) [0, 3, 2, 4, 1, 5]
+  // IM2COL: krnl.parallel [[MB]] : !krnl.loop
+  // IM2COL: krnl.iterate([[MB]], [[PB]], [[KB]], [[ML]], [[KL]], [[PL]]) with ([[GEMM_LOOPS]]#0 -> [[GM:%.+]] = 0 to 4, [[GEMM_LOOPS]]#1 -> [[GK:%.+]] = 0 to 18, [[GEMM_LOOPS]]#2 -> [[GP:%.+]] = 0 to 16) {
+  // IM2COL:   [[KERNEL:%.+]] = affine.load %arg1[{{.*}}] : memref<4x2x3x3xf32>
+  // IM2COL:   [[LOAD_COL:%.+]] = affine.load [[COL]]{{\[}}[[GK]], [[GP]]{{\]}} : memref<18x16xf32>
+  // IM2COL:   [[PARTIAL:%.+]] = affine.load [[RES]][{{.*}}] : memref<1x4x4x4xf32>
+  // IM2COL:   [[MUL:%.+]] = mulf [[KERNEL]], [[LOAD_COL]] : f32
+  // IM2COL:   [[ADD:%.+]] = addf [[PARTIAL]], [[MUL]] : f32
+  // IM2COL:   affine.store [[ADD]], [[RES]][{{.*}}] : memref<1x4x4x4xf32>
+  // IM2COL: dealloc [[COL]] : memref<18x16xf32>
+  // IM2COL: return [[RES]] : memref<1x4x4x4xf32>
+
+  // WINOGRAD-LABEL: test_conv_3x3
+  // WINOGRAD-DAG: [[PRODUCTS:%.+]] = alloc() : memref<1x4x2x2x4x4xf32>
+  // WINOGRAD-DAG: [[INPUT_T:%.+]] = alloc() : memref<1x2x2x2x4x4xf32>
+  // WINOGRAD-DAG: [[KERNEL_T:%.+]] = alloc() : memref<4x2x4x4xf32>
+  // WINOGRAD-DAG: [[RES:%.+]] = alloc() : memref<1x4x4x4xf32>
+
+  /// Kernel transform.
+  // WINOGRAD: [[KERNEL_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // WINOGRAD: krnl.iterate([[KERNEL_LOOPS]]#0, [[KERNEL_LOOPS]]#1) with ({{.*}} = 0 to 4, {{.*}} = 0 to 2) {
+  // WINOGRAD-COUNT-9: affine.load %arg1
+  // WINOGRAD-COUNT-16: affine.store {{.*}}, [[KERNEL_T]]
+
+  /// Input transform.
+  // WINOGRAD: [[INPUT_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // WINOGRAD: krnl.iterate({{.*}}) with ({{.*}} = 0 to 1, {{.*}} = 0 to 2, {{.*}} = 0 to 2, {{.*}} = 0 to 2) {
+  // WINOGRAD-COUNT-16: affine.load %arg0
+  // WINOGRAD-COUNT-16: affine.store {{.*}}, [[INPUT_T]]
+
+  /// Products of the transformed tiles reduced over the channels.
+  // WINOGRAD: krnl.define_loops 6
+  // WINOGRAD: affine.store {{.*}}, [[PRODUCTS]]
+  // WINOGRAD: krnl.define_loops 7
+  // WINOGRAD: [[LOAD_KERNEL_T:%.+]] = affine.load [[KERNEL_T]]
+  // WINOGRAD: [[LOAD_INPUT_T:%.+]] = affine.load [[INPUT_T]]
+  // WINOGRAD: [[PARTIAL:%.+]] = affine.load [[PRODUCTS]]
+  // WINOGRAD: [[MUL:%.+]] = mulf [[LOAD_KERNEL_T]], [[LOAD_INPUT_T]] : f32
+  // WINOGRAD: [[ADD:%.+]] = addf [[PARTIAL]], [[MUL]] : f32
+  // WINOGRAD: affine.store [[ADD]], [[PRODUCTS]]
+
+  /// Output transform.
+  // WINOGRAD: krnl.define_loops 4
+  // WINOGRAD-COUNT-16: affine.load [[PRODUCTS]]
+  // WINOGRAD: affine.load %arg2
+  // WINOGRAD-COUNT-4: affine.store {{.*}}, [[RES]]
+  // WINOGRAD: return [[RES]] : memref<1x4x4x4xf32>
+
+  /// The transforms of Winograd cost more than they save on 2 channels.
+  // AUTO-LABEL: test_conv_3x3
+  // AUTO-NOT: memref<4x2x4x4xf32>
+  // AUTO: alloc() : memref<18x16xf32>
+  // AUTO: return
+}
+
+// -----
+
+/// Strided convolutions are not handled by Winograd and use the direct loop
+/// nest.
+func @test_conv_strided(%arg0 : tensor<1x2x7x7xf32>, %arg1 : tensor<4x2x3x3xf32>) -> tensor<*xf32> {
+  %cst = constant unit
+  %0 = "onnx.Conv"(%arg0, %arg1, %cst) {auto_pad = "NOTSET", group = 1 : si64, strides = [2, 2]} : (tensor<1x2x7x7xf32>, tensor<4x2x3x3xf32>, none) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // IM2COL-LABEL: test_conv_strided
+  // IM2COL: alloc() : memref<18x9xf32>
+  // IM2COL: krnl.block
+
+  // WINOGRAD-LABEL: test_conv_strided
+  // WINOGRAD-NOT: memref<4x2x4x4xf32>
+  // WINOGRAD: [[OUTER_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // WINOGRAD: [[SPATIAL_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // WINOGRAD: [[INNER_LOOPS:%.+]]:3 = krnl.define_loops 3
+  // WINOGRAD: return
+
+  // AUTO-LABEL: test_conv_strided
+  // AUTO: alloc() : memref<18x9xf32>
+  // AUTO: krnl.block
+}
+
+// -----
+
+/// Winograd is picked when its transforms are amortized over the channels.
+func @test_conv_3x3_channels(%arg0 : tensor<1x16x6x6xf32>, %arg1 : tensor<16x16x3x3xf32>) -> tensor<*xf32> {
+  %cst = constant unit
+  %0 = "onnx.Conv"(%arg0, %arg1, %cst) {auto_pad = "NOTSET", group = 1 : si64} : (tensor<1x16x6x6xf32>, tensor<16x16x3x3xf32>, none) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // AUTO-LABEL: test_conv_3x3_channels
+  // AUTO-NOT: memref<144x16xf32>
+  // AUTO: alloc() : memref<16x16x4x4xf32>
+  // AUTO: return
+}
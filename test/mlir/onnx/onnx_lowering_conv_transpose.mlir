@@ -0,0 +1,35 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl %s -split-input-file | FileCheck %s
+
+/// Each output element gathers the input elements hit by the kernel.
+func @test_conv_transpose(%arg0 : tensor<1x2x3x3xf32>, %arg1 : tensor<2x4x2x2xf32>, %arg2 : tensor<4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ConvTranspose"(%arg0, %arg1, %arg2) {strides = [2, 2]} : (tensor<1x2x3x3xf32>, tensor<2x4x2x2xf32>, tensor<4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-DAG: [[MAP_KERNEL:#.+]] = affine_map<(d0, d1) -> (d0 * 4 + d1)>
+  // CHECK-DAG: [[MAP_CHANNEL:#.+]] = affine_map<(d0, d1) -> (d0 * 2 + d1)>
+  // CHECK-DAG: [[MAP_ROW:#.+]] = affine_map<(d0, d1, d2, d3) -> ((d0 - d2) floordiv 2)>
+  // CHECK-DAG: [[MAP_COL:#.+]] = affine_map<(d0, d1, d2, d3) -> ((d1 - d3) floordiv 2)>
+  // CHECK-DAG: [[HIT:#.+]] = affine_set<(d0, d1, d2, d3) : ({{.*}}mod 2 == 0{{.*}}mod 2 == 0)>
+  // CHECK-LABEL: test_conv_transpose
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x4x6x6xf32>
+  // CHECK: [[OUTER:%.+]]:5 = krnl.define_loops 5
+  // CHECK-DAG: krnl.parallel [[OUTER]]#0 : !krnl.loop
+  // CHECK-DAG: krnl.parallel [[OUTER]]#2 : !krnl.loop
+  // CHECK: krnl.iterate([[OUTER]]#0, [[OUTER]]#1, [[OUTER]]#2, [[OUTER]]#3, [[OUTER]]#4) with ([[OUTER]]#0 -> [[N:%.+]] = 0 to 1, [[OUTER]]#1 -> [[G:%.+]] = 0 to 1, [[OUTER]]#2 -> [[M:%.+]] = 0 to 4, [[OUTER]]#3 -> [[O1:%.+]] = 0 to 6, [[OUTER]]#4 -> [[O2:%.+]] = 0 to 6) {
+  // CHECK:   [[KERNEL:%.+]] = affine.apply [[MAP_KERNEL]]([[G]], [[M]])
+  // CHECK:   [[BIAS:%.+]] = affine.load %arg2{{\[}}[[KERNEL]]{{\]}} : memref<4xf32>
+  // CHECK:   affine.store [[BIAS]], [[RES]]{{\[}}[[N]], [[KERNEL]], [[O1]], [[O2]]{{\]}} : memref<1x4x6x6xf32>
+  // CHECK:   [[INNER:%.+]]:3 = krnl.define_loops 3
+  // CHECK:   krnl.iterate([[INNER]]#0, [[INNER]]#1, [[INNER]]#2) with ([[INNER]]#0 -> [[C:%.+]] = 0 to 2, [[INNER]]#1 -> [[K1:%.+]] = 0 to 2, [[INNER]]#2 -> [[K2:%.+]] = 0 to 2) {
+  // CHECK:     affine.if [[HIT]]([[O1]], [[O2]], [[K1]], [[K2]]) {
+  // CHECK:       [[CHANNEL:%.+]] = affine.apply [[MAP_CHANNEL]]([[G]], [[C]])
+  // CHECK:       [[I1:%.+]] = affine.apply [[MAP_ROW]]([[O1]], [[O2]], [[K1]], [[K2]])
+  // CHECK:       [[I2:%.+]] = affine.apply [[MAP_COL]]([[O1]], [[O2]], [[K1]], [[K2]])
+  // CHECK:       [[DATA:%.+]] = affine.load %arg0{{\[}}[[N]], [[CHANNEL]], [[I1]], [[I2]]{{\]}} : memref<1x2x3x3xf32>
+  // CHECK:       [[WEIGHT:%.+]] = affine.load %arg1{{\[}}[[CHANNEL]], [[M]], [[K1]], [[K2]]{{\]}} : memref<2x4x2x2xf32>
+  // CHECK:       [[PARTIAL:%.+]] = affine.load [[RES]]{{\[}}[[N]], [[KERNEL]], [[O1]], [[O2]]{{\]}} : memref<1x4x6x6xf32>
+  // CHECK:       [[MUL:%.+]] = mulf [[DATA]], [[WEIGHT]] : f32
+  // CHECK:       [[ADD:%.+]] = addf [[PARTIAL]], [[MUL]] : f32
+  // CHECK:       affine.store [[ADD]], [[RES]]{{\[}}[[N]], [[KERNEL]], [[O1]], [[O2]]{{\]}} : memref<1x4x6x6xf32>
+  // CHECK: return [[RES]] : memref<1x4x6x6xf32>
+}
@@ -0,0 +1,56 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl %s -split-input-file | FileCheck %s
+
+/// Only the taken branch is computed. The buffer of the Relu is allocated in
+/// the then branch and yielded, the argument forwarded by the else branch is
+/// copied into a buffer of its own.
+func @test_if(%arg0 : tensor<i1>, %arg1 : tensor<10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.IfRegion"(%arg0) ({
+    %1 = "onnx.Relu"(%arg1) : (tensor<10xf32>) -> tensor<*xf32>
+    "onnx.IfRegionYield"(%1) : (tensor<*xf32>) -> ()
+  }, {
+    "onnx.IfRegionYield"(%arg1) : (tensor<10xf32>) -> ()
+  }) : (tensor<i1>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_if
+  // CHECK: [[COND:%.+]] = load %arg0[] : memref<i1>
+  // CHECK: [[RES:%.+]] = scf.if [[COND]] -> (memref<10xf32>) {
+  // CHECK:   [[RELU:%.+]] = alloc() : memref<10xf32>
+  // CHECK:   krnl.iterate
+  // CHECK-NOT: dealloc
+  // CHECK:   scf.yield [[RELU]] : memref<10xf32>
+  // CHECK: } else {
+  // CHECK:   [[COPY:%.+]] = alloc() : memref<10xf32>
+  // CHECK:   "krnl.memcpy"([[COPY]], %arg1, {{.*}}) : (memref<10xf32>, memref<10xf32>, i64) -> ()
+  // CHECK:   scf.yield [[COPY]] : memref<10xf32>
+  // CHECK: }
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RES]] : memref<10xf32>
+}
+
+// -----
+
+/// The result of the If is freed after its last use.
+func @test_if_dealloc(%arg0 : tensor<1xi1>, %arg1 : tensor<10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.IfRegion"(%arg0) ({
+    %1 = "onnx.Relu"(%arg1) : (tensor<10xf32>) -> tensor<*xf32>
+    "onnx.IfRegionYield"(%1) : (tensor<*xf32>) -> ()
+  }, {
+    %2 = "onnx.Exp"(%arg1) : (tensor<10xf32>) -> tensor<*xf32>
+    "onnx.IfRegionYield"(%2) : (tensor<*xf32>) -> ()
+  }) : (tensor<1xi1>) -> tensor<*xf32>
+  %3 = "onnx.Sqrt"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%3) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_if_dealloc
+  // CHECK: [[C0:%.+]] = constant 0 : index
+  // CHECK: [[COND:%.+]] = load %arg0{{\[}}[[C0]]{{\]}} : memref<1xi1>
+  // CHECK: [[RES:%.+]] = scf.if [[COND]] -> (memref<10xf32>) {
+  // CHECK:   scf.yield
+  // CHECK: } else {
+  // CHECK:   scf.yield
+  // CHECK: }
+  // CHECK: krnl.iterate
+  // CHECK: dealloc [[RES]] : memref<10xf32>
+  // CHECK: return
+}
@@ -0,0 +1,73 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='in-place-elementwise' %s -split-input-file | FileCheck %s
+
+/// The second Exp overwrites the result of the first one which has no other
+/// use, the returned result of the third Exp gets its own buffer.
+func @test_in_place_unary(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Exp"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Exp"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  %2 = "onnx.Exp"(%1) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_in_place_unary
+  // CHECK: [[BUF:%.+]] = alloc({{.*}}) : memref<?x10xf32>
+  // CHECK: [[LOAD0:%.+]] = affine.load %arg0[%arg1, %arg2] : memref<?x10xf32>
+  // CHECK: [[EXP0:%.+]] = exp [[LOAD0]] : f32
+  // CHECK: affine.store [[EXP0]], [[BUF]][%arg1, %arg2] : memref<?x10xf32>
+  // CHECK-NOT: alloc
+  // CHECK: [[LOAD1:%.+]] = affine.load [[BUF]][%arg1, %arg2] : memref<?x10xf32>
+  // CHECK: [[EXP1:%.+]] = exp [[LOAD1]] : f32
+  // CHECK: affine.store [[EXP1]], [[BUF]][%arg1, %arg2] : memref<?x10xf32>
+  // CHECK: [[RES:%.+]] = alloc({{.*}}) : memref<?x10xf32>
+  // CHECK: [[LOAD2:%.+]] = affine.load [[BUF]][%arg1, %arg2] : memref<?x10xf32>
+  // CHECK: [[EXP2:%.+]] = exp [[LOAD2]] : f32
+  // CHECK: affine.store [[EXP2]], [[RES]][%arg1, %arg2] : memref<?x10xf32>
+  // CHECK: dealloc [[BUF]] : memref<?x10xf32>
+  // CHECK-NOT: dealloc
+  // CHECK: return [[RES]] : memref<?x10xf32>
+}
+
+// -----
+
+/// The Add of static shapes overwrites its first input.
+func @test_in_place_binary(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Exp"(%arg0) : (tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Add"(%0, %arg1) : (tensor<*xf32>, tensor<10x10xf32>) -> tensor<*xf32>
+  %2 = "onnx.Exp"(%1) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_in_place_binary
+  // CHECK: [[RES:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK: [[BUF:%.+]] = alloc() : memref<10x10xf32>
+  // CHECK-NOT: alloc
+  // CHECK: affine.store {{.*}}, [[BUF]][%arg2, %arg3] : memref<10x10xf32>
+  // CHECK: [[LOAD0:%.+]] = affine.load [[BUF]][%arg2, %arg3] : memref<10x10xf32>
+  // CHECK: [[LOAD1:%.+]] = affine.load %arg1[%arg2, %arg3] : memref<10x10xf32>
+  // CHECK: [[ADD:%.+]] = addf [[LOAD0]], [[LOAD1]] : f32
+  // CHECK: affine.store [[ADD]], [[BUF]][%arg2, %arg3] : memref<10x10xf32>
+  // CHECK: affine.store {{.*}}, [[RES]][%arg2, %arg3] : memref<10x10xf32>
+  // CHECK: dealloc [[BUF]] : memref<10x10xf32>
+  // CHECK: return [[RES]] : memref<10x10xf32>
+}
+
+// -----
+
+/// The Add of dynamic shapes may broadcast its inputs, and the input of the
+/// second Exp is read again by the Add, so that no buffer is reused.
+func @test_no_in_place(%arg0 : tensor<?x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Exp"(%arg0) : (tensor<?x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Exp"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  %2 = "onnx.Add"(%0, %1) : (tensor<*xf32>, tensor<*xf32>) -> tensor<*xf32>
+  %3 = "onnx.Exp"(%2) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%3) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_no_in_place
+  // CHECK: [[BUF0:%.+]] = alloc({{.*}}) : memref<?x10xf32>
+  // CHECK: affine.store {{.*}}, [[BUF0]][%arg1, %arg2] : memref<?x10xf32>
+  // CHECK: [[BUF1:%.+]] = alloc({{.*}}) : memref<?x10xf32>
+  // CHECK: affine.store {{.*}}, [[BUF1]][%arg1, %arg2] : memref<?x10xf32>
+  // CHECK: [[BUF2:%.+]] = alloc({{.*}}) : memref<?x10xf32>
+  // CHECK: affine.store {{.*}}, [[BUF2]]
+  // CHECK: [[RES:%.+]] = alloc({{.*}}) : memref<?x10xf32>
+  // CHECK: affine.store {{.*}}, [[RES]][%arg1, %arg2] : memref<?x10xf32>
+  // CHECK: return [[RES]] : memref<?x10xf32>
+}
@@ -0,0 +1,19 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='instrument=true' %s -split-input-file | FileCheck %s
+
+func @test_instrument(%arg0 : tensor<10x10xf32>, %arg1 : tensor<10x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) {onnx_node_name = "add0"} : (tensor<10x10xf32>, tensor<10x10xf32>) -> tensor<*xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  /// The loop nest of each operation is surrounded by calls to the profiling hook.
+  // CHECK-LABEL: test_instrument
+  // CHECK: "krnl.instrument"() {nodeName = "add0", opName = "onnx.Add", shapes = "(tensor<10x10xf32>, tensor<10x10xf32>) -> (tensor<10x10xf32>)", tag = 0 : i64} : () -> ()
+  // CHECK: krnl.iterate
+  // CHECK: addf
+  // CHECK: "krnl.instrument"() {nodeName = "add0", opName = "onnx.Add", {{.*}}, tag = 1 : i64} : () -> ()
+  // CHECK: "krnl.instrument"() {nodeName = "", opName = "onnx.Relu", shapes = "(tensor<10x10xf32>) -> (tensor<10x10xf32>)", tag = 0 : i64} : () -> ()
+  // CHECK: krnl.iterate
+  // CHECK: select
+  // CHECK: "krnl.instrument"() {nodeName = "", opName = "onnx.Relu", {{.*}}, tag = 1 : i64} : () -> ()
+  // CHECK: return
+}
@@ -0,0 +1,93 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='enable-matmul-tiling matmul-cache-tile-m=8 matmul-cache-tile-n=16 matmul-cache-tile-k=8 matmul-register-tile-m=4 matmul-register-tile-n=8' %s -split-input-file | FileCheck %s
+
+func @test_matmul_tiled(%arg0 : tensor<16x32xf32>, %arg1 : tensor<32x64xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<16x32xf32>, tensor<32x64xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_matmul_tiled
+  // CHECK: [[RES:%.+]] = alloc() : memref<16x64xf32>
+  // CHECK: [[CONSTANT:%.+]] = constant 0.000000e+00 : f32
+  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg2 = 0 to 16, [[DEF_LOOPS]]#1 -> %arg3 = 0 to 64) {
+  // CHECK:   affine.store [[CONSTANT]], [[RES]][%arg2, %arg3] : memref<16x64xf32>
+  // CHECK: }
+  // CHECK: [[LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK: [[IB:%.+]], [[IL:%.+]] = krnl.block [[LOOPS]]#0 8 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[JB:%.+]], [[JL:%.+]] = krnl.block [[LOOPS]]#1 16 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[KB:%.+]], [[KL:%.+]] = krnl.block [[LOOPS]]#2 8 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[IRB:%.+]], [[IR:%.+]] = krnl.block [[IL]] 4 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[JRB:%.+]], [[JR:%.+]] = krnl.block [[JL]] 8 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: krnl.permute([[IB]], [[IRB]], [[IR]], [[JB]], [[JRB]], [[JR]], [[KB]], [[KL]]) [2, 3, 6, 0, 4, 7, 1, 5]
+  // CHECK: krnl.unroll [[JR]] : !krnl.loop
+  // CHECK: krnl.unroll [[IR]] : !krnl.loop
+  // CHECK: krnl.parallel [[JB]] : !krnl.loop
+  // CHECK: krnl.iterate([[JB]], [[KB]], [[IB]], [[IRB]], [[JRB]], [[KL]], [[IR]], [[JR]]) with ([[LOOPS]]#0 -> %arg2 = 0 to 16, [[LOOPS]]#1 -> %arg3 = 0 to 64, [[LOOPS]]#2 -> %arg4 = 0 to 32) {
+  // CHECK:   [[LOAD_0:%.+]] = affine.load %arg0[%arg2, %arg4] : memref<16x32xf32>
+  // CHECK:   [[LOAD_1:%.+]] = affine.load %arg1[%arg4, %arg3] : memref<32x64xf32>
+  // CHECK:   [[LOAD_RES:%.+]] = affine.load [[RES]][%arg2, %arg3] : memref<16x64xf32>
+  // CHECK:   [[MUL:%.+]] = mulf [[LOAD_0]], [[LOAD_1]] : f32
+  // CHECK:   [[ADD:%.+]] = addf [[LOAD_RES]], [[MUL]] : f32
+  // CHECK:   affine.store [[ADD]], [[RES]][%arg2, %arg3] : memref<16x64xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<16x64xf32>
+}
+
+// -----
+
+/// Dynamic dimensions fall back to the untiled lowering.
+func @test_matmul_dynamic_not_tiled(%arg0 : tensor<?x32xf32>, %arg1 : tensor<32x64xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<?x32xf32>, tensor<32x64xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_matmul_dynamic_not_tiled
+  // CHECK-NOT: krnl.block
+  // CHECK: [[DEF_LOOPS_REDUCE:%.+]] = krnl.define_loops 1
+  // CHECK-NOT: krnl.block
+  // CHECK: return
+}
+
+// -----
+
+/// The batches and rows of A form the rows of a single tiled matrix
+/// multiplication by the weight matrix B shared by the batches.
+func @test_matmul_tiled_shared_weights(%arg0 : tensor<2x8x16xf32>, %arg1 : tensor<16x32xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<2x8x16xf32>, tensor<16x32xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_matmul_tiled_shared_weights
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x8x32xf32>
+  // CHECK: [[A:%.+]] = "krnl.reshape"(%arg0) : (memref<2x8x16xf32>) -> memref<16x16xf32>
+  // CHECK: [[RES_VIEW:%.+]] = "krnl.reshape"([[RES]]) : (memref<2x8x32xf32>) -> memref<16x32xf32>
+  // CHECK: [[DEF_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[DEF_LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[DEF_LOOPS]]#0, [[DEF_LOOPS]]#1) with ([[DEF_LOOPS]]#0 -> %arg2 = 0 to 16, [[DEF_LOOPS]]#1 -> %arg3 = 0 to 32) {
+  // CHECK:   affine.store {{.*}}, [[RES_VIEW]][%arg2, %arg3] : memref<16x32xf32>
+  // CHECK: }
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> %arg2 = 0 to 16, {{.*}} -> %arg3 = 0 to 32, {{.*}} -> %arg4 = 0 to 16) {
+  // CHECK:   [[LOAD_0:%.+]] = affine.load [[A]][%arg2, %arg4] : memref<16x16xf32>
+  // CHECK:   [[LOAD_1:%.+]] = affine.load %arg1[%arg4, %arg3] : memref<16x32xf32>
+  // CHECK:   [[LOAD_RES:%.+]] = affine.load [[RES_VIEW]][%arg2, %arg3] : memref<16x32xf32>
+  // CHECK:   affine.store {{.*}}, [[RES_VIEW]][%arg2, %arg3] : memref<16x32xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<2x8x32xf32>
+}
+
+// -----
+
+/// All the batch loops are parallel, and A is broadcast along the first one.
+func @test_matmul_tiled_broadcast_batch(%arg0 : tensor<1x3x8x8xf32>, %arg1 : tensor<2x3x8x8xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<1x3x8x8xf32>, tensor<2x3x8x8xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_matmul_tiled_broadcast_batch
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x3x8x8xf32>
+  // CHECK: [[LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.parallel [[LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.parallel [[LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate([[LOOPS]]#0, [[LOOPS]]#1) with ([[LOOPS]]#0 -> %arg2 = 0 to 2, [[LOOPS]]#1 -> %arg3 = 0 to 3) {
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> %arg4 = 0 to 8, {{.*}} -> %arg5 = 0 to 8, {{.*}} -> %arg6 = 0 to 8) {
+  // CHECK:     [[ZERO:%.+]] = constant 0 : index
+  // CHECK:     [[LOAD_0:%.+]] = affine.load %arg0{{\[}}[[ZERO]], %arg3, %arg4, %arg6] : memref<1x3x8x8xf32>
+  // CHECK:     [[LOAD_1:%.+]] = affine.load %arg1[%arg2, %arg3, %arg6, %arg5] : memref<2x3x8x8xf32>
+  // CHECK:     affine.store {{.*}}, [[RES]][%arg2, %arg3, %arg4, %arg5] : memref<2x3x8x8xf32>
+}
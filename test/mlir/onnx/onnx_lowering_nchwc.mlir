@@ -0,0 +1,58 @@
+// RUN: onnx-mlir-opt --convert-onnx-to-krnl %s -split-input-file | FileCheck %s
+
+func @test_layout_transform_nchwc(%arg0 : tensor<1x16x4x4xf32>) -> tensor<1x2x4x4x8xf32> {
+  %0 = "onnx.LayoutTransform"(%arg0) {block_size = 8 : i64, target_layout = "NCHWc"} : (tensor<1x16x4x4xf32>) -> tensor<1x2x4x4x8xf32>
+  "std.return"(%0) : (tensor<1x2x4x4x8xf32>) -> ()
+
+  // CHECK-LABEL: test_layout_transform_nchwc
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x2x4x4x8xf32>
+  // CHECK: [[LOOPS:%.+]]:5 = krnl.define_loops 5
+  // CHECK: krnl.parallel [[LOOPS]]#0 : !krnl.loop
+  // CHECK: krnl.iterate([[LOOPS]]#0, [[LOOPS]]#1, [[LOOPS]]#2, [[LOOPS]]#3, [[LOOPS]]#4) with ([[LOOPS]]#0 -> [[N:%.+]] = 0 to 1, [[LOOPS]]#1 -> [[CB:%.+]] = 0 to 2, [[LOOPS]]#2 -> [[H:%.+]] = 0 to 4, [[LOOPS]]#3 -> [[W:%.+]] = 0 to 4, [[LOOPS]]#4 -> [[CI:%.+]] = 0 to 8) {
+  // CHECK:   [[LOAD:%.+]] = affine.load %arg0{{\[}}[[N]], [[CB]] * 8 + [[CI]], [[H]], [[W]]{{\]}} : memref<1x16x4x4xf32>
+  // CHECK:   affine.store [[LOAD]], [[RES]]{{\[}}[[N]], [[CB]], [[H]], [[W]], [[CI]]{{\]}} : memref<1x2x4x4x8xf32>
+}
+
+// -----
+
+func @test_layout_transform_nchw(%arg0 : tensor<1x2x4x4x8xf32>) -> tensor<1x16x4x4xf32> {
+  %0 = "onnx.LayoutTransform"(%arg0) {block_size = 8 : i64, target_layout = "NCHW"} : (tensor<1x2x4x4x8xf32>) -> tensor<1x16x4x4xf32>
+  "std.return"(%0) : (tensor<1x16x4x4xf32>) -> ()
+
+  // CHECK-LABEL: test_layout_transform_nchw
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x16x4x4xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[N:%.+]] = 0 to 1, {{.*}} -> [[C:%.+]] = 0 to 16, {{.*}} -> [[H:%.+]] = 0 to 4, {{.*}} -> [[W:%.+]] = 0 to 4) {
+  // CHECK:   [[LOAD:%.+]] = affine.load %arg0{{\[}}[[N]], [[C]] floordiv 8, [[H]], [[W]], [[C]] mod 8{{\]}} : memref<1x2x4x4x8xf32>
+  // CHECK:   affine.store [[LOAD]], [[RES]]{{\[}}[[N]], [[C]], [[H]], [[W]]{{\]}} : memref<1x16x4x4xf32>
+}
+
+// -----
+
+func @test_conv_nchwc(%arg0 : tensor<1x1x6x6x8xf32>, %arg1 : tensor<2x1x3x3x8x8xf32>, %arg2 : tensor<16xf32>) -> tensor<1x2x2x2x8xf32> {
+  %0 = "onnx.ConvNCHWc"(%arg0, %arg1, %arg2) {strides = [2, 2]} : (tensor<1x1x6x6x8xf32>, tensor<2x1x3x3x8x8xf32>, tensor<16xf32>) -> tensor<1x2x2x2x8xf32>
+  "std.return"(%0) : (tensor<1x2x2x2x8xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_nchwc
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x2x2x2x8xf32>
+  // CHECK: [[OUTER_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.parallel [[OUTER_LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[N:%.+]] = 0 to 1, {{.*}} -> [[MB:%.+]] = 0 to 2, {{.*}} -> [[R1:%.+]] = 0 to 2, {{.*}} -> [[R2:%.+]] = 0 to 2) {
+
+  /// Initialize the block of output channels with the bias.
+  // CHECK: [[INIT_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.iterate([[INIT_LOOP]]) with ([[INIT_LOOP]] -> [[MI:%.+]] = 0 to 8) {
+  // CHECK:   [[BIAS:%.+]] = affine.load %arg2{{\[}}[[MB]] * 8 + [[MI]]{{\]}} : memref<16xf32>
+  // CHECK:   affine.store [[BIAS]], [[RES]]{{\[}}[[N]], [[MB]], [[R1]], [[R2]], [[MI]]{{\]}} : memref<1x2x2x2x8xf32>
+
+  /// Accumulate the products, the innermost loop walking the output channels.
+  // CHECK: [[RED_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[CB:%.+]] = 0 to 1, {{.*}} -> [[K1:%.+]] = 0 to 3, {{.*}} -> [[K2:%.+]] = 0 to 3, {{.*}} -> [[CI:%.+]] = 0 to 8) {
+  // CHECK:   [[DATA:%.+]] = affine.load %arg0{{\[}}[[N]], [[CB]], [[R1]] * 2 + [[K1]], [[R2]] * 2 + [[K2]], [[CI]]{{\]}} : memref<1x1x6x6x8xf32>
+  // CHECK:   [[CHANNEL_LOOP:%.+]] = krnl.define_loops 1
+  // CHECK:   krnl.iterate([[CHANNEL_LOOP]]) with ([[CHANNEL_LOOP]] -> [[MI2:%.+]] = 0 to 8) {
+  // CHECK:     [[KERNEL:%.+]] = affine.load %arg1{{\[}}[[MB]], [[CB]], [[K1]], [[K2]], [[CI]], [[MI2]]{{\]}} : memref<2x1x3x3x8x8xf32>
+  // CHECK:     [[PARTIAL:%.+]] = affine.load [[RES]]{{\[}}[[N]], [[MB]], [[R1]], [[R2]], [[MI2]]{{\]}} : memref<1x2x2x2x8xf32>
+  // CHECK:     [[MUL:%.+]] = mulf [[DATA]], [[KERNEL]] : f32
+  // CHECK:     [[ADD:%.+]] = addf [[PARTIAL]], [[MUL]] : f32
+  // CHECK:     affine.store [[ADD]], [[RES]]{{\[}}[[N]], [[MB]], [[R1]], [[R2]], [[MI2]]{{\]}} : memref<1x2x2x2x8xf32>
+}
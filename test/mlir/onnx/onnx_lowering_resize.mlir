@@ -0,0 +1,59 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl %s -split-input-file | FileCheck %s
+
+/// The nearest input elements are gathered through index tables.
+func @test_resize_nearest(%arg0 : tensor<1x1x2x2xf32>, %arg1 : tensor<0xf32>) -> tensor<*xf32> {
+  %scales = "onnx.Constant"() {value = dense<[1.0, 1.0, 2.0, 2.0]> : tensor<4xf32>} : () -> tensor<4xf32>
+  %cst = constant unit
+  %0 = "onnx.Resize"(%arg0, %arg1, %scales, %cst) : (tensor<1x1x2x2xf32>, tensor<0xf32>, tensor<4xf32>, none) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_resize_nearest
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x1x4x4xf32>
+  // CHECK: [[ROWS:%.+]] = "krnl.global"() {name = "resize_{{[0-9]+}}", shape = [4], value = dense<[0, 0, 1, 1]> : tensor<4xi64>} : () -> memref<4xi64>
+  // CHECK: [[COLS:%.+]] = "krnl.global"() {name = "resize_{{[0-9]+}}", shape = [4], value = dense<[0, 0, 1, 1]> : tensor<4xi64>} : () -> memref<4xi64>
+  // CHECK: [[LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK-DAG: krnl.parallel [[LOOPS]]#0 : !krnl.loop
+  // CHECK-DAG: krnl.parallel [[LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate([[LOOPS]]#0, [[LOOPS]]#1, [[LOOPS]]#2, [[LOOPS]]#3) with ([[LOOPS]]#0 -> [[N:%.+]] = 0 to 1, [[LOOPS]]#1 -> [[C:%.+]] = 0 to 1, [[LOOPS]]#2 -> [[O1:%.+]] = 0 to 4, [[LOOPS]]#3 -> [[O2:%.+]] = 0 to 4) {
+  // CHECK:   [[ROW_I64:%.+]] = affine.load [[ROWS]]{{\[}}[[O1]]{{\]}} : memref<4xi64>
+  // CHECK:   [[ROW:%.+]] = index_cast [[ROW_I64]] : i64 to index
+  // CHECK:   [[COL_I64:%.+]] = affine.load [[COLS]]{{\[}}[[O2]]{{\]}} : memref<4xi64>
+  // CHECK:   [[COL:%.+]] = index_cast [[COL_I64]] : i64 to index
+  // CHECK:   [[VALUE:%.+]] = load %arg0{{\[}}[[N]], [[C]], [[ROW]], [[COL]]{{\]}} : memref<1x1x2x2xf32>
+  // CHECK:   affine.store [[VALUE]], [[RES]]{{\[}}[[N]], [[C]], [[O1]], [[O2]]{{\]}} : memref<1x1x4x4xf32>
+  // CHECK: return [[RES]] : memref<1x1x4x4xf32>
+}
+
+// -----
+
+/// The linear interpolation is separable: the shrunk axis is interpolated
+/// first, into an intermediate buffer, then the enlarged one.
+func @test_resize_linear(%arg0 : tensor<1x1x2x4xf32>, %arg1 : tensor<0xf32>) -> tensor<*xf32> {
+  %scales = "onnx.Constant"() {value = dense<[1.0, 1.0, 2.0, 0.5]> : tensor<4xf32>} : () -> tensor<4xf32>
+  %cst = constant unit
+  %0 = "onnx.Resize"(%arg0, %arg1, %scales, %cst) {coordinate_transformation_mode = "asymmetric", mode = "linear"} : (tensor<1x1x2x4xf32>, tensor<0xf32>, tensor<4xf32>, none) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_resize_linear
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x1x4x2xf32>
+  // CHECK: [[TMP:%.+]] = alloc() : memref<1x1x2x2xf32>
+  // CHECK: [[LO3:%.+]] = "krnl.global"() {name = "resize_{{[0-9]+}}", shape = [2], value = dense<[0, 2]> : tensor<2xi64>} : () -> memref<2xi64>
+  // CHECK: [[HI3:%.+]] = "krnl.global"() {name = "resize_{{[0-9]+}}", shape = [2], value = dense<[1, 3]> : tensor<2xi64>} : () -> memref<2xi64>
+  // CHECK: [[W3:%.+]] = "krnl.global"() {name = "resize_{{[0-9]+}}", shape = [2], value = dense<0.000000e+00> : tensor<2xf32>} : () -> memref<2xf32>
+  // CHECK: krnl.iterate
+  // CHECK:   [[LO:%.+]] = load %arg0
+  // CHECK:   [[HI:%.+]] = load %arg0
+  // CHECK:   [[DIFF:%.+]] = subf [[HI]], [[LO]] : f32
+  // CHECK:   [[MUL:%.+]] = mulf {{.*}}, [[DIFF]] : f32
+  // CHECK:   [[ADD:%.+]] = addf [[LO]], [[MUL]] : f32
+  // CHECK:   affine.store [[ADD]], [[TMP]]
+  // CHECK: [[LO2:%.+]] = "krnl.global"() {name = "resize_{{[0-9]+}}", shape = [4], value = dense<[0, 0, 1, 1]> : tensor<4xi64>} : () -> memref<4xi64>
+  // CHECK: [[HI2:%.+]] = "krnl.global"() {name = "resize_{{[0-9]+}}", shape = [4], value = dense<1> : tensor<4xi64>} : () -> memref<4xi64>
+  // CHECK: [[W2:%.+]] = "krnl.global"() {name = "resize_{{[0-9]+}}", shape = [4], value = dense<[0.000000e+00, 5.000000e-01, 0.000000e+00, 0.000000e+00]> : tensor<4xf32>} : () -> memref<4xf32>
+  // CHECK: krnl.iterate
+  // CHECK:   load [[TMP]]
+  // CHECK:   load [[TMP]]
+  // CHECK:   affine.store {{.*}}, [[RES]]
+  // CHECK: dealloc [[TMP]] : memref<1x1x2x2xf32>
+  // CHECK: return [[RES]] : memref<1x1x4x2xf32>
+}
@@ -0,0 +1,84 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl %s -split-input-file | FileCheck %s
+
+/// The data is copied into the output with a krnl.memcpy. The updates at
+/// different columns never store to the same element, so the loop over the
+/// columns is parallel.
+func @test_scatter_elements(%arg0 : tensor<3x3xf32>, %arg1 : tensor<2x3xi64>, %arg2 : tensor<2x3xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ScatterElements"(%arg0, %arg1, %arg2) {axis = 0 : si64} : (tensor<3x3xf32>, tensor<2x3xi64>, tensor<2x3xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_scatter_elements
+  // CHECK: [[RES:%.+]] = alloc() : memref<3x3xf32>
+  // CHECK: [[SIZE:%.+]] = constant 36 : i64
+  // CHECK: "krnl.memcpy"([[RES]], %arg0, [[SIZE]]) : (memref<3x3xf32>, memref<3x3xf32>, i64) -> ()
+  // CHECK: [[LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.parallel [[LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate([[LOOPS]]#0, [[LOOPS]]#1) with ([[LOOPS]]#0 -> [[I:%.+]] = 0 to 2, [[LOOPS]]#1 -> [[J:%.+]] = 0 to 3) {
+  // CHECK:   [[UPDATE:%.+]] = affine.load %arg2{{\[}}[[I]], [[J]]{{\]}} : memref<2x3xf32>
+  // CHECK:   [[RAW:%.+]] = load %arg1{{\[}}[[I]], [[J]]{{\]}} : memref<2x3xi64>
+  // CHECK:   [[RAW_INDEX:%.+]] = index_cast [[RAW]] : i64 to index
+  // CHECK:   [[INDEX:%.+]] = select {{.*}}, {{.*}}, [[RAW_INDEX]] : index
+  // CHECK:   store [[UPDATE]], [[RES]]{{\[}}[[INDEX]], [[J]]{{\]}} : memref<3x3xf32>
+  // CHECK: return [[RES]] : memref<3x3xf32>
+}
+
+// -----
+
+/// The output overwrites the data, which has no other use.
+func @test_scatter_elements_in_place(%arg0 : tensor<1x5xf32>, %arg1 : tensor<1x2xi64>, %arg2 : tensor<1x2xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Relu"(%arg0) : (tensor<1x5xf32>) -> tensor<*xf32>
+  %1 = "onnx.ScatterElements"(%0, %arg1, %arg2) {axis = -1 : si64} : (tensor<*xf32>, tensor<1x2xi64>, tensor<1x2xf32>) -> tensor<*xf32>
+  %2 = "onnx.Exp"(%1) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_scatter_elements_in_place
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x5xf32>
+  // CHECK: [[RELU:%.+]] = alloc() : memref<1x5xf32>
+  // CHECK-NOT: alloc
+  // CHECK-NOT: krnl.memcpy
+  // CHECK: krnl.parallel {{.*}}#0 : !krnl.loop
+  // CHECK: store {{.*}}, [[RELU]]{{\[}}{{.*}}{{\]}} : memref<1x5xf32>
+  // CHECK: dealloc [[RELU]] : memref<1x5xf32>
+  // CHECK: return [[RES]] : memref<1x5xf32>
+}
+
+// -----
+
+/// The indices have no duplicate tuples, the updates are stored in parallel.
+func @test_scatter_nd(%arg0 : tensor<8xf32>, %arg1 : tensor<4x1xi64>, %arg2 : tensor<4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ScatterND"(%arg0, %arg1, %arg2) : (tensor<8xf32>, tensor<4x1xi64>, tensor<4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_scatter_nd
+  // CHECK: [[RES:%.+]] = alloc() : memref<8xf32>
+  // CHECK: "krnl.memcpy"([[RES]], %arg0, {{.*}}) : (memref<8xf32>, memref<8xf32>, i64) -> ()
+  // CHECK: [[LOOP:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[LOOP]] : !krnl.loop
+  // CHECK: krnl.iterate([[LOOP]]) with ([[LOOP]] -> [[I:%.+]] = 0 to 4) {
+  // CHECK:   [[C0:%.+]] = constant 0 : index
+  // CHECK:   [[RAW:%.+]] = load %arg1{{\[}}[[I]], [[C0]]{{\]}} : memref<4x1xi64>
+  // CHECK:   [[INDEX:%.+]] = select
+  // CHECK:   [[UPDATE:%.+]] = affine.load %arg2{{\[}}[[I]]{{\]}} : memref<4xf32>
+  // CHECK:   store [[UPDATE]], [[RES]]{{\[}}[[INDEX]]{{\]}} : memref<8xf32>
+}
+
+// -----
+
+/// The slices of 64 bytes are copied with one krnl.memcpy each.
+func @test_scatter_nd_slices(%arg0 : tensor<4x4x4xf32>, %arg1 : tensor<2x1xi64>, %arg2 : tensor<2x4x4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ScatterND"(%arg0, %arg1, %arg2) : (tensor<4x4x4xf32>, tensor<2x1xi64>, tensor<2x4x4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-DAG: [[SRC_MAP:#.+]] = affine_map<(d0) -> (d0 * 16)>
+  // CHECK-LABEL: test_scatter_nd_slices
+  // CHECK: [[RES:%.+]] = alloc() : memref<4x4x4xf32>
+  // CHECK: "krnl.memcpy"([[RES]], %arg0, {{.*}}) : (memref<4x4x4xf32>, memref<4x4x4xf32>, i64) -> ()
+  // CHECK: [[LOOP:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[LOOP]] : !krnl.loop
+  // CHECK: krnl.iterate([[LOOP]]) with ([[LOOP]] -> [[I:%.+]] = 0 to 2) {
+  // CHECK:   [[INDEX:%.+]] = select
+  // CHECK:   [[DEST:%.+]] = addi
+  // CHECK:   [[SRC:%.+]] = affine.apply [[SRC_MAP]]([[I]])
+  // CHECK:   [[SIZE:%.+]] = constant 64 : i64
+  // CHECK:   "krnl.memcpy"([[RES]], %arg2, [[SIZE]], [[DEST]], [[SRC]]) : (memref<4x4x4xf32>, memref<2x4x4xf32>, i64, index, index) -> ()
+}
@@ -0,0 +1,60 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl %s -split-input-file | FileCheck %s
+
+/// The K selected elements of each row are kept in a heap stored in the rows
+/// of the outputs, the rows being processed in parallel.
+func @test_topk(%arg0 : tensor<3x5xf32>) -> (tensor<*xf32>, tensor<*xi64>) {
+  %k = "onnx.Constant"() {value = dense<[2]> : tensor<1xi64>} : () -> tensor<1xi64>
+  %0, %1 = "onnx.TopK"(%arg0, %k) : (tensor<3x5xf32>, tensor<1xi64>) -> (tensor<*xf32>, tensor<*xi64>)
+  "std.return"(%0, %1) : (tensor<*xf32>, tensor<*xi64>) -> ()
+
+  // CHECK-LABEL: test_topk
+  // CHECK: [[VALUES:%.+]] = alloc() : memref<3x2xf32>
+  // CHECK: [[INDICES:%.+]] = alloc() : memref<3x2xi64>
+  // CHECK: [[ROWS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[ROWS]] : !krnl.loop
+  // CHECK: krnl.iterate([[ROWS]]) with ([[ROWS]] -> [[I:%.+]] = 0 to 3) {
+
+  /// Fill the heap.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 0 to 2) {
+  // CHECK:   [[X:%.+]] = affine.load %arg0{{\[}}[[I]], [[J]]{{\]}} : memref<3x5xf32>
+  // CHECK:   [[J_I64:%.+]] = index_cast [[J]] : index to i64
+  // CHECK:   store [[X]], [[VALUES]]{{\[}}[[I]], [[J]]{{\]}} : memref<3x2xf32>
+  // CHECK:   store [[J_I64]], [[INDICES]]{{\[}}[[I]], [[J]]{{\]}} : memref<3x2xi64>
+
+  /// Heapify.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} = 0 to 1) {
+  // CHECK:   scf.for {{.*}} iter_args({{.*}}) -> (index, i1) {
+  // CHECK:     scf.if {{.*}} -> (index, i1) {
+
+  /// Insert the rest of the row when better than the root.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 2 to 5) {
+  // CHECK:   [[X:%.+]] = affine.load %arg0{{\[}}[[I]], [[J]]{{\]}} : memref<3x5xf32>
+  // CHECK:   [[ROOT:%.+]] = load [[VALUES]]{{\[}}[[I]], {{.*}}{{\]}} : memref<3x2xf32>
+  // CHECK:   cmpf "olt", [[ROOT]], [[X]] : f32
+  // CHECK:   scf.if {{.*}} {
+  // CHECK:     store [[X]], [[VALUES]]{{\[}}[[I]], {{.*}}{{\]}} : memref<3x2xf32>
+  // CHECK:     scf.for
+
+  /// Sort the heap.
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} = 0 to 1) {
+  // CHECK: return [[VALUES]], [[INDICES]] : memref<3x2xf32>, memref<3x2xi64>
+}
+
+// -----
+
+/// The smallest elements are selected with largest = 0.
+func @test_topk_smallest(%arg0 : tensor<4x3xf32>) -> (tensor<*xf32>, tensor<*xi64>) {
+  %k = "onnx.Constant"() {value = dense<[2]> : tensor<1xi64>} : () -> tensor<1xi64>
+  %0, %1 = "onnx.TopK"(%arg0, %k) {axis = 0 : si64, largest = 0 : si64} : (tensor<4x3xf32>, tensor<1xi64>) -> (tensor<*xf32>, tensor<*xi64>)
+  "std.return"(%0, %1) : (tensor<*xf32>, tensor<*xi64>) -> ()
+
+  // CHECK-LABEL: test_topk_smallest
+  // CHECK: [[VALUES:%.+]] = alloc() : memref<2x3xf32>
+  // CHECK: [[INDICES:%.+]] = alloc() : memref<2x3xi64>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[I:%.+]] = 0 to 3) {
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 2 to 4) {
+  // CHECK:   [[X:%.+]] = affine.load %arg0{{\[}}[[J]], [[I]]{{\]}} : memref<4x3xf32>
+  // CHECK:   [[ROOT:%.+]] = load [[VALUES]]{{\[}}{{.*}}, [[I]]{{\]}} : memref<2x3xf32>
+  // CHECK:   cmpf "ogt", [[ROOT]], [[X]] : f32
+  // CHECK: return [[VALUES]], [[INDICES]] : memref<2x3xf32>, memref<2x3xi64>
+}
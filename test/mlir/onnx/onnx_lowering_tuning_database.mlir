@@ -0,0 +1,32 @@
+// RUN: echo "onnx.MatMul 16x32,32x64 test:cpu cache-tile-m=8 cache-tile-n=16 cache-tile-k=8 register-tile-m=2 register-tile-n=4 cache-loop-order=mnk" > %t.tune
+// RUN: echo "onnx.MatMul 16x32,32x32 other:cpu cache-tile-m=8" >> %t.tune
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='tuning-database=%t.tune tuning-target=test:cpu' %s -split-input-file | FileCheck %s
+
+/// The MatMul is tiled with the parameters of its entry in the database.
+func @test_matmul_tuned(%arg0 : tensor<16x32xf32>, %arg1 : tensor<32x64xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<16x32xf32>, tensor<32x64xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_matmul_tuned
+  // CHECK: [[LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK: [[IB:%.+]], [[IL:%.+]] = krnl.block [[LOOPS]]#0 8 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[JB:%.+]], [[JL:%.+]] = krnl.block [[LOOPS]]#1 16 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[KB:%.+]], [[KL:%.+]] = krnl.block [[LOOPS]]#2 8 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[IRB:%.+]], [[IR:%.+]] = krnl.block [[IL]] 2 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: [[JRB:%.+]], [[JR:%.+]] = krnl.block [[JL]] 4 : (!krnl.loop) -> (!krnl.loop, !krnl.loop)
+  // CHECK: krnl.permute([[IB]], [[IRB]], [[IR]], [[JB]], [[JRB]], [[JR]], [[KB]], [[KL]]) [0, 3, 6, 1, 4, 7, 2, 5]
+  // CHECK: krnl.parallel [[JB]] : !krnl.loop
+  // CHECK: krnl.iterate([[IB]], [[JB]], [[KB]], [[IRB]], [[JRB]], [[KL]], [[IR]], [[JR]]) with ([[LOOPS]]#0 -> %arg2 = 0 to 16, [[LOOPS]]#1 -> %arg3 = 0 to 64, [[LOOPS]]#2 -> %arg4 = 0 to 32) {
+}
+
+// -----
+
+/// The entry of this shape is for another target, the MatMul is not tiled.
+func @test_matmul_other_target(%arg0 : tensor<16x32xf32>, %arg1 : tensor<32x32xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<16x32xf32>, tensor<32x32xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_matmul_other_target
+  // CHECK-NOT: krnl.block
+  // CHECK: return
+}
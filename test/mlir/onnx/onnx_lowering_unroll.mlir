@@ -0,0 +1,56 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='unroll-threshold=64' %s -split-input-file | FileCheck %s
+
+/// The loops of a 4x4 MatMul are fully unrolled, innermost first, and not
+/// parallelized.
+func @test_unroll_matmul(%arg0 : tensor<4x4xf32>, %arg1 : tensor<4x4xf32>) -> tensor<*xf32> {
+  %0 ="onnx.MatMul"(%arg0, %arg1) : (tensor<4x4xf32>, tensor<4x4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_unroll_matmul
+  // CHECK: [[LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK-NEXT: krnl.unroll [[LOOPS]]#1 : !krnl.loop
+  // CHECK-NEXT: krnl.unroll [[LOOPS]]#0 : !krnl.loop
+  // CHECK-NOT: krnl.parallel
+  // CHECK: krnl.iterate([[LOOPS]]#0, [[LOOPS]]#1)
+  // CHECK: [[REDUCE:%.+]] = krnl.define_loops 1
+  // CHECK-NEXT: krnl.unroll [[REDUCE]] : !krnl.loop
+  // CHECK: krnl.iterate([[REDUCE]])
+}
+
+// -----
+
+/// The loops of a Gemm of 3x3 matrices are fully unrolled, and its operands
+/// are not packed.
+func @test_unroll_gemm(%arg0 : tensor<3x3xf32>, %arg1 : tensor<3x3xf32>, %arg2 : tensor<3xf32>) -> tensor<*xf32> {
+  %0 ="onnx.Gemm"(%arg0, %arg1, %arg2) {transA = 1 : si64} : (tensor<3x3xf32>, tensor<3x3xf32>, tensor<3xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_unroll_gemm
+  // CHECK: [[LOOPS:%.+]]:3 = krnl.define_loops 3
+  // CHECK-NEXT: krnl.unroll [[LOOPS]]#2 : !krnl.loop
+  // CHECK-NEXT: krnl.unroll [[LOOPS]]#1 : !krnl.loop
+  // CHECK-NEXT: krnl.unroll [[LOOPS]]#0 : !krnl.loop
+  // CHECK-NOT: krnl.parallel
+  // CHECK: krnl.iterate([[LOOPS]]#0, [[LOOPS]]#1)
+  // CHECK: affine.load %arg0
+}
+
+// -----
+
+/// Element-wise operations of at most 64 elements are unrolled, larger ones
+/// are parallelized.
+func @test_unroll_elementwise(%arg0 : tensor<4x16xf32>, %arg1 : tensor<4x32xf32>) -> (tensor<*xf32>, tensor<*xf32>) {
+  %0 = "onnx.Relu"(%arg0) : (tensor<4x16xf32>) -> tensor<*xf32>
+  %1 = "onnx.Relu"(%arg1) : (tensor<4x32xf32>) -> tensor<*xf32>
+  "std.return"(%0, %1) : (tensor<*xf32>, tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_unroll_elementwise
+  // CHECK: [[LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK-NEXT: krnl.unroll [[LOOPS]]#1 : !krnl.loop
+  // CHECK-NEXT: krnl.unroll [[LOOPS]]#0 : !krnl.loop
+  // CHECK-NEXT: krnl.iterate([[LOOPS]]#0, [[LOOPS]]#1)
+  // CHECK: [[LOOPS2:%.+]]:2 = krnl.define_loops 2
+  // CHECK-NEXT: krnl.parallel [[LOOPS2]]#0 : !krnl.loop
+  // CHECK-NOT: krnl.unroll
+  // CHECK: krnl.iterate([[LOOPS2]]#0, [[LOOPS2]]#1)
+}
@@ -0,0 +1,370 @@
+// RUN: onnx-mlir-opt --shape-inference --convert-onnx-to-krnl='vector-bits=256' %s -split-input-file | FileCheck %s
+
+func @test_add_vectorized(%arg0 : tensor<2x20xf32>, %arg1 : tensor<2x20xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<2x20xf32>, tensor<2x20xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_add_vectorized
+  // CHECK: [[RES:%.+]] = alloc() : memref<2x20xf32>
+  // CHECK: [[VEC_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[VEC_LOOPS]]#0, [[VEC_LOOPS]]#1) with ([[VEC_LOOPS]]#0 -> [[I:%.+]] = 0 to 2, [[VEC_LOOPS]]#1 -> [[J:%.+]] = 0 to 2) {
+  // CHECK: [[LOAD1:%.+]] = affine.vector_load %arg0{{\[}}[[I]], [[J]] * 8{{\]}} : memref<2x20xf32>, vector<8xf32>
+  // CHECK: [[LOAD2:%.+]] = affine.vector_load %arg1{{\[}}[[I]], [[J]] * 8{{\]}} : memref<2x20xf32>, vector<8xf32>
+  // CHECK: [[ADD:%.+]] = addf [[LOAD1]], [[LOAD2]] : vector<8xf32>
+  // CHECK: affine.vector_store [[ADD]], [[RES]]{{\[}}[[I]], [[J]] * 8{{\]}} : memref<2x20xf32>, vector<8xf32>
+
+  /// Scalar remainder loop.
+  // CHECK: [[REM_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[REM_LOOPS]]#0, [[REM_LOOPS]]#1) with ([[REM_LOOPS]]#0 -> [[I2:%.+]] = 0 to 2, [[REM_LOOPS]]#1 -> [[J2:%.+]] = 16 to 20) {
+  // CHECK: [[LOAD3:%.+]] = affine.load %arg0{{\[}}[[I2]], [[J2]]{{\]}} : memref<2x20xf32>
+  // CHECK: [[LOAD4:%.+]] = affine.load %arg1{{\[}}[[I2]], [[J2]]{{\]}} : memref<2x20xf32>
+  // CHECK: [[ADD2:%.+]] = addf [[LOAD3]], [[LOAD4]] : f32
+  // CHECK: affine.store [[ADD2]], [[RES]]{{\[}}[[I2]], [[J2]]{{\]}} : memref<2x20xf32>
+  // CHECK: return [[RES]] : memref<2x20xf32>
+}
+
+// -----
+
+func @test_relu_vectorized(%arg0 : tensor<4x16xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Relu"(%arg0) : (tensor<4x16xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_relu_vectorized
+  // CHECK: [[RES:%.+]] = alloc() : memref<4x16xf32>
+  // CHECK: [[VEC_LOOPS:%.+]]:2 = krnl.define_loops 2
+  // CHECK: krnl.iterate([[VEC_LOOPS]]#0, [[VEC_LOOPS]]#1) with ([[VEC_LOOPS]]#0 -> [[I:%.+]] = 0 to 4, [[VEC_LOOPS]]#1 -> [[J:%.+]] = 0 to 2) {
+  // CHECK: [[LOAD:%.+]] = affine.vector_load %arg0{{\[}}[[I]], [[J]] * 8{{\]}} : memref<4x16xf32>, vector<8xf32>
+  // CHECK: [[ZERO:%.+]] = constant dense<0.000000e+00> : vector<8xf32>
+  // CHECK: [[LTZERO:%.+]] = cmpf "olt", [[LOAD]], [[ZERO]] : vector<8xf32>
+  // CHECK: [[RELU_RES:%.+]] = select [[LTZERO]], [[ZERO]], [[LOAD]] : vector<8xi1>, vector<8xf32>
+  // CHECK: affine.vector_store [[RELU_RES]], [[RES]]{{\[}}[[I]], [[J]] * 8{{\]}} : memref<4x16xf32>, vector<8xf32>
+  // CHECK-NOT: krnl.define_loops
+  // CHECK: return [[RES]] : memref<4x16xf32>
+}
+
+// -----
+
+/// Broadcasting operands keep the scalar lowering.
+func @test_add_broadcast_not_vectorized(%arg0 : tensor<2x20xf32>, %arg1 : tensor<20xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Add"(%arg0, %arg1) : (tensor<2x20xf32>, tensor<20xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_add_broadcast_not_vectorized
+  // CHECK-NOT: affine.vector_load
+  // CHECK: addf {{.*}} : f32
+  // CHECK: return
+}
+
+// -----
+
+/// The max and the sum of the exponentials are accumulated per lane, merged,
+/// and extended with the remaining elements of the row.
+func @test_softmax_vectorized(%arg0 : tensor<2x20xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Softmax"(%arg0) {axis=1: si64} : (tensor<2x20xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_softmax_vectorized
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<2x20xf32>
+  // CHECK-DAG: [[LANE_SUM:%.+]] = alloc() : memref<vector<8xf32>>
+  // CHECK-DAG: [[LANE_MAX:%.+]] = alloc() : memref<vector<8xf32>>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[I:%.+]] = 0 to 2) {
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 0 to 2) {
+  // CHECK: [[LOAD:%.+]] = affine.vector_load %arg0{{\[}}[[I]], [[J]] * 8{{\]}} : memref<2x20xf32>, vector<8xf32>
+  // CHECK: [[EXP:%.+]] = exp {{.*}} : vector<8xf32>
+  // CHECK: affine.store {{.*}}, [[LANE_SUM]][] : memref<vector<8xf32>>
+  // CHECK: affine.store {{.*}}, [[LANE_MAX]][] : memref<vector<8xf32>>
+  // CHECK: }
+  // CHECK-COUNT-8: vector.extract {{.*}}[{{[0-7]}}] : vector<8xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[K:%.+]] = 16 to 20) {
+  // CHECK: affine.load %arg0{{\[}}[[I]], [[K]]{{\]}} : memref<2x20xf32>
+  // CHECK: exp {{.*}} : f32
+  // CHECK: }
+  // CHECK: vector.broadcast {{.*}} : f32 to vector<8xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 0 to 2) {
+  // CHECK: affine.vector_store {{.*}}, [[RES]]{{\[}}[[I]], [[J]] * 8{{\]}} : memref<2x20xf32>, vector<8xf32>
+  // CHECK: }
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[K:%.+]] = 16 to 20) {
+  // CHECK: affine.store {{.*}}, [[RES]]{{\[}}[[I]], [[K]]{{\]}} : memref<2x20xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<2x20xf32>
+}
+
+// -----
+
+// A row whose first vector is masked out with -inf: the lanes and the lane
+// merge take their exponentials relative to a shift that is 0 while the max
+// is -inf.
+func @test_softmax_vectorized_leading_neg_infinity(%arg0 : tensor<1x20xf32>) -> tensor<*xf32> {
+  %mask = "onnx.Constant"() {value = dense<[[0xFF800000, 0xFF800000, 0xFF800000, 0xFF800000, 0xFF800000, 0xFF800000, 0xFF800000, 0xFF800000, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0]]> : tensor<1x20xf32>} : () -> tensor<1x20xf32>
+  %0 = "onnx.Add"(%arg0, %mask) : (tensor<1x20xf32>, tensor<1x20xf32>) -> tensor<*xf32>
+  %1 = "onnx.Softmax"(%0) {axis=1: si64} : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_softmax_vectorized_leading_neg_infinity
+  // CHECK: [[GT:%.+]] = cmpf "ogt", [[LOAD:%.+]], [[M:%.+]] : vector<8xf32>
+  // CHECK: [[NEW_MAX:%.+]] = select [[GT]], [[LOAD]], [[M]] : vector<8xi1>, vector<8xf32>
+  // CHECK: [[NEG_INF:%.+]] = constant dense<0xFF800000> : vector<8xf32>
+  // CHECK: [[IS_NEG_INF:%.+]] = cmpf "oeq", [[NEW_MAX]], [[NEG_INF]] : vector<8xf32>
+  // CHECK: [[SHIFT:%.+]] = select [[IS_NEG_INF]], {{.*}}, [[NEW_MAX]] : vector<8xi1>, vector<8xf32>
+  // CHECK: [[OTHER:%.+]] = select [[GT]], [[M]], [[LOAD]] : vector<8xi1>, vector<8xf32>
+  // CHECK: [[DIFF:%.+]] = subf [[OTHER]], [[SHIFT]] : vector<8xf32>
+  // CHECK: exp [[DIFF]] : vector<8xf32>
+  // CHECK: }
+  // CHECK: [[LANE_MAX:%.+]] = vector.extract {{.*}}[0] : vector<8xf32>
+  // CHECK: [[LANE_SUM:%.+]] = vector.extract {{.*}}[0] : vector<8xf32>
+  // CHECK: [[LANE_GT:%.+]] = cmpf "ogt", [[LANE_MAX]], [[MAX:%.+]] : f32
+  // CHECK: [[LANE_NEW_MAX:%.+]] = select [[LANE_GT]], [[LANE_MAX]], [[MAX]] : f32
+  // CHECK: [[LANE_IS_NEG_INF:%.+]] = cmpf "oeq", [[LANE_NEW_MAX]], {{.*}} : f32
+  // CHECK: [[LANE_SHIFT:%.+]] = select [[LANE_IS_NEG_INF]], {{.*}}, [[LANE_NEW_MAX]] : f32
+  // CHECK: [[LANE_OTHER:%.+]] = select [[LANE_GT]], [[MAX]], [[LANE_MAX]] : f32
+  // CHECK: [[LANE_DIFF:%.+]] = subf [[LANE_OTHER]], [[LANE_SHIFT]] : f32
+  // CHECK: [[LANE_EXP:%.+]] = exp [[LANE_DIFF]] : f32
+  // CHECK: mulf [[LANE_SUM]], [[LANE_EXP]] : f32
+  // CHECK: return
+}
+
+// -----
+
+/// Reductions of the innermost axis accumulate one vector of partial results
+/// per output element, combined by a tree of shuffles.
+func @test_reducemean_vectorized(%arg0 : tensor<4x20xf32>) -> tensor<*xf32> {
+  %0 ="onnx.ReduceMean"(%arg0) {axes=[1], keepdims = 0 : si64} : (tensor<4x20xf32>)-> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_reducemean_vectorized
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<4xf32>
+  // CHECK-DAG: [[PARTIALS:%.+]] = alloc() : memref<4xvector<8xf32>>
+  // CHECK: [[IDENTITY:%.+]] = vector.broadcast {{.*}} : f32 to vector<8xf32>
+  // CHECK: [[OUTER_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[OUTER_LOOPS]] : !krnl.loop
+  // CHECK: krnl.iterate([[OUTER_LOOPS]]) with ([[OUTER_LOOPS]] -> [[I:%.+]] = 0 to 4) {
+  // CHECK: affine.store [[IDENTITY]], [[PARTIALS]]{{\[}}[[I]]{{\]}} : memref<4xvector<8xf32>>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 0 to 2) {
+  // CHECK: [[LOAD:%.+]] = affine.vector_load %arg0{{\[}}[[I]], [[J]] * 8{{\]}} : memref<4x20xf32>, vector<8xf32>
+  // CHECK: [[PARTIAL:%.+]] = affine.load [[PARTIALS]]{{\[}}[[I]]{{\]}} : memref<4xvector<8xf32>>
+  // CHECK: [[ADD:%.+]] = addf [[PARTIAL]], [[LOAD]] : vector<8xf32>
+  // CHECK: affine.store [[ADD]], [[PARTIALS]]{{\[}}[[I]]{{\]}} : memref<4xvector<8xf32>>
+  // CHECK: }
+  // CHECK: [[P8:%.+]] = affine.load [[PARTIALS]]{{\[}}[[I]]{{\]}} : memref<4xvector<8xf32>>
+  // CHECK: [[LOW4:%.+]] = vector.shuffle [[P8]], [[P8]] [0, 1, 2, 3] : vector<8xf32>, vector<8xf32>
+  // CHECK: [[HIGH4:%.+]] = vector.shuffle [[P8]], [[P8]] [4, 5, 6, 7] : vector<8xf32>, vector<8xf32>
+  // CHECK: [[P4:%.+]] = addf [[LOW4]], [[HIGH4]] : vector<4xf32>
+  // CHECK: [[P2:%.+]] = addf {{.*}} : vector<2xf32>
+  // CHECK: [[P1:%.+]] = addf {{.*}} : vector<1xf32>
+  // CHECK: [[SUM:%.+]] = vector.extract [[P1]][0] : vector<1xf32>
+  // CHECK: affine.store [[SUM]], [[RES]]{{\[}}[[I]]{{\]}} : memref<4xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[K:%.+]] = 16 to 20) {
+  // CHECK: affine.load %arg0{{\[}}[[I]], [[K]]{{\]}} : memref<4x20xf32>
+  // CHECK: addf {{.*}} : f32
+  // CHECK: }
+  // CHECK: }
+  // CHECK: divf {{.*}} : f32
+  // CHECK: return [[RES]] : memref<4xf32>
+}
+
+// -----
+
+/// Reductions that keep the innermost axis keep the scalar lowering.
+func @test_reducemax_not_vectorized(%arg0 : tensor<4x20xf32>) -> tensor<*xf32> {
+  %0 ="onnx.ReduceMax"(%arg0) {axes=[0], keepdims = 0 : si64} : (tensor<4x20xf32>)-> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_reducemax_not_vectorized
+  // CHECK-NOT: affine.vector_load
+  // CHECK: cmpf "ogt", {{.*}} : f32
+  // CHECK: return
+}
+
+// -----
+
+/// ArgMax along the innermost axis selects a value and an index per lane,
+/// the lanes being combined once the vectors of the row have been read.
+func @test_argmax_vectorized(%arg0 : tensor<4x20xf32>) -> tensor<*xi64> {
+  %0 ="onnx.ArgMax"(%arg0) {axis = 1 : si64, keepdims = 0 : si64} : (tensor<4x20xf32>)-> tensor<*xi64>
+  "std.return"(%0) : (tensor<*xi64>) -> ()
+
+  // CHECK-LABEL: test_argmax_vectorized
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<4xi64>
+  // CHECK-DAG: [[PARTIAL_VALUES:%.+]] = alloc() : memref<4xvector<8xf32>>
+  // CHECK-DAG: [[PARTIAL_INDICES:%.+]] = alloc() : memref<4xvector<8xi64>>
+  // CHECK-DAG: [[SELECTED:%.+]] = alloc() : memref<4xf32>
+  // CHECK-DAG: [[LANES:%.+]] = constant dense<[0, 1, 2, 3, 4, 5, 6, 7]> : vector<8xi64>
+  // CHECK: [[OUTER_LOOPS:%.+]] = krnl.define_loops 1
+  // CHECK: krnl.parallel [[OUTER_LOOPS]] : !krnl.loop
+  // CHECK: krnl.iterate([[OUTER_LOOPS]]) with ([[OUTER_LOOPS]] -> [[I:%.+]] = 0 to 4) {
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 0 to 2) {
+  // CHECK: [[LOAD:%.+]] = affine.vector_load %arg0{{\[}}[[I]], [[J]] * 8{{\]}} : memref<4x20xf32>, vector<8xf32>
+  // CHECK: [[FIRST:%.+]] = muli {{.*}} : i64
+  // CHECK: [[FIRSTS:%.+]] = vector.broadcast [[FIRST]] : i64 to vector<8xi64>
+  // CHECK: [[INDICES:%.+]] = addi [[FIRSTS]], [[LANES]] : vector<8xi64>
+  // CHECK: [[VALUES:%.+]] = affine.load [[PARTIAL_VALUES]]{{\[}}[[I]]{{\]}} : memref<4xvector<8xf32>>
+  // CHECK: [[SELECTED_INDICES:%.+]] = affine.load [[PARTIAL_INDICES]]{{\[}}[[I]]{{\]}} : memref<4xvector<8xi64>>
+  // CHECK: [[IS_SELECTED:%.+]] = cmpf "ogt", [[LOAD]], [[VALUES]] : vector<8xf32>
+  // CHECK: [[NEW_VALUES:%.+]] = select [[IS_SELECTED]], [[LOAD]], [[VALUES]] : vector<8xi1>, vector<8xf32>
+  // CHECK: affine.store [[NEW_VALUES]], [[PARTIAL_VALUES]]{{\[}}[[I]]{{\]}} : memref<4xvector<8xf32>>
+  // CHECK: [[NEW_INDICES:%.+]] = select [[IS_SELECTED]], [[INDICES]], [[SELECTED_INDICES]] : vector<8xi1>, vector<8xi64>
+  // CHECK: affine.store [[NEW_INDICES]], [[PARTIAL_INDICES]]{{\[}}[[I]]{{\]}} : memref<4xvector<8xi64>>
+  // CHECK: }
+  // CHECK: vector.extract {{.*}}[7] : vector<8xi64>
+  // CHECK: affine.store {{.*}}, [[RES]]{{\[}}[[I]]{{\]}} : memref<4xi64>
+  // CHECK: affine.store {{.*}}, [[SELECTED]]{{\[}}[[I]]{{\]}} : memref<4xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[K:%.+]] = 16 to 20) {
+  // CHECK: affine.load %arg0{{\[}}[[I]], [[K]]{{\]}} : memref<4x20xf32>
+  // CHECK: cmpf "ogt", {{.*}} : f32
+  // CHECK: }
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<4xi64>
+}
+
+// -----
+
+/// Max pools with unit strides along the innermost dimension compute adjacent
+/// outputs in the lanes of a vector, over an input padded with -inf.
+func @test_maxpool_vectorized(%arg0 : tensor<1x3x20x20xf32>) -> tensor<*xf32> {
+  %0 = "onnx.MaxPoolSingleOut"(%arg0) {auto_pad = "NOTSET", kernel_shape = [3, 3], pads = [1, 1, 1, 1]} : (tensor<1x3x20x20xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_maxpool_vectorized
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<1x3x20x20xf32>
+  // CHECK-DAG: [[PADDED:%.+]] = alloc() : memref<1x3x22x22xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} = 0 to 22, {{.*}} = 0 to 22) {
+  // CHECK:   affine.store {{.*}}, [[PADDED]]{{.*}} : memref<1x3x22x22xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[N:%.+]] = 0 to 1, {{.*}} -> [[C:%.+]] = 0 to 3, {{.*}} -> [[H:%.+]] = 0 to 20, {{.*}} -> [[W:%.+]] = 0 to 20) {
+  // CHECK:   [[INPUT:%.+]] = affine.load %arg0{{\[}}[[N]], [[C]], [[H]], [[W]]{{\]}} : memref<1x3x20x20xf32>
+  // CHECK:   affine.store [[INPUT]], [[PADDED]]{{\[}}[[N]], [[C]], [[H]] + 1, [[W]] + 1{{\]}} : memref<1x3x22x22xf32>
+
+  // CHECK: [[OUTPUT_LOOPS:%.+]]:4 = krnl.define_loops 4
+  // CHECK: krnl.parallel [[OUTPUT_LOOPS]]#1 : !krnl.loop
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[N:%.+]] = 0 to 1, {{.*}} -> [[C:%.+]] = 0 to 3, {{.*}} -> [[HO:%.+]] = 0 to 20, {{.*}} -> [[WO:%.+]] = 0 to 2) {
+  // CHECK:   [[IDENTITY:%.+]] = vector.broadcast {{.*}} : f32 to vector<8xf32>
+  // CHECK:   affine.vector_store [[IDENTITY]], [[RES]]{{\[}}[[N]], [[C]], [[HO]], [[WO]] * 8{{\]}} : memref<1x3x20x20xf32>, vector<8xf32>
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> [[KH:%.+]] = 0 to 3, {{.*}} -> [[KW:%.+]] = 0 to 3) {
+  // CHECK:     [[NEXT:%.+]] = affine.vector_load [[PADDED]]{{\[}}[[N]], [[C]], [[HO]] + [[KH]], [[WO]] * 8 + [[KW]]{{\]}} : memref<1x3x22x22xf32>, vector<8xf32>
+  // CHECK:     [[PARTIAL:%.+]] = affine.vector_load [[RES]]{{\[}}[[N]], [[C]], [[HO]], [[WO]] * 8{{\]}} : memref<1x3x20x20xf32>, vector<8xf32>
+  // CHECK:     [[GREATER:%.+]] = cmpf "ogt", [[PARTIAL]], [[NEXT]] : vector<8xf32>
+  // CHECK:     [[MAX:%.+]] = select [[GREATER]], [[PARTIAL]], [[NEXT]] : {{.*}}vector<8xf32>
+  // CHECK:     affine.vector_store [[MAX]], [[RES]]{{\[}}[[N]], [[C]], [[HO]], [[WO]] * 8{{\]}} : memref<1x3x20x20xf32>, vector<8xf32>
+
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} = 0 to 1, {{.*}} = 0 to 3, {{.*}} = 0 to 20, {{.*}} -> [[WO:%.+]] = 16 to 20) {
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} = 0 to 3, {{.*}} = 0 to 3) {
+  // CHECK:     affine.load [[PADDED]]{{.*}} : memref<1x3x22x22xf32>
+  // CHECK:     cmpf "ogt", {{.*}} : f32
+  // CHECK: dealloc [[PADDED]] : memref<1x3x22x22xf32>
+  // CHECK: return [[RES]] : memref<1x3x20x20xf32>
+}
+
+// -----
+
+/// Depthwise convolutions are vectorized along the width of the output rows,
+/// the outputs left over by the vectors are computed one at a time.
+func @test_conv_depthwise_vectorized(%arg0 : tensor<1x2x10x12xf32>, %arg1 : tensor<2x1x3x3xf32>) -> tensor<*xf32> {
+  %cst = constant unit
+  %0 = "onnx.Conv"(%arg0, %arg1, %cst) {auto_pad = "NOTSET", group = 2 : si64} : (tensor<1x2x10x12xf32>, tensor<2x1x3x3xf32>, none) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_conv_depthwise_vectorized
+  // CHECK: [[RES:%.+]] = alloc() : memref<1x2x8x10xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[N:%.+]] = 0 to 1, {{.*}} -> [[M:%.+]] = 0 to 2, {{.*}} -> [[R1:%.+]] = 0 to 8) {
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> [[R2:%.+]] = 0 to 1) {
+  // CHECK:     [[INIT:%.+]] = vector.broadcast {{.*}} : f32 to vector<8xf32>
+  // CHECK:     affine.vector_store [[INIT]], [[RES]]{{\[}}[[N]], [[M]], [[R1]], [[R2]] * 8{{\]}} : memref<1x2x8x10xf32>, vector<8xf32>
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> [[K1:%.+]] = 0 to 3, {{.*}} -> [[K2:%.+]] = 0 to 3) {
+  // CHECK:     [[WEIGHT:%.+]] = affine.load %arg1{{\[}}[[M]], 0, [[K1]], [[K2]]{{\]}} : memref<2x1x3x3xf32>
+  // CHECK:     [[WEIGHTS:%.+]] = vector.broadcast [[WEIGHT]] : f32 to vector<8xf32>
+  // CHECK:     krnl.iterate({{.*}}) with ({{.*}} -> [[R2:%.+]] = 0 to 1) {
+  // CHECK:       [[DATA:%.+]] = affine.vector_load %arg0{{\[}}[[N]], [[M]], [[R1]] + [[K1]], [[R2]] * 8 + [[K2]]{{\]}} : memref<1x2x10x12xf32>, vector<8xf32>
+  // CHECK:       [[PARTIAL:%.+]] = affine.vector_load [[RES]]{{\[}}[[N]], [[M]], [[R1]], [[R2]] * 8{{\]}} : memref<1x2x8x10xf32>, vector<8xf32>
+  // CHECK:       [[MUL:%.+]] = mulf [[DATA]], [[WEIGHTS]] : vector<8xf32>
+  // CHECK:       [[ADD:%.+]] = addf [[PARTIAL]], [[MUL]] : vector<8xf32>
+  // CHECK:       affine.vector_store [[ADD]], [[RES]]{{\[}}[[N]], [[M]], [[R1]], [[R2]] * 8{{\]}} : memref<1x2x8x10xf32>, vector<8xf32>
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} = 8 to 10) {
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} = 0 to 3, {{.*}} = 0 to 3) {
+  // CHECK:     krnl.iterate({{.*}}) with ({{.*}} = 8 to 10) {
+  // CHECK:       affine.load %arg0{{.*}} : memref<1x2x10x12xf32>
+  // CHECK:       mulf {{.*}} : f32
+  // CHECK: return [[RES]] : memref<1x2x8x10xf32>
+}
+
+// -----
+
+func @test_global_averagepool_vectorized(%arg0 : tensor<1x3x5x10xf32>) -> tensor<*xf32> {
+  %0 = "onnx.GlobalAveragePool"(%arg0) : (tensor<1x3x5x10xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_global_averagepool_vectorized
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<1x3x1x1xf32>
+  // CHECK-DAG: [[LANES:%.+]] = alloc() : memref<1x3xvector<8xf32>>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[N:%.+]] = 0 to 1, {{.*}} -> [[C:%.+]] = 0 to 3) {
+  // CHECK:   affine.store {{.*}}, [[LANES]]{{\[}}[[N]], [[C]]{{\]}} : memref<1x3xvector<8xf32>>
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> [[H:%.+]] = 0 to 5, {{.*}} -> [[W:%.+]] = 0 to 1) {
+  // CHECK:     [[NEXT:%.+]] = affine.vector_load %arg0{{\[}}[[N]], [[C]], [[H]], [[W]] * 8{{\]}} : memref<1x3x5x10xf32>, vector<8xf32>
+  // CHECK:     [[PARTIAL:%.+]] = affine.load [[LANES]]{{\[}}[[N]], [[C]]{{\]}} : memref<1x3xvector<8xf32>>
+  // CHECK:     [[SUM:%.+]] = addf [[PARTIAL]], [[NEXT]] : vector<8xf32>
+  // CHECK:     affine.store [[SUM]], [[LANES]]{{\[}}[[N]], [[C]]{{\]}} : memref<1x3xvector<8xf32>>
+  // CHECK:   }
+  // CHECK:   [[PARTIALS:%.+]] = affine.load [[LANES]]{{\[}}[[N]], [[C]]{{\]}} : memref<1x3xvector<8xf32>>
+  // CHECK:   vector.extract [[PARTIALS]][0] : vector<8xf32>
+  // CHECK:   vector.extract [[PARTIALS]][7] : vector<8xf32>
+  // CHECK:   affine.store {{.*}}, [[RES]]{{\[}}[[N]], [[C]], 0, 0{{\]}} : memref<1x3x1x1xf32>
+  // CHECK:   krnl.iterate({{.*}}) with ({{.*}} -> [[H:%.+]] = 0 to 5, {{.*}} -> [[W:%.+]] = 8 to 10) {
+  // CHECK:     affine.load %arg0{{\[}}[[N]], [[C]], [[H]], [[W]]{{\]}} : memref<1x3x5x10xf32>
+  // CHECK:     addf {{.*}} : f32
+  // CHECK:   }
+  // CHECK:   mulf {{.*}} : f32
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<1x3x1x1xf32>
+}
+
+// -----
+
+/// Gelu is computed on vectors with a polynomial approximation of erf.
+func @test_gelu_vectorized(%arg0 : tensor<4x16xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Gelu"(%arg0) : (tensor<4x16xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_gelu_vectorized
+  // CHECK: [[LOAD:%.+]] = affine.vector_load %arg0{{.*}} : memref<4x16xf32>, vector<8xf32>
+  // CHECK: absf {{.*}} : vector<8xf32>
+  // CHECK: exp {{.*}} : vector<8xf32>
+  // CHECK: select {{.*}}vector<8xf32>
+  // CHECK: affine.vector_store {{.*}} : memref<4x16xf32>, vector<8xf32>
+}
+
+// -----
+
+/// The mean, the variance and the result of a layer normalization are each
+/// computed in one pass over the row, by vectors and then by scalars.
+func @test_layer_norm_vectorized(%arg0 : tensor<2x20xf32>, %arg1 : tensor<20xf32>, %arg2 : tensor<20xf32>) -> tensor<*xf32> {
+  %0 = "onnx.LayerNormalization"(%arg0, %arg1, %arg2) {epsilon = 1.0e-05 : f32} : (tensor<2x20xf32>, tensor<20xf32>, tensor<20xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_layer_norm_vectorized
+  // CHECK-DAG: [[RES:%.+]] = alloc() : memref<2x20xf32>
+  // CHECK-DAG: [[SUM:%.+]] = alloc() : memref<f32>
+  // CHECK-DAG: [[LANE_SUM:%.+]] = alloc() : memref<vector<8xf32>>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[I:%.+]] = 0 to 2) {
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 0 to 2) {
+  // CHECK: affine.vector_load %arg0{{\[}}[[I]], [[J]] * 8{{\]}} : memref<2x20xf32>, vector<8xf32>
+  // CHECK: affine.store {{.*}}, [[LANE_SUM]][] : memref<vector<8xf32>>
+  // CHECK: }
+  // CHECK-COUNT-8: vector.extract {{.*}}[{{[0-7]}}] : vector<8xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[K:%.+]] = 16 to 20) {
+  // CHECK: affine.store {{.*}}, [[SUM]][] : memref<f32>
+  // CHECK: }
+  // CHECK: [[MEAN:%.+]] = divf
+  // CHECK: vector.broadcast [[MEAN]] : f32 to vector<8xf32>
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 0 to 2) {
+  // CHECK: subf {{.*}} : vector<8xf32>
+  // CHECK: }
+  // CHECK: sqrt
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[J:%.+]] = 0 to 2) {
+  // CHECK: affine.vector_load %arg1{{\[}}[[J]] * 8{{\]}} : memref<20xf32>, vector<8xf32>
+  // CHECK: affine.vector_load %arg2{{\[}}[[J]] * 8{{\]}} : memref<20xf32>, vector<8xf32>
+  // CHECK: affine.vector_store {{.*}}, [[RES]]{{\[}}[[I]], [[J]] * 8{{\]}} : memref<2x20xf32>, vector<8xf32>
+  // CHECK: }
+  // CHECK: krnl.iterate({{.*}}) with ({{.*}} -> [[K:%.+]] = 16 to 20) {
+  // CHECK: affine.load %arg1{{\[}}[[K]]{{\]}} : memref<20xf32>
+  // CHECK: affine.store {{.*}}, [[RES]]{{\[}}[[I]], [[K]]{{\]}} : memref<2x20xf32>
+  // CHECK: }
+  // CHECK: return [[RES]] : memref<2x20xf32>
+}
@@ -0,0 +1,40 @@
+// RUN: onnx-mlir-opt --report-op-costs='report-file=%t peak-gflops=100 bandwidth-gbps=10' %s && FileCheck %s < %t
+// RUN: onnx-mlir-opt --report-op-costs='report-file=%t' %s && FileCheck --check-prefix=NOROOFLINE %s < %t
+
+/// The MatMul counts 2 * 64 * 32 * 128 FLOPs, the Relu one per element. Both
+/// are memory bound, and the MatMul comes first. The Reshape of dynamic shape
+/// is not counted.
+func @test_op_costs(%arg0 : tensor<64x128xf32>, %arg1 : tensor<128x32xf32>, %arg2 : tensor<?xi64>) -> tensor<*xf32> {
+  %0 = "onnx.MatMul"(%arg0, %arg1) : (tensor<64x128xf32>, tensor<128x32xf32>) -> tensor<64x32xf32>
+  %1 = "onnx.Relu"(%0) : (tensor<64x32xf32>) -> tensor<64x32xf32>
+  %2 = "onnx.Reshape"(%1, %arg2) : (tensor<64x32xf32>, tensor<?xi64>) -> tensor<*xf32>
+  return %2 : tensor<*xf32>
+
+  // CHECK: "peak_gflops": 100,
+  // CHECK-NEXT: "bandwidth_gbps": 10,
+  // CHECK-NEXT: "total_flops": 526336,
+  // CHECK-NEXT: "total_bytes": 73728,
+  // CHECK-NEXT: "estimated_time_us": 7.3
+  // CHECK-NEXT: "dynamic_ops": 1,
+  // CHECK: "name": "onnx.MatMul",
+  // CHECK: "flops": 524288,
+  // CHECK-NEXT: "bytes_read": 49152,
+  // CHECK-NEXT: "bytes_written": 8192,
+  // CHECK-NEXT: "intensity": 9.14
+  // CHECK-NEXT: "bound": "memory",
+  // CHECK-NEXT: "estimated_time_us": 5.7
+  // CHECK: "name": "onnx.Relu",
+  // CHECK: "flops": 2048,
+  // CHECK-NEXT: "bytes_read": 8192,
+  // CHECK-NEXT: "bytes_written": 8192,
+  // CHECK-NEXT: "intensity": 0.12
+  // CHECK-NEXT: "bound": "memory",
+  // CHECK-NEXT: "estimated_time_us": 1.6
+
+  // NOROOFLINE-NOT: "peak_gflops"
+  // NOROOFLINE: "total_flops": 526336,
+  // NOROOFLINE: "name": "onnx.MatMul",
+  // NOROOFLINE: "intensity": 9.14
+  // NOROOFLINE-NOT: "bound"
+  // NOROOFLINE: "name": "onnx.Relu",
+}
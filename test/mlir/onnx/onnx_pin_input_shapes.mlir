@@ -0,0 +1,15 @@
+// RUN: onnx-mlir-opt --pin-input-shapes="shapes=0:1x?x4,1:4" %s -split-input-file | FileCheck %s
+
+/// The dynamic dimensions of the inputs are pinned, the types of the
+/// operations are left to shape inference.
+module {
+  func @main_graph(%arg0: tensor<?x?x4xf32>, %arg1: tensor<*xf32>) -> tensor<*xf32> {
+    %0 = "onnx.Add"(%arg0, %arg1) : (tensor<?x?x4xf32>, tensor<*xf32>) -> tensor<*xf32>
+    "std.return"(%0) : (tensor<*xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 2 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph(%arg0: tensor<1x?x4xf32>, %arg1: tensor<4xf32>) -> tensor<*xf32>
+  // CHECK: [[ADD:%.+]] = "onnx.Add"(%arg0, %arg1) : (tensor<1x?x4xf32>, tensor<4xf32>) -> tensor<*xf32>
+  // CHECK: return [[ADD]] : tensor<*xf32>
+}
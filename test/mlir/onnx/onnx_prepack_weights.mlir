@@ -0,0 +1,31 @@
+// RUN: onnx-mlir-opt --prepack-weights %s -split-input-file | FileCheck %s
+
+/// A constant B is transposed and transB is set.
+func @test_prepack_gemm_b(%arg0: tensor<2x3xf32>) -> tensor<2x2xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]]> : tensor<3x2xf32>} : () -> tensor<3x2xf32>
+  %1 = "onnx.Constant"() {value = dense<[1.0, 2.0]> : tensor<2xf32>} : () -> tensor<2xf32>
+  %2 = "onnx.Gemm"(%arg0, %0, %1) {alpha = 1.0 : f32, beta = 1.0 : f32, transA = 0 : si64, transB = 0 : si64} : (tensor<2x3xf32>, tensor<3x2xf32>, tensor<2xf32>) -> tensor<2x2xf32>
+  "std.return"(%2) : (tensor<2x2xf32>) -> ()
+
+  // CHECK-LABEL: test_prepack_gemm_b
+  // CHECK-NOT: tensor<3x2xf32>
+  // CHECK: [[B:%.+]] = "onnx.Constant"() {value = dense<{{\[}}[1.000000e+00, 3.000000e+00, 5.000000e+00], [2.000000e+00, 4.000000e+00, 6.000000e+00]{{\]}}> : tensor<2x3xf32>} : () -> tensor<2x3xf32>
+  // CHECK: "onnx.Gemm"(%arg0, [[B]], {{.*}}) {alpha = 1.000000e+00 : f32, beta = 1.000000e+00 : f32, transA = 0 : si64, transB = 1 : si64} : (tensor<2x3xf32>, tensor<2x3xf32>, tensor<2xf32>) -> tensor<2x2xf32>
+}
+
+// -----
+
+/// A constant A used transposed is transposed and transA is cleared. A B that
+/// is already transposed is left unchanged.
+func @test_prepack_gemm_a() -> tensor<2x2xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[1, 2], [3, 4], [5, 6]]> : tensor<3x2xi32>} : () -> tensor<3x2xi32>
+  %1 = "onnx.Constant"() {value = dense<[[1, 2, 3], [4, 5, 6]]> : tensor<2x3xi32>} : () -> tensor<2x3xi32>
+  %cst = constant unit
+  %2 = "onnx.Gemm"(%0, %1, %cst) {alpha = 1.0 : f32, beta = 1.0 : f32, transA = 1 : si64, transB = 1 : si64} : (tensor<3x2xi32>, tensor<2x3xi32>, none) -> tensor<2x2xi32>
+  "std.return"(%2) : (tensor<2x2xi32>) -> ()
+
+  // CHECK-LABEL: test_prepack_gemm_a
+  // CHECK: [[B:%.+]] = "onnx.Constant"() {value = dense<{{\[}}[1, 2, 3], [4, 5, 6]{{\]}}> : tensor<2x3xi32>} : () -> tensor<2x3xi32>
+  // CHECK: [[A:%.+]] = "onnx.Constant"() {value = dense<{{\[}}[1, 3, 5], [2, 4, 6]{{\]}}> : tensor<2x3xi32>} : () -> tensor<2x3xi32>
+  // CHECK: "onnx.Gemm"([[A]], [[B]], {{.*}}) {alpha = 1.000000e+00 : f32, beta = 1.000000e+00 : f32, transA = 0 : si64, transB = 1 : si64}
+}
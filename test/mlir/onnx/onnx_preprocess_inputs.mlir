@@ -0,0 +1,36 @@
+// RUN: onnx-mlir-opt --preprocess-inputs="specs=0:layout=nhwc:dtype=ui8:mean=1:std=1/2/4" %s -split-input-file | FileCheck %s
+
+/// The raw image is the input of the function, and the normalization is folded
+/// into the weights and bias of the convolution without padding reading it.
+module {
+  func @main_graph(%arg0: tensor<1x3x2x2xf32>) -> tensor<*xf32> {
+    %0 = "onnx.Constant"() {value = dense<1.0> : tensor<1x3x1x1xf32>} : () -> tensor<1x3x1x1xf32>
+    %1 = "onnx.Constant"() {value = dense<0.5> : tensor<1xf32>} : () -> tensor<1xf32>
+    %2 = "onnx.Conv"(%arg0, %0, %1) {kernel_shape = [1, 1]} : (tensor<1x3x2x2xf32>, tensor<1x3x1x1xf32>, tensor<1xf32>) -> tensor<*xf32>
+    "std.return"(%2) : (tensor<*xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph(%arg0: tensor<1x2x2x3xi8>) -> tensor<*xf32>
+  // CHECK: [[IMAGE:%.+]] = "onnx.ImagePreprocess"(%arg0) {is_unsigned = 1 : si64, layout = "NHWC", mean = [0.000000e+00 : f32], std = [1.000000e+00 : f32]} : (tensor<1x2x2x3xi8>) -> tensor<1x3x2x2xf32>
+  // CHECK-DAG: [[W:%.+]] = "onnx.Constant"() {value = dense<{{.*}}1.000000e+00{{.*}}5.000000e-01{{.*}}2.500000e-01{{.*}}> : tensor<1x3x1x1xf32>}
+  // CHECK-DAG: [[B:%.+]] = "onnx.Constant"() {value = dense<-1.250000e+00> : tensor<1xf32>}
+  // CHECK: "onnx.Conv"([[IMAGE]], [[W]], [[B]])
+}
+
+// -----
+
+/// Padded convolutions read the normalized image.
+module {
+  func @main_graph(%arg0: tensor<1x3x2x2xf32>) -> tensor<*xf32> {
+    %0 = "onnx.Constant"() {value = dense<1.0> : tensor<1x3x3x3xf32>} : () -> tensor<1x3x3x3xf32>
+    %1 = constant unit
+    %2 = "onnx.Conv"(%arg0, %0, %1) {kernel_shape = [3, 3], pads = [1, 1, 1, 1]} : (tensor<1x3x2x2xf32>, tensor<1x3x3x3xf32>, none) -> tensor<*xf32>
+    "std.return"(%2) : (tensor<*xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph(%arg0: tensor<1x2x2x3xi8>) -> tensor<*xf32>
+  // CHECK: [[IMAGE:%.+]] = "onnx.ImagePreprocess"(%arg0) {is_unsigned = 1 : si64, layout = "NHWC", mean = [1.000000e+00 : f32], std = [1.000000e+00 : f32, 2.000000e+00 : f32, 4.000000e+00 : f32]} : (tensor<1x2x2x3xi8>) -> tensor<1x3x2x2xf32>
+  // CHECK: "onnx.Conv"([[IMAGE]], %0, %1)
+}
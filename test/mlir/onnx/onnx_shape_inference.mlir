@@ -1064,6 +1064,15 @@ func @test_dequantize_linear_1(%arg0 : tensor<5x2x3x4xi8>, %arg1 : tensor<f32>,
   // CHECK: return [[RES]] : tensor<5x2x3x4xf32>
 }
 
+func @test_matmul_integer(%arg0 : tensor<4x3xi8>, %arg1 : tensor<3x2xi8>, %arg2 : tensor<i8>, %arg3 : tensor<i8>) -> tensor<*xi32> {
+  %0 = "onnx.MatMulInteger"(%arg0, %arg1, %arg2, %arg3) : (tensor<4x3xi8>, tensor<3x2xi8>, tensor<i8>, tensor<i8>) -> tensor<*xi32>
+  "std.return"(%0) : (tensor<*xi32>) -> ()
+
+  // CHECK-LABEL: test_matmul_integer
+  // CHECK: [[RES:%.+]] = "onnx.MatMulInteger"(%arg0, %arg1, %arg2, %arg3) : (tensor<4x3xi8>, tensor<3x2xi8>, tensor<i8>, tensor<i8>) -> tensor<4x2xi32>
+  // CHECK: return [[RES]] : tensor<4x2xi32>
+}
+
 //===----------------------------------------------------------------------===//
 /// Test shape inference for ConvInteger operation and all its attributes.
 //===----------------------------------------------------------------------===//
@@ -1304,6 +1313,24 @@ func @test_constant_of_shape_constant() -> tensor<*xf32> {
 
 // -----
 
+/// The result of the Neg is ranked but not static, it is only inferred once
+/// the shape of its operand is, and so is the ConstantOfShape which needs a
+/// static shape.
+func @test_infer_users_of_refined_ops(%arg0 : tensor<3xi64>) -> tensor<*xf32> {
+  %0 = "onnx.Abs"(%arg0) : (tensor<3xi64>) -> tensor<*xi64>
+  %1 = "onnx.Neg"(%0) : (tensor<*xi64>) -> tensor<?xi64>
+  %2 = "onnx.ConstantOfShape"(%1) {value = dense<[1.0]> : tensor<1xf32>} : (tensor<?xi64>) -> tensor<*xf32>
+  "std.return"(%2) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_infer_users_of_refined_ops
+  // CHECK: [[ABS:%.+]] = "onnx.Abs"(%arg0) : (tensor<3xi64>) -> tensor<3xi64>
+  // CHECK: [[NEG:%.+]] = "onnx.Neg"([[ABS]]) : (tensor<3xi64>) -> tensor<3xi64>
+  // CHECK: [[RES:%.+]] = "onnx.ConstantOfShape"([[NEG]]) {value = dense<1.000000e+00> : tensor<1xf32>} : (tensor<3xi64>) -> tensor<?x?x?xf32>
+  // CHECK: return [[RES]] : tensor<?x?x?xf32>
+}
+
+// -----
+
 func @test_slice(%arg0 : tensor<2x4xf32>, %arg1: tensor<2xi64>, %arg2: tensor<2xi64>, %arg3: tensor<2xi64>, %arg4: tensor<2xi64>) -> tensor<*xf32> {
   %1 = "onnx.Slice"(%arg0, %arg1, %arg2, %arg3, %arg4) : (tensor<2x4xf32>, tensor<2xi64>, tensor<2xi64>, tensor<2xi64>, tensor<2xi64>) -> tensor<*xf32>
   "std.return"(%1) : (tensor<*xf32>) -> ()
@@ -1651,3 +1678,157 @@ func @test_less_unknown_dims_2(%arg0: tensor<?x?x5xf32>, %arg1: tensor<?x4x5xf32
   // CHECK: {{.*}} = "onnx.Less"(%arg0, %arg1) : (tensor<?x?x5xf32>, tensor<?x4x5xf32>) -> tensor<?x4x5xi1>
 }
 
+
+// -----
+
+/// Test shape inference for InstanceNormalization.
+
+func @test_instancenorm(%arg0 : tensor<2x3x?x5xf32>, %arg1 : tensor<3xf32>, %arg2 : tensor<3xf32>) -> tensor<*xf32> {
+  %0 = "onnx.InstanceNormalization"(%arg0, %arg1, %arg2) : (tensor<2x3x?x5xf32>, tensor<3xf32>, tensor<3xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_instancenorm
+  // CHECK: [[RES:%.+]] = "onnx.InstanceNormalization"(%arg0, %arg1, %arg2) : (tensor<2x3x?x5xf32>, tensor<3xf32>, tensor<3xf32>) -> tensor<2x3x?x5xf32>
+  // CHECK: return [[RES]] : tensor<2x3x?x5xf32>
+}
+
+// -----
+
+/// Test shape inference for Resize and Upsample.
+
+func @test_resize_scales(%arg0 : tensor<1x3x4x?xf32>, %arg1 : tensor<0xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<[1.0, 1.0, 1.5, 2.0]> : tensor<4xf32>} : () -> tensor<4xf32>
+  %cst = constant unit
+  %1 = "onnx.Resize"(%arg0, %arg1, %0, %cst) : (tensor<1x3x4x?xf32>, tensor<0xf32>, tensor<4xf32>, none) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_resize_scales
+  // CHECK: [[RES:%.+]] = "onnx.Resize"(%arg0, %arg1, %0, %cst) : (tensor<1x3x4x?xf32>, tensor<0xf32>, tensor<4xf32>, none) -> tensor<1x3x6x?xf32>
+  // CHECK: return [[RES]] : tensor<1x3x6x?xf32>
+}
+
+// -----
+
+func @test_resize_sizes(%arg0 : tensor<1x3x4x?xf32>, %arg1 : tensor<0xf32>, %arg2 : tensor<0xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<[1, 3, 16, 16]> : tensor<4xi64>} : () -> tensor<4xi64>
+  %1 = "onnx.Resize"(%arg0, %arg1, %arg2, %0) : (tensor<1x3x4x?xf32>, tensor<0xf32>, tensor<0xf32>, tensor<4xi64>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_resize_sizes
+  // CHECK: [[RES:%.+]] = "onnx.Resize"(%arg0, %arg1, %arg2, %0) : (tensor<1x3x4x?xf32>, tensor<0xf32>, tensor<0xf32>, tensor<4xi64>) -> tensor<1x3x16x16xf32>
+  // CHECK: return [[RES]] : tensor<1x3x16x16xf32>
+}
+
+// -----
+
+func @test_upsample(%arg0 : tensor<1x3x4x4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Constant"() {value = dense<[1.0, 1.0, 2.0, 2.0]> : tensor<4xf32>} : () -> tensor<4xf32>
+  %1 = "onnx.Upsample"(%arg0, %0) : (tensor<1x3x4x4xf32>, tensor<4xf32>) -> tensor<*xf32>
+  "std.return"(%1) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_upsample
+  // CHECK: [[RES:%.+]] = "onnx.Upsample"(%arg0, %0) : (tensor<1x3x4x4xf32>, tensor<4xf32>) -> tensor<1x3x8x8xf32>
+  // CHECK: return [[RES]] : tensor<1x3x8x8xf32>
+}
+
+// -----
+
+/// Test shape inference for ArgMax and TopK.
+
+func @test_argmax(%arg0 : tensor<2x3x?xf32>) -> tensor<*xi64> {
+  %0 = "onnx.ArgMax"(%arg0) {axis = -2 : si64} : (tensor<2x3x?xf32>) -> tensor<*xi64>
+  "std.return"(%0) : (tensor<*xi64>) -> ()
+
+  // CHECK-LABEL: test_argmax
+  // CHECK: [[RES:%.+]] = "onnx.ArgMax"(%arg0) {axis = -2 : si64} : (tensor<2x3x?xf32>) -> tensor<2x1x?xi64>
+  // CHECK: return [[RES]] : tensor<2x1x?xi64>
+}
+
+// -----
+
+func @test_argmax_no_keepdims(%arg0 : tensor<2x3x4xf32>) -> tensor<*xi64> {
+  %0 = "onnx.ArgMax"(%arg0) {axis = 2 : si64, keepdims = 0 : si64} : (tensor<2x3x4xf32>) -> tensor<*xi64>
+  "std.return"(%0) : (tensor<*xi64>) -> ()
+
+  // CHECK-LABEL: test_argmax_no_keepdims
+  // CHECK: [[RES:%.+]] = "onnx.ArgMax"(%arg0) {axis = 2 : si64, keepdims = 0 : si64} : (tensor<2x3x4xf32>) -> tensor<2x3xi64>
+  // CHECK: return [[RES]] : tensor<2x3xi64>
+}
+
+// -----
+
+func @test_topk(%arg0 : tensor<?x100xf32>) -> (tensor<*xf32>, tensor<*xi64>) {
+  %0 = "onnx.Constant"() {value = dense<[5]> : tensor<1xi64>} : () -> tensor<1xi64>
+  %1, %2 = "onnx.TopK"(%arg0, %0) : (tensor<?x100xf32>, tensor<1xi64>) -> (tensor<*xf32>, tensor<*xi64>)
+  "std.return"(%1, %2) : (tensor<*xf32>, tensor<*xi64>) -> ()
+
+  // CHECK-LABEL: test_topk
+  // CHECK: [[RES:%.+]]:2 = "onnx.TopK"(%arg0, %0) : (tensor<?x100xf32>, tensor<1xi64>) -> (tensor<?x5xf32>, tensor<?x5xi64>)
+  // CHECK: return [[RES]]#0, [[RES]]#1 : tensor<?x5xf32>, tensor<?x5xi64>
+}
+
+// -----
+
+func @test_image_preprocess(%arg0 : tensor<?x224x200x3xi8>) -> tensor<*xf32> {
+  %0 = "onnx.ImagePreprocess"(%arg0) {is_unsigned = 1 : si64, layout = "NHWC", mean = [127.5 : f32], std = [127.5 : f32]} : (tensor<?x224x200x3xi8>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_image_preprocess
+  // CHECK: [[RES:%.+]] = "onnx.ImagePreprocess"(%arg0) {{.*}} : (tensor<?x224x200x3xi8>) -> tensor<?x3x224x200xf32>
+  // CHECK: return [[RES]] : tensor<?x3x224x200xf32>
+}
+
+// -----
+
+func @test_einsum(%arg0 : tensor<?x3x4xf32>, %arg1 : tensor<2x4x5xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Einsum"(%arg0, %arg1) {equation = "bij,bjk->bki"} : (tensor<?x3x4xf32>, tensor<2x4x5xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_einsum
+  // CHECK: [[RES:%.+]] = "onnx.Einsum"(%arg0, %arg1) {equation = "bij,bjk->bki"} : (tensor<?x3x4xf32>, tensor<2x4x5xf32>) -> tensor<2x5x3xf32>
+  // CHECK: return [[RES]] : tensor<2x5x3xf32>
+}
+
+// -----
+
+/// The dimensions on which the branches disagree are dynamic.
+func @test_if_region(%arg0 : tensor<i1>, %arg1 : tensor<3x4xf32>, %arg2 : tensor<3x5xf32>) -> tensor<*xf32> {
+  %0 = "onnx.IfRegion"(%arg0) ({
+    %1 = "onnx.Relu"(%arg1) : (tensor<3x4xf32>) -> tensor<*xf32>
+    "onnx.IfRegionYield"(%1) : (tensor<*xf32>) -> ()
+  }, {
+    "onnx.IfRegionYield"(%arg2) : (tensor<3x5xf32>) -> ()
+  }) : (tensor<i1>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_if_region
+  // CHECK: [[RES:%.+]] = "onnx.IfRegion"(%arg0) ( {
+  // CHECK:   [[RELU:%.+]] = "onnx.Relu"(%arg1) : (tensor<3x4xf32>) -> tensor<3x4xf32>
+  // CHECK:   "onnx.IfRegionYield"([[RELU]]) : (tensor<3x4xf32>) -> ()
+  // CHECK: },  {
+  // CHECK:   "onnx.IfRegionYield"(%arg2) : (tensor<3x5xf32>) -> ()
+  // CHECK: }) : (tensor<i1>) -> tensor<3x?xf32>
+  // CHECK: return [[RES]] : tensor<3x?xf32>
+}
+
+// -----
+
+func @test_scatter_elements(%arg0 : tensor<3x?xf32>, %arg1 : tensor<2x3xi64>, %arg2 : tensor<2x3xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ScatterElements"(%arg0, %arg1, %arg2) {axis = -1 : si64} : (tensor<3x?xf32>, tensor<2x3xi64>, tensor<2x3xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_scatter_elements
+  // CHECK: [[RES:%.+]] = "onnx.ScatterElements"(%arg0, %arg1, %arg2) {axis = 1 : si64} : (tensor<3x?xf32>, tensor<2x3xi64>, tensor<2x3xf32>) -> tensor<3x?xf32>
+  // CHECK: return [[RES]] : tensor<3x?xf32>
+}
+
+// -----
+
+func @test_scatter_nd(%arg0 : tensor<4x4x4xf32>, %arg1 : tensor<2x1xi64>, %arg2 : tensor<2x4x4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.ScatterND"(%arg0, %arg1, %arg2) : (tensor<4x4x4xf32>, tensor<2x1xi64>, tensor<2x4x4xf32>) -> tensor<*xf32>
+  "std.return"(%0) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: test_scatter_nd
+  // CHECK: [[RES:%.+]] = "onnx.ScatterND"(%arg0, %arg1, %arg2) : (tensor<4x4x4xf32>, tensor<2x1xi64>, tensor<2x4x4xf32>) -> tensor<4x4x4xf32>
+  // CHECK: return [[RES]] : tensor<4x4x4xf32>
+}
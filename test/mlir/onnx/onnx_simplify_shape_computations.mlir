@@ -0,0 +1,40 @@
+// RUN: onnx-mlir-opt --shape-inference --simplify-shape-computations %s -split-input-file | FileCheck %s
+
+/// The shape computed from the static input folds into a constant, from which
+/// the static shapes of the Reshape and of its users are inferred.
+func @test_reshape_shape_chain(%arg0: tensor<2x3x4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Shape"(%arg0) : (tensor<2x3x4xf32>) -> tensor<*xi64>
+  %1 = "onnx.Constant"() {value = dense<0> : tensor<1xi64>} : () -> tensor<1xi64>
+  %2 = "onnx.Gather"(%0, %1) {axis = 0 : si64} : (tensor<*xi64>, tensor<1xi64>) -> tensor<*xi64>
+  %3 = "onnx.Constant"() {value = dense<-1> : tensor<1xi64>} : () -> tensor<1xi64>
+  %4 = "onnx.Concat"(%2, %3) {axis = 0 : si64} : (tensor<*xi64>, tensor<1xi64>) -> tensor<*xi64>
+  %5 = "onnx.Reshape"(%arg0, %4) : (tensor<2x3x4xf32>, tensor<*xi64>) -> tensor<*xf32>
+  %6 = "onnx.Relu"(%5) : (tensor<*xf32>) -> tensor<*xf32>
+  "std.return"(%6) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: func @test_reshape_shape_chain(%arg0: tensor<2x3x4xf32>) -> tensor<2x12xf32>
+  // CHECK-NOT: "onnx.Shape"
+  // CHECK: [[SHAPE:%.+]] = "onnx.Constant"() {value = dense<[2, -1]> : tensor<2xi64>} : () -> tensor<2xi64>
+  // CHECK: [[RESHAPE:%.+]] = "onnx.Reshape"(%arg0, [[SHAPE]]) : (tensor<2x3x4xf32>, tensor<2xi64>) -> tensor<2x12xf32>
+  // CHECK: [[RELU:%.+]] = "onnx.Relu"([[RESHAPE]]) : (tensor<2x12xf32>) -> tensor<2x12xf32>
+  // CHECK: return [[RELU]] : tensor<2x12xf32>
+}
+
+// -----
+
+/// The shape of a dynamic input is left to run time.
+func @test_dynamic_shape_chain(%arg0: tensor<?x3x4xf32>) -> tensor<*xf32> {
+  %0 = "onnx.Shape"(%arg0) : (tensor<?x3x4xf32>) -> tensor<*xi64>
+  %1 = "onnx.Constant"() {value = dense<0> : tensor<1xi64>} : () -> tensor<1xi64>
+  %2 = "onnx.Gather"(%0, %1) {axis = 0 : si64} : (tensor<*xi64>, tensor<1xi64>) -> tensor<*xi64>
+  %3 = "onnx.Constant"() {value = dense<-1> : tensor<1xi64>} : () -> tensor<1xi64>
+  %4 = "onnx.Concat"(%2, %3) {axis = 0 : si64} : (tensor<*xi64>, tensor<1xi64>) -> tensor<*xi64>
+  %5 = "onnx.Reshape"(%arg0, %4) : (tensor<?x3x4xf32>, tensor<*xi64>) -> tensor<*xf32>
+  "std.return"(%5) : (tensor<*xf32>) -> ()
+
+  // CHECK-LABEL: func @test_dynamic_shape_chain(%arg0: tensor<?x3x4xf32>) -> tensor<?x?xf32>
+  // CHECK: "onnx.Shape"(%arg0)
+  // CHECK: "onnx.Gather"
+  // CHECK: "onnx.Concat"
+  // CHECK: "onnx.Reshape"
+}
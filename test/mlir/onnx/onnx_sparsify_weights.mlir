@@ -0,0 +1,46 @@
+// RUN: onnx-mlir-opt --sparsify-weights="threshold=0.7" %s -split-input-file | FileCheck %s
+
+/// The sparse weights are stored by columns of the result.
+func @test_sparse_matmul(%arg0 : tensor<?x4xf32>) -> tensor<?x2xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[1.0, 0.0], [0.0, 0.0], [0.0, 2.0], [0.0, 0.0]]> : tensor<4x2xf32>} : () -> tensor<4x2xf32>
+  %1 = "onnx.MatMul"(%arg0, %0) : (tensor<?x4xf32>, tensor<4x2xf32>) -> tensor<?x2xf32>
+  "std.return"(%1) : (tensor<?x2xf32>) -> ()
+
+  // CHECK-LABEL: test_sparse_matmul
+  // CHECK-DAG: [[ROWS:%.+]] = "onnx.Constant"() {value = dense<[0, 1, 2]> : tensor<3xi64>} : () -> tensor<3xi64>
+  // CHECK-DAG: [[COLS:%.+]] = "onnx.Constant"() {value = dense<[0, 2]> : tensor<2xi64>} : () -> tensor<2xi64>
+  // CHECK-DAG: [[VALS:%.+]] = "onnx.Constant"() {value = dense<[1.000000e+00, 2.000000e+00]> : tensor<2xf32>} : () -> tensor<2xf32>
+  // CHECK-DAG: [[NONE:%.+]] = constant unit
+  // CHECK: [[RES:%.+]] = "onnx.SparseMatMul"(%arg0, [[ROWS]], [[COLS]], [[VALS]], [[NONE]]) : (tensor<?x4xf32>, tensor<3xi64>, tensor<2xi64>, tensor<2xf32>, none) -> tensor<?x2xf32>
+  // CHECK-NOT: "onnx.MatMul"
+  // CHECK: return [[RES]] : tensor<?x2xf32>
+}
+
+// -----
+
+/// The alpha of Gemm is folded into the values, and the bias is kept.
+func @test_sparse_gemm(%arg0 : tensor<3x4xf32>, %arg1 : tensor<2xf32>) -> tensor<3x2xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[0.0, 0.0, 0.0, 1.0], [0.0, 3.0, 0.0, 0.0]]> : tensor<2x4xf32>} : () -> tensor<2x4xf32>
+  %1 = "onnx.Gemm"(%arg0, %0, %arg1) {alpha = 2.0 : f32, beta = 1.0 : f32, transA = 0 : si64, transB = 1 : si64} : (tensor<3x4xf32>, tensor<2x4xf32>, tensor<2xf32>) -> tensor<3x2xf32>
+  "std.return"(%1) : (tensor<3x2xf32>) -> ()
+
+  // CHECK-LABEL: test_sparse_gemm
+  // CHECK-DAG: [[ROWS:%.+]] = "onnx.Constant"() {value = dense<[0, 1, 2]> : tensor<3xi64>} : () -> tensor<3xi64>
+  // CHECK-DAG: [[COLS:%.+]] = "onnx.Constant"() {value = dense<[3, 1]> : tensor<2xi64>} : () -> tensor<2xi64>
+  // CHECK-DAG: [[VALS:%.+]] = "onnx.Constant"() {value = dense<[2.000000e+00, 6.000000e+00]> : tensor<2xf32>} : () -> tensor<2xf32>
+  // CHECK: [[RES:%.+]] = "onnx.SparseMatMul"(%arg0, [[ROWS]], [[COLS]], [[VALS]], %arg1)
+  // CHECK: return [[RES]] : tensor<3x2xf32>
+}
+
+// -----
+
+/// Weights below the sparsity threshold are left dense.
+func @test_dense_matmul(%arg0 : tensor<?x2xf32>) -> tensor<?x2xf32> {
+  %0 = "onnx.Constant"() {value = dense<[[1.0, 0.0], [0.0, 2.0]]> : tensor<2x2xf32>} : () -> tensor<2x2xf32>
+  %1 = "onnx.MatMul"(%arg0, %0) : (tensor<?x2xf32>, tensor<2x2xf32>) -> tensor<?x2xf32>
+  "std.return"(%1) : (tensor<?x2xf32>) -> ()
+
+  // CHECK-LABEL: test_dense_matmul
+  // CHECK-NOT: "onnx.SparseMatMul"
+  // CHECK: "onnx.MatMul"
+}
@@ -0,0 +1,37 @@
+// RUN: onnx-mlir-opt --specialize-batch-sizes="batch-sizes=1,8" %s -split-input-file | FileCheck %s
+
+/// The inputs with a dynamic leading dimension are specialized, the types of
+/// the operations are left to shape inference.
+module {
+  func @main_graph(%arg0: tensor<?x10xf32>, %arg1: tensor<10xf32>) -> tensor<*xf32> {
+    %0 = "onnx.Add"(%arg0, %arg1) : (tensor<?x10xf32>, tensor<10xf32>) -> tensor<*xf32>
+    "std.return"(%0) : (tensor<*xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 2 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph(%arg0: tensor<?x10xf32>, %arg1: tensor<10xf32>) -> tensor<*xf32>
+  // CHECK: "onnx.EntryPoint"() {batchSizes = [1, 8], batchedInputs = [0], func = @main_graph, numInputs = 2 : i32, numOutputs = 1 : i32, specializations = [@main_graph_batch1, @main_graph_batch8]} : () -> ()
+
+  // CHECK-LABEL: func @main_graph_batch1(%arg0: tensor<1x10xf32>, %arg1: tensor<10xf32>) -> tensor<*xf32>
+  // CHECK: [[ADD:%.+]] = "onnx.Add"(%arg0, %arg1) : (tensor<1x10xf32>, tensor<10xf32>) -> tensor<*xf32>
+  // CHECK: return [[ADD]] : tensor<*xf32>
+
+  // CHECK-LABEL: func @main_graph_batch8(%arg0: tensor<8x10xf32>, %arg1: tensor<10xf32>) -> tensor<*xf32>
+  // CHECK: [[ADD:%.+]] = "onnx.Add"(%arg0, %arg1) : (tensor<8x10xf32>, tensor<10xf32>) -> tensor<*xf32>
+  // CHECK: return [[ADD]] : tensor<*xf32>
+}
+
+// -----
+
+/// Graphs without a dynamic leading dimension are not specialized.
+module {
+  func @main_graph(%arg0: tensor<4x10xf32>) -> tensor<*xf32> {
+    %0 = "onnx.Relu"(%arg0) : (tensor<4x10xf32>) -> tensor<*xf32>
+    "std.return"(%0) : (tensor<*xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph(%arg0: tensor<4x10xf32>) -> tensor<*xf32>
+  // CHECK: "onnx.EntryPoint"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 1 : i32} : () -> ()
+  // CHECK-NOT: main_graph_batch
+}
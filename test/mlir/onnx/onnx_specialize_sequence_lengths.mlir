@@ -0,0 +1,35 @@
+// RUN: onnx-mlir-opt --specialize-sequence-lengths="sequence-lengths=128,32 pad=true" %s -split-input-file | FileCheck %s
+
+/// The inputs with a dynamic second dimension are specialized for the sorted
+/// sequence lengths, and padded to the smallest one they fit in.
+module {
+  func @main_graph(%arg0: tensor<?x?xi64>, %arg1: tensor<?x?xf32>, %arg2: tensor<?xf32>) -> tensor<*xf32> {
+    %0 = "onnx.Cast"(%arg0) {to = 1 : si64} : (tensor<?x?xi64>) -> tensor<*xf32>
+    %1 = "onnx.Add"(%0, %arg1) : (tensor<*xf32>, tensor<?x?xf32>) -> tensor<*xf32>
+    %2 = "onnx.Add"(%1, %arg2) : (tensor<*xf32>, tensor<?xf32>) -> tensor<*xf32>
+    "std.return"(%2) : (tensor<*xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 3 : i32, numOutputs = 1 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph(%arg0: tensor<?x?xi64>, %arg1: tensor<?x?xf32>, %arg2: tensor<?xf32>) -> tensor<*xf32>
+  // CHECK: "onnx.EntryPoint"() {batchSizes = [32, 128], batchedInputs = [0, 1], func = @main_graph, numInputs = 3 : i32, numOutputs = 1 : i32, padInputs, specializations = [@main_graph_seq32, @main_graph_seq128], specializedAxis = 1 : i64} : () -> ()
+
+  // CHECK-LABEL: func @main_graph_seq32(%arg0: tensor<?x32xi64>, %arg1: tensor<?x32xf32>, %arg2: tensor<?xf32>) -> tensor<*xf32>
+  // CHECK-LABEL: func @main_graph_seq128(%arg0: tensor<?x128xi64>, %arg1: tensor<?x128xf32>, %arg2: tensor<?xf32>) -> tensor<*xf32>
+}
+
+// -----
+
+/// Padded inputs are freed after the call, graphs returning one of their
+/// inputs are not specialized.
+module {
+  func @main_graph(%arg0: tensor<?x?xf32>) -> (tensor<*xf32>, tensor<?x?xf32>) {
+    %0 = "onnx.Relu"(%arg0) : (tensor<?x?xf32>) -> tensor<*xf32>
+    "std.return"(%0, %arg0) : (tensor<*xf32>, tensor<?x?xf32>) -> ()
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 2 : i32} : () -> ()
+
+  // CHECK-LABEL: func @main_graph(%arg0: tensor<?x?xf32>) -> (tensor<*xf32>, tensor<?x?xf32>)
+  // CHECK: "onnx.EntryPoint"() {func = @main_graph, numInputs = 1 : i32, numOutputs = 2 : i32} : () -> ()
+  // CHECK-NOT: main_graph_seq
+}
@@ -0,0 +1,58 @@
+// RUN: onnx-mlir-opt --approximate-math %s -split-input-file | FileCheck %s
+
+/// The exponential of a vector is expanded into a polynomial of the reduced
+/// argument scaled by 2^n, without math library calls.
+func @test_exp_vector(%arg0 : vector<8xf32>) -> vector<8xf32> {
+  %0 = exp %arg0 : vector<8xf32>
+  return %0 : vector<8xf32>
+
+  // CHECK-LABEL: test_exp_vector
+  // CHECK-NOT: exp
+  // CHECK: [[N:%.+]] = ceilf {{.*}} : vector<8xf32>
+  // CHECK: mulf [[N]], {{.*}} : vector<8xf32>
+  // CHECK: select {{.*}}vector<8xf32>
+  // CHECK: return {{.*}} : vector<8xf32>
+}
+
+// -----
+
+/// The logarithm of a scalar is expanded, with the special cases of 0,
+/// infinity and negative inputs selected at the end.
+func @test_log_scalar(%arg0 : f32) -> f32 {
+  %0 = log %arg0 : f32
+  return %0 : f32
+
+  // CHECK-LABEL: test_log_scalar
+  // CHECK-NOT: log
+  // CHECK: cmpf "oge", %arg0
+  // CHECK: cmpf "ult", %arg0
+  // CHECK: [[RES:%.+]] = select
+  // CHECK: return [[RES]] : f32
+}
+
+// -----
+
+/// Tanh is computed from a single expanded exponential of 2 * |x|.
+func @test_tanh_scalar(%arg0 : f32) -> f32 {
+  %0 = tanh %arg0 : f32
+  return %0 : f32
+
+  // CHECK-LABEL: test_tanh_scalar
+  // CHECK-NOT: tanh
+  // CHECK: absf %arg0 : f32
+  // CHECK: ceilf
+  // CHECK: divf
+  // CHECK: return {{.*}} : f32
+}
+
+// -----
+
+/// The f64 exponential is kept for the math library.
+func @test_exp_f64(%arg0 : f64) -> f64 {
+  %0 = exp %arg0 : f64
+  return %0 : f64
+
+  // CHECK-LABEL: test_exp_f64
+  // CHECK: [[RES:%.+]] = exp %arg0 : f64
+  // CHECK: return [[RES]] : f64
+}
@@ -0,0 +1,207 @@
+//===------- ModelBenchmark.cpp - Latency and throughput of a model -------===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains a driver measuring the load time, the latency, the
+// throughput and the peak memory of a model compiled into a shared library,
+// run on random inputs of the given shapes:
+//
+//   ModelBenchmark resnet50.so --input 1x3x224x224xf32 --concurrency 4
+//
+// Inputs are described as <dims>x<type>, with the type being f32, f64, i32 or
+// i64. Integer inputs may be followed by :<bound> to draw their values in
+// [0, bound), e.g. 1x128xi64:30522 for token identifiers. The measurements
+// are written to the standard output as a JSON object.
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "src/Runtime/ConcurrentExecutionSession.hpp"
+#include "src/Runtime/ExecutionSession.hpp"
+#include "src/Runtime/OMTensorHelper.h"
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+using OMTensorPtr = unique_ptr<OMTensor, decltype(&omTensorDestroy)>;
+
+struct Options {
+  string modelPath;
+  string entryPointName = "run_main_graph";
+  vector<string> inputs;
+  int warmup = 10;
+  int iterations = 100;
+  unsigned concurrency = 1;
+};
+
+void printUsage() {
+  cerr << "usage: ModelBenchmark <model.so> --input <shape> [--input ...]\n"
+          "           [--entry-point <name>] [--warmup <n>]\n"
+          "           [--iterations <n>] [--concurrency <n>]\n";
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--input" && hasValue)
+      options.inputs.emplace_back(argv[++i]);
+    else if (arg == "--entry-point" && hasValue)
+      options.entryPointName = argv[++i];
+    else if (arg == "--warmup" && hasValue)
+      options.warmup = atoi(argv[++i]);
+    else if (arg == "--iterations" && hasValue)
+      options.iterations = atoi(argv[++i]);
+    else if (arg == "--concurrency" && hasValue)
+      options.concurrency = atoi(argv[++i]);
+    else if (arg[0] != '-' && options.modelPath.empty())
+      options.modelPath = arg;
+    else
+      return false;
+  }
+  return !options.modelPath.empty() && options.iterations > 0 &&
+         options.concurrency > 0;
+}
+
+/// Create a tensor of random data from its description, e.g. 1x3x224x224xf32
+/// or 1x128xi64:30522.
+OMTensor *createRandomInput(const string &desc) {
+  size_t boundPos = desc.find(':');
+  string shapeAndType = desc.substr(0, boundPos);
+  int64_t bound =
+      boundPos == string::npos ? 2 : stoll(desc.substr(boundPos + 1));
+
+  vector<int64_t> shape;
+  size_t pos = 0, next;
+  while ((next = shapeAndType.find('x', pos)) != string::npos) {
+    shape.emplace_back(stoll(shapeAndType.substr(pos, next - pos)));
+    pos = next + 1;
+  }
+  string type = shapeAndType.substr(pos);
+
+  if (type == "f32")
+    return omTensorCreateWithRandomData<float>(shape);
+  if (type == "f64")
+    return omTensorCreateWithRandomData<double>(shape);
+  // Integer values are truncated from the real distribution.
+  if (type == "i32")
+    return omTensorCreateWithRandomData<int32_t>(shape, 0, bound - 1);
+  if (type == "i64")
+    return omTensorCreateWithRandomData<int64_t>(shape, 0, bound - 1);
+  throw runtime_error("unsupported input type: " + desc);
+}
+
+/// The inputs are kept across invocations.
+void keepTensor(OMTensor *) {}
+
+vector<OMTensorPtr> borrowInputs(const vector<OMTensorPtr> &tensors) {
+  vector<OMTensorPtr> inputs;
+  for (auto &tensor : tensors)
+    inputs.emplace_back(tensor.get(), keepTensor);
+  return inputs;
+}
+
+double toMs(Clock::duration duration) {
+  return chrono::duration<double, milli>(duration).count();
+}
+
+int64_t getPeakRSSKb() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage();
+    return 1;
+  }
+
+  try {
+    vector<OMTensorPtr> tensors;
+    for (auto &input : options.inputs)
+      tensors.emplace_back(createRandomInput(input), omTensorDestroy);
+
+    auto loadStart = Clock::now();
+    onnx_mlir::ExecutionSession session(
+        options.modelPath, options.entryPointName);
+    double loadTimeMs = toMs(Clock::now() - loadStart);
+
+    // The first invocations page in the constants and grow the memory pools.
+    for (int i = 0; i < options.warmup; ++i)
+      session.run(borrowInputs(tensors));
+
+    // Latency of one request at a time.
+    vector<double> latencies;
+    for (int i = 0; i < options.iterations; ++i) {
+      auto start = Clock::now();
+      session.run(borrowInputs(tensors));
+      latencies.emplace_back(toMs(Clock::now() - start));
+    }
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+      return latencies[min(latencies.size() - 1,
+          static_cast<size_t>(p * latencies.size()))];
+    };
+    double mean = 0;
+    for (double latency : latencies)
+      mean += latency / latencies.size();
+
+    // Throughput with `concurrency` requests served at a time, after a first
+    // round of requests warming the workers up.
+    double throughput;
+    {
+      onnx_mlir::ConcurrentExecutionSession concurrentSession(
+          options.modelPath, options.entryPointName, options.concurrency);
+      vector<future<vector<OMTensorPtr>>> results;
+      for (unsigned i = 0; i < options.concurrency; ++i)
+        results.emplace_back(concurrentSession.submit(borrowInputs(tensors)));
+      for (auto &result : results)
+        result.get();
+      results.clear();
+
+      int numRequests = options.iterations * options.concurrency;
+      auto start = Clock::now();
+      for (int i = 0; i < numRequests; ++i)
+        results.emplace_back(concurrentSession.submit(borrowInputs(tensors)));
+      for (auto &result : results)
+        result.get();
+      throughput = numRequests / (toMs(Clock::now() - start) / 1e3);
+    }
+
+    printf("{\"load_time_ms\": %.3f, \"latency_ms\": {\"mean\": %.3f, "
+           "\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f}, "
+           "\"concurrency\": %u, \"throughput_per_s\": %.3f, "
+           "\"peak_rss_kb\": %lld}\n",
+        loadTimeMs, mean, percentile(0.5), percentile(0.9), percentile(0.99),
+        options.concurrency, throughput, (long long)getPeakRSSKb());
+  } catch (const exception &e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
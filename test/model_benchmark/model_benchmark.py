@@ -0,0 +1,168 @@
+# Compile the models listed in a configuration file with onnx-mlir and
+# measure their load time, latency, throughput and peak memory with the
+# ModelBenchmark driver.
+#
+# The measurements of all the models are written into the output report. When
+# a baseline report of a previous run is given, models whose latency or peak
+# memory grew, or whose throughput dropped, by more than the tolerance are
+# reported and make the script fail.
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+VERBOSE = bool(os.environ.get("VERBOSE"))
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument("--onnx-mlir", required=True, help="onnx-mlir binary")
+parser.add_argument("--driver", required=True,
+                    help="ModelBenchmark binary")
+parser.add_argument("--models", required=True,
+                    help="JSON file listing the models and their inputs")
+parser.add_argument("--model-dir", default="",
+                    help="directory holding the models")
+parser.add_argument("--output", required=True, help="report to write")
+parser.add_argument("--baseline", default="",
+                    help="report of a previous run to compare against")
+parser.add_argument("--tolerance", type=float, default=0.1,
+                    help="relative change reported as a regression")
+parser.add_argument("--warmup", type=int, default=10,
+                    help="invocations before the measurements")
+parser.add_argument("--iterations", type=int, default=100,
+                    help="invocations measured per worker")
+parser.add_argument("--concurrency", type=int, default=4,
+                    help="requests served at a time for the throughput")
+parser.add_argument("--compile-options", default="",
+                    help="additional options of onnx-mlir")
+
+
+def run(cmd):
+    if VERBOSE:
+        print(" ".join(cmd))
+    return subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+
+
+def compile_model(args, model_path, work_dir):
+    base = os.path.join(work_dir,
+                        os.path.splitext(os.path.basename(model_path))[0])
+    result = run([args.onnx_mlir, "--EmitLib", "-o", base] +
+                 args.compile_options.split() + [model_path])
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr.decode(errors="replace"))
+        return None
+    return base + ".so"
+
+
+def benchmark_model(args, model, lib_path):
+    cmd = [
+        args.driver, lib_path, "--warmup",
+        str(args.warmup), "--iterations",
+        str(args.iterations), "--concurrency",
+        str(args.concurrency)
+    ]
+    for model_input in model["inputs"]:
+        cmd += ["--input", model_input]
+    result = run(cmd)
+    if result.returncode != 0:
+        sys.stderr.write(result.stderr.decode(errors="replace"))
+        return None
+    return json.loads(result.stdout.decode())
+
+
+# Metrics compared against the baseline, and whether larger values are worse.
+METRICS = [
+    (("latency_ms", "p50"), True),
+    (("latency_ms", "p99"), True),
+    (("throughput_per_s", ), False),
+    (("peak_rss_kb", ), True),
+    (("load_time_ms", ), True),
+]
+
+
+def get_metric(numbers, path):
+    for key in path:
+        numbers = numbers[key]
+    return numbers
+
+
+def find_regressions(report, baseline, tolerance):
+    regressions = []
+    for model, numbers in report.items():
+        if model not in baseline or "error" in numbers or \
+                "error" in baseline[model]:
+            continue
+        for path, larger_is_worse in METRICS:
+            old = get_metric(baseline[model], path)
+            new = get_metric(numbers, path)
+            if old <= 0:
+                continue
+            change = (new - old) / old
+            if (change if larger_is_worse else -change) > tolerance:
+                regressions.append("{}: {} went from {:.3f} to {:.3f}".format(
+                    model, ".".join(path), old, new))
+    return regressions
+
+
+def main():
+    args = parser.parse_args()
+    if not args.model_dir or not os.path.isdir(args.model_dir):
+        print("Set ONNX_MLIR_MODEL_ZOO_DIR to a directory holding the models "
+              "listed in " + args.models)
+        return 1
+    with open(args.models) as f:
+        models = json.load(f)["models"]
+
+    report = {}
+    failures = []
+    work_dir = tempfile.mkdtemp(prefix="onnx-mlir-model-benchmark-")
+    try:
+        for model in models:
+            name = model["name"]
+            model_path = os.path.join(args.model_dir, model["file"])
+            if not os.path.exists(model_path):
+                print("{}: {} not found, skipped".format(name, model["file"]))
+                continue
+            lib_path = compile_model(args, model_path, work_dir)
+            numbers = benchmark_model(args, model, lib_path) \
+                if lib_path else None
+            if numbers is None:
+                failures.append(name)
+                report[name] = {"error": "compilation failed" if not lib_path
+                                else "run failed"}
+                print("{}: {}".format(name, report[name]["error"]))
+                continue
+            report[name] = numbers
+            print("{}: load {:.1f} ms, p50 {:.3f} ms, p99 {:.3f} ms, "
+                  "{:.1f}/s at concurrency {}, peak RSS {} KB".format(
+                      name, numbers["load_time_ms"],
+                      numbers["latency_ms"]["p50"],
+                      numbers["latency_ms"]["p99"],
+                      numbers["throughput_per_s"], numbers["concurrency"],
+                      numbers["peak_rss_kb"]))
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    with open(args.output, "w") as f:
+        json.dump(report, f, indent=2)
+
+    regressions = []
+    if args.baseline:
+        with open(args.baseline) as f:
+            regressions = find_regressions(report, json.load(f),
+                                           args.tolerance)
+        for regression in regressions:
+            print("regression: " + regression)
+    return 1 if failures or regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,94 @@
+# Tests of the import of a subset of the outputs of a model with --outputs,
+# which only imports the nodes these outputs depend on. The onnx-mlir binary
+# is given on the command line.
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+import onnx
+from onnx import helper
+from onnx import TensorProto
+
+ONNX_MLIR = sys.argv.pop(1)
+
+
+# A model whose outputs are A = Relu(X), B = Neg(X) and D = If(cond, Abs(X),
+# X). Abs(X) is only read by the then branch of the If.
+def make_model():
+    x = helper.make_tensor_value_info('X', TensorProto.FLOAT, [2])
+    cond = helper.make_tensor_value_info('cond', TensorProto.BOOL, [])
+    then_branch = helper.make_graph(
+        [helper.make_node('Identity', ['C'], ['then_out'])], 'then_branch', [],
+        [helper.make_tensor_value_info('then_out', TensorProto.FLOAT, [2])])
+    else_branch = helper.make_graph(
+        [helper.make_node('Identity', ['X'], ['else_out'])], 'else_branch', [],
+        [helper.make_tensor_value_info('else_out', TensorProto.FLOAT, [2])])
+    nodes = [
+        helper.make_node('Relu', ['X'], ['A']),
+        helper.make_node('Neg', ['X'], ['B']),
+        helper.make_node('Abs', ['X'], ['C']),
+        helper.make_node('If', ['cond'], ['D'],
+                         then_branch=then_branch,
+                         else_branch=else_branch),
+    ]
+    outputs = [
+        helper.make_tensor_value_info(name, TensorProto.FLOAT, [2])
+        for name in ['A', 'B', 'D']
+    ]
+    graph = helper.make_graph(nodes, 'outputs', [x, cond], outputs)
+    return helper.make_model(graph, producer_name='ImportOutputsTest')
+
+
+class ImportOutputsTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.TemporaryDirectory()
+        self.model_path = os.path.join(self.dir.name, 'model.onnx')
+        onnx.save(make_model(), self.model_path)
+
+    def tearDown(self):
+        self.dir.cleanup()
+
+    # Import the model with the given outputs and return the process and the
+    # imported module.
+    def run_import(self, outputs):
+        process = subprocess.run(
+            [ONNX_MLIR, '--EmitONNXBasic', '--outputs=' + outputs,
+             self.model_path],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            universal_newlines=True)
+        mlir_path = os.path.join(self.dir.name, 'model.onnx.mlir')
+        if process.returncode != 0:
+            return process, None
+        with open(mlir_path) as mlir_file:
+            return process, mlir_file.read()
+
+    def test_dead_nodes_are_pruned(self):
+        process, module = self.run_import('A')
+        self.assertEqual(process.returncode, 0, process.stderr)
+        self.assertIn('output_names = ["A"]', module)
+        self.assertIn('onnx.Relu', module)
+        for op in ['onnx.Neg', 'onnx.Abs', 'onnx.IfRegion']:
+            self.assertNotIn(op, module)
+
+    def test_subgraph_inputs_are_kept(self):
+        # The outputs are imported in the order given.
+        process, module = self.run_import('D,A')
+        self.assertEqual(process.returncode, 0, process.stderr)
+        self.assertIn('output_names = ["D", "A"]', module)
+        for op in ['onnx.Relu', 'onnx.Abs', 'onnx.IfRegion']:
+            self.assertIn(op, module)
+        self.assertNotIn('onnx.Neg', module)
+
+    def test_unknown_output_is_an_error(self):
+        process, module = self.run_import('A,Z')
+        self.assertNotEqual(process.returncode, 0)
+        self.assertIn('output Z not found in the model', process.stderr)
+        self.assertIsNone(module)
+
+
+if __name__ == '__main__':
+    unittest.main()
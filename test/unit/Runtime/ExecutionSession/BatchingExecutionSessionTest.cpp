@@ -0,0 +1,200 @@
+//===--- BatchingExecutionSessionTest.cpp - Batching Session Unit Test ----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the batching execution session, run on
+// run_main_graph of TestModel.c.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+#include <dlfcn.h>
+#include <stdexcept>
+#include <vector>
+
+#include "BatchingExecutionSession.hpp"
+
+using namespace onnx_mlir;
+
+typedef BatchingExecutionSession::OMTensorPtr OMTensorPtr;
+typedef std::future<std::vector<OMTensorPtr>> Results;
+typedef int64_t (*numCallsFuncType)();
+typedef void (*setSignatureFuncType)(const char *, const char *);
+
+// The scale of the outputs of run_main_graph, see TestModel.c.
+static const float kScale = 2.f;
+
+static numCallsFuncType getNumCalls;
+static setSignatureFuncType setSignature;
+
+// A request with a single input of shape [rows, cols], whose elements are
+// value, value + 1, ... in row-major order.
+static std::vector<OMTensorPtr> createInputs(
+    int64_t rows, int64_t cols, float value) {
+  int64_t shape[] = {rows, cols};
+  std::vector<OMTensorPtr> ins;
+  ins.emplace_back(
+      omTensorCreateEmpty(shape, 2, ONNX_TYPE_FLOAT), omTensorDestroy);
+  for (int64_t i = 0; i < rows * cols; i++)
+    ((float *)omTensorGetDataPtr(ins[0].get()))[i] = value + i;
+  return ins;
+}
+
+// Check that the results of a request are the outputs of its own inputs.
+static void checkResults(
+    Results &results, int64_t rows, int64_t cols, float value) {
+  auto outs = results.get();
+  assert(outs.size() == 1);
+  assert(omTensorGetRank(outs[0].get()) == 2);
+  assert(omTensorGetDataShape(outs[0].get())[0] == rows);
+  assert(omTensorGetDataShape(outs[0].get())[1] == cols);
+  float *data = (float *)omTensorGetDataPtr(outs[0].get());
+  for (int64_t i = 0; i < rows * cols; i++)
+    assert(data[i] == kScale * (value + i));
+}
+
+// Full batches run without waiting for the latency window.
+void testFullBatches() {
+  int64_t numCalls = getNumCalls();
+  BatchingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+      /*maxBatchSize=*/4, std::chrono::seconds(10));
+  std::vector<Results> results;
+  for (int r = 0; r < 8; r++)
+    results.emplace_back(session.submit(createInputs(1, 3, 10 * r)));
+  for (int r = 0; r < 8; r++)
+    checkResults(results[r], 1, 3, 10 * r);
+  assert(getNumCalls() == numCalls + 2);
+}
+
+// A partial batch runs once its oldest request has waited for the latency
+// window.
+void testLatencyWindow() {
+  int64_t numCalls = getNumCalls();
+  BatchingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+      /*maxBatchSize=*/4, std::chrono::milliseconds(10));
+  Results results = session.submit(createInputs(2, 3, 0));
+  checkResults(results, 2, 3, 0);
+  assert(getNumCalls() == numCalls + 1);
+}
+
+// Requests of different shapes are run in different batches. The window
+// leaves the time to queue the four requests before the first batch runs.
+void testIncompatibleRequests() {
+  int64_t numCalls = getNumCalls();
+  BatchingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+      /*maxBatchSize=*/4, std::chrono::milliseconds(200));
+  std::vector<Results> results;
+  results.emplace_back(session.submit(createInputs(1, 3, 0)));
+  results.emplace_back(session.submit(createInputs(2, 5, 100)));
+  results.emplace_back(session.submit(createInputs(1, 3, 200)));
+  results.emplace_back(session.submit(createInputs(2, 5, 300)));
+  checkResults(results[0], 1, 3, 0);
+  checkResults(results[1], 2, 5, 100);
+  checkResults(results[2], 1, 3, 200);
+  checkResults(results[3], 2, 5, 300);
+  assert(getNumCalls() == numCalls + 2);
+}
+
+// Destroying the session runs the queued requests without waiting for the
+// latency window.
+void testDestroyRunsQueuedRequests() {
+  std::vector<Results> results;
+  {
+    BatchingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+        /*maxBatchSize=*/4, std::chrono::seconds(600));
+    for (int r = 0; r < 2; r++)
+      results.emplace_back(session.submit(createInputs(1, 3, r)));
+  }
+  for (int r = 0; r < 2; r++)
+    checkResults(results[r], 1, 3, r);
+}
+
+// Requests with inputs which are not dense are run on their own.
+void testNonDenseInputs() {
+  int64_t numCalls = getNumCalls();
+  BatchingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+      /*maxBatchSize=*/2, std::chrono::milliseconds(200));
+
+  // A view [10, 11, 12] of every other element of a buffer.
+  int64_t bufferShape[] = {1, 6}, shape[] = {1, 3}, strides[] = {6, 2};
+  OMTensor *buffer = omTensorCreateEmpty(bufferShape, 2, ONNX_TYPE_FLOAT);
+  float *data = (float *)omTensorGetDataPtr(buffer);
+  for (int i = 0; i < 3; i++)
+    data[2 * i] = 10 + i;
+  std::vector<OMTensorPtr> strided;
+  strided.emplace_back(
+      omTensorCreate(data, shape, 2, ONNX_TYPE_FLOAT), omTensorDestroy);
+  omTensorSetStrides(strided[0].get(), strides);
+
+  Results stridedResults = session.submit(std::move(strided));
+  Results denseResults = session.submit(createInputs(1, 3, 100));
+  checkResults(stridedResults, 1, 3, 10);
+  checkResults(denseResults, 1, 3, 100);
+  assert(getNumCalls() == numCalls + 2);
+  omTensorDestroy(buffer);
+}
+
+// Models whose signature has a static first dimension run the requests one
+// at a time, those with a dynamic first dimension batch them.
+void testSignatureBatchDim() {
+  setSignature(R"([{"dims":[1,3],"name":"x","type":"f32"}])",
+      R"([{"dims":[1,3],"name":"y","type":"f32"}])");
+  {
+    int64_t numCalls = getNumCalls();
+    BatchingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+        /*maxBatchSize=*/2, std::chrono::milliseconds(200));
+    Results first = session.submit(createInputs(1, 3, 0));
+    Results second = session.submit(createInputs(1, 3, 100));
+    checkResults(first, 1, 3, 0);
+    checkResults(second, 1, 3, 100);
+    assert(getNumCalls() == numCalls + 2);
+  }
+
+  setSignature(R"([{"dims":[-1,3],"name":"x","type":"f32"}])",
+      R"([{"dims":[-1,3],"name":"y","type":"f32"}])");
+  {
+    int64_t numCalls = getNumCalls();
+    BatchingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+        /*maxBatchSize=*/2, std::chrono::seconds(10));
+    Results first = session.submit(createInputs(1, 3, 0));
+    Results second = session.submit(createInputs(1, 3, 100));
+    checkResults(first, 1, 3, 0);
+    checkResults(second, 1, 3, 100);
+    assert(getNumCalls() == numCalls + 1);
+  }
+  setSignature("", "");
+}
+
+void testRank0Input() {
+  BatchingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+      /*maxBatchSize=*/4, std::chrono::milliseconds(10));
+  std::vector<OMTensorPtr> ins;
+  ins.emplace_back(
+      omTensorCreateEmpty(nullptr, 0, ONNX_TYPE_FLOAT), omTensorDestroy);
+  bool thrown = false;
+  try {
+    session.submit(std::move(ins));
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+int main() {
+  void *handle = dlopen(TEST_MODEL_PATH, RTLD_NOW);
+  assert(handle);
+  getNumCalls = (numCallsFuncType)dlsym(handle, "testModelGetNumCalls");
+  setSignature =
+      (setSignatureFuncType)dlsym(handle, "testModelSetSignature");
+  assert(getNumCalls && setSignature);
+  testFullBatches();
+  testLatencyWindow();
+  testIncompatibleRequests();
+  testDestroyRunsQueuedRequests();
+  testNonDenseInputs();
+  testSignatureBatchDim();
+  testRank0Input();
+  dlclose(handle);
+  return 0;
+}
@@ -0,0 +1,107 @@
+//===-- CachingExecutionSessionTest.cpp - Caching Session Unit Test -------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the caching execution session, run on
+// run_main_graph of TestModel.c.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+#include <dlfcn.h>
+#include <vector>
+
+#include "CachingExecutionSession.hpp"
+
+using namespace onnx_mlir;
+
+typedef int64_t (*numCallsFuncType)();
+
+// The scale of the outputs of run_main_graph, see TestModel.c.
+static const float kScale = 2.f;
+
+static numCallsFuncType getNumCalls;
+
+// Check that the single output of a request is the input [value, value + 1,
+// value + 2] scaled by the model.
+static void checkOutputs(
+    const CachingExecutionSession::Results &outs, float value) {
+  assert(outs->size() == 1);
+  float *data = (float *)omTensorGetDataPtr((*outs)[0].get());
+  for (int i = 0; i < 3; i++)
+    assert(data[i] == kScale * (value + i));
+}
+
+void testHitAndMissAfterChange() {
+  CachingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+      /*memoryBudget=*/1 << 20);
+  int64_t shape[] = {3};
+  OMTensor *in = omTensorCreateEmpty(shape, 1, ONNX_TYPE_FLOAT);
+  float *data = (float *)omTensorGetDataPtr(in);
+  for (int i = 0; i < 3; i++)
+    data[i] = i;
+
+  int64_t numCalls = getNumCalls();
+  auto first = session.runCached({in});
+  checkOutputs(first, 0);
+  auto second = session.runCached({in});
+  assert(second == first);
+  assert(getNumCalls() == numCalls + 1);
+  auto stats = session.getCacheStats();
+  assert(stats.hits == 1 && stats.misses == 1 && stats.entries == 1);
+
+  // Changing the data of the input in place runs the model again.
+  for (int i = 0; i < 3; i++)
+    data[i] = i + 1;
+  auto third = session.runCached({in});
+  checkOutputs(third, 1);
+  assert(getNumCalls() == numCalls + 2);
+  stats = session.getCacheStats();
+  assert(stats.hits == 1 && stats.misses == 2 && stats.entries == 2);
+  omTensorDestroy(in);
+}
+
+void testNonDenseInputsBypassCache() {
+  CachingExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+      /*memoryBudget=*/1 << 20);
+  int64_t bufferShape[] = {6}, shape[] = {3}, strides[] = {2};
+  OMTensor *buffer = omTensorCreateEmpty(bufferShape, 1, ONNX_TYPE_FLOAT);
+  float *data = (float *)omTensorGetDataPtr(buffer);
+  for (int i = 0; i < 6; i++)
+    data[i] = i;
+
+  // A strided view [0, 2, 4] of the buffer, and a view [1, 2, 3] starting at
+  // an offset.
+  OMTensor *strided = omTensorCreate(data, shape, 1, ONNX_TYPE_FLOAT);
+  omTensorSetStrides(strided, strides);
+  OMTensor *shifted = omTensorCreate(data, shape, 1, ONNX_TYPE_FLOAT);
+  omTensorSetOffset(shifted, 1);
+
+  int64_t numCalls = getNumCalls();
+  for (int i = 0; i < 2; i++) {
+    auto outs = session.runCached({strided});
+    float *outData = (float *)omTensorGetDataPtr((*outs)[0].get());
+    for (int j = 0; j < 3; j++)
+      assert(outData[j] == kScale * 2 * j);
+    checkOutputs(session.runCached({shifted}), 1);
+  }
+  assert(getNumCalls() == numCalls + 4);
+  auto stats = session.getCacheStats();
+  assert(stats.hits == 0 && stats.misses == 4 && stats.entries == 0);
+
+  omTensorDestroy(shifted);
+  omTensorDestroy(strided);
+  omTensorDestroy(buffer);
+}
+
+int main() {
+  void *handle = dlopen(TEST_MODEL_PATH, RTLD_NOW);
+  assert(handle);
+  getNumCalls = (numCallsFuncType)dlsym(handle, "testModelGetNumCalls");
+  assert(getNumCalls);
+  testHitAndMissAfterChange();
+  testNonDenseInputsBypassCache();
+  dlclose(handle);
+  return 0;
+}
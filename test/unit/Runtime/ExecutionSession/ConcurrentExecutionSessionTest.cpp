@@ -0,0 +1,122 @@
+//===- ConcurrentExecutionSessionTest.cpp - Concurrent Session Unit Test --===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the concurrent execution session, run on
+// the entry points of TestModel.c.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+#include <dlfcn.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+#include "ConcurrentExecutionSession.hpp"
+
+using namespace onnx_mlir;
+
+typedef ConcurrentExecutionSession::OMTensorPtr OMTensorPtr;
+typedef int64_t (*numCallsFuncType)();
+
+// The scale of the outputs of run_main_graph and run_arena, see TestModel.c.
+static const float kScale = 2.f;
+
+static numCallsFuncType getNumCalls;
+
+static std::vector<OMTensorPtr> createInputs(float value) {
+  int64_t shape[] = {64};
+  std::vector<OMTensorPtr> ins;
+  ins.emplace_back(
+      omTensorCreateEmpty(shape, 1, ONNX_TYPE_FLOAT), omTensorDestroy);
+  for (int i = 0; i < 64; i++)
+    ((float *)omTensorGetDataPtr(ins[0].get()))[i] = value + i;
+  return ins;
+}
+
+// Submit requests to a session and check that each future gets the outputs
+// of its own inputs.
+static void runRequests(ConcurrentExecutionSession &session, int numRequests) {
+  std::vector<std::future<std::vector<OMTensorPtr>>> results;
+  for (int r = 0; r < numRequests; r++)
+    results.emplace_back(session.submit(createInputs(r)));
+  for (int r = 0; r < numRequests; r++) {
+    auto outs = results[r].get();
+    assert(outs.size() == 1);
+    float *data = (float *)omTensorGetDataPtr(outs[0].get());
+    for (int i = 0; i < 64; i++)
+      assert(data[i] == kScale * (r + i));
+  }
+}
+
+void testSubmit() {
+  int64_t numCalls = getNumCalls();
+  ConcurrentExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+      /*numWorkers=*/4);
+  assert(session.getNumWorkers() == 4);
+  runRequests(session, 32);
+  assert(getNumCalls() == numCalls + 32);
+}
+
+// The workers compute in buffers of their own memory arena, so that the
+// requests running at once never share them.
+void testArenaPerWorker() {
+  ConcurrentExecutionSession session(TEST_MODEL_PATH, "run_arena",
+      /*numWorkers=*/4);
+  runRequests(session, 64);
+}
+
+// The requests queued when the session is destroyed are run before the
+// workers stop.
+void testDestroyRunsQueuedRequests() {
+  int64_t numCalls = getNumCalls();
+  std::vector<std::future<std::vector<OMTensorPtr>>> results;
+  {
+    ConcurrentExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+        /*numWorkers=*/2);
+    for (int r = 0; r < 16; r++)
+      results.emplace_back(session.submit(createInputs(r)));
+  }
+  assert(getNumCalls() == numCalls + 16);
+  for (auto &result : results)
+    assert(result.get().size() == 1);
+}
+
+void testNumaNode() {
+  assert(ConcurrentExecutionSession::getNumNumaNodes() >= 1);
+#ifdef __linux__
+  // The workers of a session on node 0 run the private copy of the model,
+  // whose calls are not counted by the library loaded by the process.
+  if (access("/sys/devices/system/node/node0/cpulist", R_OK) == 0) {
+    int64_t numCalls = getNumCalls();
+    ConcurrentExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+        /*numWorkers=*/2, /*numaNode=*/0);
+    runRequests(session, 8);
+    assert(getNumCalls() == numCalls);
+  }
+
+  bool thrown = false;
+  try {
+    ConcurrentExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+        /*numWorkers=*/1, /*numaNode=*/1 << 20);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+#endif
+}
+
+int main() {
+  void *handle = dlopen(TEST_MODEL_PATH, RTLD_NOW);
+  assert(handle);
+  getNumCalls = (numCallsFuncType)dlsym(handle, "testModelGetNumCalls");
+  assert(getNumCalls);
+  testSubmit();
+  testArenaPerWorker();
+  testDestroyRunsQueuedRequests();
+  testNumaNode();
+  dlclose(handle);
+  return 0;
+}
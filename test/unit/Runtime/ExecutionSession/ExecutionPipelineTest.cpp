@@ -0,0 +1,95 @@
+//===------ ExecutionPipelineTest.cpp - Execution Pipeline Unit Test ------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the execution pipeline, run on the entry
+// points of TestModel.c.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+#include <stdexcept>
+#include <vector>
+
+#include "ExecutionPipeline.hpp"
+
+using namespace onnx_mlir;
+
+typedef ExecutionPipeline::OMTensorPtr OMTensorPtr;
+
+// The scale of the outputs of run_main_graph, see TestModel.c.
+static const float kScale = 2.f;
+
+static std::vector<OMTensorPtr> createInputs(float value) {
+  int64_t shape[] = {2};
+  std::vector<OMTensorPtr> ins;
+  ins.emplace_back(
+      omTensorCreateEmpty(shape, 1, ONNX_TYPE_FLOAT), omTensorDestroy);
+  float *data = (float *)omTensorGetDataPtr(ins[0].get());
+  data[0] = value;
+  data[1] = -value;
+  return ins;
+}
+
+void testStages() {
+  // The connector adds 1 to the outputs of the first stage.
+  ExecutionPipeline::StageDesc first, second;
+  first.sharedLibPath = second.sharedLibPath = TEST_MODEL_PATH;
+  first.numWorkers = 2;
+  second.connector = [](std::vector<OMTensorPtr> tensors) {
+    float *data = (float *)omTensorGetDataPtr(tensors[0].get());
+    data[0] += 1.f;
+    data[1] += 1.f;
+    return tensors;
+  };
+  ExecutionPipeline pipeline({first, second});
+  assert(pipeline.getNumStages() == 2);
+
+  std::vector<std::future<std::vector<OMTensorPtr>>> results;
+  for (int i = 0; i < 32; i++)
+    results.push_back(pipeline.submit(createInputs(i)));
+  for (int i = 0; i < 32; i++) {
+    auto outs = results[i].get();
+    float *data = (float *)omTensorGetDataPtr(outs[0].get());
+    assert(data[0] == kScale * (kScale * i + 1.f));
+    assert(data[1] == kScale * (-kScale * i + 1.f));
+  }
+}
+
+void testConnectorError() {
+  ExecutionPipeline::StageDesc first, second;
+  first.sharedLibPath = second.sharedLibPath = TEST_MODEL_PATH;
+  second.connector = [](std::vector<OMTensorPtr> tensors)
+      -> std::vector<OMTensorPtr> { throw std::runtime_error("connector"); };
+  ExecutionPipeline pipeline({first, second});
+  auto results = pipeline.submit(createInputs(1.f));
+  try {
+    results.get();
+    assert(false && "connector error not rethrown");
+  } catch (const std::runtime_error &error) {
+    assert(std::string(error.what()) == "connector");
+  }
+}
+
+void testStageLoadError() {
+  // The stages are loaded from the last one, which is started before the
+  // first one fails to load and is stopped when the construction is
+  // abandoned.
+  ExecutionPipeline::StageDesc first, second;
+  first.sharedLibPath = "no-such-model.so";
+  second.sharedLibPath = TEST_MODEL_PATH;
+  second.numWorkers = 4;
+  try {
+    ExecutionPipeline pipeline({first, second});
+    assert(false && "missing model loaded");
+  } catch (const std::runtime_error &) {
+  }
+}
+
+int main() {
+  testStages();
+  testConnectorError();
+  testStageLoadError();
+  return 0;
+}
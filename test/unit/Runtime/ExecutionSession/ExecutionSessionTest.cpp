@@ -0,0 +1,174 @@
+//===------ ExecutionSessionTest.cpp - Execution Session Unit Test --------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the execution session, run on the entry
+// points of TestModel.c.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <vector>
+
+#include "ExecutionSession.hpp"
+
+using namespace onnx_mlir;
+
+typedef std::unique_ptr<OMTensor, decltype(&omTensorDestroy)> OMTensorPtr;
+typedef int64_t (*numCallsFuncType)();
+typedef int (*configureThreadsFuncType)(const int *, int64_t, int32_t);
+typedef void (*setSignatureFuncType)(const char *, const char *);
+
+// The scale of the outputs of run_main_graph, see TestModel.c.
+static const float kScale = 2.f;
+
+static std::vector<OMTensorPtr> createInputs(float value) {
+  int64_t shape[] = {3};
+  std::vector<OMTensorPtr> ins;
+  ins.emplace_back(
+      omTensorCreateEmpty(shape, 1, ONNX_TYPE_FLOAT), omTensorDestroy);
+  for (int i = 0; i < 3; i++)
+    ((float *)omTensorGetDataPtr(ins[0].get()))[i] = value + i;
+  return ins;
+}
+
+void testPrivateCopy() {
+  void *handle = dlopen(TEST_MODEL_PATH, RTLD_NOW);
+  assert(handle);
+  auto getNumCalls = (numCallsFuncType)dlsym(handle, "testModelGetNumCalls");
+  assert(getNumCalls);
+  int64_t numCalls = getNumCalls();
+
+  // The private copy counts its calls apart from the library loaded by the
+  // process. Its outputs are allocated on the heap of the process and freed
+  // by it.
+  {
+    ExecutionSession session(TEST_MODEL_PATH, "run_main_graph",
+        /*privateCopy=*/true);
+    for (int i = 0; i < 4; i++) {
+      auto outs = session.run(createInputs(i));
+      assert(outs.size() == 1);
+      for (int j = 0; j < 3; j++)
+        assert(((float *)omTensorGetDataPtr(outs[0].get()))[j] ==
+               kScale * (i + j));
+    }
+  }
+  assert(getNumCalls() == numCalls);
+
+  ExecutionSession session(TEST_MODEL_PATH, "run_main_graph");
+  session.run(createInputs(0));
+  assert(getNumCalls() == numCalls + 1);
+  dlclose(handle);
+}
+
+// Test if running the session into the given outputs throws an exception
+// without running the model.
+static bool runIntoThrows(ExecutionSession &session,
+    const std::vector<OMTensor *> &outs, numCallsFuncType getNumCalls) {
+  int64_t numCalls = getNumCalls();
+  try {
+    session.runInto(createInputs(0), outs);
+  } catch (const std::runtime_error &) {
+    return getNumCalls() == numCalls;
+  }
+  return false;
+}
+
+void testRunIntoChecksOutputs() {
+  void *handle = dlopen(TEST_MODEL_PATH, RTLD_NOW);
+  assert(handle);
+  auto getNumCalls = (numCallsFuncType)dlsym(handle, "testModelGetNumCalls");
+  auto setSignature =
+      (setSignatureFuncType)dlsym(handle, "testModelSetSignature");
+  assert(getNumCalls && setSignature);
+  setSignature("", R"([{"dims":[3],"name":"y","type":"f32"}])");
+
+  {
+    ExecutionSession session(TEST_MODEL_PATH, "run_main_graph");
+    int64_t shape[] = {3}, otherShape[] = {4}, bufferShape[] = {6};
+    int64_t strides[] = {2};
+    OMTensorPtr out(
+        omTensorCreateEmpty(shape, 1, ONNX_TYPE_FLOAT), omTensorDestroy);
+    session.runInto(createInputs(1), {out.get()});
+    for (int j = 0; j < 3; j++)
+      assert(((float *)omTensorGetDataPtr(out.get()))[j] == kScale * (1 + j));
+
+    // Outputs of another shape or element type, strided outputs and extra
+    // outputs are rejected.
+    OMTensorPtr otherShapeOut(
+        omTensorCreateEmpty(otherShape, 1, ONNX_TYPE_FLOAT), omTensorDestroy);
+    OMTensorPtr otherTypeOut(
+        omTensorCreateEmpty(shape, 1, ONNX_TYPE_DOUBLE), omTensorDestroy);
+    OMTensorPtr buffer(
+        omTensorCreateEmpty(bufferShape, 1, ONNX_TYPE_FLOAT), omTensorDestroy);
+    OMTensorPtr stridedOut(
+        omTensorCreate(omTensorGetDataPtr(buffer.get()), shape, 1,
+            ONNX_TYPE_FLOAT),
+        omTensorDestroy);
+    omTensorSetStrides(stridedOut.get(), strides);
+    assert(runIntoThrows(session, {otherShapeOut.get()}, getNumCalls));
+    assert(runIntoThrows(session, {otherTypeOut.get()}, getNumCalls));
+    assert(runIntoThrows(session, {stridedOut.get()}, getNumCalls));
+    assert(runIntoThrows(session, {out.get(), out.get()}, getNumCalls));
+  }
+
+  setSignature("", "");
+  dlclose(handle);
+}
+
+#ifdef __linux__
+// Return the number of threads of the process.
+static int getNumThreads() {
+  DIR *tasks = opendir("/proc/self/task");
+  assert(tasks);
+  int numThreads = 0;
+  while (struct dirent *task = readdir(tasks))
+    numThreads += task->d_name[0] != '.';
+  closedir(tasks);
+  return numThreads;
+}
+
+void testUnloadStopsMemcpyThreads() {
+  int numThreads = getNumThreads();
+  {
+    ExecutionSession session(TEST_MODEL_PATH, "run_copy");
+    void *handle = dlopen(TEST_MODEL_PATH, RTLD_NOW);
+    auto configureThreads =
+        (configureThreadsFuncType)dlsym(handle, "omMemcpyConfigureThreads");
+    assert(configureThreads);
+    assert(configureThreads(nullptr, 0, /*spinWait=*/1) == 0);
+    assert(getNumThreads() == numThreads + 2);
+    dlclose(handle);
+
+    // A copy large enough to be split between the threads.
+    int64_t shape[] = {1 << 20};
+    std::vector<OMTensorPtr> ins;
+    ins.emplace_back(
+        omTensorCreateEmpty(shape, 1, ONNX_TYPE_FLOAT), omTensorDestroy);
+    float *data = (float *)omTensorGetDataPtr(ins[0].get());
+    for (int64_t i = 0; i < shape[0]; i++)
+      data[i] = i;
+    auto outs = session.run(std::move(ins));
+    float *copy = (float *)omTensorGetDataPtr(outs[0].get());
+    for (int64_t i = 0; i < shape[0]; i++)
+      assert(copy[i] == i);
+  }
+  // The spinning threads are joined when the library is unloaded.
+  assert(getNumThreads() == numThreads);
+}
+#endif
+
+int main() {
+  testPrivateCopy();
+  testRunIntoChecksOutputs();
+#ifdef __linux__
+  setenv("ONNX_MLIR_MEMCPY_THREADS", "2", 1);
+  testUnloadStopsMemcpyThreads();
+#endif
+  return 0;
+}
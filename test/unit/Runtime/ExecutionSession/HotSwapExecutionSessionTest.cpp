@@ -0,0 +1,107 @@
+//===-- HotSwapExecutionSessionTest.cpp - Hot Swap Session Unit Test ------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the hot swap execution session, swapping
+// the two versions of the model of TestModel.c, which scale their inputs by 2
+// and 3.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "HotSwapExecutionSession.hpp"
+
+using namespace onnx_mlir;
+
+typedef HotSwapExecutionSession::OMTensorPtr OMTensorPtr;
+
+// Run a request and return the scale of its output.
+static float runScale(HotSwapExecutionSession &session, float value) {
+  int64_t shape[] = {4};
+  std::vector<OMTensorPtr> ins;
+  ins.emplace_back(
+      omTensorCreateEmpty(shape, 1, ONNX_TYPE_FLOAT), omTensorDestroy);
+  for (int i = 0; i < 4; i++)
+    ((float *)omTensorGetDataPtr(ins[0].get()))[i] = value;
+  auto outs = session.run(std::move(ins));
+  float *data = (float *)omTensorGetDataPtr(outs[0].get());
+  for (int i = 1; i < 4; i++)
+    assert(data[i] == data[0]);
+  return data[0] / value;
+}
+
+void testIdleThread() {
+  // The thread keeps the first version open by its arena until its next
+  // request.
+  HotSwapExecutionSession session(TEST_MODEL_PATH, "run_arena");
+  assert(runScale(session, 1.f) == 2.f);
+  session.reload(TEST_MODEL_V2_PATH).get();
+  assert(session.getVersion() == 1);
+  assert(session.getNumLoadedVersions() == 2);
+  assert(runScale(session, 1.f) == 3.f);
+  assert(session.getNumLoadedVersions() == 1);
+}
+
+void testExitingThread() {
+  // The thread releases its arena in the first version when it exits.
+  HotSwapExecutionSession session(TEST_MODEL_PATH, "run_arena");
+  std::promise<void> swapped;
+  std::promise<void> ran;
+  std::thread thread([&] {
+    assert(runScale(session, 1.f) == 2.f);
+    ran.set_value();
+    swapped.get_future().wait();
+  });
+  ran.get_future().wait();
+  session.reload(TEST_MODEL_V2_PATH).get();
+  assert(session.getNumLoadedVersions() == 2);
+  swapped.set_value();
+  thread.join();
+  assert(session.getNumLoadedVersions() == 1);
+}
+
+void testSwapInFlight() {
+  // The requests running while the version is swapped see the first version
+  // and then only the second one.
+  HotSwapExecutionSession session(TEST_MODEL_PATH, "run_arena");
+  std::atomic<int> numRuns{0};
+  std::atomic<bool> stopping{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++)
+    threads.emplace_back([&, t] {
+      float scale = 2.f;
+      for (int i = 0; !stopping; i++) {
+        float runningScale = runScale(session, t + i + 1.f);
+        assert(runningScale == 2.f || runningScale == 3.f);
+        assert(runningScale >= scale);
+        scale = runningScale;
+        numRuns++;
+      }
+      // A request started once the swap completed.
+      assert(runScale(session, 1.f) == 3.f);
+    });
+  while (numRuns < 100)
+    std::this_thread::yield();
+  session.reload(TEST_MODEL_V2_PATH).get();
+  int numRunsAtSwap = numRuns;
+  while (numRuns < numRunsAtSwap + 100)
+    std::this_thread::yield();
+  stopping = true;
+  for (auto &thread : threads)
+    thread.join();
+  assert(session.getVersion() == 1);
+  assert(session.getNumLoadedVersions() == 1);
+}
+
+int main() {
+  testIdleThread();
+  testExitingThread();
+  testSwapInFlight();
+  return 0;
+}
@@ -0,0 +1,95 @@
+//===---- JitExecutionSessionTest.cpp - JIT Execution Session Unit Test ---===//
+//
+// Copyright 2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the JIT execution session, run on a model
+// of the ONNX dialect compiled in the test process.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "src/JitExecutionSession.hpp"
+
+using namespace onnx_mlir;
+
+typedef std::unique_ptr<OMTensor, decltype(&omTensorDestroy)> OMTensorPtr;
+
+// z = x + y on tensors of 3 floats.
+static const char *kModel = R"(
+module {
+  func @main_graph(%arg0: tensor<3xf32>, %arg1: tensor<3xf32>)
+      -> tensor<3xf32>
+      attributes {input_names = ["x", "y"], output_names = ["z"]} {
+    %0 = "onnx.Add"(%arg0, %arg1)
+        : (tensor<3xf32>, tensor<3xf32>) -> tensor<3xf32>
+    return %0 : tensor<3xf32>
+  }
+  "onnx.EntryPoint"() {func = @main_graph, numInputs = 2 : i32,
+      numOutputs = 1 : i32} : () -> ()
+}
+)";
+
+// Write the model into a temporary file whose extension marks it as MLIR.
+static std::string writeModel() {
+  const char *tmpDir = getenv("TMPDIR");
+  std::string path = std::string(tmpDir ? tmpDir : "/tmp") +
+                     "/onnx-mlir-jit-test-XXXXXX.mlir";
+  int fd = mkstemps(&path[0], /*suffixlen=*/5);
+  assert(fd >= 0);
+  FILE *file = fdopen(fd, "w");
+  assert(file);
+  fputs(kModel, file);
+  fclose(file);
+  return path;
+}
+
+static std::vector<OMTensorPtr> createInputs(float x, float y) {
+  int64_t shape[] = {3};
+  std::vector<OMTensorPtr> ins;
+  for (float value : {x, y}) {
+    ins.emplace_back(
+        omTensorCreateEmpty(shape, 1, ONNX_TYPE_FLOAT), omTensorDestroy);
+    for (int i = 0; i < 3; i++)
+      ((float *)omTensorGetDataPtr(ins.back().get()))[i] = value + i;
+  }
+  return ins;
+}
+
+void testRun(const std::string &modelPath) {
+  JitExecutionSession session(modelPath, "run_main_graph");
+  for (int r = 0; r < 3; r++) {
+    auto outs = session.run(createInputs(r, 10));
+    assert(outs.size() == 1);
+    assert(omTensorGetRank(outs[0].get()) == 1);
+    assert(omTensorGetDataShape(outs[0].get())[0] == 3);
+    float *data = (float *)omTensorGetDataPtr(outs[0].get());
+    for (int i = 0; i < 3; i++)
+      assert(data[i] == (r + i) + (10 + i));
+  }
+}
+
+void testMissingEntryPoint(const std::string &modelPath) {
+  bool thrown = false;
+  try {
+    JitExecutionSession session(modelPath, "run_missing");
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+int main() {
+  std::string modelPath = writeModel();
+  testRun(modelPath);
+  testMissingEntryPoint(modelPath);
+  unlink(modelPath.c_str());
+  return 0;
+}
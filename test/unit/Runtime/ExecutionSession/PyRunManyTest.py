@@ -0,0 +1,51 @@
+# Tests of ExecutionSession.run_many, which runs batches of requests on native
+# threads. The model library is given on the command line, see TestModel.c.
+
+import sys
+import unittest
+
+import numpy as np
+
+from PyRuntime import ExecutionSession
+
+MODEL_PATH = sys.argv.pop(1)
+
+
+class RunManyTest(unittest.TestCase):
+    def setUp(self):
+        self.session = ExecutionSession(MODEL_PATH, "run_main_graph")
+
+    def test_run_many(self):
+        # More requests than threads, with two inputs each, so that the
+        # requests queued after the first ones read the inputs they were
+        # given.
+        requests = [[
+            np.full((3, 4), r, dtype=np.float32),
+            np.arange(r, r + 5, dtype=np.float32)
+        ] for r in range(16)]
+        outputs = self.session.run_many(requests, num_threads=4)
+        self.assertEqual(len(outputs), len(requests))
+        for request, output in zip(requests, outputs):
+            self.assertEqual(len(output), 2)
+            for x, y in zip(request, output):
+                np.testing.assert_array_equal(y, 2 * x)
+
+    def test_run_many_strided(self):
+        # Writable inputs keep their strides.
+        base = np.arange(48, dtype=np.float32).reshape(6, 8)
+        requests = [[base[r:, ::2]] for r in range(4)]
+        outputs = self.session.run_many(requests, num_threads=2)
+        for request, output in zip(requests, outputs):
+            np.testing.assert_array_equal(output[0], 2 * request[0])
+
+    def test_run_many_same_as_run(self):
+        requests = [[np.random.rand(2, 3).astype(np.float32)]
+                    for _ in range(8)]
+        outputs = self.session.run_many(requests)
+        for request, output in zip(requests, outputs):
+            np.testing.assert_array_equal(output[0],
+                                          self.session.run(request)[0])
+
+
+if __name__ == '__main__':
+    unittest.main()
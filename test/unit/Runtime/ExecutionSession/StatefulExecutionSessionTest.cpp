@@ -0,0 +1,163 @@
+//===-- StatefulExecutionSessionTest.cpp - Stateful Session Unit Test -----===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the stateful execution session, run on the
+// entry points of TestModel.c.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+#include <stdexcept>
+#include <vector>
+
+#include "StatefulExecutionSession.hpp"
+
+using namespace onnx_mlir;
+
+typedef StatefulExecutionSession::OMTensorPtr OMTensorPtr;
+
+static OMTensorPtr createTensor(std::vector<float> values,
+    std::vector<int64_t> shape) {
+  OMTensorPtr tensor(omTensorCreateEmpty(shape.data(), shape.size(),
+                         ONNX_TYPE_FLOAT),
+      omTensorDestroy);
+  std::copy(values.begin(), values.end(),
+      (float *)omTensorGetDataPtr(tensor.get()));
+  return tensor;
+}
+
+static float getElem(OMTensor *tensor, int64_t i) {
+  return ((float *)omTensorGetDataPtr(tensor))[i];
+}
+
+void testStates() {
+  StatefulExecutionSession session(TEST_MODEL_PATH, "run_accumulate",
+      {StatefulExecutionSession::StateBinding{1, 1}});
+  std::vector<OMTensorPtr> states;
+  states.emplace_back(createTensor({0.f, 0.f}, {2}));
+  auto stream = session.createStream(std::move(states));
+
+  // The state is the sum of the inputs of the previous calls.
+  float sum = 0.f;
+  for (int step = 1; step <= 4; step++) {
+    std::vector<OMTensorPtr> ins;
+    ins.emplace_back(createTensor({(float)step, 10.f * step}, {2}));
+    auto outs = session.run(*stream, std::move(ins));
+    sum += step;
+    assert(outs.size() == 1);
+    assert(getElem(outs[0].get(), 0) == sum);
+    assert(getElem(outs[0].get(), 1) == 10.f * sum);
+    assert(getElem(stream->getStates()[0].get(), 0) == sum);
+  }
+}
+
+void testStatesInto() {
+  // The model writes the next states into the second buffer of each stream,
+  // and the buffers of a stream are swapped after each call. Two streams run
+  // in turn keep apart states.
+  StatefulExecutionSession session(TEST_MODEL_PATH, "run_accumulate",
+      {StatefulExecutionSession::StateBinding{1, 1}});
+  std::unique_ptr<StatefulExecutionSession::Stream> streams[2];
+  for (auto &stream : streams) {
+    std::vector<OMTensorPtr> states;
+    states.emplace_back(createTensor({0.f, 0.f}, {2}));
+    stream = session.createStream(std::move(states));
+  }
+  OMTensor *buffers[2][2];
+  for (int s = 0; s < 2; s++)
+    buffers[s][0] = streams[s]->getStates()[0].get();
+
+  float sums[2] = {0.f, 0.f};
+  OMTensorPtr out = createTensor({0.f, 0.f}, {2});
+  for (int step = 1; step <= 4; step++) {
+    for (int s = 0; s < 2; s++) {
+      float x = step * (s + 1);
+      std::vector<OMTensorPtr> ins;
+      ins.emplace_back(createTensor({x, 10.f * x}, {2}));
+      session.runInto(*streams[s], std::move(ins), {out.get()});
+      sums[s] += x;
+      assert(getElem(out.get(), 0) == sums[s]);
+      assert(getElem(out.get(), 1) == 10.f * sums[s]);
+
+      OMTensor *state = streams[s]->getStates()[0].get();
+      assert(getElem(state, 0) == sums[s]);
+      if (step == 1)
+        buffers[s][1] = state;
+      assert(state == buffers[s][step % 2]);
+    }
+  }
+  assert(buffers[0][0] != buffers[0][1]);
+}
+
+void testCaches() {
+  // The cache holds two entries along dimension 1, the view of the entries is
+  // strided until the cache is full and is repacked by the model. The calls
+  // past the capacity grow the buffer.
+  StatefulExecutionSession session(TEST_MODEL_PATH, "run_append", {},
+      {StatefulExecutionSession::CacheBinding{1, 1, 1, 2}});
+  std::vector<OMTensorPtr> caches;
+  caches.emplace_back(createTensor({}, {2, 0}));
+  auto stream = session.createStream({}, std::move(caches));
+
+  float sum = 0.f;
+  for (int step = 1; step <= 5; step++) {
+    std::vector<OMTensorPtr> ins;
+    ins.emplace_back(createTensor({(float)step, -(float)step}, {2, 1}));
+    auto outs = session.run(*stream, std::move(ins));
+    assert(outs.size() == 1);
+    assert(getElem(outs[0].get(), 0) == step + sum);
+    assert(getElem(outs[0].get(), 1) == -(step + sum));
+    sum += step;
+    assert(stream->getCacheLength(0) == step);
+
+    // The view holds all the entries, in order.
+    OMTensor *view = stream->getCache(0);
+    assert(omTensorGetDataShape(view)[1] == step);
+    int64_t *strides = omTensorGetStrides(view);
+    for (int j = 0; j < step; j++) {
+      float *data = (float *)omTensorGetDataPtr(view);
+      assert(data[j * strides[1]] == j + 1);
+      assert(data[strides[0] + j * strides[1]] == -(j + 1));
+    }
+  }
+}
+
+void testInvalidBindings() {
+  // Bindings sharing an input would leave fewer inputs of the model to the
+  // call than it is given.
+  bool thrown = false;
+  try {
+    StatefulExecutionSession session(TEST_MODEL_PATH, "run_accumulate",
+        {StatefulExecutionSession::StateBinding{1, 1},
+            StatefulExecutionSession::StateBinding{1, 0}});
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // A state bound past the inputs of the model is reported by the run.
+  StatefulExecutionSession session(TEST_MODEL_PATH, "run_accumulate",
+      {StatefulExecutionSession::StateBinding{2, 1}});
+  std::vector<OMTensorPtr> states;
+  states.emplace_back(createTensor({0.f, 0.f}, {2}));
+  auto stream = session.createStream(std::move(states));
+  std::vector<OMTensorPtr> ins;
+  ins.emplace_back(createTensor({1.f, 10.f}, {2}));
+  thrown = false;
+  try {
+    session.run(*stream, std::move(ins));
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+int main() {
+  testStates();
+  testStatesInto();
+  testCaches();
+  testInvalidBindings();
+  return 0;
+}
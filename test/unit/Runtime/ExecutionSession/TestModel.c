@@ -0,0 +1,201 @@
+//===------------- TestModel.c - Model Library for Session Tests ----------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains the entry points of a model library standing in for the
+// compiled models in the unit tests of the execution sessions. The outputs of
+// run_main_graph are its float inputs multiplied by TEST_MODEL_SCALE, and the
+// library counts the calls of its entry points. The inputs of the stateful
+// entry points are repacked like those of the compiled models, run_arena
+// keeps its buffers in the memory arena of the runtime, and run_copy copies
+// its input with the memory copy threads of the runtime. The signature of the
+// library is empty unless set by the tests.
+//
+//===----------------------------------------------------------------------===//
+#include <stdlib.h>
+#include <string.h>
+
+#include "OnnxMlirRuntime.h"
+#include "onnx-mlir/Runtime/OMArena.h"
+#include "onnx-mlir/Runtime/OMMemcpy.h"
+
+#ifndef TEST_MODEL_SCALE
+#define TEST_MODEL_SCALE 2
+#endif
+
+// Left out from the header, called by the entry points of the models.
+OMTensor *omTensorGetContiguous(OMTensor *tensor);
+void omTensorReleaseContiguous(OMTensor *contiguous, OMTensor *tensor);
+
+static int64_t _numCalls = 0;
+static const char *_inputSignature = "";
+static const char *_outputSignature = "";
+
+int64_t testModelGetNumCalls(void) {
+    return __atomic_load_n(&_numCalls, __ATOMIC_SEQ_CST);
+}
+
+void testModelSetSignature(
+    const char *inputSignature, const char *outputSignature) {
+    _inputSignature = inputSignature;
+    _outputSignature = outputSignature;
+}
+
+const char *omInputSignature(void) { return _inputSignature; }
+
+const char *omOutputSignature(void) { return _outputSignature; }
+
+// Return element i of a tensor in row-major order, with the strides and the
+// offset of the tensor.
+static float loadElem(OMTensor *tensor, int64_t i) {
+    int rank = omTensorGetRank(tensor);
+    int64_t *shape = omTensorGetDataShape(tensor);
+    int64_t *strides = omTensorGetStrides(tensor);
+    int64_t offset = omTensorGetOffset(tensor);
+    for (int d = rank - 1; d >= 0; d--) {
+        offset += (i % shape[d]) * strides[d];
+        i /= shape[d];
+    }
+    return ((float *)omTensorGetDataPtr(tensor))[offset];
+}
+
+// Create a list of tensors owning their array, as the compiled models do.
+static OMTensorList *createList(OMTensor **tensors, int n) {
+    OMTensor **omts = (OMTensor **)malloc(n * sizeof(OMTensor *));
+    for (int i = 0; i < n; i++)
+        omts[i] = tensors[i];
+    return omTensorListCreate(omts, n);
+}
+
+OMTensorList *run_main_graph(OMTensorList *input) {
+    __atomic_add_fetch(&_numCalls, 1, __ATOMIC_SEQ_CST);
+    int n = omTensorListGetSize(input);
+    OMTensor *outputs[16];
+    for (int i = 0; i < n && i < 16; i++) {
+        OMTensor *x = omTensorListGetOmtByIndex(input, i);
+        OMTensor *y = omTensorCreateEmpty(omTensorGetDataShape(x),
+            omTensorGetRank(x), ONNX_TYPE_FLOAT);
+        float *yData = (float *)omTensorGetDataPtr(y);
+        int64_t numElems =
+            getNumOfElems(omTensorGetDataShape(x), omTensorGetRank(x));
+        for (int64_t j = 0; j < numElems; j++)
+            yData[j] = TEST_MODEL_SCALE * loadElem(x, j);
+        outputs[i] = y;
+    }
+    return createList(outputs, n < 16 ? n : 16);
+}
+
+// run_main_graph writing into the output buffers given by the caller.
+OMTensorList *run_main_graph_into(OMTensorList *input, OMTensorList *output) {
+    __atomic_add_fetch(&_numCalls, 1, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < omTensorListGetSize(input); i++) {
+        OMTensor *x = omTensorListGetOmtByIndex(input, i);
+        float *yData =
+            (float *)omTensorGetDataPtr(omTensorListGetOmtByIndex(output, i));
+        int64_t numElems =
+            getNumOfElems(omTensorGetDataShape(x), omTensorGetRank(x));
+        for (int64_t j = 0; j < numElems; j++)
+            yData[j] = TEST_MODEL_SCALE * loadElem(x, j);
+    }
+    return output;
+}
+
+// The outputs of run_main_graph on a single input, computed in a buffer of
+// the memory arena like those of the models compiled with a memory arena.
+OMTensorList *run_arena(OMTensorList *input) {
+    __atomic_add_fetch(&_numCalls, 1, __ATOMIC_SEQ_CST);
+    OMTensor *x = omTensorListGetOmtByIndex(input, 0);
+    int64_t numElems =
+        getNumOfElems(omTensorGetDataShape(x), omTensorGetRank(x));
+    float *buffer = (float *)omArenaGet(0, numElems * sizeof(float));
+    for (int64_t j = 0; j < numElems; j++)
+        buffer[j] = TEST_MODEL_SCALE * loadElem(x, j);
+    OMTensor *y = omTensorCreateEmpty(
+        omTensorGetDataShape(x), omTensorGetRank(x), ONNX_TYPE_FLOAT);
+    memcpy(omTensorGetDataPtr(y), buffer, numElems * sizeof(float));
+    return createList(&y, 1);
+}
+
+// Inputs (x, state) of the same shape, outputs (x + state, x + state).
+OMTensorList *run_accumulate(OMTensorList *input) {
+    __atomic_add_fetch(&_numCalls, 1, __ATOMIC_SEQ_CST);
+    OMTensor *x = omTensorGetContiguous(omTensorListGetOmtByIndex(input, 0));
+    OMTensor *state =
+        omTensorGetContiguous(omTensorListGetOmtByIndex(input, 1));
+    int rank = omTensorGetRank(x);
+    int64_t *shape = omTensorGetDataShape(x);
+    OMTensor *outputs[2];
+    for (int i = 0; i < 2; i++) {
+        outputs[i] = omTensorCreateEmpty(shape, rank, ONNX_TYPE_FLOAT);
+        float *y = (float *)omTensorGetDataPtr(outputs[i]);
+        for (int64_t j = 0; j < getNumOfElems(shape, rank); j++)
+            y[j] = ((float *)omTensorGetDataPtr(x))[j] +
+                   ((float *)omTensorGetDataPtr(state))[j];
+    }
+    omTensorReleaseContiguous(x, omTensorListGetOmtByIndex(input, 0));
+    omTensorReleaseContiguous(state, omTensorListGetOmtByIndex(input, 1));
+    return createList(outputs, 2);
+}
+
+// run_accumulate writing into the output buffers (y, state) given by the
+// caller.
+OMTensorList *run_accumulate_into(OMTensorList *input, OMTensorList *output) {
+    __atomic_add_fetch(&_numCalls, 1, __ATOMIC_SEQ_CST);
+    OMTensor *x = omTensorGetContiguous(omTensorListGetOmtByIndex(input, 0));
+    OMTensor *state =
+        omTensorGetContiguous(omTensorListGetOmtByIndex(input, 1));
+    int rank = omTensorGetRank(x);
+    int64_t *shape = omTensorGetDataShape(x);
+    for (int i = 0; i < 2; i++) {
+        float *y = (float *)omTensorGetDataPtr(
+            omTensorListGetOmtByIndex(output, i));
+        for (int64_t j = 0; j < getNumOfElems(shape, rank); j++)
+            y[j] = ((float *)omTensorGetDataPtr(x))[j] +
+                   ((float *)omTensorGetDataPtr(state))[j];
+    }
+    omTensorReleaseContiguous(x, omTensorListGetOmtByIndex(input, 0));
+    omTensorReleaseContiguous(state, omTensorListGetOmtByIndex(input, 1));
+    return output;
+}
+
+// Inputs x of shape [n, 1] and the past entries of shape [n, k] of a cache,
+// outputs x + the sum of the past entries along dimension 1, and x as the
+// entry of the call.
+OMTensorList *run_append(OMTensorList *input) {
+    __atomic_add_fetch(&_numCalls, 1, __ATOMIC_SEQ_CST);
+    OMTensor *x = omTensorGetContiguous(omTensorListGetOmtByIndex(input, 0));
+    OMTensor *cache =
+        omTensorGetContiguous(omTensorListGetOmtByIndex(input, 1));
+    int64_t n = omTensorGetDataShape(x)[0];
+    int64_t k = omTensorGetDataShape(cache)[1];
+    float *xData = (float *)omTensorGetDataPtr(x);
+    float *cacheData = (float *)omTensorGetDataPtr(cache);
+    OMTensor *outputs[2];
+    for (int i = 0; i < 2; i++)
+        outputs[i] =
+            omTensorCreateEmpty(omTensorGetDataShape(x), 2, ONNX_TYPE_FLOAT);
+    float *y = (float *)omTensorGetDataPtr(outputs[0]);
+    float *entry = (float *)omTensorGetDataPtr(outputs[1]);
+    for (int64_t r = 0; r < n; r++) {
+        y[r] = xData[r];
+        for (int64_t j = 0; j < k; j++)
+            y[r] += cacheData[r * k + j];
+        entry[r] = xData[r];
+    }
+    omTensorReleaseContiguous(x, omTensorListGetOmtByIndex(input, 0));
+    omTensorReleaseContiguous(cache, omTensorListGetOmtByIndex(input, 1));
+    return createList(outputs, 2);
+}
+
+// Input x, output a copy of x made by the memory copy threads.
+OMTensorList *run_copy(OMTensorList *input) {
+    __atomic_add_fetch(&_numCalls, 1, __ATOMIC_SEQ_CST);
+    OMTensor *x = omTensorListGetOmtByIndex(input, 0);
+    OMTensor *y = omTensorCreateEmpty(
+        omTensorGetDataShape(x), omTensorGetRank(x), ONNX_TYPE_FLOAT);
+    omMemcpyParallel(omTensorGetDataPtr(y), omTensorGetDataPtr(x),
+        omTensorGetDataBufferSize(x), /*threshold=*/0, /*nonTemporal=*/0);
+    return createList(&y, 1);
+}
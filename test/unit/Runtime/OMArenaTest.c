@@ -0,0 +1,40 @@
+//===------------------ OMArenaTest.c - OMArena Unit Test -----------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the memory arena of the runtime.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+
+#include "OnnxMlirRuntime.h"
+
+void testOMArenaNumAllocs() {
+    int64_t numAllocs = omArenaGetNumAllocs();
+    void *pool = omArenaGet(1, 1024);
+    assert(pool);
+    assert(omArenaGetNumAllocs() > numAllocs);
+
+    // The memory of the slots is reused by the next invocations.
+    numAllocs = omArenaGetNumAllocs();
+    assert(omArenaGet(1, 1024) == pool);
+    assert(omArenaGet(1, 512) == pool);
+    assert(omArenaGet(0, 256));
+    int64_t sizedNumAllocs = omArenaGetNumAllocs();
+    assert(sizedNumAllocs == numAllocs + 1);
+    omArenaGet(0, 256);
+    omArenaGet(1, 1024);
+    assert(omArenaGetNumAllocs() == sizedNumAllocs);
+
+    // A larger memory pool is allocated again.
+    omArenaGet(1, 4096);
+    assert(omArenaGetNumAllocs() == sizedNumAllocs + 1);
+    omArenaRelease();
+}
+
+int main() {
+    testOMArenaNumAllocs();
+    return 0;
+}
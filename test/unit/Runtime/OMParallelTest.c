@@ -0,0 +1,66 @@
+//===--------------- OMParallelTest.c - OMParallel Unit Test --------------===//
+//
+// Copyright 2019-2020 The IBM Research Authors.
+//
+// =============================================================================
+//
+// This file contains unit tests of the parallel loop function of the runtime.
+//
+//===----------------------------------------------------------------------===//
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "onnx-mlir/Runtime/OMParallel.h"
+
+#define NUM_ITERATIONS 1000
+
+// The number of times each iteration was run, and the number of ranges.
+typedef struct {
+    int32_t counts[NUM_ITERATIONS];
+    int64_t numRanges;
+} Counts;
+
+static void countIterations(int64_t begin, int64_t end, void *context) {
+    Counts *counts = (Counts *)context;
+    assert(0 <= begin && begin < end && end <= NUM_ITERATIONS);
+    for (int64_t i = begin; i < end; ++i)
+        __atomic_add_fetch(&counts->counts[i], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counts->numRanges, 1, __ATOMIC_RELAXED);
+}
+
+static void runLoop(int64_t numIterations, int32_t numThreads,
+    int64_t maxNumRanges) {
+    Counts counts;
+    memset(&counts, 0, sizeof(counts));
+    omParallelFor(countIterations, numIterations, &counts, numThreads);
+    for (int64_t i = 0; i < NUM_ITERATIONS; ++i)
+        assert(counts.counts[i] == (i < numIterations ? 1 : 0));
+    assert(counts.numRanges >= (numIterations > 0 ? 1 : 0));
+    assert(counts.numRanges <= maxNumRanges);
+}
+
+// Each iteration runs once, in at most one range per thread.
+void testOMParallelForIterations() {
+    runLoop(NUM_ITERATIONS, 0, NUM_ITERATIONS);
+    runLoop(NUM_ITERATIONS, 2, 2);
+    runLoop(NUM_ITERATIONS, 1, 1);
+    runLoop(3, 0, 3);
+    runLoop(0, 0, 0);
+}
+
+// A loop started by the body of a parallel loop runs on its thread.
+static void runNestedLoop(int64_t begin, int64_t end, void *context) {
+    for (int64_t i = begin; i < end; ++i)
+        runLoop(NUM_ITERATIONS, 0, 1);
+}
+
+void testOMParallelForNested() {
+    omParallelFor(runNestedLoop, 4, NULL, 0);
+}
+
+int main() {
+    testOMParallelForIterations();
+    testOMParallelForNested();
+    return 0;
+}
@@ -13,6 +13,10 @@
 
 #include "OnnxMlirRuntime.h"
 
+// Left out from the header, called by the entry points of the models.
+OMTensor *omTensorGetContiguous(OMTensor *tensor);
+void omTensorReleaseContiguous(OMTensor *contiguous, OMTensor *tensor);
+
 void testOMTensorCtor() {
     float data[4] = {1.f, 1.f};
     int64_t shape[2] = {2, 2};
@@ -30,7 +34,63 @@ void testOMTensorCtor() {
     assert(strides_ptr[1] == 1);
 }
 
+void testOMTensorGetContiguous() {
+    // The transpose of a 2x3 row-major tensor.
+    float data[6] = {0.f, 1.f, 2.f, 3.f, 4.f, 5.f};
+    int64_t shape[2] = {3, 2};
+    int64_t strides[2] = {1, 3};
+    OMTensor *tensor = omTensorCreate(data, shape, 2, ONNX_TYPE_FLOAT);
+    assert(tensor);
+    omTensorSetStrides(tensor, strides);
+
+    OMTensor *contiguous = omTensorGetContiguous(tensor);
+    assert(contiguous != tensor);
+    float *repacked = (float *)omTensorGetDataPtr(contiguous);
+    assert(repacked != data);
+    float expected[6] = {0.f, 3.f, 1.f, 4.f, 2.f, 5.f};
+    for (int i = 0; i < 6; i++)
+        assert(repacked[i] == expected[i]);
+    int64_t* strides_ptr = omTensorGetStrides(contiguous);
+    assert(strides_ptr[0] == 2);
+    assert(strides_ptr[1] == 1);
+
+    // The tensor of the caller still views its data with its strides, and
+    // the next calls see the updates of the data.
+    omTensorReleaseContiguous(contiguous, tensor);
+    assert(omTensorGetDataPtr(tensor) == data);
+    assert(omTensorGetStrides(tensor)[0] == 1);
+    assert(omTensorGetStrides(tensor)[1] == 3);
+    data[1] = 6.f;
+    contiguous = omTensorGetContiguous(tensor);
+    assert(((float *)omTensorGetDataPtr(contiguous))[2] == 6.f);
+    omTensorReleaseContiguous(contiguous, tensor);
+
+    // Dense tensors are used as they are.
+    OMTensor *dense = omTensorCreate(data, shape, 2, ONNX_TYPE_FLOAT);
+    assert(omTensorGetContiguous(dense) == dense);
+    omTensorReleaseContiguous(dense, dense);
+    assert(omTensorGetDataPtr(dense) == data);
+
+    // Dense tensors with other strides for their dimensions of size 1 are
+    // viewed without copy.
+    int64_t rowShape[2] = {1, 6};
+    int64_t rowStrides[2] = {1, 1};
+    OMTensor *row = omTensorCreate(data, rowShape, 2, ONNX_TYPE_FLOAT);
+    omTensorSetStrides(row, rowStrides);
+    contiguous = omTensorGetContiguous(row);
+    assert(contiguous != row);
+    assert(omTensorGetDataPtr(contiguous) == data);
+    assert(omTensorGetStrides(contiguous)[0] == 6);
+    omTensorReleaseContiguous(contiguous, row);
+    assert(omTensorGetStrides(row)[0] == 1);
+
+    omTensorDestroy(row);
+    omTensorDestroy(dense);
+    omTensorDestroy(tensor);
+}
+
 int main() {
     testOMTensorCtor();
+    testOMTensorGetContiguous();
     return 0;
 }
\ No newline at end of file
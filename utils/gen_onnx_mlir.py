@@ -238,6 +238,7 @@ special_attr_defaults = dict([
 special_op_handler = dict([
     ("MaxPool", "ImportNodeMaxPool"),
     ("BatchNormalization", "ImportNodeBatchNormalization"),
+    ("If", "ImportNodeIf"),
     ("Pad", "ImportNodePad"),
     ("Slice", "ImportNodeSlice"),
     #("Transpose", "ImportNodeTranspose")
@@ -248,6 +249,8 @@ OpsWithShapeInference=[
     'Abs',
     'Add',
     'And',
+    'ArgMax',
+    'ArgMin',
     'Atan',
     'AveragePool',
     'Cast',
@@ -274,11 +277,13 @@ OpsWithShapeInference=[
     'GlobalAveragePool',
     'HardSigmoid',
     'Identity',
+    'InstanceNormalization',
     'LSTM',
     'LeakyRelu',
     'Less',
     'Log',
     'MatMul',
+    'MatMulInteger',
     'Max',
     'Min',
     'Mul',
@@ -300,7 +305,10 @@ OpsWithShapeInference=[
     'ReduceSum',
     'Relu',
     'Reshape',
+    'Resize',
     'Scaler',
+    'ScatterElements',
+    'ScatterND',
     'Selu',
     'Shape',
     'Sigmoid',
@@ -320,13 +328,15 @@ OpsWithShapeInference=[
     'Tan',
     'Tanh',
     'Tile',
+    'TopK',
     'Transpose',
     'Unsqueeze',
+    'Upsample',
     'Xor',
 ]
 
 # Operations supporting canonicalization.
-OpsWithCanonicalizer = ['Add', 'Identity', 'Gemm', 'Conv', 'Cast', 'Transpose', 'Dropout', 'Shape', 'Size']
+OpsWithCanonicalizer = ['Add', 'Identity', 'Mul', 'Gemm', 'Conv', 'Cast', 'Transpose', 'Dropout', 'Shape', 'Size', 'ReduceMean', 'ReduceSum']
 
 # Operations who have operands that, if produced by constant operations, should
 # be promoted to become an attribute (via attribute promotion).